@@ -0,0 +1,351 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Headless throughput benchmark of the VT processing stages.
+//
+// Each corpus is fed into three stages of increasing depth:
+//
+//   Parser     - the VT parser alone, with all events discarded.
+//   Sequencer  - the VT parser plus sequence assembly and function lookup,
+//                i.e. everything up to (but excluding) applying the sequence to the screen.
+//   Screen     - Screen::write(), i.e. the full pipeline without any frontend.
+//
+// Usage: vtbench [-s MEGABYTES] [-r REPEAT] [FILE ...]
+//
+// Any given FILE (e.g. a recorded session) is benchmarked in addition to the synthetic corpora.
+
+#include <terminal/Parser.h>
+#include <terminal/Screen.h>
+#include <terminal/ScreenEvents.h>
+#include <terminal/Sequencer.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using namespace terminal;
+
+namespace // {{{ helper
+{
+    struct Corpus {
+        string name;
+        string data;
+    };
+
+    /// Repeats _generate() until the resulting corpus has at least _size bytes.
+    template <typename Generator>
+    string fill(size_t _size, Generator _generate)
+    {
+        string text;
+        text.reserve(_size + 4096);
+        for (unsigned i = 0; text.size() < _size; ++i)
+            text += _generate(i);
+        return text;
+    }
+
+    string asciiText(size_t _size)
+    {
+        string_view constexpr alphabet =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZ "
+            "abcdefghijklmnopqrstuvwxyz "
+            "0123456789 []{}();+-*/=";
+
+        return fill(_size, [&](unsigned i) {
+            auto line = string{};
+            for (unsigned k = 0; k < 79; ++k)
+                line += alphabet[(i + k) % alphabet.size()];
+            return line + "\r\n";
+        });
+    }
+
+    string sgrText(size_t _size)
+    {
+        return fill(_size, [](unsigned i) {
+            return fmt::format("\033[38;5;{}m\033[48;2;{};{};{}m{}\033[1;4:3m{}\033[m ",
+                               i % 256, i % 256, (i * 3) % 256, (i * 7) % 256,
+                               "colored", i % 2 ? "text" : "words");
+        });
+    }
+
+    string cjkText(size_t _size)
+    {
+        return fill(_size, [](unsigned i) {
+            return string(i % 2
+                ? "\xE6\xBC\xA2\xE5\xAD\x97\xE3\x81\x8B\xE3\x81\xAA\xE3\x82\xAB\xE3\x83\x8A" // 漢字かなカナ
+                : "\xED\x95\x9C\xEA\xB5\xAD\xEC\x96\xB4\xE4\xB8\xAD\xE6\x96\x87 "); // 한국어中文
+        });
+    }
+
+    string emojiText(size_t _size)
+    {
+        return fill(_size, [](unsigned i) {
+            switch (i % 4)
+            {
+                case 0: return "\xF0\x9F\x91\xA8\xE2\x80\x8D\xF0\x9F\x91\xA9\xE2\x80\x8D\xF0\x9F\x91\xA7\xE2\x80\x8D\xF0\x9F\x91\xA6 "sv; // family
+                case 1: return "\xF0\x9F\x8F\xB3\xEF\xB8\x8F\xE2\x80\x8D\xF0\x9F\x8C\x88 "sv; // rainbow flag
+                case 2: return "\xF0\x9F\x91\xA9\xF0\x9F\x8F\xBD\xE2\x80\x8D\xF0\x9F\x92\xBB "sv; // technologist
+                default: return "\xE2\x9D\xA4\xEF\xB8\x8F\r\n"sv; // heart
+            }
+        });
+    }
+
+    /// Full screen redraws as done by TUI applications, using cursor addressing and SGR.
+    string tuiRedraws(size_t _size)
+    {
+        return fill(_size, [](unsigned i) {
+            auto frame = string("\033[?25l\033[H");
+            for (unsigned row = 1; row <= 24; ++row)
+            {
+                frame += fmt::format("\033[{};1H\033[{}m{:>4}\033[m ", row, row == 1 ? "7" : "33", row + i);
+                frame += fmt::format("\033[38;5;{}m{:<60}\033[K", (row + i) % 256, "item content of the list view");
+                frame += fmt::format("\033[{};70H\033[2m{:>8}\033[m", row, (row * i) % 100000);
+            }
+            frame += "\033[24;1H\033[44m status line\033[K\033[m\033[?25h";
+            return frame;
+        });
+    }
+
+    string sixelImages(size_t _size)
+    {
+        return fill(_size, [](unsigned i) {
+            auto image = string("\033Pq\"1;1;400;120");
+            for (int color = 1; color <= 4; ++color)
+                image += fmt::format("#{};2;{};{};{}", color, color * 20, (color * 30) % 100, 100 - color * 10);
+            for (int band = 0; band < 20; ++band)
+            {
+                image += fmt::format("#{}!{}~#{}", 1 + (band + i) % 4, 100 + band, 1 + (band + 1) % 4);
+                for (int x = 0; x < 100; ++x)
+                    image += static_cast<char>(63 + (x * 7 + band) % 64);
+                image += fmt::format("#{}!{}_-", 1 + band % 4, 200 - band);
+            }
+            image += "\033\\";
+            return image;
+        });
+    }
+
+    optional<Corpus> loadFile(string const& _path)
+    {
+        auto in = ifstream(_path, ios::binary);
+        if (!in.good())
+            return nullopt;
+        return Corpus{_path, string(istreambuf_iterator<char>(in), istreambuf_iterator<char>())};
+    }
+} // }}}
+
+namespace // {{{ stages
+{
+    /// Discards all parser events, including the bulk ones that would otherwise be split per character.
+    class NullEvents : public BasicParserEvents {
+      public:
+        void print(string_view) override {}
+        void putOSC(string_view) override {}
+        void put(string_view) override {}
+    };
+
+    /// Builds VT sequences and looks up their function definitions, just like the Sequencer does,
+    /// but without applying them to a screen.
+    class SequenceBuilder : public BasicParserEvents {
+      public:
+        void print(char32_t) override { ++printed_; }
+        void print(string_view _chars) override { printed_ += _chars.size(); }
+        void execute(char) override { ++executed_; }
+        void put(string_view) override {}
+        void clear() override { sequence_.clear(); }
+        void collect(char _char) override { sequence_.intermediateCharacters().push_back(_char); }
+        void collectLeader(char _leader) override { sequence_.setLeader(_leader); }
+
+        void param(char _char) override
+        {
+            if (sequence_.parameters().empty())
+                sequence_.parameters().push();
+
+            if (_char == ';')
+                sequence_.parameters().push();
+            else if (_char == ':')
+                sequence_.parameters().pushSubParameter();
+            else if ('0' <= _char && _char <= '9')
+                sequence_.parameters().appendDigit(_char - '0');
+        }
+
+        void dispatchESC(char _finalChar) override { dispatch(FunctionCategory::ESC, _finalChar); }
+        void dispatchCSI(char _finalChar) override { dispatch(FunctionCategory::CSI, _finalChar); }
+        bool hook(char _finalChar) override { dispatch(FunctionCategory::DCS, _finalChar); return true; }
+
+        void startOSC() override { sequence_.clear(); sequence_.setCategory(FunctionCategory::OSC); }
+        void putOSC(string_view _chars) override { sequence_.setOscString(_chars); }
+        void dispatchOSC() override
+        {
+            auto const osc = sequence_.oscString();
+            auto code = 0;
+            auto i = size_t{0};
+            for (; i < osc.size() && '0' <= osc[i] && osc[i] <= '9'; ++i)
+                code = code * 10 + (osc[i] - '0');
+            sequence_.parameters().push(code);
+            sequence_.setOscString(osc.substr(min(i + 1, osc.size())));
+            lookup();
+        }
+
+        size_t checksum() const noexcept { return printed_ + executed_ + known_; }
+
+      private:
+        void dispatch(FunctionCategory _category, char _finalChar)
+        {
+            sequence_.setCategory(_category);
+            sequence_.setFinalChar(_finalChar);
+            lookup();
+        }
+
+        void lookup()
+        {
+            if (sequence_.functionDefinition() != nullptr)
+                ++known_;
+        }
+
+        Sequence sequence_{};
+        size_t printed_ = 0;
+        size_t executed_ = 0;
+        size_t known_ = 0;
+    };
+
+    struct Result {
+        size_t bytes = 0;
+        chrono::nanoseconds duration{};
+
+        double megabytesPerSecond() const noexcept
+        {
+            auto const seconds = chrono::duration<double>(duration).count();
+            return seconds > 0 ? double(bytes) / (1024.0 * 1024.0) / seconds : 0.0;
+        }
+
+        double nanosecondsPerByte() const noexcept
+        {
+            return bytes ? double(duration.count()) / double(bytes) : 0.0;
+        }
+    };
+
+    template <typename Feed>
+    Result measure(string const& _data, int _repeat, Feed _feed)
+    {
+        auto const start = chrono::steady_clock::now();
+        for (int i = 0; i < _repeat; ++i)
+            _feed(string_view(_data));
+        auto const end = chrono::steady_clock::now();
+        return Result{_data.size() * size_t(_repeat), chrono::duration_cast<chrono::nanoseconds>(end - start)};
+    }
+
+    Result benchParser(string const& _data, int _repeat)
+    {
+        auto events = NullEvents{};
+        auto parser = parser::Parser(events);
+        return measure(_data, _repeat, [&](string_view _chunk) { parser.parseFragment(_chunk); });
+    }
+
+    Result benchSequencer(string const& _data, int _repeat, size_t& _checksum)
+    {
+        auto events = SequenceBuilder{};
+        auto parser = parser::Parser(events);
+        auto const result = measure(_data, _repeat, [&](string_view _chunk) { parser.parseFragment(_chunk); });
+        _checksum += events.checksum();
+        return result;
+    }
+
+    Result benchScreen(string const& _data, int _repeat)
+    {
+        auto events = MockScreenEvents{};
+        auto screen = Screen(crispy::Size{120, 40}, events, false, false, 1000, crispy::Size{800, 600});
+        screen.setCellPixelSize(crispy::Size{10, 20});
+        return measure(_data, _repeat, [&](string_view _chunk) { screen.write(_chunk); });
+    }
+} // }}}
+
+int main(int argc, char const* argv[])
+{
+    auto corpusSize = size_t{16} * 1024 * 1024;
+    auto repeat = 3;
+    auto corpora = vector<Corpus>{};
+    auto files = vector<string>{};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if ((strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "-r") == 0) && i + 1 < argc)
+        {
+            auto const value = atoi(argv[i + 1]);
+            if (argv[i][1] == 's')
+                corpusSize = size_t(max(value, 1)) * 1024 * 1024;
+            else
+                repeat = max(value, 1);
+            ++i;
+        }
+        else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
+        {
+            fmt::print("Usage: {} [-s MEGABYTES] [-r REPEAT] [FILE ...]\n", argv[0]);
+            return EXIT_SUCCESS;
+        }
+        else
+            files.emplace_back(argv[i]);
+    }
+
+    corpora.emplace_back(Corpus{"ascii", asciiText(corpusSize)});
+    corpora.emplace_back(Corpus{"sgr", sgrText(corpusSize)});
+    corpora.emplace_back(Corpus{"cjk", cjkText(corpusSize)});
+    corpora.emplace_back(Corpus{"emoji-zwj", emojiText(corpusSize)});
+    corpora.emplace_back(Corpus{"tui-redraw", tuiRedraws(corpusSize)});
+    corpora.emplace_back(Corpus{"sixel", sixelImages(corpusSize)});
+
+    for (auto const& file : files)
+    {
+        if (auto corpus = loadFile(file); corpus)
+            corpora.emplace_back(move(*corpus));
+        else
+        {
+            fmt::print(stderr, "Could not read file: {}\n", file);
+            return EXIT_FAILURE;
+        }
+    }
+
+    fmt::print("{:<16} {:>10} {:>24} {:>24} {:>24}\n", "corpus", "size", "Parser", "Sequencer", "Screen");
+    fmt::print("{:<16} {:>10} {:>24} {:>24} {:>24}\n", "", "(MB)", "MB/s | ns/byte", "MB/s | ns/byte", "MB/s | ns/byte");
+
+    auto const cell = [](Result const& _result) {
+        return fmt::format("{:>10.2f} | {:>8.3f}", _result.megabytesPerSecond(), _result.nanosecondsPerByte());
+    };
+
+    size_t checksum = 0;
+    for (auto const& corpus : corpora)
+    {
+        auto const parser = benchParser(corpus.data, repeat);
+        auto const sequencer = benchSequencer(corpus.data, repeat, checksum);
+        auto const screen = benchScreen(corpus.data, repeat);
+
+        fmt::print("{:<16} {:>10.2f} {:>24} {:>24} {:>24}\n",
+                   corpus.name,
+                   double(corpus.data.size()) / (1024.0 * 1024.0),
+                   cell(parser), cell(sequencer), cell(screen));
+    }
+
+    // Keeps the sequence builder's work observable.
+    if (checksum == 0)
+        fmt::print("(no events)\n");
+
+    return EXIT_SUCCESS;
+}
@@ -235,7 +235,7 @@ void ActionHandler::operator()(FollowHyperlink)
     };
     if (terminal().screen().contains(currentMousePosition))
     {
-        if (auto hyperlink = terminal().screen().at(currentMousePositionRel).hyperlink(); hyperlink != nullptr)
+        if (auto const* hyperlink = terminal().screen().hyperlinkAt(currentMousePositionRel); hyperlink != nullptr)
         {
             followHyperlink(*hyperlink);
             return;
@@ -284,8 +284,7 @@ void ActionHandler::operator()(PasteClipboard)
 {
     if (QClipboard* clipboard = QGuiApplication::clipboard(); clipboard != nullptr)
     {
-        string const text = clipboard->text(QClipboard::Clipboard).toUtf8().toStdString();
-        terminal().sendPaste(string_view{text});
+        terminal().sendPaste(clipboard->text(QClipboard::Clipboard).toUtf8().toStdString());
     }
 }
 
@@ -293,8 +292,7 @@ void ActionHandler::operator()(PasteSelection)
 {
     if (QClipboard* clipboard = QGuiApplication::clipboard(); clipboard != nullptr)
     {
-        string const text = clipboard->text(QClipboard::Selection).toUtf8().toStdString();
-        terminal().sendPaste(string_view{text});
+        terminal().sendPaste(clipboard->text(QClipboard::Selection).toUtf8().toStdString());
     }
 }
 
@@ -325,10 +323,12 @@ void ActionHandler::operator()(ResetFontSize)
 
 void ActionHandler::operator()(ScreenshotVT)
 {
-    auto _l = lock_guard{ terminal() };
-    auto const screenshot = terminal().screen().screenshot();
+    auto const screenshot = [&]() {
+        auto _l = lock_guard{ terminal() };
+        return terminal().screen().captureScreenshot();
+    }();
     ofstream ofs{ "screenshot.vt", ios::trunc | ios::binary };
-    ofs << screenshot;
+    terminal::writeScreenshot(screenshot, [&](string_view _chunk) { ofs.write(_chunk.data(), static_cast<streamsize>(_chunk.size())); });
 }
 
 void ActionHandler::operator()(ScrollDown)
@@ -924,6 +924,7 @@ void ActionHandler::doDumpState()
             auto const saveScreenshot = atlasScreenshotSaver(allocator->name(), atlasID.value, info.buffer, info.size);
             switch (info.format)
             {
+                case terminal::renderer::atlas::Format::CompressedRGBA: // never read back as such
                 case terminal::renderer::atlas::Format::RGBA:
                     saveScreenshot(ImageBufferFormat::RGBA);
                     break;
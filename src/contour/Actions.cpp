@@ -54,6 +54,11 @@ optional<Action> fromString(string const& _name)
         mapAction<actions::CopySelection>("CopySelection"),
         mapAction<actions::DecreaseFontSize>("DecreaseFontSize"),
         mapAction<actions::DecreaseOpacity>("DecreaseOpacity"),
+        mapAction<actions::DumpAllocationStats>("DumpAllocationStats"),
+        mapAction<actions::DumpLatencyStats>("DumpLatencyStats"),
+        mapAction<actions::DumpMemoryUsage>("DumpMemoryUsage"),
+        mapAction<actions::DumpRenderStats>("DumpRenderStats"),
+        mapAction<actions::DumpVTMetrics>("DumpVTMetrics"),
         mapAction<actions::IncreaseFontSize>("IncreaseFontSize"),
         mapAction<actions::IncreaseOpacity>("IncreaseOpacity"),
         mapAction<actions::NewTerminal>("NewTerminal"),
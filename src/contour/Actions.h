@@ -29,6 +29,11 @@ struct IncreaseFontSize{};
 struct DecreaseFontSize{};
 struct IncreaseOpacity{};
 struct DecreaseOpacity{};
+struct DumpAllocationStats{};
+struct DumpLatencyStats{};
+struct DumpMemoryUsage{};
+struct DumpRenderStats{};
+struct DumpVTMetrics{};
 struct SendChars{ std::string chars; };
 struct WriteScreen{ std::string chars; }; // "\033[2J\033[3J"
 struct ScrollOneUp{};
@@ -70,6 +75,11 @@ using Action = std::variant<
     DecreaseFontSize,
     IncreaseOpacity,
     DecreaseOpacity,
+    DumpAllocationStats,
+    DumpLatencyStats,
+    DumpMemoryUsage,
+    DumpRenderStats,
+    DumpVTMetrics,
     SendChars,
     WriteScreen,
     ScrollOneUp,
@@ -118,6 +128,11 @@ DECLARE_ACTION_FMT(CopyPreviousMarkRange);
 DECLARE_ACTION_FMT(CopySelection);
 DECLARE_ACTION_FMT(DecreaseFontSize);
 DECLARE_ACTION_FMT(DecreaseOpacity);
+DECLARE_ACTION_FMT(DumpAllocationStats);
+DECLARE_ACTION_FMT(DumpLatencyStats);
+DECLARE_ACTION_FMT(DumpMemoryUsage);
+DECLARE_ACTION_FMT(DumpRenderStats);
+DECLARE_ACTION_FMT(DumpVTMetrics);
 DECLARE_ACTION_FMT(FollowHyperlink);
 DECLARE_ACTION_FMT(IncreaseFontSize);
 DECLARE_ACTION_FMT(IncreaseOpacity);
@@ -169,6 +184,11 @@ namespace fmt {
             HANDLE_ACTION(CopySelection);
             HANDLE_ACTION(DecreaseFontSize);
             HANDLE_ACTION(DecreaseOpacity);
+            HANDLE_ACTION(DumpAllocationStats);
+            HANDLE_ACTION(DumpLatencyStats);
+            HANDLE_ACTION(DumpMemoryUsage);
+            HANDLE_ACTION(DumpRenderStats);
+            HANDLE_ACTION(DumpVTMetrics);
             HANDLE_ACTION(FollowHyperlink);
             HANDLE_ACTION(IncreaseFontSize);
             HANDLE_ACTION(IncreaseOpacity);
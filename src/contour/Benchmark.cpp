@@ -0,0 +1,658 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <contour/Benchmark.h>
+
+#include <terminal/Terminal.h>
+#include <terminal/pty/PtyRecording.h>
+
+#include <terminal_renderer/Renderer.h>
+#include <terminal_renderer/RenderTarget.h>
+
+#include <text_shaper/directwrite_shaper.h>
+#include <text_shaper/open_shaper.h>
+
+#include <crispy/allocation_counter.h>
+#include <crispy/latency_histogram.h>
+#include <crispy/memory_usage.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <utility>
+
+// {{{ allocation counting
+#if defined(CONTOUR_BENCH_ALLOCATIONS)
+// Replaces the global allocation functions, so that the benchmark and the allocation statistics
+// can report allocations, see crispy::allocations.
+// Array and nothrow variants are implemented in terms of these by the standard library.
+void* operator new(std::size_t _size)
+{
+    crispy::allocations::record(_size);
+    if (void* p = std::malloc(_size ? _size : 1); p != nullptr)
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* _p) noexcept
+{
+    std::free(_p);
+}
+
+void operator delete(void* _p, std::size_t) noexcept
+{
+    std::free(_p);
+}
+#endif
+// }}}
+
+using crispy::Size;
+using crispy::latency_histogram;
+
+using std::array;
+using std::nullopt;
+using std::optional;
+using std::pair;
+using std::string;
+using std::string_view;
+using std::vector;
+
+using namespace std::chrono;
+
+namespace contour {
+
+namespace // {{{ helper
+{
+    namespace atlas = terminal::renderer::atlas;
+
+    // {{{ workloads
+    // All workloads are generated by the very same pseudo random number generator,
+    // which, unlike the distributions, is fully specified by the standard.
+    using Random = std::minstd_rand;
+
+    void appendUtf8(string& _out, char32_t _codepoint)
+    {
+        if (_codepoint < 0x80)
+            _out += static_cast<char>(_codepoint);
+        else if (_codepoint < 0x800)
+        {
+            _out += static_cast<char>(0xC0 | (_codepoint >> 6));
+            _out += static_cast<char>(0x80 | (_codepoint & 0x3F));
+        }
+        else if (_codepoint < 0x10000)
+        {
+            _out += static_cast<char>(0xE0 | (_codepoint >> 12));
+            _out += static_cast<char>(0x80 | ((_codepoint >> 6) & 0x3F));
+            _out += static_cast<char>(0x80 | (_codepoint & 0x3F));
+        }
+        else
+        {
+            _out += static_cast<char>(0xF0 | (_codepoint >> 18));
+            _out += static_cast<char>(0x80 | ((_codepoint >> 12) & 0x3F));
+            _out += static_cast<char>(0x80 | ((_codepoint >> 6) & 0x3F));
+            _out += static_cast<char>(0x80 | (_codepoint & 0x3F));
+        }
+    }
+
+    void appendWord(string& _out, Random& _random)
+    {
+        auto const length = 1 + _random() % 10;
+        for (unsigned i = 0; i < length; ++i)
+            _out += static_cast<char>('a' + _random() % 26);
+    }
+
+    /// Plain text lines of varying length, some of them wrapping, like `cat` of a source file.
+    string asciiWorkload(size_t _size, Size _pageSize)
+    {
+        auto random = Random{1};
+        auto out = string{};
+        out.reserve(_size + 256);
+        while (out.size() < _size)
+        {
+            auto const lineLength = random() % static_cast<unsigned>(_pageSize.width * 3 / 2 + 1);
+            for (auto column = 0u; column < lineLength; ++column)
+                out += static_cast<char>(' ' + random() % 95);
+            out += "\r\n";
+        }
+        return out;
+    }
+
+    /// Words in changing colors and attributes, like colored compiler or `ls` output.
+    string sgrWorkload(size_t _size, Size _pageSize)
+    {
+        auto random = Random{2};
+        auto out = string{};
+        out.reserve(_size + 256);
+        while (out.size() < _size)
+        {
+            for (auto column = 0; column < _pageSize.width; column += 8)
+            {
+                switch (random() % 3)
+                {
+                    case 0: out += fmt::format("\033[38;5;{}m", random() % 256); break;
+                    case 1: out += fmt::format("\033[1;38;2;{};{};{}m", random() % 256, random() % 256, random() % 256); break;
+                    case 2: out += fmt::format("\033[4;48;5;{}m", random() % 256); break;
+                }
+                appendWord(out, random);
+                out += "\033[m ";
+            }
+            out += "\r\n";
+        }
+        return out;
+    }
+
+    /// Wide, combined and emoji characters, mixed with latin text.
+    string unicodeWorkload(size_t _size, Size _pageSize)
+    {
+        auto random = Random{3};
+        auto out = string{};
+        out.reserve(_size + 256);
+        while (out.size() < _size)
+        {
+            for (auto column = 0; column < _pageSize.width; column += 2)
+            {
+                switch (random() % 4)
+                {
+                    case 0: appendUtf8(out, 0x4E00 + random() % 0x5000); break; // CJK
+                    case 1: appendUtf8(out, 'a' + random() % 26); appendUtf8(out, 0x0301); break; // combining acute
+                    case 2: appendUtf8(out, 0x1F600 + random() % 0x50); break; // emoticons
+                    case 3: appendUtf8(out, 0x03B1 + random() % 24); out += ' '; break; // greek
+                }
+            }
+            out += "\r\n";
+        }
+        return out;
+    }
+
+    /// Text written at random positions with occasional clears, like a full screen application.
+    string cursorWorkload(size_t _size, Size _pageSize)
+    {
+        auto random = Random{4};
+        auto out = string{};
+        out.reserve(_size + 256);
+        auto const updatesPerScreen = static_cast<unsigned>(_pageSize.width * _pageSize.height / 8 + 1);
+        for (auto updates = 0u; out.size() < _size; ++updates)
+        {
+            if (updates % updatesPerScreen == 0)
+                out += "\033[H\033[2J";
+            out += fmt::format("\033[{};{}H", 1 + random() % _pageSize.height, 1 + random() % _pageSize.width);
+            if (random() % 4 == 0)
+                out += "\033[K";
+            appendWord(out, random);
+        }
+        return out;
+    }
+
+    /// Short lines scrolling by as fast as possible, like `seq`.
+    string seqWorkload(size_t _size, Size /*_pageSize*/)
+    {
+        auto out = string{};
+        out.reserve(_size + 32);
+        for (auto i = 1; out.size() < _size; ++i)
+        {
+            out += std::to_string(i);
+            out += "\r\n";
+        }
+        return out;
+    }
+
+    using WorkloadGenerator = string(*)(size_t, Size);
+
+    struct BuiltinWorkload {
+        string_view name;
+        WorkloadGenerator generate;
+    };
+
+    constexpr BuiltinWorkload BuiltinWorkloads[] = {
+        { "ascii", &asciiWorkload },
+        { "sgr", &sgrWorkload },
+        { "unicode", &unicodeWorkload },
+        { "cursor", &cursorWorkload },
+        { "seq", &seqWorkload },
+    };
+
+    optional<string> loadWorkload(string const& _name, size_t _size, Size _pageSize)
+    {
+        for (auto const& workload: BuiltinWorkloads)
+            if (workload.name == _name)
+                return workload.generate(_size, _pageSize);
+
+        auto in = std::ifstream(_name, std::ios::binary);
+        if (!in.good())
+            return nullopt;
+        return string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    // }}}
+
+    // {{{ render target
+    /// Atlas backend merely handing out atlas IDs.
+    struct NullAtlasBackend : public atlas::AtlasBackend {
+        atlas::AtlasID createAtlas(Size /*_size*/, atlas::Format /*_format*/, int /*_user*/) override
+        {
+            return atlas::AtlasID{nextAtlasID++};
+        }
+
+        void uploadTexture(atlas::UploadTexture /*_texture*/) override {}
+        void renderTexture(atlas::RenderTexture /*_texture*/) override {}
+        void destroyAtlas(atlas::AtlasID /*_atlasID*/) override {}
+
+        int nextAtlasID = 0;
+    };
+
+    /// Render target discarding all draw calls, so that everything up to the GPU
+    /// (including text shaping and glyph rasterization) can be measured without a display.
+    class NullRenderTarget : public terminal::renderer::RenderTarget {
+      public:
+        NullRenderTarget() :
+            monochromeAtlasAllocator_{backend_, Size{1024, 1024}, 24, atlas::Format::Red, 0, "monochromeAtlas"},
+            coloredAtlasAllocator_{backend_, Size{2048, 2048}, 24, atlas::Format::RGBA, 1, "colorAtlas"},
+            lcdAtlasAllocator_{backend_, Size{2048, 2048}, 24, atlas::Format::RGB, 2, "lcdAtlas"}
+        {}
+
+        void setRenderSize(Size /*_size*/) override {}
+        void setMargin(terminal::renderer::PageMargin /*_margin*/) override {}
+
+        atlas::TextureAtlasAllocator& monochromeAtlasAllocator() noexcept override { return monochromeAtlasAllocator_; }
+        atlas::TextureAtlasAllocator& coloredAtlasAllocator() noexcept override { return coloredAtlasAllocator_; }
+        atlas::TextureAtlasAllocator& lcdAtlasAllocator() noexcept override { return lcdAtlasAllocator_; }
+
+        atlas::AtlasBackend& textureScheduler() override { return backend_; }
+
+        void renderRectangle(int, int, int, int, float, float, float, float) override {}
+        void renderDecoration(terminal::renderer::Decorator, int, int, int,
+                              terminal::renderer::GridMetrics const&, terminal::RGBColor const&) override {}
+        void setDamagedArea(std::optional<terminal::renderer::DamagedArea> /*_area*/) override {}
+        bool scrollArea(terminal::renderer::DamagedArea const& /*_area*/, int /*_offset*/) override { return true; }
+        bool setDistanceFieldGlyphs(bool /*_enabled*/) override { return false; }
+        bool supportsCellGrid() const noexcept override { return false; }
+        void renderGrid(terminal::renderer::GridMetrics const& /*_gridMetrics*/,
+                        int /*_firstRow*/,
+                        int /*_lastRow*/,
+                        std::vector<terminal::renderer::GridCell> const& /*_cells*/) override {}
+        void setPalette(terminal::RenderPalette const& /*_palette*/) override {}
+        void scheduleScreenshot(ScreenshotCallback /*_callback*/) override {}
+        bool screenshotsPending() const noexcept override { return false; }
+        void execute() override {}
+        bool uploadsPending() const noexcept override { return false; }
+        std::string renderStats() const override { return {}; }
+        void collectMemoryUsage(crispy::memory_usage& /*_usage*/) const override {}
+        void clearCache() override {}
+        void trimMemory() override {}
+
+        optional<terminal::renderer::AtlasTextureInfo> readAtlas(atlas::TextureAtlasAllocator const&, atlas::AtlasID) override
+        {
+            return nullopt;
+        }
+
+      private:
+        NullAtlasBackend backend_;
+        atlas::TextureAtlasAllocator monochromeAtlasAllocator_;
+        atlas::TextureAtlasAllocator coloredAtlasAllocator_;
+        atlas::TextureAtlasAllocator lcdAtlasAllocator_;
+    };
+    // }}}
+
+    // {{{ results
+    struct Stage {
+        latency_histogram latencies;
+        steady_clock::duration total{};
+
+        template <typename F>
+        void measure(F&& _f)
+        {
+            auto const start = steady_clock::now();
+            _f();
+            auto const elapsed = steady_clock::now() - start;
+            latencies.record(elapsed);
+            total += elapsed;
+        }
+    };
+
+    string jsonString(string_view _value)
+    {
+        auto out = string{"\""};
+        for (char const ch: _value)
+        {
+            if (ch == '"' || ch == '\\')
+                out += fmt::format("\\{}", ch);
+            else if (static_cast<unsigned char>(ch) < 0x20)
+                out += fmt::format("\\u{:04x}", static_cast<unsigned>(ch));
+            else
+                out += ch;
+        }
+        out += '"';
+        return out;
+    }
+
+    string jsonStage(Stage const& _stage)
+    {
+        return fmt::format(
+            "{{ \"count\": {}, \"total_ms\": {:.3f}, \"p50_us\": {}, \"p99_us\": {}, \"max_us\": {} }}",
+            _stage.latencies.count(),
+            duration<double, std::milli>(_stage.total).count(),
+            _stage.latencies.percentile(50).count(),
+            _stage.latencies.percentile(99).count(),
+            _stage.latencies.max().count()
+        );
+    }
+    // }}}
+
+    /// Runs a single workload, returning its JSON results.
+    string runWorkload(string const& _name,
+                       terminal::PtyRecording _recording,
+                       BenchmarkSettings const& _settings,
+                       config::Config const& _config,
+                       config::TerminalProfile const& _profile)
+    {
+        auto const pageSize = _profile.terminalSize;
+        auto const refreshRate = _profile.refreshRate > 0.0 ? _profile.refreshRate : 60.0;
+        auto const frameInterval = duration_cast<steady_clock::duration>(duration<double>(1.0 / refreshRate));
+
+        auto const bytes = _recording.outputSize();
+        auto pty = terminal::PtyReplay{
+            pageSize,
+            std::move(_recording),
+            _settings.realtime ? terminal::PtyReplay::Speed::Original : terminal::PtyReplay::Speed::Unlimited
+        };
+        auto events = terminal::Terminal::Events{};
+        auto vt = terminal::Terminal{
+            pty,
+            _config.ptyReadBufferSize,
+            events,
+            _profile.maxHistoryLineCount.has_value()
+                ? optional<size_t>(static_cast<size_t>(*_profile.maxHistoryLineCount))
+                : nullopt,
+            _profile.cursorBlinkInterval,
+            steady_clock::now(),
+            _config.wordDelimiters,
+            _config.bypassMouseProtocolModifier,
+            {800, 600},     // maxImageSize
+            256,            // maxImageColorRegisters
+            true,           // sixelCursorConformance
+            _profile.colors,
+            refreshRate
+        };
+
+        auto readBufferSettings = terminal::Terminal::ReadBufferSettings{};
+        readBufferSettings.maxSize = _config.readBuffer.maxSize;
+        readBufferSettings.coalesce = _config.readBuffer.coalesce;
+        readBufferSettings.coalesceTimeBudget = microseconds(_config.readBuffer.coalesceTimeBudget);
+        vt.setReadBufferSettings(readBufferSettings);
+
+        auto throughputModeSettings = terminal::Terminal::ThroughputModeSettings{};
+        throughputModeSettings.enabled = _config.throughputMode.enabled;
+        throughputModeSettings.bytesPerFrame = _config.throughputMode.bytesPerFrame;
+        throughputModeSettings.sustainedFrames = _config.throughputMode.sustainedFrames;
+        vt.setThroughputModeSettings(throughputModeSettings);
+
+        auto renderTarget = std::unique_ptr<NullRenderTarget>{};
+        auto renderer = std::unique_ptr<terminal::renderer::Renderer>{};
+        if (_settings.render)
+        {
+            auto fonts = _profile.fonts;
+            if (fonts.dpi.x == 0 || fonts.dpi.y == 0)
+                fonts.dpi = crispy::Point{96, 96};
+            renderTarget = std::make_unique<NullRenderTarget>();
+            renderer = std::make_unique<terminal::renderer::Renderer>(
+                pageSize,
+                fonts,
+                vt.screen().colorPalette(),
+                _profile.backgroundOpacity,
+                _profile.hyperlinkDecoration.normal,
+                _profile.hyperlinkDecoration.hover
+            );
+            renderer->setRenderTarget(*renderTarget);
+            renderer->setRenderSize(pageSize * renderer->cellSize());
+        }
+
+        pty.setResizeHandler([&](Size _cells, optional<Size> _pixels) {
+            vt.resizeScreen(_cells, _pixels);
+            if (renderer)
+            {
+                renderer->setScreenSize(_cells);
+                renderer->setRenderSize(_cells * renderer->cellSize());
+            }
+        });
+
+        auto parse = Stage{};
+        auto renderBuffer = Stage{};
+        auto render = Stage{};
+        auto frameCount = uint64_t{0};
+
+        auto const renderFrame = [&](steady_clock::time_point _now) {
+            renderBuffer.measure([&]() { vt.refreshRenderBuffer(_now); });
+            if (renderer)
+                render.measure([&]() { renderer->render(vt, _now, steady_clock::time_point{}); });
+            ++frameCount;
+        };
+
+        auto const allocationsBefore = crispy::allocations::this_thread();
+        auto const start = steady_clock::now();
+        auto lastFrame = start;
+
+        // Frames are rendered at the profile's refresh rate while the output is being parsed,
+        // just like a display would do, followed by a final one showing all of it.
+        while (!pty.drained())
+        {
+            parse.measure([&]() { vt.processInputOnce(); });
+            if (auto const now = steady_clock::now(); now - lastFrame >= frameInterval)
+            {
+                renderFrame(now);
+                lastFrame = now;
+            }
+        }
+        renderFrame(steady_clock::now());
+
+        auto const elapsed = duration<double>(steady_clock::now() - start).count();
+        auto const allocations = crispy::allocations::this_thread() - allocationsBefore;
+
+        auto memoryUsage = crispy::memory_usage{};
+        {
+            auto const _l = std::scoped_lock{vt};
+            vt.collectMemoryUsage(memoryUsage);
+        }
+        if (renderer)
+            renderer->collectMemoryUsage(memoryUsage);
+
+        auto out = string{};
+        out += fmt::format("    {{\n");
+        out += fmt::format("      \"name\": {},\n", jsonString(_name));
+        out += fmt::format("      \"bytes\": {},\n", bytes);
+        out += fmt::format("      \"seconds\": {:.6f},\n", elapsed);
+        out += fmt::format("      \"mib_per_second\": {:.3f},\n",
+                           elapsed > 0.0 ? static_cast<double>(bytes) / (1024.0 * 1024.0) / elapsed : 0.0);
+        out += fmt::format("      \"frames\": {},\n", frameCount);
+        if (crispy::allocations::counting())
+            out += fmt::format("      \"allocations\": {{ \"count\": {}, \"bytes\": {} }},\n",
+                               allocations.count,
+                               allocations.bytes);
+        else
+            out += fmt::format("      \"allocations\": null,\n");
+        out += fmt::format("      \"allocation_phases\": {},\n", vt.allocationTrace().json());
+        out += fmt::format("      \"stages\": {{\n");
+        out += fmt::format("        \"parse\": {},\n", jsonStage(parse));
+        out += fmt::format("        \"render_buffer\": {}", jsonStage(renderBuffer));
+        if (renderer)
+            out += fmt::format(",\n        \"render\": {}", jsonStage(render));
+        out += fmt::format("\n      }},\n");
+        out += fmt::format("      \"memory\": {}\n", memoryUsage.json());
+        out += fmt::format("    }}");
+        return out;
+    }
+
+    // {{{ rasterization
+    constexpr text::render_mode RasterizationModes[] = {
+        text::render_mode::bitmap,
+        text::render_mode::gray,
+        text::render_mode::light,
+        text::render_mode::lcd,
+        text::render_mode::color,
+        text::render_mode::sdf,
+    };
+
+    /// Number of times each glyph is rasterized per render mode.
+    constexpr int RasterizationRounds = 16;
+
+    /// Rasterizes the printable US-ASCII glyphs of the regular font and the emoticons of the
+    /// emoji font in each render mode, returning the JSON results of each font and render mode.
+    vector<string> runRasterization(config::TerminalProfile const& _profile)
+    {
+        auto fonts = _profile.fonts;
+        if (fonts.dpi.x == 0 || fonts.dpi.y == 0)
+            fonts.dpi = crispy::Point{96, 96};
+
+        #if defined(_WIN32)
+        auto shaper = std::make_unique<text::directwrite_shaper>(fonts.dpi);
+        #else
+        auto shaper = std::make_unique<text::open_shaper>(fonts.dpi);
+        #endif
+
+        auto const glyphsOf = [&](text::font_description const& _font, char32_t _first, char32_t _last) {
+            auto glyphs = vector<text::glyph_key>{};
+            auto const font = shaper->load_font(_font, fonts.size);
+            if (!font.has_value())
+                return glyphs;
+            for (auto codepoint = _first; codepoint <= _last; ++codepoint)
+                if (auto const glyphPosition = shaper->shape(*font, codepoint); glyphPosition.has_value())
+                    glyphs.push_back(glyphPosition->glyph);
+            return glyphs;
+        };
+
+        auto const samples = array{
+            pair{string_view{"regular"}, glyphsOf(fonts.regular, 0x20, 0x7E)},
+            pair{string_view{"emoji"}, glyphsOf(fonts.emoji, 0x1F600, 0x1F64F)},
+        };
+
+        auto results = vector<string>{};
+        for (auto const& [fontName, glyphs]: samples)
+        {
+            for (auto const mode: RasterizationModes)
+            {
+                auto rasterize = Stage{};
+                auto bytes = size_t{0};
+                for (auto round = 0; round < RasterizationRounds; ++round)
+                    for (auto const& glyph: glyphs)
+                        rasterize.measure([&]() {
+                            if (auto const bitmap = shaper->rasterize(glyph, mode); bitmap.has_value())
+                                bytes += bitmap->bitmap.size();
+                        });
+
+                auto const seconds = duration<double>(rasterize.total).count();
+                results.emplace_back(fmt::format(
+                    "    {{ \"font\": {}, \"render_mode\": {}, \"glyphs\": {}, \"bytes\": {}, "
+                    "\"glyphs_per_second\": {:.0f}, \"rasterize\": {} }}",
+                    jsonString(fontName),
+                    jsonString(fmt::format("{}", mode)),
+                    glyphs.size(),
+                    bytes,
+                    seconds > 0.0 ? static_cast<double>(rasterize.latencies.count()) / seconds : 0.0,
+                    jsonStage(rasterize)));
+            }
+        }
+        return results;
+    }
+    // }}}
+} // }}}
+
+vector<string> builtinWorkloads()
+{
+    auto names = vector<string>{};
+    for (auto const& workload: BuiltinWorkloads)
+        names.emplace_back(workload.name);
+    return names;
+}
+
+bool runBenchmark(BenchmarkSettings const& _settings,
+                  config::Config const& _config,
+                  config::TerminalProfile const& _profile,
+                  std::ostream& _output)
+{
+    auto results = vector<string>{};
+    for (auto const& name: _settings.workloads)
+    {
+        auto output = loadWorkload(name, _settings.workloadSize, _profile.terminalSize);
+        if (!output)
+        {
+            std::cerr << fmt::format("Unknown workload or unreadable file: {}\n", name);
+            return false;
+        }
+
+        auto recording = terminal::PtyRecording::isRecording(*output)
+                       ? terminal::PtyRecording::parse(*output)
+                       : terminal::PtyRecording::fromOutput(std::move(*output));
+        if (!recording)
+        {
+            std::cerr << fmt::format("Invalid PTY recording: {}\n", name);
+            return false;
+        }
+
+        try
+        {
+            results.emplace_back(runWorkload(name, std::move(*recording), _settings, _config, _profile));
+        }
+        catch (std::exception const& e)
+        {
+            std::cerr << fmt::format("Running workload {} failed. {}\n", name, e.what());
+            return false;
+        }
+    }
+
+    auto rasterization = vector<string>{};
+    if (_settings.rasterize)
+    {
+        try
+        {
+            rasterization = runRasterization(_profile);
+        }
+        catch (std::exception const& e)
+        {
+            std::cerr << fmt::format("Measuring glyph rasterization failed. {}\n", e.what());
+            return false;
+        }
+    }
+
+    _output << "{\n";
+    _output << fmt::format("  \"version\": {},\n", jsonString(CONTOUR_VERSION_STRING));
+    _output << fmt::format("  \"page_size\": {{ \"columns\": {}, \"lines\": {} }},\n",
+                           _profile.terminalSize.width, _profile.terminalSize.height);
+    _output << fmt::format("  \"pty_read_buffer_size\": {},\n", _config.ptyReadBufferSize);
+    _output << fmt::format("  \"render\": {},\n", _settings.render);
+    _output << fmt::format("  \"realtime\": {},\n", _settings.realtime);
+    _output << "  \"workloads\": [\n";
+    for (size_t i = 0; i < results.size(); ++i)
+        _output << results[i] << (i + 1 < results.size() ? ",\n" : "\n");
+    _output << "  ]";
+    if (_settings.rasterize)
+    {
+        _output << ",\n  \"rasterization\": [\n";
+        for (size_t i = 0; i < rasterization.size(); ++i)
+            _output << rasterization[i] << (i + 1 < rasterization.size() ? ",\n" : "\n");
+        _output << "  ]";
+    }
+    _output << "\n}\n";
+    return true;
+}
+
+}
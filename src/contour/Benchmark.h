@@ -0,0 +1,57 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <contour/Config.h>
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace contour {
+
+struct BenchmarkSettings
+{
+    /// Names of built-in workloads (see builtinWorkloads()), or paths of files to replay,
+    /// either PTY recordings (see terminal::PtyRecording) or raw output replayed verbatim.
+    std::vector<std::string> workloads;
+    /// Whether PTY recordings are replayed at the speed they were recorded with,
+    /// rather than as fast as possible.
+    bool realtime = false;
+    /// Number of bytes each built-in workload generates.
+    size_t workloadSize = 16 * 1024 * 1024;
+    /// Whether frames are also rendered, through a RenderTarget discarding the draw calls.
+    bool render = false;
+    /// Whether glyph rasterization throughput of the profile's fonts is measured, per render mode.
+    bool rasterize = false;
+};
+
+/// @returns the names of all built-in workloads.
+std::vector<std::string> builtinWorkloads();
+
+/// Runs each workload through a terminal over a mock PTY, without any GUI,
+/// writing throughput, allocations and per-stage timings as JSON into @p _output.
+/// If requested, glyph rasterization is measured as well, separately from any workload.
+///
+/// The terminal is configured from the given @p _config and @p _profile, as it would be
+/// for a terminal session. Built-in workloads are generated deterministically,
+/// so that results are comparable across builds, configurations and machines.
+///
+/// @returns whether all workloads could be run.
+bool runBenchmark(BenchmarkSettings const& _settings,
+                  config::Config const& _config,
+                  config::TerminalProfile const& _profile,
+                  std::ostream& _output);
+
+}
@@ -44,7 +44,6 @@
 #endif
 
 using std::cerr;
-using std::copy_n;
 using std::cout;
 using std::make_unique;
 using std::nullopt;
@@ -231,14 +230,58 @@ namespace
     auto constexpr ReplyPrefix = "\033]314;"sv; // DCS 314 ;
     auto constexpr ReplySuffix = "\033\\"sv;    // ST
 
-    // Reads a *single* response chunk.
-    bool readCaptureChunk(TTY& _input, timeval* _timeout, string& _reply)
+    /// Reads the capture, replied in fragments of `OSC 314 ; <text> ST` followed by an empty one
+    /// marking the end, writing the text of each fragment to @p _output as soon as it is received.
+    bool readCapture(TTY& _input, timeval const& _timeout, ostream& _output, int _verbosityLevel)
     {
-        timeval timeout = *_timeout;
-        // Response is of format: OSC 314 ; <screen capture> ST`
-        long long int n = 0;
+        auto constexpr ProgressInterval = size_t{1024 * 1024};
+
+        auto buffer = string{};
+        auto receivedBytes = size_t{0};
+        auto nextProgress = ProgressInterval;
+
         while (true)
         {
+            // Writes out all fragments received completely so far.
+            auto consumed = size_t{0};
+            while (true)
+            {
+                auto const pending = string_view(buffer).substr(consumed);
+                auto const prefixSize = std::min(pending.size(), ReplyPrefix.size());
+                if (pending.substr(0, prefixSize) != ReplyPrefix.substr(0, prefixSize))
+                {
+                    cerr << "Invalid response from terminal received. Does not start with expected reply prefix.\n";
+                    return false;
+                }
+
+                if (pending.size() < ReplyPrefix.size())
+                    break;
+
+                auto const end = pending.find(ReplySuffix, ReplyPrefix.size());
+                if (end == string_view::npos)
+                    break;
+
+                auto const text = pending.substr(ReplyPrefix.size(), end - ReplyPrefix.size());
+                if (text.empty())
+                {
+                    if (_verbosityLevel > 0)
+                        cerr << fmt::format("Captured {} bytes.\n", receivedBytes);
+                    return true;
+                }
+
+                _output.write(text.data(), static_cast<std::streamsize>(text.size()));
+                receivedBytes += text.size();
+                consumed += end + ReplySuffix.size();
+            }
+            buffer.erase(0, consumed);
+
+            if (_verbosityLevel > 0 && receivedBytes >= nextProgress)
+            {
+                cerr << fmt::format("Captured {} KiB so far.\n", receivedBytes / 1024);
+                nextProgress = receivedBytes + ProgressInterval;
+            }
+
+            auto timeout = _timeout;
             int rv = _input.wait(&timeout);
             if (rv < 0)
             {
@@ -251,7 +294,7 @@ namespace
                 return false;
             }
 
-            char buf[4096];
+            char buf[64 * 1024];
             rv = _input.read(buf, sizeof(buf));
             if (rv < 0)
             {
@@ -259,19 +302,7 @@ namespace
                 return false;
             }
 
-            copy_n(buf, rv, back_inserter(_reply));
-
-            if (n == 0 && !crispy::startsWith(string_view(_reply), ReplyPrefix))
-            {
-                cerr << fmt::format("Invalid response from terminal received. Does not start with expected reply prefix.\n");
-                return false;
-            }
-            n++;
-
-            if (!crispy::endsWith(string_view(_reply), ReplySuffix))
-                continue;
-
-            return true;
+            buffer.append(buf, static_cast<size_t>(rv));
         }
     }
 }
@@ -303,10 +334,6 @@ bool captureScreen(CaptureSettings const& _settings)
                             _settings.lineCount,
                             _settings.outputFile.data());
 
-    // request screen capture
-    string reply;
-    reply.reserve(numColumns * std::max(_settings.lineCount, numLines));
-
     reference_wrapper<ostream> output(cout);
     unique_ptr<ostream> customOutput;
     if (_settings.outputFile != "-"sv)
@@ -320,19 +347,7 @@ bool captureScreen(CaptureSettings const& _settings)
                           _settings.logicalLines ? '1' : '0',
                           _settings.lineCount));
 
-    while (true)
-    {
-        if (!readCaptureChunk(tty, &timeout, reply))
-            return false;
-
-        auto const payload = string_view(reply.data() + ReplyPrefix.size(),
-                                         reply.size() - ReplyPrefix.size() - ReplySuffix.size());
-        if (payload.empty())
-            return true;
-
-        output.get().write(payload.data(), payload.size());
-        reply.clear();
-    }
+    return readCapture(tty, timeout, output.get(), _settings.verbosityLevel);
 }
 
 } // end namespace
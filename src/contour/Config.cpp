@@ -31,6 +31,9 @@
 #include <array>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <utility>
@@ -216,6 +219,30 @@ FileSystem::path configHome()
     return configHome("contour");
 }
 
+/// @returns the directory for persistent caches or an empty path if none could be determined.
+FileSystem::path cacheHome(string const& _programName)
+{
+#if defined(__unix__) || defined(__APPLE__)
+	if (auto const *value = getenv("XDG_CACHE_HOME"); value && *value)
+		return FileSystem::path{value} / _programName;
+	else if (auto const *value = getenv("HOME"); value && *value)
+		return FileSystem::path{value} / ".cache" / _programName;
+#endif
+
+#if defined(_WIN32)
+	DWORD size = GetEnvironmentVariable("LOCALAPPDATA", nullptr, 0);
+	if (size)
+	{
+		std::vector<char> buf;
+		buf.resize(size);
+		GetEnvironmentVariable("LOCALAPPDATA", &buf[0], size);
+		return FileSystem::path{&buf[0]} / _programName / "cache";
+	}
+#endif
+
+	return {};
+}
+
 template <typename T>
 bool softLoadValue(YAML::Node const& _node, string const& _name, T& _store)
 {
@@ -596,6 +623,19 @@ terminal::ColorPalette loadColorScheme(YAML::Node const& _node)
             colors.selectionBackground.reset();
     }
 
+    if (auto def = _node["search_highlight"]; def && def.IsMap())
+    {
+        if (auto fg = def["foreground"]; fg && fg.IsScalar())
+            colors.searchHighlightForeground.emplace(fg.as<string>());
+        else
+            colors.searchHighlightForeground.reset();
+
+        if (auto bg = def["background"]; bg && bg.IsScalar())
+            colors.searchHighlightBackground.emplace(bg.as<string>());
+        else
+            colors.searchHighlightBackground.reset();
+    }
+
     if (auto cursor = _node["cursor"]; cursor && cursor.IsScalar() && !cursor.as<string>().empty())
         colors.cursor = cursor.as<string>();
 
@@ -719,6 +759,7 @@ TerminalProfile loadTerminalProfile(YAML::Node const& _node,
 
     softLoadValue(_node, "maximized", profile.maximized, false);
     softLoadValue(_node, "fullscreen", profile.fullscreen, false);
+    softLoadValue(_node, "predictive_echo", profile.predictiveEcho, false);
 
     if (auto const value = _node["refresh_rate"])
     {
@@ -794,6 +835,7 @@ TerminalProfile loadTerminalProfile(YAML::Node const& _node,
     {
         softLoadPermission(permissions, "capture_buffer", profile.permissions.captureBuffer);
         softLoadPermission(permissions, "change_font", profile.permissions.changeFont);
+        softLoadPermission(permissions, "shared_images", profile.permissions.sharedImages);
     }
 
     if (auto fonts = _node["font"]; fonts)
@@ -855,6 +897,7 @@ TerminalProfile loadTerminalProfile(YAML::Node const& _node,
             pair{"gray"sv, text::render_mode::gray},
             pair{""sv, text::render_mode::gray},
             pair{"monochrome"sv, text::render_mode::bitmap},
+            pair{"sdf"sv, text::render_mode::sdf},
         };
 
         auto const i = crispy::find_if(renderModeMap, [&](auto m) { return m.first == renderModeStr; });
@@ -863,6 +906,13 @@ TerminalProfile loadTerminalProfile(YAML::Node const& _node,
         else
             debuglog(ConfigTag).write("Invalid render_mode \"{}\" in configuration.", renderModeStr);
         debuglog(ConfigTag).write("Using render mode: {}", profile.fonts.renderMode);
+
+        bool glyphCache = true;
+        softLoadValue(fonts, "glyph_cache", glyphCache, true);
+        if (auto const cacheDirectory = cacheHome("contour"); glyphCache && !cacheDirectory.empty())
+            profile.fonts.glyphCacheDirectory = (cacheDirectory / "glyphs").string();
+
+        softLoadValue(fonts, "builtin_box_drawing", profile.fonts.builtinBoxDrawing, true);
     }
 
     if (auto history = _node["history"]; history)
@@ -875,6 +925,32 @@ TerminalProfile loadTerminalProfile(YAML::Node const& _node,
                 profile.maxHistoryLineCount = limit.as<size_t>();
         }
 
+        if (auto compressAfter = history["compress_after"]; compressAfter)
+        {
+            if (compressAfter.as<int>() < 0)
+                profile.historyCompressionThreshold = nullopt;
+            else
+                profile.historyCompressionThreshold = compressAfter.as<int>();
+        }
+
+        if (auto spillAfter = history["spill_after"]; spillAfter)
+        {
+            if (spillAfter.as<int>() < 0)
+                profile.historySpillThreshold = nullopt;
+            else
+                profile.historySpillThreshold = spillAfter.as<int>();
+        }
+
+        softLoadValue(history, "spill_directory", profile.historySpillDirectory);
+
+        if (auto maxMemory = history["max_memory"]; maxMemory)
+        {
+            if (auto const bytes = maxMemory.as<size_t>(); bytes != 0)
+                profile.maxHistoryMemory = bytes;
+            else
+                profile.maxHistoryMemory = nullopt;
+        }
+
         softLoadValue(history, "auto_scroll_on_update", profile.autoScrollOnUpdate);
         softLoadValue(history, "scroll_multiplier", profile.historyScrollMultiplier);
     }
@@ -914,23 +990,22 @@ TerminalProfile loadTerminalProfile(YAML::Node const& _node,
     return profile;
 }
 
-/**
- * @return success or failure of loading the config file.
- */
-void loadConfigFromFile(Config& _config, FileSystem::path const& _fileName)
+/// Loads the configuration from the given YAML document of a config file.
+void loadConfigFromDocument(Config& _config, YAML::Node const& doc)
 {
-    _config.backingFilePath = _fileName;
-    createFileIfNotExists(_config.backingFilePath);
-
-    YAML::Node doc = YAML::LoadFile(_fileName.string());
-
     softLoadValue(doc, "word_delimiters", _config.wordDelimiters);
+    softLoadValue(doc, "sanitize_paste", _config.sanitizePaste);
 
     if (auto opt = parseModifier(doc["bypass_mouse_protocol_modifier"]); opt.has_value())
         _config.bypassMouseProtocolModifier = opt.value();
 
     auto constexpr KnownExperimentalFeatures = array{
-        "tcap"sv
+        "cell_grid"sv,
+        "compressed_color_atlas"sv,
+        "render_thread"sv,
+        "selection_overlay"sv,
+        "tcap"sv,
+        "window_surface"sv
     };
 
     if (auto experimental = doc["experimental"]; experimental.IsMap())
@@ -956,9 +1031,18 @@ void loadConfigFromFile(Config& _config, FileSystem::path const& _fileName)
     {
         softLoadValue(images, "sixel_scrolling", _config.sixelScrolling);
         softLoadValue(images, "sixel_cursor_conformance", _config.sixelCursorConformance);
+        softLoadValue(images, "sixel_progressive", _config.sixelProgressive);
         softLoadValue(images, "sixel_register_count", _config.maxImageColorRegisters);
         softLoadValue(images, "max_width", _config.maxImageSize.width);
         softLoadValue(images, "max_height", _config.maxImageSize.height);
+        softLoadValue(images, "max_memory", _config.maxImageMemory);
+    }
+
+    if (auto metrics = doc["vt_metrics"]; metrics)
+    {
+        softLoadValue(metrics, "export_path", _config.vtMetricsExportPath);
+        if (auto value = metrics["export_interval"]; value)
+            _config.vtMetricsExportInterval = chrono::seconds(max(value.as<int>(), 1));
     }
 
     if (auto scrollbar = doc["scrollbar"]; scrollbar)
@@ -980,6 +1064,34 @@ void loadConfigFromFile(Config& _config, FileSystem::path const& _fileName)
             _config.hideScrollbarInAltScreen = value.as<bool>();
     }
 
+    if (auto triggers = doc["triggers"]; triggers && triggers.IsSequence())
+    {
+        for (auto const& node: triggers)
+        {
+            if (!node["pattern"] || node["pattern"].as<string>().empty())
+            {
+                debuglog(ConfigTag).write("Ignoring trigger without pattern.");
+                continue;
+            }
+
+            auto trigger = terminal::Trigger{};
+            trigger.pattern = node["pattern"].as<string>();
+            if (auto value = node["action"]; value)
+            {
+                auto const literal = toLower(value.as<string>());
+                if (literal == "highlight")
+                    trigger.action = terminal::TriggerAction::Highlight;
+                else if (literal == "mark")
+                    trigger.action = terminal::TriggerAction::Mark;
+                else if (literal == "notify")
+                    trigger.action = terminal::TriggerAction::Notify;
+                else
+                    throw std::runtime_error("Invalid trigger action. Should be one of: highlight, mark, notify.");
+            }
+            _config.triggers.emplace_back(move(trigger));
+        }
+    }
+
     if (auto profiles = doc["color_schemes"]; profiles)
     {
         for (auto i = profiles.begin(); i != profiles.end(); ++i)
@@ -991,6 +1103,56 @@ void loadConfigFromFile(Config& _config, FileSystem::path const& _fileName)
 
     softLoadValue(doc, "read_buffer_size", _config.ptyReadBufferSize);
 
+    if (auto readBuffer = doc["read_buffer"]; readBuffer)
+    {
+        softLoadValue(readBuffer, "max_size", _config.readBuffer.maxSize);
+        softLoadValue(readBuffer, "coalesce", _config.readBuffer.coalesce);
+        softLoadValue(readBuffer, "coalesce_time_budget", _config.readBuffer.coalesceTimeBudget);
+    }
+
+    softLoadValue(doc, "idle_memory_trim_delay", _config.idleMemoryTrimDelay);
+    softLoadValue(doc, "max_history_memory", _config.maxHistoryMemory);
+
+    if (auto throughputMode = doc["throughput_mode"]; throughputMode)
+    {
+        softLoadValue(throughputMode, "enabled", _config.throughputMode.enabled);
+        softLoadValue(throughputMode, "bytes_per_frame", _config.throughputMode.bytesPerFrame);
+        softLoadValue(throughputMode, "sustained_frames", _config.throughputMode.sustainedFrames);
+    }
+
+    softLoadValue(doc, "synchronized_output_timeout", _config.synchronizedOutputTimeout);
+
+    if (auto pipeline = doc["read_pipeline"]; pipeline)
+    {
+        softLoadValue(pipeline, "enabled", _config.readPipeline.enabled);
+        softLoadValue(pipeline, "buffer_size", _config.readPipeline.bufferSize);
+        softLoadValue(pipeline, "high_watermark", _config.readPipeline.highWatermark);
+        softLoadValue(pipeline, "low_watermark", _config.readPipeline.lowWatermark);
+        softLoadValue(pipeline, "shared_reactor", _config.readPipeline.sharedReactor);
+    }
+
+    if (auto scheduler = doc["scheduler"]; scheduler)
+    {
+        softLoadValue(scheduler, "enabled", _config.scheduler.enabled);
+        softLoadValue(scheduler, "time_slice", _config.scheduler.timeSlice);
+        softLoadValue(scheduler, "background_share", _config.scheduler.backgroundShare);
+        softLoadValue(scheduler, "background_refresh_rate", _config.scheduler.backgroundRefreshRate);
+    }
+
+    if (auto framePacing = doc["frame_pacing"]; framePacing)
+    {
+        softLoadValue(framePacing, "enabled", _config.framePacing.enabled);
+        softLoadValue(framePacing, "render_ahead", _config.framePacing.renderAhead);
+    }
+
+    softLoadValue(doc, "session_pool_size", _config.sessionPoolSize);
+
+    if (auto controlSocket = doc["control_socket"]; controlSocket)
+    {
+        softLoadValue(controlSocket, "enabled", _config.controlSocket.enabled);
+        softLoadValue(controlSocket, "name", _config.controlSocket.name);
+    }
+
     if (auto profiles = doc["profiles"]; profiles)
     {
         for (auto i = profiles.begin(); i != profiles.end(); ++i)
@@ -1024,6 +1186,54 @@ void loadConfigFromFile(Config& _config, FileSystem::path const& _fileName)
     logMappings(_config.inputMappings.mouseMappings);
 }
 
+namespace
+{
+    /// A parsed config file, along with the state of the file it has been parsed from.
+    struct ParsedConfigFile {
+        FileSystem::file_time_type lastWriteTime;
+        size_t contentsHash;
+        Config config;
+    };
+
+    // Config files parsed so far, by file name, so that new terminal sessions and
+    // reloads of unchanged config files are spared parsing them again.
+    mutex parsedConfigFilesLock;
+    map<string, ParsedConfigFile> parsedConfigFiles;
+}
+
+/**
+ * @return success or failure of loading the config file.
+ */
+void loadConfigFromFile(Config& _config, FileSystem::path const& _fileName)
+{
+    _config.backingFilePath = _fileName;
+    createFileIfNotExists(_config.backingFilePath);
+
+    auto const lastWriteTime = FileSystem::last_write_time(_fileName);
+    auto ifs = ifstream(_fileName.string(), ios::binary);
+    if (!ifs.good())
+        throw runtime_error{fmt::format("Could not open config file {}.", _fileName.string())};
+    auto const contents = string(istreambuf_iterator<char>(ifs), istreambuf_iterator<char>());
+    auto const contentsHash = hash<string>{}(contents);
+
+    {
+        auto _l = scoped_lock{parsedConfigFilesLock};
+        if (auto i = parsedConfigFiles.find(_fileName.string()); i != parsedConfigFiles.end()
+                && i->second.lastWriteTime == lastWriteTime
+                && i->second.contentsHash == contentsHash)
+        {
+            debuglog(ConfigTag).write("Reusing parsed config file {}.", _fileName.string());
+            _config = i->second.config;
+            return;
+        }
+    }
+
+    loadConfigFromDocument(_config, YAML::Load(contents));
+
+    auto _l = scoped_lock{parsedConfigFilesLock};
+    parsedConfigFiles[_fileName.string()] = ParsedConfigFile{lastWriteTime, contentsHash, _config};
+}
+
 optional<std::string> readConfigFile(std::string const& _filename)
 {
     for (FileSystem::path const& prefix : configHomes("contour"))
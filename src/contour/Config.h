@@ -23,6 +23,7 @@
 #include <terminal/Color.h>
 #include <terminal/Process.h>
 #include <terminal/Sequencer.h>                 // CursorDisplay
+#include <terminal/TriggerEngine.h>
 
 #include <text_shaper/font.h>
 
@@ -69,10 +70,15 @@ struct TerminalProfile {
     bool maximized = false;
     bool fullscreen = false;
     double refreshRate = 0.0; // 0=auto
+    bool predictiveEcho = false; // see terminal::Terminal::setPredictiveEcho()
 
     crispy::Size terminalSize;
 
     std::optional<int> maxHistoryLineCount;
+    std::optional<int> historyCompressionThreshold;
+    std::optional<int> historySpillThreshold;
+    std::string historySpillDirectory;
+    std::optional<size_t> maxHistoryMemory; // in bytes
     int historyScrollMultiplier;
     bool autoScrollOnUpdate;
 
@@ -81,6 +87,7 @@ struct TerminalProfile {
     struct {
         Permission captureBuffer = Permission::Ask;
         Permission changeFont = Permission::Ask;
+        Permission sharedImages = Permission::Ask;
     } permissions;
 
     terminal::ColorPalette colors{};
@@ -111,6 +118,69 @@ struct Config {
     // Changing this value may result in better or worse throughput performance.
     int ptyReadBufferSize = 16384;
 
+    // Adaptive growth of the PTY read buffer and coalescing of PTY reads,
+    // see terminal::Terminal::setReadBufferSettings().
+    struct {
+        size_t maxSize = 1024 * 1024;
+        bool coalesce = false;
+        unsigned coalesceTimeBudget = 2000; // in microseconds
+    } readBuffer;
+
+    // Seconds without any output after which memory held beyond the current needs is given back,
+    // or 0 to never do so, see terminal::Terminal::setIdleMemoryTrimDelay().
+    unsigned idleMemoryTrimDelay = 60;
+
+    // Bytes of memory the history of all terminals may hold together, or 0 for no limit,
+    // see terminal::Grid::setGlobalMaxHistoryBytes().
+    size_t maxHistoryMemory = 0;
+
+    // Only parses while flooded by output, refreshing once per frame,
+    // see terminal::Terminal::setThroughputModeSettings().
+    struct {
+        bool enabled = true;
+        size_t bytesPerFrame = 256 * 1024;
+        int sustainedFrames = 3;
+    } throughputMode;
+
+    // Milliseconds a synchronized output batch (DECSET 2026) may stay open before it is shown anyway,
+    // see terminal::Terminal::setSynchronizedOutputTimeout().
+    unsigned synchronizedOutputTimeout = 1000;
+
+    // Optionally reads the PTY on a dedicated thread ahead of parsing,
+    // see terminal::Terminal::enableInputPipeline().
+    struct {
+        bool enabled = false;
+        size_t bufferSize = 4 * 1024 * 1024;
+        size_t highWatermark = 3 * 1024 * 1024;
+        size_t lowWatermark = 1024 * 1024;
+        bool sharedReactor = true;
+    } readPipeline;
+
+    // Shares the CPU among all terminals in favor of the focused one, see terminal::SessionScheduler.
+    struct {
+        bool enabled = true;
+        unsigned timeSlice = 10;            // in milliseconds
+        unsigned backgroundShare = 25;      // percentage of each time slice
+        double backgroundRefreshRate = 10.0;
+    } scheduler;
+
+    // Starts rendering just in time before the display's vertical blank,
+    // see terminal::renderer::FrameScheduler.
+    struct {
+        bool enabled = false;
+        unsigned renderAhead = 3; // in milliseconds
+    } framePacing;
+
+    // Number of shells to keep started ahead of time in the profile contour has been started with,
+    // for new terminals of that profile to start up instantly, see SessionPool.
+    size_t sessionPoolSize = 0;
+
+    // Local socket serving live performance statistics, see ControlServer.
+    struct {
+        bool enabled = false;
+        std::string name; // "contour-<pid>" if empty
+    } controlSocket;
+
     std::unordered_map<std::string, terminal::ColorPalette> colorschemes;
     std::unordered_map<std::string, TerminalProfile> profiles;
     std::string defaultProfileName;
@@ -136,6 +206,12 @@ struct Config {
     std::string wordDelimiters;
     terminal::Modifier bypassMouseProtocolModifier = terminal::Modifier::Shift;
 
+    // clipboard
+    bool sanitizePaste = false;
+
+    // patterns looked for in the output
+    std::vector<terminal::Trigger> triggers;
+
     // input mapping
     InputMappings inputMappings;
 
@@ -146,9 +222,27 @@ struct Config {
 
     bool sixelScrolling = true;
     bool sixelCursorConformance = true;
+    bool sixelProgressive = true;
     crispy::Size maxImageSize = {1280, 720};
+    size_t maxImageMemory = 256 * 1024 * 1024;
     int maxImageColorRegisters = 4096;
 
+    // VT sequence usage metrics
+    std::string vtMetricsExportPath;
+    std::chrono::seconds vtMetricsExportInterval{60};
+
+    // Path to record the PTY output of the initial terminal to, for replaying it with "contour bench".
+    // Only set from the command line.
+    std::string ptyRecordingPath;
+
+    // Path to save the initial terminal's screen and history to, for restoring them on next start.
+    // Only set from the command line.
+    std::string sessionFilePath;
+
+    // Number of key presses to measure the key-to-photon latency of in the initial terminal,
+    // or 0 to not do so, see LatencyTest. Only set from the command line.
+    unsigned latencyTestSamples = 0;
+
     ScrollBarPosition scrollbarPosition = ScrollBarPosition::Right;
     bool hideScrollbarInAltScreen = true;
 
@@ -11,6 +11,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <contour/Benchmark.h>
 #include <contour/CaptureScreen.h>
 #include <contour/Config.h>
 #include <contour/ContourApp.h>
@@ -24,6 +25,7 @@
 #include <crispy/utils.h>
 
 #include <fstream>
+#include <iostream>
 #include <memory>
 
 using std::bind;
@@ -43,6 +45,7 @@ namespace contour {
 ContourApp::ContourApp() :
     App("contour", "Contour Terminal Emulator", CONTOUR_VERSION_STRING)
 {
+    link("contour.bench", bind(&ContourApp::benchAction, this));
     link("contour.capture", bind(&ContourApp::captureAction, this));
     link("contour.list-debug-tags", bind(&ContourApp::listDebugTagsAction, this));
     link("contour.set.profile", bind(&ContourApp::profileAction, this));
@@ -101,6 +104,36 @@ int ContourApp::terminfoAction()
     return EXIT_SUCCESS;
 }
 
+int ContourApp::benchAction()
+{
+    auto const configPath = parameters().get<string>("contour.bench.config");
+    auto const config = configPath.empty() ? config::loadConfig() : config::loadConfigFromFile(configPath);
+
+    auto profileName = parameters().get<string>("contour.bench.profile");
+    if (profileName.empty())
+        profileName = config.defaultProfileName;
+    auto const* profile = config.profile(profileName);
+    if (!profile)
+    {
+        std::cerr << fmt::format("No such profile: {}\n", profileName);
+        return EXIT_FAILURE;
+    }
+
+    auto settings = BenchmarkSettings{};
+    auto const workloads = parameters().get<string>("contour.bench.workloads");
+    for (auto const workload: crispy::split(workloads, ','))
+        if (!workload.empty())
+            settings.workloads.emplace_back(workload);
+    settings.workloadSize = parameters().get<unsigned>("contour.bench.size") * size_t{1024 * 1024};
+    settings.render = parameters().get<bool>("contour.bench.render");
+    settings.rasterize = parameters().get<bool>("contour.bench.rasterize");
+    settings.realtime = parameters().get<bool>("contour.bench.realtime");
+
+    return withOutput(parameters(), "contour.bench.to", [&](auto& _stream) {
+        return runBenchmark(settings, config, *profile, _stream) ? EXIT_SUCCESS : EXIT_FAILURE;
+    });
+}
+
 int ContourApp::captureAction()
 {
     auto captureSettings = contour::CaptureSettings{};
@@ -199,6 +232,20 @@ crispy::cli::Command ContourApp::parameterDefinition() const
                     }
                 }
             },
+            CLI::Command{
+                "bench",
+                "Runs workloads through a terminal without any GUI, reporting throughput, allocations and timings as JSON.",
+                {
+                    CLI::Option{"workloads", CLI::Value{"ascii,sgr,unicode,cursor,seq"s}, "Comma separated list of workloads to run. Each one is either a built-in workload (ascii, sgr, unicode, cursor, seq) or the path of a file to replay, being either a PTY recording (see contour terminal record) or raw output.", "LIST"},
+                    CLI::Option{"size", CLI::Value{16u}, "Number of mebibytes each built-in workload generates.", "MIB"},
+                    CLI::Option{"render", CLI::Value{false}, "Also renders the frames, discarding the resulting draw calls."},
+                    CLI::Option{"realtime", CLI::Value{false}, "Replays PTY recordings at the speed they were recorded with, rather than as fast as possible."},
+                    CLI::Option{"rasterize", CLI::Value{false}, "Also measures glyph rasterization throughput of the profile's fonts in each render mode."},
+                    CLI::Option{"config", CLI::Value{""s}, "Path to the configuration file to configure the terminal with.", "FILE"},
+                    CLI::Option{"profile", CLI::Value{""s}, "Configuration profile to configure the terminal with.", "NAME"},
+                    CLI::Option{"to", CLI::Value{"-"s}, "Output file name to store the results to. If - (dash) is given, the results will be written to standard output.", "FILE"},
+                }
+            },
             CLI::Command{
                 "capture",
                 "Captures the screen buffer of the currently running terminal.",
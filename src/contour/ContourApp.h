@@ -28,6 +28,7 @@ class ContourApp : public crispy::App
     crispy::cli::Command parameterDefinition() const override;
 
   private:
+    int benchAction();
     int captureAction();
     int listDebugTagsAction();
     int parserTableAction();
@@ -16,18 +16,29 @@
 #if defined(CONTOUR_FRONTEND_GUI)
 #include <contour/Config.h>
 #include <contour/Controller.h>
+#include <contour/helper.h>
 #include <contour/opengl/TerminalWidget.h>
+
+#include <terminal/pty/PtyProcess.h>
 #endif
 
+#include <crispy/trace.h>
+
 #if defined(CONTOUR_FRONTEND_GUI)
 #include <QtWidgets/QApplication>
 #include <QSurfaceFormat>
 #endif
 
+#include <cstdlib>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <optional>
 
 using std::bind;
 using std::cerr;
+using std::getenv;
+using std::move;
 using std::prev;
 using std::string;
 using std::string_view;
@@ -65,8 +76,13 @@ crispy::cli::Command ContourGuiApp::parameterDefinition() const
                 CLI::Option{"config", CLI::Value{contour::config::defaultConfigFilePath()}, "Path to configuration file to load at startup.", "FILE"},
                 CLI::Option{"profile", CLI::Value{""s}, "Terminal Profile to load (overriding config).", "NAME"},
                 CLI::Option{"debug", CLI::Value{""s}, "Enables debug logging, using a comma (,) seperated list of tags.", "TAGS"},
+                CLI::Option{"debug-sync", CLI::Value{false}, "Writes debug log messages right away rather than on a background thread, e.g. to not lose any upon a crash."},
                 CLI::Option{"live-config", CLI::Value{false}, "Enables live config reloading."},
                 CLI::Option{"working-directory", CLI::Value{""s}, "Sets initial working directory (overriding config).", "DIRECTORY"},
+                CLI::Option{"record", CLI::Value{""s}, "Records the output of the initial terminal's PTY along with its size changes to FILE, e.g. for replaying it with contour bench.", "FILE"},
+                CLI::Option{"session", CLI::Value{""s}, "Restores the initial terminal's screen and history from FILE if saved there before, and keeps saving them to FILE while running.", "FILE"},
+                CLI::Option{"measure-latency", CLI::Value{0u}, "Measures the latency from COUNT synthetic key presses to the presentation of their echo, printing its distribution to standard output and exiting. Runs cat to echo the key presses, unless PROGRAM is given.", "COUNT"},
+                CLI::Option{"startup-trace", CLI::Value{""s}, "Writes the time spent in each phase of starting up to FILE as Chrome trace events, or as a table to stderr if FILE is -. Also enabled by the environment variable CONTOUR_STARTUP_TRACE.", "FILE"},
             },
             CLI::CommandList{},
             CLI::CommandSelect::Implicit,
@@ -111,13 +127,23 @@ int terminalGUI(int argc, char const* argv[], CLI::FlagStore const& _flags)
                 });
             }
         }
+
+        if (!_flags.get<bool>("contour.terminal.debug-sync"))
+            crispy::logging_sink::for_debug().set_async(true);
     }
 
+    if (auto startupTrace = _flags.get<string>("contour.terminal.startup-trace"); !startupTrace.empty())
+        startStartupTrace(move(startupTrace));
+    else if (auto const* env = getenv("CONTOUR_STARTUP_TRACE"); env && *env)
+        startStartupTrace(env);
+
     auto const configPath = QString::fromStdString(_flags.get<string>("contour.terminal.config"));
 
-    auto config =
-        configPath.isEmpty() ? contour::config::loadConfig()
-                             : contour::config::loadConfigFromFile(configPath.toStdString());
+    auto config = [&]() {
+        auto const _trace = crispy::trace_scope("config loading");
+        return configPath.isEmpty() ? contour::config::loadConfig()
+                                    : contour::config::loadConfigFromFile(configPath.toStdString());
+    }();
 
     string const profileName = [&]() {
         if (auto profile = _flags.get<string>("contour.terminal.profile"); !profile.empty())
@@ -149,6 +175,10 @@ int terminalGUI(int argc, char const* argv[], CLI::FlagStore const& _flags)
     if (auto const wd = _flags.get<string>("contour.terminal.working-directory"); !wd.empty())
         config.profile(profileName)->shell.workingDirectory = FileSystem::path(wd);
 
+    config.ptyRecordingPath = _flags.get<string>("contour.terminal.record");
+    config.sessionFilePath = _flags.get<string>("contour.terminal.session");
+    config.latencyTestSamples = _flags.get<unsigned>("contour.terminal.measure-latency");
+
     if (configFailures)
         return EXIT_FAILURE;
 
@@ -163,6 +193,28 @@ int terminalGUI(int argc, char const* argv[], CLI::FlagStore const& _flags)
         for (size_t i = 1; i < _flags.verbatim.size(); ++i)
              shell.arguments.push_back(string(_flags.verbatim.at(i)));
     }
+    else if (config.latencyTestSamples != 0)
+    {
+        // Echoed by the PTY's line discipline, the latency is the terminal's alone.
+        auto& shell = config.profile(profileName)->shell;
+        shell.program = "cat";
+        shell.arguments.clear();
+    }
+
+    // The shell is started right away, at the configured size, rather than along with the window,
+    // so that its startup overlaps with that of Qt, the fonts and OpenGL. Its early output waits
+    // in the PTY until the session reads it, and the window's actual size is applied once laid out.
+    auto pty = std::unique_ptr<terminal::Pty>{};
+    try
+    {
+        auto const _trace = crispy::trace_scope("shell spawning");
+        auto const& profile = *config.profile(profileName);
+        pty = std::make_unique<terminal::PtyProcess>(profile.shell, profile.terminalSize);
+    }
+    catch (std::exception const&)
+    {
+        // Attempted again, and reported, when creating the window.
+    }
 
     QCoreApplication::setApplicationName("contour");
     QCoreApplication::setOrganizationName("contour");
@@ -174,11 +226,13 @@ int terminalGUI(int argc, char const* argv[], CLI::FlagStore const& _flags)
     //QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling, true);
     QCoreApplication::setAttribute(Qt::AA_DisableHighDpiScaling);
 
+    auto trace = std::optional<crispy::trace_scope>("Qt initialization");
     QApplication app(argc, (char**) argv);
 
     QSurfaceFormat::setDefaultFormat(contour::opengl::TerminalWidget::surfaceFormat());
+    trace.reset();
 
-    contour::Controller controller(argv[0], config, liveConfig, profileName);
+    contour::Controller controller(argv[0], config, liveConfig, profileName, move(pty));
     controller.start();
 
     // auto const HTS = "\033H";
@@ -0,0 +1,170 @@
+/**
+ * This file is part of the "contour" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <contour/ControlServer.h>
+#include <contour/TerminalSession.h>
+#include <contour/helper.h>
+
+#include <crispy/algorithm.h>
+#include <crispy/debuglog.h>
+#include <crispy/utils.h>
+
+#include <QtCore/QCoreApplication>
+#include <QtNetwork/QLocalSocket>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+
+using namespace std;
+
+namespace contour {
+
+namespace // {{{ helper
+{
+    /// Longest command line accepted, before dropping the client.
+    constexpr qint64 MaxCommandLength = 4096;
+
+    /// Matches a debug log tag name the same way as the --debug command line option,
+    /// i.e. either exactly, or by prefix if the pattern ends with '*'.
+    bool matches(string_view _pattern, string const& _tagName)
+    {
+        if (_pattern.empty())
+            return false;
+        if (_pattern.back() != '*')
+            return _tagName == _pattern;
+        _pattern.remove_suffix(1);
+        return string_view(_tagName).substr(0, _pattern.size()) == _pattern;
+    }
+
+    string traceJson()
+    {
+        auto json = string("{\"tags\": {");
+        auto first = true;
+        for (auto const& tag: crispy::debugtag::store())
+        {
+            json += fmt::format("{}\"{}\": {}", first ? "" : ", ", tag.name, tag.enabled);
+            first = false;
+        }
+        json += "}}";
+        return json;
+    }
+
+    string statsJson()
+    {
+        auto json = fmt::format("{{\"pid\": {}, \"sessions\": [", QCoreApplication::applicationPid());
+        auto first = true;
+        for (TerminalSession* session: TerminalSession::sessions())
+        {
+            if (!first)
+                json += ", ";
+            json += session->statsJson();
+            first = false;
+        }
+        json += "]}";
+        return json;
+    }
+
+    string errorJson(string_view _message)
+    {
+        return fmt::format("{{\"error\": \"{}\"}}", _message);
+    }
+} // }}}
+
+ControlServer::ControlServer(string _name, QObject* _parent):
+    QObject(_parent),
+    server_(this)
+{
+    if (_name.empty())
+        _name = fmt::format("contour-{}", QCoreApplication::applicationPid());
+
+    auto const name = QString::fromStdString(_name);
+
+    // A socket file left behind by a crashed process would have listen() fail.
+    QLocalServer::removeServer(name);
+
+    server_.setSocketOptions(QLocalServer::UserAccessOption);
+    connect(&server_, &QLocalServer::newConnection, this, [this]() { onNewConnection(); });
+
+    if (server_.listen(name))
+        debuglog(WidgetTag).write("Control socket listening on {}.", serverName());
+    else
+        debuglog(WidgetTag).write("Control socket failed to listen on {}. {}",
+                                  _name, server_.errorString().toStdString());
+}
+
+string ControlServer::serverName() const
+{
+    return server_.isListening() ? server_.fullServerName().toStdString() : string();
+}
+
+void ControlServer::onNewConnection()
+{
+    while (QLocalSocket* socket = server_.nextPendingConnection())
+    {
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+        connect(socket, &QLocalSocket::disconnected, socket, &QLocalSocket::deleteLater);
+    }
+}
+
+void ControlServer::onReadyRead(QLocalSocket* _socket)
+{
+    while (_socket->canReadLine())
+    {
+        auto const line = _socket->readLine(MaxCommandLength).trimmed().toStdString();
+        if (line.empty())
+            continue;
+        auto const reply = execute(line) + '\n';
+        _socket->write(reply.data(), static_cast<qint64>(reply.size()));
+    }
+
+    if (_socket->bytesAvailable() > MaxCommandLength)
+    {
+        debuglog(WidgetTag).write("Control socket client sent an overlong command. Disconnecting.");
+        _socket->abort();
+    }
+}
+
+string ControlServer::execute(string_view _command)
+{
+    auto words = crispy::split(_command, ' ');
+    words.erase(remove(words.begin(), words.end(), string_view()), words.end());
+
+    if (words.empty())
+        return errorJson("empty command");
+
+    if (words[0] == "stats" && words.size() == 1)
+        return statsJson();
+
+    if (words[0] == "trace")
+    {
+        if (words.size() == 1)
+            return traceJson();
+
+        if (words.size() >= 3 && (words[1] == "enable" || words[1] == "disable"))
+        {
+            auto const enable = words[1] == "enable";
+            auto const patterns = vector<string_view>(next(words.begin(), 2), words.end());
+            if (enable)
+                crispy::logging_sink::for_debug().enable(true);
+            for (auto& tag: crispy::debugtag::store())
+                if (crispy::any_of(patterns, [&](string_view _pattern) { return matches(_pattern, tag.name); }))
+                    tag.enabled = enable;
+            return traceJson();
+        }
+    }
+
+    return errorJson("unknown command");
+}
+
+} // end namespace
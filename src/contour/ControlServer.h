@@ -0,0 +1,60 @@
+/**
+ * This file is part of the "contour" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <QtCore/QObject>
+#include <QtNetwork/QLocalServer>
+
+#include <string>
+#include <string_view>
+
+class QLocalSocket;
+
+namespace contour {
+
+/// Serves live performance statistics of this process' terminal sessions on a local socket,
+/// i.e. a Unix domain socket or, on Windows, a named pipe, so that they can be monitored
+/// without restarting the sessions with debug logging enabled.
+///
+/// Clients send one command per line, and receive one line of JSON in reply:
+///
+///     stats                       statistics of all sessions, see TerminalSession::statsJson()
+///     trace                       the debug log tags, and whether they are enabled
+///     trace enable PATTERN...     enables the debug log tags matching any pattern, e.g. "vt.*"
+///     trace disable PATTERN...    disables them again
+///
+/// The socket is only accessible by the user running this process.
+class ControlServer: public QObject
+{
+  public:
+    /// @param _name  name of the socket to listen on, "contour-<pid>" if empty.
+    ///               Unless an absolute path, it is placed into the temporary directory.
+    explicit ControlServer(std::string _name, QObject* _parent = nullptr);
+
+    /// @returns the full name of the socket listened on, or an empty string if listening failed.
+    std::string serverName() const;
+
+    /// Executes a single command line, as received from a client.
+    ///
+    /// @returns the JSON reply, without the trailing newline.
+    static std::string execute(std::string_view _command);
+
+  private:
+    void onNewConnection();
+    void onReadyRead(QLocalSocket* _socket);
+
+    QLocalServer server_;
+};
+
+} // end namespace
@@ -26,17 +26,28 @@ Controller* Controller::self_ = nullptr;
 Controller::Controller(std::string _programPath,
                        config::Config _config,
                        bool _liveConfig,
-                       std::string _profileName) :
+                       std::string _profileName,
+                       std::unique_ptr<terminal::Pty> _initialPty) :
     programPath_{ move(_programPath) },
     config_{ move(_config) },
     liveConfig_{ _liveConfig },
-    profileName_{ move(_profileName) }
+    profileName_{ move(_profileName) },
+    initialPty_{ move(_initialPty) }
 {
     // systrayIcon_ = new QSystemTrayIcon(nullptr);
     // systrayIcon_->show();
     // TODO: systrayIcon_: add icon
     // TODO: systrayIcon_: add context menu?
 
+    if (config_.sessionPoolSize != 0)
+    {
+        auto const& profile = *config_.profile(profileName_);
+        sessionPool_ = make_unique<SessionPool>(profile.shell, profile.terminalSize, config_.sessionPoolSize);
+    }
+
+    if (config_.controlSocket.enabled)
+        controlServer_ = make_unique<ControlServer>(config_.controlSocket.name);
+
     connect(this, &Controller::started, this, [this]() { newWindow(); });
 
     self_ = this;
@@ -48,14 +59,24 @@ Controller::~Controller()
 
 void Controller::newWindow()
 {
+    auto pty = move(initialPty_);
+    if (!pty && sessionPool_)
+        pty = sessionPool_->take();
+
     auto mainWindow = new TerminalWindow{
         config_,
         liveConfig_,
         profileName_,
-        programPath_
+        programPath_,
+        move(pty)
     };
     mainWindow->show();
 
+    // Only the initial terminal is recorded, saved and measured, rather than each window overwriting these files.
+    config_.ptyRecordingPath.clear();
+    config_.sessionFilePath.clear();
+    config_.latencyTestSamples = 0;
+
     terminalWindows_.push_back(mainWindow);
     // TODO: Remove window from list when destroyed.
 
@@ -63,6 +84,15 @@ void Controller::newWindow()
     //                  this, &Controller::showNotification);
 }
 
+bool Controller::newPooledWindow(std::string const& _profileName)
+{
+    if (!sessionPool_ || _profileName != profileName_)
+        return false;
+
+    newWindow();
+    return true;
+}
+
 void Controller::showNotification(QString const& _title, QString const& _content)
 {
     // systrayIcon_->showMessage(
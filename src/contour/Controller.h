@@ -14,6 +14,10 @@
 #pragma once
 
 #include <contour/Config.h>
+#include <contour/ControlServer.h>
+#include <contour/SessionPool.h>
+
+#include <terminal/pty/Pty.h>
 
 #include <QtCore/QThread>
 #include <QtWidgets/QSystemTrayIcon>
@@ -29,17 +33,29 @@ class TerminalWindow;
 
 class Controller : public QThread {
   public:
+    /// @param _initialPty  an already started shell for the first window, or nullptr to start one with it.
     Controller(std::string _programPath,
                contour::config::Config _config,
                bool _liveConfig,
-               std::string _profileName);
+               std::string _profileName,
+               std::unique_ptr<terminal::Pty> _initialPty = {});
 
     ~Controller();
 
+    /// @returns the controller of this process' terminal windows, if running.
+    static Controller* instance() noexcept { return self_; }
+
     std::list<TerminalWindow*> const& terminalWindows() const noexcept { return terminalWindows_; }
 
   public slots:
     void newWindow();
+
+    /// Opens a new window using a shell of the session pool,
+    /// provided the session pool is enabled and keeps shells of the given profile.
+    ///
+    /// @returns whether or not a window has been opened.
+    bool newPooledWindow(std::string const& _profileName);
+
     void showNotification(QString const& _title, QString const& _content);
 
   private:
@@ -53,7 +69,10 @@ class Controller : public QThread {
     bool const liveConfig_;
     std::string profileName_;
 
+    std::unique_ptr<terminal::Pty> initialPty_;    // taken by the first window
     std::list<TerminalWindow*> terminalWindows_;
+    std::unique_ptr<SessionPool> sessionPool_;
+    std::unique_ptr<ControlServer> controlServer_;
 
     QSystemTrayIcon* systrayIcon_ = nullptr;
 };
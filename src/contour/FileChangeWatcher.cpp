@@ -12,44 +12,170 @@
  * limitations under the License.
  */
 #include "FileChangeWatcher.h"
-#include <thread>
-#include <chrono>
+#include <contour/helper.h>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFileInfo>
+#include <QtCore/QFileSystemWatcher>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
 
 using namespace std;
 
-FileChangeWatcher::FileChangeWatcher(FileSystem::path _filePath, Notifier _notifier) :
-    filePath_{ move(_filePath) },
-    notifier_{ move(_notifier) },
-    exit_{ false },
-    watcher_{ [this]() { watch(); } }
+/// The process-wide file system watch, fanning out change events to all FileChangeWatchers.
+///
+/// Besides the watched files, their directories are watched as well, as files replaced
+/// by editors (i.e. written to a new file that is then renamed) or erased are dropped from
+/// the watch and need to be added again as soon as they reappear.
+class FileChangeWatcher::Hub {
+  public:
+    static void subscribe(FileChangeWatcher& _watcher);
+    static void unsubscribe(FileChangeWatcher& _watcher);
+
+  private:
+    Hub();
+
+    static QString keyOf(FileChangeWatcher const& _watcher);
+
+    void fileChanged(QString const& _path);
+    void directoryChanged(QString const& _path);
+    void notify(QString const& _path, Event _event);
+
+    QFileSystemWatcher watcher_;
+    map<QString, vector<FileChangeWatcher*>> subscribers_; // by absolute file path
+
+    static unique_ptr<Hub> instance_;
+};
+
+unique_ptr<FileChangeWatcher::Hub> FileChangeWatcher::Hub::instance_;
+
+FileChangeWatcher::Hub::Hub()
 {
+    QObject::connect(&watcher_, &QFileSystemWatcher::fileChanged,
+                     [this](QString const& _path) { fileChanged(_path); });
+    QObject::connect(&watcher_, &QFileSystemWatcher::directoryChanged,
+                     [this](QString const& _path) { directoryChanged(_path); });
 }
 
-FileChangeWatcher::~FileChangeWatcher()
+QString FileChangeWatcher::Hub::keyOf(FileChangeWatcher const& _watcher)
 {
-    stop();
-    watcher_.join();
+    return QFileInfo(QString::fromStdString(_watcher.filePath_.generic_string())).absoluteFilePath();
+}
+
+void FileChangeWatcher::Hub::subscribe(FileChangeWatcher& _watcher)
+{
+    if (!instance_)
+        instance_.reset(new Hub());
+
+    auto const path = keyOf(_watcher);
+    auto& subscribers = instance_->subscribers_[path];
+    subscribers.push_back(&_watcher);
+    if (subscribers.size() > 1)
+        return;
+
+    if (QFileInfo::exists(path))
+        instance_->watcher_.addPath(path);
+    instance_->watcher_.addPath(QFileInfo(path).absolutePath());
+}
+
+void FileChangeWatcher::Hub::unsubscribe(FileChangeWatcher& _watcher)
+{
+    auto const path = keyOf(_watcher);
+    auto i = instance_->subscribers_.find(path);
+    if (i == instance_->subscribers_.end())
+        return;
+
+    auto& subscribers = i->second;
+    subscribers.erase(remove(subscribers.begin(), subscribers.end(), &_watcher), subscribers.end());
+    if (!subscribers.empty())
+        return;
+
+    instance_->subscribers_.erase(i);
+    instance_->watcher_.removePath(path);
+
+    auto const directory = QFileInfo(path).absolutePath();
+    auto const directoryWatched = any_of(instance_->subscribers_.begin(), instance_->subscribers_.end(),
+                                         [&](auto const& _entry) { return QFileInfo(_entry.first).absolutePath() == directory; });
+    if (!directoryWatched)
+        instance_->watcher_.removePath(directory);
+
+    // Released only after returning to the event loop, as this may be called by a notifier.
+    if (auto* app = QCoreApplication::instance(); app != nullptr)
+        contour::postToObject(app, []() {
+            if (instance_ && instance_->subscribers_.empty())
+                instance_.reset();
+        });
 }
 
-void FileChangeWatcher::watch()
+void FileChangeWatcher::Hub::fileChanged(QString const& _path)
 {
-    auto lastWriteTime = FileSystem::last_write_time(filePath_);
-    while (!exit_)
+    if (!QFileInfo::exists(_path))
     {
-        if (!FileSystem::exists(filePath_))
-            notifier_(Event::Erased);
-
-        auto lwt = FileSystem::last_write_time(filePath_);
-        if (lwt != lastWriteTime)
-        {
-            lastWriteTime = lwt;
-            notifier_(Event::Modified);
-        }
-        this_thread::sleep_for(1s);
+        // Picked up again by directoryChanged() once the file reappears.
+        notify(_path, Event::Erased);
+        return;
     }
+
+    // A replaced file is no longer watched, so watch the new one.
+    if (!watcher_.files().contains(_path))
+        watcher_.addPath(_path);
+
+    notify(_path, Event::Modified);
+}
+
+void FileChangeWatcher::Hub::directoryChanged(QString const& _path)
+{
+    auto const watchedFiles = watcher_.files();
+    for (auto const& [path, subscribers]: subscribers_)
+    {
+        if (QFileInfo(path).absolutePath() != _path
+            || watchedFiles.contains(path)
+            || !QFileInfo::exists(path))
+            continue;
+
+        watcher_.addPath(path);
+        notify(path, Event::Modified);
+    }
+}
+
+void FileChangeWatcher::Hub::notify(QString const& _path, Event _event)
+{
+    auto const i = subscribers_.find(_path);
+    if (i == subscribers_.end())
+        return;
+
+    // Notifiers may stop watching, so iterate over a copy and skip the ones stopped meanwhile.
+    auto const subscribers = i->second;
+    for (FileChangeWatcher* watcher: subscribers)
+    {
+        auto const current = subscribers_.find(_path);
+        if (current != subscribers_.end()
+            && find(current->second.begin(), current->second.end(), watcher) != current->second.end())
+            watcher->notifier_(_event);
+    }
+}
+
+FileChangeWatcher::FileChangeWatcher(FileSystem::path _filePath, Notifier _notifier) :
+    filePath_{ move(_filePath) },
+    notifier_{ move(_notifier) },
+    watching_{ true }
+{
+    Hub::subscribe(*this);
+}
+
+FileChangeWatcher::~FileChangeWatcher()
+{
+    stop();
 }
 
 void FileChangeWatcher::stop()
 {
-    exit_ = true;
+    if (!watching_)
+        return;
+
+    watching_ = false;
+    Hub::unsubscribe(*this);
 }
@@ -16,8 +16,13 @@
 #include <crispy/stdfs.h>
 
 #include <functional>
-#include <thread>
 
+/// Notifies about changes of a single file.
+///
+/// Changes are reported by the operating system (inotify, kqueue, or ReadDirectoryChangesW)
+/// rather than polled for. All watchers of the process share a single system watch and are
+/// notified alike when the file they watch changes. Watchers must be created and destroyed
+/// on the GUI thread, which is also the thread invoking the notifiers.
 class FileChangeWatcher {
   public:
     enum class Event {
@@ -29,15 +34,16 @@ class FileChangeWatcher {
     FileChangeWatcher(FileSystem::path _filePath, Notifier _notifier);
     ~FileChangeWatcher();
 
+    FileChangeWatcher(FileChangeWatcher const&) = delete;
+    FileChangeWatcher& operator=(FileChangeWatcher const&) = delete;
+
     // stop watching on that file early
     void stop();
 
   private:
-    void watch();
+    class Hub;
 
-  private:
     FileSystem::path filePath_;
     Notifier notifier_;
-    bool exit_;
-    std::thread watcher_;
+    bool watching_;
 };
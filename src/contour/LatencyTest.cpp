@@ -0,0 +1,139 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <contour/LatencyTest.h>
+#include <contour/TerminalSession.h>
+
+#include <QtCore/QCoreApplication>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+using std::chrono::duration;
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace contour {
+
+namespace // {{{ helper
+{
+    /// Time given to the program to start up, before typing.
+    auto constexpr StartupDelay = milliseconds(1000);
+
+    /// Time after which a key press counts as lost, if its echo has not been presented by then.
+    auto constexpr SampleTimeout = milliseconds(1000);
+
+    /// Range of the time waited for between presenting an echo and pressing the next key.
+    auto constexpr MinTypingDelay = 30;
+    auto constexpr MaxTypingDelay = 80;
+
+    /// Number of keys pressed before starting a new line, so that echoes never wrap,
+    /// nor fill up the line buffer of the PTY.
+    auto constexpr LineLength = 40u;
+
+    std::string formatLatency(steady_clock::duration _value)
+    {
+        return fmt::format("{:.2f}ms", duration<double, std::milli>(_value).count());
+    }
+} // }}}
+
+LatencyTest::LatencyTest(TerminalSession& _session, unsigned _sampleCount) :
+    session_{ _session },
+    sampleCount_{ _sampleCount }
+{
+    timer_.setSingleShot(true);
+    timer_.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&timer_, &QTimer::timeout, [this]() { onTimeout(); });
+}
+
+void LatencyTest::start()
+{
+    timer_.start(StartupDelay);
+}
+
+void LatencyTest::onTimeout()
+{
+    if (pending_)
+    {
+        ++lost_;
+        pending_.reset();
+    }
+
+    typeNext();
+}
+
+void LatencyTest::typeNext()
+{
+    if (typed_ == sampleCount_)
+    {
+        finish();
+        return;
+    }
+
+    if (typed_ % LineLength == 0 && typed_ != 0 && !lineStarted_)
+    {
+        // The echo of the line break is not measured, and waited for to be shown.
+        lineStarted_ = true;
+        session_.terminal().sendRaw("\r");
+        timer_.start(MaxTypingDelay);
+        return;
+    }
+
+    lineStarted_ = false;
+    auto const ch = static_cast<char32_t>('a' + typed_ % 26);
+    ++typed_;
+    pending_ = steady_clock::now();
+    session_.sendCharPressEvent(terminal::CharInputEvent{ch, terminal::Modifier::None}, *pending_);
+    timer_.start(SampleTimeout);
+}
+
+void LatencyTest::framePresented(Timestamp _outputTime, Timestamp _now)
+{
+    if (!pending_ || _outputTime == Timestamp{} || _outputTime < *pending_)
+        return;
+
+    auto const latency = _now - *pending_;
+    pending_.reset();
+    histogram_.record(latency);
+    min_ = std::min(min_, latency);
+    total_ += latency;
+
+    auto delay = std::uniform_int_distribution<int>{MinTypingDelay, MaxTypingDelay};
+    timer_.start(milliseconds(delay(random_)));
+}
+
+void LatencyTest::finish()
+{
+    auto const measured = histogram_.count();
+    std::cout << fmt::format("Key-to-photon latency of {} key presses ({} lost):\n", sampleCount_, lost_);
+    if (measured != 0)
+    {
+        std::cout << fmt::format("{:>10} {:>10} {:>10} {:>10} {:>10} {:>10}\n", "min", "mean", "p50", "p90", "p99", "max");
+        std::cout << fmt::format("{:>10} {:>10} {:>10} {:>10} {:>10} {:>10}\n",
+                                 formatLatency(min_),
+                                 formatLatency(total_ / static_cast<int>(measured)),
+                                 formatLatency(histogram_.percentile(50)),
+                                 formatLatency(histogram_.percentile(90)),
+                                 formatLatency(histogram_.percentile(99)),
+                                 formatLatency(histogram_.max()));
+    }
+    std::cout.flush();
+
+    QCoreApplication::exit(measured != 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+} // end namespace
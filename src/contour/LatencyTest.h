@@ -0,0 +1,70 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <crispy/latency_histogram.h>
+
+#include <QtCore/QTimer>
+
+#include <chrono>
+#include <optional>
+#include <random>
+
+namespace contour {
+
+class TerminalSession;
+
+/// Measures the latency from key presses to the presentation of their echo on screen,
+/// as typometer does from the outside, see `contour terminal --measure-latency`.
+///
+/// Synthetic key presses are sent through the session one at a time, at random intervals,
+/// so as to not be in phase with the display's refresh. The latency of each one is taken
+/// when the first frame showing PTY output read after the key press has been presented.
+/// It is therefore meant to be run with a program echoing the input, and nothing else.
+class LatencyTest {
+  public:
+    using Timestamp = std::chrono::steady_clock::time_point;
+
+    LatencyTest(TerminalSession& _session, unsigned _sampleCount);
+
+    LatencyTest(LatencyTest const&) = delete;
+    LatencyTest& operator=(LatencyTest const&) = delete;
+
+    /// Starts typing, once the program had some time to start up.
+    void start();
+
+    /// Takes the time of the pending key press if the presented frame shows its echo,
+    /// that is, any PTY output read at @p _outputTime after the key press.
+    void framePresented(Timestamp _outputTime, Timestamp _now);
+
+  private:
+    void onTimeout();
+    void typeNext();
+    void finish();
+
+    TerminalSession& session_;
+    unsigned const sampleCount_;
+    unsigned typed_ = 0;                // number of key presses measured, including lost ones
+    unsigned lost_ = 0;                 // number of key presses whose echo has not been seen in time
+    bool lineStarted_ = false;          // whether a new line has been started for the next key press
+    std::optional<Timestamp> pending_;  // of the key press whose echo has not been presented yet
+
+    QTimer timer_;
+    std::minstd_rand random_;
+    crispy::latency_histogram histogram_;
+    std::chrono::steady_clock::duration min_ = std::chrono::steady_clock::duration::max();
+    std::chrono::steady_clock::duration total_{};
+};
+
+} // end namespace
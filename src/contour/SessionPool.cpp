@@ -0,0 +1,121 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <contour/SessionPool.h>
+
+#include <crispy/debuglog.h>
+
+#include <exception>
+
+using std::exception;
+using std::make_unique;
+using std::move;
+using std::scoped_lock;
+using std::unique_lock;
+using std::unique_ptr;
+
+using terminal::Process;
+using terminal::PtyProcess;
+
+namespace contour {
+
+namespace // {{{ helper
+{
+    auto const SessionPoolTag = crispy::debugtag::make("contour.sessionpool", "Logs details about pre-started shells.");
+} // }}}
+
+SessionPool::SessionPool(Process::ExecInfo _shell, crispy::Size _terminalSize, size_t _size) :
+    shell_{ move(_shell) },
+    terminalSize_{ _terminalSize },
+    size_{ _size },
+    refiller_{ [this]() { refill(); } }
+{
+}
+
+SessionPool::~SessionPool()
+{
+    {
+        auto _l = scoped_lock{lock_};
+        stopping_ = true;
+    }
+    refillNeeded_.notify_all();
+    refiller_.join();
+
+    while (!ready_.empty())
+    {
+        discard(move(ready_.front()));
+        ready_.pop_front();
+    }
+}
+
+unique_ptr<PtyProcess> SessionPool::take()
+{
+    auto _l = unique_lock{lock_};
+    while (!ready_.empty())
+    {
+        auto ptyProcess = move(ready_.front());
+        ready_.pop_front();
+        refillNeeded_.notify_one();
+
+        // The shell might have exited in the meantime, e.g. killed by the user.
+        if (ptyProcess->process().alive())
+        {
+            debuglog(SessionPoolTag).write("Taking pre-started shell. {} left.", ready_.size());
+            return ptyProcess;
+        }
+
+        _l.unlock();
+        discard(move(ptyProcess));
+        _l.lock();
+    }
+    debuglog(SessionPoolTag).write("No pre-started shell ready.");
+    return nullptr;
+}
+
+void SessionPool::refill()
+{
+    auto _l = unique_lock{lock_};
+    for (;;)
+    {
+        refillNeeded_.wait(_l, [this]() { return stopping_ || ready_.size() < size_; });
+        if (stopping_)
+            return;
+
+        // Started without holding the lock, as starting a process may take a while.
+        _l.unlock();
+        auto ptyProcess = unique_ptr<PtyProcess>{};
+        try
+        {
+            ptyProcess = make_unique<PtyProcess>(shell_, terminalSize_);
+        }
+        catch (exception const& e)
+        {
+            debuglog(SessionPoolTag).write("Failed to start shell. {}", e.what());
+        }
+        _l.lock();
+
+        if (!ptyProcess)
+            return;
+
+        ready_.push_back(move(ptyProcess));
+        debuglog(SessionPoolTag).write("Pre-started shell. {} ready.", ready_.size());
+    }
+}
+
+void SessionPool::discard(unique_ptr<PtyProcess> _ptyProcess)
+{
+    _ptyProcess->process().terminate(Process::TerminationHint::Hangup);
+    (void) _ptyProcess->waitForProcessExit();
+}
+
+} // end namespace
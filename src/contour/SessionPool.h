@@ -0,0 +1,63 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/pty/PtyProcess.h>
+
+#include <crispy/size.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace contour {
+
+/// Keeps a number of shells started ahead of time, each one attached to its own PTY,
+/// so that new terminal windows do not have to wait for the shell to start up.
+///
+/// The pool is topped up by a background thread whenever a shell has been taken out of it.
+class SessionPool {
+  public:
+    /// @param _shell         the shell (and its working directory) to start.
+    /// @param _terminalSize  initial size of the PTYs, in cells.
+    /// @param _size          number of shells to keep ready.
+    SessionPool(terminal::Process::ExecInfo _shell, crispy::Size _terminalSize, size_t _size);
+    ~SessionPool();
+
+    SessionPool(SessionPool const&) = delete;
+    SessionPool& operator=(SessionPool const&) = delete;
+
+    /// Takes a readily started shell out of the pool.
+    ///
+    /// @returns the shell's PTY, or nullptr if none is ready yet.
+    std::unique_ptr<terminal::PtyProcess> take();
+
+  private:
+    void refill();
+    static void discard(std::unique_ptr<terminal::PtyProcess> _ptyProcess);
+
+    terminal::Process::ExecInfo const shell_;
+    crispy::Size const terminalSize_;
+    size_t const size_;
+
+    std::mutex lock_;
+    std::condition_variable refillNeeded_;
+    std::deque<std::unique_ptr<terminal::PtyProcess>> ready_;
+    bool stopping_ = false;
+    std::thread refiller_;
+};
+
+} // end namespace
@@ -20,11 +20,13 @@
 #include <terminal/Image.h>
 #include <terminal/ScreenEvents.h>
 
+#include <crispy/memory_usage.h>
 #include <crispy/point.h>
 #include <crispy/size.h>
 
 #include <chrono>
 #include <functional>
+#include <string>
 
 namespace contour {
 
@@ -58,6 +60,9 @@ public:
     virtual void bell() = 0;
     virtual void copyToClipboard(std::string_view _data) = 0;
     virtual void dumpState() = 0;
+    virtual std::string renderStats() = 0;
+    virtual std::string renderStatsJson() = 0;
+    virtual void collectMemoryUsage(crispy::memory_usage& _usage) = 0;
     virtual void notify(std::string_view _title, std::string_view _body) = 0;
     virtual void resizeWindow(int _width, int _height, bool _unitInPixels) = 0;
     virtual void setBackgroundBlur(bool _enabled) = 0;
@@ -78,6 +83,7 @@ public:
     virtual void onClosed() = 0; // PTY closed
     virtual void onSelectionCompleted() = 0; // a visual selection has completed
     virtual void renderBufferUpdated() = 0; // notify on RenderBuffer updates
+    virtual void memoryTrimmed() = 0; // the terminal went idle and gave back memory, see Terminal::trimMemory()
     virtual void scheduleRedraw() = 0; //!< forced redraw of the screen
 };
 
@@ -11,6 +11,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <contour/Controller.h>
 #include <contour/TerminalSession.h>
 #include <contour/helper.h>
 
@@ -34,6 +35,7 @@
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QMessageBox>
 
+#include <algorithm>
 #include <fstream>
 
 #if defined(CONTOUR_BLUR_PLATFORM_KWIN)
@@ -65,6 +67,36 @@ namespace // {{{ helper
         return fmt::format("{}: Unhandled exception caught ({}). {}", where, typeid(e).name(), e.what());
     }
 
+    /// Tests whether switching fonts from @p a to @p b requires reloading them,
+    /// also comparing the settings not covered by FontDescriptions' equality operator.
+    bool fontsChanged(renderer::FontDescriptions const& a, renderer::FontDescriptions const& b)
+    {
+        return a != b
+            || a.dpi != b.dpi
+            || a.dpiScale != b.dpiScale
+            || a.textShapingMethod != b.textShapingMethod
+            || a.glyphCacheDirectory != b.glyphCacheDirectory
+            || a.builtinBoxDrawing != b.builtinBoxDrawing;
+    }
+
+    string jsonEscaped(string_view _text)
+    {
+        auto escaped = string();
+        for (char const ch: _text)
+        {
+            if (ch == '"' || ch == '\\')
+                escaped.push_back('\\');
+            if (static_cast<unsigned char>(ch) < 0x20)
+                escaped += fmt::format("\\u{:04x}", static_cast<unsigned>(ch));
+            else
+                escaped.push_back(ch);
+        }
+        return escaped;
+    }
+
+    unsigned nextSessionId = 1;
+    vector<TerminalSession*> allSessions;
+
 } //  }}}
 
 TerminalSession::TerminalSession(unique_ptr<Pty> _pty,
@@ -97,6 +129,12 @@ TerminalSession::TerminalSession(unique_ptr<Pty> _pty,
     },
     display_{move(_display)}
 {
+    id_ = nextSessionId++;
+    allSessions.push_back(this);
+
+    // Sessions share the CPU with each other, with priority to the focused one, see sendFocusInEvent().
+    terminal_.setForeground(false);
+
     if (_liveConfig)
     {
         debuglog(WidgetTag).write("Enable live configuration reloading of file {}.",
@@ -112,7 +150,54 @@ TerminalSession::TerminalSession(unique_ptr<Pty> _pty,
 
 TerminalSession::~TerminalSession()
 {
+#if defined(CONTOUR_VT_METRICS)
+    fmt::print("VT sequence usage metrics:\n{}", terminal_.screen().metrics().dump());
+#endif
     (void) display_.release(); // TODO: due to Qt, this is currently not owned by us. That's sad, or is it not?
+    allSessions.erase(std::remove(allSessions.begin(), allSessions.end(), this), allSessions.end());
+}
+
+vector<TerminalSession*> const& TerminalSession::sessions() noexcept
+{
+    return allSessions;
+}
+
+string TerminalSession::statsJson()
+{
+    auto usage = crispy::memory_usage{};
+    auto images = string();
+    {
+        auto const _l = scoped_lock{terminal()};
+        terminal().collectMemoryUsage(usage);
+        auto const& pool = terminal().screen().imagePool();
+        images = fmt::format("{{\"count\": {}, \"rasterized\": {}, \"named\": {}, \"bytes\": {}, "
+                             "\"memory_limit\": {}, \"evicted_count\": {}, \"evicted_bytes\": {}, \"pixel_cache\": {}}}",
+                             pool.imageCount(),
+                             pool.rasterizedImageCount(),
+                             pool.namedImageCount(),
+                             pool.imageBytes(),
+                             pool.memoryLimit(),
+                             pool.evictedImageCount(),
+                             pool.evictedImageBytes(),
+                             pool.pixelCacheStats().json());
+    }
+    if (display_)
+        display_->collectMemoryUsage(usage);
+
+    // The counters and histograms may be read without holding the terminal lock.
+    return fmt::format("{{\"id\": {}, \"profile\": \"{}\", \"parse\": {}, \"latency\": {}, \"render\": {}, "
+                       "\"render_buffer\": {{\"frames\": {}, \"overwritten\": {}}}, "
+                       "\"memory\": {}, \"images\": {}, \"allocations\": {}}}",
+                       id_,
+                       jsonEscaped(profileName_),
+                       terminal_.parseStats().json(),
+                       terminal_.latencyTrace().json(),
+                       display_ ? display_->renderStatsJson() : string("null"),
+                       terminal_.renderBufferFrameCount(),
+                       terminal_.renderBufferOverwrittenFrameCount(),
+                       usage.json(),
+                       images,
+                       terminal_.allocationTrace().json());
 }
 
 void TerminalSession::setDisplay(unique_ptr<TerminalDisplay> _display)
@@ -134,10 +219,77 @@ void TerminalSession::displayInitialized()
 
     if (displayInitialized_)
         displayInitialized_();
+
+    if (config_.latencyTestSamples != 0 && !latencyTest_)
+    {
+        latencyTest_ = make_unique<LatencyTest>(*this, config_.latencyTestSamples);
+        latencyTest_->start();
+    }
+}
+
+void TerminalSession::framePresented(steady_clock::time_point _outputTime, steady_clock::time_point _now)
+{
+    if (latencyTest_)
+        latencyTest_->framePresented(_outputTime, _now);
 }
 
 void TerminalSession::start()
 {
+    auto readBufferSettings = terminal::Terminal::ReadBufferSettings{};
+    readBufferSettings.maxSize = config_.readBuffer.maxSize;
+    readBufferSettings.coalesce = config_.readBuffer.coalesce;
+    readBufferSettings.coalesceTimeBudget = std::chrono::microseconds(config_.readBuffer.coalesceTimeBudget);
+    terminal().setReadBufferSettings(readBufferSettings);
+    terminal().setIdleMemoryTrimDelay(std::chrono::seconds(config_.idleMemoryTrimDelay));
+
+    auto throughputModeSettings = terminal::Terminal::ThroughputModeSettings{};
+    throughputModeSettings.enabled = config_.throughputMode.enabled;
+    throughputModeSettings.bytesPerFrame = config_.throughputMode.bytesPerFrame;
+    throughputModeSettings.sustainedFrames = config_.throughputMode.sustainedFrames;
+    terminal().setThroughputModeSettings(throughputModeSettings);
+    terminal().setSynchronizedOutputTimeout(std::chrono::milliseconds(config_.synchronizedOutputTimeout));
+
+    auto schedulerSettings = terminal::SessionScheduler::Settings{};
+    schedulerSettings.enabled = config_.scheduler.enabled;
+    schedulerSettings.timeSlice = std::chrono::milliseconds(config_.scheduler.timeSlice);
+    schedulerSettings.backgroundShare = config_.scheduler.backgroundShare;
+    schedulerSettings.backgroundRefreshRate = config_.scheduler.backgroundRefreshRate;
+    terminal::SessionScheduler::shared().setSettings(schedulerSettings);
+
+    if (config_.readPipeline.enabled)
+    {
+        auto settings = terminal::Terminal::InputPipelineSettings{};
+        settings.bufferSize = config_.readPipeline.bufferSize;
+        settings.highWatermark = config_.readPipeline.highWatermark;
+        settings.lowWatermark = config_.readPipeline.lowWatermark;
+        settings.sharedReactor = config_.readPipeline.sharedReactor;
+        terminal().enableInputPipeline(settings);
+    }
+
+    if (!config_.ptyRecordingPath.empty())
+    {
+        try
+        {
+            terminal().setRecorder(make_unique<terminal::PtyRecorder>(config_.ptyRecordingPath));
+        }
+        catch (exception const& e)
+        {
+            cerr << e.what() << '\n';
+        }
+    }
+
+    if (!config_.sessionFilePath.empty())
+    {
+        try
+        {
+            terminal().setSessionFile(make_unique<terminal::SessionFile>(config_.sessionFilePath));
+        }
+        catch (exception const& e)
+        {
+            cerr << e.what() << '\n';
+        }
+    }
+
     terminal().start();
 }
 
@@ -152,19 +304,25 @@ void TerminalSession::bell()
 
 void TerminalSession::bufferChanged(terminal::ScreenType _type)
 {
-    display_->post([this, _type] ()
-    {
-        display_->bufferChanged(_type);
-    });
+    if (!display_)
+        return;
+
+    auto _l = scoped_lock{displayUpdatesLock_};
+    displayUpdates_.screenType = _type;
+    postDisplayUpdates();
 }
 
 void TerminalSession::screenUpdated()
 {
-#if defined(CONTOUR_VT_METRICS)
-    // TODO
-    // for (auto const& command : _commands)
-    //     terminalMetrics_(command);
-#endif
+    if (!config_.vtMetricsExportPath.empty())
+    {
+        if (auto const now = steady_clock::now(); now - lastVTMetricsExport_ >= config_.vtMetricsExportInterval)
+        {
+            lastVTMetricsExport_ = now;
+            exportVTMetrics(config_.vtMetricsExportPath);
+        }
+    }
+
     if (profile_.autoScrollOnUpdate && terminal().viewport().scrolled())
         terminal().viewport().scrollToBottom();
 
@@ -179,6 +337,24 @@ void TerminalSession::renderBufferUpdated()
     display_->renderBufferUpdated();
 }
 
+void TerminalSession::memoryTrimmed()
+{
+    if (!display_)
+        return;
+
+    display_->memoryTrimmed();
+}
+
+void TerminalSession::inputCongestionChanged(bool _congested)
+{
+    if (!display_)
+        return;
+
+    auto _l = scoped_lock{displayUpdatesLock_};
+    displayUpdates_.inputCongested = _congested;
+    postDisplayUpdates();
+}
+
 void TerminalSession::requestCaptureBuffer(int _absoluteStartLine, int _lineCount)
 {
     display_->post([this, _absoluteStartLine, _lineCount]()
@@ -270,11 +446,25 @@ void TerminalSession::onClosed()
 
 void TerminalSession::onSelectionCompleted()
 {
-    if (QClipboard* clipboard = QGuiApplication::clipboard(); clipboard != nullptr)
-    {
-        string const text = terminal().extractSelectionText();
-        clipboard->setText(QString::fromUtf8(text.c_str(), static_cast<int>(text.size())), QClipboard::Selection);
-    }
+    extractSelectionText([this](string _text) {
+        if (!display_)
+            return;
+
+        display_->post([text = move(_text)]() {
+            if (QClipboard* clipboard = QGuiApplication::clipboard(); clipboard != nullptr)
+                clipboard->setText(QString::fromUtf8(text.c_str(), static_cast<int>(text.size())), QClipboard::Selection);
+        });
+    });
+}
+
+void TerminalSession::extractSelectionText(std::function<void(std::string)> _done)
+{
+    // Qt's clipboard only takes the text as a whole, so the pieces are joined here.
+    terminal().extractSelectionTextAsync([text = string{}, done = move(_done)](string_view _piece, bool _last) mutable {
+        text += _piece;
+        if (_last)
+            done(move(text));
+    });
 }
 
 void TerminalSession::resizeWindow(int _width, int _height, bool _inPixels)
@@ -295,9 +485,36 @@ void TerminalSession::setWindowTitle(string_view _title)
     if (!display_)
         return;
 
-    display_->post([this, terminalTitle = string(_title)]() {
-        display_->setWindowTitle(terminalTitle);
-    });
+    auto _l = scoped_lock{displayUpdatesLock_};
+    displayUpdates_.windowTitle = string(_title);
+    postDisplayUpdates();
+}
+
+void TerminalSession::postDisplayUpdates()
+{
+    if (!std::exchange(displayUpdates_.posted, true))
+        display_->post([this]() { deliverDisplayUpdates(); });
+}
+
+void TerminalSession::deliverDisplayUpdates()
+{
+    auto updates = DisplayUpdates{};
+    {
+        auto _l = scoped_lock{displayUpdatesLock_};
+        updates = std::exchange(displayUpdates_, DisplayUpdates{});
+    }
+
+    if (updates.screenType)
+        display_->bufferChanged(*updates.screenType);
+
+    if (updates.windowTitle)
+        display_->setWindowTitle(*updates.windowTitle);
+
+    // The display resets the mouse cursor along with the screen buffer.
+    if (updates.inputCongested)
+        inputCongested_ = *updates.inputCongested;
+    if (updates.inputCongested || (updates.screenType && inputCongested_))
+        setDefaultCursor();
 }
 
 void TerminalSession::setTerminalProfile(string const& _configProfileName)
@@ -315,6 +532,34 @@ void TerminalSession::discardImage(terminal::Image const& _image)
     display_->discardImage(_image);
 }
 
+bool TerminalSession::permitSharedImage()
+{
+    switch (profile_.permissions.sharedImages)
+    {
+        case config::Permission::Allow:
+            return true;
+        case config::Permission::Deny:
+            return false;
+        case config::Permission::Ask:
+            break;
+    }
+
+    // Images arriving while the user is being asked are dropped rather than blocking the screen.
+    auto expected = SharedImagePermission::Unknown;
+    if (display_ && sharedImagePermission_.compare_exchange_strong(expected, SharedImagePermission::Asking))
+    {
+        display_->post([this]() {
+            auto const allowed = display_->requestPermission(profile_.permissions.sharedImages,
+                                                             "display images from shared memory");
+            sharedImagePermission_ = allowed ? SharedImagePermission::Allowed
+                                             : SharedImagePermission::Denied;
+        });
+        return false;
+    }
+
+    return expected == SharedImagePermission::Allowed;
+}
+
 // }}}
 // {{{ Input Events
 void TerminalSession::sendKeyPressEvent(terminal::KeyInputEvent const& _event, Timestamp _now)
@@ -358,15 +603,15 @@ void TerminalSession::sendMousePressEvent(terminal::MousePressEvent const& _even
 
 void TerminalSession::sendMouseMoveEvent(terminal::MouseMoveEvent const& _event, Timestamp _now)
 {
-    auto const handled = terminal().sendMouseMoveEvent(_event, _now);
+    auto const changed = terminal().sendMouseMoveEvent(_event, _now);
 
-    bool const mouseHoveringHyperlink = terminal().isMouseHoveringHyperlink();
-    if (mouseHoveringHyperlink)
+    // Also restores the mouse cursor hidden while typing.
+    if (terminal().isMouseHoveringHyperlink())
         display_->setMouseCursorShape(MouseCursorShape::PointingHand);
     else
         setDefaultCursor();
 
-    if (mouseHoveringHyperlink || handled || terminal().isSelectionAvailable()) // && only if selection has changed!
+    if (changed)
     {
         terminal().breakLoopAndRefreshRenderBuffer();
         scheduleRedraw();
@@ -386,6 +631,7 @@ void TerminalSession::sendFocusInEvent()
     setDefaultCursor();
 
     terminal().screen().setFocus(true);
+    terminal().setForeground(true);
     terminal().sendFocusInEvent();
 
     display_->setBackgroundBlur(profile().backgroundBlur);
@@ -396,6 +642,7 @@ void TerminalSession::sendFocusOutEvent()
 {
     // TODO maybe paint with "faint" colors
     terminal().screen().setFocus(false);
+    terminal().setForeground(false);
     terminal().sendFocusOutEvent();
 
     scheduleRedraw();
@@ -419,7 +666,7 @@ void TerminalSession::operator()(actions::CopyPreviousMarkRange)
 
 void TerminalSession::operator()(actions::CopySelection)
 {
-    copyToClipboard(terminal().extractSelectionText());
+    extractSelectionText([this](string _text) { copyToClipboard(_text); });
 }
 
 void TerminalSession::operator()(actions::DecreaseFontSize)
@@ -440,6 +687,50 @@ void TerminalSession::operator()(actions::DecreaseOpacity)
     display_->setBackgroundOpacity(profile_.backgroundOpacity);
 }
 
+void TerminalSession::operator()(actions::DumpAllocationStats)
+{
+    // The counters may be read without holding the terminal lock.
+    auto const stats = terminal_.allocationTrace().dump();
+    debuglog(WidgetTag).write("Allocation statistics:\n{}", stats);
+    debuglog(WidgetTag).write("Allocation statistics (JSON): {}", terminal_.allocationTrace().json());
+    notify("Allocation statistics", stats);
+}
+
+void TerminalSession::operator()(actions::DumpLatencyStats)
+{
+    // The histograms may be read without holding the terminal lock.
+    auto const stats = terminal_.latencyTrace().dump();
+    debuglog(WidgetTag).write("Latency statistics:\n{}", stats);
+    notify("Latency statistics", stats);
+}
+
+void TerminalSession::operator()(actions::DumpMemoryUsage)
+{
+    auto usage = crispy::memory_usage{};
+    {
+        auto const _l = scoped_lock{terminal()};
+        terminal().collectMemoryUsage(usage);
+    }
+    display_->collectMemoryUsage(usage);
+
+    auto const table = usage.table();
+    debuglog(WidgetTag).write("Memory usage:\n{}", table);
+    debuglog(WidgetTag).write("Memory usage (JSON): {}", usage.json());
+    notify("Memory usage", table);
+}
+
+void TerminalSession::operator()(actions::DumpRenderStats)
+{
+    auto const stats = display_->renderStats();
+    debuglog(WidgetTag).write("Render statistics:\n{}", stats);
+    notify("Render statistics", stats);
+}
+
+void TerminalSession::operator()(actions::DumpVTMetrics)
+{
+    exportVTMetrics(!config_.vtMetricsExportPath.empty() ? config_.vtMetricsExportPath : "vt-metrics.txt");
+}
+
 void TerminalSession::operator()(actions::FollowHyperlink)
 {
     auto const _l = scoped_lock{terminal()};
@@ -450,11 +741,17 @@ void TerminalSession::operator()(actions::FollowHyperlink)
     };
     if (terminal().screen().contains(currentMousePosition))
     {
-        if (auto hyperlink = terminal().screen().at(currentMousePositionRel).hyperlink(); hyperlink != nullptr)
+        if (auto const* hyperlink = terminal().screen().hyperlinkAt(currentMousePositionRel); hyperlink != nullptr)
         {
             followHyperlink(*hyperlink);
             return;
         }
+
+        if (auto const link = terminal().screen().detectedLinkAt(currentMousePositionRel); link.has_value())
+        {
+            followHyperlink(terminal().screen().detectedHyperlink(currentMousePositionRel.row, *link));
+            return;
+        }
     }
 }
 
@@ -499,8 +796,8 @@ void TerminalSession::operator()(actions::PasteClipboard)
 {
     if (QClipboard* clipboard = QGuiApplication::clipboard(); clipboard != nullptr)
     {
-        string const text = clipboard->text(QClipboard::Clipboard).toUtf8().toStdString();
-        terminal().sendPaste(string_view{text});
+        auto text = clipboard->text(QClipboard::Clipboard).toUtf8().toStdString();
+        terminal().sendPaste(move(text), config_.sanitizePaste);
     }
 }
 
@@ -508,8 +805,8 @@ void TerminalSession::operator()(actions::PasteSelection)
 {
     if (QClipboard* clipboard = QGuiApplication::clipboard(); clipboard != nullptr)
     {
-        string const text = clipboard->text(QClipboard::Selection).toUtf8().toStdString();
-        terminal().sendPaste(string_view{text});
+        auto text = clipboard->text(QClipboard::Selection).toUtf8().toStdString();
+        terminal().sendPaste(move(text), config_.sanitizePaste);
     }
 }
 
@@ -540,10 +837,12 @@ void TerminalSession::operator()(actions::ResetFontSize)
 
 void TerminalSession::operator()(actions::ScreenshotVT)
 {
-    auto _l = lock_guard{ terminal() };
-    auto const screenshot = terminal().screen().screenshot();
+    auto const screenshot = [&]() {
+        auto _l = lock_guard{ terminal() };
+        return terminal().screen().captureScreenshot();
+    }();
     ofstream ofs{ "screenshot.vt", ios::trunc | ios::binary };
-    ofs << screenshot;
+    terminal::writeScreenshot(screenshot, [&](string_view _chunk) { ofs.write(_chunk.data(), static_cast<streamsize>(_chunk.size())); });
 }
 
 void TerminalSession::operator()(actions::ScrollDown)
@@ -639,6 +938,14 @@ void TerminalSession::setDefaultCursor()
 {
     using Type = terminal::ScreenType;
     display_->setMouseCursorShape(MouseCursorShape::Hidden); // hide first so we force the change.
+
+    // The application is not keeping up with the input, e.g. a large paste.
+    if (inputCongested_)
+    {
+        display_->setMouseCursorShape(MouseCursorShape::Busy);
+        return;
+    }
+
     switch (terminal().screen().bufferType())
     {
         case Type::Main:
@@ -713,6 +1020,9 @@ void TerminalSession::executeAction(actions::Action const& _action)
 
 void TerminalSession::spawnNewTerminal(string const& _profileName)
 {
+    if (auto controller = Controller::instance(); controller && controller->newPooledWindow(_profileName))
+        return;
+
     ::contour::spawnNewTerminal(
         programPath_,
         config_.backingFilePath.generic_string(),
@@ -735,12 +1045,12 @@ void TerminalSession::activateProfile(string const& _newProfileName)
 
     debuglog(WidgetTag).write("Changing profile to {}.", _newProfileName);
     profileName_ = _newProfileName;
-    profile_ = *newProfile;
-    configureTerminal();
-    configureDisplay();
+    auto const previousProfile = exchange(profile_, *newProfile);
+    configureTerminal(&previousProfile);
+    configureDisplay(&previousProfile);
 }
 
-void TerminalSession::configureTerminal()
+void TerminalSession::configureTerminal(config::TerminalProfile const* _previousProfile)
 {
     auto const _l = scoped_lock{terminal_};
     debuglog(WidgetTag).write("Configuring terminal.");
@@ -748,11 +1058,18 @@ void TerminalSession::configureTerminal()
 
     terminal_.setWordDelimiters(config_.wordDelimiters);
     terminal_.setMouseProtocolBypassModifier(config_.bypassMouseProtocolModifier);
+    terminal_.setSelectionOverlay(config_.experimentalFeatures.count("selection_overlay") != 0);
 
+    screen.setTriggers(config_.triggers);
     screen.setRespondToTCapQuery(config_.experimentalFeatures.count("tcap"));
     screen.setSixelCursorConformance(config_.sixelCursorConformance);
+    screen.setSixelProgressive(config_.sixelProgressive);
     screen.setMaxImageColorRegisters(config_.maxImageColorRegisters);
     screen.setMaxImageSize(config_.maxImageSize);
+    screen.setMaxImageMemory(config_.maxImageMemory);
+    terminal::Grid::setGlobalMaxHistoryBytes(config_.maxHistoryMemory
+                                             ? std::optional<size_t>(config_.maxHistoryMemory)
+                                             : std::nullopt);
     debuglog(WidgetTag).write("maxImageSize={}, sixelScrolling={}",
             config_.maxImageSize, config_.sixelScrolling ? "yes" : "no");
     screen.setMode(terminal::DECMode::SixelScrolling, config_.sixelScrolling);
@@ -761,32 +1078,67 @@ void TerminalSession::configureTerminal()
     // if (!_terminalView.renderer().renderTargetAvailable())
     //     return;
 
-    screen.setMaxHistoryLineCount(profile_.maxHistoryLineCount);
-    terminal_.setCursorDisplay(profile_.cursorDisplay);
-    terminal_.setCursorShape(profile_.cursorShape);
-    terminal_.screen().colorPalette() = profile_.colors;
-    terminal_.screen().defaultColorPalette() = profile_.colors;
+    // Only what differs from the previous profile is applied, if any.
+    auto const changed = [&](auto const& _member) {
+        return !_previousProfile || profile_.*_member != _previousProfile->*_member;
+    };
+
+    if (changed(&config::TerminalProfile::maxHistoryLineCount))
+        screen.setMaxHistoryLineCount(profile_.maxHistoryLineCount);
+    if (changed(&config::TerminalProfile::historyCompressionThreshold))
+        screen.setHistoryCompressionThreshold(profile_.historyCompressionThreshold);
+    if (changed(&config::TerminalProfile::historySpillThreshold)
+            || changed(&config::TerminalProfile::historySpillDirectory))
+        screen.setHistorySpill(profile_.historySpillThreshold, profile_.historySpillDirectory);
+    if (changed(&config::TerminalProfile::maxHistoryMemory))
+        screen.setMaxHistoryBytes(profile_.maxHistoryMemory);
+    if (changed(&config::TerminalProfile::cursorDisplay))
+        terminal_.setCursorDisplay(profile_.cursorDisplay);
+    if (changed(&config::TerminalProfile::cursorShape))
+        terminal_.setCursorShape(profile_.cursorShape);
+    if (changed(&config::TerminalProfile::predictiveEcho))
+        terminal_.setPredictiveEcho(profile_.predictiveEcho);
+    if (changed(&config::TerminalProfile::colors))
+    {
+        terminal_.screen().colorPalette() = profile_.colors;
+        terminal_.screen().defaultColorPalette() = profile_.colors;
+    }
 }
 
-void TerminalSession::configureDisplay()
+void TerminalSession::configureDisplay(config::TerminalProfile const* _previousProfile)
 {
     if (!display_)
         return;
 
     debuglog(WidgetTag).write("Configuring display.");
-    display_->setBackgroundBlur(profile_.backgroundBlur);
 
-    if (profile_.maximized)
-        display_->setWindowMaximized();
-    else
-        display_->setWindowNormal();
+    // Only what differs from the previous profile is applied, if any.
+    auto const changed = [&](auto const& _member) {
+        return !_previousProfile || profile_.*_member != _previousProfile->*_member;
+    };
+
+    if (changed(&config::TerminalProfile::backgroundBlur))
+        display_->setBackgroundBlur(profile_.backgroundBlur);
+
+    if (changed(&config::TerminalProfile::maximized))
+    {
+        if (profile_.maximized)
+            display_->setWindowMaximized();
+        else
+            display_->setWindowNormal();
+    }
 
     if (profile_.fullscreen != display_->isFullScreen())
         display_->toggleFullScreen();
 
     terminal_.setRefreshRate(display_->refreshRate());
-    display_->setScreenSize(display_->pixelSize() / display_->cellSize());
-    display_->setFonts(profile_.fonts);
+
+    // Reloading fonts flushes all glyph caches, so it is avoided where possible.
+    if (!_previousProfile || fontsChanged(_previousProfile->fonts, profile_.fonts))
+    {
+        display_->setScreenSize(display_->pixelSize() / display_->cellSize());
+        display_->setFonts(profile_.fonts);
+    }
     // TODO: maybe update margin after this call?
 
     display_->setHyperlinkDecoration(profile_.hyperlinkDecoration.normal,
@@ -796,6 +1148,17 @@ void TerminalSession::configureDisplay()
 
 }
 
+void TerminalSession::exportVTMetrics(string const& _path)
+{
+    // The counters may be read without holding the terminal lock.
+    auto const metrics = terminal_.screen().metrics().dump();
+    ofstream ofs{ _path, ios::trunc | ios::binary };
+    if (ofs.good())
+        ofs << metrics;
+    else
+        debuglog(WidgetTag).write("Failed to export VT metrics to {}.", _path);
+}
+
 void TerminalSession::setFontSize(text::font_size _size)
 {
     if (!display_->setFontSize(_size))
@@ -864,7 +1227,9 @@ bool TerminalSession::resetConfig()
 void TerminalSession::followHyperlink(terminal::HyperlinkInfo const& _hyperlink)
 {
     auto const fileInfo = QFileInfo(QString::fromStdString(string(_hyperlink.path())));
-    auto const isLocal = _hyperlink.isLocal() && _hyperlink.host() == QHostInfo::localHostName().toStdString();
+    // File URLs without a host, such as of file paths detected in the text, refer to the local host.
+    auto const isLocal = _hyperlink.isLocal()
+                      && (_hyperlink.host().empty() || _hyperlink.host() == QHostInfo::localHostName().toStdString());
     auto const editorEnv = getenv("EDITOR");
 
     if (isLocal && fileInfo.isFile() && fileInfo.isExecutable())
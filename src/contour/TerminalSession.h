@@ -16,6 +16,7 @@
 #include <contour/Config.h>
 #include <contour/TerminalDisplay.h>
 #include <contour/FileChangeWatcher.h>
+#include <contour/LatencyTest.h>
 
 #include <terminal/Terminal.h>
 
@@ -23,7 +24,12 @@
 
 #include <crispy/point.h>
 
+#include <atomic>
 #include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace contour {
 
@@ -55,6 +61,17 @@ class TerminalSession: public terminal::Terminal::Events
 
     void start();
 
+    /// @returns the number identifying this session within the process, starting at 1.
+    unsigned id() const noexcept { return id_; }
+
+    /// @returns all live sessions of this process, in the order they were created.
+    /// Must only be invoked on the GUI thread.
+    static std::vector<TerminalSession*> const& sessions() noexcept;
+
+    /// @returns this session's performance statistics as a JSON object, as served by
+    /// the ControlServer. Must only be invoked on the GUI thread.
+    std::string statsJson();
+
     config::Config const& config() const noexcept { return config_; }
     config::TerminalProfile const& profile() const noexcept { return profile_; }
 
@@ -68,12 +85,19 @@ class TerminalSession: public terminal::Terminal::Events
     void setDisplay(std::unique_ptr<TerminalDisplay> _display);
     void displayInitialized();
 
+    /// Invoked by the display on the GUI thread after presenting a frame,
+    /// showing PTY output read at @p _outputTime unless unset.
+    void framePresented(std::chrono::steady_clock::time_point _outputTime,
+                        std::chrono::steady_clock::time_point _now);
+
     // Terminal::Events
     //
     void requestCaptureBuffer(int _absoluteStartLine, int _lineCount) override;
     void bell() override;
     void bufferChanged(terminal::ScreenType) override;
     void renderBufferUpdated() override;
+    void memoryTrimmed() override;
+    void inputCongestionChanged(bool _congested) override;
     void screenUpdated() override;
     terminal::FontDef getFontDef() override;
     void setFontDef(terminal::FontDef const& _fontSpec) override;
@@ -86,6 +110,7 @@ class TerminalSession: public terminal::Terminal::Events
     void setWindowTitle(std::string_view _title) override;
     void setTerminalProfile(std::string const& _configProfileName) override;
     void discardImage(terminal::Image const&) override;
+    bool permitSharedImage() override;
 
     // Input Events
     using Timestamp = std::chrono::steady_clock::time_point;
@@ -103,6 +128,11 @@ class TerminalSession: public terminal::Terminal::Events
     void operator()(actions::CopySelection);
     void operator()(actions::DecreaseFontSize);
     void operator()(actions::DecreaseOpacity);
+    void operator()(actions::DumpAllocationStats);
+    void operator()(actions::DumpLatencyStats);
+    void operator()(actions::DumpMemoryUsage);
+    void operator()(actions::DumpRenderStats);
+    void operator()(actions::DumpVTMetrics);
     void operator()(actions::FollowHyperlink);
     void operator()(actions::IncreaseFontSize);
     void operator()(actions::IncreaseOpacity);
@@ -153,11 +183,31 @@ class TerminalSession: public terminal::Terminal::Events
     void onConfigReload(FileChangeWatcher::Event _event);
     void setDefaultCursor();
     config::TerminalProfile& profile() noexcept { return profile_; }
-    void configureTerminal();
-    void configureDisplay();
+
+    /// Applies the configuration and current profile to the terminal, or with respect to
+    /// the profile, only what differs from @p _previousProfile if given.
+    void configureTerminal(config::TerminalProfile const* _previousProfile = nullptr);
+
+    /// Applies the current profile to the display, or only what differs from
+    /// @p _previousProfile if given, sparing reloading fonts if they did not change.
+    void configureDisplay(config::TerminalProfile const* _previousProfile = nullptr);
+
+    void exportVTMetrics(std::string const& _path);
+
+    /// Posts deliverDisplayUpdates() to the GUI thread, unless already pending.
+    /// Must be invoked with displayUpdatesLock_ held.
+    void postDisplayUpdates();
+
+    /// Applies the display updates requested since the last call, on the GUI thread.
+    void deliverDisplayUpdates();
+
+    /// Extracts the selection's text in the background, see Terminal::extractSelectionTextAsync(),
+    /// calling @p _done with the whole text from the extracting thread once complete.
+    void extractSelectionText(std::function<void(std::string)> _done);
 
     // private data
     //
+    unsigned id_ = 0;
     config::Config config_;
     std::string profileName_;
     config::TerminalProfile profile_;
@@ -169,11 +219,31 @@ class TerminalSession: public terminal::Terminal::Events
     std::unique_ptr<TerminalDisplay> display_;
 
     std::optional<FileChangeWatcher> configFileChangeWatcher_;
+    std::unique_ptr<LatencyTest> latencyTest_;  // see Config::latencyTestSamples
 
     // state vars
     //
     terminal::ScreenType currentScreenType_ = terminal::ScreenType::Main;
     bool allowKeyMappings_ = true;
+
+    /// The user's answer to whether shared images are permitted, if asked already.
+    enum class SharedImagePermission { Unknown, Asking, Allowed, Denied };
+    std::atomic<SharedImagePermission> sharedImagePermission_ = SharedImagePermission::Unknown;
+    std::chrono::steady_clock::time_point lastVTMetricsExport_ = std::chrono::steady_clock::now();
+
+    /// Display updates requested by the terminal's thread, not yet delivered to the GUI thread.
+    ///
+    /// Each kind only keeps its latest value, e.g. the most recent window title of a shell
+    /// setting it on every prompt, and all of them are delivered by a single posted event.
+    struct DisplayUpdates {
+        std::optional<std::string> windowTitle;
+        std::optional<terminal::ScreenType> screenType;
+        std::optional<bool> inputCongested;
+        bool posted = false;                // whether deliverDisplayUpdates() is pending
+    };
+    std::mutex displayUpdatesLock_;
+    DisplayUpdates displayUpdates_;
+    bool inputCongested_ = false;           // as delivered to the display, see setDefaultCursor()
 };
 
 }
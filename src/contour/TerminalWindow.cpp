@@ -16,6 +16,7 @@
 #include <contour/TerminalWindow.h>
 #include <contour/helper.h>
 
+#include <contour/opengl/TerminalSurface.h>
 #include <contour/opengl/TerminalWidget.h>
 
 #include <qnamespace.h>
@@ -30,6 +31,7 @@
 #endif
 
 #include <crispy/debuglog.h>
+#include <crispy/trace.h>
 
 #include <QtCore/QDebug>
 #include <QtGui/QScreen>
@@ -44,6 +46,7 @@
 
 #include <cstring>
 #include <fstream>
+#include <optional>
 #include <stdexcept>
 
 using namespace std;
@@ -123,16 +126,14 @@ void ScrollableDisplay::updateValues()
     if (!scrollBar_->isVisible())
         return;
 
-    scrollBar_->setMaximum(session_.terminal().screen().historyLineCount());
-    if (auto const s = session_.terminal().viewport().absoluteScrollOffset(); s.has_value())
-        scrollBar_->setValue(s.value());
-    else
-        scrollBar_->setValue(scrollBar_->maximum());
+    auto const state = session_.terminal().viewState();
+    scrollBar_->setMaximum(state.historyLineCount);
+    scrollBar_->setValue(state.absoluteScrollOffset());
 }
 
 void ScrollableDisplay::updatePosition()
 {
-    //terminalWidget_->setGeometry(calculateWidgetGeometry());
+    //displayWidget_->setGeometry(calculateWidgetGeometry());
     debuglog(WindowTag).write("called with {}x{} in {}", width(), height(),
             session_.currentScreenType());
 
@@ -185,7 +186,8 @@ void ScrollableDisplay::onValueChanged()
 }
 #endif // }}}
 
-TerminalWindow::TerminalWindow(config::Config _config, bool _liveConfig, string _profileName, string _programPath) :
+TerminalWindow::TerminalWindow(config::Config _config, bool _liveConfig, string _profileName, string _programPath,
+                               unique_ptr<terminal::Pty> _pty) :
     config_{ std::move(_config) },
     liveConfig_{ _liveConfig },
     profileName_{ std::move(_profileName) },
@@ -202,11 +204,19 @@ TerminalWindow::TerminalWindow(config::Config _config, bool _liveConfig, string
     setAttribute(Qt::WA_TranslucentBackground);
     setAttribute(Qt::WA_NoSystemBackground, false);
 
-    terminalSession_ = make_unique<TerminalSession>(
-        make_unique<terminal::PtyProcess>(
+    auto pty = [&]() -> unique_ptr<terminal::Pty> {
+        if (_pty)
+            return std::move(_pty);
+        auto const _trace = crispy::trace_scope("shell spawning");
+        return make_unique<terminal::PtyProcess>(
             config_.profile(profileName_)->shell,
             config_.profile(profileName_)->terminalSize
-        ),
+        );
+    }();
+
+    auto trace = std::optional<crispy::trace_scope>("session creation");
+    terminalSession_ = make_unique<TerminalSession>(
+        std::move(pty),
         config_,
         liveConfig_,
         profileName_,
@@ -223,26 +233,49 @@ TerminalWindow::TerminalWindow(config::Config _config, bool _liveConfig, string
         }
     );
 
-    terminalSession_->setDisplay(make_unique<opengl::TerminalWidget>(
-        *config_.profile(profileName_),
-        *terminalSession_,
-        [this]() { centralWidget()->updateGeometry(); update(); },
-        [this](bool _enable) { WindowBackgroundBlur::setEnabled(winId(), _enable); }
-    ));
-    terminalWidget_ = static_cast<opengl::TerminalWidget*>(terminalSession_->display());
+    trace.emplace("display creation");
+    auto adaptSize = [this]() { centralWidget()->updateGeometry(); update(); };
+    auto enableBackgroundBlur = [this](bool _enable) { WindowBackgroundBlur::setEnabled(winId(), _enable); };
+    QObject* display = nullptr;
+    if (config_.experimentalFeatures.count("window_surface"))
+    {
+        // Rendered straight into a native child window, hosted by a container widget.
+        terminalSession_->setDisplay(make_unique<opengl::TerminalSurface>(
+            *config_.profile(profileName_),
+            *terminalSession_,
+            adaptSize,
+            enableBackgroundBlur
+        ));
+        auto* surface = static_cast<opengl::TerminalSurface*>(terminalSession_->display());
+        display = surface;
+        displayWidget_ = new opengl::TerminalSurfaceContainer(*surface);
+    }
+    else
+    {
+        terminalSession_->setDisplay(make_unique<opengl::TerminalWidget>(
+            *config_.profile(profileName_),
+            *terminalSession_,
+            adaptSize,
+            enableBackgroundBlur
+        ));
+        auto* widget = static_cast<opengl::TerminalWidget*>(terminalSession_->display());
+        display = widget;
+        displayWidget_ = widget;
+    }
+    trace.reset();
 
-    connect(terminalWidget_, SIGNAL(terminated()), this, SLOT(onTerminalClosed()));
-    connect(terminalWidget_, SIGNAL(terminalBufferChanged(terminal::ScreenType)), this, SLOT(terminalBufferChanged(terminal::ScreenType)));
+    connect(display, SIGNAL(terminated()), this, SLOT(onTerminalClosed()));
+    connect(display, SIGNAL(terminalBufferChanged(terminal::ScreenType)), this, SLOT(terminalBufferChanged(terminal::ScreenType)));
 
 #if defined(CONTOUR_SCROLLBAR)
-    scrollableDisplay_ = new ScrollableDisplay(nullptr, *terminalSession_, terminalWidget_);
+    scrollableDisplay_ = new ScrollableDisplay(nullptr, *terminalSession_, displayWidget_);
     setCentralWidget(scrollableDisplay_);
-    connect(terminalWidget_, SIGNAL(terminalBufferUpdated()), scrollableDisplay_, SLOT(updateValues()));
+    connect(display, SIGNAL(terminalBufferUpdated()), scrollableDisplay_, SLOT(updateValues()));
 #else
-    setCentralWidget(terminalWidget_);
+    setCentralWidget(displayWidget_);
 #endif
 
-    terminalWidget_->setFocus();
+    displayWidget_->setFocus();
 
     //statusBar()->showMessage("blurb");
 
@@ -78,7 +78,9 @@ class TerminalWindow :
     Q_OBJECT
 
   public:
-    TerminalWindow(config::Config _config, bool _liveConfig, std::string _profileName, std::string _programPath);
+    /// @param _pty  an already started shell to use (see SessionPool), or nullptr to start a new one.
+    TerminalWindow(config::Config _config, bool _liveConfig, std::string _profileName, std::string _programPath,
+                   std::unique_ptr<terminal::Pty> _pty = {});
 
     bool event(QEvent* _event) override;
     void resizeEvent(QResizeEvent* _event) override;
@@ -104,7 +106,7 @@ class TerminalWindow :
 #endif
 
     std::unique_ptr<TerminalSession> terminalSession_;
-    opengl::TerminalWidget* terminalWidget_ = nullptr;
+    QWidget* displayWidget_ = nullptr;      // the terminal display, or its container
 };
 
 } // namespace contour
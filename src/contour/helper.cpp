@@ -17,6 +17,8 @@
 #include <terminal/Terminal.h>
 #include <terminal_renderer/Renderer.h>
 
+#include <crispy/trace.h>
+
 #include <QtCore/QString>
 #include <QtCore/QStringList>
 #include <QtCore/QUrl>
@@ -26,15 +28,20 @@
 
 #include <array>
 #include <algorithm>
+#include <fstream>
+#include <iostream>
 #include <mutex>
 
 using std::array;
+using std::cerr;
 using std::chrono::steady_clock;
 using std::get;
 using std::holds_alternative;
 using std::max;
 using std::monostate;
+using std::move;
 using std::nullopt;
+using std::ofstream;
 using std::optional;
 using std::pair;
 using std::scoped_lock;
@@ -196,6 +203,11 @@ void sendMouseReleaseEvent(QMouseEvent* _event, TerminalSession& _session)
 }
 
 void sendMouseMoveEvent(QMouseEvent* _event, TerminalSession& _session)
+{
+    _session.sendMouseMoveEvent(makeMouseMoveEvent(_event, _session), steady_clock::now());
+}
+
+terminal::MouseMoveEvent makeMouseMoveEvent(QMouseEvent* _event, TerminalSession const& _session)
 {
     auto constexpr MarginTop = 0;
     auto constexpr MarginLeft = 0;
@@ -203,9 +215,7 @@ void sendMouseMoveEvent(QMouseEvent* _event, TerminalSession& _session)
     auto const cellSize = _session.display()->cellSize();
     auto const row = int{1 + (max(_event->y(), 0) - MarginTop) /  cellSize.height};
     auto const col = int{1 + (max(_event->x(), 0) - MarginLeft) / cellSize.width};
-    auto const mouseEvent = terminal::MouseMoveEvent{row, col, makeModifier(_event->modifiers())};
-
-    _session.sendMouseMoveEvent(mouseEvent, steady_clock::now());
+    return terminal::MouseMoveEvent{row, col, makeModifier(_event->modifiers())};
 }
 
 void spawnNewTerminal(string const& _programPath,
@@ -340,14 +350,20 @@ bool applyFontDescription(Size _cellSize,
                           terminal::renderer::Renderer& _renderer,
                           terminal::renderer::FontDescriptions _fontDescriptions)
 {
+    if (_fontDescriptions.dpi == Zero<Point>)
+        _fontDescriptions.dpi = _screenDPI;
+
     if (_renderer.fontDescriptions() == _fontDescriptions)
-        return false;
+    {
+        // Changing the DPI alone keeps the glyphs of the previous one.
+        if (!_renderer.setDpi(_fontDescriptions.dpi))
+            return false;
+        _renderer.setMargin(computeMargin(_renderer.gridMetrics().cellSize, _screenSize, _pixelSize));
+        return true;
+    }
 
     auto const windowMargin = computeMargin(_cellSize, _screenSize, _pixelSize);
 
-    if (_fontDescriptions.dpi == Zero<Point>)
-        _fontDescriptions.dpi = _screenDPI;
-
     _renderer.setFonts(_fontDescriptions);
     _renderer.setMargin(windowMargin);
     _renderer.updateFontMetrics();
@@ -355,4 +371,39 @@ bool applyFontDescription(Size _cellSize,
     return true;
 }
 
+namespace
+{
+    string startupTraceDestination;
+    steady_clock::time_point startupTime;
+}
+
+void startStartupTrace(string _destination)
+{
+    startupTraceDestination = move(_destination);
+    startupTime = steady_clock::now();
+    crispy::trace_recorder::get().enable(true);
+}
+
+void finishStartupTrace()
+{
+    auto& recorder = crispy::trace_recorder::get();
+    if (!recorder.enabled())
+        return;
+
+    recorder.record("startup", startupTime, steady_clock::now());
+    recorder.enable(false);
+
+    if (startupTraceDestination == "-")
+    {
+        cerr << recorder.table();
+        return;
+    }
+
+    auto out = ofstream(startupTraceDestination, std::ios::trunc);
+    if (out.good())
+        out << recorder.trace_events();
+    else
+        cerr << "Failed to write startup trace to " << startupTraceDestination << ".\n";
+}
+
 } // end namespace
@@ -52,6 +52,7 @@ enum class MouseCursorShape
     PointingHand,
     IBeam,
     Arrow,
+    Busy,
 };
 
 template <typename F>
@@ -148,6 +149,7 @@ bool sendKeyEvent(QKeyEvent* _keyEvent, TerminalSession& _session);
 void sendWheelEvent(QWheelEvent* _event, TerminalSession& _session);
 void sendMousePressEvent(QMouseEvent* _event, TerminalSession& _session);
 void sendMouseMoveEvent(QMouseEvent* _event, TerminalSession& _session);
+terminal::MouseMoveEvent makeMouseMoveEvent(QMouseEvent* _event, TerminalSession const& _session);
 void sendMouseReleaseEvent(QMouseEvent* _event, TerminalSession& _session);
 
 void spawnNewTerminal(std::string const& _programPath,
@@ -186,6 +188,14 @@ bool applyFontDescription(
     terminal::renderer::Renderer& _renderer,
     terminal::renderer::FontDescriptions _fontDescriptions);
 
+/// Starts recording the phases of starting up (see crispy::trace_recorder), to be written
+/// to @p _destination once the first frame has been presented, as Chrome trace events,
+/// or as a table to standard error if @p _destination is "-".
+void startStartupTrace(std::string _destination);
+
+/// Writes the startup trace, if being recorded, and stops recording.
+void finishStartupTrace();
+
 constexpr Qt::CursorShape toQtMouseShape(MouseCursorShape _shape)
 {
     switch (_shape)
@@ -198,6 +208,8 @@ constexpr Qt::CursorShape toQtMouseShape(MouseCursorShape _shape)
             return Qt::CursorShape::IBeamCursor;
         case contour::MouseCursorShape::PointingHand:
             return Qt::CursorShape::PointingHandCursor;
+        case contour::MouseCursorShape::Busy:
+            return Qt::CursorShape::BusyCursor;
     }
 
     // should never be reached
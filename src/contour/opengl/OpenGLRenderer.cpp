@@ -12,20 +12,36 @@
  * limitations under the License.
  */
 #include <contour/opengl/OpenGLRenderer.h>
+#include <contour/opengl/RenderPassTimer.h>
+#include <contour/opengl/ScreenshotReader.h>
 #include <contour/opengl/ShaderConfig.h>
+#include <contour/opengl/StreamingBuffer.h>
 
 #include <terminal_renderer/Atlas.h>
 
 #include <crispy/algorithm.h>
+#include <crispy/bc3.h>
+#include <crispy/profiler.h>
+#include <crispy/thread_pool.h>
 #include <crispy/utils.h>
 
 #include <range/v3/all.hpp>
 
+#include <QtGui/QOpenGLContext>
+#include <QtGui/QVector2D>
+#include <QtGui/QVector4D>
+
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 #include <utility>
 
 using crispy::Size;
+using std::max;
 using std::min;
 using std::optional;
 using std::nullopt;
@@ -33,6 +49,10 @@ using std::pair;
 using std::string;
 using std::vector;
 
+#if !defined(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
 namespace terminal::renderer::opengl {
 
 #if !defined(NDEBUG)
@@ -59,10 +79,29 @@ namespace // {{{ helper
                 return GL_RGB;
             case atlas::Format::Red:
                 return GL_RED;
+            case atlas::Format::CompressedRGBA:
+                return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
         }
         return GL_RED;
     }
 
+    /// @returns the number of bytes of a compressed texture of the given size.
+    GLsizei compressedSize(Size _size)
+    {
+        return static_cast<GLsizei>(crispy::bc3::encodedSize(_size.width, _size.height));
+    }
+
+    /// Discards the contents and storage of @p _vector, which must be done before its arena is reset.
+    ///
+    /// @returns the capacity it had, to be reserved again from the reset arena.
+    template <typename T>
+    size_t discard(crispy::arena_vector<T>& _vector)
+    {
+        auto const capacity = _vector.capacity();
+        _vector = crispy::arena_vector<T>(_vector.get_allocator());
+        return capacity;
+    }
+
     QMatrix4x4 ortho(float left, float right, float bottom, float top)
     {
         constexpr float nearPlane = -1.0f;
@@ -77,47 +116,108 @@ namespace // {{{ helper
 constexpr int MaxMonochromeTextureSize = 1024;
 constexpr int MaxColorTextureSize = 2048;
 constexpr int MaxInstanceCount = 24;
+constexpr size_t AtlasMemoryBudget = 64 * 1024 * 1024; // GPU memory per atlas allocator, in bytes
+constexpr size_t StreamingRegionSize = 1024 * 1024; // initial bytes of vertex data per frame
+constexpr size_t UploadBudget = 4 * 1024 * 1024; // bytes of texture data to upload per frame, at least one texture
+constexpr size_t RectVertexSize = 7 * sizeof(GLfloat);
+constexpr int GridTextureUnit = 3; // next to the texture arrays of the three atlas users
+constexpr size_t GridCellSize = 8; // number of 32 bit integers per cell
+constexpr int PaletteTextureUnit = 4; // next to the cell grid's
+constexpr GLuint PaletteColorTag = 0x01; // alpha of a packed color referring to a palette slot instead
+static_assert(MaxInstanceCount <= 0xFF, "Texture array layers must fit the 8 bits the cell grid reserves for them.");
 
 struct OpenGLRenderer::TextureScheduler : public atlas::AtlasBackend
 {
+    /// Everything the text shader needs to know to render one texture.
+    ///
+    /// The quad's four vertices are derived from this in the vertex shader,
+    /// by stretching the static unit quad instead of uploading them each frame.
+    struct Instance
+    {
+        GLfloat x, y, z;                    // window coordinates of the bottom left corner
+        GLfloat width, height;              // size on the window
+        GLfloat rx, ry, rw, rh;             // relative atlas coordinates of the texture
+        GLfloat user;                       // selects which texture array to sample from
+        GLfloat layer;                      // layer of the texture array holding the atlas page
+        std::array<GLubyte, 4> color;       // RGBA, normalized
+    };
+
     struct RenderBatch
     {
-        std::vector<atlas::RenderTexture> renderTextures;
-        std::vector<GLfloat> buffer;
-        int user = 0;
+        explicit RenderBatch(crispy::frame_arena& _arena):
+            renderTextures{ crispy::arena_allocator<atlas::RenderTexture>{_arena} },
+            instances{ crispy::arena_allocator<Instance>{_arena} }
+        {}
+
+        crispy::arena_vector<atlas::RenderTexture> renderTextures;
+        crispy::arena_vector<Instance> instances;
 
         void clear()
         {
             renderTextures.clear();
-            buffer.clear();
+            instances.clear();
         }
     };
 
-    std::vector<atlas::CreateAtlas> createAtlases;
-    std::vector<atlas::UploadTexture> uploadTextures;
-    std::vector<RenderBatch> renderBatches;
-    std::vector<atlas::AtlasID> destroyAtlases;
+    explicit TextureScheduler(crispy::frame_arena& _arena):
+        createAtlases{ crispy::arena_allocator<atlas::CreateAtlas>{_arena} },
+        uploadTextures{ crispy::arena_allocator<atlas::UploadTexture>{_arena} },
+        renderBatch{ _arena },
+        destroyAtlases{ crispy::arena_allocator<atlas::AtlasID>{_arena} }
+    {}
+
+    // Everything scheduled for the next frame, allocated from the frame arena.
+    crispy::arena_vector<atlas::CreateAtlas> createAtlases;
+    crispy::arena_vector<atlas::UploadTexture> uploadTextures;
+    RenderBatch renderBatch;    // all atlases are sampled from in a single draw call
+    crispy::arena_vector<atlas::AtlasID> destroyAtlases;
+
+    struct AtlasLayer
+    {
+        int user;
+        int layer;
+    };
 
-    std::list<int> atlasIDs_;
-    std::list<int> unusedAtlasIDs_;
+    std::unordered_map<atlas::AtlasID, AtlasLayer> atlasLayers_;    // maps atlas IDs to texture array layers
+    std::unordered_map<int, std::vector<int>> unusedLayers_;        // released layers, per user
+    std::unordered_map<int, int> layerCount_;                       // number of layers ever allocated, per user
     int nextAtlasID_ = 0;
 
     atlas::AtlasID allocateAtlasID(int _user)
     {
-        // The allocated atlas ID is not the OpenGL texture ID but
-        // an internal one that is used to reference into renderBatches, but
-        // can be used to map to OpenGL texture IDs.
+        // The allocated atlas ID is not the OpenGL texture ID but an internal one
+        // that maps to a layer of the texture array that belongs to the given user.
+        // The layer is assigned right away, as instances referencing it may be
+        // scheduled before the atlas is actually created on the GPU.
 
         auto const id = atlas::AtlasID{nextAtlasID_++};
-        atlasIDs_.push_back(id.value);
-        if (renderBatches.size() <= static_cast<size_t>(id.value))
-            renderBatches.resize(id.value + 10);
 
-        renderBatches[id.value].user = _user;
+        auto& unusedLayers = unusedLayers_[_user];
+        if (!unusedLayers.empty())
+        {
+            atlasLayers_[id] = AtlasLayer{_user, unusedLayers.back()};
+            unusedLayers.pop_back();
+        }
+        else
+            atlasLayers_[id] = AtlasLayer{_user, layerCount_[_user]++};
 
         return id;
     }
 
+    AtlasLayer atlasLayer(atlas::AtlasID _atlasID) const
+    {
+        return atlasLayers_.at(_atlasID);
+    }
+
+    void releaseAtlasID(atlas::AtlasID _atlasID)
+    {
+        if (auto const i = atlasLayers_.find(_atlasID); i != atlasLayers_.end())
+        {
+            unusedLayers_[i->second.user].push_back(i->second.layer);
+            atlasLayers_.erase(i);
+        }
+    }
+
     atlas::AtlasID createAtlas(Size _size, atlas::Format _format, int _user) override
     {
         auto const id = allocateAtlasID(_user);
@@ -133,53 +233,63 @@ struct OpenGLRenderer::TextureScheduler : public atlas::AtlasBackend
     void renderTexture(atlas::RenderTexture _render) override
     {
         // This is factored out of renderTexture() to make sure it's not writing to anything else
-        addRenderTextureToBatch(_render, renderBatches.at(_render.texture.get().atlas.value));
-    }
-
-    static void addRenderTextureToBatch(atlas::RenderTexture _render, RenderBatch& _batch)
-    {
-        // Vertices
-        GLfloat const x = _render.x;
-        GLfloat const y = _render.y;
-        GLfloat const z = _render.z;
-      //GLfloat const w = _render.w;
-        GLfloat const r = _render.texture.get().targetSize.width;
-        GLfloat const s = _render.texture.get().targetSize.height;
-
-        // TexCoords
-        GLfloat const rx = _render.texture.get().relativeX;
-        GLfloat const ry = _render.texture.get().relativeY;
-        GLfloat const w = _render.texture.get().relativeWidth;
-        GLfloat const h = _render.texture.get().relativeHeight;
-        GLfloat const i = 0; // _render.texture.get().z;
-        GLfloat const u = _render.texture.get().user;
-
-        // color
-        GLfloat const cr = _render.color[0];
-        GLfloat const cg = _render.color[1];
-        GLfloat const cb = _render.color[2];
-        GLfloat const ca = _render.color[3];
-
-        GLfloat const vertices[6 * 11] = {
-            // first triangle
-        // <X      Y      Z> <X       Y       I  U>  <R   G   B   A>
-            x,     y + s, z,  rx,     ry + h, i, u,  cr, cg, cb, ca, // left top
-            x,     y,     z,  rx,     ry,     i, u,  cr, cg, cb, ca, // left bottom
-            x + r, y,     z,  rx + w, ry,     i, u,  cr, cg, cb, ca, // right bottom
-
-            // second triangle
-            x,     y + s, z,  rx,     ry + h, i, u,  cr, cg, cb, ca, // left top
-            x + r, y,     z,  rx + w, ry,     i, u,  cr, cg, cb, ca, // right bottom
-            x + r, y + s, z,  rx + w, ry + h, i, u,  cr, cg, cb, ca, // right top
-
-            // buffer contains
-            // - 3 vertex coordinates (XYZ)
-            // - 4 texture coordinates (XYIU), I is unused currently, U selects which texture to use
-            // - 4 color values (RGBA)
+        addRenderTextureToBatch(_render, atlasLayer(_render.texture.get().atlas).layer, renderBatch);
+    }
+
+    static void addRenderTextureToBatch(atlas::RenderTexture _render, int _layer, RenderBatch& _batch)
+    {
+        auto const& texture = _render.texture.get();
+        auto const normalized = [](float _value) {
+            return static_cast<GLubyte>(std::clamp(_value, 0.0f, 1.0f) * 255.0f + 0.5f);
         };
 
+        auto targetWidth = static_cast<GLfloat>(texture.targetSize.width) * _render.scale;
+        auto targetHeight = static_cast<GLfloat>(texture.targetSize.height) * _render.scale;
+        auto rx = texture.relativeX;
+        auto ry = texture.relativeY;
+        auto rw = texture.relativeWidth;
+        auto rh = texture.relativeHeight;
+
+        // Only a part of the bitmap is rendered when given a source area,
+        // which is scaled the same way as the whole bitmap is onto its target size.
+        if (auto const& source = _render.sourceSize; source.width && source.height)
+        {
+            auto const bitmapWidth = static_cast<GLfloat>(texture.bitmapSize.width);
+            auto const bitmapHeight = static_cast<GLfloat>(texture.bitmapSize.height);
+            targetWidth *= static_cast<GLfloat>(source.width) / bitmapWidth;
+            targetHeight *= static_cast<GLfloat>(source.height) / bitmapHeight;
+            rx += rw * static_cast<GLfloat>(_render.sourceOffset.x) / bitmapWidth;
+            ry += rh * static_cast<GLfloat>(_render.sourceOffset.y) / bitmapHeight;
+            rw *= static_cast<GLfloat>(source.width) / bitmapWidth;
+            rh *= static_cast<GLfloat>(source.height) / bitmapHeight;
+        }
+
+        if (auto const& target = _render.targetSize; target.width && target.height)
+        {
+            targetWidth = static_cast<GLfloat>(target.width);
+            targetHeight = static_cast<GLfloat>(target.height);
+        }
+
         _batch.renderTextures.emplace_back(_render);
-        crispy::copy(vertices, back_inserter(_batch.buffer));
+        _batch.instances.emplace_back(Instance{
+            static_cast<GLfloat>(_render.x),
+            static_cast<GLfloat>(_render.y),
+            static_cast<GLfloat>(_render.z),
+            targetWidth,
+            targetHeight,
+            rx,
+            ry,
+            rw,
+            rh,
+            static_cast<GLfloat>(texture.user),
+            static_cast<GLfloat>(_layer),
+            {
+                normalized(_render.color[0]),
+                normalized(_render.color[1]),
+                normalized(_render.color[2]),
+                normalized(_render.color[3])
+            }
+        });
     }
 
     void destroyAtlas(atlas::AtlasID _atlas) override
@@ -203,8 +313,11 @@ inline void bound(T& _bindable, Fn&& _callable)
 
 OpenGLRenderer::OpenGLRenderer(ShaderConfig const& _textShaderConfig,
                                ShaderConfig const& _rectShaderConfig,
+                               ShaderConfig const& _decorationShaderConfig,
+                               ShaderConfig const& _gridShaderConfig,
                                Size _size,
-                               terminal::renderer::PageMargin _margin):
+                               terminal::renderer::PageMargin _margin,
+                               bool _compressColorTextures):
     size_{ _size },
     projectionMatrix_{ortho(
         0.0f, float(_size.width),      // left, right
@@ -213,12 +326,14 @@ OpenGLRenderer::OpenGLRenderer(ShaderConfig const& _textShaderConfig,
     margin_{ _margin },
     textShader_{ createShader(_textShaderConfig) },
     textProjectionLocation_{ textShader_->uniformLocation("vs_projection") },
+    textDistanceFieldLocation_{ textShader_->uniformLocation("fs_distanceField") },
     // texture
-    textureScheduler_{std::make_unique<TextureScheduler>()},
+    maxTextureLayers_{ min(MaxInstanceCount, maxTextureDepth()) },
+    textureScheduler_{std::make_unique<TextureScheduler>(frameArena_)},
     monochromeAtlasAllocator_{
         *textureScheduler_,
         monochromeTextureSizeHint(),
-        MaxInstanceCount, // TODO: better runtime compute with max(x,y)
+        maxTextureLayers_,
         atlas::Format::Red,
         0,
         "monochromeAtlas",
@@ -226,25 +341,33 @@ OpenGLRenderer::OpenGLRenderer(ShaderConfig const& _textShaderConfig,
     coloredAtlasAllocator_{
         *textureScheduler_,
         colorTextureSizeHint(),
-        MaxInstanceCount, // TODO: better runtime compute with max(x,y)
-        atlas::Format::RGBA,
+        maxTextureLayers_,
+        colorTextureFormat(_compressColorTextures),
         1,
         "colorAtlas"
     },
     lcdAtlasAllocator_{
         *textureScheduler_,
         colorTextureSizeHint(),
-        MaxInstanceCount, // TODO: better runtime compute with max(x,y)
+        maxTextureLayers_,
         atlas::Format::RGB,
         2,
         "lcdAtlas",
     },
     // rect
     rectShader_{ createShader(_rectShaderConfig) },
-    rectProjectionLocation_{ rectShader_->uniformLocation("u_projection") }
+    rectProjectionLocation_{ rectShader_->uniformLocation("u_projection") },
+    // decoration
+    decorationShader_{ createShader(_decorationShaderConfig) },
+    decorationProjectionLocation_{ decorationShader_->uniformLocation("u_projection") },
+    // grid
+    gridShader_{ createShader(_gridShaderConfig) }
 {
     initialize();
 
+    for (atlas::TextureAtlasAllocator* allocator: allAtlasAllocators())
+        allocator->setMemoryBudget(AtlasMemoryBudget);
+
     setRenderSize(_size);
 
     assert(textProjectionLocation_ != -1);
@@ -263,6 +386,11 @@ OpenGLRenderer::OpenGLRenderer(ShaderConfig const& _textShaderConfig,
 
     initializeRectRendering();
     initializeTextureRendering();
+    initializeDecorationRendering();
+    initializeGridRendering();
+
+    screenshotReader_ = std::make_unique<ScreenshotReader>(*this);
+    passTimer_ = std::make_unique<RenderPassTimer>();
 }
 
 crispy::Size OpenGLRenderer::colorTextureSizeHint()
@@ -273,6 +401,37 @@ crispy::Size OpenGLRenderer::colorTextureSizeHint()
     };
 }
 
+atlas::Format OpenGLRenderer::colorTextureFormat(bool _compress)
+{
+    if (!_compress)
+        return atlas::Format::RGBA;
+
+    initialize();
+
+    // Texture arrays grow by copying their layers over into larger storage, which, unlike
+    // for uncompressed textures, cannot be done via framebuffers but glCopyImageSubData() only.
+    auto const* context = QOpenGLContext::currentContext();
+    auto const version = context->format().version();
+    auto const copyImage = context->isOpenGLES()
+        ? version >= qMakePair(3, 2) || context->hasExtension("GL_EXT_copy_image") || context->hasExtension("GL_OES_copy_image")
+        : version >= qMakePair(4, 3) || context->hasExtension("GL_ARB_copy_image");
+    if (!context->hasExtension("GL_EXT_texture_compression_s3tc") || !copyImage)
+    {
+        debuglog(OpenGLRendererTag).write("Compressed textures not supported. Storing colored textures uncompressed.");
+        return atlas::Format::RGBA;
+    }
+
+    for (auto const* name: { "glCopyImageSubData", "glCopyImageSubDataEXT", "glCopyImageSubDataOES" })
+    {
+        copyImageSubData_ = reinterpret_cast<CopyImageSubData>(context->getProcAddress(name));
+        if (copyImageSubData_)
+            return atlas::Format::CompressedRGBA;
+    }
+
+    debuglog(OpenGLRendererTag).write("glCopyImageSubData() not found. Storing colored textures uncompressed.");
+    return atlas::Format::RGBA;
+}
+
 crispy::Size OpenGLRenderer::monochromeTextureSizeHint()
 {
     return Size{
@@ -317,65 +476,174 @@ atlas::AtlasBackend& OpenGLRenderer::textureScheduler()
 
 void OpenGLRenderer::initializeRectRendering()
 {
+    // Rectangles and texture instances share the same stream of per-frame vertex data.
+    streamingBuffer_ = std::make_unique<StreamingBuffer>(*this, GL_ARRAY_BUFFER, StreamingRegionSize);
+
     CHECKED_GL( glGenVertexArrays(1, &rectVAO_) );
     CHECKED_GL( glBindVertexArray(rectVAO_) );
 
-    CHECKED_GL( glGenBuffers(1, &rectVBO_) );
-    CHECKED_GL( glBindBuffer(GL_ARRAY_BUFFER, rectVBO_) );
-    CHECKED_GL( glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STREAM_DRAW) );
-
-    auto constexpr BufferStride = 7 * sizeof(GLfloat);
-    auto const VertexOffset = (void const*) (0 * sizeof(GLfloat));
-    auto const ColorOffset = (void const*) (3 * sizeof(GLfloat));
-
     // 0 (vec3): vertex buffer
-    CHECKED_GL( glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, BufferStride, VertexOffset) );
     CHECKED_GL( glEnableVertexAttribArray(0) );
 
     // 1 (vec4): color buffer
-    CHECKED_GL( glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, BufferStride, ColorOffset) );
     CHECKED_GL( glEnableVertexAttribArray(1) );
+
+    // The attributes are pointed into the streaming buffer right before drawing.
+    CHECKED_GL( glBindVertexArray(0) );
+}
+
+void OpenGLRenderer::bindRectAttributes(GLintptr _offset)
+{
+    auto const VertexOffset = (void const*) (_offset + 0 * sizeof(GLfloat));
+    auto const ColorOffset = (void const*) (_offset + 3 * sizeof(GLfloat));
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, RectVertexSize, VertexOffset);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, RectVertexSize, ColorOffset);
 }
 
 void OpenGLRenderer::initializeTextureRendering()
 {
+    // Texture data is staged in a pixel unpack buffer, so that glTexSubImage3D() does not
+    // have to copy it out of host memory before returning.
+    uploadBuffer_ = std::make_unique<StreamingBuffer>(*this, GL_PIXEL_UNPACK_BUFFER, UploadBudget);
+
     CHECKED_GL( glGenVertexArrays(1, &vao_) );
     CHECKED_GL( glBindVertexArray(vao_) );
 
-    auto constexpr BufferStride = (3 + 4 + 4) * sizeof(GLfloat);
-    auto constexpr VertexOffset = (void const*) 0;
-    auto const TexCoordOffset = (void const*) (3 * sizeof(GLfloat));
-    auto const ColorOffset = (void const*) (7 * sizeof(GLfloat));
+    // The unit quad, as triangle strip, that every instance is stretching over its target area.
+    static GLfloat const quadVertices[4 * 2] = {
+        0.0f, 0.0f, // left bottom
+        1.0f, 0.0f, // right bottom
+        0.0f, 1.0f, // left top
+        1.0f, 1.0f, // right top
+    };
 
-    CHECKED_GL( glGenBuffers(1, &vbo_) );
-    CHECKED_GL( glBindBuffer(GL_ARRAY_BUFFER, vbo_) );
-    CHECKED_GL( glBufferData(GL_ARRAY_BUFFER, 0/* sizeof(GLfloat) * 6 * 11 * 200 * 100*/, nullptr, GL_STREAM_DRAW) );
+    CHECKED_GL( glGenBuffers(1, &quadVBO_) );
+    CHECKED_GL( glBindBuffer(GL_ARRAY_BUFFER, quadVBO_) );
+    CHECKED_GL( glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW) );
 
-    // 0 (vec3): vertex buffer
-    CHECKED_GL( glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, BufferStride, VertexOffset) );
+    // 0 (vec2): quad corner
+    CHECKED_GL( glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), nullptr) );
     CHECKED_GL( glEnableVertexAttribArray(0) );
 
-    // 1 (vec3): texture coordinates buffer
-    CHECKED_GL( glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, BufferStride, TexCoordOffset) );
-    CHECKED_GL( glEnableVertexAttribArray(1) );
+    // The per-instance attributes are pointed into the streaming buffer right before drawing.
+    for (GLuint location = 1; location <= 5; ++location)
+    {
+        CHECKED_GL( glEnableVertexAttribArray(location) );
+        CHECKED_GL( glVertexAttribDivisor(location, 1) ); // advance once per instance
+    }
 
-    // 2 (vec4): color buffer
-    CHECKED_GL( glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, BufferStride, ColorOffset) );
-    CHECKED_GL( glEnableVertexAttribArray(2) );
+    CHECKED_GL( glBindVertexArray(0) );
+}
 
-    // setup EBO
-    // glGenBuffers(1, &ebo_);
-    // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-    // static const GLuint indices[6] = { 0, 1, 3, 1, 2, 3 };
-    // glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+void OpenGLRenderer::bindInstanceAttributes(GLintptr _offset)
+{
+    using Instance = TextureScheduler::Instance;
+
+    auto constexpr Stride = sizeof(Instance);
+    auto const OriginOffset = (void const*) (_offset + offsetof(Instance, x));
+    auto const SizeOffset = (void const*) (_offset + offsetof(Instance, width));
+    auto const TexCoordOffset = (void const*) (_offset + offsetof(Instance, rx));
+    auto const TextureSelectorOffset = (void const*) (_offset + offsetof(Instance, user));
+    auto const ColorOffset = (void const*) (_offset + offsetof(Instance, color));
+
+    // 1 (vec3): target origin
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, Stride, OriginOffset);
+    // 2 (vec2): target size
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, Stride, SizeOffset);
+    // 3 (vec4): relative texture coordinates (x, y, width, height)
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, Stride, TexCoordOffset);
+    // 4 (vec2): texture selector and texture array layer
+    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, Stride, TextureSelectorOffset);
+    // 5 (vec4): color, normalized from bytes
+    glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, Stride, ColorOffset);
+}
+
+void OpenGLRenderer::initializeDecorationRendering()
+{
+    CHECKED_GL( glGenVertexArrays(1, &decorationVAO_) );
+    CHECKED_GL( glBindVertexArray(decorationVAO_) );
+
+    // 0 (vec2): quad corner, of the same unit quad the texture instances are stretched from
+    CHECKED_GL( glBindBuffer(GL_ARRAY_BUFFER, quadVBO_) );
+    CHECKED_GL( glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), nullptr) );
+    CHECKED_GL( glEnableVertexAttribArray(0) );
 
-    //glVertexAttribDivisor(0, 1); // TODO: later for instanced rendering
+    // The per-instance attributes are pointed into the streaming buffer right before drawing.
+    for (GLuint location = 1; location <= 4; ++location)
+    {
+        CHECKED_GL( glEnableVertexAttribArray(location) );
+        CHECKED_GL( glVertexAttribDivisor(location, 1) ); // advance once per instance
+    }
+
+    CHECKED_GL( glBindVertexArray(0) );
+}
+
+void OpenGLRenderer::bindDecorationAttributes(GLintptr _offset)
+{
+    auto constexpr Stride = sizeof(DecorationInstance);
+    auto const RectOffset = (void const*) (_offset + offsetof(DecorationInstance, x));
+    auto const ColorOffset = (void const*) (_offset + offsetof(DecorationInstance, color));
+    auto const DecoratorOffset = (void const*) (_offset + offsetof(DecorationInstance, decorator));
+    auto const MetricsOffset = (void const*) (_offset + offsetof(DecorationInstance, cellWidth));
+
+    // 1 (vec4): target origin and size
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, Stride, RectOffset);
+    // 2 (vec4): color, normalized from bytes
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, Stride, ColorOffset);
+    // 3 (ivec2): decorator and baseline
+    glVertexAttribIPointer(3, 2, GL_INT, Stride, DecoratorOffset);
+    // 4 (ivec3): cell width, underline position and thickness
+    glVertexAttribIPointer(4, 3, GL_INT, Stride, MetricsOffset);
+}
+
+void OpenGLRenderer::initializeGridRendering()
+{
+    // The cell grid is optional, so a shader failing to compile merely disables it.
+    if (!gridShader_)
+        return;
+
+    bound(*gridShader_, [&]() {
+        CHECKED_GL( gridShader_->setUniformValue("u_cells", GridTextureUnit) );
+        CHECKED_GL( gridShader_->setUniformValue("u_palette", PaletteTextureUnit) );
+        CHECKED_GL( gridShader_->setUniformValue("u_monochromeTextures", monochromeAtlasAllocator_.user()) );
+        CHECKED_GL( gridShader_->setUniformValue("u_colorTextures", coloredAtlasAllocator_.user()) );
+        CHECKED_GL( gridShader_->setUniformValue("u_lcdTextures", lcdAtlasAllocator_.user()) );
+    });
+
+    CHECKED_GL( glGenVertexArrays(1, &gridVAO_) );
+    CHECKED_GL( glBindVertexArray(gridVAO_) );
+
+    // 0 (vec2): quad corner, stretched over the grid lines to render
+    CHECKED_GL( glBindBuffer(GL_ARRAY_BUFFER, quadVBO_) );
+    CHECKED_GL( glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), nullptr) );
+    CHECKED_GL( glEnableVertexAttribArray(0) );
+
+    CHECKED_GL( glBindVertexArray(0) );
 }
 
 OpenGLRenderer::~OpenGLRenderer()
 {
+    passTimer_.reset();
+    screenshotReader_.reset();
     CHECKED_GL( glDeleteVertexArrays(1, &rectVAO_) );
-    CHECKED_GL( glDeleteBuffers(1, &rectVBO_) );
+    CHECKED_GL( glDeleteVertexArrays(1, &decorationVAO_) );
+    if (gridVAO_)
+        CHECKED_GL( glDeleteVertexArrays(1, &gridVAO_) );
+    if (gridTexture_)
+        CHECKED_GL( glDeleteTextures(1, &gridTexture_) );
+    if (paletteTexture_)
+        CHECKED_GL( glDeleteTextures(1, &paletteTexture_) );
+    if (scrollFramebuffer_)
+        CHECKED_GL( glDeleteFramebuffers(1, &scrollFramebuffer_) );
+    if (scrollTexture_)
+        CHECKED_GL( glDeleteTextures(1, &scrollTexture_) );
+    CHECKED_GL( glDeleteVertexArrays(1, &vao_) );
+    CHECKED_GL( glDeleteBuffers(1, &quadVBO_) );
+    for (auto const& [user, textureArray]: textureArrays_)
+        CHECKED_GL( glDeleteTextures(1, &textureArray.textureId) );
+    streamingBuffer_.reset();
+    uploadBuffer_.reset();
 }
 
 void OpenGLRenderer::initialize()
@@ -392,6 +660,22 @@ void OpenGLRenderer::clearCache()
     monochromeAtlasAllocator_.clear();
     coloredAtlasAllocator_.clear();
     lcdAtlasAllocator_.clear();
+    pendingUploads_.clear();
+    pendingTextures_.clear();
+}
+
+void OpenGLRenderer::trimMemory()
+{
+    // Layers of destroyed atlases stay allocated on the GPU, but are reused by the next atlas.
+    monochromeAtlasAllocator_.releaseUnusedAtlases();
+    coloredAtlasAllocator_.releaseUnusedAtlases();
+    lcdAtlasAllocator_.releaseUnusedAtlases();
+
+    // Scheduled atlases may still be destroyed with this frame, so the arena is trimmed after it.
+    frameArenaTrimRequested_ = true;
+    decorations_.shrink_to_fit();
+    gridCells_.shrink_to_fit();
+    gridGlyphs_.shrink_to_fit();
 }
 
 int OpenGLRenderer::maxTextureDepth()
@@ -399,7 +683,7 @@ int OpenGLRenderer::maxTextureDepth()
     initialize();
 
     GLint value = {};
-    CHECKED_GL( glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &value) );
+    CHECKED_GL( glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &value) );
     return static_cast<int>(value);
 }
 
@@ -412,29 +696,39 @@ int OpenGLRenderer::maxTextureSize()
     return static_cast<int>(value);
 }
 
-void OpenGLRenderer::clearTextureAtlas(GLuint _textureId, int _width, int _height, atlas::Format _format)
+void OpenGLRenderer::clearTextureAtlas(TextureArray const& _array, int _layer)
 {
-    bindTexture(_textureId);
+    auto const width = _array.size.width;
+    auto const height = _array.size.height;
+    auto const format = _array.format;
 
-    auto constexpr target = GL_TEXTURE_2D;
+    auto constexpr target = GL_TEXTURE_2D_ARRAY;
     auto constexpr levelOfDetail = 0;
-    //auto constexpr depth = 1;
+    auto constexpr depth = 1;
     auto constexpr type = GL_UNSIGNED_BYTE;
-    //auto constexpr x0 = 0;
-    //auto constexpr y0 = 0;
-    //auto constexpr z0 = 0;
+    auto constexpr x0 = 0;
+    auto constexpr y0 = 0;
+
+    if (format == atlas::Format::CompressedRGBA)
+    {
+        // All-zero blocks decode to transparent black.
+        auto const stub = std::vector<uint8_t>(static_cast<size_t>(compressedSize(_array.size)));
+        CHECKED_GL( glCompressedTexSubImage3D(target, levelOfDetail, x0, y0, _layer, width, height, depth, glFormat(format),
+                                              static_cast<GLsizei>(stub.size()), stub.data()) );
+        return;
+    }
 
     std::vector<uint8_t> stub;
-    stub.resize(_width * _height * atlas::element_count(_format)); // {{{ fill stub
+    stub.resize(width * height * atlas::element_count(format)); // {{{ fill stub
     auto t = stub.begin();
-    switch (_format)
+    switch (format)
     {
         case atlas::Format::Red:
-            for (auto i = 0; i < _width * _height; ++i)
+            for (auto i = 0; i < width * height; ++i)
                 *t++ = 0x40;
             break;
         case atlas::Format::RGB:
-            for (auto i = 0; i < _width * _height; ++i)
+            for (auto i = 0; i < width * height; ++i)
             {
                 *t++ = 0x00;
                 *t++ = 0x00;
@@ -442,7 +736,7 @@ void OpenGLRenderer::clearTextureAtlas(GLuint _textureId, int _width, int _heigh
             }
             break;
         case atlas::Format::RGBA:
-            for (auto i = 0; i < _width * _height; ++i)
+            for (auto i = 0; i < width * height; ++i)
             {
                 *t++ = 0x00;
                 *t++ = 0x80;
@@ -450,50 +744,110 @@ void OpenGLRenderer::clearTextureAtlas(GLuint _textureId, int _width, int _heigh
                 *t++ = 0x80;
             }
             break;
+        case atlas::Format::CompressedRGBA:
+            break;
     }
     assert(t == stub.end()); // }}}
 
-    GLenum const glFmt = glFormat(_format);
+    CHECKED_GL( glPixelStorei(GL_UNPACK_ALIGNMENT, 1) );
+    CHECKED_GL( glTexSubImage3D(target, levelOfDetail, x0, y0, _layer, width, height, depth, glFormat(format), type, stub.data()) );
+}
+
+void OpenGLRenderer::growTextureArray(int _user, TextureArray& _array, int _depth)
+{
+    assert(_depth > _array.depth && _depth <= maxTextureLayers_);
+
+    GLuint const previousTextureId = _array.textureId;
+    int const previousDepth = _array.depth;
+
+    CHECKED_GL( glGenTextures(1, &_array.textureId) );
+    bindTextureArray(_user, _array.textureId);
+
+    setTextureFilter(_user);
+    CHECKED_GL( glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE) );
+    CHECKED_GL( glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE) );
+
+    GLenum const glFmt = glFormat(_array.format);
     GLint constexpr UnusedParam = 0;
-    CHECKED_GL( glTexImage2D(target, levelOfDetail, glFmt, _width, _height, UnusedParam, glFmt, type, stub.data()) );
+    if (_array.format == atlas::Format::CompressedRGBA)
+        CHECKED_GL( glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, 0, glFmt, _array.size.width, _array.size.height, _depth,
+                                           UnusedParam, compressedSize(_array.size) * _depth, nullptr) );
+    else
+        CHECKED_GL( glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, glFmt, _array.size.width, _array.size.height, _depth,
+                                 UnusedParam, glFmt, GL_UNSIGNED_BYTE, nullptr) );
+    _array.depth = _depth;
+
+    if (!previousTextureId)
+        return;
+
+    if (_array.format == atlas::Format::CompressedRGBA)
+    {
+        // Compressed textures cannot be attached to framebuffers, but their blocks can be copied as is.
+        CHECKED_GL( copyImageSubData_(previousTextureId, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+                                      _array.textureId, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+                                      _array.size.width, _array.size.height, previousDepth) );
+        CHECKED_GL( glDeleteTextures(1, &previousTextureId) );
+        debuglog(OpenGLRendererTag).write("Texture array for user {} grown from {} to {} layers.", _user, previousDepth, _depth);
+        return;
+    }
+
+    // Carry the already populated layers over into the new storage.
+    // Layers can only be read back via a framebuffer, so each of them gets attached in turn.
+    GLint previousReadFramebuffer{};
+    CHECKED_GL( glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebuffer) );
+
+    GLuint fbo{};
+    CHECKED_GL( glGenFramebuffers(1, &fbo) );
+    CHECKED_GL( glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo) );
+    for (int layer = 0; layer < previousDepth; ++layer)
+    {
+        CHECKED_GL( glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, previousTextureId, 0, layer) );
+        CHECKED_GL( glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, 0, 0, _array.size.width, _array.size.height) );
+    }
+    CHECKED_GL( glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(previousReadFramebuffer)) );
+    CHECKED_GL( glDeleteFramebuffers(1, &fbo) );
+    CHECKED_GL( glDeleteTextures(1, &previousTextureId) );
+
+    debuglog(OpenGLRendererTag).write("Texture array for user {} grown from {} to {} layers.", _user, previousDepth, _depth);
 }
 
 void OpenGLRenderer::createAtlas(atlas::CreateAtlas const& _param)
 {
-    GLuint textureId{};
-    CHECKED_GL( glGenTextures(1, &textureId) );
-    bindTexture(textureId);
+    auto const layer = textureScheduler_->atlasLayer(_param.atlas).layer;
 
-    CHECKED_GL( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST) ); // NEAREST, because LINEAR yields borders at the edges
-    CHECKED_GL( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST) );
-    CHECKED_GL( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE) );
-    CHECKED_GL( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE) );
-    CHECKED_GL( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE) );
+    auto& textureArray = textureArrays_[_param.user];
+    if (!textureArray.textureId)
+    {
+        textureArray.size = _param.size;
+        textureArray.format = _param.format;
+    }
+    assert(textureArray.size == _param.size && textureArray.format == _param.format);
 
-    clearTextureAtlas(textureId, _param.size.width, _param.size.height, _param.format);
+    if (layer >= textureArray.depth)
+        growTextureArray(_param.user, textureArray, min(max(layer + 1, 2 * textureArray.depth), maxTextureLayers_));
+    else
+        bindTextureArray(_param.user, textureArray.textureId);
 
-    atlasMap_.insert(pair{_param.atlas, textureId});
+    clearTextureAtlas(textureArray, layer);
 }
 
-void OpenGLRenderer::uploadTexture(atlas::UploadTexture const& _param)
+void OpenGLRenderer::uploadTexture(PendingUpload const& _param, GLintptr _offset)
 {
-    auto const& texture = _param.texture.get();
-    auto const key = texture.atlas;
-    [[maybe_unused]] auto const textureIdIter = atlasMap_.find(key);
-    assert(textureIdIter != atlasMap_.end() && "Texture ID not found in atlas map!");
-    auto const textureId = atlasMap_.at(key);
-    auto const x0 = texture.offset.x;
-    auto const y0 = texture.offset.y;
-    //auto const z0 = texture.z;
+    auto const [user, layer] = textureScheduler_->atlasLayer(_param.atlas);
+    [[maybe_unused]] auto const textureArrayIter = textureArrays_.find(user);
+    assert(textureArrayIter != textureArrays_.end() && "Texture array not found for atlas!");
+    auto const textureId = textureArrays_.at(user).textureId;
+    auto const x0 = _param.offset.x;
+    auto const y0 = _param.offset.y;
 
-    //debuglog(OpenGLRendererTag).write("({}): {}", textureId, _param);
+    //debuglog(OpenGLRendererTag).write("({}/{}): {}", textureId, layer, _param);
 
-    auto constexpr target = GL_TEXTURE_2D;
+    auto constexpr target = GL_TEXTURE_2D_ARRAY;
     auto constexpr levelOfDetail = 0;
-    //auto constexpr depth = 1;
+    auto constexpr depth = 1;
     auto constexpr type = GL_UNSIGNED_BYTE;
 
-    bindTexture(textureId);
+    bindTextureArray(user, textureId);
 
     switch (_param.format)
     {
@@ -504,37 +858,86 @@ void OpenGLRenderer::uploadTexture(atlas::UploadTexture const& _param)
         case atlas::Format::RGBA:
             CHECKED_GL( glPixelStorei(GL_UNPACK_ALIGNMENT, 4) );
             break;
+        case atlas::Format::CompressedRGBA:
+            break;
     }
 
-    CHECKED_GL( glTexSubImage2D(target, levelOfDetail, x0, y0, texture.bitmapSize.width, texture.bitmapSize.height, glFormat(_param.format), type, _param.data.data()) );
+    // The pixels are read from the bound pixel unpack buffer, at the given offset.
+    auto const pixels = reinterpret_cast<void const*>(_offset);
+    if (_param.format == atlas::Format::CompressedRGBA)
+        CHECKED_GL( glCompressedTexSubImage3D(target, levelOfDetail, x0, y0, layer, _param.size.width, _param.size.height, depth,
+                                              glFormat(_param.format), static_cast<GLsizei>(_param.data.size()), pixels) );
+    else
+        CHECKED_GL( glTexSubImage3D(target, levelOfDetail, x0, y0, layer, _param.size.width, _param.size.height, depth, glFormat(_param.format), type, pixels) );
 }
 
-GLuint OpenGLRenderer::textureAtlasID(atlas::AtlasID _atlasID) const noexcept
+void OpenGLRenderer::destroyAtlas(atlas::AtlasID _atlasID)
 {
-    auto const it = atlasMap_.find(_atlasID);
-    if (it == atlasMap_.end())
-        return 0;
+    // The layer stays allocated in the texture array, ready to be handed out to the next atlas.
+    textureScheduler_->releaseAtlasID(_atlasID);
+}
 
-    return it->second;
+void OpenGLRenderer::setTextureFilter(int _user)
+{
+    // NEAREST, because LINEAR yields borders at the edges. Distance fields must be interpolated though,
+    // whose borders are far enough outside of their glyphs to not show.
+    auto const filter = distanceFieldGlyphs_ && _user == monochromeAtlasAllocator_.user() ? GL_LINEAR : GL_NEAREST;
+    CHECKED_GL( glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter) );
+    CHECKED_GL( glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter) );
 }
 
-void OpenGLRenderer::destroyAtlas(atlas::AtlasID _atlasID)
+bool OpenGLRenderer::setDistanceFieldGlyphs(bool _enabled)
+{
+    if (distanceFieldGlyphs_ != _enabled)
+    {
+        distanceFieldGlyphs_ = _enabled;
+        textureFilterChanged_ = true; // applied by the next execute(), with the OpenGL context current
+    }
+    return true;
+}
+
+void OpenGLRenderer::useProgram(QOpenGLShaderProgram& _program)
 {
-    if (auto const it = atlasMap_.find(_atlasID); it != atlasMap_.end())
+    if (boundState_.program == _program.programId())
     {
-        GLuint const textureId = it->second;
-        atlasMap_.erase(it);
-        glDeleteTextures(1, &textureId);
+        ++frameStateChanges_.skipped;
+        return;
     }
+
+    _program.bind();
+    boundState_.program = _program.programId();
+    ++frameStateChanges_.programs;
 }
 
-void OpenGLRenderer::bindTexture(GLuint _textureId)
+void OpenGLRenderer::bindTexture(int _unit, GLenum _target, GLuint _texture)
 {
-    if (currentTextureId_ != _textureId)
+    auto const unit = static_cast<size_t>(_unit);
+    auto const cached = unit < boundState_.textures.size();
+    if (cached && boundState_.textures[unit] == pair{_target, _texture})
+    {
+        ++frameStateChanges_.skipped;
+        return;
+    }
+
+    auto const activeTexture = static_cast<GLenum>(GL_TEXTURE0 + _unit);
+    if (boundState_.activeTexture != activeTexture)
     {
-        glBindTexture(GL_TEXTURE_2D, _textureId);
-        currentTextureId_ = _textureId;
+        glActiveTexture(activeTexture);
+        boundState_.activeTexture = activeTexture;
+        ++frameStateChanges_.textures;
     }
+
+    glBindTexture(_target, _texture);
+    ++frameStateChanges_.textures;
+    if (cached)
+        boundState_.textures[unit] = {_target, _texture};
+}
+
+void OpenGLRenderer::bindTextureArray(int _user, GLuint _textureId)
+{
+    // Each texture array lives on the texture unit matching its user,
+    // which is what the text shader's samplers are configured with.
+    bindTexture(_user, GL_TEXTURE_2D_ARRAY, _textureId);
 }
 
 void OpenGLRenderer::renderRectangle(int _x, int _y, int _width, int _height,
@@ -562,7 +965,100 @@ void OpenGLRenderer::renderRectangle(int _x, int _y, int _width, int _height,
         x + r, y + s, z, cr, cg, cb, ca
     };
 
-    crispy::copy(vertices, back_inserter(rectBuffer_));
+    // Rectangles are written straight into the streaming buffer, back to back.
+    auto const allocation = streamingBuffer_->allocate(sizeof(vertices));
+    if (!rectVertexCount_)
+        rectOffset_ = allocation.offset;
+    assert(allocation.offset == rectOffset_ + rectVertexCount_ * RectVertexSize);
+    std::memcpy(allocation.data, vertices, sizeof(vertices));
+    rectVertexCount_ += 6;
+}
+
+void OpenGLRenderer::renderDecoration(Decorator _decorator, int _x, int _y, int _width,
+                                      GridMetrics const& _gridMetrics, RGBColor const& _color)
+{
+    // Each run of cells is covered by a single quad, whose pattern is computed in the fragment shader.
+    decorations_.emplace_back(DecorationInstance{
+        static_cast<GLfloat>(_x),
+        static_cast<GLfloat>(_y),
+        static_cast<GLfloat>(_width),
+        static_cast<GLfloat>(_gridMetrics.cellSize.height),
+        {_color.red, _color.green, _color.blue, 0xFF},
+        static_cast<GLint>(_decorator),
+        _gridMetrics.baseline,
+        _gridMetrics.cellSize.width,
+        _gridMetrics.underline.position,
+        _gridMetrics.underline.thickness
+    });
+}
+
+void OpenGLRenderer::renderGrid(GridMetrics const& _gridMetrics,
+                                int _firstRow,
+                                int _lastRow,
+                                vector<GridCell> const& _cells)
+{
+    gridFirstRow_ = _firstRow;
+    gridLastRow_ = _lastRow;
+    gridPageSize_ = _gridMetrics.pageSize;
+    gridCellSize_ = _gridMetrics.cellSize;
+    gridMargin_ = _gridMetrics.pageMargin;
+    gridBaseline_ = _gridMetrics.baseline;
+    gridUnderlinePosition_ = _gridMetrics.underline.position;
+    gridUnderlineThickness_ = _gridMetrics.underline.thickness;
+
+    auto const pack = [](int _low, int _high) {
+        return static_cast<GLuint>(static_cast<uint16_t>(_low))
+             | static_cast<GLuint>(static_cast<uint16_t>(_high)) << 16;
+    };
+
+    // Colors taken from the palette refer to their palette slot instead (16 bits),
+    // along with whether they are faint (bit 8) and the PaletteColorTag as their alpha.
+    // Changing the palette then merely needs the palette texture to be uploaded again.
+    auto const color = [this](RGBAColor _color, PaletteSlot _slot, bool _faint) {
+        if (_slot == PaletteSlot::None || !gridPalette_ || !_color.alpha())
+            return static_cast<GLuint>(_color.value);
+        return static_cast<GLuint>(_slot) << 16 | (_faint ? 0x100u : 0u) | PaletteColorTag;
+    };
+
+    // Per cell:
+    //   first texel:  background, foreground, glyph's atlas offset, glyph's bitmap size
+    //   second texel: glyph's target size, glyph's offset into the cell,
+    //                 atlas user + 1 and layer and decorators (8, 8 and 16 bits), decoration color
+    gridCells_.resize(_cells.size() * GridCellSize);
+    gridGlyphs_.resize(_cells.size());
+    auto out = gridCells_.begin();
+    auto glyphOut = gridGlyphs_.begin();
+    for (GridCell const& cell: _cells)
+    {
+        *glyphOut++ = cell.glyph;
+        *out++ = color(cell.background, cell.backgroundSlot, false);
+        *out++ = color(cell.foreground, cell.foregroundSlot, cell.faint);
+        if (atlas::TextureInfo const* glyph = cell.glyph; glyph)
+        {
+            auto const [user, layer] = textureScheduler_->atlasLayer(glyph->atlas);
+            *out++ = pack(glyph->offset.x, glyph->offset.y);
+            *out++ = pack(glyph->bitmapSize.width, glyph->bitmapSize.height);
+            *out++ = pack(glyph->targetSize.width, glyph->targetSize.height);
+            *out++ = pack(cell.glyphOffset.x, cell.glyphOffset.y);
+            *out++ = static_cast<GLuint>(user + 1) | static_cast<GLuint>(layer) << 8
+                   | static_cast<GLuint>(cell.decorators) << 16;
+        }
+        else
+        {
+            *out++ = 0;
+            *out++ = 0;
+            *out++ = 0;
+            *out++ = 0;
+            *out++ = static_cast<GLuint>(cell.decorators) << 16;
+        }
+        *out++ = cell.decorators ? color(RGBAColor{cell.decorationColor}, cell.decorationSlot, cell.faint) : 0;
+    }
+}
+
+void OpenGLRenderer::setPalette(RenderPalette const& _palette)
+{
+    gridPalette_ = _palette;
+    gridPaletteChanged_ = true;
 }
 
 optional<AtlasTextureInfo> OpenGLRenderer::readAtlas(atlas::TextureAtlasAllocator const& _allocator, atlas::AtlasID _instanceID)
@@ -570,7 +1066,12 @@ optional<AtlasTextureInfo> OpenGLRenderer::readAtlas(atlas::TextureAtlasAllocato
     // NB: to get all atlas pages, call this from instance base id up to and including current
     // instance id of the given allocator.
 
-    auto const textureId = textureAtlasID(_instanceID);
+    auto const [user, layer] = textureScheduler_->atlasLayer(_instanceID);
+    auto const textureId = textureArrays_.at(user).textureId;
+
+    // Compressed textures cannot be attached to framebuffers, and thus not be read back on all platforms.
+    if (textureArrays_.at(user).format == atlas::Format::CompressedRGBA)
+        return nullopt;
 
     AtlasTextureInfo output{};
     output.atlasName = _allocator.name();
@@ -583,7 +1084,7 @@ optional<AtlasTextureInfo> OpenGLRenderer::readAtlas(atlas::TextureAtlasAllocato
     GLuint fbo;
     CHECKED_GL( glGenFramebuffers(1, &fbo) );
     CHECKED_GL( glBindFramebuffer(GL_FRAMEBUFFER, fbo) );
-    CHECKED_GL( glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureId, 0) );
+    CHECKED_GL( glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureId, 0, layer) );
     CHECKED_GL( glReadPixels(0, 0, output.size.width, output.size.height, GL_RGBA, GL_UNSIGNED_BYTE, output.buffer.data()) );
     CHECKED_GL( glBindFramebuffer(GL_FRAMEBUFFER, 0) );
     CHECKED_GL( glDeleteFramebuffers(1, &fbo) );
@@ -591,57 +1092,268 @@ optional<AtlasTextureInfo> OpenGLRenderer::readAtlas(atlas::TextureAtlasAllocato
     return output;
 }
 
+void OpenGLRenderer::setDamagedArea(optional<DamagedArea> _area)
+{
+    damagedArea_ = _area;
+}
+
+bool OpenGLRenderer::scrollArea(DamagedArea const& _area, int _offset)
+{
+    GLint target = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+
+    // Multisampled framebuffers cannot be blitted into.
+    GLint sampleBuffers = 0;
+    glGetIntegerv(GL_SAMPLE_BUFFERS, &sampleBuffers);
+    if (sampleBuffers > 0)
+        return false;
+
+    // The area is given in render size coordinates, which the viewport maps onto the framebuffer.
+    GLint viewport[4] = {};
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    auto const scale = static_cast<double>(viewport[3]) / static_cast<double>(max(1, size_.height));
+    auto const y0 = static_cast<GLint>(std::floor(std::clamp(_area.y, 0, size_.height) * scale));
+    auto const y1 = static_cast<GLint>(std::ceil(std::clamp(_area.y + _area.height, 0, size_.height) * scale));
+    auto const offset = static_cast<GLint>(std::lround(_offset * scale));
+    auto const height = y1 - y0 - std::abs(offset);
+    auto const width = viewport[2];
+    if (height <= 0 || width <= 0)
+        return true;
+
+    if (!scrollTexture_ || scrollTextureSize_.width < width || scrollTextureSize_.height < height)
+    {
+        scrollTextureSize_ = Size{width, max(height, viewport[3])};
+        if (!scrollTexture_)
+            CHECKED_GL( glGenTextures(1, &scrollTexture_) );
+        CHECKED_GL( glBindTexture(GL_TEXTURE_2D, scrollTexture_) );
+        CHECKED_GL( glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, scrollTextureSize_.width, scrollTextureSize_.height, 0,
+                                 GL_RGBA, GL_UNSIGNED_BYTE, nullptr) );
+        CHECKED_GL( glBindTexture(GL_TEXTURE_2D, 0) );
+
+        if (!scrollFramebuffer_)
+            CHECKED_GL( glGenFramebuffers(1, &scrollFramebuffer_) );
+        CHECKED_GL( glBindFramebuffer(GL_FRAMEBUFFER, scrollFramebuffer_) );
+        CHECKED_GL( glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scrollTexture_, 0) );
+    }
+
+    auto const sourceY = viewport[1] + (offset > 0 ? y0 : y0 - offset);
+    auto const targetY = viewport[1] + (offset > 0 ? y0 + offset : y0);
+
+    glDisable(GL_SCISSOR_TEST);
+    CHECKED_GL( glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(target)) );
+    CHECKED_GL( glBindFramebuffer(GL_DRAW_FRAMEBUFFER, scrollFramebuffer_) );
+    CHECKED_GL( glBlitFramebuffer(viewport[0], sourceY, viewport[0] + width, sourceY + height,
+                                  0, 0, width, height,
+                                  GL_COLOR_BUFFER_BIT, GL_NEAREST) );
+    CHECKED_GL( glBindFramebuffer(GL_READ_FRAMEBUFFER, scrollFramebuffer_) );
+    CHECKED_GL( glBindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLuint>(target)) );
+    CHECKED_GL( glBlitFramebuffer(0, 0, width, height,
+                                  viewport[0], targetY, viewport[0] + width, targetY + height,
+                                  GL_COLOR_BUFFER_BIT, GL_NEAREST) );
+    CHECKED_GL( glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(target)) );
+    return true;
+}
+
 void OpenGLRenderer::scheduleScreenshot(ScreenshotCallback _callback)
 {
     pendingScreenshotCallback_ = std::move(_callback);
 }
 
+bool OpenGLRenderer::screenshotsPending() const noexcept
+{
+    return pendingScreenshotCallback_.has_value() || screenshotReader_->pending();
+}
+
 void OpenGLRenderer::execute()
 {
+    CRISPY_PROFILE_ZONE("OpenGLRenderer::execute");
+    boundState_ = {};
+    frameStateChanges_ = {};
+
     //FIXME
     //glEnable(GL_BLEND);
     //glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE);
     //glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE);
     //glBlendFunc(GL_SRC1_COLOR, GL_ONE_MINUS_SRC1_COLOR);
 
+    // The framebuffer is preserved across frames, so only the damaged area is cleared and drawn into.
+    // It is given in render size coordinates, which the viewport maps onto the framebuffer.
+    auto const area = std::exchange(damagedArea_, nullopt).value_or(DamagedArea{0, size_.height});
+    GLint viewport[4] = {};
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    auto const scale = static_cast<double>(viewport[3]) / static_cast<double>(max(1, size_.height));
+    auto const y0 = static_cast<GLint>(std::floor(area.y * scale));
+    auto const y1 = static_cast<GLint>(std::ceil((area.y + area.height) * scale));
+    auto const scaleX = static_cast<double>(viewport[2]) / static_cast<double>(max(1, size_.width));
+    auto const left = std::clamp(area.x, 0, size_.width);
+    auto const right = left + std::clamp(area.width, 0, size_.width - left);
+    auto const x0 = static_cast<GLint>(std::floor(left * scaleX));
+    auto const x1 = static_cast<GLint>(std::ceil(right * scaleX));
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(viewport[0] + x0, viewport[1] + y0, x1 - x0, y1 - y0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // The cell grid samples glyphs straight from the atlases, so these must be up to date first.
+    {
+        auto _p = ScopedRenderPass{*passTimer_, RenderPass::Uploads};
+        CRISPY_PROFILE_ZONE("OpenGLRenderer::execute: uploads");
+        executeTextureUploads();
+    }
+
     // render filled rects
     //
-    if (!rectBuffer_.empty())
+    if (rectVertexCount_)
     {
-        bound(*rectShader_, [&]() {
-            rectShader_->setUniformValue(rectProjectionLocation_, projectionMatrix_);
+        auto _p = ScopedRenderPass{*passTimer_, RenderPass::Rectangles};
+        CRISPY_PROFILE_ZONE("OpenGLRenderer::execute: rectangles");
+        useProgram(*rectShader_);
+        rectShader_->setUniformValue(rectProjectionLocation_, projectionMatrix_);
+
+        streamingBuffer_->flush();
+        glBindVertexArray(rectVAO_);
+        glBindBuffer(GL_ARRAY_BUFFER, streamingBuffer_->id());
+        bindRectAttributes(streamingBuffer_->baseOffset() + static_cast<GLintptr>(rectOffset_));
+
+        glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(rectVertexCount_));
+        ++frameStateChanges_.draws;
+        glBindVertexArray(0);
+        rectVertexCount_ = 0;
+    }
 
-            glBindVertexArray(rectVAO_);
-            glBindBuffer(GL_ARRAY_BUFFER, rectVBO_);
-            glBufferData(GL_ARRAY_BUFFER, rectBuffer_.size() * sizeof(GLfloat), rectBuffer_.data(), GL_STREAM_DRAW);
+    // render cell grid
+    //
+    if (gridFirstRow_ <= gridLastRow_)
+    {
+        auto _p = ScopedRenderPass{*passTimer_, RenderPass::Grid};
+        CRISPY_PROFILE_ZONE("OpenGLRenderer::execute: grid");
+        executeRenderGrid();
+    }
 
-            glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(rectBuffer_.size() / 7));
-            glBindVertexArray(0);
-        });
-        rectBuffer_.clear();
+    // render decorations
+    //
+    if (!decorations_.empty())
+    {
+        auto _p = ScopedRenderPass{*passTimer_, RenderPass::Decorations};
+        CRISPY_PROFILE_ZONE("OpenGLRenderer::execute: decorations");
+        useProgram(*decorationShader_);
+        decorationShader_->setUniformValue(decorationProjectionLocation_, projectionMatrix_);
+        executeRenderDecorations();
     }
 
     // render textures
     //
-    bound(*textShader_, [&]() {
+    {
+        auto _p = ScopedRenderPass{*passTimer_, RenderPass::Textures};
+        CRISPY_PROFILE_ZONE("OpenGLRenderer::execute: textures");
+        useProgram(*textShader_);
         // TODO: only upload when it actually DOES change
         textShader_->setUniformValue(textProjectionLocation_, projectionMatrix_);
+        textShader_->setUniformValue(textDistanceFieldLocation_, static_cast<GLint>(distanceFieldGlyphs_));
         executeRenderTextures();
-    });
+    }
+
+    // Qt expects no program to be bound when composing the window.
+    if (boundState_.program)
+        glUseProgram(0);
+
+    streamingBuffer_->finishFrame();
+    uploadBuffer_->finishFrame();
+    finishFrame();
+    glDisable(GL_SCISSOR_TEST);
+
+    totalStateChanges_.programs += frameStateChanges_.programs;
+    totalStateChanges_.textures += frameStateChanges_.textures;
+    totalStateChanges_.skipped += frameStateChanges_.skipped;
+    totalStateChanges_.draws += frameStateChanges_.draws;
+    ++frameCount_;
+
+    // Deliver the screenshots of earlier frames the GPU is done with, before starting a new one.
+    screenshotReader_->poll();
 
     if (pendingScreenshotCallback_)
     {
         Size bufferSize = renderBufferSize();
-        vector<uint8_t> buffer;
-        buffer.resize(bufferSize.width * bufferSize.height * 4);
-
         debuglog(OpenGLRendererTag).write("Capture screenshot ({}/{}).", bufferSize, size_);
+        screenshotReader_->capture(bufferSize, std::move(pendingScreenshotCallback_.value()));
+        pendingScreenshotCallback_.reset();
+    }
+}
 
-        CHECKED_GL( glReadPixels(0, 0, bufferSize.width, bufferSize.height, GL_RGBA, GL_UNSIGNED_BYTE, buffer.data()) );
+void OpenGLRenderer::finishFrame()
+{
+    auto const capacities = std::array{
+        discard(textureScheduler_->createAtlases),
+        discard(textureScheduler_->uploadTextures),
+        discard(textureScheduler_->renderBatch.renderTextures),
+        discard(textureScheduler_->renderBatch.instances),
+        discard(textureScheduler_->destroyAtlases),
+        discard(pendingTextures_)
+    };
 
-        pendingScreenshotCallback_.value()(buffer, bufferSize);
-        pendingScreenshotCallback_.reset();
+    if (std::exchange(frameArenaTrimRequested_, false))
+    {
+        frameArena_.release();
+        return;
     }
+
+    // Reserving what this frame needed has frames of steady size fill the arena without growing.
+    frameArena_.reset();
+    textureScheduler_->createAtlases.reserve(capacities[0]);
+    textureScheduler_->uploadTextures.reserve(capacities[1]);
+    textureScheduler_->renderBatch.renderTextures.reserve(capacities[2]);
+    textureScheduler_->renderBatch.instances.reserve(capacities[3]);
+    textureScheduler_->destroyAtlases.reserve(capacities[4]);
+    pendingTextures_.reserve(capacities[5]);
+}
+
+string OpenGLRenderer::renderStats() const
+{
+    auto const frames = static_cast<double>(max(frameCount_, uint64_t{1}));
+    auto const& last = frameStateChanges_;
+    auto const& total = totalStateChanges_;
+    return passTimer_->dump()
+         + fmt::format("state changes: {} programs, {} texture binds, {} draws, {} skipped"
+                       " (average: {:.1f} programs, {:.1f} texture binds, {:.1f} draws, {:.1f} skipped)\n",
+                       last.programs, last.textures, last.draws, last.skipped,
+                       double(total.programs) / frames,
+                       double(total.textures) / frames,
+                       double(total.draws) / frames,
+                       double(total.skipped) / frames);
+}
+
+void OpenGLRenderer::collectMemoryUsage(crispy::memory_usage& _usage) const
+{
+    auto atlases = size_t{0};
+    for (auto const& entry: textureArrays_)
+    {
+        auto const& textureArray = entry.second;
+        atlases += static_cast<size_t>(textureArray.size.width) * static_cast<size_t>(textureArray.size.height)
+                 * static_cast<size_t>(textureArray.depth) * static_cast<size_t>(atlas::element_count(textureArray.format));
+    }
+
+    auto pendingUploads = size_t{0};
+    for (auto const& upload: pendingUploads_)
+        pendingUploads += crispy::allocated_bytes(upload.data);
+
+    auto const gridTexture = static_cast<size_t>(gridTextureSize_.width) * static_cast<size_t>(gridTextureSize_.height)
+                           * 4 * sizeof(GLuint); // RGBA32UI
+
+    _usage.add("gpu.atlases", atlases);
+    _usage.add("gpu.grid_texture", gridTexture);
+    _usage.add("gpu.scroll_texture", static_cast<size_t>(scrollTextureSize_.width) * static_cast<size_t>(scrollTextureSize_.height) * 4);
+    _usage.add("gpu.vertex_buffers", 4 * 2 * sizeof(GLfloat) + streamingBuffer_->storageSize());
+    _usage.add("gpu.upload_buffer", uploadBuffer_ ? uploadBuffer_->storageSize() : 0);
+    _usage.add("gpu.screenshot_buffers", screenshotReader_ ? screenshotReader_->storageSize() : 0);
+    _usage.add("opengl.atlas_metadata", monochromeAtlasAllocator_.metadataMemoryUsage()
+                                      + coloredAtlasAllocator_.metadataMemoryUsage()
+                                      + lcdAtlasAllocator_.metadataMemoryUsage());
+    _usage.add("opengl.pending_uploads", pendingUploads);
+    _usage.add("opengl.staging", streamingBuffer_->stagingSize()
+                               + (uploadBuffer_ ? uploadBuffer_->stagingSize() : 0));
+    _usage.add("opengl.frame", frameArena_.capacity_bytes()
+                             + crispy::allocated_bytes(decorations_)
+                             + crispy::allocated_bytes(gridCells_)
+                             + crispy::allocated_bytes(gridGlyphs_));
 }
 
 Size OpenGLRenderer::renderBufferSize()
@@ -657,44 +1369,240 @@ Size OpenGLRenderer::renderBufferSize()
 #endif
 }
 
-void OpenGLRenderer::executeRenderTextures()
+void OpenGLRenderer::executeRenderDecorations()
 {
-    currentTextureId_ = std::numeric_limits<int>::max();
+    auto const byteCount = decorations_.size() * sizeof(DecorationInstance);
+    auto const allocation = streamingBuffer_->allocate(byteCount);
+    std::memcpy(allocation.data, decorations_.data(), byteCount);
+    streamingBuffer_->flush();
+
+    glBindVertexArray(decorationVAO_);
+    glBindBuffer(GL_ARRAY_BUFFER, streamingBuffer_->id());
+    bindDecorationAttributes(streamingBuffer_->baseOffset() + static_cast<GLintptr>(allocation.offset));
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(decorations_.size()));
+    ++frameStateChanges_.draws;
+    glBindVertexArray(0);
+
+    decorations_.clear();
+}
 
-    // debuglog(OpenGLRendererTag).write(
-    //     "OpenGLRenderer::executeRenderTextures() upload={} render={}",
-    //     textureScheduler_->uploadTextures.size(),
-    //     textureScheduler_->renderTextures.size()
-    // );
+void OpenGLRenderer::executeRenderGrid()
+{
+    auto const columns = gridPageSize_.width;
+    auto const textureSize = Size{2 * columns, gridPageSize_.height};
+
+    if (!gridTexture_)
+        glGenTextures(1, &gridTexture_);
+    bindTexture(GridTextureUnit, GL_TEXTURE_2D, gridTexture_);
+    if (gridTextureSize_ != textureSize)
+    {
+        // Only the rendered lines are ever sampled from, so the storage is left uninitialized.
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); // integer textures cannot be filtered
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        CHECKED_GL( glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32UI, textureSize.width, textureSize.height, 0,
+                                 GL_RGBA_INTEGER, GL_UNSIGNED_INT, nullptr) );
+        gridTextureSize_ = textureSize;
+    }
+
+    // Glyphs still waiting to be uploaded are left out of this frame.
+    if (!pendingTextures_.empty())
+    {
+        for (size_t i = 0; i < gridGlyphs_.size(); ++i)
+        {
+            if (gridGlyphs_[i] && uploadPending(gridGlyphs_[i]))
+            {
+                auto const cell = gridCells_.begin() + static_cast<ptrdiff_t>(i * GridCellSize);
+                std::fill_n(cell + 2, 4, 0);
+                cell[6] &= 0xFFFF0000u; // keeping the decorators
+            }
+        }
+    }
+
+    if (gridPalette_)
+    {
+        if (!paletteTexture_)
+            glGenTextures(1, &paletteTexture_);
+        bindTexture(PaletteTextureUnit, GL_TEXTURE_2D, paletteTexture_);
+        if (std::exchange(gridPaletteChanged_, false))
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            CHECKED_GL( glPixelStorei(GL_UNPACK_ALIGNMENT, 1) );
+            CHECKED_GL( glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, static_cast<GLsizei>(RenderPalette::Size), 1, 0,
+                                     GL_RGB, GL_UNSIGNED_BYTE, gridPalette_->colors.data()) );
+        }
+    }
+
+    // Texture rows are counted from the top grid line, matching the order of the cells.
+    auto const rowCount = gridLastRow_ - gridFirstRow_ + 1;
+    CHECKED_GL( glPixelStorei(GL_UNPACK_ALIGNMENT, 4) );
+    CHECKED_GL( glTexSubImage2D(GL_TEXTURE_2D, 0, 0, gridFirstRow_ - 1, textureSize.width, rowCount,
+                                GL_RGBA_INTEGER, GL_UNSIGNED_INT, gridCells_.data()) );
+
+    for (auto const& [user, textureArray]: textureArrays_)
+        bindTextureArray(user, textureArray.textureId);
+
+    auto const cellSize = gridCellSize_;
+    auto const bottom = gridMargin_.bottom + (gridPageSize_.height - gridLastRow_) * cellSize.height;
+
+    useProgram(*gridShader_);
+    gridShader_->setUniformValue("u_projection", projectionMatrix_);
+    gridShader_->setUniformValue("u_rect", QVector4D(
+        static_cast<float>(gridMargin_.left),
+        static_cast<float>(bottom),
+        static_cast<float>(columns * cellSize.width),
+        static_cast<float>(rowCount * cellSize.height)
+    ));
+    gridShader_->setUniformValue("u_gridOrigin", QVector2D(
+        static_cast<float>(gridMargin_.left),
+        static_cast<float>(gridMargin_.bottom)
+    ));
+    glUniform2i(gridShader_->uniformLocation("u_cellSize"), cellSize.width, cellSize.height);
+    glUniform2i(gridShader_->uniformLocation("u_pageSize"), gridPageSize_.width, gridPageSize_.height);
+    glUniform3i(gridShader_->uniformLocation("u_decorationMetrics"),
+                gridBaseline_, gridUnderlinePosition_, gridUnderlineThickness_);
+
+    glBindVertexArray(gridVAO_);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    ++frameStateChanges_.draws;
+    glBindVertexArray(0);
+
+    gridFirstRow_ = 0;
+    gridLastRow_ = -1;
+}
+
+void OpenGLRenderer::executeTextureUploads()
+{
+    if (std::exchange(textureFilterChanged_, false))
+    {
+        auto const user = monochromeAtlasAllocator_.user();
+        if (auto i = textureArrays_.find(user); i != textureArrays_.end() && i->second.textureId)
+        {
+            bindTextureArray(user, i->second.textureId);
+            setTextureFilter(user);
+        }
+    }
 
     // potentially create new atlases
     for (auto const& params: textureScheduler_->createAtlases)
         createAtlas(params);
     textureScheduler_->createAtlases.clear();
 
-    // potentially upload any new textures
-    for (auto const& params: textureScheduler_->uploadTextures)
-        uploadTexture(params);
+    // Queue up any new textures behind the ones still waiting from previous frames.
+    // They must be uploaded in order, as a released texture's space may be handed out again.
+    auto const firstNewUpload = pendingUploads_.size();
+    for (auto& params: textureScheduler_->uploadTextures)
+    {
+        auto const& texture = params.texture.get();
+        pendingUploads_.emplace_back(PendingUpload{
+            &texture,
+            texture.atlas,
+            texture.offset,
+            texture.bitmapSize,
+            params.format,
+            std::move(params.data)
+        });
+    }
     textureScheduler_->uploadTextures.clear();
 
+    // Textures to be stored compressed are handed over as RGBA pixels, and compressed on the
+    // worker threads here, right away, so that deferred uploads count by their compressed size.
+    auto compressions = crispy::arena_vector<PendingUpload*>{crispy::arena_allocator<PendingUpload*>{frameArena_}};
+    for (auto i = firstNewUpload; i < pendingUploads_.size(); ++i)
+        if (pendingUploads_[i].format == atlas::Format::CompressedRGBA)
+            compressions.push_back(&pendingUploads_[i]);
+    crispy::thread_pool::shared().parallel_for(compressions.size(), [&](size_t _index) {
+        PendingUpload& upload = *compressions[_index];
+        assert(upload.data.size() == static_cast<size_t>(upload.size.width * upload.size.height * 4));
+        auto compressed = atlas::Buffer(crispy::bc3::encodedSize(upload.size.width, upload.size.height));
+        crispy::bc3::encode(upload.data.data(), upload.size.width, upload.size.height, compressed.data());
+        upload.data = std::move(compressed);
+        upload.size = Size{crispy::bc3::blockAligned(upload.size.width), crispy::bc3::blockAligned(upload.size.height)};
+    });
+
+    if (pendingUploads_.empty())
+        return;
+
+    // Copy as many as the budget permits into the upload buffer, so that large images
+    // are spread across frames instead of stalling a single one.
+    auto offsets = crispy::arena_vector<size_t>{crispy::arena_allocator<size_t>{frameArena_}};
+    offsets.reserve(pendingUploads_.size());
+    size_t byteCount = 0;
+    for (PendingUpload const& upload: pendingUploads_)
+    {
+        if (!offsets.empty() && byteCount + upload.data.size() > UploadBudget)
+            break;
+        auto const allocation = uploadBuffer_->allocate(upload.data.size());
+        if (!upload.data.empty())
+            std::memcpy(allocation.data, upload.data.data(), upload.data.size());
+        offsets.push_back(allocation.offset);
+        byteCount += upload.data.size();
+    }
+    uploadBuffer_->flush();
+
+    CHECKED_GL( glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer_->id()) );
+    for (size_t const offset: offsets)
+    {
+        // Uploads into atlases that have been destroyed in the meantime are dropped.
+        if (textureScheduler_->atlasLayers_.count(pendingUploads_.front().atlas))
+            uploadTexture(pendingUploads_.front(), uploadBuffer_->baseOffset() + static_cast<GLintptr>(offset));
+        pendingUploads_.pop_front();
+    }
+    CHECKED_GL( glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0) );
+
+    pendingTextures_.clear();
+    for (PendingUpload const& upload: pendingUploads_)
+        pendingTextures_.push_back(upload.texture);
+    std::sort(pendingTextures_.begin(), pendingTextures_.end());
+
+    if (!pendingUploads_.empty())
+        debuglog(OpenGLRendererTag).write("Deferring {} texture uploads to the next frame.", pendingUploads_.size());
+}
+
+void OpenGLRenderer::executeRenderTextures()
+{
+    // debuglog(OpenGLRendererTag).write(
+    //     "OpenGLRenderer::executeRenderTextures() upload={} render={}",
+    //     textureScheduler_->uploadTextures.size(),
+    //     textureScheduler_->renderTextures.size()
+    // );
+
     // upload vertices and render
-    for (size_t i = 0; i < textureScheduler_->renderBatches.size(); ++i)
+    auto& batch = textureScheduler_->renderBatch;
+
+    // Textures still waiting to be uploaded are left out of this frame.
+    if (!pendingTextures_.empty())
     {
-        auto& batch = textureScheduler_->renderBatches[i];
-        if (batch.renderTextures.empty())
-            continue;
+        size_t count = 0;
+        for (size_t i = 0; i < batch.renderTextures.size(); ++i)
+        {
+            if (uploadPending(&batch.renderTextures[i].texture.get()))
+                continue;
+            batch.renderTextures[count] = batch.renderTextures[i];
+            batch.instances[count] = batch.instances[i];
+            ++count;
+        }
+        batch.renderTextures.erase(batch.renderTextures.begin() + static_cast<ptrdiff_t>(count), batch.renderTextures.end());
+        batch.instances.erase(batch.instances.begin() + static_cast<ptrdiff_t>(count), batch.instances.end());
+    }
 
-        glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + batch.user));
-        bindTexture(textureAtlasID(atlas::AtlasID{static_cast<int>(i)}));
+    if (!batch.renderTextures.empty())
+    {
+        // Every texture array sits on its own texture unit, so that instances
+        // of all formats and atlas pages can be rendered in one go.
+        for (auto const& [user, textureArray]: textureArrays_)
+            bindTextureArray(user, textureArray.textureId);
         glBindVertexArray(vao_);
 
-        // upload buffer
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-        glBufferData(GL_ARRAY_BUFFER,
-                     batch.buffer.size() * sizeof(GLfloat),
-                     batch.buffer.data(),
-                     GL_STREAM_DRAW);
-        glDrawArrays(GL_TRIANGLES, 0, batch.renderTextures.size() * 6);
+        // Upload instances and render them, all expanded from the same quad.
+        auto const byteCount = batch.instances.size() * sizeof(TextureScheduler::Instance);
+        auto const allocation = streamingBuffer_->allocate(byteCount);
+        std::memcpy(allocation.data, batch.instances.data(), byteCount);
+        streamingBuffer_->flush();
+        glBindBuffer(GL_ARRAY_BUFFER, streamingBuffer_->id());
+        bindInstanceAttributes(streamingBuffer_->baseOffset() + static_cast<GLintptr>(allocation.offset));
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(batch.instances.size()));
+        ++frameStateChanges_.draws;
 
         batch.clear();
     }
@@ -17,17 +17,29 @@
 #include <terminal_renderer/Atlas.h>
 
 #include <crispy/debuglog.h>
+#include <crispy/frame_arena.h>
 
 #include <QtGui/QMatrix4x4>
 #include <QtGui/QOpenGLExtraFunctions>
 #include <QtGui/QOpenGLShaderProgram>
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace terminal::renderer::opengl {
 
 struct ShaderConfig;
+class RenderPassTimer;
+class ScreenshotReader;
+class StreamingBuffer;
 
 class OpenGLRenderer final :
     public RenderTarget,
@@ -36,11 +48,54 @@ class OpenGLRenderer final :
   private:
     struct TextureScheduler;
 
+    using CopyImageSubData = void (QOPENGLF_APIENTRYP)(GLuint, GLenum, GLint, GLint, GLint, GLint,
+                                                       GLuint, GLenum, GLint, GLint, GLint, GLint,
+                                                       GLsizei, GLsizei, GLsizei);
+
+    /// All atlas pages of one atlas user (i.e. of one texture format), stored as layers of a
+    /// single GL_TEXTURE_2D_ARRAY that is bound to the texture unit matching the user.
+    struct TextureArray
+    {
+        GLuint textureId = 0;
+        crispy::Size size{};
+        atlas::Format format = atlas::Format::Red;
+        int depth = 0;                  // number of layers the texture storage was allocated with
+    };
+
+    /// Everything the decoration shader needs to know to draw one decorated run of grid cells.
+    struct DecorationInstance
+    {
+        GLfloat x, y;                   // window coordinates of the bottom left corner
+        GLfloat width, height;          // size on the window
+        std::array<GLubyte, 4> color;   // RGBA, normalized
+        GLint decorator;                // Decorator, selecting the pattern
+        GLint baseline;                 // glyph baseline relative to the cell bottom
+        GLint cellWidth;                // horizontal period of the pattern
+        GLint underlinePosition;        // relative to the cell bottom
+        GLint underlineThickness;
+    };
+
+    /// A texture upload that is waiting for its share of the per-frame upload budget.
+    ///
+    /// The texture's attributes are copied, as the texture may be released before it is uploaded.
+    struct PendingUpload
+    {
+        atlas::TextureInfo const* texture;  // identifies the texture only, never dereferenced
+        atlas::AtlasID atlas;
+        crispy::Point offset;               // within the atlas
+        crispy::Size size;
+        atlas::Format format;
+        atlas::Buffer data;
+    };
+
   public:
     OpenGLRenderer(ShaderConfig const& _textShaderConfig,
                    ShaderConfig const& _rectShaderConfig,
+                   ShaderConfig const& _decorationShaderConfig,
+                   ShaderConfig const& _gridShaderConfig,
                    crispy::Size _size,
-                   terminal::renderer::PageMargin _margin);
+                   terminal::renderer::PageMargin _margin,
+                   bool _compressColorTextures);
 
     ~OpenGLRenderer() override;
 
@@ -53,14 +108,37 @@ class OpenGLRenderer final :
 
     atlas::AtlasBackend& textureScheduler() override;
 
+    void setDamagedArea(std::optional<DamagedArea> _area) override;
+    bool scrollArea(DamagedArea const& _area, int _offset) override;
+
+    bool setDistanceFieldGlyphs(bool _enabled) override;
+    bool supportsCellGrid() const noexcept override { return gridShader_ != nullptr; }
+    void renderGrid(GridMetrics const& _gridMetrics,
+                    int _firstRow,
+                    int _lastRow,
+                    std::vector<GridCell> const& _cells) override;
+    void setPalette(RenderPalette const& _palette) override;
+
+    bool uploadsPending() const noexcept override { return !pendingUploads_.empty(); }
+
+    /// Screenshots are read back asynchronously and delivered on a worker thread.
     void scheduleScreenshot(ScreenshotCallback _callback) override;
 
+    bool screenshotsPending() const noexcept override;
+
     void renderRectangle(int _x, int _y, int _width, int _height,
                          float _r, float _g, float _b, float _a) override;
 
+    void renderDecoration(Decorator _decorator, int _x, int _y, int _width,
+                          GridMetrics const& _gridMetrics, RGBColor const& _color) override;
+
     void execute() override;
 
+    std::string renderStats() const override;
+    void collectMemoryUsage(crispy::memory_usage& _usage) const override;
+
     void clearCache() override;
+    void trimMemory() override;
 
     std::optional<AtlasTextureInfo> readAtlas(atlas::TextureAtlasAllocator const& _allocator, atlas::AtlasID _instanceId) override;
 
@@ -70,25 +148,50 @@ class OpenGLRenderer final :
     void initialize();
     void initializeTextureRendering();
     void initializeRectRendering();
+    void initializeDecorationRendering();
+    void initializeGridRendering();
     int maxTextureDepth();
     int maxTextureSize();
     int maxTextureUnits();
     crispy::Size renderBufferSize();
 
     crispy::Size colorTextureSizeHint();
+
+    /// @returns the format to store colored textures in, being compressed only if requested
+    ///          and supported by the OpenGL context.
+    atlas::Format colorTextureFormat(bool _compress);
     crispy::Size monochromeTextureSizeHint();
 
+    void executeRenderDecorations();
+    void executeRenderGrid();
+    void executeTextureUploads();
     void executeRenderTextures();
+
+    /// Drops everything scheduled for the frame just executed, resetting the frame arena.
+    void finishFrame();
+
+    /// @returns whether @p _texture is still waiting to be uploaded.
+    bool uploadPending(atlas::TextureInfo const* _texture) const noexcept
+    {
+        return std::binary_search(pendingTextures_.begin(), pendingTextures_.end(), _texture);
+    }
+
     void createAtlas(atlas::CreateAtlas const& _param);
-    void uploadTexture(atlas::UploadTexture const& _param);
+    void uploadTexture(PendingUpload const& _param, GLintptr _offset);
     void renderTexture(atlas::RenderTexture const& _param);
     void destroyAtlas(atlas::AtlasID _atlasID);
 
     void executeRenderRectangle(int _x, int _y, int _width, int _height, QVector4D const& _color);
+    void bindRectAttributes(GLintptr _offset);
+    void bindInstanceAttributes(GLintptr _offset);
+    void bindDecorationAttributes(GLintptr _offset);
 
-    void bindTexture(GLuint _textureId);
-    GLuint textureAtlasID(atlas::AtlasID _atlasID) const noexcept;
-    void clearTextureAtlas(GLuint _textureId, int _width, int _height, atlas::Format _format);
+    void useProgram(QOpenGLShaderProgram& _program);
+    void bindTexture(int _unit, GLenum _target, GLuint _texture);
+    void bindTextureArray(int _user, GLuint _textureId);
+    void growTextureArray(int _user, TextureArray& _array, int _depth);
+    void setTextureFilter(int _user);
+    void clearTextureAtlas(TextureArray const& _array, int _layer);
 
     // -------------------------------------------------------------------------------------------
     // private data members
@@ -98,31 +201,106 @@ class OpenGLRenderer final :
     QMatrix4x4 projectionMatrix_;
 
     terminal::renderer::PageMargin margin_{};
+    std::optional<DamagedArea> damagedArea_;   // area to be redrawn by the next execute(), or everything
 
     std::unique_ptr<QOpenGLShaderProgram> textShader_;
     int textProjectionLocation_;
+    int textDistanceFieldLocation_;     // -1 if not supported by a custom text shader
 
     // private data members for rendering textures
     //
     GLuint vao_{};              // Vertex Array Object, covering all buffer objects
-    GLuint vbo_{};              // Buffer containing the vertex coordinates
-    //TODO: GLuint ebo_{};
-    std::unordered_map<atlas::AtlasID, GLuint> atlasMap_; // maps atlas IDs to texture IDs
-    GLuint currentTextureId_ = std::numeric_limits<GLuint>::max();
+    GLuint quadVBO_{};          // Buffer containing the unit quad, shared by all instances
+    std::unordered_map<int, TextureArray> textureArrays_; // maps atlas users to their texture arrays
+    int maxTextureLayers_;      // maximum number of layers (atlas pages) per texture array
+    CopyImageSubData copyImageSubData_ = nullptr; // grows compressed texture arrays, see colorTextureFormat()
+    bool distanceFieldGlyphs_ = false;  // monochrome atlas holds distance fields, see setDistanceFieldGlyphs()
+    bool textureFilterChanged_ = false; // monochrome texture array to be filtered accordingly
+    crispy::frame_arena frameArena_;   // memory of everything scheduled for a single frame, see finishFrame()
+    bool frameArenaTrimRequested_ = false;
     std::unique_ptr<TextureScheduler> textureScheduler_;
     atlas::TextureAtlasAllocator monochromeAtlasAllocator_;
     atlas::TextureAtlasAllocator coloredAtlasAllocator_;
     atlas::TextureAtlasAllocator lcdAtlasAllocator_;
 
+    // private data members for uploading textures
+    //
+    std::deque<PendingUpload> pendingUploads_;                      // in scheduling order
+    crispy::arena_vector<atlas::TextureInfo const*> pendingTextures_{ // textures of pendingUploads_, sorted
+        crispy::arena_allocator<atlas::TextureInfo const*>{frameArena_}
+    };
+    std::unique_ptr<StreamingBuffer> uploadBuffer_;                 // pixel unpack buffer to upload from
+
     // private data members for rendering filled rectangles
     //
-    std::vector<GLfloat> rectBuffer_;
+    size_t rectOffset_ = 0;         // offset of the first rectangle vertex in the streaming buffer
+    size_t rectVertexCount_ = 0;
     std::unique_ptr<QOpenGLShaderProgram> rectShader_;
     GLint rectProjectionLocation_;
     GLuint rectVAO_;
-    GLuint rectVBO_;
+
+    // private data members for rendering decorations
+    //
+    std::vector<DecorationInstance> decorations_;   // decorations of the current frame
+    std::unique_ptr<QOpenGLShaderProgram> decorationShader_;
+    GLint decorationProjectionLocation_;
+    GLuint decorationVAO_{};
+
+    // private data members for rendering the cell grid
+    //
+    std::vector<GLuint> gridCells_;             // cells of the current frame, packed as two RGBA32UI texels each
+    std::vector<atlas::TextureInfo const*> gridGlyphs_; // glyph of each cell in gridCells_, if any
+    int gridFirstRow_ = 0;
+    int gridLastRow_ = -1;                      // no cells to render if less than gridFirstRow_
+    crispy::Size gridPageSize_{};
+    crispy::Size gridCellSize_{};
+    PageMargin gridMargin_{};
+    int gridBaseline_ = 0;
+    int gridUnderlinePosition_ = 0;
+    int gridUnderlineThickness_ = 0;
+    crispy::Size gridTextureSize_{};            // size the cell texture was allocated with
+    GLuint gridTexture_{};
+    std::optional<RenderPalette> gridPalette_;  // palette slots of the cells are resolved against, once set
+    bool gridPaletteChanged_ = false;           // whether the palette texture is to be uploaded again
+    GLuint paletteTexture_{};
+    std::unique_ptr<QOpenGLShaderProgram> gridShader_;
+    GLuint gridVAO_{};
+
+    // Intermediate copy of the pixels moved by scrollArea(), as blitting within the same
+    // framebuffer is undefined if source and destination overlap.
+    GLuint scrollFramebuffer_{};
+    GLuint scrollTexture_{};
+    crispy::Size scrollTextureSize_{};
+
+    // Per-frame vertex data for both, rectangles and textures.
+    std::unique_ptr<StreamingBuffer> streamingBuffer_;
 
     std::optional<ScreenshotCallback> pendingScreenshotCallback_;
+    std::unique_ptr<ScreenshotReader> screenshotReader_;
+
+    std::unique_ptr<RenderPassTimer> passTimer_;
+
+    // OpenGL state bound by the frame being executed, so that binding it again can be skipped.
+    // It is forgotten with every frame, as the window system may change it in between.
+    struct BoundState
+    {
+        GLuint program = 0;
+        GLenum activeTexture = 0;
+        std::array<std::pair<GLenum, GLuint>, 5> textures{}; // target and texture of the units in use
+    };
+    BoundState boundState_;
+
+    // OpenGL state changes issued, see renderStats().
+    struct StateChanges
+    {
+        uint64_t programs = 0;      // programs bound
+        uint64_t textures = 0;      // texture units activated and textures bound
+        uint64_t skipped = 0;       // bindings skipped as the state was bound already
+        uint64_t draws = 0;         // draw calls
+    };
+    StateChanges frameStateChanges_;    // of the frame executed last
+    StateChanges totalStateChanges_;    // of all frames executed
+    uint64_t frameCount_ = 0;
 };
 
 } // end namespace
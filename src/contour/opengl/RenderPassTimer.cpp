@@ -0,0 +1,147 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <contour/opengl/RenderPassTimer.h>
+
+#include <crispy/debuglog.h>
+#include <crispy/profiler.h>
+
+#include <fmt/format.h>
+
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+using std::string;
+
+namespace terminal::renderer::opengl {
+
+namespace // {{{ helper
+{
+    auto const RenderPassTimerTag = crispy::debugtag::make("renderer.passes", "Logs details about render pass timing.");
+
+    string formatDuration(crispy::latency_histogram::duration _value)
+    {
+        return fmt::format("{:.3f}ms", static_cast<double>(_value.count()) / 1000.0);
+    }
+
+    /// Plots the GPU time of a pass in the profiler, as it cannot be shown as a zone.
+    void profileGpuTime([[maybe_unused]] RenderPass _pass, [[maybe_unused]] nanoseconds _time)
+    {
+        switch (_pass)
+        {
+            case RenderPass::Uploads: CRISPY_PROFILE_COUNTER("GPU uploads (ms)", _time.count() / 1e6); break;
+            case RenderPass::Rectangles: CRISPY_PROFILE_COUNTER("GPU rectangles (ms)", _time.count() / 1e6); break;
+            case RenderPass::Grid: CRISPY_PROFILE_COUNTER("GPU grid (ms)", _time.count() / 1e6); break;
+            case RenderPass::Decorations: CRISPY_PROFILE_COUNTER("GPU decorations (ms)", _time.count() / 1e6); break;
+            case RenderPass::Textures: CRISPY_PROFILE_COUNTER("GPU textures (ms)", _time.count() / 1e6); break;
+        }
+    }
+} // }}}
+
+RenderPassTimer::RenderPassTimer()
+{
+#if !defined(QT_OPENGL_ES_2)
+    auto const* context = QOpenGLContext::currentContext();
+    gpuTimingSupported_ = context && !context->isOpenGLES();
+    for (auto& pass: passes_)
+    {
+        for (auto& query: pass.queries)
+        {
+            if (!gpuTimingSupported_)
+                break;
+            query = std::make_unique<QOpenGLTimerQuery>();
+            gpuTimingSupported_ = query->create();
+        }
+    }
+#endif
+
+    if (!gpuTimingSupported_)
+        debuglog(RenderPassTimerTag).write("Timer queries not supported. Measuring CPU time only.");
+}
+
+RenderPassTimer::~RenderPassTimer()
+{
+#if !defined(QT_OPENGL_ES_2)
+    for (auto& pass: passes_)
+        for (auto& query: pass.queries)
+            if (query)
+                query->destroy();
+#endif
+}
+
+void RenderPassTimer::begin(RenderPass _pass)
+{
+    auto& p = pass(_pass);
+    p.cpuStart = steady_clock::now();
+
+#if !defined(QT_OPENGL_ES_2)
+    if (!gpuTimingSupported_)
+        return;
+
+    // Collect the oldest query's result if the GPU is done with it, otherwise skip this frame
+    // rather than stalling the pipeline.
+    auto& query = *p.queries[p.next];
+    if (p.pending[p.next])
+    {
+        if (!query.isResultAvailable())
+            return;
+        auto const gpuTime = nanoseconds(query.waitForResult());
+        p.gpuTime.record(gpuTime);
+        profileGpuTime(_pass, gpuTime);
+        p.pending[p.next] = false;
+    }
+
+    query.begin();
+    p.active = true;
+#endif
+}
+
+void RenderPassTimer::end(RenderPass _pass)
+{
+    auto& p = pass(_pass);
+    p.cpuTime.record(steady_clock::now() - p.cpuStart);
+
+#if !defined(QT_OPENGL_ES_2)
+    if (!p.active)
+        return;
+
+    p.queries[p.next]->end();
+    p.pending[p.next] = true;
+    p.next = (p.next + 1) % QueryCount;
+    p.active = false;
+#endif
+}
+
+string RenderPassTimer::dump() const
+{
+    auto out = fmt::format("{:<14} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10}\n",
+                           "pass", "samples", "cpu p50", "cpu p99", "gpu p50", "gpu p99", "gpu max");
+    for (size_t i = 0; i < PassCount; ++i)
+    {
+        auto const renderPass = static_cast<RenderPass>(i);
+        auto const& p = pass(renderPass);
+        auto const gpu = [&](auto _value) -> string {
+            return gpuTimingSupported_ ? formatDuration(_value) : "-";
+        };
+        out += fmt::format("{:<14} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10}\n",
+                           to_string(renderPass),
+                           p.cpuTime.count(),
+                           formatDuration(p.cpuTime.percentile(50)),
+                           formatDuration(p.cpuTime.percentile(99)),
+                           gpu(p.gpuTime.percentile(50)),
+                           gpu(p.gpuTime.percentile(99)),
+                           gpu(p.gpuTime.max()));
+    }
+    return out;
+}
+
+} // end namespace
@@ -0,0 +1,117 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <crispy/latency_histogram.h>
+
+#include <QtGui/QOpenGLContext>
+
+#if !defined(QT_OPENGL_ES_2)
+#include <QtGui/QOpenGLTimerQuery>
+#endif
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace terminal::renderer::opengl {
+
+/// Render passes of OpenGLRenderer::execute(), in execution order.
+enum class RenderPass {
+    Uploads,        //!< Creating atlases and uploading textures.
+    Rectangles,     //!< Filled rectangles, i.e. cell backgrounds, cursor, and selection.
+    Grid,           //!< The cell grid, see GridRenderer.
+    Decorations,    //!< Underlines and other cell decorations.
+    Textures,       //!< Glyphs and images.
+};
+
+constexpr std::string_view to_string(RenderPass _pass) noexcept
+{
+    switch (_pass)
+    {
+        case RenderPass::Uploads: return "uploads";
+        case RenderPass::Rectangles: return "rectangles";
+        case RenderPass::Grid: return "grid";
+        case RenderPass::Decorations: return "decorations";
+        case RenderPass::Textures: return "textures";
+    }
+    return "INVALID";
+}
+
+/// Measures the CPU and GPU time spent in each render pass.
+///
+/// CPU time is the time taken to issue the pass's OpenGL calls. GPU time is measured with
+/// timer queries (where supported, i.e. not on OpenGL ES), which are read back a few frames
+/// later so as to never wait for the GPU. Passes whose queries are all still in flight
+/// are not measured on the GPU for that frame.
+class RenderPassTimer {
+  public:
+    static constexpr size_t PassCount = static_cast<size_t>(RenderPass::Textures) + 1;
+
+    /// Creates the timer queries, if supported by the current context.
+    RenderPassTimer();
+    ~RenderPassTimer();
+
+    RenderPassTimer(RenderPassTimer const&) = delete;
+    RenderPassTimer& operator=(RenderPassTimer const&) = delete;
+
+    /// Starts measuring the given pass. Passes must not overlap.
+    void begin(RenderPass _pass);
+
+    /// Stops measuring the given pass.
+    void end(RenderPass _pass);
+
+    /// @returns a human readable table of the 50th and 99th percentile CPU and GPU time of each pass.
+    std::string dump() const;
+
+  private:
+    /// Number of queries per pass, being at least the number of frames the GPU may lag behind.
+    static constexpr size_t QueryCount = 4;
+
+    struct Pass {
+#if !defined(QT_OPENGL_ES_2)
+        std::array<std::unique_ptr<QOpenGLTimerQuery>, QueryCount> queries;
+        std::array<bool, QueryCount> pending{};     // whether or not a query's result is yet to be read
+        size_t next = 0;                            // query to use next
+        bool active = false;                        // whether or not a query is running for the current frame
+#endif
+        std::chrono::steady_clock::time_point cpuStart{};
+        crispy::latency_histogram cpuTime;
+        crispy::latency_histogram gpuTime;
+    };
+
+    Pass& pass(RenderPass _pass) noexcept { return passes_[static_cast<size_t>(_pass)]; }
+    Pass const& pass(RenderPass _pass) const noexcept { return passes_[static_cast<size_t>(_pass)]; }
+
+    std::array<Pass, PassCount> passes_;
+    bool gpuTimingSupported_ = false;
+};
+
+/// Measures the enclosing scope as the given render pass.
+class ScopedRenderPass {
+  public:
+    ScopedRenderPass(RenderPassTimer& _timer, RenderPass _pass): timer_{ _timer }, pass_{ _pass } { timer_.begin(pass_); }
+    ~ScopedRenderPass() { timer_.end(pass_); }
+
+    ScopedRenderPass(ScopedRenderPass const&) = delete;
+    ScopedRenderPass& operator=(ScopedRenderPass const&) = delete;
+
+  private:
+    RenderPassTimer& timer_;
+    RenderPass pass_;
+};
+
+} // end namespace
@@ -0,0 +1,81 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <contour/opengl/RenderThread.h>
+#include <contour/helper.h>
+
+#include <QtGui/QGuiApplication>
+#include <QtGui/QOpenGLContext>
+
+using std::move;
+using std::scoped_lock;
+using std::unique_lock;
+
+namespace contour::opengl {
+
+RenderThread::RenderThread(QOpenGLWidget& _widget, std::function<void()> _render):
+    widget_{ _widget },
+    render_{ move(_render) }
+{
+    thread_.setObjectName("render");
+    worker_.moveToThread(&thread_);
+    thread_.start();
+}
+
+RenderThread::~RenderThread()
+{
+    wait();
+    thread_.quit();
+    thread_.wait();
+}
+
+void RenderThread::requestFrame()
+{
+    {
+        auto _l = scoped_lock{lock_};
+        if (rendering_)
+            return;
+        rendering_ = true;
+    }
+
+    // A context can only be pushed to another thread by the thread it currently belongs to.
+    widget_.doneCurrent();
+    widget_.context()->moveToThread(&thread_);
+    postToObject(&worker_, [this]() { renderFrame(); });
+}
+
+void RenderThread::wait()
+{
+    auto lock = unique_lock{lock_};
+    condition_.wait(lock, [this]() { return !rendering_; });
+}
+
+void RenderThread::renderFrame()
+{
+    widget_.makeCurrent(); // also binds the widget's framebuffer
+    render_();
+    widget_.doneCurrent();
+    widget_.context()->moveToThread(qGuiApp->thread());
+
+    {
+        auto _l = scoped_lock{lock_};
+        rendering_ = false;
+    }
+    condition_.notify_all();
+
+    // Composing the widget with the rest of the window is up to the GUI thread.
+    auto* const widget = &widget_;
+    postToObject(widget, [widget]() { widget->update(); });
+}
+
+} // end namespace
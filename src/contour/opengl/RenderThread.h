@@ -0,0 +1,66 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <QtCore/QObject>
+#include <QtCore/QThread>
+#include <QtWidgets/QOpenGLWidget>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+namespace contour::opengl {
+
+/// Renders the frames of a QOpenGLWidget on a dedicated thread, off the GUI thread.
+///
+/// For each frame, the GUI thread hands the widget's OpenGL context over to the render thread,
+/// which renders into the widget's framebuffer, hands the context back and has the GUI thread
+/// compose the widget. Only the GUI thread ever hands the context over, so the GUI thread is
+/// free to use the context and everything rendering touches once wait() returned,
+/// until it returns to its event loop.
+class RenderThread {
+  public:
+    /// @param _render invoked on the render thread, with the widget's context current.
+    RenderThread(QOpenGLWidget& _widget, std::function<void()> _render);
+
+    /// Waits for the frame in flight, if any.
+    ~RenderThread();
+
+    RenderThread(RenderThread const&) = delete;
+    RenderThread& operator=(RenderThread const&) = delete;
+
+    /// Renders a frame on the render thread, followed by updating the widget on the GUI thread.
+    ///
+    /// Does nothing while a frame is being rendered already. Must be invoked from the GUI thread.
+    void requestFrame();
+
+    /// Blocks until the frame in flight, if any, has been rendered. Must be invoked from the GUI thread.
+    void wait();
+
+  private:
+    void renderFrame();
+
+    QOpenGLWidget& widget_;
+    std::function<void()> render_;
+
+    std::mutex lock_;
+    std::condition_variable condition_;
+    bool rendering_ = false;    // whether or not the render thread owns the context
+
+    QThread thread_;
+    QObject worker_;            // lives on the render thread, receiving the render requests
+};
+
+} // end namespace
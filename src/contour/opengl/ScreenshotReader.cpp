@@ -0,0 +1,158 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <contour/opengl/ScreenshotReader.h>
+#include <contour/opengl/ShaderConfig.h>
+
+#include <crispy/debuglog.h>
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+
+using std::exception;
+using std::move;
+using std::scoped_lock;
+using std::unique_lock;
+using std::vector;
+
+namespace terminal::renderer::opengl {
+
+ScreenshotReader::ScreenshotReader(QOpenGLExtraFunctions& _gl):
+    gl_{ _gl },
+    thread_{ [this]() { run(); } }
+{
+}
+
+ScreenshotReader::~ScreenshotReader()
+{
+    for (Read& read: reads_)
+        finish(read);
+    reads_.clear();
+
+    for (auto const& [buffer, byteCount]: spareBuffers_)
+        gl_.glDeleteBuffers(1, &buffer);
+
+    {
+        auto _l = scoped_lock{lock_};
+        quit_ = true;
+    }
+    condition_.notify_one();
+    thread_.join();
+}
+
+void ScreenshotReader::capture(crispy::Size _size, ScreenshotCallback _callback)
+{
+    auto const byteCount = static_cast<size_t>(_size.width) * static_cast<size_t>(_size.height) * 4;
+
+    GLuint buffer = 0;
+    auto const spare = std::find_if(spareBuffers_.begin(), spareBuffers_.end(),
+                                    [&](auto const& _spare) { return _spare.second == byteCount; });
+    if (spare != spareBuffers_.end())
+    {
+        buffer = spare->first;
+        spareBuffers_.erase(spare);
+        gl_.glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    }
+    else
+    {
+        gl_.glGenBuffers(1, &buffer);
+        gl_.glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        gl_.glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(byteCount), nullptr, GL_STREAM_READ);
+    }
+
+    // With a pixel pack buffer bound, this returns right away and the GPU writes into the buffer.
+    gl_.glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    gl_.glReadPixels(0, 0, _size.width, _size.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    gl_.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    auto const fence = gl_.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    reads_.emplace_back(Read{buffer, byteCount, fence, _size, move(_callback)});
+
+    debuglog(OpenGLRendererTag).write("Reading back screenshot ({}).", _size);
+}
+
+void ScreenshotReader::poll()
+{
+    while (!reads_.empty())
+    {
+        // Reads complete in order, so there is no need to look any further.
+        Read& read = reads_.front();
+        auto const result = gl_.glClientWaitSync(read.fence, 0, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+            return;
+
+        finish(read);
+        reads_.pop_front();
+    }
+}
+
+void ScreenshotReader::finish(Read& _read)
+{
+    constexpr GLuint64 Timeout = 1'000'000'000; // 1 second in nanoseconds
+    GLenum result = GL_TIMEOUT_EXPIRED;
+    while (result == GL_TIMEOUT_EXPIRED)
+        result = gl_.glClientWaitSync(_read.fence, GL_SYNC_FLUSH_COMMANDS_BIT, Timeout);
+    gl_.glDeleteSync(_read.fence);
+
+    auto pixels = vector<uint8_t>(_read.byteCount);
+    gl_.glBindBuffer(GL_PIXEL_PACK_BUFFER, _read.buffer);
+    auto const* mapping = gl_.glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(_read.byteCount), GL_MAP_READ_BIT);
+    if (mapping)
+    {
+        std::memcpy(pixels.data(), mapping, _read.byteCount);
+        gl_.glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    gl_.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    spareBuffers_.emplace_back(_read.buffer, _read.byteCount);
+
+    if (!mapping)
+    {
+        debuglog(OpenGLRendererTag).write("Could not map screenshot of size {}.", _read.size);
+        return;
+    }
+
+    {
+        auto _l = scoped_lock{lock_};
+        screenshots_.emplace_back(Screenshot{move(pixels), _read.size, move(_read.callback)});
+    }
+    condition_.notify_one();
+}
+
+void ScreenshotReader::run()
+{
+    auto lock = unique_lock{lock_};
+    for (;;)
+    {
+        // Screenshots still queued up are delivered before quitting.
+        condition_.wait(lock, [this]() { return quit_ || !screenshots_.empty(); });
+        if (screenshots_.empty())
+            return;
+
+        Screenshot screenshot = move(screenshots_.front());
+        screenshots_.pop_front();
+
+        lock.unlock();
+        try
+        {
+            screenshot.callback(screenshot.pixels, screenshot.size);
+        }
+        catch (exception const& e)
+        {
+            debuglog(OpenGLRendererTag).write("Delivering screenshot failed. {}", e.what());
+        }
+        lock.lock();
+    }
+}
+
+} // end namespace
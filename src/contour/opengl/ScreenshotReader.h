@@ -0,0 +1,101 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal_renderer/RenderTarget.h>
+
+#include <crispy/size.h>
+
+#include <QtGui/QOpenGLExtraFunctions>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace terminal::renderer::opengl {
+
+/// Reads back screenshots of the framebuffer without stalling the render thread.
+///
+/// The pixels are read into a pixel pack buffer, and a fence tells when the GPU is done with it.
+/// Subsequent frames poll() for finished reads, copy the pixels out, and hand them over
+/// to a worker thread that invokes the screenshot callbacks, e.g. for encoding and saving them.
+///
+/// Must be used, and destroyed, with the OpenGL context current.
+/// Destruction waits for all screenshots still in flight to be delivered.
+class ScreenshotReader {
+  public:
+    using ScreenshotCallback = RenderTarget::ScreenshotCallback;
+
+    explicit ScreenshotReader(QOpenGLExtraFunctions& _gl);
+    ~ScreenshotReader();
+
+    ScreenshotReader(ScreenshotReader const&) = delete;
+    ScreenshotReader& operator=(ScreenshotReader const&) = delete;
+
+    /// Starts reading the RGBA pixels of the given area of the current read framebuffer.
+    void capture(crispy::Size _size, ScreenshotCallback _callback);
+
+    /// Hands the screenshots the GPU is done with over to the worker thread.
+    void poll();
+
+    /// @returns whether or not screenshots are still waiting for the GPU, and thus for poll().
+    bool pending() const noexcept { return !reads_.empty(); }
+
+    /// @returns the number of bytes of the pixel pack buffers on the GPU, including the spare ones.
+    size_t storageSize() const noexcept
+    {
+        size_t bytes = 0;
+        for (auto const& read: reads_)
+            bytes += read.byteCount;
+        for (auto const& spare: spareBuffers_)
+            bytes += spare.second;
+        return bytes;
+    }
+
+  private:
+    struct Read {
+        GLuint buffer;
+        size_t byteCount;
+        GLsync fence;
+        crispy::Size size;
+        ScreenshotCallback callback;
+    };
+
+    struct Screenshot {
+        std::vector<uint8_t> pixels;
+        crispy::Size size;
+        ScreenshotCallback callback;
+    };
+
+    /// Copies the read's pixels out and queues them up for the worker thread.
+    void finish(Read& _read);
+    void run();
+
+    QOpenGLExtraFunctions& gl_;
+    std::deque<Read> reads_;                                // in capture order
+    std::vector<std::pair<GLuint, size_t>> spareBuffers_;   // buffers and their sizes, to be reused
+
+    std::mutex lock_;
+    std::condition_variable condition_;
+    std::deque<Screenshot> screenshots_;                    // waiting for the worker thread
+    bool quit_ = false;
+
+    std::thread thread_;
+};
+
+} // end namespace
@@ -20,6 +20,10 @@
 
 #include <contour/opengl/background_vert.h>
 #include <contour/opengl/background_frag.h>
+#include <contour/opengl/decoration_vert.h>
+#include <contour/opengl/decoration_frag.h>
+#include <contour/opengl/grid_vert.h>
+#include <contour/opengl/grid_frag.h>
 #include <contour/opengl/text_vert.h>
 #include <contour/opengl/text_frag.h>
 
@@ -31,6 +35,21 @@ namespace {
     {
         return std::string(reinterpret_cast<char const*>(data.data()), data.size());
     }
+
+    /// Adds a shader to the program.
+    ///
+    /// Where supported, linking the program looks up its binary in Qt's program binary cache
+    /// first (in the user's cache directory, keyed by the shader sources and the OpenGL vendor,
+    /// renderer and version), only compiling the shaders if not found there.
+    /// Compile errors are thus reported by linking.
+    bool addShader(QOpenGLShaderProgram& _program, QOpenGLShader::ShaderType _type, std::string const& _source)
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+        return _program.addCacheableShaderFromSourceCode(_type, _source.c_str());
+#else
+        return _program.addShaderFromSourceCode(_type, _source.c_str());
+#endif
+    }
 }
 
 ShaderConfig defaultShaderConfig(ShaderClass _shaderClass)
@@ -41,6 +60,10 @@ ShaderConfig defaultShaderConfig(ShaderClass _shaderClass)
     {
         case ShaderClass::Background:
             return {s(background_vert), s(background_frag), "builtin.background.vert", "builtin.background.frag"};
+        case ShaderClass::Decoration:
+            return {s(decoration_vert), s(decoration_frag), "builtin.decoration.vert", "builtin.decoration.frag"};
+        case ShaderClass::Grid:
+            return {s(grid_vert), s(grid_frag), "builtin.grid.vert", "builtin.grid.frag"};
         case ShaderClass::Text:
             return {s(text_vert), s(text_frag), "builtin.text.vert", "builtin.text.frag"};
     }
@@ -48,11 +71,12 @@ ShaderConfig defaultShaderConfig(ShaderClass _shaderClass)
     throw std::invalid_argument(fmt::format("ShaderClass<{}>", static_cast<unsigned>(_shaderClass)));
 }
 
+
 std::unique_ptr<QOpenGLShaderProgram> createShader(ShaderConfig const& _shaderConfig)
 {
     auto shader = std::make_unique<QOpenGLShaderProgram>();
 
-    if (!shader->addShaderFromSourceCode(QOpenGLShader::Vertex, _shaderConfig.vertexShader.c_str()))
+    if (!addShader(*shader, QOpenGLShader::Vertex, _shaderConfig.vertexShader))
     {
         debuglog(OpenGLRendererTag).write("Compiling vertex shader {} failed. {}", _shaderConfig.vertexShaderFileName,
                                                                   shader->log().toStdString());
@@ -60,7 +84,7 @@ std::unique_ptr<QOpenGLShaderProgram> createShader(ShaderConfig const& _shaderCo
         return {};
     }
 
-    if (!shader->addShaderFromSourceCode(QOpenGLShader::Fragment, _shaderConfig.fragmentShader.c_str()))
+    if (!addShader(*shader, QOpenGLShader::Fragment, _shaderConfig.fragmentShader))
     {
         debuglog(OpenGLRendererTag).write("Compiling fragment shader {} failed. {}", _shaderConfig.fragmentShaderFileName,
                                                                     shader->log().toStdString());
@@ -29,6 +29,8 @@ auto const inline OpenGLRendererTag = crispy::debugtag::make("renderer.opengl",
 
 enum class ShaderClass {
     Background,
+    Decoration,
+    Grid,
     Text
 };
 
@@ -45,6 +47,10 @@ inline std::string to_string(ShaderClass _shaderClass)
     {
         case ShaderClass::Background:
             return "background";
+        case ShaderClass::Decoration:
+            return "decoration";
+        case ShaderClass::Grid:
+            return "grid";
         case ShaderClass::Text:
             return "text";
     }
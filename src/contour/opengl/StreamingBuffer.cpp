@@ -0,0 +1,242 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <contour/opengl/StreamingBuffer.h>
+#include <contour/opengl/ShaderConfig.h>
+
+#include <crispy/debuglog.h>
+
+#include <QtGui/QOpenGLContext>
+
+#include <algorithm>
+#include <cstring>
+
+#if !defined(GL_MAP_PERSISTENT_BIT)
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+
+#if !defined(GL_MAP_COHERENT_BIT)
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+using std::max;
+using std::vector;
+
+namespace terminal::renderer::opengl {
+
+namespace // {{{ helper
+{
+    using BufferStorageFn = void (QOPENGLF_APIENTRYP)(GLenum, GLsizeiptr, void const*, GLbitfield);
+
+    constexpr size_t Alignment = sizeof(GLfloat); // suffices for vertex attributes and pixels of floats and bytes
+    constexpr GLbitfield PersistentFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    constexpr size_t alignUp(size_t _value) noexcept
+    {
+        return (_value + Alignment - 1) & ~(Alignment - 1);
+    }
+
+    /// @returns glBufferStorage(), if supported by the current context.
+    BufferStorageFn bufferStorageFunction()
+    {
+        auto* context = QOpenGLContext::currentContext();
+        if (!context)
+            return nullptr;
+
+        if (context->isOpenGLES())
+        {
+            if (!context->hasExtension("GL_EXT_buffer_storage"))
+                return nullptr;
+            return reinterpret_cast<BufferStorageFn>(context->getProcAddress("glBufferStorageEXT"));
+        }
+
+        auto const version = context->format().version();
+        if (version < qMakePair(4, 4) && !context->hasExtension("GL_ARB_buffer_storage"))
+            return nullptr;
+        return reinterpret_cast<BufferStorageFn>(context->getProcAddress("glBufferStorage"));
+    }
+} // }}}
+
+StreamingBuffer::StreamingBuffer(QOpenGLExtraFunctions& _gl, GLenum _target, size_t _regionSize):
+    gl_{ _gl },
+    target_{ _target },
+    regionSize_{ alignUp(_regionSize) }
+{
+    createStorage(regionSize_);
+    debuglog(OpenGLRendererTag).write("Streaming buffer {} uses {}.",
+                                      buffer_,
+                                      persistent_ ? "persistent mapping" : "buffer orphaning");
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+    destroyStorage();
+}
+
+void StreamingBuffer::createStorage(size_t _regionSize)
+{
+    regionSize_ = _regionSize;
+    gl_.glGenBuffers(1, &buffer_);
+    gl_.glBindBuffer(target_, buffer_);
+
+    if (auto const bufferStorage = bufferStorageFunction(); bufferStorage)
+    {
+        auto const totalSize = static_cast<GLsizeiptr>(regionSize_ * RegionCount);
+        bufferStorage(target_, totalSize, nullptr, PersistentFlags);
+        mapping_ = static_cast<std::byte*>(gl_.glMapBufferRange(target_, 0, totalSize, PersistentFlags));
+        persistent_ = mapping_ != nullptr;
+    }
+
+    if (!persistent_)
+    {
+        // The buffer object might already have immutable storage, if only mapping it failed.
+        gl_.glDeleteBuffers(1, &buffer_);
+        gl_.glGenBuffers(1, &buffer_);
+        gl_.glBindBuffer(target_, buffer_);
+
+        capacity_ = regionSize_;
+        gl_.glBufferData(target_, static_cast<GLsizeiptr>(capacity_), nullptr, GL_STREAM_DRAW);
+        staging_.resize(regionSize_);
+    }
+
+    gl_.glBindBuffer(target_, 0);
+    region_ = 0;
+    regionReady_ = true;
+}
+
+void StreamingBuffer::destroyStorage()
+{
+    for (auto& fence: fences_)
+    {
+        if (fence)
+            gl_.glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    if (mapping_)
+    {
+        gl_.glBindBuffer(target_, buffer_);
+        gl_.glUnmapBuffer(target_);
+        gl_.glBindBuffer(target_, 0);
+        mapping_ = nullptr;
+    }
+
+    gl_.glDeleteBuffers(1, &buffer_);
+    buffer_ = 0;
+}
+
+GLintptr StreamingBuffer::baseOffset() const noexcept
+{
+    return persistent_ ? static_cast<GLintptr>(region_ * regionSize_) : 0;
+}
+
+void StreamingBuffer::waitForRegion(size_t _region)
+{
+    auto& fence = fences_[_region];
+    if (!fence)
+        return;
+
+    constexpr GLuint64 Timeout = 1'000'000'000; // 1 second in nanoseconds
+    GLenum result = GL_TIMEOUT_EXPIRED;
+    while (result == GL_TIMEOUT_EXPIRED)
+        result = gl_.glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, Timeout);
+
+    gl_.glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void StreamingBuffer::grow(size_t _minimumSize)
+{
+    auto const newRegionSize = alignUp(max(regionSize_ * 2, _minimumSize));
+    debuglog(OpenGLRendererTag).write("Growing streaming buffer {} regions from {} to {} bytes.",
+                                      buffer_, regionSize_, newRegionSize);
+
+    if (!persistent_)
+    {
+        // flush() takes care of growing the buffer object itself.
+        regionSize_ = newRegionSize;
+        staging_.resize(regionSize_);
+        return;
+    }
+
+    // Draw calls already issued keep the old buffer alive until the GPU is done with them,
+    // so only the current frame's data needs to be carried over.
+    auto const carried = vector<std::byte>(mapping_ + baseOffset(), mapping_ + baseOffset() + size_);
+    destroyStorage();
+    createStorage(newRegionSize);
+    if (persistent_)
+        std::memcpy(mapping_, carried.data(), carried.size());
+    else
+        std::memcpy(staging_.data(), carried.data(), carried.size());
+}
+
+StreamingBuffer::Allocation StreamingBuffer::allocate(size_t _size)
+{
+    if (persistent_ && !regionReady_)
+    {
+        waitForRegion(region_);
+        regionReady_ = true;
+    }
+
+    auto const offset = alignUp(size_);
+    if (offset + _size > regionSize_)
+        grow(offset + _size);
+
+    size_ = offset + _size;
+
+    auto* const base = persistent_ ? mapping_ + baseOffset() : staging_.data();
+    return Allocation{base + offset, offset};
+}
+
+void StreamingBuffer::flush()
+{
+    // Writes to a coherent mapping become visible to the GPU without any further ado.
+    if (persistent_ || flushed_ == size_)
+        return;
+
+    gl_.glBindBuffer(target_, buffer_);
+    if (flushed_ == 0 || size_ > capacity_)
+    {
+        // Orphan the storage, so that the driver does not need to wait for draw calls still reading it.
+        capacity_ = max(capacity_, regionSize_);
+        gl_.glBufferData(target_, static_cast<GLsizeiptr>(capacity_), nullptr, GL_STREAM_DRAW);
+        gl_.glBufferSubData(target_, 0, static_cast<GLsizeiptr>(size_), staging_.data());
+    }
+    else
+    {
+        gl_.glBufferSubData(target_,
+                            static_cast<GLintptr>(flushed_),
+                            static_cast<GLsizeiptr>(size_ - flushed_),
+                            staging_.data() + flushed_);
+    }
+    gl_.glBindBuffer(target_, 0);
+    flushed_ = size_;
+}
+
+void StreamingBuffer::finishFrame()
+{
+    if (persistent_)
+    {
+        if (!size_)
+            return; // nothing written, so the region can be reused as is
+
+        fences_[region_] = gl_.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region_ = (region_ + 1) % RegionCount;
+        regionReady_ = false;
+    }
+
+    size_ = 0;
+    flushed_ = 0;
+}
+
+} // end namespace
@@ -0,0 +1,106 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <QtGui/QOpenGLExtraFunctions>
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace terminal::renderer::opengl {
+
+/// Buffer object for data that is written anew every frame,
+/// such as vertex data (GL_ARRAY_BUFFER) or texture data to upload (GL_PIXEL_UNPACK_BUFFER).
+///
+/// Where buffer storage is supported (OpenGL 4.4, GL_ARB_buffer_storage or GL_EXT_buffer_storage),
+/// the buffer is persistently mapped and split into one region per frame in flight.
+/// Data is written straight into the mapped memory, and a fence guards each region from being
+/// overwritten before the GPU is done reading it.
+///
+/// Otherwise the data is staged in host memory and uploaded before drawing,
+/// orphaning the buffer's previous storage once per frame.
+///
+/// Offsets are relative to the frame. Add baseOffset() when pointing vertex attributes into the buffer.
+/// The buffer is left unbound from its target, so that it does not affect unrelated calls,
+/// such as texture uploads from host memory.
+class StreamingBuffer {
+  public:
+    /// Number of frames the GPU may lag behind before writing blocks.
+    static constexpr size_t RegionCount = 3;
+
+    StreamingBuffer(QOpenGLExtraFunctions& _gl, GLenum _target, size_t _regionSize);
+    ~StreamingBuffer();
+
+    StreamingBuffer(StreamingBuffer const&) = delete;
+    StreamingBuffer& operator=(StreamingBuffer const&) = delete;
+
+    /// @returns the OpenGL buffer object, which may change whenever the buffer grows.
+    GLuint id() const noexcept { return buffer_; }
+
+    /// @returns whether or not the buffer is persistently mapped.
+    bool persistent() const noexcept { return persistent_; }
+
+    /// @returns the offset of the current frame's data within the buffer.
+    GLintptr baseOffset() const noexcept;
+
+    struct Allocation {
+        void* data;         // memory to write the data to, valid until the next allocate() call
+        size_t offset;      // offset relative to the current frame
+    };
+
+    /// Reserves @p _size bytes for the current frame, growing the buffer if needed.
+    Allocation allocate(size_t _size);
+
+    /// @returns the number of bytes allocated in the current frame.
+    size_t size() const noexcept { return size_; }
+
+    /// @returns the number of bytes of the buffer's storage on the GPU.
+    size_t storageSize() const noexcept { return persistent_ ? regionSize_ * RegionCount : capacity_; }
+
+    /// @returns the number of bytes staged in host memory (fallback mode only).
+    size_t stagingSize() const noexcept { return staging_.capacity(); }
+
+    /// Makes all data allocated so far available to the GPU. Must be invoked before drawing from it.
+    void flush();
+
+    /// Marks the end of the frame, after all draw calls reading from this buffer were issued.
+    void finishFrame();
+
+  private:
+    void createStorage(size_t _regionSize);
+    void destroyStorage();
+    void waitForRegion(size_t _region);
+    void grow(size_t _minimumSize);
+
+    QOpenGLExtraFunctions& gl_;
+    GLenum const target_;
+    bool persistent_ = false;
+    GLuint buffer_{};
+    size_t regionSize_;
+    size_t size_ = 0;           // bytes allocated in the current frame
+
+    // persistent mode
+    std::byte* mapping_ = nullptr;
+    size_t region_ = 0;
+    bool regionReady_ = false;
+    std::array<GLsync, RegionCount> fences_{};
+
+    // fallback mode
+    std::vector<std::byte> staging_;
+    size_t flushed_ = 0;        // bytes uploaded from staging_ in the current frame
+    size_t capacity_ = 0;       // size of the buffer's current storage
+};
+
+} // end namespace
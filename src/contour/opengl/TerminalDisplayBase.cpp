@@ -0,0 +1,869 @@
+/**
+ * This file is part of the "contour" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <contour/opengl/TerminalDisplayBase.h>
+#include <contour/opengl/OpenGLRenderer.h>
+
+#include <contour/helper.h>
+
+#include <crispy/algorithm.h>
+#include <crispy/cache_stats.h>
+#include <crispy/debuglog.h>
+#include <crispy/stdfs.h>
+#include <crispy/times.h>
+#include <crispy/trace.h>
+
+#include <QtCore/QStandardPaths>
+#include <QtGui/QClipboard>
+#include <QtGui/QGuiApplication>
+#include <QtGui/QImage>
+#include <QtGui/QInputMethodEvent>
+#include <QtGui/QKeyEvent>
+#include <QtGui/QOpenGLContext>
+#include <QtGui/QScreen>
+#include <QtWidgets/QApplication>
+#include <QtWidgets/QWidget>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <tuple>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+using crispy::Size;
+
+using std::exception;
+using std::function;
+using std::make_unique;
+using std::max;
+using std::scoped_lock;
+using std::string;
+using std::string_view;
+using std::tuple;
+using std::vector;
+using std::chrono::steady_clock;
+
+using namespace std::string_view_literals;
+
+namespace chrono = std::chrono;
+
+#if defined(_MSC_VER)
+#define __PRETTY_FUNCTION__ __FUNCDNAME__
+#endif
+
+namespace contour::opengl {
+
+namespace // {{{ helpers
+{
+    /// Time the window size must not change for, before the application is informed about it.
+    auto constexpr PtyResizeDelay = chrono::milliseconds(100);
+
+    /// Interval the caches' effectiveness is logged at, if enabled.
+    auto constexpr StatsSummaryInterval = chrono::seconds(10);
+
+    auto const CacheStatsTag = crispy::debugtag::make("renderer.caches", "Logs the hit rates of all caches periodically.");
+
+    chrono::milliseconds frameInterval(double _refreshRate)
+    {
+        return chrono::duration_cast<chrono::milliseconds>(chrono::duration<double>(1.0 / max(_refreshRate, 1.0)));
+    }
+
+    terminal::renderer::FontDescriptions sanitizeDPI(terminal::renderer::FontDescriptions _fonts, crispy::Point _dpi)
+    {
+        if (_fonts.dpi.x <= 0 || _fonts.dpi.y <= 0)
+            _fonts.dpi = _dpi;
+        return _fonts;
+    }
+} // }}}
+
+TerminalDisplayBase::TerminalDisplayBase(config::TerminalProfile const& _profile,
+                                         TerminalSession& _session,
+                                         function<void()> _adaptSize,
+                                         function<void(bool)> _enableBackgroundBlur,
+                                         crispy::Point _screenDPI):
+    profile_{ _profile },
+    session_{ _session },
+    adaptSize_{ std::move(_adaptSize) },
+    enableBackgroundBlur_{ std::move(_enableBackgroundBlur) },
+    renderer_{
+        terminal().screenSize(),
+        sanitizeDPI(profile_.fonts, _screenDPI),
+        terminal().screen().colorPalette(),
+        profile_.backgroundOpacity,
+        profile_.hyperlinkDecoration.normal,
+        profile_.hyperlinkDecoration.hover
+    },
+    size_{ terminal().screenSize() * gridMetrics().cellSize }
+{
+    updateTimer_.setSingleShot(true);
+    QObject::connect(&updateTimer_, &QTimer::timeout, &updateTimer_, [this]() { scheduleRedraw(); });
+
+    frameTimer_.setSingleShot(true);
+    frameTimer_.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&frameTimer_, &QTimer::timeout, &frameTimer_, [this]() { requestFrame(); });
+    frameScheduler_.setRenderAhead(chrono::milliseconds(session_.config().framePacing.renderAhead));
+
+    // Interactive resizes are applied to the screen at most once per frame,
+    // and to the PTY only once the size stopped changing.
+    resizeTimer_.setSingleShot(true);
+    resizeTimer_.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&resizeTimer_, &QTimer::timeout, &resizeTimer_, [this]() { applyResize(); });
+    ptyResizeTimer_.setSingleShot(true);
+    QObject::connect(&ptyResizeTimer_, &QTimer::timeout, &ptyResizeTimer_, [this]() {
+        auto const cells = terminal().screenSize();
+        if (cells != terminal().device().screenSize())
+            terminal().resizePty(cells, cells * gridMetrics().cellSize);
+    });
+
+    mouseMoveTimer_.setSingleShot(true);
+    mouseMoveTimer_.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&mouseMoveTimer_, &QTimer::timeout, &mouseMoveTimer_, [this]() { flushMouseMove(); });
+
+    // The tag may be enabled at runtime, hence the timer runs regardless.
+    statsTimer_.setInterval(StatsSummaryInterval);
+    QObject::connect(&statsTimer_, &QTimer::timeout, &statsTimer_, [this]() { statsSummary(); });
+    statsTimer_.start();
+}
+
+QSurfaceFormat TerminalDisplayBase::surfaceFormat()
+{
+    QSurfaceFormat format;
+
+    constexpr bool forceOpenGLES = (
+#if defined(__linux__)
+        true
+#else
+        false
+#endif
+    );
+
+    if (forceOpenGLES || QOpenGLContext::openGLModuleType() == QOpenGLContext::LibGLES)
+    {
+        format.setVersion(3, 2);
+        format.setRenderableType(QSurfaceFormat::OpenGLES);
+    }
+    else
+    {
+        format.setVersion(3, 3);
+        format.setRenderableType(QSurfaceFormat::OpenGL);
+    }
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setAlphaBufferSize(8);
+    format.setSwapBehavior(QSurfaceFormat::DoubleBuffer);
+    format.setSwapInterval(1);
+
+#if !defined(NDEBUG)
+    format.setOption(QSurfaceFormat::DebugContext);
+#endif
+
+    return format;
+}
+
+void TerminalDisplayBase::reportUnhandledException(string_view _where, exception const& _e)
+{
+    auto const message = fmt::format("{}: Unhandled exception caught ({}). {}", _where, typeid(_e).name(), _e.what());
+    debuglog(WidgetTag).write("{}", message);
+    std::cerr << message << std::endl;
+}
+
+QSize TerminalDisplayBase::pageSizeHint() const
+{
+    auto const viewSize = gridMetrics().cellSize * profile_.terminalSize;
+    return QSize(viewSize.width, viewSize.height);
+}
+
+QSize TerminalDisplayBase::minimumPageSizeHint() const
+{
+    auto constexpr MinimumScreenSize = Size{3, 2};
+    auto const viewSize = MinimumScreenSize * gridMetrics().cellSize;
+    return QSize(viewSize.width, viewSize.height);
+}
+
+// {{{ attributes
+double TerminalDisplayBase::refreshRate() const
+{
+    auto const* screen = hostScreen();
+    if (!screen)
+        return profile_.refreshRate != 0.0 ? profile_.refreshRate : 30.0;
+
+    // The rate measured from presented frames is more accurate than the one reported by the system.
+    auto const systemRefreshRate = framePacing() ? frameScheduler_.refreshRate()
+                                                 : static_cast<double>(screen->refreshRate());
+    if (1.0 < profile_.refreshRate && profile_.refreshRate < systemRefreshRate)
+        return profile_.refreshRate;
+    else
+        return systemRefreshRate;
+}
+
+double TerminalDisplayBase::effectiveRefreshRate() const
+{
+    // Frames are rendered at half the refresh rate under heavy rendering pressure.
+    if (renderer_.degradationLevel() >= terminal::renderer::DegradationLevel::ReducedRefreshRate)
+        return refreshRate() / 2.0;
+    else
+        return refreshRate();
+}
+
+bool TerminalDisplayBase::isFullScreen() const
+{
+    auto const* top = topLevel();
+    return top && top->isFullScreen();
+}
+
+crispy::Size TerminalDisplayBase::pixelSize() const
+{
+    return size_;
+}
+
+crispy::Size TerminalDisplayBase::cellSize() const
+{
+    return gridMetrics().cellSize;
+}
+// }}}
+
+// {{{ rendering
+void TerminalDisplayBase::initializeRenderer(Size _pixels)
+{
+    initializeOpenGLFunctions();
+
+    {
+        auto const _shaderTrace = crispy::trace_scope("shader compilation");
+        renderTarget_ = make_unique<terminal::renderer::opengl::OpenGLRenderer>(
+            *config::Config::loadShaderConfig(config::ShaderClass::Text),
+            *config::Config::loadShaderConfig(config::ShaderClass::Background),
+            *config::Config::loadShaderConfig(config::ShaderClass::Decoration),
+            *config::Config::loadShaderConfig(config::ShaderClass::Grid),
+            _pixels,
+            computeMargin(gridMetrics().cellSize, terminal().screenSize(), _pixels),
+            session_.config().experimentalFeatures.count("compressed_color_atlas") != 0
+        );
+    }
+
+    renderer_.setRenderTarget(*renderTarget_);
+    renderer_.setCellGridEnabled(session_.config().experimentalFeatures.count("cell_grid") != 0);
+}
+
+void TerminalDisplayBase::finishInitialization()
+{
+    initialized_ = true;
+    session_.displayInitialized();
+}
+
+void TerminalDisplayBase::renderFrame(bool _redrawAll)
+{
+    try
+    {
+        bool const reverseVideo = terminal().screen().isModeEnabled(terminal::DECMode::ReverseVideo);
+        auto const bg = reverseVideo
+            ? terminal::RGBAColor(profile_.colors.defaultForeground, uint8_t(profile_.backgroundOpacity))
+            : terminal::RGBAColor(profile_.colors.defaultBackground, uint8_t(profile_.backgroundOpacity));
+
+        if (bg != backgroundColor_)
+        {
+            glClearColor(float(bg.red()) / 255.0f,
+                         float(bg.green()) / 255.0f,
+                         float(bg.blue()) / 255.0f,
+                         float(bg.alpha()) / 255.0f);
+            backgroundColor_ = bg;
+            _redrawAll = true;
+        }
+
+        // Otherwise, the render target clears only the area it is about to redraw.
+        if (_redrawAll)
+            renderer_.invalidate();
+
+        renderer_.render(terminal(), steady_clock::now(), lastInput_.load());
+        if (auto const outputTime = renderer_.renderedOutputTime(); outputTime != steady_clock::time_point{})
+            paintedOutputTime_ = outputTime;
+
+        // Textures held back by the per-frame upload budget are rendered with the next frame,
+        // and screenshots being read back are picked up by it.
+        if (renderTarget_->uploadsPending() || renderTarget_->screenshotsPending())
+            post([this]() { scheduleRedraw(); });
+    }
+    catch (exception const& e)
+    {
+        reportUnhandledException(__PRETTY_FUNCTION__, e);
+    }
+}
+
+void TerminalDisplayBase::framePresented()
+{
+    // Starting up is considered complete once the first frame has been presented.
+    finishStartupTrace();
+
+    auto const now = steady_clock::now();
+    auto const outputTime = std::exchange(paintedOutputTime_, steady_clock::time_point{});
+    terminal().latencyTrace().record(terminal::LatencyStage::Presented, outputTime, now);
+    session_.framePresented(outputTime, now);
+    lastFrameSwap_ = now;
+
+    bool refreshRateChanged = false;
+    if (framePacing())
+    {
+        auto const* screen = hostScreen();
+        bool const screenChanged = screen && frameScheduler_.setNominalRefreshRate(static_cast<double>(screen->refreshRate()));
+        bool const estimateChanged = frameScheduler_.presented(now);
+        refreshRateChanged = screenChanged || estimateChanged;
+    }
+
+    // The refresh rate is reduced, or restored, as rendering pressure changes.
+    auto const degradationLevel = renderer_.degradationLevel();
+    if (std::exchange(degradationLevel_, degradationLevel) != degradationLevel)
+        refreshRateChanged = true;
+
+    if (refreshRateChanged)
+        terminal().setRefreshRate(effectiveRefreshRate());
+    renderer_.setRefreshRate(refreshRate());
+}
+
+void TerminalDisplayBase::scheduleCursorBlink()
+{
+    if (profile_.cursorDisplay == terminal::CursorDisplay::Blink
+            && terminal().cursorVisibility()
+            && terminal().visible())
+        updateTimer_.start(terminal().nextRender(steady_clock::now()));
+}
+
+void TerminalDisplayBase::scheduleUpdate()
+{
+    auto const reducedRefreshRate = renderer_.degradationLevel() >= terminal::renderer::DegradationLevel::ReducedRefreshRate;
+    if (!framePacing() && !reducedRefreshRate)
+    {
+        requestFrame();
+        return;
+    }
+
+    // The render buffer is built when painting, so delaying the paint has it built just in time, too.
+    if (frameTimer_.isActive())
+        return;
+
+    auto const now = steady_clock::now();
+    auto renderDelay = framePacing() ? frameScheduler_.renderDelay(now) : steady_clock::duration::zero();
+
+    // Under heavy rendering pressure, frames are spaced out to the reduced refresh rate.
+    if (reducedRefreshRate)
+    {
+        auto const interval = chrono::duration_cast<steady_clock::duration>(chrono::duration<double>(1.0 / max(effectiveRefreshRate(), 1.0)));
+        renderDelay = max(renderDelay, lastFrameSwap_ + interval - now);
+    }
+
+    auto const delay = chrono::duration_cast<chrono::milliseconds>(renderDelay);
+    if (delay.count() <= 0)
+        requestFrame();
+    else
+        frameTimer_.start(delay);
+}
+
+void TerminalDisplayBase::requestFrame()
+{
+    // Nothing is rendered for displays that cannot be seen, e.g. when minimized or on another
+    // virtual desktop. The screen stays dirty, and the display renders once exposed again,
+    // see updateVisibility().
+    if (!exposed())
+        return;
+
+    requestPaint();
+}
+
+void TerminalDisplayBase::updateVisibility()
+{
+    auto const visible = exposed();
+    if (visible == terminal().visible())
+        return;
+
+    // While hidden, the terminal only parses, and neither frames nor the blinking cursor are rendered.
+    terminal().setVisible(visible);
+    if (!visible)
+    {
+        updateTimer_.stop();
+        return;
+    }
+
+    // Renders a single frame to catch up, which also restarts the blinking cursor's timer.
+    post([this]() {
+        markScreenDirty();
+        requestFrame();
+    });
+}
+
+void TerminalDisplayBase::onScreenChanged()
+{
+    // The DPI follows the screen the window has been moved to, keeping the glyphs
+    // of the previous one for when it is moved back.
+    auto const dpi = screenDPI();
+    auto const dpiScale = profile_.fonts.dpiScale;
+
+    waitForRenderer();
+    if (!renderer_.setDpi(crispy::Point{static_cast<int>(dpi.x * dpiScale), static_cast<int>(dpi.y * dpiScale)}))
+        return;
+
+    renderer_.setMargin(computeMargin(gridMetrics().cellSize, screenSize(), pixelSize()));
+    resizeTerminal(size_); // same pixels, but adjusted terminal rows/columns and margin
+    updateMinimumSize();
+}
+
+void TerminalDisplayBase::scheduleResize(Size _pixels)
+{
+    debuglog(WidgetTag).write("resizing to {}", _pixels);
+    if (_pixels.width == 0 || _pixels.height == 0)
+        return;
+
+    waitForRenderer();
+    size_ = _pixels;
+
+    // The current screen is shown at the new size until the resize is applied.
+    renderer_.setRenderSize(size_);
+    renderer_.setMargin(computeMargin(gridMetrics().cellSize, terminal().screenSize(), size_));
+
+    if (!resizeTimer_.isActive())
+        resizeTimer_.start(frameInterval(refreshRate()));
+}
+
+void TerminalDisplayBase::applyResize()
+{
+    waitForRenderer();
+    auto const newScreenSize = screenSize();
+
+    renderer_.setScreenSize(newScreenSize);
+    renderer_.setMargin(computeMargin(gridMetrics().cellSize, newScreenSize, size_));
+
+    if (newScreenSize != terminal().screenSize())
+    {
+        terminal().resizePage(newScreenSize, newScreenSize * gridMetrics().cellSize);
+        terminal().clearSelection();
+        ptyResizeTimer_.start(PtyResizeDelay);
+    }
+
+    scheduleRedraw();
+}
+
+void TerminalDisplayBase::resizeTerminal(Size _pixels)
+{
+    waitForRenderer();
+    size_ = _pixels;
+
+    auto const newScreenSize = screenSize();
+
+    renderer_.setRenderSize(_pixels);
+    renderer_.setScreenSize(newScreenSize);
+    renderer_.setMargin(computeMargin(gridMetrics().cellSize, newScreenSize, size_));
+
+    if (newScreenSize != terminal().screenSize())
+    {
+        terminal().resizeScreen(newScreenSize, newScreenSize * gridMetrics().cellSize);
+        terminal().clearSelection();
+    }
+}
+// }}}
+
+// {{{ input
+void TerminalDisplayBase::keyPressed(QKeyEvent* _event)
+{
+    lastInput_ = steady_clock::now();
+    sendKeyEvent(_event, session_);
+}
+
+void TerminalDisplayBase::wheelMoved(QWheelEvent* _event)
+{
+    lastInput_ = steady_clock::now();
+    sendWheelEvent(_event, session_);
+}
+
+void TerminalDisplayBase::mousePressed(QMouseEvent* _event)
+{
+    lastInput_ = steady_clock::now();
+    flushMouseMove();
+    sendMousePressEvent(_event, session_);
+}
+
+void TerminalDisplayBase::mouseMoved(QMouseEvent* _event)
+{
+    // High-frequency mice report far more moves than can be shown, so these are coalesced
+    // into at most one per frame, sending only the most recent one.
+    pendingMouseMove_ = makeMouseMoveEvent(_event, session_);
+    if (mouseMoveTimer_.isActive())
+        return;
+
+    auto const delay = chrono::duration_cast<chrono::milliseconds>(lastMouseMove_ + frameInterval(refreshRate()) - steady_clock::now());
+    if (delay.count() > 0)
+        mouseMoveTimer_.start(delay);
+    else
+        flushMouseMove();
+}
+
+void TerminalDisplayBase::mouseReleased(QMouseEvent* _event)
+{
+    flushMouseMove();
+    sendMouseReleaseEvent(_event, session_);
+}
+
+void TerminalDisplayBase::inputMethodCommitted(QInputMethodEvent* _event)
+{
+    if (!_event->commitString().isEmpty())
+    {
+        QKeyEvent keyEvent(QEvent::KeyPress, 0, Qt::NoModifier, _event->commitString());
+        keyPressed(&keyEvent);
+    }
+    _event->accept();
+}
+
+void TerminalDisplayBase::flushMouseMove()
+{
+    mouseMoveTimer_.stop();
+    if (!pendingMouseMove_)
+        return;
+
+    lastMouseMove_ = steady_clock::now();
+    session_.sendMouseMoveEvent(*pendingMouseMove_, lastMouseMove_);
+    pendingMouseMove_.reset();
+}
+// }}}
+
+// {{{ (user requested) actions
+bool TerminalDisplayBase::requestPermission(config::Permission _allowedByConfig, string_view _topicText)
+{
+    return contour::requestPermission(rememberedPermissions_, hostWidget(), _allowedByConfig, _topicText);
+}
+
+terminal::FontDef TerminalDisplayBase::getFontDef()
+{
+    return getFontDefinition(renderer_);
+}
+
+void TerminalDisplayBase::bell()
+{
+    QApplication::beep();
+}
+
+void TerminalDisplayBase::copyToClipboard(string_view _data)
+{
+    if (QClipboard* clipboard = QGuiApplication::clipboard(); clipboard != nullptr)
+        clipboard->setText(QString::fromUtf8(_data.data(), static_cast<int>(_data.size())));
+}
+
+string TerminalDisplayBase::renderStats()
+{
+    // The render passes' timer queries are read back through the display's context.
+    waitForRenderer();
+    makeRenderContextCurrent();
+    return renderer_.renderStats();
+}
+
+string TerminalDisplayBase::renderStatsJson()
+{
+    waitForRenderer();
+    return renderer_.statsJson();
+}
+
+void TerminalDisplayBase::statsSummary()
+{
+    if (!crispy::debugtag::enabled(CacheStatsTag))
+        return;
+
+    auto caches = crispy::cache_statistics{};
+    {
+        auto const _l = scoped_lock{terminal()};
+        caches.add("images.pixels", terminal().screen().imagePool().pixelCacheStats());
+    }
+    waitForRenderer();
+    renderer_.collectCacheStats(caches);
+    debuglog(CacheStatsTag).write("Cache statistics:\n{}", caches.table());
+}
+
+void TerminalDisplayBase::collectMemoryUsage(crispy::memory_usage& _usage)
+{
+    waitForRenderer();
+    makeRenderContextCurrent();
+    renderer_.collectMemoryUsage(_usage);
+}
+
+void TerminalDisplayBase::dumpState()
+{
+    waitForRenderer();
+    makeRenderContextCurrent();
+    auto const tmpDir = FileSystem::path(QStandardPaths::writableLocation(QStandardPaths::TempLocation).toStdString());
+    auto const targetDir = tmpDir / FileSystem::path("contour-debug");
+    FileSystem::create_directories(targetDir);
+    debuglog(WidgetTag).write("Dumping state into directory: {}", targetDir.generic_string());
+    // TODO: The above should be done from the outside and the targetDir being passed into this call.
+    // TODO: maybe zip this dir in the end.
+
+    terminal().screen().dumpState("Dump screen state.");
+    {
+        auto rendererState = std::ofstream((targetDir / "renderer.txt").generic_string());
+        renderer_.dumpState(rendererState);
+    }
+
+    enum class ImageBufferFormat { RGBA, RGB, Alpha };
+
+    auto screenshotSaver = [](FileSystem::path const& _filename, ImageBufferFormat _format) {
+        auto const [qImageFormat, elementCount] = [&]() -> tuple<QImage::Format, int> {
+            switch (_format) {
+                case ImageBufferFormat::RGBA: return tuple{QImage::Format_RGBA8888, 4};
+                case ImageBufferFormat::RGB: return tuple{QImage::Format_RGB888, 3};
+                case ImageBufferFormat::Alpha: return tuple{QImage::Format_Grayscale8, 1};
+            }
+            return tuple{QImage::Format_Grayscale8, 1};
+        }();
+
+        // That's a little workaround for MacOS/X's C++ Clang compiler.
+        auto const theImageFormat = qImageFormat;
+        auto const theElementCount = elementCount;
+
+        return [_filename, theImageFormat, theElementCount](vector<uint8_t> const& _buffer, Size _size) {
+            auto image = make_unique<QImage>(_size.width, _size.height, theImageFormat);
+            // Vertically flip the image, because the coordinate system between OpenGL and desktop screens is inverse.
+            crispy::for_each(
+                // TODO: std::execution::seq,
+                crispy::times(_size.height),
+                [&_buffer, &image, theElementCount, _size](int i) {
+                    uint8_t const* sourceLine = &_buffer.data()[i * _size.width * theElementCount];
+                    std::copy(sourceLine, sourceLine + _size.width * theElementCount, image->scanLine(_size.height - i - 1));
+                }
+            );
+            image->save(QString::fromStdString(_filename.generic_string()));
+        };
+    };
+
+    auto const atlasScreenshotSaver = [&screenshotSaver, &targetDir](string const& _allocatorName,
+                                                                     unsigned _instanceId,
+                                                                     vector<uint8_t> const& _buffer,
+                                                                     Size _size) {
+        return [&screenshotSaver, &targetDir, &_buffer, _size, _allocatorName, _instanceId](ImageBufferFormat _format) {
+            auto const formatText = [&]() {
+                switch (_format) {
+                    case ImageBufferFormat::RGBA: return "rgba"sv;
+                    case ImageBufferFormat::RGB: return "rgb"sv;
+                    case ImageBufferFormat::Alpha: return "alpha"sv;
+                }
+                return "unknown"sv;
+            }();
+            auto const fileName = targetDir / fmt::format("atlas-{}-{}-{}.png", _allocatorName, formatText, _instanceId);
+            return screenshotSaver(fileName, _format)(_buffer, _size);
+        };
+    };
+
+    terminal::renderer::RenderTarget& renderTarget = renderer_.renderTarget();
+
+    for (auto const* allocator: renderTarget.allAtlasAllocators())
+    {
+        for (auto const atlasID: allocator->activeAtlasTextures())
+        {
+            auto infoOpt = renderTarget.readAtlas(*allocator, atlasID);
+            if (!infoOpt.has_value())
+                continue;
+
+            terminal::renderer::AtlasTextureInfo& info = infoOpt.value();
+            auto const saveScreenshot = atlasScreenshotSaver(allocator->name(), atlasID.value, info.buffer, info.size);
+            switch (info.format)
+            {
+                case terminal::renderer::atlas::Format::CompressedRGBA: // never read back as such
+                case terminal::renderer::atlas::Format::RGBA:
+                    saveScreenshot(ImageBufferFormat::RGBA);
+                    break;
+                case terminal::renderer::atlas::Format::RGB:
+                    saveScreenshot(ImageBufferFormat::RGB);
+                    break;
+                case terminal::renderer::atlas::Format::Red:
+                    saveScreenshot(ImageBufferFormat::Alpha);
+                    break;
+            }
+        }
+    }
+
+    renderTarget.scheduleScreenshot(screenshotSaver(targetDir / "screenshot.png", ImageBufferFormat::RGBA));
+}
+
+void TerminalDisplayBase::notify(string_view /*_title*/, string_view /*_body*/)
+{
+    // TODO: showNotification callback to Controller?
+}
+
+void TerminalDisplayBase::resizeWindow(int _width, int _height, bool _inPixels)
+{
+    if (isFullScreen())
+    {
+        debuglog(WidgetTag).write("Application request to resize window in full screen mode denied.");
+        return;
+    }
+
+    auto requestedScreenSize = terminal().screenSize();
+    if (_inPixels)
+    {
+        auto const pixels = Size{_width ? _width : size_.width, _height ? _height : size_.height};
+        requestedScreenSize = pixels / gridMetrics().cellSize;
+    }
+    else
+    {
+        if (_width)
+            requestedScreenSize.width = _width;
+        if (_height)
+            requestedScreenSize.height = _height;
+    }
+
+    waitForRenderer();
+    const_cast<config::TerminalProfile&>(profile_).terminalSize = requestedScreenSize;
+    renderer_.setScreenSize(requestedScreenSize);
+    terminal().resizeScreen(requestedScreenSize, requestedScreenSize * gridMetrics().cellSize);
+    if (auto* widget = hostWidget(); widget)
+        widget->updateGeometry();
+    adaptSize_();
+}
+
+void TerminalDisplayBase::setFonts(terminal::renderer::FontDescriptions _fontDescriptions)
+{
+    waitForRenderer();
+    if (applyFontDescription(gridMetrics().cellSize, screenSize(), size_, screenDPI(), renderer_, std::move(_fontDescriptions)))
+        resizeTerminal(size_); // same pixels, but adjusted terminal rows/columns and margin
+}
+
+bool TerminalDisplayBase::setFontSize(text::font_size _size)
+{
+    waitForRenderer();
+    if (!renderer_.setFontSize(_size))
+        return false;
+
+    renderer_.setMargin(computeMargin(gridMetrics().cellSize, screenSize(), pixelSize()));
+    resizeTerminal(size_); // same pixels, but adjusted terminal rows/columns and margin
+    updateMinimumSize();
+    return true;
+}
+
+bool TerminalDisplayBase::setScreenSize(crispy::Size _newScreenSize)
+{
+    if (_newScreenSize == terminal().screenSize())
+        return false;
+
+    waitForRenderer();
+    renderer_.setScreenSize(_newScreenSize);
+    terminal().resizeScreen(_newScreenSize, _newScreenSize * cellSize());
+    return true;
+}
+
+void TerminalDisplayBase::setTerminalProfile(config::TerminalProfile _profile)
+{
+    (void) _profile; // profile_ = std::move(_profile); // TODO
+}
+
+void TerminalDisplayBase::setWindowTitle(string_view _title)
+{
+    auto const title = _title.empty() ? string("contour") : fmt::format("{} - contour", _title);
+
+    // TODO: since we do not control the whole window, it would be best to emit a signal (or call back) instead.
+    if (auto* top = topLevel(); top)
+        top->setWindowTitle(QString::fromUtf8(title.c_str()));
+}
+
+void TerminalDisplayBase::setWindowFullScreen()
+{
+    if (auto* top = topLevel(); top)
+        top->showFullScreen();
+}
+
+void TerminalDisplayBase::setWindowMaximized()
+{
+    if (auto* top = topLevel(); top)
+        top->showMaximized();
+    maximizedState_ = true;
+}
+
+void TerminalDisplayBase::setWindowNormal()
+{
+    updateMinimumSize();
+    if (auto* top = topLevel(); top)
+        top->showNormal();
+    maximizedState_ = false;
+}
+
+void TerminalDisplayBase::setBackgroundBlur(bool _enable)
+{
+    if (enableBackgroundBlur_)
+        enableBackgroundBlur_(_enable);
+}
+
+void TerminalDisplayBase::toggleFullScreen()
+{
+    auto* top = topLevel();
+    if (!top)
+        return;
+
+    if (top->isFullScreen())
+    {
+        top->showNormal();
+        if (maximizedState_)
+            top->showMaximized();
+    }
+    else
+    {
+        maximizedState_ = top->isMaximized();
+        top->showFullScreen();
+    }
+}
+
+void TerminalDisplayBase::setHyperlinkDecoration(terminal::renderer::Decorator _normal,
+                                                 terminal::renderer::Decorator _hover)
+{
+    waitForRenderer();
+    renderer_.setHyperlinkDecoration(_normal, _hover);
+}
+
+void TerminalDisplayBase::setBackgroundOpacity(terminal::Opacity _opacity)
+{
+    waitForRenderer();
+    renderer_.setBackgroundOpacity(_opacity);
+    session_.terminal().breakLoopAndRefreshRenderBuffer();
+}
+// }}}
+
+// {{{ terminal events
+void TerminalDisplayBase::renderBufferUpdated()
+{
+    scheduleRedraw();
+}
+
+void TerminalDisplayBase::memoryTrimmed()
+{
+    // Picked up by the next frame, which is rendered right away.
+    renderer_.requestMemoryTrim();
+    scheduleRedraw();
+}
+
+void TerminalDisplayBase::onSelectionCompleted()
+{
+    if (QClipboard* clipboard = QGuiApplication::clipboard(); clipboard != nullptr)
+    {
+        string const text = terminal().extractSelectionText();
+        clipboard->setText(QString::fromUtf8(text.c_str(), static_cast<int>(text.size())), QClipboard::Selection);
+    }
+}
+
+void TerminalDisplayBase::discardImage(terminal::Image const& _image)
+{
+    waitForRenderer();
+    renderer_.discardImage(_image);
+}
+// }}}
+
+// {{{ helpers
+QWidget* TerminalDisplayBase::topLevel() const
+{
+    auto* widget = hostWidget();
+    return widget ? widget->window() : nullptr;
+}
+// }}}
+
+} // end namespace
@@ -0,0 +1,218 @@
+/**
+ * This file is part of the "contour" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <contour/Config.h>
+#include <contour/TerminalDisplay.h>
+#include <contour/TerminalSession.h>
+#include <contour/helper.h>
+
+#include <terminal/Color.h>
+#include <terminal_renderer/FrameScheduler.h>
+#include <terminal_renderer/Renderer.h>
+
+#include <QtCore/QSize>
+#include <QtCore/QTimer>
+#include <QtGui/QOpenGLExtraFunctions>
+#include <QtGui/QSurfaceFormat>
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+class QInputMethodEvent;
+class QKeyEvent;
+class QMouseEvent;
+class QScreen;
+class QWheelEvent;
+class QWidget;
+
+namespace contour::opengl {
+
+/// Session, input and render plumbing shared by the OpenGL terminal displays,
+/// TerminalWidget and TerminalSurface.
+///
+/// Implements the parts of the TerminalDisplay API that do not depend on how the frames reach
+/// the screen, while the displays provide the hooks below for the parts that do.
+class TerminalDisplayBase:
+    public TerminalDisplay,
+    protected QOpenGLExtraFunctions
+{
+  public:
+    TerminalDisplayBase(config::TerminalProfile const& _profile,
+                        TerminalSession& _session,
+                        std::function<void()> _adaptSize,
+                        std::function<void(bool)> _enableBackgroundBlur,
+                        crispy::Point _screenDPI);
+
+    static QSurfaceFormat surfaceFormat();
+
+    // {{{ TerminalDisplay API
+    // Attributes
+    double refreshRate() const override;
+    bool isFullScreen() const override;
+    crispy::Size pixelSize() const override;
+    crispy::Size cellSize() const override;
+
+    // (user requested) actions
+    bool requestPermission(config::Permission _allowedByConfig, std::string_view _topicText) override;
+    terminal::FontDef getFontDef() override;
+    void bell() override;
+    void copyToClipboard(std::string_view _data) override;
+    void dumpState() override;
+    std::string renderStats() override;
+    std::string renderStatsJson() override;
+    void collectMemoryUsage(crispy::memory_usage& _usage) override;
+    void notify(std::string_view _title, std::string_view _body) override;
+    void resizeWindow(int _width, int _height, bool _unitInPixels) override;
+    void setFonts(terminal::renderer::FontDescriptions _fontDescriptions) override;
+    bool setFontSize(text::font_size _size) override;
+    bool setScreenSize(crispy::Size _newScreenSize) override;
+    void setTerminalProfile(config::TerminalProfile _profile) override;
+    void setWindowTitle(std::string_view _title) override;
+    void setWindowFullScreen() override;
+    void setWindowMaximized() override;
+    void setWindowNormal() override;
+    void setBackgroundBlur(bool _enable) override;
+    void toggleFullScreen() override;
+    void setHyperlinkDecoration(terminal::renderer::Decorator _normal,
+                                terminal::renderer::Decorator _hover) override;
+    void setBackgroundOpacity(terminal::Opacity _opacity) override;
+
+    // terminal events
+    void renderBufferUpdated() override;
+    void memoryTrimmed() override;
+    void onSelectionCompleted() override;
+    void discardImage(terminal::Image const& _image) override;
+    // }}}
+
+  protected:
+    // {{{ hooks of the displays
+    /// The widget standing for the display within the widget hierarchy, if embedded already.
+    virtual QWidget* hostWidget() const = 0;
+
+    /// The screen the display is shown on, if any.
+    virtual QScreen* hostScreen() const = 0;
+
+    /// Whether the display can be seen at all, e.g. not minimized or on another virtual desktop.
+    virtual bool exposed() const = 0;
+
+    /// Flags the screen as changed since the frame rendered last.
+    virtual void markScreenDirty() = 0;
+
+    /// Has a frame rendered, see requestFrame().
+    virtual void requestPaint() = 0;
+
+    /// Makes the display's OpenGL context current, for reading back from the render target.
+    virtual void makeRenderContextCurrent() = 0;
+
+    /// Applies minimumPageSizeHint() to the display.
+    virtual void updateMinimumSize() = 0;
+
+    /// Waits for the frame being rendered, if rendered off the GUI thread.
+    virtual void waitForRenderer() {}
+    // }}}
+
+    static void reportUnhandledException(std::string_view _where, std::exception const& _e);
+
+    terminal::Terminal& terminal() noexcept { return session_.terminal(); }
+    terminal::renderer::GridMetrics const& gridMetrics() const noexcept { return renderer_.gridMetrics(); }
+    crispy::Size screenSize() const { return size_ / gridMetrics().cellSize; }
+    bool framePacing() const noexcept { return session_.config().framePacing.enabled; }
+    double effectiveRefreshRate() const;
+
+    /// The top level widget hosting the display, if embedded already.
+    QWidget* topLevel() const;
+
+    /// Size of the terminal's configured page, in pixels.
+    QSize pageSizeHint() const;
+
+    /// Size of the smallest page worth showing, in pixels.
+    QSize minimumPageSizeHint() const;
+
+    /// Creates the render target, with the display's OpenGL context current.
+    void initializeRenderer(crispy::Size _pixels);
+
+    /// Marks the display ready for rendering, once the display's initialization is complete.
+    void finishInitialization();
+
+    /// Renders the frame, which may be limited to what changed since the previous frame
+    /// if the surface keeps its contents, see TerminalWidget.
+    void renderFrame(bool _redrawAll);
+
+    /// Accounts for the frame rendered last having been presented.
+    void framePresented();
+
+    /// Has the blinking cursor rendered again when due.
+    void scheduleCursorBlink();
+
+    void scheduleUpdate();
+    void requestFrame();
+    void updateVisibility();
+    void onScreenChanged();
+
+    /// Shows the current screen at the new size of @p _pixels until the screen is resized as well,
+    /// at most once per frame, see applyResize().
+    void scheduleResize(crispy::Size _pixels);
+    void applyResize();
+
+    /// Resizes the screen to fit @p _pixels right away.
+    void resizeTerminal(crispy::Size _pixels);
+
+    // {{{ input
+    void keyPressed(QKeyEvent* _event);
+    void wheelMoved(QWheelEvent* _event);
+    void mousePressed(QMouseEvent* _event);
+    void mouseMoved(QMouseEvent* _event);
+    void mouseReleased(QMouseEvent* _event);
+    void inputMethodCommitted(QInputMethodEvent* _event);
+    void flushMouseMove();
+    // }}}
+
+    config::TerminalProfile const& profile_;
+    TerminalSession& session_;
+    std::function<void()> adaptSize_;
+    std::function<void(bool)> enableBackgroundBlur_;
+    terminal::renderer::Renderer renderer_;
+    crispy::Size size_;                             // display size in pixels
+
+    std::unique_ptr<terminal::renderer::RenderTarget> renderTarget_;
+    QTimer updateTimer_;                            // update() timer used to animate the blinking cursor
+    QTimer frameTimer_;                             // update() timer used to render just in time, see framePacing()
+    terminal::renderer::FrameScheduler frameScheduler_;
+    QTimer resizeTimer_;                            // applies the display's size to the screen, see scheduleResize()
+    QTimer ptyResizeTimer_;                         // informs the application about the size once it settled
+    QTimer mouseMoveTimer_;                         // sends the pending mouse move, see mouseMoved()
+    QTimer statsTimer_;                             // logs the caches' effectiveness, see statsSummary()
+    std::optional<terminal::MouseMoveEvent> pendingMouseMove_;
+    std::chrono::steady_clock::time_point lastMouseMove_{};
+    std::atomic<std::chrono::steady_clock::time_point> lastInput_{}; // most recent user input, read by renderFrame()
+    std::chrono::steady_clock::time_point lastFrameSwap_{};
+    std::chrono::steady_clock::time_point paintedOutputTime_{}; // of the frame to be presented next
+    terminal::renderer::DegradationLevel degradationLevel_ = terminal::renderer::DegradationLevel::None;
+    bool maximizedState_ = false;
+    std::atomic<bool> initialized_ = false;
+    terminal::RGBAColor backgroundColor_{};
+
+    PermissionCache rememberedPermissions_;
+
+  private:
+    void statsSummary();
+};
+
+} // end namespace
@@ -0,0 +1,298 @@
+/**
+ * This file is part of the "contour" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <contour/opengl/TerminalSurface.h>
+
+#include <contour/helper.h>
+
+#include <terminal/pty/Pty.h>
+
+#include <crispy/debuglog.h>
+#include <crispy/profiler.h>
+#include <crispy/trace.h>
+
+#include <QtGui/QInputMethodEvent>
+#include <QtGui/QOpenGLContext>
+#include <QtWidgets/QVBoxLayout>
+
+#include <utility>
+
+using crispy::Size;
+
+using std::exception;
+using std::function;
+
+namespace contour::opengl {
+
+TerminalSurface::TerminalSurface(config::TerminalProfile const& _profile,
+                                 TerminalSession& _session,
+                                 function<void()> _adaptSize,
+                                 function<void(bool)> _enableBackgroundBlur):
+    QOpenGLWindow(QOpenGLWindow::NoPartialUpdate),
+    TerminalDisplayBase(_profile,
+                        _session,
+                        std::move(_adaptSize),
+                        std::move(_enableBackgroundBlur),
+                        crispy::Point{ logicalDpiX(), logicalDpiY() })
+{
+    debuglog(WidgetTag).write("surface ctor: terminalSize={}, fontSize={}", profile_.terminalSize, profile_.fonts.size);
+
+    setFormat(surfaceFormat());
+    updateMinimumSize();
+
+    connect(this, &QOpenGLWindow::frameSwapped, this, &TerminalSurface::onFrameSwapped);
+    connect(this, &QWindow::screenChanged, this, [this]() { onScreenChanged(); });
+
+    // Glyph cache misses are rasterized off the GUI thread, repainting once they're ready.
+    renderer_.enableAsyncRasterization([this]() { post([this]() { scheduleRedraw(); }); });
+}
+
+TerminalSurface::~TerminalSurface()
+{
+    debuglog(WidgetTag).write("TerminalSurface.dtor!");
+    makeCurrent(); // The render target's resources are released with the context current.
+    renderTarget_.reset();
+    doneCurrent();
+}
+
+crispy::Point TerminalSurface::screenDPI() const
+{
+    return crispy::Point{ logicalDpiX(), logicalDpiY() };
+}
+
+// {{{ OpenGL render API
+void TerminalSurface::initializeGL()
+{
+    auto const _trace = crispy::trace_scope("OpenGL initialization");
+    initializeRenderer(Size{width(), height()});
+
+    debuglog(WidgetTag).write("[FYI] Rendering straight into the window surface ({}).",
+                              QOpenGLContext::currentContext()->isOpenGLES() ? "OpenGL/ES" : "OpenGL");
+
+    finishInitialization();
+}
+
+void TerminalSurface::resizeGL(int _width, int _height)
+{
+    scheduleResize(Size{_width, _height});
+}
+
+void TerminalSurface::paintGL()
+{
+    auto const _trace = crispy::trace_scope("frame rendering");
+    CRISPY_PROFILE_ZONE("TerminalSurface::paintGL");
+
+    // The back buffer does not keep the previous frame, so everything is drawn again.
+    dirty_ = false;
+    renderFrame(true);
+}
+
+void TerminalSurface::onFrameSwapped()
+{
+    CRISPY_PROFILE_FRAME();
+
+    framePresented();
+
+    if (dirty_)
+        scheduleUpdate();
+    else
+        scheduleCursorBlink();
+}
+// }}}
+
+// {{{ Input handling
+void TerminalSurface::keyPressEvent(QKeyEvent* _keyEvent)
+{
+    CRISPY_PROFILE_ZONE("TerminalSurface::keyPressEvent");
+    keyPressed(_keyEvent);
+}
+
+void TerminalSurface::wheelEvent(QWheelEvent* _event)
+{
+    CRISPY_PROFILE_ZONE("TerminalSurface::wheelEvent");
+    wheelMoved(_event);
+}
+
+void TerminalSurface::mousePressEvent(QMouseEvent* _event)
+{
+    CRISPY_PROFILE_ZONE("TerminalSurface::mousePressEvent");
+    mousePressed(_event);
+}
+
+void TerminalSurface::mouseMoveEvent(QMouseEvent* _event)
+{
+    CRISPY_PROFILE_ZONE("TerminalSurface::mouseMoveEvent");
+    mouseMoved(_event);
+}
+
+void TerminalSurface::mouseReleaseEvent(QMouseEvent* _event)
+{
+    CRISPY_PROFILE_ZONE("TerminalSurface::mouseReleaseEvent");
+    mouseReleased(_event);
+}
+
+void TerminalSurface::focusInEvent(QFocusEvent* _event)
+{
+    QOpenGLWindow::focusInEvent(_event);
+    session_.sendFocusInEvent();
+}
+
+void TerminalSurface::focusOutEvent(QFocusEvent* _event)
+{
+    QOpenGLWindow::focusOutEvent(_event);
+    session_.sendFocusOutEvent();
+}
+
+void TerminalSurface::exposeEvent(QExposeEvent* _event)
+{
+    QOpenGLWindow::exposeEvent(_event);
+    updateVisibility();
+}
+
+bool TerminalSurface::event(QEvent* _event)
+{
+    try
+    {
+        switch (_event->type())
+        {
+            case QEvent::InputMethodQuery:
+            {
+                // Windows, unlike widgets, have input methods enabled only when asked.
+                auto* query = static_cast<QInputMethodQueryEvent*>(_event);
+                if (query->queries() & Qt::ImEnabled)
+                    query->setValue(Qt::ImEnabled, true);
+                if (query->queries() & Qt::ImCursorPosition)
+                    query->setValue(Qt::ImCursorPosition, 0);
+                if (query->queries() & Qt::ImCurrentSelection)
+                    query->setValue(Qt::ImCurrentSelection, QString());
+                query->accept();
+                return true;
+            }
+            case QEvent::InputMethod:
+                inputMethodCommitted(static_cast<QInputMethodEvent*>(_event));
+                return true;
+            case QEvent::Close:
+                session_.pty().close();
+                emit terminated();
+                break;
+            default:
+                break;
+        }
+
+        return QOpenGLWindow::event(_event);
+    }
+    catch (exception const& e)
+    {
+        reportUnhandledException(__PRETTY_FUNCTION__, e);
+        return false;
+    }
+}
+// }}}
+
+// {{{ TerminalDisplay API
+void TerminalSurface::post(function<void()> _fn)
+{
+    postToObject(this, std::move(_fn));
+}
+
+void TerminalSurface::setMouseCursorShape(MouseCursorShape _shape)
+{
+    if (auto const newShape = toQtMouseShape(_shape); newShape != cursor().shape())
+        setCursor(newShape);
+}
+
+void TerminalSurface::scheduleRedraw()
+{
+    if (!initialized_.load())
+        return;
+
+    // May be invoked from the terminal's thread, while frames are requested by the GUI thread only.
+    if (!dirty_.exchange(true))
+        post([this]() {
+            scheduleUpdate();
+            emit terminalBufferUpdated();
+        });
+}
+
+void TerminalSurface::onClosed()
+{
+    post([this]() { close(); });
+}
+
+void TerminalSurface::bufferChanged(terminal::ScreenType _type)
+{
+    switch (_type)
+    {
+        case terminal::ScreenType::Main:
+            setCursor(Qt::IBeamCursor);
+            break;
+        case terminal::ScreenType::Alternate:
+            setCursor(Qt::ArrowCursor);
+            break;
+    }
+    emit terminalBufferChanged(_type);
+}
+// }}}
+
+// {{{ TerminalDisplayBase hooks
+bool TerminalSurface::exposed() const
+{
+    if (!isExposed())
+        return false;
+
+    auto const* top = topLevel();
+    return !top || !top->windowHandle()
+        || (top->windowHandle()->visibility() != QWindow::Hidden
+            && top->windowHandle()->visibility() != QWindow::Minimized);
+}
+
+void TerminalSurface::updateMinimumSize()
+{
+    setMinimumSize(minimumSizeHint());
+    if (container_)
+        container_->setMinimumSize(minimumSizeHint());
+}
+// }}}
+
+// {{{ TerminalSurfaceContainer
+TerminalSurfaceContainer::TerminalSurfaceContainer(TerminalSurface& _surface, QWidget* _parent):
+    QWidget(_parent),
+    surface_{ _surface }
+{
+    auto* layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setSpacing(0);
+
+    // The window container only ever holds a weak reference to the surface,
+    // which is owned by its terminal session.
+    auto* container = QWidget::createWindowContainer(&_surface, this);
+    container->setFocusPolicy(Qt::StrongFocus);
+    layout->addWidget(container);
+    setFocusProxy(container);
+
+    surface_.container_ = this;
+    setMinimumSize(surface_.minimumSizeHint());
+}
+
+QSize TerminalSurfaceContainer::sizeHint() const
+{
+    return surface_.sizeHint();
+}
+
+QSize TerminalSurfaceContainer::minimumSizeHint() const
+{
+    return surface_.minimumSizeHint();
+}
+// }}}
+
+} // end namespace
@@ -0,0 +1,125 @@
+/**
+ * This file is part of the "contour" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <contour/Config.h>
+#include <contour/TerminalSession.h>
+#include <contour/opengl/TerminalDisplayBase.h>
+
+#include <QtGui/QOpenGLWindow>
+#include <QtWidgets/QWidget>
+
+#include <atomic>
+#include <functional>
+
+namespace contour::opengl {
+
+/// Terminal display rendering straight into the window surface.
+///
+/// Unlike TerminalWidget, which renders into an offscreen framebuffer that Qt then composes
+/// into the window, this one is a native window of its own, embedded into the widget hierarchy
+/// by a TerminalSurfaceContainer. That saves a full-window texture copy per frame, and the frame
+/// of latency the composition adds.
+///
+/// The window surface's contents are undefined after swapping buffers, so each frame is
+/// redrawn as a whole, from the renderer's cached rows and glyphs.
+class TerminalSurface :
+    public QOpenGLWindow,
+    public TerminalDisplayBase
+{
+    Q_OBJECT
+
+  public:
+    TerminalSurface(config::TerminalProfile const& _profile,
+                    TerminalSession& _session,
+                    std::function<void()> _adaptSize,
+                    std::function<void(bool)> _enableBackgroundBlur);
+
+    ~TerminalSurface() override;
+
+    /// Size of the terminal's configured page, in pixels.
+    QSize sizeHint() const { return pageSizeHint(); }
+
+    /// Size of the smallest page worth showing, in pixels.
+    QSize minimumSizeHint() const { return minimumPageSizeHint(); }
+
+    // {{{ OpenGL rendering handling
+    void initializeGL() override;
+    void resizeGL(int _width, int _height) override;
+    void paintGL() override;
+    // }}}
+
+    // {{{ Input handling
+    void keyPressEvent(QKeyEvent* _keyEvent) override;
+    void wheelEvent(QWheelEvent* _wheelEvent) override;
+    void mousePressEvent(QMouseEvent* _mousePressEvent) override;
+    void mouseReleaseEvent(QMouseEvent* _mouseReleaseEvent) override;
+    void mouseMoveEvent(QMouseEvent* _mouseMoveEvent) override;
+    void focusInEvent(QFocusEvent* _event) override;
+    void focusOutEvent(QFocusEvent* _event) override;
+    void exposeEvent(QExposeEvent* _event) override;
+    bool event(QEvent* _event) override;
+    // }}}
+
+    // {{{ TerminalDisplay API
+    void post(std::function<void()> _fn) override;
+    crispy::Point screenDPI() const override;
+    void setMouseCursorShape(MouseCursorShape _shape) override;
+
+    // terminal events
+    void scheduleRedraw() override;
+    void onClosed() override;
+    void bufferChanged(terminal::ScreenType) override;
+    // }}}
+
+  public Q_SLOTS:
+    void onFrameSwapped();
+
+  signals:
+    void terminalBufferChanged(terminal::ScreenType);
+    void terminalBufferUpdated();
+    void terminated();
+
+  protected:
+    // {{{ TerminalDisplayBase hooks
+    QWidget* hostWidget() const override { return container_; }
+    QScreen* hostScreen() const override { return screen(); }
+    bool exposed() const override;
+    void markScreenDirty() override { dirty_ = true; }
+    void requestPaint() override { update(); }
+    void makeRenderContextCurrent() override { makeCurrent(); }
+    void updateMinimumSize() override;
+    // }}}
+
+  private:
+    friend class TerminalSurfaceContainer;
+
+    QWidget* container_ = nullptr;                  // see TerminalSurfaceContainer
+    std::atomic<bool> dirty_ = false;               // whether the screen changed since the last frame
+};
+
+/// Hosts a TerminalSurface within a widget hierarchy, e.g. the main window's.
+class TerminalSurfaceContainer: public QWidget
+{
+  public:
+    explicit TerminalSurfaceContainer(TerminalSurface& _surface, QWidget* _parent = nullptr);
+
+    QSize sizeHint() const override;
+    QSize minimumSizeHint() const override;
+
+  private:
+    TerminalSurface& surface_;
+};
+
+} // end namespace
@@ -13,6 +13,7 @@
  */
 #include <contour/opengl/TerminalWidget.h>
 #include <contour/opengl/OpenGLRenderer.h>
+#include <contour/opengl/RenderThread.h>
 
 #include <contour/Actions.h>
 #include <contour/helper.h>
@@ -22,7 +23,9 @@
 #include <terminal/pty/Pty.h>
 
 #include <crispy/debuglog.h>
+#include <crispy/profiler.h>
 #include <crispy/stdfs.h>
+#include <crispy/trace.h>
 
 #include <QtCore/QDebug>
 #include <QtCore/QFileInfo>
@@ -50,6 +53,7 @@
 #include <stdexcept>
 #include <string_view>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include <range/v3/all.hpp>
@@ -212,17 +216,6 @@ namespace // {{{
     }
 #endif
 
-    std::string unhandledExceptionMessage(std::string_view const& where, exception const& e)
-    {
-        return fmt::format("{}: Unhandled exception caught ({}). {}", where, typeid(e).name(), e.what());
-    }
-
-    void reportUnhandledException(std::string_view const& where, exception const& e)
-    {
-        debuglog(WidgetTag).write("{}", unhandledExceptionMessage(where, e));
-        cerr << unhandledExceptionMessage(where, e) << endl;
-    }
-
     QScreen* screenOf(QWidget const* _widget)
     {
 #if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
@@ -242,13 +235,6 @@ namespace // {{{
     }
 } // }}}
 
-terminal::renderer::FontDescriptions TerminalWidget::sanitizeDPI(terminal::renderer::FontDescriptions _fonts)
-{
-    if (_fonts.dpi.x <= 0 || _fonts.dpi.y <= 0)
-        _fonts.dpi = screenDPI();
-    return _fonts;
-}
-
 TerminalWidget::TerminalWidget(
     config::TerminalProfile const& _profile,
     TerminalSession& _session,
@@ -256,23 +242,11 @@ TerminalWidget::TerminalWidget(
     function<void(bool)> _enableBackgroundBlur
 ):
     QOpenGLWidget(),
-    profile_{ _profile },
-    session_{ _session },
-    adaptSize_{ std::move(_adaptSize) },
-    enableBackgroundBlur_{ std::move(_enableBackgroundBlur) },
-    renderer_{
-        terminal().screenSize(),
-        sanitizeDPI(profile_.fonts),
-        terminal().screen().colorPalette(),
-        profile_.backgroundOpacity,
-        profile_.hyperlinkDecoration.normal,
-        profile_.hyperlinkDecoration.hover
-        //TODO: , WindowMargin(windowMargin_.left, windowMargin_.bottom);
-    },
-    size_{
-        static_cast<int>(terminal().screenSize().width * gridMetrics().cellSize.width),
-        static_cast<int>(terminal().screenSize().height * gridMetrics().cellSize.height)
-    }
+    TerminalDisplayBase(_profile,
+                        _session,
+                        std::move(_adaptSize),
+                        std::move(_enableBackgroundBlur),
+                        crispy::Point{ logicalDpiX(), logicalDpiY() })
 {
     debuglog(WidgetTag).write("ctor: terminalSize={}, fontSize={}, contentScale={}, geometry={}:{}..{}:{}",
                               profile_.terminalSize,
@@ -286,20 +260,26 @@ TerminalWidget::TerminalWidget(
     setMouseTracking(true);
     setFormat(surfaceFormat());
 
+    // Keep the framebuffer's contents across frames, so that only what changed needs to be redrawn.
+    setUpdateBehavior(QOpenGLWidget::PartialUpdate);
+
     setAttribute(Qt::WA_InputMethodEnabled, true);
     setAttribute(Qt::WA_OpaquePaintEvent);
 
-    setMinimumSize(gridMetrics().cellSize.width * 3,
-                   gridMetrics().cellSize.height * 2);
+    updateMinimumSize();
 
     // setAttribute(Qt::WA_TranslucentBackground);
     // setAttribute(Qt::WA_NoSystemBackground, false);
 
-    updateTimer_.setSingleShot(true);
-    connect(&updateTimer_, &QTimer::timeout, this, QOverload<>::of(&TerminalWidget::blinkingCursorUpdate));
-
     connect(this, SIGNAL(frameSwapped()), this, SLOT(onFrameSwapped()));
 
+    // The framebuffer must not be composed or resized while the render thread draws into it.
+    connect(this, &QOpenGLWidget::aboutToCompose, this, [this]() { waitForRenderer(); });
+    connect(this, &QOpenGLWidget::aboutToResize, this, [this]() { waitForRenderer(); });
+
+    // Glyph cache misses are rasterized off the render thread, repainting once they're ready.
+    renderer_.enableAsyncRasterization([this]() { post([this]() { scheduleRedraw(); }); });
+
     // TODO
     // configureTerminal(view(), config(), actionHandler_->profileName());
     QOpenGLWidget::updateGeometry();
@@ -308,115 +288,38 @@ TerminalWidget::TerminalWidget(
 TerminalWidget::~TerminalWidget()
 {
     debuglog(WidgetTag).write("TerminalWidget.dtor!");
+    renderThread_.reset();
     makeCurrent(); // XXX must be called.
 }
 
-// {{{ attributes
-double TerminalWidget::refreshRate() const
-{
-    auto const screen = screenOf(this);
-    if (!screen)
-        return profile_.refreshRate != 0.0 ? profile_.refreshRate : 30.0;
-
-    auto const systemRefreshRate = static_cast<double>(screen->refreshRate());
-    if (1.0 < profile_.refreshRate && profile_.refreshRate < systemRefreshRate)
-        return profile_.refreshRate;
-    else
-        return systemRefreshRate;
-}
-
 crispy::Point TerminalWidget::screenDPI() const
 {
     return crispy::Point{ logicalDpiX(), logicalDpiY() };
 }
 
-bool TerminalWidget::isFullScreen() const
-{
-    return window()->isFullScreen();
-}
-
-crispy::Size TerminalWidget::pixelSize() const
-{
-    return size_;
-}
-
-crispy::Size TerminalWidget::cellSize() const
-{
-    return gridMetrics().cellSize;
-}
-// }}}
-
 // {{{ OpenGL render API
-QSurfaceFormat TerminalWidget::surfaceFormat()
-{
-    QSurfaceFormat format;
-
-    constexpr bool forceOpenGLES = (
-#if defined(__linux__)
-        true
-#else
-        false
-#endif
-    );
-
-    if (forceOpenGLES || QOpenGLContext::openGLModuleType() == QOpenGLContext::LibGLES)
-    {
-        format.setVersion(3, 2);
-        format.setRenderableType(QSurfaceFormat::OpenGLES);
-    }
-    else
-    {
-        format.setVersion(3, 3);
-        format.setRenderableType(QSurfaceFormat::OpenGL);
-    }
-    format.setProfile(QSurfaceFormat::CoreProfile);
-    format.setAlphaBufferSize(8);
-    format.setSwapBehavior(QSurfaceFormat::DoubleBuffer);
-    format.setSwapInterval(1);
-
-#if !defined(NDEBUG)
-    format.setOption(QSurfaceFormat::DebugContext);
-#endif
-
-    return format;
-}
-
 QSize TerminalWidget::minimumSizeHint() const
 {
-    auto constexpr MinimumScreenSize = Size{3, 2};
-
-    auto const cellSize = gridMetrics().cellSize;
-    auto const viewSize = MinimumScreenSize * cellSize;
-
-    return QSize(viewSize.width, viewSize.height);
+    return minimumPageSizeHint();
 }
 
 QSize TerminalWidget::sizeHint() const
 {
-    auto const cellSize = renderer_.gridMetrics().cellSize;
-    auto const viewSize = cellSize * profile_.terminalSize;
+    auto const viewSize = pageSizeHint();
 
-
-    debuglog(WidgetTag).write("sizeHint: {}, cellSize: {}, terminalSize: {}, dpi: {}",
-                              viewSize, cellSize, profile_.terminalSize,
+    debuglog(WidgetTag).write("sizeHint: {}x{}, cellSize: {}, terminalSize: {}, dpi: {}",
+                              viewSize.width(), viewSize.height(),
+                              gridMetrics().cellSize, profile_.terminalSize,
                               renderer_.fontDescriptions().dpi
                               );
 
-    return QSize(viewSize.width, viewSize.height);
+    return viewSize;
 }
 
 void TerminalWidget::initializeGL()
 {
-    initializeOpenGLFunctions();
-
-    renderTarget_ = make_unique<terminal::renderer::opengl::OpenGLRenderer>(
-        *config::Config::loadShaderConfig(config::ShaderClass::Text),
-        *config::Config::loadShaderConfig(config::ShaderClass::Background),
-        Size{width(), height()},
-        terminal::renderer::PageMargin{} // TODO margin
-    );
-
-    renderer_.setRenderTarget(*renderTarget_);
+    auto const _trace = crispy::trace_scope("OpenGL initialization");
+    initializeRenderer(Size{width(), height()});
 
     // {{{ some info
     static bool infoPrinted = false;
@@ -469,82 +372,62 @@ void TerminalWidget::initializeGL()
     CHECKED_GL( glDebugMessageCallback(&glMessageCallback, this) );
 #endif
 
-    initialized_ = true;
-    session_.displayInitialized();
+    if (session_.config().experimentalFeatures.count("render_thread"))
+        renderThread_ = make_unique<RenderThread>(*this, [this]() { paintGL(); });
+
+    // Catches up on frames requested while the window was not exposed, see requestFrame(),
+    // and suspends rendering while it is hidden, see updateVisibility().
+    if (auto* handle = window()->windowHandle(); handle)
+    {
+        handle->installEventFilter(this);
+        connect(handle, &QWindow::visibilityChanged, this, [this]() { updateVisibility(); });
+        connect(handle, &QWindow::screenChanged, this, [this]() { onScreenChanged(); });
+    }
+
+    finishInitialization();
 }
 
 void TerminalWidget::resizeGL(int _width, int _height)
 {
-    debuglog(WidgetTag).write("resizing to {}", Size{_width, _height});
     QOpenGLWidget::resizeGL(_width, _height);
-
-    if (_width == 0 || _height == 0)
-        return;
-
-    size_ = Size{_width, _height};
-    auto const newScreenSize = screenSize();
-
-    renderer_.setRenderSize(size_);
-    renderer_.setScreenSize(newScreenSize);
-    renderer_.setMargin(computeMargin(gridMetrics().cellSize, newScreenSize, size_));
-    //renderer_.clearCache();
-
-    if (newScreenSize != terminal().screenSize())
-    {
-        terminal().resizeScreen(newScreenSize, newScreenSize * gridMetrics().cellSize);
-        terminal().clearSelection();
-    }
+    scheduleResize(Size{_width, _height});
 }
 
 void TerminalWidget::paintGL()
 {
-    try
-    {
-        [[maybe_unused]] auto const lastState = state_.exchange(State::CleanPainting);
+    auto const _trace = crispy::trace_scope("frame rendering");
+    CRISPY_PROFILE_ZONE("TerminalWidget::paintGL");
+
+    [[maybe_unused]] auto const lastState = state_.exchange(State::CleanPainting);
 
 #if 0
-        auto const updateCount = stats_.updatesSinceRendering.exchange(0);
-        auto const renderCount = stats_.consecutiveRenderCount.exchange(0);
-        debuglog(WidgetTag).write(
-            "paintGL#{}: {} updates since last paint (state: {}).",
-            renderCount,
-            updateCount,
-            lastState
-        );
+    auto const updateCount = stats_.updatesSinceRendering.exchange(0);
+    auto const renderCount = stats_.consecutiveRenderCount.exchange(0);
+    debuglog(WidgetTag).write(
+        "paintGL#{}: {} updates since last paint (state: {}).",
+        renderCount,
+        updateCount,
+        lastState
+    );
 #endif
 
-        bool const reverseVideo =
-            terminal().screen().isModeEnabled(terminal::DECMode::ReverseVideo);
-
-        auto const bg =
-            reverseVideo
-                ? terminal::RGBAColor(profile_.colors.defaultForeground, uint8_t(profile_.backgroundOpacity))
-                : terminal::RGBAColor(profile_.colors.defaultBackground, uint8_t(profile_.backgroundOpacity));
-
-        if (bg != renderStateCache_.backgroundColor)
-        {
-            auto const clearColor = array<float, 4>{
-                float(bg.red()) / 255.0f,
-                float(bg.green()) / 255.0f,
-                float(bg.blue()) / 255.0f,
-                float(bg.alpha()) / 255.0f
-            };
-            glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
-            renderStateCache_.backgroundColor = bg;
-        }
-
-        glClear(GL_COLOR_BUFFER_BIT);
+    // The framebuffer keeps the previous frame, so only what changed is redrawn.
+    renderFrame(false);
+}
 
-        renderer_.render(terminal(), steady_clock::now(), renderingPressure_);
-    }
-    catch (exception const& e)
-    {
-        reportUnhandledException(__PRETTY_FUNCTION__, e);
-    }
+void TerminalWidget::paintEvent(QPaintEvent* _event)
+{
+    // With a render thread, the framebuffer has been rendered already and only needs to be composed.
+    if (!renderThread_)
+        QOpenGLWidget::paintEvent(_event);
 }
 
 void TerminalWidget::onFrameSwapped()
 {
+    CRISPY_PROFILE_FRAME();
+
+    framePresented();
+
     for (;;)
     {
         auto state = state_.load();
@@ -553,21 +436,18 @@ void TerminalWidget::onFrameSwapped()
             case State::DirtyIdle:
                 //assert(!"The impossible happened, painting but painting. Shakesbeer.");
                 //qDebug() << "The impossible happened, onFrameSwapped() called in wrong state DirtyIdle.";
-                update();
+                scheduleUpdate();
                 return;
             case State::DirtyPainting:
                 stats_.consecutiveRenderCount++;
-                update();
+                scheduleUpdate();
                 return;
             case State::CleanPainting:
                 if (!state_.compare_exchange_strong(state, State::CleanIdle))
                     break;
                 [[fallthrough]];
             case State::CleanIdle:
-                renderingPressure_ = false;
-                if (profile_.cursorDisplay == terminal::CursorDisplay::Blink
-                        && terminal().cursorVisibility())
-                    updateTimer_.start(terminal().nextRender(steady_clock::now()));
+                scheduleCursorBlink();
                 return;
         }
     }
@@ -577,27 +457,32 @@ void TerminalWidget::onFrameSwapped()
 // {{{ Input handling
 void TerminalWidget::keyPressEvent(QKeyEvent* _keyEvent)
 {
-   sendKeyEvent(_keyEvent, session_);
+    CRISPY_PROFILE_ZONE("TerminalWidget::keyPressEvent");
+    keyPressed(_keyEvent);
 }
 
 void TerminalWidget::wheelEvent(QWheelEvent* _event)
 {
-    sendWheelEvent(_event, session_);
+    CRISPY_PROFILE_ZONE("TerminalWidget::wheelEvent");
+    wheelMoved(_event);
 }
 
 void TerminalWidget::mousePressEvent(QMouseEvent* _event)
 {
-    sendMousePressEvent(_event, session_);
+    CRISPY_PROFILE_ZONE("TerminalWidget::mousePressEvent");
+    mousePressed(_event);
 }
 
 void TerminalWidget::mouseMoveEvent(QMouseEvent* _event)
 {
-    sendMouseMoveEvent(_event, session_);
+    CRISPY_PROFILE_ZONE("TerminalWidget::mouseMoveEvent");
+    mouseMoved(_event);
 }
 
 void TerminalWidget::mouseReleaseEvent(QMouseEvent* _event)
 {
-    sendMouseReleaseEvent(_event, session_);
+    CRISPY_PROFILE_ZONE("TerminalWidget::mouseReleaseEvent");
+    mouseReleased(_event);
 }
 
 void TerminalWidget::focusInEvent(QFocusEvent* _event)
@@ -614,20 +499,13 @@ void TerminalWidget::focusOutEvent(QFocusEvent* _event)
 
 void TerminalWidget::inputMethodEvent(QInputMethodEvent* _event)
 {
-    if (!_event->commitString().isEmpty())
-    {
-        QKeyEvent keyEvent(QEvent::KeyPress, 0, Qt::NoModifier, _event->commitString());
-        keyPressEvent(&keyEvent);
-        // TODO: emit keyPressedSignal(&keyEvent);
-    }
-
     // if (_readOnly && isCursorOnDisplay())
     // {
     //     // _inputMethodData.preeditString = event->preeditString();
     //     // update(preeditRect() | _inputMethodData.previousPreeditRect);
     // }
 
-    _event->accept();
+    inputMethodCommitted(_event);
 }
 
 QVariant TerminalWidget::inputMethodQuery(Qt::InputMethodQuery _query) const
@@ -683,198 +561,20 @@ bool TerminalWidget::event(QEvent* _event)
         return false;
     }
 }
-// }}}
-
-// {{{ (user requested) actions
-void TerminalWidget::post(std::function<void()> _fn)
-{
-    postToObject(this, std::move(_fn));
-}
 
-bool TerminalWidget::requestPermission(config::Permission _allowedByConfig, string_view _topicText)
+bool TerminalWidget::eventFilter(QObject* _watched, QEvent* _event)
 {
-    return contour::requestPermission(rememberedPermissions_,
-                                      this,
-                                      _allowedByConfig,
-                                      _topicText);
-}
+    if (_event->type() == QEvent::Expose)
+        updateVisibility();
 
-terminal::FontDef TerminalWidget::getFontDef()
-{
-    return getFontDefinition(renderer_);
-}
-
-void TerminalWidget::bell()
-{
-    QApplication::beep();
-}
-
-void TerminalWidget::copyToClipboard(std::string_view _data)
-{
-    if (QClipboard* clipboard = QGuiApplication::clipboard(); clipboard != nullptr)
-        clipboard->setText(QString::fromUtf8(_data.data(), static_cast<int>(_data.size())));
-}
-
-void TerminalWidget::dumpState()
-{
-    makeCurrent();
-    auto const tmpDir = FileSystem::path(QStandardPaths::writableLocation(QStandardPaths::TempLocation).toStdString());
-    auto const targetDir = tmpDir / FileSystem::path("contour-debug");
-    FileSystem::create_directories(targetDir);
-    debuglog(WidgetTag).write("Dumping state into directory: {}", targetDir.generic_string());
-    // TODO: The above should be done from the outside and the targetDir being passed into this call.
-    // TODO: maybe zip this dir in the end.
-
-    // TODO: use this file store for everything that needs to be dumped.
-    terminal().screen().dumpState("Dump screen state.");
-    renderer_.dumpState(std::cout);
-
-    enum class ImageBufferFormat { RGBA, RGB, Alpha };
-
-    auto screenshotSaver = [](FileSystem::path const& _filename, ImageBufferFormat _format) {
-        auto const [qImageFormat, elementCount] = [&]() -> tuple<QImage::Format, int> {
-            switch (_format) {
-                case ImageBufferFormat::RGBA: return tuple{QImage::Format_RGBA8888, 4};
-                case ImageBufferFormat::RGB: return tuple{QImage::Format_RGB888, 3};
-                case ImageBufferFormat::Alpha: return tuple{QImage::Format_Grayscale8, 1};
-            }
-            return tuple{QImage::Format_Grayscale8, 1};
-        }();
-
-        // That's a little workaround for MacOS/X's C++ Clang compiler.
-        auto const theImageFormat = qImageFormat;
-        auto const theElementCount = elementCount;
-
-        return [_filename, theImageFormat, theElementCount](vector<uint8_t> const& _buffer, Size _size) {
-            auto image = make_unique<QImage>(_size.width, _size.height, theImageFormat);
-            // Vertically flip the image, because the coordinate system between OpenGL and desktop screens is inverse.
-            crispy::for_each(
-                // TODO: std::execution::seq,
-                crispy::times(_size.height),
-                [&_buffer, &image, theElementCount, _size](int i) {
-                    uint8_t const* sourceLine = &_buffer.data()[i * _size.width * theElementCount];
-                    copy(sourceLine, sourceLine + _size.width * theElementCount, image->scanLine(_size.height - i - 1));
-                }
-            );
-            image->save(QString::fromStdString(_filename.generic_string()));
-        };
-    };
-
-    auto const atlasScreenshotSaver = [&screenshotSaver, &targetDir](std::string const& _allocatorName,
-                                                                     unsigned _instanceId,
-                                                                     vector<uint8_t> const& _buffer,
-                                                                     Size _size) {
-        return [&screenshotSaver, &targetDir, &_buffer, _size, _allocatorName, _instanceId](ImageBufferFormat _format) {
-            auto const formatText = [&]() {
-                switch (_format) {
-                    case ImageBufferFormat::RGBA: return "rgba"sv;
-                    case ImageBufferFormat::RGB: return "rgb"sv;
-                    case ImageBufferFormat::Alpha: return "alpha"sv;
-                }
-                return "unknown"sv;
-            }();
-            auto const fileName = targetDir / fmt::format("atlas-{}-{}-{}.png", _allocatorName, formatText, _instanceId);
-            return screenshotSaver(fileName, _format)(_buffer, _size);
-        };
-    };
-
-    terminal::renderer::RenderTarget& renderTarget = renderer_.renderTarget();
-
-    for (auto const* allocator: renderTarget.allAtlasAllocators())
-    {
-        for (auto const atlasID: allocator->activeAtlasTextures())
-        {
-            auto infoOpt = renderTarget.readAtlas(*allocator, atlasID);
-            if (!infoOpt.has_value())
-                continue;
-
-            terminal::renderer::AtlasTextureInfo& info = infoOpt.value();
-            auto const saveScreenshot = atlasScreenshotSaver(allocator->name(), atlasID.value, info.buffer, info.size);
-            switch (info.format)
-            {
-                case terminal::renderer::atlas::Format::RGBA:
-                    saveScreenshot(ImageBufferFormat::RGBA);
-                    break;
-                case terminal::renderer::atlas::Format::RGB:
-                    saveScreenshot(ImageBufferFormat::RGB);
-                    break;
-                case terminal::renderer::atlas::Format::Red:
-                    saveScreenshot(ImageBufferFormat::Alpha);
-                    break;
-            }
-        }
-    }
-
-    renderTarget.scheduleScreenshot(screenshotSaver(targetDir / "screenshot.png", ImageBufferFormat::RGBA));
-}
-
-void TerminalWidget::notify(std::string_view /*_title*/, std::string_view /*_body*/)
-{
-    // TODO: showNotification callback to Controller?
-}
-
-void TerminalWidget::resizeWindow(int _width, int _height, bool _inPixels)
-{
-    if (isFullScreen())
-    {
-        debuglog(WidgetTag).write("Application request to resize window in full screen mode denied.");
-        return;
-    }
-
-    auto requestedScreenSize = terminal().screenSize();
-
-    if (_inPixels)
-    {
-        auto const pixelSize = crispy::Size{
-            _width ? _width : width(),
-            _height ? _height : height()
-        };
-        requestedScreenSize = pixelSize / gridMetrics().cellSize;
-    }
-    else
-    {
-        if (_width)
-            requestedScreenSize.width = _width;
-
-        if (_height)
-            requestedScreenSize.height = _height;
-    }
-
-    //setSizePolicy(QSizePolicy::Policy::Fixed, QSizePolicy::Policy::Fixed);
-    const_cast<config::TerminalProfile&>(profile_).terminalSize = requestedScreenSize;
-    renderer_.setScreenSize(requestedScreenSize);
-    terminal().resizeScreen(requestedScreenSize, requestedScreenSize * gridMetrics().cellSize);
-    updateGeometry();
-    adaptSize_();
-}
-
-void TerminalWidget::setFonts(terminal::renderer::FontDescriptions _fontDescriptions)
-{
-    if (applyFontDescription(gridMetrics().cellSize,
-                             screenSize(), size_, screenDPI(),
-                             renderer_, _fontDescriptions))
-        resize(size_); // resize widget (same pixels, but adjusted terminal rows/columns and margin)
-}
-
-bool TerminalWidget::setFontSize(text::font_size _size)
-{
-    if (!renderer_.setFontSize(_size))
-        return false;
-
-    renderer_.setMargin(computeMargin(gridMetrics().cellSize, screenSize(), pixelSize()));
-    resize(size_); // resize view (same pixels, but adjusted terminal rows/columns and margin)
-    updateMinimumSize();
-    return true;
+    return QOpenGLWidget::eventFilter(_watched, _event);
 }
+// }}}
 
-bool TerminalWidget::setScreenSize(crispy::Size _newScreenSize)
+// {{{ TerminalDisplay API
+void TerminalWidget::post(std::function<void()> _fn)
 {
-    if (_newScreenSize == terminal().screenSize())
-        return false;
-
-    renderer_.setScreenSize(_newScreenSize);
-    terminal().resizeScreen(_newScreenSize, _newScreenSize * cellSize());
-    return true;
+    postToObject(this, std::move(_fn));
 }
 
 void TerminalWidget::setMouseCursorShape(MouseCursorShape _shape)
@@ -883,87 +583,6 @@ void TerminalWidget::setMouseCursorShape(MouseCursorShape _shape)
         setCursor(newShape);
 }
 
-void TerminalWidget::setTerminalProfile(config::TerminalProfile _profile)
-{
-    (void) _profile; // profile_ = std::move(_profile); // TODO
-}
-
-void TerminalWidget::setWindowTitle(string_view _title)
-{
-    auto const title = _title.empty()
-        ? "contour"s
-        : fmt::format("{} - contour", _title);
-
-    // TODO: since we do not control the whole window, it would be best to emit a signal (or call back) instead.
-    if (window() && window()->windowHandle())
-        window()->windowHandle()->setTitle(QString::fromUtf8(title.c_str()));
-}
-
-void TerminalWidget::setWindowFullScreen()
-{
-    assertInitialized();
-    window()->windowHandle()->showFullScreen();
-}
-
-void TerminalWidget::setWindowMaximized()
-{
-    assertInitialized();
-    window()->showMaximized();
-    maximizedState_ = true;
-}
-
-void TerminalWidget::setWindowNormal()
-{
-    assertInitialized();
-    updateMinimumSize();
-    window()->windowHandle()->showNormal();
-    maximizedState_ = false;
-}
-
-void TerminalWidget::setBackgroundBlur(bool _enable)
-{
-    if (!enableBackgroundBlur_)
-        return;
-
-    enableBackgroundBlur_(_enable);
-}
-
-void TerminalWidget::toggleFullScreen()
-{
-    assertInitialized();
-
-    if (window()->isFullScreen())
-    {
-        window()->showNormal();
-        if (maximizedState_)
-            window()->showMaximized();
-    }
-    else
-    {
-        maximizedState_ = window()->isMaximized();
-        window()->showFullScreen();
-    }
-
-    // if (window_.visibility() == QWindow::FullScreen)
-    //     window_.setVisibility(QWindow::Windowed);
-    // else
-    //     window_.setVisibility(QWindow::FullScreen);
-}
-
-void TerminalWidget::setHyperlinkDecoration(terminal::renderer::Decorator _normal,
-                                            terminal::renderer::Decorator _hover)
-{
-    renderer_.setHyperlinkDecoration(_normal, _hover);
-}
-
-void TerminalWidget::setBackgroundOpacity(terminal::Opacity _opacity)
-{
-    renderer_.setBackgroundOpacity(_opacity);
-    session_.terminal().breakLoopAndRefreshRenderBuffer();
-}
-// }}}
-
-// {{{ terminal events
 void TerminalWidget::scheduleRedraw()
 {
     if (!initialized_.load())
@@ -971,31 +590,17 @@ void TerminalWidget::scheduleRedraw()
 
     if (setScreenDirty())
     {
-        update(); //QCoreApplication::postEvent(this, new QEvent(QEvent::UpdateRequest));
+        scheduleUpdate(); //QCoreApplication::postEvent(this, new QEvent(QEvent::UpdateRequest));
 
         emit terminalBufferUpdated(); // TODO: should not be invoked, as it's not guarranteed to be updated.
     }
 }
 
-void TerminalWidget::renderBufferUpdated()
-{
-    scheduleRedraw();
-}
-
 void TerminalWidget::onClosed()
 {
     post([this]() { close(); });
 }
 
-void TerminalWidget::onSelectionCompleted()
-{
-    if (QClipboard* clipboard = QGuiApplication::clipboard(); clipboard != nullptr)
-    {
-        string const text = terminal().extractSelectionText();
-        clipboard->setText(QString::fromUtf8(text.c_str(), static_cast<int>(text.size())), QClipboard::Selection);
-    }
-}
-
 void TerminalWidget::bufferChanged(terminal::ScreenType _type)
 {
     using Type = terminal::ScreenType;
@@ -1011,33 +616,47 @@ void TerminalWidget::bufferChanged(terminal::ScreenType _type)
     emit terminalBufferChanged(_type);
     //scheduleRedraw();
 }
+// }}}
 
-void TerminalWidget::discardImage(terminal::Image const& _image)
+// {{{ TerminalDisplayBase hooks
+QScreen* TerminalWidget::hostScreen() const
 {
-    renderer_.discardImage(_image);
+    return screenOf(this);
 }
-// }}}
 
-// {{{ helpers
-void TerminalWidget::assertInitialized()
+bool TerminalWidget::exposed() const
 {
-    if (initialized_)
-        return;
+    auto const* handle = window()->windowHandle();
+    return !handle
+        || (handle->isExposed()
+            && handle->visibility() != QWindow::Hidden
+            && handle->visibility() != QWindow::Minimized);
+}
 
-    throw std::runtime_error(
-        "Internal error. "
-        "TerminalWidget function invoked before initialization has finished."
-    );
+void TerminalWidget::requestPaint()
+{
+    if (renderThread_)
+        renderThread_->requestFrame();
+    else
+        update();
 }
 
-void TerminalWidget::onScrollBarValueChanged(int _value)
+void TerminalWidget::updateMinimumSize()
 {
-    terminal().viewport().scrollToAbsolute(_value);
-    scheduleRedraw();
+    setMinimumSize(minimumSizeHint());
 }
 
-void TerminalWidget::blinkingCursorUpdate()
+void TerminalWidget::waitForRenderer()
+{
+    if (renderThread_)
+        renderThread_->wait();
+}
+// }}}
+
+// {{{ helpers
+void TerminalWidget::onScrollBarValueChanged(int _value)
 {
+    terminal().viewport().scrollToAbsolute(_value);
     scheduleRedraw();
 }
 
@@ -1048,31 +667,6 @@ float TerminalWidget::contentScale() const
 
     return window()->windowHandle()->screen()->devicePixelRatio();
 }
-
-void TerminalWidget::resize(Size _size)
-{
-    size_ = _size;
-
-    auto const newScreenSize = screenSize();
-
-    renderer_.setRenderSize(_size);
-    renderer_.setScreenSize(newScreenSize);
-    renderer_.setMargin(computeMargin(gridMetrics().cellSize, newScreenSize, size_));
-    //renderer_.clearCache();
-
-    if (newScreenSize != terminal().screenSize())
-    {
-        terminal().resizeScreen(newScreenSize, newScreenSize * gridMetrics().cellSize);
-        terminal().clearSelection();
-    }
-}
-
-void TerminalWidget::updateMinimumSize()
-{
-    auto const MinimumGridSize = Size{3, 2};
-    auto const minSize = gridMetrics().cellSize * MinimumGridSize;
-    setMinimumSize(minSize.width, minSize.height);
-}
 // }}}
 
 } // namespace contour
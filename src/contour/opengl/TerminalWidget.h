@@ -15,17 +15,13 @@
 
 #include <contour/Actions.h>
 #include <contour/Config.h>
-#include <contour/TerminalDisplay.h>
 #include <contour/TerminalSession.h>
-#include <contour/helper.h>
+#include <contour/opengl/TerminalDisplayBase.h>
 
-#include <terminal/Color.h>
 #include <terminal/Metrics.h>
-#include <terminal_renderer/Renderer.h>
 
 #include <QtCore/QPoint>
 #include <QtCore/QTimer>
-#include <QtGui/QOpenGLExtraFunctions>
 #include <QtGui/QVector4D>
 #include <QtWidgets/QOpenGLWidget>
 #include <QtWidgets/QMainWindow>
@@ -35,17 +31,17 @@
 #include <atomic>
 #include <fstream>
 #include <memory>
-#include <optional>
 #include <vector>
 
 namespace contour::opengl {
 
+class RenderThread;
+
 // It currently just handles one terminal inside, but ideally later it can handle
 // multiple terminals in tabbed views as well tiled.
 class TerminalWidget :
     public QOpenGLWidget,
-    public TerminalDisplay,
-    private QOpenGLExtraFunctions
+    public TerminalDisplayBase
 {
     Q_OBJECT
 
@@ -58,12 +54,12 @@ public:
     ~TerminalWidget() override;
 
     // {{{ OpenGL rendering handling
-    static QSurfaceFormat surfaceFormat();
     QSize minimumSizeHint() const override;
     QSize sizeHint() const override;
     void initializeGL() override;
     void resizeGL(int _width, int _height) override;
     void paintGL() override;
+    void paintEvent(QPaintEvent* _event) override;
     // }}}
 
     // {{{ Input handling
@@ -77,48 +73,18 @@ public:
     void inputMethodEvent(QInputMethodEvent* _event) override;
     QVariant inputMethodQuery(Qt::InputMethodQuery _query) const override;
     bool event(QEvent* _event) override;
+    bool eventFilter(QObject* _watched, QEvent* _event) override;
     // }}}
 
     // {{{ TerminalDisplay API
     void post(std::function<void()> _fn) override;
-
-    // Attributes
-    double refreshRate() const override;
     crispy::Point screenDPI() const override;
-    bool isFullScreen() const override;
-    crispy::Size pixelSize() const override;
-    crispy::Size cellSize() const override;
-
-    // (user requested) actions
-    bool requestPermission(config::Permission _allowedByConfig, std::string_view _topicText) override;
-    terminal::FontDef getFontDef() override;
-    void bell() override;
-    void copyToClipboard(std::string_view /*_data*/) override;
-    void dumpState() override;
-    void notify(std::string_view /*_title*/, std::string_view /*_body*/) override;
-    void resizeWindow(int /*_width*/, int /*_height*/, bool /*_unitInPixels*/) override;
-    void setFonts(terminal::renderer::FontDescriptions _fontDescriptions) override;
-    bool setFontSize(text::font_size _size) override;
-    bool setScreenSize(crispy::Size _newScreenSize) override;
     void setMouseCursorShape(MouseCursorShape _shape) override;
-    void setTerminalProfile(config::TerminalProfile _profile) override;
-    void setWindowTitle(std::string_view /*_title*/) override;
-    void setWindowFullScreen() override;
-    void setWindowMaximized() override;
-    void setWindowNormal() override;
-    void setBackgroundBlur(bool _enable) override;
-    void toggleFullScreen() override;
-    void setHyperlinkDecoration(terminal::renderer::Decorator _normal,
-                                terminal::renderer::Decorator _hover) override;
-    void setBackgroundOpacity(terminal::Opacity _opacity) override;
 
     // terminal events
     void scheduleRedraw() override;
-    void renderBufferUpdated() override;
     void onClosed() override;
-    void onSelectionCompleted() override;
     void bufferChanged(terminal::ScreenType) override;
-    void discardImage(terminal::Image const&) override;
     // }}}
 
     /// Declares the screen-dirtiness-vs-rendering state.
@@ -139,20 +105,22 @@ public:
     void terminated();
     void showNotification(QString const& _title, QString const& _body);
 
+  protected:
+    // {{{ TerminalDisplayBase hooks
+    QWidget* hostWidget() const override { return const_cast<TerminalWidget*>(this); }
+    QScreen* hostScreen() const override;
+    bool exposed() const override;
+    void markScreenDirty() override { setScreenDirty(); }
+    void requestPaint() override;
+    void makeRenderContextCurrent() override { makeCurrent(); }
+    void updateMinimumSize() override;
+    void waitForRenderer() override;
+    // }}}
+
   private:
     // helper methods
     //
-    terminal::Terminal& terminal() noexcept { return session_.terminal(); }
-    crispy::Size screenSize() const { return size_ / gridMetrics().cellSize; }
-    void assertInitialized();
     float contentScale() const;
-    void blinkingCursorUpdate();
-    void resize(crispy::Size _pixels);
-    void updateMinimumSize();
-
-    void statsSummary();
-    void doResize(crispy::Size _size);
-    terminal::renderer::GridMetrics const& gridMetrics() const noexcept { return renderer_.gridMetrics(); }
 
     /// Defines the current screen-dirtiness-vs-rendering state.
     ///
@@ -167,8 +135,6 @@ public:
     /// either DirtyIdle if no painting is currently in progress, DirtyPainting otherwise.
     std::atomic<State> state_ = State::CleanIdle;
 
-    terminal::renderer::FontDescriptions sanitizeDPI(terminal::renderer::FontDescriptions _fonts);
-
     /// Flags the screen as dirty.
     ///
     /// @returns boolean indicating whether the screen was clean before and made dirty (true), false otherwise.
@@ -198,36 +164,12 @@ public:
 
     // private data fields
     //
-    config::TerminalProfile const& profile_; // TODO: a cref would be much better
-    TerminalSession& session_;
-    std::function<void()> adaptSize_;
-    std::function<void(bool)> enableBackgroundBlur_;
-    terminal::renderer::Renderer renderer_;
-    crispy::Size size_;                     // view size in pixels
-    text::font_size fontSize_{};
-
-    // ======================================================================
-
-    std::unique_ptr<terminal::renderer::RenderTarget> renderTarget_;
-    QTimer updateTimer_;                            // update() timer used to animate the blinking cursor.
-    bool renderingPressure_ = false;
-    bool maximizedState_ = false;
+    std::unique_ptr<RenderThread> renderThread_;    // renders the frames if enabled, off the GUI thread
     struct Stats {
         std::atomic<uint64_t> updatesSinceRendering = 0;
         std::atomic<uint64_t> consecutiveRenderCount = 0;
     };
-    std::atomic<bool> initialized_ = false;
     Stats stats_;
-#if defined(CONTOUR_VT_METRICS)
-    terminal::Metrics terminalMetrics_{};
-#endif
-
-    PermissionCache rememberedPermissions_;
-
-    // render state cache
-    struct {
-        terminal::RGBAColor backgroundColor{};
-    } renderStateCache_;
 };
 
 } // namespace contour
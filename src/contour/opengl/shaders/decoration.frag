@@ -0,0 +1,103 @@
+in vec2 fs_position;
+flat in ivec2 fs_size;
+flat in vec4 fs_color;
+flat in ivec2 fs_decoration;
+flat in ivec3 fs_metrics;
+
+out vec4 outColor;
+
+// Must match the order of terminal::renderer::Decorator.
+const int Underline = 0;
+const int DoubleUnderline = 1;
+const int CurlyUnderline = 2;
+const int DottedUnderline = 3;
+const int DashedUnderline = 4;
+const int Overline = 5;
+const int CrossedOut = 6;
+const int Framed = 7;
+const int Encircle = 8;
+
+const float PI = 3.14159265358979;
+
+bool horizontalLine(int y, int bottom, int thickness)
+{
+    return bottom <= y && y < bottom + thickness;
+}
+
+// Tests whether the given pixel, relative to the bottom left of its grid cell, is to be painted.
+bool covers(ivec2 pos)
+{
+    int decorator = fs_decoration.x;
+    int baseline = fs_decoration.y;
+    int cellWidth = max(1, fs_metrics.x);
+    int cellHeight = fs_size.y;
+    int underlinePosition = fs_metrics.y;
+    int thickness = max(1, fs_metrics.z);
+    int thicknessHalf = (thickness + 1) / 2;
+    int underlineBottom = max(0, underlinePosition - thicknessHalf);
+
+    switch (decorator)
+    {
+        case Underline:
+            return horizontalLine(pos.y, underlineBottom, thickness);
+        case DoubleUnderline:
+        {
+            // Two lines, one thickness apart, moved up if there is no room below the underline.
+            int lowerBottom = max(0, underlineBottom - thickness);
+            return horizontalLine(pos.y, lowerBottom, thickness)
+                || horizontalLine(pos.y, lowerBottom + 2 * thickness, thickness);
+        }
+        case CurlyUnderline:
+        {
+            // One period of a cosine wave per cell, between the cell bottom and two thirds of the baseline.
+            float amplitude = float(max(0, (2 * baseline) / 3 - thickness));
+            float wave = (cos((float(pos.x) + 0.5) / float(cellWidth) * 2.0 * PI) + 1.0) / 2.0;
+            return horizontalLine(pos.y, int(wave * amplitude), thickness);
+        }
+        case DottedUnderline:
+        {
+            // Dots of the underline's thickness, three diameters apart.
+            int radius = thicknessHalf;
+            int period = 6 * radius;
+            int centerY = max(radius, underlinePosition - radius);
+            int dx = pos.x - radius - ((pos.x + period / 2 - radius) / period) * period;
+            int dy = pos.y - centerY;
+            return dx * dx + dy * dy <= radius * radius;
+        }
+        case DashedUnderline:
+            // Divides the cell's underline into three sections, leaving out the middle one.
+            return horizontalLine(pos.y, underlineBottom, thickness)
+                && abs((float(pos.x) + 0.5) / float(cellWidth) - 0.5) >= 0.25;
+        case Overline:
+            return horizontalLine(pos.y, cellHeight - thickness, thickness);
+        case CrossedOut:
+            return horizontalLine(pos.y, cellHeight / 2 - thicknessHalf, thickness);
+        case Framed:
+        {
+            int border = max(1, thickness / 2);
+            return pos.x < border || pos.x >= cellWidth - border
+                || pos.y < border || pos.y >= cellHeight - border;
+        }
+        case Encircle:
+        {
+            // Ellipse inscribed into the cell, with its outline being as thick as the frame.
+            vec2 radii = vec2(cellWidth, cellHeight) / 2.0;
+            vec2 offset = (vec2(pos) + 0.5 - radii) / radii;
+            float border = float(max(1, thickness / 2)) / min(radii.x, radii.y);
+            float extent = length(offset);
+            return 1.0 - border <= extent && extent <= 1.0;
+        }
+    }
+    return false;
+}
+
+void main()
+{
+    ivec2 pos = ivec2(fs_position);
+    int cellWidth = max(1, fs_metrics.x);
+
+    if (!covers(ivec2(pos.x % cellWidth, pos.y)))
+        discard;
+
+    outColor = fs_color;
+}
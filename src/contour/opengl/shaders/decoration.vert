@@ -0,0 +1,23 @@
+uniform mat4 u_projection;
+layout (location = 0) in vec2 vs_corner;        // corner of the unit quad
+layout (location = 1) in vec4 vs_rect;          // target origin (x, y) and size (width, height)
+layout (location = 2) in vec4 vs_color;         // decoration color
+layout (location = 3) in ivec2 vs_decoration;   // decorator and glyph baseline
+layout (location = 4) in ivec3 vs_metrics;      // cell width, underline position and thickness
+
+out vec2 fs_position;                           // position within the target, relative to its bottom left
+flat out ivec2 fs_size;
+flat out vec4 fs_color;
+flat out ivec2 fs_decoration;
+flat out ivec3 fs_metrics;
+
+void main()
+{
+    fs_position = vs_corner * vs_rect.zw;
+    fs_size = ivec2(vs_rect.zw);
+    fs_color = vs_color;
+    fs_decoration = vs_decoration;
+    fs_metrics = vs_metrics;
+
+    gl_Position = u_projection * vec4(vs_rect.xy + fs_position, 0.0, 1.0);
+}
@@ -0,0 +1,208 @@
+// Integers are packed into 32 bits, see OpenGLRenderer::renderGrid().
+precision highp int;
+precision highp usampler2D;
+
+uniform usampler2D u_cells;                     // two RGBA32UI texels per cell, one row per grid line
+uniform sampler2D u_palette;                    // one RGB texel per palette slot
+uniform sampler2DArray u_monochromeTextures;    // R
+uniform sampler2DArray u_colorTextures;         // RGBA
+uniform sampler2DArray u_lcdTextures;           // RGB
+uniform vec2 u_gridOrigin;                      // bottom left corner of the grid
+uniform ivec2 u_cellSize;
+uniform ivec2 u_pageSize;                       // number of columns and lines
+uniform ivec3 u_decorationMetrics;              // glyph baseline, underline position and thickness
+
+in vec2 fs_position;
+out vec4 fragColor;
+
+// Must match the order of terminal::renderer::Decorator.
+const int Underline = 0;
+const int DoubleUnderline = 1;
+const int CurlyUnderline = 2;
+const int DottedUnderline = 3;
+const int DashedUnderline = 4;
+const int Overline = 5;
+const int CrossedOut = 6;
+const int Framed = 7;
+const int Encircle = 8;
+
+const float PI = 3.14159265358979;
+
+vec4 unpackColor(uint v)
+{
+    return vec4(float((v >> 24u) & 0xFFu),
+                float((v >> 16u) & 0xFFu),
+                float((v >> 8u) & 0xFFu),
+                float(v & 0xFFu)) / 255.0;
+}
+
+// Resolves colors referring to a palette slot, tagged by an alpha of 1.
+vec4 cellColor(uint v)
+{
+    if ((v & 0xFFu) != 1u)
+        return unpackColor(v);
+
+    vec3 color = texelFetch(u_palette, ivec2(int(v >> 16u), 0), 0).rgb;
+    if ((v & 0x100u) != 0u)
+        color *= 0.5; // faint
+    return vec4(color, 1.0);
+}
+
+ivec2 unpackSize(uint v)
+{
+    return ivec2(int(v & 0xFFFFu), int(v >> 16u));
+}
+
+ivec2 unpackOffset(uint v)
+{
+    ivec2 u = unpackSize(v);
+    return ivec2(u.x >= 0x8000 ? u.x - 0x10000 : u.x,
+                 u.y >= 0x8000 ? u.y - 0x10000 : u.y);
+}
+
+// Composites non-premultiplied colors.
+vec4 over(vec4 top, vec4 bottom)
+{
+    float a = top.a + bottom.a * (1.0 - top.a);
+    if (a <= 0.0)
+        return vec4(0.0);
+    return vec4((top.rgb * top.a + bottom.rgb * bottom.a * (1.0 - top.a)) / a, a);
+}
+
+// Samples the glyph of the given cell at a pixel relative to that cell's bottom left corner.
+vec4 glyphAt(int column, int line, ivec2 pixel)
+{
+    if (column < 0 || column >= u_pageSize.x)
+        return vec4(0.0);
+
+    uvec4 first = texelFetch(u_cells, ivec2(2 * column, line), 0);
+    uvec4 second = texelFetch(u_cells, ivec2(2 * column + 1, line), 0);
+
+    int selector = int(second.z & 0xFFu) - 1; // atlas user, or -1 without a glyph
+    if (selector < 0)
+        return vec4(0.0);
+
+    ivec2 targetSize = unpackSize(second.x);
+    ivec2 p = pixel - unpackOffset(second.y);
+    if (any(lessThan(p, ivec2(0))) || any(greaterThanEqual(p, targetSize)))
+        return vec4(0.0);
+
+    // Same texel as nearest sampling at the pixel's center yields for a textured quad.
+    ivec2 bitmapSize = unpackSize(first.w);
+    ivec2 texel = unpackSize(first.z) + (2 * p + 1) * bitmapSize / (2 * targetSize);
+    ivec3 coord = ivec3(texel, int((second.z >> 8u) & 0xFFu));
+    vec4 textColor = cellColor(first.y);
+
+    switch (selector)
+    {
+        case 2:
+        {
+            vec4 v = texelFetch(u_lcdTextures, coord, 0);
+            return vec4(v.rgb * textColor.rgb, (v.r + v.g + v.b) / 3.0);
+        }
+        case 1:
+            return texelFetch(u_colorTextures, coord, 0);
+        case 0:
+        default:
+            return vec4(textColor.rgb, textColor.a * texelFetch(u_monochromeTextures, coord, 0).r);
+    }
+}
+
+bool horizontalLine(int y, int bottom, int thickness)
+{
+    return bottom <= y && y < bottom + thickness;
+}
+
+// Tests whether the given decorator paints a pixel relative to the bottom left of its cell,
+// drawing the same patterns as the decoration shader.
+bool covers(int decorator, ivec2 pos)
+{
+    int baseline = u_decorationMetrics.x;
+    int cellWidth = max(1, u_cellSize.x);
+    int cellHeight = u_cellSize.y;
+    int underlinePosition = u_decorationMetrics.y;
+    int thickness = max(1, u_decorationMetrics.z);
+    int thicknessHalf = (thickness + 1) / 2;
+    int underlineBottom = max(0, underlinePosition - thicknessHalf);
+
+    switch (decorator)
+    {
+        case Underline:
+            return horizontalLine(pos.y, underlineBottom, thickness);
+        case DoubleUnderline:
+        {
+            int lowerBottom = max(0, underlineBottom - thickness);
+            return horizontalLine(pos.y, lowerBottom, thickness)
+                || horizontalLine(pos.y, lowerBottom + 2 * thickness, thickness);
+        }
+        case CurlyUnderline:
+        {
+            float amplitude = float(max(0, (2 * baseline) / 3 - thickness));
+            float wave = (cos((float(pos.x) + 0.5) / float(cellWidth) * 2.0 * PI) + 1.0) / 2.0;
+            return horizontalLine(pos.y, int(wave * amplitude), thickness);
+        }
+        case DottedUnderline:
+        {
+            int radius = thicknessHalf;
+            int period = 6 * radius;
+            int centerY = max(radius, underlinePosition - radius);
+            int dx = pos.x - radius - ((pos.x + period / 2 - radius) / period) * period;
+            int dy = pos.y - centerY;
+            return dx * dx + dy * dy <= radius * radius;
+        }
+        case DashedUnderline:
+            return horizontalLine(pos.y, underlineBottom, thickness)
+                && abs((float(pos.x) + 0.5) / float(cellWidth) - 0.5) >= 0.25;
+        case Overline:
+            return horizontalLine(pos.y, cellHeight - thickness, thickness);
+        case CrossedOut:
+            return horizontalLine(pos.y, cellHeight / 2 - thicknessHalf, thickness);
+        case Framed:
+        {
+            int border = max(1, thickness / 2);
+            return pos.x < border || pos.x >= cellWidth - border
+                || pos.y < border || pos.y >= cellHeight - border;
+        }
+        case Encircle:
+        {
+            vec2 radii = vec2(cellWidth, cellHeight) / 2.0;
+            vec2 offset = (vec2(pos) + 0.5 - radii) / radii;
+            float border = float(max(1, thickness / 2)) / min(radii.x, radii.y);
+            float extent = length(offset);
+            return 1.0 - border <= extent && extent <= 1.0;
+        }
+    }
+    return false;
+}
+
+void main()
+{
+    ivec2 local = ivec2(floor(fs_position - u_gridOrigin));
+    int column = local.x / u_cellSize.x;
+    int lineFromBottom = local.y / u_cellSize.y;
+    int line = u_pageSize.y - 1 - lineFromBottom;
+    ivec2 pixel = local - ivec2(column, lineFromBottom) * u_cellSize;
+
+    // Glyphs may overflow into their neighbors, on top of which they are drawn from left to right.
+    vec4 color = cellColor(texelFetch(u_cells, ivec2(2 * column, line), 0).x);
+    color = over(glyphAt(column - 1, line, pixel + ivec2(u_cellSize.x, 0)), color);
+    color = over(glyphAt(column, line, pixel), color);
+    color = over(glyphAt(column + 1, line, pixel - ivec2(u_cellSize.x, 0)), color);
+
+    // Decorations are opaque and drawn on top of all glyphs.
+    uvec4 second = texelFetch(u_cells, ivec2(2 * column + 1, line), 0);
+    uint decorators = second.z >> 16u;
+    for (int decorator = Underline; decorators != 0u && decorator <= Encircle; ++decorator)
+    {
+        if ((decorators & (1u << uint(decorator))) != 0u && covers(decorator, pixel))
+        {
+            color = cellColor(second.w);
+            break;
+        }
+    }
+
+    if (color.a <= 0.0)
+        discard;
+
+    fragColor = color;
+}
@@ -0,0 +1,12 @@
+uniform mat4 u_projection;
+uniform vec4 u_rect;                            // target origin (x, y) and size (width, height)
+
+layout (location = 0) in vec2 vs_corner;        // corner of the unit quad
+
+out vec2 fs_position;                           // position on the render target
+
+void main()
+{
+    fs_position = u_rect.xy + vs_corner * u_rect.zw;
+    gl_Position = u_projection * vec4(fs_position, 0.0, 1.0);
+}
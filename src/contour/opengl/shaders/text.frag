@@ -1,10 +1,8 @@
 uniform float pixel_x;                        // 1.0 / lcdAtlas.width
-uniform sampler2D fs_monochromeTextures; // R
-uniform sampler2D fs_colorTextures;      // RGBA
-uniform sampler2D fs_lcdTexture;         // RGB
-// uniform sampler2DArray fs_monochromeTextures; // R
-// uniform sampler2DArray fs_colorTextures;      // RGBA
-// uniform sampler2DArray fs_lcdTexture;         // RGB
+uniform sampler2DArray fs_monochromeTextures; // R
+uniform sampler2DArray fs_colorTextures;      // RGBA
+uniform sampler2DArray fs_lcdTexture;         // RGB
+uniform bool fs_distanceField;                // monochrome textures hold signed distance fields
 
 in vec4 fs_TexCoord;
 in vec4 fs_textColor;
@@ -19,12 +17,19 @@ const vec4 TEST_PIXEL = vec4(1.0, 0.0, 0.0, 1.0); // test pixel for debugging
 void renderGrayscaleGlyph()
 {
     // XXX monochrome glyph (RGB)
-    //vec4 alphaMap = texture(fs_monochromeTextures, fs_TexCoord.xy);
+    //vec4 alphaMap = texture(fs_monochromeTextures, fs_TexCoord.xyz);
     //fragColor = fs_textColor;
     //colorMask = alphaMap;
 
     // when only using the RED-channel
-    float v = texture(fs_monochromeTextures, fs_TexCoord.xy).r;
+    float v = texture(fs_monochromeTextures, fs_TexCoord.xyz).r;
+
+    // The outline is at half the distance range, anti-aliased across about a pixel on screen.
+    if (fs_distanceField)
+    {
+        float width = max(0.5 * fwidth(v), 0.0001);
+        v = smoothstep(0.5 - width, 0.5 + width, v);
+    }
     vec4 sampled = vec4(1.0, 1.0, 1.0, v);
     fragColor = sampled * fs_textColor;
 }
@@ -33,7 +38,7 @@ void renderGrayscaleGlyph()
 void renderColoredRGBA()
 {
     // colored image (RGBA)
-    vec4 v = texture(fs_colorTextures, fs_TexCoord.xy);
+    vec4 v = texture(fs_colorTextures, fs_TexCoord.xyz);
     //v = TEST_PIXEL;
     fragColor = v;
 }
@@ -43,7 +48,7 @@ void renderColoredRGBA()
 void renderLcdGlyphSimple()
 {
     // LCD glyph (RGB)
-    vec4 v = texture(fs_lcdTexture, fs_TexCoord.xy); // .rgb ?
+    vec4 v = texture(fs_lcdTexture, fs_TexCoord.xyz); // .rgb ?
 
     // float a = min(v.r, min(v.g, v.b));
     float a = (v.r + v.g + v.b) / 3.0;
@@ -109,12 +114,11 @@ vec3 lcdPixelShift(vec3 current, vec3 previous, float shift)
 void renderLcdGlyph()
 {
     float px = pixel_x;
-    vec2 pixelOffset = vec2(1.0, 0.0) * px;
-    //vec3 pixelOffset = vec3(1.0, 0.0, 0.0) * px;
+    vec3 pixelOffset = vec3(1.0, 0.0, 0.0) * px;
 
     // LCD glyph (RGB)
-    vec4 current  = texture(fs_lcdTexture, fs_TexCoord.xy);
-    vec4 previous = texture(fs_lcdTexture, fs_TexCoord.xy - pixelOffset);
+    vec4 current  = texture(fs_lcdTexture, fs_TexCoord.xyz);
+    vec4 previous = texture(fs_lcdTexture, fs_TexCoord.xyz - pixelOffset);
 
     // The text in a terminal does enforce fixed-width advances, and therefore
     // rendering a glyph should always start at a full pixel with no shift.
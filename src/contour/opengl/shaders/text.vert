@@ -1,16 +1,20 @@
-uniform mat4 vs_projection;                 // projection matrix (flips around the coordinate system)
+uniform mat4 vs_projection;                         // projection matrix (flips around the coordinate system)
 
-layout (location = 0) in vec3 vs_vertex;    // target vertex coordinates
-layout (location = 1) in vec4 vs_texCoords; // 3D-atlas texture coordinates
-layout (location = 2) in vec4 vs_colors;    // custom foreground colors
+layout (location = 0) in vec2 vs_corner;            // unit quad corner, shared by all instances
+layout (location = 1) in vec3 vs_origin;            // target coordinates of the bottom left corner
+layout (location = 2) in vec2 vs_size;              // target width and height
+layout (location = 3) in vec4 vs_texRect;           // atlas texture coordinates (x, y, width, height)
+layout (location = 4) in vec2 vs_textureSelector;   // selects which texture array and layer to use
+layout (location = 5) in vec4 vs_colors;            // custom foreground colors
 
 out vec4 fs_TexCoord;
 out vec4 fs_textColor;
 
 void main()
 {
-    gl_Position = vs_projection * vec4(vs_vertex.xyz, 1.0);
+    vec2 position = vs_origin.xy + vs_corner * vs_size;
+    gl_Position = vs_projection * vec4(position, vs_origin.z, 1.0);
 
-    fs_TexCoord = vs_texCoords;
+    fs_TexCoord = vec4(vs_texRect.xy + vs_corner * vs_texRect.zw, vs_textureSelector.y, vs_textureSelector.x);
     fs_textColor = vs_colors;
 }
@@ -0,0 +1,136 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// Counting of heap allocations, per thread and per phase of work (such as parsing or rendering).
+///
+/// Allocations are only counted if the executable replaces the global operator new
+/// with one invoking crispy::allocations::record(), otherwise all counts stay zero.
+namespace crispy {
+
+struct allocation_count {
+    uint64_t count = 0;     // number of allocations
+    uint64_t bytes = 0;     // number of bytes allocated
+
+    constexpr allocation_count& operator+=(allocation_count const& _other) noexcept
+    {
+        count += _other.count;
+        bytes += _other.bytes;
+        return *this;
+    }
+};
+
+constexpr allocation_count operator-(allocation_count const& a, allocation_count const& b) noexcept
+{
+    return allocation_count{ a.count - b.count, a.bytes - b.bytes };
+}
+
+namespace allocations
+{
+    namespace detail
+    {
+        inline thread_local allocation_count thisThread{};
+        inline std::atomic<bool> counting{ false };
+    }
+
+    /// Accounts an allocation of @p _bytes to the calling thread. Invoked by the global operator new.
+    inline void record(size_t _bytes) noexcept
+    {
+        detail::thisThread.count += 1;
+        detail::thisThread.bytes += _bytes;
+        if (!detail::counting.load(std::memory_order_relaxed))
+            detail::counting.store(true, std::memory_order_relaxed);
+    }
+
+    /// @returns whether allocations are being counted at all, i.e. record() has ever been invoked.
+    inline bool counting() noexcept { return detail::counting.load(std::memory_order_relaxed); }
+
+    /// @returns the allocations made by the calling thread so far.
+    inline allocation_count this_thread() noexcept { return detail::thisThread; }
+}
+
+/// Sums up the allocations made within the scopes of a phase of work, along with the amount of
+/// work done (e.g. bytes parsed or frames rendered), so that they can be reported per unit of work.
+///
+/// Scopes may be entered from any number of threads.
+class allocation_phase {
+  public:
+    allocation_phase() = default;
+    allocation_phase(allocation_phase const&) = delete;
+    allocation_phase& operator=(allocation_phase const&) = delete;
+
+    void add(allocation_count const& _allocations, uint64_t _units) noexcept
+    {
+        count_.fetch_add(_allocations.count, std::memory_order_relaxed);
+        bytes_.fetch_add(_allocations.bytes, std::memory_order_relaxed);
+        units_.fetch_add(_units, std::memory_order_relaxed);
+    }
+
+    allocation_count allocations() const noexcept
+    {
+        return allocation_count{ count_.load(std::memory_order_relaxed), bytes_.load(std::memory_order_relaxed) };
+    }
+
+    /// @returns the amount of work done within this phase's scopes.
+    uint64_t units() const noexcept { return units_.load(std::memory_order_relaxed); }
+
+    /// @returns the number of allocations per @p _unitSize units of work, or zero if none was done.
+    double allocations_per(uint64_t _unitSize = 1) const noexcept
+    {
+        auto const n = units();
+        return n ? static_cast<double>(allocations().count) * static_cast<double>(_unitSize) / static_cast<double>(n)
+                 : 0.0;
+    }
+
+    void reset() noexcept
+    {
+        count_.store(0, std::memory_order_relaxed);
+        bytes_.store(0, std::memory_order_relaxed);
+        units_.store(0, std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<uint64_t> count_ = 0;
+    std::atomic<uint64_t> bytes_ = 0;
+    std::atomic<uint64_t> units_ = 0;
+};
+
+/// Accounts the allocations the calling thread makes during its lifetime to an allocation_phase.
+class scoped_allocation_count {
+  public:
+    explicit scoped_allocation_count(allocation_phase& _phase, uint64_t _units = 1) noexcept:
+        phase_{ _phase },
+        units_{ _units },
+        start_{ allocations::this_thread() }
+    {}
+
+    ~scoped_allocation_count() { phase_.add(allocations::this_thread() - start_, units_); }
+
+    scoped_allocation_count(scoped_allocation_count const&) = delete;
+    scoped_allocation_count& operator=(scoped_allocation_count const&) = delete;
+
+    /// Sets the amount of work done within this scope, if only known by the end of it.
+    void set_units(uint64_t _units) noexcept { units_ = _units; }
+
+  private:
+    allocation_phase& phase_;
+    uint64_t units_;
+    allocation_count start_;
+};
+
+} // end namespace
@@ -0,0 +1,72 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/allocation_counter.h>
+
+#include <catch2/catch.hpp>
+
+#include <thread>
+
+using crispy::allocation_phase;
+using crispy::scoped_allocation_count;
+namespace allocations = crispy::allocations;
+
+// The test executable doesn't replace the global operator new, so allocations are recorded by hand.
+
+TEST_CASE("allocation_counter.scope", "[allocation_counter]")
+{
+    auto phase = allocation_phase{};
+    allocations::record(100);
+    {
+        auto const _ = scoped_allocation_count{phase};
+        allocations::record(16);
+        allocations::record(32);
+    }
+    CHECK(allocations::counting());
+    CHECK(phase.allocations().count == 2);
+    CHECK(phase.allocations().bytes == 48);
+    CHECK(phase.units() == 1);
+
+    {
+        auto scope = scoped_allocation_count{phase, 0};
+        allocations::record(8);
+        scope.set_units(3);
+    }
+    CHECK(phase.allocations().count == 3);
+    CHECK(phase.units() == 4);
+    CHECK(phase.allocations_per() == 0.75);
+    CHECK(phase.allocations_per(8) == 6.0);
+
+    phase.reset();
+    CHECK(phase.allocations().count == 0);
+    CHECK(phase.allocations_per() == 0.0);
+}
+
+TEST_CASE("allocation_counter.threads", "[allocation_counter]")
+{
+    // Only the allocations of the thread owning the scope are accounted to it.
+    auto phase = allocation_phase{};
+    {
+        auto const _ = scoped_allocation_count{phase};
+        auto other = std::thread([&]() {
+            allocations::record(64);
+            auto const _ = scoped_allocation_count{phase};
+            allocations::record(8);
+        });
+        other.join();
+        allocations::record(16);
+    }
+    CHECK(phase.allocations().count == 2);
+    CHECK(phase.allocations().bytes == 24);
+    CHECK(phase.units() == 2);
+}
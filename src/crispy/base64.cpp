@@ -0,0 +1,478 @@
+/**
+ * This file is part of the "contour" project.
+ *   Copyright (c) 2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/base64.h>
+
+#include <cstring>
+#include <utility>
+
+#if defined(__SSSE3__)
+    #include <tmmintrin.h>
+    #define CRISPY_BASE64_SSSE3 1
+#endif
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define CRISPY_BASE64_AVX2 1
+#endif
+
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && (defined(__aarch64__) || defined(_M_ARM64))
+    #include <arm_neon.h>
+    #define CRISPY_BASE64_NEON 1
+#endif
+
+using std::pair;
+using std::string_view;
+
+namespace crispy::base64 {
+
+namespace // {{{ helper
+{
+    constexpr char Alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+        "abcdefghijklmnopqrstuvwxyz"
+        "0123456789+/";
+
+    constexpr uint8_t sextet(char _char) noexcept
+    {
+        return detail::indexmap[static_cast<uint8_t>(_char)];
+    }
+
+    inline void encodeGroup(uint8_t const* _input, char* _output) noexcept
+    {
+        _output[0] = Alphabet[_input[0] >> 2];
+        _output[1] = Alphabet[((_input[0] & 0x03) << 4) | (_input[1] >> 4)];
+        _output[2] = Alphabet[((_input[1] & 0x0F) << 2) | (_input[2] >> 6)];
+        _output[3] = Alphabet[_input[2] & 0x3F];
+    }
+
+    /// Encodes the last one or two bytes, including padding.
+    size_t encodeTail(uint8_t const* _input, size_t _count, char* _output) noexcept
+    {
+        if (_count == 0)
+            return 0;
+
+        auto const second = _count > 1 ? _input[1] : uint8_t{0};
+        _output[0] = Alphabet[_input[0] >> 2];
+        _output[1] = Alphabet[((_input[0] & 0x03) << 4) | (second >> 4)];
+        _output[2] = _count > 1 ? Alphabet[(second & 0x0F) << 2] : '=';
+        _output[3] = '=';
+        return 4;
+    }
+
+    inline void decodeGroup(uint8_t const* _sextets, uint8_t* _output) noexcept
+    {
+        _output[0] = static_cast<uint8_t>(_sextets[0] << 2 | _sextets[1] >> 4);
+        _output[1] = static_cast<uint8_t>(_sextets[1] << 4 | _sextets[2] >> 2);
+        _output[2] = static_cast<uint8_t>(_sextets[2] << 6 | _sextets[3]);
+    }
+
+    /// Decodes the last two or three sextets of an unpadded or padded group.
+    size_t decodeTail(uint8_t const* _sextets, size_t _count, uint8_t* _output) noexcept
+    {
+        if (_count < 2)
+            return 0;
+
+        _output[0] = static_cast<uint8_t>(_sextets[0] << 2 | _sextets[1] >> 4);
+        if (_count < 3)
+            return 1;
+
+        _output[1] = static_cast<uint8_t>(_sextets[1] << 4 | _sextets[2] >> 2);
+        return 2;
+    }
+
+#if defined(CRISPY_BASE64_SSSE3)
+    // Vectorized base64 as described by Wojciech Muła and Daniel Lemire,
+    // "Faster Base64 Encoding and Decoding Using AVX2 Instructions".
+
+    /// Spreads 12 bytes in each 128-bit lane into 16 sextets, one per byte.
+    inline __m128i unpackSextets(__m128i _input) noexcept
+    {
+        auto const in = _mm_shuffle_epi8(_input, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        auto const t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+        auto const t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        auto const t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+        auto const t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        return _mm_or_si128(t1, t3);
+    }
+
+    /// Maps sextets to their characters, by adding the offset of the range each one falls into.
+    inline __m128i sextetsToChars(__m128i _sextets) noexcept
+    {
+        // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+        auto range = _mm_subs_epu8(_sextets, _mm_set1_epi8(51));
+        auto const upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), _sextets);
+        range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+        auto const offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                           '/' - 63, 'A', 0, 0);
+        return _mm_add_epi8(_mm_shuffle_epi8(offsets, range), _sextets);
+    }
+
+    /// Maps 16 characters to their sextets.
+    ///
+    /// @returns false if any of them is not part of the alphabet.
+    inline bool charsToSextets(__m128i _chars, __m128i& _sextets) noexcept
+    {
+        auto const higherNibble = _mm_and_si128(_mm_srli_epi32(_chars, 4), _mm_set1_epi8(0x0F));
+        auto const lowerNibble = _mm_and_si128(_chars, _mm_set1_epi8(0x0F));
+
+        // Each character is valid if the bit of its higher nibble is set in the mask of its lower nibble.
+        auto const masks = _mm_setr_epi8(char(0xA8), char(0xF8), char(0xF8), char(0xF8), char(0xF8), char(0xF8),
+                                         char(0xF8), char(0xF8), char(0xF8), char(0xF8), char(0xF0), char(0x54),
+                                         char(0x50), char(0x50), char(0x50), char(0x54));
+        auto const bits = _mm_setr_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, char(0x80),
+                                        0, 0, 0, 0, 0, 0, 0, 0);
+        auto const valid = _mm_and_si128(_mm_shuffle_epi8(masks, lowerNibble), _mm_shuffle_epi8(bits, higherNibble));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(valid, _mm_setzero_si128())) != 0)
+            return false;
+
+        // Offsets by higher nibble, except for '/', which shares its higher nibble with '+'.
+        auto const offsets = _mm_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        auto const slash = _mm_cmpeq_epi8(_chars, _mm_set1_epi8('/'));
+        auto const offset = _mm_or_si128(_mm_andnot_si128(slash, _mm_shuffle_epi8(offsets, higherNibble)),
+                                         _mm_and_si128(slash, _mm_set1_epi8(16)));
+        _sextets = _mm_add_epi8(_chars, offset);
+        return true;
+    }
+
+    /// Packs 16 sextets into 12 bytes, at the beginning of the lane.
+    inline __m128i packSextets(__m128i _sextets) noexcept
+    {
+        auto const pairs = _mm_maddubs_epi16(_sextets, _mm_set1_epi32(0x01400140));
+        auto const quads = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        return _mm_shuffle_epi8(quads, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    }
+#endif
+
+#if defined(CRISPY_BASE64_AVX2)
+    inline __m256i unpackSextets(__m256i _input) noexcept
+    {
+        auto const in = _mm256_shuffle_epi8(_input, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                                                     10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        auto const t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00));
+        auto const t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        auto const t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0));
+        auto const t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        return _mm256_or_si256(t1, t3);
+    }
+
+    inline __m256i sextetsToChars(__m256i _sextets) noexcept
+    {
+        auto range = _mm256_subs_epu8(_sextets, _mm256_set1_epi8(51));
+        auto const upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), _sextets);
+        range = _mm256_or_si256(range, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+        auto const offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                              '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                              '/' - 63, 'A', 0, 0,
+                                              'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                              '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                              '/' - 63, 'A', 0, 0);
+        return _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), _sextets);
+    }
+
+    inline bool charsToSextets(__m256i _chars, __m256i& _sextets) noexcept
+    {
+        auto const higherNibble = _mm256_and_si256(_mm256_srli_epi32(_chars, 4), _mm256_set1_epi8(0x0F));
+        auto const lowerNibble = _mm256_and_si256(_chars, _mm256_set1_epi8(0x0F));
+
+        auto const masks = _mm256_broadcastsi128_si256(
+            _mm_setr_epi8(char(0xA8), char(0xF8), char(0xF8), char(0xF8), char(0xF8), char(0xF8),
+                          char(0xF8), char(0xF8), char(0xF8), char(0xF8), char(0xF0), char(0x54),
+                          char(0x50), char(0x50), char(0x50), char(0x54)));
+        auto const bits = _mm256_broadcastsi128_si256(
+            _mm_setr_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, char(0x80), 0, 0, 0, 0, 0, 0, 0, 0));
+        auto const valid = _mm256_and_si256(_mm256_shuffle_epi8(masks, lowerNibble),
+                                            _mm256_shuffle_epi8(bits, higherNibble));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(valid, _mm256_setzero_si256())) != 0)
+            return false;
+
+        auto const offsets = _mm256_broadcastsi128_si256(
+            _mm_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0));
+        auto const slash = _mm256_cmpeq_epi8(_chars, _mm256_set1_epi8('/'));
+        auto const offset = _mm256_blendv_epi8(_mm256_shuffle_epi8(offsets, higherNibble),
+                                               _mm256_set1_epi8(16),
+                                               slash);
+        _sextets = _mm256_add_epi8(_chars, offset);
+        return true;
+    }
+
+    /// Packs 32 sextets into 24 bytes, at the beginning of the register.
+    inline __m256i packSextets(__m256i _sextets) noexcept
+    {
+        auto const pairs = _mm256_maddubs_epi16(_sextets, _mm256_set1_epi32(0x01400140));
+        auto const quads = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        auto const lanes = _mm256_shuffle_epi8(quads, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                                       2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        return _mm256_permutevar8x32_epi32(lanes, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1));
+    }
+#endif
+
+    /// Encodes complete groups of three bytes, @p _size being a multiple of three.
+    void encodeBlocks(uint8_t const* _input, size_t _size, char* _output) noexcept
+    {
+        auto input = _input;
+        auto const end = _input + _size;
+        auto output = _output;
+
+#if defined(CRISPY_BASE64_AVX2)
+        // Loads 16 bytes per lane, of which 12 are used.
+        while (end - input >= 28)
+        {
+            auto const lower = _mm_loadu_si128(reinterpret_cast<__m128i const*>(input));
+            auto const upper = _mm_loadu_si128(reinterpret_cast<__m128i const*>(input + 12));
+            auto const batch = _mm256_inserti128_si256(_mm256_castsi128_si256(lower), upper, 1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), sextetsToChars(unpackSextets(batch)));
+            input += 24;
+            output += 32;
+        }
+#endif
+
+#if defined(CRISPY_BASE64_SSSE3)
+        // Loads 16 bytes, of which 12 are used.
+        while (end - input >= 16)
+        {
+            auto const batch = _mm_loadu_si128(reinterpret_cast<__m128i const*>(input));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output), sextetsToChars(unpackSextets(batch)));
+            input += 12;
+            output += 16;
+        }
+#elif defined(CRISPY_BASE64_NEON)
+        uint8x16x4_t alphabet;
+        for (int i = 0; i < 4; ++i)
+            alphabet.val[i] = vld1q_u8(reinterpret_cast<uint8_t const*>(Alphabet) + 16 * i);
+
+        while (end - input >= 48)
+        {
+            auto const batch = vld3q_u8(input);
+            uint8x16x4_t chars;
+            chars.val[0] = vshrq_n_u8(batch.val[0], 2);
+            chars.val[1] = vorrq_u8(vshlq_n_u8(vandq_u8(batch.val[0], vdupq_n_u8(0x03)), 4),
+                                    vshrq_n_u8(batch.val[1], 4));
+            chars.val[2] = vorrq_u8(vshlq_n_u8(vandq_u8(batch.val[1], vdupq_n_u8(0x0F)), 2),
+                                    vshrq_n_u8(batch.val[2], 6));
+            chars.val[3] = vandq_u8(batch.val[2], vdupq_n_u8(0x3F));
+            for (int i = 0; i < 4; ++i)
+                chars.val[i] = vqtbl4q_u8(alphabet, chars.val[i]);
+            vst4q_u8(reinterpret_cast<uint8_t*>(output), chars);
+            input += 48;
+            output += 64;
+        }
+#endif
+
+        for (; input != end; input += 3, output += 4)
+            encodeGroup(input, output);
+    }
+
+    /// Decodes complete groups of four valid characters, up to the first invalid character.
+    ///
+    /// @returns the number of characters consumed and bytes written.
+    pair<size_t, size_t> decodeBlocks(char const* _input, size_t _size, uint8_t* _output) noexcept
+    {
+        auto input = _input;
+        auto const end = _input + _size;
+        auto output = _output;
+
+#if defined(CRISPY_BASE64_AVX2)
+        while (end - input >= 32)
+        {
+            auto sextets = __m256i{};
+            if (!charsToSextets(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(input)), sextets))
+                break;
+            auto const bytes = packSextets(sextets);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm256_castsi256_si128(bytes));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(output + 16), _mm256_extracti128_si256(bytes, 1));
+            input += 32;
+            output += 24;
+        }
+#endif
+
+#if defined(CRISPY_BASE64_SSSE3)
+        while (end - input >= 16)
+        {
+            auto sextets = __m128i{};
+            if (!charsToSextets(_mm_loadu_si128(reinterpret_cast<__m128i const*>(input)), sextets))
+                break;
+            auto const bytes = packSextets(sextets);
+            auto const last = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(bytes, 8)));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(output), bytes);
+            std::memcpy(output + 8, &last, sizeof(last));
+            input += 16;
+            output += 12;
+        }
+#elif defined(CRISPY_BASE64_NEON)
+        uint8x16x4_t lowerTable;
+        uint8x16x4_t upperTable;
+        for (int i = 0; i < 4; ++i)
+        {
+            lowerTable.val[i] = vld1q_u8(detail::indexmap + 16 * i);
+            upperTable.val[i] = vld1q_u8(detail::indexmap + 64 + 16 * i);
+        }
+
+        while (end - input >= 64)
+        {
+            auto const chars = vld4q_u8(reinterpret_cast<uint8_t const*>(input));
+            uint8x16x4_t sextets;
+            auto invalid = vdupq_n_u8(0);
+            for (int i = 0; i < 4; ++i)
+            {
+                // Characters 0..63 are looked up in the lower table, 64..127 in the upper one,
+                // whereas characters 128..255 are invalid.
+                sextets.val[i] = vqtbx4q_u8(vqtbl4q_u8(lowerTable, chars.val[i]),
+                                            upperTable,
+                                            vsubq_u8(chars.val[i], vdupq_n_u8(64)));
+                invalid = vorrq_u8(invalid, vorrq_u8(sextets.val[i], vandq_u8(chars.val[i], vdupq_n_u8(0x80))));
+            }
+            if (vmaxvq_u8(invalid) > 63)
+                break;
+
+            uint8x16x3_t bytes;
+            bytes.val[0] = vorrq_u8(vshlq_n_u8(sextets.val[0], 2), vshrq_n_u8(sextets.val[1], 4));
+            bytes.val[1] = vorrq_u8(vshlq_n_u8(sextets.val[1], 4), vshrq_n_u8(sextets.val[2], 2));
+            bytes.val[2] = vorrq_u8(vshlq_n_u8(sextets.val[2], 6), sextets.val[3]);
+            vst3q_u8(output, bytes);
+            input += 64;
+            output += 48;
+        }
+#endif
+
+        while (end - input >= 4)
+        {
+            uint8_t const sextets[4] = { sextet(input[0]), sextet(input[1]), sextet(input[2]), sextet(input[3]) };
+            if ((sextets[0] | sextets[1] | sextets[2] | sextets[3]) > 63)
+                break;
+            decodeGroup(sextets, output);
+            input += 4;
+            output += 3;
+        }
+
+        return { static_cast<size_t>(input - _input), static_cast<size_t>(output - _output) };
+    }
+} // }}}
+
+size_t encode(string_view _input, char* _output) noexcept
+{
+    auto const input = reinterpret_cast<uint8_t const*>(_input.data());
+    auto const blockSize = _input.size() / 3 * 3;
+    encodeBlocks(input, blockSize, _output);
+    auto const blockOutputSize = blockSize / 3 * 4;
+    return blockOutputSize + encodeTail(input + blockSize, _input.size() - blockSize, _output + blockOutputSize);
+}
+
+size_t decode(string_view _input, char* _output) noexcept
+{
+    auto output = reinterpret_cast<uint8_t*>(_output);
+    auto const [consumed, written] = decodeBlocks(_input.data(), _input.size(), output);
+
+    uint8_t sextets[3] = {};
+    auto count = size_t{0};
+    for (auto i = consumed; i < _input.size() && count < 3 && sextet(_input[i]) <= 63; ++i)
+        sextets[count++] = sextet(_input[i]);
+
+    return written + decodeTail(sextets, count, output + written);
+}
+
+// {{{ encoder
+size_t encoder::update(string_view _chunk, char* _output) noexcept
+{
+    auto input = reinterpret_cast<uint8_t const*>(_chunk.data());
+    auto const end = input + _chunk.size();
+    auto output = _output;
+
+    if (pendingCount_ != 0)
+    {
+        while (pendingCount_ < 3 && input != end)
+            pending_[pendingCount_++] = *input++;
+        if (pendingCount_ < 3)
+            return 0;
+        encodeGroup(pending_.data(), output);
+        output += 4;
+        pendingCount_ = 0;
+    }
+
+    auto const blockSize = static_cast<size_t>(end - input) / 3 * 3;
+    encodeBlocks(input, blockSize, output);
+    input += blockSize;
+    output += blockSize / 3 * 4;
+
+    while (input != end)
+        pending_[pendingCount_++] = *input++;
+
+    return static_cast<size_t>(output - _output);
+}
+
+size_t encoder::finish(char* _output) noexcept
+{
+    auto const n = encodeTail(pending_.data(), pendingCount_, _output);
+    pendingCount_ = 0;
+    return n;
+}
+// }}}
+
+// {{{ decoder
+size_t decoder::update(string_view _chunk, char* _output) noexcept
+{
+    if (finished_)
+        return 0;
+
+    auto input = _chunk.data();
+    auto const end = input + _chunk.size();
+    auto output = reinterpret_cast<uint8_t*>(_output);
+
+    // Takes the next characters into the pending group, until it is complete.
+    auto const fillPending = [&]() {
+        while (pendingCount_ < 4 && input != end)
+        {
+            auto const value = sextet(*input++);
+            if (value > 63)
+            {
+                finished_ = true;
+                return;
+            }
+            pending_[pendingCount_++] = value;
+        }
+    };
+
+    if (pendingCount_ != 0)
+    {
+        fillPending();
+        if (pendingCount_ < 4)
+            return 0;
+        decodeGroup(pending_.data(), output);
+        output += 3;
+        pendingCount_ = 0;
+    }
+
+    if (!finished_)
+    {
+        auto const [consumed, written] = decodeBlocks(input, static_cast<size_t>(end - input), output);
+        input += consumed;
+        output += written;
+
+        // Less than a group is left, or an invalid character is within the next group.
+        fillPending();
+    }
+
+    return static_cast<size_t>(output - reinterpret_cast<uint8_t*>(_output));
+}
+
+size_t decoder::finish(char* _output) noexcept
+{
+    auto const n = decodeTail(pending_.data(), pendingCount_, reinterpret_cast<uint8_t*>(_output));
+    pendingCount_ = 0;
+    finished_ = false;
+    return n;
+}
+// }}}
+
+} // end namespace
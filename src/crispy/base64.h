@@ -13,6 +13,9 @@
  */
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <string_view>
 
@@ -42,6 +45,69 @@ namespace detail
     };
 }
 
+// {{{ buffer based (vectorized) encoding and decoding
+/// @returns the number of characters @p _size bytes are encoded to, including padding.
+constexpr size_t encodedSize(size_t _size) noexcept { return (_size + 2) / 3 * 4; }
+
+/// @returns the maximum number of bytes @p _size characters are decoded to.
+constexpr size_t decodedSizeMax(size_t _size) noexcept { return (_size + 3) / 4 * 3; }
+
+/// Encodes @p _input into @p _output, which must have room for encodedSize(_input.size()) characters.
+///
+/// @returns the number of characters written.
+size_t encode(std::string_view _input, char* _output) noexcept;
+
+/// Decodes @p _input into @p _output, which must have room for decodedSizeMax(_input.size()) bytes.
+/// Decoding ends at the first padding or otherwise invalid character.
+///
+/// @returns the number of bytes written.
+size_t decode(std::string_view _input, char* _output) noexcept;
+
+/// Encodes input handed over in chunks of arbitrary size.
+class encoder {
+  public:
+    /// Encodes @p _chunk into @p _output, which must have room for encodedSize(_chunk.size())
+    /// characters. Up to two bytes are kept back, to be encoded along with the next chunk.
+    ///
+    /// @returns the number of characters written.
+    size_t update(std::string_view _chunk, char* _output) noexcept;
+
+    /// Encodes the bytes kept back, including padding, into @p _output (at most 4 characters),
+    /// and resets the encoder.
+    ///
+    /// @returns the number of characters written.
+    size_t finish(char* _output) noexcept;
+
+  private:
+    std::array<uint8_t, 3> pending_{};
+    size_t pendingCount_ = 0;
+};
+
+/// Decodes input handed over in chunks of arbitrary size.
+class decoder {
+  public:
+    /// Decodes @p _chunk into @p _output, which must have room for decodedSizeMax(_chunk.size()) bytes.
+    /// Up to three characters are kept back, to be decoded along with the next chunk.
+    /// Decoding ends at the first padding or otherwise invalid character, ignoring any input after.
+    ///
+    /// @returns the number of bytes written.
+    size_t update(std::string_view _chunk, char* _output) noexcept;
+
+    /// Decodes the characters kept back into @p _output (at most 2 bytes), and resets the decoder.
+    ///
+    /// @returns the number of bytes written.
+    size_t finish(char* _output) noexcept;
+
+    /// @returns whether the end of the encoded data has been reached.
+    bool finished() const noexcept { return finished_; }
+
+  private:
+    std::array<uint8_t, 4> pending_{};
+    size_t pendingCount_ = 0;
+    bool finished_ = false;
+};
+// }}}
+
 template <typename Iterator, typename Alphabet>
 std::string encode(Iterator begin, Iterator end, Alphabet alphabet)
 {
@@ -108,7 +174,10 @@ std::string encode(Iterator begin, Iterator end)
 
 inline std::string encode(const std::string_view& value)
 {
-    return encode(value.begin(), value.end());
+    std::string output;
+    output.resize(encodedSize(value.size()));
+    encode(value, output.data());
+    return output;
 }
 
 template <typename Iterator, typename IndexTable>
@@ -203,8 +272,8 @@ size_t decode(std::string_view const& input, Output output)
 inline std::string decode(const std::string_view& input)
 {
     std::string output;
-    output.resize(decodeLength(input));
-    output.resize(decode(input, &output[0]));
+    output.resize(decodedSizeMax(input.size()));
+    output.resize(decode(input, output.data()));
     return output;
 }
 
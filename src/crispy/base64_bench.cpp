@@ -0,0 +1,75 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/base64.h>
+#include <crispy/benchmark.h>
+
+#include <fmt/format.h>
+
+#include <string>
+#include <vector>
+
+using crispy::benchmark::do_not_optimize;
+using crispy::benchmark::random_bytes;
+using std::string;
+using std::vector;
+
+namespace
+{
+    auto constexpr InputSizes = { size_t{64}, size_t{4096}, size_t{1024 * 1024} };
+}
+
+CRISPY_BENCHMARK("base64.encode")
+{
+    for (size_t const size: InputSizes)
+    {
+        auto const input = random_bytes(_bench.rng(), size);
+        auto output = vector<char>(crispy::base64::encodedSize(size));
+        _bench.throughput(size);
+        _bench.measure(fmt::format("size={}", size), [&]() {
+            do_not_optimize(crispy::base64::encode(input, output.data()));
+        });
+    }
+}
+
+CRISPY_BENCHMARK("base64.decode")
+{
+    for (size_t const size: InputSizes)
+    {
+        auto const bytes = random_bytes(_bench.rng(), size);
+        auto input = string(crispy::base64::encodedSize(size), '\0');
+        input.resize(crispy::base64::encode(bytes, input.data()));
+        auto output = vector<char>(crispy::base64::decodedSizeMax(input.size()));
+        _bench.throughput(input.size());
+        _bench.measure(fmt::format("size={}", size), [&]() {
+            do_not_optimize(crispy::base64::decode(input, output.data()));
+        });
+    }
+}
+
+// Decodes the way image payloads arrive, in chunks of whatever size the PTY reads happen to have.
+CRISPY_BENCHMARK("base64.decoder.chunked")
+{
+    auto constexpr ChunkSize = size_t{4093};
+    auto const bytes = random_bytes(_bench.rng(), 1024 * 1024);
+    auto input = string(crispy::base64::encodedSize(bytes.size()), '\0');
+    input.resize(crispy::base64::encode(bytes, input.data()));
+    auto output = vector<char>(crispy::base64::decodedSizeMax(ChunkSize) + 2);
+    _bench.throughput(input.size());
+    _bench.measure(fmt::format("chunk={}", ChunkSize), [&]() {
+        auto decoder = crispy::base64::decoder{};
+        for (size_t offset = 0; offset < input.size(); offset += ChunkSize)
+            do_not_optimize(decoder.update(std::string_view(input).substr(offset, ChunkSize), output.data()));
+        do_not_optimize(decoder.finish(output.data()));
+    });
+}
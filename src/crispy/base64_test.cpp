@@ -14,7 +14,29 @@
 #include <crispy/base64.h>
 #include <catch2/catch.hpp>
 
+#include <random>
+#include <string>
+
 using namespace crispy;
+using std::string;
+
+namespace
+{
+    string randomBytes(size_t _size)
+    {
+        auto rng = std::mt19937{static_cast<unsigned>(_size)};
+        auto bytes = string(_size, '\0');
+        for (auto& byte: bytes)
+            byte = static_cast<char>(rng() & 0xFF);
+        return bytes;
+    }
+
+    /// Encodes with the iterator based implementation.
+    string referenceEncode(string const& _input)
+    {
+        return base64::encode(_input.begin(), _input.end());
+    }
+}
 
 TEST_CASE("base64.encode", "[base64]")
 {
@@ -33,3 +55,67 @@ TEST_CASE("base64.decode", "[base64]")
     CHECK("abcd" == base64::decode("YWJjZA=="));
     CHECK("foo:bar" == base64::decode("Zm9vOmJhcg=="));
 }
+
+TEST_CASE("base64.roundtrip", "[base64]")
+{
+    // Sizes around the vectorized block sizes, for the scalar tails to be covered as well.
+    for (size_t size = 0; size < 300; ++size)
+    {
+        auto const input = randomBytes(size);
+        auto const encoded = base64::encode(input);
+        INFO("size: " << size);
+        REQUIRE(encoded == referenceEncode(input));
+        REQUIRE(base64::decode(encoded) == input);
+    }
+}
+
+TEST_CASE("base64.decode.invalid", "[base64]")
+{
+    auto const encoded = base64::encode(randomBytes(120)); // 160 characters, no padding
+
+    // Decoding ends at the first invalid character, wherever it is.
+    for (size_t pos = 0; pos < encoded.size(); ++pos)
+    {
+        for (char const invalid: { '=', '\n', '-', '\xC3' })
+        {
+            auto input = encoded;
+            input[pos] = invalid;
+            INFO("position: " << pos << ", character: " << int(invalid));
+            REQUIRE(base64::decode(input) == base64::decode(encoded.substr(0, pos)));
+        }
+    }
+}
+
+TEST_CASE("base64.stream", "[base64]")
+{
+    auto const input = randomBytes(1000);
+    auto const expected = base64::encode(input);
+
+    for (size_t chunkSize: { 1, 2, 3, 4, 5, 7, 16, 31, 64, 100, 1000 })
+    {
+        INFO("chunk size: " << chunkSize);
+
+        auto encoder = base64::encoder{};
+        auto encoded = string{};
+        for (size_t i = 0; i < input.size(); i += chunkSize)
+        {
+            auto const chunk = std::string_view(input).substr(i, chunkSize);
+            auto buffer = string(base64::encodedSize(chunk.size()), '\0');
+            encoded.append(buffer.data(), encoder.update(chunk, buffer.data()));
+        }
+        char tail[4];
+        encoded.append(tail, encoder.finish(tail));
+        CHECK(encoded == expected);
+
+        auto decoder = base64::decoder{};
+        auto decoded = string{};
+        for (size_t i = 0; i < encoded.size(); i += chunkSize)
+        {
+            auto const chunk = std::string_view(encoded).substr(i, chunkSize);
+            auto buffer = string(base64::decodedSizeMax(chunk.size()), '\0');
+            decoded.append(buffer.data(), decoder.update(chunk, buffer.data()));
+        }
+        decoded.append(tail, decoder.finish(tail));
+        CHECK(decoded == input);
+    }
+}
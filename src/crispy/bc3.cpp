@@ -0,0 +1,349 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/bc3.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <tuple>
+#include <utility>
+
+namespace crispy::bc3 {
+
+namespace // {{{ helper
+{
+    constexpr int PixelCount = BlockSize * BlockSize;
+
+    /// The RGBA pixels of one block, row by row.
+    using Block = std::array<uint8_t, PixelCount * 4>;
+
+    struct Color {
+        int r = 0;
+        int g = 0;
+        int b = 0;
+    };
+
+    constexpr int distance(Color _a, Color _b) noexcept
+    {
+        return (_a.r - _b.r) * (_a.r - _b.r) + (_a.g - _b.g) * (_a.g - _b.g) + (_a.b - _b.b) * (_a.b - _b.b);
+    }
+
+    constexpr uint16_t pack565(Color _color) noexcept
+    {
+        return static_cast<uint16_t>(((_color.r * 31 + 127) / 255) << 11
+                                   | ((_color.g * 63 + 127) / 255) << 5
+                                   | ((_color.b * 31 + 127) / 255));
+    }
+
+    constexpr Color unpack565(uint16_t _value) noexcept
+    {
+        auto const r = (_value >> 11) & 0x1F;
+        auto const g = (_value >> 5) & 0x3F;
+        auto const b = _value & 0x1F;
+        return Color{ r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2 };
+    }
+
+    inline Color colorAt(Block const& _block, int _index) noexcept
+    {
+        return Color{ _block[_index * 4], _block[_index * 4 + 1], _block[_index * 4 + 2] };
+    }
+
+    /// @returns the colors indices 0 to 3 refer to, with the endpoints as the first two.
+    inline std::array<Color, 4> colorPalette(uint16_t _color0, uint16_t _color1) noexcept
+    {
+        auto const c0 = unpack565(_color0);
+        auto const c1 = unpack565(_color1);
+        return {
+            c0,
+            c1,
+            Color{ (2 * c0.r + c1.r) / 3, (2 * c0.g + c1.g) / 3, (2 * c0.b + c1.b) / 3 },
+            Color{ (c0.r + 2 * c1.r) / 3, (c0.g + 2 * c1.g) / 3, (c0.b + 2 * c1.b) / 3 },
+        };
+    }
+
+    /// @returns the alpha values indices 0 to 7 refer to, with the endpoints as the first two.
+    inline std::array<int, 8> alphaPalette(int _alpha0, int _alpha1) noexcept
+    {
+        auto palette = std::array<int, 8>{ _alpha0, _alpha1 };
+        if (_alpha0 > _alpha1)
+        {
+            for (int i = 1; i < 7; ++i)
+                palette[i + 1] = ((7 - i) * _alpha0 + i * _alpha1) / 7;
+        }
+        else
+        {
+            for (int i = 1; i < 5; ++i)
+                palette[i + 1] = ((5 - i) * _alpha0 + i * _alpha1) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+        return palette;
+    }
+
+    void encodeAlpha(Block const& _block, uint8_t* _output) noexcept
+    {
+        auto minAlpha = 255;
+        auto maxAlpha = 0;
+        for (int i = 0; i < PixelCount; ++i)
+        {
+            minAlpha = std::min(minAlpha, int(_block[i * 4 + 3]));
+            maxAlpha = std::max(maxAlpha, int(_block[i * 4 + 3]));
+        }
+
+        _output[0] = static_cast<uint8_t>(maxAlpha);
+        _output[1] = static_cast<uint8_t>(minAlpha);
+
+        // Uniform alpha is represented by the first endpoint exactly, which all indices default to.
+        uint64_t indices = 0;
+        if (minAlpha != maxAlpha)
+        {
+            auto const palette = alphaPalette(maxAlpha, minAlpha);
+            for (int i = 0; i < PixelCount; ++i)
+            {
+                auto const alpha = int(_block[i * 4 + 3]);
+                auto best = 0;
+                for (int k = 1; k < 8; ++k)
+                    if (std::abs(palette[k] - alpha) < std::abs(palette[best] - alpha))
+                        best = k;
+                indices |= uint64_t(best) << (3 * i);
+            }
+        }
+
+        for (int i = 0; i < 6; ++i)
+            _output[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+    }
+
+    /// @returns the principal axis of the block's colors, or a zero vector if they are all the same.
+    std::array<float, 3> principalAxis(Block const& _block) noexcept
+    {
+        auto mean = std::array<float, 3>{};
+        auto minimum = std::array<int, 3>{ 255, 255, 255 };
+        auto maximum = std::array<int, 3>{};
+        for (int i = 0; i < PixelCount; ++i)
+            for (int c = 0; c < 3; ++c)
+            {
+                mean[c] += _block[i * 4 + c];
+                minimum[c] = std::min(minimum[c], int(_block[i * 4 + c]));
+                maximum[c] = std::max(maximum[c], int(_block[i * 4 + c]));
+            }
+        for (auto& m: mean)
+            m /= PixelCount;
+
+        auto covariance = std::array<std::array<float, 3>, 3>{};
+        for (int i = 0; i < PixelCount; ++i)
+            for (int a = 0; a < 3; ++a)
+                for (int b = 0; b < 3; ++b)
+                    covariance[a][b] += (_block[i * 4 + a] - mean[a]) * (_block[i * 4 + b] - mean[b]);
+
+        // Power iteration, starting off the bounding box's diagonal.
+        auto axis = std::array<float, 3>{ float(maximum[0] - minimum[0]),
+                                          float(maximum[1] - minimum[1]),
+                                          float(maximum[2] - minimum[2]) };
+        for (int iteration = 0; iteration < 4; ++iteration)
+        {
+            auto next = std::array<float, 3>{};
+            for (int a = 0; a < 3; ++a)
+                for (int b = 0; b < 3; ++b)
+                    next[a] += covariance[a][b] * axis[b];
+            auto const length = std::max({ std::abs(next[0]), std::abs(next[1]), std::abs(next[2]) });
+            if (length < std::numeric_limits<float>::epsilon())
+                break;
+            for (int c = 0; c < 3; ++c)
+                axis[c] = next[c] / length;
+        }
+        return axis;
+    }
+
+    /// @returns the indices of the colors closest to the block's pixels, and their squared error in total.
+    std::pair<uint32_t, int> colorIndices(Block const& _block, uint16_t _color0, uint16_t _color1) noexcept
+    {
+        auto const palette = colorPalette(_color0, _color1);
+        uint32_t indices = 0;
+        auto error = 0;
+        for (int i = 0; i < PixelCount; ++i)
+        {
+            auto const color = colorAt(_block, i);
+            auto best = 0;
+            auto bestDistance = distance(palette[0], color);
+            for (int k = 1; k < 4; ++k)
+                if (auto const d = distance(palette[k], color); d < bestDistance)
+                {
+                    best = k;
+                    bestDistance = d;
+                }
+            indices |= uint32_t(best) << (2 * i);
+            error += bestDistance;
+        }
+        return { indices, error };
+    }
+
+    /// @returns the endpoints that approximate the block's pixels best with the given indices,
+    ///          or std::nullopt if the indices do not determine them (e.g. all being the same).
+    std::optional<std::pair<uint16_t, uint16_t>> refineEndpoints(Block const& _block, uint32_t _indices) noexcept
+    {
+        // Weight of the first endpoint in the color of each index.
+        constexpr auto Weights = std::array<float, 4>{ 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+        auto aa = 0.0f;
+        auto bb = 0.0f;
+        auto ab = 0.0f;
+        auto ax = std::array<float, 3>{};
+        auto bx = std::array<float, 3>{};
+        for (int i = 0; i < PixelCount; ++i)
+        {
+            auto const a = Weights[(_indices >> (2 * i)) & 0x03];
+            auto const b = 1.0f - a;
+            aa += a * a;
+            bb += b * b;
+            ab += a * b;
+            for (int c = 0; c < 3; ++c)
+            {
+                ax[c] += a * _block[i * 4 + c];
+                bx[c] += b * _block[i * 4 + c];
+            }
+        }
+
+        auto const determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f)
+            return std::nullopt;
+
+        auto const channel = [](float _value) { return static_cast<int>(std::clamp(_value, 0.0f, 255.0f) + 0.5f); };
+        auto const endpoint = [&](std::array<float, 3> const& _own, std::array<float, 3> const& _other, float _ownWeight) {
+            auto const value = [&](int c) { return channel((_ownWeight * _own[c] - ab * _other[c]) / determinant); };
+            return Color{ value(0), value(1), value(2) };
+        };
+        auto const endpoint0 = endpoint(ax, bx, bb);
+        auto const endpoint1 = endpoint(bx, ax, aa);
+        return std::pair{ pack565(endpoint0), pack565(endpoint1) };
+    }
+
+    void encodeColor(Block const& _block, uint8_t* _output) noexcept
+    {
+        // The endpoints are the colors furthest apart along the principal axis.
+        auto const axis = principalAxis(_block);
+        auto minIndex = 0;
+        auto maxIndex = 0;
+        auto minProjection = std::numeric_limits<float>::max();
+        auto maxProjection = std::numeric_limits<float>::lowest();
+        for (int i = 0; i < PixelCount; ++i)
+        {
+            auto const projection = _block[i * 4] * axis[0] + _block[i * 4 + 1] * axis[1] + _block[i * 4 + 2] * axis[2];
+            if (projection < minProjection)
+            {
+                minProjection = projection;
+                minIndex = i;
+            }
+            if (projection > maxProjection)
+            {
+                maxProjection = projection;
+                maxIndex = i;
+            }
+        }
+
+        auto color0 = pack565(colorAt(_block, maxIndex));
+        auto color1 = pack565(colorAt(_block, minIndex));
+        auto [indices, error] = colorIndices(_block, color0, color1);
+
+        // Refines the endpoints once, to those fitting the chosen indices best (in the least squares sense).
+        if (auto const refined = refineEndpoints(_block, indices); refined.has_value())
+        {
+            auto const [refinedIndices, refinedError] = colorIndices(_block, refined->first, refined->second);
+            if (refinedError < error)
+            {
+                std::tie(color0, color1) = *refined;
+                indices = refinedIndices;
+            }
+        }
+
+        // The first endpoint being the larger one selects interpolating in 4 steps,
+        // which BC3 always does, yet some decoders do not.
+        if (color0 < color1)
+        {
+            std::swap(color0, color1);
+            indices ^= 0x55555555; // swaps indices 0 and 1, as well as 2 and 3
+        }
+        else if (color0 == color1)
+            indices = 0;
+
+        _output[0] = static_cast<uint8_t>(color0);
+        _output[1] = static_cast<uint8_t>(color0 >> 8);
+        _output[2] = static_cast<uint8_t>(color1);
+        _output[3] = static_cast<uint8_t>(color1 >> 8);
+        for (int i = 0; i < 4; ++i)
+            _output[4 + i] = static_cast<uint8_t>(indices >> (8 * i));
+    }
+} // }}}
+
+void encode(uint8_t const* _input, int _width, int _height, uint8_t* _output) noexcept
+{
+    for (int blockY = 0; blockY < _height; blockY += BlockSize)
+    {
+        for (int blockX = 0; blockX < _width; blockX += BlockSize)
+        {
+            auto block = Block{};
+            auto const columns = std::min(BlockSize, _width - blockX);
+            auto const rows = std::min(BlockSize, _height - blockY);
+            for (int y = 0; y < rows; ++y)
+            {
+                auto const row = _input + (static_cast<size_t>(blockY + y) * static_cast<size_t>(_width) + static_cast<size_t>(blockX)) * 4;
+                std::copy(row, row + columns * 4, block.data() + y * BlockSize * 4);
+            }
+
+            encodeAlpha(block, _output);
+            encodeColor(block, _output + 8);
+            _output += BlockBytes;
+        }
+    }
+}
+
+void decode(uint8_t const* _input, int _width, int _height, uint8_t* _output) noexcept
+{
+    for (int blockY = 0; blockY < _height; blockY += BlockSize)
+    {
+        for (int blockX = 0; blockX < _width; blockX += BlockSize)
+        {
+            auto const alphas = alphaPalette(_input[0], _input[1]);
+            uint64_t alphaIndices = 0;
+            for (int i = 0; i < 6; ++i)
+                alphaIndices |= uint64_t(_input[2 + i]) << (8 * i);
+
+            auto const colors = colorPalette(static_cast<uint16_t>(_input[8] | _input[9] << 8),
+                                             static_cast<uint16_t>(_input[10] | _input[11] << 8));
+            uint32_t colorIndices = 0;
+            for (int i = 0; i < 4; ++i)
+                colorIndices |= uint32_t(_input[12 + i]) << (8 * i);
+
+            auto const columns = std::min(BlockSize, _width - blockX);
+            auto const rows = std::min(BlockSize, _height - blockY);
+            for (int y = 0; y < rows; ++y)
+            {
+                for (int x = 0; x < columns; ++x)
+                {
+                    auto const i = y * BlockSize + x;
+                    auto const color = colors[(colorIndices >> (2 * i)) & 0x03];
+                    auto pixel = _output + (static_cast<size_t>(blockY + y) * static_cast<size_t>(_width) + static_cast<size_t>(blockX + x)) * 4;
+                    pixel[0] = static_cast<uint8_t>(color.r);
+                    pixel[1] = static_cast<uint8_t>(color.g);
+                    pixel[2] = static_cast<uint8_t>(color.b);
+                    pixel[3] = static_cast<uint8_t>(alphas[(alphaIndices >> (3 * i)) & 0x07]);
+                }
+            }
+            _input += BlockBytes;
+        }
+    }
+}
+
+} // end namespace
@@ -0,0 +1,57 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// Lossy compression of RGBA pixels into BC3 blocks (also known as DXT5, see the
+/// EXT_texture_compression_s3tc OpenGL extension), which GPUs sample from directly.
+///
+/// Each block of 4x4 pixels is encoded to 16 bytes, i.e. a quarter of its RGBA size:
+/// the alpha values are interpolated between two 8 bit endpoints in 8 steps,
+/// the colors between two RGB565 endpoints in 4 steps.
+///
+/// The encoder aims to be fast enough to compress glyphs as they are rasterized,
+/// picking the color endpoints along the principal axis of each block's colors.
+namespace crispy::bc3 {
+
+/// Number of pixels per row and column of a block.
+constexpr int BlockSize = 4;
+
+/// Number of bytes each block is encoded to.
+constexpr size_t BlockBytes = 16;
+
+/// @returns @p _pixels rounded up to a multiple of BlockSize.
+constexpr int blockAligned(int _pixels) noexcept { return (_pixels + BlockSize - 1) / BlockSize * BlockSize; }
+
+/// @returns the number of bytes an image of the given size in pixels is encoded to.
+constexpr size_t encodedSize(int _width, int _height) noexcept
+{
+    return static_cast<size_t>(blockAligned(_width) / BlockSize)
+         * static_cast<size_t>(blockAligned(_height) / BlockSize)
+         * BlockBytes;
+}
+
+/// Encodes the @p _width x @p _height RGBA pixels at @p _input, stored row by row,
+/// into @p _output, which must have room for encodedSize(_width, _height) bytes.
+///
+/// Blocks reaching beyond the image are padded with transparent black pixels.
+void encode(uint8_t const* _input, int _width, int _height, uint8_t* _output) noexcept;
+
+/// Decodes the blocks at @p _input of an image of given size into its RGBA pixels at @p _output,
+/// which must have room for @p _width x @p _height pixels.
+void decode(uint8_t const* _input, int _width, int _height, uint8_t* _output) noexcept;
+
+} // end namespace
@@ -0,0 +1,107 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/bc3.h>
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using std::vector;
+
+namespace
+{
+    vector<uint8_t> roundtrip(vector<uint8_t> const& _pixels, int _width, int _height)
+    {
+        auto encoded = vector<uint8_t>(crispy::bc3::encodedSize(_width, _height));
+        crispy::bc3::encode(_pixels.data(), _width, _height, encoded.data());
+        auto decoded = vector<uint8_t>(_pixels.size());
+        crispy::bc3::decode(encoded.data(), _width, _height, decoded.data());
+        return decoded;
+    }
+
+    /// @returns the largest difference of any channel of any pixel.
+    int maxError(vector<uint8_t> const& _a, vector<uint8_t> const& _b)
+    {
+        auto error = 0;
+        for (size_t i = 0; i < _a.size(); ++i)
+            error = std::max(error, std::abs(int(_a[i]) - int(_b[i])));
+        return error;
+    }
+
+    /// @returns the average difference of the channels of all pixels.
+    double meanError(vector<uint8_t> const& _a, vector<uint8_t> const& _b)
+    {
+        auto error = 0.0;
+        for (size_t i = 0; i < _a.size(); ++i)
+            error += std::abs(int(_a[i]) - int(_b[i]));
+        return error / double(_a.size());
+    }
+}
+
+TEST_CASE("bc3.encodedSize")
+{
+    CHECK(crispy::bc3::encodedSize(1, 1) == 16);
+    CHECK(crispy::bc3::encodedSize(4, 4) == 16);
+    CHECK(crispy::bc3::encodedSize(5, 4) == 32);
+    CHECK(crispy::bc3::encodedSize(16, 9) == 4 * 3 * 16);
+    CHECK(crispy::bc3::blockAligned(13) == 16);
+}
+
+TEST_CASE("bc3.uniform")
+{
+    // Colors representable in RGB565 survive exactly, as does uniform alpha.
+    auto pixels = vector<uint8_t>();
+    for (int i = 0; i < 8 * 4; ++i)
+    {
+        auto const left = (i % 8) < 4;
+        pixels.insert(pixels.end(), { uint8_t(left ? 255 : 0), uint8_t(left ? 0 : 255), 0, uint8_t(left ? 255 : 128) });
+    }
+    CHECK(roundtrip(pixels, 8, 4) == pixels);
+}
+
+TEST_CASE("bc3.gradient")
+{
+    auto constexpr Width = 32;
+    auto constexpr Height = 32;
+    auto pixels = vector<uint8_t>();
+    for (int y = 0; y < Height; ++y)
+        for (int x = 0; x < Width; ++x)
+            pixels.insert(pixels.end(), { uint8_t(x * 8), uint8_t(y * 8), uint8_t(255 - x * 4), uint8_t(x * y / 4) });
+
+    // Colors varying in two directions within a block do not fit onto a single line
+    // between the endpoints, and thus lose the most.
+    auto const decoded = roundtrip(pixels, Width, Height);
+    CHECK(maxError(pixels, decoded) <= 24);
+    CHECK(meanError(pixels, decoded) < 4.0);
+}
+
+TEST_CASE("bc3.padding")
+{
+    // An image smaller than a block, padded with transparent pixels.
+    auto const pixels = vector<uint8_t>(3 * 2 * 4, 0xFF);
+    auto encoded = vector<uint8_t>(crispy::bc3::encodedSize(3, 2));
+    crispy::bc3::encode(pixels.data(), 3, 2, encoded.data());
+
+    auto block = vector<uint8_t>(4 * 4 * 4);
+    crispy::bc3::decode(encoded.data(), 4, 4, block.data());
+    for (int y = 0; y < 4; ++y)
+        for (int x = 0; x < 4; ++x)
+        {
+            auto const pixel = &block[static_cast<size_t>(y * 4 + x) * 4];
+            auto const inside = x < 3 && y < 2;
+            CHECK(vector<uint8_t>(pixel, pixel + 4) == (inside ? vector<uint8_t>(4, 0xFF) : vector<uint8_t>(4, 0)));
+        }
+}
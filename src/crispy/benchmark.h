@@ -0,0 +1,339 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// Minimal micro benchmark harness, reporting its results as JSON.
+///
+/// Benchmarks are defined alongside the unit tests, in *_bench.cpp files:
+///
+///     CRISPY_BENCHMARK("base64.encode")
+///     {
+///         auto const input = crispy::benchmark::random_bytes(_bench.rng(), 4096);
+///         _bench.throughput(input.size());
+///         _bench.measure("size=4096", [&]() { ... });
+///     }
+///
+/// and exactly one translation unit of the benchmark executable defines CRISPY_BENCHMARK_MAIN
+/// before including this header, much like CATCH_CONFIG_MAIN.
+///
+/// Each measurement is run in batches of as many iterations as needed to take at least
+/// the minimum batch time, the first batch of which also warms up caches and allocations.
+/// Random input is to be drawn from rng(), which is seeded the same for each benchmark,
+/// so that runs are comparable.
+namespace crispy::benchmark {
+
+using clock = std::chrono::steady_clock;
+
+/// Keeps the compiler from optimizing away the computation of @p _value.
+template <typename T>
+inline void do_not_optimize(T const& _value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(_value) : "memory");
+#else
+    auto volatile sink = &_value;
+    (void) sink;
+#endif
+}
+
+struct options {
+    std::vector<std::string> filters;   // runs only benchmarks containing any of these, all if empty
+    unsigned samples = 10;              // number of batches measured per benchmark
+    std::chrono::milliseconds min_batch_time{10};
+    std::mt19937::result_type seed = 42;
+};
+
+struct result {
+    std::string name;
+    uint64_t iterations;                // per batch
+    std::vector<double> samples;        // nanoseconds per iteration, one per batch
+    size_t bytes_per_iteration;
+};
+
+/// Handed to each benchmark, to measure one or more variants of it.
+class context {
+  public:
+    context(std::string _name, options const& _options, std::function<void(result const&)> _report):
+        name_{ std::move(_name) },
+        options_{ _options },
+        rng_{ _options.seed },
+        report_{ std::move(_report) }
+    {}
+
+    /// The random number generator benchmark input is to be created from, seeded the same each run.
+    std::mt19937& rng() noexcept { return rng_; }
+
+    /// Sets the number of bytes processed per iteration by the next measurement,
+    /// to have its throughput reported.
+    void throughput(size_t _bytesPerIteration) noexcept { bytesPerIteration_ = _bytesPerIteration; }
+
+    /// @returns whether @p _variant of this benchmark is to be measured at all,
+    ///          allowing to skip the setup of those filtered out.
+    bool selected(std::string_view _variant) const { return selectedName(nameOf(_variant)); }
+
+    /// Measures @p _fn, reporting it as @p _variant of this benchmark, such as "history=1000".
+    template <typename F>
+    void measure(std::string_view _variant, F&& _fn)
+    {
+        auto const name = nameOf(_variant);
+        if (!selectedName(name))
+        {
+            bytesPerIteration_ = 0;
+            return;
+        }
+
+        auto const minBatchTime = std::chrono::duration<double>(options_.min_batch_time).count();
+
+        // Calibrates the batch size, warming up along the way.
+        uint64_t iterations = 1;
+        for (;;)
+        {
+            auto const elapsed = run(_fn, iterations);
+            if (elapsed >= minBatchTime || iterations >= MaxIterations)
+                break;
+            auto const factor = elapsed > 0 ? std::min(10.0, 1.2 * minBatchTime / elapsed) : 10.0;
+            iterations = std::min(MaxIterations,
+                                  std::max(iterations + 1, static_cast<uint64_t>(double(iterations) * factor)));
+        }
+
+        auto r = result{ name, iterations, {}, bytesPerIteration_ };
+        r.samples.reserve(options_.samples);
+        for (unsigned i = 0; i < options_.samples; ++i)
+            r.samples.push_back(run(_fn, iterations) * 1e9 / double(iterations));
+
+        bytesPerIteration_ = 0;
+        report_(r);
+    }
+
+    /// Measures @p _fn as this benchmark itself, i.e. without any variant name.
+    template <typename F>
+    void measure(F&& _fn)
+    {
+        measure(std::string_view{}, std::forward<F>(_fn));
+    }
+
+  private:
+    static constexpr uint64_t MaxIterations = 1'000'000'000;
+
+    template <typename F>
+    static double run(F& _fn, uint64_t _iterations)
+    {
+        auto const start = clock::now();
+        for (uint64_t i = 0; i < _iterations; ++i)
+            _fn();
+        return std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    std::string nameOf(std::string_view _variant) const
+    {
+        return _variant.empty() ? name_ : fmt::format("{}/{}", name_, _variant);
+    }
+
+    bool selectedName(std::string const& _name) const
+    {
+        if (options_.filters.empty())
+            return true;
+        return std::any_of(options_.filters.begin(), options_.filters.end(), [&](auto const& _filter) {
+            return _name.find(_filter) != std::string::npos;
+        });
+    }
+
+    std::string name_;
+    options const& options_;
+    std::mt19937 rng_;
+    std::function<void(result const&)> report_;
+    size_t bytesPerIteration_ = 0;
+};
+
+using benchmark_function = void(*)(context&);
+
+inline std::vector<std::pair<std::string, benchmark_function>>& registry()
+{
+    static std::vector<std::pair<std::string, benchmark_function>> benchmarks;
+    return benchmarks;
+}
+
+struct registration {
+    registration(std::string _name, benchmark_function _fn)
+    {
+        registry().emplace_back(std::move(_name), _fn);
+    }
+};
+
+/// @returns @p _count random bytes.
+inline std::string random_bytes(std::mt19937& _rng, size_t _count)
+{
+    auto dist = std::uniform_int_distribution<int>(0, 255);
+    auto bytes = std::string(_count, '\0');
+    for (char& byte: bytes)
+        byte = static_cast<char>(dist(_rng));
+    return bytes;
+}
+
+/// @returns @p _count random printable US-ASCII characters, with spaces in between words.
+inline std::string random_text(std::mt19937& _rng, size_t _count)
+{
+    auto letter = std::uniform_int_distribution<int>('!', '~');
+    auto wordLength = std::uniform_int_distribution<int>(1, 10);
+    auto text = std::string();
+    text.reserve(_count);
+    while (text.size() < _count)
+    {
+        for (auto n = wordLength(_rng); n > 0 && text.size() < _count; --n)
+            text.push_back(static_cast<char>(letter(_rng)));
+        if (text.size() < _count)
+            text.push_back(' ');
+    }
+    return text;
+}
+
+namespace detail
+{
+    inline std::string json_escape(std::string_view _text)
+    {
+        auto escaped = std::string();
+        for (char const ch: _text)
+        {
+            if (ch == '"' || ch == '\\')
+                escaped.push_back('\\');
+            escaped.push_back(ch);
+        }
+        return escaped;
+    }
+
+    inline std::string to_json(result const& _result)
+    {
+        auto sorted = _result.samples;
+        std::sort(sorted.begin(), sorted.end());
+        auto const count = double(sorted.size());
+        auto const mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / count;
+        auto const median = sorted.size() % 2
+                          ? sorted[sorted.size() / 2]
+                          : (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]) / 2;
+        auto variance = 0.0;
+        for (double const sample: sorted)
+            variance += (sample - mean) * (sample - mean);
+        auto const stddev = std::sqrt(variance / count);
+
+        auto json = fmt::format(
+            "    {{\"name\": \"{}\", \"iterations\": {}, \"samples\": {}, "
+            "\"ns_per_iteration\": {{\"min\": {:.2f}, \"median\": {:.2f}, \"mean\": {:.2f}, \"max\": {:.2f}, \"stddev\": {:.2f}}}",
+            json_escape(_result.name),
+            _result.iterations,
+            sorted.size(),
+            sorted.front(),
+            median,
+            mean,
+            sorted.back(),
+            stddev);
+        if (_result.bytes_per_iteration)
+            json += fmt::format(", \"bytes_per_second\": {:.0f}",
+                                double(_result.bytes_per_iteration) * 1e9 / median);
+        json += "}";
+        return json;
+    }
+}
+
+/// Runs the registered benchmarks selected by @p _options, writing their results to stdout as JSON.
+inline int run(options const& _options)
+{
+    auto first = true;
+    auto const report = [&](result const& _result) {
+        std::fputs(first ? "\n" : ",\n", stdout);
+        std::fputs(detail::to_json(_result).c_str(), stdout);
+        std::fflush(stdout);
+        first = false;
+    };
+
+    std::fputs(fmt::format("{{\n  \"seed\": {},\n  \"samples\": {},\n  \"min_batch_time_ms\": {},\n  \"benchmarks\": [",
+                           _options.seed,
+                           _options.samples,
+                           _options.min_batch_time.count()).c_str(),
+               stdout);
+
+    for (auto const& [name, fn]: registry())
+    {
+        auto bench = context(name, _options, report);
+        fn(bench);
+    }
+
+    std::fputs("\n  ]\n}\n", stdout);
+    return EXIT_SUCCESS;
+}
+
+/// Parses the command line into @p _options.
+///
+/// Usage: [--samples N] [--min-batch-time MS] [--seed N] [FILTER ...]
+///
+/// @returns whether the command line was valid.
+inline bool parse(int argc, char const* argv[], options& _options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        auto const arg = std::string_view(argv[i]);
+        auto const hasValue = i + 1 < argc;
+        if (arg == "--samples" && hasValue)
+            _options.samples = std::max(1u, static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10)));
+        else if (arg == "--min-batch-time" && hasValue)
+            _options.min_batch_time = std::chrono::milliseconds(std::strtoul(argv[++i], nullptr, 10));
+        else if (arg == "--seed" && hasValue)
+            _options.seed = static_cast<std::mt19937::result_type>(std::strtoul(argv[++i], nullptr, 10));
+        else if (arg.substr(0, 2) == "--")
+            return false;
+        else
+            _options.filters.emplace_back(arg);
+    }
+    return true;
+}
+
+} // end namespace
+
+#define CRISPY_BENCHMARK_CONCAT_(a, b) a##b
+#define CRISPY_BENCHMARK_CONCAT(a, b) CRISPY_BENCHMARK_CONCAT_(a, b)
+
+/// Defines a benchmark named @p _name, with its body having a crispy::benchmark::context named _bench.
+#define CRISPY_BENCHMARK(_name)                                                                      \
+    static void CRISPY_BENCHMARK_CONCAT(crispy_benchmark_, __LINE__)(crispy::benchmark::context&);  \
+    static crispy::benchmark::registration const CRISPY_BENCHMARK_CONCAT(crispy_benchmark_registration_, __LINE__) \
+        { (_name), &CRISPY_BENCHMARK_CONCAT(crispy_benchmark_, __LINE__) };                          \
+    static void CRISPY_BENCHMARK_CONCAT(crispy_benchmark_, __LINE__)([[maybe_unused]] crispy::benchmark::context& _bench)
+
+#if defined(CRISPY_BENCHMARK_MAIN)
+int main(int argc, char const* argv[])
+{
+    auto options = crispy::benchmark::options{};
+    if (!crispy::benchmark::parse(argc, argv, options))
+    {
+        std::fprintf(stderr, "Usage: %s [--samples N] [--min-batch-time MS] [--seed N] [FILTER ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    return crispy::benchmark::run(options);
+}
+#endif
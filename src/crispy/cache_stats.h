@@ -0,0 +1,203 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <crispy/latency_histogram.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace crispy {
+
+/// Effectiveness of a cache: how often lookups found what they were looking for,
+/// how much it holds, and how long it took to fill in what was missing.
+struct cache_stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t insertions = 0;
+    uint64_t evictions = 0;                     // entries dropped, to make room or as no longer needed
+    size_t bytes = 0;                           // held by the cached entries
+
+    // Time it took to fill in a miss, where measured, or zero.
+    latency_histogram::duration miss_latency_p50{};
+    latency_histogram::duration miss_latency_p99{};
+
+    uint64_t lookups() const noexcept { return hits + misses; }
+
+    double hit_rate() const noexcept
+    {
+        return lookups() ? static_cast<double>(hits) / static_cast<double>(lookups()) : 0.0;
+    }
+
+    /// Takes the miss latencies from @p _histogram, which records the time each miss took to be filled in.
+    cache_stats& with_miss_latency(latency_histogram const& _histogram) noexcept
+    {
+        miss_latency_p50 = _histogram.percentile(50);
+        miss_latency_p99 = _histogram.percentile(99);
+        return *this;
+    }
+
+    /// Adds up with @p _other, such as a cache kept per font, keeping the larger of the miss latencies.
+    cache_stats& operator+=(cache_stats const& _other) noexcept
+    {
+        hits += _other.hits;
+        misses += _other.misses;
+        insertions += _other.insertions;
+        evictions += _other.evictions;
+        bytes += _other.bytes;
+        miss_latency_p50 = std::max(miss_latency_p50, _other.miss_latency_p50);
+        miss_latency_p99 = std::max(miss_latency_p99, _other.miss_latency_p99);
+        return *this;
+    }
+
+    std::string json() const
+    {
+        return fmt::format("{{\"hits\": {}, \"misses\": {}, \"hit_rate\": {:.4f}, \"insertions\": {}, "
+                           "\"evictions\": {}, \"bytes\": {}, \"miss_p50_us\": {}, \"miss_p99_us\": {}}}",
+                           hits,
+                           misses,
+                           hit_rate(),
+                           insertions,
+                           evictions,
+                           bytes,
+                           miss_latency_p50.count(),
+                           miss_latency_p99.count());
+    }
+};
+
+/// Counts the lookups, insertions and evictions of a cache, for cache_stats.
+///
+/// Counting is lock-free and may happen from any number of threads,
+/// such as for caches shared by the render thread and its workers.
+class cache_counters {
+  public:
+    cache_counters() = default;
+    cache_counters(cache_counters const&) = delete;
+    cache_counters& operator=(cache_counters const&) = delete;
+
+    void hit() noexcept { hits_.fetch_add(1, std::memory_order_relaxed); }
+    void miss() noexcept { misses_.fetch_add(1, std::memory_order_relaxed); }
+
+    /// Counts a miss that took @p _latency to be filled in.
+    void miss(std::chrono::steady_clock::duration _latency) noexcept
+    {
+        miss();
+        missLatency_.record(_latency);
+    }
+
+    void insert(uint64_t _count = 1) noexcept { insertions_.fetch_add(_count, std::memory_order_relaxed); }
+    void evict(uint64_t _count = 1) noexcept { evictions_.fetch_add(_count, std::memory_order_relaxed); }
+
+    /// @returns the counts so far, along with the @p _bytes the cache holds.
+    cache_stats stats(size_t _bytes) const noexcept
+    {
+        auto stats = cache_stats{};
+        stats.hits = hits_.load(std::memory_order_relaxed);
+        stats.misses = misses_.load(std::memory_order_relaxed);
+        stats.insertions = insertions_.load(std::memory_order_relaxed);
+        stats.evictions = evictions_.load(std::memory_order_relaxed);
+        stats.bytes = _bytes;
+        return stats.with_miss_latency(missLatency_);
+    }
+
+  private:
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+    std::atomic<uint64_t> insertions_ = 0;
+    std::atomic<uint64_t> evictions_ = 0;
+    latency_histogram missLatency_;
+};
+
+/// Effectiveness of caches, by name, for sizing them by how well they do.
+///
+/// Caches are named hierarchically with dots, such as "shaper.glyphs",
+/// and reported in the order they were first added.
+class cache_statistics {
+  public:
+    struct entry {
+        std::string name;
+        cache_stats stats;
+    };
+
+    /// Reports @p _stats for the given cache, adding up with what was reported for it before.
+    void add(std::string_view _name, cache_stats const& _stats)
+    {
+        for (auto& e: entries_)
+            if (e.name == _name)
+            {
+                e.stats += _stats;
+                return;
+            }
+        entries_.push_back(entry{std::string(_name), _stats});
+    }
+
+    std::vector<entry> const& entries() const noexcept { return entries_; }
+
+    /// @returns the statistics reported for the given cache, or nullptr if none.
+    cache_stats const* find(std::string_view _name) const noexcept
+    {
+        for (auto const& e: entries_)
+            if (e.name == _name)
+                return &e.stats;
+        return nullptr;
+    }
+
+    /// @returns a human readable table of all caches.
+    std::string table() const
+    {
+        auto width = std::string_view("cache").size();
+        for (auto const& e: entries_)
+            width = std::max(width, e.name.size());
+
+        auto out = fmt::format("{:<{}} {:>12} {:>12} {:>8} {:>10} {:>10} {:>12} {:>10} {:>10}\n",
+                               "cache", width, "hits", "misses", "rate", "inserts", "evicts",
+                               "KiB", "miss p50", "miss p99");
+        for (auto const& e: entries_)
+            out += fmt::format("{:<{}} {:>12} {:>12} {:>7.2f}% {:>10} {:>10} {:>12.1f} {:>8}us {:>8}us\n",
+                               e.name,
+                               width,
+                               e.stats.hits,
+                               e.stats.misses,
+                               100.0 * e.stats.hit_rate(),
+                               e.stats.insertions,
+                               e.stats.evictions,
+                               static_cast<double>(e.stats.bytes) / 1024.0,
+                               e.stats.miss_latency_p50.count(),
+                               e.stats.miss_latency_p99.count());
+        return out;
+    }
+
+    /// @returns a JSON object mapping each cache to its statistics, see cache_stats::json().
+    std::string json() const
+    {
+        auto out = std::string{"{"};
+        for (auto const& e: entries_)
+            out += fmt::format("{}\"{}\": {}", out.size() > 1 ? ", " : "", e.name, e.stats.json());
+        out += '}';
+        return out;
+    }
+
+  private:
+    std::vector<entry> entries_;
+};
+
+} // end namespace
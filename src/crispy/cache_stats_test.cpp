@@ -0,0 +1,86 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/cache_stats.h>
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+
+using crispy::cache_counters;
+using crispy::cache_statistics;
+using crispy::cache_stats;
+
+using namespace std::chrono_literals;
+
+TEST_CASE("cache_counters.stats", "[cache_stats]")
+{
+    auto counters = cache_counters{};
+    counters.hit();
+    counters.hit();
+    counters.hit();
+    counters.miss(100us);
+    counters.insert();
+    counters.evict(2);
+
+    auto const stats = counters.stats(42);
+    CHECK(stats.hits == 3);
+    CHECK(stats.misses == 1);
+    CHECK(stats.hit_rate() == 0.75);
+    CHECK(stats.insertions == 1);
+    CHECK(stats.evictions == 2);
+    CHECK(stats.bytes == 42);
+    CHECK(stats.miss_latency_p50.count() >= 90);
+    CHECK(stats.miss_latency_p50.count() <= 100);
+}
+
+TEST_CASE("cache_statistics.add", "[cache_stats]")
+{
+    auto a = cache_stats{};
+    a.hits = 1;
+    a.bytes = 10;
+    a.miss_latency_p99 = 5us;
+    auto b = cache_stats{};
+    b.misses = 1;
+    b.bytes = 20;
+    b.miss_latency_p99 = 3us;
+
+    auto statistics = cache_statistics{};
+    statistics.add("shaper.fallbacks", a);
+    statistics.add("text.rows", b);
+    statistics.add("shaper.fallbacks", b);
+
+    REQUIRE(statistics.entries().size() == 2);
+    REQUIRE(statistics.find("shaper.fallbacks") != nullptr);
+    CHECK(statistics.find("shaper.fallbacks")->lookups() == 2);
+    CHECK(statistics.find("shaper.fallbacks")->bytes == 30);
+    CHECK(statistics.find("shaper.fallbacks")->miss_latency_p99 == 5us);
+    CHECK(statistics.find("images") == nullptr);
+}
+
+TEST_CASE("cache_statistics.json", "[cache_stats]")
+{
+    auto statistics = cache_statistics{};
+    CHECK(statistics.json() == "{}");
+
+    auto stats = cache_stats{};
+    stats.hits = 3;
+    stats.misses = 1;
+    statistics.add("a", stats);
+    statistics.add("b", cache_stats{});
+    CHECK(statistics.json()
+          == "{\"a\": {\"hits\": 3, \"misses\": 1, \"hit_rate\": 0.7500, \"insertions\": 0, \"evictions\": 0, "
+             "\"bytes\": 0, \"miss_p50_us\": 0, \"miss_p99_us\": 0}, "
+             "\"b\": {\"hits\": 0, \"misses\": 0, \"hit_rate\": 0.0000, \"insertions\": 0, \"evictions\": 0, "
+             "\"bytes\": 0, \"miss_p50_us\": 0, \"miss_p99_us\": 0}}");
+}
@@ -15,11 +15,20 @@
 
 #include <crispy/indexed.h>
 #include <crispy/algorithm.h>
+#include <crispy/spsc_ring.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <utility>
 #include <functional>
 #include <vector>
@@ -50,27 +59,33 @@
 namespace crispy {
 
 namespace detail {
-    class dummy_source_location {
+    /// Source location referring to strings of static storage duration, such as __FILE__.
+    class basic_source_location {
       public:
-        dummy_source_location(std::string_view _filename, int _line, std::string_view _functionName) :
+        constexpr basic_source_location(char const* _filename, int _line, char const* _functionName) noexcept :
             fileName_{ _filename },
             line_{ _line },
             functionName_{ _functionName }
         {}
 
-        char const* file_name() const noexcept { return fileName_.c_str(); }
-        int line() const noexcept { return line_; }
-        char const* function_name() const noexcept { return functionName_.c_str(); }
+        template <typename SourceLocation>
+        constexpr basic_source_location(SourceLocation const& _location) noexcept :
+            basic_source_location(_location.file_name(), int(_location.line()), _location.function_name())
+        {}
+
+        constexpr char const* file_name() const noexcept { return fileName_; }
+        constexpr int line() const noexcept { return line_; }
+        constexpr char const* function_name() const noexcept { return functionName_; }
 
       private:
-        std::string fileName_;
+        char const* fileName_;
         int line_;
-        std::string functionName_;
+        char const* functionName_;
     };
 }
 
 #if !defined(CRISPY_SOURCE_LOCATION)
-    using source_location = detail::dummy_source_location;
+    using source_location = detail::basic_source_location;
 #endif
 
 namespace debugtag
@@ -82,6 +97,12 @@ namespace debugtag
     };
     struct tag_id { size_t value; };
 
+    /// Tag of a category compiled out of this build.
+    ///
+    /// Logging to it compiles down to nothing, and enabled() is a constant expression,
+    /// so that expensive log arguments can be eliminated at compile time, too.
+    struct disabled {};
+
     inline std::vector<tag_info>& store()
     {
         static std::vector<tag_info> tagStore;
@@ -122,50 +143,263 @@ namespace debugtag
 
     inline bool enabled(tag_id _tag) noexcept
     {
-        return _tag.value < store().size() && store().at(_tag.value).enabled;
+        auto const& tags = store();
+        return _tag.value < tags.size() && tags[_tag.value].enabled;
     }
+
+    constexpr bool enabled(disabled) noexcept { return false; }
 }
 
 class log_message {
   public:
     using Flush = std::function<void(log_message const&)>;
 
-    log_message(Flush _flush, source_location _sloc, debugtag::tag_id _tag) :
+    /// Constructs a message to be flushed upon destruction, unless its tag is disabled.
+    log_message(Flush _flush, detail::basic_source_location _sloc, debugtag::tag_id _tag) :
         flush_{ std::move(_flush) },
-        location_{ std::move(_sloc) },
-        tag_{ _tag }
+        location_{ _sloc },
+        tag_{ _tag },
+        enabled_{ debugtag::enabled(_tag) }
+    {}
+
+    /// Constructs an already written message, e.g. for passing it on from another thread.
+    log_message(detail::basic_source_location _sloc, debugtag::tag_id _tag, std::string _text) :
+        location_{ _sloc },
+        tag_{ _tag },
+        enabled_{ true },
+        text_{ std::move(_text) }
     {}
 
     ~log_message()
     {
-        flush_(*this);
+        if (flush_ && enabled_)
+            flush_(*this);
     }
 
     template <typename... Args>
     void write(std::string_view _message)
     {
-        if (debugtag::enabled(tag_))
+        if (enabled_)
             text_.append(_message);
     }
 
     template <typename... Args>
     void write(std::string_view _format, Args&&... _args)
     {
-        if (debugtag::enabled(tag_))
+        if (enabled_)
             text_.append(fmt::format(_format, std::forward<Args>(_args)...));
     }
 
-    source_location const& location() const noexcept { return location_; }
+    detail::basic_source_location const& location() const noexcept { return location_; }
     debugtag::tag_id tag() const noexcept { return tag_; }
     std::string const& text() const noexcept { return text_; }
 
   private:
     Flush flush_;
-    source_location const location_;
+    detail::basic_source_location const location_;
     debugtag::tag_id const tag_;
+    bool const enabled_;
     std::string text_;
 };
 
+/// Log message of a tag compiled out of this build (see debugtag::disabled), doing nothing.
+struct null_log_message {
+    template <typename... Args>
+    constexpr void write(std::string_view /*_format*/, Args&&... /*_args*/) const noexcept {}
+};
+
+namespace detail {
+    /// Queue of log messages written on a background thread.
+    ///
+    /// Each thread logging appends its messages to its own lock-free ring buffer, as a header
+    /// followed by the message text, which a background thread drains to pass them on.
+    /// Logging thus never waits for the messages to be transformed and written.
+    /// When a ring is full, messages are dropped and reported as such later on.
+    class async_log_queue {
+      public:
+        using Consumer = std::function<void(log_message const&)>;
+
+        static constexpr size_t RingSize = 256 * 1024;
+
+        explicit async_log_queue(Consumer _consumer) :
+            id_{ nextId() },
+            consumer_{ std::move(_consumer) },
+            thread_{ [this]() { run(); } }
+        {}
+
+        /// Stops the background thread, passing on all messages logged so far.
+        ~async_log_queue()
+        {
+            {
+                auto _l = std::scoped_lock{wakeupLock_};
+                stopping_ = true;
+            }
+            wakeup_.notify_one();
+            thread_.join();
+        }
+
+        async_log_queue(async_log_queue const&) = delete;
+        async_log_queue& operator=(async_log_queue const&) = delete;
+
+        void push(log_message const& _message)
+        {
+            auto const header = record{
+                _message.tag().value,
+                _message.location().file_name(),
+                _message.location().function_name(),
+                _message.location().line(),
+                _message.text().size()
+            };
+
+            auto& producer = localProducer();
+            auto& ring = producer.ring;
+            if (ring.capacity() - ring.size() < sizeof(header) + header.textSize)
+            {
+                producer.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            ring.push(reinterpret_cast<char const*>(&header), sizeof(header));
+            ring.push(_message.text().data(), header.textSize);
+
+            if (sleeping_.load(std::memory_order_relaxed))
+                wakeup_.notify_one();
+        }
+
+      private:
+        struct record {
+            size_t tag;
+            char const* fileName;
+            char const* functionName;
+            int line;
+            size_t textSize;
+        };
+
+        struct producer {
+            spsc_ring<char> ring{RingSize};
+            std::atomic<size_t> dropped = 0;
+            std::atomic<bool> released = false;    // its thread has exited
+        };
+
+        // Producers of the calling thread, by queue ID, released upon thread exit.
+        struct local_producers {
+            std::vector<std::pair<unsigned, std::shared_ptr<producer>>> producers;
+
+            ~local_producers()
+            {
+                for (auto& entry: producers)
+                    entry.second->released.store(true, std::memory_order_release);
+            }
+        };
+
+        static unsigned nextId()
+        {
+            static std::atomic<unsigned> id = 0;
+            return ++id;
+        }
+
+        producer& localProducer()
+        {
+            thread_local local_producers local;
+            for (auto& entry: local.producers)
+                if (entry.first == id_)
+                    return *entry.second;
+
+            auto p = std::make_shared<producer>();
+            {
+                auto _l = std::scoped_lock{producersLock_};
+                producers_.push_back(p);
+            }
+            local.producers.emplace_back(id_, p);
+            return *p;
+        }
+
+        static void pop(spsc_ring<char>& _ring, char* _data, size_t _count)
+        {
+            while (_count != 0)
+            {
+                auto const chunk = _ring.readable();
+                auto const n = std::min(chunk.size(), _count);
+                std::copy_n(chunk.begin(), n, _data);
+                _ring.consume(n);
+                _data += n;
+                _count -= n;
+            }
+        }
+
+        /// Passes on all messages logged so far.
+        ///
+        /// @returns whether or not there were any.
+        bool drain()
+        {
+            auto _l = std::scoped_lock{producersLock_};
+            bool drained = false;
+            for (auto i = producers_.begin(); i != producers_.end(); )
+            {
+                auto& p = **i;
+                auto const released = p.released.load(std::memory_order_acquire);
+                auto last = std::optional<record>{};
+                while (!p.ring.empty())
+                {
+                    auto header = record{};
+                    pop(p.ring, reinterpret_cast<char*>(&header), sizeof(header));
+                    auto text = std::string(header.textSize, '\0');
+                    pop(p.ring, text.data(), header.textSize);
+                    consumer_(log_message(basic_source_location(header.fileName, header.line, header.functionName),
+                                          debugtag::tag_id{header.tag},
+                                          std::move(text)));
+                    last = header;
+                    drained = true;
+                }
+
+                if (last.has_value())
+                    if (auto const dropped = p.dropped.exchange(0, std::memory_order_relaxed); dropped != 0)
+                        consumer_(log_message(basic_source_location(last->fileName, last->line, last->functionName),
+                                              debugtag::tag_id{last->tag},
+                                              fmt::format("({} log messages dropped)", dropped)));
+
+                if (released && p.ring.empty())
+                    i = producers_.erase(i);
+                else
+                    ++i;
+            }
+            return drained;
+        }
+
+        void run()
+        {
+            for (;;)
+            {
+                if (drain())
+                    continue;
+
+                auto _l = std::unique_lock{wakeupLock_};
+                if (stopping_)
+                    break;
+
+                // Bounded, as messages may get pushed right before falling asleep.
+                sleeping_.store(true, std::memory_order_relaxed);
+                wakeup_.wait_for(_l, std::chrono::milliseconds(50));
+                sleeping_.store(false, std::memory_order_relaxed);
+            }
+            drain();
+        }
+
+        unsigned const id_;
+        Consumer consumer_;
+
+        std::mutex producersLock_;
+        std::vector<std::shared_ptr<producer>> producers_;
+
+        std::mutex wakeupLock_;
+        std::condition_variable wakeup_;
+        std::atomic<bool> sleeping_ = false;
+        bool stopping_ = false;
+
+        std::thread thread_;
+    };
+}
+
 class logging_sink {
   public:
     using Transform = std::function<std::string(log_message const&)>;
@@ -197,9 +431,31 @@ class logging_sink {
     void enable(bool _enabled) { enabled_ = _enabled; }
     void toggle() noexcept { enabled_ = !enabled_; }
 
+    /// Transforms and writes messages on a background thread rather than right away,
+    /// so that logging has little impact on the performance of the threads logging.
+    ///
+    /// Messages still queued are written when disabling it again or upon destruction.
+    /// The transform and writer must not be changed while enabled.
+    void set_async(bool _enable)
+    {
+        if (!_enable)
+            async_.reset();
+        else if (!async_)
+            async_ = std::make_unique<detail::async_log_queue>([this](log_message const& _message) {
+                writer_(transform_(_message));
+            });
+    }
+
+    bool async() const noexcept { return async_ != nullptr; }
+
     void write(log_message const& _message)
     {
-        if (enabled())
+        if (!enabled())
+            return;
+
+        if (async_)
+            async_->push(_message);
+        else
             writer_(transform_(_message));
     }
 
@@ -224,22 +480,35 @@ class logging_sink {
     bool enabled_;
     Transform transform_;
     Writer writer_;
+    std::unique_ptr<detail::async_log_queue> async_;
 };
 
+namespace detail {
+    inline log_message make_log_message(debugtag::tag_id _tag, basic_source_location _sloc)
+    {
+        return log_message([](log_message const& m) { logging_sink::for_debug().write(m); }, _sloc, _tag);
+    }
+
+    constexpr null_log_message make_log_message(debugtag::disabled, basic_source_location) noexcept
+    {
+        return null_log_message{};
+    }
+}
+
 }
 
 #if defined(CRISPY_SOURCE_LOCATION)
     // XXX: sadly, this must be a global function so we can provide the fallback below.
     // TODO: Change that as soon as we get C++20's std::source_location on all major platforms supported.
-    inline ::crispy::log_message debuglog(::crispy::debugtag::tag_id _tag, crispy::source_location _sloc = crispy::source_location::current())
+    template <typename Tag>
+    inline auto debuglog(Tag _tag, crispy::source_location _sloc = crispy::source_location::current())
     {
-        return crispy::log_message([](::crispy::log_message const& m) { ::crispy::logging_sink::for_debug().write(m); }, _sloc, _tag);
+        return ::crispy::detail::make_log_message(_tag, _sloc);
     }
 #elif defined(__GNUC__) || defined(__clang__)
-    #define debuglog(_tag) (::crispy::log_message([](::crispy::log_message const& m) { ::crispy::logging_sink::for_debug().write(m); }, ::crispy::detail::dummy_source_location(__FILE__, __LINE__, __FUNCTION__), (_tag)))
+    #define debuglog(_tag) (::crispy::detail::make_log_message((_tag), ::crispy::detail::basic_source_location(__FILE__, __LINE__, __FUNCTION__)))
 #elif defined(__func__)
-    #define debuglog(_tag) (::crispy::log_message([](::crispy::log_message const& m) { ::crispy::logging_sink::for_debug().write(m); }, ::crispy::detail::dummy_source_location(__FILE__, __LINE__, __func__), (_tag)))
+    #define debuglog(_tag) (::crispy::detail::make_log_message((_tag), ::crispy::detail::basic_source_location(__FILE__, __LINE__, __func__)))
 #elif defined(__FUNCTION__)
-    #define debuglog(_tag) (::crispy::log_message([](::crispy::log_message const& m) { ::crispy::logging_sink::for_debug().write(m); }, ::crispy::detail::dummy_source_location(__FILE__, __LINE__, __FUNCTION__), (_tag)))
+    #define debuglog(_tag) (::crispy::detail::make_log_message((_tag), ::crispy::detail::basic_source_location(__FILE__, __LINE__, __FUNCTION__)))
 #endif
-
@@ -0,0 +1,115 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/debuglog.h>
+
+#include <catch2/catch.hpp>
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace
+{
+    auto const EnabledTag = crispy::debugtag::make("test.enabled", "Enabled test tag.", true);
+    auto const DisabledTag = crispy::debugtag::make("test.disabled", "Disabled test tag.", false);
+    auto const CompiledOutTag = crispy::debugtag::disabled{};
+
+    static_assert(!crispy::debugtag::enabled(CompiledOutTag));
+
+    /// Collects the messages written to the debug logging sink while alive.
+    class capture {
+      public:
+        capture()
+        {
+            auto& sink = crispy::logging_sink::for_debug();
+            sink.set_transform([](crispy::log_message const& _message) { return _message.text() + '\n'; });
+            sink.set_writer([this](string_view const& _text) {
+                auto _l = std::scoped_lock{lock_};
+                text_ += _text;
+            });
+            sink.enable(true);
+        }
+
+        ~capture()
+        {
+            auto& sink = crispy::logging_sink::for_debug();
+            sink.set_async(false);
+            sink.enable(false);
+            sink.set_writer([](string_view const&) {});
+        }
+
+        string text()
+        {
+            auto _l = std::scoped_lock{lock_};
+            return text_;
+        }
+
+      private:
+        std::mutex lock_;
+        string text_;
+    };
+}
+
+TEST_CASE("debuglog.sync", "[debuglog]")
+{
+    auto output = capture{};
+
+    debuglog(EnabledTag).write("enabled {}", 1);
+    debuglog(DisabledTag).write("disabled {}", 2);
+    debuglog(CompiledOutTag).write("compiled out {}", 3);
+
+    CHECK(output.text() == "enabled 1\n");
+}
+
+TEST_CASE("debuglog.async", "[debuglog]")
+{
+    auto output = capture{};
+    auto& sink = crispy::logging_sink::for_debug();
+    sink.set_async(true);
+
+    auto threads = vector<std::thread>{};
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back([t]() {
+            for (int i = 0; i < 100; ++i)
+                debuglog(EnabledTag).write("{}.{}", t, i);
+        });
+    for (auto& thread: threads)
+        thread.join();
+    debuglog(DisabledTag).write("disabled");
+
+    // Writes all queued messages.
+    sink.set_async(false);
+
+    auto const text = output.text();
+    for (int t = 0; t < 4; ++t)
+    {
+        // Messages of each thread are kept in order.
+        auto last = size_t{0};
+        for (int i = 0; i < 100; ++i)
+        {
+            auto const pos = text.find(fmt::format("\n{}.{}\n", t, i));
+            auto const first = text.find(fmt::format("{}.{}\n", t, i)) == 0;
+            REQUIRE((first || pos != string::npos));
+            auto const at = first ? 0 : pos + 1;
+            CHECK(at >= last);
+            last = at;
+        }
+    }
+    CHECK(text.find("disabled") == string::npos);
+}
@@ -0,0 +1,154 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace crispy {
+
+/// Bump allocator for data living no longer than a single frame.
+///
+/// Memory is handed out from a list of chunks by advancing an offset, and never freed
+/// individually. reset() rewinds to the first chunk in constant time, invalidating
+/// everything allocated since, but keeping the chunks for the next frame.
+/// New chunks are only allocated while a frame needs more memory than the ones before,
+/// so that frames of steady size do not touch the global allocator at all.
+///
+/// Not thread-safe, meant to be owned by the thread building the frames.
+class frame_arena {
+  public:
+    static constexpr size_t DefaultChunkSize = 64 * 1024;
+
+    explicit frame_arena(size_t _chunkSize = DefaultChunkSize): chunkSize_{ _chunkSize } {}
+
+    frame_arena(frame_arena const&) = delete;
+    frame_arena& operator=(frame_arena const&) = delete;
+
+    void* allocate(size_t _bytes, size_t _alignment = alignof(std::max_align_t))
+    {
+        assert(_alignment <= alignof(std::max_align_t) && (_alignment & (_alignment - 1)) == 0);
+
+        // Chunks too small for the request are skipped for the rest of the frame.
+        while (current_ < chunks_.size())
+        {
+            auto const offset = (offset_ + _alignment - 1) & ~(_alignment - 1);
+            if (offset + _bytes <= chunks_[current_].size)
+            {
+                offset_ = offset + _bytes;
+                used_ += _bytes;
+                return chunks_[current_].data() + offset;
+            }
+            ++current_;
+            offset_ = 0;
+        }
+
+        chunks_.emplace_back(chunk{std::max(_bytes, chunkSize_)});
+        current_ = chunks_.size() - 1;
+        offset_ = _bytes;
+        used_ += _bytes;
+        return chunks_.back().data();
+    }
+
+    /// Invalidates all memory handed out, keeping the chunks for reuse.
+    void reset() noexcept
+    {
+        current_ = 0;
+        offset_ = 0;
+        used_ = 0;
+    }
+
+    /// Resets the arena and frees all chunks but the first one,
+    /// e.g. to give back the memory of a frame of exceptional size.
+    void release()
+    {
+        reset();
+        if (chunks_.size() > 1)
+            chunks_.erase(chunks_.begin() + 1, chunks_.end());
+        chunks_.shrink_to_fit();
+    }
+
+    /// @returns the bytes handed out since the last reset().
+    size_t used_bytes() const noexcept { return used_; }
+
+    /// @returns the bytes held by the arena's chunks.
+    size_t capacity_bytes() const noexcept
+    {
+        size_t total = 0;
+        for (chunk const& c: chunks_)
+            total += c.size;
+        return total;
+    }
+
+  private:
+    struct chunk {
+        explicit chunk(size_t _size):
+            storage{ std::make_unique<std::max_align_t[]>((_size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t)) },
+            size{ _size }
+        {}
+
+        uint8_t* data() const noexcept { return reinterpret_cast<uint8_t*>(storage.get()); }
+
+        std::unique_ptr<std::max_align_t[]> storage;
+        size_t size;
+    };
+
+    size_t chunkSize_;
+    std::vector<chunk> chunks_;
+    size_t current_ = 0;    // index of the chunk being allocated from
+    size_t offset_ = 0;     // into the current chunk
+    size_t used_ = 0;
+};
+
+/// Standard allocator drawing its memory from a frame_arena.
+///
+/// Deallocation is a no-op, the memory is reclaimed by the arena's reset() only.
+/// Containers using it must therefore be emptied or discarded before that.
+template <typename T>
+struct arena_allocator {
+    static_assert(alignof(T) <= alignof(std::max_align_t));
+
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    explicit arena_allocator(frame_arena& _arena) noexcept: arena{ &_arena } {}
+    template <typename U> arena_allocator(arena_allocator<U> const& _other) noexcept: arena{ _other.arena } {}
+
+    T* allocate(size_t _count)
+    {
+        return static_cast<T*>(arena->allocate(_count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) noexcept {}
+
+    template <typename U>
+    bool operator==(arena_allocator<U> const& _other) const noexcept { return arena == _other.arena; }
+
+    template <typename U>
+    bool operator!=(arena_allocator<U> const& _other) const noexcept { return arena != _other.arena; }
+
+    frame_arena* arena;
+};
+
+template <typename T>
+using arena_vector = std::vector<T, arena_allocator<T>>;
+
+} // end namespace
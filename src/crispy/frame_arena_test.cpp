@@ -0,0 +1,78 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/frame_arena.h>
+
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+
+using crispy::arena_allocator;
+using crispy::arena_vector;
+using crispy::frame_arena;
+
+TEST_CASE("frame_arena.reset", "[frame_arena]")
+{
+    auto arena = frame_arena{1024};
+
+    auto* a = arena.allocate(100);
+    auto* b = arena.allocate(1, 1);
+    auto* c = arena.allocate(8, 8);
+    CHECK(static_cast<uint8_t*>(b) == static_cast<uint8_t*>(a) + 100);
+    CHECK(reinterpret_cast<uintptr_t>(c) % 8 == 0);
+    CHECK(arena.used_bytes() == 109);
+
+    // The next frame is handed out the same memory again.
+    arena.reset();
+    CHECK(arena.used_bytes() == 0);
+    CHECK(arena.allocate(100) == a);
+    CHECK(arena.capacity_bytes() == 1024);
+}
+
+TEST_CASE("frame_arena.chunks", "[frame_arena]")
+{
+    auto arena = frame_arena{1024};
+
+    auto* first = arena.allocate(1000);
+    arena.allocate(1000);
+    auto* large = arena.allocate(4096);
+    CHECK(arena.capacity_bytes() == 1024 + 1024 + 4096);
+
+    // Frames of the same size do not allocate any further chunks.
+    arena.reset();
+    CHECK(arena.allocate(1000) == first);
+    arena.allocate(1000);
+    CHECK(arena.allocate(4096) == large);
+    CHECK(arena.capacity_bytes() == 1024 + 1024 + 4096);
+
+    arena.release();
+    CHECK(arena.capacity_bytes() == 1024);
+    CHECK(arena.allocate(1000) == first);
+}
+
+TEST_CASE("frame_arena.allocator", "[frame_arena]")
+{
+    auto arena = frame_arena{1024};
+
+    auto values = arena_vector<int>{arena_allocator<int>{arena}};
+    values.reserve(16);
+    for (int i = 0; i < 16; ++i)
+        values.push_back(i);
+    CHECK(arena.used_bytes() == 16 * sizeof(int));
+    CHECK(values.back() == 15);
+
+    values = arena_vector<int>{values.get_allocator()};
+    arena.reset();
+    values.reserve(16);
+    CHECK(arena.used_bytes() == 16 * sizeof(int));
+}
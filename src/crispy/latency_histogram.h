@@ -0,0 +1,136 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+namespace crispy {
+
+/// Histogram of latencies, answering percentile queries such as the median or the 99th percentile.
+///
+/// Samples are counted in logarithmic buckets of microseconds, eight buckets per power of two,
+/// so that percentiles are reported with an error of at most 12.5%, in constant space.
+///
+/// Recording is lock-free and may happen from any number of threads.
+class latency_histogram {
+  public:
+    using duration = std::chrono::microseconds;
+
+    latency_histogram() = default;
+    latency_histogram(latency_histogram const&) = delete;
+    latency_histogram& operator=(latency_histogram const&) = delete;
+
+    void record(std::chrono::steady_clock::duration _latency) noexcept
+    {
+        auto const value = std::max(std::chrono::duration_cast<duration>(_latency).count(), duration::rep{0});
+        buckets_[bucketIndex(static_cast<uint64_t>(value))].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+
+        auto previousMax = max_.load(std::memory_order_relaxed);
+        while (previousMax < static_cast<uint64_t>(value)
+               && !max_.compare_exchange_weak(previousMax, static_cast<uint64_t>(value), std::memory_order_relaxed))
+            ;
+    }
+
+    /// @returns the number of samples recorded.
+    uint64_t count() const noexcept { return count_.load(std::memory_order_relaxed); }
+
+    /// @returns the largest latency recorded.
+    duration max() const noexcept { return duration(max_.load(std::memory_order_relaxed)); }
+
+    /// @returns the latency that @p _percent percent of all samples did not exceed,
+    ///          or zero if nothing has been recorded.
+    duration percentile(double _percent) const noexcept
+    {
+        auto const total = count();
+        if (!total)
+            return duration::zero();
+
+        auto const rank = std::clamp(static_cast<uint64_t>(std::ceil(_percent / 100.0 * static_cast<double>(total))),
+                                     uint64_t{1}, total);
+        auto seen = uint64_t{0};
+        for (size_t i = 0; i < BucketCount; ++i)
+        {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen >= rank)
+                return std::min(duration(bucketUpperBound(i)), max());
+        }
+        return max();
+    }
+
+    /// @returns a JSON object of the number of samples, and the 50th, 90th and 99th percentile
+    ///          and maximum latency in microseconds.
+    std::string json() const
+    {
+        return fmt::format("{{\"count\": {}, \"p50_us\": {}, \"p90_us\": {}, \"p99_us\": {}, \"max_us\": {}}}",
+                           count(),
+                           percentile(50).count(),
+                           percentile(90).count(),
+                           percentile(99).count(),
+                           max().count());
+    }
+
+    /// Forgets all samples. Samples recorded concurrently may or may not survive.
+    void reset() noexcept
+    {
+        for (auto& bucket: buckets_)
+            bucket.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+  private:
+    static constexpr unsigned SubBucketBits = 3;
+    static constexpr uint64_t SubBucketCount = uint64_t{1} << SubBucketBits;
+    static constexpr unsigned OctaveCount = 40; // covering latencies of up to about twelve days
+    static constexpr size_t BucketCount = SubBucketCount + OctaveCount * SubBucketCount;
+
+    static constexpr size_t bucketIndex(uint64_t _value) noexcept
+    {
+        if (_value < SubBucketCount)
+            return static_cast<size_t>(_value);
+
+        // Values in [8, 16) << shift all fall into the same octave.
+        auto shift = 0u;
+        while ((_value >> shift) >= 2 * SubBucketCount)
+            ++shift;
+        if (shift >= OctaveCount)
+            return BucketCount - 1;
+        return static_cast<size_t>(SubBucketCount + shift * SubBucketCount + ((_value >> shift) - SubBucketCount));
+    }
+
+    static constexpr uint64_t bucketUpperBound(size_t _index) noexcept
+    {
+        if (_index < SubBucketCount)
+            return _index;
+
+        auto const shift = (_index - SubBucketCount) / SubBucketCount;
+        auto const subBucket = (_index - SubBucketCount) % SubBucketCount;
+        return ((SubBucketCount + subBucket) << shift) + (uint64_t{1} << shift) - 1;
+    }
+
+    std::array<std::atomic<uint64_t>, BucketCount> buckets_{};
+    std::atomic<uint64_t> count_ = 0;
+    std::atomic<uint64_t> max_ = 0;
+};
+
+} // end namespace crispy
@@ -0,0 +1,64 @@
+/**
+ * This file is part of the "contour" project.
+ *   Copyright (c) 2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/latency_histogram.h>
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+
+using crispy::latency_histogram;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+TEST_CASE("latency_histogram.empty", "[latency_histogram]")
+{
+    auto const h = latency_histogram{};
+    CHECK(h.count() == 0);
+    CHECK(h.percentile(50) == microseconds(0));
+    CHECK(h.max() == microseconds(0));
+}
+
+TEST_CASE("latency_histogram.percentile", "[latency_histogram]")
+{
+    auto h = latency_histogram{};
+    for (int i = 1; i <= 98; ++i)
+        h.record(microseconds(5));
+    h.record(milliseconds(10));
+    h.record(milliseconds(20));
+
+    CHECK(h.count() == 100);
+    CHECK(h.percentile(50) == microseconds(5));
+    CHECK(h.percentile(98) == microseconds(5));
+    CHECK(h.max() == milliseconds(20));
+    CHECK(h.percentile(100) == milliseconds(20));
+
+    // Larger values are only reported within the resolution of their bucket.
+    auto const p99 = h.percentile(99);
+    CHECK(p99 >= milliseconds(10));
+    CHECK(p99 <= microseconds(10000 + 10000 / 8));
+
+    h.reset();
+    CHECK(h.count() == 0);
+    CHECK(h.percentile(99) == microseconds(0));
+}
+
+TEST_CASE("latency_histogram.json", "[latency_histogram]")
+{
+    auto h = crispy::latency_histogram{};
+    CHECK(h.json() == R"({"count": 0, "p50_us": 0, "p90_us": 0, "p99_us": 0, "max_us": 0})");
+
+    h.record(microseconds(5));
+    h.record(microseconds(7));
+    CHECK(h.json() == R"({"count": 2, "p50_us": 5, "p90_us": 7, "p99_us": 7, "max_us": 7})");
+}
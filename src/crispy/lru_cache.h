@@ -0,0 +1,233 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <crispy/cache_stats.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace crispy {
+
+/// Fixed-capacity cache of values keyed by 64-bit hashes, evicting the least recently used entry.
+///
+/// All storage is allocated up front: entries live in a preallocated slab
+/// and are indexed by an open-addressing hash table, so that lookups and insertions never allocate.
+/// Evicted values are handed out again by insert() as they are, allowing the caller
+/// to reuse any memory they own.
+///
+/// Keys are expected to be well distributed hashes already.
+template <typename Value>
+class lru_cache {
+  public:
+    explicit lru_cache(size_t _capacity):
+        nodes_(_capacity + 1),
+        table_(tableSize(_capacity), Empty),
+        mask_{table_.size() - 1}
+    {
+        assert(_capacity > 0);
+        nodes_[Sentinel].prev = Sentinel;
+        nodes_[Sentinel].next = Sentinel;
+    }
+
+    lru_cache(lru_cache const&) = delete;
+    lru_cache& operator=(lru_cache const&) = delete;
+
+    size_t capacity() const noexcept { return nodes_.size() - 1; }
+    size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+
+    uint64_t hits() const noexcept { return hits_; }
+    uint64_t misses() const noexcept { return misses_; }
+
+    /// @returns the lookups, insertions and evictions so far, along with the bytes of the
+    ///          preallocated storage (see storage_bytes()), for the caller to add what its values own.
+    cache_stats stats() const noexcept
+    {
+        auto stats = cache_stats{};
+        stats.hits = hits_;
+        stats.misses = misses_;
+        stats.insertions = insertions_;
+        stats.evictions = evictions_;
+        stats.bytes = storage_bytes();
+        return stats;
+    }
+
+    /// @returns the value cached for @p _key, marking it most recently used, or nullptr.
+    Value* try_get(uint64_t _key) noexcept
+    {
+        if (uint32_t const node = find(_key); node != Empty)
+        {
+            ++hits_;
+            unlink(node);
+            pushFront(node);
+            return &nodes_[node].value;
+        }
+        ++misses_;
+        return nullptr;
+    }
+
+    /// @returns the value cached for @p _key, or nullptr, without marking it used nor counting the lookup.
+    Value const* peek(uint64_t _key) const noexcept
+    {
+        if (uint32_t const node = find(_key); node != Empty)
+            return &nodes_[node].value;
+        return nullptr;
+    }
+
+    /// Makes room for @p _key, evicting the least recently used entry if the cache is full.
+    ///
+    /// @returns the value slot for @p _key, which is to be fully (re)assigned by the caller.
+    Value& insert(uint64_t _key) noexcept
+    {
+        ++insertions_;
+        uint32_t node = find(_key);
+        if (node != Empty)
+            unlink(node);
+        else
+        {
+            if (size_ < capacity())
+                node = static_cast<uint32_t>(++size_);
+            else
+            {
+                ++evictions_;
+                node = nodes_[Sentinel].prev;
+                unlink(node);
+                erase(nodes_[node].key);
+            }
+            nodes_[node].key = _key;
+            emplace(node);
+        }
+        pushFront(node);
+        return nodes_[node].value;
+    }
+
+    /// Forgets all entries, keeping their values for reuse.
+    void clear() noexcept
+    {
+        evictions_ += size_;
+        std::fill(table_.begin(), table_.end(), Empty);
+        nodes_[Sentinel].prev = Sentinel;
+        nodes_[Sentinel].next = Sentinel;
+        size_ = 0;
+    }
+
+    /// Invokes @p _visit with each key and value, from most to least recently used.
+    template <typename Visitor>
+    void for_each(Visitor _visit) const
+    {
+        for (uint32_t node = nodes_[Sentinel].next; node != Sentinel; node = nodes_[node].next)
+            _visit(nodes_[node].key, nodes_[node].value);
+    }
+
+    /// Invokes @p _visit with every value ever inserted, including the values of evicted
+    /// or forgotten entries that are kept for reuse.
+    template <typename Visitor>
+    void for_each_value(Visitor _visit) const
+    {
+        for (size_t node = 1; node < nodes_.size(); ++node)
+            _visit(nodes_[node].value);
+    }
+
+    /// @returns the bytes of the preallocated storage, not including memory owned by the values.
+    size_t storage_bytes() const noexcept
+    {
+        return nodes_.capacity() * sizeof(Node) + table_.capacity() * sizeof(uint32_t);
+    }
+
+  private:
+    static constexpr uint32_t Empty = std::numeric_limits<uint32_t>::max();
+    static constexpr uint32_t Sentinel = 0; // head of the LRU list, most recently used first
+
+    struct Node {
+        uint64_t key = 0;
+        uint32_t prev = Sentinel;
+        uint32_t next = Sentinel;
+        Value value{};
+    };
+
+    /// Keeps the table at most half full to keep the probe sequences short.
+    static size_t tableSize(size_t _capacity) noexcept
+    {
+        size_t size = 1;
+        while (size < 2 * _capacity)
+            size <<= 1;
+        return size;
+    }
+
+    uint32_t find(uint64_t _key) const noexcept
+    {
+        for (size_t slot = _key & mask_; table_[slot] != Empty; slot = (slot + 1) & mask_)
+            if (nodes_[table_[slot]].key == _key)
+                return table_[slot];
+        return Empty;
+    }
+
+    void emplace(uint32_t _node) noexcept
+    {
+        size_t slot = nodes_[_node].key & mask_;
+        while (table_[slot] != Empty)
+            slot = (slot + 1) & mask_;
+        table_[slot] = _node;
+    }
+
+    /// Removes @p _key from the table, shifting back subsequent entries of its probe sequence.
+    void erase(uint64_t _key) noexcept
+    {
+        size_t hole = _key & mask_;
+        while (nodes_[table_[hole]].key != _key)
+            hole = (hole + 1) & mask_;
+
+        for (size_t slot = (hole + 1) & mask_; table_[slot] != Empty; slot = (slot + 1) & mask_)
+        {
+            // Only move entries whose home slot is not within (hole, slot].
+            size_t const home = nodes_[table_[slot]].key & mask_;
+            if (((slot - home) & mask_) >= ((slot - hole) & mask_))
+            {
+                table_[hole] = table_[slot];
+                hole = slot;
+            }
+        }
+        table_[hole] = Empty;
+    }
+
+    void unlink(uint32_t _node) noexcept
+    {
+        nodes_[nodes_[_node].prev].next = nodes_[_node].next;
+        nodes_[nodes_[_node].next].prev = nodes_[_node].prev;
+    }
+
+    void pushFront(uint32_t _node) noexcept
+    {
+        nodes_[_node].prev = Sentinel;
+        nodes_[_node].next = nodes_[Sentinel].next;
+        nodes_[nodes_[Sentinel].next].prev = _node;
+        nodes_[Sentinel].next = _node;
+    }
+
+    std::vector<Node> nodes_; // slab of entries, with nodes_[Sentinel] heading the LRU list
+    std::vector<uint32_t> table_;
+    size_t const mask_;
+    size_t size_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t insertions_ = 0;
+    uint64_t evictions_ = 0;
+};
+
+} // end namespace crispy
@@ -0,0 +1,121 @@
+/**
+ * This file is part of the "contour" project.
+ *   Copyright (c) 2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/lru_cache.h>
+
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+using crispy::lru_cache;
+using std::string;
+
+TEST_CASE("lru_cache.insert", "[lru_cache]")
+{
+    auto cache = lru_cache<string>{3};
+    CHECK(cache.empty());
+    CHECK(cache.try_get(1) == nullptr);
+
+    cache.insert(1) = "one";
+    cache.insert(2) = "two";
+    REQUIRE(cache.try_get(1) != nullptr);
+    CHECK(*cache.try_get(1) == "one");
+    CHECK(cache.size() == 2);
+    CHECK(cache.hits() == 2);
+    CHECK(cache.misses() == 1);
+}
+
+TEST_CASE("lru_cache.evict_least_recently_used", "[lru_cache]")
+{
+    auto cache = lru_cache<string>{3};
+    cache.insert(1) = "one";
+    cache.insert(2) = "two";
+    cache.insert(3) = "three";
+    cache.try_get(1); // 2 is the least recently used one now
+
+    // The evicted value is handed out for reuse.
+    string& value = cache.insert(4);
+    CHECK(value == "two");
+    value = "four";
+
+    CHECK(cache.size() == 3);
+    CHECK(cache.try_get(2) == nullptr);
+    CHECK(*cache.try_get(1) == "one");
+    CHECK(*cache.try_get(3) == "three");
+    CHECK(*cache.try_get(4) == "four");
+
+    auto order = std::vector<uint64_t>{};
+    cache.for_each([&](uint64_t _key, string const&) { order.push_back(_key); });
+    CHECK(order == std::vector<uint64_t>{4, 3, 1});
+
+    CHECK(cache.stats().insertions == 4);
+    CHECK(cache.stats().evictions == 1);
+    cache.clear();
+    CHECK(cache.stats().evictions == 4);
+}
+
+TEST_CASE("lru_cache.peek", "[lru_cache]")
+{
+    auto cache = lru_cache<string>{2};
+    cache.insert(1) = "one";
+    cache.insert(2) = "two";
+    CHECK(cache.peek(3) == nullptr);
+    REQUIRE(cache.peek(1) != nullptr);
+    CHECK(*cache.peek(1) == "one");
+    CHECK(cache.hits() == 0);
+    CHECK(cache.misses() == 0);
+
+    // Peeking leaves 1 the least recently used one.
+    cache.insert(3) = "three";
+    CHECK(cache.peek(1) == nullptr);
+}
+
+TEST_CASE("lru_cache.clear", "[lru_cache]")
+{
+    auto cache = lru_cache<string>{2};
+    cache.insert(1) = "one";
+    cache.clear();
+    CHECK(cache.empty());
+    CHECK(cache.try_get(1) == nullptr);
+    cache.insert(2) = "two";
+    CHECK(*cache.try_get(2) == "two");
+}
+
+TEST_CASE("lru_cache.colliding_slots", "[lru_cache]")
+{
+    // Keys sharing their low bits probe the same table slots,
+    // which must survive evicting entries from the middle of a probe sequence.
+    auto cache = lru_cache<uint64_t>{8};
+    auto expected = std::map<uint64_t, uint64_t>{};
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        auto const key = (i % 3) + (i << 20);
+        cache.insert(key) = i;
+        expected[key] = i;
+        if (expected.size() > 8)
+            expected.erase(((i - 8) % 3) + ((i - 8) << 20));
+
+        auto actual = std::map<uint64_t, uint64_t>{};
+        cache.for_each([&](uint64_t _key, uint64_t _value) { actual[_key] = _value; });
+        REQUIRE(actual == expected);
+    }
+
+    for (auto const& [key, value]: expected)
+    {
+        REQUIRE(cache.try_get(key) != nullptr);
+        CHECK(*cache.try_get(key) == value);
+    }
+}
@@ -0,0 +1,128 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace crispy {
+
+/// Bytes of memory used, by subsystem.
+///
+/// Subsystems are named hierarchically with dots, such as "screen.primary.history.cells",
+/// and reported in the order they were first added.
+class memory_usage {
+  public:
+    struct entry {
+        std::string name;
+        size_t bytes;
+    };
+
+    /// Accounts @p _bytes to the given subsystem, adding up with what was accounted before.
+    void add(std::string_view _name, size_t _bytes)
+    {
+        for (auto& e: entries_)
+            if (e.name == _name)
+            {
+                e.bytes += _bytes;
+                return;
+            }
+        entries_.push_back(entry{std::string(_name), _bytes});
+    }
+
+    std::vector<entry> const& entries() const noexcept { return entries_; }
+
+    /// @returns the bytes accounted to the given subsystem and all subsystems nested in it.
+    size_t bytes(std::string_view _prefix) const noexcept
+    {
+        size_t sum = 0;
+        for (auto const& e: entries_)
+            if (e.name == _prefix
+                || (e.name.size() > _prefix.size()
+                    && e.name.compare(0, _prefix.size(), _prefix) == 0
+                    && e.name[_prefix.size()] == '.'))
+                sum += e.bytes;
+        return sum;
+    }
+
+    size_t total() const noexcept
+    {
+        size_t sum = 0;
+        for (auto const& e: entries_)
+            sum += e.bytes;
+        return sum;
+    }
+
+    /// @returns a human readable table of all subsystems.
+    std::string table() const
+    {
+        auto width = std::string_view("total").size();
+        for (auto const& e: entries_)
+            width = std::max(width, e.name.size());
+
+        auto out = std::string{};
+        for (auto const& e: entries_)
+            out += fmt::format("{:<{}} {:>12} {:>10.2f} MiB\n", e.name, width, e.bytes, mebibytes(e.bytes));
+        out += fmt::format("{:<{}} {:>12} {:>10.2f} MiB\n", "total", width, total(), mebibytes(total()));
+        return out;
+    }
+
+    /// @returns a JSON object mapping each subsystem (and "total") to its bytes.
+    std::string json() const
+    {
+        auto out = std::string{"{"};
+        for (auto const& e: entries_)
+            out += fmt::format("\"{}\": {}, ", e.name, e.bytes);
+        out += fmt::format("\"total\": {}}}", total());
+        return out;
+    }
+
+  private:
+    static double mebibytes(size_t _bytes) noexcept { return static_cast<double>(_bytes) / (1024.0 * 1024.0); }
+
+    std::vector<entry> entries_;
+};
+
+/// @returns the bytes allocated by the given vector.
+template <typename T, typename Allocator>
+size_t allocated_bytes(std::vector<T, Allocator> const& _vector) noexcept
+{
+    return _vector.capacity() * sizeof(T);
+}
+
+/// @returns the bytes allocated by the given string, beyond what is stored inline.
+template <typename Char>
+size_t allocated_bytes(std::basic_string<Char> const& _string) noexcept
+{
+    auto const inlineCapacity = std::basic_string<Char>().capacity();
+    return _string.capacity() > inlineCapacity ? (_string.capacity() + 1) * sizeof(Char) : 0;
+}
+
+/// @returns an estimate of the bytes allocated by the given node-based hash table,
+///          not including memory owned by its keys or values.
+template <typename HashTable>
+size_t hash_table_bytes(HashTable const& _table) noexcept
+{
+    auto constexpr NodeOverhead = sizeof(void*) + sizeof(size_t); // next pointer and cached hash
+    return _table.bucket_count() * sizeof(void*)
+         + _table.size() * (sizeof(typename HashTable::value_type) + NodeOverhead);
+}
+
+} // end namespace
@@ -0,0 +1,64 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/memory_usage.h>
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using crispy::memory_usage;
+
+TEST_CASE("memory_usage.add", "[memory_usage]")
+{
+    auto usage = memory_usage{};
+    usage.add("grid.page", 100);
+    usage.add("grid.history", 20);
+    usage.add("gridlines", 3);
+    usage.add("grid.page", 50);
+
+    REQUIRE(usage.entries().size() == 3);
+    CHECK(usage.entries()[0].name == "grid.page");
+    CHECK(usage.entries()[0].bytes == 150);
+    CHECK(usage.bytes("grid") == 170);
+    CHECK(usage.bytes("grid.page") == 150);
+    CHECK(usage.bytes("images") == 0);
+    CHECK(usage.total() == 173);
+}
+
+TEST_CASE("memory_usage.json", "[memory_usage]")
+{
+    auto usage = memory_usage{};
+    CHECK(usage.json() == "{\"total\": 0}");
+
+    usage.add("a.b", 1);
+    usage.add("c", 2);
+    CHECK(usage.json() == "{\"a.b\": 1, \"c\": 2, \"total\": 3}");
+}
+
+TEST_CASE("memory_usage.allocated_bytes", "[memory_usage]")
+{
+    auto values = std::vector<uint32_t>{};
+    values.reserve(10);
+    CHECK(crispy::allocated_bytes(values) == values.capacity() * 4);
+
+    CHECK(crispy::allocated_bytes(std::string("short")) == 0);
+    auto const text = std::string(1000, 'x');
+    CHECK(crispy::allocated_bytes(text) == text.capacity() + 1);
+
+    auto table = std::unordered_map<int, int>{};
+    table[1] = 2;
+    CHECK(crispy::hash_table_bytes(table) >= table.bucket_count() * sizeof(void*) + sizeof(std::pair<int const, int>));
+}
@@ -0,0 +1,86 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace crispy {
+
+/// Unbounded lock-free queue of any number of producer threads and exactly one consumer thread.
+///
+/// Pushing never waits, neither for other producers nor for the consumer, allocating one node
+/// per element. Elements pushed by the same thread are popped in the order they were pushed.
+///
+/// An element may become visible to the consumer only shortly after push() returned to another
+/// producer, so producers must not rely on popping order across threads.
+template <typename T>
+class mpsc_queue {
+  public:
+    mpsc_queue() = default;
+    mpsc_queue(mpsc_queue const&) = delete;
+    mpsc_queue& operator=(mpsc_queue const&) = delete;
+
+    ~mpsc_queue()
+    {
+        while (try_pop())
+            ;
+        if (tail_ != &stub_)
+            delete tail_;
+    }
+
+    /// Appends @p _value to the queue. May be invoked by any thread.
+    void push(T _value)
+    {
+        auto* n = new node{};
+        n->value.emplace(std::move(_value));
+        auto* previous = head_.exchange(n, std::memory_order_acq_rel);
+        previous->next.store(n, std::memory_order_release);
+    }
+
+    /// @returns the front element, if any. May only be invoked by the consumer.
+    std::optional<T> try_pop()
+    {
+        auto* next = tail_->next.load(std::memory_order_acquire);
+        if (!next)
+            return std::nullopt;
+
+        // The popped element's node becomes the new (value-less) tail.
+        auto result = std::move(next->value);
+        next->value.reset();
+        if (tail_ != &stub_)
+            delete tail_;
+        tail_ = next;
+        return result;
+    }
+
+    /// Tells whether there is nothing to pop. May only be invoked by the consumer.
+    bool empty() const noexcept { return tail_->next.load(std::memory_order_acquire) == nullptr; }
+
+  private:
+    struct node {
+        std::atomic<node*> next = nullptr;
+        std::optional<T> value;
+    };
+
+    node stub_;
+
+    // The most recently pushed node, exchanged by the producers, and kept on
+    // a separate cache line from the consumer's end.
+    alignas(64) std::atomic<node*> head_ = &stub_;
+    alignas(64) node* tail_ = &stub_;
+};
+
+} // end namespace
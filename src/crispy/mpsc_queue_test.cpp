@@ -0,0 +1,85 @@
+/**
+ * This file is part of the "contour" project.
+ *   Copyright (c) 2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/mpsc_queue.h>
+
+#include <catch2/catch.hpp>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using crispy::mpsc_queue;
+using std::string;
+
+TEST_CASE("mpsc_queue.fifo", "[mpsc_queue]")
+{
+    auto q = mpsc_queue<string>{};
+    CHECK(q.empty());
+    CHECK(!q.try_pop());
+
+    q.push("a");
+    q.push("b");
+    CHECK(!q.empty());
+    CHECK(q.try_pop() == "a");
+
+    q.push("c");
+    CHECK(q.try_pop() == "b");
+    CHECK(q.try_pop() == "c");
+    CHECK(q.empty());
+    CHECK(!q.try_pop());
+}
+
+TEST_CASE("mpsc_queue.destroys_pending", "[mpsc_queue]")
+{
+    auto value = std::make_shared<int>(42);
+    {
+        auto q = mpsc_queue<std::shared_ptr<int>>{};
+        q.push(value);
+        q.push(value);
+        CHECK(value.use_count() == 3);
+    }
+    CHECK(value.use_count() == 1);
+}
+
+TEST_CASE("mpsc_queue.threads", "[mpsc_queue]")
+{
+    auto constexpr ProducerCount = 4;
+    auto constexpr ElementCount = 10000;
+
+    auto q = mpsc_queue<std::pair<int, int>>{};
+    auto producers = std::vector<std::thread>{};
+    for (int p = 0; p < ProducerCount; ++p)
+        producers.emplace_back([&q, p]() {
+            for (int i = 0; i < ElementCount; ++i)
+                q.push({p, i});
+        });
+
+    // Each producer's elements arrive in the order they were pushed.
+    auto next = std::vector<int>(ProducerCount, 0);
+    auto popped = 0;
+    while (popped < ProducerCount * ElementCount)
+    {
+        auto const element = q.try_pop();
+        if (!element)
+            continue;
+        REQUIRE(element->second == next[element->first]);
+        ++next[element->first];
+        ++popped;
+    }
+
+    for (auto& producer: producers)
+        producer.join();
+    CHECK(q.empty());
+}
@@ -0,0 +1,56 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+/// Instrumentation zones, counters and frame marks for the Tracy profiler
+/// (https://github.com/wolfpld/tracy), compiled in only if CRISPY_TRACY is defined
+/// (see the CMake option of the same name), and expanding to nothing otherwise.
+///
+///     void Renderer::render(...)
+///     {
+///         CRISPY_PROFILE_ZONE("Renderer::render");
+///         ...
+///         CRISPY_PROFILE_COUNTER("cells rendered", cellCount);
+///     }
+///
+/// Zone and counter names must be string literals. Arguments to counters are not evaluated
+/// unless profiling is compiled in, so they may compute the value reported.
+///
+/// Unlike crispy::trace_recorder, which records a few coarse phases at runtime (such as
+/// starting up), these are meant for the hot paths, to be inspected live in the profiler.
+
+#if defined(CRISPY_TRACY)
+
+    #include <tracy/Tracy.hpp>
+
+    /// Records the enclosing scope as a zone of the given name.
+    #define CRISPY_PROFILE_ZONE(_name) ZoneScopedN(_name)
+
+    /// Reports the current value of the counter of the given name, plotted over time.
+    #define CRISPY_PROFILE_COUNTER(_name, _value) TracyPlot((_name), static_cast<double>(_value))
+
+    /// Marks the end of a frame presented to the screen.
+    #define CRISPY_PROFILE_FRAME() FrameMark
+
+    /// Names the calling thread in the profiler.
+    #define CRISPY_PROFILE_THREAD(_name) tracy::SetThreadName(_name)
+
+#else
+
+    #define CRISPY_PROFILE_ZONE(_name) do {} while (0)
+    #define CRISPY_PROFILE_COUNTER(_name, _value) do {} while (0)
+    #define CRISPY_PROFILE_FRAME() do {} while (0)
+    #define CRISPY_PROFILE_THREAD(_name) do {} while (0)
+
+#endif
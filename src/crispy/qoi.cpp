@@ -0,0 +1,246 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/qoi.h>
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+
+namespace crispy::qoi {
+
+namespace // {{{ helper
+{
+    constexpr uint8_t OpIndex = 0x00;   // 00iiiiii: pixel seen before, at index i
+    constexpr uint8_t OpDiff = 0x40;    // 01rrggbb: small difference to the previous pixel
+    constexpr uint8_t OpLuma = 0x80;    // 10gggggg rrrrbbbb: difference relative to the green one
+    constexpr uint8_t OpRun = 0xC0;     // 11llllll: previous pixel repeated l + 1 times
+    constexpr uint8_t OpRGB = 0xFE;
+    constexpr uint8_t OpRGBA = 0xFF;
+    constexpr uint8_t OpMask = 0xC0;
+
+    constexpr int MaxRun = 62;          // as run lengths of 63 and 64 would collide with OpRGB and OpRGBA
+
+    struct Pixel {
+        uint8_t r = 0;
+        uint8_t g = 0;
+        uint8_t b = 0;
+        uint8_t a = 255;
+
+        bool operator==(Pixel const& _other) const noexcept
+        {
+            return r == _other.r && g == _other.g && b == _other.b && a == _other.a;
+        }
+        bool operator!=(Pixel const& _other) const noexcept { return !(*this == _other); }
+    };
+
+    constexpr size_t hash(Pixel _pixel) noexcept
+    {
+        return (_pixel.r * 3u + _pixel.g * 5u + _pixel.b * 7u + _pixel.a * 11u) % 64u;
+    }
+
+    inline Pixel load(uint8_t const* _input) noexcept
+    {
+        return Pixel{ _input[0], _input[1], _input[2], _input[3] };
+    }
+
+    inline void store(Pixel _pixel, uint8_t* _output) noexcept
+    {
+        _output[0] = _pixel.r;
+        _output[1] = _pixel.g;
+        _output[2] = _pixel.b;
+        _output[3] = _pixel.a;
+    }
+
+    constexpr uint8_t Magic[4] = { 'q', 'o', 'i', 'f' };
+
+    inline void storeBigEndian(uint32_t _value, uint8_t* _output) noexcept
+    {
+        _output[0] = static_cast<uint8_t>(_value >> 24);
+        _output[1] = static_cast<uint8_t>(_value >> 16);
+        _output[2] = static_cast<uint8_t>(_value >> 8);
+        _output[3] = static_cast<uint8_t>(_value);
+    }
+
+    inline uint32_t loadBigEndian(uint8_t const* _input) noexcept
+    {
+        return uint32_t(_input[0]) << 24 | uint32_t(_input[1]) << 16 | uint32_t(_input[2]) << 8 | uint32_t(_input[3]);
+    }
+} // }}}
+
+void encodeHeader(header const& _header, uint8_t* _output) noexcept
+{
+    std::copy(std::begin(Magic), std::end(Magic), _output);
+    storeBigEndian(_header.width, _output + 4);
+    storeBigEndian(_header.height, _output + 8);
+    _output[12] = _header.channels;
+    _output[13] = _header.colorspace;
+}
+
+std::optional<header> decodeHeader(uint8_t const* _input, size_t _size) noexcept
+{
+    if (_size < HeaderSize || !std::equal(std::begin(Magic), std::end(Magic), _input))
+        return std::nullopt;
+
+    auto const result = header{ loadBigEndian(_input + 4), loadBigEndian(_input + 8), _input[12], _input[13] };
+    if (result.channels < 3 || result.channels > 4 || result.colorspace > 1)
+        return std::nullopt;
+
+    return result;
+}
+
+size_t encode(uint8_t const* _input, size_t _pixelCount, uint8_t* _output) noexcept
+{
+    auto index = std::array<Pixel, 64>{};
+    for (auto& seen: index)
+        seen.a = 0;
+    auto previous = Pixel{};
+    auto output = _output;
+    auto run = 0;
+
+    for (size_t i = 0; i < _pixelCount; ++i)
+    {
+        auto const pixel = load(_input + i * 4);
+        if (pixel == previous)
+        {
+            if (++run == MaxRun || i + 1 == _pixelCount)
+            {
+                *output++ = static_cast<uint8_t>(OpRun | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+
+        if (run > 0)
+        {
+            *output++ = static_cast<uint8_t>(OpRun | (run - 1));
+            run = 0;
+        }
+
+        auto const position = hash(pixel);
+        if (index[position] == pixel)
+            *output++ = static_cast<uint8_t>(OpIndex | position);
+        else
+        {
+            index[position] = pixel;
+            if (pixel.a == previous.a)
+            {
+                auto const dr = static_cast<int8_t>(pixel.r - previous.r);
+                auto const dg = static_cast<int8_t>(pixel.g - previous.g);
+                auto const db = static_cast<int8_t>(pixel.b - previous.b);
+                auto const drg = dr - dg;
+                auto const dbg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                    *output++ = static_cast<uint8_t>(OpDiff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7)
+                {
+                    *output++ = static_cast<uint8_t>(OpLuma | (dg + 32));
+                    *output++ = static_cast<uint8_t>((drg + 8) << 4 | (dbg + 8));
+                }
+                else
+                {
+                    *output++ = OpRGB;
+                    *output++ = pixel.r;
+                    *output++ = pixel.g;
+                    *output++ = pixel.b;
+                }
+            }
+            else
+            {
+                *output++ = OpRGBA;
+                store(pixel, output);
+                output += 4;
+            }
+        }
+        previous = pixel;
+    }
+
+    return static_cast<size_t>(output - _output);
+}
+
+std::vector<uint8_t> encode(uint8_t const* _input, size_t _pixelCount)
+{
+    auto output = std::vector<uint8_t>(encodedSizeMax(_pixelCount));
+    output.resize(encode(_input, _pixelCount, output.data()));
+    output.shrink_to_fit();
+    return output;
+}
+
+bool decode(uint8_t const* _input, size_t _size, uint8_t* _output, size_t _pixelCount) noexcept
+{
+    auto index = std::array<Pixel, 64>{};
+    for (auto& seen: index)
+        seen.a = 0;
+    auto pixel = Pixel{};
+    auto input = _input;
+    auto const end = _input + _size;
+
+    for (size_t i = 0; i < _pixelCount; )
+    {
+        if (input == end)
+            return false;
+
+        auto const op = *input++;
+        if (op == OpRGB)
+        {
+            if (end - input < 3)
+                return false;
+            pixel.r = input[0];
+            pixel.g = input[1];
+            pixel.b = input[2];
+            input += 3;
+        }
+        else if (op == OpRGBA)
+        {
+            if (end - input < 4)
+                return false;
+            pixel = load(input);
+            input += 4;
+        }
+        else if ((op & OpMask) == OpIndex)
+            pixel = index[op];
+        else if ((op & OpMask) == OpDiff)
+        {
+            pixel.r = static_cast<uint8_t>(pixel.r + ((op >> 4) & 0x03) - 2);
+            pixel.g = static_cast<uint8_t>(pixel.g + ((op >> 2) & 0x03) - 2);
+            pixel.b = static_cast<uint8_t>(pixel.b + (op & 0x03) - 2);
+        }
+        else if ((op & OpMask) == OpLuma)
+        {
+            if (input == end)
+                return false;
+            auto const next = *input++;
+            auto const dg = (op & 0x3F) - 32;
+            pixel.r = static_cast<uint8_t>(pixel.r + dg - 8 + ((next >> 4) & 0x0F));
+            pixel.g = static_cast<uint8_t>(pixel.g + dg);
+            pixel.b = static_cast<uint8_t>(pixel.b + dg - 8 + (next & 0x0F));
+        }
+        else
+        {
+            // Runs leave the index alone, as the encoder does.
+            auto const run = std::min(static_cast<size_t>((op & 0x3F) + 1), _pixelCount - i);
+            for (size_t k = 0; k < run; ++k)
+                store(pixel, _output + (i + k) * 4);
+            i += run;
+            continue;
+        }
+
+        index[hash(pixel)] = pixel;
+        store(pixel, _output + i * 4);
+        ++i;
+    }
+
+    return true;
+}
+
+} // end namespace
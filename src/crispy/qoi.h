@@ -0,0 +1,68 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+/// Lossless compression of RGBA pixels, using the chunk encoding of the QOI image format
+/// ("Quite OK Image", https://qoiformat.org), without its header and end marker,
+/// as the dimensions of the image are known to the caller already.
+///
+/// It compresses images with areas of equal or similar colors (such as plots and
+/// screenshots of text) well, while encoding and decoding at several hundred MB/s.
+///
+/// QOI image files are the header (see encodeHeader() and decodeHeader()) followed by
+/// the chunks and the end marker, the latter of which is ignored by decode().
+namespace crispy::qoi {
+
+/// Number of bytes of the header of QOI image files.
+constexpr size_t HeaderSize = 14;
+
+/// Header of QOI image files.
+struct header {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t channels = 4;       // 3 (RGB) or 4 (RGBA), informative only, as decode() always yields RGBA
+    uint8_t colorspace = 0;     // 0 (sRGB with linear alpha) or 1 (all linear), informative only
+};
+
+/// Writes @p _header into @p _output, which must have room for HeaderSize bytes.
+void encodeHeader(header const& _header, uint8_t* _output) noexcept;
+
+/// Reads the header from the start of the @p _size bytes at @p _input.
+///
+/// @returns the header, or std::nullopt if the input is too short or not a valid QOI header.
+std::optional<header> decodeHeader(uint8_t const* _input, size_t _size) noexcept;
+
+/// @returns the maximum number of bytes @p _pixelCount pixels are encoded to.
+constexpr size_t encodedSizeMax(size_t _pixelCount) noexcept { return _pixelCount * 5; }
+
+/// Encodes the RGBA pixels at @p _input into @p _output, which must have room for
+/// encodedSizeMax(_pixelCount) bytes.
+///
+/// @returns the number of bytes written.
+size_t encode(uint8_t const* _input, size_t _pixelCount, uint8_t* _output) noexcept;
+
+/// @returns the RGBA pixels at @p _input encoded, with no capacity to spare.
+std::vector<uint8_t> encode(uint8_t const* _input, size_t _pixelCount);
+
+/// Decodes @p _pixelCount RGBA pixels from the @p _size bytes at @p _input into @p _output.
+///
+/// @returns whether the input held all of the pixels. Pixels missing are left untouched.
+bool decode(uint8_t const* _input, size_t _size, uint8_t* _output, size_t _pixelCount) noexcept;
+
+} // end namespace
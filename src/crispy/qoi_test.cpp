@@ -0,0 +1,121 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/qoi.h>
+
+#include <catch2/catch.hpp>
+
+#include <random>
+#include <vector>
+
+using std::vector;
+
+namespace
+{
+    vector<uint8_t> roundtrip(vector<uint8_t> const& _pixels)
+    {
+        auto const pixelCount = _pixels.size() / 4;
+        auto const encoded = crispy::qoi::encode(_pixels.data(), pixelCount);
+        CHECK(encoded.size() <= crispy::qoi::encodedSizeMax(pixelCount));
+        auto decoded = vector<uint8_t>(_pixels.size());
+        CHECK(crispy::qoi::decode(encoded.data(), encoded.size(), decoded.data(), pixelCount));
+        return decoded;
+    }
+
+    /// A plot-like image: a uniform background with a few gradients and lines.
+    vector<uint8_t> plot(int _width, int _height)
+    {
+        auto pixels = vector<uint8_t>();
+        for (int y = 0; y < _height; ++y)
+            for (int x = 0; x < _width; ++x)
+            {
+                auto const onLine = y == _height / 2 || x == (y * 3) % _width;
+                pixels.push_back(onLine ? 255 : 16);
+                pixels.push_back(onLine ? 64 : 16);
+                pixels.push_back(static_cast<uint8_t>(16 + y / 4));
+                pixels.push_back(255);
+            }
+        return pixels;
+    }
+}
+
+TEST_CASE("qoi.roundtrip.empty")
+{
+    CHECK(crispy::qoi::encode(nullptr, 0).empty());
+    CHECK(crispy::qoi::decode(nullptr, 0, nullptr, 0));
+}
+
+TEST_CASE("qoi.roundtrip.plot")
+{
+    auto const pixels = plot(320, 200);
+    CHECK(roundtrip(pixels) == pixels);
+
+    // Compresses well.
+    CHECK(crispy::qoi::encode(pixels.data(), pixels.size() / 4).size() < pixels.size() / 8);
+}
+
+TEST_CASE("qoi.roundtrip.random")
+{
+    // Exercises all chunk types, including alpha changes and runs longer than a chunk holds.
+    auto rng = std::mt19937{42};
+    auto pixels = vector<uint8_t>();
+    while (pixels.size() < 4 * 100000)
+    {
+        auto const kind = rng() % 5;
+        auto const previous = pixels.empty() ? vector<uint8_t>{0, 0, 0, 255}
+                                             : vector<uint8_t>(pixels.end() - 4, pixels.end());
+        auto const repeat = kind == 0 ? 1 + rng() % 200 : 1;
+        for (unsigned i = 0; i < repeat; ++i)
+            for (int c = 0; c < 4; ++c)
+            {
+                auto const value = kind == 0 ? previous[c]
+                                 : kind == 1 ? static_cast<uint8_t>(previous[c] + rng() % 3 - 1)
+                                 : kind == 2 ? static_cast<uint8_t>(c == 3 ? previous[c] : previous[c] + rng() % 40 - 20)
+                                 : static_cast<uint8_t>(rng());
+                pixels.push_back(value);
+            }
+    }
+    CHECK(roundtrip(pixels) == pixels);
+}
+
+TEST_CASE("qoi.decode.truncated")
+{
+    auto const pixels = plot(64, 64);
+    auto const encoded = crispy::qoi::encode(pixels.data(), pixels.size() / 4);
+    auto decoded = vector<uint8_t>(pixels.size());
+    CHECK_FALSE(crispy::qoi::decode(encoded.data(), encoded.size() / 2, decoded.data(), pixels.size() / 4));
+}
+
+TEST_CASE("qoi.header")
+{
+    auto const header = crispy::qoi::header{ 1920, 1080, 3, 1 };
+    auto bytes = vector<uint8_t>(crispy::qoi::HeaderSize);
+    crispy::qoi::encodeHeader(header, bytes.data());
+    CHECK(bytes == vector<uint8_t>{ 'q', 'o', 'i', 'f', 0, 0, 0x07, 0x80, 0, 0, 0x04, 0x38, 3, 1 });
+
+    auto const decoded = crispy::qoi::decodeHeader(bytes.data(), bytes.size());
+    REQUIRE(decoded.has_value());
+    CHECK(decoded->width == 1920);
+    CHECK(decoded->height == 1080);
+    CHECK(decoded->channels == 3);
+    CHECK(decoded->colorspace == 1);
+
+    CHECK_FALSE(crispy::qoi::decodeHeader(bytes.data(), bytes.size() - 1).has_value());
+
+    bytes[12] = 2; // channels
+    CHECK_FALSE(crispy::qoi::decodeHeader(bytes.data(), bytes.size()).has_value());
+
+    bytes[12] = 4;
+    bytes[0] = 'Q';
+    CHECK_FALSE(crispy::qoi::decodeHeader(bytes.data(), bytes.size()).has_value());
+}
@@ -35,11 +35,15 @@ struct range
     constexpr const_iterator cend() const { return end_; }
 
     constexpr size_t size() const noexcept { return std::distance(begin_, end_); }
+    constexpr bool empty() const noexcept { return begin_ == end_; }
 };
 
 template <typename Iter>
 range(Iter, Iter) -> range<Iter>;
 
+template <typename Iter> constexpr Iter begin(range<Iter> const& _range) { return _range.begin(); }
+template <typename Iter> constexpr Iter end(range<Iter> const& _range) { return _range.end(); }
+
 template <typename Container>
 auto reversed(Container && _container)
 {
@@ -0,0 +1,243 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace crispy {
+
+template <typename T> class ring;
+
+template <typename Ring, typename T>
+class ring_iterator // {{{
+{
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::remove_const_t<T>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T*;
+    using reference = T&;
+
+    ring_iterator() noexcept = default;
+    ring_iterator(Ring* _ring, difference_type _index) noexcept : ring_{_ring}, index_{_index} {}
+
+    // Allows converting a mutable iterator into a const one.
+    template <typename R, typename U, std::enable_if_t<std::is_convertible_v<U*, T*>, int> = 0>
+    ring_iterator(ring_iterator<R, U> const& _other) noexcept : ring_{_other.ring_}, index_{_other.index_} {}
+
+    reference operator*() const noexcept { return (*ring_)[static_cast<size_t>(index_)]; }
+    pointer operator->() const noexcept { return &**this; }
+    reference operator[](difference_type _n) const noexcept { return *(*this + _n); }
+
+    ring_iterator& operator++() noexcept { ++index_; return *this; }
+    ring_iterator& operator--() noexcept { --index_; return *this; }
+    ring_iterator operator++(int) noexcept { auto old = *this; ++index_; return old; }
+    ring_iterator operator--(int) noexcept { auto old = *this; --index_; return old; }
+
+    ring_iterator& operator+=(difference_type _n) noexcept { index_ += _n; return *this; }
+    ring_iterator& operator-=(difference_type _n) noexcept { index_ -= _n; return *this; }
+
+    friend ring_iterator operator+(ring_iterator _i, difference_type _n) noexcept { return _i += _n; }
+    friend ring_iterator operator+(difference_type _n, ring_iterator _i) noexcept { return _i += _n; }
+    friend ring_iterator operator-(ring_iterator _i, difference_type _n) noexcept { return _i -= _n; }
+    friend difference_type operator-(ring_iterator const& a, ring_iterator const& b) noexcept { return a.index_ - b.index_; }
+
+    friend bool operator==(ring_iterator const& a, ring_iterator const& b) noexcept { return a.index_ == b.index_; }
+    friend bool operator!=(ring_iterator const& a, ring_iterator const& b) noexcept { return a.index_ != b.index_; }
+    friend bool operator<(ring_iterator const& a, ring_iterator const& b) noexcept { return a.index_ < b.index_; }
+    friend bool operator>(ring_iterator const& a, ring_iterator const& b) noexcept { return a.index_ > b.index_; }
+    friend bool operator<=(ring_iterator const& a, ring_iterator const& b) noexcept { return a.index_ <= b.index_; }
+    friend bool operator>=(ring_iterator const& a, ring_iterator const& b) noexcept { return a.index_ >= b.index_; }
+
+  private:
+    template <typename R, typename U> friend class ring_iterator;
+
+    Ring* ring_ = nullptr;
+    difference_type index_ = 0;
+};
+// }}}
+
+/// Sequence container with a ring buffer as storage.
+///
+/// Unlike std::deque, taking elements off the front and appending them to the back again
+/// (see rotate_left()) neither allocates nor destroys anything, which makes it a good fit
+/// for scrolling a fixed number of lines.
+///
+/// Iterators address elements by their logical position, so they remain valid
+/// across insertions and rotations, as long as that position exists.
+template <typename T>
+class ring {
+  public:
+    using value_type = T;
+    using size_type = size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = T&;
+    using const_reference = T const&;
+    using iterator = ring_iterator<ring<T>, T>;
+    using const_iterator = ring_iterator<ring<T> const, T const>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    ring() = default;
+    ring(size_t _count, T const& _value) : storage_(_count, _value), size_{_count} {}
+
+    ring(ring const&) = default;
+    ring& operator=(ring const&) = default;
+
+    ring(ring&& _other) noexcept :
+        storage_{std::move(_other.storage_)},
+        head_{std::exchange(_other.head_, 0)},
+        size_{std::exchange(_other.size_, 0)}
+    {}
+
+    ring& operator=(ring&& _other) noexcept
+    {
+        storage_ = std::move(_other.storage_);
+        head_ = std::exchange(_other.head_, 0);
+        size_ = std::exchange(_other.size_, 0);
+        return *this;
+    }
+
+    size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    size_t capacity() const noexcept { return storage_.size(); }
+
+    /// Ensures storage for at least @p _capacity elements, without constructing any new ones.
+    void reserve(size_t _capacity)
+    {
+        if (_capacity > capacity())
+            realign(_capacity);
+    }
+
+    T& operator[](size_t _i) noexcept { return storage_[physical(_i)]; }
+    T const& operator[](size_t _i) const noexcept { return storage_[physical(_i)]; }
+
+    T& front() noexcept { return (*this)[0]; }
+    T const& front() const noexcept { return (*this)[0]; }
+    T& back() noexcept { return (*this)[size_ - 1]; }
+    T const& back() const noexcept { return (*this)[size_ - 1]; }
+
+    iterator begin() noexcept { return iterator{this, 0}; }
+    iterator end() noexcept { return iterator{this, static_cast<difference_type>(size_)}; }
+    const_iterator begin() const noexcept { return const_iterator{this, 0}; }
+    const_iterator end() const noexcept { return const_iterator{this, static_cast<difference_type>(size_)}; }
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+
+    reverse_iterator rbegin() noexcept { return reverse_iterator{end()}; }
+    reverse_iterator rend() noexcept { return reverse_iterator{begin()}; }
+    const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator{end()}; }
+    const_reverse_iterator rend() const noexcept { return const_reverse_iterator{begin()}; }
+
+    void push_back(T const& _value) { emplace_back(_value); }
+    void push_back(T&& _value) { emplace_back(std::move(_value)); }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... _args)
+    {
+        if (size_ == capacity())
+            realign(std::max(size_t{1}, 2 * capacity()));
+
+        T& slot = storage_[physical(size_)];
+        slot = T(std::forward<Args>(_args)...);
+        ++size_;
+        return slot;
+    }
+
+    /// Removes the first @p _count elements.
+    void pop_front(size_t _count = 1)
+    {
+        assert(_count <= size_);
+        for (size_t i = 0; i < _count; ++i)
+            (*this)[i] = T{};
+        head_ = physical(_count);
+        size_ -= _count;
+    }
+
+    /// Moves the first @p _count elements to the back, preserving their order.
+    void rotate_left(size_t _count = 1)
+    {
+        assert(_count <= size_);
+        if (size_ == capacity())
+        {
+            head_ = physical(_count);
+            return;
+        }
+
+        // Move each front element into the unused slot right behind the back.
+        for (size_t i = 0; i < _count; ++i)
+        {
+            std::swap(storage_[head_], storage_[physical(size_)]);
+            head_ = physical(1);
+        }
+    }
+
+    void resize(size_t _count)
+    {
+        if (_count < size_)
+        {
+            for (size_t i = _count; i < size_; ++i)
+                (*this)[i] = T{};
+            size_ = _count;
+        }
+        else
+        {
+            reserve(_count);
+            for (size_t i = size_; i < _count; ++i)
+                storage_[physical(i)] = T{};
+            size_ = _count;
+        }
+    }
+
+    void clear()
+    {
+        storage_.clear();
+        head_ = 0;
+        size_ = 0;
+    }
+
+  private:
+    size_t physical(size_t _i) const noexcept
+    {
+        auto const i = head_ + _i;
+        return i < storage_.size() ? i : i - storage_.size();
+    }
+
+    /// Reallocates storage to the given capacity, with the front element being stored first.
+    void realign(size_t _capacity)
+    {
+        auto storage = std::vector<T>(_capacity);
+        for (size_t i = 0; i < size_; ++i)
+            storage[i] = std::move((*this)[i]);
+        storage_ = std::move(storage);
+        head_ = 0;
+    }
+
+    std::vector<T> storage_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+};
+
+template <typename T> auto begin(ring<T>& _ring) noexcept { return _ring.begin(); }
+template <typename T> auto end(ring<T>& _ring) noexcept { return _ring.end(); }
+template <typename T> auto begin(ring<T> const& _ring) noexcept { return _ring.cbegin(); }
+template <typename T> auto end(ring<T> const& _ring) noexcept { return _ring.cend(); }
+
+} // end namespace
@@ -0,0 +1,108 @@
+/**
+ * This file is part of the "contour" project.
+ *   Copyright (c) 2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/ring.h>
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using crispy::ring;
+using std::string;
+using std::vector;
+
+namespace // {{{ helper
+{
+    template <typename T>
+    vector<T> toVector(ring<T> const& _ring)
+    {
+        return vector<T>(_ring.begin(), _ring.end());
+    }
+} // }}}
+
+TEST_CASE("ring.push_back", "[ring]")
+{
+    auto r = ring<int>{};
+    CHECK(r.empty());
+
+    for (int i = 1; i <= 5; ++i)
+        r.push_back(i);
+
+    CHECK(r.size() == 5);
+    CHECK(r.front() == 1);
+    CHECK(r.back() == 5);
+    CHECK(toVector(r) == vector{1, 2, 3, 4, 5});
+    CHECK(vector<int>(r.rbegin(), r.rend()) == vector{5, 4, 3, 2, 1});
+}
+
+TEST_CASE("ring.pop_front", "[ring]")
+{
+    auto r = ring<int>{};
+    for (int i = 1; i <= 5; ++i)
+        r.push_back(i);
+
+    r.pop_front(2);
+    CHECK(toVector(r) == vector{3, 4, 5});
+
+    // Wraps around the end of the underlying storage.
+    r.push_back(6);
+    r.push_back(7);
+    CHECK(toVector(r) == vector{3, 4, 5, 6, 7});
+    CHECK(r[4] == 7);
+}
+
+TEST_CASE("ring.rotate_left", "[ring]")
+{
+    SECTION("full") {
+        auto r = ring<string>(3, "");
+        r[0] = "a"; r[1] = "b"; r[2] = "c";
+        REQUIRE(r.size() == r.capacity());
+        auto const* addressOfFront = &r.front();
+        r.rotate_left();
+        CHECK(toVector(r) == vector<string>{"b", "c", "a"});
+        CHECK(&r.back() == addressOfFront);
+    }
+
+    SECTION("with spare capacity") {
+        auto r = ring<string>{};
+        r.reserve(8);
+        r.push_back("a"); r.push_back("b"); r.push_back("c");
+        r.rotate_left(2);
+        CHECK(toVector(r) == vector<string>{"c", "a", "b"});
+        CHECK(r.capacity() == 8);
+    }
+}
+
+TEST_CASE("ring.iterators", "[ring]")
+{
+    auto r = ring<int>{};
+    r.reserve(4);
+    for (int i = 1; i <= 4; ++i)
+        r.push_back(i);
+    r.rotate_left();
+
+    auto const i = std::next(r.begin(), 1);
+    CHECK(*i == 3);
+    CHECK(r.end() - r.begin() == 4);
+
+    std::rotate(r.begin(), std::next(r.begin(), 2), r.end());
+    CHECK(toVector(r) == vector{4, 1, 2, 3});
+    CHECK(*i == 1);
+
+    r.resize(2);
+    CHECK(toVector(r) == vector{4, 1});
+    r.resize(3);
+    CHECK(toVector(r) == vector{4, 1, 0});
+}
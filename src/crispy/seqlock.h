@@ -0,0 +1,89 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace crispy {
+
+/// Sequence lock publishing a small value from a single writer to any number of readers.
+///
+/// Neither side ever blocks: the writer just bumps a sequence number around each store,
+/// and readers retry until they have copied the value without a store in between.
+/// This suits state that is read much more often than it changes, e.g. by the GUI thread,
+/// while being updated by the terminal thread.
+///
+/// The value is kept in atomic words, so that copying it while being stored is well defined.
+template <typename T>
+class seqlock {
+  public:
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    seqlock() noexcept : seqlock(T{}) {}
+    explicit seqlock(T const& _value) noexcept { store(_value); }
+
+    seqlock(seqlock const&) = delete;
+    seqlock& operator=(seqlock const&) = delete;
+
+    /// Publishes a new value. May only be invoked by the single writer.
+    void store(T const& _value) noexcept
+    {
+        Words words{};
+        std::memcpy(words.data(), &_value, sizeof(T));
+
+        auto const sequence = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WordCount; ++i)
+            words_[i].store(words[i], std::memory_order_relaxed);
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    /// @returns a consistent copy of the most recently published value.
+    T load() const noexcept
+    {
+        Words words{};
+        for (;;)
+        {
+            auto const before = sequence_.load(std::memory_order_acquire);
+            if (before & 1)
+                continue; // a store is in progress
+            for (size_t i = 0; i < WordCount; ++i)
+                words[i] = words_[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == before)
+                break;
+        }
+
+        T value{};
+        std::memcpy(static_cast<void*>(&value), words.data(), sizeof(T));
+        return value;
+    }
+
+    /// @returns the number of values published so far, including the initial one.
+    uint64_t version() const noexcept { return sequence_.load(std::memory_order_acquire) / 2; }
+
+  private:
+    static constexpr size_t WordCount = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    using Words = std::array<uint64_t, WordCount>;
+
+    std::atomic<uint64_t> sequence_ = 0;
+    std::array<std::atomic<uint64_t>, WordCount> words_{};
+};
+
+} // end namespace crispy
@@ -0,0 +1,75 @@
+/**
+ * This file is part of the "contour" project.
+ *   Copyright (c) 2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/seqlock.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+
+using crispy::seqlock;
+
+namespace // {{{ helper
+{
+    struct Pair {
+        int first = 0;
+        int second = 0;
+        char tag = 'x';
+    };
+} // }}}
+
+TEST_CASE("seqlock.store", "[seqlock]")
+{
+    auto s = seqlock<Pair>{};
+    CHECK(s.version() == 1);
+    CHECK(s.load().tag == 'x');
+
+    s.store(Pair{1, 2, 'a'});
+    auto const value = s.load();
+    CHECK(value.first == 1);
+    CHECK(value.second == 2);
+    CHECK(value.tag == 'a');
+    CHECK(s.version() == 2);
+}
+
+TEST_CASE("seqlock.threads", "[seqlock]")
+{
+    // Readers must never observe a value torn between two stores.
+    auto s = seqlock<Pair>{};
+    auto done = std::atomic<bool>{false};
+
+    auto writer = std::thread([&]() {
+        for (int i = 1; i <= 100000; ++i)
+            s.store(Pair{i, 2 * i, 'w'});
+        done = true;
+    });
+
+    int torn = 0;
+    int last = 0;
+    int regressions = 0;
+    while (!done)
+    {
+        auto const value = s.load();
+        if (value.second != 2 * value.first)
+            ++torn;
+        if (value.first < last)
+            ++regressions;
+        last = value.first;
+    }
+    writer.join();
+
+    CHECK(torn == 0);
+    CHECK(regressions == 0);
+    CHECK(s.load().first == 100000);
+}
@@ -0,0 +1,178 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace crispy {
+
+/// Thread-safe pool of memory blocks, handed out by size class and recycled once freed.
+///
+/// Block sizes are rounded up to a multiple of Granularity, each multiple being a size class.
+/// Freed blocks up to the largest pooled block size are kept on a free list per size class
+/// (as long as the pool holds less than its byte budget), and handed out again by the next
+/// allocation of the same size class. Larger blocks, and the ones beyond the budget,
+/// are returned to the global allocator right away.
+///
+/// All pools allocate from the global allocator with the same size classes, so that a block
+/// may be freed through another pool than the one it was allocated by.
+class size_class_pool {
+  public:
+    static constexpr size_t Granularity = 256;
+    static constexpr size_t DefaultMaxBlockSize = 64 * 1024;
+    static constexpr size_t DefaultMaxPooledBytes = 4 * 1024 * 1024;
+
+    struct statistics {
+        uint64_t allocations = 0; //!< blocks allocated in total
+        uint64_t reused = 0;      //!< blocks handed out from a free list
+        size_t pooled_bytes = 0;  //!< bytes currently kept on free lists
+    };
+
+    explicit size_class_pool(size_t _maxBlockSize = DefaultMaxBlockSize,
+                             size_t _maxPooledBytes = DefaultMaxPooledBytes):
+        freeLists_(class_of(_maxBlockSize) + 1, nullptr),
+        maxPooledBytes_{ _maxPooledBytes }
+    {}
+
+    ~size_class_pool() { release(); }
+
+    size_class_pool(size_class_pool const&) = delete;
+    size_class_pool& operator=(size_class_pool const&) = delete;
+
+    void* allocate(size_t _bytes)
+    {
+        auto const sizeClass = class_of(_bytes);
+        {
+            auto const _l = std::lock_guard{mutex_};
+            ++stats_.allocations;
+            if (sizeClass < freeLists_.size() && freeLists_[sizeClass])
+            {
+                ++stats_.reused;
+                stats_.pooled_bytes -= sizeClass * Granularity;
+                return std::exchange(freeLists_[sizeClass], freeLists_[sizeClass]->next);
+            }
+        }
+        return ::operator new(sizeClass * Granularity);
+    }
+
+    void deallocate(void* _block, size_t _bytes) noexcept
+    {
+        auto const sizeClass = class_of(_bytes);
+        if (sizeClass < freeLists_.size())
+        {
+            auto const _l = std::lock_guard{mutex_};
+            if (stats_.pooled_bytes + sizeClass * Granularity <= maxPooledBytes_)
+            {
+                freeLists_[sizeClass] = new (_block) free_block{freeLists_[sizeClass]};
+                stats_.pooled_bytes += sizeClass * Granularity;
+                return;
+            }
+        }
+        ::operator delete(_block);
+    }
+
+    /// Returns all pooled blocks to the global allocator.
+    void release() noexcept
+    {
+        auto const _l = std::lock_guard{mutex_};
+        for (auto& head: freeLists_)
+            while (head)
+                ::operator delete(std::exchange(head, head->next));
+        stats_.pooled_bytes = 0;
+    }
+
+    statistics stats() const
+    {
+        auto const _l = std::lock_guard{mutex_};
+        return stats_;
+    }
+
+    /// @returns the pool used by pool_allocator.
+    static size_class_pool& current() noexcept
+    {
+        // Never destroyed, as blocks may still be freed by static objects' destructors.
+        static auto* const defaultPool = new size_class_pool{};
+        auto* pool = currentPool().load(std::memory_order_acquire);
+        return pool ? *pool : *defaultPool;
+    }
+
+    /// Replaces the pool used by pool_allocator, e.g. by tests counting allocations,
+    /// or restores the default one if @p _pool is nullptr.
+    ///
+    /// The pool must outlive being installed, though blocks allocated from it may still be
+    /// freed afterwards.
+    ///
+    /// @returns the previously installed pool, or nullptr for the default one.
+    static size_class_pool* set_current(size_class_pool* _pool) noexcept
+    {
+        return currentPool().exchange(_pool, std::memory_order_acq_rel);
+    }
+
+  private:
+    struct free_block {
+        free_block* next;
+    };
+
+    static constexpr size_t class_of(size_t _bytes) noexcept
+    {
+        return (std::max(_bytes, size_t{1}) + Granularity - 1) / Granularity;
+    }
+
+    static std::atomic<size_class_pool*>& currentPool() noexcept
+    {
+        static auto pool = std::atomic<size_class_pool*>{nullptr};
+        return pool;
+    }
+
+    mutable std::mutex mutex_;
+    std::vector<free_block*> freeLists_; // indexed by size class
+    size_t maxPooledBytes_;
+    statistics stats_;
+};
+
+/// Standard allocator drawing its memory from size_class_pool::current().
+template <typename T>
+struct pool_allocator {
+    static_assert(alignof(T) <= alignof(std::max_align_t));
+
+    using value_type = T;
+
+    pool_allocator() noexcept = default;
+    template <typename U> pool_allocator(pool_allocator<U> const&) noexcept {}
+
+    T* allocate(size_t _count)
+    {
+        return static_cast<T*>(size_class_pool::current().allocate(_count * sizeof(T)));
+    }
+
+    void deallocate(T* _pointer, size_t _count) noexcept
+    {
+        size_class_pool::current().deallocate(_pointer, _count * sizeof(T));
+    }
+
+    template <typename U>
+    constexpr bool operator==(pool_allocator<U> const&) const noexcept { return true; }
+
+    template <typename U>
+    constexpr bool operator!=(pool_allocator<U> const&) const noexcept { return false; }
+};
+
+} // end namespace
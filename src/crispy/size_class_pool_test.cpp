@@ -0,0 +1,81 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/size_class_pool.h>
+
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+#include <vector>
+
+using crispy::pool_allocator;
+using crispy::size_class_pool;
+
+TEST_CASE("size_class_pool.reuse", "[size_class_pool]")
+{
+    auto pool = size_class_pool{};
+
+    auto* a = pool.allocate(100);
+    pool.deallocate(a, 100);
+    CHECK(pool.stats().pooled_bytes == size_class_pool::Granularity);
+
+    // Same size class.
+    CHECK(pool.allocate(200) == a);
+    CHECK(pool.stats().reused == 1);
+    CHECK(pool.stats().pooled_bytes == 0);
+
+    // Other size class.
+    auto* b = pool.allocate(300);
+    CHECK(pool.stats().reused == 1);
+    CHECK(pool.stats().allocations == 3);
+
+    pool.deallocate(a, 200);
+    pool.deallocate(b, 300);
+    CHECK(pool.stats().pooled_bytes == 3 * size_class_pool::Granularity);
+    pool.release();
+    CHECK(pool.stats().pooled_bytes == 0);
+}
+
+TEST_CASE("size_class_pool.limits", "[size_class_pool]")
+{
+    auto pool = size_class_pool{1024, 2048};
+
+    // Blocks beyond the largest pooled block size are not kept.
+    pool.deallocate(pool.allocate(2000), 2000);
+    CHECK(pool.stats().pooled_bytes == 0);
+
+    // Neither are blocks beyond the budget.
+    auto blocks = std::vector<void*>{};
+    for (int i = 0; i < 4; ++i)
+        blocks.push_back(pool.allocate(1000));
+    for (void* block: blocks)
+        pool.deallocate(block, 1000);
+    CHECK(pool.stats().pooled_bytes == 2048);
+}
+
+TEST_CASE("size_class_pool.allocator", "[size_class_pool]")
+{
+    auto pool = size_class_pool{};
+    auto* const previous = size_class_pool::set_current(&pool);
+
+    {
+        auto cells = std::vector<uint64_t, pool_allocator<uint64_t>>(80);
+        cells.clear();
+        cells.shrink_to_fit();
+        cells.resize(80);
+    }
+    CHECK(pool.stats().allocations == 2);
+    CHECK(pool.stats().reused == 1);
+
+    CHECK(size_class_pool::set_current(previous) == &pool);
+}
@@ -20,6 +20,15 @@ namespace crispy {
 
 namespace detail
 {
+    // std::swap() is not constexpr prior to C++20.
+    template <typename T>
+    constexpr void swap(T& _a, T& _b)
+    {
+        T t = std::move(_a);
+        _a = std::move(_b);
+        _b = std::move(t);
+    }
+
     template <typename Container, typename Comp, typename size_type>
     constexpr size_type partition(Container& _container, Comp _compare, size_type _low, size_type _high)
     {
@@ -31,12 +40,12 @@ namespace detail
             if (_compare(_container[j], pivot) <= 0)
             {
                 i++;
-                std::swap(_container[i], _container[j]);
+                detail::swap(_container[i], _container[j]);
             }
         }
 
         i++;
-        std::swap(_container[i], _container[_high]);
+        detail::swap(_container[i], _container[_high]);
         return i;
     }
 }
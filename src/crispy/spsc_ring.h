@@ -0,0 +1,132 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <crispy/span.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace crispy {
+
+/// Lock-free ring buffer shared between exactly one producer thread and one consumer thread.
+///
+/// The producer fills the contiguous free space returned by writable() in place and publishes
+/// it via commit(). The consumer processes the contiguous data returned by readable() in place
+/// and releases it via consume(). Neither side ever waits for the other.
+///
+/// The capacity is rounded up to the next power of two.
+template <typename T>
+class spsc_ring {
+  public:
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    explicit spsc_ring(size_t _capacity) :
+        storage_(round_up(_capacity)),
+        mask_{storage_.size() - 1}
+    {}
+
+    spsc_ring(spsc_ring const&) = delete;
+    spsc_ring& operator=(spsc_ring const&) = delete;
+
+    size_t capacity() const noexcept { return storage_.size(); }
+
+    /// Number of elements committed but not yet consumed.
+    ///
+    /// Exact when invoked by either side, a snapshot when invoked by any other thread.
+    size_t size() const noexcept
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const noexcept { return size() == 0; }
+
+    /// @returns the contiguous free space behind the last committed element.
+    /// May only be invoked by the producer.
+    span<T> writable() noexcept
+    {
+        auto const head = head_.load(std::memory_order_relaxed);
+        auto const tail = tail_.load(std::memory_order_acquire);
+        auto const offset = head & mask_;
+        auto const count = std::min(capacity() - (head - tail), capacity() - offset);
+        return span<T>(storage_.data() + offset, count);
+    }
+
+    /// Publishes the first @p _count elements of writable() to the consumer.
+    /// May only be invoked by the producer.
+    void commit(size_t _count) noexcept
+    {
+        head_.store(head_.load(std::memory_order_relaxed) + _count, std::memory_order_release);
+    }
+
+    /// Copies as many of the given elements into the ring as there is space for.
+    /// May only be invoked by the producer.
+    ///
+    /// @returns the number of elements copied.
+    size_t push(T const* _data, size_t _count) noexcept
+    {
+        size_t pushed = 0;
+        while (pushed < _count)
+        {
+            auto space = writable();
+            if (space.empty())
+                break;
+            auto const n = std::min(space.size(), _count - pushed);
+            std::copy_n(_data + pushed, n, space.begin());
+            commit(n);
+            pushed += n;
+        }
+        return pushed;
+    }
+
+    /// @returns the contiguous committed data in front of the ring.
+    /// May only be invoked by the consumer.
+    span<T const> readable() const noexcept
+    {
+        auto const tail = tail_.load(std::memory_order_relaxed);
+        auto const head = head_.load(std::memory_order_acquire);
+        auto const offset = tail & mask_;
+        auto const count = std::min(head - tail, capacity() - offset);
+        return span<T const>(storage_.data() + offset, count);
+    }
+
+    /// Releases the first @p _count elements of readable() back to the producer.
+    /// May only be invoked by the consumer.
+    void consume(size_t _count) noexcept
+    {
+        tail_.store(tail_.load(std::memory_order_relaxed) + _count, std::memory_order_release);
+    }
+
+  private:
+    static size_t round_up(size_t _capacity) noexcept
+    {
+        size_t result = 1;
+        while (result < _capacity)
+            result <<= 1;
+        return result;
+    }
+
+    std::vector<T> storage_;
+    size_t mask_;
+
+    // Both positions only ever grow, and are kept on separate cache lines,
+    // as each one is written by a different thread.
+    alignas(64) std::atomic<size_t> head_ = 0;
+    alignas(64) std::atomic<size_t> tail_ = 0;
+};
+
+} // end namespace
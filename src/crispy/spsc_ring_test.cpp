@@ -0,0 +1,92 @@
+/**
+ * This file is part of the "contour" project.
+ *   Copyright (c) 2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/spsc_ring.h>
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <string_view>
+#include <thread>
+
+using crispy::spsc_ring;
+using std::string;
+using std::string_view;
+
+namespace // {{{ helper
+{
+    string readAll(spsc_ring<char>& _ring)
+    {
+        string result;
+        while (!_ring.empty())
+        {
+            auto const data = _ring.readable();
+            result.append(data.begin(), data.end());
+            _ring.consume(data.size());
+        }
+        return result;
+    }
+} // }}}
+
+TEST_CASE("spsc_ring.push", "[spsc_ring]")
+{
+    auto r = spsc_ring<char>{6};
+    CHECK(r.capacity() == 8);
+    CHECK(r.empty());
+
+    CHECK(r.push("abcde", 5) == 5);
+    CHECK(r.size() == 5);
+    CHECK(r.push("fghij", 5) == 3); // full
+    CHECK(r.writable().empty());
+
+    auto const data = r.readable();
+    CHECK(string_view(data.begin(), data.size()) == "abcdefgh");
+}
+
+TEST_CASE("spsc_ring.wrap_around", "[spsc_ring]")
+{
+    auto r = spsc_ring<char>{8};
+    r.push("abcdef", 6);
+    r.consume(4);
+    CHECK(r.push("ghijkl", 6) == 6);
+
+    // Data wrapping around the end is handed out in two contiguous parts.
+    CHECK(r.readable().size() == 4);
+    CHECK(readAll(r) == "efghijkl");
+    CHECK(r.writable().size() == 8 - 4);
+}
+
+TEST_CASE("spsc_ring.threads", "[spsc_ring]")
+{
+    auto r = spsc_ring<char>{64};
+    auto expected = string{};
+    for (int i = 0; i < 10000; ++i)
+        expected += static_cast<char>('a' + i % 26);
+
+    auto producer = std::thread([&]() {
+        size_t written = 0;
+        while (written < expected.size())
+            written += r.push(expected.data() + written, expected.size() - written);
+    });
+
+    auto received = string{};
+    while (received.size() < expected.size())
+    {
+        auto const data = r.readable();
+        received.append(data.begin(), data.end());
+        r.consume(data.size());
+    }
+    producer.join();
+
+    CHECK(received == expected);
+}
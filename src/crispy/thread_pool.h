@@ -0,0 +1,273 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace crispy {
+
+enum class task_priority {
+    background,     // e.g. trimming memory, persisting sessions
+    normal,         // e.g. searching, extracting the selection
+    interactive,    // e.g. rendering the frame about to be shown
+};
+
+/// Asks tasks sharing it to stop early, or not to start at all.
+///
+/// Copies share the same state, so that the token handed to a task can be cancelled by its owner.
+class cancellation_token {
+  public:
+    cancellation_token(): cancelled_{ std::make_shared<std::atomic<bool>>(false) } {}
+
+    void cancel() const noexcept { cancelled_->store(true, std::memory_order_relaxed); }
+    bool cancelled() const noexcept { return cancelled_->load(std::memory_order_relaxed); }
+
+  private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+struct task_options {
+    task_priority priority = task_priority::normal;
+
+    /// Tasks of the same non-zero affinity (e.g. the address of a terminal session) are queued to
+    /// the same thread, keeping their data in its caches, unless idle threads steal them.
+    uint64_t affinity = 0;
+
+    /// Skips the task if cancelled before it started.
+    std::optional<cancellation_token> token = std::nullopt;
+};
+
+/// Runs the background work of all subsystems on a bounded set of threads.
+///
+/// Each thread has its own queues, one per task_priority, and steals from the other threads'
+/// queues once its own are empty. Higher priority tasks are picked first, from any queue.
+/// Tasks are not to block for long (e.g. on I/O), as they would hold up others.
+class thread_pool {
+  public:
+    /// @param _threadCount number of threads, at least one.
+    explicit thread_pool(unsigned _threadCount)
+    {
+        for (unsigned i = 0; i < std::max(1u, _threadCount); ++i)
+            workers_.emplace_back(std::make_unique<worker>());
+        for (size_t i = 0; i < workers_.size(); ++i)
+            workers_[i]->thread = std::thread([this, i]() { loop(i); });
+    }
+
+    /// Waits for the running tasks to finish and drops the queued ones.
+    ~thread_pool()
+    {
+        {
+            auto _l = std::scoped_lock{sleepLock_};
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker: workers_)
+            worker->thread.join();
+    }
+
+    thread_pool(thread_pool const&) = delete;
+    thread_pool& operator=(thread_pool const&) = delete;
+
+    /// The pool shared by the whole process, with one thread less than the hardware supports,
+    /// as the caller of parallel_for() joins in.
+    static thread_pool& shared()
+    {
+        static thread_pool pool{ std::max(2u, std::thread::hardware_concurrency()) - 1 };
+        return pool;
+    }
+
+    size_t thread_count() const noexcept { return workers_.size(); }
+
+    /// Queues @p _task, which must not throw.
+    void post(std::function<void()> _task, task_options _options = {})
+    {
+        // Affinities are scrambled (Fibonacci hashing), as addresses share their lowest bits.
+        auto const index = _options.affinity != 0
+                         ? ((_options.affinity * 0x9E3779B97F4A7C15ull) >> 32) % workers_.size()
+                         : nextWorker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+        auto& target = *workers_[index];
+        {
+            auto _l = std::scoped_lock{target.lock};
+            target.queues[static_cast<size_t>(_options.priority)].push_back(
+                queued_task{ std::move(_task), std::move(_options.token) });
+        }
+        {
+            auto _l = std::scoped_lock{sleepLock_};
+            ++pending_;
+        }
+        wake_.notify_one();
+    }
+
+    /// Queues @p _task, with its result or exception handed over by the returned future.
+    /// The future also becomes ready if the task is skipped, see task_options::token.
+    template <typename F>
+    auto submit(F&& _task, task_options _options = {}) -> std::future<decltype(_task())>
+    {
+        using result = decltype(_task());
+        auto task = std::make_shared<std::packaged_task<result()>>(std::forward<F>(_task));
+        auto future = task->get_future();
+        post([task]() { (*task)(); }, std::move(_options));
+        return future;
+    }
+
+    /// Invokes @p _task for each index in [0, @p _count), spread across the calling thread
+    /// and the pool, and returns once all of them are done.
+    ///
+    /// May be invoked from within tasks, too, as the calling thread works on the indices
+    /// the pool did not get to yet. The first exception thrown by @p _task is rethrown.
+    void parallel_for(size_t _count,
+                      std::function<void(size_t)> const& _task,
+                      task_priority _priority = task_priority::interactive)
+    {
+        if (_count <= 1)
+        {
+            for (size_t i = 0; i < _count; ++i)
+                _task(i);
+            return;
+        }
+
+        auto state = std::make_shared<parallel_state>(_task, _count);
+        for (size_t i = 0, e = std::min(_count - 1, workers_.size()); i < e; ++i)
+            post([state]() { state->work(); }, task_options{ _priority });
+        state->work();
+
+        auto lock = std::unique_lock{state->lock};
+        state->done.wait(lock, [&]() { return state->finished == _count; });
+        if (state->error)
+            std::rethrow_exception(state->error);
+    }
+
+  private:
+    static constexpr size_t PriorityCount = 3;
+
+    struct queued_task {
+        std::function<void()> run;
+        std::optional<cancellation_token> token;
+    };
+
+    struct worker {
+        std::mutex lock;
+        std::array<std::deque<queued_task>, PriorityCount> queues;  // by task_priority
+        std::thread thread;
+    };
+
+    struct parallel_state {
+        parallel_state(std::function<void(size_t)> const& _task, size_t _count): task{ _task }, count{ _count } {}
+
+        // Helpers starting after all indices got picked up return right away,
+        // and thus never touch the task, which may be gone by then.
+        void work()
+        {
+            for (auto i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+            {
+                auto thrown = std::exception_ptr{};
+                try
+                {
+                    task(i);
+                }
+                catch (...)
+                {
+                    thrown = std::current_exception();
+                }
+
+                auto _l = std::scoped_lock{lock};
+                if (thrown && !error)
+                    error = thrown;
+                if (++finished == count)
+                    done.notify_all();
+            }
+        }
+
+        std::function<void(size_t)> const& task;
+        size_t const count;
+        std::atomic<size_t> next = 0;
+        std::mutex lock;
+        std::condition_variable done;
+        size_t finished = 0;
+        std::exception_ptr error;
+    };
+
+    /// Takes the next task of the highest priority, preferably off the front of @p _index's queue,
+    /// or otherwise off the back of another thread's.
+    std::optional<queued_task> take(size_t _index)
+    {
+        for (size_t priority = PriorityCount; priority-- > 0; )
+        {
+            for (size_t i = 0; i < workers_.size(); ++i)
+            {
+                auto& victim = *workers_[(_index + i) % workers_.size()];
+                auto _l = std::scoped_lock{victim.lock};
+                auto& queue = victim.queues[priority];
+                if (queue.empty())
+                    continue;
+                auto task = std::optional<queued_task>{};
+                if (i == 0)
+                {
+                    task.emplace(std::move(queue.front()));
+                    queue.pop_front();
+                }
+                else
+                {
+                    task.emplace(std::move(queue.back()));
+                    queue.pop_back();
+                }
+                pending_.fetch_sub(1);
+                return task;
+            }
+        }
+        return std::nullopt;
+    }
+
+    void loop(size_t _index)
+    {
+        for (;;)
+        {
+            if (auto task = take(_index); task.has_value())
+            {
+                if (!task->token || !task->token->cancelled())
+                    task->run();
+                continue;
+            }
+
+            auto lock = std::unique_lock{sleepLock_};
+            wake_.wait(lock, [this]() { return stopping_ || pending_.load() != 0; });
+            if (stopping_)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<worker>> workers_;
+    std::atomic<size_t> nextWorker_ = 0;    // to queue tasks without affinity to, round robin
+    std::atomic<size_t> pending_ = 0;       // number of tasks queued, incremented under sleepLock_
+    std::mutex sleepLock_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+};
+
+} // end namespace
@@ -0,0 +1,148 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/thread_pool.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using crispy::cancellation_token;
+using crispy::task_options;
+using crispy::task_priority;
+using crispy::thread_pool;
+using std::vector;
+
+namespace
+{
+    /// Keeps the (only) thread of a pool busy until released.
+    struct blocker {
+        explicit blocker(thread_pool& _pool)
+        {
+            _pool.post([this]() {
+                started.set_value();
+                released.get_future().wait();
+            });
+            started.get_future().wait();
+        }
+
+        void release() { released.set_value(); }
+
+        std::promise<void> started;
+        std::promise<void> released;
+    };
+}
+
+TEST_CASE("thread_pool.submit", "[thread_pool]")
+{
+    auto pool = thread_pool{2};
+    CHECK(pool.thread_count() == 2);
+
+    auto answer = pool.submit([]() { return 42; });
+    CHECK(answer.get() == 42);
+
+    auto failure = pool.submit([]() -> int { throw std::runtime_error("failed"); });
+    CHECK_THROWS_AS(failure.get(), std::runtime_error);
+}
+
+TEST_CASE("thread_pool.priorities", "[thread_pool]")
+{
+    auto pool = thread_pool{1};
+    auto order = vector<task_priority>{};
+    auto orderLock = std::mutex{};
+    auto const record = [&](task_priority _priority) {
+        return [&, _priority]() {
+            auto _l = std::scoped_lock{orderLock};
+            order.push_back(_priority);
+        };
+    };
+
+    auto gate = blocker{pool};
+    pool.post(record(task_priority::background), task_options{task_priority::background});
+    pool.post(record(task_priority::normal), task_options{task_priority::normal});
+    auto last = pool.submit(record(task_priority::interactive), task_options{task_priority::interactive});
+    pool.post(record(task_priority::background), task_options{task_priority::background});
+    gate.release();
+
+    // Submitted last, but of the highest priority.
+    last.wait();
+    auto done = pool.submit([]() {}, task_options{task_priority::background});
+    done.wait();
+
+    CHECK(order == vector{task_priority::interactive,
+                          task_priority::normal,
+                          task_priority::background,
+                          task_priority::background});
+}
+
+TEST_CASE("thread_pool.cancellation", "[thread_pool]")
+{
+    auto pool = thread_pool{1};
+    auto token = cancellation_token{};
+    auto calls = std::atomic<int>{0};
+
+    auto gate = blocker{pool};
+    auto skipped = pool.submit([&]() { ++calls; }, task_options{task_priority::normal, 0, token});
+    token.cancel();
+    gate.release();
+
+    // Becomes ready without the task having run.
+    CHECK_THROWS_AS(skipped.get(), std::future_error);
+    CHECK(calls.load() == 0);
+    CHECK(token.cancelled());
+}
+
+TEST_CASE("thread_pool.affinity", "[thread_pool]")
+{
+    auto pool = thread_pool{4};
+    auto calls = std::atomic<int>{0};
+    auto futures = vector<std::future<void>>{};
+    for (uint64_t session = 1; session <= 3; ++session)
+        for (int i = 0; i < 10; ++i)
+            futures.emplace_back(pool.submit([&]() { ++calls; }, task_options{task_priority::normal, session}));
+    for (auto& future: futures)
+        future.get();
+    CHECK(calls.load() == 30);
+}
+
+TEST_CASE("thread_pool.parallel_for", "[thread_pool]")
+{
+    auto pool = thread_pool{3};
+
+    for (size_t round = 0; round <= 50; ++round)
+    {
+        auto counts = vector<std::atomic<int>>(round * 7);
+        pool.parallel_for(counts.size(), [&](size_t i) { ++counts[i]; });
+        for (auto const& count: counts)
+            REQUIRE(count.load() == 1);
+    }
+
+    CHECK_THROWS_AS(pool.parallel_for(8, [](size_t i) { if (i == 5) throw std::runtime_error("failed"); }),
+                    std::runtime_error);
+}
+
+TEST_CASE("thread_pool.parallel_for.nested", "[thread_pool]")
+{
+    // All threads of the pool wait for their inner loops, which thus must be done by the callers.
+    auto pool = thread_pool{2};
+    auto calls = std::atomic<int>{0};
+    pool.parallel_for(4, [&](size_t) {
+        pool.parallel_for(4, [&](size_t) { ++calls; });
+    });
+    CHECK(calls.load() == 16);
+}
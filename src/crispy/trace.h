@@ -0,0 +1,173 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace crispy {
+
+/// Records the time spent in named phases of the process, such as the steps of starting up,
+/// to be reported as Chrome trace events (see chrome://tracing or ui.perfetto.dev) or as a table.
+///
+/// Recording is disabled by default, costing a single relaxed atomic load per phase.
+class trace_recorder {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    struct span {
+        std::string name;
+        unsigned thread;            // 1-based, in order of first appearance
+        clock::duration start;      // relative to when recording has been enabled
+        clock::duration duration;
+    };
+
+    static trace_recorder& get()
+    {
+        static trace_recorder instance;
+        return instance;
+    }
+
+    bool enabled() const noexcept { return enabled_.load(std::memory_order_relaxed); }
+
+    /// Enables or disables recording.
+    ///
+    /// Enabling starts a new recording, discarding the phases recorded so far.
+    void enable(bool _enable)
+    {
+        auto _l = std::scoped_lock{lock_};
+        if (_enable && !enabled())
+        {
+            origin_ = clock::now();
+            spans_.clear();
+        }
+        enabled_.store(_enable, std::memory_order_relaxed);
+    }
+
+    /// Records the phase @p _name, having taken from @p _start to @p _end.
+    void record(std::string_view _name, clock::time_point _start, clock::time_point _end)
+    {
+        auto _l = std::scoped_lock{lock_};
+        if (!enabled())
+            return;
+
+        auto const threadId = std::this_thread::get_id();
+        auto thread = std::find(threads_.begin(), threads_.end(), threadId);
+        if (thread == threads_.end())
+            thread = threads_.insert(threads_.end(), threadId);
+
+        spans_.push_back(span{std::string(_name),
+                              static_cast<unsigned>(thread - threads_.begin()) + 1,
+                              _start - origin_,
+                              _end - _start});
+    }
+
+    /// @returns the phases recorded so far, in order of their start, enclosing phases first.
+    std::vector<span> spans() const
+    {
+        auto _l = std::scoped_lock{lock_};
+        auto result = spans_;
+        std::stable_sort(result.begin(), result.end(), [](span const& a, span const& b) {
+            return a.start < b.start || (a.start == b.start && a.duration > b.duration);
+        });
+        return result;
+    }
+
+    /// @returns the phases recorded so far as a Chrome trace event JSON document.
+    std::string trace_events() const
+    {
+        auto const microseconds = [](clock::duration _value) {
+            return std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(_value).count();
+        };
+
+        std::string out = "{\"traceEvents\":[";
+        for (auto const& s: spans())
+        {
+            if (out.back() != '[')
+                out += ',';
+            out += fmt::format("\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                               escaped(s.name), s.thread, microseconds(s.start), microseconds(s.duration));
+        }
+        out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+        return out;
+    }
+
+    /// @returns the phases recorded so far as a human readable table.
+    std::string table() const
+    {
+        auto const milliseconds = [](clock::duration _value) {
+            return std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(_value).count();
+        };
+
+        auto out = fmt::format("{:<32} {:>6} {:>10} {:>10}\n", "phase", "thread", "start", "duration");
+        for (auto const& s: spans())
+            out += fmt::format("{:<32} {:>6} {:>8.3f}ms {:>8.3f}ms\n",
+                               s.name, s.thread, milliseconds(s.start), milliseconds(s.duration));
+        return out;
+    }
+
+  private:
+    static std::string escaped(std::string_view _text)
+    {
+        std::string result;
+        for (char const ch: _text)
+        {
+            if (ch == '"' || ch == '\\')
+                result += '\\';
+            result += ch;
+        }
+        return result;
+    }
+
+    std::atomic<bool> enabled_ = false;
+    mutable std::mutex lock_;
+    clock::time_point origin_ = clock::now();
+    std::vector<std::thread::id> threads_;
+    std::vector<span> spans_;
+};
+
+/// Records its own lifetime as the phase of the given name, if recording is enabled.
+class trace_scope {
+  public:
+    /// @param _name name of the phase, which must outlive this object, e.g. a string literal.
+    explicit trace_scope(std::string_view _name) :
+        name_{ _name },
+        start_{ trace_recorder::get().enabled() ? trace_recorder::clock::now() : trace_recorder::clock::time_point{} }
+    {
+    }
+
+    ~trace_scope()
+    {
+        if (start_ != trace_recorder::clock::time_point{})
+            trace_recorder::get().record(name_, start_, trace_recorder::clock::now());
+    }
+
+    trace_scope(trace_scope const&) = delete;
+    trace_scope& operator=(trace_scope const&) = delete;
+
+  private:
+    std::string_view name_;
+    trace_recorder::clock::time_point start_;
+};
+
+} // end namespace
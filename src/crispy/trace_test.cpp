@@ -0,0 +1,64 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/trace.h>
+
+#include <catch2/catch.hpp>
+
+#include <string>
+
+using crispy::trace_recorder;
+using crispy::trace_scope;
+using std::string;
+
+TEST_CASE("trace_recorder.disabled", "[trace]")
+{
+    auto& recorder = trace_recorder::get();
+    recorder.enable(true);
+    recorder.enable(false);
+
+    {
+        auto const _trace = trace_scope("ignored");
+    }
+
+    CHECK(recorder.spans().empty());
+}
+
+TEST_CASE("trace_recorder.spans", "[trace]")
+{
+    auto& recorder = trace_recorder::get();
+    recorder.enable(true);
+
+    {
+        auto const _outer = trace_scope("outer");
+        auto const _inner = trace_scope("inner \"quoted\"");
+    }
+    recorder.enable(false);
+
+    auto const spans = recorder.spans();
+    REQUIRE(spans.size() == 2);
+    auto const& outer = spans[0];
+    auto const& inner = spans[1];
+    CHECK(outer.name == "outer");
+    CHECK(inner.name == "inner \"quoted\"");
+    CHECK(outer.thread == inner.thread);
+    CHECK(outer.start <= inner.start);
+    CHECK(outer.duration >= inner.duration);
+
+    auto const json = recorder.trace_events();
+    CHECK(json.find("{\"traceEvents\":[") == 0);
+    CHECK(json.find("\"name\":\"outer\",\"ph\":\"X\"") != string::npos);
+    CHECK(json.find("\"name\":\"inner \\\"quoted\\\"\"") != string::npos);
+
+    CHECK(recorder.table().find("outer") != string::npos);
+}
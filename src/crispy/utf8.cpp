@@ -0,0 +1,111 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/utf8.h>
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+    #include <emmintrin.h>
+    #define CRISPY_UTF8_SSE2 1
+#endif
+
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && (defined(__aarch64__) || defined(_M_ARM64))
+    #include <arm_neon.h>
+    #define CRISPY_UTF8_NEON 1
+#endif
+
+using std::string;
+using std::u32string_view;
+
+namespace crispy::utf8 {
+
+namespace // {{{ helper
+{
+    /// Narrows the leading US-ASCII codepoints of @p _input, 16 at a time, into @p _output.
+    /// Stops at the first batch containing any other codepoint.
+    ///
+    /// @returns the number of codepoints consumed, which equals the number of bytes written.
+    size_t encodeAsciiBlocks([[maybe_unused]] char32_t const* _input,
+                             [[maybe_unused]] size_t _count,
+                             [[maybe_unused]] char* _output) noexcept
+    {
+        size_t i = 0;
+
+#if defined(CRISPY_UTF8_SSE2)
+        auto const nonAscii = _mm_set1_epi32(~0x7F);
+        for (; i + 16 <= _count; i += 16)
+        {
+            auto const input = reinterpret_cast<__m128i const*>(_input + i);
+            auto const a = _mm_loadu_si128(input + 0);
+            auto const b = _mm_loadu_si128(input + 1);
+            auto const c = _mm_loadu_si128(input + 2);
+            auto const d = _mm_loadu_si128(input + 3);
+            auto const any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(any, nonAscii), _mm_setzero_si128())) != 0xFFFF)
+                break;
+            // All lanes are below 0x80, so neither pack saturates.
+            auto const bytes = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(_output + i), bytes);
+        }
+#elif defined(CRISPY_UTF8_NEON)
+        for (; i + 16 <= _count; i += 16)
+        {
+            auto const input = reinterpret_cast<uint32_t const*>(_input + i);
+            auto const a = vld1q_u32(input + 0);
+            auto const b = vld1q_u32(input + 4);
+            auto const c = vld1q_u32(input + 8);
+            auto const d = vld1q_u32(input + 12);
+            if (vmaxvq_u32(vorrq_u32(vorrq_u32(a, b), vorrq_u32(c, d))) >= 0x80)
+                break;
+            auto const lower = vcombine_u16(vmovn_u32(a), vmovn_u32(b));
+            auto const upper = vcombine_u16(vmovn_u32(c), vmovn_u32(d));
+            vst1q_u8(reinterpret_cast<uint8_t*>(_output + i), vcombine_u8(vmovn_u16(lower), vmovn_u16(upper)));
+        }
+#endif
+
+        return i;
+    }
+} // }}}
+
+size_t encode(u32string_view _input, char* _output) noexcept
+{
+    auto const input = _input.data();
+    auto const count = _input.size();
+    auto output = _output;
+
+    size_t i = 0;
+    while (i < count)
+    {
+        auto const asciiCount = encodeAsciiBlocks(input + i, count - i, output);
+        i += asciiCount;
+        output += asciiCount;
+
+        // Encodes the batch the vectorized path stopped at (or the tail) one by one.
+        auto const end = std::min(i + 16, count);
+        for (; i < end; ++i)
+            output += encode(input[i], output);
+    }
+
+    return static_cast<size_t>(output - _output);
+}
+
+void append(string& _output, u32string_view _input)
+{
+    auto const offset = _output.size();
+    _output.resize(offset + encodedSizeMax(_input.size()));
+    _output.resize(offset + encode(_input, _output.data() + offset));
+}
+
+} // end namespace
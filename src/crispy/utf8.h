@@ -0,0 +1,82 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/// Bulk UTF-32 to UTF-8 transcoding, as used for extracting text out of the grid.
+namespace crispy::utf8 {
+
+/// @returns the maximum number of bytes @p _count codepoints are encoded to.
+constexpr size_t encodedSizeMax(size_t _count) noexcept { return _count * 4; }
+
+/// @returns the number of bytes @p _codepoint is encoded to.
+constexpr size_t encodedSize(char32_t _codepoint) noexcept
+{
+    return _codepoint < 0x80 ? 1
+         : _codepoint < 0x800 ? 2
+         : _codepoint < 0x10000 ? 3
+         : 4;
+}
+
+/// Encodes @p _codepoint into @p _output, which must have room for encodedSize(_codepoint) bytes.
+///
+/// @returns the number of bytes written.
+constexpr size_t encode(char32_t _codepoint, char* _output) noexcept
+{
+    if (_codepoint < 0x80)
+    {
+        _output[0] = static_cast<char>(_codepoint);
+        return 1;
+    }
+    if (_codepoint < 0x800)
+    {
+        _output[0] = static_cast<char>(0xC0 | (_codepoint >> 6));
+        _output[1] = static_cast<char>(0x80 | (_codepoint & 0x3F));
+        return 2;
+    }
+    if (_codepoint < 0x10000)
+    {
+        _output[0] = static_cast<char>(0xE0 | (_codepoint >> 12));
+        _output[1] = static_cast<char>(0x80 | ((_codepoint >> 6) & 0x3F));
+        _output[2] = static_cast<char>(0x80 | (_codepoint & 0x3F));
+        return 3;
+    }
+    _output[0] = static_cast<char>(0xF0 | ((_codepoint >> 18) & 0x07));
+    _output[1] = static_cast<char>(0x80 | ((_codepoint >> 12) & 0x3F));
+    _output[2] = static_cast<char>(0x80 | ((_codepoint >> 6) & 0x3F));
+    _output[3] = static_cast<char>(0x80 | (_codepoint & 0x3F));
+    return 4;
+}
+
+/// Encodes @p _input into @p _output, which must have room for encodedSizeMax(_input.size()) bytes.
+/// Runs of US-ASCII codepoints are narrowed many at a time.
+///
+/// @returns the number of bytes written.
+size_t encode(std::u32string_view _input, char* _output) noexcept;
+
+/// Appends @p _input, encoded as UTF-8, to @p _output, growing it at most once.
+void append(std::string& _output, std::u32string_view _input);
+
+/// @returns @p _input encoded as UTF-8.
+inline std::string encode(std::u32string_view _input)
+{
+    auto output = std::string();
+    append(output, _input);
+    return output;
+}
+
+} // end namespace
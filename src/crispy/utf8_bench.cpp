@@ -0,0 +1,57 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/benchmark.h>
+#include <crispy/utf8.h>
+
+#include <fmt/format.h>
+
+#include <string>
+#include <vector>
+
+using crispy::benchmark::do_not_optimize;
+using crispy::benchmark::random_text;
+using std::u32string;
+using std::vector;
+
+namespace
+{
+    /// A terminal line's worth of text, one codepoint per cell.
+    u32string randomLine(std::mt19937& _rng, size_t _columns)
+    {
+        auto const text = random_text(_rng, _columns);
+        return u32string(text.begin(), text.end());
+    }
+}
+
+CRISPY_BENCHMARK("utf8.encode")
+{
+    for (size_t const columns: {80, 200, 64 * 1024})
+    {
+        auto input = randomLine(_bench.rng(), columns);
+        auto output = vector<char>(crispy::utf8::encodedSizeMax(input.size()));
+
+        _bench.throughput(input.size());
+        _bench.measure(fmt::format("ascii/size={}", columns), [&]() {
+            do_not_optimize(crispy::utf8::encode(input, output.data()));
+        });
+
+        // Every 8th cell holding a non-ASCII character, such as in box drawings or localized text.
+        for (size_t i = 0; i < input.size(); i += 8)
+            input[i] = U'│';
+        _bench.throughput(input.size());
+        _bench.measure(fmt::format("mixed/size={}", columns), [&]() {
+            do_not_optimize(crispy::utf8::encode(input, output.data()));
+        });
+    }
+}
@@ -0,0 +1,121 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/utf8.h>
+
+#include <fmt/format.h>
+
+#include <catch2/catch.hpp>
+
+#include <random>
+#include <string>
+
+using namespace crispy;
+using std::string;
+using std::u32string;
+
+namespace
+{
+    /// Encodes one codepoint at a time.
+    string referenceEncode(u32string const& _input)
+    {
+        auto output = string();
+        for (char32_t const codepoint: _input)
+        {
+            char buffer[4]{};
+            output.append(buffer, utf8::encode(codepoint, buffer));
+        }
+        return output;
+    }
+
+    /// @returns @p _size random codepoints, of which about one in @p _nonAsciiRatio is not US-ASCII.
+    u32string randomText(size_t _size, unsigned _nonAsciiRatio)
+    {
+        auto rng = std::mt19937{static_cast<unsigned>(_size)};
+        auto text = u32string(_size, U' ');
+        for (auto& codepoint: text)
+        {
+            if (rng() % _nonAsciiRatio)
+                codepoint = static_cast<char32_t>(0x20 + rng() % 0x5F);
+            else
+                switch (rng() % 3)
+                {
+                    case 0: codepoint = static_cast<char32_t>(0x80 + rng() % 0x780); break;
+                    case 1: codepoint = static_cast<char32_t>(0x4E00 + rng() % 0x5000); break;
+                    default: codepoint = static_cast<char32_t>(0x1F300 + rng() % 0x300); break;
+                }
+        }
+        return text;
+    }
+}
+
+TEST_CASE("utf8.encode.codepoint")
+{
+    char buffer[4]{};
+    CHECK(utf8::encode(U'A', buffer) == 1);
+    CHECK(string(buffer, 1) == "A");
+    CHECK(utf8::encode(U'ä', buffer) == 2);
+    CHECK(string(buffer, 2) == "\xC3\xA4");
+    CHECK(utf8::encode(U'€', buffer) == 3);
+    CHECK(string(buffer, 3) == "\xE2\x82\xAC");
+    CHECK(utf8::encode(U'\U0001F600', buffer) == 4);
+    CHECK(string(buffer, 4) == "\xF0\x9F\x98\x80");
+
+    CHECK(utf8::encodedSize(0x7F) == 1);
+    CHECK(utf8::encodedSize(0x80) == 2);
+    CHECK(utf8::encodedSize(0x7FF) == 2);
+    CHECK(utf8::encodedSize(0x800) == 3);
+    CHECK(utf8::encodedSize(0xFFFF) == 3);
+    CHECK(utf8::encodedSize(0x10000) == 4);
+}
+
+TEST_CASE("utf8.encode.ascii")
+{
+    CHECK(utf8::encode(U"") == "");
+    CHECK(utf8::encode(U"Hello, World!") == "Hello, World!");
+
+    // Exceeds a vectorized batch, with a tail left to encode one by one.
+    auto const text = u32string(U"The quick brown fox jumps over the lazy dog.");
+    CHECK(utf8::encode(text) == "The quick brown fox jumps over the lazy dog.");
+}
+
+TEST_CASE("utf8.encode.mixed")
+{
+    // Non-ASCII codepoints at each position of a vectorized batch.
+    for (size_t position = 0; position < 40; ++position)
+    {
+        auto text = u32string(40, U'x');
+        text[position] = U'ä';
+        INFO(position);
+        CHECK(utf8::encode(text) == referenceEncode(text));
+    }
+
+    for (unsigned const ratio: {1u, 2u, 17u, 1000u})
+    {
+        for (size_t const size: {size_t{0}, size_t{1}, size_t{15}, size_t{16}, size_t{17}, size_t{80}, size_t{4099}})
+        {
+            auto const text = randomText(size, ratio);
+            INFO(fmt::format("ratio={} size={}", ratio, size));
+            CHECK(utf8::encode(text) == referenceEncode(text));
+        }
+    }
+}
+
+TEST_CASE("utf8.append")
+{
+    auto output = string("> ");
+    utf8::append(output, U"äbc");
+    utf8::append(output, U"");
+    utf8::append(output, U" \U0001F600");
+    CHECK(output == "> \xC3\xA4" "bc \xF0\x9F\x98\x80");
+}
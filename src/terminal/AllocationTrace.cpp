@@ -0,0 +1,79 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/AllocationTrace.h>
+
+#include <fmt/format.h>
+
+#include <cctype>
+
+using std::string;
+
+namespace terminal {
+
+namespace // {{{ helper
+{
+    /// @returns @p _name in lower case, with spaces replaced by underscores, as used for JSON keys.
+    string jsonKey(std::string_view _name)
+    {
+        auto key = string(_name);
+        for (char& ch: key)
+            ch = ch == ' ' ? '_' : static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+        return key;
+    }
+} // }}}
+
+string AllocationTrace::dump() const
+{
+    if (!crispy::allocations::counting())
+        return "Allocations are not counted by this build.\n";
+
+    auto out = fmt::format("{:<14} {:>12} {:>14} {:>14} {:>18}\n", "phase", "units", "allocations", "bytes", "allocations/unit");
+    for (size_t i = 0; i < PhaseCount; ++i)
+    {
+        auto const phase = static_cast<AllocationPhase>(i);
+        auto const& p = this->phase(phase);
+        out += fmt::format("{:<14} {:>12} {:>14} {:>14} {:>18}\n",
+                           to_string(phase),
+                           fmt::format("{:.1f} {}", double(p.units()) / double(unitSize(phase)), unitName(phase)),
+                           p.allocations().count,
+                           p.allocations().bytes,
+                           fmt::format("{:.2f}", p.allocations_per(unitSize(phase))));
+    }
+    return out;
+}
+
+string AllocationTrace::json() const
+{
+    if (!crispy::allocations::counting())
+        return "null";
+
+    auto out = string{"{"};
+    for (size_t i = 0; i < PhaseCount; ++i)
+    {
+        auto const phase = static_cast<AllocationPhase>(i);
+        auto const& p = this->phase(phase);
+        out += fmt::format("{}\"{}\": {{ \"count\": {}, \"bytes\": {}, \"units\": {}, \"per_{}\": {:.3f} }}",
+                           i ? ", " : " ",
+                           jsonKey(to_string(phase)),
+                           p.allocations().count,
+                           p.allocations().bytes,
+                           p.units(),
+                           jsonKey(unitName(phase)),
+                           p.allocations_per(unitSize(phase)));
+    }
+    out += " }";
+    return out;
+}
+
+} // end namespace
@@ -0,0 +1,98 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <crispy/allocation_counter.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace terminal {
+
+/// Phases of work heap allocations are accounted to, each with its own unit of work.
+enum class AllocationPhase {
+    Parse,          //!< PTY output being written to the screen, per MiB.
+    RenderBuffer,   //!< The render buffer being refreshed from the screen, per refresh.
+    Render,         //!< A frame being rendered from the render buffer, per frame.
+    Input,          //!< A key, character or mouse event being handled, per event.
+};
+
+constexpr std::string_view to_string(AllocationPhase _phase) noexcept
+{
+    switch (_phase)
+    {
+        case AllocationPhase::Parse: return "parse";
+        case AllocationPhase::RenderBuffer: return "render buffer";
+        case AllocationPhase::Render: return "render";
+        case AllocationPhase::Input: return "input";
+    }
+    return "INVALID";
+}
+
+/// @returns the name of the unit of work of @p _phase.
+constexpr std::string_view unitName(AllocationPhase _phase) noexcept
+{
+    switch (_phase)
+    {
+        case AllocationPhase::Parse: return "MiB";
+        case AllocationPhase::RenderBuffer: return "refresh";
+        case AllocationPhase::Render: return "frame";
+        case AllocationPhase::Input: return "event";
+    }
+    return "INVALID";
+}
+
+/// @returns the number of units counted per unit of work of @p _phase, e.g. bytes per MiB.
+constexpr uint64_t unitSize(AllocationPhase _phase) noexcept
+{
+    return _phase == AllocationPhase::Parse ? 1024 * 1024 : 1;
+}
+
+/// Counts heap allocations made by each AllocationPhase, to tell the allocations per unit of work.
+///
+/// Phases are entered by different threads (terminal, render, and GUI thread), each one
+/// accounting the allocations of its own thread only. The counts may be read at any time.
+/// They stay zero unless the executable counts allocations, see crispy::allocations.
+class AllocationTrace {
+  public:
+    static constexpr size_t PhaseCount = static_cast<size_t>(AllocationPhase::Input) + 1;
+
+    /// @returns a scope accounting the calling thread's allocations to @p _phase, for @p _units units.
+    crispy::scoped_allocation_count scope(AllocationPhase _phase, uint64_t _units = 1) noexcept
+    {
+        return crispy::scoped_allocation_count{phase(_phase), _units};
+    }
+
+    crispy::allocation_phase& phase(AllocationPhase _phase) noexcept { return phases_[static_cast<size_t>(_phase)]; }
+    crispy::allocation_phase const& phase(AllocationPhase _phase) const noexcept { return phases_[static_cast<size_t>(_phase)]; }
+
+    void reset() noexcept
+    {
+        for (auto& phase: phases_)
+            phase.reset();
+    }
+
+    /// @returns a human readable table of the allocations per unit of work of each phase.
+    std::string dump() const;
+
+    /// @returns the allocations of each phase as JSON object.
+    std::string json() const;
+
+  private:
+    std::array<crispy::allocation_phase, PhaseCount> phases_;
+};
+
+} // end namespace terminal
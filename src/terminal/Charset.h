@@ -15,6 +15,7 @@
 
 #include <terminal/Sequencer.h>
 
+#include <algorithm>
 #include <array>
 #include <fmt/format.h>
 
@@ -41,7 +42,7 @@ class CharsetMapping {
 
     char32_t map(char _code) noexcept
     {
-        auto result = map(shift_, _code);
+        auto result = usascii_ ? static_cast<char32_t>(_code) : map(shift_, _code);
         shift_ = selected_;
         return result;
     }
@@ -65,16 +66,23 @@ class CharsetMapping {
     void select(CharsetTable _table, CharsetId _id) noexcept
     {
         tables_[static_cast<size_t>(_table)] = charsetMap(_id);
+        usascii_ = std::all_of(tables_.begin(), tables_.end(), [](CharsetMap const* _map) {
+            return _map == charsetMap(CharsetId::USASCII);
+        });
     }
 
     constexpr CharsetTable currentTable() const noexcept { return shift_; }
 
+    /// Tests whether all tables are US-ASCII, in which case mapping does not change any character.
+    constexpr bool isUSASCII() const noexcept { return usascii_; }
+
   private:
     CharsetTable shift_ = CharsetTable::G0;
     CharsetTable selected_ = CharsetTable::G0;
 
     using Tables = std::array<CharsetMap const*, 4>;
     Tables tables_;
+    bool usascii_ = true;
 };
 
 } // end namespace
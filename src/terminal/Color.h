@@ -247,28 +247,30 @@ struct ColorPalette
 
     RGBColor normalColor(size_t _index) const noexcept {
         assert(_index < 8);
-        return palette.at(_index);
+        return palette[_index];
     }
 
     RGBColor brightColor(size_t _index) const noexcept {
         assert(_index < 8);
-        return palette.at(_index + 8);
+        return palette[_index + 8];
     }
 
     RGBColor dimColor(size_t _index) const {
         assert(_index < 8);
-        return palette.at(_index); // TODO
+        return palette[_index]; // TODO
     }
 
     RGBColor indexedColor(size_t _index) const noexcept {
         assert(_index < 256);
-        return palette.at(_index);
+        return palette[_index];
     }
 
     RGBColor defaultForeground = 0xD0D0D0;
     RGBColor defaultBackground = 0x000000;
     std::optional<RGBColor> selectionForeground = std::nullopt;
     std::optional<RGBColor> selectionBackground = std::nullopt;
+    std::optional<RGBColor> searchHighlightForeground = std::nullopt;
+    std::optional<RGBColor> searchHighlightBackground = std::nullopt;
 	RGBColor cursor = 0x707020;
 
     RGBColor mouseForeground = 0x800000;
@@ -280,6 +282,27 @@ struct ColorPalette
     } hyperlinkDecoration;
 };
 
+inline bool operator==(ColorPalette const& a, ColorPalette const& b) noexcept
+{
+    return a.palette == b.palette
+        && a.defaultForeground == b.defaultForeground
+        && a.defaultBackground == b.defaultBackground
+        && a.selectionForeground == b.selectionForeground
+        && a.selectionBackground == b.selectionBackground
+        && a.searchHighlightForeground == b.searchHighlightForeground
+        && a.searchHighlightBackground == b.searchHighlightBackground
+        && a.cursor == b.cursor
+        && a.mouseForeground == b.mouseForeground
+        && a.mouseBackground == b.mouseBackground
+        && a.hyperlinkDecoration.normal == b.hyperlinkDecoration.normal
+        && a.hyperlinkDecoration.hover == b.hyperlinkDecoration.hover;
+}
+
+inline bool operator!=(ColorPalette const& a, ColorPalette const& b) noexcept
+{
+    return !(a == b);
+}
+
 enum class ColorTarget {
     Foreground,
     Background,
@@ -43,28 +43,153 @@ using std::stringstream;
 
 namespace terminal {
 
-FunctionDefinition const* select(FunctionSelector const& _selector) noexcept
+namespace // {{{ helper
 {
-    auto static const& funcs = functions();
+    constexpr FunctionDefinition const* binarySearch(FunctionSelector const& _selector) noexcept
+    {
+        auto const& funcs = functions();
+
+        int a = 0;
+        int b = static_cast<int>(funcs.size()) - 1;
+        while (a <= b)
+        {
+            auto const i = (a + b) / 2;
+            auto const& I = funcs[i];
+            auto const rel = compare(_selector, I);
+            if (rel > 0)
+                a = i + 1;
+            else if (rel < 0)
+                b = i - 1;
+            else
+                return &I;
+        }
+        return nullptr;
+    }
+
+    /// Identifies the syntax of an ESC, CSI, or DCS function, ignoring the number of parameters.
+    constexpr uint32_t syntaxKey(FunctionCategory _category, char _leader, char _intermediate, char _final) noexcept
+    {
+        return static_cast<uint32_t>(_category)
+             | static_cast<uint32_t>(static_cast<uint8_t>(_leader)) << 8
+             | static_cast<uint32_t>(static_cast<uint8_t>(_intermediate)) << 16
+             | static_cast<uint32_t>(static_cast<uint8_t>(_final)) << 24;
+    }
 
-    //std::cout << fmt::format("select: {}\n", _selector);
+    constexpr uint32_t syntaxKey(FunctionDefinition const& _f) noexcept
+    {
+        return syntaxKey(_f.category, _f.leader, _f.intermediate, _f.finalSymbol);
+    }
 
-    int a = 0;
-    int b = static_cast<int>(funcs.size()) - 1;
-    while (a <= b)
+    constexpr bool isHashed(FunctionCategory _category) noexcept
     {
-        auto const i = (a + b) / 2;
-        auto const& I = funcs[i];
-        auto const rel = compare(_selector, I);
-        //std::cout << fmt::format(" - a:{:>2} b:{:>2} i:{} rel:{} I: {}\n", a, b, i, rel < 0 ? '<' : rel > 0 ? '>' : '=', I);
-        if (rel > 0)
-            a = i + 1;
-        else if (rel < 0)
-            b = i - 1;
-        else
-            return &I;
+        return _category == FunctionCategory::ESC
+            || _category == FunctionCategory::CSI
+            || _category == FunctionCategory::DCS;
     }
-    return nullptr;
+
+    /// Perfect hash table over the syntax keys of all ESC, CSI, and DCS functions.
+    ///
+    /// Each slot refers to the range of function definitions sharing the same syntax key
+    /// (and thus only differing in their parameter count), which are adjacent in functions().
+    struct FunctionHashTable
+    {
+        static constexpr unsigned Bits = 10;
+
+        struct Slot
+        {
+            uint8_t first = 0;
+            uint8_t count = 0;
+        };
+
+        uint32_t multiplier = 0; // 0 if no perfect hash function could be found
+        std::array<Slot, 1u << Bits> slots{};
+
+        constexpr size_t indexOf(uint32_t _key) const noexcept
+        {
+            return (_key * multiplier) >> (32 - Bits);
+        }
+    };
+
+    constexpr FunctionHashTable makeFunctionHashTable() noexcept
+    {
+        auto const& funcs = functions();
+        static_assert(std::tuple_size_v<std::decay_t<decltype(funcs)>> < 256);
+
+        uint32_t multiplier = 0x9E3779B1u;
+        for (int attempt = 0; attempt < 1024; ++attempt)
+        {
+            auto table = FunctionHashTable{};
+            table.multiplier = multiplier;
+
+            bool collision = false;
+            for (size_t i = 0; i < funcs.size() && !collision; ++i)
+            {
+                if (!isHashed(funcs[i].category))
+                    continue;
+
+                auto& slot = table.slots[table.indexOf(syntaxKey(funcs[i]))];
+                if (slot.count && syntaxKey(funcs[slot.first]) == syntaxKey(funcs[i]))
+                    ++slot.count;
+                else if (slot.count)
+                    collision = true;
+                else
+                    slot = FunctionHashTable::Slot{static_cast<uint8_t>(i), 1};
+            }
+            if (!collision)
+                return table;
+
+            multiplier = (multiplier * 1664525u + 1013904223u) | 1u;
+        }
+        return FunctionHashTable{};
+    }
+
+    constexpr auto functionHashTable = makeFunctionHashTable();
+    static_assert(functionHashTable.multiplier != 0, "No perfect hash found for the function table.");
+
+    constexpr FunctionDefinition const* hashLookup(FunctionSelector const& _selector) noexcept
+    {
+        auto const& funcs = functions();
+        auto const key = syntaxKey(_selector.category, _selector.leader, _selector.intermediate, _selector.finalSymbol);
+        auto const& slot = functionHashTable.slots[functionHashTable.indexOf(key)];
+
+        if (!slot.count || syntaxKey(funcs[slot.first]) != key)
+            return nullptr;
+
+        for (auto i = slot.first; i < slot.first + slot.count; ++i)
+            if (funcs[i].minimumParameters <= _selector.argc && _selector.argc <= funcs[i].maximumParameters)
+                return &funcs[i];
+
+        return nullptr;
+    }
+
+    /// Verifies that the hashed lookup agrees with the binary search over functions().
+    constexpr bool verifyFunctionHashTable() noexcept
+    {
+        for (auto const& f: functions())
+        {
+            if (!isHashed(f.category))
+                continue;
+
+            for (int const argc: {int(f.minimumParameters) - 1, int(f.minimumParameters),
+                                  int(f.maximumParameters), int(f.maximumParameters) + 1})
+            {
+                auto const selector = FunctionSelector{f.category, f.leader, argc, f.intermediate, f.finalSymbol};
+                if (hashLookup(selector) != binarySearch(selector))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    static_assert(verifyFunctionHashTable(), "Hashed function lookup disagrees with the function table.");
+} // }}}
+
+FunctionDefinition const* select(FunctionSelector const& _selector) noexcept
+{
+    if (isHashed(_selector.category))
+        return hashLookup(_selector);
+
+    return binarySearch(_selector);
 }
 
 } // end namespace
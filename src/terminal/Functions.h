@@ -332,6 +332,7 @@ constexpr inline auto STP         = detail::DCS(std::nullopt, 0, 0, '$', 'p', VT
 constexpr inline auto DECRQSS     = detail::DCS(std::nullopt, 0, 0, '$', 'q', VTType::VT420, "DECRQSS", "Request Status String");
 constexpr inline auto DECSIXEL    = detail::DCS(std::nullopt, 0, 3, std::nullopt, 'q', VTType::VT330, "DECSIXEL", "Sixel Graphics Image");
 constexpr inline auto XTGETTCAP   = detail::DCS(std::nullopt, 0, 0, '+', 'q', VTType::VT100, "XTGETTCAP", "Request Termcap/Terminfo String");
+constexpr inline auto IMGXFER     = detail::DCS(std::nullopt, 0, 2, std::nullopt, 'i', VTType::VT525 /*Extension*/, "IMGXFER", "Transfer compressed image");
 
 // OSC
 constexpr inline auto SETTITLE      = detail::OSC(0, "SETINICON", "Change Window & Icon Title");
@@ -365,10 +366,11 @@ constexpr inline auto RCOLORHIGHLIGHTFG = detail::OSC(119, "RCOLORHIGHLIGHTFG",
 constexpr inline auto RCOLORHIGHLIGHTBG = detail::OSC(117, "RCOLORHIGHLIGHTBG", "Reset highlight background color.");
 constexpr inline auto NOTIFY        = detail::OSC(777, "NOTIFY", "Send Notification.");
 constexpr inline auto DUMPSTATE     = detail::OSC(888, "DUMPSTATE", "Dumps internal state to debug stream.");
+constexpr inline auto SHMIMAGE      = detail::OSC(889, "SHMIMAGE", "Display RGBA image from shared memory.");
 
-inline auto const& functions() noexcept
+namespace detail
 {
-    static auto const funcs = []() constexpr { // {{{
+    constexpr inline auto functions = []() constexpr { // {{{
         auto f = std::array{
             // C0
             EOT,
@@ -469,6 +471,7 @@ inline auto const& functions() noexcept
             DECRQSS,
             DECSIXEL,
             XTGETTCAP,
+            IMGXFER,
 
             // OSC
             SETICON,
@@ -497,17 +500,17 @@ inline auto const& functions() noexcept
             RCOLORHIGHLIGHTBG,
             NOTIFY,
             DUMPSTATE,
+            SHMIMAGE,
         };
         crispy::sort(f, [](FunctionDefinition const& a, FunctionDefinition const& b) constexpr { return compare(a, b); });
         return f;
     }();  // }}}
+}
 
-#if 0
-    for (auto [a, b] : crispy::indexed(funcs))
-        std::cout << fmt::format("{:>2}: {}\n", a, b);
-#endif
-
-    return funcs;
+/// @returns all known function definitions, sorted by compare().
+constexpr auto const& functions() noexcept
+{
+    return detail::functions;
 }
 
 /// Selects a FunctionDefinition based on a FunctionSelector.
@@ -70,3 +70,25 @@ TEST_CASE("Functions.OSC777", "[Functions]")
     REQUIRE(osc);
     CHECK(*osc == NOTIFY);
 }
+
+TEST_CASE("Functions.select_all", "[Functions]")
+{
+    for (FunctionDefinition const& def: functions())
+    {
+        INFO(fmt::format("{}", def));
+        auto const argc = def.category == FunctionCategory::OSC ? int(def.maximumParameters)
+                                                                : int(def.minimumParameters);
+        FunctionDefinition const* f = select({def.category, def.leader, argc, def.intermediate, def.finalSymbol});
+        REQUIRE(f);
+        CHECK(*f == def);
+    }
+}
+
+TEST_CASE("Functions.select_unknown", "[Functions]")
+{
+    CHECK(terminal::selectControl(0, 0, 0, 'z') == nullptr);
+    CHECK(terminal::selectControl('?', 0, 0, 'm') == nullptr);
+    CHECK(terminal::selectControl(0, 0, '!', 'm') == nullptr);
+    CHECK(terminal::selectControl(0, 2, 0, 'K') == nullptr); // EL takes at most one parameter
+    CHECK(terminal::selectEscape('#', '9') == nullptr);
+}
@@ -12,15 +12,24 @@
  * limitations under the License.
  */
 #include <terminal/Grid.h>
+#include <terminal/ScrollbackFile.h>
 
 #include <crispy/Comparison.h>
+#include <crispy/FNV.h>
 #include <crispy/indexed.h>
+#include <crispy/profiler.h>
 #include <crispy/range.h>
+#include <crispy/thread_pool.h>
+#include <crispy/utf8.h>
 
 #include <unicode/convert.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <numeric>
 #include <optional>
 #include <sstream>
 #include <tuple>
@@ -30,10 +39,12 @@ using crispy::Comparison;
 using crispy::Size;
 
 using std::back_inserter;
+using std::copy_n;
 using std::fill_n;
 using std::for_each;
 using std::front_inserter;
 using std::generate_n;
+using std::max;
 using std::min;
 using std::move;
 using std::next;
@@ -43,7 +54,9 @@ using std::prev;
 using std::reverse;
 using std::rotate;
 using std::string;
+using std::string_view;
 using std::tuple;
+using std::vector;
 
 #if defined(LIBTERMINAL_EXECUTION_PAR)
 #include <execution>
@@ -56,15 +69,62 @@ namespace terminal {
 
 namespace // {{{ helper
 {
+    /// Granularity the column capacity of the main page lines is rounded up to.
+    constexpr int ColumnCapacityGranularity = 16;
+
+    constexpr int roundUpColumns(int _columns) noexcept
+    {
+        return (_columns + ColumnCapacityGranularity - 1) / ColumnCapacityGranularity * ColumnCapacityGranularity;
+    }
+
     bool is_blank(Cell const& _cell) noexcept
     {
         return
-#if defined(LIBTERMINAL_IMAGES)
-            !_cell.imageFragment() &&
-#endif
+            !_cell.hasImage() &&
             _cell.codepointCount() == 0;
     }
 
+    /// @returns the codepoint a compressed line stores for @p _cell.
+    char32_t codepointOf(Cell const& _cell) noexcept
+    {
+        return _cell.codepointCount() ? _cell.codepoint(0) : char32_t{0};
+    }
+
+    size_t hashCell(size_t _hash, char32_t _codepoint, GraphicsAttributesId _attributes) noexcept
+    {
+        auto constexpr fnv = crispy::FNV<uint32_t>();
+        return fnv(_hash, static_cast<uint32_t>(_codepoint), static_cast<uint32_t>(_attributes));
+    }
+
+    template <typename T>
+    void appendValue(string& _record, T _value)
+    {
+        _record.append(reinterpret_cast<char const*>(&_value), sizeof(_value));
+    }
+
+    template <typename T>
+    T readValue(char const*& _input) noexcept
+    {
+        T value;
+        std::memcpy(&value, _input, sizeof(value));
+        _input += sizeof(value);
+        return value;
+    }
+
+    // Lower bound of history lines worth leaving to Grid::reflowHistory() when resizing.
+    constexpr int MinDeferredReflowLineCount = 1000;
+
+    // Number of lines (rounded up to complete logical lines) to reflow per parallel task.
+    constexpr std::ptrdiff_t ReflowChunkSize = 4096;
+
+    // Minimum number of trailing blank cells worth reallocating a line's cells for, see Line::trim().
+    constexpr int MinTrimmedCellCount = 8;
+
+#if defined(LIBTERMINAL_IMAGES)
+    // Minimum number of image rows to be added before unused ones are collected.
+    constexpr size_t MinImageRowCollectionCount = 256;
+#endif
+
     template <typename... Args>
     void logf([[maybe_unused]] Args&&... _args)
     {
@@ -77,13 +137,248 @@ namespace // {{{ helper
 // {{{ Cell impl
 string Cell::toUtf8() const
 {
-    if (!codepoints_.empty())
-        return unicode::convert_to<char>(codepoints());
+    if (codepointCount() != 0)
+        return crispy::utf8::encode(codepoints());
     else
         return " ";
 }
 // }}}
+// {{{ GraphicsAttributesTable impl
+GraphicsAttributesTable::GraphicsAttributesTable() :
+    values_{ GraphicsAttributes{} },
+    ids_{ {keyOf(GraphicsAttributes{}), DefaultGraphicsAttributesId} },
+    lastKey_{ keyOf(GraphicsAttributes{}) }
+{
+}
+
+uint64_t GraphicsAttributesTable::nextVersion() noexcept
+{
+    static std::atomic<uint64_t> lastVersion = 0;
+    return ++lastVersion;
+}
+
+GraphicsAttributesTable::Key GraphicsAttributesTable::keyOf(GraphicsAttributes const& _attributes) noexcept
+{
+    auto const encode = [](Color _color) -> uint32_t {
+        auto const type = static_cast<uint32_t>(_color.type) << 24;
+        if (_color.type == ColorType::RGB)
+            return type | (uint32_t(_color.rgb.red) << 16)
+                        | (uint32_t(_color.rgb.green) << 8)
+                        | uint32_t(_color.rgb.blue);
+        return type | _color.index;
+    };
+
+    return Key{
+        encode(_attributes.foregroundColor),
+        encode(_attributes.backgroundColor),
+        encode(_attributes.underlineColor),
+        static_cast<uint32_t>(_attributes.styles)
+    };
+}
+
+optional<GraphicsAttributesId> GraphicsAttributesTable::intern(GraphicsAttributes const& _attributes)
+{
+    auto const key = keyOf(_attributes);
+    if (key == lastKey_)
+        return lastId_;
+
+    if (auto const i = ids_.find(key); i != ids_.end())
+    {
+        lastKey_ = key;
+        lastId_ = i->second;
+        return lastId_;
+    }
+
+    if (values_.size() == Capacity)
+        return nullopt;
+
+    auto const id = static_cast<GraphicsAttributesId>(values_.size());
+    values_.emplace_back(_attributes);
+    ids_.emplace(key, id);
+    lastKey_ = key;
+    lastId_ = id;
+    return id;
+}
+
+std::vector<GraphicsAttributesId> GraphicsAttributesTable::compact(std::vector<bool> const& _used)
+{
+    auto mapping = std::vector<GraphicsAttributesId>(values_.size(), DefaultGraphicsAttributesId);
+    auto values = std::vector<GraphicsAttributes>{};
+    values.reserve(values_.size());
+    ids_.clear();
+
+    for (size_t i = 0; i < values_.size(); ++i)
+    {
+        // The default rendition always keeps its identifier.
+        if (i != DefaultGraphicsAttributesId && !_used[i])
+            continue;
+
+        auto const id = static_cast<GraphicsAttributesId>(values.size());
+        mapping[i] = id;
+        ids_.emplace(keyOf(values_[i]), id);
+        values.emplace_back(values_[i]);
+    }
+
+    values_ = move(values);
+    version_ = nextVersion();
+    lastKey_ = keyOf(GraphicsAttributes{});
+    lastId_ = DefaultGraphicsAttributesId;
+
+    return mapping;
+}
+// }}}
+// {{{ ImageRowTable impl
+#if defined(LIBTERMINAL_IMAGES)
+optional<ImageRowId> ImageRowTable::add(std::shared_ptr<RasterizedImage const> _image, int _row)
+{
+    ImageRowId id = 0;
+    if (!released_.empty())
+    {
+        id = released_.back();
+        released_.pop_back();
+        rows_[id] = Row{move(_image), _row};
+    }
+    else if (rows_.size() < Capacity)
+    {
+        id = static_cast<ImageRowId>(rows_.size());
+        rows_.emplace_back(Row{move(_image), _row});
+    }
+    else
+        return nullopt;
+
+    ++added_;
+    ++live_;
+    return id;
+}
+
+bool ImageRowTable::evict(ImageRowId _id)
+{
+    Row& row = rows_[_id];
+    if (!row.image)
+        return false;
+
+    row.image.reset();
+    row.evicted = true;
+    --live_;
+    return true;
+}
+
+void ImageRowTable::release(std::vector<bool> const& _used)
+{
+    for (size_t i = 0; i < rows_.size(); ++i)
+    {
+        Row& row = rows_[i];
+        if (_used[i] || (!row.image && !row.evicted))
+            continue;
+
+        if (row.image)
+            --live_;
+        row.image.reset();
+        row.evicted = false;
+        released_.push_back(static_cast<ImageRowId>(i));
+    }
+    added_ = 0;
+}
+#endif
+// }}}
+// {{{ MarkIndex impl
+void MarkIndex::dropFront(int _count)
+{
+    auto const count = min(_count, lineCount_);
+    base_ += count;
+    lineCount_ -= count;
+    while (!marks_.empty() && marks_.front() < base_)
+        marks_.pop_front();
+}
+
+void MarkIndex::dropBack(int _count)
+{
+    lineCount_ -= min(_count, lineCount_);
+    while (!marks_.empty() && marks_.back() >= base_ + lineCount_)
+        marks_.pop_back();
+}
+
+optional<int> MarkIndex::previous(int _line) const noexcept
+{
+    auto const i = std::lower_bound(marks_.begin(), marks_.end(), base_ + _line);
+    if (i == marks_.begin())
+        return nullopt;
+    return static_cast<int>(*prev(i) - base_);
+}
+
+optional<int> MarkIndex::next(int _line) const noexcept
+{
+    auto const i = std::upper_bound(marks_.begin(), marks_.end(), base_ + _line);
+    if (i == marks_.end())
+        return nullopt;
+    return static_cast<int>(*i - base_);
+}
+// }}}
+// {{{ LogicalLineIndex impl
+void LogicalLineIndex::dropFront(int _count)
+{
+    auto const count = min(_count, lineCount_);
+    base_ += count;
+    lineCount_ -= count;
+    while (!spans_.empty() && spans_.front().first + spans_.front().count <= base_ + 1)
+        spans_.pop_front();
+    if (!spans_.empty() && spans_.front().first < base_)
+    {
+        spans_.front().count -= static_cast<int>(base_ - spans_.front().first);
+        spans_.front().first = base_;
+    }
+}
+
+void LogicalLineIndex::dropBack(int _count)
+{
+    lineCount_ -= min(_count, lineCount_);
+    auto const end = base_ + lineCount_;
+    while (!spans_.empty() && spans_.back().first + 1 >= end)
+        spans_.pop_back();
+    if (!spans_.empty() && spans_.back().first + spans_.back().count > end)
+        spans_.back().count = static_cast<int>(end - spans_.back().first);
+}
+
+optional<std::pair<int, int>> LogicalLineIndex::find(int _line) const noexcept
+{
+    auto const line = base_ + _line;
+    auto const i = std::upper_bound(spans_.begin(), spans_.end(), line,
+                                    [](int64_t _value, Span const& _span) { return _value < _span.first; });
+    if (i == spans_.begin() || line >= prev(i)->first + prev(i)->count)
+        return nullopt;
+    return std::pair{ static_cast<int>(prev(i)->first - base_), prev(i)->count };
+}
+// }}}
 // {{{ Line impl
+Line::Line(Line const& _other) :
+    buffer_{ _other.buffer_ },
+    packed_{ _other.packed_ },
+    spilled_{ _other.spilled_ ? std::make_unique<SpilledCells>(*_other.spilled_) : nullptr },
+    trimmedCellCount_{ _other.trimmedCellCount_ },
+    side_{ _other.side_ ? std::make_unique<SideTable>(*_other.side_) : nullptr },
+    trimmedAttributes_{ _other.trimmedAttributes_ },
+    reservedColumns_{ _other.reservedColumns_ },
+    flags_{ _other.flags_ },
+    accountedBytes_{ _other.accountedBytes_ },
+    generation_{ _other.generation_ }
+{
+}
+
+Line& Line::operator=(Line const& _other)
+{
+    buffer_ = _other.buffer_;
+    packed_ = _other.packed_;
+    spilled_ = _other.spilled_ ? std::make_unique<SpilledCells>(*_other.spilled_) : nullptr;
+    trimmedCellCount_ = _other.trimmedCellCount_;
+    side_ = _other.side_ ? std::make_unique<SideTable>(*_other.side_) : nullptr;
+    trimmedAttributes_ = _other.trimmedAttributes_;
+    reservedColumns_ = _other.reservedColumns_;
+    flags_ = _other.flags_;
+    accountedBytes_ = _other.accountedBytes_;
+    generation_ = _other.generation_;
+    return *this;
+}
+
 Line::Line(Buffer&& _init, Flags _flags) :
     buffer_{ move(_init) },
     flags_{ static_cast<unsigned>(_flags) }
@@ -110,22 +405,101 @@ Line::Line(int _numCols, std::string_view const& _s, Flags _flags) :
         buffer_.at(i).setCharacter(ch);
 }
 
-string Line::toUtf8() const
+string Line::toUtf8(vector<size_t>* _cellOffsets) const
+{
+    if (_cellOffsets)
+        _cellOffsets->clear();
+
+    auto output = string{};
+    appendUtf8(output, _cellOffsets);
+    return output;
+}
+
+void Line::appendUtf8(string& _output, vector<size_t>* _cellOffsets) const
+{
+    appendUtf8(_output, _cellOffsets, size());
+}
+
+void Line::appendUtf8(string& _output, int _columnCount) const
 {
-    std::stringstream sstr;
-    for (Cell const& cell : crispy::range(begin(), next(begin(), size())))
+    appendUtf8(_output, nullptr, _columnCount);
+}
+
+void Line::appendUtf8(string& _output, vector<size_t>* _cellOffsets, int _columnCount) const
+{
+    if (packed_ || spilled_)
     {
-        if (cell.codepointCount() == 0)
+        // Compressed lines are read as they are, rather than unpacking their cells.
+        auto text = string_view{};
+        if (spilled_)
         {
-            sstr << ' ';
+            auto const record = spilled_->file->read(spilled_->offset, spilled_->size);
+            auto i = record.data() + sizeof(int32_t);
+            auto const textSize = readValue<uint32_t>(i);
+            text = string_view(i, textSize);
         }
         else
+            text = packed_->text;
+
+        _output.reserve(_output.size() + text.size() + static_cast<size_t>(_columnCount));
+        auto cellCount = 0;
+        for (char const ch : text)
         {
-            for (char32_t codepoint : cell.codepoints())
-                sstr << unicode::convert_to<char>(codepoint);
+            // Every non-continuation byte starts the codepoint of another cell.
+            if ((static_cast<uint8_t>(ch) & 0xC0) != 0x80)
+            {
+                if (cellCount == _columnCount)
+                    break;
+                if (_cellOffsets)
+                    _cellOffsets->push_back(_output.size());
+                ++cellCount;
+            }
+            _output += ch != '\0' ? ch : ' ';
+        }
+        for (; cellCount < _columnCount; ++cellCount)
+        {
+            if (_cellOffsets)
+                _cellOffsets->push_back(_output.size());
+            _output += ' ';
+        }
+        return;
+    }
+
+    // The codepoints of cells are gathered in chunks, each transcoded at once.
+    char32_t chunk[512];
+    size_t chunkSize = 0;
+    auto offset = _output.size(); // of the next cell's text, once transcoded
+
+    auto const cellCount = min(static_cast<size_t>(max(_columnCount, 0)), buffer_.size());
+    for (size_t i = 0; i < cellCount; ++i)
+    {
+        Cell const& cell = buffer_[i];
+        auto const codepoints = cell.codepointCount() != 0 ? cell.codepoints() : std::u32string_view(U" ", 1);
+        if (chunkSize + codepoints.size() > std::size(chunk))
+        {
+            crispy::utf8::append(_output, std::u32string_view(chunk, chunkSize));
+            chunkSize = 0;
+        }
+
+        if (_cellOffsets)
+        {
+            _cellOffsets->push_back(offset);
+            for (char32_t const codepoint : codepoints)
+                offset += crispy::utf8::encodedSize(codepoint);
         }
+
+        copy_n(codepoints.begin(), codepoints.size(), chunk + chunkSize);
+        chunkSize += codepoints.size();
+    }
+    crispy::utf8::append(_output, std::u32string_view(chunk, chunkSize));
+
+    // Trimmed cells, and the ones the line is shorter by, are blank.
+    for (auto i = static_cast<int>(cellCount); i < _columnCount; ++i)
+    {
+        if (_cellOffsets)
+            _cellOffsets->push_back(_output.size());
+        _output += ' ';
     }
-    return sstr.str();
 }
 
 string Line::toUtf8Trimmed() const
@@ -136,65 +510,141 @@ string Line::toUtf8Trimmed() const
     return output;
 }
 
-void Line::prepend(Buffer const& _cells)
+void Line::setText(std::string_view _u8string)
 {
-    buffer_.insert(buffer_.begin(), _cells.begin(), _cells.end());
+    inflate();
+    side_.reset();
+    for (auto const [i, ch] : crispy::indexed(unicode::convert_to<char32_t>(_u8string)))
+        buffer_.at(i).setCharacter(ch);
 }
 
-void Line::append(Buffer const& _cells)
+vector<DetectedLink> const& Line::detectedLinks() const
 {
-    buffer_.insert(buffer_.end(), _cells.begin(), _cells.end());
+    if (linksDetected())
+        return side_->links;
+
+    // Trailing blank cells not allocated cannot be part of any link, so they're not restored.
+    auto detector = LinkDetector{};
+    auto column = 0;
+    for (Cell const& cell: untrimmedCells())
+    {
+        ++column;
+#if defined(LIBTERMINAL_HYPERLINKS)
+        if (cell.hyperlink() != NoHyperlinkId)
+        {
+            detector.feed(column, 0);
+            continue;
+        }
+#endif
+        detector.feed(column, cell.codepointCount() ? cell.codepoint(0) : 0);
+    }
+
+    if (!side_)
+        side_ = std::make_unique<SideTable>();
+    side_->linksGeneration = generation_;
+    side_->links = detector.finish();
+    return side_->links;
 }
 
-void Line::append(int _count, Cell const& _initial)
+void Line::forgetLinks() const
 {
-    fill_n(back_inserter(buffer_), _count, _initial);
+    if (!side_)
+        return;
+
+    if (side_->triggersGeneration.has_value())
+    {
+        side_->linksGeneration.reset();
+        side_->links = {};
+    }
+    else
+        side_.reset();
 }
 
-crispy::range<Line::const_iterator> Line::trim_blank_right() const
+vector<TriggerMatch> const& Line::triggerMatches() const noexcept
 {
-    auto i = buffer_.cbegin();
-    auto e = buffer_.cend();
+    static auto const none = vector<TriggerMatch>{};
+    if (side_ && side_->triggersGeneration == generation_)
+        return side_->triggerMatches;
+    return none;
+}
 
-    while (i != e && is_blank(*prev(e)))
-        e = prev(e);
+void Line::setTriggerMatches(vector<TriggerMatch> const& _matches)
+{
+    if (!side_)
+        side_ = std::make_unique<SideTable>();
+    side_->triggersGeneration = generation_;
+    side_->triggerMatches = _matches;
+}
 
-    return crispy::range(i, e);
+void Line::setMovedGeneration(uint64_t _generation) noexcept
+{
+    if (side_ && side_->linksGeneration == generation_)
+        side_->linksGeneration = _generation;
+    if (side_ && side_->triggersGeneration == generation_)
+        side_->triggersGeneration = _generation;
+    generation_ = _generation;
 }
 
-Line::Buffer Line::shift_left(int _count, Cell const& _fill)
+void Line::resize(int _size)
 {
-    auto const actualShiftCount = min(_count, size());
-    auto const from = std::begin(buffer_);
-    auto const to = std::next(std::begin(buffer_), actualShiftCount);
+    // Links cut off may have their remainder detected as links of their own.
+    if (_size < size())
+        forgetLinks();
 
-    auto out = remove(from, to);
-    append(actualShiftCount, _fill);
+    // Compressed lines keep their cells compressed, as long as no stored cells are cut off.
+    if ((packed_ || spilled_) && _size >= usedColumns())
+    {
+        if (packed_)
+            trimmedCellCount_ = _size - packed_->cells;
+        else
+            spilled_->columns = _size;
+        return;
+    }
 
-    // trim trailing blanks
-    while (!out.empty() && is_blank(out.back()))
-        out.pop_back();
+    // Dropped trailing blanks can simply be accounted for, as long as they're default cells.
+    auto const bufferSize = static_cast<int>(buffer_.size());
+    if (!packed_ && !spilled_ && _size >= bufferSize
+            && (_size <= size() || !trimmedCellCount_ || trimmedAttributes_ == DefaultGraphicsAttributesId))
+    {
+        if (!trimmedCellCount_)
+            trimmedAttributes_ = DefaultGraphicsAttributesId;
+        trimmedCellCount_ = _size - bufferSize;
+        return;
+    }
 
-    return out;
+    inflate();
+    if (_size >= 0)
+    {
+        reserveCells(static_cast<size_t>(_size));
+        buffer_.resize(static_cast<size_t>(_size));
+    }
 }
 
-Line::Buffer Line::remove(iterator const& _from, iterator const& _to)
+void Line::reserveColumns(int _columns)
 {
-    auto removedColumns = Buffer(_from, _to);
-    buffer_.erase(_from, _to);
-    return removedColumns;
+    reservedColumns_ = static_cast<uint16_t>(std::clamp(_columns, 0, int{std::numeric_limits<uint16_t>::max()}));
+    if (!buffer_.empty())
+        reserveCells(buffer_.size());
 }
 
-void Line::setText(std::string_view _u8string)
+void Line::reserveCells(size_t _count) const
 {
-    for (auto const [i, ch] : crispy::indexed(unicode::convert_to<char32_t>(_u8string)))
-        buffer_.at(i).setCharacter(ch);
+    if (buffer_.capacity() < max(_count, size_t{reservedColumns_}))
+        buffer_.reserve(max(_count, size_t{reservedColumns_}));
 }
 
-void Line::resize(int _size)
+int Line::usedColumns() const noexcept
 {
-    if (_size >= 0)
-        buffer_.resize(static_cast<int>(_size));
+    if (packed_)
+        return packed_->cells;
+
+    if (spilled_)
+        return spilled_->storedCells;
+
+    auto used = buffer_.size();
+    while (used != 0 && is_blank(buffer_[used - 1]))
+        --used;
+    return static_cast<int>(used);
 }
 
 bool Line::blank() const noexcept
@@ -202,418 +652,1732 @@ bool Line::blank() const noexcept
     return std::all_of(cbegin(), cend(), is_blank);
 }
 
-Line::Buffer Line::reflow(int _newColumnCount)
+void Line::trim()
+{
+    // Trimmed lines are history lines, which are not expected to be resized anymore.
+    reservedColumns_ = 0;
+
+    if (packed_ || spilled_ || trimmedCellCount_ || buffer_.empty())
+        return;
+
+    auto const attributes = buffer_.back().attributes();
+    auto const isTrimmable = [&](Cell const& _cell) {
+        return _cell.codepointCount() == 0
+            && !_cell.hasImage()
+            && _cell.width() == 1
+            && _cell.attributes() == attributes
+#if defined(LIBTERMINAL_HYPERLINKS)
+            && !_cell.hyperlink()
+#endif
+            ;
+    };
+
+    auto used = buffer_.end();
+    while (used != buffer_.begin() && isTrimmable(*prev(used)))
+        --used;
+
+    auto const count = static_cast<int>(std::distance(used, buffer_.end()));
+    if (count < MinTrimmedCellCount)
+        return;
+
+    buffer_.erase(used, buffer_.end());
+    buffer_.shrink_to_fit();
+    trimmedCellCount_ = count;
+    trimmedAttributes_ = attributes;
+}
+
+void Line::untrim() const
+{
+    reserveCells(buffer_.size() + static_cast<size_t>(trimmedCellCount_));
+    buffer_.resize(buffer_.size() + static_cast<size_t>(trimmedCellCount_), Cell{{}, trimmedAttributes_});
+    trimmedCellCount_ = 0;
+}
+
+optional<crispy::range<Line::const_iterator>> Line::compressibleCells() const
 {
-    switch (crispy::strongCompare(_newColumnCount, size()))
+    auto const isTrailingBlank = [](Cell const& _cell) {
+        return _cell.empty()
+            && _cell.attributes() == DefaultGraphicsAttributesId
+#if defined(LIBTERMINAL_HYPERLINKS)
+            && !_cell.hyperlink()
+#endif
+            ;
+    };
+
+    auto used = buffer_.cend();
+    while (used != buffer_.cbegin() && isTrailingBlank(*prev(used)))
+        --used;
+
+    for (Cell const& cell : crispy::range(buffer_.cbegin(), used))
     {
-        case Comparison::Equal:
-            break;
-        case Comparison::Greater:
-            buffer_.resize(_newColumnCount);
-            break;
-        case Comparison::Less:
-        {
-            // TODO: properly handle wide character cells
-            // - when cutting in the middle of a wide char, the wide char gets wrapped and an empty
-            //   cell needs to be injected to match the expected column width.
+        if (cell.codepointCount() > 1)
+            return nullopt;
+#if defined(LIBTERMINAL_HYPERLINKS)
+        if (cell.hyperlink())
+            return nullopt;
+#endif
+        if (cell.hasImage())
+            return nullopt;
+        auto const codepoint = codepointOf(cell);
+        if (codepoint > 0x10FFFF || cell.width() != Cell{codepoint}.width())
+            return nullopt;
+    }
 
-            if (wrappable())
-            {
-                auto const [reflowStart, reflowEnd] = [this, _newColumnCount]()
-                {
-                    auto const reflowStart = next(buffer_.begin(), _newColumnCount /* - buffer_[_newColumnCount].width()*/);
-                    auto reflowEnd = buffer_.end();
+    return crispy::range(buffer_.cbegin(), used);
+}
 
-                    while (reflowEnd != reflowStart && is_blank(*prev(reflowEnd)))
-                        reflowEnd = prev(reflowEnd);
+bool Line::compress()
+{
+    reservedColumns_ = 0;
 
-                    return tuple{reflowStart, reflowEnd};
-                }();
+    if (packed_ || spilled_)
+        return true;
 
-                auto removedColumns = Buffer(reflowStart, reflowEnd);
-                buffer_.erase(reflowStart, buffer_.end());
-                assert(size() == _newColumnCount);
-                return removedColumns;
-            }
-            else
-            {
-                auto const reflowStart = next(buffer_.cbegin(), _newColumnCount);
-                buffer_.erase(reflowStart, buffer_.end());
-                assert(size() == _newColumnCount);
-                return {};
-            }
-        }
+    // Dropped trailing cells that would have to be stored are restored first.
+    if (trimmedCellCount_ && trimmedAttributes_ != DefaultGraphicsAttributesId)
+        untrim();
+
+    auto const cells = compressibleCells();
+    if (!cells.has_value())
+        return false;
+
+    auto packed = PackedCells{ static_cast<int>(cells->size()), {}, {} };
+    packed.text.reserve(cells->size());
+    for (Cell const& cell : *cells)
+    {
+        char utf8[4];
+        packed.text.append(utf8, crispy::utf8::encode(codepointOf(cell), utf8));
+
+        if (!packed.attributes.empty()
+                && packed.attributes.back().second == cell.attributes()
+                && packed.attributes.back().first < std::numeric_limits<uint16_t>::max())
+            ++packed.attributes.back().first;
+        else
+            packed.attributes.emplace_back(1, cell.attributes());
     }
-    return {};
+
+    packed.text.shrink_to_fit();
+    packed.attributes.shrink_to_fit();
+    trimmedCellCount_ = size() - packed.cells;
+    trimmedAttributes_ = DefaultGraphicsAttributesId;
+    packed_ = std::make_shared<PackedCells>(move(packed));
+    Buffer{}.swap(buffer_);
+
+    return true;
 }
-// }}}
-// {{{ Grid impl
-Grid::Grid(Size _screenSize, bool _reflowOnResize, optional<int> _maxHistoryLineCount) :
-    screenSize_{ _screenSize },
-    reflowOnResize_{ _reflowOnResize },
-    maxHistoryLineCount_{ _maxHistoryLineCount },
-    lines_(
-        static_cast<size_t>(_screenSize.height),
-        Line(
-            static_cast<size_t>(_screenSize.width),
-            Cell{},
-            _reflowOnResize ? Line::Flags::Wrappable : Line::Flags::None
-        )
-    )
+
+template <typename Callback>
+void Line::forEachPackedCell(PackedCells const& _cells, Callback const& _callback)
+{
+    auto run = _cells.attributes.begin();
+    auto remaining = run != _cells.attributes.end() ? run->first : 0;
+    for (char32_t const codepoint : unicode::from_utf8(_cells.text))
+    {
+        if (remaining == 0)
+            remaining = (++run)->first;
+        _callback(codepoint, run->second);
+        --remaining;
+    }
+}
+
+size_t Line::hashCells(PackedCells const& _cells)
 {
+    auto hash = crispy::FNV<uint32_t>().basis();
+    forEachPackedCell(_cells, [&](char32_t _codepoint, GraphicsAttributesId _attributes) {
+        hash = hashCell(hash, _codepoint, _attributes);
+    });
+    return hash;
 }
 
-/**
- * Appends logical line by splitting into fixed-width lines.
- *
- * @param _targetLines
- * @param _newColumnCount
- * @param _logicalLineBuffer
- * @param _baseFlags
- * @param _initialNoWrap
- */
-void addNewWrappedLines(Lines& _targetLines,
-                        int _newColumnCount,
-                        Line::Buffer&& _logicalLineBuffer, // TODO: don't move, do (c)ref instead
-                        Line::Flags _baseFlags,
-                        bool _initialNoWrap)
+size_t Line::hashCells(crispy::range<const_iterator> _cells)
+{
+    auto hash = crispy::FNV<uint32_t>().basis();
+    for (Cell const& cell : _cells)
+        hash = hashCell(hash, codepointOf(cell), cell.attributes());
+    return hash;
+}
+
+void Line::unpack() const
+{
+    unspill();
+    auto const packed = move(packed_);
+
+    reserveCells(static_cast<size_t>(packed->cells + trimmedCellCount_));
+    forEachPackedCell(*packed, [&](char32_t _codepoint, GraphicsAttributesId _attributes) {
+        buffer_.emplace_back(_codepoint, _attributes);
+    });
+}
+
+bool Line::share(SharedCellsTable& _table)
+{
+    if (spilled_)
+        return false;
+
+    if (packed_)
+    {
+        if (packed_->shared)
+            return true;
+
+        auto const hash = hashCells(*packed_);
+        if (auto cells = _table.find(hash); cells && *cells == *packed_)
+            packed_ = move(cells);
+        else
+            _table.insert(hash, packed_);
+        return true;
+    }
+
+    // Lines of different widths or trailing blanks share the same cells, as those are not stored.
+    if (_table.empty() || (trimmedCellCount_ && trimmedAttributes_ != DefaultGraphicsAttributesId))
+        return false;
+
+    auto const cells = compressibleCells();
+    if (!cells.has_value())
+        return false;
+
+    auto shared = _table.find(hashCells(*cells));
+    if (!shared || shared->cells != static_cast<int>(cells->size()))
+        return false;
+
+    auto matching = true;
+    auto cell = cells->begin();
+    forEachPackedCell(*shared, [&](char32_t _codepoint, GraphicsAttributesId _attributes) {
+        matching = matching && codepointOf(*cell) == _codepoint && cell->attributes() == _attributes;
+        ++cell;
+    });
+    if (!matching)
+        return false;
+
+    reservedColumns_ = 0;
+    trimmedCellCount_ = size() - shared->cells;
+    trimmedAttributes_ = DefaultGraphicsAttributesId;
+    packed_ = move(shared);
+    Buffer{}.swap(buffer_);
+
+    return true;
+}
+
+bool Line::spill(std::shared_ptr<ScrollbackFile> const& _file)
+{
+    if (spilled_)
+        return true;
+
+    if (!compress())
+        return false;
+
+    // Record layout: columns, text size, text, run count, runs (length, attributes).
+    auto record = string{};
+    record.reserve(3 * sizeof(uint32_t) + packed_->text.size() + 2 * sizeof(uint16_t) * packed_->attributes.size());
+    appendValue(record, static_cast<int32_t>(size()));
+    appendValue(record, static_cast<uint32_t>(packed_->text.size()));
+    record += packed_->text;
+    appendValue(record, static_cast<uint32_t>(packed_->attributes.size()));
+    for (auto const& [count, attributes] : packed_->attributes)
+    {
+        appendValue(record, count);
+        appendValue(record, attributes);
+    }
+
+    auto const offset = _file->append(record);
+    if (!offset.has_value())
+        return false;
+
+    spilled_ = std::make_unique<SpilledCells>(
+        _file,
+        *offset,
+        static_cast<uint32_t>(record.size()),
+        size(),
+        packed_->cells
+    );
+    packed_.reset();
+    forgetLinks();
+    trimmedCellCount_ = 0;
+
+    return true;
+}
+
+Line::SpilledCells::SpilledCells(std::shared_ptr<ScrollbackFile> _file, uint64_t _offset, uint32_t _size, int _columns, int _storedCells):
+    file{ move(_file) },
+    offset{ _offset },
+    size{ _size },
+    columns{ _columns },
+    storedCells{ _storedCells }
+{
+    file->retain(size);
+}
+
+Line::SpilledCells::SpilledCells(SpilledCells const& _other):
+    SpilledCells(_other.file, _other.offset, _other.size, _other.columns, _other.storedCells)
 {
-    // TODO: avoid unnecessary copies via erase() by incrementally updating (from, to)
-    int i = 0;
+}
+
+Line::SpilledCells::~SpilledCells()
+{
+    file->release(size);
+}
+
+void Line::unspill() const
+{
+    if (!spilled_)
+        return;
+
+    auto packed = readSpilled(spilled_->file->read(spilled_->offset, spilled_->size), spilled_->storedCells);
+    trimmedCellCount_ = spilled_->columns - packed.cells;
+    packed_ = std::make_shared<PackedCells>(move(packed));
+    spilled_.reset();
+}
+
+Line::PackedCells Line::readSpilled(std::string_view _record, int _storedCells)
+{
+    auto i = _record.data();
+
+    // The line may have been resized since, see resize().
+    auto packed = PackedCells{};
+    (void) readValue<int32_t>(i);
+    packed.cells = _storedCells;
+    auto const textSize = readValue<uint32_t>(i);
+    packed.text.assign(i, textSize);
+    i += textSize;
+    auto const runCount = readValue<uint32_t>(i);
+    packed.attributes.reserve(runCount);
+    for (uint32_t k = 0; k < runCount; ++k)
+    {
+        auto const count = readValue<uint16_t>(i);
+        auto const attributes = readValue<GraphicsAttributesId>(i);
+        packed.attributes.emplace_back(count, attributes);
+    }
+    return packed;
+}
+
+optional<Line::PrefetchedCells> Line::prefetch() const
+{
+    if (!packed_ && !spilled_)
+        return nullopt;
+
+    auto cells = PrefetchedCells{};
+    if (spilled_)
+    {
+        cells.file_ = spilled_->file;
+        cells.offset_ = spilled_->offset;
+        cells.size_ = spilled_->size;
+        cells.storedCells_ = spilled_->storedCells;
+        cells.capacity_ = static_cast<size_t>(spilled_->columns);
+    }
+    else
+    {
+        cells.packed_ = packed_;
+        cells.capacity_ = static_cast<size_t>(packed_->cells + trimmedCellCount_);
+    }
+    return cells;
+}
+
+void Line::PrefetchedCells::restore()
+{
+    auto spilled = PackedCells{};
+    if (file_)
+    {
+        auto const record = file_->load(offset_, size_);
+        if (record.empty())
+            return;
+        spilled = readSpilled(record, storedCells_);
+    }
+
+    PackedCells const& packed = file_ ? spilled : *packed_;
+    cells_.reserve(std::max(capacity_, static_cast<size_t>(packed.cells)));
+    forEachPackedCell(packed, [&](char32_t _codepoint, GraphicsAttributesId _attributes) {
+        cells_.emplace_back(_codepoint, _attributes);
+    });
+    restored_ = true;
+}
+
+bool Line::adopt(PrefetchedCells& _cells)
+{
+    if (!_cells.restored_)
+        return false;
+
+    // Lines are only ever compressed or spilled anew, so that the same cells mean the same contents.
+    if (_cells.file_)
+    {
+        if (!spilled_ || spilled_->file != _cells.file_ || spilled_->offset != _cells.offset_)
+            return false;
+        trimmedCellCount_ = spilled_->columns - spilled_->storedCells;
+        spilled_.reset();
+    }
+    else
+    {
+        if (!packed_ || packed_ != _cells.packed_)
+            return false;
+        packed_.reset();
+    }
+
+    // Same as unpack(), which leaves the trailing blank cells trimmed.
+    buffer_ = move(_cells.cells_);
+    reserveCells(buffer_.size() + static_cast<size_t>(trimmedCellCount_));
+    _cells.restored_ = false;
+    return true;
+}
+
+std::shared_ptr<Line::PackedCells> Line::SharedCellsTable::find(size_t _hash) const
+{
+    if (auto const i = cells_.find(_hash); i != cells_.end())
+        return i->second.lock();
+    return nullptr;
+}
+
+void Line::SharedCellsTable::insert(size_t _hash, std::shared_ptr<PackedCells> const& _cells)
+{
+    auto& entry = cells_[_hash];
+    if (auto const previous = entry.lock())
+        previous->shared = false;
+    entry = _cells;
+    _cells->shared = true;
+
+    if (cells_.size() >= sweepSize_)
+        sweep();
+}
+
+void Line::SharedCellsTable::remapAttributes(std::vector<GraphicsAttributesId> const& _mapping)
+{
+    // The renditions are part of the content hash, so the table is rebuilt.
+    auto remapped = std::unordered_map<size_t, std::weak_ptr<PackedCells>>{};
+    remapped.reserve(cells_.size());
+    for (auto const& [hash, weakCells] : cells_)
+    {
+        auto const cells = weakCells.lock();
+        if (!cells)
+            continue;
+
+        for (auto& [count, attributes] : cells->attributes)
+            attributes = _mapping[attributes];
+
+        // Cells that used to differ may collide now, leaving the lines to remap the others.
+        if (!remapped.emplace(hashCells(*cells), cells).second)
+            cells->shared = false;
+    }
+    cells_ = move(remapped);
+    sweepSize_ = max(MinSweepSize, 2 * cells_.size());
+}
+
+void Line::SharedCellsTable::sweep()
+{
+    for (auto i = cells_.begin(); i != cells_.end(); )
+        if (i->second.expired())
+            i = cells_.erase(i);
+        else
+            ++i;
+
+    // Sweeping again once the table has doubled keeps the cost per insertion constant.
+    sweepSize_ = max(MinSweepSize, 2 * cells_.size());
+}
+
+void Line::addMemoryUsage(LineMemoryUsage& _usage) const
+{
+    _usage.cells += crispy::allocated_bytes(buffer_);
+    for (Cell const& cell: buffer_)
+    {
+        _usage.codepoints += cell.codepointBytes();
+        _usage.hyperlinks += cell.hyperlinkBytes();
+    }
+
+    // Lines sharing their cells account for an equal part of them each.
+    if (packed_)
+        _usage.compressed += (sizeof(PackedCells)
+                              + crispy::allocated_bytes(packed_->text)
+                              + crispy::allocated_bytes(packed_->attributes))
+                           / static_cast<size_t>(packed_.use_count());
+    if (spilled_)
+        _usage.compressed += sizeof(SpilledCells);
+
+    if (side_)
+        _usage.links += sizeof(SideTable)
+                      + crispy::allocated_bytes(side_->links)
+                      + crispy::allocated_bytes(side_->triggerMatches);
+}
+
+size_t Line::memoryFootprint() const
+{
+    auto usage = LineMemoryUsage{};
+    addMemoryUsage(usage);
+    return sizeof(Line) + usage.cells + usage.codepoints + usage.hyperlinks + usage.compressed + usage.links;
+}
+
+void Line::markUsedAttributes(std::vector<bool>& _used) const
+{
+    if (spilled_)
+    {
+        auto const record = spilled_->file->read(spilled_->offset, spilled_->size);
+        auto i = record.data() + sizeof(int32_t);
+        auto const textSize = readValue<uint32_t>(i);
+        i += textSize;
+        auto const runCount = readValue<uint32_t>(i);
+        for (uint32_t k = 0; k < runCount; ++k)
+        {
+            readValue<uint16_t>(i);
+            _used[readValue<GraphicsAttributesId>(i)] = true;
+        }
+        return;
+    }
+
+    if (packed_)
+    {
+        for (auto const& [count, attributes] : packed_->attributes)
+            _used[attributes] = true;
+        return;
+    }
+
+    for (Cell const& cell : buffer_)
+        _used[cell.attributes()] = true;
+    if (trimmedCellCount_)
+        _used[trimmedAttributes_] = true;
+}
+
+void Line::remapAttributes(std::vector<GraphicsAttributesId> const& _mapping)
+{
+    // Records of a scrollback file are immutable, so the line is kept in memory from now on.
+    unspill();
+
+    if (packed_)
+    {
+        if (packed_->shared)
+            return;
+
+        // Packed cells may be shared with copies of this line.
+        if (packed_.use_count() > 1)
+            packed_ = std::make_shared<PackedCells>(*packed_);
+        for (auto& [count, attributes] : packed_->attributes)
+            attributes = _mapping[attributes];
+        return;
+    }
+
+    for (Cell& cell : buffer_)
+        cell.setAttributes(_mapping[cell.attributes()]);
+    trimmedAttributes_ = _mapping[trimmedAttributes_];
+}
+
+#if defined(LIBTERMINAL_HYPERLINKS)
+void Line::markUsedHyperlinks(std::vector<bool>& _used) const
+{
+    // Lines containing hyperlinks are never compressed.
+    if (compressed())
+        return;
+
+    for (Cell const& cell : buffer_)
+        if (auto const id = cell.hyperlink(); id != NoHyperlinkId)
+            _used[id] = true;
+}
+#endif
+
+#if defined(LIBTERMINAL_IMAGES)
+void Line::markUsedImageRows(std::vector<bool>& _used) const
+{
+    // Lines containing images are never compressed.
+    if (compressed())
+        return;
+
+    for (Cell const& cell : buffer_)
+        if (cell.hasImage())
+            _used[cell.imageRow()] = true;
+}
+#endif
+// }}}
+// {{{ Grid impl
+Grid::Grid(Size _screenSize, bool _reflowOnResize, optional<int> _maxHistoryLineCount) :
+    screenSize_{ _screenSize },
+    reservedColumns_{ roundUpColumns(_screenSize.width) },
+    reflowOnResize_{ _reflowOnResize },
+    maxHistoryLineCount_{ _maxHistoryLineCount },
+    lines_(
+        static_cast<size_t>(_screenSize.height),
+        Line(
+            _screenSize.width,
+            DefaultGraphicsAttributesId,
+            _reflowOnResize ? Line::Flags::Wrappable : Line::Flags::None
+        )
+    )
+{
+    for (Line& line: lines_)
+        line.reserveColumns(reservedColumns_);
+    reserveLines();
+}
+
+namespace // {{{ reflow helper
+{
+    /// Moves the cells of a logical line, being the lines of @p _lines from @p _first on,
+    /// into lines of @p _columnCount cells each.
+    ///
+    /// The logical line's own lines are reused for that, and further lines appended as needed.
+    /// All but its last line contribute all of their cells, the last one without its trailing blanks.
+    ///
+    /// @param _sizes   reused for the number of cells contributed by each line
+    /// @param _scratch reused for cells that cannot be moved in place
+    void reflowLogicalLine(Lines& _lines, size_t _first, int _columnCount,
+                           vector<size_t>& _sizes, Line::Buffer& _scratch)
+    {
+        auto const width = static_cast<size_t>(_columnCount);
+        auto const sourceCount = _lines.size() - _first;
+        auto const cells = [&](size_t _i) -> Line::Buffer& { return _lines[_first + _i].buffer(); };
+
+        _sizes.clear();
+        for (size_t i = 0; i < sourceCount; ++i)
+            _sizes.push_back(i + 1 < sourceCount ? cells(i).size()
+                                                 : static_cast<size_t>(_lines[_first + i].usedColumns()));
+
+        auto const cellCount = std::accumulate(_sizes.begin(), _sizes.end(), size_t{0});
+        auto const lineCount = max(size_t{1}, (cellCount + width - 1) / width);
+
+        // Cells can be moved front to back if no line starts past its reflowed position,
+        // or back to front if none starts before it, without overwriting cells yet to be moved.
+        auto forward = true;
+        auto backward = true;
+        for (size_t i = 0, offset = 0; i < min(sourceCount, lineCount); offset += _sizes[i], ++i)
+        {
+            forward = forward && offset <= i * width;
+            backward = backward && offset >= i * width;
+        }
+
+        auto const flags = _lines[_first].inheritableFlags() | Line::Flags::Wrapped;
+        for (size_t i = sourceCount; i < lineCount; ++i)
+            _lines.emplace_back(Line(_columnCount, Cell{}, flags));
+        for (size_t i = 0; i < min(sourceCount, lineCount); ++i)
+            if (cells(i).size() < width)
+                cells(i).resize(width);
+
+        if (forward)
+        {
+            for (size_t position = 0, source = 0, column = 0; position < cellCount; )
+            {
+                while (column == _sizes[source])
+                {
+                    ++source;
+                    column = 0;
+                }
+                auto const count = min(_sizes[source] - column, width - position % width);
+                auto const from = cells(source).begin() + static_cast<ptrdiff_t>(column);
+                auto const to = cells(position / width).begin() + static_cast<ptrdiff_t>(position % width);
+                if (from != to)
+                    std::move(from, from + static_cast<ptrdiff_t>(count), to);
+                position += count;
+                column += count;
+            }
+        }
+        else if (backward)
+        {
+            for (size_t position = cellCount, source = sourceCount - 1, column = _sizes.back(); position > 0; )
+            {
+                while (column == 0)
+                    column = _sizes[--source];
+                auto const targetColumn = (position - 1) % width + 1;
+                auto const count = min(column, targetColumn);
+                auto const from = cells(source).begin() + static_cast<ptrdiff_t>(column);
+                auto const to = cells((position - 1) / width).begin() + static_cast<ptrdiff_t>(targetColumn);
+                if (from != to)
+                    std::move_backward(from - static_cast<ptrdiff_t>(count), from, to);
+                position -= count;
+                column -= count;
+            }
+        }
+        else
+        {
+            // Lines of differing widths may not be movable in place.
+            _scratch.clear();
+            for (size_t i = 0; i < sourceCount; ++i)
+                std::move(cells(i).begin(), cells(i).begin() + static_cast<ptrdiff_t>(_sizes[i]), back_inserter(_scratch));
+            for (size_t position = 0; position < cellCount; position += width)
+                std::move(_scratch.begin() + static_cast<ptrdiff_t>(position),
+                          _scratch.begin() + static_cast<ptrdiff_t>(min(position + width, cellCount)),
+                          cells(position / width).begin());
+        }
+
+        auto& lastLine = cells(lineCount - 1);
+        Cell::fill(lastLine.data() + (cellCount - (lineCount - 1) * width), lastLine.data() + width, DefaultGraphicsAttributesId);
+
+        for (size_t i = 0; i < lineCount; ++i)
+            if (cells(i).size() > width)
+                cells(i).resize(width);
+
+        if (sourceCount > lineCount)
+            _lines.resize(_first + lineCount);
+    }
+} // }}}
+
+void reflow(Lines& _targetLines, crispy::range<Lines::iterator> _sourceLines, int _columnCount)
+{
+    auto sizes = vector<size_t>{};
+    auto scratch = Line::Buffer{};
+
+    for (auto source = _sourceLines.begin(); source != _sourceLines.end(); )
+    {
+        auto const first = _targetLines.size();
+        auto const flags = source->inheritableFlags();
+        auto const wrappable = source->wrappable();
+
+        _targetLines.emplace_back(move(*source++));
+        while (wrappable && source != _sourceLines.end() && source->wrapped() && source->inheritableFlags() == flags)
+            _targetLines.emplace_back(move(*source++));
+
+        // Most lines are not continued and fit into the new width, which does not even require their cells.
+        Line& line = _targetLines[first];
+        if (_targetLines.size() - first == 1 && (!wrappable || line.usedColumns() <= _columnCount))
+            line.resize(_columnCount);
+        else
+            reflowLogicalLine(_targetLines, first, _columnCount, sizes, scratch);
+    }
+}
+
+void Grid::setMaxHistoryLineCount(optional<int> _maxHistoryLineCount)
+{
+    maxHistoryLineCount_ = _maxHistoryLineCount;
+    clampHistory();
+    reserveLines();
+}
+
+void Grid::setMaxHistoryBytes(optional<size_t> _bytes)
+{
+    maxHistoryBytes_ = _bytes;
+    accountHistory();
+}
+
+namespace
+{
+    std::atomic<size_t>& globalMaxHistoryBytesValue() noexcept
+    {
+        static auto bytes = std::atomic<size_t>{0}; // 0 for no limit
+        return bytes;
+    }
+}
+
+optional<size_t> Grid::globalMaxHistoryBytes() noexcept
+{
+    if (auto const bytes = globalMaxHistoryBytesValue().load(std::memory_order_relaxed); bytes)
+        return bytes;
+    return nullopt;
+}
+
+void Grid::setGlobalMaxHistoryBytes(optional<size_t> _bytes) noexcept
+{
+    // Grids catch up with a lowered limit as soon as their history grows again.
+    globalMaxHistoryBytesValue().store(_bytes.value_or(0), std::memory_order_relaxed);
+}
+
+void Grid::setHistoryCompressionThreshold(optional<int> _threshold)
+{
+    historyCompressionThreshold_ = _threshold;
+    compressHistory();
+}
+
+void Grid::setHistorySpill(optional<int> _threshold, string _directory)
+{
+    if (_directory != historySpillDirectory_)
+        scrollbackFile_.reset();
+
+    historySpillThreshold_ = ScrollbackFile::Available ? _threshold : nullopt;
+    historySpillDirectory_ = move(_directory);
+    compressHistory();
+}
+
+void Grid::compressHistory(optional<int> _count)
+{
+    // The most recent history line is always kept uncompressed, as the screen may still refer
+    // to its last written cell (e.g. when a wrapped grapheme cluster continues).
+    //
+    // Lines are compressed from the most recent cold one downwards, which allows stopping early
+    // when only a few lines have just become cold.
+    auto const forEachColdLine = [&](int _threshold, auto const& _callback) {
+        auto const coldLineCount = historyLineCount() - max(1, _threshold);
+        auto const end = _count.has_value() ? max(0, coldLineCount - *_count) : 0;
+        for (int i = coldLineCount - 1; i >= end; --i)
+        {
+            Line& line = lines_[static_cast<size_t>(i)];
+            auto const proceed = _callback(line);
+            if (i < accountedLineCount_)
+                accountLine(line);
+            if (!proceed)
+                break;
+        }
+    };
+
+    // Trailing blanks are dropped from all history lines, most of which are rather short.
+    // Lines that have just become cold share the cells of identical compressed lines right away.
+    forEachColdLine(0, [&](Line& _line) {
+        if (!_count.has_value() || !_line.share(sharedCells_))
+            _line.trim();
+        return true;
+    });
+
+    if (historyCompressionThreshold_.has_value())
+        forEachColdLine(*historyCompressionThreshold_, [&](Line& _line) {
+            if (_line.compress())
+                _line.share(sharedCells_);
+            return true;
+        });
+
+    if (historySpillThreshold_.has_value())
+    {
+        // Lines dropped from the history leave their records behind, which is why new lines
+        // are spilled to a fresh file once most of the current one is unused. The current one
+        // is kept if no new one can be created.
+        if (!scrollbackFile_ || scrollbackFile_->wasteful())
+        {
+            if (auto file = ScrollbackFile::create(historySpillDirectory_); file || !scrollbackFile_)
+                scrollbackFile_ = move(file);
+        }
+
+        // Without a scrollback file, lines are simply kept in memory.
+        if (!scrollbackFile_)
+            historySpillThreshold_ = nullopt;
+        else
+            forEachColdLine(*historySpillThreshold_, [&](Line& _line) {
+                // Stop once the file cannot be grown anymore, but skip unspillable lines.
+                return _line.spill(scrollbackFile_) || !_line.compressed();
+            });
+    }
+
+    accountHistory();
+}
+
+void Grid::accountHistory()
+{
+    // The most recent history line may still be continued, see compressHistory().
+    auto const lineCount = max(0, historyLineCount() - 1);
+    if (accountedLineCount_ > lineCount)
+    {
+        unaccountLines(lineCount, accountedLineCount_);
+        accountedLineCount_ = lineCount;
+    }
+    for (; accountedLineCount_ < lineCount; ++accountedLineCount_)
+    {
+        // Lines may carry the accounting of where they have been copied from.
+        Line& line = lines_[static_cast<size_t>(accountedLineCount_)];
+        line.setAccountedBytes(0);
+        accountLine(line);
+    }
+
+    auto const globalMaxBytes = globalMaxHistoryBytes();
+    if (!maxHistoryBytes_.has_value() && !globalMaxBytes.has_value())
+        return;
+
+    // Only this grid's lines are dropped, even if it is other grids exceeding the global budget.
+    auto bytes = historyMemory_.bytes();
+    auto globalBytes = HistoryMemory::totalBytes();
+    auto dropCount = 0;
+    while (dropCount < accountedLineCount_
+           && (bytes > maxHistoryBytes_.value_or(bytes) || globalBytes > globalMaxBytes.value_or(globalBytes)))
+    {
+        auto const lineBytes = lines_[static_cast<size_t>(dropCount++)].accountedBytes();
+        bytes -= lineBytes;
+        globalBytes -= min(globalBytes, size_t{lineBytes});
+    }
+
+    if (dropCount)
+    {
+        dropIndexedLines(dropCount);
+        lines_.pop_front(static_cast<size_t>(dropCount));
+        dropPendingReflow(dropCount);
+    }
+}
+
+void Grid::accountLine(Line& _line)
+{
+    historyMemory_.subtract(_line.accountedBytes());
+    auto const bytes = static_cast<uint32_t>(min(_line.memoryFootprint(), size_t{std::numeric_limits<uint32_t>::max()}));
+    _line.setAccountedBytes(bytes);
+    historyMemory_.add(bytes);
+}
+
+void Grid::unaccountLines(int _first, int _last)
+{
+    for (int i = _first; i < _last; ++i)
+    {
+        Line& line = lines_[static_cast<size_t>(i)];
+        historyMemory_.subtract(line.accountedBytes());
+        line.setAccountedBytes(0);
+    }
+}
+
+int Grid::computeRelativeLineNumberFromBottom(int _n) const
+{
+    auto line = static_cast<int>(lines_.size());
+    for (int i = 0; i < _n && line > 0; ++i)
+        line = logicalLineAt(line - 1).first;
+    return line - historyLineCount() + 1;
+}
+
+Grid::LogicalLine Grid::logicalLineAt(int _line) const
+{
+    updateLogicalLineIndex();
+    auto const indexed = logicalLineIndex_.lineCount();
+    auto const wrapped = [&](int _i) { return lines_[static_cast<size_t>(_i)].wrapped(); };
+
+    auto first = _line;
+    while (first >= indexed && first > 0 && wrapped(first))
+        --first;
+    if (first < indexed)
+        if (auto const span = logicalLineIndex_.find(first); span.has_value())
+            first = span->first;
+
+    // Logical lines reaching the end of the indexed lines may be continued beyond.
+    auto last = _line;
+    if (last < indexed)
+        if (auto const span = logicalLineIndex_.find(last); span.has_value())
+            last = span->first + span->second - 1;
+    if (last >= indexed - 1)
+        while (last + 1 < static_cast<int>(lines_.size()) && wrapped(last + 1))
+            ++last;
+
+    return LogicalLine{ first, last - first + 1 };
+}
+
+string Grid::logicalLineText(LogicalLine _logicalLine, vector<size_t>* _cellOffsets) const
+{
+    auto text = string();
+    if (_cellOffsets)
+        _cellOffsets->clear();
+    for (int line = _logicalLine.first; line <= _logicalLine.last(); ++line)
+        lines_[static_cast<size_t>(line)].appendUtf8(text, _cellOffsets);
+    return text;
+}
+
+Coordinate Grid::resize(Size _newSize, Coordinate _currentCursorPos, bool _wrapPending)
+{
+    CRISPY_PROFILE_ZONE("Grid::resize");
+
+    auto const growLines = [this](int _newHeight) -> Coordinate
+    {
+        // Grow line count by splicing available lines from history back into buffer, if available,
+        // or create new ones until screenSize_.height == _newHeight.
+
+        auto const extendCount = _newHeight - screenSize_.height;
+        auto const rowsToTakeFromSavedLines = min(extendCount, historyLineCount());
+        auto const fillLineCount = extendCount - rowsToTakeFromSavedLines;
+        auto const wrappableFlag = lines_.back().wrappableFlag();
+
+        assert(rowsToTakeFromSavedLines >= 0);
+        assert(fillLineCount >= 0);
+
+        generate_n(
+            back_inserter(lines_),
+            fillLineCount,
+            [this, wrappableFlag]() {
+                auto line = Line(screenSize_.width, DefaultGraphicsAttributesId, wrappableFlag);
+                line.reserveColumns(reservedColumns_);
+                return line;
+            }
+        );
+
+        screenSize_.height = _newHeight;
+
+        return Coordinate{rowsToTakeFromSavedLines, 0};
+    };
+
+    auto const shrinkLines = [this](int _newHeight, Coordinate _cursor) -> Coordinate
+    {
+        // Shrink existing line count to _newSize.height
+        // by splicing the number of lines to be shrinked by into savedLines bottom.
+
+        if (_cursor.row == screenSize_.height)
+        {
+            auto const shrinkedLinesCount = screenSize_.height - _newHeight;
+            screenSize_.height = _newHeight;
+            clampHistory();
+            return Coordinate{shrinkedLinesCount, 0};
+        }
+        else
+        {
+            // Hard-cut below cursor by the number of lines to shrink.
+            lines_.resize(historyLineCount() + _newHeight);
+            screenSize_.height = _newHeight;
+            return Coordinate{0, 0};
+        }
+    };
+
+    auto const growColumns = [this, _wrapPending](int _newColumnCount, Coordinate _cursor) -> Coordinate
+    {
+        if (!reflowOnResize_)
+        {
+            for (Line& line : lines_)
+                if (static_cast<int>(line.size()) < _newColumnCount)
+                    line.resize(_newColumnCount);
+            screenSize_.width = _newColumnCount;
+            return _cursor + Coordinate{0, _wrapPending ? 1 : 0};
+        }
+        else
+        {
+            auto const extendCount = _newColumnCount - screenSize_.width;
+            assert(extendCount > 0);
+
+            logf("Growing by {} cols", extendCount);
+
+            reflowMainPage(_newColumnCount);
+
+            auto cy = 0;
+            if (historyLineCount() < 0)
+            {
+                cy = historyLineCount();
+                appendNewLines(-historyLineCount(), lines_.back()->back().attributes());
+            }
+
+            return _cursor + Coordinate{cy, _wrapPending ? 1 : 0};
+        }
+    };
+
+    auto const shrinkColumns = [this](int _newColumnCount, Coordinate _cursor) -> Coordinate
+    {
+        if (!reflowOnResize_)
+        {
+            screenSize_.width = _newColumnCount;
+            crispy::for_each(lines_, [=](Line& line) {
+                if (line.size() < _newColumnCount)
+                    line.resize(_newColumnCount);
+            });
+            return _cursor + Coordinate{0, min(_cursor.column, _newColumnCount)};
+        }
+        else
+        {
+            reflowMainPage(_newColumnCount);
+            return _cursor; // TODO
+        }
+    };
+
+    Coordinate cursorPosition = _currentCursorPos;
+
+    // The main page lines keep room for both the old and the new width, so that switching back
+    // and forth between them (or resizing in small steps) does not reallocate their cells.
+    if (_newSize.width != screenSize_.width)
+    {
+        reservedColumns_ = roundUpColumns(max(_newSize.width, screenSize_.width));
+        for (Line& line: lines(historyLineCount(), static_cast<int>(lines_.size())))
+            line.reserveColumns(reservedColumns_);
+    }
+
+    // Lines are only reflowed lazily as long as reflow is enabled.
+    if (!reflowOnResize_)
+        reflowHistory();
+
+    // grow/shrink columns
+    switch (crispy::strongCompare(_newSize.width, screenSize_.width))
+    {
+        case Comparison::Greater:
+            cursorPosition = growColumns(_newSize.width, cursorPosition);
+            break;
+        case Comparison::Less:
+            cursorPosition = shrinkColumns(_newSize.width, cursorPosition);
+            break;
+        case Comparison::Equal:
+            break;
+    }
+
+    // Lines moving from history into the main page must have been reflowed already.
+    if (pendingReflowLineCount() > historyLineCount() - max(0, _newSize.height - screenSize_.height))
+        reflowHistory();
+
+    // grow/shrink lines
+    switch (crispy::strongCompare(_newSize.height, screenSize_.height))
+    {
+        case Comparison::Greater:
+            cursorPosition += growLines(_newSize.height);
+            // The most recent history lines have become part of the main page.
+            invalidateIndexes(historyLineCount());
+            break;
+        case Comparison::Less:
+            cursorPosition += shrinkLines(_newSize.height, cursorPosition);
+            break;
+        case Comparison::Equal:
+            break;
+    }
+
+    reserveLines();
+    compressHistory();
+    touchPage();
+
+    return cursorPosition;
+}
+
+GraphicsAttributesId Grid::intern(GraphicsAttributes const& _attributes)
+{
+    if (auto const id = attributes_.intern(_attributes); id.has_value())
+        return *id;
+
+    collectUnusedAttributes();
+
+    if (auto const id = attributes_.intern(_attributes); id.has_value())
+        return *id;
+
+    // Every single identifier is in use by some cell, so fall back to the default rendition.
+    return DefaultGraphicsAttributesId;
+}
+
+void Grid::collectUnusedAttributes()
+{
+    auto used = std::vector<bool>(attributes_.size(), false);
+    for (Line const& line: lines_)
+        line.markUsedAttributes(used);
+
+    auto const mapping = attributes_.compact(used);
+
+    sharedCells_.remapAttributes(mapping);
+    for (Line& line: lines_)
+        line.remapAttributes(mapping);
+}
+
+#if defined(LIBTERMINAL_IMAGES)
+optional<ImageRowId> Grid::addImageRow(std::shared_ptr<RasterizedImage const> const& _image, int _row)
+{
+    // Images that have been overwritten are only released by a collection, so collect each time
+    // the number of rows has doubled since the previous one, to not keep too many of them alive.
+    auto const usedAfterCollection = imageRows_.used() - imageRows_.added();
+    if (imageRows_.added() >= max(MinImageRowCollectionCount, usedAfterCollection))
+        collectUnusedImageRows();
+
+    if (auto const id = imageRows_.add(_image, _row); id.has_value())
+        return id;
+
+    collectUnusedImageRows();
+    return imageRows_.add(_image, _row);
+}
+
+void Grid::collectUnusedImageRows()
+{
+    auto used = std::vector<bool>(imageRows_.size(), false);
+    for (Line const& line: lines_)
+        line.markUsedImageRows(used);
+
+    imageRows_.release(used);
+}
+
+size_t Grid::evictHistoryImages(std::function<bool()> const& _done)
+{
+    auto const historyLines = static_cast<size_t>(historyLineCount());
+
+    // Rows still displayed in the main page must be kept.
+    auto pageRows = std::vector<bool>(imageRows_.size(), false);
+    for (size_t i = historyLines; i < lines_.size(); ++i)
+        lines_[i].markUsedImageRows(pageRows);
+
+    auto pageRowCount = size_t{0};
+    for (size_t i = 0; i < pageRows.size(); ++i)
+        if (pageRows[i] && imageRows_.hasImage(static_cast<ImageRowId>(i)))
+            ++pageRowCount;
+    if (pageRowCount == imageRows_.live())
+        return 0;
+
+    auto evicted = size_t{0};
+    for (size_t i = 0; i < historyLines && !_done(); ++i)
+    {
+        Line& line = lines_[i];
+
+        // Lines containing images are never compressed.
+        if (line.compressed())
+            continue;
+
+        auto const evictedBefore = evicted;
+        for (Cell const& cell: line)
+            if (cell.hasImage() && !pageRows[cell.imageRow()] && imageRows_.evict(cell.imageRow()))
+                ++evicted;
+
+        if (evicted != evictedBefore)
+            touch(line);
+    }
+    return evicted;
+}
+#endif
+
+void Grid::collectMemoryUsage(crispy::memory_usage& _usage, std::string const& _prefix) const
+{
+    auto page = LineMemoryUsage{};
+    auto history = LineMemoryUsage{};
+    auto const historyLines = static_cast<size_t>(historyLineCount());
+    for (size_t i = 0; i < lines_.size(); ++i)
+        lines_[i].addMemoryUsage(i < historyLines ? history : page);
+
+    _usage.add(_prefix + ".lines", lines_.capacity() * sizeof(Line));
+    _usage.add(_prefix + ".page.cells", page.cells);
+    _usage.add(_prefix + ".page.codepoints", page.codepoints);
+    _usage.add(_prefix + ".page.hyperlinks", page.hyperlinks);
+    _usage.add(_prefix + ".page.links", page.links);
+    _usage.add(_prefix + ".history.cells", history.cells);
+    _usage.add(_prefix + ".history.codepoints", history.codepoints);
+    _usage.add(_prefix + ".history.hyperlinks", history.hyperlinks);
+    _usage.add(_prefix + ".history.compressed", history.compressed);
+    _usage.add(_prefix + ".history.links", history.links);
+    _usage.add(_prefix + ".attributes", attributes_.memoryUsage());
+#if defined(LIBTERMINAL_IMAGES)
+    _usage.add(_prefix + ".image_rows", imageRows_.memoryUsage());
+#endif
+    _usage.add(_prefix + ".indexes", searchIndex_.memoryUsage() + markIndex_.memoryUsage()
+                                    + logicalLineIndex_.memoryUsage());
+}
+
+#if defined(LIBTERMINAL_HYPERLINKS)
+void Grid::markUsedHyperlinks(std::vector<bool>& _used) const
+{
+    for (Line const& line: lines_)
+        line.markUsedHyperlinks(_used);
+}
+#endif
+
+void Grid::appendNewLines(int _count, GraphicsAttributesId _attr)
+{
+    auto const wrappableFlag = lines_.back().wrappableFlag();
+
+    // Not to be mistaken with the main page being short of lines (e.g. after reflowing it).
+    if (maxHistoryLineCount_.has_value() && historyLineCount() == *maxHistoryLineCount_)
+    {
+        // We've reached to history line count limit already.
+        // Rotate lines that would fall off down to the bottom again in a clean state.
+        // We do save quite some overhead due to avoiding unnecessary memory allocations.
+        dropIndexedLines(_count);
+        for (int i = 0; i < _count; ++i)
+        {
+            lines_.rotate_left();
+            lines_.back().reset(_attr);
+            lines_.back().reserveColumns(reservedColumns_);
+        }
+        if (!pendingReflow_.empty())
+        {
+            // Recycled lines may stem from history that has not been reflowed yet.
+            for (Line& line : lines(static_cast<int>(lines_.size()) - _count, static_cast<int>(lines_.size())))
+                line.resize(screenSize_.width);
+            dropPendingReflow(_count);
+        }
+        compressHistory(_count);
+        return;
+    }
+
+    if (auto const n = min(_count, screenSize_.height); n > 0)
+    {
+        generate_n(
+            back_inserter(lines_),
+            n,
+            [&]() {
+                auto line = Line(screenSize_.width, _attr, wrappableFlag);
+                line.reserveColumns(reservedColumns_);
+                return line;
+            }
+        );
+        clampHistory();
+        compressHistory(n);
+    }
+}
+
+void Grid::clearHistory()
+{
+    if (historyLineCount())
+    {
+        droppedLineCount_ += static_cast<uint64_t>(historyLineCount());
+        lines_.pop_front(static_cast<size_t>(historyLineCount()));
+    }
+
+    pendingReflow_.clear();
+    searchIndex_.clear();
+    markIndex_.clear();
+    logicalLineIndex_.clear();
+    historyMemory_.reset();
+    accountedLineCount_ = 0;
+    savedHistory_.dropped += savedHistory_.count;
+    savedHistory_.count = 0;
+
+    // Start over with a fresh file, once the old records are not referenced anymore.
+    scrollbackFile_.reset();
+}
+
+int Grid::restore(GraphicsAttributesTable _attributes, vector<Line> _history, vector<Line> _page)
+{
+    clearHistory();
+    lines_.clear();
+    attributes_ = move(_attributes);
+    reserveLines();
+
+    auto const columnCount = screenSize_.width;
+    auto const historyLineCount = static_cast<int>(_history.size());
+    auto pendingLineCount = 0;
+    for (Line& line : _history)
+    {
+        if (line.size() != columnCount)
+        {
+            if (!reflowOnResize_)
+                line.resize(columnCount);
+            else
+                pendingLineCount = static_cast<int>(lines_.size()) + 1;
+        }
+        lines_.emplace_back(move(line));
+    }
 
-    while (static_cast<int>(_logicalLineBuffer.size()) >= _newColumnCount)
+    // Consecutive lines of the same width make up one segment, and lines already being of the
+    // current width are simply skipped by reflowHistory().
+    for (int i = 0; i < pendingLineCount; ++i)
     {
-        auto from = begin(_logicalLineBuffer);
-        auto to = next(begin(_logicalLineBuffer), _newColumnCount);
-        auto const wrappedFlag = i == 0 && _initialNoWrap ? Line::Flags::None : Line::Flags::Wrapped;
-        _targetLines.emplace_back(Line(from, to, _baseFlags | wrappedFlag));
-        logf(" - add line: '{}' ({})", _targetLines.back().toUtf8(), _targetLines.back().flags());
-        _logicalLineBuffer.erase(from, to);
-        ++i;
+        auto const lineColumnCount = lines_[static_cast<size_t>(i)].size();
+        if (!pendingReflow_.empty() && pendingReflow_.back().columnCount == lineColumnCount)
+            ++pendingReflow_.back().lineCount;
+        else
+            pendingReflow_.push_back(PendingReflow{1, lineColumnCount});
     }
 
-    if (_logicalLineBuffer.size() > 0)
+    auto const movedLineCount = max(0, static_cast<int>(_page.size()) - screenSize_.height);
+    for (Line& line : _page)
     {
-        auto const wrappedFlag = i == 0 && _initialNoWrap ? Line::Flags::None : Line::Flags::Wrapped;
-        _targetLines.emplace_back(Line(_newColumnCount, move(_logicalLineBuffer), _baseFlags | wrappedFlag));
-        logf(" - add line: '{}' ({})", _targetLines.back().toUtf8(), _targetLines.back().flags());
+        line.resize(columnCount);
+        lines_.emplace_back(move(line));
     }
+    for (auto i = static_cast<int>(_page.size()); i < screenSize_.height; ++i)
+        lines_.emplace_back(Line(columnCount, DefaultGraphicsAttributesId, reflowOnResize_ ? Line::Flags::Wrappable : Line::Flags::None));
+
+    // The given history lines are considered saved already.
+    savedHistory_ = SavedHistory{0, historyLineCount};
+
+    clampHistory();
+    compressHistory();
+    touchPage();
+
+    return movedLineCount;
 }
 
-void Grid::setMaxHistoryLineCount(optional<int> _maxHistoryLineCount)
+int Grid::pendingReflowLineCount() const noexcept
 {
-    maxHistoryLineCount_ = _maxHistoryLineCount;
-    clampHistory();
+    int count = 0;
+    for (PendingReflow const& segment : pendingReflow_)
+        count += segment.lineCount;
+    return count;
 }
 
-// TODO: rename to include word Logical
-/**
- * Computes the relative line number for the bottom-most @p _n logical lines.
- */
-int Grid::computeRelativeLineNumberFromBottom(int _n) const noexcept
+int Grid::reflowHistory(optional<int> _maxLines)
 {
-    int logicalLineCount = 0;
-    int outputRelativePhysicalLine = screenSize_.height;
+    CRISPY_PROFILE_ZONE("Grid::reflowHistory");
 
-    auto i = lines_.rbegin();
-    while (i != lines_.rend())
+    if (pendingReflow_.empty())
+        return 0;
+
+    auto const lineCount = static_cast<int>(lines_.size());
+    auto budget = _maxLines.value_or(lineCount);
+
+    // Segments are processed from the most recent one upwards, so that the lines
+    // closest to the main page become available first.
+    while (!pendingReflow_.empty() && budget > 0)
     {
-        if (!i->wrapped())
-            logicalLineCount++;
-        outputRelativePhysicalLine--;
-        ++i;
-        if (logicalLineCount == _n)
-            break;
+        PendingReflow& segment = pendingReflow_.back();
+        auto const last = pendingReflowLineCount();
+        auto const segmentStart = last - segment.lineCount;
+
+        if (segment.columnCount == screenSize_.width)
+        {
+            // Resized back to where these lines came from, so there's nothing to do.
+            pendingReflow_.pop_back();
+            continue;
+        }
+
+        auto first = max(segmentStart, last - budget);
+        while (first > segmentStart && lines_[static_cast<size_t>(first)].wrapped())
+            --first;
+
+        reflowLines(first, last, segment.columnCount);
+
+        budget -= last - first;
+        segment.lineCount -= last - first;
+        if (segment.lineCount == 0)
+            pendingReflow_.pop_back();
     }
 
-    // XXX If the top-most logical line is reached, we still need to traverse upwards until the
-    // beginning of the top-most logical line (the one that does not have the wrapped-flag set).
-    while (i != lines_.rend() && i->wrapped())
+    clampHistory();
+    compressHistory();
+
+    return static_cast<int>(lines_.size()) - lineCount;
+}
+
+void Grid::reflowMainPage(int _newColumnCount)
+{
+    // The main page and one page of history above it are reflowed right away, whereas the
+    // older history lines keep their current width until reflowHistory() gets to them.
+    // Lines pending from a previous resize are left untouched, so that resizing repeatedly
+    // (e.g. while dragging the window border) does not reflow the same history over and over.
+    auto const pendingLineCount = pendingReflowLineCount();
+    auto first = max(pendingLineCount, historyLineCount() - screenSize_.height);
+    while (first > pendingLineCount && lines_[static_cast<size_t>(first)].wrapped())
+        --first;
+
+    auto const columnCount = screenSize_.width;
+    screenSize_.width = _newColumnCount;
+    reflowLines(first, static_cast<int>(lines_.size()), columnCount);
+
+    if (auto const deferredLineCount = first - pendingLineCount; deferredLineCount > 0)
     {
-        printf("further upwards: l %d, p %d\n", logicalLineCount, outputRelativePhysicalLine);
-        outputRelativePhysicalLine--;
-        ++i;
+        if (!pendingReflow_.empty() && pendingReflow_.back().columnCount == columnCount)
+            pendingReflow_.back().lineCount += deferredLineCount;
+        else
+            pendingReflow_.push_back(PendingReflow{deferredLineCount, columnCount});
     }
 
-    return outputRelativePhysicalLine;
+    // Not worth deferring.
+    if (pendingReflowLineCount() < MinDeferredReflowLineCount)
+        reflowHistory();
 }
 
-Coordinate Grid::resize(Size _newSize, Coordinate _currentCursorPos, bool _wrapPending)
+int Grid::reflowLines(int _first, int _last, int _columnCount)
 {
-    auto const growLines = [this](int _newHeight) -> Coordinate
-    {
-        // Grow line count by splicing available lines from history back into buffer, if available,
-        // or create new ones until screenSize_.height == _newHeight.
+    auto const first = static_cast<size_t>(_first);
+    auto const last = static_cast<size_t>(_last);
+    auto const lineCount = lines_.size();
 
-        auto const extendCount = _newHeight - screenSize_.height;
-        auto const rowsToTakeFromSavedLines = min(extendCount, historyLineCount());
-        auto const fillLineCount = extendCount - rowsToTakeFromSavedLines;
-        auto const wrappableFlag = lines_.back().wrappableFlag();
+    invalidateIndexes(_first);
 
-        assert(rowsToTakeFromSavedLines >= 0);
-        assert(fillLineCount >= 0);
+    if (_columnCount == screenSize_.width)
+    {
+        for (auto i = first; i < last; ++i)
+            touch(lines_[i]);
+        return 0;
+    }
 
-        generate_n(
-            back_inserter(lines_),
-            fillLineCount,
-            [this, wrappableFlag]() { return Line(screenSize_.width, Cell{}, wrappableFlag); }
-        );
+    // Logical lines are reflowed independently of each other, so the lines are split into
+    // chunks at logical line boundaries, and the chunks are reflowed in parallel.
+    auto chunks = std::vector<crispy::range<Lines::iterator>>{};
+    auto const sourceEnd = next(lines_.begin(), _last);
+    for (auto i = next(lines_.begin(), _first); i != sourceEnd; )
+    {
+        auto j = next(i, min(std::distance(i, sourceEnd), ReflowChunkSize));
+        while (j != sourceEnd && j->wrapped())
+            ++j;
+        chunks.emplace_back(i, j);
+        i = j;
+    }
 
-        screenSize_.height = _newHeight;
+    auto reflowedChunks = std::vector<Lines>(chunks.size());
+    crispy::thread_pool::shared().parallel_for(chunks.size(), [&](size_t _chunk) {
+        reflowedChunks[_chunk].reserve(chunks[_chunk].size());
+        reflow(reflowedChunks[_chunk], chunks[_chunk], screenSize_.width);
+    });
 
-        return Coordinate{rowsToTakeFromSavedLines, 0};
-    };
+    // Only the lines below are moved, by as many lines as the reflowed ones differ in count,
+    // which keeps reflowing the bottom of the grid cheap.
+    auto reflowedCount = size_t{0};
+    for (Lines const& reflowedLines : reflowedChunks)
+        reflowedCount += reflowedLines.size();
 
-    auto const shrinkLines = [this](int _newHeight, Coordinate _cursor) -> Coordinate
+    if (reflowedCount > last - first)
     {
-        // Shrink existing line count to _newSize.height
-        // by splicing the number of lines to be shrinked by into savedLines bottom.
+        lines_.resize(lineCount + reflowedCount - (last - first));
+        std::move_backward(next(lines_.begin(), _last), next(lines_.begin(), static_cast<int>(lineCount)), lines_.end());
+    }
+    else if (reflowedCount < last - first)
+    {
+        std::move(next(lines_.begin(), _last), lines_.end(), next(lines_.begin(), static_cast<int>(first + reflowedCount)));
+        lines_.resize(lineCount - (last - first) + reflowedCount);
+    }
 
-        if (_cursor.row == screenSize_.height)
+    // Reflowed lines are new lines as far as observers of the line generations are concerned.
+    auto i = first;
+    for (Lines& reflowedLines : reflowedChunks)
+        for (Line& line : reflowedLines)
         {
-            auto const shrinkedLinesCount = screenSize_.height - _newHeight;
-            screenSize_.height = _newHeight;
-            clampHistory();
-            return Coordinate{shrinkedLinesCount, 0};
-        }
-        else
-        {
-            // Hard-cut below cursor by the number of lines to shrink.
-            lines_.resize(historyLineCount() + _newHeight);
-            screenSize_.height = _newHeight;
-            return Coordinate{0, 0};
+            lines_[i] = move(line);
+            touch(lines_[i++]);
         }
-    };
 
-    auto const growColumns = [this, _wrapPending](int _newColumnCount, Coordinate _cursor) -> Coordinate
+    return static_cast<int>(lines_.size()) - static_cast<int>(lineCount);
+}
+
+void Grid::dropPendingReflow(int _count)
+{
+    while (_count > 0 && !pendingReflow_.empty())
     {
-        if (!reflowOnResize_)
-        {
-            for (Line& line : lines_)
-                if (static_cast<int>(line.size()) < _newColumnCount)
-                    line.resize(_newColumnCount);
-            screenSize_.width = _newColumnCount;
-            return _cursor + Coordinate{0, _wrapPending ? 1 : 0};
-        }
-        else
-        {
-            // Grow columns by inverse shrink,
-            // i.e. the lines are traversed in reverse order.
+        auto const n = min(_count, pendingReflow_.front().lineCount);
+        pendingReflow_.front().lineCount -= n;
+        if (pendingReflow_.front().lineCount == 0)
+            pendingReflow_.erase(pendingReflow_.begin());
+        _count -= n;
+    }
+}
 
-            auto const extendCount = _newColumnCount - screenSize_.width;
-            assert(extendCount > 0);
+void Grid::updateSearchIndex()
+{
+    // The most recent history line may still be continued, see compressHistory().
+    auto const lineCount = historyLineCount() - 1;
+    searchIndex_.dropBack(max(0, searchIndex_.lineCount() - max(0, lineCount)));
+    for (int i = searchIndex_.lineCount(); i < lineCount; ++i)
+        searchIndex_.append(lines_[static_cast<size_t>(i)].toUtf8());
+}
 
-            logf("Growing by {} cols", extendCount);
+void Grid::updateMarkIndex() const
+{
+    // The most recent history line may still be continued, see compressHistory().
+    auto const lineCount = historyLineCount() - 1;
+    markIndex_.dropBack(max(0, markIndex_.lineCount() - max(0, lineCount)));
+    for (int i = markIndex_.lineCount(); i < lineCount; ++i)
+        markIndex_.append(lines_[static_cast<size_t>(i)].marked());
+}
 
-            Lines grownLines;
-            Line::Buffer logicalLineBuffer; // Temporary state, representing wrapped columns from the line "below".
-            Line::Flags logicalLineFlags = Line::Flags::None;
+void Grid::updateLogicalLineIndex() const
+{
+    // The most recent history line may still be continued, see compressHistory().
+    auto const lineCount = historyLineCount() - 1;
+    logicalLineIndex_.dropBack(max(0, logicalLineIndex_.lineCount() - max(0, lineCount)));
+    for (int i = logicalLineIndex_.lineCount(); i < lineCount; ++i)
+        logicalLineIndex_.append(lines_[static_cast<size_t>(i)].wrapped());
+}
 
-            [[maybe_unused]] auto i = 1;
-            for (Line& line : lines_)
-            {
-                logf("{:>2}: line: '{}' (wrapped: '{}') {}",
-                     i++,
-                     line.toUtf8(),
-                     Line(Line::Buffer(logicalLineBuffer), line.flags()).toUtf8(),
-                     line.wrapped() ? "WRAPPED" : "");
-                assert(line.size() >= screenSize_.width);
-
-                if (line.wrapped())
-                {
-                    crispy::copy(line.trim_blank_right(), back_inserter(logicalLineBuffer));
-                    logf(" - join: '{}'", Line(Line::Buffer(logicalLineBuffer), line.flags()).toUtf8());
-                }
-                else // line is not wrapped
-                {
-                    if (!logicalLineBuffer.empty())
-                    {
-                        addNewWrappedLines(grownLines, _newColumnCount, move(logicalLineBuffer), logicalLineFlags, true);
-                        logicalLineBuffer.clear();
-                    }
+void Grid::dropIndexedLines(int _count)
+{
+    unaccountLines(0, min(_count, accountedLineCount_));
+    accountedLineCount_ = max(0, accountedLineCount_ - _count);
 
-                    crispy::copy(line, back_inserter(logicalLineBuffer));
-                    logicalLineFlags = line.wrappableFlag() | line.markedFlag();
+    droppedLineCount_ += static_cast<uint64_t>(_count);
+    searchIndex_.dropFront(_count);
+    markIndex_.dropFront(_count);
+    logicalLineIndex_.dropFront(_count);
 
-                    logf(" - start new logical line: '{}'", line.toUtf8());
-                }
-            }
+    auto const savedLineCount = min(_count, savedHistory_.count);
+    savedHistory_.dropped += savedLineCount;
+    savedHistory_.count -= savedLineCount;
+}
 
-            if (!logicalLineBuffer.empty())
-            {
-                addNewWrappedLines(grownLines, _newColumnCount, move(logicalLineBuffer), logicalLineFlags, true);
-                logicalLineBuffer.clear();
-            }
+void Grid::invalidateIndexes(int _line)
+{
+    searchIndex_.dropBack(max(0, searchIndex_.lineCount() - _line));
+    markIndex_.dropBack(max(0, markIndex_.lineCount() - _line));
+    logicalLineIndex_.dropBack(max(0, logicalLineIndex_.lineCount() - _line));
+    savedHistory_.count = min(savedHistory_.count, max(0, _line));
+    if (accountedLineCount_ > _line)
+    {
+        unaccountLines(max(0, _line), accountedLineCount_);
+        accountedLineCount_ = max(0, _line);
+    }
+}
 
-            lines_ = move(grownLines);
-            screenSize_.width = _newColumnCount;
+optional<int> Grid::previousMarkedLine(int _line) const
+{
+    updateMarkIndex();
 
-            auto cy = 0;
-            if (historyLineCount() < 0)
-            {
-                cy = historyLineCount();
-                appendNewLines(-historyLineCount(), lines_.back()->back().attributes());
-            }
+    auto const lineCount = static_cast<int>(lines_.size());
+    for (int i = min(_line, lineCount) - 1; i >= markIndex_.lineCount(); --i)
+        if (lines_[static_cast<size_t>(i)].marked())
+            return i;
 
-            return _cursor + Coordinate{cy, _wrapPending ? 1 : 0};
-        }
-    };
+    return markIndex_.previous(min(_line, markIndex_.lineCount()));
+}
 
-    auto const shrinkColumns = [this](int _newColumnCount, Coordinate _cursor) -> Coordinate
-    {
-        if (!reflowOnResize_)
-        {
-            screenSize_.width = _newColumnCount;
-            crispy::for_each(lines_, [=](Line& line) {
-                if (line.size() < _newColumnCount)
-                    line.resize(_newColumnCount);
-            });
-            return _cursor + Coordinate{0, min(_cursor.column, _newColumnCount)};
-        }
-        else
-        {
-            // {{{ Shrinking progress
-            // -----------------------------------------------------------------------
-            //  (one-by-one)        | (from-5-to-2)
-            // -----------------------------------------------------------------------
-            // "ABCDE"              | "ABCDE"
-            // "abcde"              | "xy   "
-            // ->                   | "abcde"
-            // "ABCD"               | ->
-            // "E   "   Wrapped     | "AB"                  push "AB", wrap "CDE"
-            // "abcd"               | "CD"      Wrapped     push "CD", wrap "E"
-            // "e   "   Wrapped     | "E"       Wrapped     push "E",  inc line
-            // ->                   | "xy"      no-wrapped  push "xy", inc line
-            // "ABC"                | "ab"      no-wrapped  push "ab", wrap "cde"
-            // "DE "    Wrapped     | "cd"      Wrapped     push "cd", wrap "e"
-            // "abc"                | "e "      Wrapped     push "e",  inc line
-            // "de "    Wrapped
-            // ->
-            // "AB"
-            // "DE"     Wrapped
-            // "E "     Wrapped
-            // "ab"
-            // "cd"     Wrapped
-            // "e "     Wrapped
-            // }}}
-
-            Lines shrinkedLines;
-            Line::Buffer wrappedColumns;
-            Line::Flags previousFlags = lines_.front().inheritableFlags();
-
-            int i = 0;
-            for (Line& line : lines_)
-            {
-                logf("shrink line {}: \"{}\" wrapped: \"{}\"",
-                    i,
-                    line.toUtf8(),
-                    Line(Line::Buffer(wrappedColumns), previousFlags).toUtf8()
-                );
-                // do we have previous columns carried?
-                if (!wrappedColumns.empty())
-                {
-                    if (line.wrapped() && line.inheritableFlags() == previousFlags)
-                    {
-                        assert(previousFlags == line.inheritableFlags());
-                        // Prepend previously wrapped columns into current line.
-                        line.prepend(wrappedColumns);
-                    }
-                    else
-                    {
-                        // Insert NEW line(s) between previous and this line with previously wrapped columns.
-                        addNewWrappedLines(shrinkedLines, _newColumnCount, move(wrappedColumns), previousFlags, false);
-                        previousFlags = line.inheritableFlags();
-                    }
-                }
-                else
-                {
-                    previousFlags = line.inheritableFlags();
-                }
+optional<int> Grid::nextMarkedLine(int _line) const
+{
+    updateMarkIndex();
 
-                wrappedColumns = line.reflow(_newColumnCount);
+    if (_line < markIndex_.lineCount())
+        if (auto const line = markIndex_.next(_line); line.has_value())
+            return line;
 
-                auto const wrappedLine = Line(Line::Buffer(wrappedColumns), Line::Flags::None);
-                logf(" - ADD LINE: '{}' ({}) wrapped: \"{}\"", line.toUtf8(), line.flags(),
-                    Line(Line::Buffer(wrappedColumns), Line::Flags::None).toUtf8());
+    auto const lineCount = static_cast<int>(lines_.size());
+    for (int i = max(_line + 1, markIndex_.lineCount()); i < lineCount; ++i)
+        if (lines_[static_cast<size_t>(i)].marked())
+            return i;
 
-                shrinkedLines.emplace_back(move(line));
-                assert(shrinkedLines.back().size() >= _newColumnCount);
-                i++;
-            }
-            addNewWrappedLines(shrinkedLines, _newColumnCount, move(wrappedColumns), previousFlags, false);
+    return nullopt;
+}
 
-            lines_ = move(shrinkedLines);
-            screenSize_.width = _newColumnCount;
+vector<Coordinate> Grid::search(string_view _literal)
+{
+    auto matches = vector<Coordinate>{};
+    if (_literal.empty())
+        return matches;
 
-            return _cursor; // TODO
+    updateSearchIndex();
+
+    auto cellOffsets = vector<size_t>{};
+    auto const searchLine = [&](int _line) {
+        auto const text = lines_[static_cast<size_t>(_line)].toUtf8(&cellOffsets);
+        for (auto i = text.find(_literal); i != string::npos; i = text.find(_literal, i + 1))
+        {
+            auto const column = std::upper_bound(cellOffsets.begin(), cellOffsets.end(), i) - cellOffsets.begin();
+            matches.emplace_back(Coordinate{_line, static_cast<int>(column)});
         }
     };
 
-    Coordinate cursorPosition = _currentCursorPos;
+    searchIndex_.forEachCandidate(_literal, [&](int _first, int _count) {
+        for (int line = _first; line < _first + _count; ++line)
+            searchLine(line);
+    });
+
+    for (int line = searchIndex_.lineCount(); line < static_cast<int>(lines_.size()); ++line)
+        searchLine(line);
+
+    // Occurrences spanning wrapped lines, which none of the lines contains on its own,
+    // are searched for in the text of the logical lines spanning multiple lines.
+    auto const matchCount = matches.size();
+    auto lineCells = vector<int>{};
+    auto const searchLogicalLine = [&](LogicalLine _logicalLine) {
+        auto const text = logicalLineText(_logicalLine, &cellOffsets);
+        lineCells.clear();
+        for (int line = _logicalLine.first, cells = 0; line <= _logicalLine.last(); ++line)
+            lineCells.push_back(cells += lines_[static_cast<size_t>(line)].size());
+        auto const lineOf = [&](size_t _offset) {
+            auto const cell = std::upper_bound(cellOffsets.begin(), cellOffsets.end(), _offset) - cellOffsets.begin() - 1;
+            return static_cast<int>(std::upper_bound(lineCells.begin(), lineCells.end(), cell) - lineCells.begin());
+        };
+        for (auto i = text.find(_literal); i != string::npos; i = text.find(_literal, i + 1))
+        {
+            auto const line = lineOf(i);
+            if (line == lineOf(i + _literal.size() - 1))
+                continue;
+            auto const column = std::upper_bound(cellOffsets.begin(), cellOffsets.end(), i) - cellOffsets.begin()
+                              - (line ? lineCells[static_cast<size_t>(line - 1)] : 0);
+            matches.emplace_back(Coordinate{_logicalLine.first + line, static_cast<int>(column)});
+        }
+    };
 
-    // grow/shrink columns
-    switch (crispy::strongCompare(_newSize.width, screenSize_.width))
+    updateLogicalLineIndex();
+    auto const indexed = logicalLineIndex_.lineCount();
+    auto const continued = indexed < static_cast<int>(lines_.size()) && lines_[static_cast<size_t>(indexed)].wrapped();
+    logicalLineIndex_.forEach([&](int _first, int _count) {
+        // One continued beyond the indexed lines is searched along with those.
+        if (!continued || _first + _count < indexed)
+            searchLogicalLine(LogicalLine{ _first, _count });
+    });
+    for (int line = indexed; line < static_cast<int>(lines_.size()); )
     {
-        case Comparison::Greater:
-            cursorPosition = growColumns(_newSize.width, cursorPosition);
-            break;
-        case Comparison::Less:
-            cursorPosition = shrinkColumns(_newSize.width, cursorPosition);
-            break;
-        case Comparison::Equal:
-            break;
+        auto const logicalLine = logicalLineAt(line);
+        if (logicalLine.count > 1)
+            searchLogicalLine(logicalLine);
+        line = logicalLine.last() + 1;
     }
 
-    // grow/shrink lines
-    switch (crispy::strongCompare(_newSize.height, screenSize_.height))
+    if (matches.size() > matchCount)
+        std::sort(matches.begin(), matches.end());
+
+    return matches;
+}
+
+vector<Coordinate> Grid::search(std::regex const& _regex) const
+{
+    auto matches = vector<Coordinate>{};
+    for (SearchMatch const& match : searchSnapshot().search(_regex))
+        matches.emplace_back(Coordinate{match.line, match.firstColumn});
+    return matches;
+}
+
+SearchSnapshot Grid::searchSnapshot() const
+{
+    auto snapshot = SearchSnapshot{};
+    auto cellOffsets = vector<size_t>{};
+    for (Line const& line : lines_)
     {
-        case Comparison::Greater:
-            cursorPosition += growLines(_newSize.height);
-            break;
-        case Comparison::Less:
-            cursorPosition += shrinkLines(_newSize.height, cursorPosition);
-            break;
-        case Comparison::Equal:
-            break;
+        auto text = line.toUtf8(&cellOffsets);
+        snapshot.append(move(text), cellOffsets);
     }
+    return snapshot;
+}
 
-    return cursorPosition;
+void Grid::touchLines(int _fromRow, int _toRow) noexcept
+{
+    for (int row = max(1, _fromRow); row <= min(_toRow, screenSize_.height); ++row)
+        touch(lineAt(row));
 }
 
-void Grid::appendNewLines(int _count, GraphicsAttributes _attr)
+void Grid::touchMovedLines(int _fromRow, int _toRow) noexcept
 {
-    auto const wrappableFlag = lines_.back().wrappableFlag();
+    for (int row = max(1, _fromRow); row <= min(_toRow, screenSize_.height); ++row)
+        lineAt(row).setMovedGeneration(++generation_);
+}
 
-    if (historyLineCount() == maxHistoryLineCount().value_or(-1))
+void Grid::fill(int _top, int _left, int _bottom, int _right, GraphicsAttributesId _attributes, char32_t _codepoint)
+{
+    for (int row = max(1, _top); row <= min(_bottom, screenSize_.height); ++row)
     {
-        // We've reached to history line count limit already.
-        // Rotate lines that would fall off down to the bottom again in a clean state.
-        // We do save quite some overhead due to avoiding unnecessary memory allocations.
-        for (int i = 0; i < _count; ++i)
+        Line& line = lineAt(row);
+        auto const right = min(_right, line.size());
+        if (_left <= right)
+            line.fill(_left - 1, right, _attributes, _codepoint);
+        touch(line);
+    }
+}
+
+void Grid::copyArea(int _top, int _left, int _bottom, int _right, int _targetTop, int _targetLeft)
+{
+    auto const height = min(min(_bottom, screenSize_.height) - _top, screenSize_.height - _targetTop) + 1;
+    auto const width = min(min(_right, screenSize_.width) - _left, screenSize_.width - _targetLeft) + 1;
+    if (_top < 1 || _left < 1 || _targetTop < 1 || _targetLeft < 1 || height <= 0 || width <= 0)
+        return;
+
+    // Each row is transferred as one block. Within a row, and across rows, the copy runs
+    // in the direction that reads every overlapping source cell before overwriting it.
+    auto const copyRow = [&](int _row) {
+        Line& source = lineAt(_top + _row);
+        Line& target = lineAt(_targetTop + _row);
+        auto const first = next(source.begin(), _left - 1);
+        auto const last = next(first, width);
+        auto const targetFirst = next(target.begin(), _targetLeft - 1);
+        if (&source == &target && _targetLeft > _left)
+            std::copy_backward(first, last, next(targetFirst, width));
+        else
+            std::copy(first, last, targetFirst);
+        touch(target);
+    };
+
+    if (_targetTop > _top)
+        for (int row = height - 1; row >= 0; --row)
+            copyRow(row);
+    else
+        for (int row = 0; row < height; ++row)
+            copyRow(row);
+}
+
+void Grid::touchPage(uint64_t _generation) noexcept
+{
+    generation_ = max(generation_, _generation);
+    touchLines(1, screenSize_.height);
+}
+
+void Grid::touchPage(Grid const& _previous)
+{
+    // Cells of either grid refer to their own graphics renditions, so those are compared by value.
+    auto const sameCells = [&](Line const& _line, Line const& _other) {
+        if (_line.size() != _other.size())
+            return false;
+
+        auto const cells = _line.untrimmedCells();
+        auto const otherCells = _other.untrimmedCells();
+        auto const blank = Cell{{}, _line.trimmedAttributes()};
+        auto const otherBlank = Cell{{}, _other.trimmedAttributes()};
+        for (int column = 0; column < _line.size(); ++column)
         {
-            Line line = move(lines_.front());
-            lines_.pop_front();
-            line.reset(_attr);
-            lines_.emplace_back(move(line));
+            Cell const& cell = column < static_cast<int>(cells.size()) ? *next(cells.begin(), column) : blank;
+            Cell const& other = column < static_cast<int>(otherCells.size()) ? *next(otherCells.begin(), column) : otherBlank;
+            if (cell.codepointCount() != other.codepointCount()
+                    || cell.width() != other.width()
+                    || cell.hasImage() || other.hasImage()
+#if defined(LIBTERMINAL_HYPERLINKS)
+                    || cell.hyperlink() != other.hyperlink()
+#endif
+                    || !(attributes(cell) == _previous.attributes(other)))
+                return false;
+            for (int i = 0; i < cell.codepointCount(); ++i)
+                if (cell.codepoint(static_cast<size_t>(i)) != other.codepoint(static_cast<size_t>(i)))
+                    return false;
         }
-        return;
-    }
+        return true;
+    };
 
-    if (auto const n = min(_count, screenSize_.height); n > 0)
+    generation_ = max(generation_, _previous.generation());
+    for (int row = 1; row <= min(screenSize_.height, _previous.screenSize_.height); ++row)
     {
-        generate_n(
-            back_inserter(lines_),
-            n,
-            [&]() { return Line(screenSize_.width, Cell{{}, _attr}, wrappableFlag); }
-        );
-        clampHistory();
+        Line& line = lineAt(row);
+        Line const& other = _previous.lineAt(row);
+        if (sameCells(line, other))
+            line.setGeneration(other.generation());
+        else
+            touch(line);
     }
+    touchLines(_previous.screenSize_.height + 1, screenSize_.height);
 }
 
-void Grid::clearHistory()
+vector<int> Grid::changedLines(uint64_t _generation, optional<int> _scrollOffset) const
 {
-    if (historyLineCount())
-        lines_.erase(begin(lines_), next(begin(lines_), historyLineCount()));
+    auto rows = vector<int>{};
+    for (auto const && [row, line] : crispy::indexed(pageAtScrollOffset(_scrollOffset), 1))
+        if (line.generation() > _generation)
+            rows.push_back(row);
+    return rows;
+}
+
+void Grid::reserveLines()
+{
+    // Preallocating the line slots for the full scrollback lets lines be recycled
+    // once the history limit is reached, rather than the storage growing further.
+    if (maxHistoryLineCount_.has_value())
+        lines_.reserve(static_cast<size_t>(*maxHistoryLineCount_ + screenSize_.height));
 }
 
 void Grid::clampHistory()
@@ -640,11 +2404,15 @@ void Grid::clampHistory()
         line.setFlag(Line::Flags::Wrappable, wrappable);
     }
 
-    lines_.erase(begin(lines_), next(begin(lines_), diff));
+    dropIndexedLines(diff);
+    lines_.pop_front(static_cast<size_t>(diff));
+    dropPendingReflow(diff);
 }
 
 void Grid::scrollUp(int _n, GraphicsAttributes const& _defaultAttributes, Margin const& _margin)
 {
+    CRISPY_PROFILE_ZONE("Grid::scrollUp");
+    auto const defaultAttributes = intern(_defaultAttributes);
     if (_margin.horizontal != Margin::Range{1, screenSize_.width})
     {
         // a full "inside" scroll-up
@@ -657,11 +2425,13 @@ void Grid::scrollUp(int _n, GraphicsAttributes const& _defaultAttributes, Margin
             auto sourceLine = next(begin(mainPage()), _margin.vertical.from - 1 + n); // source line
             auto const bottomLine = next(begin(mainPage()), _margin.vertical.to);     // bottom margin's end-line iterator
 
+            // Source cells are either overwritten or cleared afterwards, so they can be moved.
             for (; sourceLine != bottomLine; ++sourceLine, ++targetLine)
             {
-                copy_n(
-                    next(begin(*sourceLine), _margin.horizontal.from - 1),
-                    _margin.horizontal.length(),
+                auto const source = next(begin(*sourceLine), _margin.horizontal.from - 1);
+                std::move(
+                    source,
+                    next(source, _margin.horizontal.length()),
                     next(begin(*targetLine), _margin.horizontal.from - 1)
                 );
             }
@@ -670,34 +2440,14 @@ void Grid::scrollUp(int _n, GraphicsAttributes const& _defaultAttributes, Margin
         // clear bottom n lines in margin.
         auto const topLine = next(begin(mainPage()), _margin.vertical.to - n);
         auto const bottomLine = next(begin(mainPage()), _margin.vertical.to);     // bottom margin's end-line iterator
-#if 1
         for (Line& line : crispy::range(topLine, bottomLine))
-        {
-            fill_n(
-                next(begin(line), _margin.horizontal.from - 1),
-                _margin.horizontal.length(),
-                Cell{{}, _defaultAttributes}
-            );
-        }
-#else
-        for_each(
-            topLine,
-            bottomLine,
-            [&](Line& line) {
-                fill_n(
-                    next(begin(line), _margin.horizontal.from - 1),
-                    _margin.horizontal.length(),
-                    Cell{{}, _defaultAttributes}
-                );
-            }
-        );
-#endif
+            line.fill(_margin.horizontal.from - 1, _margin.horizontal.to, defaultAttributes);
     }
     else if (_margin.vertical == Margin::Range{1, screenSize_.height})
     {
         if (auto const n = min(_n, screenSize_.height); n > 0)
         {
-            appendNewLines(n, _defaultAttributes);
+            appendNewLines(n, defaultAttributes);
         }
     }
     else
@@ -714,19 +2464,27 @@ void Grid::scrollUp(int _n, GraphicsAttributes const& _defaultAttributes, Margin
             );
         }
 
-        for_each(
+        std::for_each(
             LIBTERMINAL_EXECUTION_COMMA(par)
             next(begin(mainPage()), _margin.vertical.to - n),
             next(begin(mainPage()), _margin.vertical.to),
             [&](Line& line) {
-                fill(begin(line), end(line), Cell{{}, _defaultAttributes});
+                line.reset(defaultAttributes);
             }
         );
     }
+
+    // Lines scrolled as a whole keep what has been derived from their contents.
+    if (_margin.horizontal != Margin::Range{1, screenSize_.width})
+        touchLines(_margin.vertical.from, _margin.vertical.to);
+    else
+        touchMovedLines(_margin.vertical.from, _margin.vertical.to);
 }
 
 void Grid::scrollDown(int v_n, GraphicsAttributes const& _defaultAttributes, Margin const& _margin)
 {
+    CRISPY_PROFILE_ZONE("Grid::scrollDown");
+    auto const defaultAttributes = intern(_defaultAttributes);
     auto const marginHeight = _margin.vertical.length();
     auto const n = min(v_n, marginHeight);
 
@@ -739,49 +2497,35 @@ void Grid::scrollDown(int v_n, GraphicsAttributes const& _defaultAttributes, Mar
             auto targetLine = next(begin(mainPage()), _margin.vertical.to - 1);
             auto const sourceEndLine = next(begin(mainPage()), _margin.vertical.from - 1);
 
+            // Source cells are either overwritten or cleared afterwards, so they can be moved.
+            auto const moveCells = [&](Line& _source, Line& _target) {
+                auto const source = next(begin(_source), _margin.horizontal.from - 1);
+                std::move(
+                    source,
+                    next(source, _margin.horizontal.length()),
+                    next(begin(_target), _margin.horizontal.from - 1)
+                );
+            };
+
             while (sourceLine != sourceEndLine)
             {
-                copy_n(
-                    next(begin(*sourceLine), _margin.horizontal.from - 1),
-                    _margin.horizontal.length(),
-                    next(begin(*targetLine), _margin.horizontal.from - 1)
-                );
+                moveCells(*sourceLine, *targetLine);
                 --targetLine;
                 --sourceLine;
             }
 
-            copy_n(
-                next(begin(*sourceLine), _margin.horizontal.from - 1),
-                _margin.horizontal.length(),
-                next(begin(*targetLine), _margin.horizontal.from - 1)
-            );
+            moveCells(*sourceLine, *targetLine);
 
-            for_each(
-                next(begin(mainPage()), _margin.vertical.from - 1),
-                next(begin(mainPage()), _margin.vertical.from - 1 + n),
-                [&](Line& line) {
-                    fill_n(
-                        next(begin(line), _margin.horizontal.from - 1),
-                        _margin.horizontal.length(),
-                        Cell{{}, _defaultAttributes}
-                    );
-                }
-            );
+            auto const topLine = next(begin(mainPage()), _margin.vertical.from - 1);
+            for (Line& line : crispy::range(topLine, next(topLine, n)))
+                line.fill(_margin.horizontal.from - 1, _margin.horizontal.to, defaultAttributes);
         }
         else
         {
             // clear everything in margin
-            for_each(
-                next(begin(mainPage()), _margin.vertical.from - 1),
-                next(begin(mainPage()), _margin.vertical.to),
-                [&](Line& line) {
-                    fill_n(
-                        next(begin(line), _margin.horizontal.from - 1),
-                        _margin.horizontal.length(),
-                        Cell{{}, _defaultAttributes}
-                    );
-                }
-            );
+            auto const topLine = next(begin(mainPage()), _margin.vertical.from - 1);
+            for (Line& line : crispy::range(topLine, next(topLine, marginHeight)))
+                line.fill(_margin.horizontal.from - 1, _margin.horizontal.to, defaultAttributes);
         }
     }
     else if (_margin.vertical == Margin::Range{1, screenSize_.height})
@@ -792,15 +2536,11 @@ void Grid::scrollDown(int v_n, GraphicsAttributes const& _defaultAttributes, Mar
             end(mainPage())
         );
 
-        for_each(
+        std::for_each(
             begin(mainPage()),
             next(begin(mainPage()), n),
             [&](Line& line) {
-                fill(
-                    begin(line),
-                    end(line),
-                    Cell{{}, _defaultAttributes}
-                );
+                line.reset(defaultAttributes);
             }
         );
     }
@@ -813,44 +2553,39 @@ void Grid::scrollDown(int v_n, GraphicsAttributes const& _defaultAttributes, Mar
             next(begin(mainPage()), _margin.vertical.to)
         );
 
-        for_each(
+        std::for_each(
             next(begin(mainPage()), _margin.vertical.from - 1),
             next(begin(mainPage()), _margin.vertical.from - 1 + n),
             [&](Line& line) {
-                fill(
-                    begin(line),
-                    end(line),
-                    Cell{{}, _defaultAttributes}
-                );
+                line.reset(defaultAttributes);
             }
         );
     }
+
+    // Lines scrolled as a whole keep what has been derived from their contents.
+    if (_margin.horizontal != Margin::Range{1, screenSize_.width})
+        touchLines(_margin.vertical.from, _margin.vertical.to);
+    else
+        touchMovedLines(_margin.vertical.from, _margin.vertical.to);
 }
 
 string Grid::renderTextLineAbsolute(int row) const
 {
-    string line;
-    line.reserve(screenSize_.width);
-    for (int col = 1; col <= screenSize_.width; ++col)
-        if (auto const& cell = at({row - historyLineCount() + 1, col}); cell.codepointCount())
-            line += cell.toUtf8();
-        else
-            line += " "; // fill character
-
-    return line;
+    // Restores a compressed line, as accessing any of its cells does.
+    auto const& line = absoluteLineAt(row);
+    (void) line.cbegin();
+    auto text = string{};
+    line.appendUtf8(text, screenSize_.width);
+    return text;
 }
 
 string Grid::renderTextLine(int row) const
 {
-    string line;
-    line.reserve(screenSize_.width);
-    for (int col = 1; col <= screenSize_.width; ++col)
-        if (auto const& cell = at({row, col}); cell.codepointCount())
-            line += cell.toUtf8();
-        else
-            line += " "; // fill character
-
-    return line;
+    auto const& line = lineAt(row);
+    (void) line.cbegin();
+    auto text = string{};
+    line.appendUtf8(text, screenSize_.width);
+    return text;
 }
 
 string Grid::renderAllText() const
@@ -860,7 +2595,7 @@ string Grid::renderAllText() const
 
     for (int lineNr = 0; lineNr < historyLineCount() + screenSize_.height; ++lineNr)
     {
-        text += renderTextLineAbsolute(lineNr);
+        absoluteLineAt(lineNr).appendUtf8(text, screenSize_.width);
         text += '\n';
     }
 
@@ -874,7 +2609,7 @@ string Grid::renderText() const
 
     for (int lineNr = 1; lineNr <= screenSize_.height; ++lineNr)
     {
-        text += renderTextLine(lineNr);
+        lineAt(lineNr).appendUtf8(text, screenSize_.width);
         text += '\n';
     }
 
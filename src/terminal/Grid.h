@@ -18,12 +18,19 @@
 #include <terminal/Color.h>
 #include <terminal/Hyperlink.h>
 #include <terminal/Image.h>
+#include <terminal/LinkDetector.h>
+#include <terminal/TriggerEngine.h>
+#include <terminal/SearchIndex.h>
+#include <terminal/SearchSnapshot.h>
 
 #include <crispy/algorithm.h>
 #include <crispy/indexed.h>
+#include <crispy/memory_usage.h>
 #include <crispy/point.h>
 #include <crispy/range.h>
+#include <crispy/ring.h>
 #include <crispy/size.h>
+#include <crispy/size_class_pool.h>
 #include <crispy/span.h>
 #include <crispy/times.h>
 #include <crispy/utils.h>
@@ -36,21 +43,28 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <deque>
 #include <functional>
+#include <limits>
 #include <list>
 #include <map>
 #include <memory>
 #include <optional>
+#include <regex>
 #include <set>
 #include <sstream>
 #include <stack>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace terminal {
 
+class ScrollbackFile;
+
 // {{{ Margin
 struct Margin {
 	struct Range {
@@ -196,122 +210,305 @@ constexpr bool operator!=(GraphicsAttributes const& a, GraphicsAttributes const&
 }
 // }}}
 
+// {{{ GraphicsAttributesTable
+/// Identifies a GraphicsAttributes value within a GraphicsAttributesTable.
+using GraphicsAttributesId = uint16_t;
+
+/// Identifier of the default graphics rendition, which is contained in every table.
+constexpr GraphicsAttributesId DefaultGraphicsAttributesId = 0;
+
+/// Deduplicates the graphics renditions used by a grid, so that each cell only needs
+/// to store a small identifier rather than the full GraphicsAttributes.
+///
+/// Entries are never released individually. Once the table runs full, the owning grid
+/// compacts it down to the identifiers still referenced by any of its cells.
+class GraphicsAttributesTable {
+  public:
+    static constexpr size_t Capacity = size_t(std::numeric_limits<GraphicsAttributesId>::max()) + 1;
+
+    GraphicsAttributesTable();
+
+    size_t size() const noexcept { return values_.size(); }
+
+    /// @returns the bytes allocated by this table.
+    size_t memoryUsage() const noexcept
+    {
+        return crispy::allocated_bytes(values_) + crispy::hash_table_bytes(ids_);
+    }
+
+    GraphicsAttributes const& operator[](GraphicsAttributesId _id) const noexcept { return values_[_id]; }
+
+    /// @returns the identifier of @p _attributes, interning it if not yet present,
+    ///          or std::nullopt if the table is full.
+    std::optional<GraphicsAttributesId> intern(GraphicsAttributes const& _attributes);
+
+    /// Drops all entries whose identifier is not marked in @p _used.
+    ///
+    /// @returns a mapping from each previously used identifier to its new one.
+    std::vector<GraphicsAttributesId> compact(std::vector<bool> const& _used);
+
+    /// Changes whenever compact() reassigns identifiers, and is unique across all tables
+    /// otherwise, so that values derived from identifiers can be cached along with it.
+    uint64_t version() const noexcept { return version_; }
+
+  private:
+    /// Exact representation of a GraphicsAttributes value.
+    ///
+    /// Color's equality operator only looks at the first byte of the color value,
+    /// which is not precise enough to tell RGB colors apart.
+    using Key = std::array<uint32_t, 4>;
+
+    struct KeyHash {
+        size_t operator()(Key const& _key) const noexcept
+        {
+            uint64_t h = 14695981039346656037ull;
+            for (uint32_t const v: _key)
+                h = (h ^ v) * 1099511628211ull;
+            return static_cast<size_t>(h);
+        }
+    };
+
+    static Key keyOf(GraphicsAttributes const& _attributes) noexcept;
+    static uint64_t nextVersion() noexcept;
+
+    uint64_t version_ = nextVersion();
+    std::vector<GraphicsAttributes> values_;
+    std::unordered_map<Key, GraphicsAttributesId, KeyHash> ids_;
+
+    // Consecutive lookups are most likely for the very same value, so remember the last one.
+    Key lastKey_;
+    GraphicsAttributesId lastId_ = DefaultGraphicsAttributesId;
+};
+// }}}
+
+// {{{ ImageRowTable
+#if defined(LIBTERMINAL_IMAGES)
+/// Identifies a single row of cells of a placed image within an ImageRowTable.
+using ImageRowId = uint32_t;
+
+/// Keeps track of the images placed onto a grid, with one entry per row of cells covered
+/// by an image, so that each cell only needs to store the row's identifier and its column.
+///
+/// Entries are never released individually. Every now and then, the owning grid releases
+/// all rows no longer referenced by any of its cells, whose identifiers are then reused.
+///
+/// Rows may be evicted though, dropping their image while still being referenced,
+/// so that their cells display nothing but a blank placeholder.
+class ImageRowTable {
+  public:
+    static constexpr size_t Capacity = size_t(1) << 20;
+
+    /// Number of identifiers handed out so far, including the released ones.
+    size_t size() const noexcept { return rows_.size(); }
+
+    /// Number of rows added since the last call to release().
+    size_t added() const noexcept { return added_; }
+
+    /// Number of rows that have not been released.
+    size_t used() const noexcept { return rows_.size() - released_.size(); }
+
+    /// Number of rows that have neither been released nor evicted.
+    size_t live() const noexcept { return live_; }
+
+    /// @returns the bytes allocated by this table, not including the images.
+    size_t memoryUsage() const noexcept
+    {
+        return crispy::allocated_bytes(rows_) + crispy::allocated_bytes(released_);
+    }
+
+    /// Adds row @p _row (0-based, in grid cells) of the given image.
+    ///
+    /// @returns the identifier of the row or std::nullopt if the table is full.
+    std::optional<ImageRowId> add(std::shared_ptr<RasterizedImage const> _image, int _row);
+
+    /// @returns the fragment of the given image row at the given 0-based image column,
+    ///          or std::nullopt if the row has been evicted.
+    std::optional<ImageFragment> fragment(ImageRowId _id, int _column) const
+    {
+        if (!rows_[_id].image)
+            return std::nullopt;
+        return ImageFragment{rows_[_id].image, Coordinate{rows_[_id].row, _column}};
+    }
+
+    /// @returns whether the given row still has its image, i.e. has neither been evicted nor released.
+    bool hasImage(ImageRowId _id) const noexcept { return rows_[_id].image != nullptr; }
+
+    /// Drops the image of the given row, while keeping the row itself until released.
+    ///
+    /// @returns whether the row still had its image.
+    bool evict(ImageRowId _id);
+
+    /// Releases all rows whose identifier is not marked in @p _used.
+    void release(std::vector<bool> const& _used);
+
+  private:
+    struct Row {
+        std::shared_ptr<RasterizedImage const> image;
+        int row = 0;
+        bool evicted = false;
+    };
+
+    std::vector<Row> rows_;
+    std::vector<ImageRowId> released_;
+    size_t added_ = 0;
+    size_t live_ = 0;
+};
+#endif
+// }}}
+
 // {{{ Cell
+/// Codepoints below U+0300 (ASCII and Latin-1, up to the combining diacritical marks)
+/// are all one column wide, and none of them extend the grapheme cluster of a preceding
+/// codepoint in that same range. This allows skipping the Unicode property lookups for them.
+constexpr char32_t NarrowCodepointLimit = 0x300;
+
+/// @returns the number of columns the given codepoint occupies in a cell, which is at least one.
+inline int cellWidth(char32_t _codepoint) noexcept
+{
+    if (_codepoint < NarrowCodepointLimit)
+        return 1;
+    return std::max(unicode::width(_codepoint), 1);
+}
+
 /// Grid cell with character and graphics rendition information.
+///
+/// The first codepoint is stored inline, as the vast majority of cells hold at most one.
+/// Everything that is rarely needed (combining codepoints, hyperlinks) lives
+/// in a lazily allocated extra record, so that blank or plain text cells do not allocate.
+///
+/// Cells displaying an image fragment store the fragment's ImageRowId and column in place
+/// of the inline codepoint, see Grid::imageFragment().
 class Cell {
   public:
     static size_t constexpr MaxCodepoints = 9;
 
-    Cell(char32_t _codepoint, GraphicsAttributes _attrib) noexcept :
-        codepoints_{},
+    explicit Cell(char32_t _codepoint, GraphicsAttributesId _attributes = DefaultGraphicsAttributesId) noexcept :
+        codepoint_{_codepoint},
         width_{1},
-        attributes_{_attrib}
+        attributes_{_attributes}
     {
-        // setCharacter(_codepoint);
-        if (_codepoint)
-        {
-            codepoints_.assign(1, _codepoint);
-            width_ = std::max(unicode::width(_codepoint), 1);
-        }
+        width_ = cellWidth(_codepoint);
     }
 
     Cell() noexcept :
-        codepoints_{},
+        codepoint_{0},
         width_{1},
-        attributes_{}
+        attributes_{DefaultGraphicsAttributesId}
     {}
 
-    void reset(GraphicsAttributes _attributes = {}) noexcept
+    void reset(GraphicsAttributesId _attributes = DefaultGraphicsAttributesId) noexcept
     {
         attributes_ = _attributes;
         width_ = 1;
-#if defined(LIBTERMINAL_HYPERLINKS)
-        hyperlink_ = nullptr;
-#endif
-        codepoints_.clear();
+        codepoint_ = 0;
 #if defined(LIBTERMINAL_IMAGES)
-        imageFragment_.reset();
+        image_ = false;
 #endif
+        extra_.reset();
     }
 
 #if defined(LIBTERMINAL_HYPERLINKS)
-    void reset(GraphicsAttributes _attribs, HyperlinkRef const& _hyperlink) noexcept
+    void reset(GraphicsAttributesId _attribs, HyperlinkId _hyperlink) noexcept
     {
-        attributes_ = _attribs;
-        width_ = 1;
-        codepoints_.clear();
-        hyperlink_ = _hyperlink;
+        reset(_attribs);
+        if (_hyperlink)
+            extra().hyperlink = _hyperlink;
+    }
+#endif
+
+    Cell(Cell const& _other) :
+        codepoint_{_other.codepoint_},
+        width_{_other.width_},
 #if defined(LIBTERMINAL_IMAGES)
-        imageFragment_.reset();
+        image_{_other.image_},
 #endif
-    }
+        attributes_{_other.attributes_},
+        extra_{_other.extra_ ? std::make_unique<Extra>(*_other.extra_) : nullptr}
+    {}
+
+    Cell& operator=(Cell const& _other)
+    {
+        codepoint_ = _other.codepoint_;
+        width_ = _other.width_;
+#if defined(LIBTERMINAL_IMAGES)
+        image_ = _other.image_;
 #endif
+        attributes_ = _other.attributes_;
+        if (!_other.extra_)
+            extra_.reset();
+        else if (extra_)
+            *extra_ = *_other.extra_;
+        else
+            extra_ = std::make_unique<Extra>(*_other.extra_);
+        return *this;
+    }
 
-    Cell(Cell const&) = default;
     Cell(Cell&&) noexcept = default;
-    Cell& operator=(Cell const&) = default;
     Cell& operator=(Cell&&) noexcept = default;
 
     std::u32string_view codepoints() const noexcept
     {
-        return codepoints_;
+        if (extra_ && !extra_->codepoints.empty())
+            return extra_->codepoints;
+        if (codepoint_ && !hasImage())
+            return std::u32string_view(&codepoint_, 1);
+        return {};
     }
 
     char32_t codepoint(size_t i) const noexcept
     {
 #if !defined(NDEBUG)
-        return codepoints_.at(i);
+        return codepoints().at(i);
 #else
-        return codepoints_[i];
+        return codepoints()[i];
 #endif
     }
 
-    int codepointCount() const noexcept { return codepoints_.size(); }
+    int codepointCount() const noexcept
+    {
+        if (extra_ && !extra_->codepoints.empty())
+            return static_cast<int>(extra_->codepoints.size());
+        return codepoint_ && !hasImage() ? 1 : 0;
+    }
 
-#if defined(LIBTERMINAL_IMAGES)
-    bool empty() const noexcept { return codepoints_.empty() && !imageFragment_; }
-#else
-    bool empty() const noexcept { return codepoints_.empty(); }
-#endif
+    bool empty() const noexcept { return !codepoint_ && !hasImage(); }
 
     constexpr int width() const noexcept { return width_; }
 
-    constexpr GraphicsAttributes attributes() const noexcept { return attributes_; }
+    /// @returns the identifier of this cell's graphics rendition within its grid's attributes table.
+    ///
+    /// @see Grid::attributes()
+    constexpr GraphicsAttributesId attributes() const noexcept { return attributes_; }
 
 #if defined(LIBTERMINAL_IMAGES)
-    std::optional<ImageFragment> const& imageFragment() const noexcept { return imageFragment_; }
+    bool hasImage() const noexcept { return image_; }
 
-    void setImage(ImageFragment _imageFragment)
-    {
-        imageFragment_.emplace(std::move(_imageFragment));
-        width_ = 1;
-        codepoints_.clear();
-    }
+    /// @returns the identifier of the image row displayed by this cell, see hasImage().
+    ImageRowId imageRow() const noexcept { return codepoint_ >> ImageColumnBits; }
 
-#if defined(LIBTERMINAL_HYPERLINKS)
-    void setImage(ImageFragment _imageFragment, HyperlinkRef _hyperlink)
+    /// @returns the 0-based column within the image row displayed by this cell, see hasImage().
+    int imageColumn() const noexcept { return static_cast<int>(codepoint_ & ImageColumnMask); }
+
+    /// Displays the fragment at the given 0-based column of the given image row.
+    void setImage(ImageRowId _row, int _column) noexcept
     {
-        setImage(std::move(_imageFragment));
-        hyperlink_ = std::move(_hyperlink);
+        static_assert(ImageRowTable::Capacity <= (size_t(1) << (32 - ImageColumnBits)));
+        clearCodepoints();
+        codepoint_ = static_cast<char32_t>((_row << ImageColumnBits) | (static_cast<uint32_t>(_column) & ImageColumnMask));
+        image_ = true;
+        width_ = 1;
     }
-#endif
+#else
+    constexpr bool hasImage() const noexcept { return false; }
 #endif
 
     void setCharacter(char32_t _codepoint) noexcept
     {
-#if defined(LIBTERMINAL_IMAGES)
-        imageFragment_.reset();
-#endif
-        if (_codepoint)
-        {
-            codepoints_.assign(1, _codepoint);
-            width_ = std::max(unicode::width(_codepoint), 1);
-        }
-        else
-        {
-            codepoints_.clear();
-            width_ = 1;
-        }
+        resetImage();
+        clearCodepoints();
+        releaseUnusedExtra();
+        codepoint_ = _codepoint;
+        width_ = cellWidth(_codepoint);
     }
 
     void setWidth(int _width) noexcept
@@ -319,14 +516,20 @@ class Cell {
         width_ = _width;
     }
 
-    int appendCharacter(char32_t _codepoint) noexcept
+    int appendCharacter(char32_t _codepoint)
     {
-#if defined(LIBTERMINAL_IMAGES)
-        imageFragment_.reset();
-#endif
-        if (codepoints_.size() < MaxCodepoints)
+        resetImage();
+        if (static_cast<size_t>(codepointCount()) < MaxCodepoints)
         {
-            codepoints_.push_back(_codepoint);
+            if (!codepoint_)
+                codepoint_ = _codepoint;
+            else
+            {
+                auto& codepoints = extra().codepoints;
+                if (codepoints.empty())
+                    codepoints.assign(1, codepoint_);
+                codepoints.push_back(_codepoint);
+            }
 
             constexpr bool AllowWidthChange = false; // TODO: make configurable
 
@@ -352,36 +555,136 @@ class Cell {
         return 0;
     }
 
-    void setAttributes(GraphicsAttributes _attributes) noexcept
+    void setAttributes(GraphicsAttributesId _attributes) noexcept
     {
         attributes_ = _attributes;
     }
 
+    /// Resets all cells within [_first, _last) as by reset(), and sets their character to
+    /// @p _codepoint, which must be of single width.
+    ///
+    /// Cells carrying extra properties are rare, so these are released up front,
+    /// leaving the remaining loop to plain stores.
+    static void fill(Cell* _first, Cell* _last, GraphicsAttributesId _attributes, char32_t _codepoint = 0) noexcept
+    {
+        for (Cell* cell = _first; cell != _last; ++cell)
+            if (cell->extra_)
+                cell->extra_.reset();
+
+        for (Cell* cell = _first; cell != _last; ++cell)
+        {
+            cell->codepoint_ = _codepoint;
+            cell->width_ = 1;
+#if defined(LIBTERMINAL_IMAGES)
+            cell->image_ = false;
+#endif
+            cell->attributes_ = _attributes;
+        }
+    }
+
     std::string toUtf8() const;
 
+    /// @returns the bytes allocated on the heap for the codepoints beyond the first one.
+    size_t codepointBytes() const noexcept
+    {
+        return extra_ && !extra_->codepoints.empty()
+            ? sizeof(Extra) + crispy::allocated_bytes(extra_->codepoints)
+            : 0;
+    }
+
+    /// @returns the bytes allocated on the heap for nothing but the cell's hyperlink.
+    size_t hyperlinkBytes() const noexcept
+    {
+        return extra_ && extra_->codepoints.empty() ? sizeof(Extra) : 0;
+    }
+
 #if defined(LIBTERMINAL_HYPERLINKS)
-    HyperlinkRef hyperlink() const noexcept { return hyperlink_; }
-    void setHyperlink(HyperlinkRef const& _hyperlink) { hyperlink_ = _hyperlink; }
+    /// @returns the identifier of this cell's hyperlink within its screen's hyperlink table.
+    HyperlinkId hyperlink() const noexcept { return extra_ ? extra_->hyperlink : NoHyperlinkId; }
+
+    void setHyperlink(HyperlinkId _hyperlink)
+    {
+        if (_hyperlink)
+            extra().hyperlink = _hyperlink;
+        else if (extra_)
+        {
+            extra_->hyperlink = NoHyperlinkId;
+            releaseUnusedExtra();
+        }
+    }
 #endif
 
   private:
-    /// Unicode codepoint to be displayed.
-    std::u32string codepoints_;
+    /// Rarely used cell properties, allocated on demand.
+    struct Extra {
+        /// All codepoints of the grapheme cluster (including the inline one),
+        /// or empty if the cell holds at most one codepoint.
+        std::u32string codepoints;
 
-    /// number of cells this cell spans. Usually this is 1, but it may be also 0 or >= 2.
-    uint8_t width_;
+#if defined(LIBTERMINAL_HYPERLINKS)
+        HyperlinkId hyperlink = NoHyperlinkId;
+#endif
 
-    /// Graphics renditions, such as foreground/background color or other grpahics attributes.
-    GraphicsAttributes attributes_;
+    };
 
+    Extra& extra()
+    {
+        if (!extra_)
+            extra_ = std::make_unique<Extra>();
+        return *extra_;
+    }
+
+    void clearCodepoints() noexcept
+    {
+        codepoint_ = 0;
+        if (extra_)
+            extra_->codepoints.clear();
+    }
+
+    /// Frees the extra record once it does not carry any information anymore.
+    void releaseUnusedExtra() noexcept
+    {
+        if (!extra_ || !extra_->codepoints.empty())
+            return;
 #if defined(LIBTERMINAL_HYPERLINKS)
-    HyperlinkRef hyperlink_ = nullptr;
+        if (extra_->hyperlink)
+            return;
 #endif
+        extra_.reset();
+    }
 
-    /// Image fragment to be rendered in this cell.
+    void resetImage() noexcept
+    {
 #if defined(LIBTERMINAL_IMAGES)
-    std::optional<ImageFragment> imageFragment_;
+        if (image_)
+        {
+            image_ = false;
+            codepoint_ = 0;
+        }
 #endif
+    }
+
+#if defined(LIBTERMINAL_IMAGES)
+    static constexpr unsigned ImageColumnBits = 12;
+    static constexpr uint32_t ImageColumnMask = (1u << ImageColumnBits) - 1;
+#endif
+
+    /// First (and usually only) Unicode codepoint to be displayed.
+    char32_t codepoint_;
+
+    /// number of cells this cell spans. Usually this is 1, but it may be also 0 or >= 2.
+    uint8_t width_;
+
+#if defined(LIBTERMINAL_IMAGES)
+    /// Whether codepoint_ holds an image fragment rather than a codepoint.
+    bool image_ = false;
+#endif
+
+    /// Graphics renditions, such as foreground/background color or other grpahics attributes,
+    /// interned in the owning grid's GraphicsAttributesTable.
+    GraphicsAttributesId attributes_;
+
+    std::unique_ptr<Extra> extra_;
 };
 
 inline bool operator==(Cell const& a, Cell const& b) noexcept
@@ -389,7 +692,7 @@ inline bool operator==(Cell const& a, Cell const& b) noexcept
     if (a.codepointCount() != b.codepointCount())
         return false;
 
-    if (!(a.attributes() == b.attributes()))
+    if (a.attributes() != b.attributes())
         return false;
 
     for (auto const i : crispy::times(a.codepointCount()))
@@ -401,6 +704,73 @@ inline bool operator==(Cell const& a, Cell const& b) noexcept
 
 // }}}
 
+/// Bytes of memory held by grid lines, see Line::addMemoryUsage().
+struct LineMemoryUsage {
+    size_t cells = 0;       //!< cell buffers
+    size_t codepoints = 0;  //!< codepoints of cells beyond their first one
+    size_t hyperlinks = 0;  //!< hyperlinks of cells without further codepoints
+    size_t compressed = 0;  //!< compressed cells of cold history lines
+    size_t links = 0;       //!< links and trigger matches found in the lines' text
+};
+
+/// Bytes of memory held by a grid's history lines, which also count towards the total
+/// of all grids in the process, see Grid::setGlobalMaxHistoryBytes().
+class HistoryMemory {
+  public:
+    HistoryMemory() = default;
+    HistoryMemory(HistoryMemory const& _other) noexcept { add(_other.bytes_); }
+    HistoryMemory(HistoryMemory&& _other) noexcept : bytes_{std::exchange(_other.bytes_, 0)} {}
+    ~HistoryMemory() { reset(); }
+
+    HistoryMemory& operator=(HistoryMemory const& _other) noexcept
+    {
+        if (this != &_other)
+        {
+            reset();
+            add(_other.bytes_);
+        }
+        return *this;
+    }
+
+    HistoryMemory& operator=(HistoryMemory&& _other) noexcept
+    {
+        if (this != &_other)
+        {
+            reset();
+            bytes_ = std::exchange(_other.bytes_, 0);
+        }
+        return *this;
+    }
+
+    size_t bytes() const noexcept { return bytes_; }
+
+    void add(size_t _bytes) noexcept
+    {
+        bytes_ += _bytes;
+        total().fetch_add(_bytes, std::memory_order_relaxed);
+    }
+
+    void subtract(size_t _bytes) noexcept
+    {
+        bytes_ -= _bytes;
+        total().fetch_sub(_bytes, std::memory_order_relaxed);
+    }
+
+    void reset() noexcept { subtract(bytes_); }
+
+    /// @returns the bytes held by the history lines of all grids.
+    static size_t totalBytes() noexcept { return total().load(std::memory_order_relaxed); }
+
+  private:
+    static std::atomic<size_t>& total() noexcept
+    {
+        static auto bytes = std::atomic<size_t>{0};
+        return bytes;
+    }
+
+    size_t bytes_ = 0;
+};
+
 class Line { // {{{
   public:
     enum class Flags : uint8_t {
@@ -410,7 +780,9 @@ class Line { // {{{
         Marked    = 0x0004,
     };
 
-    using Buffer = std::vector<Cell>;
+    /// Cell buffers are recycled by size class (see crispy::size_class_pool), as lines keep being
+    /// created, resized and dropped along with the history.
+    using Buffer = std::vector<Cell, crispy::pool_allocator<Cell>>;
     using iterator = Buffer::iterator;
     using const_iterator = Buffer::const_iterator;
     using reverse_iterator = Buffer::reverse_iterator;
@@ -420,61 +792,187 @@ class Line { // {{{
         flags_{static_cast<unsigned>(_flags)}
     {}
 
+    /// Constructs a line of blank cells, whose memory is not allocated before being accessed (see trim()).
+    Line(int _numCols, GraphicsAttributesId _attributes, Flags _flags) :
+        trimmedCellCount_{_numCols},
+        trimmedAttributes_{_attributes},
+        flags_{static_cast<unsigned>(_flags)}
+    {}
+
     Line(Buffer const& _init, Flags _flags) : Line(Buffer(_init), _flags) {}
     Line(Buffer&& _init, Flags _flags);
     Line(iterator const& _begin, iterator const& _end, Flags _flags);
     Line(int _numCols, Buffer&& _init, Flags _flags);
     Line(int _numCols, std::string_view const& _s, Flags _flags);
 
-    Buffer& buffer() noexcept { return buffer_; }
+    Buffer& buffer() { inflate(); return buffer_; }
 
     Line() = default;
-    Line(Line const&) = default;
+    Line(Line const& _other);
     Line(Line&&) = default;
-    Line& operator=(Line const&) = default;
+    Line& operator=(Line const& _other);
     Line& operator=(Line&&) = default;
 
-    void reset(GraphicsAttributes _attributes) noexcept
+    void reset(GraphicsAttributesId _attributes)
     {
-        for (Cell& cell: buffer_)
-            cell.reset(_attributes);
-    }
+        side_.reset();
 
-    Buffer* operator->() noexcept { return &buffer_; }
-    Buffer const* operator->() const noexcept { return &buffer_; }
-    auto& operator[](std::size_t _index) { return buffer_[_index]; }
-    auto const& operator[](std::size_t _index) const { return buffer_[_index]; }
-
-    void prepend(Buffer const&);
-    void append(Buffer const&);
-    void append(int _count, Cell const& _initial);
+        // Lines not kept in memory are not allocated before being written to again.
+        if (packed_ || spilled_ || trimmedCellCount_)
+        {
+            trimmedCellCount_ = size();
+            trimmedAttributes_ = _attributes;
+            buffer_.clear();
+            packed_.reset();
+            spilled_.reset();
+            return;
+        }
 
-    Buffer remove(iterator const& _from, iterator const& _to);
+        Cell::fill(buffer_.data(), buffer_.data() + buffer_.size(), _attributes);
+    }
 
-    /// Shhift left by @p _count cells and fill right with cells of @p _fill.
-    ///
-    /// @returns sequence of cells that have been shifted out.
-    Buffer shift_left(int _count, Cell const& _fill);
+    /// Resets the cells within the 0-based column range [_first, _last), see Cell::fill().
+    void fill(int _first, int _last, GraphicsAttributesId _attributes, char32_t _codepoint = 0)
+    {
+        inflate();
+        side_.reset();
+        Cell::fill(buffer_.data() + _first, buffer_.data() + _last, _attributes, _codepoint);
+    }
 
-    crispy::range<const_iterator> trim_blank_right() const;
+    Buffer* operator->() { inflate(); return &buffer_; }
+    Buffer const* operator->() const { inflate(); return &buffer_; }
+    auto& operator[](std::size_t _index) { inflate(); return buffer_[_index]; }
+    auto const& operator[](std::size_t _index) const { inflate(); return buffer_[_index]; }
 
-    int size() const noexcept { return static_cast<int>(buffer_.size()); }
+    int size() const noexcept
+    {
+        if (packed_)
+            return packed_->cells + trimmedCellCount_;
+        if (spilled_)
+            return spilled_->columns;
+        return static_cast<int>(buffer_.size()) + trimmedCellCount_;
+    }
 
     bool blank() const noexcept;
 
     // TODO (trimmed version of size()): int maxOccupiedColumns() const noexcept { return size(); }
 
+    /// Resizes the line to @p _size columns, cutting off or appending cells.
+    ///
+    /// Compressed and trimmed lines are resized without restoring their cells,
+    /// as long as only their trailing blank cells are affected.
     void resize(int _size);
-    [[nodiscard]] Buffer reflow(int _column);
 
-    iterator begin() { return buffer_.begin(); }
-    iterator end() { return buffer_.end(); }
-    const_iterator begin() const { return buffer_.begin(); }
-    const_iterator end() const { return buffer_.end(); }
-    reverse_iterator rbegin() { return buffer_.rbegin(); }
-    reverse_iterator rend() { return buffer_.rend(); }
-    const_iterator cbegin() const { return buffer_.cbegin(); }
-    const_iterator cend() const { return buffer_.cend(); }
+    /// Reserves memory for the cells of @p _columns columns, now if the cells are in memory already,
+    /// or whenever they are (re)allocated otherwise, so that the line can be resized up to that
+    /// width without reallocating.
+    ///
+    /// The reservation is dropped once the line gets trimmed or compressed, see trim().
+    void reserveColumns(int _columns);
+
+    /// Number of cells up to and including the last one that is not blank, without inflating the line.
+    ///
+    /// For compressed lines, this may include some trailing blank cells.
+    int usedColumns() const noexcept;
+
+    iterator begin() { inflate(); return buffer_.begin(); }
+    iterator end() { inflate(); return buffer_.end(); }
+    const_iterator begin() const { inflate(); return buffer_.begin(); }
+    const_iterator end() const { inflate(); return buffer_.end(); }
+    reverse_iterator rbegin() { inflate(); return buffer_.rbegin(); }
+    reverse_iterator rend() { inflate(); return buffer_.rend(); }
+    const_iterator cbegin() const { inflate(); return buffer_.cbegin(); }
+    const_iterator cend() const { inflate(); return buffer_.cend(); }
+
+    /// Drops trailing blank cells sharing the same graphics rendition and releases their memory.
+    ///
+    /// The line keeps its size, and the dropped cells are transparently restored on next access.
+    /// Nothing is dropped if there are too few such cells to be worth it.
+    void trim();
+
+    /// Number of trailing blank cells currently dropped, see trim().
+    int trimmedCellCount() const noexcept { return trimmedCellCount_; }
+
+    /// Graphics rendition of the trailing blank cells currently dropped, see trim().
+    GraphicsAttributesId trimmedAttributes() const noexcept { return trimmedAttributes_; }
+
+    /// Cells other than the trailing blank cells currently dropped, without restoring them.
+    crispy::range<const_iterator> untrimmedCells() const
+    {
+        if (packed_ || spilled_)
+            unpack();
+        return crispy::range<const_iterator>(buffer_.cbegin(), buffer_.cend());
+    }
+
+    /// Stores the cells in a compact form, if they can be represented losslessly that way.
+    ///
+    /// Trailing blank cells are dropped, codepoints are stored UTF-8 encoded and graphics
+    /// renditions run-length encoded. The cells are transparently restored on next access.
+    ///
+    /// Lines containing grapheme clusters, hyperlinks or images are left untouched.
+    ///
+    /// @returns whether or not the line is stored compressed now.
+    bool compress();
+
+    bool compressed() const noexcept { return packed_ || spilled_; }
+
+    /// Table of the packed cells identical lines may share, see share().
+    class SharedCellsTable;
+
+    /// Makes identical lines share their packed cells.
+    ///
+    /// A compressed line lists its cells in @p _table for identical lines to share, unless identical
+    /// cells are listed already, which it then shares instead. An uncompressed line only shares
+    /// identical cells listed already, which compresses it, so that duplicates of compressed lines
+    /// do not take up memory from the start.
+    ///
+    /// @returns whether or not the line's cells are listed in @p _table now.
+    bool share(SharedCellsTable& _table);
+
+    /// Compresses the line and moves it out of memory into the given scrollback file.
+    ///
+    /// @returns whether or not the line is stored in a scrollback file now.
+    bool spill(std::shared_ptr<ScrollbackFile> const& _file);
+
+    bool spilled() const noexcept { return spilled_ != nullptr; }
+
+    /// Cells of a compressed line restored ahead of the line being accessed, see prefetch().
+    class PrefetchedCells;
+
+    /// @returns what the cells of this compressed (or spilled) line are restored from,
+    ///          for PrefetchedCells::restore() to do so on another thread, or std::nullopt
+    ///          if the line is not compressed.
+    std::optional<PrefetchedCells> prefetch() const;
+
+    /// Takes over the cells restored by PrefetchedCells::restore(), unless the line has been
+    /// modified or accessed since prefetch(), leaving it as if it had been accessed.
+    ///
+    /// @returns whether or not the cells have been taken over.
+    bool adopt(PrefetchedCells& _cells);
+
+    /// Marks the graphics renditions used by this line's cells in @p _used, without inflating it.
+    void markUsedAttributes(std::vector<bool>& _used) const;
+
+    /// Adds the memory held by this line to @p _usage, without inflating it.
+    void addMemoryUsage(LineMemoryUsage& _usage) const;
+
+    /// @returns the bytes of memory held by this line, including the line itself.
+    size_t memoryFootprint() const;
+
+    /// Renumbers the graphics renditions of this line's cells, without inflating it.
+    ///
+    /// Cells listed in a SharedCellsTable are left to SharedCellsTable::remapAttributes().
+    void remapAttributes(std::vector<GraphicsAttributesId> const& _mapping);
+
+#if defined(LIBTERMINAL_HYPERLINKS)
+    /// Marks the hyperlinks referenced by this line's cells in @p _used.
+    void markUsedHyperlinks(std::vector<bool>& _used) const;
+#endif
+
+#if defined(LIBTERMINAL_IMAGES)
+    /// Marks the image rows referenced by this line's cells in @p _used.
+    void markUsedImageRows(std::vector<bool>& _used) const;
+#endif
 
     bool marked() const noexcept { return isFlagEnabled(Flags::Marked); }
     void setMarked(bool _enable) { setFlag(Flags::Marked, _enable); }
@@ -488,13 +986,58 @@ class Line { // {{{
     Flags wrappableFlag() const noexcept { return wrappable() ? Line::Flags::Wrappable : Line::Flags::None; }
     Flags markedFlag() const noexcept { return marked() ? Line::Flags::Marked : Line::Flags::None; }
 
-    std::string toUtf8() const;
+    /// @returns the text of all cells, with empty cells being represented as spaces.
+    ///
+    /// Compressed lines are read without being unpacked.
+    ///
+    /// @param _cellOffsets if not null, receives the byte offset of each cell's text.
+    std::string toUtf8(std::vector<size_t>* _cellOffsets = nullptr) const;
+
+    /// Appends the text of all cells to @p _output, as toUtf8() does.
+    ///
+    /// The codepoints of cells are gathered and transcoded in bulk, see crispy::utf8::append().
+    ///
+    /// @param _cellOffsets if not null, receives the byte offset of each cell's text within @p _output.
+    void appendUtf8(std::string& _output, std::vector<size_t>* _cellOffsets = nullptr) const;
+
+    /// Appends the text of the first @p _columnCount cells to @p _output, as appendUtf8() does,
+    /// with blanks for the columns the line is shorter by, i.e. as a page that wide shows it.
+    void appendUtf8(std::string& _output, int _columnCount) const;
     std::string toUtf8Trimmed() const;
 
     void setText(std::string_view _u8string);
 
+    /// @returns the URLs and file paths in the text of cells without a hyperlink, see LinkDetector.
+    ///
+    /// Links are detected once per modification of the line (see generation()) and kept along with it,
+    /// so that looking them up again, such as on every mouse move, does not scan the line.
+    std::vector<DetectedLink> const& detectedLinks() const;
+
+    /// @returns whether detectedLinks() is up to date, i.e. returns without scanning the line.
+    bool linksDetected() const noexcept { return side_ && side_->linksGeneration == generation_; }
+
+    /// @returns the matches of the trigger patterns in the line's text, ordered by their last column,
+    ///          if they have been recorded for its current contents (see Screen::setTriggers()).
+    std::vector<TriggerMatch> const& triggerMatches() const noexcept;
+
+    /// Records the trigger matches of the line's current contents, which are dropped with the
+    /// next modification of the line.
+    void setTriggerMatches(std::vector<TriggerMatch> const& _matches);
+
     Flags flags() const noexcept { return static_cast<Flags>(flags_); }
 
+    /// Grid generation this line has been modified in most recently, see Grid::touch().
+    uint64_t generation() const noexcept { return generation_; }
+    void setGeneration(uint64_t _generation) noexcept { generation_ = _generation; }
+
+    /// Like setGeneration(), but for the line having moved rows only, keeping the links and
+    /// trigger matches of its unchanged contents.
+    void setMovedGeneration(uint64_t _generation) noexcept;
+
+    /// Memory footprint this line has been accounted for by its grid's history, see Grid::historyBytes().
+    uint32_t accountedBytes() const noexcept { return accountedBytes_; }
+    void setAccountedBytes(uint32_t _bytes) noexcept { accountedBytes_ = _bytes; }
+
     Flags inheritableFlags() const noexcept
     {
         auto constexpr Inheritables = unsigned(Flags::Wrappable)
@@ -513,8 +1056,155 @@ class Line { // {{{
     bool isFlagEnabled(Flags _flag) const noexcept { return (flags_ & static_cast<unsigned>(_flag)) != 0; }
 
   private:
-    Buffer buffer_;
+    void appendUtf8(std::string& _output, std::vector<size_t>* _cellOffsets, int _columnCount) const;
+
+    /// Compact representation of a line's cells, see compress().
+    ///
+    /// The trailing blank cells are not stored, but accounted for by the line's trimmed cell count.
+    /// Packed cells are immutable, as identical lines may share them (see share()).
+    struct PackedCells {
+        /// Number of cells stored.
+        int cells;
+
+        /// UTF-8 encoded codepoint of each stored cell, with empty cells being encoded as NUL.
+        std::string text;
+
+        /// Run-length encoded graphics renditions of the stored cells.
+        std::vector<std::pair<uint16_t, GraphicsAttributesId>> attributes;
+
+        /// Whether these cells are listed in a SharedCellsTable.
+        bool shared = false;
+
+        bool operator==(PackedCells const& _other) const noexcept
+        {
+            return cells == _other.cells && text == _other.text && attributes == _other.attributes;
+        }
+    };
+
+    /// What is known about a line's text beyond its cells, each part along with the line's
+    /// generation it has been found in, and thus valid for as long as the line is not modified.
+    struct SideTable {
+        std::optional<uint64_t> linksGeneration;
+        std::vector<DetectedLink> links;
+        std::optional<uint64_t> triggersGeneration;
+        std::vector<TriggerMatch> triggerMatches;
+    };
+
+    /// Location of a line's PackedCells within a scrollback file, see spill().
+    /// Retains its record for as long as it exists, see ScrollbackFile::wasteful().
+    struct SpilledCells {
+        SpilledCells(std::shared_ptr<ScrollbackFile> _file, uint64_t _offset, uint32_t _size, int _columns, int _storedCells);
+        SpilledCells(SpilledCells const& _other);
+        SpilledCells& operator=(SpilledCells const&) = delete;
+        ~SpilledCells();
+
+        std::shared_ptr<ScrollbackFile> file;
+        uint64_t offset;
+        uint32_t size;
+        int columns;       //!< takes precedence over the columns of the stored cells
+        int storedCells;   //!< number of cells stored, see usedColumns()
+    };
+
+    void inflate() const
+    {
+        if (packed_ || spilled_)
+            unpack();
+        if (trimmedCellCount_)
+            untrim();
+    }
+
+    /// Restores the stored cells of a compressed line, leaving its trailing blank cells trimmed.
+    void unpack() const;
+
+    /// @returns the cells a compressed line would store, or std::nullopt if the line cannot be compressed.
+    std::optional<crispy::range<const_iterator>> compressibleCells() const;
+
+    /// Invokes @p _callback with the codepoint and graphics rendition of each of the packed cells.
+    template <typename Callback>
+    static void forEachPackedCell(PackedCells const& _cells, Callback const& _callback);
+
+    /// Content hash of the given cells, which is the same for packed and unpacked ones.
+    static size_t hashCells(PackedCells const& _cells);
+    static size_t hashCells(crispy::range<const_iterator> _cells);
+
+    /// Ensures capacity for @p _count cells, along with the columns reserved by reserveColumns().
+    void reserveCells(size_t _count) const;
+
+    /// Restores the trailing blank cells dropped by trim().
+    void untrim() const;
+
+    /// Loads the spilled cells back into memory in their compressed form.
+    void unspill() const;
+
+    /// @returns the packed cells stored by spill() into @p _record.
+    static PackedCells readSpilled(std::string_view _record, int _storedCells);
+
+    /// Drops the detected links, to be detected again once looked up.
+    void forgetLinks() const;
+
+    // The cell buffer is restored on demand, even when accessing a compressed line read-only.
+    mutable Buffer buffer_;
+    mutable std::shared_ptr<PackedCells> packed_;
+    mutable std::unique_ptr<SpilledCells> spilled_;
+    mutable int trimmedCellCount_ = 0;
+    mutable std::unique_ptr<SideTable> side_; // see detectedLinks() and triggerMatches()
+    GraphicsAttributesId trimmedAttributes_ = DefaultGraphicsAttributesId;
+    uint16_t reservedColumns_ = 0;
     unsigned flags_;
+    uint32_t accountedBytes_ = 0;
+    uint64_t generation_ = 0;
+};
+
+/// Packed cells of compressed lines by their content, so that identical lines can share them.
+///
+/// Progress bars, repeated warnings and the output of periodically run commands fill the history
+/// with identical lines. Cells are only referred to weakly, being released along with the last line
+/// sharing them.
+class Line::SharedCellsTable {
+  public:
+    bool empty() const noexcept { return cells_.empty(); }
+    size_t size() const noexcept { return cells_.size(); }
+
+    /// @returns the cells listed with the content hash @p _hash, if still alive.
+    std::shared_ptr<PackedCells> find(size_t _hash) const;
+
+    /// Lists @p _cells with the content hash @p _hash, replacing any cells listed with it before.
+    void insert(size_t _hash, std::shared_ptr<PackedCells> const& _cells);
+
+    /// Renumbers the graphics renditions of all cells listed, see Line::remapAttributes().
+    void remapAttributes(std::vector<GraphicsAttributesId> const& _mapping);
+
+  private:
+    /// Drops the entries of cells no longer alive.
+    void sweep();
+
+    static constexpr size_t MinSweepSize = 1024;
+
+    std::unordered_map<size_t, std::weak_ptr<PackedCells>> cells_;
+    size_t sweepSize_ = MinSweepSize;
+};
+
+/// Cells of a compressed or spilled line, restored ahead of the line being accessed.
+///
+/// Refers to what the line stores, which is immutable, rather than to the line itself, so that
+/// the cells can be restored on another thread while the line's grid is in use. Spilled cells
+/// are read from the scrollback file without its memory mapping, which may move as it grows.
+class Line::PrefetchedCells {
+  public:
+    /// Restores the cells, which may be done on any thread, see Line::adopt().
+    void restore();
+
+  private:
+    friend class Line;
+
+    std::shared_ptr<PackedCells const> packed_;  // unless spilled
+    std::shared_ptr<ScrollbackFile> file_;       // if spilled
+    uint64_t offset_ = 0;
+    uint32_t size_ = 0;
+    int storedCells_ = 0;
+    size_t capacity_ = 0;                        // cells the line will hold once its trailing blanks are restored
+    Buffer cells_;
+    bool restored_ = false;
 };
 
 constexpr Line::Flags operator|(Line::Flags a, Line::Flags b) noexcept
@@ -528,10 +1218,20 @@ constexpr bool operator&(Line::Flags a, Line::Flags b) noexcept
 }
 // }}}
 
-using Lines = std::deque<Line>;
+using Lines = crispy::ring<Line>;
 using ColumnIterator = Line::iterator;
 using LineIterator = Lines::iterator;
 
+/// Reflows the lines of @p _sourceLines to @p _columnCount columns, moving them to @p _targetLines.
+///
+/// A logical line is a wrappable line along with the wrapped lines continuing it that share its
+/// flags. Its cells are moved within the buffers of its own lines, which are reused for the
+/// reflowed lines, and only the lines it takes in excess of these are allocated.
+/// Lines that are not wrappable are cut off or padded.
+///
+/// @p _sourceLines must start with the beginning of a logical line.
+void reflow(Lines& _targetLines, crispy::range<Lines::iterator> _sourceLines, int _columnCount);
+
 inline auto begin(Line& _line) { return _line.begin(); }
 inline auto end(Line& _line) { return _line.end(); }
 inline auto begin(Line const& _line) { return _line.cbegin(); }
@@ -539,6 +1239,109 @@ inline auto end(Line const& _line) { return _line.cend(); }
 inline Line::const_iterator cbegin(Line const& _line) { return _line.cbegin(); }
 inline Line::const_iterator cend(Line const& _line) { return _line.cend(); }
 
+// {{{ MarkIndex
+/// Sorted index of the marked lines (see Line::marked()) among a sequence of history lines.
+///
+/// Like the history, lines can only be appended as well as dropped from either end.
+class MarkIndex {
+  public:
+    /// Number of lines indexed.
+    int lineCount() const noexcept { return lineCount_; }
+
+    /// Indexes a new line, to come after all lines indexed so far.
+    void append(bool _marked)
+    {
+        if (_marked)
+            marks_.push_back(base_ + lineCount_);
+        ++lineCount_;
+    }
+
+    /// Drops the @p _count first lines, which renumbers the remaining ones.
+    void dropFront(int _count);
+
+    /// Drops the @p _count last lines.
+    void dropBack(int _count);
+
+    void clear() { marks_.clear(); lineCount_ = 0; }
+
+    size_t memoryUsage() const noexcept { return marks_.size() * sizeof(int64_t); }
+
+    /// @returns the index of the closest marked line before @p _line, if any.
+    std::optional<int> previous(int _line) const noexcept;
+
+    /// @returns the index of the closest marked line after @p _line, if any.
+    std::optional<int> next(int _line) const noexcept;
+
+  private:
+    // Marks are numbered including all lines ever dropped from the front,
+    // so dropping lines does not need to renumber them.
+    std::deque<int64_t> marks_;
+    int64_t base_ = 0;
+    int lineCount_ = 0;
+};
+// }}}
+
+// {{{ LogicalLineIndex
+/// Sorted index of the logical lines spanning multiple lines among a sequence of history lines,
+/// i.e. of the lines continued by wrapped lines (see Line::wrapped()).
+///
+/// A minified JSON document or base64 blob may wrap across thousands of lines, which then
+/// need not be walked to find the logical line any one of them belongs to.
+/// Like the history, lines can only be appended as well as dropped from either end.
+class LogicalLineIndex {
+  public:
+    /// Number of lines indexed.
+    int lineCount() const noexcept { return lineCount_; }
+
+    /// Indexes a new line, to come after all lines indexed so far.
+    void append(bool _wrapped)
+    {
+        auto const line = base_ + lineCount_++;
+        if (!_wrapped || line == base_)
+            return;
+        if (!spans_.empty() && spans_.back().first + spans_.back().count == line)
+            ++spans_.back().count;
+        else
+            spans_.push_back(Span{line - 1, 2});
+    }
+
+    /// Drops the @p _count first lines, which renumbers the remaining ones.
+    void dropFront(int _count);
+
+    /// Drops the @p _count last lines.
+    void dropBack(int _count);
+
+    void clear() { spans_.clear(); lineCount_ = 0; }
+
+    size_t memoryUsage() const noexcept { return spans_.size() * sizeof(Span); }
+
+    /// @returns the first line and the number of lines of the logical line containing @p _line,
+    ///          if it spans multiple of the lines indexed.
+    std::optional<std::pair<int, int>> find(int _line) const noexcept;
+
+    /// Invokes @p _callback with the first line and the number of lines of each logical line
+    /// spanning multiple of the lines indexed, in ascending order.
+    template <typename Callback>
+    void forEach(Callback const& _callback) const
+    {
+        for (Span const& span: spans_)
+            _callback(static_cast<int>(span.first - base_), span.count);
+    }
+
+  private:
+    struct Span {
+        int64_t first;
+        int count;
+    };
+
+    // Lines are numbered including all lines ever dropped from the front,
+    // so dropping lines does not need to renumber them.
+    std::deque<Span> spans_;
+    int64_t base_ = 0;
+    int lineCount_ = 0;
+};
+// }}}
+
 /**
  * Manages the screen grid buffer (main screen + scrollback history).
  *
@@ -565,6 +1368,21 @@ inline Line::const_iterator cend(Line const& _line) { return _line.cend(); }
  *       1                          screenSize.columns
  * </pre>
  */
+/// Cells of a single row of the page, as passed to the callback of Grid::renderRows().
+///
+/// A row consists of the cells held in memory, followed by blank cells that are not:
+/// the ones dropped by Line::trim(), and the ones past the end of a line narrower than the page.
+struct RowCells {
+    int row;                                // 1-based row on the page
+    Line const& line;
+    crispy::span<Cell const> cells;         // starting at column 1
+    int trimmedBlanks;                      // blank cells of trimmedAttributes following the cells
+    GraphicsAttributesId trimmedAttributes;
+    int paddingBlanks;                      // blank cells of default rendition up to the page width
+
+    int trailingBlanks() const noexcept { return trimmedBlanks + paddingBlanks; }
+};
+
 class Grid {
   public:
     // TODO: Rename all "History" to "Scrollback"?
@@ -587,15 +1405,197 @@ class Grid {
     std::optional<int> maxHistoryLineCount() const noexcept { return maxHistoryLineCount_; }
     void setMaxHistoryLineCount(std::optional<int> _maxHistoryLineCount);
 
+    /// Number of most recent history lines to keep uncompressed, or std::nullopt
+    /// if history lines must never be compressed.
+    ///
+    /// @see Line::compress()
+    std::optional<int> historyCompressionThreshold() const noexcept { return historyCompressionThreshold_; }
+    void setHistoryCompressionThreshold(std::optional<int> _threshold);
+
+    /// Number of most recent history lines to keep in memory, or std::nullopt if history
+    /// lines must never be spilled into a scrollback file.
+    ///
+    /// @see Line::spill()
+    std::optional<int> historySpillThreshold() const noexcept { return historySpillThreshold_; }
+
+    /// Configures spilling of older history lines into a memory-mapped scrollback file,
+    /// which is created within @p _directory (or the system's temporary directory if empty).
+    void setHistorySpill(std::optional<int> _threshold, std::string _directory = {});
+    std::string const& historySpillDirectory() const noexcept { return historySpillDirectory_; }
+
+    /// Maximum bytes of memory the history lines may hold, or std::nullopt for no limit.
+    ///
+    /// Beyond that, the oldest history lines are dropped, in addition to the limit on their count.
+    /// Compressed and spilled lines count with what they still hold in memory, so that compressing
+    /// or spilling history makes room for more lines within the same budget.
+    ///
+    /// @see Line::memoryFootprint()
+    std::optional<size_t> maxHistoryBytes() const noexcept { return maxHistoryBytes_; }
+    void setMaxHistoryBytes(std::optional<size_t> _bytes);
+
+    /// Bytes of memory held by the history lines, except the most recent one, which may still
+    /// be continued. Lines are accounted for as stored, so that ones being temporarily restored
+    /// for reading do not count.
+    size_t historyBytes() const noexcept { return historyMemory_.bytes(); }
+
+    /// Maximum bytes of memory the history lines of all grids in the process may hold together,
+    /// or std::nullopt for no limit.
+    ///
+    /// Beyond that, the grid whose history is growing drops its oldest history lines,
+    /// leaving the history of other grids untouched.
+    static std::optional<size_t> globalMaxHistoryBytes() noexcept;
+    static void setGlobalMaxHistoryBytes(std::optional<size_t> _bytes) noexcept;
+
+    /// @returns the bytes of memory held by the history lines of all grids in the process.
+    static size_t globalHistoryBytes() noexcept { return HistoryMemory::totalBytes(); }
+
     bool reflowOnResize() const noexcept { return reflowOnResize_; }
     void setReflowOnResize(bool _enabled) { reflowOnResize_ = _enabled; }
 
     int historyLineCount() const noexcept { return static_cast<int>(lines_.size()) - screenSize_.height; }
 
+    /// Number of oldest history lines that have not been reflowed to the current width yet.
+    ///
+    /// Resizing with reflow enabled only reflows the main page and the page of history above it
+    /// right away, provided there's enough history to make that worthwhile.
+    /// The older lines keep their previous width until reflowHistory() catches up with them.
+    int pendingReflowLineCount() const noexcept;
+
+    /// Reflows pending history lines to the current width, most recent ones first.
+    ///
+    /// @param _maxLines maximum number of pending lines to reflow (rounded up to complete
+    ///                  logical lines), or std::nullopt to reflow all of them.
+    ///
+    /// @returns the number of lines the grid has grown by (negative if it shrunk).
+    ///          Lines below the previously pending ones are shifted by that amount.
+    int reflowHistory(std::optional<int> _maxLines = std::nullopt);
+
+    /// @returns the identifier of @p _attributes, to be used by cells of this grid.
+    ///
+    /// If the attributes table is full, all identifiers no longer referenced by any cell are
+    /// released first, which renumbers the identifiers stored in this grid's cells.
+    GraphicsAttributesId intern(GraphicsAttributes const& _attributes);
+
+    /// @returns the graphics rendition referenced by the given identifier.
+    GraphicsAttributes const& attributes(GraphicsAttributesId _id) const noexcept { return attributes_[_id]; }
+
+    /// @returns the graphics rendition of the given cell of this grid.
+    GraphicsAttributes const& attributes(Cell const& _cell) const noexcept { return attributes_[_cell.attributes()]; }
+
+    GraphicsAttributesTable const& attributesTable() const noexcept { return attributes_; }
+
+#if defined(LIBTERMINAL_HYPERLINKS)
+    /// Marks the hyperlinks referenced by any of this grid's cells in @p _used.
+    void markUsedHyperlinks(std::vector<bool>& _used) const;
+#endif
+
+#if defined(LIBTERMINAL_IMAGES)
+    /// Adds row @p _row (0-based, in grid cells) of the given image, to be displayed by cells of this grid.
+    ///
+    /// @returns the identifier to be passed to Cell::setImage(),
+    ///          or std::nullopt if every single identifier is still in use by some cell.
+    std::optional<ImageRowId> addImageRow(std::shared_ptr<RasterizedImage const> const& _image, int _row);
+
+    /// @returns the image fragment displayed by the given cell of this grid, if any.
+    std::optional<ImageFragment> imageFragment(Cell const& _cell) const
+    {
+        if (!_cell.hasImage())
+            return std::nullopt;
+        return imageRows_.fragment(_cell.imageRow(), _cell.imageColumn());
+    }
+
+    /// Evicts the images displayed in the history, starting with its oldest line, until @p _done
+    /// returns true. Evicted fragments are displayed as blank cells. Image rows also displayed
+    /// in the main page are kept.
+    ///
+    /// @returns the number of image rows evicted.
+    size_t evictHistoryImages(std::function<bool()> const& _done);
+
+    ImageRowTable const& imageRowTable() const noexcept { return imageRows_; }
+#endif
+
+    /// Accounts the memory held by this grid to subsystems named after @p _prefix,
+    /// separately for the main page and the history.
+    void collectMemoryUsage(crispy::memory_usage& _usage, std::string const& _prefix) const;
+
+    /// Modification counter of this grid, which is advanced for every line being touched.
+    uint64_t generation() const noexcept { return generation_; }
+
+    /// Number of lines dropped from the top of the history so far.
+    ///
+    /// Absolute line numbers, see absoluteLineAt(), shift down by one with every dropped line,
+    /// so readers holding on to absolute line numbers across a lock can compensate using this counter.
+    uint64_t droppedLineCount() const noexcept { return droppedLineCount_; }
+
+    /// History lines saved into a session file, see SessionFile.
+    struct SavedHistory {
+        int dropped = 0; //!< saved lines dropped from the top of the history since
+        int count = 0;   //!< oldest history lines that have been saved and not changed since
+    };
+
+    SavedHistory savedHistory() const noexcept { return savedHistory_; }
+
+    /// Records that the @p _count oldest history lines have been saved as they are now.
+    void markHistorySaved(int _count) noexcept { savedHistory_ = SavedHistory{0, _count}; }
+
+    /// Replaces all lines by the given history lines (oldest first) and main page lines,
+    /// whose cells reference the given attributes table, which replaces this grid's one.
+    ///
+    /// History lines of a different width are reflowed lazily like after a resize, see reflowHistory(),
+    /// or resized if reflow is disabled. Main page lines are resized, and those exceeding the page
+    /// are moved into the history.
+    ///
+    /// @returns the number of main page lines moved into the history.
+    int restore(GraphicsAttributesTable _attributes, std::vector<Line> _history, std::vector<Line> _page);
+
+    /// Marks the given line as modified, in a new generation.
+    void touch(Line& _line) noexcept { _line.setGeneration(++generation_); }
+
+    /// Marks the main page lines within the given (1-based, inclusive) rows as modified.
+    void touchLines(int _fromRow, int _toRow) noexcept;
+
+    /// Marks the main page lines within the given (1-based, inclusive) rows as modified,
+    /// for having moved rows or been blanked only, see Line::setMovedGeneration().
+    void touchMovedLines(int _fromRow, int _toRow) noexcept;
+
+    /// Resets the main page cells within the given (1-based, inclusive) area, see Line::fill(),
+    /// and marks their lines as modified.
+    void fill(int _top, int _left, int _bottom, int _right,
+              GraphicsAttributesId _attributes, char32_t _codepoint = 0);
+
+    /// Copies the main page cells within the given (1-based, inclusive) area to the area
+    /// starting at the given target position, and marks the target lines as modified.
+    ///
+    /// Source and target may overlap. Parts of the target area that lie off the page are clipped.
+    void copyArea(int _top, int _left, int _bottom, int _right, int _targetTop, int _targetLeft);
+
+    /// Marks all main page lines as modified, in a generation past @p _generation as well.
+    ///
+    /// This is used when replacing the grid, so that generations keep increasing for its observers.
+    void touchPage(uint64_t _generation = 0) noexcept;
+
+    /// Marks the main page lines as modified that differ from the ones of @p _previous,
+    /// in a generation past the ones of @p _previous as well.
+    ///
+    /// The other lines take over the generation of their counterpart in @p _previous, which is used
+    /// when switching between grids, so that observers only see the rows that actually differ.
+    void touchPage(Grid const& _previous);
+
+    /// @returns the rows (1-based) of the page at the given scroll offset, whose lines have been
+    ///          modified after generation @p _generation.
+    ///
+    /// Moving the viewport does not modify any line, so observers need to account for that themselves.
+    std::vector<int> changedLines(uint64_t _generation, std::optional<int> _scrollOffset = std::nullopt) const;
+
     /// Renders the full screen by passing every grid cell to the callback.
     template <typename RendererT>
     void render(RendererT && _render, std::optional<int> _scrollOffset = std::nullopt) const;
 
+    /// Renders the full screen by passing each row's cells at once to the callback (see RowCells),
+    /// without materializing the trailing blank cells that are not held in memory.
+    template <typename RendererT>
+    void renderRows(RendererT && _render, std::optional<int> _scrollOffset = std::nullopt) const;
+
     Line& absoluteLineAt(int _line) noexcept;
     Line const& absoluteLineAt(int _line) const noexcept;
 
@@ -609,7 +1609,25 @@ class Grid {
     /// Converts an absolute line number into a relative line number.
     int toRelativeLine(int _absoluteLine) const noexcept;
 
-    int computeRelativeLineNumberFromBottom(int _n) const noexcept;
+    /// @returns the relative line number of the first line of the @p _n bottom-most logical lines.
+    int computeRelativeLineNumberFromBottom(int _n) const;
+
+    /// A line along with the wrapped lines continuing it, by absolute line numbers.
+    struct LogicalLine {
+        int first;
+        int count;
+
+        int last() const noexcept { return first + count - 1; }
+    };
+
+    /// @returns the logical line containing the absolute line @p _line.
+    ///
+    /// History lines are looked up in an index of the logical lines spanning multiple lines,
+    /// which is brought up to date with the grid's history first.
+    LogicalLine logicalLineAt(int _line) const;
+
+    /// @returns the text of all cells of @p _logicalLine contiguously, as Line::appendUtf8() does.
+    std::string logicalLineText(LogicalLine _logicalLine, std::vector<size_t>* _cellOffsets = nullptr) const;
 
     /// Gets a reference to the cell relative to screen origin (top left, 1:1).
     Cell& at(Coordinate const& _coord) noexcept;
@@ -631,6 +1649,29 @@ class Grid {
     /// Completely deletes all scrollback lines.
     void clearHistory();
 
+    /// @returns the absolute line number of the closest marked line before absolute line @p _line.
+    std::optional<int> previousMarkedLine(int _line) const;
+
+    /// @returns the absolute line number of the closest marked line after absolute line @p _line.
+    std::optional<int> nextMarkedLine(int _line) const;
+
+    /// @returns the start of every occurrence of @p _literal within the lines of this grid,
+    ///          as absolute line (0-based) and column, in ascending order.
+    ///
+    /// History lines not containing all trigrams of @p _literal are skipped by means of
+    /// a search index, which is brought up to date with the grid's history first.
+    /// Occurrences spanning wrapped lines are found within the text of their logical lines.
+    std::vector<Coordinate> search(std::string_view _literal);
+
+    /// @returns the start of every non-empty match of @p _regex within the lines of this grid,
+    ///          as absolute line (0-based) and column, in ascending order.
+    ///
+    /// Unlike literal searches, this cannot make use of the search index.
+    std::vector<Coordinate> search(std::regex const& _regex) const;
+
+    /// @returns a copy of the text of all lines, to be searched independently of this grid.
+    SearchSnapshot searchSnapshot() const;
+
     /// Scrolls up by @p _n lines within the given margin.
     ///
     /// @param _n number of lines to scroll up within the given margin.
@@ -658,33 +1699,146 @@ class Grid {
     /// Ensures the maxHistoryLineCount attribute will be satisified, potentially deleting any
     /// overflowing history line.
     void clampHistory();
-    void appendNewLines(int _count, GraphicsAttributes _attr);
+
+    /// Reserves line storage for the main page and the maximum number of history lines.
+    void reserveLines();
+
+    /// Compresses (or spills) the history lines that are beyond the history compression
+    /// (or spill) threshold, starting with the @p _count most recent ones of them.
+    void compressHistory(std::optional<int> _count = std::nullopt);
+    void appendNewLines(int _count, GraphicsAttributesId _attr);
+
+    /// Reflows the main page to the given column count, deferring older history lines.
+    void reflowMainPage(int _newColumnCount);
+
+    /// Reflows the logical lines within [_first, _last) from @p _columnCount to the current width.
+    ///
+    /// @returns the number of lines the grid has grown by (negative if it shrunk).
+    int reflowLines(int _first, int _last, int _columnCount);
+
+    /// Accounts for the given number of oldest history lines having been removed.
+    void dropPendingReflow(int _count);
+
+    /// Indexes the history lines not indexed yet, except the most recent one.
+    void updateSearchIndex();
+
+    /// Indexes the marks of the history lines not indexed yet, except the most recent one.
+    void updateMarkIndex() const;
+    void updateLogicalLineIndex() const;
+
+    /// Accounts for the given number of oldest history lines being removed from the indexes,
+    /// which must be done before removing them.
+    void dropIndexedLines(int _count);
+
+    /// Accounts for the memory of the history lines not accounted for yet, except the most recent
+    /// one, and drops the oldest history lines as long as the history exceeds its memory budget.
+    void accountHistory();
+
+    /// (Re-)Accounts for the memory held by the history line @p _line.
+    void accountLine(Line& _line);
+
+    /// Stops accounting for the memory of the history lines within [_first, _last).
+    void unaccountLines(int _first, int _last);
+
+    /// Drops all lines starting at absolute line @p _line from the indexes, as they've changed.
+    void invalidateIndexes(int _line);
+
+    /// Releases all attributes table entries no longer referenced by any cell.
+    void collectUnusedAttributes();
+
+#if defined(LIBTERMINAL_IMAGES)
+    /// Releases all image rows no longer referenced by any cell.
+    void collectUnusedImageRows();
+#endif
 
   private:
     crispy::Size screenSize_;
+
+    /// Number of columns the main page lines reserve memory for, see Line::reserveColumns().
+    ///
+    /// This covers the largest of the current and the previous width, so that toggling between
+    /// two widths (e.g. full screen and windowed) does not reallocate the main page lines.
+    int reservedColumns_;
+
     bool reflowOnResize_;
     std::optional<int> maxHistoryLineCount_;
+    std::optional<int> historyCompressionThreshold_;
+    std::optional<int> historySpillThreshold_;
+    std::string historySpillDirectory_;
+    std::shared_ptr<ScrollbackFile> scrollbackFile_;
+    std::optional<size_t> maxHistoryBytes_;
+    Line::SharedCellsTable sharedCells_;
+
+    /// Memory held by the oldest accountedLineCount_ history lines, see accountHistory().
+    HistoryMemory historyMemory_;
+    int accountedLineCount_ = 0;
+
+    GraphicsAttributesTable attributes_;
+#if defined(LIBTERMINAL_IMAGES)
+    ImageRowTable imageRows_;
+#endif
     Lines lines_;
+
+    /// Consecutive runs of history lines that are still to be reflowed, oldest first,
+    /// each along with the column count its lines have been laid out for.
+    struct PendingReflow {
+        int lineCount;
+        int columnCount;
+    };
+    std::vector<PendingReflow> pendingReflow_;
+
+    /// Index of the oldest history lines, see search().
+    SearchIndex searchIndex_;
+
+    /// Index of the oldest history lines' marks, brought up to date on demand.
+    mutable MarkIndex markIndex_;
+    mutable LogicalLineIndex logicalLineIndex_; // see logicalLineAt()
+
+    uint64_t generation_ = 0;
+    uint64_t droppedLineCount_ = 0;
+    SavedHistory savedHistory_;
 };
 
 // {{{ inlines
 template <typename RendererT>
 inline void Grid::render(RendererT && _render, std::optional<int> _scrollOffset) const
 {
-    for (auto const && [rowNumber, line] : crispy::indexed(pageAtScrollOffset(_scrollOffset), 1))
-    {
-        for (auto const && [colNumber, column] : crispy::indexed(line, 1))
-            _render({rowNumber, colNumber}, column);
+    renderRows([&](RowCells const& _row) {
+        auto column = 0;
+        for (Cell const& cell: _row.cells)
+            _render({_row.row, ++column}, cell);
+
+        auto const trimmedCell = Cell{{}, _row.trimmedAttributes};
+        for (auto i = 0; i < _row.trimmedBlanks; ++i)
+            _render({_row.row, ++column}, trimmedCell);
+
+        for (auto i = 0; i < _row.paddingBlanks; ++i)
+            _render({_row.row, ++column}, Cell{});
+    }, _scrollOffset);
+}
 
-        for (auto const colNumber : crispy::times(line.size() + 1, std::max(0, screenSize_.width - line.size())))
-            _render({rowNumber, colNumber}, Cell{});
+template <typename RendererT>
+inline void Grid::renderRows(RendererT && _render, std::optional<int> _scrollOffset) const
+{
+    auto rowNumber = 0;
+    for (Line const& line: pageAtScrollOffset(_scrollOffset))
+    {
+        auto const cells = line.untrimmedCells();
+        _render(RowCells{
+            ++rowNumber,
+            line,
+            crispy::span<Cell const>(cells.empty() ? nullptr : &*cells.begin(), cells.size()),
+            line.trimmedCellCount(),
+            line.trimmedAttributes(),
+            std::max(0, screenSize_.width - line.size())
+        });
     }
 }
 
 inline Line& Grid::absoluteLineAt(int _line) noexcept
 {
     assert(crispy::ascending(0, _line, static_cast<int>(lines_.size()) - 1));
-    return *next(lines_.begin(), _line);
+    return *std::next(lines_.begin(), _line);
 }
 
 inline Line const& Grid::absoluteLineAt(int _line) const noexcept
@@ -696,7 +1850,7 @@ inline Line& Grid::lineAt(int _line) noexcept
 {
     assert(crispy::ascending(1 - historyLineCount(), _line, screenSize_.height));
 
-    return *next(lines_.begin(), historyLineCount() + _line - 1);
+    return *std::next(lines_.begin(), historyLineCount() + _line - 1);
 }
 
 inline Line const& Grid::lineAt(int _line) const noexcept
@@ -720,9 +1874,9 @@ inline Cell& Grid::at(Coordinate const& _coord) noexcept
     assert(crispy::ascending(1, _coord.column, screenSize_.width));
 
     if (_coord.row > 0)
-        return (*next(lines_.rbegin(), screenSize_.height - _coord.row))[_coord.column - 1];
+        return (*std::next(lines_.rbegin(), screenSize_.height - _coord.row))[_coord.column - 1];
     else
-        return (*next(lines_.begin(), historyLineCount() + _coord.row - 1))[_coord.column - 1];
+        return (*std::next(lines_.begin(), historyLineCount() + _coord.row - 1))[_coord.column - 1];
 }
 
 inline Cell const& Grid::at(Coordinate const& _coord) const noexcept
@@ -736,8 +1890,8 @@ inline crispy::range<Lines::const_iterator> Grid::lines(int _start, int _end) co
     assert(crispy::ascending(_start, _end, int(lines_.size()) - 1) && "Absolute scroll offset must not be negative or overflowing.");
 
     return crispy::range<Lines::const_iterator>(
-        next(lines_.cbegin(), _start),
-        next(lines_.cbegin(), _end)
+        std::next(lines_.cbegin(), _start),
+        std::next(lines_.cbegin(), _end)
     );
 }
 
@@ -747,8 +1901,8 @@ inline crispy::range<Lines::iterator> Grid::lines(int _start, int _end)
     assert(crispy::ascending(_start, _end, int(lines_.size())) && "Absolute scroll offset must not be negative or overflowing.");
 
     return crispy::range<Lines::iterator>(
-        next(lines_.begin(), _start),
-        next(lines_.begin(), _end)
+        std::next(lines_.begin(), _start),
+        std::next(lines_.begin(), _end)
     );
 }
 
@@ -0,0 +1,151 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/Grid.h>
+
+#include <crispy/benchmark.h>
+
+#include <fmt/format.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace terminal;
+using crispy::Size;
+using crispy::benchmark::do_not_optimize;
+using std::string;
+using std::vector;
+
+namespace // {{{ helper
+{
+    auto constexpr PageSize = Size{80, 25};
+    auto constexpr HistorySizes = { 0, 1000, 100'000 };
+
+    /// @returns @p _count lines of random text, of 0 up to 2 * PageSize.width characters each.
+    vector<string> randomLines(std::mt19937& _rng, size_t _count)
+    {
+        auto length = std::uniform_int_distribution<size_t>(0, 2 * PageSize.width);
+        auto lines = vector<string>(_count);
+        for (string& line: lines)
+            line = crispy::benchmark::random_text(_rng, length(_rng));
+        return lines;
+    }
+
+    /// Writes @p _text into the bottom line of @p _grid, wrapping into as many lines as it takes,
+    /// and scrolls them up into the history.
+    void writeLine(Grid& _grid, std::string_view _text)
+    {
+        auto const width = static_cast<size_t>(_grid.screenSize().width);
+        auto const margin = Margin{{1, _grid.screenSize().height}, {1, _grid.screenSize().width}};
+        auto wrapped = false;
+        do
+        {
+            Line& line = _grid.lineAt(_grid.screenSize().height);
+            line.setText(_text.substr(0, width));
+            line.setWrappable(true);
+            line.setWrapped(wrapped);
+            _grid.scrollUp(1, GraphicsAttributes{}, margin);
+            _text.remove_prefix(std::min(width, _text.size()));
+            wrapped = true;
+        }
+        while (!_text.empty());
+    }
+
+    Grid filledGrid(std::mt19937& _rng, int _historySize, bool _reflowOnResize)
+    {
+        auto grid = Grid(PageSize, _reflowOnResize, _historySize);
+        for (string const& text: randomLines(_rng, static_cast<size_t>(_historySize + PageSize.height)))
+            writeLine(grid, text);
+        return grid;
+    }
+} // }}}
+
+CRISPY_BENCHMARK("Grid.scrollUp")
+{
+    for (int const historySize: HistorySizes)
+    {
+        auto const variant = fmt::format("history={}", historySize);
+        if (!_bench.selected(variant))
+            continue;
+
+        auto grid = filledGrid(_bench.rng(), historySize, false);
+        auto const lines = randomLines(_bench.rng(), 1024);
+        auto const margin = Margin{{1, PageSize.height}, {1, PageSize.width}};
+        size_t i = 0;
+        _bench.measure(variant, [&]() {
+            auto const text = std::string_view(lines[i++ % lines.size()]).substr(0, PageSize.width);
+            grid.lineAt(PageSize.height).setText(text);
+            grid.scrollUp(1, GraphicsAttributes{}, margin);
+        });
+    }
+}
+
+CRISPY_BENCHMARK("Grid.resize")
+{
+    for (bool const reflow: {false, true})
+    {
+        for (int const historySize: HistorySizes)
+        {
+            auto const variant = fmt::format("reflow={}/history={}", reflow, historySize);
+            if (!_bench.selected(variant))
+                continue;
+
+            // Narrows the grid and widens it back, with all of the history reflowed each time.
+            auto grid = filledGrid(_bench.rng(), historySize, reflow);
+            auto cursor = Coordinate{PageSize.height, 1};
+            _bench.measure(variant, [&]() {
+                for (int const width: {PageSize.width * 3 / 4, PageSize.width})
+                {
+                    cursor = grid.resize(Size{width, PageSize.height}, cursor, false);
+                    do_not_optimize(grid.reflowHistory());
+                }
+            });
+        }
+    }
+}
+
+CRISPY_BENCHMARK("Line")
+{
+    auto const texts = randomLines(_bench.rng(), 1024);
+    size_t i = 0;
+
+    auto line = Line(PageSize.width, GraphicsAttributesId{}, Line::Flags::Wrappable);
+    _bench.measure("setText", [&]() {
+        line.setText(std::string_view(texts[i++ % texts.size()]).substr(0, PageSize.width));
+    });
+
+    auto lines = vector<Line>();
+    for (string const& text: texts)
+        lines.emplace_back(PageSize.width, std::string_view(text).substr(0, PageSize.width), Line::Flags::Wrappable);
+
+    _bench.measure("toUtf8", [&]() {
+        do_not_optimize(lines[i++ % lines.size()].toUtf8());
+    });
+
+    _bench.measure("fill", [&]() {
+        line.fill(1, PageSize.width, GraphicsAttributesId{}, U'x');
+    });
+
+    _bench.measure("copy", [&]() {
+        auto copy = lines[i++ % lines.size()];
+        do_not_optimize(copy);
+    });
+
+    // Compresses a line the way history lines are, and inflates it again as when being written to.
+    _bench.measure("compress+inflate", [&]() {
+        Line& target = lines[i++ % lines.size()];
+        do_not_optimize(target.compress());
+        do_not_optimize(*target.begin());
+    });
+}
@@ -13,6 +13,7 @@
  */
 #include <terminal/Grid.h>
 #include <terminal/Parser.h>
+#include <terminal/ScrollbackFile.h>
 #include <catch2/catch.hpp>
 #include <fmt/format.h>
 #include <iostream>
@@ -58,46 +59,1149 @@ namespace // {{{ helper
     }
 } // }}}
 
-TEST_CASE("Line.reflow.unwrappable", "[grid]")
+TEST_CASE("Cell.codepoints", "[grid]")
 {
-    auto line = Line(5, "ABCDE"sv, Line::Flags::None);
-    REQUIRE(!line.wrappable());
-    REQUIRE(!line.wrapped());
+    auto cell = Cell{};
+    CHECK(cell.empty());
+    CHECK(cell.codepointCount() == 0);
+    CHECK(cell.codepoints().empty());
+
+    cell.setCharacter('A');
+    CHECK(cell.codepointCount() == 1);
+    CHECK(cell.codepoints() == U"A"sv);
+
+    cell.appendCharacter(0x0301); // combining acute accent
+    cell.appendCharacter(0x0302);
+    CHECK(cell.codepointCount() == 3);
+    CHECK(cell.codepoints() == U"A\u0301\u0302"sv);
+    CHECK(cell.codepoint(2) == 0x0302);
+
+    auto copy = cell;
+    cell.setCharacter('B');
+    CHECK(cell.codepoints() == U"B"sv);
+    CHECK(copy.codepoints() == U"A\u0301\u0302"sv);
+    CHECK_FALSE(copy == cell);
+
+    copy = cell;
+    CHECK(copy == cell);
+
+    cell.reset();
+    CHECK(cell.empty());
+    CHECK(cell.width() == 1);
+
+    auto wide = Cell{0x4E2D};
+    CHECK(wide.width() == 2);
+    CHECK(wide.codepoints() == U"\u4E2D"sv);
+}
+
+#if defined(LIBTERMINAL_HYPERLINKS)
+TEST_CASE("Cell.hyperlink", "[grid]")
+{
+    auto const hyperlink = HyperlinkId{1};
+
+    auto cell = Cell{};
+    cell.setCharacter('X');
+    cell.setHyperlink(hyperlink);
+    cell.setCharacter('Y'); // keeps the hyperlink
+    CHECK(cell.hyperlink() == hyperlink);
+    CHECK(Cell(cell).hyperlink() == hyperlink);
+
+    cell.setHyperlink(NoHyperlinkId);
+    CHECK(cell.hyperlink() == NoHyperlinkId);
+    CHECK(cell.codepoints() == U"Y"sv);
+
+    cell.reset(DefaultGraphicsAttributesId, hyperlink);
+    CHECK(cell.empty());
+    CHECK(cell.hyperlink() == hyperlink);
+}
+
+TEST_CASE("Line.fill", "[grid]")
+{
+    auto line = Line(6, "abcdef"sv, Line::Flags::None);
+    line[1].appendCharacter(0x0301);
+    line[2].setHyperlink(HyperlinkId{1});
+
+    line.fill(1, 4, GraphicsAttributesId{3}, 'x');
+    CHECK(line.toUtf8() == "axxxef");
+    CHECK(line[1].codepointCount() == 1);
+    CHECK(line[2].hyperlink() == NoHyperlinkId);
+    CHECK(line[3].attributes() == GraphicsAttributesId{3});
+    CHECK(line[4].attributes() == DefaultGraphicsAttributesId);
+
+    line.fill(0, 6, DefaultGraphicsAttributesId);
+    CHECK(line.blank());
+}
+
+TEST_CASE("Line.blank.lazy", "[grid]")
+{
+    auto line = Line(10, GraphicsAttributesId{2}, Line::Flags::None);
+    CHECK(line.size() == 10);
+    CHECK(line.untrimmedCells().size() == 0);
+    CHECK(line.trimmedAttributes() == GraphicsAttributesId{2});
+
+    // Allocated on first access.
+    line[1].setCharacter('x');
+    CHECK(line.trimmedCellCount() == 0);
+    CHECK(line.toUtf8() == " x        ");
+    CHECK(line[9].attributes() == GraphicsAttributesId{2});
+
+    // Allocated cells are reused when being reset.
+    line.reset(DefaultGraphicsAttributesId);
+    CHECK(line.untrimmedCells().size() == 10);
+    CHECK(line.blank());
+
+    line.trim();
+    line.reset(GraphicsAttributesId{3});
+    CHECK(line.untrimmedCells().size() == 0);
+    CHECK(line.size() == 10);
+    CHECK(line[0].attributes() == GraphicsAttributesId{3});
+}
+
+TEST_CASE("Grid.touchPage.previous", "[grid]")
+{
+    auto primary = Grid(Size{3, 3}, false, 0);
+    auto alternate = Grid(Size{3, 3}, false, 0);
+    primary.lineAt(2)[0].setCharacter('a');
+    primary.touch(primary.lineAt(2));
+    alternate.lineAt(3)[0].setCharacter('a');
+    alternate.touch(alternate.lineAt(3));
+
+    auto const generation = primary.generation();
+    alternate.touchPage(primary);
+    CHECK(alternate.changedLines(generation) == std::vector<int>{2, 3});
+    CHECK(alternate.lineAt(1).generation() == primary.lineAt(1).generation());
+
+    // No line is allocated for that.
+    CHECK(alternate.lineAt(1).untrimmedCells().size() == 0);
+}
+
+TEST_CASE("HyperlinkTable", "[grid]")
+{
+    auto table = HyperlinkTable{};
+    CHECK(table.find(NoHyperlinkId) == nullptr);
+
+    auto const a = table.add("a", "https://a.example/");
+    auto const b = table.add("", "https://b.example/");
+    REQUIRE(a.has_value());
+    REQUIRE(b.has_value());
+    CHECK(*a != *b);
+    CHECK(table.add("a", "https://a.example/") == a); // same ID, same hyperlink
+    CHECK(table.add("", "https://b.example/") != b);  // anonymous hyperlinks are never shared
+    CHECK(table.find(*a)->uri == "https://a.example/");
+
+    auto used = std::vector<bool>(table.size(), false);
+    used[*b] = true;
+    table.release(used);
+    CHECK(table.find(*a) == nullptr);
+    CHECK(table.find(*b)->uri == "https://b.example/");
+
+    // Released identifiers are reused, and the released hyperlink's ID is forgotten.
+    auto const c = table.add("a", "https://c.example/");
+    REQUIRE(c.has_value());
+    CHECK(table.find(*c)->uri == "https://c.example/");
+    CHECK(table.size() == 4);
+}
+#endif
+
+TEST_CASE("GraphicsAttributesTable.intern", "[grid]")
+{
+    auto table = GraphicsAttributesTable{};
+    CHECK(table.size() == 1);
+    CHECK(table.intern(GraphicsAttributes{}) == DefaultGraphicsAttributesId);
+
+    auto red = GraphicsAttributes{};
+    red.foregroundColor = RGBColor{0xFF, 0x00, 0x00};
+    auto redGreen = red;
+    redGreen.foregroundColor = RGBColor{0xFF, 0x80, 0x00};
+
+    auto const redId = table.intern(red);
+    auto const redGreenId = table.intern(redGreen);
+    REQUIRE(redId.has_value());
+    REQUIRE(redGreenId.has_value());
+    CHECK(*redId != *redGreenId);
+    CHECK(table.intern(red) == redId);
+    CHECK(table.size() == 3);
+    CHECK(getRGBColor(table[*redGreenId].foregroundColor).green == 0x80);
+}
+
+TEST_CASE("Grid.intern.collectsUnusedAttributes", "[grid]")
+{
+    auto grid = Grid(Size{2, 1}, false, std::nullopt);
+
+    auto const coloredBy = [](unsigned _value) {
+        auto attributes = GraphicsAttributes{};
+        attributes.backgroundColor = RGBColor{static_cast<uint32_t>(_value)};
+        return attributes;
+    };
+
+    // Fill up the table, with only one entry in use by any cell.
+    for (unsigned i = 1; i < GraphicsAttributesTable::Capacity; ++i)
+        grid.intern(coloredBy(i));
+    REQUIRE(grid.attributesTable().size() == GraphicsAttributesTable::Capacity);
+    grid.at({1, 2}).setAttributes(grid.intern(coloredBy(42)));
+    auto const version = grid.attributesTable().version();
+
+    auto const id = grid.intern(coloredBy(0x123456));
+    CHECK(grid.attributesTable().size() == 3);
+    CHECK(grid.attributesTable().version() != version);
+    CHECK(grid.attributes(id).backgroundColor == coloredBy(0x123456).backgroundColor);
+    CHECK(grid.at({1, 1}).attributes() == DefaultGraphicsAttributesId);
+    CHECK(getRGBColor(grid.attributes(grid.at({1, 2})).backgroundColor).blue == 42);
+}
+
+#if defined(LIBTERMINAL_IMAGES)
+TEST_CASE("Cell.image", "[grid]")
+{
+    auto cell = Cell{};
+    cell.setCharacter('X');
+    cell.setImage(ImageRowId{0x12345}, 0x678);
+    CHECK(cell.hasImage());
+    CHECK(!cell.empty());
+    CHECK(cell.codepoints().empty());
+    CHECK(cell.imageRow() == 0x12345);
+    CHECK(cell.imageColumn() == 0x678);
+    CHECK(Cell(cell).hasImage());
+
+    cell.setCharacter('Y');
+    CHECK(!cell.hasImage());
+    CHECK(cell.codepoints() == U"Y"sv);
+
+    cell.setImage(ImageRowId{0}, 0);
+    CHECK(!cell.empty());
+    cell.appendCharacter('Z');
+    CHECK(!cell.hasImage());
+    CHECK(cell.codepoints() == U"Z"sv);
+}
+
+TEST_CASE("Grid.addImageRow", "[grid]")
+{
+    auto grid = Grid(Size{4, 1}, false, std::nullopt);
+    auto const imageSize = Size{4, 2};
+    auto const image = std::make_shared<Image const>(1, ImageFormat::RGBA, Image::Data(4 * 2 * 4), imageSize);
+    auto const rasterizedImage = std::make_shared<RasterizedImage const>(image, ImageAlignment::TopStart,
+                                                                         ImageResize::NoResize, RGBAColor{},
+                                                                         imageSize, Size{1, 1});
+
+    auto const row = grid.addImageRow(rasterizedImage, 1);
+    REQUIRE(row.has_value());
+    grid.at({1, 3}).setImage(*row, 2);
+
+    CHECK(!grid.imageFragment(grid.at({1, 1})).has_value());
+    auto const fragment = grid.imageFragment(grid.at({1, 3}));
+    REQUIRE(fragment.has_value());
+    CHECK(fragment->offset() == Coordinate{1, 2});
+    CHECK(&fragment->rasterizedImage() == rasterizedImage.get());
+
+    // Rows not referenced by any cell are eventually released, while others are kept.
+    for (int i = 0; i < 1000; ++i)
+        REQUIRE(grid.addImageRow(rasterizedImage, 0).has_value());
+    CHECK(grid.imageRowTable().used() < 1000);
+    CHECK(grid.imageFragment(grid.at({1, 3}))->offset() == Coordinate{1, 2});
+}
+
+TEST_CASE("Grid.evictHistoryImages", "[grid]")
+{
+    auto pool = ImagePool{};
+    auto grid = Grid(Size{4, 1}, false, 10);
+
+    // Places one image per line, leaving the first two in the history.
+    auto const imageSize = Size{4, 4};
+    for (int i = 0; i < 3; ++i)
+    {
+        if (i != 0)
+            grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 4}});
+        auto const image = pool.create(ImageFormat::RGBA, imageSize, Image::Data(4 * 4 * 4));
+        auto const row = grid.addImageRow(pool.rasterize(image, ImageAlignment::TopStart, ImageResize::NoResize,
+                                                         RGBAColor{}, Size{1, 1}, imageSize), 0);
+        REQUIRE(row.has_value());
+        grid.lineAt(1)[0].setImage(*row, 0);
+    }
+    REQUIRE(grid.historyLineCount() == 2);
+    CHECK(pool.imageCount() == 3);
+    CHECK(pool.imageBytes() == 3 * 64);
+    CHECK_FALSE(pool.overBudget());
+
+    // Only as many images as needed are evicted, oldest first.
+    pool.setMemoryLimit(2 * 64);
+    REQUIRE(pool.overBudget());
+    pool.evict([&]() { CHECK(grid.evictHistoryImages([&]() { return !pool.overBudget(); }) == 1); });
+    CHECK(pool.imageCount() == 2);
+    CHECK(pool.evictedImageCount() == 1);
+    CHECK(pool.evictedImageBytes() == 64);
+    CHECK(grid.at({-1, 1}).hasImage());
+    CHECK_FALSE(grid.imageFragment(grid.at({-1, 1})).has_value());
+    CHECK(grid.imageFragment(grid.at({0, 1})).has_value());
+
+    // Images in the main page are never evicted.
+    pool.setMemoryLimit(1);
+    pool.evict([&]() { grid.evictHistoryImages([&]() { return !pool.overBudget(); }); });
+    CHECK(pool.imageCount() == 1);
+    CHECK(pool.evictedImageCount() == 2);
+    CHECK(grid.imageFragment(grid.at({1, 1})).has_value());
+    CHECK(grid.evictHistoryImages([]() { return false; }) == 0);
+
+    CHECK(grid.imageRowTable().used() == 3);
+    CHECK(grid.imageRowTable().live() == 1);
+}
 
-    auto const reflowed = line.reflow(3);
-    CHECK(!line.wrapped());
-    CHECK(line.size() == 3);
-    CHECK(line.toUtf8() == "ABC");
-    CHECK(reflowed.size() == 0);
+TEST_CASE("ImageRowTable.evict", "[grid]")
+{
+    auto const imageSize = Size{1, 1};
+    auto const image = std::make_shared<Image const>(1, ImageFormat::RGBA, Image::Data(4), imageSize);
+    auto const rasterizedImage = std::make_shared<RasterizedImage const>(image, ImageAlignment::TopStart,
+                                                                         ImageResize::NoResize, RGBAColor{},
+                                                                         imageSize, imageSize);
+    auto table = ImageRowTable{};
+    auto const a = table.add(rasterizedImage, 0);
+    auto const b = table.add(rasterizedImage, 0);
+    REQUIRE((a.has_value() && b.has_value()));
+
+    CHECK(table.evict(*a));
+    CHECK_FALSE(table.evict(*a));
+    CHECK_FALSE(table.hasImage(*a));
+    CHECK_FALSE(table.fragment(*a, 0).has_value());
+    CHECK(table.used() == 2);
+    CHECK(table.live() == 1);
+
+    // Evicted rows are released just like others, once no longer referenced.
+    table.release(std::vector<bool>{false, false});
+    CHECK(table.used() == 0);
+    CHECK(table.live() == 0);
+    CHECK(rasterizedImage.use_count() == 1);
 }
+#endif
 
-TEST_CASE("Line.reflow.wrappable", "[grid]")
+TEST_CASE("Line.compress", "[grid]")
 {
-    auto line = Line(5, "ABCDE"sv, Line::Flags::Wrappable);
-    REQUIRE(line.wrappable());
-    REQUIRE(!line.wrapped());
+    auto line = Line(10, "Ax b"sv, Line::Flags::Wrappable);
+    line[1].setCharacter(0x4E2D);
+    line[2].setCharacter(0xE4);
+    line[1].setAttributes(3);
+    line[2].setAttributes(3);
+    auto const expected = line;
+
+    REQUIRE(line.compress());
+    CHECK(line.compressed());
+    CHECK(line.size() == 10);
+    CHECK(line.wrappable());
+
+    auto used = std::vector<bool>(4, false);
+    line.markUsedAttributes(used);
+    CHECK(used == std::vector<bool>{true, false, false, true});
+    CHECK(line.compressed());
+
+    // Accessing the cells restores them.
+    CHECK(line[1].codepoints() == U"\u4E2D"sv);
+    CHECK_FALSE(line.compressed());
+    CHECK(line.size() == 10);
+    for (int i = 0; i < 10; ++i)
+    {
+        INFO(fmt::format("column {}", i));
+        CHECK(line[i] == expected[i]);
+        CHECK(line[i].width() == expected[i].width());
+    }
 
-    auto const reflowed = Line(line.reflow(3), line.inheritableFlags() | Line::Flags::Wrapped);
-    CHECK(!line.wrapped());
-    CHECK(line.size() == 3);
-    CHECK(line.toUtf8() == "ABC");
-    CHECK(reflowed.size() == 2);
-    CHECK(reflowed.toUtf8() == "DE");
+    // Grapheme clusters are kept uncompressed.
+    line[3].appendCharacter(0x0301);
+    CHECK_FALSE(line.compress());
+    CHECK(line[3].codepointCount() == 2);
 }
 
-TEST_CASE("Line.reflow.empty", "[grid]")
+TEST_CASE("Line.trim", "[grid]")
 {
-    auto line = Line(5, Cell{}, Line::Flags::Wrappable);
-    REQUIRE(!line.wrapped());
-    REQUIRE(line.size() == 5);
-    REQUIRE(line.toUtf8() == "     ");
+    auto line = Line(20, Cell{}, Line::Flags::None);
+    line.setText("abc");
+    line.trim();
+    CHECK(line.trimmedCellCount() == 17);
+    CHECK(line.size() == 20);
+    CHECK(line.toUtf8() == "abc                 ");
+
+    // Growing and shrinking along the dropped cells keeps them dropped.
+    line.resize(30);
+    CHECK(line.trimmedCellCount() == 27);
+    line.resize(10);
+    CHECK(line.trimmedCellCount() == 7);
+    CHECK(line.size() == 10);
+
+    // Any cell access restores them.
+    CHECK(line[9].empty());
+    CHECK(line.trimmedCellCount() == 0);
+    CHECK(line.size() == 10);
+    CHECK(line.toUtf8() == "abc       ");
+
+    // Trailing blanks sharing a non-default rendition are restored along with it.
+    auto grid = Grid(Size{20, 1}, false, 0);
+    auto attributes = GraphicsAttributes{};
+    attributes.backgroundColor = RGBColor{1, 2, 3};
+    auto const id = grid.intern(attributes);
+    auto colored = Line(20, Cell{{}, id}, Line::Flags::None);
+    colored.setText("x");
+    colored.trim();
+    CHECK(colored.trimmedCellCount() == 19);
+    auto used = std::vector<bool>(grid.attributesTable().size(), false);
+    colored.markUsedAttributes(used);
+    CHECK(used.at(id));
+    CHECK(colored.compress());
+    CHECK(colored[19].attributes() == id);
+
+    // Too few blank cells aren't worth it.
+    auto full = Line(5, "abcd"sv, Line::Flags::None);
+    full.trim();
+    CHECK(full.trimmedCellCount() == 0);
+}
+
+TEST_CASE("Grid.history.trim", "[grid]")
+{
+    auto grid = Grid(Size{40, 1}, false, 10);
+    for (auto const text : {"abc", "def", "ghi"})
+    {
+        grid.lineAt(1).setText(text);
+        grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 40}});
+    }
+
+    REQUIRE(grid.historyLineCount() == 3);
+    CHECK(grid.absoluteLineAt(0).trimmedCellCount() == 37);
+    CHECK(grid.absoluteLineAt(1).trimmedCellCount() == 37);
+    // The most recent history line is left as is.
+    CHECK(grid.absoluteLineAt(2).trimmedCellCount() == 0);
+
+    CHECK(grid.absoluteLineAt(0).toUtf8Trimmed() == "abc");
+    CHECK(grid.absoluteLineAt(0).size() == 40);
 
-    auto const reflowed = Line(line.reflow(3), line.flags());
-    CHECK(!line.wrapped());
-    CHECK(line.size() == 3);
-    CHECK(line.toUtf8() == "   ");
-    CHECK(reflowed.size() == 0);
-    CHECK(reflowed.toUtf8() == "");
+    // Recycled lines are blank again, and not allocated before being written to.
+    auto recycled = Grid(Size{40, 1}, false, 2);
+    for (int i = 0; i < 5; ++i)
+    {
+        recycled.lineAt(1).setText("abc");
+        recycled.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 40}});
+    }
+    CHECK(recycled.lineAt(1).trimmedCellCount() == 40);
+    CHECK(recycled.lineAt(1).size() == 40);
+    CHECK(recycled.lineAt(1).blank());
+    CHECK(recycled.absoluteLineAt(0).trimmedCellCount() == 37);
+}
+
+TEST_CASE("Grid.renderRows", "[grid]")
+{
+    auto grid = Grid(Size{40, 2}, false, 10);
+    grid.lineAt(1).setText("abc");
+    grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 2}, {1, 40}});
+    grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 2}, {1, 40}});
+    grid.lineAt(1).setText("xyz");
+    grid.lineAt(1).resize(30);
+    REQUIRE(grid.historyLineCount() == 2);
+    REQUIRE(grid.absoluteLineAt(0).trimmedCellCount() == 37);
+
+    auto rows = std::vector<std::tuple<int, string, int, int>>{};
+    auto const collect = [&](RowCells const& _row) {
+        auto text = string{};
+        for (Cell const& cell: _row.cells)
+            text += cell.empty() ? ' ' : static_cast<char>(cell.codepoint(0));
+        rows.emplace_back(_row.row, text, _row.trimmedBlanks, _row.paddingBlanks);
+        CHECK(static_cast<int>(_row.cells.size()) + _row.trailingBlanks() == 40);
+    };
+
+    // History lines keep their trailing blank cells dropped.
+    grid.renderRows(collect, 0);
+    REQUIRE(rows.size() == 2);
+    CHECK(std::get<0>(rows[0]) == 1);
+    CHECK(std::get<1>(rows[0]) == "abc");
+    CHECK(std::get<2>(rows[0]) == 37);
+    CHECK(std::get<3>(rows[0]) == 0);
+    CHECK(std::get<0>(rows[1]) == 2);
+    CHECK(grid.absoluteLineAt(0).trimmedCellCount() == 37);
+
+    // Lines narrower than the page are padded up to its width.
+    rows.clear();
+    grid.renderRows(collect);
+    REQUIRE(rows.size() == 2);
+    CHECK(std::get<1>(rows[0]).substr(0, 3) == "xyz");
+    CHECK(std::get<3>(rows[0]) == 10);
+
+    // The cell callback sees the very same cells, trailing blanks included.
+    auto text = string{};
+    grid.render([&](Coordinate const& _pos, Cell const& _cell) {
+        if (_pos.row == 1)
+            text += _cell.empty() ? ' ' : static_cast<char>(_cell.codepoint(0));
+    });
+    CHECK(text == "xyz" + string(37, ' '));
+}
+
+TEST_CASE("Grid.history.pooledCells", "[grid]")
+{
+    auto pool = crispy::size_class_pool{};
+    auto* const previous = crispy::size_class_pool::set_current(&pool);
+
+    // Once the history is full, the cells of dropped and trimmed lines are handed out again.
+    {
+        auto grid = Grid(Size{40, 2}, false, 4);
+        auto const scroll = [&](int _count) {
+            for (int i = 0; i < _count; ++i)
+            {
+                grid.lineAt(2).setText("abc");
+                grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 2}, {1, 40}});
+            }
+        };
+        scroll(10);
+
+        auto const before = pool.stats();
+        scroll(20);
+        auto const after = pool.stats();
+        CHECK(after.allocations > before.allocations);
+        CHECK(after.reused - before.reused == after.allocations - before.allocations);
+    }
+
+    crispy::size_class_pool::set_current(previous);
+}
+
+TEST_CASE("Grid.historyCompressionThreshold", "[grid]")
+{
+    auto grid = Grid(Size{4, 1}, false, 10);
+    grid.setHistoryCompressionThreshold(2);
+
+    for (auto const text : {"abcd", "efgh", "ijkl", "mnop"})
+    {
+        grid.lineAt(1).setText(text);
+        grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 4}});
+    }
+
+    REQUIRE(grid.historyLineCount() == 4);
+    CHECK(grid.absoluteLineAt(0).compressed());
+    CHECK(grid.absoluteLineAt(1).compressed());
+    CHECK_FALSE(grid.absoluteLineAt(2).compressed());
+    CHECK_FALSE(grid.absoluteLineAt(3).compressed());
+
+    CHECK(grid.renderTextLineAbsolute(0) == "abcd");
+    CHECK(grid.renderTextLineAbsolute(1) == "efgh");
+    CHECK(grid.renderTextLineAbsolute(3) == "mnop");
+}
+
+TEST_CASE("Grid.history.sharedCells", "[grid]")
+{
+    auto grid = Grid(Size{4, 1}, false, std::nullopt);
+    grid.setHistoryCompressionThreshold(3);
+    auto const write = [&](std::initializer_list<char const*> _texts) {
+        for (auto const text : _texts)
+        {
+            grid.lineAt(1).setText(text);
+            grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 4}});
+        }
+    };
+
+    write({"abcd", "efgh", "abcd", "abcd", "efgh", "abcd", "ijkl"});
+    REQUIRE(grid.historyLineCount() == 7);
+
+    // Lines that have just become cold share the cells of compressed ones right away.
+    CHECK(grid.absoluteLineAt(4).compressed());
+    CHECK(grid.absoluteLineAt(5).compressed());
+    CHECK_FALSE(grid.absoluteLineAt(6).compressed());
+
+    // Lines sharing their cells with more lines account for less memory each.
+    CHECK(grid.absoluteLineAt(0).memoryFootprint() < grid.absoluteLineAt(1).memoryFootprint());
+
+    // Writing to a line leaves the ones it has shared its cells with untouched.
+    grid.absoluteLineAt(2).fill(0, 4, DefaultGraphicsAttributesId, 'x');
+    auto const texts = std::vector<std::string>{"abcd", "efgh", "xxxx", "abcd", "efgh", "abcd", "ijkl"};
+    for (int i = 0; i < 7; ++i)
+        CHECK(grid.renderTextLineAbsolute(i) == texts[static_cast<size_t>(i)]);
+}
+
+TEST_CASE("Grid.historySpill", "[grid]")
+{
+    auto grid = Grid(Size{4, 1}, false, std::nullopt);
+    grid.setHistorySpill(1);
+
+    auto attributes = GraphicsAttributes{};
+    attributes.foregroundColor = RGBColor{1, 2, 3};
+
+    for (auto const text : {"abcd", "efgh", "ijkl"})
+    {
+        grid.lineAt(1).setText(text);
+        grid.lineAt(1)[0].setAttributes(grid.intern(attributes));
+        grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 4}});
+    }
+
+    REQUIRE(grid.historyLineCount() == 3);
+    CHECK(grid.absoluteLineAt(0).spilled());
+    CHECK(grid.absoluteLineAt(1).spilled());
+    CHECK_FALSE(grid.absoluteLineAt(2).spilled());
+
+    auto used = std::vector<bool>(grid.attributesTable().size(), false);
+    grid.absoluteLineAt(0).markUsedAttributes(used);
+    CHECK(used.at(grid.intern(attributes)));
+
+    CHECK(grid.renderTextLineAbsolute(0) == "abcd");
+    CHECK(grid.renderTextLineAbsolute(1) == "efgh");
+    CHECK_FALSE(grid.absoluteLineAt(1).spilled());
+    CHECK(grid.attributes(grid.absoluteLineAt(1)[0]).foregroundColor == attributes.foregroundColor);
+}
+
+TEST_CASE("ScrollbackFile.wasteful", "[grid]")
+{
+    auto file = ScrollbackFile::create({});
+    REQUIRE(file);
+
+    // Records of lines dropped from the history are released, but never reused.
+    auto const record = string(8 * 1024 * 1024, 'x');
+    for (int i = 0; i < 2; ++i)
+    {
+        REQUIRE(file->append(record).has_value());
+        file->retain(record.size());
+    }
+    CHECK(file->referencedSize() == file->size());
+    CHECK_FALSE(file->wasteful());
+
+    file->release(record.size());
+    CHECK_FALSE(file->wasteful());
+
+    file->release(record.size());
+    CHECK(file->referencedSize() == 0);
+    CHECK(file->wasteful());
+}
+
+TEST_CASE("Grid.maxHistoryBytes", "[grid]")
+{
+    auto grid = Grid(Size{4, 1}, false, std::nullopt);
+    auto const write = [&](std::initializer_list<char const*> _texts) {
+        for (auto const text : _texts)
+        {
+            grid.lineAt(1).setText(text);
+            grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 4}});
+        }
+    };
+
+    write({"abcd", "efgh", "ijkl", "mnop", "qrst"});
+    REQUIRE(grid.historyLineCount() == 5);
+    auto const lineBytes = grid.absoluteLineAt(0).memoryFootprint();
+
+    // The most recent history line is not accounted for.
+    CHECK(grid.historyBytes() == 4 * lineBytes);
+
+    grid.setMaxHistoryBytes(2 * lineBytes);
+    CHECK(grid.historyLineCount() == 3);
+    CHECK(grid.historyBytes() == 2 * lineBytes);
+    CHECK(grid.renderTextLineAbsolute(0) == "ijkl");
+
+    write({"uvwx", "yzAB"});
+    CHECK(grid.historyLineCount() == 3);
+    CHECK(grid.historyBytes() == 2 * lineBytes);
+    CHECK(grid.renderTextLineAbsolute(0) == "qrst");
+
+    grid.clearHistory();
+    CHECK(grid.historyBytes() == 0);
+}
+
+TEST_CASE("Grid.globalMaxHistoryBytes", "[grid]")
+{
+    auto first = Grid(Size{4, 1}, false, std::nullopt);
+    auto second = Grid(Size{4, 1}, false, std::nullopt);
+    auto const write = [](Grid& _grid, int _count) {
+        for (int i = 0; i < _count; ++i)
+        {
+            _grid.lineAt(1).setText("abcd");
+            _grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 4}});
+        }
+    };
+
+    write(first, 4);
+    auto const lineBytes = first.absoluteLineAt(0).memoryFootprint();
+    auto const otherBytes = Grid::globalHistoryBytes() - first.historyBytes();
+
+    Grid::setGlobalMaxHistoryBytes(otherBytes + 5 * lineBytes);
+
+    // Only the grid whose history is growing drops lines.
+    write(second, 5);
+    CHECK(first.historyLineCount() == 4);
+    CHECK(second.historyLineCount() == 3);
+    CHECK(Grid::globalHistoryBytes() == otherBytes + 5 * lineBytes);
+
+    Grid::setGlobalMaxHistoryBytes(std::nullopt);
+    write(second, 2);
+    CHECK(second.historyLineCount() == 5);
+}
+
+TEST_CASE("Grid.scroll.horizontalMargin", "[grid]")
+{
+    auto grid = Grid(Size{5, 4}, false, 0);
+    auto const setPage = [&]() {
+        for (int row = 1; row <= 4; ++row)
+            grid.lineAt(row).setText(fmt::format("{0}{0}{0}{0}{0}", row));
+    };
+    auto const page = [&]() {
+        auto rows = std::vector<std::string>{};
+        for (int row = 1; row <= 4; ++row)
+            rows.emplace_back(grid.lineAt(row).toUtf8());
+        return rows;
+    };
+
+    setPage();
+    grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 4}, {2, 4}});
+    CHECK(page() == std::vector<std::string>{"12221", "23332", "34443", "4   4"});
+
+    setPage();
+    grid.scrollDown(2, GraphicsAttributes{}, Margin{{2, 4}, {2, 4}});
+    CHECK(page() == std::vector<std::string>{"11111", "2   2", "3   3", "42224"});
+
+    setPage();
+    grid.scrollDown(3, GraphicsAttributes{}, Margin{{1, 2}, {2, 4}});
+    CHECK(page() == std::vector<std::string>{"1   1", "2   2", "33333", "44444"});
+}
+
+TEST_CASE("Grid.copyArea", "[grid]")
+{
+    auto grid = Grid(Size{5, 3}, false, 0);
+    auto const setPage = [&]() {
+        grid.lineAt(1).setText("abcde");
+        grid.lineAt(2).setText("fghij");
+        grid.lineAt(3).setText("klmno");
+    };
+    auto const page = [&]() {
+        return fmt::format("{}|{}|{}", grid.lineAt(1).toUtf8(), grid.lineAt(2).toUtf8(), grid.lineAt(3).toUtf8());
+    };
+
+    SECTION("overlapping right and down") {
+        setPage();
+        grid.copyArea(1, 1, 2, 3, 2, 2);
+        CHECK(page() == "abcde|fabcj|kfgho");
+    }
+
+    SECTION("overlapping left and up") {
+        setPage();
+        grid.copyArea(2, 2, 3, 4, 1, 1);
+        CHECK(page() == "ghide|lmnij|klmno");
+    }
+
+    SECTION("clipped at the page's edges") {
+        setPage();
+        grid.copyArea(1, 1, 3, 5, 3, 4);
+        CHECK(page() == "abcde|fghij|klmab");
+    }
+}
+
+TEST_CASE("Grid.search", "[grid]")
+{
+    auto grid = Grid(Size{4, 1}, false, 100);
+    grid.setHistoryCompressionThreshold(10);
+
+    auto const writeLines = [&](int _first, int _count) {
+        for (int i = _first; i < _first + _count; ++i)
+        {
+            grid.lineAt(1).setText(fmt::format("{:04}", i));
+            grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 4}});
+        }
+    };
+
+    writeLines(0, 200);
+    REQUIRE(grid.historyLineCount() == 100);
+    REQUIRE(grid.absoluteLineAt(50).compressed());
+
+    CHECK(grid.search("0150") == std::vector<Coordinate>{{50, 1}});
+    CHECK(grid.search("150") == std::vector<Coordinate>{{50, 2}});
+    CHECK(grid.search("0050").empty());
+    CHECK(grid.search(std::regex("01[5-6]9")) == std::vector<Coordinate>{{59, 1}, {69, 1}});
+
+    // Lines dropped off the history are dropped from the index as well.
+    writeLines(200, 50);
+    CHECK(grid.search("0150") == std::vector<Coordinate>{{0, 1}});
+    CHECK(grid.search("0120").empty());
+    CHECK(grid.search("0249") == std::vector<Coordinate>{{99, 1}});
+
+    grid.lineAt(1).setText("0150");
+    CHECK(grid.search("0150") == std::vector<Coordinate>{{0, 1}, {100, 1}});
+
+    grid.clearHistory();
+    CHECK(grid.search("0150") == std::vector<Coordinate>{{0, 1}});
+}
+
+TEST_CASE("Grid.search.columns", "[grid]")
+{
+    auto grid = Grid(Size{5, 1}, false, 10);
+    grid.setHistoryCompressionThreshold(0);
+
+    grid.lineAt(1).setText("a\u00E4bc");
+    grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 5}});
+    grid.lineAt(1).setText("\u00E4bc");
+    grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 5}});
+
+    REQUIRE(grid.absoluteLineAt(0).compressed());
+    CHECK(grid.search("\u00E4bc") == std::vector<Coordinate>{{0, 2}, {1, 1}});
+    CHECK(grid.search(std::regex("c ")) == std::vector<Coordinate>{{0, 4}, {1, 3}});
+}
+
+TEST_CASE("Grid.search.reflow", "[grid]")
+{
+    auto grid = Grid(Size{4, 1}, true, 10);
+    for (auto const text : {"abcd", "efgh", "ijkl"})
+    {
+        grid.lineAt(1).setText(text);
+        grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 4}});
+    }
+    REQUIRE(grid.search("efgh") == std::vector<Coordinate>{{1, 1}});
+
+    (void) grid.resize(Size{2, 1}, Coordinate{1, 1}, false);
+    REQUIRE(grid.renderTextLineAbsolute(2) == "ef");
+    CHECK(grid.search("efgh") == std::vector<Coordinate>{{2, 1}});
+    CHECK(grid.search("gh") == std::vector<Coordinate>{{3, 1}});
+
+    (void) grid.resize(Size{4, 1}, Coordinate{1, 1}, false);
+    CHECK(grid.search("efgh") == std::vector<Coordinate>{{1, 1}});
+}
+
+TEST_CASE("Grid.logicalLines", "[grid]")
+{
+    auto grid = Grid(Size{4, 2}, false, 10);
+    auto const writeLine = [&](std::string_view _text, bool _wrapped) {
+        grid.lineAt(1).setText(_text);
+        grid.lineAt(1).setWrapped(_wrapped);
+        grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 2}, {1, 4}});
+    };
+    auto const logicalLine = [&](int _line) {
+        auto const logicalLine = grid.logicalLineAt(_line);
+        return std::pair{logicalLine.first, logicalLine.count};
+    };
+
+    writeLine("head", false);
+    writeLine("xxxx", false);
+    for (auto const text : {"xxxx", "xxxx", "xxxx", "xxAB", "CDxx", "xxxx", "xxxx"})
+        writeLine(text, true);
+    grid.lineAt(1).setText("xxxx");
+    grid.lineAt(1).setWrapped(true);
+    REQUIRE(grid.historyLineCount() == 9);
+
+    // Logical lines continue from the history onto the main page.
+    CHECK(logicalLine(0) == std::pair{0, 1});
+    CHECK(logicalLine(1) == std::pair{1, 9});
+    CHECK(logicalLine(4) == std::pair{1, 9});
+    CHECK(logicalLine(9) == std::pair{1, 9});
+    CHECK(logicalLine(10) == std::pair{10, 1});
+    CHECK(grid.computeRelativeLineNumberFromBottom(1) == 2);
+    CHECK(grid.computeRelativeLineNumberFromBottom(2) == -7);
+    CHECK(grid.computeRelativeLineNumberFromBottom(3) == -8);
+
+    CHECK(grid.logicalLineText(grid.logicalLineAt(5)) == "xxxxxxxxxxxxxxxxxxABCDxxxxxxxxxxxxxx");
+    CHECK(grid.search("ABCD") == std::vector<Coordinate>{{5, 3}});
+    CHECK(grid.search("xABC") == std::vector<Coordinate>{{5, 2}});
+    CHECK(grid.search("AB") == std::vector<Coordinate>{{5, 3}});
+
+    // Lines dropped off the history shorten the logical line they belonged to.
+    writeLine("tail", false);
+    for (int i = 0; i < 4; ++i)
+        writeLine("zzzz", false);
+    REQUIRE(grid.historyLineCount() == 10);
+    REQUIRE(grid.renderTextLineAbsolute(0) == "xxxx");
+    CHECK(logicalLine(2) == std::pair{0, 5});
+    CHECK(logicalLine(5) == std::pair{5, 1});
+    CHECK(grid.search("ABCD") == std::vector<Coordinate>{{1, 3}});
+}
+
+TEST_CASE("SearchSnapshot.search", "[grid]")
+{
+    auto snapshot = SearchSnapshot{};
+    auto const lineCount = 3 * SearchSnapshot::MinWorkerLineCount;
+    for (int i = 0; i < lineCount; ++i)
+        snapshot.append(fmt::format("{:05} ", i), {0, 1, 2, 3, 4, 5});
+
+    // A combining character makes up a cell with two codepoints.
+    snapshot.append("e\u0301e\u0301 1\u0301", {0, 3, 6, 7});
+
+    auto const regex = std::regex("0123[0-9]|e\u0301 |1\u0301");
+    auto const expected = std::vector<SearchMatch>{
+        {1230 + 0, 1, 5},
+        {1230 + 1, 1, 5},
+        {1230 + 2, 1, 5},
+        {1230 + 3, 1, 5},
+        {1230 + 4, 1, 5},
+        {1230 + 5, 1, 5},
+        {1230 + 6, 1, 5},
+        {1230 + 7, 1, 5},
+        {1230 + 8, 1, 5},
+        {1230 + 9, 1, 5},
+        {lineCount, 2, 3},
+        {lineCount, 4, 4},
+    };
+    CHECK(snapshot.search(regex) == expected);
+
+    auto streamed = std::vector<SearchMatch>{};
+    auto batchCount = 0;
+    snapshot.search(regex, [&](std::vector<SearchMatch> const& _matches) {
+        CHECK(std::is_sorted(_matches.begin(), _matches.end()));
+        streamed.insert(streamed.end(), _matches.begin(), _matches.end());
+        ++batchCount;
+    });
+    std::sort(streamed.begin(), streamed.end());
+    CHECK(streamed == expected);
+    CHECK(batchCount >= 2);
+}
+
+TEST_CASE("Grid.markedLines", "[grid]")
+{
+    auto grid = Grid(Size{4, 2}, false, 100);
+    auto const writeLines = [&](int _first, int _count) {
+        for (int i = _first; i < _first + _count; ++i)
+        {
+            grid.lineAt(1).setText(fmt::format("{:04}", i));
+            grid.lineAt(1).setMarked(i % 10 == 0);
+            grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 2}, {1, 4}});
+        }
+    };
+
+    writeLines(0, 50);
+    REQUIRE(grid.historyLineCount() == 50);
+    CHECK(grid.previousMarkedLine(0) == std::nullopt);
+    CHECK(grid.previousMarkedLine(25) == 20);
+    CHECK(grid.previousMarkedLine(20) == 10);
+    CHECK(grid.nextMarkedLine(20) == 30);
+    CHECK(grid.nextMarkedLine(40) == std::nullopt);
+
+    // Marks on the main page are found, too.
+    grid.lineAt(2).setMarked(true);
+    CHECK(grid.nextMarkedLine(40) == 51);
+    CHECK(grid.previousMarkedLine(100) == 51);
+    grid.lineAt(2).setMarked(false);
+
+    // Lines dropped off the history renumber the remaining marks.
+    writeLines(50, 100);
+    REQUIRE(grid.historyLineCount() == 100);
+    CHECK(grid.renderTextLineAbsolute(0) == "0050");
+    CHECK(grid.previousMarkedLine(5) == 0);
+    CHECK(grid.nextMarkedLine(0) == 10);
+    CHECK(grid.previousMarkedLine(102) == 90);
+
+    grid.clearHistory();
+    CHECK(grid.previousMarkedLine(2) == std::nullopt);
+}
+
+TEST_CASE("Grid.markedLines.reflow", "[grid]")
+{
+    auto grid = Grid(Size{4, 1}, true, 100);
+    for (auto const text : {"abcd", "efgh", "ijkl"})
+    {
+        grid.lineAt(1).setText(text);
+        grid.lineAt(1).setMarked(text[0] != 'a');
+        grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 4}});
+    }
+    REQUIRE(grid.nextMarkedLine(0) == 1);
+
+    (void) grid.resize(Size{2, 1}, Coordinate{1, 1}, false);
+    REQUIRE(grid.renderTextLineAbsolute(2) == "ef");
+
+    // Wrapped lines inherit the mark of the line they continue.
+    CHECK(grid.nextMarkedLine(0) == 2);
+    CHECK(grid.nextMarkedLine(2) == 3);
+    CHECK(grid.previousMarkedLine(4) == 3);
+    CHECK(grid.previousMarkedLine(2) == std::nullopt);
+}
+
+namespace
+{
+    Lines reflowed(std::vector<Line> _lines, int _columnCount)
+    {
+        auto sourceLines = Lines();
+        for (Line& line : _lines)
+            sourceLines.emplace_back(std::move(line));
+
+        auto targetLines = Lines();
+        reflow(targetLines, crispy::range(sourceLines.begin(), sourceLines.end()), _columnCount);
+        return targetLines;
+    }
+}
+
+TEST_CASE("reflow.unwrappable", "[grid]")
+{
+    auto const lines = reflowed({Line(5, "ABCDE"sv, Line::Flags::None)}, 3);
+
+    REQUIRE(lines.size() == 1);
+    CHECK(!lines[0].wrapped());
+    CHECK(lines[0].size() == 3);
+    CHECK(lines[0].toUtf8() == "ABC");
+}
+
+TEST_CASE("reflow.wrappable", "[grid]")
+{
+    auto const lines = reflowed({Line(5, "ABCDE"sv, Line::Flags::Wrappable)}, 3);
+
+    REQUIRE(lines.size() == 2);
+    CHECK(!lines[0].wrapped());
+    CHECK(lines[0].toUtf8() == "ABC");
+    CHECK(lines[1].wrapped());
+    CHECK(lines[1].wrappable());
+    CHECK(lines[1].size() == 3);
+    CHECK(lines[1].toUtf8() == "DE ");
+}
+
+TEST_CASE("reflow.empty", "[grid]")
+{
+    auto const lines = reflowed({Line(5, Cell{}, Line::Flags::Wrappable)}, 3);
+
+    REQUIRE(lines.size() == 1);
+    CHECK(!lines[0].wrapped());
+    CHECK(lines[0].size() == 3);
+    CHECK(lines[0].toUtf8() == "   ");
+}
+
+TEST_CASE("reflow.inPlace", "[grid]")
+{
+    auto const logicalLine = [](std::vector<std::string_view> _texts) {
+        auto lines = std::vector<Line>{};
+        for (auto const text : _texts)
+        {
+            auto const flags = lines.empty() ? Line::Flags::Wrappable : Line::Flags::Wrappable | Line::Flags::Wrapped;
+            lines.emplace_back(static_cast<int>(_texts.front().size()), text, flags);
+        }
+        return lines;
+    };
+
+    // Shrinking moves the cells back to front, into the lines' own buffers and new ones.
+    auto const shrunk = reflowed(logicalLine({"ABCDE", "FGH"}), 3);
+    REQUIRE(shrunk.size() == 3);
+    CHECK(shrunk[0].toUtf8() == "ABC");
+    CHECK(shrunk[1].toUtf8() == "DEF");
+    CHECK(shrunk[2].toUtf8() == "GH ");
+    CHECK(!shrunk[0].wrapped());
+    CHECK(shrunk[1].wrapped());
+    CHECK(shrunk[2].wrapped());
+
+    // Growing moves the cells front to back, dropping the lines no longer needed.
+    auto const grown = reflowed(logicalLine({"AB", "CD", "EF", "G"}), 5);
+    REQUIRE(grown.size() == 2);
+    CHECK(grown[0].toUtf8() == "ABCDE");
+    CHECK(grown[1].toUtf8() == "FG   ");
+    CHECK(grown[1].wrapped());
+
+    // Blanks within a logical line are kept, whereas the trailing ones are not wrapped.
+    auto const spaced = reflowed(logicalLine({"A C ", "E"}), 3);
+    REQUIRE(spaced.size() == 2);
+    CHECK(spaced[0].toUtf8() == "A C");
+    CHECK(spaced[1].toUtf8() == " E ");
+}
+
+TEST_CASE("reflow.mixedWidths", "[grid]")
+{
+    auto lines = std::vector<Line>{};
+    lines.emplace_back(2, "AB"sv, Line::Flags::Wrappable);
+    lines.emplace_back(6, "CDEFGH"sv, Line::Flags::Wrappable | Line::Flags::Wrapped);
+    lines.emplace_back(2, "IJ"sv, Line::Flags::Wrappable | Line::Flags::Wrapped);
+    lines.emplace_back(2, "KL"sv, Line::Flags::Wrappable | Line::Flags::Wrapped);
+
+    // The lines neither all start before nor all after their reflowed position.
+    auto const reflowedLines = reflowed(std::move(lines), 3);
+    REQUIRE(reflowedLines.size() == 4);
+    CHECK(reflowedLines[0].toUtf8() == "ABC");
+    CHECK(reflowedLines[1].toUtf8() == "DEF");
+    CHECK(reflowedLines[2].toUtf8() == "GHI");
+    CHECK(reflowedLines[3].toUtf8() == "JKL");
+}
+
+TEST_CASE("Line.resize.compressed", "[grid]")
+{
+    auto line = Line(8, "ABC"sv, Line::Flags::Wrappable);
+    REQUIRE(line.compress());
+    CHECK(line.usedColumns() == 3);
+
+    // Only the trailing blanks are affected, so the line is kept compressed.
+    line.resize(4);
+    CHECK(line.compressed());
+    CHECK(line.size() == 4);
+    line.resize(12);
+    CHECK(line.compressed());
+    CHECK(line.size() == 12);
+    CHECK(line.toUtf8() == "ABC         ");
+
+    line.resize(2);
+    CHECK(!line.compressed());
+    CHECK(line.toUtf8() == "AB");
+}
+
+TEST_CASE("Line.share", "[grid]")
+{
+    auto table = Line::SharedCellsTable{};
+    auto a = Line(10, "abc"sv, Line::Flags::None);
+    auto b = Line(12, "abc"sv, Line::Flags::None);
+    auto c = Line(10, "abd"sv, Line::Flags::None);
+
+    // Uncompressed lines only share cells listed already.
+    CHECK_FALSE(b.share(table));
+    CHECK_FALSE(b.compressed());
+
+    REQUIRE(a.compress());
+    CHECK(a.share(table));
+    CHECK(table.size() == 1);
+
+    // Trailing blanks are not part of the shared cells.
+    CHECK(b.share(table));
+    CHECK(b.compressed());
+    CHECK(b.size() == 12);
+    CHECK(b.toUtf8() == "abc         ");
+    CHECK(a.memoryFootprint() < Line(a).memoryFootprint() + sizeof(Line));
+
+    CHECK_FALSE(c.share(table));
+    CHECK_FALSE(c.compressed());
+
+    // Writing to a line leaves the ones it has shared its cells with untouched.
+    b[0].setCharacter('x');
+    CHECK(b.toUtf8() == "xbc         ");
+    CHECK(a.toUtf8() == "abc       ");
+    CHECK(a.compressed());
+}
+
+TEST_CASE("Line.reserveColumns", "[grid]")
+{
+    // Blank lines are not allocated before being accessed, but then with the reserved capacity.
+    auto line = Line(8, DefaultGraphicsAttributesId, Line::Flags::None);
+    line.reserveColumns(16);
+    CHECK(line.buffer().size() == 8);
+    CHECK(line.buffer().capacity() >= 16);
+
+    auto const cells = line.buffer().data();
+    line.resize(16);
+    line.resize(4);
+    line.resize(12);
+    CHECK(line.buffer().data() == cells);
+}
+
+TEST_CASE("Line.detectedLinks", "[grid]")
+{
+    auto line = Line(30, "see https://a.b/ or /etc/x"sv, Line::Flags::None);
+    CHECK_FALSE(line.linksDetected());
+    CHECK(line.detectedLinks() == std::vector<DetectedLink>{DetectedLink{5, 16}, DetectedLink{21, 26}});
+    CHECK(line.linksDetected());
+
+    // Links are detected again once the line has been modified.
+    line[3].setCharacter('+');
+    line.setGeneration(line.generation() + 1);
+    CHECK_FALSE(line.linksDetected());
+    CHECK(line.detectedLinks() == std::vector<DetectedLink>{DetectedLink{1, 16}, DetectedLink{21, 26}});
+
+    line.setText("~/a ");
+    CHECK(line.detectedLinks()
+          == std::vector<DetectedLink>{DetectedLink{1, 3}, DetectedLink{5, 16}, DetectedLink{21, 26}});
+
+    line.reset(DefaultGraphicsAttributesId);
+    CHECK(line.detectedLinks().empty());
+}
+
+TEST_CASE("Grid.resize.columnCapacity", "[grid]")
+{
+    // Resizing back and forth between two widths keeps the cells of the main page lines in place.
+    for (bool const reflow: {false, true})
+    {
+        auto grid = Grid(Size{20, 2}, reflow, std::nullopt);
+        grid.lineAt(1).setText("ABCDEFGHIJKLMNOPQRST");
+        grid.lineAt(2).setText("abc");
+
+        (void) grid.resize(Size{40, 2}, Coordinate{1, 1}, false);
+        auto const cells = grid.lineAt(1).buffer().data();
+        CHECK(grid.lineAt(1).buffer().capacity() >= 40);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            (void) grid.resize(Size{20, 2}, Coordinate{1, 1}, false);
+            (void) grid.resize(Size{40, 2}, Coordinate{1, 1}, false);
+            CHECK(grid.lineAt(1).buffer().data() == cells);
+        }
+        CHECK(grid.renderTextLine(1) == "ABCDEFGHIJKLMNOPQRST                    ");
+        CHECK(grid.renderTextLine(2) == "abc                                     ");
+    }
 }
 
 TEST_CASE("Grid.reflow.shrink.wrappable", "[grid]")
@@ -303,6 +1407,71 @@ TEST_CASE("Grid.reflow.shrink_many_grow_many", "[grid]")
     }
 }
 
+TEST_CASE("Grid.reflow.lazy", "[grid]")
+{
+    auto const setupGrid = []() {
+        auto grid = Grid(Size{4, 1}, true, std::nullopt);
+        for (int i = 0; i < 1200; ++i)
+        {
+            grid.lineAt(1).setText(fmt::format("{:04}", i));
+            grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 4}});
+        }
+        return grid;
+    };
+
+    auto grid = setupGrid();
+    REQUIRE(grid.historyLineCount() == 1200);
+
+    // Only the main page and the page of history above it are reflowed right away.
+    (void) grid.resize(Size{2, 1}, Coordinate{1, 1}, false);
+    CHECK(grid.pendingReflowLineCount() == 1199);
+    CHECK(grid.absoluteLineAt(0).size() == 4);
+    CHECK(grid.absoluteLineAt(1199).size() == 2);
+    CHECK(grid.renderTextLine(0) == "99");
+    CHECK(grid.renderTextLine(-1) == "11");
+
+    // Lines still pending are not reflowed more than once.
+    (void) grid.resize(Size{3, 1}, Coordinate{1, 1}, false);
+    CHECK(grid.pendingReflowLineCount() >= 1199);
+    CHECK(grid.absoluteLineAt(0).size() == 4);
+
+    auto reference = setupGrid();
+    (void) reference.resize(Size{3, 1}, Coordinate{1, 1}, false);
+    (void) reference.reflowHistory();
+
+    CHECK(grid.reflowHistory(100) > 0);
+    CHECK(grid.pendingReflowLineCount() > 0);
+    (void) grid.reflowHistory();
+    CHECK(grid.pendingReflowLineCount() == 0);
+
+    CHECK(grid.historyLineCount() == reference.historyLineCount());
+    CHECK(grid.renderAllText() == reference.renderAllText());
+    CHECK(grid.renderTextLineAbsolute(0) == "000");
+    CHECK(grid.renderTextLineAbsolute(1) == "0  ");
+}
+
+TEST_CASE("Grid.reflow.chunked", "[grid]")
+{
+    // Enough logical lines to be reflowed in multiple chunks, each spanning two lines.
+    auto grid = Grid(Size{4, 1}, true, std::nullopt);
+    for (int i = 0; i < 6000; ++i)
+    {
+        grid.lineAt(1).setText(fmt::format("{:04}", i));
+        grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 4}});
+        grid.lineAt(1).setText("abcd");
+        grid.lineAt(1).setWrapped(true);
+        grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 4}});
+    }
+    REQUIRE(grid.historyLineCount() == 12000);
+
+    (void) grid.resize(Size{8, 1}, Coordinate{1, 1}, false);
+    (void) grid.reflowHistory();
+
+    REQUIRE(grid.historyLineCount() == 6000);
+    for (int i = 0; i < 6000; ++i)
+        CHECK(grid.renderTextLineAbsolute(i) == fmt::format("{:04}abcd", i));
+}
+
 TEST_CASE("Grid.reflow.tripple", "[grid]")
 {
     // Tests reflowing text upon shrink/grow across more than two (e.g. three) wrapped lines.
@@ -440,3 +1609,34 @@ TEST_CASE("Grid.reflow.tripple", "[grid]")
         // }}}
     }
 }
+
+TEST_CASE("ImagePool.compressUnusedImages", "[grid]")
+{
+    auto pool = ImagePool{};
+    auto const imageSize = Size{16, 16};
+    auto data = Image::Data(16 * 16 * 4);
+    for (size_t i = 0; i < data.size(); i += 4)
+        data[i] = (i / 64) % 2 ? 0xFF : 0x00; // stripes
+    auto const image = pool.create(ImageFormat::RGBA, imageSize, Image::Data(data));
+    REQUIRE(pool.imageBytes() == data.size());
+
+    // Recently used images are left alone.
+    CHECK(pool.compressUnusedImages(Image::Clock::now() - std::chrono::seconds(60)) == 0);
+    CHECK_FALSE(image->compressed());
+
+    // So are those whose pixels are in use.
+    {
+        auto const pixels = image->pixels();
+        CHECK(pool.compressUnusedImages(Image::Clock::now() + std::chrono::seconds(1)) == 0);
+    }
+
+    CHECK(pool.compressUnusedImages(Image::Clock::now() + std::chrono::seconds(1)) != 0);
+    CHECK(image->compressed());
+    CHECK(pool.imageBytes() < data.size());
+
+    // Accessing the pixels decompresses them again.
+    auto const pixels = image->pixels();
+    REQUIRE(pixels.data.size() == data.size());
+    CHECK(std::equal(pixels.data.begin(), pixels.data.end(), data.begin()));
+    CHECK(pool.imageBytes() > data.size());
+}
@@ -0,0 +1,158 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/HistoryPrefetcher.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using std::clamp;
+using std::future_status;
+using std::make_shared;
+using std::max;
+using std::move;
+
+namespace terminal {
+
+HistoryPrefetcher::~HistoryPrefetcher()
+{
+    clear();
+}
+
+bool HistoryPrefetcher::Page::ready() const
+{
+    return !restored.valid() || restored.wait_for(std::chrono::seconds(0)) == future_status::ready;
+}
+
+void HistoryPrefetcher::update(Grid& _grid, int _top, int _height, double _velocity)
+{
+    // Lines are counted including the ones dropped off the history, for the pages to keep
+    // referring to the same lines as these are being dropped.
+    auto const dropped = static_cast<int64_t>(_grid.droppedLineCount());
+    auto const historyLines = static_cast<int64_t>(_grid.historyLineCount());
+    if (_top < 0 || _top >= historyLines)
+    {
+        clear();
+        return;
+    }
+
+    auto const top = dropped + _top;
+    auto const bottom = dropped + clamp(static_cast<int64_t>(_top) + _height, int64_t(_top) + 1, historyLines);
+    auto const firstVisible = top / PageSize;
+    auto const lastVisible = (bottom - 1) / PageSize;
+
+    // {{{ pages to keep: the ones in view, and the ones ahead of the viewport
+    auto const ahead = clamp(static_cast<int64_t>(std::ceil(std::abs(_velocity) * LookAheadTime / PageSize)),
+                             int64_t(1),
+                             int64_t(MaxPages));
+    auto const firstPage = max(dropped / PageSize, _velocity > 0 ? firstVisible : firstVisible - ahead);
+    auto const lastPage = std::min((dropped + historyLines - 1) / PageSize,
+                                   _velocity < 0 ? lastVisible : lastVisible + ahead);
+
+    pages_.erase(std::remove_if(pages_.begin(), pages_.end(), [&](Page const& _page) {
+        auto const page = static_cast<int64_t>(_page.first) / PageSize;
+        if (firstPage <= page && page <= lastPage)
+            return false;
+        _page.token.cancel();
+        return true;
+    }), pages_.end());
+    // }}}
+
+    // {{{ hand the restored pages in view over to their lines
+    for (Page& page: pages_)
+    {
+        auto const index = static_cast<int64_t>(page.first) / PageSize;
+        if (index < firstVisible || lastVisible < index || page.lines->empty() || !page.ready())
+            continue;
+
+        for (auto& [offset, cells]: *page.lines)
+        {
+            auto const line = static_cast<int64_t>(page.first) + offset - dropped;
+            if (0 <= line && line < historyLines && _grid.absoluteLineAt(static_cast<int>(line)).adopt(cells))
+                ++adoptedLineCount_;
+        }
+        page.lines->clear();
+    }
+    // }}}
+
+    // {{{ restore the pages about to come into view, the nearest ones first
+    // The pages in view are not, as their lines are being accessed right away.
+    auto const schedule = [&](int64_t _page) {
+        if (static_cast<int>(pages_.size()) >= MaxPages)
+            return;
+        auto const first = static_cast<uint64_t>(_page * PageSize);
+        auto const known = std::any_of(pages_.begin(), pages_.end(),
+                                       [&](Page const& _known) { return _known.first == first; });
+        if (!known)
+            pages_.emplace_back(prefetch(_grid, first));
+    };
+    for (int64_t i = 1; i <= ahead; ++i)
+    {
+        if (_velocity >= 0 && lastVisible + i <= lastPage)
+            schedule(lastVisible + i);
+        if (_velocity <= 0 && firstVisible - i >= firstPage)
+            schedule(firstVisible - i);
+    }
+    // }}}
+}
+
+HistoryPrefetcher::Page HistoryPrefetcher::prefetch(Grid const& _grid, uint64_t _first) const
+{
+    auto page = Page{_first, make_shared<PageLines>(), {}, {}};
+
+    auto const dropped = _grid.droppedLineCount();
+    auto const historyLines = static_cast<uint64_t>(_grid.historyLineCount());
+    for (int offset = 0; offset < PageSize; ++offset)
+    {
+        auto const line = _first + static_cast<uint64_t>(offset);
+        if (line < dropped || line - dropped >= historyLines)
+            continue;
+        if (auto cells = _grid.absoluteLineAt(static_cast<int>(line - dropped)).prefetch(); cells)
+            page.lines->emplace_back(offset, move(*cells));
+    }
+
+    // Pages without compressed lines are kept nonetheless, for them not to be searched again.
+    if (page.lines->empty())
+        return page;
+
+    page.restored = crispy::thread_pool::shared().submit(
+        [lines = page.lines, token = page.token]() {
+            for (auto& line: *lines)
+            {
+                if (token.cancelled())
+                    return;
+                line.second.restore();
+            }
+        },
+        crispy::task_options{ crispy::task_priority::normal, 0, page.token }
+    );
+    return page;
+}
+
+void HistoryPrefetcher::clear()
+{
+    // Pages still being restored keep their lines alive until done with them.
+    for (Page const& page: pages_)
+        page.token.cancel();
+    pages_.clear();
+}
+
+void HistoryPrefetcher::wait() const
+{
+    for (Page const& page: pages_)
+        if (page.restored.valid())
+            page.restored.wait();
+}
+
+}
@@ -0,0 +1,87 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/Grid.h>
+
+#include <crispy/thread_pool.h>
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace terminal {
+
+/// Restores the compressed and spilled history lines the viewport is about to show ahead of
+/// time, on crispy::thread_pool::shared(), so that scrolling through cold history does not
+/// stall on restoring each line as it comes into view.
+///
+/// The history is split into pages of PageSize lines. The pages ahead of the viewport, in the
+/// direction and as far as it is being scrolled, are restored in the background and kept until
+/// they come into view, when their lines take over the restored cells (see Line::adopt()).
+/// Lines accessed before their page has been restored are restored as usual.
+class HistoryPrefetcher {
+  public:
+    static constexpr int PageSize = 64;
+
+    /// Most pages kept at once, including the ones in view.
+    static constexpr int MaxPages = 8;
+
+    /// Seconds of scrolling at the current velocity the pages ahead of the viewport cover.
+    static constexpr double LookAheadTime = 0.5;
+
+    HistoryPrefetcher() = default;
+    HistoryPrefetcher(HistoryPrefetcher const&) = delete;
+    HistoryPrefetcher& operator=(HistoryPrefetcher const&) = delete;
+    ~HistoryPrefetcher();
+
+    /// Hands the restored pages in view over to their lines and prefetches the pages around
+    /// the viewport showing @p _height lines of @p _grid from absolute line @p _top on,
+    /// while being scrolled by @p _velocity lines per second (see Viewport::scrollVelocity()).
+    ///
+    /// Must be invoked with the grid locked, as are all other accesses to it.
+    void update(Grid& _grid, int _top, int _height, double _velocity);
+
+    /// Drops all pages, e.g. as the viewport returned to the main page.
+    void clear();
+
+    /// Waits for the pages being restored to be done.
+    void wait() const;
+
+    int pageCount() const noexcept { return static_cast<int>(pages_.size()); }
+
+    /// Number of lines that took over cells restored ahead of time.
+    uint64_t adoptedLineCount() const noexcept { return adoptedLineCount_; }
+
+  private:
+    using PageLines = std::vector<std::pair<int, Line::PrefetchedCells>>;
+
+    struct Page {
+        uint64_t first;                     // line number counting dropped lines, see Grid::droppedLineCount()
+        std::shared_ptr<PageLines> lines;   // compressed lines by their offset into the page
+        std::future<void> restored;         // invalid if there is nothing to restore
+        crispy::cancellation_token token;
+
+        bool ready() const;
+    };
+
+    Page prefetch(Grid const& _grid, uint64_t _first) const;
+
+    std::vector<Page> pages_;
+    uint64_t adoptedLineCount_ = 0;
+};
+
+}
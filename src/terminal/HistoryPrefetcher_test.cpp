@@ -0,0 +1,89 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/HistoryPrefetcher.h>
+
+#include <catch2/catch.hpp>
+
+#include <fmt/format.h>
+
+using crispy::Size;
+
+using terminal::GraphicsAttributes;
+using terminal::Grid;
+using terminal::HistoryPrefetcher;
+using terminal::Margin;
+
+namespace {
+
+void writeHistory(Grid& _grid, int _lineCount)
+{
+    _grid.setHistoryCompressionThreshold(2);
+    for (int i = 0; i < _lineCount; ++i)
+    {
+        _grid.lineAt(1).setText(fmt::format("{:04}", i));
+        _grid.scrollUp(1, GraphicsAttributes{}, Margin{{1, 1}, {1, 4}});
+    }
+}
+
+}
+
+TEST_CASE("HistoryPrefetcher.scrollingDown", "[history]")
+{
+    auto constexpr PageSize = HistoryPrefetcher::PageSize;
+    auto grid = Grid(Size{4, 1}, false, std::nullopt);
+    writeHistory(grid, 4 * PageSize);
+    auto prefetcher = HistoryPrefetcher{};
+
+    prefetcher.update(grid, 0, 1, 10.0);
+    prefetcher.wait();
+
+    // Only the page ahead is restored, leaving its lines compressed until it comes into view.
+    CHECK(prefetcher.pageCount() == 1);
+    CHECK(grid.absoluteLineAt(PageSize).compressed());
+
+    // A line accessed in between keeps what it has been restored to.
+    CHECK(grid.renderTextLineAbsolute(PageSize + 1) == fmt::format("{:04}", PageSize + 1));
+
+    prefetcher.update(grid, PageSize, 1, 10.0);
+    CHECK(prefetcher.adoptedLineCount() == PageSize - 1);
+    for (int i = PageSize; i < 2 * PageSize; ++i)
+    {
+        CHECK_FALSE(grid.absoluteLineAt(i).compressed());
+        CHECK(grid.renderTextLineAbsolute(i) == fmt::format("{:04}", i));
+    }
+}
+
+TEST_CASE("HistoryPrefetcher.scrollingUp", "[history]")
+{
+    auto constexpr PageSize = HistoryPrefetcher::PageSize;
+    auto grid = Grid(Size{4, 1}, false, std::nullopt);
+    writeHistory(grid, 4 * PageSize);
+    auto prefetcher = HistoryPrefetcher{};
+
+    // Scrolling fast looks further ahead, in the direction being scrolled to only.
+    prefetcher.update(grid, 3 * PageSize, 1, -8.0 * PageSize);
+    prefetcher.wait();
+    CHECK(prefetcher.pageCount() == 3);
+
+    // Lines modified in between are left alone.
+    grid.absoluteLineAt(10).setText("xxxx");
+
+    prefetcher.update(grid, 0, PageSize, -8.0 * PageSize);
+    CHECK(prefetcher.adoptedLineCount() == PageSize - 1);
+    CHECK(grid.renderTextLineAbsolute(10) == "xxxx");
+    CHECK(grid.renderTextLineAbsolute(11) == "0011");
+
+    prefetcher.clear();
+    CHECK(prefetcher.pageCount() == 0);
+}
@@ -0,0 +1,85 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/Hyperlink.h>
+
+#include <crispy/memory_usage.h>
+
+using std::nullopt;
+using std::optional;
+using std::string;
+using std::vector;
+
+namespace terminal {
+
+HyperlinkTable::HyperlinkTable() :
+    entries_(1) // NoHyperlinkId
+{
+}
+
+optional<HyperlinkId> HyperlinkTable::add(string const& _id, URI const& _uri)
+{
+    if (!_id.empty())
+        if (auto const i = ids_.find(_id); i != ids_.end())
+            return i->second;
+
+    HyperlinkId id = NoHyperlinkId;
+    if (!released_.empty())
+    {
+        id = released_.back();
+        released_.pop_back();
+        entries_[id].emplace(HyperlinkInfo{_id, _uri});
+    }
+    else if (entries_.size() < Capacity)
+    {
+        id = static_cast<HyperlinkId>(entries_.size());
+        entries_.emplace_back(HyperlinkInfo{_id, _uri});
+    }
+    else
+        return nullopt;
+
+    if (!_id.empty())
+        ids_.emplace(_id, id);
+
+    return id;
+}
+
+size_t HyperlinkTable::memoryUsage() const noexcept
+{
+    auto bytes = crispy::allocated_bytes(entries_)
+               + crispy::allocated_bytes(released_)
+               + crispy::hash_table_bytes(ids_);
+    for (auto const& entry: entries_)
+        if (entry.has_value())
+            bytes += crispy::allocated_bytes(entry->id) + crispy::allocated_bytes(entry->uri);
+    for (auto const& entry: ids_)
+        bytes += crispy::allocated_bytes(entry.first);
+    return bytes;
+}
+
+void HyperlinkTable::release(vector<bool> const& _used)
+{
+    for (size_t i = 1; i < entries_.size(); ++i)
+    {
+        if (_used[i] || !entries_[i].has_value())
+            continue;
+
+        if (auto const k = ids_.find(entries_[i]->id); k != ids_.end() && k->second == i)
+            ids_.erase(k);
+
+        entries_[i].reset();
+        released_.push_back(static_cast<HyperlinkId>(i));
+    }
+}
+
+} // end namespace
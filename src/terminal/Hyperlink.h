@@ -13,10 +13,15 @@
  */
 #pragma once
 
-#include <string>
-#include <unordered_map>
+#include <cstdint>
+#include <limits>
 #include <list>
 #include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace terminal {
 
@@ -70,7 +75,57 @@ struct HyperlinkInfo { // TODO: rename to Hyperlink
     }
 };
 
-using HyperlinkRef = std::shared_ptr<HyperlinkInfo>;
+/// Identifies a HyperlinkInfo within a HyperlinkTable.
+using HyperlinkId = uint16_t;
+
+/// Identifier of cells not being part of any hyperlink.
+constexpr HyperlinkId NoHyperlinkId = 0;
+
+/// Holds the hyperlinks of a screen, so that each cell only needs to store a small identifier
+/// rather than sharing ownership of the hyperlink.
+///
+/// Entries are never released individually. Once the table runs full, the owning screen
+/// releases all identifiers no longer referenced by any of its cells, which are then reused.
+class HyperlinkTable {
+  public:
+    static constexpr size_t Capacity = size_t(std::numeric_limits<HyperlinkId>::max()) + 1;
+
+    HyperlinkTable();
+
+    /// Number of identifiers handed out so far, including the released ones.
+    size_t size() const noexcept { return entries_.size(); }
+
+    /// @returns the bytes allocated by this table, including the hyperlinks' texts.
+    size_t memoryUsage() const noexcept;
+
+    /// @returns the hyperlink of the given identifier or nullptr if there is none.
+    HyperlinkInfo* find(HyperlinkId _id) noexcept
+    {
+        return _id < entries_.size() && entries_[_id].has_value() ? &*entries_[_id] : nullptr;
+    }
+
+    HyperlinkInfo const* find(HyperlinkId _id) const noexcept
+    {
+        return const_cast<HyperlinkTable*>(this)->find(_id);
+    }
+
+    /// Adds a new hyperlink, or looks up the existing one if a non-empty @p _id is already known.
+    ///
+    /// @returns the hyperlink's identifier or std::nullopt if the table is full.
+    std::optional<HyperlinkId> add(std::string const& _id, URI const& _uri);
+
+    /// Forgets about all user provided hyperlink IDs, so that they can be reused for new hyperlinks.
+    /// Cells keep referring to their hyperlinks.
+    void forgetIds() { ids_.clear(); }
+
+    /// Releases all hyperlinks whose identifier is not marked in @p _used.
+    void release(std::vector<bool> const& _used);
+
+  private:
+    std::vector<std::optional<HyperlinkInfo>> entries_;
+    std::vector<HyperlinkId> released_;
+    std::unordered_map<std::string, HyperlinkId> ids_;
+};
 
 bool is_local(HyperlinkInfo const& _hyperlink);
 
@@ -13,18 +13,92 @@
  */
 #include <terminal/Image.h>
 
+#include <crispy/qoi.h>
+#include <crispy/thread_pool.h>
+
 #include <algorithm>
 #include <memory>
 
 using crispy::Size;
+using std::clamp;
 using std::copy;
 using std::min;
 using std::move;
+using std::scoped_lock;
 using std::shared_ptr;
+using std::unique_lock;
+using std::weak_ptr;
 
 namespace terminal {
 
+// {{{ Image
+Image::Pixels Image::pixels() const
+{
+    lastUse_.store(Clock::now(), std::memory_order_relaxed);
+    if (storage_)
+        return Pixels{ storage_, storedPixels_ };
+
+    auto _l = scoped_lock{lock_};
+    if (!data_)
+    {
+        auto const start = Clock::now();
+        auto data = Data(dataSize_);
+        crispy::qoi::decode(compressedData_.data(), compressedData_.size(), data.data(), dataSize_ / 4);
+        data_ = std::make_shared<Data const>(move(data));
+        memoryBytes_ = dataSize_ + compressedData_.size();
+        if (pixelCounters_)
+        {
+            pixelCounters_->miss(Clock::now() - start);
+            pixelCounters_->insert();
+        }
+    }
+    else if (pixelCounters_)
+        pixelCounters_->hit();
+    return Pixels{ data_, crispy::span<uint8_t const>(data_->data(), data_->size()) };
+}
+
+size_t Image::compress() const
+{
+    if (storage_ || format_ != ImageFormat::RGBA || dataSize_ != static_cast<size_t>(size_.width) * static_cast<size_t>(size_.height) * 4)
+        return 0;
+
+    auto _l = scoped_lock{lock_};
+    if (!data_ || incompressible_ || data_.use_count() > 1)
+        return 0;
+
+    if (compressedData_.empty())
+    {
+        auto compressed = crispy::qoi::encode(data_->data(), dataSize_ / 4);
+        if (compressed.size() >= dataSize_ / 2)
+        {
+            incompressible_ = true;
+            return 0;
+        }
+        compressedData_ = move(compressed);
+    }
+
+    auto const bytesBefore = memoryBytes_.load();
+    data_.reset();
+    if (pixelCounters_)
+        pixelCounters_->evict();
+    memoryBytes_ = compressedData_.size();
+    return bytesBefore - compressedData_.size();
+}
+
+bool Image::compressed() const
+{
+    auto _l = scoped_lock{lock_};
+    return !data_ && !storage_;
+}
+// }}}
+
+// {{{ RasterizedImage
 Image::Data RasterizedImage::fragment(Coordinate _pos) const
+{
+    return tile(_pos, Size{1, 1});
+}
+
+Image::Data RasterizedImage::tile(Coordinate _pos, Size _cellCount) const
 {
     // TODO: respect alignment hint
     // TODO: respect resize hint
@@ -32,11 +106,13 @@ Image::Data RasterizedImage::fragment(Coordinate _pos) const
     auto const xOffset = _pos.column * cellSize_.width;
     auto const yOffset = _pos.row * cellSize_.height;
     auto const pixelOffset = Coordinate{yOffset, xOffset};
+    auto const width = _cellCount.width * cellSize_.width;
+    auto const height = _cellCount.height * cellSize_.height;
 
     Image::Data fragData;
-    fragData.resize(cellSize_.width * cellSize_.height * 4); // RGBA
-    auto const availableWidth = min(image_->width() - pixelOffset.column, cellSize_.width);
-    auto const availableHeight = min(image_->height() - pixelOffset.row, cellSize_.height);
+    fragData.resize(width * height * 4); // RGBA
+    auto const availableWidth = clamp(image_->width() - pixelOffset.column, 0, width);
+    auto const availableHeight = clamp(image_->height() - pixelOffset.row, 0, height);
 
     // auto const availableSize = Size{availableWidth, availableHeight};
     // std::cout << fmt::format(
@@ -59,10 +135,11 @@ Image::Data RasterizedImage::fragment(Coordinate _pos) const
 
     // TODO: if input format is (RGB | PNG), transform to RGBA
 
+    auto const pixels = image_->pixels();
     auto target = &fragData[0];
 
     // fill horizontal gap at the bottom
-    for (int y = availableHeight * cellSize_.width; y < cellSize_.height * cellSize_.width; ++y)
+    for (int y = availableHeight * width; y < height * width; ++y)
     {
         *target++ = defaultColor_.red();
         *target++ = defaultColor_.green();
@@ -73,11 +150,11 @@ Image::Data RasterizedImage::fragment(Coordinate _pos) const
     for (int y = 0; y < availableHeight; ++y)
     {
         auto const startOffset = ((pixelOffset.row + (availableHeight - 1 - y)) * image_->width() + pixelOffset.column) * 4;
-        auto const source = &image_->data()[startOffset];
+        auto const source = &pixels.data[startOffset];
         target = copy(source, source + availableWidth * 4, target);
 
         // fill vertical gap on right
-        for (int x = availableWidth; x < cellSize_.width; ++x)
+        for (int x = availableWidth; x < width; ++x)
         {
             *target++ = defaultColor_.red();
             *target++ = defaultColor_.green();
@@ -88,13 +165,60 @@ Image::Data RasterizedImage::fragment(Coordinate _pos) const
 
     return fragData;
 }
+// }}}
+
+// {{{ ImagePool
+ImagePool::State::~State()
+{
+    auto _l = unique_lock{lock};
+    decompressed.wait(_l, [this]() { return decompressing == 0; });
+}
+
+shared_ptr<Image const> ImagePool::adopt(Image& _image)
+{
+    _image.pixelCounters_ = &state_->pixelCounters;
+    auto image = shared_ptr<Image const>(&_image, [state = state_.get()](Image const* _released) {
+        state->removeImage(const_cast<Image*>(_released));
+    });
+    state_->imageRefs.emplace(image.get(), image);
+    return image;
+}
 
 shared_ptr<Image const> ImagePool::create(ImageFormat _format, Size _size, Image::Data&& _data)
 {
     // TODO: This operation should be idempotent, i.e. if that image has been created already, return a reference to that.
-    images_.emplace_back(nextImageId_++, _format, move(_data), _size);
-    return shared_ptr<Image>(&images_.back(),
-                             [this](Image* _image) { removeImage(_image); });
+    auto _l = scoped_lock{state_->lock};
+    return adopt(state_->images.emplace_back(state_->nextImageId++, _format, move(_data), _size));
+}
+
+shared_ptr<Image const> ImagePool::create(ImageFormat _format, Size _size,
+                                          shared_ptr<void const> _storage,
+                                          crispy::span<uint8_t const> _pixels)
+{
+    auto _l = scoped_lock{state_->lock};
+    return adopt(state_->images.emplace_back(state_->nextImageId++, _format, move(_storage), _pixels, _size));
+}
+
+shared_ptr<Image const> ImagePool::create(Size _size, Image::CompressedData _compressed)
+{
+    auto _l = unique_lock{state_->lock};
+    auto image = adopt(state_->images.emplace_back(state_->nextImageId++, move(_compressed), _size));
+    ++state_->decompressing;
+    _l.unlock();
+
+    crispy::thread_pool::shared().post(
+        [state = state_.get(), weakImage = weak_ptr<Image const>(image)]() {
+            // Skipped if the image got dropped already, e.g. by a screen clear.
+            if (auto const image = weakImage.lock())
+                image->pixels();
+            auto _l = scoped_lock{state->lock};
+            --state->decompressing;
+            state->decompressed.notify_all();
+        },
+        crispy::task_options{ crispy::task_priority::normal, reinterpret_cast<uintptr_t>(state_.get()) }
+    );
+
+    return image;
 }
 
 shared_ptr<RasterizedImage const> ImagePool::rasterize(shared_ptr<Image const> _image,
@@ -104,28 +228,112 @@ shared_ptr<RasterizedImage const> ImagePool::rasterize(shared_ptr<Image const> _
                                                        Size _cellSpan,
                                                        Size _cellSize)
 {
-    rasterizedImages_.emplace_back(move(_image), _alignmentPolicy, _resizePolicy, _defaultColor, _cellSpan, _cellSize);
-    return shared_ptr<RasterizedImage>(&rasterizedImages_.back(),
-                                       [this](RasterizedImage* _image) { removeRasterizedImage(_image); });
+    auto _l = scoped_lock{state_->lock};
+    auto& rasterizedImage = state_->rasterizedImages.emplace_back(move(_image), _alignmentPolicy, _resizePolicy,
+                                                                  _defaultColor, _cellSpan, _cellSize);
+    return shared_ptr<RasterizedImage>(&rasterizedImage, [state = state_.get()](RasterizedImage* _image) {
+        state->removeRasterizedImage(_image);
+    });
+}
+
+void ImagePool::State::removeImage(Image* _image)
+{
+    auto _l = scoped_lock{lock};
+    if (auto i = find_if(images.begin(),
+                         images.end(),
+                         [&](Image const& p) { return &p == _image; }); i != images.end())
+    {
+        auto const bytes = _image->memoryBytes();
+        if (evicting)
+        {
+            ++evictedImageCount;
+            evictedImageBytes += bytes;
+        }
+        onImageRemove(_image);
+        imageRefs.erase(_image);
+        images.erase(i);
+    }
+}
+
+void ImagePool::evict(std::function<void()> const& _release)
+{
+    {
+        auto _l = scoped_lock{state_->lock};
+        state_->evicting = true;
+    }
+    _release();
+    auto _l = scoped_lock{state_->lock};
+    state_->evicting = false;
+}
+
+size_t ImagePool::imageCount() const
+{
+    auto _l = scoped_lock{state_->lock};
+    return state_->images.size();
 }
 
-void ImagePool::removeImage(Image* _image)
+size_t ImagePool::rasterizedImageCount() const
 {
-    if (auto i = find_if(images_.begin(),
-                         images_.end(),
-                         [&](Image const& p) { return &p == _image; }); i != images_.end())
+    auto _l = scoped_lock{state_->lock};
+    return state_->rasterizedImages.size();
+}
+
+size_t ImagePool::imageBytes() const
+{
+    auto _l = scoped_lock{state_->lock};
+    auto bytes = size_t{0};
+    for (Image const& image: state_->images)
+        bytes += image.memoryBytes();
+    return bytes;
+}
+
+size_t ImagePool::compressUnusedImages(Image::Clock::time_point _unusedSince)
+{
+    auto candidates = std::vector<shared_ptr<Image const>>{};
     {
-        onImageRemove_(_image);
-        images_.erase(i);
+        auto _l = scoped_lock{state_->lock};
+        for (auto const& [image, ref]: state_->imageRefs)
+            if (image->lastUse() < _unusedSince)
+                if (auto candidate = ref.lock())
+                    candidates.emplace_back(move(candidate));
     }
+
+    auto bytes = size_t{0};
+    for (auto const& image: candidates)
+        bytes += image->compress();
+
+    // The last references to the images may be dropped here, removing them from the pool.
+    candidates.clear();
+    return bytes;
+}
+
+uint64_t ImagePool::evictedImageCount() const
+{
+    auto _l = scoped_lock{state_->lock};
+    return state_->evictedImageCount;
+}
+
+uint64_t ImagePool::evictedImageBytes() const
+{
+    auto _l = scoped_lock{state_->lock};
+    return state_->evictedImageBytes;
 }
 
-void ImagePool::removeRasterizedImage(RasterizedImage* _image)
+crispy::cache_stats ImagePool::pixelCacheStats() const
 {
-    if (auto i = find_if(rasterizedImages_.begin(),
-                         rasterizedImages_.end(),
-                         [&](RasterizedImage const& p) { return &p == _image; }); i != rasterizedImages_.end())
-        rasterizedImages_.erase(i);
+    return state_->pixelCounters.stats(imageBytes());
+}
+
+void ImagePool::State::removeRasterizedImage(RasterizedImage* _image)
+{
+    // Destroyed without holding the lock, as this may remove its image from the pool as well.
+    auto removed = std::list<RasterizedImage>{};
+
+    auto _l = scoped_lock{lock};
+    if (auto i = find_if(rasterizedImages.begin(),
+                         rasterizedImages.end(),
+                         [&](RasterizedImage const& p) { return &p == _image; }); i != rasterizedImages.end())
+        removed.splice(removed.end(), rasterizedImages, i);
 }
 
 void ImagePool::link(std::string const& _name, std::shared_ptr<Image const> _imageRef)
@@ -145,5 +353,6 @@ void ImagePool::unlink(std::string const& _name)
 {
     namedImages_.erase(_name);
 }
+// }}}
 
 } // end namespace
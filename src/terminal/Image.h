@@ -15,15 +15,22 @@
 
 #include <terminal/Color.h>
 #include <terminal/Coordinate.h>
+#include <crispy/cache_stats.h>
 #include <crispy/size.h>
+#include <crispy/span.h>
 
 #include <fmt/format.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <functional>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 namespace terminal {
@@ -42,11 +49,26 @@ enum class ImageFormat {
 
 /**
  * Represents an image that can be displayed in the terminal by being placed into the grid cells
+ *
+ * The pixels of RGBA images owned by the image itself may be compressed while not in use
+ * (see compress()), and are decompressed again on next access.
  */
 class Image {
   public:
     using Id = uint64_t; // unique numerical image identifier
     using Data = std::vector<uint8_t>; // raw RGBA data
+    using Clock = std::chrono::steady_clock;
+
+    /// The pixels of an image, kept in memory for as long as this is alive.
+    struct Pixels {
+        std::shared_ptr<void const> owner;
+        crispy::span<uint8_t const> data;
+    };
+
+    /// RGBA pixels compressed by crispy::qoi::encode(), i.e. QOI chunks without header.
+    struct CompressedData {
+        Data chunks;
+    };
 
     /// Constructs an RGBA image.
     ///
@@ -55,8 +77,37 @@ class Image {
     Image(Id _id, ImageFormat _format, Data _data, crispy::Size _pixelSize) :
         id_{ _id },
         format_{ _format },
-        data_{ move(_data) },
-        size_{ _pixelSize }
+        size_{ _pixelSize },
+        dataSize_{ _data.size() },
+        data_{ std::make_shared<Data const>(std::move(_data)) },
+        memoryBytes_{ dataSize_ },
+        lastUse_{ Clock::now() }
+    {}
+
+    /// Constructs an RGBA image whose pixels are kept in memory owned by @p _storage
+    /// (e.g. shared memory mapped from another process) rather than being copied.
+    Image(Id _id, ImageFormat _format, std::shared_ptr<void const> _storage,
+          crispy::span<uint8_t const> _pixels, crispy::Size _pixelSize) :
+        id_{ _id },
+        format_{ _format },
+        size_{ _pixelSize },
+        dataSize_{ _pixels.size() },
+        storage_{ std::move(_storage) },
+        storedPixels_{ _pixels },
+        memoryBytes_{ dataSize_ },
+        lastUse_{ Clock::now() }
+    {}
+
+    /// Constructs an RGBA image from its compressed pixels, which are decompressed
+    /// on first access (see pixels()). Pixels missing in @p _compressed are left transparent.
+    Image(Id _id, CompressedData _compressed, crispy::Size _pixelSize) :
+        id_{ _id },
+        format_{ ImageFormat::RGBA },
+        size_{ _pixelSize },
+        dataSize_{ static_cast<size_t>(_pixelSize.width) * static_cast<size_t>(_pixelSize.height) * 4 },
+        compressedData_{ std::move(_compressed.chunks) },
+        memoryBytes_{ compressedData_.size() },
+        lastUse_{ Clock::now() }
     {}
 
     Image(Image const&) = delete;
@@ -66,16 +117,50 @@ class Image {
 
     constexpr Id id() const noexcept { return id_; }
     constexpr ImageFormat format() const noexcept { return format_; }
-    Data const& data() const noexcept { return data_; }
     constexpr crispy::Size size() const noexcept { return size_; }
     constexpr int width() const noexcept { return size_.width; }
     constexpr int height() const noexcept { return size_.height; }
 
+    /// @returns the pixels, decompressing them first if need be.
+    Pixels pixels() const;
+
+    /// Number of bytes of the pixels, uncompressed.
+    size_t dataSize() const noexcept { return dataSize_; }
+
+    /// Number of bytes of pixel data currently held in memory, compressed or not.
+    size_t memoryBytes() const noexcept { return memoryBytes_.load(std::memory_order_relaxed); }
+
+    /// Point in time the pixels were last accessed.
+    Clock::time_point lastUse() const noexcept { return lastUse_.load(std::memory_order_relaxed); }
+
+    /// Compresses the pixels (see crispy::qoi), unless they are not owned by the image,
+    /// not RGBA, compressed already, or in use by a Pixels object.
+    ///
+    /// Once decompressed, the compressed pixels are kept around,
+    /// so that compressing them again merely releases the uncompressed ones.
+    ///
+    /// @returns the number of bytes released.
+    size_t compress() const;
+
+    bool compressed() const;
+
   private:
+    friend class ImagePool;
+
     Id const id_;
     ImageFormat const format_;
-    Data const data_;
     crispy::Size const size_;
+    size_t const dataSize_;
+    std::shared_ptr<void const> const storage_;
+    crispy::span<uint8_t const> const storedPixels_;    // of storage_, if any
+
+    mutable std::mutex lock_;                           // guards the owned pixels
+    mutable std::shared_ptr<Data const> data_;          // uncompressed, unless compressed only
+    mutable Data compressedData_;
+    mutable bool incompressible_ = false;               // compressing turned out not to pay off
+    mutable std::atomic<size_t> memoryBytes_;
+    mutable std::atomic<Clock::time_point> lastUse_;
+    crispy::cache_counters* pixelCounters_ = nullptr;   // of the pool holding this image, see ImagePool::pixelCacheStats()
 };
 
 /// Image resize hints are used to properly fit/fill the area to place the image onto.
@@ -135,6 +220,10 @@ class RasterizedImage
     /// @returns an RGBA buffer for a grid cell at given coordinate @p _pos of the rasterized image.
     Image::Data fragment(Coordinate _pos) const;
 
+    /// @returns an RGBA buffer for the @p _cellCount grid cells starting at coordinate @p _pos
+    ///          of the rasterized image, with its bottom line of pixels first.
+    Image::Data tile(Coordinate _pos, crispy::Size _cellCount) const;
+
   private:
     std::shared_ptr<Image const> const image_;  //!< Reference to the Image to be rasterized.
     ImageAlignment const alignmentPolicy_;      //!< Alignment policy of the image inside the raster size.
@@ -162,6 +251,7 @@ class ImageFragment {
     ImageFragment& operator=(ImageFragment&&) noexcept = default;
 
     RasterizedImage const& rasterizedImage() const noexcept { return *rasterizedImage_; }
+    std::shared_ptr<RasterizedImage const> const& rasterizedImageRef() const noexcept { return rasterizedImage_; }
 
     /// @returns offset of this image fragment in pixels into the underlying image.
     Coordinate offset() const noexcept { return offset_; }
@@ -194,21 +284,37 @@ inline bool operator<(ImageFragment const& a, ImageFragment const& b) noexcept
 /// Highlevel Image Storage Pool.
 ///
 /// Stores RGBA images in host memory, also taking care of eviction.
+///
+/// The last reference to an image may be released on any thread (e.g. by a renderer's worker),
+/// so that removing images from the pool is synchronized.
 class ImagePool {
   public:
     using OnImageRemove = std::function<void(Image const*)>;
     ImagePool(OnImageRemove _onImageRemove, Image::Id _nextImageId) :
-        nextImageId_{ _nextImageId },
-        images_{},
-        rasterizedImages_{},
-        onImageRemove_{ std::move(_onImageRemove) }
+        state_{ std::make_unique<State>(std::move(_onImageRemove), _nextImageId) }
     {}
 
     ImagePool() : ImagePool([](auto) {}, 1) {}
 
+    ImagePool(ImagePool const&) = delete;
+    ImagePool& operator=(ImagePool const&) = delete;
+    ImagePool(ImagePool&&) noexcept = default;
+    ImagePool& operator=(ImagePool&&) noexcept = default;
+
     /// Creates an RGBA image of given size in pixels.
     std::shared_ptr<Image const> create(ImageFormat _format, crispy::Size _pixelSize, Image::Data&& _data);
 
+    /// Creates an RGBA image of given size in pixels, whose pixels are kept in memory owned by @p _storage.
+    std::shared_ptr<Image const> create(ImageFormat _format, crispy::Size _pixelSize,
+                                        std::shared_ptr<void const> _storage,
+                                        crispy::span<uint8_t const> _pixels);
+
+    /// Creates an RGBA image of given size in pixels from its compressed pixels.
+    ///
+    /// The pixels are decompressed on crispy::thread_pool::shared() right away, so that the caller
+    /// does not wait for them, and yet they are likely ready by the time the image is rendered.
+    std::shared_ptr<Image const> create(crispy::Size _pixelSize, Image::CompressedData _compressed);
+
     /// Rasterizes an Image.
     std::shared_ptr<RasterizedImage const> rasterize(std::shared_ptr<Image const> _image,
                                                      ImageAlignment _alignmentPolicy,
@@ -223,20 +329,76 @@ class ImagePool {
     std::shared_ptr<Image const> findImageByName(std::string const& _name) const;
     void unlink(std::string const& _name);
 
-    size_t imageCount() const noexcept { return images_.size(); }
-    size_t rasterizedImageCount() const noexcept { return rasterizedImages_.size(); }
+    size_t imageCount() const;
+    size_t rasterizedImageCount() const;
     size_t namedImageCount() const noexcept { return namedImages_.size(); }
 
+    /// @returns the number of bytes of image data currently held by the pool, compressed or not.
+    size_t imageBytes() const;
+
+    /// Compresses the pixels of the images not accessed since @p _unusedSince, see Image::compress().
+    ///
+    /// The images are compressed one at a time, without blocking the pool for others.
+    ///
+    /// @returns the number of bytes released.
+    size_t compressUnusedImages(Image::Clock::time_point _unusedSince);
+
+    // memory budget
+    //
+    /// Limits the bytes of image data the pool should hold, or 0 for no limit.
+    ///
+    /// The pool cannot release images still in use by itself. Exceeding the limit is merely
+    /// reported by overBudget(), for the owner to evict images, see evict().
+    void setMemoryLimit(size_t _bytes) noexcept { memoryLimit_ = _bytes; }
+    size_t memoryLimit() const noexcept { return memoryLimit_; }
+    bool overBudget() const { return memoryLimit_ != 0 && imageBytes() > memoryLimit_; }
+
+    /// Invokes @p _release, which is to drop references to images, accounting all images
+    /// it thereby removes from the pool as evicted.
+    void evict(std::function<void()> const& _release);
+
+    /// Number and bytes of images evicted so far.
+    uint64_t evictedImageCount() const;
+    uint64_t evictedImageBytes() const;
+
+    /// @returns how often the pixels of images were found uncompressed when accessed, or had
+    ///          to be decompressed first (see Image::pixels()), along with the bytes of image data held.
+    crispy::cache_stats pixelCacheStats() const;
+
   private:
-    void removeImage(Image* _image);                        //!< Removes given image from pool.
-    void removeRasterizedImage(RasterizedImage* _image);    //!< Removes a rasterized image from pool.
+    std::shared_ptr<Image const> adopt(Image& _image);     //!< Hands out the image just added to the pool.
+
+    /// What the images handed out refer back to, kept in place as the pool gets moved.
+    struct State {
+        State(OnImageRemove _onImageRemove, Image::Id _nextImageId) :
+            nextImageId{ _nextImageId },
+            onImageRemove{ std::move(_onImageRemove) }
+        {}
+
+        /// Waits for the images being decompressed, see create(crispy::Size, Image::CompressedData).
+        ~State();
+
+        void removeImage(Image* _image);                        //!< Removes given image from pool.
+        void removeRasterizedImage(RasterizedImage* _image);    //!< Removes a rasterized image from pool.
+
+        mutable std::mutex lock;                                            //!< guards the pools and their counters
+        Image::Id nextImageId;                                              //!< ID for next image to be put into the pool
+        std::list<Image> images;                                            //!< pool of raw images
+        std::unordered_map<Image const*, std::weak_ptr<Image const>> imageRefs; //!< references handed out per image
+        std::list<RasterizedImage> rasterizedImages;                        //!< pool of rasterized images
+        OnImageRemove const onImageRemove;                                  //!< Callback to be invoked when image gets removed from pool.
+        bool evicting = false;                                              //!< whether removed images are being evicted
+        size_t decompressing = 0;                                           //!< number of images being decompressed in the background
+        std::condition_variable decompressed;                               //!< notified whenever one of them is done
+        uint64_t evictedImageCount = 0;
+        uint64_t evictedImageBytes = 0;
+        crispy::cache_counters pixelCounters;                               //!< see pixelCacheStats()
+    };
 
   private:
-    Image::Id nextImageId_;                                             //!< ID for next image to be put into the pool
-    std::list<Image> images_;                                           //!< pool of raw images
-    std::list<RasterizedImage> rasterizedImages_;                       //!< pool of rasterized images
+    std::unique_ptr<State> state_;
     std::map<std::string, std::shared_ptr<Image const>> namedImages_;   //!< keeps mapping from name to raw image
-    OnImageRemove const onImageRemove_;                                 //!< Callback to be invoked when image gets removed from pool.
+    size_t memoryLimit_ = 0;                                            //!< bytes of image data the pool should hold at most
 };
 
 } // end namespace
@@ -0,0 +1,104 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/ImageTransfer.h>
+#include <terminal/logging.h>
+
+#include <crispy/debuglog.h>
+#include <crispy/qoi.h>
+
+#include <fmt/format.h>
+
+using std::nullopt;
+using std::optional;
+using std::string_view;
+
+namespace terminal {
+
+namespace
+{
+    // The end marker, following the chunks of QOI files.
+    constexpr size_t QoiEndMarkerSize = 8;
+}
+
+void ImageTransfer::pass(string_view _chars)
+{
+    if (failed_)
+        return;
+
+    auto const offset = data_.size();
+    data_.resize(offset + crispy::base64::decodedSizeMax(_chars.size()));
+    data_.resize(offset + base64_.update(_chars, reinterpret_cast<char*>(data_.data() + offset)));
+
+    if (!maxDataSize_ && data_.size() >= crispy::qoi::HeaderSize && !checkHeader())
+        return;
+
+    if (maxDataSize_ && data_.size() > maxDataSize_)
+        fail("more data than the image can have");
+}
+
+optional<ImageTransfer::Result> ImageTransfer::finish()
+{
+    if (failed_)
+        return nullopt;
+
+    auto const offset = data_.size();
+    data_.resize(offset + 2);
+    data_.resize(offset + base64_.finish(reinterpret_cast<char*>(data_.data() + offset)));
+
+    if (!maxDataSize_ && !checkHeader())
+        return nullopt;
+
+    auto const header = crispy::qoi::decodeHeader(data_.data(), data_.size());
+    auto const size = crispy::Size{ static_cast<int>(header->width), static_cast<int>(header->height) };
+    data_.erase(data_.begin(), data_.begin() + crispy::qoi::HeaderSize);
+    return Result{ size, Image::CompressedData{ std::move(data_) } };
+}
+
+bool ImageTransfer::checkHeader()
+{
+    auto const header = crispy::qoi::decodeHeader(data_.data(), data_.size());
+    if (!header)
+    {
+        fail("no QOI image header");
+        return false;
+    }
+
+    if (header->width == 0 || header->height == 0
+        || header->width > static_cast<unsigned>(maxImageSize_.width)
+        || header->height > static_cast<unsigned>(maxImageSize_.height))
+    {
+        fail(fmt::format("image size {}x{} exceeding the limit", header->width, header->height));
+        return false;
+    }
+
+    auto const pixelCount = static_cast<size_t>(header->width) * header->height;
+    maxDataSize_ = crispy::qoi::HeaderSize + crispy::qoi::encodedSizeMax(pixelCount) + QoiEndMarkerSize;
+    return true;
+}
+
+void ImageTransfer::fail(string_view _reason)
+{
+    debuglog(VTParserTag).write("Ignoring image transfer: {}.", _reason);
+    failed_ = true;
+    data_ = Image::Data{};
+}
+
+void ImageTransferParser::pass(char32_t _char)
+{
+    // Anything but US-ASCII is no base64 and thus ends the data, just like invalid ASCII does.
+    auto const ch = _char < 0x80 ? static_cast<char>(_char) : '!';
+    transfer_.pass(string_view(&ch, 1));
+}
+
+} // end namespace
@@ -0,0 +1,96 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/Image.h>
+#include <terminal/ParserExtension.h>
+
+#include <crispy/base64.h>
+#include <crispy/size.h>
+
+#include <functional>
+#include <optional>
+#include <string_view>
+
+namespace terminal {
+
+/// Image formats of IMGXFER, see ImageTransfer.
+enum class ImageTransferFormat {
+    QOI = 1,
+    PNG = 2,    // reserved, not supported as there is no PNG decoder at hand
+};
+
+/// Receives an image file transferred in base64 encoded chunks by IMGXFER:
+///
+///     DCS Pf ; Pm i <base64 data> ST
+///
+/// with Pf being the ImageTransferFormat (default: QOI), and Pm being 1 if more chunks
+/// follow, or 0 (default) for the last one. The chunks are concatenated, so that they may be
+/// split up anywhere, e.g. to fit the size limits of multiplexers.
+///
+/// The chunks are decoded as they arrive rather than collecting their encoded text,
+/// and the transfer is given up as soon as its header reveals an invalid or too large image.
+/// The pixels themselves are not decompressed here, but later by the ImagePool.
+class ImageTransfer {
+  public:
+    /// Received image, of given size in pixels.
+    struct Result {
+        crispy::Size size;
+        Image::CompressedData pixels;
+    };
+
+    explicit ImageTransfer(crispy::Size _maxImageSize): maxImageSize_{ _maxImageSize } {}
+
+    /// Decodes the next characters of a chunk.
+    void pass(std::string_view _chars);
+
+    /// @returns whether the transfer has been given up, ignoring any further chunks.
+    bool failed() const noexcept { return failed_; }
+
+    /// Completes the transfer after its last chunk.
+    ///
+    /// @returns the image, or std::nullopt if the transfer failed or the data received is no image.
+    std::optional<Result> finish();
+
+  private:
+    bool checkHeader();
+    void fail(std::string_view _reason);
+
+    crispy::Size const maxImageSize_;
+    crispy::base64::decoder base64_;
+    Image::Data data_;                  // QOI file received so far
+    size_t maxDataSize_ = 0;            // bytes the QOI file may have, once its header is known
+    bool failed_ = false;
+};
+
+/// Passes one chunk of an IMGXFER sequence on to its ImageTransfer.
+class ImageTransferParser : public ParserExtension
+{
+  public:
+    ImageTransferParser(ImageTransfer& _transfer, std::function<void()> _done):
+        transfer_{ _transfer },
+        done_{ std::move(_done) }
+    {}
+
+    void start() override {}
+    void pass(char32_t _char) override;
+    void pass(std::string_view _chars) override { transfer_.pass(_chars); }
+    void finalize() override { done_(); }
+
+  private:
+    ImageTransfer& transfer_;
+    std::function<void()> done_;
+};
+
+} // end namespace
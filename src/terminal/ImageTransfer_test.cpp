@@ -0,0 +1,180 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/ImageTransfer.h>
+#include <terminal/Screen.h>
+
+#include <crispy/base64.h>
+#include <crispy/qoi.h>
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+using crispy::Size;
+using std::string;
+using std::string_view;
+using std::vector;
+using namespace terminal;
+
+namespace
+{
+    /// A gradient of RGBA pixels, compressing well in some places and not so well in others.
+    vector<uint8_t> gradient(Size _size)
+    {
+        auto pixels = vector<uint8_t>();
+        for (int y = 0; y < _size.height; ++y)
+            for (int x = 0; x < _size.width; ++x)
+            {
+                pixels.push_back(static_cast<uint8_t>(x * 7));
+                pixels.push_back(static_cast<uint8_t>(y * 3));
+                pixels.push_back(x < _size.width / 2 ? 32 : static_cast<uint8_t>(x * y));
+                pixels.push_back(255);
+            }
+        return pixels;
+    }
+
+    /// @returns @p _pixels as base64 encoded QOI file.
+    string qoiFile(Size _size, vector<uint8_t> const& _pixels)
+    {
+        auto file = string(crispy::qoi::HeaderSize, '\0');
+        auto const header = crispy::qoi::header{ static_cast<uint32_t>(_size.width), static_cast<uint32_t>(_size.height) };
+        crispy::qoi::encodeHeader(header, reinterpret_cast<uint8_t*>(file.data()));
+        auto const chunks = crispy::qoi::encode(_pixels.data(), _pixels.size() / 4);
+        file.append(chunks.begin(), chunks.end());
+        file.append(7, '\0');
+        file.push_back('\1');
+        return crispy::base64::encode(file);
+    }
+
+    vector<uint8_t> decompress(ImageTransfer::Result const& _image)
+    {
+        auto pixels = vector<uint8_t>(static_cast<size_t>(_image.size.width * _image.size.height) * 4);
+        CHECK(crispy::qoi::decode(_image.pixels.chunks.data(), _image.pixels.chunks.size(),
+                                  pixels.data(), pixels.size() / 4));
+        return pixels;
+    }
+
+    class MockScreen : public MockScreenEvents,
+                       public Screen {
+      public:
+        explicit MockScreen(Size const& _size) :
+            Screen{ _size, *this }
+        {}
+    };
+}
+
+TEST_CASE("ImageTransfer.chunks", "[image]")
+{
+    auto const size = Size{37, 23};
+    auto const pixels = gradient(size);
+    auto const encoded = qoiFile(size, pixels);
+
+    // Splits the data at odd places, including within the header and base64 quadruples.
+    auto transfer = ImageTransfer{Size{800, 600}};
+    for (size_t offset = 0, length = 1; offset < encoded.size(); offset += length, length = length * 2 + 1)
+        transfer.pass(string_view(encoded).substr(offset, length));
+    CHECK_FALSE(transfer.failed());
+
+    auto const image = transfer.finish();
+    REQUIRE(image.has_value());
+    CHECK(image->size == size);
+    CHECK(decompress(*image) == pixels);
+}
+
+TEST_CASE("ImageTransfer.too_large", "[image]")
+{
+    auto const size = Size{40, 20};
+    auto const encoded = qoiFile(size, gradient(size));
+
+    auto transfer = ImageTransfer{Size{40, 19}};
+    transfer.pass(string_view(encoded).substr(0, 20)); // the header only
+    CHECK(transfer.failed());
+    transfer.pass(string_view(encoded).substr(20));
+    CHECK_FALSE(transfer.finish().has_value());
+}
+
+TEST_CASE("ImageTransfer.invalid", "[image]")
+{
+    SECTION("no QOI file") {
+        auto transfer = ImageTransfer{Size{800, 600}};
+        transfer.pass(crispy::base64::encode("GIF89a, or some other image format"));
+        CHECK(transfer.failed());
+        CHECK_FALSE(transfer.finish().has_value());
+    }
+
+    SECTION("incomplete header") {
+        auto transfer = ImageTransfer{Size{800, 600}};
+        transfer.pass(crispy::base64::encode("qoif"));
+        CHECK_FALSE(transfer.failed());
+        CHECK_FALSE(transfer.finish().has_value());
+    }
+
+    SECTION("more data than the image can have") {
+        auto const size = Size{2, 2};
+        auto const encoded = qoiFile(size, gradient(size));
+        auto transfer = ImageTransfer{Size{800, 600}};
+        transfer.pass(encoded.substr(0, encoded.size() - 4)); // without the padded end
+        transfer.pass(crispy::base64::encode(string(100, 'x')));
+        CHECK(transfer.failed());
+    }
+}
+
+TEST_CASE("ImageTransfer.Screen", "[image]")
+{
+    auto screen = MockScreen{Size{10, 5}};
+    screen.setCellPixelSize(Size{4, 8});
+
+    auto const size = Size{10, 12};
+    auto const pixels = gradient(size);
+    auto const encoded = qoiFile(size, pixels);
+    auto const half = encoded.size() / 2 + 1;
+
+    // First chunk, more to follow, with text output in between.
+    screen.write("\033P1;1i" + encoded.substr(0, half) + "\033\\");
+    screen.write("ab");
+    CHECK(screen.renderTextLine(1) == "ab        ");
+    screen.write("\r");
+
+    // Last chunk, with the format defaulting to QOI.
+    screen.write("\033Pi" + encoded.substr(half) + "\033\\");
+
+#if defined(LIBTERMINAL_IMAGES)
+    // Spans 3x2 cells, placed at the cursor.
+    for (int column = 1; column <= 3; ++column)
+        for (int row = 1; row <= 2; ++row)
+            CHECK(screen.grid().imageFragment(screen.grid().at({row, column})).has_value());
+    CHECK_FALSE(screen.grid().imageFragment(screen.grid().at({1, 4})).has_value());
+
+    auto const fragment = screen.grid().imageFragment(screen.grid().at({1, 1}));
+    REQUIRE(fragment.has_value());
+    auto const& image = fragment->rasterizedImage().image();
+    CHECK(image.size() == size);
+    auto const decoded = image.pixels();
+    CHECK(vector<uint8_t>(decoded.data.begin(), decoded.data.end()) == pixels);
+#endif
+}
+
+TEST_CASE("ImageTransfer.Screen.png", "[image]")
+{
+    // PNG is reserved, yet unsupported, and thus ignored, as is any chunk of a broken transfer.
+    auto screen = MockScreen{Size{10, 5}};
+    screen.setCellPixelSize(Size{4, 8});
+    screen.write("\033P2i" + crispy::base64::encode("\x89PNG\r\n\x1a\n") + "\033\\");
+#if defined(LIBTERMINAL_IMAGES)
+    CHECK_FALSE(screen.grid().imageFragment(screen.grid().at({1, 1})).has_value());
+#endif
+    CHECK(screen.cursorPosition() == Coordinate{1, 1});
+}
@@ -20,6 +20,7 @@
 
 #include <algorithm>
 #include <array>
+#include <cassert>
 #include <iterator>
 #include <string_view>
 #include <unordered_map>
@@ -67,17 +68,12 @@ namespace mappings {
         std::string_view const mapping{};
     };
 
-    // TODO: implement constexpr-binary-search by:
-    // - adding operator<(KeyMapping a, KeyMapping b) { return a.key < b.key; }
-    // - constexpr-evaluated sort()ed array returned in lambda-expr to be assigned to these globals here.
-    // - make use of this property and let tryMap() do a std::binary_search()
-
     #define ESC "\x1B"
     #define CSI "\x1B["
     #define SS3 "\x1BO"
 
-    // the modifier parameter is going to be replaced via fmt::format()
-    array<KeyMapping, 30> functionKeysWithModifiers{
+    // the modifier parameter is going to be substituted for "{}", see makeKeySequence()
+    constexpr array<KeyMapping, 30> functionKeysWithModifiers{
         // Note, that F1..F4 is using CSI too instead of ESC when used with modifier keys.
         // XXX: Maybe I am blind when reading ctlseqs.txt, but F1..F4 with "1;{}P".. seems not to
         // match what other terminal emulators send out with modifiers and I don't see how to match
@@ -118,7 +114,7 @@ namespace mappings {
         KeyMapping{Key::PageDown, CSI "6;{}~"},
     };
 
-    array<KeyMapping, 22> standard{
+    constexpr array<KeyMapping, 22> standard{
         // cursor keys
         KeyMapping{Key::UpArrow, CSI "A"},
         KeyMapping{Key::DownArrow, CSI "B"},
@@ -149,7 +145,7 @@ namespace mappings {
     };
 
     /// (DECCKM) Cursor key mode: mappings in when cursor key application mode is set.
-    array<KeyMapping, 6> applicationCursorKeys{
+    constexpr array<KeyMapping, 6> applicationCursorKeys{
         KeyMapping{Key::UpArrow, SS3 "A"},
         KeyMapping{Key::DownArrow, SS3 "B"},
         KeyMapping{Key::RightArrow, SS3 "C"},
@@ -158,7 +154,7 @@ namespace mappings {
         KeyMapping{Key::End, SS3 "F"},
     };
 
-    array<KeyMapping, 21> applicationKeypad{
+    constexpr array<KeyMapping, 21> applicationKeypad{
         KeyMapping{Key::Numpad_NumLock, SS3 "P"},
         KeyMapping{Key::Numpad_Divide, SS3 "Q"},
         KeyMapping{Key::Numpad_Multiply, SS3 "Q"},
@@ -197,7 +193,7 @@ namespace mappings {
     }
 
     template<size_t N>
-    optional<string_view> tryMap(array<KeyMapping, N> const& _mappings, Key _key) noexcept
+    constexpr optional<string_view> tryMap(array<KeyMapping, N> const& _mappings, Key _key) noexcept
     {
         for (KeyMapping const& km : _mappings)
             if (km.key == _key)
@@ -205,6 +201,84 @@ namespace mappings {
 
         return nullopt;
     }
+
+    /// Escape sequence stored inline, so that tables of them can be built at compile time.
+    struct KeySequence {
+        char data[8]{};
+        uint8_t size = 0;
+
+        constexpr string_view view() const noexcept { return string_view(data, size); }
+    };
+
+    /// Substitutes @p _param for the "{}" placeholder within @p _mapping, if any.
+    constexpr KeySequence makeKeySequence(string_view _mapping, size_t _param) noexcept
+    {
+        KeySequence sequence{};
+        for (size_t i = 0; i < _mapping.size(); ++i)
+        {
+            if (_mapping[i] == '{' && i + 1 < _mapping.size() && _mapping[i + 1] == '}')
+            {
+                if (_param >= 10)
+                    sequence.data[sequence.size++] = static_cast<char>('0' + _param / 10);
+                sequence.data[sequence.size++] = static_cast<char>('0' + _param % 10);
+                ++i;
+            }
+            else
+                sequence.data[sequence.size++] = _mapping[i];
+        }
+        return sequence;
+    }
+
+    constexpr KeySequence mapKey(Key _key, Modifier _modifier, bool _applicationCursorKeys, bool _applicationKeypad) noexcept
+    {
+        if (_modifier)
+        {
+            if (auto mapping = tryMap(functionKeysWithModifiers, _key); mapping)
+                return makeKeySequence(*mapping, makeVirtualTerminalParam(_modifier));
+        }
+
+        if (_applicationCursorKeys)
+            if (auto mapping = tryMap(applicationCursorKeys, _key); mapping)
+                return makeKeySequence(*mapping, 0);
+
+        if (_applicationKeypad)
+            if (auto mapping = tryMap(applicationKeypad, _key); mapping)
+                return makeKeySequence(*mapping, 0);
+
+        if (auto mapping = tryMap(standard, _key); mapping)
+            return makeKeySequence(*mapping, 0);
+
+        return {};
+    }
+
+    constexpr size_t KeyCount = static_cast<size_t>(Key::Numpad_9) + 1;
+    constexpr size_t ModifierCount = 16; // all combinations of Shift, Alt, Control and Meta
+
+    /// Sequences of all keys, by application cursor keys mode, application keypad mode,
+    /// modifier and key, being empty for keys not mapped.
+    using KeySequenceTable = array<array<array<array<KeySequence, KeyCount>, ModifierCount>, 2>, 2>;
+
+    constexpr KeySequenceTable makeKeySequenceTable() noexcept
+    {
+        KeySequenceTable table{};
+        for (size_t cursorKeys = 0; cursorKeys < 2; ++cursorKeys)
+            for (size_t keypad = 0; keypad < 2; ++keypad)
+                for (size_t modifier = 0; modifier < ModifierCount; ++modifier)
+                    for (size_t key = 0; key < KeyCount; ++key)
+                        table[cursorKeys][keypad][modifier][key] = mapKey(static_cast<Key>(key),
+                                                                          static_cast<Modifier::Key>(modifier),
+                                                                          cursorKeys != 0,
+                                                                          keypad != 0);
+        return table;
+    }
+
+    constexpr KeySequenceTable keySequences = makeKeySequenceTable();
+
+    static_assert(keySequences[0][0][0][static_cast<size_t>(Key::UpArrow)].view() == "\x1B[A");
+    static_assert(keySequences[1][0][0][static_cast<size_t>(Key::UpArrow)].view() == "\x1BOA");
+    static_assert(keySequences[1][0][Modifier::Control][static_cast<size_t>(Key::UpArrow)].view() == "\x1B[1;5A");
+    static_assert(keySequences[0][0][15][static_cast<size_t>(Key::F20)].view() == "\x1B[34;16~");
+    static_assert(keySequences[0][0][0][static_cast<size_t>(Key::Numpad_5)].view().empty());
 }
 
 string to_string(Modifier _modifier)
@@ -389,39 +463,74 @@ bool InputGenerator::generate(char32_t _characterEvent, Modifier _modifier)
     return true;
 }
 
-bool InputGenerator::generate(Key _key, Modifier _modifier)
+string_view InputGenerator::sequence(Key _key, Modifier _modifier) const noexcept
 {
-    if (_modifier)
-    {
-        if (auto mapping = tryMap(mappings::functionKeysWithModifiers, _key); mapping)
-            return append(fmt::format(*mapping, makeVirtualTerminalParam(_modifier)));
-    }
-
-    if (applicationCursorKeys())
-        if (auto mapping = tryMap(mappings::applicationCursorKeys, _key); mapping)
-            return append(*mapping);
-
-    if (applicationKeypad())
-        if (auto mapping = tryMap(mappings::applicationKeypad, _key); mapping)
-            return append(*mapping);
+    auto const key = static_cast<size_t>(_key);
+    if (key >= mappings::KeyCount || _modifier.value() >= mappings::ModifierCount)
+        return {};
 
-    if (auto mapping = tryMap(mappings::standard, _key); mapping)
-        return append(*mapping);
+    return mappings::keySequences[applicationCursorKeys()][applicationKeypad()][_modifier.value()][key].view();
+}
 
-    return false;
+bool InputGenerator::generate(Key _key, Modifier _modifier)
+{
+    auto const mapping = sequence(_key, _modifier);
+    return !mapping.empty() && append(mapping);
 }
 
 void InputGenerator::generatePaste(std::string_view const& _text)
+{
+    generatePasteBegin();
+    append(_text);
+    generatePasteEnd();
+}
+
+void InputGenerator::generatePasteBegin()
 {
     if (bracketedPaste_)
         append("\033[200~"sv);
+}
 
-    append(_text);
-
+void InputGenerator::generatePasteEnd()
+{
     if (bracketedPaste_)
         append("\033[201~"sv);
 }
 
+void sanitizePaste(std::string& _text)
+{
+    // Length of the control character at the given offset, or 0 if there is none.
+    auto const controlLength = [&](size_t i) -> size_t {
+        auto const ch = static_cast<uint8_t>(_text[i]);
+        if (ch < 0x20)
+            return ch == '\t' || ch == '\n' || ch == '\r' ? 0 : 1;
+        if (ch == 0x7F)
+            return 1;
+        if (ch == 0xC2 && i + 1 < _text.size())
+        {
+            auto const next = static_cast<uint8_t>(_text[i + 1]);
+            return next >= 0x80 && next <= 0x9F ? 2 : 0; // UTF-8 encoded C1 control
+        }
+        return 0;
+    };
+
+    // Compacts the text in place, leaving it untouched up to the first control character.
+    auto out = size_t{0};
+    for (size_t i = 0; i < _text.size(); )
+    {
+        if (auto const n = controlLength(i); n != 0)
+        {
+            i += n;
+            continue;
+        }
+        if (out != i)
+            _text[out] = _text[i];
+        ++out;
+        ++i;
+    }
+    _text.resize(out);
+}
+
 void InputGenerator::swap(Sequence& _other)
 {
     std::swap(pendingSequence_, _other);
@@ -20,6 +20,7 @@
 #include <crispy/escape.h>
 #include <unicode/convert.h>
 
+#include <functional>
 #include <optional>
 #include <set>
 #include <string>
@@ -344,9 +345,22 @@ class InputGenerator {
     /// Generates input sequence for a pressed special key.
     bool generate(Key _key, Modifier _modifier);
 
+    /// @returns the input sequence for a pressed special key in the current modes,
+    ///          or an empty one if the key is not mapped. Nothing is generated.
+    std::string_view sequence(Key _key, Modifier _modifier) const noexcept;
+
     /// Generates input sequence for bracketed paste text.
     void generatePaste(std::string_view const& _text);
 
+    /// Generates the opening bracket of a paste, if in bracketed paste mode.
+    ///
+    /// Along with generatePasteEnd(), this allows the pasted text itself to be written
+    /// by the caller, rather than being copied into the pending sequence.
+    void generatePasteBegin();
+
+    /// Generates the closing bracket of a paste, if in bracketed paste mode.
+    void generatePasteEnd();
+
     /// Generates input sequence for a mouse button press event.
     bool generate(MousePressEvent const& _mousePress);
 
@@ -420,6 +434,11 @@ inline std::string to_string(InputGenerator::MouseEventType _value)
     return "???";
 }
 
+/// Removes control characters from pasted text in a single pass, so that the paste cannot
+/// inject control sequences. Tab, line feed and carriage return are kept.
+/// UTF-8 encoded C1 control characters are removed as well.
+void sanitizePaste(std::string& _text);
+
 }  // namespace terminal
 
 namespace fmt { // {{{
@@ -0,0 +1,94 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/InputGenerator.h>
+
+#include <crispy/benchmark.h>
+
+#include <fmt/format.h>
+
+#include <array>
+#include <random>
+#include <string>
+
+using namespace terminal;
+using crispy::benchmark::do_not_optimize;
+
+namespace
+{
+    auto constexpr Modifiers = std::array<Modifier::Key, 4>{
+        Modifier::None, Modifier::Shift, Modifier::Alt, Modifier::Control
+    };
+
+    auto constexpr Keys = std::array<Key, 12>{
+        Key::F1, Key::F5, Key::F12,
+        Key::DownArrow, Key::LeftArrow, Key::RightArrow, Key::UpArrow,
+        Key::Insert, Key::Delete, Key::Home, Key::End, Key::PageUp
+    };
+}
+
+CRISPY_BENCHMARK("InputGenerator.generate")
+{
+    auto input = InputGenerator{};
+    auto sequence = InputGenerator::Sequence{};
+
+    // Printable US-ASCII characters, mostly without modifiers, as when typing.
+    auto character = std::uniform_int_distribution<int>(0x20, 0x7E);
+    auto modifier = std::uniform_int_distribution<size_t>(0, Modifiers.size() - 1);
+    auto characters = std::array<std::pair<char32_t, Modifier>, 1024>{};
+    for (auto& [ch, mod]: characters)
+    {
+        ch = static_cast<char32_t>(character(_bench.rng()));
+        mod = _bench.rng()() % 8 ? Modifier::None : Modifiers[modifier(_bench.rng())];
+    }
+
+    size_t i = 0;
+    _bench.measure("char", [&]() {
+        auto const& [ch, mod] = characters[i++ % characters.size()];
+        do_not_optimize(input.generate(ch, mod));
+        input.swap(sequence);
+        sequence.clear();
+    });
+
+    auto key = std::uniform_int_distribution<size_t>(0, Keys.size() - 1);
+    auto keys = std::array<std::pair<Key, Modifier>, 1024>{};
+    for (auto& [k, mod]: keys)
+    {
+        k = Keys[key(_bench.rng())];
+        mod = Modifiers[modifier(_bench.rng())];
+    }
+
+    for (auto const mode: {KeyMode::Normal, KeyMode::Application})
+    {
+        input.setCursorKeysMode(mode);
+        _bench.measure(fmt::format("key/mode={}", mode == KeyMode::Normal ? "normal" : "application"), [&]() {
+            auto const& [k, mod] = keys[i++ % keys.size()];
+            do_not_optimize(input.generate(k, mod));
+            input.swap(sequence);
+            sequence.clear();
+        });
+    }
+    input.setCursorKeysMode(KeyMode::Normal);
+
+    for (bool const bracketed: {false, true})
+    {
+        auto const text = crispy::benchmark::random_text(_bench.rng(), 4096);
+        input.setBracketedPaste(bracketed);
+        _bench.throughput(text.size());
+        _bench.measure(fmt::format("paste/bracketed={}", bracketed), [&]() {
+            input.generatePaste(text);
+            input.swap(sequence);
+            sequence.clear();
+        });
+    }
+}
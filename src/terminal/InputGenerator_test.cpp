@@ -104,3 +104,61 @@ TEST_CASE("InputGenerator.all(Ctrl + A..Z)", "[terminal,input]")
         REQUIRE(escape(input.peek()) == escape(c0));
     }
 }
+
+TEST_CASE("InputGenerator.generatePaste", "[terminal,input]")
+{
+    auto input = InputGenerator{};
+    input.generatePaste("text"sv);
+    CHECK(input.peek() == "text");
+
+    auto bracketed = InputGenerator{};
+    bracketed.setBracketedPaste(true);
+    bracketed.generatePaste("text"sv);
+    CHECK(escape(bracketed.peek()) == escape("\033[200~text\033[201~"sv));
+
+    // The brackets alone, for the text to be written by the caller.
+    auto pending = Buffer{};
+    bracketed.swap(pending);
+    bracketed.generatePasteBegin();
+    bracketed.generatePasteEnd();
+    CHECK(escape(bracketed.peek()) == escape("\033[200~\033[201~"sv));
+}
+
+TEST_CASE("InputGenerator.sanitizePaste", "[terminal,input]")
+{
+    auto text = "ls\t-l\r\n\033[201~rm\x7F\x07 \xC2\x9B" "1m\xC2\xA0\xE2\x82\xAC\0end"s;
+    text += '\xC2'; // truncated UTF-8 sequence at the end is kept as is
+    terminal::sanitizePaste(text);
+    CHECK(escape(text) == escape("ls\t-l\r\n[201~rm 1m\xC2\xA0\xE2\x82\xAC" "end\xC2"sv));
+
+    auto clean = string("nothing to remove\n");
+    terminal::sanitizePaste(clean);
+    CHECK(clean == "nothing to remove\n");
+}
+
+TEST_CASE("InputGenerator.keys", "[terminal,input]")
+{
+    using terminal::Key;
+    using terminal::KeyMode;
+
+    auto input = InputGenerator{};
+    CHECK(escape(input.sequence(Key::UpArrow, Modifier::None)) == escape("\033[A"sv));
+    CHECK(escape(input.sequence(Key::F5, Modifier::None)) == escape("\033[15~"sv));
+    CHECK(escape(input.sequence(Key::F1, Modifier::Shift)) == escape("\033O2P"sv));
+    CHECK(escape(input.sequence(Key::PageDown, Modifier::Control)) == escape("\033[6;5~"sv));
+    CHECK(escape(input.sequence(Key::F20, Modifier(Modifier::Key(15)))) == escape("\033[34;16~"sv));
+    CHECK(input.sequence(Key::Numpad_5, Modifier::None).empty());
+
+    input.setCursorKeysMode(KeyMode::Application);
+    CHECK(escape(input.sequence(Key::UpArrow, Modifier::None)) == escape("\033OA"sv));
+    CHECK(escape(input.sequence(Key::UpArrow, Modifier::Alt)) == escape("\033[1;3A"sv));
+
+    input.setApplicationKeypadMode(true);
+    CHECK(escape(input.sequence(Key::Numpad_5, Modifier::None)) == escape("\033Ou"sv));
+
+    // sequence() merely looks up, whereas generate() appends to the pending input.
+    CHECK(input.peek().empty());
+    CHECK(input.generate(Key::Numpad_5, Modifier::None));
+    CHECK(escape(input.peek()) == escape("\033Ou"sv));
+    CHECK_FALSE(input.generate(Key::F13, Modifier::None));
+}
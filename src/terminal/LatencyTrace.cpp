@@ -0,0 +1,73 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/LatencyTrace.h>
+
+#include <fmt/format.h>
+
+using std::string;
+
+namespace terminal {
+
+namespace // {{{ helper
+{
+    string formatLatency(crispy::latency_histogram::duration _value)
+    {
+        return fmt::format("{:.2f}ms", static_cast<double>(_value.count()) / 1000.0);
+    }
+
+    std::string_view jsonKey(LatencyStage _stage) noexcept
+    {
+        switch (_stage)
+        {
+            case LatencyStage::Parsed: return "parsed";
+            case LatencyStage::RenderBuffer: return "render_buffer";
+            case LatencyStage::Painted: return "painted";
+            case LatencyStage::Presented: return "presented";
+            case LatencyStage::InputWritten: return "input_written";
+            case LatencyStage::SynchronizedOutput: return "synchronized_output";
+        }
+        return "invalid";
+    }
+} // }}}
+
+string LatencyTrace::dump() const
+{
+    auto out = fmt::format("{:<14} {:>10} {:>10} {:>10} {:>10}\n", "stage", "samples", "p50", "p99", "max");
+    for (size_t i = 0; i < StageCount; ++i)
+    {
+        auto const stage = static_cast<LatencyStage>(i);
+        auto const& h = histogram(stage);
+        out += fmt::format("{:<14} {:>10} {:>10} {:>10} {:>10}\n",
+                           to_string(stage),
+                           h.count(),
+                           formatLatency(h.percentile(50)),
+                           formatLatency(h.percentile(99)),
+                           formatLatency(h.max()));
+    }
+    return out;
+}
+
+string LatencyTrace::json() const
+{
+    auto out = string("{");
+    for (size_t i = 0; i < StageCount; ++i)
+    {
+        auto const stage = static_cast<LatencyStage>(i);
+        out += fmt::format("{}\"{}\": {}", i ? ", " : "", jsonKey(stage), histogram(stage).json());
+    }
+    out += '}';
+    return out;
+}
+
+} // end namespace
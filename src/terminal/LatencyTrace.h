@@ -0,0 +1,88 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <crispy/latency_histogram.h>
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <string_view>
+
+namespace terminal {
+
+/// Points in the pipeline up to which latencies are traced.
+///
+/// Output latencies are measured from the time the PTY output has been read,
+/// input latencies from the time the key event has been received.
+enum class LatencyStage {
+    Parsed,         //!< PTY output has been written to the screen.
+    RenderBuffer,   //!< PTY output has been published in a render buffer.
+    Painted,        //!< PTY output has been painted by the render thread.
+    Presented,      //!< PTY output has been presented, i.e. its frame has been swapped to screen.
+    InputWritten,   //!< A key event has been written to the PTY.
+    SynchronizedOutput, //!< A synchronized output batch (DECSET 2026) has been completed, since it began.
+};
+
+constexpr std::string_view to_string(LatencyStage _stage) noexcept
+{
+    switch (_stage)
+    {
+        case LatencyStage::Parsed: return "parsed";
+        case LatencyStage::RenderBuffer: return "render buffer";
+        case LatencyStage::Painted: return "painted";
+        case LatencyStage::Presented: return "presented";
+        case LatencyStage::InputWritten: return "input written";
+        case LatencyStage::SynchronizedOutput: return "sync. output";
+    }
+    return "INVALID";
+}
+
+/// Collects latency histograms for each LatencyStage.
+///
+/// Stages are recorded by different threads (terminal, render, and PTY writer thread),
+/// and may be read by any thread at any time.
+class LatencyTrace {
+  public:
+    using Timestamp = std::chrono::steady_clock::time_point;
+
+    static constexpr size_t StageCount = static_cast<size_t>(LatencyStage::SynchronizedOutput) + 1;
+
+    /// Records the time passed from @p _origin to @p _now, unless @p _origin is unset.
+    void record(LatencyStage _stage, Timestamp _origin, Timestamp _now) noexcept
+    {
+        if (_origin != Timestamp{})
+            histogram(_stage).record(_now - _origin);
+    }
+
+    crispy::latency_histogram& histogram(LatencyStage _stage) noexcept { return histograms_[static_cast<size_t>(_stage)]; }
+    crispy::latency_histogram const& histogram(LatencyStage _stage) const noexcept { return histograms_[static_cast<size_t>(_stage)]; }
+
+    void reset() noexcept
+    {
+        for (auto& histogram: histograms_)
+            histogram.reset();
+    }
+
+    /// @returns a human readable table of the 50th and 99th percentile and maximum of each stage.
+    std::string dump() const;
+
+    /// @returns a JSON object mapping each stage to its histogram, see crispy::latency_histogram::json().
+    std::string json() const;
+
+  private:
+    std::array<crispy::latency_histogram, StageCount> histograms_;
+};
+
+} // end namespace terminal
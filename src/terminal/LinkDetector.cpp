@@ -0,0 +1,244 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/LinkDetector.h>
+
+using std::vector;
+
+namespace terminal {
+
+namespace
+{
+    constexpr bool isAlpha(char32_t _ch) noexcept
+    {
+        return (U'a' <= _ch && _ch <= U'z') || (U'A' <= _ch && _ch <= U'Z');
+    }
+
+    constexpr bool isAlphaNumeric(char32_t _ch) noexcept
+    {
+        return isAlpha(_ch) || (U'0' <= _ch && _ch <= U'9');
+    }
+
+    constexpr bool isSchemeChar(char32_t _ch) noexcept
+    {
+        return isAlphaNumeric(_ch) || _ch == U'+' || _ch == U'-' || _ch == U'.';
+    }
+
+    /// Codepoints never part of any link, i.e. blanks and quotes around it.
+    constexpr bool isDelimiter(char32_t _ch) noexcept
+    {
+        switch (_ch)
+        {
+            case U'"':
+            case U'\'':
+            case U'`':
+            case U'<':
+            case U'>':
+            case U'|':
+            case U'{':
+            case U'}':
+            case U'\\':
+            case U'^':
+            case 0x7F:
+            case 0xA0:
+                return true;
+            default:
+                return _ch <= U' ';
+        }
+    }
+
+    /// Codepoints part of a path's names. Colons are left out to not take line numbers
+    /// (such as in "/src/main.cpp:42:") as part of the path.
+    constexpr bool isPathChar(char32_t _ch) noexcept
+    {
+        switch (_ch)
+        {
+            case U'/':
+            case U'.':
+            case U'_':
+            case U'-':
+            case U'~':
+            case U'+':
+            case U'@':
+            case U'%':
+            case U'=':
+            case U'#':
+                return true;
+            default:
+                return isAlphaNumeric(_ch) || (_ch >= 0x80 && !isDelimiter(_ch));
+        }
+    }
+
+    /// Codepoints ending a sentence or clause, that are only part of a link if followed by more of it.
+    constexpr bool isPunctuation(char32_t _ch) noexcept
+    {
+        switch (_ch)
+        {
+            case U'.':
+            case U',':
+            case U';':
+            case U':':
+            case U'!':
+            case U'?':
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /// Whether a file path may start after @p _ch, such as after a blank, an opening parenthesis,
+    /// or an equal sign of a command line option.
+    constexpr bool startsPath(char32_t _ch) noexcept
+    {
+        return isDelimiter(_ch) || _ch == U'(' || _ch == U'[' || _ch == U'=' || _ch == U':' || _ch == U',';
+    }
+}
+
+void LinkDetector::feed(int _column, char32_t _codepoint)
+{
+    switch (state_)
+    {
+        case State::Gap:
+            start(_column, _codepoint);
+            break;
+        case State::Scheme:
+            if (_codepoint == U':')
+                state_ = State::SchemeColon;
+            else if (!isSchemeChar(_codepoint))
+                start(_column, _codepoint);
+            break;
+        case State::SchemeColon:
+            if (_codepoint == U'/')
+                state_ = State::SchemeSlash;
+            else
+                start(_column, _codepoint);
+            break;
+        case State::SchemeSlash:
+            if (_codepoint == U'/')
+            {
+                state_ = State::Url;
+                lastColumn_ = 0;
+                nesting_ = 0;
+            }
+            else
+                start(_column, _codepoint);
+            break;
+        case State::Url:
+            if (isDelimiter(_codepoint))
+            {
+                addLink();
+                state_ = State::Gap;
+            }
+            else if (_codepoint == U')' || _codepoint == U']')
+            {
+                if (nesting_ == 0)
+                {
+                    addLink();
+                    state_ = State::Gap;
+                }
+                else
+                {
+                    --nesting_;
+                    lastColumn_ = _column;
+                }
+            }
+            else
+            {
+                if (_codepoint == U'(' || _codepoint == U'[')
+                    ++nesting_;
+                if (!isPunctuation(_codepoint))
+                    lastColumn_ = _column;
+            }
+            break;
+        case State::Tilde:
+            if (_codepoint == U'/')
+                state_ = State::PathSlash;
+            else
+                start(_column, _codepoint);
+            break;
+        case State::Dot:
+            if (_codepoint == U'/')
+                state_ = State::PathSlash;
+            else if (_codepoint == U'.')
+                state_ = State::DotDot;
+            else
+                start(_column, _codepoint);
+            break;
+        case State::DotDot:
+            if (_codepoint == U'/')
+                state_ = State::PathSlash;
+            else
+                start(_column, _codepoint);
+            break;
+        case State::PathSlash:
+            if (_codepoint != U'/' && isPathChar(_codepoint))
+            {
+                state_ = State::Path;
+                lastColumn_ = _column;
+            }
+            else
+                start(_column, _codepoint);
+            break;
+        case State::Path:
+            if (!isPathChar(_codepoint))
+            {
+                addLink();
+                start(_column, _codepoint);
+            }
+            else if (_codepoint != U'.')
+                lastColumn_ = _column;
+            break;
+    }
+    previous_ = _codepoint;
+}
+
+void LinkDetector::start(int _column, char32_t _codepoint)
+{
+    firstColumn_ = _column;
+    lastColumn_ = 0;
+
+    if (isAlpha(_codepoint) && !isSchemeChar(previous_))
+        state_ = State::Scheme;
+    else if (!startsPath(previous_))
+        state_ = State::Gap;
+    else if (_codepoint == U'/')
+        state_ = State::PathSlash;
+    else if (_codepoint == U'~')
+        state_ = State::Tilde;
+    else if (_codepoint == U'.')
+        state_ = State::Dot;
+    else
+        state_ = State::Gap;
+}
+
+void LinkDetector::addLink()
+{
+    if (lastColumn_ >= firstColumn_ && lastColumn_ > 0)
+        links_.push_back(DetectedLink{firstColumn_, lastColumn_});
+    lastColumn_ = 0;
+}
+
+vector<DetectedLink> LinkDetector::finish()
+{
+    if (state_ == State::Url || state_ == State::Path)
+        addLink();
+
+    state_ = State::Gap;
+    previous_ = 0;
+    nesting_ = 0;
+    auto links = vector<DetectedLink>{};
+    links.swap(links_);
+    return links;
+}
+
+} // end namespace
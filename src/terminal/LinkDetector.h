@@ -0,0 +1,84 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <vector>
+
+namespace terminal {
+
+/// Columns of a URL or file path detected in the plain text of a line, see LinkDetector.
+struct DetectedLink {
+    int firstColumn;    // 1-based
+    int lastColumn;
+
+    constexpr bool contains(int _column) const noexcept { return firstColumn <= _column && _column <= lastColumn; }
+};
+
+constexpr bool operator==(DetectedLink const& a, DetectedLink const& b) noexcept
+{
+    return a.firstColumn == b.firstColumn && a.lastColumn == b.lastColumn;
+}
+
+constexpr bool operator!=(DetectedLink const& a, DetectedLink const& b) noexcept
+{
+    return !(a == b);
+}
+
+/// Detects URLs and file paths in text not marked up as hyperlinks (see OSC 8).
+///
+/// URLs are detected by their scheme, such as https://example.com/ or file:///etc/hosts,
+/// and file paths by their leading slash, tilde or dot, such as /etc/hosts, ~/.bashrc or ../README.md.
+/// Trailing punctuation and unbalanced closing parentheses or brackets are not taken as part of a link,
+/// as they most likely belong to the surrounding prose.
+///
+/// The text is fed one cell at a time into a small state machine, without any text being
+/// built up or matched against regular expressions, so that a line is scanned in a single pass.
+class LinkDetector {
+  public:
+    /// Feeds the codepoint of the cell at the 1-based @p _column, with 0 standing for an empty cell.
+    ///
+    /// Columns are expected in ascending order.
+    void feed(int _column, char32_t _codepoint);
+
+    /// Completes the link the last cell fed may be part of.
+    ///
+    /// @returns the links detected, ordered by column, resetting the detector for the next line.
+    std::vector<DetectedLink> finish();
+
+  private:
+    enum class State {
+        Gap,            // outside of any link
+        Scheme,         // letters possibly starting a URL's scheme
+        SchemeColon,    // "scheme:"
+        SchemeSlash,    // "scheme:/"
+        Url,            // "scheme://..."
+        Tilde,          // "~"
+        Dot,            // "."
+        DotDot,         // ".."
+        PathSlash,      // a path's slash not followed by any name yet
+        Path,           // "/name..."
+    };
+
+    void start(int _column, char32_t _codepoint);
+    void addLink();
+
+    State state_ = State::Gap;
+    char32_t previous_ = 0;     // codepoint of the cell fed last
+    int firstColumn_ = 0;       // of the link being detected
+    int lastColumn_ = 0;        // of the link being detected, excluding trailing punctuation, 0 if none yet
+    int nesting_ = 0;           // parentheses and brackets opened within the link being detected
+    std::vector<DetectedLink> links_;
+};
+
+} // end namespace
@@ -0,0 +1,115 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/LinkDetector.h>
+
+#include <unicode/convert.h>
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+using terminal::DetectedLink;
+using terminal::LinkDetector;
+
+namespace
+{
+    /// @returns the text of the links detected in @p _text, which is fed one codepoint per cell.
+    vector<string> detect(string_view _text)
+    {
+        auto const text = unicode::convert_to<char32_t>(_text);
+        auto detector = LinkDetector{};
+        for (size_t i = 0; i < text.size(); ++i)
+            detector.feed(static_cast<int>(i + 1), text[i]);
+
+        auto links = vector<string>{};
+        for (DetectedLink const& link: detector.finish())
+            links.emplace_back(unicode::convert_to<char>(std::u32string_view(text).substr(
+                static_cast<size_t>(link.firstColumn - 1),
+                static_cast<size_t>(link.lastColumn - link.firstColumn + 1))));
+        return links;
+    }
+}
+
+TEST_CASE("LinkDetector.urls", "[links]")
+{
+    CHECK(detect("https://example.com/") == vector<string>{"https://example.com/"});
+    CHECK(detect("see http://a.b/c?d=1&e=2#f for more") == vector<string>{"http://a.b/c?d=1&e=2#f"});
+    CHECK(detect("file:///etc/hosts") == vector<string>{"file:///etc/hosts"});
+    CHECK(detect("git+ssh://host/repo.git, or") == vector<string>{"git+ssh://host/repo.git"});
+    CHECK(detect("two: http://a.b and ftp://c.d") == vector<string>{"http://a.b", "ftp://c.d"});
+    CHECK(detect("ünïcode https://a.b/ü") == vector<string>{"https://a.b/ü"});
+}
+
+TEST_CASE("LinkDetector.url_punctuation", "[links]")
+{
+    CHECK(detect("Go to https://example.com.") == vector<string>{"https://example.com"});
+    CHECK(detect("(see https://example.com/x)") == vector<string>{"https://example.com/x"});
+    CHECK(detect("https://en.wikipedia.org/wiki/Foo_(bar)") == vector<string>{"https://en.wikipedia.org/wiki/Foo_(bar)"});
+    CHECK(detect("[https://a.b/[c]]") == vector<string>{"https://a.b/[c]"});
+    CHECK(detect("\"https://a.b/\"") == vector<string>{"https://a.b/"});
+    CHECK(detect("<https://a.b/>") == vector<string>{"https://a.b/"});
+}
+
+TEST_CASE("LinkDetector.no_urls", "[links]")
+{
+    CHECK(detect("").empty());
+    CHECK(detect("https://").empty());
+    CHECK(detect("https:// example").empty());
+    CHECK(detect("time: 12:30").empty());
+    CHECK(detect("key:value").empty());
+    CHECK(detect("https:/a.b").empty());
+}
+
+TEST_CASE("LinkDetector.paths", "[links]")
+{
+    CHECK(detect("/etc/hosts") == vector<string>{"/etc/hosts"});
+    CHECK(detect("cat ~/.bashrc") == vector<string>{"~/.bashrc"});
+    CHECK(detect("ls ./build ../src/") == vector<string>{"./build", "../src/"});
+    CHECK(detect("/src/main.cpp:42:7: error") == vector<string>{"/src/main.cpp"});
+    CHECK(detect("--config=/etc/x.yml.") == vector<string>{"/etc/x.yml"});
+    CHECK(detect("PATH=/usr/bin:/bin") == vector<string>{"/usr/bin", "/bin"});
+    CHECK(detect("(/tmp/a)") == vector<string>{"/tmp/a"});
+}
+
+TEST_CASE("LinkDetector.no_paths", "[links]")
+{
+    CHECK(detect("/").empty());
+    CHECK(detect("// comment").empty());
+    CHECK(detect("and/or 1/2").empty());
+    CHECK(detect("~ . .. ./ ~/").empty());
+    CHECK(detect("a./b").empty());
+}
+
+TEST_CASE("LinkDetector.empty_cells", "[links]")
+{
+    // Empty cells separate links just like blanks.
+    auto detector = LinkDetector{};
+    auto column = 0;
+    for (char32_t const ch: std::u32string_view(U"/a/b"))
+        detector.feed(++column, ch);
+    detector.feed(++column, 0);
+    for (char32_t const ch: std::u32string_view(U"/c"))
+        detector.feed(++column, ch);
+    CHECK(detector.finish() == vector<DetectedLink>{DetectedLink{1, 4}, DetectedLink{6, 7}});
+
+    // The detector is reset for the next line.
+    detector.feed(1, U'x');
+    CHECK(detector.finish().empty());
+}
@@ -0,0 +1,34 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/Metrics.h>
+
+#include <fmt/format.h>
+
+using std::string;
+
+namespace terminal {
+
+string Metrics::dump() const
+{
+    string out;
+    for (auto const& [function, freq] : ordered())
+        out += fmt::format("{:>12} {:<10} {:<20} {}\n", freq, function->mnemonic, *function, function->comment);
+
+    if (auto const unknownFreq = unknownCount(); unknownFreq != 0)
+        out += fmt::format("{:>12} {:<10}\n", unknownFreq, "(unknown)");
+
+    return out;
+}
+
+} // end namespace
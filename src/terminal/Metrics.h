@@ -13,40 +13,98 @@
  */
 #pragma once
 
-#include <terminal/Sequencer.h> // Sequence
+#include <terminal/Functions.h>
 
 #include <algorithm>
-#include <map>
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace terminal {
 
 /// Used for collecting VT sequence usage metrics.
-struct Metrics {
-    // XXX Too bad the key is a string.
-    std::map<std::string, uint64_t> sequences;
+///
+/// Counters are indexed by the position of the FunctionDefinition within functions(),
+/// so counting a sequence neither allocates nor formats anything.
+///
+/// Counters must only be incremented by a single thread (the one processing the VT stream),
+/// but may be read from any other thread at any time.
+class Metrics {
+  public:
+    static constexpr size_t FunctionCount = std::tuple_size_v<std::decay_t<decltype(functions())>>;
 
-    void operator()(Sequence const& _seq)
+    Metrics() = default;
+    Metrics(Metrics const& _other) noexcept { *this = _other; }
+
+    Metrics& operator=(Metrics const& _other) noexcept
+    {
+        for (size_t i = 0; i < FunctionCount; ++i)
+            counters_[i].store(_other.counters_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        unknown_.store(_other.unknownCount(), std::memory_order_relaxed);
+        return *this;
+    }
+
+    /// Counts an invocation of the given function, which must be an element of functions().
+    void operator()(FunctionDefinition const& _function) noexcept
     {
-        sequences[_seq.text()]++;
+        if (auto const i = indexOf(_function); i < FunctionCount)
+            increment(counters_[i]);
     }
 
-    /// @returns an ordered list of collected metrics, with highest frequencey first.
-    std::vector<std::pair<std::string, uint64_t>> ordered() const
+    /// Counts a sequence that did not match any known function.
+    void unknown() noexcept { increment(unknown_); }
+
+    uint64_t count(FunctionDefinition const& _function) const noexcept
     {
-        std::vector<std::pair<std::string, uint64_t>> vec;
-        for (auto const& [name, freq] : sequences)
-            vec.emplace_back(std::pair{name, freq});
-
-        std::sort(vec.begin(), vec.end(), [](auto const& a, auto const& b) {
-            if (a.second > b.second)
-                return true;
-            if (a.second == b.second)
-                return a.first > b.first;
-            return false;
+        auto const i = indexOf(_function);
+        return i < FunctionCount ? counters_[i].load(std::memory_order_relaxed) : 0;
+    }
+
+    uint64_t unknownCount() const noexcept { return unknown_.load(std::memory_order_relaxed); }
+
+    /// @returns the total number of sequences counted, including unknown ones.
+    uint64_t total() const noexcept
+    {
+        uint64_t sum = unknownCount();
+        for (auto const& counter : counters_)
+            sum += counter.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    /// @returns an ordered list of all functions invoked at least once, with highest frequency first.
+    std::vector<std::pair<FunctionDefinition const*, uint64_t>> ordered() const
+    {
+        std::vector<std::pair<FunctionDefinition const*, uint64_t>> vec;
+        for (size_t i = 0; i < FunctionCount; ++i)
+            if (auto const freq = counters_[i].load(std::memory_order_relaxed); freq != 0)
+                vec.emplace_back(&functions()[i], freq);
+
+        std::stable_sort(vec.begin(), vec.end(), [](auto const& a, auto const& b) {
+            return a.second > b.second;
         });
         return vec;
     }
+
+    /// Formats all invoked functions, one per line, with highest frequency first.
+    std::string dump() const;
+
+  private:
+    static size_t indexOf(FunctionDefinition const& _function) noexcept
+    {
+        return static_cast<size_t>(&_function - functions().data());
+    }
+
+    static void increment(std::atomic<uint64_t>& _counter) noexcept
+    {
+        // There's only one writer, so a plain load/store pair suffices and avoids a locked instruction.
+        _counter.store(_counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<uint64_t>, FunctionCount> counters_{};
+    std::atomic<uint64_t> unknown_{};
 };
 
 } // end namespace
@@ -0,0 +1,52 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/ParseStats.h>
+
+#include <fmt/format.h>
+
+using std::string;
+
+namespace terminal {
+
+uint64_t ParseStats::batches() const noexcept
+{
+    auto total = uint64_t{0};
+    for (auto const& count: sizeClasses_)
+        total += count.load(std::memory_order_relaxed);
+    return total;
+}
+
+string ParseStats::json() const
+{
+    auto const seconds = std::chrono::duration<double>(time()).count();
+
+    // Size classes are keyed by their largest batch size, the last one also counting larger ones.
+    auto sizes = string();
+    for (size_t i = 0; i < SizeClassCount; ++i)
+        if (auto const count = batches(i); count != 0)
+            sizes += fmt::format("{}\"{}{}\": {}",
+                                 sizes.empty() ? "" : ", ",
+                                 i + 1 < SizeClassCount ? "" : ">",
+                                 i + 1 < SizeClassCount ? sizeClassLimit(i) : sizeClassLimit(i - 1),
+                                 count);
+
+    return fmt::format("{{\"bytes\": {}, \"batches\": {}, \"seconds\": {:.6f}, \"bytes_per_second\": {:.0f}, \"batch_sizes\": {{{}}}}}",
+                       bytes(),
+                       batches(),
+                       seconds,
+                       seconds > 0 ? static_cast<double>(bytes()) / seconds : 0.0,
+                       sizes);
+}
+
+} // end namespace
@@ -0,0 +1,82 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace terminal {
+
+/// Statistics of the PTY output parsed, i.e. written to the screen.
+///
+/// Output is parsed in batches, each one being what a read from the PTY returned, or what
+/// accumulated in the read pipeline meanwhile (see Terminal::enableInputPipeline()).
+///
+/// Recorded by the terminal's thread, and may be read by any thread at any time.
+class ParseStats {
+  public:
+    /// Batches are counted by size, in classes of up to 1, 2, 4, ... bytes,
+    /// the last one also counting all batches larger than that.
+    static constexpr size_t SizeClassCount = 24;
+
+    /// Records a batch of @p _bytes having taken @p _time to parse.
+    void record(size_t _bytes, std::chrono::steady_clock::duration _time) noexcept
+    {
+        bytes_.fetch_add(_bytes, std::memory_order_relaxed);
+        nanoseconds_.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(_time).count()),
+                               std::memory_order_relaxed);
+        sizeClasses_[sizeClass(_bytes)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// @returns the number of bytes parsed.
+    uint64_t bytes() const noexcept { return bytes_.load(std::memory_order_relaxed); }
+
+    /// @returns the time spent parsing.
+    std::chrono::nanoseconds time() const noexcept
+    {
+        return std::chrono::nanoseconds(nanoseconds_.load(std::memory_order_relaxed));
+    }
+
+    /// @returns the number of batches parsed.
+    uint64_t batches() const noexcept;
+
+    /// @returns the number of batches of the given size class, see SizeClassCount.
+    uint64_t batches(size_t _sizeClass) const noexcept { return sizeClasses_.at(_sizeClass).load(std::memory_order_relaxed); }
+
+    /// @returns the largest batch size of the given size class.
+    static constexpr uint64_t sizeClassLimit(size_t _sizeClass) noexcept { return uint64_t{1} << _sizeClass; }
+
+    static constexpr size_t sizeClass(size_t _bytes) noexcept
+    {
+        auto i = size_t{0};
+        while (sizeClassLimit(i) < _bytes && i + 1 < SizeClassCount)
+            ++i;
+        return i;
+    }
+
+    /// @returns a JSON object of the bytes and batches parsed, the time it took in seconds,
+    ///          the resulting throughput, and the number of batches of each size class seen.
+    std::string json() const;
+
+  private:
+    std::atomic<uint64_t> bytes_ = 0;
+    std::atomic<uint64_t> nanoseconds_ = 0;
+    std::array<std::atomic<uint64_t>, SizeClassCount> sizeClasses_{};
+};
+
+} // end namespace terminal
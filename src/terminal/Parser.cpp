@@ -18,7 +18,7 @@
 #include <crispy/overloaded.h>
 #include <crispy/indexed.h>
 
-#include <unicode/utf8.h>
+#include <unicode/convert.h>
 
 #include <array>
 #include <cctype>
@@ -28,10 +28,293 @@
 
 #include <fmt/format.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+    #include <emmintrin.h>
+    #define LIBTERMINAL_PARSER_SSE2 1
+#endif
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && (defined(__aarch64__) || defined(_M_ARM64))
+    #include <arm_neon.h>
+    #define LIBTERMINAL_PARSER_NEON 1
+#endif
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
 namespace terminal::parser {
 
 using namespace std;
 
+namespace // {{{ helper
+{
+    [[maybe_unused]] inline unsigned countTrailingZeros(uint32_t _value) noexcept
+    {
+        // Precondition: _value != 0
+#if defined(_MSC_VER)
+        unsigned long index = 0;
+        _BitScanForward(&index, _value);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(_value));
+#endif
+    }
+} // }}}
+
+size_t countPrintableAscii(uint8_t const* _begin, uint8_t const* _end) noexcept
+{
+    auto input = _begin;
+
+#if defined(__AVX2__)
+    // NB: signed comparison, so that any byte >= 0x80 is considered negative and thus rejected.
+    auto const lowerBound32 = _mm256_set1_epi8(0x1F);
+    auto const upperBound32 = _mm256_set1_epi8(0x7F);
+    while (_end - input >= 32)
+    {
+        auto const batch = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(input));
+        auto const printable = _mm256_and_si256(_mm256_cmpgt_epi8(batch, lowerBound32),
+                                                _mm256_cmpgt_epi8(upperBound32, batch));
+        auto const mask = static_cast<uint32_t>(_mm256_movemask_epi8(printable));
+        if (mask != 0xFFFFFFFFu)
+            return static_cast<size_t>(input - _begin) + countTrailingZeros(~mask);
+        input += 32;
+    }
+#endif
+
+#if defined(LIBTERMINAL_PARSER_SSE2)
+    auto const lowerBound = _mm_set1_epi8(0x1F);
+    auto const upperBound = _mm_set1_epi8(0x7F);
+    while (_end - input >= 16)
+    {
+        auto const batch = _mm_loadu_si128(reinterpret_cast<__m128i const*>(input));
+        auto const printable = _mm_and_si128(_mm_cmpgt_epi8(batch, lowerBound),
+                                             _mm_cmplt_epi8(batch, upperBound));
+        auto const mask = static_cast<uint32_t>(_mm_movemask_epi8(printable));
+        if (mask != 0xFFFFu)
+            return static_cast<size_t>(input - _begin) + countTrailingZeros(~mask);
+        input += 16;
+    }
+#elif defined(LIBTERMINAL_PARSER_NEON)
+    auto const lowerBound = vdupq_n_u8(0x1F);
+    auto const upperBound = vdupq_n_u8(0x7F);
+    while (_end - input >= 16)
+    {
+        uint8x16_t const batch = vld1q_u8(input);
+        uint8x16_t const printable = vandq_u8(vcgtq_u8(batch, lowerBound), vcltq_u8(batch, upperBound));
+        if (vminvq_u8(printable) != 0xFF)
+            break; // let the scalar loop below find the exact position
+        input += 16;
+    }
+#endif
+
+    while (input != _end && isPrintableAscii(*input))
+        ++input;
+
+    return static_cast<size_t>(input - _begin);
+}
+
+size_t countNonAscii(uint8_t const* _begin, uint8_t const* _end) noexcept
+{
+    auto input = _begin;
+
+#if defined(LIBTERMINAL_PARSER_SSE2)
+    while (_end - input >= 16)
+    {
+        auto const batch = _mm_loadu_si128(reinterpret_cast<__m128i const*>(input));
+        auto const mask = static_cast<uint32_t>(_mm_movemask_epi8(batch));
+        if (mask != 0xFFFFu)
+            return static_cast<size_t>(input - _begin) + countTrailingZeros(~mask);
+        input += 16;
+    }
+#elif defined(LIBTERMINAL_PARSER_NEON)
+    while (_end - input >= 16)
+    {
+        if (vminvq_u8(vld1q_u8(input)) < 0x80)
+            break;
+        input += 16;
+    }
+#endif
+
+    while (input != _end && *input >= 0x80)
+        ++input;
+
+    return static_cast<size_t>(input - _begin);
+}
+
+size_t countDiscardable(uint8_t const* _begin, uint8_t const* _end) noexcept
+{
+    auto const discardable = [](uint8_t _byte) constexpr {
+        return _byte != 0x07 && _byte != 0x18 && _byte != 0x1A && _byte != 0x1B && _byte != 0xC2;
+    };
+
+    auto input = _begin;
+
+#if defined(LIBTERMINAL_PARSER_SSE2)
+    auto const bel = _mm_set1_epi8(0x07);
+    auto const can = _mm_set1_epi8(0x18);
+    auto const sub = _mm_set1_epi8(0x1A);
+    auto const esc = _mm_set1_epi8(0x1B);
+    auto const c1 = _mm_set1_epi8(static_cast<char>(0xC2));
+    while (_end - input >= 16)
+    {
+        auto const batch = _mm_loadu_si128(reinterpret_cast<__m128i const*>(input));
+        auto const terminators = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(batch, bel), _mm_cmpeq_epi8(batch, can)),
+                                              _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(batch, sub), _mm_cmpeq_epi8(batch, esc)),
+                                                           _mm_cmpeq_epi8(batch, c1)));
+        auto const mask = static_cast<uint32_t>(_mm_movemask_epi8(terminators));
+        if (mask != 0)
+            return static_cast<size_t>(input - _begin) + countTrailingZeros(mask);
+        input += 16;
+    }
+#elif defined(LIBTERMINAL_PARSER_NEON)
+    while (_end - input >= 16)
+    {
+        uint8x16_t const batch = vld1q_u8(input);
+        uint8x16_t const terminators = vorrq_u8(vorrq_u8(vceqq_u8(batch, vdupq_n_u8(0x07)), vceqq_u8(batch, vdupq_n_u8(0x18))),
+                                                vorrq_u8(vorrq_u8(vceqq_u8(batch, vdupq_n_u8(0x1A)), vceqq_u8(batch, vdupq_n_u8(0x1B))),
+                                                         vceqq_u8(batch, vdupq_n_u8(0xC2))));
+        if (vmaxvq_u8(terminators) != 0)
+            break; // let the scalar loop below find the exact position
+        input += 16;
+    }
+#endif
+
+    while (input != _end && discardable(*input))
+        ++input;
+
+    return static_cast<size_t>(input - _begin);
+}
+
+// {{{ Utf8Decoder
+u32string_view Utf8Decoder::decode(uint8_t const* _begin, uint8_t const* _end)
+{
+    // Each input byte yields at most one codepoint, plus one replacement character
+    // for a sequence that has been left incomplete by the previous chunk.
+    codepoints_.resize(static_cast<size_t>(_end - _begin) + 1);
+
+    auto output = codepoints_.data();
+    auto input = _begin;
+
+    while (input != _end)
+    {
+        if (!remaining_ && *input < 0x80)
+        {
+#if defined(LIBTERMINAL_PARSER_SSE2)
+            // Widen blocks of US-ASCII straight into codepoints.
+            auto const zero = _mm_setzero_si128();
+            while (_end - input >= 16)
+            {
+                auto const batch = _mm_loadu_si128(reinterpret_cast<__m128i const*>(input));
+                if (_mm_movemask_epi8(batch))
+                    break;
+                auto const lo = _mm_unpacklo_epi8(batch, zero);
+                auto const hi = _mm_unpackhi_epi8(batch, zero);
+                auto const out = reinterpret_cast<__m128i*>(output);
+                _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(lo, zero));
+                _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+                _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+                _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+                input += 16;
+                output += 16;
+            }
+#elif defined(LIBTERMINAL_PARSER_NEON)
+            while (_end - input >= 16)
+            {
+                uint8x16_t const batch = vld1q_u8(input);
+                if (vmaxvq_u8(batch) >= 0x80)
+                    break;
+                uint16x8_t const lo = vmovl_u8(vget_low_u8(batch));
+                uint16x8_t const hi = vmovl_u8(vget_high_u8(batch));
+                auto const out = reinterpret_cast<uint32_t*>(output);
+                vst1q_u32(out + 0, vmovl_u16(vget_low_u16(lo)));
+                vst1q_u32(out + 4, vmovl_u16(vget_high_u16(lo)));
+                vst1q_u32(out + 8, vmovl_u16(vget_low_u16(hi)));
+                vst1q_u32(out + 12, vmovl_u16(vget_high_u16(hi)));
+                input += 16;
+                output += 16;
+            }
+#endif
+            while (input != _end && *input < 0x80)
+                *output++ = *input++;
+            continue;
+        }
+
+        output = decodeByte(output, *input++);
+    }
+
+    codepoints_.resize(static_cast<size_t>(output - codepoints_.data()));
+    return codepoints_;
+}
+
+char32_t* Utf8Decoder::decodeByte(char32_t* _output, uint8_t _byte) noexcept
+{
+    if (remaining_)
+    {
+        if (lowerBound_ <= _byte && _byte <= upperBound_)
+        {
+            codepoint_ = (codepoint_ << 6) | (_byte & 0x3F);
+            lowerBound_ = 0x80;
+            upperBound_ = 0xBF;
+            if (--remaining_ == 0)
+                *_output++ = codepoint_;
+            return _output;
+        }
+
+        // The sequence got interrupted. Replace what we've got so far,
+        // and process the current byte as the start of a new sequence.
+        reset();
+        *_output++ = ReplacementCharacter;
+    }
+
+    // See Unicode Standard, Table 3-7 (Well-Formed UTF-8 Byte Sequences).
+    if (_byte < 0x80)
+        *_output++ = _byte;
+    else if (0xC2 <= _byte && _byte <= 0xDF)
+    {
+        codepoint_ = _byte & 0x1F;
+        remaining_ = 1;
+    }
+    else if (0xE0 <= _byte && _byte <= 0xEF)
+    {
+        codepoint_ = _byte & 0x0F;
+        remaining_ = 2;
+        if (_byte == 0xE0)
+            lowerBound_ = 0xA0; // overlong
+        else if (_byte == 0xED)
+            upperBound_ = 0x9F; // surrogates
+    }
+    else if (0xF0 <= _byte && _byte <= 0xF4)
+    {
+        codepoint_ = _byte & 0x07;
+        remaining_ = 3;
+        if (_byte == 0xF0)
+            lowerBound_ = 0x90; // overlong
+        else if (_byte == 0xF4)
+            upperBound_ = 0x8F; // beyond U+10FFFF
+    }
+    else
+        *_output++ = ReplacementCharacter; // stray continuation byte or invalid lead byte
+
+    return _output;
+}
+// }}}
+
+void Parser::collectOSC(char32_t _char)
+{
+    spillOSC();
+
+    char u8[4];
+    auto const count = static_cast<size_t>(distance(u8, unicode::encoder<char>{}(_char, u8)));
+    if (oscSpill_.size() + count <= MaxOscLength)
+        oscSpill_.append(u8, count);
+    else
+        discardOSC();
+}
+
 using Transition = pair<State, State>;
 using Range = ParserTable::Range;
 using RangeSet = std::vector<Range>;
@@ -119,4 +402,15 @@ void dot(std::ostream& _os, ParserTable const& _table)
     _os << "}\n";
 }
 
+}  // namespace terminal::parser
+
+namespace terminal {
+
+void ParserEvents::putOSC(std::string_view _chars)
+{
+    auto decoder = parser::Utf8Decoder{};
+    for (char32_t const ch : decoder.decode(_chars))
+        putOSC(ch);
+}
+
 }  // namespace terminal
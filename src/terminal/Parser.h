@@ -17,10 +17,10 @@
 #include <terminal/ParserEvents.h>
 
 #include <crispy/overloaded.h>
+#include <crispy/profiler.h>
 #include <crispy/range.h>
 
-#include <unicode/utf8.h>
-
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <functional>
@@ -699,11 +699,156 @@ constexpr ParserTable ParserTable::get() // {{{
     }
 
     // TODO: verify the above is correct (programatically as much as possible)
-    // TODO: see if we can reduce the preassure on L2 caches (is this even an issue?)
 
     return t;
 } // }}}
 
+/// ParserTable packed for looking up how to handle an input with a single table access.
+///
+/// Inputs that are treated alike in every state share a byte class, which reduces
+/// the 257 inputs of ParserTable to a few columns. Each (state, byte class) cell
+/// holds the next state along with all the actions to be invoked, so that the whole
+/// table fits into a few cache lines.
+struct PackedParserTable {
+    struct Step {
+        State next = State::Undefined;       //!< State::Undefined if the state does not change.
+        Action action = Action::Undefined;   //!< Transition or event action.
+        Action exit = Action::Undefined;     //!< Exit action of the current state, if changing state.
+        Action entry = Action::Undefined;    //!< Entry action of the next state, if changing state.
+    };
+
+    static constexpr size_t MaxByteClassCount = 32;
+
+    //! Byte class of each input, UnicodeCodepoint::Value standing in for all non-ASCII codepoints.
+    std::array<uint8_t, 257> byteClasses{};
+
+    std::array<std::array<Step, MaxByteClassCount>, std::numeric_limits<State>::size()> steps{};
+
+    size_t byteClassCount = 0;
+
+    /// @returns @p _table packed, or a table with byteClassCount exceeding MaxByteClassCount
+    ///          if it cannot be.
+    static constexpr PackedParserTable pack(ParserTable const& _table);
+
+    constexpr Step const& step(State _state, size_t _input) const noexcept
+    {
+        return steps[static_cast<size_t>(_state)][byteClasses[_input]];
+    }
+};
+
+constexpr PackedParserTable PackedParserTable::pack(ParserTable const& _table) // {{{
+{
+    auto packed = PackedParserTable{};
+
+    auto const equivalent = [&](size_t a, size_t b) constexpr {
+        for (size_t s = 0; s < std::numeric_limits<State>::size(); ++s)
+            if (_table.transitions[s][a] != _table.transitions[s][b]
+                || _table.events[s][a] != _table.events[s][b])
+                return false;
+        return true;
+    };
+
+    // Each input is represented by the first input of its byte class.
+    auto representatives = std::array<size_t, 257>{};
+    for (size_t input = 0; input < packed.byteClasses.size(); ++input)
+    {
+        size_t byteClass = 0;
+        while (byteClass < packed.byteClassCount && !equivalent(representatives[byteClass], input))
+            ++byteClass;
+
+        if (byteClass == packed.byteClassCount)
+        {
+            if (++packed.byteClassCount > MaxByteClassCount)
+                return packed;
+            representatives[byteClass] = input;
+        }
+        packed.byteClasses[input] = static_cast<uint8_t>(byteClass);
+    }
+
+    for (size_t s = 0; s < std::numeric_limits<State>::size(); ++s)
+    {
+        for (size_t byteClass = 0; byteClass < packed.byteClassCount; ++byteClass)
+        {
+            auto const input = representatives[byteClass];
+            auto& step = packed.steps[s][byteClass];
+            step.next = _table.transitions[s][input];
+            step.action = _table.events[s][input];
+            if (step.next != State::Undefined)
+            {
+                step.exit = _table.exitEvents[s];
+                step.entry = _table.entryEvents[static_cast<size_t>(step.next)];
+            }
+        }
+    }
+
+    return packed;
+} // }}}
+
+/// @returns true if @p _byte is a printable US-ASCII character (0x20..0x7E).
+constexpr bool isPrintableAscii(uint8_t _byte) noexcept
+{
+    return 0x20 <= _byte && _byte <= 0x7E;
+}
+
+/// Counts the number of leading printable US-ASCII characters (0x20..0x7E) in [_begin, _end).
+///
+/// This is using SIMD instructions (AVX2, SSE2, or NEON) where available,
+/// and falls back to a scalar implementation otherwise.
+size_t countPrintableAscii(uint8_t const* _begin, uint8_t const* _end) noexcept;
+
+/// Counts the number of leading non-US-ASCII bytes (0x80..0xFF) in [_begin, _end).
+size_t countNonAscii(uint8_t const* _begin, uint8_t const* _end) noexcept;
+
+/// Counts the number of leading bytes in [_begin, _end) that cannot terminate a control string,
+/// that is, any byte but BEL, CAN, SUB, ESC, and 0xC2 (the UTF-8 lead byte of ST and other C1 controls).
+size_t countDiscardable(uint8_t const* _begin, uint8_t const* _end) noexcept;
+
+/// Block UTF-8 decoder, used as decoding stage ahead of the VT parser's state machine.
+///
+/// Each call to decode() turns a chunk of UTF-8 bytes into a sequence of codepoints,
+/// stored in a buffer that is reused across calls. Sequences split across chunk boundaries
+/// (e.g. across two PTY reads) are carried over into the next call.
+///
+/// Malformed input (invalid lead bytes, overlong encodings, surrogates, codepoints beyond
+/// U+10FFFF, and truncated sequences) is replaced with U+FFFD, one per maximal subpart
+/// of an ill-formed sequence.
+class Utf8Decoder {
+  public:
+    static constexpr char32_t ReplacementCharacter = 0xFFFD;
+
+    /// Decodes the bytes in [_begin, _end).
+    ///
+    /// @returns a view to the decoded codepoints, valid until the next call to decode().
+    std::u32string_view decode(uint8_t const* _begin, uint8_t const* _end);
+
+    std::u32string_view decode(std::string_view _bytes)
+    {
+        auto const p = reinterpret_cast<uint8_t const*>(_bytes.data());
+        return decode(p, p + _bytes.size());
+    }
+
+    /// @returns true if a multi-byte sequence has been started but not yet completed.
+    constexpr bool pending() const noexcept { return remaining_ != 0; }
+
+    /// Discards any partially decoded sequence.
+    constexpr void reset() noexcept
+    {
+        codepoint_ = 0;
+        remaining_ = 0;
+        lowerBound_ = 0x80;
+        upperBound_ = 0xBF;
+    }
+
+  private:
+    char32_t* decodeByte(char32_t* _output, uint8_t _byte) noexcept;
+
+    char32_t codepoint_ = 0;
+    uint8_t remaining_ = 0;     // number of continuation bytes still expected
+    uint8_t lowerBound_ = 0x80; // valid range of the next continuation byte
+    uint8_t upperBound_ = 0xBF;
+    std::u32string codepoints_;
+};
+
 /**
  * Terminal Parser.
  *
@@ -718,6 +863,12 @@ class Parser {
     using ParseError = std::function<void(std::string const&)>;
     using iterator = uint8_t const*;
 
+    /// Upper limit of an OSC control string, beyond which it is discarded.
+    size_t constexpr static MaxOscLength = 1024 * 1024;
+
+    /// Default upper limit of a DCS data string, see setMaxDcsLength().
+    size_t constexpr static DefaultMaxDcsLength = 64 * 1024 * 1024;
+
     explicit Parser(ParserEvents& _listener) :
         eventListener_{ _listener }
     {
@@ -739,68 +890,172 @@ class Parser {
     {
         for (auto const codepoint : s)
             processInput(codepoint);
+        spillOSC();
     }
 
+    /// Sets the number of characters of a DCS data string to be passed on to the listener at most.
+    /// The remainder of a longer data string is discarded.
+    void setMaxDcsLength(size_t _value) noexcept { maxDcsLength_ = _value; }
+    size_t maxDcsLength() const noexcept { return maxDcsLength_; }
+
+    /// Gives back the memory of buffers grown by large control strings, unless still in use.
+    void trimMemory()
+    {
+        if (oscSpill_.empty())
+            oscSpill_.shrink_to_fit();
+    }
+
+    /// @returns true if the data of the current control string is being skipped,
+    ///          up to the control string's terminator.
+    bool discarding() const noexcept { return discarding_ || state_ == State::SOS_PM_APC_String; }
+
   private:
     void processInput(char32_t _ch);
     void handle(ActionClass _actionClass, Action _action, char32_t _char);
 
+    void collectOSC(std::string_view _chars);
+    void collectOSC(char32_t _char);
+    void spillOSC();
+    void discardOSC();
+
+    void putDCS(std::string_view _chars);
+    void discardDCS();
+
   private:
     State state_ = State::Ground;
-    unicode::utf8_decoder_state utf8DecoderState_{};
+    Utf8Decoder utf8Decoder_{};
+
+    // The OSC control string is passed to the listener in one piece when it is terminated.
+    // As long as it is entirely contained in the current input fragment, it is referenced
+    // as oscString_. Otherwise it is copied into oscSpill_, which is reused across OSC strings.
+    std::string_view oscString_{};
+    std::string oscSpill_{};
+
+    // Unsupported or oversized control strings are skipped rather than passed on character by
+    // character, up to whatever terminates them. Control strings that are ignored by the state
+    // machine anyway (SOS, PM, and APC) are always skipped.
+    bool discarding_ = false;
+    size_t dcsLength_ = 0;
+    size_t maxDcsLength_ = DefaultMaxDcsLength;
 
     ParserEvents& eventListener_;
 };
 
 inline void Parser::parseFragment(iterator _begin, iterator _end)
 {
-    static constexpr char32_t ReplacementCharacter {0xFFFD};
+    CRISPY_PROFILE_ZONE("Parser::parseFragment");
+
+    auto input = _begin;
+    while (input != _end)
+    {
+        if (!utf8Decoder_.pending() && discarding())
+        {
+            input += countDiscardable(input, _end);
+            if (input == _end)
+                break;
+        }
+
+        if (!utf8Decoder_.pending() && *input < 0x80)
+        {
+            // Fast path: consume runs of printable US-ASCII characters without going through
+            // the state transition table, as they're always printed.
+            // The same goes for the characters of OSC and DCS control strings.
+            if (isPrintableAscii(*input) && (state_ == State::Ground
+                                             || state_ == State::OSC_String
+                                             || state_ == State::DCS_PassThrough))
+            {
+                auto const count = countPrintableAscii(input, _end);
+                auto const chars = std::string_view(reinterpret_cast<char const*>(input), count);
+                switch (state_)
+                {
+                    case State::Ground: eventListener_.print(chars); break;
+                    case State::OSC_String: collectOSC(chars); break;
+                    default: putDCS(chars); break;
+                }
+                input += count;
+            }
+            else
+                processInput(*input++);
+            continue;
+        }
+
+        // Decode the whole stretch of multi-byte UTF-8 up to the next US-ASCII byte at once
+        // (the first byte may be US-ASCII itself, if it terminates an incomplete sequence).
+        auto const next = std::next(input) + countNonAscii(std::next(input), _end);
+        for (char32_t const codepoint : utf8Decoder_.decode(input, next))
+            processInput(codepoint);
+        input = next;
+    }
+
+    // The input fragment is not guaranteed to outlive this call.
+    spillOSC();
+}
 
-    for (auto const current : crispy::range(_begin, _end))
+inline void Parser::collectOSC(std::string_view _chars)
+{
+    // Only one of both is in use at a time.
+    if (oscString_.size() + oscSpill_.size() + _chars.size() > MaxOscLength)
+        discardOSC();
+    else if (oscString_.empty() && oscSpill_.empty())
+        oscString_ = _chars;
+    else
     {
-#if 0
-        std::visit(
-            overloaded{
-                [&](unicode::Incomplete) {},
-                [&](unicode::Invalid) {
-                    eventListener_.error("Invalid UTF-8 byte sequence received.");
-                    processInput(ReplacementCharacter);
-                },
-                [&](unicode::Success const& success) {
-                    // std::cout << fmt::format("VTParser.parse: ch = {:04X}\n", static_cast<unsigned>(success.value));
-                    processInput(success.value);
-                },
-            },
-            unicode::from_utf8(utf8DecoderState_, current)
-        );
-#else
-        unicode::ConvertResult const r = unicode::from_utf8(utf8DecoderState_, current);
-        if (std::holds_alternative<unicode::Success>(r))
-            processInput(std::get<unicode::Success>(r).value);
-        else if (std::holds_alternative<unicode::Invalid>(r))
-            processInput(ReplacementCharacter);
-#endif
+        spillOSC();
+        oscSpill_.append(_chars);
     }
 }
 
-inline void Parser::processInput(char32_t _ch)
+inline void Parser::spillOSC()
 {
-    auto const s = static_cast<size_t>(state_);
+    if (oscString_.empty())
+        return;
+
+    oscSpill_.append(oscString_);
+    oscString_ = {};
+}
 
-    ParserTable static constexpr table = ParserTable::get();
+inline void Parser::discardOSC()
+{
+    oscString_ = {};
+    oscSpill_.clear();
+    discarding_ = true;
+    eventListener_.error("Discarding OSC control string exceeding the maximum length.");
+}
+
+inline void Parser::putDCS(std::string_view _chars)
+{
+    auto const count = std::min(_chars.size(), maxDcsLength_ - std::min(maxDcsLength_, dcsLength_));
+    if (count)
+        eventListener_.put(_chars.substr(0, count));
+    dcsLength_ += count;
+
+    if (count < _chars.size())
+        discardDCS();
+}
+
+inline void Parser::discardDCS()
+{
+    discarding_ = true;
+    eventListener_.error("Discarding the remainder of a DCS data string exceeding the maximum length.");
+}
+
+inline void Parser::processInput(char32_t _ch)
+{
+    PackedParserTable static constexpr table = PackedParserTable::pack(ParserTable::get());
+    static_assert(table.byteClassCount <= PackedParserTable::MaxByteClassCount,
+                  "Parser table has too many byte classes to be packed.");
 
     auto const ch = _ch < 0xFF ? _ch : static_cast<char32_t>(ParserTable::UnicodeCodepoint::Value);
 
-    if (auto const t = table.transitions[s][ch]; t != State::Undefined)
+    if (auto const& step = table.step(state_, ch); step.next != State::Undefined)
     {
-        // handle(_actionClass, _action, currentChar());
-        handle(ActionClass::Leave, table.exitEvents[s], _ch);
-        handle(ActionClass::Transition, table.events[s][ch], _ch);
-        state_ = t;
-        handle(ActionClass::Enter, table.entryEvents[static_cast<size_t>(t)], _ch);
+        handle(ActionClass::Leave, step.exit, _ch);
+        handle(ActionClass::Transition, step.action, _ch);
+        state_ = step.next;
+        handle(ActionClass::Enter, step.entry, _ch);
     }
-    else if (Action const a = table.events[s][ch]; a != Action::Undefined)
-        handle(ActionClass::Event, a, _ch);
+    else if (step.action != Action::Undefined)
+        handle(ActionClass::Event, step.action, _ch);
     else
     {
         if (ch < 128)
@@ -841,22 +1096,45 @@ inline void Parser::handle(ActionClass _actionClass, Action _action, char32_t _c
             eventListener_.print(_char);
             break;
         case Action::OSC_Start:
+            oscString_ = {};
+            oscSpill_.clear();
             eventListener_.startOSC();
             break;
         case Action::OSC_Put:
-            eventListener_.putOSC(_char);
+            if (!discarding_)
+                collectOSC(_char);
             break;
         case Action::OSC_End:
-            eventListener_.dispatchOSC();
+            if (discarding_)
+                discarding_ = false;
+            else
+            {
+                if (!oscString_.empty())
+                    eventListener_.putOSC(oscString_);
+                else if (!oscSpill_.empty())
+                    eventListener_.putOSC(oscSpill_);
+                eventListener_.dispatchOSC();
+            }
+            oscString_ = {};
             break;
         case Action::Hook:
-            eventListener_.hook(static_cast<char>(_char));
+            discarding_ = !eventListener_.hook(static_cast<char>(_char));
+            dcsLength_ = 0;
             break;
         case Action::Put:
-            eventListener_.put(_char);
+            if (discarding_)
+                break;
+            else if (dcsLength_ >= maxDcsLength_)
+                discardDCS();
+            else
+            {
+                ++dcsLength_;
+                eventListener_.put(_char);
+            }
             break;
         case Action::Unhook:
             eventListener_.unhook();
+            discarding_ = false;
             break;
         case Action::Ignore:
         case Action::Undefined:
@@ -39,6 +39,19 @@ class ParserEvents {
      */
     virtual void print(char32_t _text) = 0;
 
+    /**
+     * Bulk variant of print(char32_t) for a run of printable US-ASCII characters (0x20..0x7E).
+     *
+     * This is invoked by the parser in ground state for consecutive text that does not need
+     * any UTF-8 decoding, allowing the receiver to process the whole run at once.
+     * The default implementation forwards each character to print(char32_t).
+     */
+    virtual void print(std::string_view _chars)
+    {
+        for (char const ch : _chars)
+            print(static_cast<char32_t>(ch));
+    }
+
     /**
      * The C0 or C1 control function should be executed, which may have any one of a variety of
      * effects, including changing the cursor position, suspending or resuming communications or
@@ -110,6 +123,16 @@ class ParserEvents {
      */
     virtual void putOSC(char32_t _char) = 0;
 
+    /**
+     * Bulk variant of putOSC(char32_t), passing the UTF-8 encoded control string at once.
+     *
+     * The parser invokes this once per OSC right before dispatchOSC(). The characters are
+     * either referring to the parser's input directly or to an internal buffer, and are only
+     * guaranteed to be valid until dispatchOSC() returns.
+     * The default implementation decodes the string and forwards each character to putOSC(char32_t).
+     */
+    virtual void putOSC(std::string_view _chars);
+
     /**
      * This action is called when the OSC string is terminated by ST, CAN, SUB or ESC,
      * to allow the OSC handler to finish neatly.
@@ -123,8 +146,11 @@ class ParserEvents {
      * selects a handler function for the rest of the characters in the control string. This
      * handler function will be called by the put action for every character in the control
      * string as it arrives.
+     *
+     * @retval true  the data string is to be passed on by put().
+     * @retval false the control function is not supported, and its data string is discarded.
      */
-    virtual void hook(char _function) = 0;
+    virtual bool hook(char _function) = 0;
 
     /**
      * This action passes characters from the data string part of a device control string to a
@@ -133,6 +159,18 @@ class ParserEvents {
      */
     virtual void put(char32_t _char) = 0;
 
+    /**
+     * Bulk variant of put(char32_t) for a run of printable US-ASCII characters (0x20..0x7E).
+     *
+     * The characters are referring to the parser's input and are only valid during this call.
+     * The default implementation forwards each character to put(char32_t).
+     */
+    virtual void put(std::string_view _chars)
+    {
+        for (char const ch : _chars)
+            put(static_cast<char32_t>(ch));
+    }
+
     /**
      * When a device control string is terminated by ST, CAN, SUB or ESC, this action calls the
      * previously selected handler function with an “end of data” parameter. This allows the
@@ -155,7 +193,7 @@ class BasicParserEvents : public ParserEvents {
     void startOSC() override {}
     void putOSC(char32_t) override {}
     void dispatchOSC() override {}
-    void hook(char) override {}
+    bool hook(char) override { return true; }
     void put(char32_t) override {}
     void unhook() override {}
 };
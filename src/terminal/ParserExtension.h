@@ -2,6 +2,7 @@
 
 #include <functional>
 #include <string>
+#include <string_view>
 
 namespace terminal {
 
@@ -17,6 +18,15 @@ class ParserExtension
 
     virtual void start() = 0;
     virtual void pass(char32_t _char) = 0;
+
+    /// Passes a run of printable US-ASCII characters at once.
+    ///
+    /// The characters are only valid during this call.
+    virtual void pass(std::string_view _chars)
+    {
+        for (char const ch : _chars)
+            pass(static_cast<char32_t>(ch));
+    }
     virtual void finalize() = 0;
 };
 
@@ -38,6 +48,11 @@ class SimpleStringCollector : public ParserExtension
         data_.push_back(_char);
     }
 
+    void pass(std::string_view _chars) override
+    {
+        data_.append(_chars.begin(), _chars.end());
+    }
+
     void finalize() override
     {
         if (done_)
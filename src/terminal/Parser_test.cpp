@@ -16,6 +16,7 @@
 
 using namespace std;
 using namespace terminal;
+using namespace std::string_view_literals;
 
 class MockParserEvents : public terminal::BasicParserEvents {
   public:
@@ -23,6 +24,14 @@ class MockParserEvents : public terminal::BasicParserEvents {
 
     void error(string_view const& _msg) override { INFO(fmt::format("Parser error received. {}", _msg)); }
     void print(char32_t _ch) override { text.push_back(_ch); }
+    void print(string_view _chars) override { for (char const ch : _chars) text.push_back(static_cast<char32_t>(ch)); }
+
+    std::vector<std::string> osc;
+    void putOSC(string_view _chars) override { osc.emplace_back(_chars); }
+
+    std::string dcs;
+    void put(char32_t _ch) override { dcs.push_back(static_cast<char>(_ch)); }
+    void put(string_view _chars) override { dcs += _chars; }
 };
 
 TEST_CASE("Parser.utf8_single", "[Parser]")
@@ -36,3 +45,248 @@ TEST_CASE("Parser.utf8_single", "[Parser]")
     CHECK(0xF6 == static_cast<unsigned>(textListener.text.at(0)));
 }
 
+
+TEST_CASE("Parser.countPrintableAscii", "[Parser]")
+{
+    auto const count = [](string_view s) {
+        auto const p = reinterpret_cast<uint8_t const*>(s.data());
+        return parser::countPrintableAscii(p, p + s.size());
+    };
+
+    CHECK(count("") == 0);
+    CHECK(count("\033[m") == 0);
+    CHECK(count("Hello") == 5);
+    CHECK(count("Hello\r\n") == 5);
+    CHECK(count("0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF") == 48);
+    CHECK(count("0123456789ABCDEF0123456789ABCDE\x7F") == 31);
+    CHECK(count("0123456789ABCDEF0123456789ABCDEF\xC3\xB6") == 32);
+    CHECK(count("0123456789ABCDEF01234\t") == 21);
+}
+
+TEST_CASE("Parser.ascii_run", "[Parser]")
+{
+    MockParserEvents textListener;
+    auto p = parser::Parser(textListener);
+
+    auto const text = "The quick brown fox jumps over the lazy dog. 0123456789"sv;
+    p.parseFragment(text);
+
+    REQUIRE(textListener.text.size() == text.size());
+    for (size_t i = 0; i < text.size(); ++i)
+        CHECK(static_cast<char32_t>(text[i]) == textListener.text.at(i));
+}
+
+TEST_CASE("Parser.ascii_run_interrupted", "[Parser]")
+{
+    MockParserEvents textListener;
+    auto p = parser::Parser(textListener);
+
+    // Text within escape sequences must not be printed, text around it must be.
+    p.parseFragment("Hello, \033[1;31mWorld\033]2;title\033\\!\xC3\xB6");
+
+    CHECK(textListener.text == std::vector<char32_t>{
+        'H', 'e', 'l', 'l', 'o', ',', ' ', 'W', 'o', 'r', 'l', 'd', '!', 0xF6
+    });
+}
+
+TEST_CASE("Parser.ascii_run_after_split_utf8", "[Parser]")
+{
+    MockParserEvents textListener;
+    auto p = parser::Parser(textListener);
+
+    p.parseFragment("A\xC3");
+    p.parseFragment("\xB6" "BC");
+
+    CHECK(textListener.text == std::vector<char32_t>{ 'A', 0xF6, 'B', 'C' });
+}
+
+TEST_CASE("Parser.utf8_invalid", "[Parser]")
+{
+    MockParserEvents textListener;
+    auto p = parser::Parser(textListener);
+
+    // truncated sequence followed by US-ASCII, and a stray continuation byte
+    p.parseFragment("\xE2\x82" "A\x80" "B");
+
+    CHECK(textListener.text == std::vector<char32_t>{ 0xFFFD, 'A', 0xFFFD, 'B' });
+}
+
+TEST_CASE("Utf8Decoder.decode", "[Parser]")
+{
+    auto decoder = parser::Utf8Decoder{};
+
+    CHECK(decoder.decode(""sv).empty());
+    CHECK(decoder.decode("Hello"sv) == U"Hello"sv);
+    CHECK(decoder.decode("\xC3\xB6\xE2\x94\x80\xF0\x9F\x98\x80"sv) == U"ö─\U0001F600"sv);
+
+    auto const longText = "0123456789ABCDEF0123456789ABCDEF\xE4\xB8\xAD" "0123456789ABCDEF!"sv;
+    CHECK(decoder.decode(longText) == U"0123456789ABCDEF0123456789ABCDEF中0123456789ABCDEF!"sv);
+    CHECK_FALSE(decoder.pending());
+}
+
+TEST_CASE("Utf8Decoder.split", "[Parser]")
+{
+    auto const text = "a\xC3\xB6" "b\xE2\x94\x80" "c\xF0\x9F\x98\x80" "d"sv;
+    auto const expected = U"aöb─c\U0001F600d"sv;
+
+    for (size_t i = 0; i <= text.size(); ++i)
+    {
+        INFO(fmt::format("split at {}", i));
+        auto decoder = parser::Utf8Decoder{};
+        auto decoded = std::u32string(decoder.decode(text.substr(0, i)));
+        decoded += decoder.decode(text.substr(i));
+        CHECK(decoded == expected);
+        CHECK_FALSE(decoder.pending());
+    }
+}
+
+TEST_CASE("Utf8Decoder.invalid", "[Parser]")
+{
+    auto decoder = parser::Utf8Decoder{};
+
+    // invalid lead bytes and stray continuation bytes
+    CHECK(decoder.decode("\xC0\xAF" "a\xFF" "b\xBF"sv) == U"��a�b�"sv);
+
+    // overlong encodings, surrogates, and codepoints beyond U+10FFFF
+    CHECK(decoder.decode("\xE0\x80\xAF"sv) == U"���"sv);
+    CHECK(decoder.decode("\xED\xA0\x80"sv) == U"���"sv);
+    CHECK(decoder.decode("\xF4\x90\x80\x80"sv) == U"����"sv);
+
+    // truncated sequences, also across chunk boundaries
+    CHECK(decoder.decode("\xE2\x94" "a"sv) == U"�a"sv);
+    CHECK(decoder.decode("\xF0\x9F"sv).empty());
+    CHECK(decoder.pending());
+    CHECK(decoder.decode("\xE2\x94\x80"sv) == U"�─"sv);
+    CHECK_FALSE(decoder.pending());
+}
+
+TEST_CASE("Parser.osc", "[Parser]")
+{
+    MockParserEvents listener;
+    auto p = parser::Parser(listener);
+
+    p.parseFragment("\033]8;;https://example.com/\033\\text\033]2;caf\xC3\xA9\x07");
+
+    CHECK(listener.osc == std::vector<std::string>{ "8;;https://example.com/", "2;caf\xC3\xA9" });
+    CHECK(listener.text == std::vector<char32_t>{ 't', 'e', 'x', 't' });
+}
+
+TEST_CASE("Parser.osc_split", "[Parser]")
+{
+    MockParserEvents listener;
+    auto p = parser::Parser(listener);
+
+    p.parseFragment("\033]52;c;aGVs"sv);
+    {
+        // The parser must not refer to input fragments it has returned from already.
+        auto chunk = std::string("bG8=\x07");
+        p.parseFragment(chunk);
+        std::fill(chunk.begin(), chunk.end(), 'X');
+    }
+
+    CHECK(listener.osc == std::vector<std::string>{ "52;c;aGVsbG8=" });
+}
+
+TEST_CASE("Parser.dcs", "[Parser]")
+{
+    MockParserEvents listener;
+    auto p = parser::Parser(listener);
+
+    p.parseFragment("\033P1$r0\r1m\033\\");
+
+    CHECK(listener.dcs == "0\r1m");
+}
+
+TEST_CASE("Parser.countDiscardable", "[Parser]")
+{
+    auto const count = [](string_view s) {
+        auto const p = reinterpret_cast<uint8_t const*>(s.data());
+        return parser::countDiscardable(p, p + s.size());
+    };
+
+    CHECK(count("") == 0);
+    CHECK(count("\033\\") == 0);
+    CHECK(count("0123456789ABCDEF0123456789ABCDEF") == 32);
+    CHECK(count("0123456789ABCDEF\r\n\t\x7F\x80\xFF\xC3\xB6" "012345\x07") == 30);
+    CHECK(count("0123456789ABCDEF0123456789\x18") == 26);
+    CHECK(count("0123456789ABCDEF0123456789\x1A") == 26);
+    CHECK(count("0123456789ABCDEF0123456789ABCDEF\xC2\x9C") == 32);
+}
+
+TEST_CASE("Parser.dcs_unsupported", "[Parser]")
+{
+    class Listener : public MockParserEvents {
+      public:
+        bool hook(char _function) override { return _function != 'q'; }
+    };
+    Listener listener;
+    auto p = parser::Parser(listener);
+
+    p.parseFragment("\033P1;1;0q#0;2;0;0;0#0!10~\xC3\xB6\x07-\033\\A"sv);
+    CHECK(listener.dcs.empty());
+    CHECK(listener.text == std::vector<char32_t>{ 'A' });
+
+    p.parseFragment("\033P1$r0m\033\\"sv);
+    CHECK(listener.dcs == "0m");
+}
+
+TEST_CASE("Parser.dcs_oversized", "[Parser]")
+{
+    MockParserEvents listener;
+    auto p = parser::Parser(listener);
+    p.setMaxDcsLength(4);
+
+    p.parseFragment("\033P1$r01;2"sv);
+    p.parseFragment("3m\033\\A\033P1$r0\r1m\x9C"sv);
+
+    CHECK(listener.dcs == "01;20\r1m");
+    CHECK(listener.text == std::vector<char32_t>{ 'A' });
+}
+
+TEST_CASE("Parser.osc_oversized", "[Parser]")
+{
+    MockParserEvents listener;
+    auto p = parser::Parser(listener);
+
+    p.parseFragment("\033]52;c;"sv);
+    p.parseFragment(std::string(parser::Parser::MaxOscLength, 'A'));
+    p.parseFragment("\x07" "B" "\033]2;title\033\\"sv);
+
+    CHECK(listener.osc == std::vector<std::string>{ "2;title" });
+    CHECK(listener.text == std::vector<char32_t>{ 'B' });
+}
+
+TEST_CASE("Parser.apc", "[Parser]")
+{
+    MockParserEvents listener;
+    auto p = parser::Parser(listener);
+
+    p.parseFragment("\033_Gf=100;\xC3\xB6" "AAAA\x07\x80\033\\A"sv);
+
+    CHECK(listener.text == std::vector<char32_t>{ 'A' });
+}
+
+TEST_CASE("PackedParserTable.pack", "[Parser]")
+{
+    using parser::Action;
+    using parser::State;
+
+    auto const table = parser::ParserTable::get();
+    auto const packed = parser::PackedParserTable::pack(table);
+    REQUIRE(packed.byteClassCount <= parser::PackedParserTable::MaxByteClassCount);
+
+    for (size_t s = 0; s < numeric_limits<State>::size(); ++s)
+    {
+        auto const state = static_cast<State>(s);
+        for (size_t input = 0; input < 257; ++input)
+        {
+            INFO(fmt::format("{} 0x{:02X}", state, input));
+            auto const& step = packed.step(state, input);
+            auto const next = table.transitions[s][input];
+            CHECK(step.next == next);
+            CHECK(step.action == table.events[s][input]);
+            CHECK(step.exit == (next != State::Undefined ? table.exitEvents[s] : Action::Undefined));
+            CHECK(step.entry == (next != State::Undefined ? table.entryEvents[static_cast<size_t>(next)] : Action::Undefined));
+        }
+    }
+}
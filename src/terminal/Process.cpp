@@ -30,8 +30,10 @@
 
 #if !defined(_WIN32)
 #include <utmp.h>
+#include <fcntl.h>
 #include <pwd.h>
 #include <signal.h>
+#include <spawn.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -44,6 +46,18 @@
 #include <terminal/pty/ConPty.h>
 #endif
 
+// posix_spawn() is used to create child processes where it can set up everything fork() is used for,
+// i.e. chdir (glibc 2.29+) and acquiring the controlling terminal by opening it after setsid().
+#if defined(__linux__) && defined(__GLIBC__) && defined(POSIX_SPAWN_SETSID)
+    #if __GLIBC_PREREQ(2, 29)
+        #define LIBTERMINAL_POSIX_SPAWN 1
+    #endif
+#endif
+
+#if defined(LIBTERMINAL_POSIX_SPAWN)
+extern char** environ;
+#endif
+
 using namespace std;
 
 namespace terminal {
@@ -152,6 +166,95 @@ namespace {
         return hr;
     }
 	#endif
+
+    #if defined(LIBTERMINAL_POSIX_SPAWN)
+    /// Spawns a child process without fork(), so that the time it takes does not grow
+    /// with the size of this process' address space.
+    ///
+    /// @param _argv        program arguments, including the program name.
+    /// @param _newSession  whether or not the child becomes the leader of a new session.
+    /// @param _tty         file descriptor of the terminal to become the child's controlling terminal
+    ///                     and standard input/output/error, or -1 to inherit those.
+    ///
+    /// @returns the child's process ID or -1 if the child could not be spawned.
+    pid_t spawnProcess(string const& _path,
+                       vector<string> const& _argv,
+                       FileSystem::path const& _cwd,
+                       Process::Environment const& _env,
+                       bool _newSession,
+                       int _tty)
+    {
+        char ttyName[256];
+        if (_tty >= 0 && ttyname_r(_tty, ttyName, sizeof(ttyName)) != 0)
+            return -1;
+
+        auto argv = vector<char*>{};
+        for (auto const& arg: _argv)
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+
+        auto environment = vector<string>{};
+        for (char** env = environ; *env; ++env)
+        {
+            auto const name = string_view(*env).substr(0, string_view(*env).find('='));
+            if (_env.find(string(name)) == _env.end())
+                environment.emplace_back(*env);
+        }
+        for (auto&& [name, value] : _env)
+            environment.emplace_back(name + '=' + value);
+        auto envp = vector<char*>{};
+        for (auto const& env: environment)
+            envp.push_back(const_cast<char*>(env.c_str()));
+        envp.push_back(nullptr);
+
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+        if (_newSession)
+            flags |= POSIX_SPAWN_SETSID;
+        posix_spawnattr_setflags(&attr, flags);
+
+        // reset signal(s) to default that may have been changed in the parent process.
+        sigset_t signals;
+        sigemptyset(&signals);
+        posix_spawnattr_setsigmask(&attr, &signals);
+        sigaddset(&signals, SIGPIPE);
+        posix_spawnattr_setsigdefault(&attr, &signals);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+
+        if (_tty >= 0)
+        {
+            // Opening the terminal right after setsid() makes it the controlling terminal.
+            posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, ttyName, O_RDWR, 0);
+            posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO, STDOUT_FILENO);
+            posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO, STDERR_FILENO);
+
+            // close any leaked/inherited file descriptors from parent process
+            for (int fd = 3; fd < 256; ++fd)
+                if (auto const fdFlags = fcntl(fd, F_GETFD); fdFlags >= 0 && !(fdFlags & FD_CLOEXEC))
+                    posix_spawn_file_actions_addclose(&actions, fd);
+        }
+
+        auto const cwd = _cwd.generic_string();
+        if (!cwd.empty())
+            posix_spawn_file_actions_addchdir_np(&actions, cwd.c_str());
+
+        pid_t pid = -1;
+        int const rv = posix_spawnp(&pid, _path.c_str(), &actions, &attr, argv.data(), envp.data());
+
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attr);
+
+        if (rv != 0)
+        {
+            errno = rv;
+            return -1;
+        }
+        return pid;
+    }
+    #endif
 } // anonymous namespace
 
 Process::Process(string const& _path,
@@ -161,6 +264,21 @@ Process::Process(string const& _path,
                  Pty& _pty)
 {
 #if defined(__unix__) || defined(__APPLE__)
+#if defined(LIBTERMINAL_POSIX_SPAWN)
+    if (auto const tty = _pty.slaveFileDescriptor(); tty >= 0)
+    {
+        auto argv = vector<string>{_path};
+        argv.insert(argv.end(), _args.begin(), _args.end());
+        pid_ = spawnProcess(_path, argv, _cwd, _env, true, tty);
+        if (pid_ != -1)
+        {
+            _pty.prepareParentProcess();
+            return;
+        }
+        // Falling back to fork(), also reporting the error to the terminal like it does.
+    }
+#endif
+
     pid_ = fork();
     switch (pid_)
     {
@@ -257,6 +375,12 @@ Process::Process(
 	detached_ = _detached;
 
 #if defined(__unix__) || defined(__APPLE__)
+#if defined(LIBTERMINAL_POSIX_SPAWN)
+    pid_ = spawnProcess(_path, _args, _cwd, _env, _detached, -1);
+    if (pid_ != -1)
+        return;
+#endif
+
     pid_ = fork();
     switch (pid_)
     {
@@ -13,31 +13,72 @@
  */
 #include <terminal/RenderBuffer.h>
 
-#include <mutex>
-
-#include <fmt/format.h>
+#include <algorithm>
+#include <utility>
 
 namespace terminal {
 
-bool RenderDoubleBuffer::swapBuffers(std::chrono::steady_clock::time_point _now) noexcept
+RenderPalette::RenderPalette(ColorPalette const& _palette, bool _reverseVideo) noexcept
 {
-    // If the terminal thread (writer) cannot try_lock (w/o wait time)
-    // the front buffer, it'll just flush back buffer instead of swapping
-    // buffers as the front buffer is apparently still in use by the
-    // renderer thread and we want to avoid render-thread imposed
-    // wait times in the terminal thread as much as possible.
+    std::copy(_palette.palette.begin(), _palette.palette.end(), colors.begin());
+    auto const [foreground, background] = _reverseVideo
+        ? std::pair{ _palette.defaultBackground, _palette.defaultForeground }
+        : std::pair{ _palette.defaultForeground, _palette.defaultBackground };
+    colors[static_cast<size_t>(PaletteSlot::DefaultForeground)] = foreground;
+    colors[static_cast<size_t>(PaletteSlot::DefaultBackground)] = background;
+    colors[static_cast<size_t>(PaletteSlot::DefaultUnderline)] = _palette.defaultForeground;
+}
 
-    if (!readerLock.try_lock())
-        return false;
+void RenderBuffer::buildRuns()
+{
+    runs.clear();
+    for (size_t i = 0; i < screen.size(); ++i)
+    {
+        RenderCell const& cell = screen[i];
+        auto flags = cell.flags;
+        flags &= ~(CellFlags::CellSequenceStart | CellFlags::CellSequenceEnd);
 
-    auto const _l = std::lock_guard<decltype(readerLock)>(readerLock, std::adopt_lock);
+        if (!runs.empty())
+        {
+            RenderRun& run = runs.back();
+            if (run.position.row == cell.position.row
+                && run.position.column + static_cast<int>(run.cellCount) == cell.position.column
+                && run.flags == flags
+                && run.foregroundColor == cell.foregroundColor
+                && run.backgroundColor == cell.backgroundColor
+                && run.decorationColor == cell.decorationColor)
+            {
+                ++run.cellCount;
+                continue;
+            }
+        }
 
-    for (;;)
-    {
-        auto current = currentBackBufferIndex.load();
-        if (currentBackBufferIndex.compare_exchange_weak(current, (current + 1) % 2))
-            break;
+        runs.emplace_back(RenderRun{static_cast<uint32_t>(i), 1, cell.position, flags,
+                                    cell.foregroundColor, cell.backgroundColor, cell.decorationColor});
     }
+}
+
+RenderBufferRef RenderTripleBuffer::frontBuffer() const noexcept
+{
+    // Only take the shared buffer if it holds a frame not seen before,
+    // so that the reader never goes back to an older one.
+    if (sharedIndex_.load(std::memory_order_relaxed) & FreshFlag)
+        frontIndex_ = sharedIndex_.exchange(frontIndex_, std::memory_order_acq_rel) & IndexMask;
+
+    return RenderBufferRef{buffers_[frontIndex_]};
+}
+
+bool RenderTripleBuffer::swapBuffers(std::chrono::steady_clock::time_point _now) noexcept
+{
+    bufferBytes_[backIndex_].store(buffers_[backIndex_].memoryUsage(), std::memory_order_relaxed);
+
+    auto const previous = sharedIndex_.exchange(backIndex_ | FreshFlag, std::memory_order_acq_rel);
+    backIndex_ = previous & IndexMask;
+
+    // There's only one writer, so a plain load/store pair suffices and avoids a locked instruction.
+    frameCount_.store(frameCount_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (previous & FreshFlag)
+        overwrittenFrameCount_.store(overwrittenFrameCount_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 
     lastUpdate = _now;
     state = RenderBufferState::WaitingForRefresh;
@@ -15,23 +15,83 @@
 
 #include <terminal/Grid.h>
 
+#include <crispy/memory_usage.h>
+
+#include <array>
 #include <atomic>
 #include <chrono>
-#include <mutex>
+#include <cstdint>
 #include <optional>
+#include <string_view>
 #include <vector>
 
 namespace terminal {
 
+/// Color palette entry a render cell's color has been resolved from, see RenderPalette.
+///
+/// Slots 0 to 255 refer to the indexed colors.
+enum class PaletteSlot : uint16_t
+{
+    DefaultForeground = 256,    // default foreground color, the background one in reverse video
+    DefaultBackground = 257,    // default background color, the foreground one in reverse video
+    DefaultUnderline = 258,     // default foreground color, regardless of reverse video
+    None = 0xFFFF,              // color not taken from the palette, e.g. a true color
+};
+
+/// Colors of a ColorPalette by PaletteSlot, with reverse video applied.
+///
+/// Cells keep referring to the palette slots their colors have been resolved from,
+/// so that they can be resolved again when the palette changes, rather than the cells
+/// being rendered again from the grid.
+struct RenderPalette
+{
+    static constexpr size_t Size = 259;
+
+    std::array<RGBColor, Size> colors{};
+
+    RenderPalette() = default;
+    RenderPalette(ColorPalette const& _palette, bool _reverseVideo) noexcept;
+
+    /// @returns the color of @p _slot, or @p _color itself if it does not refer to the palette.
+    /// Faint colors are shown at half their brightness.
+    RGBColor resolve(PaletteSlot _slot, RGBColor _color, bool _faint = false) const noexcept
+    {
+        if (_slot == PaletteSlot::None)
+            return _color;
+        auto const color = colors[static_cast<size_t>(_slot)];
+        return _faint ? color * 0.5f : color;
+    }
+};
+
 struct RenderCell
 {
-    std::u32string codepoints;
+    /// Range of this cell's codepoints within RenderBuffer::codepoints.
+    uint32_t codepointOffset = 0;
+    uint32_t codepointCount = 0;
     Coordinate position;
     CellFlags flags;
     RGBColor foregroundColor;
     RGBColor backgroundColor;
     RGBColor decorationColor;
     std::optional<ImageFragment> image;
+    PaletteSlot foregroundSlot = PaletteSlot::None;     // see RenderBuffer::palette
+    PaletteSlot backgroundSlot = PaletteSlot::None;
+    PaletteSlot decorationSlot = PaletteSlot::None;
+};
+
+/// Horizontally adjacent cells of a row sharing their colors and flags.
+///
+/// Passes only interested in the cells' attributes (e.g. backgrounds and decorations)
+/// process these rather than every single cell.
+struct RenderRun
+{
+    uint32_t firstCell = 0;         // index of the run's first cell within RenderBuffer::screen
+    uint32_t cellCount = 0;
+    Coordinate position;            // of the first cell
+    CellFlags flags;                // without the CellSequenceStart and CellSequenceEnd marks
+    RGBColor foregroundColor;
+    RGBColor backgroundColor;
+    RGBColor decorationColor;
 };
 
 struct RenderCursor
@@ -42,37 +102,96 @@ struct RenderCursor
     int width;
 };
 
+/// Selected columns of a viewport row, drawn on top of the row's cells rather than
+/// being rendered into their colors, see Terminal::setSelectionOverlay().
+struct RenderSelection
+{
+    int row;
+    int firstColumn;
+    int lastColumn;
+
+    constexpr bool operator==(RenderSelection const& _other) const noexcept
+    {
+        return row == _other.row && firstColumn == _other.firstColumn && lastColumn == _other.lastColumn;
+    }
+    constexpr bool operator!=(RenderSelection const& _other) const noexcept { return !(*this == _other); }
+};
+
 struct RenderBuffer
 {
     std::vector<RenderCell> screen{};
+    std::vector<char32_t> codepoints{}; // arena holding the codepoints of all cells in screen
+    std::vector<RenderRun> runs{};      // screen's cells grouped by their attributes, see buildRuns()
     std::optional<RenderCursor> cursor{};
+    std::vector<RenderSelection> selection{}; // ordered by row, empty unless drawn as an overlay
+
+    /// Identifies the contents of each row (indexed by viewport row), changing whenever
+    /// the row is rendered again. Allows repainting only the rows that differ from an earlier frame.
+    std::vector<uint64_t> rowVersions{};
 
-    void clear() { screen.clear(); cursor.reset(); }
+    /// Colors the cells' palette slots refer to, and its version, changing along with it,
+    /// for render targets resolving the palette slots on their own.
+    RenderPalette palette{};
+    uint64_t paletteVersion = 0;
+
+    /// Time the oldest PTY output shown for the first time in this frame has been read,
+    /// or unset if the frame does not show any new output. Used for latency tracing.
+    std::chrono::steady_clock::time_point outputTime{};
+
+    std::u32string_view codepointsOf(RenderCell const& _cell) const noexcept
+    {
+        return std::u32string_view(codepoints.data() + _cell.codepointOffset, _cell.codepointCount);
+    }
+
+    /// Groups the cells in screen into runs, to be invoked once screen has been filled.
+    void buildRuns();
+
+    /// @returns the bytes allocated by this buffer.
+    size_t memoryUsage() const noexcept
+    {
+        return crispy::allocated_bytes(screen)
+             + crispy::allocated_bytes(codepoints)
+             + crispy::allocated_bytes(runs)
+             + crispy::allocated_bytes(rowVersions)
+             + crispy::allocated_bytes(selection);
+    }
+
+    void clear()
+    {
+        screen.clear();
+        codepoints.clear();
+        runs.clear();
+        cursor.reset();
+        selection.clear();
+        rowVersions.clear();
+        outputTime = {};
+    }
+
+    /// Gives back the memory held beyond the current frame, e.g. after the screen got smaller.
+    void shrinkToFit()
+    {
+        screen.shrink_to_fit();
+        codepoints.shrink_to_fit();
+        runs.shrink_to_fit();
+        rowVersions.shrink_to_fit();
+        selection.shrink_to_fit();
+    }
 };
 
-/// Lock-guarded handle to a read-only RenderBuffer object.
+/// Handle to the read-only RenderBuffer object most recently published to the reader.
+///
+/// The buffer stays untouched by the writer until the reader acquires the next handle.
 ///
 /// @see RenderBuffer
+/// @see RenderTripleBuffer::frontBuffer()
 struct RenderBufferRef
 {
     RenderBuffer const& buffer;
-    std::mutex& guard;
 
     RenderBuffer const& get() const noexcept { return buffer; }
-
-    RenderBufferRef(RenderBuffer const& _buf, std::mutex& _lock):
-        buffer{_buf}, guard{_lock}
-    {
-        guard.lock();
-    }
-
-    ~RenderBufferRef()
-    {
-        guard.unlock();
-    }
 };
 
-/// Reflects the current state of a RenderDoubleBuffer object.
+/// Reflects the current state of a RenderTripleBuffer object.
 ///
 enum class RenderBufferState
 {
@@ -92,29 +211,65 @@ constexpr std::string_view to_string(RenderBufferState _state) noexcept
     return "INVALID";
 }
 
-struct RenderDoubleBuffer
+/// Wait-free handoff of render buffers from a single writer (the thread refreshing them)
+/// to a single reader (the render thread).
+///
+/// The writer always owns a back buffer to fill, and the reader owns the front buffer it draws.
+/// A third buffer holds the most recently completed frame in between. Both sides merely
+/// exchange their own buffer with that one, so neither of them ever waits for the other.
+/// Completed frames the reader did not pick up in time are overwritten by newer ones.
+class RenderTripleBuffer
 {
-    std::mutex mutable readerLock;
-    std::atomic<size_t> currentBackBufferIndex = 0;
-    std::array<RenderBuffer, 2> buffers{};
+  public:
     std::atomic<RenderBufferState> state = RenderBufferState::WaitingForRefresh;
     std::chrono::steady_clock::time_point lastUpdate{};
 
-    RenderBuffer& backBuffer() noexcept { return buffers[currentBackBufferIndex]; }
+    /// @returns the buffer to be filled by the writer.
+    RenderBuffer& backBuffer() noexcept { return buffers_[backIndex_]; }
 
-    RenderBufferRef frontBuffer() const
-    {
-        RenderBuffer const& frontBuffer = buffers.at((currentBackBufferIndex + 1) % 2);
-        return RenderBufferRef(frontBuffer, readerLock);
-    }
+    /// @returns the most recently completed frame. May only be invoked by the reader thread.
+    RenderBufferRef frontBuffer() const noexcept;
 
     void clear()
     {
         backBuffer().clear();
     }
 
-    // Swaps front with back buffer. May only be invoked by the writer thread.
+    /// Publishes the back buffer as the most recently completed frame.
+    /// May only be invoked by the writer thread.
+    ///
+    /// @returns always true, as publishing never has to wait for the reader.
     bool swapBuffers(std::chrono::steady_clock::time_point _now) noexcept;
+
+    /// Number of frames published by the writer.
+    uint64_t frameCount() const noexcept { return frameCount_.load(std::memory_order_relaxed); }
+
+    /// Number of published frames that got overwritten before the reader picked them up.
+    uint64_t overwrittenFrameCount() const noexcept { return overwrittenFrameCount_.load(std::memory_order_relaxed); }
+
+    /// @returns the bytes allocated by all three buffers as of their most recent publication.
+    /// May be invoked by any thread.
+    size_t memoryUsage() const noexcept
+    {
+        size_t bytes = 0;
+        for (auto const& bufferBytes: bufferBytes_)
+            bytes += bufferBytes.load(std::memory_order_relaxed);
+        return bytes;
+    }
+
+  private:
+    // The shared index carries a flag telling whether its frame has not been picked up yet.
+    static constexpr uint8_t FreshFlag = 0x4;
+    static constexpr uint8_t IndexMask = 0x3;
+
+    std::array<RenderBuffer, 3> buffers_{};
+    uint8_t backIndex_ = 0;
+    std::atomic<uint8_t> mutable sharedIndex_ = 1;
+    uint8_t mutable frontIndex_ = 2;
+
+    std::atomic<uint64_t> frameCount_ = 0;
+    std::atomic<uint64_t> overwrittenFrameCount_ = 0;
+    std::array<std::atomic<size_t>, 3> bufferBytes_{}; // memory usage of each buffer, updated when published
 };
 
 } // end namespace
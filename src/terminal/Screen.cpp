@@ -14,6 +14,9 @@
 #include <terminal/Screen.h>
 
 #include <terminal/InputGenerator.h>
+#include <terminal/Process.h>
+#include <terminal/SessionFile.h>
+#include <terminal/SharedImage.h>
 #include <terminal/VTType.h>
 #include <terminal/logging.h>
 
@@ -34,6 +37,7 @@
 #include <algorithm>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <sstream>
 #include <string_view>
 #include <tuple>
@@ -64,11 +68,13 @@ using std::make_shared;
 using std::max;
 using std::min;
 using std::monostate;
+using std::move;
 using std::next;
 using std::nullopt;
 using std::optional;
 using std::ostringstream;
 using std::pair;
+using std::prev;
 using std::ref;
 using std::string;
 using std::string_view;
@@ -372,7 +378,6 @@ Screen::Screen(Size const& _size,
     logRaw_{ _logRaw },
     logTrace_{ _logTrace },
     modes_{},
-    savedModes_{},
     defaultColorPalette_{ _colorPalette },
     colorPalette_{ _colorPalette },
     maxImageColorRegisters_{ _maxImageColorRegisters },
@@ -417,6 +422,21 @@ void Screen::setMaxHistoryLineCount(optional<int> _maxHistoryLineCount)
     primaryGrid().setMaxHistoryLineCount(_maxHistoryLineCount);
 }
 
+void Screen::setHistoryCompressionThreshold(optional<int> _threshold)
+{
+    primaryGrid().setHistoryCompressionThreshold(_threshold);
+}
+
+void Screen::setHistorySpill(optional<int> _threshold, string _directory)
+{
+    primaryGrid().setHistorySpill(_threshold, move(_directory));
+}
+
+void Screen::setMaxHistoryBytes(optional<size_t> _bytes)
+{
+    primaryGrid().setMaxHistoryBytes(_bytes);
+}
+
 void Screen::resizeColumns(int _newColumnCount, bool _clear)
 {
     // DECCOLM / DECSCPP
@@ -528,10 +548,8 @@ void Screen::write(char const * _data, size_t _size)
 {
     if (!_size)
         return;
-#if defined(LIBTERMINAL_LOG_RAW)
-    if (crispy::logging_sink::for_debug().enabled())
+    if (crispy::debugtag::enabled(ScreenRawOutputTag))
         debuglog(ScreenRawOutputTag).write("raw: \"{}\"", escape(_data, _data + _size));
-#endif
 
     parser_.parseFragment(string_view(_data, _size));
     eventListener_.screenUpdated();
@@ -550,7 +568,7 @@ void Screen::writeText(char32_t _char)
     if (wrapPending_ && cursor_.autoWrap)
     {
         linefeed(margin_.horizontal.from);
-        if (isModeEnabled(DECMode::TextReflow))
+        if (modes_.enabled<DECMode::TextReflow>())
             currentLine_->setWrapped(true);
     }
 
@@ -564,13 +582,16 @@ void Screen::writeText(char32_t _char)
             : char32_t{0};
 
     bool const insertToPrev =
-        lastChar && unicode::grapheme_segmenter::nonbreakable(lastChar, ch);
+        lastChar
+        && (lastChar >= NarrowCodepointLimit || ch >= NarrowCodepointLimit)
+        && unicode::grapheme_segmenter::nonbreakable(lastChar, ch);
 
     if (!insertToPrev)
         writeCharToCurrentAndAdvance(ch);
     else
     {
         auto const extendedWidth = lastColumn_->appendCharacter(ch);
+        grid().touch(grid().lineAt(lastCursorPosition_.row));
 
         if (extendedWidth > 0)
             clearAndAdvance(extendedWidth);
@@ -579,11 +600,72 @@ void Screen::writeText(char32_t _char)
     sequencer_.resetInstructionCounter();
 }
 
+void Screen::writeText(string_view _chars)
+{
+    if (_chars.empty())
+        return;
+
+    // The first character may need to be joined with the preceding cell's grapheme cluster,
+    // and may also trigger a pending auto-wrap, so pass it through the generic path.
+    writeText(static_cast<char32_t>(_chars.front()));
+    _chars.remove_prefix(1);
+
+    // Writing text does not change any modes, so it's safe to only query them once.
+    bool const leftRightMarginMode = modes_.enabled<DECMode::LeftRightMargin>();
+
+    // Any subsequent US-ASCII character always starts a new grapheme cluster of width 1.
+    while (!_chars.empty())
+    {
+        auto const rightMargin = leftRightMarginMode && isCursorInsideMargins()
+                               ? margin_.horizontal.to
+                               : size_.width;
+
+        // Number of cells that can be written to while still being able to advance the cursor.
+        auto const cellsAvailable = rightMargin - cursor_.position.column;
+
+        if (wrapPending_ || cellsAvailable <= 0)
+        {
+            // Let the generic path deal with the right margin and auto-wrap.
+            writeText(static_cast<char32_t>(_chars.front()));
+            _chars.remove_prefix(1);
+            continue;
+        }
+
+        auto const n = static_cast<int>(min(static_cast<size_t>(cellsAvailable), _chars.size()));
+        auto const attributes = graphicsRenditionId();
+        auto const writeCells = [&](auto _map) {
+            for (char const ch : _chars.substr(0, static_cast<size_t>(n)))
+            {
+                Cell& cell = *currentColumn_++;
+                cell.setCharacter(_map(ch));
+                cell.setAttributes(attributes);
+#if defined(LIBTERMINAL_HYPERLINKS)
+                cell.setHyperlink(currentHyperlink_);
+#endif
+            }
+        };
+
+        // Any single shift has been consumed by the first character already.
+        if (cursor_.charsets.isUSASCII())
+            writeCells([](char _ch) { return static_cast<char32_t>(_ch); });
+        else
+            writeCells([&](char _ch) { return cursor_.charsets.map(_ch); });
+
+        grid().touch(*currentLine_);
+        cursor_.position.column += n;
+        lastColumn_ = prev(currentColumn_);
+        lastCursorPosition_ = Coordinate{cursor_.position.row, cursor_.position.column - 1};
+        _chars.remove_prefix(static_cast<size_t>(n));
+    }
+}
+
 void Screen::writeCharToCurrentAndAdvance(char32_t _character)
 {
+    auto const attributes = graphicsRenditionId();
     Cell& cell = *currentColumn_;
+    grid().touch(*currentLine_);
     cell.setCharacter(_character);
-    cell.setAttributes(cursor_.graphicsRendition);
+    cell.setAttributes(attributes);
 #if defined(LIBTERMINAL_HYPERLINKS)
     cell.setHyperlink(currentHyperlink_);
 #endif
@@ -591,7 +673,7 @@ void Screen::writeCharToCurrentAndAdvance(char32_t _character)
     lastColumn_ = currentColumn_;
     lastCursorPosition_ = cursor_.position;
 
-    bool const cursorInsideMargin = isModeEnabled(DECMode::LeftRightMargin) && isCursorInsideMargins();
+    bool const cursorInsideMargin = modes_.enabled<DECMode::LeftRightMargin>() && isCursorInsideMargins();
     auto const cellsAvailable = cursorInsideMargin ? margin_.horizontal.to - cursor_.position.column
                                                    : size_.width - cursor_.position.column;
 
@@ -604,9 +686,9 @@ void Screen::writeCharToCurrentAndAdvance(char32_t _character)
         currentColumn_++;
         for (int i = 1; i < n; ++i)
 #if defined(LIBTERMINAL_HYPERLINKS)
-            (currentColumn_++)->reset(cursor_.graphicsRendition, currentHyperlink_);
+            (currentColumn_++)->reset(attributes, currentHyperlink_);
 #else
-            (currentColumn_++)->reset(cursor_.graphicsRendition);
+            (currentColumn_++)->reset(attributes);
 #endif
     }
     else if (cursor_.autoWrap)
@@ -624,12 +706,14 @@ void Screen::clearAndAdvance(int _offset)
     if (n == _offset)
     {
         assert(n > 0);
+        grid().touch(*currentLine_);
         cursor_.position.column += n;
+        auto const attributes = graphicsRenditionId();
         for (auto i = 0; i < n; ++i)
 #if defined(LIBTERMINAL_HYPERLINKS)
-            (currentColumn_++)->reset(cursor_.graphicsRendition, currentHyperlink_);
+            (currentColumn_++)->reset(attributes, currentHyperlink_);
 #else
-            (currentColumn_++)->reset(cursor_.graphicsRendition);
+            (currentColumn_++)->reset(attributes);
 #endif
     }
     else if (cursor_.autoWrap)
@@ -640,42 +724,24 @@ void Screen::clearAndAdvance(int _offset)
 
 std::string Screen::screenshot(function<string(int)> const& _postLine) const
 {
-    auto result = std::stringstream{};
-    auto writer = VTWriter(result);
+    auto result = string{};
+    writeScreenshot(captureScreenshot(), [&](string_view _chunk) { result += _chunk; }, _postLine);
+    return result;
+}
 
-    for (int const absoluteRow : crispy::times(1, grid().historyLineCount() + size_.height))
+Screenshot Screen::captureScreenshot() const
+{
+    auto screenshot = Screenshot{grid().attributesTable(), {}, historyLineCount()};
+    screenshot.lines.reserve(static_cast<size_t>(historyLineCount() + size_.height));
+    for (int const row : crispy::times(1 - historyLineCount(), historyLineCount() + size_.height))
     {
-        auto const row = absoluteRow - grid().historyLineCount();
-        for (int const col : crispy::times(1, size_.width))
-        {
-            Cell const& cell = at({row, col});
-
-            if (cell.attributes().styles & CellFlags::Bold)
-                writer.sgr_add(GraphicsRendition::Bold);
-            else
-                writer.sgr_add(GraphicsRendition::Normal);
-
-            // TODO: other styles (such as underline, ...)?
-
-            writer.setForegroundColor(cell.attributes().foregroundColor);
-            writer.setBackgroundColor(cell.attributes().backgroundColor);
-
-            if (!cell.codepointCount())
-                writer.write(U' ');
-            else
-                for (char32_t const ch : cell.codepoints())
-                    writer.write(ch);
-        }
-        writer.sgr_add(GraphicsRendition::Reset);
-
-        if (_postLine)
-            writer.write(_postLine(row));
+        Line const& line = screenshot.lines.emplace_back(grid().lineAt(row));
 
-        writer.write('\r');
-        writer.write('\n');
+        // The scrollback file is only to be read while the screen is locked.
+        if (line.spilled())
+            line.untrimmedCells();
     }
-
-    return result.str();
+    return screenshot;
 }
 
 optional<int> Screen::findMarkerBackward(int _currentCursorLine) const
@@ -683,13 +749,7 @@ optional<int> Screen::findMarkerBackward(int _currentCursorLine) const
     if (_currentCursorLine < 0 || !isPrimaryScreen())
         return nullopt;
 
-    _currentCursorLine = min(_currentCursorLine, historyLineCount() + size_.height);
-
-    for (int i = _currentCursorLine - 1; i >= 0; --i)
-        if (grid().absoluteLineAt(i).marked())
-            return {i};
-
-    return nullopt;
+    return grid().previousMarkedLine(min(_currentCursorLine, historyLineCount() + size_.height));
 }
 
 optional<int> Screen::findMarkerForward(int _currentCursorLine) const
@@ -697,11 +757,7 @@ optional<int> Screen::findMarkerForward(int _currentCursorLine) const
     if (_currentCursorLine < 0 || !isPrimaryScreen())
         return nullopt;
 
-    for (int i = _currentCursorLine + 1; i < historyLineCount() + grid().screenSize().height; ++i)
-        if (grid().absoluteLineAt(i).marked())
-            return {i};
-
-    return nullopt;
+    return grid().nextMarkedLine(_currentCursorLine);
 }
 
 // {{{ tabs related
@@ -793,7 +849,16 @@ void Screen::resetHard()
 
     clearAllTabs();
 
+    auto const historyCompressionThreshold = primaryGrid().historyCompressionThreshold();
+    auto const historySpillThreshold = primaryGrid().historySpillThreshold();
+    auto const historySpillDirectory = primaryGrid().historySpillDirectory();
+    auto const maxHistoryBytes = primaryGrid().maxHistoryBytes();
+    auto const generation = primaryGrid().generation();
     grids_ = emptyGrids(size(), primaryGrid().maxHistoryLineCount());
+    primaryGrid().touchPage(generation);
+    primaryGrid().setHistoryCompressionThreshold(historyCompressionThreshold);
+    primaryGrid().setHistorySpill(historySpillThreshold, historySpillDirectory);
+    primaryGrid().setMaxHistoryBytes(maxHistoryBytes);
     activeGrid_ = &primaryGrid();
     moveCursorTo(Coordinate{1, 1});
 
@@ -840,6 +905,9 @@ void Screen::setBuffer(ScreenType _type)
         }
         screenType_ = _type;
 
+        // Rows showing the same in both buffers, e.g. blank ones, are not considered modified.
+        grid().touchPage(backgroundGrid());
+
         eventListener_.bufferChanged(_type);
     }
 }
@@ -848,6 +916,12 @@ void Screen::linefeed(int _newColumn)
 {
     wrapPending_ = 0;
 
+    // The line is most likely complete now, and its cells still hot in cache.
+    if (!triggers_.empty())
+        scanTriggers();
+    if (eagerLinkDetection_)
+        currentLine_->detectedLinks();
+
     if (realCursorPosition().row == margin_.vertical.to ||
         realCursorPosition().row == size_.height)
     {
@@ -866,6 +940,47 @@ void Screen::linefeed(int _newColumn)
     }
 }
 
+void Screen::setTriggers(vector<Trigger> _triggers)
+{
+    triggers_ = TriggerEngine(move(_triggers));
+    triggerState_ = TriggerEngine::InitialState;
+}
+
+void Screen::scanTriggers()
+{
+    // Lines passed again unmodified, e.g. by moving the cursor, have their matches already.
+    Line& line = *currentLine_;
+    if (!line.triggerMatches().empty())
+        return;
+
+    // Patterns may continue on the wrapped line following, which is scanned next.
+    auto state = line.wrapped() ? triggerState_ : TriggerEngine::InitialState;
+    auto column = 0;
+    triggerMatches_.clear();
+    for (Cell const& cell: line.untrimmedCells())
+        triggers_.feed(state, ++column, cell.codepointCount() ? cell.codepoint(0) : 0, triggerMatches_);
+    triggerState_ = state;
+
+    if (triggerMatches_.empty())
+        return;
+
+    // The line is rendered again along with its matches.
+    grid().touch(line);
+    line.setTriggerMatches(triggerMatches_);
+
+    auto notified = false;
+    for (TriggerMatch const& match: triggerMatches_)
+    {
+        if (triggers_.performs(match.trigger, TriggerAction::Mark))
+            line.setMarked(true);
+        else if (triggers_.performs(match.trigger, TriggerAction::Notify) && !notified)
+        {
+            eventListener_.notify(triggers_.triggers()[match.trigger].pattern, line.toUtf8Trimmed());
+            notified = true;
+        }
+    }
+}
+
 void Screen::scrollUp(int _n, Margin const& _margin)
 {
     grid().scrollUp(_n, cursor().graphicsRendition, _margin);
@@ -899,16 +1014,7 @@ string Screen::renderTextLine(int row) const
 string Screen::renderHistoryTextLine(int _lineNumberIntoHistory) const
 {
     assert(1 <= _lineNumberIntoHistory && _lineNumberIntoHistory <= historyLineCount());
-    string line;
-    line.reserve(size_.width);
-
-    for (Cell const& cell : grid().lineAt(1 - _lineNumberIntoHistory))
-        if (cell.codepointCount())
-            line += cell.toUtf8();
-        else
-            line += ' '; // fill character
-
-    return line;
+    return grid().renderTextLine(1 - _lineNumberIntoHistory);
 }
 // }}}
 
@@ -1012,33 +1118,17 @@ void Screen::clearToEndOfScreen()
 {
 #if defined(LIBTERMINAL_HYPERLINKS)
     if (isAlternateScreen() && cursor_.position.row == 1 && cursor_.position.column == 1)
-        hyperlinks_.clear();
+        hyperlinks_.forgetIds();
 #endif
 
     clearToEndOfLine();
-
-    for_each(
-        LIBTERMINAL_EXECUTION_COMMA(par)
-        next(currentLine_),
-        end(grid().mainPage()),
-        [&](Line& line) {
-            fill(begin(line), end(line), Cell{{}, cursor_.graphicsRendition});
-        }
-    );
+    grid().fill(cursor_.position.row + 1, 1, size_.height, size_.width, graphicsRenditionId());
 }
 
 void Screen::clearToBeginOfScreen()
 {
     clearToBeginOfLine();
-
-    for_each(
-        LIBTERMINAL_EXECUTION_COMMA(par)
-        begin(grid().mainPage()),
-        currentLine_,
-        [&](Line& line) {
-            fill(begin(line), end(line), Cell{{}, cursor_.graphicsRendition});
-        }
-    );
+    grid().fill(1, 1, cursor_.position.row - 1, size_.width, graphicsRenditionId());
 }
 
 void Screen::clearScreen()
@@ -1061,35 +1151,30 @@ void Screen::eraseCharacters(int _n)
     // Spec: https://vt100.net/docs/vt510-rm/ECH.html
     // It's not clear from the spec how to perform erase when inside margin and number of chars to be erased would go outside margins.
     // TODO: See what xterm does ;-)
-    size_t const n = min(size_.width - realCursorPosition().column + 1, _n == 0 ? 1 : _n);
-    fill_n(currentColumn_, n, Cell{{}, cursor_.graphicsRendition});
+    auto const column = static_cast<int>(std::distance(begin(*currentLine_), currentColumn_));
+    auto const n = min(size_.width - realCursorPosition().column + 1, _n == 0 ? 1 : _n);
+    currentLine_->fill(column, column + n, graphicsRenditionId());
+    grid().touch(*currentLine_);
 }
 
 void Screen::clearToEndOfLine()
 {
-    fill(
-        currentColumn_,
-        end(*currentLine_),
-        Cell{{}, cursor_.graphicsRendition}
-    );
+    auto const column = static_cast<int>(std::distance(begin(*currentLine_), currentColumn_));
+    currentLine_->fill(column, currentLine_->size(), graphicsRenditionId());
+    grid().touch(*currentLine_);
 }
 
 void Screen::clearToBeginOfLine()
 {
-    fill(
-        begin(*currentLine_),
-        next(currentColumn_),
-        Cell{{}, cursor_.graphicsRendition}
-    );
+    auto const column = static_cast<int>(std::distance(begin(*currentLine_), currentColumn_));
+    currentLine_->fill(0, column + 1, graphicsRenditionId());
+    grid().touch(*currentLine_);
 }
 
 void Screen::clearLine()
 {
-    fill(
-        begin(*currentLine_),
-        end(*currentLine_),
-        Cell{{}, cursor_.graphicsRendition}
-    );
+    currentLine_->fill(0, currentLine_->size(), graphicsRenditionId());
+    grid().touch(*currentLine_);
 }
 
 void Screen::moveCursorToNextLine(int _n)
@@ -1131,8 +1216,9 @@ void Screen::insertChars(int _lineNo, int _n)
     fill_n(
         columnIteratorAt(begin(line), cursor_.position.column),
         n,
-        Cell{L' ', cursor_.graphicsRendition}
+        Cell{L' ', graphicsRenditionId()}
     );
+    grid().touch(line);
 }
 
 void Screen::insertLines(int _n)
@@ -1174,29 +1260,7 @@ void Screen::copyArea(int _top, int _left, int _bottom, int _right, int _page,
         // Copy to its own location => no-op.
         return;
 
-    auto const [x0, xInc, xEnd] = [&]() {
-        if (_targetLeft > _left) // moving right
-            return std::tuple{_right - _left, -1, -1};
-        else
-            return std::tuple{0, +1, _right - _left + 1};
-    }();
-
-    auto const [y0, yInc, yEnd] = [&]() {
-        if (_targetTop > _top) // moving down
-            return std::tuple{_bottom - _top, -1, -1};
-        else
-            return std::tuple{0, +1, _bottom - _top + 1};
-    }();
-
-    for (auto y = y0; y != yEnd; y += yInc)
-    {
-        for (auto x = x0; x != xEnd; x += xInc)
-        {
-            Cell const& sourceCell = at({_top + y, _left + x});
-            Cell& targetCell = at({_targetTop + y, _targetLeft + x});
-            targetCell = sourceCell;
-        }
-    }
+    grid().copyArea(_top, _left, _bottom, _right, _targetTop, _targetLeft);
 
     updateCursorIterators();
 }
@@ -1209,18 +1273,7 @@ void Screen::eraseArea(int _top, int _left, int _bottom, int _right)
     if (_top > _bottom || _left > _right)
         return;
 
-    for (int y = _top; y <= _bottom; ++y)
-    {
-        Line& line = grid().lineAt(y);
-        auto column = next(begin(line), _left - 1);
-        for (int x = _left; x <= _right; ++x)
-        {
-            Cell& cell = *column;
-            cell.reset();
-            cell.setCharacter(0x20);
-            ++column;
-        }
-    }
+    grid().fill(_top, _left, _bottom, _right, DefaultGraphicsAttributesId, 0x20);
 }
 
 void Screen::fillArea(char32_t _ch, int _top, int _left, int _bottom, int _right)
@@ -1229,18 +1282,7 @@ void Screen::fillArea(char32_t _ch, int _top, int _left, int _bottom, int _right
     if (!(32 <= _ch && _ch <= 126) && !(160 <= _ch && _ch <= 255))
         return;
 
-    for (int y = _top; y <= _bottom; ++y)
-    {
-        Line& line = grid().lineAt(y);
-        auto column = next(begin(line), _left - 1);
-        for (int x = _left; x <= _right; ++x)
-        {
-            Cell& cell = *column;
-            cell.reset(cursor().graphicsRendition);
-            cell.setCharacter(_ch);
-            ++column;
-        }
-    }
+    grid().fill(_top, _left, _bottom, _right, graphicsRenditionId(), _ch);
 }
 
 void Screen::deleteLines(int _n)
@@ -1283,8 +1325,9 @@ void Screen::deleteChars(int _lineNo, int _n)
     fill(
         prev(rightMargin, n),
         rightMargin,
-        Cell{L' ', cursor_.graphicsRendition}
+        Cell{L' ', graphicsRenditionId()}
     );
+    grid().touch(*line);
 }
 void Screen::deleteColumns(int _n)
 {
@@ -1316,27 +1359,80 @@ void Screen::setCurrentWorkingDirectory(string const& _url)
     currentWorkingDirectory_ = _url;
 }
 
+optional<DetectedLink> Screen::detectedLinkAt(Coordinate const& _coord) const
+{
+    auto const& links = grid().lineAt(_coord.row).detectedLinks();
+    auto const i = std::find_if(links.begin(), links.end(), [&](DetectedLink const& _link) {
+        return _coord.column <= _link.lastColumn;
+    });
+    if (i == links.end() || !i->contains(_coord.column))
+        return nullopt;
+    return *i;
+}
+
+HyperlinkInfo Screen::detectedHyperlink(int _row, DetectedLink const& _link) const
+{
+    auto const& line = grid().lineAt(_row);
+    auto text = string{};
+    for (int column = _link.firstColumn; column <= _link.lastColumn; ++column)
+        text += line[static_cast<size_t>(column - 1)].toUtf8();
+
+    auto uri = [&]() -> string {
+        if (text.find("://") != string::npos)
+            return text;
+        if (text.front() == '/')
+            return "file://" + text;
+        if (text.front() == '~')
+            return "file://" + Process::homeDirectory().generic_string() + text.substr(1);
+
+        // The working directory is reported as a file URL (see OSC 7).
+        if (currentWorkingDirectory_.empty())
+            return text;
+        auto const base = currentWorkingDirectory_.find("://") != string::npos
+                        ? currentWorkingDirectory_
+                        : "file://" + currentWorkingDirectory_;
+        return base.back() == '/' ? base + text : base + '/' + text;
+    }();
+
+    return HyperlinkInfo{string{}, move(uri)};
+}
+
 void Screen::hyperlink(string const& _id, string const& _uri)
 {
 #if defined(LIBTERMINAL_HYPERLINKS)
     if (_uri.empty())
-        currentHyperlink_ = nullptr;
-    else if (_id.empty())
-        currentHyperlink_ = make_shared<HyperlinkInfo>(HyperlinkInfo{_id, _uri});
-    else if (auto i = hyperlinks_.find(_id); i != hyperlinks_.end())
-        currentHyperlink_ = i->second;
-    else
     {
-        currentHyperlink_ = make_shared<HyperlinkInfo>(HyperlinkInfo{_id, _uri});
-        hyperlinks_[_id] = currentHyperlink_;
+        currentHyperlink_ = NoHyperlinkId;
+        return;
     }
+
+    auto id = hyperlinks_.add(_id, _uri);
+    if (!id.has_value())
+    {
+        collectUnusedHyperlinks();
+        id = hyperlinks_.add(_id, _uri);
+    }
+
+    // If every single identifier is still in use by some cell, the text is written without a hyperlink.
+    currentHyperlink_ = id.value_or(NoHyperlinkId);
     // TODO:
-    // Care about eviction.
     // Move hyperlink store into ScreenBuffer, so it gets reset upon every switch into
     // alternate screen (not for main screen!)
 #endif
 }
 
+#if defined(LIBTERMINAL_HYPERLINKS)
+void Screen::collectUnusedHyperlinks()
+{
+    auto used = std::vector<bool>(hyperlinks_.size(), false);
+    used[currentHyperlink_] = true;
+    for (Grid const& grid : grids_)
+        grid.markUsedHyperlinks(used);
+
+    hyperlinks_.release(used);
+}
+#endif
+
 void Screen::moveCursorUp(int _n)
 {
     auto const n = min(
@@ -1459,35 +1555,56 @@ void Screen::notify(string const& _title, string const& _content)
 
 void Screen::captureBuffer(int _lineCount, bool _logicalLines)
 {
-    // TODO: Unit test case! (for ensuring line numbering and limits are working as expected)
+    // The capture is replied in fragments of bounded size while being generated, each one
+    // queued for the application as soon as it is complete, followed by an empty one marking the end.
+    // This way, capturing the whole history never builds up the capture as a whole.
+    auto constexpr ReplyPrefix = "\033]314;"sv;
+    auto constexpr ReplySuffix = "\033\\"sv;
+    auto constexpr FragmentSize = size_t{4096};
 
-    auto capturedBuffer = std::string();
-    auto writer = VTWriter([&](auto buf, auto len) { capturedBuffer += string_view(buf, len); });
+    auto fragment = string(ReplyPrefix);
+    fragment.reserve(ReplyPrefix.size() + FragmentSize + ReplySuffix.size());
+
+    auto const replyFragment = [&]() {
+        fragment += ReplySuffix;
+        reply(fragment);
+        fragment.resize(ReplyPrefix.size());
+    };
+
+    auto const append = [&](string_view _text) {
+        while (!_text.empty())
+        {
+            auto const n = min(_text.size(), ReplyPrefix.size() + FragmentSize - fragment.size());
+            fragment += _text.substr(0, n);
+            _text.remove_prefix(n);
+            if (fragment.size() == ReplyPrefix.size() + FragmentSize)
+                replyFragment();
+        }
+    };
+
+    auto line = string();
+    auto writer = VTWriter([&](auto buf, auto len) { line += string_view(buf, len); });
 
     // TODO: when capturing _lineCount < screenSize.height, start at the lowest non-empty line.
     auto const relativeStartLine = _logicalLines ? grid().computeRelativeLineNumberFromBottom(_lineCount)
                                                  : size_.height - _lineCount + 1;
     auto const startLine = clamp(1 - historyLineCount(), relativeStartLine, size_.height);
 
-    // dumpState();
-
     auto const lineCount = size_.height - startLine + 1;
 
-    auto const trimSpaceRight = [](string& value)
-    {
-        while (!value.empty() && value.back() == ' ')
-            value.pop_back();
-    };
+    // Line feeds are held back until followed by more text, as trailing empty lines are not captured.
+    auto pendingLineFeeds = size_t{0};
 
     for (int const row : crispy::times(startLine, lineCount))
     {
         auto const& lineBuffer = grid().lineAt(row);
 
-        if (_logicalLines && lineBuffer.wrapped() && !capturedBuffer.empty())
-            capturedBuffer.pop_back();
+        if (_logicalLines && lineBuffer.wrapped() && pendingLineFeeds)
+            --pendingLineFeeds;
 
         if (!lineBuffer.blank())
         {
+            line.clear();
             for (int const col : crispy::times(1, size_.width))
             {
                 Cell const& cell = at({row, col});
@@ -1497,24 +1614,28 @@ void Screen::captureBuffer(int _lineCount, bool _logicalLines)
                     for (char32_t const ch : cell.codepoints())
                         writer.write(ch);
             }
-            trimSpaceRight(capturedBuffer);
+
+            while (!line.empty() && line.back() == ' ')
+                line.pop_back();
+
+            if (!line.empty())
+            {
+                append(string(pendingLineFeeds, '\n'));
+                append(line);
+                pendingLineFeeds = 0;
+            }
         }
 
-        writer.write('\n');
+        ++pendingLineFeeds;
     }
 
-    while (crispy::endsWith(string_view(capturedBuffer), "\n\n"sv)) // TODO: unit test
-        capturedBuffer.pop_back();
+    if (pendingLineFeeds)
+        append("\n"sv);
 
-    auto constexpr PageSize = size_t{4096};
-    for (size_t i = 0; i < capturedBuffer.size(); i += PageSize)
-    {
-        auto const start = capturedBuffer.data() + i;
-        auto const count = min(PageSize, capturedBuffer.size() - i);
-        reply("\033]314;{}\033\\", string_view(start, count));
-    }
+    if (fragment.size() > ReplyPrefix.size())
+        replyFragment();
 
-    reply("\033]314;\033\\"); // mark the end
+    replyFragment(); // mark the end
 }
 
 void Screen::cursorForwardTab(int _count)
@@ -1865,6 +1986,7 @@ void Screen::setMode(DECMode _mode, bool _enable)
                 savedPrimaryCursor_ = cursor();
                 setMode(DECMode::UseAlternateScreen, true);
                 clearScreen();
+                grid().touchPage(backgroundGrid()); // rows cleared to what the primary screen shows are unchanged
             }
             else
             {
@@ -1968,10 +2090,11 @@ void Screen::screenAlignmentPattern()
                 LIBTERMINAL_EXECUTION_COMMA(par)
                 begin(line),
                 end(line),
-                Cell{'E', cursor_.graphicsRendition}
+                Cell{'E', graphicsRenditionId()}
             );
         }
     );
+    grid().touchPage();
 }
 
 void Screen::sendMouseEvents(MouseProtocol _protocol, bool _enable)
@@ -1998,6 +2121,47 @@ void Screen::singleShiftSelect(CharsetTable _table)
 }
 
 void Screen::sixelImage(Size _pixelSize, Image::Data&& _data)
+{
+    placeImage(uploadImage(ImageFormat::RGBA, _pixelSize, move(_data)), _pixelSize);
+}
+
+void Screen::sharedImage(std::string const& _name, Size _pixelSize)
+{
+    if (_pixelSize.width <= 0 || _pixelSize.height <= 0
+        || _pixelSize.width > maxImageSize_.width || _pixelSize.height > maxImageSize_.height)
+    {
+        debuglog(TerminalTag).write("Ignoring shared image of invalid size {}.", _pixelSize);
+        return;
+    }
+
+    if (!eventListener_.permitSharedImage())
+        return;
+
+    auto const byteCount = static_cast<size_t>(_pixelSize.width) * static_cast<size_t>(_pixelSize.height) * 4;
+    auto shared = loadSharedImage(_name, byteCount);
+    if (!shared)
+        return;
+
+    auto image = imagePool_.create(ImageFormat::RGBA, _pixelSize, move(shared->storage), shared->pixels);
+    evictImages();
+    placeImage(move(image), _pixelSize);
+}
+
+void Screen::compressedImage(Size _pixelSize, Image::CompressedData&& _pixels)
+{
+    if (_pixelSize.width <= 0 || _pixelSize.height <= 0
+        || _pixelSize.width > maxImageSize_.width || _pixelSize.height > maxImageSize_.height)
+    {
+        debuglog(TerminalTag).write("Ignoring compressed image of invalid size {}.", _pixelSize);
+        return;
+    }
+
+    auto image = imagePool_.create(_pixelSize, move(_pixels));
+    evictImages();
+    placeImage(move(image), _pixelSize);
+}
+
+void Screen::placeImage(std::shared_ptr<Image const> _image, Size _pixelSize)
 {
     auto const columnCount = int(ceilf(float(_pixelSize.width) / float(cellPixelSize_.width)));
     auto const rowCount = int(ceilf(float(_pixelSize.height) / float(cellPixelSize_.height)));
@@ -2011,8 +2175,8 @@ void Screen::sixelImage(Size _pixelSize, Image::Data&& _data)
     auto const imageOffset = Coordinate{0, 0};
     auto const imageSize = extent;
 
-    if (auto const imageRef = uploadImage(ImageFormat::RGBA, _pixelSize, move(_data)); imageRef)
-        renderImage(imageRef, topLeft, extent,
+    if (_image)
+        renderImage(move(_image), topLeft, extent,
                     imageOffset, imageSize,
                     alignmentPolicy, resizePolicy,
                     sixelScrolling);
@@ -2021,9 +2185,61 @@ void Screen::sixelImage(Size _pixelSize, Image::Data&& _data)
         linefeed(topLeft.column);
 }
 
+void Screen::sixelImageStrip(Size _pixelSize, Image::Data&& _data, bool _first, bool _last)
+{
+    auto const sixelScrolling = isModeEnabled(DECMode::SixelScrolling);
+
+    if (_first)
+        progressiveSixelOrigin_ = sixelScrolling ? cursorPosition() : Coordinate{1, 1};
+
+    auto const origin = progressiveSixelOrigin_;
+
+    if (_pixelSize.height > 0)
+    {
+        auto topLeft = _first ? origin : Coordinate{cursorPosition().row + 1, origin.column};
+        if (topLeft.row > size_.height && sixelScrolling)
+        {
+            linefeed(origin.column);
+            topLeft.row = size_.height;
+        }
+
+        if (topLeft.row <= size_.height)
+        {
+            auto const columnCount = int(ceilf(float(_pixelSize.width) / float(cellPixelSize_.width)));
+            auto const rowCount = int(ceilf(float(_pixelSize.height) / float(cellPixelSize_.height)));
+            auto const extent = Size{columnCount, rowCount};
+
+            if (auto const imageRef = uploadImage(ImageFormat::RGBA, _pixelSize, move(_data)); imageRef)
+                renderImage(imageRef, topLeft, extent,
+                            Coordinate{0, 0}, extent,
+                            ImageAlignment::TopStart, ImageResize::NoResize,
+                            sixelScrolling);
+        }
+    }
+
+    if (_last && !sixelCursorConformance_)
+        linefeed(origin.column);
+}
+
 std::shared_ptr<Image const> Screen::uploadImage(ImageFormat _format, Size _imageSize, Image::Data&& _pixmap)
 {
-    return imagePool_.create(_format, _imageSize, move(_pixmap));
+    auto image = imagePool_.create(_format, _imageSize, move(_pixmap));
+    evictImages();
+    return image;
+}
+
+void Screen::evictImages()
+{
+#if defined(LIBTERMINAL_IMAGES)
+    if (!imagePool_.overBudget())
+        return;
+
+    // Only the primary screen has a history to evict images from.
+    imagePool_.evict([this]() {
+        auto const rows = primaryGrid().evictHistoryImages([this]() { return !imagePool_.overBudget(); });
+        debuglog(TerminalTag).write("Evicted {} image rows from history.", rows);
+    });
+#endif
 }
 
 void Screen::renderImage(std::shared_ptr<Image const> const& _imageRef,
@@ -2057,19 +2273,28 @@ void Screen::renderImage(std::shared_ptr<Image const> const& _imageRef,
         cellPixelSize_
     );
 
-    if (linesToBeRendered)
-    {
-        crispy::for_each(
-            LIBTERMINAL_EXECUTION_COMMA(par)
-            Size{columnsToBeRendered, linesToBeRendered},
-            [&](Point const& offset) {
-                [[maybe_unused]] Cell& cell = at(_topLeft + offset);
-                cell.setImage(ImageFragment{rasterizedImage, Coordinate(offset)});
+    // Places the given row of the image (0-based, in grid cells) onto the screen, starting at the given position.
+    auto const placeImageRow = [&](int _imageRow, Coordinate _pos) {
+        auto const imageRowId = grid().addImageRow(rasterizedImage, _imageRow);
+        if (!imageRowId.has_value())
+            return;
+
+        Line& line = grid().lineAt(_pos.row);
+        for (auto const columnOffset : crispy::times(columnsToBeRendered))
+        {
+            Cell& cell = line[static_cast<size_t>(_pos.column - 1 + columnOffset)];
+            cell.setImage(*imageRowId, columnOffset);
 #if defined(LIBTERMINAL_HYPERLINKS)
-                cell.setHyperlink(currentHyperlink_);
+            cell.setHyperlink(currentHyperlink_);
 #endif
-            }
-        );
+        }
+        grid().touch(line);
+    };
+
+    if (linesToBeRendered)
+    {
+        for (auto const rowOffset : crispy::times(linesToBeRendered))
+            placeImageRow(rowOffset, Coordinate{_topLeft.row + rowOffset, _topLeft.column});
         moveCursorTo(Coordinate{_topLeft.row + linesToBeRendered - 1, _topLeft.column});
     }
 
@@ -2082,20 +2307,7 @@ void Screen::renderImage(std::shared_ptr<Image const> const& _imageRef,
         {
             linefeed();
             moveCursorForward(_topLeft.column);
-            crispy::for_each(
-                LIBTERMINAL_EXECUTION_COMMA(par)
-                crispy::times(columnsToBeRendered),
-                [&](int columnOffset) {
-                    [[maybe_unused]] Cell& cell = at(Coordinate{size_.height, columnOffset + 1});
-                    cell.setImage(ImageFragment{
-                        rasterizedImage,
-                        Coordinate{linesToBeRendered + lineOffset, columnOffset}
-                    });
-#if defined(LIBTERMINAL_HYPERLINKS)
-                    cell.setHyperlink(currentHyperlink_);
-#endif
-                }
-            );
+            placeImageRow(linesToBeRendered + lineOffset, Coordinate{size_.height, 1});
         }
     }
 
@@ -2254,9 +2466,7 @@ void Screen::requestStatusString(RequestStatusString _value)
                 // xterm adapts this by resizing its window.
                 if (size_.height >= 24)
                     return fmt::format("{}t", size_.height);
-#if defined(LIBTERMINAL_LOG_RAW)
                 debuglog(ScreenRawOutputTag).write("Requesting device status for {} not with line count < 24 is undefined.");
-#endif
                 return nullopt;
             case RequestStatusString::DECSTBM:
                 return fmt::format("{};{}r", margin_.vertical.from, margin_.vertical.to);
@@ -2270,9 +2480,7 @@ void Screen::requestStatusString(RequestStatusString _value)
             case RequestStatusString::SGR:
                 return fmt::format("0;{}m", vtSequenceParameterString(cursor_.graphicsRendition));
             case RequestStatusString::DECSCA: // TODO
-#if defined(LIBTERMINAL_LOG_RAW)
                 debuglog(ScreenRawOutputTag).write("Requesting device status for {} not implemented yet.", _value);
-#endif
                 break;
         }
         return nullopt;
@@ -2326,9 +2534,7 @@ void Screen::requestCapability(std::string_view _name)
 {
     if (!respondToTCapQuery_)
     {
-#if defined(LIBTERMINAL_LOG_RAW)
         debuglog(ScreenRawOutputTag).write("Requesting terminal capability {} ignored. Experimental tcap feature disabled.", _name);
-#endif
         return;
     }
 
@@ -2351,15 +2557,11 @@ void Screen::requestCapability(capabilities::Code _code)
 {
     if (!respondToTCapQuery_)
     {
-#if defined(LIBTERMINAL_LOG_RAW)
         debuglog(ScreenRawOutputTag).write("Requesting terminal capability {} ignored. Experimental tcap feature disabled.", _code);
-#endif
         return;
     }
 
-#if defined(LIBTERMINAL_LOG_RAW)
     debuglog(ScreenRawOutputTag).write("Requesting terminal capability: {}", _code);
-#endif
     if (booleanCapability(_code))
         reply("\033P1+r{}\033\\", _code.hex());
     else if (auto const value = numericCapability(_code); value >= 0)
@@ -2431,6 +2633,347 @@ void Screen::setDynamicColor(DynamicColorName _name, RGBColor const& _value)
     }
 }
 
+void Screen::collectMemoryUsage(crispy::memory_usage& _usage) const
+{
+    grids_[0].collectMemoryUsage(_usage, "screen.primary");
+    grids_[1].collectMemoryUsage(_usage, "screen.alternate");
+#if defined(LIBTERMINAL_HYPERLINKS)
+    _usage.add("screen.hyperlinks", hyperlinks_.memoryUsage());
+#endif
+    _usage.add("screen.images.raw", imagePool_.imageBytes());
+    _usage.add("screen.images.rasterized", imagePool_.rasterizedImageCount() * sizeof(RasterizedImage));
+}
+
+void Screen::trimMemory()
+{
+    parser_.trimMemory();
+    sequencer_.trimMemory();
+}
+
+// {{{ session persistence
+namespace
+{
+    // Dynamic colors saved along with the palette entries, see Screen::saveState().
+    constexpr auto DynamicColors = std::array{
+        &ColorPalette::defaultForeground,
+        &ColorPalette::defaultBackground,
+        &ColorPalette::cursor,
+        &ColorPalette::mouseForeground,
+        &ColorPalette::mouseBackground,
+    };
+
+    enum CursorFlags : unsigned {
+        AutoWrapFlag = 1,
+        OriginModeFlag = 2,
+        VisibleFlag = 4,
+    };
+
+    void writeRGB(string& _output, RGBColor _color)
+    {
+        _output += static_cast<char>(_color.red);
+        _output += static_cast<char>(_color.green);
+        _output += static_cast<char>(_color.blue);
+    }
+
+    optional<RGBColor> readRGB(string_view& _input)
+    {
+        if (_input.size() < 3)
+            return nullopt;
+
+        auto const color = RGBColor{static_cast<uint8_t>(_input[0]),
+                                    static_cast<uint8_t>(_input[1]),
+                                    static_cast<uint8_t>(_input[2])};
+        _input.remove_prefix(3);
+        return color;
+    }
+
+    /// @returns whether the given mode is restored without its side effects,
+    /// as these are covered by the remaining state already.
+    constexpr bool isRestoredSilently(DECMode _mode) noexcept
+    {
+        switch (_mode)
+        {
+            case DECMode::Columns132:
+            case DECMode::UseAlternateScreen:
+            case DECMode::ExtendedAltScreen:
+            case DECMode::SaveCursor:
+            case DECMode::TextReflow:
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+void Screen::saveState(string& _output) const
+{
+    using session::writeNumber;
+
+#if defined(LIBTERMINAL_HYPERLINKS)
+    HyperlinkTable const* const hyperlinks = &hyperlinks_;
+#else
+    HyperlinkTable const* const hyperlinks = nullptr;
+#endif
+
+    writeNumber(_output, static_cast<uint64_t>(size_.width));
+    writeNumber(_output, static_cast<uint64_t>(size_.height));
+    writeNumber(_output, static_cast<uint64_t>(screenType_));
+
+    for (Grid const& grid: grids_)
+        for (Line const& line: grid.mainPage())
+            session::writeLine(_output, line, grid.attributesTable(), hyperlinks);
+
+    for (Cursor const* cursor: {&cursor_, &savedCursor_, &savedPrimaryCursor_})
+    {
+        writeNumber(_output, static_cast<uint64_t>(max(cursor->position.row, 0)));
+        writeNumber(_output, static_cast<uint64_t>(max(cursor->position.column, 0)));
+        writeNumber(_output, (cursor->autoWrap ? AutoWrapFlag : 0u)
+                           | (cursor->originMode ? OriginModeFlag : 0u)
+                           | (cursor->visible ? VisibleFlag : 0u));
+        session::writeAttributes(_output, cursor->graphicsRendition);
+    }
+    writeNumber(_output, static_cast<uint64_t>(wrapPending_));
+
+    // Modes are saved by their VT numbers, so that the enums may change in between.
+    auto ansiModes = vector<int>{};
+    for (size_t i = 0; i < Modes::AnsiModeCount; ++i)
+        if (isValidAnsiMode(static_cast<int>(i)) && modes_.enabled(static_cast<AnsiMode>(i)))
+            ansiModes.push_back(toAnsiModeNum(static_cast<AnsiMode>(i)));
+    auto decModes = vector<int>{};
+    for (size_t i = 0; i < Modes::DECModeCount; ++i)
+        if (isValidDECMode(static_cast<int>(i)) && modes_.enabled(static_cast<DECMode>(i)))
+            decModes.push_back(toDECModeNum(static_cast<DECMode>(i)));
+    for (vector<int> const* modes: {&ansiModes, &decModes})
+    {
+        writeNumber(_output, modes->size());
+        for (int const mode: *modes)
+            writeNumber(_output, static_cast<uint64_t>(mode));
+    }
+
+    writeNumber(_output, static_cast<uint64_t>(margin_.vertical.from));
+    writeNumber(_output, static_cast<uint64_t>(margin_.vertical.to));
+    writeNumber(_output, static_cast<uint64_t>(margin_.horizontal.from));
+    writeNumber(_output, static_cast<uint64_t>(margin_.horizontal.to));
+
+    writeNumber(_output, tabs_.size());
+    for (int const column: tabs_)
+        writeNumber(_output, static_cast<uint64_t>(max(column, 0)));
+    writeNumber(_output, static_cast<uint64_t>(max(tabWidth_, 0)));
+
+    session::writeString(_output, windowTitle_);
+    session::writeString(_output, currentWorkingDirectory_);
+    writeNumber(_output, static_cast<uint64_t>(cursorDisplay_));
+    writeNumber(_output, static_cast<uint64_t>(cursorShape_));
+
+    // Only the colors changed by the application are saved,
+    // so that changes to the configured colors apply on restore.
+    auto changedColors = vector<size_t>{};
+    for (size_t i = 0; i < colorPalette_.palette.size(); ++i)
+        if (colorPalette_.palette[i] != defaultColorPalette_.palette[i])
+            changedColors.push_back(i);
+    writeNumber(_output, changedColors.size());
+    for (size_t const i: changedColors)
+    {
+        writeNumber(_output, i);
+        writeRGB(_output, colorPalette_.palette[i]);
+    }
+
+    auto changedDynamicColors = uint64_t{0};
+    for (size_t i = 0; i < DynamicColors.size(); ++i)
+        if (colorPalette_.*DynamicColors[i] != defaultColorPalette_.*DynamicColors[i])
+            changedDynamicColors |= uint64_t{1} << i;
+    writeNumber(_output, changedDynamicColors);
+    for (size_t i = 0; i < DynamicColors.size(); ++i)
+        if (changedDynamicColors & (uint64_t{1} << i))
+            writeRGB(_output, colorPalette_.*DynamicColors[i]);
+}
+
+bool Screen::restoreState(string_view _state, GraphicsAttributesTable _attributes, vector<Line> _history)
+{
+    // Everything is decoded up front, so that malformed input leaves the screen untouched.
+    auto input = _state;
+    auto malformed = false;
+
+    auto const number = [&]() -> int {
+        auto const value = session::readNumber(input);
+        if (!value || *value > static_cast<uint64_t>(std::numeric_limits<int>::max()))
+        {
+            malformed = true;
+            return 0;
+        }
+        return static_cast<int>(*value);
+    };
+
+    auto const text = [&]() -> string {
+        auto const value = session::readString(input);
+        if (!value)
+        {
+            malformed = true;
+            return {};
+        }
+        return string(*value);
+    };
+
+    auto const rgb = [&]() -> RGBColor {
+        auto const value = readRGB(input);
+        if (!value)
+        {
+            malformed = true;
+            return {};
+        }
+        return *value;
+    };
+
+#if defined(LIBTERMINAL_HYPERLINKS)
+    HyperlinkTable* const hyperlinks = &hyperlinks_;
+#else
+    HyperlinkTable* const hyperlinks = nullptr;
+#endif
+
+    auto const savedSize = Size{number(), number()};
+    auto const savedScreenType = number() == static_cast<int>(ScreenType::Alternate) ? ScreenType::Alternate
+                                                                                      : ScreenType::Main;
+
+    auto alternateAttributes = GraphicsAttributesTable{};
+    auto pages = std::array<vector<Line>, 2>{};
+    for (size_t i = 0; i < pages.size() && !malformed; ++i)
+    {
+        auto& attributes = i == 0 ? _attributes : alternateAttributes;
+        for (int row = 0; row < savedSize.height && !malformed; ++row)
+        {
+            auto line = session::readLine(input, attributes, hyperlinks);
+            if (line)
+                pages[i].emplace_back(move(*line));
+            else
+                malformed = true;
+        }
+    }
+
+    auto cursors = std::array<Cursor, 3>{};
+    for (Cursor& cursor: cursors)
+    {
+        cursor.position.row = number();
+        cursor.position.column = number();
+        auto const flags = static_cast<unsigned>(number());
+        cursor.autoWrap = flags & AutoWrapFlag;
+        cursor.originMode = flags & OriginModeFlag;
+        cursor.visible = flags & VisibleFlag;
+        if (auto const attributes = session::readAttributes(input); attributes)
+            cursor.graphicsRendition = *attributes;
+        else
+            malformed = true;
+    }
+    auto const wrapPending = number();
+
+    auto ansiModes = vector<int>{};
+    auto decModes = vector<int>{};
+    for (vector<int>* modes: {&ansiModes, &decModes})
+    {
+        auto const count = number();
+        for (int i = 0; i < count && !malformed; ++i)
+            modes->push_back(number());
+    }
+
+    auto margin = Margin{};
+    margin.vertical.from = number();
+    margin.vertical.to = number();
+    margin.horizontal.from = number();
+    margin.horizontal.to = number();
+
+    auto tabs = vector<int>{};
+    auto const tabCount = number();
+    for (int i = 0; i < tabCount && !malformed; ++i)
+        tabs.push_back(number());
+    auto const tabWidth = number();
+
+    auto const windowTitle = text();
+    auto const workingDirectory = text();
+    auto const cursorDisplay = number();
+    auto const cursorShape = number();
+
+    auto palette = defaultColorPalette_;
+    auto const changedColorCount = number();
+    for (int i = 0; i < changedColorCount && !malformed; ++i)
+    {
+        auto const index = static_cast<size_t>(number());
+        auto const color = rgb();
+        if (index < palette.palette.size())
+            palette.palette[index] = color;
+    }
+    auto const changedDynamicColors = static_cast<unsigned>(number());
+    for (size_t i = 0; i < DynamicColors.size() && !malformed; ++i)
+        if (changedDynamicColors & (1u << i))
+            palette.*DynamicColors[i] = rgb();
+
+    if (malformed)
+        return false;
+
+    // {{{ apply
+    auto const movedLineCount = primaryGrid().restore(move(_attributes), move(_history), move(pages[0]));
+    (void) alternateGrid().restore(move(alternateAttributes), {}, move(pages[1]));
+
+    auto const hasMode = [](vector<int> const& _modes, int _mode) {
+        return std::find(_modes.begin(), _modes.end(), _mode) != _modes.end();
+    };
+    for (size_t i = 0; i < Modes::AnsiModeCount; ++i)
+        if (auto const mode = static_cast<AnsiMode>(i); isValidAnsiMode(static_cast<int>(i)))
+            setMode(mode, hasMode(ansiModes, toAnsiModeNum(mode)));
+    for (size_t i = 0; i < Modes::DECModeCount; ++i)
+    {
+        auto const mode = static_cast<DECMode>(i);
+        if (!isValidDECMode(static_cast<int>(i)) || mode == DECMode::DebugLogging)
+            continue;
+
+        auto const enabled = hasMode(decModes, toDECModeNum(mode));
+        if (isRestoredSilently(mode))
+            modes_.set(mode, enabled);
+        else if (enabled != isModeEnabled(mode))
+            setMode(mode, enabled);
+    }
+    setBuffer(savedScreenType);
+
+    // The main page's lines scrolled into the history when the screen got smaller,
+    // along with the primary buffer's cursors.
+    cursors[2].position.row -= movedLineCount;
+    if (savedScreenType == ScreenType::Main)
+    {
+        cursors[0].position.row -= movedLineCount;
+        cursors[1].position.row -= movedLineCount;
+    }
+    for (Cursor& cursor: cursors)
+        cursor.position = Coordinate{clamp(cursor.position.row, 1, size_.height),
+                                     clamp(cursor.position.column, 1, size_.width)};
+    cursor_ = cursors[0];
+    savedCursor_ = cursors[1];
+    savedPrimaryCursor_ = cursors[2];
+    wrapPending_ = cursor_.position.column == size_.width ? min(wrapPending, 1) : 0;
+
+    if (savedSize == size_
+            && 1 <= margin.vertical.from && margin.vertical.from < margin.vertical.to && margin.vertical.to <= size_.height
+            && 1 <= margin.horizontal.from && margin.horizontal.from < margin.horizontal.to && margin.horizontal.to <= size_.width)
+        margin_ = margin;
+    else
+        margin_ = Margin{{1, size_.height}, {1, size_.width}};
+
+    tabs_.clear();
+    for (int const column: tabs)
+        if (1 <= column && column <= size_.width)
+            tabs_.push_back(column);
+    tabWidth_ = tabWidth;
+
+    setWindowTitle(windowTitle);
+    currentWorkingDirectory_ = workingDirectory;
+    setCursorStyle(cursorDisplay == static_cast<int>(CursorDisplay::Blink) ? CursorDisplay::Blink : CursorDisplay::Steady,
+                   cursorShape <= static_cast<int>(CursorShape::Bar) ? static_cast<CursorShape>(cursorShape) : CursorShape::Block);
+    colorPalette_ = palette;
+
+    updateCursorIterators();
+    // }}}
+
+    return true;
+}
+// }}}
+
 void Screen::dumpState()
 {
     eventListener_.dumpState();
@@ -2453,6 +2996,9 @@ void Screen::dumpState(std::string const& _message) const
         cerr << fmt::format("real cursor position : {})\n", toRealCoordinate(cursor_.position));
     cerr << fmt::format("vertical margins     : {}\n", margin_.vertical);
     cerr << fmt::format("horizontal margins   : {}\n", margin_.horizontal);
+    cerr << fmt::format("images               : {} ({} bytes), {} evicted ({} bytes)\n",
+                        imagePool_.imageCount(), imagePool_.imageBytes(),
+                        imagePool_.evictedImageCount(), imagePool_.evictedImageBytes());
 
     hline();
     cerr << screenshot([this](int _lineNo) -> string {
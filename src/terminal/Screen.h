@@ -21,7 +21,9 @@
 #include <terminal/Image.h>
 #include <terminal/Parser.h>
 #include <terminal/ScreenEvents.h>
+#include <terminal/Screenshot.h>
 #include <terminal/Sequencer.h>
+#include <terminal/TriggerEngine.h>
 #include <terminal/VTType.h>
 
 #include <crispy/algorithm.h>
@@ -37,6 +39,7 @@
 #include <fmt/format.h>
 
 #include <algorithm>
+#include <bitset>
 #include <deque>
 #include <functional>
 #include <list>
@@ -55,53 +58,76 @@ namespace terminal {
 // {{{ Modes
 /// API for setting/querying terminal modes.
 ///
-/// This abstracts away the actual implementation for more intuitive use and easier future adaptability.
+/// Modes are stored in dense bitsets indexed by their enum value, so querying a mode
+/// is a single bit test and cheap enough to be done per printed character.
 class Modes {
   public:
+    // Upper bounds (exclusive) of the AnsiMode and DECMode enum values.
+    static constexpr size_t AnsiModeCount = 32;
+    static constexpr size_t DECModeCount = 2048;
+
     void set(AnsiMode _mode, bool _enabled)
     {
-        if (_enabled)
-            ansi_.insert(_mode);
-        else if (auto i = ansi_.find(_mode); i != ansi_.end())
-            ansi_.erase(i);
+        if (auto const i = static_cast<size_t>(_mode); i < ansi_.size())
+            ansi_.set(i, _enabled);
     }
 
-    void set(DECMode  _mode, bool _enabled)
+    void set(DECMode _mode, bool _enabled)
     {
-        if (_enabled)
-            dec_.insert(_mode);
-        else if (auto i = dec_.find(_mode); i != dec_.end())
-            dec_.erase(i);
+        if (auto const i = static_cast<size_t>(_mode); i < dec_.size())
+            dec_.set(i, _enabled);
     }
 
-    bool enabled(AnsiMode _mode) const noexcept { return ansi_.find(_mode) != ansi_.end(); }
+    bool enabled(AnsiMode _mode) const noexcept
+    {
+        auto const i = static_cast<size_t>(_mode);
+        return i < ansi_.size() && ansi_.test(i);
+    }
 
-    bool enabled(DECMode _mode) const noexcept { return dec_.find(_mode) != dec_.end(); }
+    bool enabled(DECMode _mode) const noexcept
+    {
+        auto const i = static_cast<size_t>(_mode);
+        return i < dec_.size() && dec_.test(i);
+    }
+
+    /// Compile-time variant of enabled() without any bounds check, for use in inner loops.
+    template <DECMode Mode>
+    bool enabled() const noexcept
+    {
+        static_assert(static_cast<size_t>(Mode) < DECModeCount);
+        return dec_[static_cast<size_t>(Mode)];
+    }
 
     void save(std::vector<DECMode> const& _modes)
     {
         for (DECMode const mode : _modes)
-            savedModes_[mode].push_back(enabled(mode));
+            savedModes_.push_back(SavedMode{mode, enabled(mode)});
     }
 
     void restore(std::vector<DECMode> const& _modes)
     {
         for (DECMode const mode : _modes)
         {
-            if (auto i = savedModes_.find(mode); i != savedModes_.end() && !i->second.empty())
+            // Restores the most recently saved state of the given mode.
+            auto const i = std::find_if(savedModes_.rbegin(), savedModes_.rend(),
+                                        [&](SavedMode const& _saved) { return _saved.mode == mode; });
+            if (i != savedModes_.rend())
             {
-                auto& saved = i->second;
-                set(mode, saved.back());
-                saved.pop_back();
+                set(mode, i->enabled);
+                savedModes_.erase(std::next(i).base());
             }
         }
     }
 
   private:
-    // TODO: make this a vector<bool> by casting from Mode, but that requires ensured small linearity in Mode enum values.
-    std::set<AnsiMode> ansi_;
-    std::set<DECMode> dec_;
-    std::map<DECMode, std::vector<bool>> savedModes_; //!< saved DEC modes
+    struct SavedMode {
+        DECMode mode;
+        bool enabled;
+    };
+
+    std::bitset<AnsiModeCount> ansi_;
+    std::bitset<DECModeCount> dec_;
+    std::vector<SavedMode> savedModes_; //!< saved DEC modes, most recently saved last
 };
 // }}}
 
@@ -163,6 +189,7 @@ class Screen : public capabilities::StaticDatabase {
 
     void setMaxImageColorRegisters(int _value) noexcept { sequencer_.setMaxImageColorRegisters(_value); }
     void setSixelCursorConformance(bool _value) noexcept { sixelCursorConformance_ = _value; }
+    void setSixelProgressive(bool _value) noexcept { sequencer_.setSixelProgressive(_value); }
 
     void setRespondToTCapQuery(bool _enable) { respondToTCapQuery_ = _enable; }
 
@@ -181,8 +208,36 @@ class Screen : public capabilities::StaticDatabase {
     void setMaxHistoryLineCount(std::optional<int> _maxHistoryLineCount);
     std::optional<int> maxHistoryLineCount() const noexcept { return grid().maxHistoryLineCount(); }
 
+    /// Sets the number of most recent history lines to keep uncompressed (std::nullopt for all).
+    void setHistoryCompressionThreshold(std::optional<int> _threshold);
+
+    /// Sets the number of most recent history lines to keep in memory (std::nullopt for all),
+    /// with older ones being spilled into a scrollback file within @p _directory.
+    void setHistorySpill(std::optional<int> _threshold, std::string _directory = {});
+
+    /// Sets the maximum bytes of memory the history lines may hold (std::nullopt for no limit).
+    void setMaxHistoryBytes(std::optional<size_t> _bytes);
+
     int historyLineCount() const noexcept { return grid().historyLineCount(); }
 
+    /// Modification counter of the active buffer, see Grid::generation().
+    uint64_t generation() const noexcept { return grid().generation(); }
+
+    /// @returns the rows (1-based) at the given scroll offset modified after generation @p _generation.
+    std::vector<int> changedLines(uint64_t _generation, std::optional<int> _scrollOffset = std::nullopt) const
+    {
+        return grid().changedLines(_generation, _scrollOffset);
+    }
+
+    /// Number of oldest history lines still to be reflowed after a resize.
+    int pendingReflowLineCount() const noexcept { return grids_[0].pendingReflowLineCount(); }
+
+    /// Reflows pending history lines to the current width (at most @p _maxLines of them).
+    ///
+    /// @returns the number of history lines gained (negative if lost).
+    /// @see Grid::reflowHistory()
+    int reflowHistory(std::optional<int> _maxLines = std::nullopt) { return primaryGrid().reflowHistory(_maxLines); }
+
     /// Writes given data into the screen.
     void write(char const* _data, size_t _size);
 
@@ -193,6 +248,12 @@ class Screen : public capabilities::StaticDatabase {
 
     void writeText(char32_t _char);
 
+    /// Writes a run of printable US-ASCII characters (0x20..0x7E) into the screen.
+    ///
+    /// This is semantically equivalent to calling writeText(char32_t) for each character,
+    /// but fills the current line up to the right margin in one go.
+    void writeText(std::string_view _chars);
+
     /// Renders the full screen by passing every grid cell to the callback.
     template <typename Renderer>
     void render(Renderer&& _render, std::optional<int> _scrollOffset = std::nullopt) const
@@ -200,6 +261,13 @@ class Screen : public capabilities::StaticDatabase {
         activeGrid_->render(std::forward<Renderer>(_render), _scrollOffset);
     }
 
+    /// Renders the full screen by passing each row's cells at once to the callback, see Grid::renderRows().
+    template <typename Renderer>
+    void renderRows(Renderer&& _render, std::optional<int> _scrollOffset = std::nullopt) const
+    {
+        activeGrid_->renderRows(std::forward<Renderer>(_render), _scrollOffset);
+    }
+
     /// Renders a single text line.
     std::string renderTextLine(int _row) const;
 
@@ -214,6 +282,10 @@ class Screen : public capabilities::StaticDatabase {
     ///          including initial clear screen, and initial cursor hide.
     std::string screenshot(std::function<std::string(int)> const& _postLine = {}) const;
 
+    /// Copies the lines of the current buffer, to be written by writeScreenshot() without
+    /// the screen being locked, e.g. into a file.
+    Screenshot captureScreenshot() const;
+
     void setFocus(bool _focused) { focused_ = _focused; }
     bool focused() const noexcept { return focused_; }
 
@@ -309,6 +381,26 @@ class Screen : public capabilities::StaticDatabase {
     void requestPixelSize(RequestPixelSize _area);
     void requestCharacterSize(RequestPixelSize _area);
     void sixelImage(crispy::Size _pixelSize, Image::Data&& _rgba);
+
+    /// Renders a horizontal strip of a Sixel image that is still being decoded.
+    ///
+    /// The first strip is placed where sixelImage() would place the whole image,
+    /// each following strip directly underneath the previous one.
+    void sixelImageStrip(crispy::Size _pixelSize, Image::Data&& _rgba, bool _first, bool _last);
+
+    /// Displays an RGBA image that a local application passed in shared memory,
+    /// placing it like sixelImage() does.
+    ///
+    /// The image is ignored unless the event listener permits shared images.
+    ///
+    /// @see loadSharedImage()
+    void sharedImage(std::string const& _name, crispy::Size _pixelSize);
+
+    /// Displays an RGBA image transferred compressed (see ImageTransfer),
+    /// placing it like sixelImage() does.
+    ///
+    /// The pixels are decompressed in the background, see ImagePool.
+    void compressedImage(crispy::Size _pixelSize, Image::CompressedData&& _pixels);
     void requestStatusString(RequestStatusString _value);
     void requestTabStops();
     void resetDynamicColor(DynamicColorName _name);
@@ -469,11 +561,47 @@ class Screen : public capabilities::StaticDatabase {
     /// Gets a reference to the cell relative to screen origin (top left, 1:1).
     Cell const& at(Coordinate const& _coord) const noexcept { return grid().at(_coord); }
 
+    /// Gets the graphics rendition of the cell relative to screen origin (top left, 1:1).
+    GraphicsAttributes const& attributesAt(Coordinate const& _coord) const noexcept { return grid().attributes(at(_coord)); }
+
+#if defined(LIBTERMINAL_HYPERLINKS)
+    /// Table of all hyperlinks referenced by the cells of both screen buffers.
+    HyperlinkTable& hyperlinks() noexcept { return hyperlinks_; }
+    HyperlinkTable const& hyperlinks() const noexcept { return hyperlinks_; }
+
+    /// Gets the hyperlink of the cell relative to screen origin (top left, 1:1), or nullptr if there is none.
+    HyperlinkInfo* hyperlinkAt(Coordinate const& _coord) noexcept { return hyperlinks_.find(at(_coord).hyperlink()); }
+    HyperlinkInfo const* hyperlinkAt(Coordinate const& _coord) const noexcept { return hyperlinks_.find(at(_coord).hyperlink()); }
+#endif
+
+    /// Gets the URL or file path detected in the plain text at the given position relative to screen
+    /// origin (top left, 1:1), see Line::detectedLinks().
+    std::optional<DetectedLink> detectedLinkAt(Coordinate const& _coord) const;
+
+    /// @returns the hyperlink to follow for the link @p _link detected in line @p _row.
+    ///
+    /// File paths are made absolute, relative to the home directory or the current working directory.
+    HyperlinkInfo detectedHyperlink(int _row, DetectedLink const& _link) const;
+
+    /// Sets whether links are detected in lines as soon as the cursor leaves them, such as on linefeed,
+    /// rather than when first looked up, see Line::detectedLinks().
+    ///
+    /// Disabled while bulk output is written, as its lines will hardly ever be looked at.
+    void setEagerLinkDetection(bool _enabled) noexcept { eagerLinkDetection_ = _enabled; }
+    bool eagerLinkDetection() const noexcept { return eagerLinkDetection_; }
+
+    /// Sets the triggers whose patterns are looked for in each line as the cursor leaves it
+    /// on linefeed, see TriggerEngine. Matches are recorded along with the line (see
+    /// Line::triggerMatches()), and mark the line or are notified about, depending on their trigger.
+    void setTriggers(std::vector<Trigger> _triggers);
+    TriggerEngine const& triggers() const noexcept { return triggers_; }
+
     bool isPrimaryScreen() const noexcept { return activeGrid_ == &grids_[0]; }
     bool isAlternateScreen() const noexcept { return activeGrid_ == &grids_[1]; }
 
     bool isModeEnabled(AnsiMode m) const noexcept { return modes_.enabled(m); }
     bool isModeEnabled(DECMode m) const noexcept { return modes_.enabled(m); }
+    Modes const& modes() const noexcept { return modes_; }
 
     bool isModeEnabled(std::variant<AnsiMode, DECMode> m) const {
         if (std::holds_alternative<AnsiMode>(m))
@@ -535,6 +663,52 @@ class Screen : public capabilities::StaticDatabase {
 
     void setMaxImageSize(crispy::Size _size) noexcept { sequencer_.setMaxImageSize(_size); }
 
+    /// Limits the host memory used by images to @p _bytes, or 0 for no limit.
+    ///
+    /// Beyond that limit, images only displayed in the history are evicted, oldest first,
+    /// leaving blank cells in their place.
+    void setMaxImageMemory(size_t _bytes)
+    {
+        imagePool_.setMemoryLimit(_bytes);
+        evictImages();
+    }
+
+    ImagePool const& imagePool() const noexcept { return imagePool_; }
+
+    /// Compresses the pixels of the images not accessed since @p _unusedSince.
+    ///
+    /// May be invoked from any thread, see ImagePool::compressUnusedImages().
+    size_t compressUnusedImages(Image::Clock::time_point _unusedSince)
+    {
+        return imagePool_.compressUnusedImages(_unusedSince);
+    }
+
+    /// Accounts the memory held by both grids, the hyperlinks and the images to @p _usage.
+    void collectMemoryUsage(crispy::memory_usage& _usage) const;
+
+    /// Gives back the memory the parser and the sequencer have grown their buffers to.
+    void trimMemory();
+
+    // {{{ session persistence
+    /// Appends the screen's state except for the history to @p _output, see SessionFile.
+    ///
+    /// That is the main page of both buffers, the cursors, modes, margins, tab stops, window title,
+    /// working directory, cursor style and the colors changed from the default color palette.
+    /// Character sets and images are not saved.
+    void saveState(std::string& _output) const;
+
+    /// Restores the state saved by saveState() along with the given history lines of the primary
+    /// buffer, whose cells reference the given attributes table.
+    ///
+    /// Pages of a different size are fitted like when resizing without reflow.
+    ///
+    /// @returns whether @p _state could be decoded, leaving the screen untouched otherwise.
+    bool restoreState(std::string_view _state, GraphicsAttributesTable _attributes, std::vector<Line> _history);
+    // }}}
+
+    /// @returns usage counters of all VT functions processed by this screen so far.
+    Metrics const& metrics() const noexcept { return sequencer_.metrics(); }
+
     void scrollUp(int n) { scrollUp(n, margin_); }
     void scrollDown(int n) { scrollDown(n, margin_); }
 
@@ -585,6 +759,12 @@ class Screen : public capabilities::StaticDatabase {
   private:
     void setBuffer(ScreenType _type);
 
+    /// Evicts images from the history while the image pool is over its memory budget.
+    void evictImages();
+
+    /// Places an image at the cursor like a Sixel image, advancing the cursor accordingly.
+    void placeImage(std::shared_ptr<Image const> _image, crispy::Size _pixelSize);
+
     void clearAllTabs();
     void clearTabUnderCursor();
     void setTabUnderCursor();
@@ -592,14 +772,25 @@ class Screen : public capabilities::StaticDatabase {
     /// Applies LF but also moves cursor to given column @p _column.
     void linefeed(int _column);
 
+    /// Looks for the trigger patterns in the current line, see setTriggers().
+    void scanTriggers();
+
     void writeCharToCurrentAndAdvance(char32_t _codepoint);
     void clearAndAdvance(int _offset);
 
+    /// @returns the identifier of the cursor's graphics rendition within the active grid.
+    GraphicsAttributesId graphicsRenditionId() { return grid().intern(cursor_.graphicsRendition); }
+
+#if defined(LIBTERMINAL_HYPERLINKS)
+    /// Releases all hyperlinks that are not referenced by any cell anymore.
+    void collectUnusedHyperlinks();
+#endif
+
     void fail(std::string const& _message) const;
 
     void updateCursorIterators()
     {
-        currentLine_ = next(begin(grid().mainPage()), cursor_.position.row - 1);
+        currentLine_ = std::next(begin(grid().mainPage()), cursor_.position.row - 1);
         updateColumnIterator();
     }
 
@@ -646,7 +837,6 @@ class Screen : public capabilities::StaticDatabase {
     VTType terminalId_ = VTType::VT525;
 
     Modes modes_;
-    std::map<DECMode, std::vector<bool>> savedModes_; //!< saved DEC modes
 
     ColorPalette defaultColorPalette_;
     ColorPalette colorPalette_;
@@ -666,6 +856,7 @@ class Screen : public capabilities::StaticDatabase {
     std::stack<std::string> savedWindowTitles_{};
 
     bool sixelCursorConformance_ = true;
+    Coordinate progressiveSixelOrigin_{}; //!< top left of the Sixel image currently rendered progressively
 
     // XXX moved from ScreenBuffer
     Margin margin_;
@@ -697,12 +888,17 @@ class Screen : public capabilities::StaticDatabase {
     CursorShape cursorShape_ = CursorShape::Block;
 
     std::string currentWorkingDirectory_ = {};
+    bool eagerLinkDetection_ = true;
+
+    TriggerEngine triggers_;
+    TriggerEngine::State triggerState_ = TriggerEngine::InitialState; // after the most recently scanned line
+    std::vector<TriggerMatch> triggerMatches_;  // of the line being scanned, kept to reuse its memory
 
     // Hyperlink related
     //
 #if defined(LIBTERMINAL_HYPERLINKS)
-    HyperlinkRef currentHyperlink_ = {};
-    std::unordered_map<std::string, HyperlinkRef> hyperlinks_; // TODO: use a deque<> instead, always push_back, lookup reverse, evict in front.
+    HyperlinkId currentHyperlink_ = NoHyperlinkId;
+    HyperlinkTable hyperlinks_;
 #endif
 
     // experimental features
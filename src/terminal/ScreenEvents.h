@@ -70,6 +70,9 @@ class ScreenEvents {
     // Invoked by screen buffer when an image is not being referenced by any grid cell anymore.
     virtual void discardImage(Image const&) {}
 
+    /// @returns whether images may be loaded from the shared memory of local applications.
+    virtual bool permitSharedImage() { return false; }
+
     /// Invoked upon `DCS $ p <profile-name> ST` to change terminal's currently active profile name.
     virtual void setTerminalProfile(std::string const& /*_configProfileName*/) {}
 };
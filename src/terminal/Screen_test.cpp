@@ -117,6 +117,114 @@ TEST_CASE("AppendChar", "[screen]")
     REQUIRE("F  " == screen.renderTextLine(1));
 }
 
+TEST_CASE("AppendChar.bulk", "[screen]")
+{
+    auto screen = MockScreen{{3, 2}};
+
+    SECTION("without auto-wrap")
+    {
+        screen.setMode(DECMode::AutoWrap, false);
+        screen.writeText("ABCDE"sv);
+        CHECK("ABE\n   \n" == screen.renderText());
+        CHECK(screen.cursorPosition() == Coordinate{1, 3});
+        CHECK_FALSE(screen.wrapPending());
+    }
+
+    SECTION("with auto-wrap")
+    {
+        screen.writeText("ABCDE"sv);
+        CHECK("ABC\nDE \n" == screen.renderText());
+        CHECK(screen.cursorPosition() == Coordinate{2, 3});
+
+        screen.writeText("F"sv);
+        CHECK("ABC\nDEF\n" == screen.renderText());
+        CHECK(screen.wrapPending());
+
+        screen.writeText("GH"sv);
+        CHECK("DEF\nGH \n" == screen.renderText());
+        CHECK(screen.cursorPosition() == Coordinate{2, 3});
+    }
+
+    SECTION("with left/right margin")
+    {
+        auto wide = MockScreen{{5, 2}};
+        wide.setMode(DECMode::LeftRightMargin, true);
+        wide.setLeftRightMargin(2, 4);
+        wide.moveCursorTo({1, 2});
+        wide.writeText("abcdef"sv);
+        CHECK(" abc \n def \n" == wide.renderText());
+        CHECK(wide.cursorPosition() == Coordinate{2, 4});
+    }
+
+    SECTION("with designated charset")
+    {
+        screen.designateCharset(CharsetTable::G0, CharsetId::Special);
+        screen.writeText("qxq"sv);
+        screen.designateCharset(CharsetTable::G0, CharsetId::USASCII);
+        screen.writeText("qxq"sv);
+        CHECK("\u2500\u2502\u2500\nqxq\n" == screen.renderText());
+    }
+
+    SECTION("combining character after ASCII")
+    {
+        screen.write(u8"ab\u0301");
+        CHECK(screen.cursorPosition() == Coordinate{1, 3});
+        CHECK(screen.at({1, 2}).codepointCount() == 2);
+    }
+
+    SECTION("same as per-character writes")
+    {
+        auto other = MockScreen{{3, 2}};
+        screen.write("\033[31m");
+        other.write("\033[31m");
+        screen.writeText("Hello World"sv);
+        for (char const ch : "Hello World"sv)
+            other.writeText(static_cast<char32_t>(ch));
+
+        CHECK(screen.renderText() == other.renderText());
+        CHECK(screen.cursorPosition() == other.cursorPosition());
+        CHECK(screen.wrapPending() == other.wrapPending());
+        CHECK(screen.attributesAt({2, 2}) == other.attributesAt({2, 2}));
+    }
+}
+
+TEST_CASE("Screen.changedLines", "[screen]")
+{
+    auto screen = MockScreen{{4, 3}};
+    auto generation = screen.generation();
+
+    screen.write("AB");
+    CHECK(screen.changedLines(generation) == vector<int>{1});
+
+    generation = screen.generation();
+    CHECK(screen.changedLines(generation).empty());
+
+    screen.write("\033[3;1H"); // CUP
+    CHECK(screen.changedLines(generation).empty());
+
+    screen.write("\033[K"); // EL
+    CHECK(screen.changedLines(generation) == vector<int>{3});
+
+    generation = screen.generation();
+    screen.write("\033[2;1H\033[L"); // CUP, IL
+    CHECK(screen.changedLines(generation) == vector<int>{2, 3});
+
+    generation = screen.generation();
+    screen.write("\033[3;1H\n"); // CUP, LF (scrolling up)
+    CHECK(screen.changedLines(generation) == vector<int>{1, 2, 3});
+
+    // Only the rows differing between the primary and alternate screen have changed.
+    screen.write("\033[1;1HX");
+    generation = screen.generation();
+    screen.write("\033[?1049h"); // alternate screen
+    CHECK(screen.changedLines(generation) == vector<int>{1});
+
+    screen.write("\033[3;1HY");
+    generation = screen.generation();
+    screen.write("\033[?1049l"); // primary screen
+    CHECK(screen.changedLines(generation) == vector<int>{1, 3});
+}
+
 TEST_CASE("AppendChar_CR_LF", "[screen]")
 {
     auto screen = MockScreen{{3, 2}};
@@ -145,13 +253,13 @@ TEST_CASE("AppendChar.emoji_exclamationmark", "[screen]")
 
     screen.write(U"\u2757"); // ❗
     // screen.write(U"\uFE0F");
-    CHECK(screen.at({1, 1}).attributes().backgroundColor == IndexedColor::Blue);
+    CHECK(screen.attributesAt({1, 1}).backgroundColor == IndexedColor::Blue);
     CHECK(screen.at({1, 1}).width() == 2);
-    CHECK(screen.at({1, 2}).attributes().backgroundColor == IndexedColor::Blue);
+    CHECK(screen.attributesAt({1, 2}).backgroundColor == IndexedColor::Blue);
     CHECK(screen.at({1, 2}).width() == 1);
 
     screen.write(U"M");
-    CHECK(screen.at({1, 3}).attributes().backgroundColor == IndexedColor::Blue);
+    CHECK(screen.attributesAt({1, 3}).backgroundColor == IndexedColor::Blue);
 }
 
 TEST_CASE("AppendChar.emoji_VS16_fixed_width", "[screen]")
@@ -1771,6 +1879,43 @@ TEST_CASE("captureBuffer", "[screen]")
     }
 }
 
+TEST_CASE("captureBuffer.fragments", "[screen]")
+{
+    auto screen = MockScreen{{10, 2}};
+    auto expected = string{};
+    for (int i = 0; i < 1000; ++i)
+    {
+        auto const line = fmt::format("line {:04}", i);
+        screen.write(line + (i != 999 ? "\r\n" : ""));
+        expected += line + '\n';
+    }
+
+    screen.captureBuffer(1000, false);
+
+    // Replied in fragments of bounded size, followed by an empty one.
+    auto fragments = vector<string_view>{};
+    auto replies = string_view(screen.replyData);
+    while (!replies.empty())
+    {
+        REQUIRE(replies.substr(0, 6) == "\033]314;");
+        auto const end = replies.find("\033\\");
+        REQUIRE(end != string_view::npos);
+        fragments.emplace_back(replies.substr(6, end - 6));
+        replies.remove_prefix(end + 2);
+    }
+
+    REQUIRE(fragments.size() == 4);
+    CHECK(fragments.back().empty());
+
+    auto captured = string{};
+    for (auto const fragment: fragments)
+    {
+        CHECK(fragment.size() <= 4096);
+        captured += fragment;
+    }
+    CHECK(captured == expected);
+}
+
 TEST_CASE("render into history", "[screen]")
 {
     auto screen = MockScreen{{5, 2}};
@@ -2320,6 +2465,58 @@ TEST_CASE("save_restore_DEC_modes", "[screen]")
     CHECK_FALSE(screen.isModeEnabled(DECMode::MouseProtocolHighlightTracking));
 }
 
+TEST_CASE("save_restore_DEC_modes.nested", "[screen]")
+{
+    auto screen = MockScreen{{2, 2}};
+
+    screen.setMode(DECMode::BracketedPaste, true);
+    screen.setMode(DECMode::TextReflow, false);
+    screen.saveModes(vector{DECMode::BracketedPaste, DECMode::TextReflow});
+
+    screen.setMode(DECMode::BracketedPaste, false);
+    screen.saveModes(vector{DECMode::BracketedPaste});
+
+    screen.setMode(DECMode::BracketedPaste, true);
+    screen.setMode(DECMode::TextReflow, true);
+    CHECK(screen.modes().enabled<DECMode::TextReflow>());
+
+    // Only the most recently saved state is restored.
+    screen.restoreModes(vector{DECMode::BracketedPaste});
+    CHECK_FALSE(screen.isModeEnabled(DECMode::BracketedPaste));
+    CHECK(screen.isModeEnabled(DECMode::TextReflow));
+
+    screen.restoreModes(vector{DECMode::BracketedPaste, DECMode::TextReflow});
+    CHECK(screen.isModeEnabled(DECMode::BracketedPaste));
+    CHECK_FALSE(screen.isModeEnabled(DECMode::TextReflow));
+
+    // Nothing left to restore.
+    screen.restoreModes(vector{DECMode::BracketedPaste});
+    CHECK(screen.isModeEnabled(DECMode::BracketedPaste));
+}
+
+#if defined(LIBTERMINAL_HYPERLINKS)
+TEST_CASE("OSC.8", "[screen]")
+{
+    auto screen = MockScreen{{4, 2}};
+    screen.write("\033]8;id=a;https://a.example/\033\\AB\033]8;;\033\\C");
+
+    REQUIRE(screen.hyperlinkAt({1, 1}) != nullptr);
+    CHECK(screen.hyperlinkAt({1, 1})->uri == "https://a.example/");
+    CHECK(screen.at({1, 1}).hyperlink() == screen.at({1, 2}).hyperlink());
+    CHECK(screen.hyperlinkAt({1, 3}) == nullptr);
+
+    SECTION("unused hyperlinks are released once the table is full") {
+        for (size_t i = 0; i < HyperlinkTable::Capacity; ++i)
+            screen.hyperlink("", "https://b.example/");
+        screen.write("D");
+        CHECK(screen.hyperlinks().size() == HyperlinkTable::Capacity);
+        CHECK(screen.hyperlinkAt({1, 1})->uri == "https://a.example/");
+        REQUIRE(screen.hyperlinkAt({1, 4}) != nullptr);
+        CHECK(screen.hyperlinkAt({1, 4})->uri == "https://b.example/");
+    }
+}
+#endif
+
 TEST_CASE("OSC.4")
 {
     auto screen = MockScreen{{2, 2}};
@@ -2578,6 +2775,24 @@ TEST_CASE("DECCRA.Left.intersecting", "[screen]")
 }
 // }}}
 
+TEST_CASE("SetGraphicsRendition.sub_parameters", "[screen]")
+{
+    auto screen = MockScreen{{4, 1}};
+
+    screen.write("\033[38:2:10:20:30m\033[48:5:3mA");
+    CHECK(screen.attributesAt({1, 1}).foregroundColor == Color{RGBColor{10, 20, 30}});
+    CHECK(screen.attributesAt({1, 1}).backgroundColor == Color{IndexedColor::Yellow});
+
+    // The maximum number of parameters is accepted.
+    screen.write("\033[0;1;1;1;1;1;1;1;1;1;1;1;1;1;1;31mB");
+    CHECK(screen.attributesAt({1, 2}).foregroundColor == Color{IndexedColor::Red});
+    CHECK(screen.attributesAt({1, 2}).styles & CellFlags::Bold);
+
+    // The parameter list is reset for each sequence.
+    screen.write("\033[mC");
+    CHECK(screen.attributesAt({1, 3}).foregroundColor == Color{DefaultColor()});
+}
+
 // TODO: SetForegroundColor
 // TODO: SetBackgroundColor
 // TODO: SetGraphicsRendition
@@ -2589,7 +2804,22 @@ TEST_CASE("DECCRA.Left.intersecting", "[screen]")
 // TODO: DesignateCharset
 // TODO: SingleShiftSelect
 
-// TODO: ChangeWindowTitle
+TEST_CASE("ChangeWindowTitle", "[screen]")
+{
+    auto screen = MockScreen{{4, 1}};
+
+    SECTION("within a single write") {
+        screen.write("\033]2;Hello World\033\\");
+        CHECK(screen.windowTitle() == "Hello World");
+    }
+
+    SECTION("split across writes") {
+        screen.write("\033]2;Hel");
+        screen.write("lo W\xC3");
+        screen.write("\xB6rld\x07");
+        CHECK(screen.windowTitle() == "Hello W\xC3\xB6rld");
+    }
+}
 
 // TODO: Bell
 // TODO: FullReset
@@ -2597,3 +2827,83 @@ TEST_CASE("DECCRA.Left.intersecting", "[screen]")
 // TODO: DeviceStatusReport
 // TODO: SendDeviceAttributes
 // TODO: SendTerminalId
+
+TEST_CASE("Metrics", "[screen]")
+{
+    auto screen = MockScreen{{10, 3}};
+    screen.write("\033[2;3H\033[1m\033[mAB\033[m\033]2;title\033\\\033[?1;2;3z");
+
+    auto const& metrics = screen.metrics();
+    CHECK(metrics.count(*selectControl(0, 2, 0, 'H')) == 1);
+    CHECK(metrics.count(*selectControl(0, 1, 0, 'm')) == 3);
+    CHECK(metrics.count(*selectOSCommand(2)) == 1);
+    CHECK(metrics.unknownCount() == 1);
+    CHECK(metrics.total() == 6);
+
+    auto const ordered = metrics.ordered();
+    REQUIRE(ordered.size() == 3);
+    CHECK(*ordered[0].first == *selectControl(0, 1, 0, 'm'));
+    CHECK(ordered[0].second == 3);
+}
+
+TEST_CASE("Screen.screenshot", "[screen]")
+{
+    auto screen = MockScreen{{5, 2}};
+
+    SECTION("changed graphics renditions only") {
+        screen.write("\033[1;31ma\033[22mb");
+        CHECK(screen.screenshot() == "\033[1;31ma\033[22mb\r\n\r\n\033[m");
+    }
+
+    SECTION("trailing background") {
+        screen.write("x\033[41m\033[K\033[m");
+        CHECK(screen.screenshot() == "x\033[41m\033[K\033[m\r\n\r\n");
+    }
+
+    SECTION("replayed") {
+        screen.write("\033[4;32mab\033[24;44mc\033[m\r\n\033[1md\033[2me");
+        auto replayed = MockScreen{{5, 3}};
+        replayed.write(screen.screenshot());
+        CHECK(replayed.renderTextLine(1) == screen.renderTextLine(1));
+        CHECK(replayed.renderTextLine(2) == screen.renderTextLine(2));
+        CHECK(replayed.at({1, 3}).attributes() != replayed.at({1, 2}).attributes());
+        CHECK(replayed.grid().attributes(replayed.at({2, 2})).styles == screen.grid().attributes(screen.at({2, 2})).styles);
+    }
+}
+
+TEST_CASE("Screen.triggers", "[screen]")
+{
+    class NotifyingScreen: public MockScreen {
+      public:
+        using MockScreen::MockScreen;
+        void notify(string_view _title, string_view _body) override { notifications.emplace_back(_title, _body); }
+        vector<pair<string, string>> notifications;
+    };
+
+    auto screen = NotifyingScreen{Size{10, 4}};
+    screen.setTriggers({
+        Trigger{"ERROR", TriggerAction::Highlight},
+        Trigger{"FAIL", TriggerAction::Mark},
+        Trigger{"done", TriggerAction::Notify},
+    });
+
+    // Lines are scanned as the cursor leaves them.
+    screen.write("an ERROR\r\nFAIL here\r\nall done");
+    CHECK(screen.grid().lineAt(1).triggerMatches() == vector<TriggerMatch>{{4, 8, 0}});
+    CHECK_FALSE(screen.grid().lineAt(1).marked());
+    CHECK(screen.grid().lineAt(2).marked());
+    CHECK(screen.notifications.empty());
+
+    screen.write("\r\n");
+    CHECK(screen.notifications == vector<pair<string, string>>{{"done", "all done"}});
+
+    // Patterns are found across wrapped lines, from the continuing line's first column on.
+    screen.write("xxxxxxxERROR\r\n");
+    CHECK(screen.grid().lineAt(2).triggerMatches().empty());
+    CHECK(screen.grid().lineAt(3).wrapped());
+    CHECK(screen.grid().lineAt(3).triggerMatches() == vector<TriggerMatch>{{1, 2, 0}});
+
+    // Matches are dropped along with the line's contents.
+    screen.write("\033[3;1Hxy");
+    CHECK(screen.grid().lineAt(3).triggerMatches().empty());
+}
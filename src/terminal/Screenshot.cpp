@@ -0,0 +1,285 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/Screenshot.h>
+
+#include <crispy/utf8.h>
+
+#include <fmt/format.h>
+
+#include <array>
+#include <iterator>
+#include <optional>
+#include <utility>
+
+using std::array;
+using std::move;
+using std::nullopt;
+using std::optional;
+using std::pair;
+using std::prev;
+using std::string;
+using std::string_view;
+
+using namespace std::string_view_literals;
+
+namespace terminal {
+
+namespace // {{{ helper
+{
+    constexpr auto BoldOrFaint = static_cast<unsigned>(CellFlags::Bold | CellFlags::Faint);
+
+    constexpr auto AnyUnderline = static_cast<unsigned>(CellFlags::Underline
+                                                        | CellFlags::DoublyUnderlined
+                                                        | CellFlags::CurlyUnderlined
+                                                        | CellFlags::DottedUnderline
+                                                        | CellFlags::DashedUnderline);
+
+    // Styles along with the SGR parameter enabling and the one disabling them.
+    // Disabling Bold or Faint disables both of them, and disabling any underline disables all of them.
+    constexpr auto Styles = array{
+        pair{CellFlags::Bold, pair{"1"sv, "22"sv}},
+        pair{CellFlags::Faint, pair{"2"sv, "22"sv}},
+        pair{CellFlags::Italic, pair{"3"sv, "23"sv}},
+        pair{CellFlags::Underline, pair{"4"sv, "24"sv}},
+        pair{CellFlags::Blinking, pair{"5"sv, "25"sv}},
+        pair{CellFlags::Inverse, pair{"7"sv, "27"sv}},
+        pair{CellFlags::Hidden, pair{"8"sv, "28"sv}},
+        pair{CellFlags::CrossedOut, pair{"9"sv, "29"sv}},
+        pair{CellFlags::DoublyUnderlined, pair{"4:2"sv, "24"sv}},
+        pair{CellFlags::CurlyUnderlined, pair{"4:3"sv, "24"sv}},
+        pair{CellFlags::DottedUnderline, pair{"4:4"sv, "24"sv}},
+        pair{CellFlags::DashedUnderline, pair{"4:5"sv, "24"sv}},
+        pair{CellFlags::Framed, pair{"51"sv, "54"sv}},
+        pair{CellFlags::Overline, pair{"53"sv, "55"sv}},
+    };
+
+    // Unlike Color's equality operator, this one tells all RGB colors apart.
+    bool sameColor(Color _a, Color _b) noexcept
+    {
+        if (_a.type != _b.type)
+            return false;
+        if (_a.type == ColorType::RGB)
+            return _a.rgb == _b.rgb;
+        return _a.index == _b.index;
+    }
+
+    bool sameAttributes(GraphicsAttributes const& _a, GraphicsAttributes const& _b) noexcept
+    {
+        return _a.styles == _b.styles
+            && sameColor(_a.foregroundColor, _b.foregroundColor)
+            && sameColor(_a.backgroundColor, _b.backgroundColor)
+            && sameColor(_a.underlineColor, _b.underlineColor);
+    }
+
+    bool visibleBackground(GraphicsAttributes const& _attributes) noexcept
+    {
+        return (!isDefaultColor(_attributes.backgroundColor) && !isUndefined(_attributes.backgroundColor))
+            || (_attributes.styles & CellFlags::Inverse);
+    }
+
+    void addParameter(string& _sgr, string_view _value)
+    {
+        if (!_sgr.empty())
+            _sgr += ';';
+        _sgr += _value;
+    }
+
+    /// Adds the parameters selecting @p _color, @p _base being 30 for the foreground,
+    /// 40 for the background and 50 for the underline color.
+    void addColor(string& _sgr, Color _color, unsigned _base)
+    {
+        switch (_color.type)
+        {
+            case ColorType::Undefined:
+            case ColorType::Default:
+                addParameter(_sgr, std::to_string(_base + 9));
+                break;
+            case ColorType::Indexed:
+                if (_color.index < 8 && _base != 50)
+                    addParameter(_sgr, std::to_string(_base + _color.index));
+                else
+                    addParameter(_sgr, fmt::format("{};5;{}", _base + 8, _color.index));
+                break;
+            case ColorType::Bright:
+                if (_base != 50)
+                    addParameter(_sgr, std::to_string(_base + 60 + _color.index));
+                else
+                    addParameter(_sgr, fmt::format("{};5;{}", _base + 8, _color.index + 8));
+                break;
+            case ColorType::RGB:
+                addParameter(_sgr, fmt::format("{};2;{};{};{}", _base + 8, _color.rgb.red, _color.rgb.green, _color.rgb.blue));
+                break;
+        }
+    }
+
+    /// @returns the SGR parameters changing @p _from into @p _to, or std::nullopt if
+    ///          that requires a reset, as there is no parameter for resetting the underline color.
+    optional<string> changedParameters(GraphicsAttributes const& _from, GraphicsAttributes const& _to)
+    {
+        auto const from = static_cast<unsigned>(_from.styles);
+        auto const to = static_cast<unsigned>(_to.styles);
+        auto added = to & ~from;
+        auto const removed = from & ~to;
+
+        if (removed & static_cast<unsigned>(CellFlags::Encircled))
+            return nullopt;
+
+        auto sgr = string{};
+        if (removed & BoldOrFaint)
+        {
+            addParameter(sgr, "22"sv);
+            added |= to & BoldOrFaint;
+        }
+        if (removed & AnyUnderline)
+        {
+            addParameter(sgr, "24"sv);
+            added |= to & AnyUnderline;
+        }
+        for (auto const& [flag, parameters]: Styles)
+            if (removed & static_cast<unsigned>(flag) & ~(BoldOrFaint | AnyUnderline))
+                addParameter(sgr, parameters.second);
+
+        for (auto const& [flag, parameters]: Styles)
+            if (added & static_cast<unsigned>(flag))
+                addParameter(sgr, parameters.first);
+
+        if (!sameColor(_from.foregroundColor, _to.foregroundColor))
+            addColor(sgr, _to.foregroundColor, 30);
+        if (!sameColor(_from.backgroundColor, _to.backgroundColor))
+            addColor(sgr, _to.backgroundColor, 40);
+        if (!sameColor(_from.underlineColor, _to.underlineColor))
+        {
+            if (isDefaultColor(_to.underlineColor) || isUndefined(_to.underlineColor))
+                return nullopt;
+            addColor(sgr, _to.underlineColor, 50);
+        }
+
+        return sgr;
+    }
+} // }}}
+
+ScreenshotWriter::ScreenshotWriter(Sink _sink, size_t _chunkSize) :
+    sink_{ move(_sink) },
+    chunkSize_{ _chunkSize }
+{
+    buffer_.reserve(chunkSize_);
+}
+
+void ScreenshotWriter::append(string_view _text)
+{
+    buffer_ += _text;
+    if (buffer_.size() >= chunkSize_)
+    {
+        sink_(buffer_);
+        buffer_.clear();
+    }
+}
+
+void ScreenshotWriter::setAttributes(GraphicsAttributes const& _attributes)
+{
+    if (sameAttributes(current_, _attributes))
+        return;
+
+    auto const changed = changedParameters(current_, _attributes);
+    auto reset = string{};
+    if (!sameAttributes(_attributes, GraphicsAttributes{}))
+        reset = "0;" + changedParameters(GraphicsAttributes{}, _attributes).value_or(string{});
+
+    auto const& parameters = changed && changed->size() <= reset.size() ? *changed : reset;
+    append("\033["sv);
+    append(parameters);
+    append("m"sv);
+    current_ = _attributes;
+}
+
+void ScreenshotWriter::writeLine(Line const& _line, GraphicsAttributesTable const& _attributes, string_view _postLine)
+{
+    auto const cells = _line.untrimmedCells();
+    auto const cellsBegin = cells.begin();
+    auto tail = cells.end();
+
+    // Trailing blank cells sharing their graphics rendition, including the ones trimmed off.
+    auto tailAttributes = _line.trimmedAttributes();
+    auto tailSize = _line.trimmedCellCount();
+    if (!tailSize && tail != cellsBegin && prev(tail)->empty())
+        tailAttributes = prev(tail)->attributes();
+    while (tail != cellsBegin && prev(tail)->empty() && prev(tail)->attributes() == tailAttributes)
+    {
+        --tail;
+        ++tailSize;
+    }
+
+    for (auto cell = cellsBegin; cell != tail; )
+    {
+        setAttributes(_attributes[cell->attributes()]);
+        if (cell->empty())
+            append(" "sv);
+        else
+        {
+            char utf8[crispy::utf8::encodedSizeMax(Cell::MaxCodepoints)];
+            append(string_view(utf8, crispy::utf8::encode(cell->codepoints(), utf8)));
+        }
+
+        // Cells covered by a wide character are not written, as the terminal skips them already.
+        auto const width = cell->width();
+        ++cell;
+        for (int i = 1; i < width && cell != tail && cell->empty(); ++i)
+            ++cell;
+    }
+
+    if (tailSize && visibleBackground(_attributes[tailAttributes]))
+    {
+        setAttributes(_attributes[tailAttributes]);
+        append("\033[K"sv);
+    }
+
+    if (!_postLine.empty())
+    {
+        setAttributes(GraphicsAttributes{});
+        append(_postLine);
+    }
+
+    // Scrolling fills the new line with the current background.
+    if (visibleBackground(current_))
+        setAttributes(GraphicsAttributes{});
+
+    append("\r\n"sv);
+}
+
+void ScreenshotWriter::finish()
+{
+    setAttributes(GraphicsAttributes{});
+    if (!buffer_.empty())
+    {
+        sink_(buffer_);
+        buffer_.clear();
+    }
+}
+
+void writeScreenshot(Screenshot const& _screenshot,
+                     ScreenshotWriter::Sink _sink,
+                     std::function<string(int)> const& _postLine)
+{
+    auto writer = ScreenshotWriter{move(_sink)};
+    auto row = 1 - _screenshot.historyLineCount;
+    for (Line const& line: _screenshot.lines)
+    {
+        auto const postLine = _postLine ? _postLine(row) : string{};
+        writer.writeLine(line, _screenshot.attributes, postLine);
+        ++row;
+    }
+    writer.finish();
+}
+
+} // end namespace
@@ -0,0 +1,76 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/Grid.h>
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace terminal {
+
+/// Copy of a screen's lines, taken by Screen::captureScreenshot() for being written
+/// by writeScreenshot() without holding on to the screen.
+///
+/// Packed lines stay packed in the copy, so taking it is about as cheap as copying their memory.
+struct Screenshot {
+    GraphicsAttributesTable attributes;
+    std::vector<Line> lines; //!< history lines followed by the page lines, oldest first
+    int historyLineCount = 0;
+};
+
+/// Writes lines as the VT sequences reproducing them, passing the output on to a sink in chunks.
+///
+/// Graphics renditions are only emitted where they change, each one as the shorter of
+/// the changes relative to the previous rendition or a reset followed by the new one.
+/// Trailing blank cells are skipped, or erased in a single EL if their background is visible.
+class ScreenshotWriter {
+  public:
+    using Sink = std::function<void(std::string_view)>;
+
+    explicit ScreenshotWriter(Sink _sink, size_t _chunkSize = 64 * 1024);
+    ~ScreenshotWriter() { finish(); }
+
+    ScreenshotWriter(ScreenshotWriter const&) = delete;
+    ScreenshotWriter& operator=(ScreenshotWriter const&) = delete;
+
+    /// Writes the cells of @p _line, followed by a line break.
+    ///
+    /// @p _postLine is written right before the line break, with the graphics rendition reset.
+    void writeLine(Line const& _line, GraphicsAttributesTable const& _attributes, std::string_view _postLine = {});
+
+    /// Resets the graphics rendition and passes any pending output on to the sink.
+    void finish();
+
+  private:
+    void setAttributes(GraphicsAttributes const& _attributes);
+    void append(std::string_view _text);
+
+    Sink sink_;
+    size_t chunkSize_;
+    std::string buffer_;
+    GraphicsAttributes current_{};
+};
+
+/// Writes all lines of @p _screenshot to @p _sink.
+///
+/// @p _postLine is passed the line number relative to the page (see Screen::screenshot())
+/// and returns the text to append to that line.
+void writeScreenshot(Screenshot const& _screenshot,
+                     ScreenshotWriter::Sink _sink,
+                     std::function<std::string(int)> const& _postLine = {});
+
+} // end namespace
@@ -0,0 +1,160 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/ScrollbackFile.h>
+#include <terminal/logging.h>
+
+#include <crispy/debuglog.h>
+#include <crispy/stdfs.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using std::max;
+using std::nullopt;
+using std::optional;
+using std::shared_ptr;
+using std::string;
+using std::string_view;
+
+namespace terminal {
+
+namespace // {{{ helper
+{
+    // Initial size of the mapping. The file is grown by doubling it.
+    constexpr uint64_t InitialCapacity = 16 * 1024 * 1024;
+}
+// }}}
+
+#if !defined(_WIN32)
+shared_ptr<ScrollbackFile> ScrollbackFile::create(string const& _directory)
+{
+    auto const directory = _directory.empty() ? FileSystem::temp_directory_path().string() : _directory;
+    auto pathTemplate = (FileSystem::path(directory) / "contour-scrollback-XXXXXX").string();
+    auto path = std::vector<char>(pathTemplate.begin(), pathTemplate.end());
+    path.push_back('\0');
+
+    int const fd = mkstemp(path.data());
+    if (fd < 0)
+    {
+        debuglog(TerminalTag).write("Could not create scrollback file in {}. {}", directory, strerror(errno));
+        return nullptr;
+    }
+    unlink(path.data());
+
+    auto file = shared_ptr<ScrollbackFile>(new ScrollbackFile(fd));
+    if (!file->reserve(InitialCapacity))
+        return nullptr;
+
+    return file;
+}
+
+ScrollbackFile::~ScrollbackFile()
+{
+    if (data_)
+        munmap(data_, capacity_);
+    close(fd_);
+}
+
+bool ScrollbackFile::reserve(uint64_t _capacity)
+{
+    if (_capacity <= capacity_)
+        return true;
+
+    if (ftruncate(fd_, static_cast<off_t>(_capacity)) != 0)
+    {
+        debuglog(TerminalTag).write("Could not grow scrollback file to {} bytes. {}", _capacity, strerror(errno));
+        return false;
+    }
+
+    void* data = mmap(nullptr, _capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (data == MAP_FAILED)
+    {
+        debuglog(TerminalTag).write("Could not map scrollback file. {}", strerror(errno));
+        return false;
+    }
+
+    if (data_)
+        munmap(data_, capacity_);
+
+    data_ = static_cast<char*>(data);
+    capacity_ = _capacity;
+    return true;
+}
+
+string ScrollbackFile::load(uint64_t _offset, size_t _size) const
+{
+    // Records are written through the shared mapping, which the file's pages reflect.
+    auto record = string(_size, '\0');
+    size_t done = 0;
+    while (done < _size)
+    {
+        auto const n = pread(fd_, record.data() + done, _size - done, static_cast<off_t>(_offset + done));
+        if (n <= 0)
+        {
+            if (n < 0 && errno == EINTR)
+                continue;
+            return {};
+        }
+        done += static_cast<size_t>(n);
+    }
+    return record;
+}
+
+#else
+shared_ptr<ScrollbackFile> ScrollbackFile::create(string const&)
+{
+    // Not available, see ScrollbackFile::Available.
+    return nullptr;
+}
+
+ScrollbackFile::~ScrollbackFile()
+{
+}
+
+bool ScrollbackFile::reserve(uint64_t)
+{
+    return false;
+}
+
+string ScrollbackFile::load(uint64_t, size_t) const
+{
+    return {};
+}
+#endif
+
+bool ScrollbackFile::wasteful() const noexcept
+{
+    // Small files are not worth another file descriptor and mapping.
+    return size_ >= InitialCapacity && 2 * referencedSize() < size_;
+}
+
+optional<uint64_t> ScrollbackFile::append(string_view _data)
+{
+    if (size_ + _data.size() > capacity_ && !reserve(max(2 * capacity_, size_ + _data.size())))
+        return nullopt;
+
+    auto const offset = size_;
+    std::memcpy(data_ + offset, _data.data(), _data.size());
+    size_ += _data.size();
+    return offset;
+}
+
+} // end namespace
@@ -0,0 +1,101 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace terminal {
+
+/// Append-only, memory-mapped temporary file holding scrollback lines that have been
+/// spilled out of memory.
+///
+/// The file is unlinked right after creation, so that it vanishes with the process.
+/// Records are addressed by their byte offset, which remains stable while the file grows.
+///
+/// Records are never overwritten. Instead, their owners retain() and release() them, and a file
+/// mostly holding released records is superseded by a new one, see wasteful(). The old file is
+/// closed along with the last record still referring to it.
+///
+/// Only available on POSIX systems. Elsewhere, create() always fails, which keeps the history
+/// lines in memory, as if spilling was disabled.
+class ScrollbackFile {
+  public:
+    /// Creates a new scrollback file within the given directory,
+    /// or the system's temporary directory if @p _directory is empty.
+    ///
+    /// @returns the new file or nullptr if memory-mapped files are not available.
+    static std::shared_ptr<ScrollbackFile> create(std::string const& _directory);
+
+    /// Whether create() may succeed at all on this platform.
+#if defined(_WIN32)
+    static constexpr bool Available = false;
+#else
+    static constexpr bool Available = true;
+#endif
+
+    ScrollbackFile(ScrollbackFile const&) = delete;
+    ScrollbackFile& operator=(ScrollbackFile const&) = delete;
+    ~ScrollbackFile();
+
+    /// Appends the given record.
+    ///
+    /// @returns the offset of the record or std::nullopt if the file could not be grown.
+    std::optional<uint64_t> append(std::string_view _data);
+
+    /// @returns a view to the record at the given offset, which stays valid until the next append().
+    std::string_view read(uint64_t _offset, size_t _size) const noexcept
+    {
+        return std::string_view(data_ + _offset, _size);
+    }
+
+    /// Copies the record at the given offset out of the file itself rather than its mapping,
+    /// which, unlike read(), may be done on any thread, even while appending.
+    ///
+    /// @returns the record, or an empty string if it could not be read.
+    std::string load(uint64_t _offset, size_t _size) const;
+
+    /// Number of bytes written so far.
+    uint64_t size() const noexcept { return size_; }
+
+    /// Accounts @p _size bytes of records as being referred to, e.g. by a spilled line.
+    void retain(uint64_t _size) noexcept { referencedSize_.fetch_add(_size, std::memory_order_relaxed); }
+
+    /// Accounts @p _size bytes of records as no longer being referred to, see retain().
+    void release(uint64_t _size) noexcept { referencedSize_.fetch_sub(_size, std::memory_order_relaxed); }
+
+    /// Number of bytes of records still referred to, see retain().
+    uint64_t referencedSize() const noexcept { return referencedSize_.load(std::memory_order_relaxed); }
+
+    /// @returns whether most of the file is taken by released records, in which case new records
+    ///          had better be appended to a new file, letting this one go once released entirely.
+    bool wasteful() const noexcept;
+
+  private:
+    explicit ScrollbackFile(int _fd) noexcept : fd_{_fd} {}
+
+    bool reserve(uint64_t _capacity);
+
+    int fd_;
+    char* data_ = nullptr;
+    uint64_t size_ = 0;
+    uint64_t capacity_ = 0;
+    std::atomic<uint64_t> referencedSize_ = 0;
+};
+
+} // end namespace
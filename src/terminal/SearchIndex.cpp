@@ -0,0 +1,80 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/SearchIndex.h>
+
+#include <algorithm>
+#include <cstdint>
+
+using std::min;
+using std::string_view;
+
+namespace terminal {
+
+void SearchIndex::addTrigrams(Bitmap& _bitmap, string_view _text) noexcept
+{
+    for (size_t i = 0; i + 3 <= _text.size(); ++i)
+    {
+        auto const trigram = uint32_t(uint8_t(_text[i]))
+                           | uint32_t(uint8_t(_text[i + 1])) << 8
+                           | uint32_t(uint8_t(_text[i + 2])) << 16;
+        // Fibonacci hashing, using the topmost bits for the bitmap index.
+        auto const hash = (trigram * 2654435769u) >> (32 - 14);
+        static_assert(BlockBitCount == 1u << 14);
+        _bitmap.set(hash);
+    }
+}
+
+void SearchIndex::append(string_view _text)
+{
+    if (blocks_.empty() || blocks_.back().lineCount == BlockLineCount)
+        blocks_.emplace_back();
+
+    addTrigrams(blocks_.back().trigrams, _text);
+    ++blocks_.back().lineCount;
+    ++lineCount_;
+}
+
+void SearchIndex::dropFront(int _count)
+{
+    while (_count > 0 && !blocks_.empty())
+    {
+        auto const n = min(_count, blocks_.front().lineCount);
+        blocks_.front().lineCount -= n;
+        lineCount_ -= n;
+        _count -= n;
+        if (blocks_.front().lineCount == 0)
+            blocks_.pop_front();
+    }
+}
+
+void SearchIndex::dropBack(int _count)
+{
+    while (_count > 0 && !blocks_.empty())
+    {
+        auto const n = min(_count, blocks_.back().lineCount);
+        blocks_.back().lineCount -= n;
+        lineCount_ -= n;
+        _count -= n;
+        if (blocks_.back().lineCount == 0)
+            blocks_.pop_back();
+    }
+}
+
+void SearchIndex::clear()
+{
+    blocks_.clear();
+    lineCount_ = 0;
+}
+
+} // end namespace
@@ -0,0 +1,89 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <deque>
+#include <string_view>
+
+namespace terminal {
+
+/// Trigram index over a sequence of text lines, used to skip blocks of history lines that
+/// cannot contain a searched literal.
+///
+/// Lines are grouped into blocks, each holding a bitmap of the hashed trigrams of its lines.
+/// Lines can only be appended as well as dropped from either end, with a partially dropped
+/// block keeping the trigrams of its dropped lines, which merely leads to false positives.
+class SearchIndex {
+  public:
+    /// Number of lines per block.
+    static constexpr int BlockLineCount = 64;
+
+    /// Number of bits per block's trigram bitmap.
+    static constexpr size_t BlockBitCount = 16384;
+
+    /// Number of lines indexed.
+    int lineCount() const noexcept { return lineCount_; }
+
+    /// @returns the bytes allocated by the index.
+    size_t memoryUsage() const noexcept { return blocks_.size() * sizeof(Block); }
+
+    /// Indexes the text of a new line, to come after all lines indexed so far.
+    void append(std::string_view _text);
+
+    /// Drops the @p _count first lines.
+    void dropFront(int _count);
+
+    /// Drops the @p _count last lines.
+    void dropBack(int _count);
+
+    void clear();
+
+    /// Invokes @p _callback with the 0-based index and count of the lines of every block that
+    /// may contain @p _literal, in ascending order.
+    template <typename Callback>
+    void forEachCandidate(std::string_view _literal, Callback&& _callback) const;
+
+  private:
+    using Bitmap = std::bitset<BlockBitCount>;
+
+    struct Block {
+        Bitmap trigrams;
+        int lineCount = 0;
+    };
+
+    /// Marks all trigrams of @p _text in @p _bitmap.
+    static void addTrigrams(Bitmap& _bitmap, std::string_view _text) noexcept;
+
+    std::deque<Block> blocks_;
+    int lineCount_ = 0;
+};
+
+template <typename Callback>
+void SearchIndex::forEachCandidate(std::string_view _literal, Callback&& _callback) const
+{
+    auto query = Bitmap{};
+    addTrigrams(query, _literal);
+
+    int firstLine = 0;
+    for (Block const& block : blocks_)
+    {
+        if ((block.trigrams & query) == query)
+            _callback(firstLine, block.lineCount);
+        firstLine += block.lineCount;
+    }
+}
+
+} // end namespace
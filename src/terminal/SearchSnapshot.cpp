@@ -0,0 +1,121 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/SearchSnapshot.h>
+
+#include <crispy/thread_pool.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+
+using std::clamp;
+using std::move;
+using std::regex;
+using std::string;
+using std::vector;
+
+namespace terminal {
+
+namespace // {{{ helper
+{
+    bool isLeadByte(char _ch) noexcept
+    {
+        return (static_cast<uint8_t>(_ch) & 0xC0) != 0x80;
+    }
+}
+// }}}
+
+void SearchSnapshot::append(string _text, vector<size_t> const& _cellOffsets)
+{
+    // As long as every cell holds a single codepoint, cells are told apart by their lead bytes.
+    auto const codepointCount = std::count_if(_text.begin(), _text.end(), isLeadByte);
+    if (static_cast<size_t>(codepointCount) == _cellOffsets.size())
+        lines_.emplace_back(LineText{move(_text), {}});
+    else
+        lines_.emplace_back(LineText{move(_text), _cellOffsets});
+}
+
+int SearchSnapshot::columnAt(LineText const& _line, size_t _offset) noexcept
+{
+    if (!_line.cellOffsets.empty())
+        return static_cast<int>(std::upper_bound(_line.cellOffsets.begin(), _line.cellOffsets.end(), _offset)
+                                - _line.cellOffsets.begin());
+
+    auto const end = std::next(_line.text.begin(), static_cast<std::ptrdiff_t>(_offset + 1));
+    return static_cast<int>(std::count_if(_line.text.begin(), end, isLeadByte));
+}
+
+void SearchSnapshot::searchLine(int _line, regex const& _regex, vector<SearchMatch>& _matches) const
+{
+    auto const& line = lines_[static_cast<size_t>(_line)];
+    for (auto i = std::sregex_iterator(line.text.begin(), line.text.end(), _regex); i != std::sregex_iterator(); ++i)
+    {
+        if (i->length() == 0)
+            continue;
+        auto const offset = static_cast<size_t>(i->position());
+        _matches.emplace_back(SearchMatch{
+            _line,
+            columnAt(line, offset),
+            columnAt(line, offset + static_cast<size_t>(i->length()) - 1)
+        });
+    }
+}
+
+void SearchSnapshot::search(regex const& _regex, MatchHandler const& _handler) const
+{
+    auto& pool = crispy::thread_pool::shared();
+    auto const workerCount = clamp(lineCount() / MinWorkerLineCount, 1, static_cast<int>(pool.thread_count()) + 1);
+
+    auto handlerLock = std::mutex{};
+    auto const flush = [&](vector<SearchMatch>& _matches) {
+        if (_matches.empty())
+            return;
+        auto const _l = std::lock_guard{handlerLock};
+        _handler(_matches);
+        _matches.clear();
+    };
+
+    auto const searchLines = [&](int _first, int _last) {
+        auto matches = vector<SearchMatch>{};
+        for (int line = _first; line < _last; ++line)
+        {
+            searchLine(line, _regex, matches);
+            if ((line - _first) % StreamLineCount == StreamLineCount - 1)
+                flush(matches);
+        }
+        flush(matches);
+    };
+
+    // Exceptions (such as std::regex_error for overly complex patterns) are passed on to the caller.
+    pool.parallel_for(
+        static_cast<size_t>(workerCount),
+        [&](size_t _worker) {
+            auto const i = static_cast<int64_t>(_worker);
+            searchLines(static_cast<int>(int64_t(lineCount()) * i / workerCount),
+                        static_cast<int>(int64_t(lineCount()) * (i + 1) / workerCount));
+        },
+        crispy::task_priority::normal);
+}
+
+vector<SearchMatch> SearchSnapshot::search(regex const& _regex) const
+{
+    auto matches = vector<SearchMatch>{};
+    search(_regex, [&](vector<SearchMatch> const& _matches) {
+        matches.insert(matches.end(), _matches.begin(), _matches.end());
+    });
+    std::sort(matches.begin(), matches.end());
+    return matches;
+}
+
+} // end namespace
@@ -0,0 +1,90 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace terminal {
+
+/// Cells of a single line covered by a search match.
+struct SearchMatch {
+    int line;           // absolute line (0-based)
+    int firstColumn;    // 1-based, inclusive
+    int lastColumn;     // 1-based, inclusive
+};
+
+constexpr bool operator==(SearchMatch const& a, SearchMatch const& b) noexcept
+{
+    return a.line == b.line && a.firstColumn == b.firstColumn && a.lastColumn == b.lastColumn;
+}
+
+constexpr bool operator!=(SearchMatch const& a, SearchMatch const& b) noexcept { return !(a == b); }
+
+constexpr bool operator<(SearchMatch const& a, SearchMatch const& b) noexcept
+{
+    return a.line < b.line || (a.line == b.line && a.firstColumn < b.firstColumn);
+}
+
+/// Read-only copy of the text of a grid's lines, see Grid::searchSnapshot().
+///
+/// Searching a snapshot does not need access to the grid it has been taken from,
+/// so that the grid can be modified concurrently.
+class SearchSnapshot {
+  public:
+    /// Minimum number of lines worth handing to another worker thread.
+    static constexpr int MinWorkerLineCount = 4096;
+
+    /// Number of lines after which a worker passes on the matches found so far.
+    static constexpr int StreamLineCount = 1024;
+
+    using MatchHandler = std::function<void(std::vector<SearchMatch> const&)>;
+
+    /// Appends the text of the next line, as returned by Line::toUtf8() along with its cell offsets.
+    void append(std::string _text, std::vector<size_t> const& _cellOffsets);
+
+    int lineCount() const noexcept { return static_cast<int>(lines_.size()); }
+
+    /// Searches all lines for non-empty matches of @p _regex, spreading the lines across
+    /// the threads of crispy::thread_pool::shared() in contiguous ranges.
+    ///
+    /// @p _handler is passed the matches as soon as they are found, in ascending order
+    /// per invocation, while invocations for different ranges of lines may interleave.
+    /// It is never invoked concurrently, but not necessarily from the calling thread either.
+    /// This function returns once all lines have been searched.
+    void search(std::regex const& _regex, MatchHandler const& _handler) const;
+
+    /// @returns all non-empty matches of @p _regex, in ascending order.
+    std::vector<SearchMatch> search(std::regex const& _regex) const;
+
+  private:
+    struct LineText {
+        std::string text;
+
+        /// Byte offset of each cell's text, only stored if some cell spans multiple codepoints.
+        std::vector<size_t> cellOffsets;
+    };
+
+    /// @returns the 1-based column of the cell containing the given byte of @p _line.
+    static int columnAt(LineText const& _line, size_t _offset) noexcept;
+
+    void searchLine(int _line, std::regex const& _regex, std::vector<SearchMatch>& _matches) const;
+
+    std::vector<LineText> lines_;
+};
+
+} // end namespace
@@ -21,17 +21,37 @@ using namespace std;
 
 namespace terminal {
 
+namespace // {{{ helper
+{
+    /// Tests whether the given cell separates words, which empty cells always do.
+    bool isWordDelimiter(Cell const& _cell, WordDelimiters const& _delimiters) noexcept
+    {
+        auto const codepoints = _cell.codepoints();
+        return codepoints.empty() || _delimiters.contains(codepoints[0]);
+    }
+
+    /// Tests whether the given 1-based column of a line is covered by the wide character to its left.
+    bool isWideCharContinuation(crispy::span<Cell const> const& _cells, int _column) noexcept
+    {
+        return _column > 1
+            && _cells[static_cast<size_t>(_column - 1)].empty()
+            && _cells[static_cast<size_t>(_column - 2)].width() > 1;
+    }
+} // }}}
+
 Selector::Selector(Mode _mode,
 				   GetCellAt _getCellAt,
+                   GetLineCells _lineCells,
                    GetWrappedFlag _wrappedFlag,
-				   std::u32string const& _wordDelimiters,
+				   WordDelimiters _wordDelimiters,
 				   int _totalRowCount,
 				   int _columnCount,
 				   Coordinate _from) :
 	mode_{_mode},
 	getCellAt_{move(_getCellAt)},
+    lineCells_{move(_lineCells)},
     wrapped_{move(_wrappedFlag)},
-	wordDelimiters_{_wordDelimiters},
+	wordDelimiters_{move(_wordDelimiters)},
 	totalRowCount_{_totalRowCount},
     columnCount_{_columnCount},
 	start_{_from},
@@ -49,7 +69,7 @@ Selector::Selector(Mode _mode,
             from_.row--;
 
         // forward
-        while (to_.row < _totalRowCount && wrapped_(to_.row + 1))
+        while (to_.row + 1 < _totalRowCount && wrapped_(to_.row + 1))
             to_.row++;
 	}
 	else if (isWordWiseSelection())
@@ -63,7 +83,7 @@ Selector::Selector(Mode _mode,
 }
 
 Selector::Selector(Mode _mode,
-                   std::u32string const& _wordDelimiters,
+                   WordDelimiters _wordDelimiters,
                    Screen const& _screen,
                    Coordinate _from) :
     Selector{
@@ -78,10 +98,17 @@ Selector::Selector(Mode _mode,
             else
                 return nullptr;
         },
+        [screen = std::ref(_screen)](int _line) -> crispy::span<Cell const> {
+            auto const& grid = screen.get().grid();
+            if (_line < 0 || _line >= grid.historyLineCount() + grid.screenSize().height)
+                return {};
+            Line const& line = grid.absoluteLineAt(_line);
+            return crispy::span<Cell const>(&*line.begin(), static_cast<size_t>(line.size()));
+        },
         [screen = std::ref(_screen)](int _line) -> bool {
             return screen.get().lineWrapped(_line);
         },
-        _wordDelimiters,
+        move(_wordDelimiters),
         _screen.size().height + static_cast<int>(_screen.historyLineCount()),
         _screen.size().width,
         _from
@@ -174,28 +201,30 @@ bool Selector::extend(Coordinate const& _coord)
 
 void Selector::extendSelectionBackward()
 {
-    auto const isWordDelimiterAt = [this](Coordinate const& _coord) -> bool {
-        Cell const* cell = at(_coord);
-        return !cell || cell->empty() || wordDelimiters_.find(cell->codepoint(0)) != wordDelimiters_.npos;
-    };
-
+    // Scans the cells of each line directly, following wrapped lines up to the start of the logical line.
     auto last = to_;
-    auto current = last;
-    for (;;) {
-        auto const wrapIntoPreviousLine = current.column == 1 && current.row > 0 && wrapped_(current.row);
-        if (current.column > 1)
-            current.column--;
-        else if (current.row > 0 || wrapIntoPreviousLine)
+    auto row = last.row;
+    auto column = last.column - 1;
+    auto cells = lineCells_(row);
+    for (;;)
+    {
+        bool delimited = column > static_cast<int>(cells.size());
+        for (; !delimited && column >= 1; --column)
         {
-            current.row--;
-            current.column = columnCount_;
+            if (isWideCharContinuation(cells, column))
+                continue;
+            if (isWordDelimiter(cells[static_cast<size_t>(column - 1)], wordDelimiters_))
+                delimited = true;
+            else
+                last = Coordinate{row, column};
         }
-        else
-            break;
 
-        if (isWordDelimiterAt(current))
+        if (delimited || row == 0 || !wrapped_(row))
             break;
-        last = current;
+
+        row--;
+        column = columnCount_;
+        cells = lineCells_(row);
     }
 
     if (to_ < from_)
@@ -209,36 +238,34 @@ void Selector::extendSelectionBackward()
 
 void Selector::extendSelectionForward()
 {
-    auto const isWordDelimiterAt = [this](Coordinate const& _coord) -> bool {
-        Cell const* cell = at(_coord);
-        return !cell || cell->empty() || wordDelimiters_.find(cell->codepoint(0)) != wordDelimiters_.npos;
-    };
-
+    // Scans the cells of each line directly, following wrapped lines down to the end of the logical line.
     auto last = to_;
-    auto current = last;
-    for (;;) {
-        if (current.column == columnCount_ && current.row + 1 < totalRowCount_ && wrapped_(current.row + 1))
+    auto row = last.row;
+    auto cells = lineCells_(row);
+    auto column = last.column + (last.column <= static_cast<int>(cells.size())
+                                 ? max(1, cells[static_cast<size_t>(last.column - 1)].width())
+                                 : 1);
+    for (;;)
+    {
+        bool delimited = false;
+        while (!delimited && column <= columnCount_)
         {
-            current.row++;
-            current.column = 1;
-            current = stretchedColumn({current.row, current.column + 1});
+            if (column > static_cast<int>(cells.size())
+                || isWordDelimiter(cells[static_cast<size_t>(column - 1)], wordDelimiters_))
+                delimited = true;
+            else
+            {
+                last = Coordinate{row, column};
+                column += max(1, cells[static_cast<size_t>(column - 1)].width());
+            }
         }
 
-        if (current.column < columnCount_)
-        {
-            current = stretchedColumn({current.row, current.column + 1});
-        }
-        else if (current.row < totalRowCount_)
-        {
-            current.row++;
-            current.column = 1;
-        }
-        else
+        if (delimited || row + 1 >= totalRowCount_ || !wrapped_(row + 1))
             break;
 
-        if (isWordDelimiterAt(current))
-            break;
-        last = current;
+        row++;
+        column = 1;
+        cells = lineCells_(row);
     }
 
     to_ = stretchedColumn(last);
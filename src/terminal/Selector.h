@@ -14,14 +14,17 @@
 #pragma once
 
 #include <terminal/InputGenerator.h>
+#include <terminal/WordDelimiters.h>
 //#include <terminal/Screen.h>
 
 #include <crispy/size.h>
+#include <crispy/span.h>
 #include <crispy/utils.h>
 
 #include <fmt/format.h>
 
 #include <functional>
+#include <optional>
 #include <vector>
 #include <utility>
 
@@ -77,17 +80,21 @@ class Selector {
 	using GetCellAt = std::function<Cell const*(Coordinate)>;
     using GetWrappedFlag = std::function<bool(int)>;
 
+    /// Retrieves all cells of the given absolute line, or none if there is no such line.
+    using GetLineCells = std::function<crispy::span<Cell const>(int)>;
+
     Selector(Mode _mode,
 			 GetCellAt _at,
+             GetLineCells _lineCells,
              GetWrappedFlag _wrappedFlag,
-			 std::u32string const& _wordDelimiters,
+			 WordDelimiters _wordDelimiters,
 			 int _totalRowCount,
              int _columnCount,
 			 Coordinate _from);
 
 	/// Convenience constructor when access to Screen is available.
     Selector(Mode _mode,
-			 std::u32string const& _wordDelimiters,
+			 WordDelimiters _wordDelimiters,
 			 Screen const& _screen,
 			 Coordinate _from);
 
@@ -126,6 +133,33 @@ class Selector {
         return false;
     }
 
+    /// @returns the columns of the given absolute line that are within the range of the selection,
+    ///          or std::nullopt if none. Up to the selector's column count, contains() holds
+    ///          for exactly these columns.
+    constexpr std::optional<Range> selectedColumns(int _line) const noexcept
+    {
+        auto const top = to_ < from_ ? to_ : from_;
+        auto const bottom = to_ < from_ ? from_ : to_;
+        if (_line < top.row || _line > bottom.row)
+            return std::nullopt;
+
+        switch (mode_)
+        {
+            case Mode::FullLine:
+                return Range{_line, 1, columnCount_};
+            case Mode::Linear:
+            case Mode::LinearWordWise:
+                return Range{_line,
+                             _line == top.row ? top.column : 1,
+                             _line == bottom.row ? bottom.column : columnCount_};
+            case Mode::Rectangular:
+                if (from_.row <= to_.row && from_.column <= to_.column)
+                    return Range{_line, from_.column, to_.column};
+                break;
+        }
+        return std::nullopt;
+    }
+
     constexpr Mode mode() const noexcept { return mode_; }
 
     /// Tests whether selection is upwards.
@@ -184,8 +218,9 @@ class Selector {
     State state_{State::Waiting};
 	Mode mode_;
 	GetCellAt getCellAt_;
+    GetLineCells lineCells_;
     GetWrappedFlag wrapped_;
-	std::u32string wordDelimiters_;
+	WordDelimiters wordDelimiters_;
 	int totalRowCount_;
     int columnCount_;
     Coordinate start_{};
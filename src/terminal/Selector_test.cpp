@@ -193,9 +193,72 @@ TEST_CASE("Selector.Linear", "[selector]")
     }
 }
 
+TEST_CASE("Selector.selectedColumns", "[selector]")
+{
+    auto screenEvents = ScreenEvents{};
+    auto screen = Screen{Size{11, 3}, screenEvents};
+    screen.write(
+        //       123456789AB
+        /* 0 */ "12345,67890"s +
+        /* 1 */ "ab,cdefg,hi"s +
+        /* 2 */ "12345,67890"s
+    );
+
+    auto const from = Coordinate{0, 8};
+    for (auto const mode: {Selector::Mode::Linear, Selector::Mode::FullLine, Selector::Mode::Rectangular})
+    for (auto const to: {Coordinate{0, 3}, Coordinate{0, 9}, Coordinate{2, 4}, Coordinate{2, 10}})
+    for (auto const& [begin, end]: {pair{from, to}, pair{to, from}})
+    {
+        auto selector = Selector{mode, U",", screen, begin};
+        selector.extend(end);
+        selector.stop();
+
+        for (int line = -1; line <= 3; ++line)
+        {
+            auto const columns = selector.selectedColumns(line);
+            for (int column = 1; column <= 11; ++column)
+            {
+                INFO(fmt::format("mode {}, selection {}, line {}, column {}",
+                                 static_cast<int>(mode), selector, line, column));
+                auto const selected = columns.has_value()
+                                   && columns->fromColumn <= column && column <= columns->toColumn;
+                CHECK(selected == selector.contains(Coordinate{line, column}));
+            }
+        }
+    }
+}
+
 TEST_CASE("Selector.LinearWordWise", "[selector]")
 {
-    // TODO
+    auto screenEvents = ScreenEvents{};
+    auto screen = Screen{Size{11, 3}, screenEvents};
+    screen.write(
+        //       123456789AB
+        /* 0 */ "12345,67890"s +
+        /* 1 */ "ab,cdefg,hi"s +
+        /* 2 */ "12345,67890"s
+    );
+
+    SECTION("inside line") {
+        auto selector = Selector{Selector::Mode::LinearWordWise, U",", screen, screen.toAbsolute({2, 5})};
+        selector.stop();
+
+        auto selectedText = TextSelection{};
+        selector.render(selectedText);
+        CHECK(selectedText.text == "cdefg");
+    }
+
+    SECTION("across wrapped lines") {
+        auto selector = Selector{Selector::Mode::LinearWordWise, U",", screen, screen.toAbsolute({2, 1})};
+        selector.stop();
+
+        CHECK(selector.from() == screen.toAbsolute({1, 7}));
+        CHECK(selector.to() == screen.toAbsolute({2, 2}));
+
+        auto selectedText = TextSelection{};
+        selector.render(selectedText);
+        CHECK(selectedText.text == "67890\nab");
+    }
 }
 
 TEST_CASE("Selector.FullLine", "[selector]")
@@ -22,6 +22,7 @@
 #include <crispy/base64.h>
 #include <crispy/escape.h>
 #include <crispy/debuglog.h>
+#include <crispy/profiler.h>
 #include <crispy/utils.h>
 
 #include <unicode/utf8.h>
@@ -30,10 +31,10 @@
 #include <fmt/format.h>
 
 #include <array>
+#include <cassert>
 #include <iostream>             // error logging
 #include <cstdlib>
 #include <iterator>
-#include <numeric>
 #include <optional>
 #include <sstream>
 #include <string>
@@ -70,7 +71,7 @@ namespace terminal {
 namespace // {{{ helpers
 {
     /// @returns parsed tuple with OSC code and offset to first data parameter byte.
-    pair<int, int> parseOSC(string const& _data)
+    pair<int, int> parseOSC(string_view _data)
     {
         int code = 0;
         size_t i = 0;
@@ -195,6 +196,20 @@ namespace impl // {{{ some command generator helpers
         return ApplyResult::Invalid;
 	}
 
+    /// Sets or resets each mode given as parameter, see setAnsiMode() and setModeDEC().
+    ///
+    /// @returns the worst result of all modes.
+    template <typename SetMode>
+    ApplyResult setModes(Sequence const& _seq, bool _enable, SetMode _setMode, Screen& _screen)
+    {
+        ApplyResult r = ApplyResult::Ok;
+        crispy::for_each(crispy::times(_seq.parameterCount()), [&](size_t i) {
+            auto const t = _setMode(_seq, i, _enable, _screen);
+            r = max(r, t);
+        });
+        return r;
+    }
+
     optional<RGBColor> parseColor(string_view const& _value)
     {
         try
@@ -508,7 +523,7 @@ namespace impl // {{{ some command generator helpers
 
     ApplyResult setOrRequestDynamicColor(Sequence const& _seq, Screen& _screen, DynamicColorName _name)
     {
-        auto const& value = _seq.intermediateCharacters();
+        auto const& value = _seq.oscString();
         if (value == "?")
             _screen.requestDynamicColor(_name);
         else if (auto color = parseColor(value); color.has_value())
@@ -561,13 +576,13 @@ namespace impl // {{{ some command generator helpers
 
     ApplyResult RCOLPAL(Sequence const& _seq, Screen& _screen)
     {
-        if (_seq.intermediateCharacters().empty())
+        if (_seq.oscString().empty())
         {
             _screen.colorPalette() = _screen.defaultColorPalette();
             return ApplyResult::Ok;
         }
 
-        auto const index = crispy::to_integer<10, uint8_t>(_seq.intermediateCharacters());
+        auto const index = crispy::to_integer<10, uint8_t>(_seq.oscString());
         if (!index.has_value())
             return ApplyResult::Invalid;
 
@@ -579,7 +594,7 @@ namespace impl // {{{ some command generator helpers
     ApplyResult SETCOLPAL(Sequence const& _seq, Screen& _screen)
     {
         bool const ok = queryOrSetColorPalette(
-            _seq.intermediateCharacters(),
+            _seq.oscString(),
             [&](uint8_t index) {
                 auto const color = _screen.colorPalette().palette.at(index);
                 _screen.reply("\e]4;rgb:{:02x}/{:02x}/{:02x}\\", color.red, color.green, color.blue);
@@ -620,7 +635,7 @@ namespace impl // {{{ some command generator helpers
     {
         // [read]  OSC 60 ST
         // [write] OSC 60 ; size ; regular ; bold ; italic ; bold italic ST
-        auto const& params = _seq.intermediateCharacters();
+        auto const& params = _seq.oscString();
         auto const splits = crispy::split(params, ';');
         auto const param = [&](int _index) -> string_view {
             if (_index < int(splits.size()))
@@ -669,7 +684,7 @@ namespace impl // {{{ some command generator helpers
 
     ApplyResult setFont(Sequence const& _seq, Screen& _screen)
     {
-        auto const& params = _seq.intermediateCharacters();
+        auto const& params = _seq.oscString();
         auto const splits = crispy::split(params, ';');
 
         if (splits.size() != 1)
@@ -693,7 +708,7 @@ namespace impl // {{{ some command generator helpers
     ApplyResult clipboard(Sequence const& _seq, Screen& _screen)
     {
         // Only setting clipboard contents is supported, not reading.
-        auto const& params = _seq.intermediateCharacters();
+        auto const& params = _seq.oscString();
         if (auto const splits = crispy::split(params, ';'); splits.size() == 2 && splits[0] == "c")
         {
             _screen.eventListener().copyToClipboard(crispy::base64::decode(splits[1]));
@@ -705,7 +720,7 @@ namespace impl // {{{ some command generator helpers
 
     ApplyResult NOTIFY(Sequence const& _seq, Screen& _screen)
     {
-        auto const& value = _seq.intermediateCharacters();
+        auto const& value = _seq.oscString();
         if (auto const splits = crispy::split(value, ';'); splits.size() == 3 && splits[0] == "notify")
         {
             _screen.notify(string(splits[1]), string(splits[2]));
@@ -715,9 +730,26 @@ namespace impl // {{{ some command generator helpers
             return ApplyResult::Unsupported;
     }
 
+    /// OSC 889 ; <width> ; <height> ; <name> ST
+    ApplyResult SHMIMAGE(Sequence const& _seq, Screen& _screen)
+    {
+        auto const& value = _seq.oscString();
+        auto const splits = crispy::split(value, ';');
+        if (splits.size() != 3)
+            return ApplyResult::Invalid;
+
+        auto const width = crispy::to_integer<10, int>(splits[0]);
+        auto const height = crispy::to_integer<10, int>(splits[1]);
+        if (!width || !height || splits[2].empty())
+            return ApplyResult::Invalid;
+
+        _screen.sharedImage(string(splits[2]), crispy::Size{*width, *height});
+        return ApplyResult::Ok;
+    }
+
     ApplyResult SETCWD(Sequence const& _seq, Screen& _screen)
     {
-        string const& url = _seq.intermediateCharacters();
+        auto const url = string(_seq.oscString());
         _screen.setCurrentWorkingDirectory(url);
         return ApplyResult::Ok;
     }
@@ -745,7 +777,7 @@ namespace impl // {{{ some command generator helpers
 
     ApplyResult HYPERLINK(Sequence const& _seq, Screen& _screen)
     {
-        auto const& value = _seq.intermediateCharacters();
+        auto const& value = _seq.oscString();
         // hyperlink_OSC ::= OSC '8' ';' params ';' URI
         // params := pair (':' pair)*
         // pair := TEXT '=' TEXT
@@ -759,7 +791,7 @@ namespace impl // {{{ some command generator helpers
                 id = p->second;
 
             if (pos + 1 != value.size())
-                _screen.hyperlink(id, value.substr(pos + 1));
+                _screen.hyperlink(id, string(value.substr(pos + 1)));
             else
                 _screen.hyperlink(string{id}, string{});
 
@@ -890,6 +922,220 @@ namespace impl // {{{ some command generator helpers
     }
 } // }}}
 
+namespace // {{{ function handlers
+{
+    /// Applies a sequence that has been selected as a particular function.
+    ///
+    /// The parameter count has been validated against the function's definition by select()
+    /// already, so that handlers merely fill in the defaults of omitted parameters.
+    using FunctionHandler = ApplyResult (*)(Sequence const& _seq, Screen& _screen);
+
+    /// Handler of each function, at the same index as the function in functions(),
+    /// or nullptr if the function is not supported or applied by the Sequencer itself.
+    constexpr auto functionHandlers = []() constexpr {
+        auto handlers = array<FunctionHandler, functions().size()>{};
+        auto const on = [&](FunctionDefinition const& _function, FunctionHandler _handler) constexpr {
+            for (size_t i = 0; i < functions().size(); ++i)
+                if (functions()[i] == _function)
+                    handlers[i] = _handler;
+        };
+
+        // C0
+        on(BEL, [](Sequence const&, Screen& _screen) { _screen.eventListener().bell(); return ApplyResult::Ok; });
+        on(BS, [](Sequence const&, Screen& _screen) { _screen.backspace(); return ApplyResult::Ok; });
+        on(TAB, [](Sequence const&, Screen& _screen) { _screen.moveCursorToNextTab(); return ApplyResult::Ok; });
+        on(LF, [](Sequence const&, Screen& _screen) { _screen.linefeed(); return ApplyResult::Ok; });
+        // Even though VT means Vertical Tab and FF means Form Feed, it seems that xterm is doing an IND instead.
+        on(VT, [](Sequence const&, Screen& _screen) { _screen.index(); return ApplyResult::Ok; });
+        on(FF, [](Sequence const&, Screen& _screen) { _screen.index(); return ApplyResult::Ok; });
+        on(CR, [](Sequence const&, Screen& _screen) { _screen.moveCursorToBeginOfLine(); return ApplyResult::Ok; });
+
+        // ESC
+        on(SCS_G0_SPECIAL, [](Sequence const&, Screen& _screen) { _screen.designateCharset(CharsetTable::G0, CharsetId::Special); return ApplyResult::Ok; });
+        on(SCS_G0_USASCII, [](Sequence const&, Screen& _screen) { _screen.designateCharset(CharsetTable::G0, CharsetId::USASCII); return ApplyResult::Ok; });
+        on(SCS_G1_SPECIAL, [](Sequence const&, Screen& _screen) { _screen.designateCharset(CharsetTable::G1, CharsetId::Special); return ApplyResult::Ok; });
+        on(SCS_G1_USASCII, [](Sequence const&, Screen& _screen) { _screen.designateCharset(CharsetTable::G1, CharsetId::USASCII); return ApplyResult::Ok; });
+        on(DECALN, [](Sequence const&, Screen& _screen) { _screen.screenAlignmentPattern(); return ApplyResult::Ok; });
+        on(DECBI, [](Sequence const&, Screen& _screen) { _screen.backIndex(); return ApplyResult::Ok; });
+        on(DECFI, [](Sequence const&, Screen& _screen) { _screen.forwardIndex(); return ApplyResult::Ok; });
+        on(DECKPAM, [](Sequence const&, Screen& _screen) { _screen.applicationKeypadMode(true); return ApplyResult::Ok; });
+        on(DECKPNM, [](Sequence const&, Screen& _screen) { _screen.applicationKeypadMode(false); return ApplyResult::Ok; });
+        on(DECRS, [](Sequence const&, Screen& _screen) { _screen.restoreCursor(); return ApplyResult::Ok; });
+        on(DECSC, [](Sequence const&, Screen& _screen) { _screen.saveCursor(); return ApplyResult::Ok; });
+        on(HTS, [](Sequence const&, Screen& _screen) { _screen.horizontalTabSet(); return ApplyResult::Ok; });
+        on(IND, [](Sequence const&, Screen& _screen) { _screen.index(); return ApplyResult::Ok; });
+        on(NEL, [](Sequence const&, Screen& _screen) { _screen.moveCursorToNextLine(1); return ApplyResult::Ok; });
+        on(RI, [](Sequence const&, Screen& _screen) { _screen.reverseIndex(); return ApplyResult::Ok; });
+        on(RIS, [](Sequence const&, Screen& _screen) { _screen.resetHard(); return ApplyResult::Ok; });
+        on(SS2, [](Sequence const&, Screen& _screen) { _screen.singleShiftSelect(CharsetTable::G2); return ApplyResult::Ok; });
+        on(SS3, [](Sequence const&, Screen& _screen) { _screen.singleShiftSelect(CharsetTable::G3); return ApplyResult::Ok; });
+
+        // CSI
+        on(ANSISYSSC, [](Sequence const&, Screen& _screen) { _screen.restoreCursor(); return ApplyResult::Ok; });
+        on(CBT, [](Sequence const& _seq, Screen& _screen) { _screen.cursorBackwardTab(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(CHA, [](Sequence const& _seq, Screen& _screen) { _screen.moveCursorToColumn(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(CHT, [](Sequence const& _seq, Screen& _screen) { _screen.cursorForwardTab(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(CNL, [](Sequence const& _seq, Screen& _screen) { _screen.moveCursorToNextLine(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(CPL, [](Sequence const& _seq, Screen& _screen) { _screen.moveCursorToPrevLine(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(CPR, impl::CPR);
+        on(CUB, [](Sequence const& _seq, Screen& _screen) { _screen.moveCursorBackward(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(CUD, [](Sequence const& _seq, Screen& _screen) { _screen.moveCursorDown(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(CUF, [](Sequence const& _seq, Screen& _screen) { _screen.moveCursorForward(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(CUP, [](Sequence const& _seq, Screen& _screen) { _screen.moveCursorTo(Coordinate{ _seq.param_or(0, 1), _seq.param_or(1, 1)}); return ApplyResult::Ok; });
+        on(CUU, [](Sequence const& _seq, Screen& _screen) { _screen.moveCursorUp(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(DA1, [](Sequence const&, Screen& _screen) { _screen.sendDeviceAttributes(); return ApplyResult::Ok; });
+        on(DA2, [](Sequence const&, Screen& _screen) { _screen.sendTerminalId(); return ApplyResult::Ok; });
+        on(DCH, [](Sequence const& _seq, Screen& _screen) { _screen.deleteCharacters(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(DECCRA, [](Sequence const& _seq, Screen& _screen) {
+            // The coordinates of the rectangular area are affected by the setting of origin mode (DECOM).
+            // DECCRA is not affected by the page margins.
+            auto const origin = _screen.origin();
+            auto const top = _seq.param_or(0, Sequence::Parameter{ origin.row });
+            auto const left = _seq.param_or(1, Sequence::Parameter{ origin.column });
+            auto const bottom = _seq.param_or(2, Sequence::Parameter{ _screen.size().height });
+            auto const right = _seq.param_or(3, Sequence::Parameter{ _screen.size().width });
+            auto const page = _seq.param_or(4, Sequence::Parameter{ 0 });
+
+            auto const targetTop = _seq.param_or(5, Sequence::Parameter{ origin.row });
+            auto const targetLeft = _seq.param_or(6, Sequence::Parameter{ origin.column });
+            auto const targetPage = _seq.param_or(7, Sequence::Parameter{ 0 });
+
+            _screen.copyArea(top, left, bottom, right, page,
+                             targetTop, targetLeft, targetPage);
+            return ApplyResult::Ok;
+        });
+        on(DECERA, [](Sequence const& _seq, Screen& _screen) {
+            // The coordinates of the rectangular area are affected by the setting of origin mode (DECOM).
+            auto const origin = _screen.origin();
+            auto const top = _seq.param_or(0, Sequence::Parameter{ origin.row });
+            auto const left = _seq.param_or(1, Sequence::Parameter{ origin.column });
+
+            // If the value of Pt, Pl, Pb, or Pr exceeds the width or height of the active page, then the value is treated as the width or height of that page.
+            auto const size = _screen.size();
+            auto const bottom = min(_seq.param_or(2, Sequence::Parameter{ size.height }), size.height);
+            auto const right = min(_seq.param_or(3, Sequence::Parameter{ size.width }), size.width);
+
+            _screen.eraseArea(top, left, bottom, right);
+            return ApplyResult::Ok;
+        });
+        on(DECFRA, [](Sequence const& _seq, Screen& _screen) {
+            auto const ch = _seq.param_or(0, Sequence::Parameter{ 0 });
+            // The coordinates of the rectangular area are affected by the setting of origin mode (DECOM).
+            auto const origin = _screen.origin();
+            auto const top = _seq.param_or(0, Sequence::Parameter{ origin.row });
+            auto const left = _seq.param_or(1, Sequence::Parameter{ origin.column });
+
+            // If the value of Pt, Pl, Pb, or Pr exceeds the width or height of the active page, then the value is treated as the width or height of that page.
+            auto const size = _screen.size();
+            auto const bottom = min(_seq.param_or(2, Sequence::Parameter{ size.height }), size.height);
+            auto const right = min(_seq.param_or(3, Sequence::Parameter{ size.width }), size.width);
+
+            _screen.fillArea(ch, top, left, bottom, right);
+            return ApplyResult::Ok;
+        });
+        on(DECDC, [](Sequence const& _seq, Screen& _screen) { _screen.deleteColumns(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(DECIC, [](Sequence const& _seq, Screen& _screen) { _screen.insertColumns(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(DECRM, [](Sequence const& _seq, Screen& _screen) { return impl::setModes(_seq, false, impl::setModeDEC, _screen); });
+        on(DECRQM, [](Sequence const& _seq, Screen& _screen) {
+            if (_seq.parameterCount() != 1)
+                return ApplyResult::Invalid;
+            _screen.requestDECMode(_seq.param(0));
+            return ApplyResult::Ok;
+        });
+        on(DECRQM_ANSI, [](Sequence const& _seq, Screen& _screen) {
+            if (_seq.parameterCount() != 1)
+                return ApplyResult::Invalid;
+            _screen.requestAnsiMode(_seq.param(0));
+            return ApplyResult::Ok;
+        });
+        on(DECRQPSR, impl::DECRQPSR);
+        on(DECSCUSR, impl::DECSCUSR);
+        on(DECSCPP, [](Sequence const& _seq, Screen& _screen) {
+            if (auto const columnCount = _seq.param_or(0, 80); columnCount == 80 || columnCount == 132)
+            {
+                // EXTENSION: only 80 and 132 are specced, but we allow any.
+                _screen.resizeColumns(columnCount, false);
+                return ApplyResult::Ok;
+            }
+            else
+                return ApplyResult::Invalid;
+        });
+        on(DECSNLS, [](Sequence const& _seq, Screen& _screen) {
+            _screen.resize(Size{_screen.size().height, _seq.param(0)});
+            return ApplyResult::Ok;
+        });
+        on(DECSLRM, [](Sequence const& _seq, Screen& _screen) { _screen.setLeftRightMargin(_seq.param_opt(0), _seq.param_opt(1)); return ApplyResult::Ok; });
+        on(DECSM, [](Sequence const& _seq, Screen& _screen) { return impl::setModes(_seq, true, impl::setModeDEC, _screen); });
+        on(DECSTBM, [](Sequence const& _seq, Screen& _screen) { _screen.setTopBottomMargin(_seq.param_opt(0), _seq.param_opt(1)); return ApplyResult::Ok; });
+        on(DECSTR, [](Sequence const&, Screen& _screen) { _screen.resetSoft(); return ApplyResult::Ok; });
+        on(DECXCPR, [](Sequence const&, Screen& _screen) { _screen.reportExtendedCursorPosition(); return ApplyResult::Ok; });
+        on(DL, [](Sequence const& _seq, Screen& _screen) { _screen.deleteLines(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(ECH, [](Sequence const& _seq, Screen& _screen) { _screen.eraseCharacters(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(ED, impl::ED);
+        on(EL, impl::EL);
+        on(HPA, [](Sequence const& _seq, Screen& _screen) { _screen.moveCursorToColumn(_seq.param(0)); return ApplyResult::Ok; });
+        on(HPR, [](Sequence const& _seq, Screen& _screen) { _screen.moveCursorForward(_seq.param(0)); return ApplyResult::Ok; });
+        on(HVP, [](Sequence const& _seq, Screen& _screen) { _screen.moveCursorTo(Coordinate{_seq.param_or(0, Sequence::Parameter{1}), _seq.param_or(1, Sequence::Parameter{1})}); return ApplyResult::Ok; }); // YES, it's like a CUP!
+        on(ICH, [](Sequence const& _seq, Screen& _screen) { _screen.insertCharacters(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(IL, [](Sequence const& _seq, Screen& _screen) { _screen.insertLines(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        // REP is applied by the Sequencer itself, as it repeats the preceding graphic character.
+        on(RM, [](Sequence const& _seq, Screen& _screen) { return impl::setModes(_seq, false, impl::setAnsiMode, _screen); });
+        on(SCOSC, [](Sequence const&, Screen& _screen) { _screen.saveCursor(); return ApplyResult::Ok; });
+        on(SD, [](Sequence const& _seq, Screen& _screen) { _screen.scrollDown(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(SETMARK, [](Sequence const&, Screen& _screen) { _screen.setMark(); return ApplyResult::Ok; });
+        on(SGR, impl::dispatchSGR);
+        on(SM, [](Sequence const& _seq, Screen& _screen) { return impl::setModes(_seq, true, impl::setAnsiMode, _screen); });
+        on(SU, [](Sequence const& _seq, Screen& _screen) { _screen.scrollUp(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(TBC, impl::TBC);
+        on(VPA, [](Sequence const& _seq, Screen& _screen) { _screen.moveCursorToLine(_seq.param_or(0, Sequence::Parameter{1})); return ApplyResult::Ok; });
+        on(WINMANIP, impl::WINDOWMANIP);
+        on(DECMODERESTORE, impl::restoreDECModes);
+        on(DECMODESAVE, impl::saveDECModes);
+        on(XTSMGRAPHICS, impl::XTSMGRAPHICS);
+        on(XTVERSION, [](Sequence const&, Screen& _screen) {
+            _screen.reply(fmt::format("\033P>|{} {}\033\\",
+                                      LIBTERMINAL_NAME,
+                                      LIBTERMINAL_VERSION_STRING));
+            return ApplyResult::Ok;
+        });
+
+        // OSC
+        on(SETTITLE, [](Sequence const& _seq, Screen& _screen) {
+            //(not supported) ChangeIconTitle(_seq.oscString());
+            _screen.setWindowTitle(string(_seq.oscString()));
+            return ApplyResult::Ok;
+        });
+        on(SETICON, [](Sequence const&, Screen&) { return ApplyResult::Ok; }); // NB: Silently ignore!
+        on(SETWINTITLE, [](Sequence const& _seq, Screen& _screen) { _screen.setWindowTitle(string(_seq.oscString())); return ApplyResult::Ok; });
+        on(SETCOLPAL, impl::SETCOLPAL);
+        on(RCOLPAL, impl::RCOLPAL);
+        on(SETCWD, impl::SETCWD);
+        on(HYPERLINK, impl::HYPERLINK);
+        on(CAPTURE, impl::CAPTURE);
+        on(COLORFG, [](Sequence const& _seq, Screen& _screen) { return impl::setOrRequestDynamicColor(_seq, _screen, DynamicColorName::DefaultForegroundColor); });
+        on(COLORBG, [](Sequence const& _seq, Screen& _screen) { return impl::setOrRequestDynamicColor(_seq, _screen, DynamicColorName::DefaultBackgroundColor); });
+        on(COLORCURSOR, [](Sequence const& _seq, Screen& _screen) { return impl::setOrRequestDynamicColor(_seq, _screen, DynamicColorName::TextCursorColor); });
+        on(COLORMOUSEFG, [](Sequence const& _seq, Screen& _screen) { return impl::setOrRequestDynamicColor(_seq, _screen, DynamicColorName::MouseForegroundColor); });
+        on(COLORMOUSEBG, [](Sequence const& _seq, Screen& _screen) { return impl::setOrRequestDynamicColor(_seq, _screen, DynamicColorName::MouseBackgroundColor); });
+        on(SETFONT, impl::setFont);
+        on(SETFONTALL, impl::setAllFont);
+        on(CLIPBOARD, impl::clipboard);
+        // TODO: COLORSPECIAL: impl::setOrRequestDynamicColor(_seq, _screen, DynamicColorName::HighlightForegroundColor);
+        on(RCOLORFG, [](Sequence const&, Screen& _screen) { _screen.resetDynamicColor(DynamicColorName::DefaultForegroundColor); return ApplyResult::Ok; });
+        on(RCOLORBG, [](Sequence const&, Screen& _screen) { _screen.resetDynamicColor(DynamicColorName::DefaultBackgroundColor); return ApplyResult::Ok; });
+        on(RCOLORCURSOR, [](Sequence const&, Screen& _screen) { _screen.resetDynamicColor(DynamicColorName::TextCursorColor); return ApplyResult::Ok; });
+        on(RCOLORMOUSEFG, [](Sequence const&, Screen& _screen) { _screen.resetDynamicColor(DynamicColorName::MouseForegroundColor); return ApplyResult::Ok; });
+        on(RCOLORMOUSEBG, [](Sequence const&, Screen& _screen) { _screen.resetDynamicColor(DynamicColorName::MouseBackgroundColor); return ApplyResult::Ok; });
+        on(RCOLORHIGHLIGHTFG, [](Sequence const&, Screen& _screen) { _screen.resetDynamicColor(DynamicColorName::HighlightForegroundColor); return ApplyResult::Ok; });
+        on(RCOLORHIGHLIGHTBG, [](Sequence const&, Screen& _screen) { _screen.resetDynamicColor(DynamicColorName::HighlightBackgroundColor); return ApplyResult::Ok; });
+        on(NOTIFY, impl::NOTIFY);
+        on(DUMPSTATE, [](Sequence const&, Screen& _screen) { _screen.dumpState(); return ApplyResult::Ok; });
+        on(SHMIMAGE, impl::SHMIMAGE);
+
+        return handlers;
+    }();
+} // }}}
+
 // {{{ Sequence impl
 std::string Sequence::raw() const
 {
@@ -904,7 +1150,7 @@ std::string Sequence::raw() const
         case FunctionCategory::OSC: sstr << "\033]"; break;
     }
 
-    if (parameterCount() > 1 || (parameterCount() == 1 && parameters_[0][0] != 0))
+    if (parameterCount() > 1 || (parameterCount() == 1 && param(0) != 0))
     {
         for (auto i = 0u; i < parameterCount(); ++i)
         {
@@ -917,7 +1163,10 @@ std::string Sequence::raw() const
         }
     }
 
-    sstr << intermediateCharacters();
+    if (category_ == FunctionCategory::OSC)
+        sstr << oscString_;
+    else
+        sstr << intermediateCharacters();
 
     if (finalChar_)
         sstr << finalChar_;
@@ -937,38 +1186,23 @@ string Sequence::text() const
     if (leaderSymbol_)
         sstr << ' ' << leaderSymbol_;
 
-    if (parameterCount() > 1 || (parameterCount() == 1 && parameters_[0][0] != 0))
+    if (parameterCount() > 1 || (parameterCount() == 1 && param(0) != 0))
     {
-        sstr << ' ' << accumulate(
-            begin(parameters_), end(parameters_), string{},
-            [](string const& a, auto const& p) -> string {
-                return !a.empty()
-                    ? fmt::format("{};{}",
-                            a,
-                            accumulate(
-                                begin(p), end(p),
-                                string{},
-                                [](string const& x, Sequence::Parameter y) -> string {
-                                    return !x.empty()
-                                        ? fmt::format("{}:{}", x, y)
-                                        : std::to_string(y);
-                                }
-                            )
-                        )
-                    : accumulate(
-                            begin(p), end(p),
-                            string{},
-                            [](string const& x, Sequence::Parameter y) -> string {
-                                return !x.empty()
-                                    ? fmt::format("{}:{}", x, y)
-                                    : std::to_string(y);
-                            }
-                        );
-            }
-        );
+        sstr << ' ';
+        for (auto i = 0u; i < parameterCount(); ++i)
+        {
+            if (i)
+                sstr << ';';
+
+            sstr << param(i);
+            for (auto k = 0u; k < subParameterCount(i); ++k)
+                sstr << ':' << subparam(i, k);
+        }
     }
 
-    if (!intermediateCharacters().empty())
+    if (!oscString_.empty())
+        sstr << ' ' << oscString_;
+    else if (!intermediateCharacters().empty())
         sstr << ' ' << intermediateCharacters();
 
     if (finalChar_)
@@ -1004,6 +1238,15 @@ void Sequencer::print(char32_t _char)
     screen_.writeText(_char);
 }
 
+void Sequencer::print(string_view _chars)
+{
+    assert(!_chars.empty());
+
+    precedingGraphicCharacter_ = static_cast<char32_t>(_chars.back());
+    instructionCounter_++;
+    screen_.writeText(_chars);
+}
+
 void Sequencer::execute(char _controlCode)
 {
     executeControlFunction(_controlCode);
@@ -1027,17 +1270,15 @@ void Sequencer::collectLeader(char _leader)
 void Sequencer::param(char _char)
 {
     if (sequence_.parameters().empty())
-        sequence_.parameters().push_back({0});
+        sequence_.parameters().push();
 
     switch (_char)
     {
         case ';':
-            if (sequence_.parameters().size() < Sequence::MaxParameters)
-                sequence_.parameters().push_back({0});
+            sequence_.parameters().push();
             break;
         case ':':
-            if (sequence_.parameters().back().size() < Sequence::MaxParameters)
-                sequence_.parameters().back().push_back({0});
+            sequence_.parameters().pushSubParameter();
             break;
         case '0':
         case '1':
@@ -1049,7 +1290,7 @@ void Sequencer::param(char _char)
         case '7':
         case '8':
         case '9':
-            sequence_.parameters().back().back() = sequence_.parameters().back().back() * 10 + (_char - U'0');
+            sequence_.parameters().appendDigit(_char - '0');
             break;
     }
 }
@@ -1075,6 +1316,8 @@ void Sequencer::startOSC()
 
 void Sequencer::putOSC(char32_t _char)
 {
+    spillOSC();
+
     uint8_t u8[4];
     size_t const count = distance(u8, unicode::encoder<char>{}(_char, u8));
     if (sequence_.intermediateCharacters().size() + count < Sequence::MaxOscLength)
@@ -1082,28 +1325,53 @@ void Sequencer::putOSC(char32_t _char)
             sequence_.intermediateCharacters().push_back(u8[i]);
 }
 
+void Sequencer::putOSC(string_view _chars)
+{
+    if (sequence_.intermediateCharacters().empty() && sequence_.oscString().empty())
+    {
+        // No need to copy, the parser keeps the string alive until dispatchOSC() returns.
+        sequence_.setOscString(_chars);
+        return;
+    }
+
+    spillOSC();
+    auto& data = sequence_.intermediateCharacters();
+    data.append(_chars.substr(0, Sequence::MaxOscLength - min(Sequence::MaxOscLength, data.size())));
+}
+
+void Sequencer::spillOSC()
+{
+    if (sequence_.oscString().empty())
+        return;
+
+    sequence_.intermediateCharacters().append(sequence_.oscString());
+    sequence_.setOscString({});
+}
+
 void Sequencer::dispatchOSC()
 {
-    auto const [code, skipCount] = parseOSC(sequence_.intermediateCharacters());
-    sequence_.parameters().push_back({static_cast<Sequence::Parameter>(code)});
-    sequence_.intermediateCharacters().erase(0, skipCount);
+    auto const data = !sequence_.oscString().empty()
+                    ? sequence_.oscString()
+                    : string_view(sequence_.intermediateCharacters());
+    auto const [code, skipCount] = parseOSC(data);
+    sequence_.parameters().push(static_cast<Sequence::Parameter>(code));
+    sequence_.setOscString(data.substr(skipCount));
     handleSequence();
     sequence_.clear();
 }
 
-void Sequencer::hook(char _finalChar)
+bool Sequencer::hook(char _finalChar)
 {
     instructionCounter_++;
     sequence_.setCategory(FunctionCategory::DCS);
     sequence_.setFinalChar(_finalChar);
 
-#if defined(LIBTERMINAL_LOG_TRACE)
-    if (crispy::logging_sink::for_debug().enabled())
+    if (crispy::debugtag::enabled(VTParserTraceTag))
         debuglog(VTParserTraceTag).write("Handle VT sequence: {}", sequence_);
-#endif
 
     if (FunctionDefinition const* funcSpec = sequence_.functionDefinition(); funcSpec != nullptr)
     {
+        metrics_(*funcSpec);
         switch (funcSpec->id())
         {
             case DECSIXEL:
@@ -1118,11 +1386,16 @@ void Sequencer::hook(char _finalChar)
             case XTGETTCAP:
                 hookedParser_ = hookXTGETTCAP(sequence_);
                 break;
+            case IMGXFER:
+                hookedParser_ = hookImageTransfer(sequence_);
+                break;
         }
 
         if (hookedParser_)
             hookedParser_->start();
     }
+
+    return hookedParser_ != nullptr;
 }
 
 void Sequencer::put(char32_t _char)
@@ -1131,6 +1404,12 @@ void Sequencer::put(char32_t _char)
         hookedParser_->pass(_char);
 }
 
+void Sequencer::put(string_view _chars)
+{
+    if (hookedParser_)
+        hookedParser_->pass(_chars);
+}
+
 void Sequencer::unhook()
 {
     if (hookedParser_)
@@ -1181,9 +1460,23 @@ unique_ptr<ParserExtension> Sequencer::hookSixel(Sequence const& _seq)
             : imageColorPalette_
     );
 
+    // Hand out the image in strips of one grid line as soon as the sixel cursor has passed them,
+    // so that large images show up while they are still being transmitted.
+    if (auto const cellHeight = screen_.cellPixelSize().height; sixelProgressive_ && cellHeight > 0)
+    {
+        sixelImageBuilder_->setProgressive(
+            cellHeight,
+            [this](int _top, Size _pixelSize, SixelImageBuilder::Buffer&& _rgba, bool _last) {
+                screen_.sixelImageStrip(_pixelSize, move(_rgba), _top == 0, _last);
+            }
+        );
+    }
+
     return make_unique<SixelParser>(
         *sixelImageBuilder_,
         [this]() {
+            // In progressive mode, the image has been handed out strip by strip already.
+            if (!sixelImageBuilder_->progressive())
             {
                 screen_.sixelImage(
                     sixelImageBuilder_->size(),
@@ -1194,6 +1487,36 @@ unique_ptr<ParserExtension> Sequencer::hookSixel(Sequence const& _seq)
     );
 }
 
+unique_ptr<ParserExtension> Sequencer::hookImageTransfer(Sequence const& _seq)
+{
+    // DCS Pf ; Pm i <base64 data> ST
+    auto const format = _seq.param_or(0, static_cast<int>(ImageTransferFormat::QOI));
+    auto const more = _seq.param_or(1, 0) != 0;
+
+    if (format != static_cast<int>(ImageTransferFormat::QOI))
+    {
+        debuglog(VTParserTag).write("Ignoring image transfer of unsupported format {}.", format);
+        imageTransfer_.reset();
+        return {};
+    }
+
+    if (!imageTransfer_)
+        imageTransfer_.emplace(maxImageSize_);
+
+    return make_unique<ImageTransferParser>(
+        *imageTransfer_,
+        [this, more]() {
+            if (more)
+                return;
+
+            auto image = imageTransfer_->finish();
+            imageTransfer_.reset();
+            if (image)
+                screen_.compressedImage(image->size, std::move(image->pixels));
+        }
+    );
+}
+
 unique_ptr<ParserExtension> Sequencer::hookSTP(Sequence const& /*_seq*/)
 {
     return make_unique<SimpleStringCollector>(
@@ -1313,25 +1636,39 @@ void Sequencer::executeControlFunction(char _c0)
 
 void Sequencer::handleSequence()
 {
-#if defined(LIBTERMINAL_LOG_TRACE)
-    if (crispy::logging_sink::for_debug().enabled())
+    CRISPY_PROFILE_ZONE("Sequencer::handleSequence");
+
+    if (crispy::debugtag::enabled(VTParserTraceTag))
         debuglog(VTParserTraceTag).write("Handle VT sequence: {}", sequence_);
-#endif
     // std::cerr << fmt::format("\t{} \t; {}\n", sequence_,
     //         sequence_.functionDefinition() ? sequence_.functionDefinition()->comment : ""sv);
 
     instructionCounter_++;
     if (FunctionDefinition const* funcSpec = sequence_.functionDefinition(); funcSpec != nullptr)
     {
+        metrics_(*funcSpec);
         applyAndLog(*funcSpec, sequence_);
         screen_.verifyState();
     }
     else
+    {
+        metrics_.unknown();
         debuglog(VTParserTag).write("Unknown VT sequence: {}", sequence_);
+    }
+}
+
+void Sequencer::trimMemory()
+{
+    if (batchedSequences_.empty())
+        batchedSequences_.shrink_to_fit();
+    if (sequence_.dataString().empty())
+        sequence_.dataString().shrink_to_fit();
 }
 
 void Sequencer::flushBatchedSequences()
 {
+    CRISPY_PROFILE_ZONE("Sequencer::flushBatchedSequences");
+
     for (auto const& batchable : batchedSequences_)
     {
         if (holds_alternative<char32_t>(batchable))
@@ -1371,247 +1708,27 @@ void Sequencer::applyAndLog(FunctionDefinition const& _function, Sequence const&
 ApplyResult Sequencer::apply(FunctionDefinition const& _function, Sequence const& _seq)
 {
     // This function assumed that the incoming instruction has been already resolved to a given
-    // FunctionDefinition
-    switch (_function)
-    {
-        // C0
-        case BEL: screen_.eventListener().bell(); break;
-        case BS: screen_.backspace(); break;
-        case TAB: screen_.moveCursorToNextTab(); break;
-        case LF: screen_.linefeed(); break;
-        case VT: [[fallthrough]];
-        case FF: screen_.index(); break;
-        case CR: screen_.moveCursorToBeginOfLine(); break;
-
-        // ESC
-        case SCS_G0_SPECIAL: screen_.designateCharset(CharsetTable::G0, CharsetId::Special); break;
-        case SCS_G0_USASCII: screen_.designateCharset(CharsetTable::G0, CharsetId::USASCII); break;
-        case SCS_G1_SPECIAL: screen_.designateCharset(CharsetTable::G1, CharsetId::Special); break;
-        case SCS_G1_USASCII: screen_.designateCharset(CharsetTable::G1, CharsetId::USASCII); break;
-        case DECALN: screen_.screenAlignmentPattern(); break;
-        case DECBI: screen_.backIndex(); break;
-        case DECFI: screen_.forwardIndex(); break;
-        case DECKPAM: screen_.applicationKeypadMode(true); break;
-        case DECKPNM: screen_.applicationKeypadMode(false); break;
-        case DECRS: screen_.restoreCursor(); break;
-        case DECSC: screen_.saveCursor(); break;
-        case HTS: screen_.horizontalTabSet(); break;
-        case IND: screen_.index(); break;
-        case NEL: screen_.moveCursorToNextLine(1); break;
-        case RI: screen_.reverseIndex(); break;
-        case RIS: screen_.resetHard(); break;
-        case SS2: screen_.singleShiftSelect(CharsetTable::G2); break;
-        case SS3: screen_.singleShiftSelect(CharsetTable::G3); break;
+    // FunctionDefinition, being one of functions().
+    auto const index = static_cast<size_t>(&_function - functions().data());
+    assert(index < functionHandlers.size());
 
-        // CSI
-        case ANSISYSSC: screen_.restoreCursor(); break;
-        case CBT: screen_.cursorBackwardTab(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case CHA: screen_.moveCursorToColumn(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case CHT: screen_.cursorForwardTab(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case CNL: screen_.moveCursorToNextLine(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case CPL: screen_.moveCursorToPrevLine(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case CPR: return impl::CPR(_seq, screen_);
-        case CUB: screen_.moveCursorBackward(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case CUD: screen_.moveCursorDown(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case CUF: screen_.moveCursorForward(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case CUP: screen_.moveCursorTo(Coordinate{ _seq.param_or(0, 1), _seq.param_or(1, 1)}); break;
-        case CUU: screen_.moveCursorUp(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case DA1: screen_.sendDeviceAttributes(); break;
-        case DA2: screen_.sendTerminalId(); break;
-        case DA3: return ApplyResult::Unsupported;
-        case DCH: screen_.deleteCharacters(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case DECCRA:
-            {
-                // The coordinates of the rectangular area are affected by the setting of origin mode (DECOM).
-                // DECCRA is not affected by the page margins.
-                auto const origin = screen_.origin();
-                auto const top = _seq.param_or(0, Sequence::Parameter{ origin.row });
-                auto const left = _seq.param_or(1, Sequence::Parameter{ origin.column });
-                auto const bottom = _seq.param_or(2, Sequence::Parameter{ screen_.size().height });
-                auto const right = _seq.param_or(3, Sequence::Parameter{ screen_.size().width });
-                auto const page = _seq.param_or(4, Sequence::Parameter{ 0 });
-
-                auto const targetTop = _seq.param_or(5, Sequence::Parameter{ origin.row });
-                auto const targetLeft = _seq.param_or(6, Sequence::Parameter{ origin.column });
-                auto const targetPage = _seq.param_or(7, Sequence::Parameter{ 0 });
-
-                screen_.copyArea(top, left, bottom, right, page,
-                                 targetTop, targetLeft, targetPage);
-            }
-            break;
-        case DECERA:
-            {
-                // The coordinates of the rectangular area are affected by the setting of origin mode (DECOM).
-                auto const origin = screen_.origin();
-                auto const top = _seq.param_or(0, Sequence::Parameter{ origin.row });
-                auto const left = _seq.param_or(1, Sequence::Parameter{ origin.column });
-
-                // If the value of Pt, Pl, Pb, or Pr exceeds the width or height of the active page, then the value is treated as the width or height of that page.
-                auto const size = screen_.size();
-                auto const bottom = min(_seq.param_or(2, Sequence::Parameter{ size.height }), size.height);
-                auto const right = min(_seq.param_or(3, Sequence::Parameter{ size.width }), size.width);
-
-                screen_.eraseArea(top, left, bottom, right);
-            }
-            break;
-        case DECFRA:
-            {
-                auto const ch = _seq.param_or(0, Sequence::Parameter{ 0 });
-                // The coordinates of the rectangular area are affected by the setting of origin mode (DECOM).
-                auto const origin = screen_.origin();
-                auto const top = _seq.param_or(0, Sequence::Parameter{ origin.row });
-                auto const left = _seq.param_or(1, Sequence::Parameter{ origin.column });
-
-                // If the value of Pt, Pl, Pb, or Pr exceeds the width or height of the active page, then the value is treated as the width or height of that page.
-                auto const size = screen_.size();
-                auto const bottom = min(_seq.param_or(2, Sequence::Parameter{ size.height }), size.height);
-                auto const right = min(_seq.param_or(3, Sequence::Parameter{ size.width }), size.width);
-
-                screen_.fillArea(ch, top, left, bottom, right);
-            }
-            break;
-        case DECDC: screen_.deleteColumns(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case DECIC: screen_.insertColumns(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case DECRM:
-            {
-                ApplyResult r = ApplyResult::Ok;
-                crispy::for_each(crispy::times(_seq.parameterCount()), [&](size_t i) {
-                    auto const t = impl::setModeDEC(_seq, i, false, screen_);
-                    r = max(r, t);
-                });
-                return r;
-            }
-            break;
-        case DECRQM:
-            if (_seq.parameterCount() != 1)
-                return ApplyResult::Invalid;
-            screen_.requestDECMode(_seq.param(0));
-            return ApplyResult::Ok;
-        case DECRQM_ANSI:
-            if (_seq.parameterCount() != 1)
-                return ApplyResult::Invalid;
-            screen_.requestAnsiMode(_seq.param(0));
-            return ApplyResult::Ok;
-        case DECRQPSR: return impl::DECRQPSR(_seq, screen_);
-        case DECSCUSR: return impl::DECSCUSR(_seq, screen_);
-        case DECSCPP:
-            if (auto const columnCount = _seq.param_or(0, 80); columnCount == 80 || columnCount == 132)
-            {
-                // EXTENSION: only 80 and 132 are specced, but we allow any.
-                screen_.resizeColumns(columnCount, false);
-                return ApplyResult::Ok;
-            }
-            else
-                return ApplyResult::Invalid;
-        case DECSNLS:
-            screen_.resize(Size{screen_.size().height, _seq.param(0)});
-            return ApplyResult::Ok;
-        case DECSLRM: screen_.setLeftRightMargin(_seq.param_opt(0), _seq.param_opt(1)); break;
-        case DECSM:
-            {
-                ApplyResult r = ApplyResult::Ok;
-                crispy::for_each(crispy::times(_seq.parameterCount()), [&](size_t i)
-                {
-                    auto const t = impl::setModeDEC(_seq, i, true, screen_);
-                    r = max(r, t);
-                });
-                return r;
-            }
-        case DECSTBM: screen_.setTopBottomMargin(_seq.param_opt(0), _seq.param_opt(1)); break;
-        case DECSTR: screen_.resetSoft(); break;
-        case DECXCPR: screen_.reportExtendedCursorPosition(); break;
-        case DL: screen_.deleteLines(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case ECH: screen_.eraseCharacters(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case ED: return impl::ED(_seq, screen_);
-        case EL: return impl::EL(_seq, screen_);
-        case HPA: screen_.moveCursorToColumn(_seq.param(0)); break;
-        case HPR: screen_.moveCursorForward(_seq.param(0)); break;
-        case HVP: screen_.moveCursorTo(Coordinate{_seq.param_or(0, Sequence::Parameter{1}), _seq.param_or(1, Sequence::Parameter{1})}); break; // YES, it's like a CUP!
-        case ICH: screen_.insertCharacters(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case IL:  screen_.insertLines(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case REP:
-            if (precedingGraphicCharacter_)
-            {
-                auto const requestedCount = _seq.param(0);
-                auto const availableColumns = screen_.margin().horizontal.to - screen_.cursor().position.column + 1;
-                auto const effectiveCount = min(requestedCount, availableColumns);
-                for (int i = 0; i < effectiveCount; i++)
-                    screen_.writeText(precedingGraphicCharacter_);
-            }
-            break;
-        case RM:
-            {
-                ApplyResult r = ApplyResult::Ok;
-                crispy::for_each(crispy::times(_seq.parameterCount()), [&](size_t i)
-                {
-                    auto const t = impl::setAnsiMode(_seq, i, false, screen_);
-                    r = max(r, t);
-                });
-                return r;
-            }
-            break;
-        case SCOSC: screen_.saveCursor(); break;
-        case SD: screen_.scrollDown(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case SETMARK: screen_.setMark(); break;
-        case SGR: return impl::dispatchSGR(_seq, screen_);
-        case SM:
-            {
-                ApplyResult r = ApplyResult::Ok;
-                crispy::for_each(crispy::times(_seq.parameterCount()), [&](size_t i)
-                {
-                    auto const t = impl::setAnsiMode(_seq, i, true, screen_);
-                    r = max(r, t);
-                });
-                return r;
-            }
-        case SU: screen_.scrollUp(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case TBC: return impl::TBC(_seq, screen_);
-        case VPA: screen_.moveCursorToLine(_seq.param_or(0, Sequence::Parameter{1})); break;
-        case WINMANIP: return impl::WINDOWMANIP(_seq, screen_);
-        case DECMODERESTORE: return impl::restoreDECModes(_seq, screen_);
-        case DECMODESAVE: return impl::saveDECModes(_seq, screen_);
-        case XTSMGRAPHICS: return impl::XTSMGRAPHICS(_seq, screen_);
-        case XTVERSION:
-            screen_.reply(fmt::format("\033P>|{} {}\033\\",
-                                      LIBTERMINAL_NAME,
-                                      LIBTERMINAL_VERSION_STRING));
-            return ApplyResult::Ok;
+    if (FunctionHandler const handler = functionHandlers[index])
+        return handler(_seq, screen_);
 
-        // OSC
-        case SETTITLE:
-            //(not supported) ChangeIconTitle(_seq.intermediateCharacters());
-            screen_.setWindowTitle(_seq.intermediateCharacters());
-            return ApplyResult::Ok;
-        case SETICON:
-            return ApplyResult::Ok; // NB: Silently ignore!
-        case SETWINTITLE: screen_.setWindowTitle(_seq.intermediateCharacters()); break;
-        case SETXPROP: return ApplyResult::Unsupported;
-        case SETCOLPAL: return impl::SETCOLPAL(_seq, screen_);
-        case RCOLPAL: return impl::RCOLPAL(_seq, screen_);
-        case SETCWD: return impl::SETCWD(_seq, screen_);
-        case HYPERLINK: return impl::HYPERLINK(_seq, screen_);
-        case CAPTURE: return impl::CAPTURE(_seq, screen_);
-        case COLORFG: return impl::setOrRequestDynamicColor(_seq, screen_, DynamicColorName::DefaultForegroundColor);
-        case COLORBG: return impl::setOrRequestDynamicColor(_seq, screen_, DynamicColorName::DefaultBackgroundColor);
-        case COLORCURSOR: return impl::setOrRequestDynamicColor(_seq, screen_, DynamicColorName::TextCursorColor);
-        case COLORMOUSEFG: return impl::setOrRequestDynamicColor(_seq, screen_, DynamicColorName::MouseForegroundColor);
-        case COLORMOUSEBG: return impl::setOrRequestDynamicColor(_seq, screen_, DynamicColorName::MouseBackgroundColor);
-        case SETFONT: return impl::setFont(_seq, screen_);
-        case SETFONTALL: return impl::setAllFont(_seq, screen_);
-        case CLIPBOARD: return impl::clipboard(_seq, screen_);
-        // TODO: case COLORSPECIAL: return impl::setOrRequestDynamicColor(_seq, _output, DynamicColorName::HighlightForegroundColor);
-        case RCOLORFG: screen_.resetDynamicColor(DynamicColorName::DefaultForegroundColor); break;
-        case RCOLORBG: screen_.resetDynamicColor(DynamicColorName::DefaultBackgroundColor); break;
-        case RCOLORCURSOR: screen_.resetDynamicColor(DynamicColorName::TextCursorColor); break;
-        case RCOLORMOUSEFG: screen_.resetDynamicColor(DynamicColorName::MouseForegroundColor); break;
-        case RCOLORMOUSEBG: screen_.resetDynamicColor(DynamicColorName::MouseBackgroundColor); break;
-        case RCOLORHIGHLIGHTFG: screen_.resetDynamicColor(DynamicColorName::HighlightForegroundColor); break;
-        case RCOLORHIGHLIGHTBG: screen_.resetDynamicColor(DynamicColorName::HighlightBackgroundColor); break;
-        case NOTIFY: return impl::NOTIFY(_seq, screen_);
-        case DUMPSTATE: screen_.dumpState(); break;
-        default: return ApplyResult::Unsupported;
+    if (_function == REP)
+    {
+        if (precedingGraphicCharacter_)
+        {
+            auto const requestedCount = _seq.param(0);
+            auto const availableColumns = screen_.margin().horizontal.to - screen_.cursor().position.column + 1;
+            auto const effectiveCount = min(requestedCount, availableColumns);
+            for (int i = 0; i < effectiveCount; i++)
+                screen_.writeText(precedingGraphicCharacter_);
+        }
+        return ApplyResult::Ok;
     }
-    return ApplyResult::Ok;
+
+    return ApplyResult::Unsupported;
 }
 
 std::string to_string(AnsiMode _mode)
@@ -17,9 +17,12 @@
 #include <terminal/ParserEvents.h>
 #include <terminal/ParserExtension.h>
 #include <terminal/Functions.h>
+#include <terminal/Metrics.h>
+#include <terminal/ImageTransfer.h>
 #include <terminal/SixelParser.h>
 #include <crispy/size.h>
 
+#include <array>
 #include <cassert>
 #include <memory>
 #include <string>
@@ -454,11 +457,84 @@ enum class ApplyResult {
 };
 // }}}
 
+/// Fixed-capacity storage for the numeric parameters of a VT sequence.
+///
+/// Each parameter may carry colon-separated sub-parameters. All values live inline,
+/// so that clearing and refilling the list for each sequence never allocates.
+class SequenceParameters {
+  public:
+    using Parameter = int;
+
+    size_t constexpr static MaxParameters = 16;
+    size_t constexpr static MaxSubParameters = 8;
+
+    void clear() noexcept { count_ = 0; }
+
+    /// Starts a new parameter, unless the maximum number of parameters has been reached already.
+    void push(Parameter _value = 0) noexcept
+    {
+        if (count_ == MaxParameters)
+            return;
+        values_[count_ * Stride] = _value;
+        subParameterCounts_[count_] = 0;
+        ++count_;
+    }
+
+    /// Starts a new sub-parameter for the last parameter,
+    /// unless the maximum number of sub-parameters has been reached already.
+    void pushSubParameter() noexcept
+    {
+        assert(count_ != 0);
+        auto& subCount = subParameterCounts_[count_ - 1];
+        if (subCount == MaxSubParameters)
+            return;
+        ++subCount;
+        values_[(count_ - 1) * Stride + subCount] = 0;
+    }
+
+    /// Appends a decimal digit to the last (sub-)parameter.
+    void appendDigit(Parameter _digit) noexcept
+    {
+        assert(count_ != 0);
+        auto& value = values_[(count_ - 1) * Stride + subParameterCounts_[count_ - 1]];
+        value = value * 10 + _digit;
+    }
+
+    bool empty() const noexcept { return count_ == 0; }
+    size_t size() const noexcept { return count_; }
+
+    size_t subParameterCount(size_t _index) const noexcept
+    {
+        assert(_index < count_);
+        return subParameterCounts_[_index];
+    }
+
+    Parameter value(size_t _index) const noexcept
+    {
+        assert(_index < count_);
+        return values_[_index * Stride];
+    }
+
+    Parameter subParameter(size_t _index, size_t _subIndex) const noexcept
+    {
+        assert(_index < count_);
+        assert(_subIndex < subParameterCounts_[_index]);
+        return values_[_index * Stride + 1 + _subIndex];
+    }
+
+  private:
+    size_t constexpr static Stride = 1 + MaxSubParameters;
+
+    std::array<Parameter, MaxParameters * Stride> values_{};
+    std::array<uint8_t, MaxParameters> subParameterCounts_{};
+    size_t count_ = 0;
+};
+
 /// Helps constructing VT functions as they're being parsed by the VT parser.
 class Sequence {
   public:
-    using Parameter = int;
-    using ParameterList = std::vector<std::vector<Parameter>>;
+    using Parameter = SequenceParameters::Parameter;
+    using ParameterList = SequenceParameters;
     using Intermediaries = std::string;
     using DataString = std::string;
 
@@ -467,22 +543,15 @@ class Sequence {
     char leaderSymbol_ = 0;
     ParameterList parameters_;
     Intermediaries intermediateCharacters_;
+    std::string_view oscString_;
     char finalChar_ = 0;
     DataString dataString_;
 
   public:
-    size_t constexpr static MaxParameters = 16;
-    size_t constexpr static MaxSubParameters = 8;
+    size_t constexpr static MaxParameters = SequenceParameters::MaxParameters;
+    size_t constexpr static MaxSubParameters = SequenceParameters::MaxSubParameters;
     size_t constexpr static MaxOscLength = 512;
 
-    Sequence()
-    {
-        parameters_.resize(MaxParameters);
-        for (auto& param : parameters_)
-            param.reserve(MaxSubParameters);
-        parameters_.clear();
-    }
-
     // mutators
     //
     void clear()
@@ -490,6 +559,7 @@ class Sequence {
         category_ = FunctionCategory::C0;
         leaderSymbol_ = 0;
         intermediateCharacters_.clear();
+        oscString_ = {};
         parameters_.clear();
         finalChar_ = 0;
         dataString_.clear();
@@ -500,6 +570,7 @@ class Sequence {
     ParameterList& parameters() noexcept { return parameters_; }
     Intermediaries& intermediateCharacters() noexcept { return intermediateCharacters_; }
     void setFinalChar(char _ch) noexcept { finalChar_ = _ch; }
+    void setOscString(std::string_view _value) noexcept { oscString_ = _value; }
 
     DataString const& dataString() const noexcept { return dataString_; }
     DataString& dataString() noexcept { return dataString_; }
@@ -521,7 +592,7 @@ class Sequence {
         switch (category_)
         {
             case FunctionCategory::OSC:
-                return FunctionSelector{category_, 0, parameters_[0][0], 0, 0};
+                return FunctionSelector{category_, 0, parameters_.value(0), 0, 0};
             default:
             {
                 // Only support CSI sequences with 0 or 1 intermediate characters.
@@ -540,14 +611,20 @@ class Sequence {
     Intermediaries const& intermediateCharacters() const noexcept { return intermediateCharacters_; }
     char finalChar() const noexcept { return finalChar_; }
 
+    /// @returns the OSC control string without its leading numeric code.
+    ///
+    /// This may refer directly to the parser's input, and is thus only valid while
+    /// the sequence is being dispatched.
+    std::string_view oscString() const noexcept { return oscString_; }
+
     ParameterList const& parameters() const noexcept { return parameters_; }
     size_t parameterCount() const noexcept { return parameters_.size(); }
-    size_t subParameterCount(size_t _index) const noexcept { return parameters_[_index].size() - 1; }
+    size_t subParameterCount(size_t _index) const noexcept { return parameters_.subParameterCount(_index); }
 
     std::optional<Parameter> param_opt(size_t _index) const noexcept
     {
-        if (_index < parameters_.size() && parameters_[_index][0])
-            return {parameters_[_index][0]};
+        if (_index < parameters_.size() && parameters_.value(_index))
+            return {parameters_.value(_index)};
         else
             return std::nullopt;
     }
@@ -559,16 +636,12 @@ class Sequence {
 
     int param(size_t _index) const noexcept
     {
-        assert(_index < parameters_.size());
-        assert(0 < parameters_[_index].size());
-        return parameters_[_index][0];
+        return parameters_.value(_index);
     }
 
     int subparam(size_t _index, size_t _subIndex) const noexcept
     {
-        assert(_index < parameters_.size());
-        assert(_subIndex + 1 < parameters_[_index].size());
-        return parameters_[_index][_subIndex + 1];
+        return parameters_.subParameter(_index, _subIndex);
     }
 
     bool containsParameter(int _value) const noexcept
@@ -595,14 +668,22 @@ class Sequencer : public ParserEvents {
     void setMaxImageSize(crispy::Size _value) { maxImageSize_ = _value; }
     void setMaxImageColorRegisters(int _value) { maxImageRegisterCount_ = _value; }
     void setUsePrivateColorRegisters(bool _value) { usePrivateColorRegisters_ = _value; }
+    void setSixelProgressive(bool _value) { sixelProgressive_ = _value; }
 
     int64_t instructionCounter() const noexcept { return instructionCounter_; }
     void resetInstructionCounter() noexcept { instructionCounter_ = 0; }
 
+    /// @returns usage counters of all VT functions processed so far.
+    Metrics const& metrics() const noexcept { return metrics_; }
+
+    /// Gives back the memory of buffers grown by large control strings or batches, unless still in use.
+    void trimMemory();
+
     // ParserEvents
     //
     void error(std::string_view const& _errorString) override;
     void print(char32_t _text) override;
+    void print(std::string_view _chars) override;
     void execute(char _controlCode) override;
     void clear() override;
     void collect(char _char) override;
@@ -612,9 +693,11 @@ class Sequencer : public ParserEvents {
     void dispatchCSI(char _function) override;
     void startOSC() override;
     void putOSC(char32_t _char) override;
+    void putOSC(std::string_view _chars) override;
     void dispatchOSC() override;
-    void hook(char _function) override;
+    bool hook(char _function) override;
     void put(char32_t _char) override;
+    void put(std::string_view _chars) override;
     void unhook() override;
 
   private:
@@ -625,8 +708,10 @@ class Sequencer : public ParserEvents {
     [[nodiscard]] std::unique_ptr<ParserExtension> hookSixel(Sequence const& _ctx);
     [[nodiscard]] std::unique_ptr<ParserExtension> hookDECRQSS(Sequence const& _ctx);
     [[nodiscard]] std::unique_ptr<ParserExtension> hookXTGETTCAP(Sequence const& /*_seq*/);
+    [[nodiscard]] std::unique_ptr<ParserExtension> hookImageTransfer(Sequence const& _ctx);
 
     void flushBatchedSequences();
+    void spillOSC();
 
     void applyAndLog(FunctionDefinition const& _function, Sequence const& _context);
     ApplyResult apply(FunctionDefinition const& _function, Sequence const& _context);
@@ -637,13 +722,16 @@ class Sequencer : public ParserEvents {
     Screen& screen_;
     char32_t precedingGraphicCharacter_ = {};
     int64_t instructionCounter_ = 0;
+    Metrics metrics_;
     using Batchable = std::variant<char32_t, Sequence, SixelImage>;
     std::vector<Batchable> batchedSequences_;
 
     std::unique_ptr<ParserExtension> hookedParser_;
     std::unique_ptr<SixelImageBuilder> sixelImageBuilder_;
     std::shared_ptr<SixelColorPalette> imageColorPalette_;
+    std::optional<ImageTransfer> imageTransfer_;        // spanning the chunks of an IMGXFER image
     bool usePrivateColorRegisters_ = false;
+    bool sixelProgressive_ = true;
     crispy::Size maxImageSize_;
     int maxImageRegisterCount_;
     RGBAColor backgroundColor_;
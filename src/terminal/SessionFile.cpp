@@ -0,0 +1,637 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/SessionFile.h>
+#include <terminal/Screen.h>
+#include <terminal/logging.h>
+
+#include <crispy/debuglog.h>
+#include <crispy/stdfs.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+using std::max;
+using std::min;
+using std::move;
+using std::nullopt;
+using std::optional;
+using std::runtime_error;
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace terminal {
+
+namespace // {{{ helper
+{
+    constexpr auto Magic = string_view{"CTSESSION"};
+    constexpr char Version = 1;
+    constexpr uint64_t HeaderSize = Magic.size() + 1;
+
+    constexpr char HistoryRecord = 'h';
+    constexpr char StateRecord = 's';
+
+    // The file is rewritten once it exceeds this size and is more than half unused.
+    constexpr uint64_t MinCompactionSize = 4 * 1024 * 1024;
+
+    // Upper bound of a line's column count, beyond which a line is considered malformed.
+    constexpr uint64_t MaxColumnCount = 0xFFFF;
+
+    // Graphics rendition flags for internal use only are not saved, see CellFlags.
+    constexpr uint64_t SavedCellFlags = (1u << 16) - 1;
+
+    constexpr unsigned SavedLineFlags = unsigned(Line::Flags::Wrappable)
+                                      | unsigned(Line::Flags::Wrapped)
+                                      | unsigned(Line::Flags::Marked);
+
+    optional<string> readFile(string const& _path)
+    {
+        auto file = std::ifstream(_path, std::ios::binary);
+        if (!file.good())
+            return nullopt;
+
+        auto contents = string{};
+        file.seekg(0, std::ios::end);
+        contents.resize(static_cast<size_t>(max(std::streamoff{0}, std::streamoff(file.tellg()))));
+        file.seekg(0, std::ios::beg);
+        file.read(contents.data(), static_cast<std::streamsize>(contents.size()));
+        if (!file.good())
+            return nullopt;
+
+        return contents;
+    }
+
+    HyperlinkId hyperlinkOf([[maybe_unused]] Cell const& _cell) noexcept
+    {
+#if defined(LIBTERMINAL_HYPERLINKS)
+        return _cell.hyperlink();
+#else
+        return NoHyperlinkId;
+#endif
+    }
+
+    void writeColor(string& _output, Color _color)
+    {
+        _output += static_cast<char>(_color.type);
+        if (_color.type == ColorType::RGB)
+        {
+            _output += static_cast<char>(_color.rgb.red);
+            _output += static_cast<char>(_color.rgb.green);
+            _output += static_cast<char>(_color.rgb.blue);
+        }
+        else
+            _output += static_cast<char>(_color.index);
+    }
+
+    optional<Color> readColor(string_view& _input)
+    {
+        if (_input.size() < 2 || static_cast<uint8_t>(_input[0]) > static_cast<uint8_t>(ColorType::RGB))
+            return nullopt;
+
+        auto const type = static_cast<ColorType>(_input[0]);
+        if (type != ColorType::RGB)
+        {
+            auto const color = Color{type, static_cast<uint8_t>(_input[1])};
+            _input.remove_prefix(2);
+            return color;
+        }
+
+        if (_input.size() < 4)
+            return nullopt;
+        auto const color = Color{RGBColor{static_cast<uint8_t>(_input[1]),
+                                          static_cast<uint8_t>(_input[2]),
+                                          static_cast<uint8_t>(_input[3])}};
+        _input.remove_prefix(4);
+        return color;
+    }
+} // }}}
+
+namespace session // {{{
+{
+    void writeNumber(string& _output, uint64_t _value)
+    {
+        while (_value >= 0x80)
+        {
+            _output += static_cast<char>((_value & 0x7F) | 0x80);
+            _value >>= 7;
+        }
+        _output += static_cast<char>(_value);
+    }
+
+    void writeString(string& _output, string_view _value)
+    {
+        writeNumber(_output, _value.size());
+        _output += _value;
+    }
+
+    void writeAttributes(string& _output, GraphicsAttributes const& _attributes)
+    {
+        writeColor(_output, _attributes.foregroundColor);
+        writeColor(_output, _attributes.backgroundColor);
+        writeColor(_output, _attributes.underlineColor);
+        writeNumber(_output, static_cast<uint64_t>(_attributes.styles) & SavedCellFlags);
+    }
+
+    void writeLine(string& _output,
+                   Line const& _line,
+                   GraphicsAttributesTable const& _attributes,
+                   HyperlinkTable const* _hyperlinks)
+    {
+        // Reading the cells of a compressed line would keep them unpacked, so a copy is read instead.
+        if (_line.compressed() || _line.trimmedCellCount())
+        {
+            auto copy = Line(_line);
+            copy.buffer();
+            writeLine(_output, copy, _attributes, _hyperlinks);
+            return;
+        }
+
+        auto const cells = _line.cbegin();
+
+        auto cellCount = static_cast<size_t>(_line.size());
+        while (cellCount > 0)
+        {
+            Cell const& cell = cells[static_cast<long>(cellCount - 1)];
+            if (cell.codepointCount() || cell.width() != 1
+                    || cell.attributes() != DefaultGraphicsAttributesId || hyperlinkOf(cell))
+                break;
+            --cellCount;
+        }
+
+        auto hyperlinks = vector<HyperlinkId>{};
+        auto runs = vector<std::pair<size_t, GraphicsAttributesId>>{};
+        for (size_t i = 0; i < cellCount; ++i)
+        {
+            Cell const& cell = cells[static_cast<long>(i)];
+            if (auto const hyperlink = hyperlinkOf(cell); hyperlink && _hyperlinks && _hyperlinks->find(hyperlink)
+                    && std::find(hyperlinks.begin(), hyperlinks.end(), hyperlink) == hyperlinks.end())
+                hyperlinks.push_back(hyperlink);
+            if (!runs.empty() && runs.back().second == cell.attributes())
+                ++runs.back().first;
+            else
+                runs.emplace_back(1, cell.attributes());
+        }
+
+        writeNumber(_output, static_cast<uint64_t>(_line.size()));
+        writeNumber(_output, static_cast<unsigned>(_line.flags()) & SavedLineFlags);
+        writeNumber(_output, cellCount);
+
+        writeNumber(_output, hyperlinks.size());
+        for (HyperlinkId const id: hyperlinks)
+        {
+            auto const* hyperlink = _hyperlinks->find(id);
+            writeString(_output, hyperlink->id);
+            writeString(_output, hyperlink->uri);
+        }
+
+        writeNumber(_output, runs.size());
+        for (auto const& run: runs)
+        {
+            writeNumber(_output, run.first);
+            writeAttributes(_output, _attributes[run.second]);
+        }
+
+        for (size_t i = 0; i < cellCount; ++i)
+        {
+            Cell const& cell = cells[static_cast<long>(i)];
+            auto const codepoints = cell.codepoints();
+            writeNumber(_output, (static_cast<unsigned>(cell.width()) << 4) | static_cast<unsigned>(codepoints.size()));
+            if (!hyperlinks.empty())
+            {
+                auto const hyperlink = std::find(hyperlinks.begin(), hyperlinks.end(), hyperlinkOf(cell));
+                writeNumber(_output, hyperlink != hyperlinks.end()
+                                         ? static_cast<uint64_t>(std::distance(hyperlinks.begin(), hyperlink)) + 1
+                                         : 0);
+            }
+            for (char32_t const codepoint: codepoints)
+                writeNumber(_output, codepoint);
+        }
+    }
+
+    optional<uint64_t> readNumber(string_view& _input)
+    {
+        auto value = uint64_t{0};
+        for (auto shift = 0; shift < 64 && !_input.empty(); shift += 7)
+        {
+            auto const byte = static_cast<uint8_t>(_input.front());
+            _input.remove_prefix(1);
+            value |= uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        return nullopt;
+    }
+
+    optional<string_view> readString(string_view& _input)
+    {
+        auto const size = readNumber(_input);
+        if (!size || *size > _input.size())
+            return nullopt;
+
+        auto const value = _input.substr(0, *size);
+        _input.remove_prefix(*size);
+        return value;
+    }
+
+    optional<GraphicsAttributes> readAttributes(string_view& _input)
+    {
+        auto attributes = GraphicsAttributes{};
+        auto const foregroundColor = readColor(_input);
+        auto const backgroundColor = foregroundColor ? readColor(_input) : nullopt;
+        auto const underlineColor = backgroundColor ? readColor(_input) : nullopt;
+        auto const styles = underlineColor ? readNumber(_input) : nullopt;
+        if (!styles)
+            return nullopt;
+
+        attributes.foregroundColor = *foregroundColor;
+        attributes.backgroundColor = *backgroundColor;
+        attributes.underlineColor = *underlineColor;
+        attributes.styles = static_cast<CellFlags>(*styles & SavedCellFlags);
+        return attributes;
+    }
+
+    optional<Line> readLine(string_view& _input,
+                            GraphicsAttributesTable& _attributes,
+                            [[maybe_unused]] HyperlinkTable* _hyperlinks)
+    {
+        auto const columnCount = readNumber(_input);
+        auto const flags = readNumber(_input);
+        auto const cellCount = readNumber(_input);
+        auto const hyperlinkCount = readNumber(_input);
+        if (!hyperlinkCount || *columnCount > MaxColumnCount || *cellCount > *columnCount)
+            return nullopt;
+
+        auto hyperlinks = vector<HyperlinkId>{};
+        for (uint64_t i = 0; i < *hyperlinkCount; ++i)
+        {
+            auto const id = readString(_input);
+            auto const uri = id ? readString(_input) : nullopt;
+            if (!uri)
+                return nullopt;
+            auto hyperlink = NoHyperlinkId;
+            if (_hyperlinks)
+                hyperlink = _hyperlinks->add(string(*id), string(*uri)).value_or(NoHyperlinkId);
+            hyperlinks.push_back(hyperlink);
+        }
+
+        auto const runCount = readNumber(_input);
+        if (!runCount || *runCount > *cellCount)
+            return nullopt;
+
+        auto runs = vector<std::pair<uint64_t, GraphicsAttributesId>>{};
+        auto runTotal = uint64_t{0};
+        for (uint64_t i = 0; i < *runCount; ++i)
+        {
+            auto const length = readNumber(_input);
+            auto const attributes = length ? readAttributes(_input) : nullopt;
+            if (!attributes)
+                return nullopt;
+            runs.emplace_back(*length, _attributes.intern(*attributes).value_or(DefaultGraphicsAttributesId));
+            runTotal += *length;
+        }
+        if (runTotal != *cellCount)
+            return nullopt;
+
+        auto buffer = Line::Buffer{};
+        buffer.reserve(static_cast<size_t>(*columnCount));
+        for (auto const& run: runs)
+        {
+            for (uint64_t i = 0; i < run.first; ++i)
+            {
+                auto const header = readNumber(_input);
+                if (!header)
+                    return nullopt;
+                auto const hyperlink = !hyperlinks.empty() ? readNumber(_input) : optional{uint64_t{0}};
+                if (!hyperlink || *hyperlink > hyperlinks.size())
+                    return nullopt;
+
+                auto& cell = buffer.emplace_back(Cell{});
+                cell.setAttributes(run.second);
+                for (uint64_t k = 0; k < (*header & 0x0F); ++k)
+                {
+                    auto const codepoint = readNumber(_input);
+                    if (!codepoint || *codepoint > 0x10FFFF)
+                        return nullopt;
+                    if (k == 0)
+                        cell.setCharacter(static_cast<char32_t>(*codepoint));
+                    else
+                        cell.appendCharacter(static_cast<char32_t>(*codepoint));
+                }
+                cell.setWidth(static_cast<int>(min(*header >> 4, uint64_t{0xFF})));
+#if defined(LIBTERMINAL_HYPERLINKS)
+                if (*hyperlink)
+                    cell.setHyperlink(hyperlinks[*hyperlink - 1]);
+#endif
+            }
+        }
+        buffer.resize(static_cast<size_t>(*columnCount));
+
+        return Line(move(buffer), static_cast<Line::Flags>(*flags & SavedLineFlags));
+    }
+} // }}}
+
+// {{{ SessionFile
+SessionFile::SessionFile(string _path) :
+    path_{ move(_path) },
+    file_{ path_, std::ios::binary | std::ios::app }
+{
+    if (!file_.good())
+        throw runtime_error{fmt::format("Could not open session file {}. {}", path_, strerror(errno))};
+
+    auto ec = std::error_code{};
+    auto const size = FileSystem::file_size(path_, ec);
+    size_ = ec ? 0 : static_cast<uint64_t>(size);
+}
+
+bool SessionFile::restore(Screen& _screen)
+{
+    auto const contents = readFile(path_);
+    if (!contents || contents->empty())
+        return false;
+
+    if (contents->size() < HeaderSize || string_view(*contents).substr(0, Magic.size()) != Magic
+            || (*contents)[Magic.size()] != Version)
+    {
+        debuglog(TerminalTag).write("Session file {} has an unknown format and is discarded.", path_);
+        compact();
+        return false;
+    }
+
+    // A truncated last record, e.g. of a terminal that crashed while saving, is dropped.
+    auto input = string_view(*contents).substr(HeaderSize);
+    while (!input.empty())
+    {
+        auto const type = input.front();
+        input.remove_prefix(1);
+        auto payload = session::readString(input);
+        if (!payload)
+            break;
+        auto const payloadOffset = static_cast<uint64_t>(payload->data() - contents->data());
+
+        if (type == HistoryRecord)
+        {
+            auto const dropped = session::readNumber(*payload);
+            auto const kept = dropped ? session::readNumber(*payload) : nullopt;
+            auto const count = kept ? session::readNumber(*payload) : nullopt;
+            if (!count)
+                break;
+
+            lines_.erase(lines_.begin(), lines_.begin() + static_cast<long>(min(*dropped, uint64_t(lines_.size()))));
+            lines_.resize(static_cast<size_t>(min(*kept, uint64_t(lines_.size()))));
+
+            for (uint64_t i = 0; i < *count; ++i)
+            {
+                auto const line = session::readString(*payload);
+                if (!line)
+                    break;
+                lines_.push_back(Extent{static_cast<uint64_t>(line->data() - contents->data()),
+                                        static_cast<uint32_t>(line->size())});
+            }
+        }
+        else if (type == StateRecord)
+            state_ = Extent{payloadOffset, static_cast<uint32_t>(payload->size())};
+        else
+            break;
+    }
+
+    // Lines beyond the screen's history limit are not restored, and not kept either.
+    if (auto const maxLines = _screen.maxHistoryLineCount(); maxLines.has_value())
+        while (lines_.size() > static_cast<size_t>(max(*maxLines, 0)))
+            lines_.pop_front();
+
+    auto attributes = GraphicsAttributesTable{};
+    auto history = vector<Line>{};
+    history.reserve(lines_.size());
+    for (Extent const& extent: lines_)
+    {
+        auto data = string_view(*contents).substr(extent.offset, extent.size);
+#if defined(LIBTERMINAL_HYPERLINKS)
+        auto line = session::readLine(data, attributes, &_screen.hyperlinks());
+#else
+        auto line = session::readLine(data, attributes, nullptr);
+#endif
+        if (!line)
+            break;
+        history.emplace_back(move(*line));
+    }
+    lines_.resize(history.size());
+
+    auto const historySize = history.size();
+    auto const restored = state_.has_value()
+        && _screen.restoreState(string_view(*contents).substr(state_->offset, state_->size),
+                                move(attributes),
+                                move(history));
+    if (!restored)
+    {
+        lines_.clear();
+        state_.reset();
+    }
+
+    debuglog(TerminalTag).write("{} session from {} with {} history lines.",
+                                restored ? "Restored" : "Could not restore",
+                                path_,
+                                restored ? historySize : 0);
+
+    // The file is read back from disk, so it has to be written out completely first.
+    file_.flush();
+    compact();
+    return restored;
+}
+
+string SessionFile::encode(Screen& _screen, optional<int> _maxLines)
+{
+    auto records = string{};
+    auto const base = size_ ? size_ : HeaderSize;
+    auto& grid = _screen.primaryGrid();
+
+    // Lines to be reflowed are saved after they've been reflowed, rather than twice.
+    if (grid.pendingReflowLineCount() == 0)
+    {
+        // The most recent history line may still be continued, see Grid::compressHistory(),
+        // unless saving everything, e.g. as the terminal is closing.
+        auto const saved = grid.savedHistory();
+        auto const lineCount = _maxLines.has_value() ? max(saved.count, grid.historyLineCount() - 1)
+                                                     : grid.historyLineCount();
+        auto const first = saved.count;
+        auto const last = _maxLines.has_value() ? min(lineCount, first + *_maxLines) : lineCount;
+
+        if (saved.dropped || static_cast<size_t>(saved.count) != lines_.size() || last > first)
+        {
+            auto payload = string{};
+            session::writeNumber(payload, static_cast<uint64_t>(saved.dropped));
+            session::writeNumber(payload, static_cast<uint64_t>(saved.count));
+            session::writeNumber(payload, static_cast<uint64_t>(last - first));
+
+            auto added = vector<Extent>{};
+            auto line = string{};
+            for (Line const& historyLine: grid.lines(first, last))
+            {
+                line.clear();
+#if defined(LIBTERMINAL_HYPERLINKS)
+                session::writeLine(line, historyLine, grid.attributesTable(), &_screen.hyperlinks());
+#else
+                session::writeLine(line, historyLine, grid.attributesTable(), nullptr);
+#endif
+                session::writeNumber(payload, line.size());
+                added.push_back(Extent{payload.size(), static_cast<uint32_t>(line.size())});
+                payload += line;
+            }
+
+            records += HistoryRecord;
+            session::writeNumber(records, payload.size());
+            auto const payloadOffset = base + records.size();
+            records += payload;
+
+            for (int i = 0; i < saved.dropped && !lines_.empty(); ++i)
+            {
+                liveSize_ -= lines_.front().size;
+                lines_.pop_front();
+            }
+            while (lines_.size() > static_cast<size_t>(saved.count))
+            {
+                liveSize_ -= lines_.back().size;
+                lines_.pop_back();
+            }
+            for (Extent const& extent: added)
+            {
+                lines_.push_back(Extent{payloadOffset + extent.offset, extent.size});
+                liveSize_ += extent.size;
+            }
+
+            grid.markHistorySaved(last);
+        }
+    }
+
+    auto state = string{};
+    _screen.saveState(state);
+    if (state != lastState_)
+    {
+        records += StateRecord;
+        session::writeNumber(records, state.size());
+        if (state_)
+            liveSize_ -= state_->size;
+        state_ = Extent{base + records.size(), static_cast<uint32_t>(state.size())};
+        liveSize_ += state.size();
+        records += state;
+        lastState_ = move(state);
+    }
+
+    return records;
+}
+
+void SessionFile::append(string_view _records)
+{
+    if (_records.empty())
+        return;
+
+    if (size_ == 0)
+    {
+        file_.write(Magic.data(), static_cast<std::streamsize>(Magic.size()));
+        file_.put(Version);
+        size_ = HeaderSize;
+    }
+
+    file_.write(_records.data(), static_cast<std::streamsize>(_records.size()));
+    file_.flush();
+    if (!file_.good())
+    {
+        debuglog(TerminalTag).write("Could not write session file {}. {}", path_, strerror(errno));
+        file_.clear();
+    }
+    size_ += _records.size();
+
+    if (size_ > MinCompactionSize && size_ > 2 * liveSize_)
+        compact();
+}
+
+void SessionFile::compact()
+{
+    file_.flush();
+    auto const contents = size_ ? readFile(path_) : optional{string{}};
+    if (!contents || contents->size() < size_)
+    {
+        debuglog(TerminalTag).write("Could not read session file {}. {}", path_, strerror(errno));
+        return;
+    }
+
+    auto data = string{};
+    data.reserve(static_cast<size_t>(HeaderSize + liveSize_ + 16 * lines_.size()));
+    data += Magic;
+    data += Version;
+
+    auto payload = string{};
+    session::writeNumber(payload, 0);
+    session::writeNumber(payload, 0);
+    session::writeNumber(payload, lines_.size());
+    auto lines = std::deque<Extent>{};
+    for (Extent const& extent: lines_)
+    {
+        session::writeNumber(payload, extent.size);
+        lines.push_back(Extent{payload.size(), extent.size});
+        payload.append(*contents, static_cast<size_t>(extent.offset), extent.size);
+    }
+    data += HistoryRecord;
+    session::writeNumber(data, payload.size());
+    for (Extent& extent: lines)
+        extent.offset += data.size();
+    data += payload;
+
+    auto state = optional<Extent>{};
+    if (state_)
+    {
+        data += StateRecord;
+        session::writeNumber(data, state_->size);
+        state = Extent{data.size(), state_->size};
+        data.append(*contents, static_cast<size_t>(state_->offset), state_->size);
+    }
+
+    // The new contents are written aside first, so that the file is complete at any time.
+    auto const tempPath = path_ + ".tmp";
+    {
+        auto output = std::ofstream(tempPath, std::ios::binary | std::ios::trunc);
+        output.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!output.good())
+        {
+            debuglog(TerminalTag).write("Could not write session file {}. {}", tempPath, strerror(errno));
+            return;
+        }
+    }
+
+    file_.close();
+    auto ec = std::error_code{};
+    FileSystem::rename(tempPath, path_, ec);
+    if (ec)
+        debuglog(TerminalTag).write("Could not replace session file {}. {}", path_, ec.message());
+    file_.open(path_, std::ios::binary | std::ios::app);
+    if (ec)
+        return;
+
+    size_ = data.size();
+    lines_ = move(lines);
+    state_ = state;
+    liveSize_ = 0;
+    for (Extent const& extent: lines_)
+        liveSize_ += extent.size;
+    if (state_)
+        liveSize_ += state_->size;
+}
+// }}}
+
+} // end namespace
@@ -0,0 +1,128 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/Grid.h>
+#include <terminal/Hyperlink.h>
+
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace terminal {
+
+class Screen;
+
+/// Building blocks of the session file format, see SessionFile.
+///
+/// All integers are LEB128-encoded, and strings are prefixed with their size.
+namespace session
+{
+    void writeNumber(std::string& _output, uint64_t _value);
+    void writeString(std::string& _output, std::string_view _value);
+    void writeAttributes(std::string& _output, GraphicsAttributes const& _attributes);
+
+    /// Appends @p _line, whose cells reference the given tables (@p _hyperlinks may be null).
+    ///
+    /// A line is encoded as its column count, its flags, the hyperlinks referenced by its cells,
+    /// the runs of graphics renditions, and finally the cells up to the last non-blank one,
+    /// each one being its width and codepoint count (4 bits each), its hyperlink (if the line has any)
+    /// and its codepoints. Image fragments are stored as blank cells.
+    void writeLine(std::string& _output,
+                   Line const& _line,
+                   GraphicsAttributesTable const& _attributes,
+                   HyperlinkTable const* _hyperlinks);
+
+    // The readers consume what they have read from the front of @p _input,
+    // and return std::nullopt if the input is malformed or truncated.
+    std::optional<uint64_t> readNumber(std::string_view& _input);
+    std::optional<std::string_view> readString(std::string_view& _input);
+    std::optional<GraphicsAttributes> readAttributes(std::string_view& _input);
+
+    /// Reads a line written by writeLine(), interning its graphics renditions and hyperlinks
+    /// into the given tables. Renditions and hyperlinks not fitting into the tables anymore
+    /// are dropped, as are all hyperlinks if @p _hyperlinks is null.
+    std::optional<Line> readLine(std::string_view& _input,
+                                 GraphicsAttributesTable& _attributes,
+                                 HyperlinkTable* _hyperlinks);
+}
+
+/// File persisting a screen's state and history across terminal restarts.
+///
+/// The file starts with the magic "CTSESSION" plus a version byte, followed by records,
+/// each one being a type byte, the payload size and the payload:
+///  - 'h' (history): number of previously saved lines dropped from the top, number of
+///    the remaining ones kept (dropping any others from the bottom), number of lines added,
+///    and the lines added (see session::writeLine()), each one prefixed with its size.
+///  - 's' (state): the screen's state except for the history, see Screen::saveState().
+///    Only the most recent state is used.
+///
+/// History lines are written once, when they have scrolled into the history, so saving is
+/// incremental. The file is rewritten once most of it is not used anymore.
+///
+/// Restoring reads the file in one go and decodes no more history lines than the screen keeps.
+class SessionFile {
+  public:
+    /// Opens the session file at the given path, creating it if it does not exist yet.
+    ///
+    /// Throws std::runtime_error if the file cannot be written.
+    explicit SessionFile(std::string _path);
+
+    std::string const& path() const noexcept { return path_; }
+
+    /// Restores the screen's state and history saved in this file, if any,
+    /// and rewrites the file to contain no more than that.
+    ///
+    /// Must be invoked before anything is saved.
+    ///
+    /// @returns whether anything has been restored.
+    bool restore(Screen& _screen);
+
+    /// Encodes the changes of @p _screen since the previous invocation, with at most @p _maxLines
+    /// history lines added, to be passed to append(). The most recent history line is only
+    /// saved without a limit, as it may still be continued otherwise.
+    ///
+    /// This must be invoked with the screen locked, whereas append() does not need to.
+    std::string encode(Screen& _screen, std::optional<int> _maxLines);
+
+    /// Appends the records encoded by encode(), rewriting the file if mostly unused.
+    void append(std::string_view _records);
+
+    /// Number of bytes written to the file.
+    uint64_t size() const noexcept { return size_; }
+
+  private:
+    /// Location of a line or state within the file.
+    struct Extent {
+        uint64_t offset;
+        uint32_t size;
+    };
+
+    /// Rewrites the file, keeping the saved history lines and the most recent state only.
+    void compact();
+
+    std::string path_;
+    std::ofstream file_;
+    uint64_t size_ = 0;
+
+    std::deque<Extent> lines_; //!< saved history lines, oldest first
+    std::optional<Extent> state_;
+    uint64_t liveSize_ = 0;    //!< bytes of lines_ and state_
+    std::string lastState_;
+};
+
+} // end namespace
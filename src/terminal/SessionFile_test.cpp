@@ -0,0 +1,149 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/SessionFile.h>
+#include <terminal/Screen.h>
+
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <string>
+
+using crispy::Size;
+using namespace terminal;
+using namespace std;
+
+namespace
+{
+    class MockScreen : public MockScreenEvents,
+                       public Screen {
+      public:
+        explicit MockScreen(Size const& _size) :
+            Screen{
+                _size,
+                *this,
+                false,
+                false,
+                100
+            }
+        {
+            grid().setReflowOnResize(false);
+        }
+    };
+
+    void save(SessionFile& _file, Screen& _screen, optional<int> _maxLines = nullopt)
+    {
+        _file.append(_file.encode(_screen, _maxLines));
+    }
+}
+
+TEST_CASE("SessionFile.roundtrip", "[session]")
+{
+    auto const path = string{"SessionFile_test.session"};
+    remove(path.c_str());
+
+    auto screen = MockScreen{Size{5, 3}};
+    {
+        auto file = SessionFile{path};
+        CHECK_FALSE(file.restore(screen));
+
+        screen.write("\033]2;title\033\\\033[1;31mone\r\ntwo\r\n");
+        save(file, screen, 1);
+        screen.write("three\r\nfour\r\n\033[42mfive");
+        save(file, screen);
+    }
+
+    auto restored = MockScreen{Size{5, 3}};
+    auto file = SessionFile{path};
+    REQUIRE(file.restore(restored));
+
+    CHECK(restored.renderText() == screen.renderText());
+    REQUIRE(restored.historyLineCount() == screen.historyLineCount());
+    for (int i = 1; i <= screen.historyLineCount(); ++i)
+        CHECK(restored.renderHistoryTextLine(i) == screen.renderHistoryTextLine(i));
+    CHECK(restored.cursor().position == screen.cursor().position);
+    CHECK(restored.cursor().graphicsRendition == screen.cursor().graphicsRendition);
+    CHECK(restored.windowTitle() == "title");
+
+    remove(path.c_str());
+}
+
+TEST_CASE("SessionFile.drop_history", "[session]")
+{
+    auto const path = string{"SessionFile_test.session"};
+    remove(path.c_str());
+
+    auto screen = MockScreen{Size{5, 2}};
+    {
+        auto file = SessionFile{path};
+        screen.write("1\r\n2\r\n3\r\n4\r\n5");
+        save(file, screen);
+
+        // Cleared history lines are dropped from the file as well.
+        screen.clearScrollbackBuffer();
+        screen.write("\r\n6\r\n7");
+        save(file, screen);
+    }
+
+    auto restored = MockScreen{Size{5, 2}};
+    auto file = SessionFile{path};
+    REQUIRE(file.restore(restored));
+    REQUIRE(restored.historyLineCount() == screen.historyLineCount());
+    for (int i = 1; i <= screen.historyLineCount(); ++i)
+        CHECK(restored.renderHistoryTextLine(i) == screen.renderHistoryTextLine(i));
+    CHECK(restored.renderText() == screen.renderText());
+
+    remove(path.c_str());
+}
+
+TEST_CASE("SessionFile.truncated", "[session]")
+{
+    auto const path = string{"SessionFile_test.session"};
+    remove(path.c_str());
+
+    auto screen = MockScreen{Size{5, 2}};
+    auto size = uint64_t{0};
+    {
+        auto file = SessionFile{path};
+        screen.write("1\r\n2\r\n3");
+        save(file, screen);
+        size = file.size();
+        screen.write("\r\n4");
+        save(file, screen);
+    }
+
+    // A partially written record, e.g. of a crashed terminal, is ignored.
+    {
+        auto contents = string{};
+        if (auto* input = fopen(path.c_str(), "rb"))
+        {
+            char buffer[4096];
+            while (auto const n = fread(buffer, 1, sizeof(buffer), input))
+                contents.append(buffer, n);
+            fclose(input);
+        }
+        REQUIRE(contents.size() > size + 2);
+        auto* output = fopen(path.c_str(), "wb");
+        REQUIRE(output);
+        fwrite(contents.data(), 1, static_cast<size_t>(size + 2), output);
+        fclose(output);
+    }
+
+    auto restored = MockScreen{Size{5, 2}};
+    auto file = SessionFile{path};
+    REQUIRE(file.restore(restored));
+    CHECK(restored.renderTextLine(1) == "2    ");
+    CHECK(restored.renderTextLine(2) == "3    ");
+
+    remove(path.c_str());
+}
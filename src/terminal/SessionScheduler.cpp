@@ -0,0 +1,86 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/SessionScheduler.h>
+
+#include <algorithm>
+
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+
+namespace terminal {
+
+SessionScheduler& SessionScheduler::shared()
+{
+    static SessionScheduler scheduler;
+    return scheduler;
+}
+
+void SessionScheduler::setSettings(Settings const& _settings) noexcept
+{
+    enabled_ = _settings.enabled;
+    timeSlice_ = duration_cast<clock::duration>(std::max(_settings.timeSlice, milliseconds(1))).count();
+    backgroundShare_ = std::clamp(_settings.backgroundShare, 1u, 100u);
+    backgroundRefreshRate_ = std::max(_settings.backgroundRefreshRate, 1.0);
+}
+
+SessionScheduler::Settings SessionScheduler::settings() const noexcept
+{
+    auto settings = Settings{};
+    settings.enabled = enabled_;
+    settings.timeSlice = duration_cast<milliseconds>(clock::duration(timeSlice_.load()));
+    settings.backgroundShare = backgroundShare_;
+    settings.backgroundRefreshRate = backgroundRefreshRate_;
+    return settings;
+}
+
+void SessionScheduler::foregroundActive(clock::time_point _now) noexcept
+{
+    foregroundActiveTime_.store(_now.time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+bool SessionScheduler::foregroundBusy(clock::time_point _now) const noexcept
+{
+    auto const lastActive = foregroundActiveTime_.load(std::memory_order_relaxed);
+    return lastActive != 0 && _now.time_since_epoch().count() - lastActive < 2 * timeSlice_.load();
+}
+
+SessionScheduler::clock::duration SessionScheduler::charge(Budget& _budget,
+                                                           clock::duration _work,
+                                                           clock::time_point _now) const noexcept
+{
+    if (!enabled_)
+        return {};
+
+    auto const timeSlice = clock::duration(timeSlice_.load());
+    if (_now - _budget.sliceStart >= timeSlice)
+    {
+        _budget.sliceStart = _now;
+        _budget.used = {};
+    }
+    _budget.used += _work;
+
+    if (_budget.used < timeSlice * backgroundShare_.load() / 100 || !foregroundBusy(_now))
+        return {};
+
+    return _budget.sliceStart + timeSlice - _now;
+}
+
+SessionScheduler::clock::duration SessionScheduler::backgroundRefreshInterval() const noexcept
+{
+    if (!enabled_)
+        return {};
+    return duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / backgroundRefreshRate_.load()));
+}
+
+} // end namespace
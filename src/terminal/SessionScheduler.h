@@ -0,0 +1,87 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+namespace terminal {
+
+/// Shares the CPU among the terminals of a process in favor of the focused one,
+/// so that terminals flooded with output in the background do not slow down its
+/// parsing and rendering, and thus its input latency.
+///
+/// Time is divided into slices. While the focused terminal is busy, i.e. it parsed output
+/// within the last two slices, each background terminal may only parse for its share of a slice
+/// and then waits for the next one. Whenever the focused terminal is idle, background terminals
+/// parse without limit.
+///
+/// Only terminals with an input pipeline are held back, as their PTY keeps being read
+/// meanwhile, so that applications never block on writing their output unless producing
+/// more than their share allows for long enough to fill up the pipeline's buffer.
+///
+/// Background terminals also notify about screen updates at a reduced refresh rate,
+/// saving on rendering work.
+class SessionScheduler {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    struct Settings {
+        bool enabled = true;
+        /// Length of a time slice.
+        std::chrono::milliseconds timeSlice{10};
+        /// Percentage of each time slice a background terminal may parse for, while the focused one is busy.
+        unsigned backgroundShare = 25;
+        /// Number of screen updates per second background terminals notify about at most.
+        double backgroundRefreshRate = 10.0;
+    };
+
+    /// Parsing time accounted to a single background terminal within the current time slice.
+    struct Budget {
+        clock::time_point sliceStart{};
+        clock::duration used{};
+    };
+
+    /// @returns the scheduler shared by all terminals of this process.
+    static SessionScheduler& shared();
+
+    /// May be invoked by any thread, taking effect with the next time slice.
+    void setSettings(Settings const& _settings) noexcept;
+    Settings settings() const noexcept;
+
+    /// Records that the focused terminal did work at @p _now.
+    void foregroundActive(clock::time_point _now) noexcept;
+
+    /// @returns whether the focused terminal did work within the last two time slices.
+    bool foregroundBusy(clock::time_point _now) const noexcept;
+
+    /// Accounts @p _work done by a background terminal at @p _now to its @p _budget.
+    ///
+    /// @returns how long the terminal must wait before doing more work, zero if it need not wait.
+    clock::duration charge(Budget& _budget, clock::duration _work, clock::time_point _now) const noexcept;
+
+    /// @returns the minimum time between two screen update notifications of a background terminal.
+    clock::duration backgroundRefreshInterval() const noexcept;
+
+  private:
+    std::atomic<bool> enabled_ = true;
+    std::atomic<clock::rep> timeSlice_ = std::chrono::duration_cast<clock::duration>(Settings{}.timeSlice).count();
+    std::atomic<unsigned> backgroundShare_ = Settings{}.backgroundShare;
+    std::atomic<double> backgroundRefreshRate_ = Settings{}.backgroundRefreshRate;
+
+    // Time (since epoch) the focused terminal did work the last time, or zero.
+    std::atomic<clock::rep> foregroundActiveTime_ = 0;
+};
+
+} // end namespace
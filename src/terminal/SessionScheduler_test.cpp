@@ -0,0 +1,85 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/SessionScheduler.h>
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+
+using namespace terminal;
+using namespace std::chrono_literals;
+
+namespace
+{
+    SessionScheduler::Settings testSettings()
+    {
+        auto settings = SessionScheduler::Settings{};
+        settings.timeSlice = 10ms;
+        settings.backgroundShare = 25;
+        settings.backgroundRefreshRate = 10.0;
+        return settings;
+    }
+}
+
+TEST_CASE("SessionScheduler.unlimitedWhileForegroundIdle")
+{
+    auto scheduler = SessionScheduler{};
+    scheduler.setSettings(testSettings());
+    auto const start = SessionScheduler::clock::now();
+
+    auto budget = SessionScheduler::Budget{};
+    CHECK(!scheduler.foregroundBusy(start));
+    CHECK(scheduler.charge(budget, 9ms, start).count() == 0);
+}
+
+TEST_CASE("SessionScheduler.limitedWhileForegroundBusy")
+{
+    auto scheduler = SessionScheduler{};
+    scheduler.setSettings(testSettings());
+    auto const start = SessionScheduler::clock::now();
+    scheduler.foregroundActive(start);
+    CHECK(scheduler.foregroundBusy(start + 19ms));
+    CHECK(!scheduler.foregroundBusy(start + 20ms));
+
+    auto budget = SessionScheduler::Budget{};
+    CHECK(scheduler.charge(budget, 1ms, start).count() == 0);
+    CHECK(scheduler.charge(budget, 1ms, start + 1ms).count() == 0);
+
+    // The share of 2.5ms per slice is used up, having to wait for the next slice.
+    CHECK(scheduler.charge(budget, 1ms, start + 3ms) == 7ms);
+
+    // The next slice starts with a fresh budget.
+    CHECK(scheduler.charge(budget, 1ms, start + 10ms).count() == 0);
+}
+
+TEST_CASE("SessionScheduler.disabled")
+{
+    auto scheduler = SessionScheduler{};
+    auto settings = testSettings();
+    settings.enabled = false;
+    scheduler.setSettings(settings);
+    auto const start = SessionScheduler::clock::now();
+    scheduler.foregroundActive(start);
+
+    auto budget = SessionScheduler::Budget{};
+    CHECK(scheduler.charge(budget, 10ms, start).count() == 0);
+    CHECK(scheduler.backgroundRefreshInterval().count() == 0);
+}
+
+TEST_CASE("SessionScheduler.backgroundRefreshInterval")
+{
+    auto scheduler = SessionScheduler{};
+    scheduler.setSettings(testSettings());
+    CHECK(scheduler.backgroundRefreshInterval() == 100ms);
+}
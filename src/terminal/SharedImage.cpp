@@ -0,0 +1,163 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/SharedImage.h>
+#include <terminal/logging.h>
+
+#include <crispy/debuglog.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using std::make_shared;
+using std::nullopt;
+using std::optional;
+using std::shared_ptr;
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace terminal {
+
+#if !defined(_WIN32)
+namespace // {{{ helper
+{
+    bool isNumber(string_view _text)
+    {
+        return !_text.empty() && std::all_of(_text.begin(), _text.end(), [](char ch) { return '0' <= ch && ch <= '9'; });
+    }
+
+    /// @returns whether the given name refers to a POSIX shared memory object.
+    bool isSharedMemoryName(string_view _name)
+    {
+        return _name.size() > 1 && _name.size() <= 255 && _name[0] == '/'
+            && _name.find('/', 1) == _name.npos;
+    }
+
+    /// @returns whether the given name refers to a file descriptor of another process, i.e. "/proc/<pid>/fd/<fd>".
+    bool isProcessFileName(string_view _name)
+    {
+        auto constexpr Prefix = string_view("/proc/");
+        if (_name.substr(0, Prefix.size()) != Prefix)
+            return false;
+        _name.remove_prefix(Prefix.size());
+
+        auto const pidEnd = _name.find('/');
+        if (pidEnd == _name.npos || !isNumber(_name.substr(0, pidEnd)))
+            return false;
+        _name.remove_prefix(pidEnd);
+
+        auto constexpr Infix = string_view("/fd/");
+        return _name.substr(0, Infix.size()) == Infix && isNumber(_name.substr(Infix.size()));
+    }
+
+    /// Opens the given memfd of another process, refusing to open anything but a memfd.
+    int openMemfd(string const& _name)
+    {
+        auto target = vector<char>(256);
+        auto const n = readlink(_name.c_str(), target.data(), target.size());
+        if (n < 0 || string_view(target.data(), static_cast<size_t>(n)).substr(0, 7) != "/memfd:")
+            return -1;
+
+        return open(_name.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+
+    /// @returns whether the given file can be mapped without risking it to be truncated meanwhile.
+    bool sealedAgainstShrinking([[maybe_unused]] int _fd)
+    {
+#if defined(F_GET_SEALS) && defined(F_SEAL_SHRINK)
+        auto const seals = fcntl(_fd, F_GET_SEALS);
+        return seals >= 0 && (seals & F_SEAL_SHRINK) != 0;
+#else
+        return false;
+#endif
+    }
+
+    optional<SharedImagePixels> mapPixels(int _fd, size_t _size)
+    {
+        void* data = mmap(nullptr, _size, PROT_READ, MAP_SHARED, _fd, 0);
+        if (data == MAP_FAILED)
+            return nullopt;
+
+        auto storage = shared_ptr<void const>(data, [_size](void const* _data) {
+            munmap(const_cast<void*>(_data), _size);
+        });
+        return SharedImagePixels{move(storage), crispy::span<uint8_t const>(static_cast<uint8_t const*>(data), _size)};
+    }
+
+    optional<SharedImagePixels> readPixels(int _fd, size_t _size)
+    {
+        auto data = make_shared<vector<uint8_t>>(_size);
+        for (size_t offset = 0; offset < _size; )
+        {
+            auto const n = pread(_fd, data->data() + offset, _size - offset, static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return nullopt;
+            offset += static_cast<size_t>(n);
+        }
+
+        auto const pixels = crispy::span<uint8_t const>(data->data(), _size);
+        return SharedImagePixels{move(data), pixels};
+    }
+} // }}}
+
+optional<SharedImagePixels> loadSharedImage(string const& _name, size_t _size)
+{
+    int fd = -1;
+    if (isSharedMemoryName(_name))
+        fd = shm_open(_name.c_str(), O_RDONLY, 0);
+    else if (isProcessFileName(_name))
+        fd = openMemfd(_name);
+    else
+    {
+        debuglog(TerminalTag).write("Refusing to load shared image from \"{}\".", _name);
+        return nullopt;
+    }
+
+    if (fd < 0)
+    {
+        debuglog(TerminalTag).write("Could not open shared image \"{}\". {}", _name, strerror(errno));
+        return nullopt;
+    }
+
+    optional<SharedImagePixels> result;
+    struct stat st{};
+    if (_size == 0 || fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < _size)
+        debuglog(TerminalTag).write("Shared image \"{}\" is smaller than {} bytes.", _name, _size);
+    else if (sealedAgainstShrinking(fd))
+        result = mapPixels(fd, _size);
+    else
+        result = readPixels(fd, _size);
+
+    close(fd);
+    return result;
+}
+#else
+optional<SharedImagePixels> loadSharedImage(string const& /*_name*/, size_t /*_size*/)
+{
+    return nullopt;
+}
+#endif
+
+} // end namespace
@@ -0,0 +1,43 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <crispy/span.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace terminal {
+
+/// Pixels of an image handed over by a local application in shared memory.
+struct SharedImagePixels {
+    std::shared_ptr<void const> storage;    //!< Keeps the pixels alive, e.g. by keeping the memory mapped.
+    crispy::span<uint8_t const> pixels;
+};
+
+/// Loads @p _size bytes of pixels from the shared memory object of the given name.
+///
+/// The name is either that of a POSIX shared memory object ("/name"), or the file descriptor
+/// of a memfd within the application ("/proc/<pid>/fd/<fd>", Linux only).
+///
+/// A memfd sealed against shrinking is mapped without copying its pixels, so the application
+/// must not modify them anymore. Any other memory could be truncated while being mapped,
+/// which would crash the terminal, so it is read into a copy instead.
+///
+/// @returns the pixels or std::nullopt if the object could not be opened or is too small.
+std::optional<SharedImagePixels> loadSharedImage(std::string const& _name, size_t _size);
+
+} // end namespace
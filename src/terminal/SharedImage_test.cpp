@@ -0,0 +1,95 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/SharedImage.h>
+
+#include <catch2/catch.hpp>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+
+using terminal::loadSharedImage;
+
+namespace
+{
+    vector<uint8_t> makePixels(size_t _size)
+    {
+        auto pixels = vector<uint8_t>(_size);
+        for (size_t i = 0; i < _size; ++i)
+            pixels[i] = static_cast<uint8_t>(i * 7);
+        return pixels;
+    }
+
+    bool writeAll(int _fd, vector<uint8_t> const& _data)
+    {
+        return write(_fd, _data.data(), _data.size()) == static_cast<ssize_t>(_data.size());
+    }
+}
+
+TEST_CASE("SharedImage.posixSharedMemory", "[image]")
+{
+    auto const name = fmt::format("/contour-test-{}", getpid());
+    auto const fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    REQUIRE(fd >= 0);
+    auto const pixels = makePixels(4 * 3 * 2);
+    REQUIRE(writeAll(fd, pixels));
+    close(fd);
+
+    auto const image = loadSharedImage(name, pixels.size());
+    auto const tooLarge = loadSharedImage(name, pixels.size() + 1);
+    shm_unlink(name.c_str());
+
+    REQUIRE(image.has_value());
+    CHECK(image->storage != nullptr);
+    CHECK(std::equal(image->pixels.begin(), image->pixels.end(), pixels.begin(), pixels.end()));
+    CHECK_FALSE(tooLarge.has_value());
+}
+
+TEST_CASE("SharedImage.invalidNames", "[image]")
+{
+    CHECK_FALSE(loadSharedImage("", 4).has_value());
+    CHECK_FALSE(loadSharedImage("/", 4).has_value());
+    CHECK_FALSE(loadSharedImage("/etc/passwd", 4).has_value());
+    CHECK_FALSE(loadSharedImage("relative", 4).has_value());
+    CHECK_FALSE(loadSharedImage("/proc/self/fd/0", 4).has_value());
+    CHECK_FALSE(loadSharedImage("/proc/1/fd/../../self/environ", 4).has_value());
+    CHECK_FALSE(loadSharedImage("/contour-test-does-not-exist", 4).has_value());
+}
+
+#if defined(__linux__) && defined(MFD_ALLOW_SEALING)
+TEST_CASE("SharedImage.sealedMemfd", "[image]")
+{
+    auto const fd = memfd_create("contour-test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    REQUIRE(fd >= 0);
+    auto const pixels = makePixels(4 * 5 * 5);
+    REQUIRE(writeAll(fd, pixels));
+    REQUIRE(fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_WRITE) == 0);
+
+    auto const image = loadSharedImage(fmt::format("/proc/{}/fd/{}", getpid(), fd), pixels.size());
+    close(fd);
+
+    // The pixels stay mapped after the application closed its file descriptor.
+    REQUIRE(image.has_value());
+    CHECK(std::equal(image->pixels.begin(), image->pixels.end(), pixels.begin(), pixels.end()));
+}
+#endif
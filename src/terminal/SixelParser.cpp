@@ -14,13 +14,17 @@
 #include <terminal/SixelParser.h>
 #include <terminal/Coordinate.h>
 
+#include <crispy/thread_pool.h>
+
 #include <algorithm>
+#include <cstring>
 
 using crispy::Size;
 using std::clamp;
 using std::fill;
 using std::max;
 using std::min;
+using std::move;
 using std::vector;
 
 namespace terminal {
@@ -138,9 +142,7 @@ void SixelParser::parse(char32_t _value)
                 paramShiftAndAddDigit(toDigit(_value));
             else if (isSixel(_value))
             {
-                auto const sixel = toSixel(_value);
-                for (int i = 0; i < params_[0]; ++i)
-                    events_.render(sixel);
+                events_.render(toSixel(_value), params_[0]);
                 transitionTo(State::Ground);
             }
             else
@@ -211,6 +213,8 @@ void SixelParser::done()
 {
     transitionTo(State::Ground); // this also ensures current state's leave action is invoked
 
+    events_.done();
+
     if (finalizer_)
         finalizer_();
 }
@@ -319,6 +323,7 @@ SixelImageBuilder::SixelImageBuilder(Size const& _maxSize,
     colors_{ std::move(_colorPalette) },
     size_{ _maxSize },
     buffer_(size_.width * size_.height * 4),
+    backgroundColor_{ _backgroundColor },
     sixelCursor_{ 0, 0 },
     currentColor_{0},
     aspectRatio_{ _aspectVertical, _aspectHorizontal }
@@ -330,8 +335,8 @@ void SixelImageBuilder::clear(RGBAColor _fillColor)
 {
     sixelCursor_ = {0, 0};
 
-    auto p = &buffer_[0];
-    for (int i = 0; i < size_.width * size_.height; ++i)
+    auto p = buffer_.data();
+    for (size_t i = 0; i < buffer_.size() / 4; ++i)
     {
         *p++ = _fillColor.red();
         *p++ = _fillColor.green();
@@ -340,8 +345,108 @@ void SixelImageBuilder::clear(RGBAColor _fillColor)
     }
 }
 
+void SixelImageBuilder::setProgressive(int _stripHeight, OnStrip _onStrip)
+{
+    stripHeight_ = max(_stripHeight, 1);
+    onStrip_ = move(_onStrip);
+    resizeProgressiveBuffer();
+}
+
+int SixelImageBuilder::bufferHeight() const noexcept
+{
+    return size_.width ? static_cast<int>(buffer_.size() / (size_.width * 4)) : 0;
+}
+
+void SixelImageBuilder::resizeProgressiveBuffer()
+{
+    // Enough to hold the rows not yet handed out, plus the sixel band currently being painted.
+    auto const height = clamp(size_.height - bufferTop_, 0, stripHeight_ + 6);
+    buffer_.resize(size_.width * height * 4);
+    auto const sixelCursor = sixelCursor_;
+    clear(backgroundColor_);
+    sixelCursor_ = sixelCursor;
+}
+
+void SixelImageBuilder::commitRows(int _rowCount, bool _last)
+{
+    rasterizeBands();
+
+    auto const rowSize = size_.width * 4;
+    auto const heldRows = min(_rowCount, bufferHeight());
+
+    auto strip = Buffer(buffer_.begin(), buffer_.begin() + heldRows * rowSize);
+    strip.reserve(_rowCount * rowSize);
+    for (int i = heldRows * size_.width; i < _rowCount * size_.width; ++i)
+    {
+        strip.push_back(backgroundColor_.red());
+        strip.push_back(backgroundColor_.green());
+        strip.push_back(backgroundColor_.blue());
+        strip.push_back(backgroundColor_.alpha());
+    }
+
+    // Move the rows still being painted to the front and reset the rows that became free.
+    auto const p = std::copy(buffer_.begin() + heldRows * rowSize, buffer_.end(), buffer_.begin());
+    for (auto i = p; i != buffer_.end(); i += 4)
+    {
+        i[0] = backgroundColor_.red();
+        i[1] = backgroundColor_.green();
+        i[2] = backgroundColor_.blue();
+        i[3] = backgroundColor_.alpha();
+    }
+
+    auto const top = bufferTop_;
+    bufferTop_ += _rowCount;
+    onStrip_(top, Size{size_.width, _rowCount}, move(strip), _last);
+}
+
+void SixelImageBuilder::done()
+{
+    // Bands cover disjoint pixel rows, so they can be rasterized independently of each other.
+    crispy::thread_pool::shared().parallel_for(bands_.size(), [this](size_t _band) { rasterize(bands_[_band]); });
+    bands_.clear();
+
+    if (progressive())
+        commitRows(max(size_.height - bufferTop_, 0), true);
+}
+
+void SixelImageBuilder::rasterizeBands()
+{
+    for (Band const& band : bands_)
+        rasterize(band);
+    bands_.clear();
+}
+
+void SixelImageBuilder::rasterize(Band const& _band) noexcept
+{
+    for (SixelRun const& run : _band.runs)
+        for (int i = 0; i < 6; ++i)
+            if (run.sixel & (1 << i))
+                fill(_band.top + i, run.column, run.count, run.color);
+}
+
 RGBAColor SixelImageBuilder::at(Coordinate _coord) const noexcept
 {
+    // Pixels painted by pending bands take precedence over what has been rasterized already.
+    for (auto band = bands_.rbegin(); band != bands_.rend(); ++band)
+    {
+        auto const pin = _coord.row - band->top;
+        if (pin < 0 || pin >= 6)
+            continue;
+        for (auto run = band->runs.rbegin(); run != band->runs.rend(); ++run)
+            if ((run->sixel & (1 << pin)) && run->column <= _coord.column && _coord.column < run->column + run->count)
+                return RGBAColor{run->color.red, run->color.green, run->color.blue, 0xFF};
+    }
+
+    if (progressive())
+    {
+        auto const row = _coord.row - bufferTop_;
+        auto const col = _coord.column % size_.width;
+        if (row < 0 || row >= bufferHeight())
+            return RGBAColor{};
+        auto const color = &buffer_[row * size_.width * 4 + col * 4];
+        return RGBAColor{color[0], color[1], color[2], color[3]};
+    }
+
     auto const row = _coord.row % size_.height;
     auto const col = _coord.column % size_.width;
     auto const base = row * size_.width * 4 + col * 4;
@@ -349,15 +454,29 @@ RGBAColor SixelImageBuilder::at(Coordinate _coord) const noexcept
     return RGBAColor{color[0], color[1], color[2], color[3]};
 }
 
-void SixelImageBuilder::write(Coordinate const& _coord, RGBColor const& _value) noexcept
+void SixelImageBuilder::fill(int _row, int _column, int _count, RGBColor const& _value) noexcept
 {
-    if (_coord.row >= 0 && _coord.row < size_.height && _coord.column >= 0 && _coord.column < size_.width)
+    auto const row = _row - bufferTop_;
+    if (row < 0 || row >= size_.height - bufferTop_ || row >= bufferHeight())
+        return;
+
+    auto const column = max(_column, 0);
+    auto const count = min(_column + _count, size_.width) - column;
+    if (count <= 0)
+        return;
+
+    // Write the first pixel and then keep doubling the filled span with block copies.
+    auto const p = &buffer_[(row * size_.width + column) * 4];
+    p[0] = _value.red;
+    p[1] = _value.green;
+    p[2] = _value.blue;
+    p[3] = 0xFF;
+    auto const total = static_cast<size_t>(count) * 4;
+    for (size_t filled = 4; filled < total; )
     {
-        auto const base = _coord.row * size_.width * 4 + _coord.column * 4;
-        buffer_[base + 0] = _value.red;
-        buffer_[base + 1] = _value.green;
-        buffer_[base + 2] = _value.blue;
-        buffer_[base + 3] = 0xFF;
+        auto const n = min(filled, total - filled);
+        std::memcpy(p + filled, p, n);
+        filled += n;
     }
 }
 
@@ -382,6 +501,12 @@ void SixelImageBuilder::newline()
 
     if (sixelCursor_.row + 6 < size_.height)
         sixelCursor_.row += 6;
+
+    // All rows above the sixel cursor are complete now.
+    // Rasterizing is deferred until done() unless the rows are handed out progressively.
+    if (progressive())
+        if (auto const completedRows = sixelCursor_.row - bufferTop_; completedRows >= stripHeight_)
+            commitRows(completedRows / stripHeight_ * stripHeight_, false);
 }
 
 void SixelImageBuilder::setRaster(int _pan, int _pad, Size const& _imageSize)
@@ -391,26 +516,40 @@ void SixelImageBuilder::setRaster(int _pan, int _pad, Size const& _imageSize)
     size_.width = clamp(_imageSize.width, 0, maxSize_.width);
     size_.height = clamp(_imageSize.height, 0, maxSize_.height);
 
-    buffer_.resize(size_.width * size_.height * 4);
+    if (progressive())
+        resizeProgressiveBuffer();
+    else
+        buffer_.resize(size_.width * size_.height * 4);
 }
 
 void SixelImageBuilder::render(int8_t _sixel)
+{
+    render(_sixel, 1);
+}
+
+void SixelImageBuilder::render(int8_t _sixel, int _count)
 {
     // TODO: respect aspect ratio!
     auto const x = sixelCursor_.column;
-    if (x < size_.width)
-    {
-        for (int i = 0; i < 6; ++i)
-        {
-            auto const y = sixelCursor_.row + i;
-            auto const pos = Coordinate{y, x};
-            auto const pin = 1 << i;
-            auto const pinned = (_sixel & pin) != 0;
-            if (pinned)
-                write(pos, currentColor());
-        }
-        sixelCursor_.column++;
-    }
+    if (x >= size_.width || _count <= 0)
+        return;
+
+    auto const count = min(_count, size_.width - x);
+    sixelCursor_.column += count;
+
+    if (!_sixel)
+        return;
+
+    if (bands_.empty() || bands_.back().top != sixelCursor_.row)
+        bands_.emplace_back(Band{sixelCursor_.row, {}});
+
+    auto const color = currentColor();
+    auto& runs = bands_.back().runs;
+    if (!runs.empty() && runs.back().sixel == _sixel && runs.back().color == color
+            && runs.back().column + runs.back().count == x)
+        runs.back().count += count;
+    else
+        runs.emplace_back(SixelRun{x, count, _sixel, color});
 }
 
 }
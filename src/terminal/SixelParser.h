@@ -21,6 +21,7 @@
 #include <crispy/size.h>
 
 #include <array>
+#include <functional>
 #include <memory>
 #include <string_view>
 #include <vector>
@@ -70,6 +71,16 @@ class SixelParser : public ParserExtension
 
         /// renders a given sixel at the current sixel-cursor position.
         virtual void render(int8_t _sixel) = 0;
+
+        /// renders a given sixel @p _count times, starting at the current sixel-cursor position.
+        virtual void render(int8_t _sixel, int _count)
+        {
+            for (int i = 0; i < _count; ++i)
+                render(_sixel);
+        }
+
+        /// Invoked once the sixel data stream is complete.
+        virtual void done() {}
     };
 
     using OnFinalize = std::function<void()>;
@@ -153,6 +164,14 @@ class SixelImageBuilder : public SixelParser::Events
   public:
     using Buffer = std::vector<uint8_t>;
 
+    /// Receives a completed horizontal strip of the image in progressive mode.
+    ///
+    /// @param _top       first pixel row of the strip in the image
+    /// @param _pixelSize size of the strip in pixels
+    /// @param _rgba      RGBA data of the strip
+    /// @param _last      whether or not this is the last strip of the image
+    using OnStrip = std::function<void(int _top, crispy::Size _pixelSize, Buffer&& _rgba, bool _last)>;
+
     SixelImageBuilder(crispy::Size const& _maxSize,
                       int _aspectVertical,
                       int _aspectHorizontal,
@@ -168,28 +187,64 @@ class SixelImageBuilder : public SixelParser::Events
 
     RGBAColor at(Coordinate _coord) const noexcept;
 
+    /// @returns the RGBA buffer, which is complete only after done() and
+    ///          only holds the rows not yet handed out in progressive mode.
     Buffer const& data() const noexcept { return buffer_; }
     Buffer& data() noexcept { return buffer_; }
 
     void clear(RGBAColor _fillColor);
 
+    /// Enables progressive mode.
+    ///
+    /// Rather than keeping the whole image until the end, rows the sixel cursor has moved past
+    /// are handed out to @p _onStrip in strips of (a multiple of) @p _stripHeight pixel rows.
+    /// The builder then only needs to hold the rows that are still being painted.
+    void setProgressive(int _stripHeight, OnStrip _onStrip);
+    bool progressive() const noexcept { return static_cast<bool>(onStrip_); }
+
     void setColor(int _index, RGBColor const& _color) override;
     void useColor(int _index) override;
     void rewind() override;
     void newline() override;
     void setRaster(int _pan, int _pad, crispy::Size const& _imageSize) override;
     void render(int8_t _sixel) override;
+    void render(int8_t _sixel, int _count) override;
+    void done() override;
 
     Coordinate const& sixelCursor() const noexcept { return sixelCursor_; }
 
   private:
-    void write(Coordinate const& _coord, RGBColor const& _value) noexcept;
+    /// A horizontal run of identical sixels within a band.
+    struct SixelRun {
+        int column;
+        int count;
+        int8_t sixel;
+        RGBColor color;
+    };
+
+    /// A sixel band (six pixel rows), with its runs yet to be rasterized.
+    struct Band {
+        int top;
+        std::vector<SixelRun> runs;
+    };
+
+    void fill(int _row, int _column, int _count, RGBColor const& _value) noexcept;
+    void rasterize(Band const& _band) noexcept;
+    void rasterizeBands();
+    int bufferHeight() const noexcept;
+    void resizeProgressiveBuffer();
+    void commitRows(int _rowCount, bool _last);
 
   private:
     crispy::Size const maxSize_;
     std::shared_ptr<SixelColorPalette> colors_;
     crispy::Size size_;
     Buffer buffer_; /// RGBA buffer
+    RGBAColor backgroundColor_;
+    int bufferTop_ = 0; /// first image row held in buffer_
+    int stripHeight_ = 0;
+    OnStrip onStrip_;
+    std::vector<Band> bands_; /// painted bands not yet rasterized into buffer_
     Coordinate sixelCursor_;
     int currentColor_;
     struct {
@@ -0,0 +1,93 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/SixelParser.h>
+
+#include <crispy/benchmark.h>
+
+#include <fmt/format.h>
+
+#include <memory>
+#include <random>
+#include <string>
+
+using namespace terminal;
+using crispy::Size;
+using crispy::benchmark::do_not_optimize;
+using std::u32string;
+
+namespace
+{
+    /// @returns the sixel data (following the DCS introducer) of a random image of @p _size pixels,
+    ///          painted in 16 colors, with repeated sixels as image encoders produce them for areas
+    ///          of the same color.
+    u32string randomSixelImage(std::mt19937& _rng, Size _size)
+    {
+        auto constexpr ColorCount = 16;
+        auto byte = std::uniform_int_distribution<int>(0, 100);
+        auto color = std::uniform_int_distribution<int>(0, ColorCount - 1);
+        auto sixel = std::uniform_int_distribution<int>(0, 63);
+        auto runLength = std::uniform_int_distribution<int>(1, 32);
+
+        auto data = fmt::format("\"1;1;{};{}", _size.width, _size.height);
+        for (int i = 0; i < ColorCount; ++i)
+            data += fmt::format("#{};2;{};{};{}", i, byte(_rng), byte(_rng), byte(_rng));
+
+        for (int band = 0; band < (_size.height + 5) / 6; ++band)
+        {
+            // Each band is painted in a few passes of different colors.
+            for (int pass = 0; pass < 4; ++pass)
+            {
+                data += fmt::format("#{}", color(_rng));
+                for (int x = 0; x < _size.width;)
+                {
+                    auto const ch = static_cast<char>('?' + sixel(_rng));
+                    auto const count = std::min(_rng() % 4 ? 1 : runLength(_rng), _size.width - x);
+                    if (count > 3)
+                        data += fmt::format("!{}{}", count, ch);
+                    else
+                        data.append(static_cast<size_t>(count), ch);
+                    x += count;
+                }
+                data += '$';
+            }
+            data += '-';
+        }
+
+        return u32string(data.begin(), data.end());
+    }
+}
+
+CRISPY_BENCHMARK("SixelParser.decode")
+{
+    for (auto const size: {Size{64, 64}, Size{640, 480}})
+    {
+        for (bool const progressive: {false, true})
+        {
+            auto const data = randomSixelImage(_bench.rng(), size);
+            auto const palette = std::make_shared<SixelColorPalette>(16, 256);
+            _bench.throughput(data.size());
+            _bench.measure(fmt::format("size={}x{}/progressive={}", size.width, size.height, progressive), [&]() {
+                auto builder = SixelImageBuilder(size, 1, 1, RGBAColor{0, 0, 0, 0xFF}, palette);
+                if (progressive)
+                    builder.setProgressive(6, [](int, Size, SixelImageBuilder::Buffer&& _rgba, bool) {
+                        do_not_optimize(_rgba);
+                    });
+                auto parser = SixelParser{builder};
+                parser.parseFragment(data);
+                parser.done();
+                do_not_optimize(builder.data());
+            });
+        }
+    }
+}
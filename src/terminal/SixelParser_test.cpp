@@ -328,3 +328,94 @@ TEST_CASE("SixelParser.newline", "[sixel]")
     }
 }
 
+
+TEST_CASE("SixelParser.progressive", "[sixel]")
+{
+    auto constexpr defaultColor = RGBAColor{0, 0, 0, 255};
+    auto constexpr pinColor = RGBAColor{255, 255, 0, 255};
+    auto ib = sixelImageBuilder(Size{3, 20}, defaultColor);
+
+    struct Strip { int top; Size size; SixelImageBuilder::Buffer rgba; bool last; };
+    auto strips = std::vector<Strip>{};
+    ib.setProgressive(4, [&](int _top, Size _size, SixelImageBuilder::Buffer&& _rgba, bool _last) {
+        strips.emplace_back(Strip{_top, _size, std::move(_rgba), _last});
+    });
+
+    auto sp = SixelParser{ib};
+    sp.parseFragment("#1;2;100;100;0");
+    sp.parseFragment("#1~~~");  // rows 0..5
+    REQUIRE(strips.empty());
+
+    sp.parseFragment("-");      // rows 0..3 are complete
+    REQUIRE(strips.size() == 1);
+    CHECK(strips[0].top == 0);
+    CHECK(strips[0].size == Size{3, 4});
+    CHECK_FALSE(strips[0].last);
+
+    sp.parseFragment("~-~");    // rows 4..11 are complete
+    REQUIRE(strips.size() == 2);
+    CHECK(strips[1].top == 4);
+    CHECK(strips[1].size == Size{3, 8});
+
+    sp.done();
+    REQUIRE(strips.size() == 3);
+    CHECK(strips[2].top == 12);
+    CHECK(strips[2].size == Size{3, 8});
+    CHECK(strips[2].last);
+
+    // Reassemble the strips and verify the painted pixels.
+    auto image = SixelImageBuilder::Buffer{};
+    for (auto const& strip: strips)
+    {
+        REQUIRE(strip.rgba.size() == size_t(strip.size.width * strip.size.height * 4));
+        image.insert(image.end(), strip.rgba.begin(), strip.rgba.end());
+    }
+    REQUIRE(image.size() == 3 * 20 * 4);
+
+    for (int y = 0; y < 20; ++y)
+    {
+        for (int x = 0; x < 3; ++x)
+        {
+            auto const p = &image[(y * 3 + x) * 4];
+            auto const actualColor = RGBAColor{p[0], p[1], p[2], p[3]};
+            auto const expectedColor = (y < 6 && x < 3) || (6 <= y && y < 18 && x == 0) ? pinColor : defaultColor;
+            INFO(fmt::format("x={}, y={}", x, y));
+            CHECK(actualColor == expectedColor);
+        }
+    }
+}
+
+TEST_CASE("SixelParser.rep_multiple_bands", "[sixel]")
+{
+    auto constexpr defaultColor = RGBAColor{0, 0, 0, 0xFF};
+    auto ib = sixelImageBuilder(Size{10, 12}, defaultColor);
+    auto sp = SixelParser{ib};
+
+    sp.parseFragment("#1;2;100;0;0#2;2;0;0;100");
+    sp.parseFragment("#1!4~#2!3~!20@"); // repeat count exceeding the image width gets clipped
+    sp.parseFragment("$#2!2@");         // overpaint the upper pin of the first two columns
+    sp.parseFragment("-#2!10_");        // bottom pin of the second band
+    sp.done();
+
+    CHECK(ib.sixelCursor() == Coordinate{6, 10});
+
+    auto const& data = ib.data();
+    REQUIRE(data.size() == size_t(10 * 12 * 4));
+    for (int y = 0; y < 12; ++y)
+    {
+        for (int x = 0; x < 10; ++x)
+        {
+            auto const p = &data[(y * 10 + x) * 4];
+            auto const actualColor = RGBAColor{p[0], p[1], p[2], p[3]};
+            auto const expectedColor = y == 0 && x < 2            ? RGBAColor{0, 0, 255, 0xFF}
+                                     : y < 6 && x < 4             ? RGBAColor{255, 0, 0, 0xFF}
+                                     : y < 6 && x < 7             ? RGBAColor{0, 0, 255, 0xFF}
+                                     : y == 0                     ? RGBAColor{0, 0, 255, 0xFF}
+                                     : y == 11                    ? RGBAColor{0, 0, 255, 0xFF}
+                                     : defaultColor;
+            INFO(fmt::format("x={}, y={}", x, y));
+            CHECK(actualColor == expectedColor);
+            CHECK(ib.at(Coordinate{y, x}) == expectedColor);
+        }
+    }
+}
@@ -17,15 +17,29 @@
 #include <terminal/InputGenerator.h>
 #include <terminal/logging.h>
 
+#if !defined(_WIN32)
+#include <terminal/pty/PtyReactor.h>
+#endif
+
 #include <crispy/escape.h>
+#include <crispy/size_class_pool.h>
 #include <crispy/stdfs.h>
 #include <crispy/debuglog.h>
+#include <crispy/profiler.h>
+#include <crispy/utf8.h>
 
+#include <algorithm>
+#include <cassert>
 #include <chrono>
+#include <limits>
 #include <utility>
 
 #include <iostream>
 
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
 using crispy::Size;
 
 using namespace std;
@@ -38,15 +52,108 @@ namespace terminal {
 
 namespace // {{{ helpers
 {
+    // Number of history lines to reflow per main loop iteration, while catching up after a resize.
+    constexpr int BackgroundReflowLineCount = 1000;
+
+    // The session file is saved at most this often, with at most this many new history lines
+    // each time, so that saving a huge history does not stall the terminal.
+    constexpr auto SessionSaveInterval = std::chrono::seconds(1);
+    constexpr int SessionSaveLineCount = 10000;
+
+    // Predicted characters not echoed within this time are dropped again.
+    constexpr auto PredictionTimeout = std::chrono::seconds(1);
+
+    // Amount of input pending to be written, at which the application is considered congested,
+    // and below which it is considered to have caught up again.
+    constexpr size_t InputHighWatermark = 1024 * 1024;
+    constexpr size_t InputLowWatermark = 64 * 1024;
+
+    // Images whose pixels have not been accessed for this long are compressed,
+    // checking for such images at the given interval.
+    constexpr auto ImageCompressionDelay = std::chrono::seconds(60);
+    constexpr auto ImageCompressionInterval = std::chrono::seconds(10);
+
+    // Output read in chunks of this size or larger (i.e. filling the default PTY read buffer) is
+    // considered bulk output, for which links are not detected before being looked up.
+    constexpr size_t EagerLinkDetectionMaxBytes = 16 * 1024;
+
     void trimSpaceRight(string& value)
     {
         while (!value.empty() && value.back() == ' ')
             value.pop_back();
     };
 
-    tuple<RGBColor, RGBColor> makeColors(ColorPalette const& _colorPalette, Cell const& _cell, bool _reverseVideo, bool _selected)
+    // Selections are extracted in the background in slices of this many lines,
+    // each with the terminal locked, see Terminal::extractSelectionTextAsync().
+    constexpr size_t SelectionExtractionLineCount = 1000;
+
+    // Extracted selection text is handed to the sink in pieces of at least this size.
+    constexpr size_t SelectionTextChunkSize = 1024 * 1024;
+
+    /// Joins the selected cells of a grid into text, range by range.
+    ///
+    /// The codepoints of each line are gathered and transcoded at once, see crispy::utf8::append().
+    class SelectionTextBuilder {
+      public:
+        explicit SelectionTextBuilder(Selector const& _selector): selector_{ _selector } {}
+
+        /// Appends the cells of @p _range to @p _text, with the range's line having moved up
+        /// by @p _droppedLines in @p _grid since the selection was taken.
+        void append(Grid const& _grid, Selector::Range const& _range, int _droppedLines, string& _text)
+        {
+            auto const line = _range.line - _droppedLines;
+            auto const row = line - _grid.historyLineCount() + 1;
+            if (line < 0 || row > _grid.screenSize().height)
+                return;
+
+            auto const columnCount = _grid.screenSize().width;
+            auto const isLineWrapped = _grid.absoluteLineAt(line).wrapped();
+            bool const touchesRightPage = _range.line > 0
+                && selector_.contains({_range.line - 1, columnCount});
+
+            for (int column = _range.fromColumn; column <= min(_range.toColumn, columnCount); ++column)
+            {
+                auto const isNewLine = column <= lastColumn_;
+                if (isNewLine && (!isLineWrapped || !touchesRightPage))
+                {
+                    // TODO: handle logical line in word-selection (don't include LF in wrapped lines)
+                    flush();
+                    trimSpaceRight(currentLine_);
+                    _text += currentLine_;
+                    _text += '\n';
+                    currentLine_.clear();
+                }
+                if (auto const& cell = _grid.at({row, column}); cell.codepointCount())
+                    codepoints_ += cell.codepoints();
+                else
+                    codepoints_ += U' ';
+                lastColumn_ = column;
+            }
+        }
+
+        void finish(string& _text)
+        {
+            flush();
+            trimSpaceRight(currentLine_);
+            _text += currentLine_;
+            currentLine_.clear();
+        }
+
+      private:
+        void flush()
+        {
+            crispy::utf8::append(currentLine_, codepoints_);
+            codepoints_.clear();
+        }
+
+        Selector const& selector_;
+        std::u32string codepoints_;
+        string currentLine_;
+        int lastColumn_ = 0;
+    };
+
+    tuple<RGBColor, RGBColor> makeColors(ColorPalette const& _colorPalette, RGBColor fg, RGBColor bg, bool _selected)
     {
-        auto const [fg, bg] = _cell.attributes().makeColors(_colorPalette, _reverseVideo);
         if (!_selected)
             return tuple{fg, bg};
 
@@ -54,6 +161,40 @@ namespace // {{{ helpers
         auto const b = _colorPalette.selectionBackground.value_or(fg);
         return tuple{a, b};
     }
+
+    /// @returns the palette slot apply() takes the color from, regardless of reverse video.
+    PaletteSlot paletteSlot(Color _color, ColorTarget _target, bool _bright) noexcept
+    {
+        switch (_color.type)
+        {
+            case ColorType::RGB:
+                return PaletteSlot::None;
+            case ColorType::Indexed:
+                return static_cast<PaletteSlot>(_bright && _color.index < 8 ? _color.index + 8 : _color.index);
+            case ColorType::Bright:
+                return static_cast<PaletteSlot>(_color.index + 8);
+            case ColorType::Undefined:
+            case ColorType::Default:
+                break;
+        }
+        return _target == ColorTarget::Foreground ? PaletteSlot::DefaultForeground : PaletteSlot::DefaultBackground;
+    }
+
+    /// Resolves the colors of @p _cell taken from the palette again, e.g. after the palette changed.
+    void recolor(RenderCell& _cell, RenderPalette const& _palette) noexcept
+    {
+        auto const faint = (_cell.flags & CellFlags::Faint) != 0;
+        _cell.foregroundColor = _palette.resolve(_cell.foregroundSlot, _cell.foregroundColor, faint);
+        _cell.backgroundColor = _palette.resolve(_cell.backgroundSlot, _cell.backgroundColor);
+        _cell.decorationColor = _palette.resolve(_cell.decorationSlot, _cell.decorationColor, faint);
+    }
+
+    tuple<RGBColor, RGBColor> makeSearchHighlightColors(ColorPalette const& _colorPalette, RGBColor fg, RGBColor bg)
+    {
+        auto const a = _colorPalette.searchHighlightForeground.value_or(bg);
+        auto const b = _colorPalette.searchHighlightBackground.value_or(fg);
+        return tuple{a, b};
+    }
 }
 // }}}
 
@@ -98,13 +239,35 @@ Terminal::Terminal(Pty& _pty,
         _colorPalette
     },
     screenUpdateThread_{},
-    viewport_{ screen_, [this]() { breakLoopAndRefreshRenderBuffer(); } }
+    viewport_{ screen_, [this]() { publishViewState(); breakLoopAndRefreshRenderBuffer(); } }
 {
     readBuffer_.resize(ptyReadBufferSize_);
+    publishViewState();
 }
 
 Terminal::~Terminal()
 {
+    cancelSelectionExtraction();
+    if (imageCompression_.valid())
+        imageCompression_.wait();
+
+    if (inputPipeline_)
+    {
+#if !defined(_WIN32)
+        if (inputPipeline_->reactorFd >= 0)
+            PtyReactor::shared().unsubscribe(inputPipeline_->reactorFd);
+#endif
+        inputPipeline_->closed = true;
+        pty_.wakeupReader();
+        {
+            auto const _l = lock_guard{inputPipeline_->mutex};
+            inputPipeline_->spaceAvailable.notify_one();
+            inputPipeline_->dataAvailable.notify_one();
+        }
+        if (inputPipeline_->readerThread)
+            inputPipeline_->readerThread->join();
+    }
+
     pty_.wakeupReader();
 
     if (screenUpdateThread_)
@@ -113,17 +276,225 @@ Terminal::~Terminal()
 
 void Terminal::start()
 {
+#if !defined(_WIN32)
+    if (inputPipeline_ && inputPipeline_->settings.sharedReactor && pty_.readFileDescriptor() >= 0)
+    {
+        auto& pipeline = *inputPipeline_;
+        pipeline.reactorFd = pty_.readFileDescriptor();
+        PtyReactor::shared().subscribe(
+            pipeline.reactorFd,
+            [this]() { return readPipelinedInput(); },
+            pty_.wakeupFileDescriptor(),
+            [this, &pipeline]() {
+                // Closing the PTY wakes it up, but drops its descriptor from the reactor silently.
+                if (pty_.readFileDescriptor() >= 0)
+                    return;
+                auto const _l = lock_guard{pipeline.mutex};
+                pipeline.closed = true;
+                pipeline.dataAvailable.notify_one();
+            }
+        );
+    }
+#endif
+
+    if (inputPipeline_ && inputPipeline_->reactorFd < 0)
+        inputPipeline_->readerThread = make_unique<std::thread>(bind(&Terminal::inputPipelineLoop, this));
+
+    ptyWriter_ = make_unique<PtyWriter>(
+        pty_,
+        InputHighWatermark,
+        InputLowWatermark,
+        [this](bool _congested) {
+            debuglog(InputTag).write("Input {}.", _congested ? "congested" : "no longer congested");
+            eventListener_.inputCongestionChanged(_congested);
+        },
+        &latencyTrace_.histogram(LatencyStage::InputWritten)
+    );
+
     screenUpdateThread_ = make_unique<std::thread>(bind(&Terminal::mainLoop, this));
 }
 
+void Terminal::enableInputPipeline(InputPipelineSettings const& _settings)
+{
+    assert(!screenUpdateThread_ && "The input pipeline must be enabled before starting the terminal.");
+
+    auto settings = _settings;
+    settings.bufferSize = max(settings.bufferSize, static_cast<size_t>(ptyReadBufferSize_));
+    settings.highWatermark = clamp(settings.highWatermark, size_t{1}, settings.bufferSize);
+    settings.lowWatermark = min(settings.lowWatermark, settings.highWatermark - 1);
+    inputPipeline_ = make_unique<InputPipeline>(settings);
+}
+
+void Terminal::setReadBufferSettings(ReadBufferSettings const& _settings)
+{
+    assert(!screenUpdateThread_ && "The read buffer must be configured before starting the terminal.");
+
+    readBufferSettings_ = _settings;
+    readBufferSettings_.maxSize = max(readBufferSettings_.maxSize, static_cast<size_t>(ptyReadBufferSize_));
+    if (readBuffer_.size() > readBufferSettings_.maxSize)
+        readBuffer_.resize(readBufferSettings_.maxSize);
+}
+
+void Terminal::setRecorder(std::unique_ptr<PtyRecorder> _recorder)
+{
+    assert(!screenUpdateThread_ && "The recorder must be set before starting the terminal.");
+
+    recorder_ = move(_recorder);
+    if (!recorder_)
+        return;
+
+    // Starts off with the current size, so that a replay begins with the same screen size.
+    auto const cellPixelSize = screen_.cellPixelSize();
+    recorder_->recordResize(screenSize(),
+                            cellPixelSize.width && cellPixelSize.height
+                                ? optional{cellPixelSize * screenSize()}
+                                : nullopt,
+                            steady_clock::now());
+}
+
+void Terminal::setSessionFile(std::unique_ptr<SessionFile> _sessionFile)
+{
+    assert(!screenUpdateThread_ && "The session file must be set before starting the terminal.");
+
+    sessionFile_ = move(_sessionFile);
+    if (!sessionFile_)
+        return;
+
+    auto const _l = lock_guard{*this};
+    if (!sessionFile_->restore(screen_))
+        return;
+
+    // The application that has been running on the alternate screen is gone.
+    if (screen_.isAlternateScreen())
+        screen_.setMode(DECMode::ExtendedAltScreen, false);
+
+    // Keeps the new shell from overwriting the last line restored.
+    if (screen_.cursor().position.column > 1)
+        screen_.write(string_view("\r\n"));
+
+    historyReflowPending_ = screen_.pendingReflowLineCount() != 0;
+    nextSessionSave_ = steady_clock::now() + SessionSaveInterval;
+}
+
+void Terminal::saveSession(optional<int> _maxLines)
+{
+    auto records = [&]() {
+        auto const _l = lock_guard{*this};
+        return sessionFile_->encode(screen_, _maxLines);
+    }();
+    sessionFile_->append(records);
+    nextSessionSave_ = steady_clock::now() + SessionSaveInterval;
+}
+
 void Terminal::setRefreshRate(double _refreshRate)
 {
     refreshInterval_ = std::chrono::milliseconds(static_cast<long long>(1000.0 / _refreshRate));
 }
 
+void Terminal::setThroughputModeSettings(ThroughputModeSettings const& _settings)
+{
+    throughputSettings_ = _settings;
+    throughputSettings_.sustainedFrames = max(throughputSettings_.sustainedFrames, 1);
+    if (!throughputSettings_.enabled)
+        throughputMode_ = false;
+}
+
+void Terminal::updateThroughputMode(steady_clock::time_point _now)
+{
+    if (!throughputSettings_.enabled)
+        return;
+
+    auto const interval = max(refreshInterval_, std::chrono::milliseconds(1));
+    auto const elapsed = _now - throughputWindowStart_;
+    if (elapsed < interval)
+        return;
+
+    // Input spread across several intervals (e.g. after a long wait) is accounted to each of them.
+    auto const intervals = static_cast<size_t>(elapsed / interval);
+    auto const flooded = throughputBytes_ >= throughputSettings_.bytesPerFrame * intervals;
+    floodedWindowCount_ = flooded ? floodedWindowCount_ + 1 : 0;
+    throughputBytes_ = 0;
+    throughputWindowStart_ = _now;
+
+    auto const enable = floodedWindowCount_ >= throughputSettings_.sustainedFrames;
+    if (enable != throughputMode_.load())
+    {
+        debuglog(TerminalTag).write("{} throughput mode.", enable ? "Entering" : "Leaving");
+        throughputMode_ = enable;
+    }
+
+    flushScreenUpdate(_now);
+}
+
+void Terminal::flushScreenUpdate(steady_clock::time_point _now)
+{
+    auto const _l = lock_guard{*this};
+    if (!screenUpdatePending_ || !visible_ || !renderBufferUpdateEnabled_ || !screenUpdateDue(_now))
+        return;
+
+    screenUpdatePending_ = false;
+    lastScreenUpdate_ = _now;
+    eventListener_.screenUpdated();
+
+    #if defined(LIBTERMINAL_PASSIVE_RENDER_BUFFER_UPDATE)
+    ensureFreshRenderBuffer(_now);
+    #endif
+}
+
+void Terminal::setVisible(bool _visible)
+{
+    if (visible_.exchange(_visible) == _visible)
+        return;
+
+    debuglog(TerminalTag).write("Terminal {}.", _visible ? "visible" : "hidden");
+
+    // Has the terminal thread catch up on the held back screen update.
+    if (_visible)
+        breakLoopAndRefreshRenderBuffer();
+}
+
+void Terminal::setForeground(bool _foreground)
+{
+    if (foreground_.exchange(_foreground) == _foreground)
+        return;
+
+    debuglog(TerminalTag).write("Terminal {}.", _foreground ? "in foreground" : "in background");
+
+    // Has the terminal thread catch up on the screen update held back in the background.
+    if (_foreground)
+        breakLoopAndRefreshRenderBuffer();
+}
+
+void Terminal::yieldToForeground(std::chrono::nanoseconds _parseTime)
+{
+    auto& scheduler = SessionScheduler::shared();
+    auto const now = steady_clock::now();
+    if (foreground_)
+    {
+        scheduler.foregroundActive(now);
+        return;
+    }
+
+    // Without an input pipeline, the PTY would not be read while waiting.
+    if (!inputPipeline_)
+        return;
+
+    if (auto const wait = scheduler.charge(schedulingBudget_, _parseTime, now); wait.count() > 0)
+    {
+        CRISPY_PROFILE_ZONE("Terminal::yieldToForeground");
+        this_thread::sleep_for(wait);
+    }
+}
+
+bool Terminal::screenUpdateDue(Timestamp _now) const noexcept
+{
+    return foreground_ || _now - lastScreenUpdate_ >= SessionScheduler::shared().backgroundRefreshInterval();
+}
+
 void Terminal::mainLoop()
 {
     mainLoopThreadID_ = this_thread::get_id();
+    CRISPY_PROFILE_THREAD("terminal");
 
     debuglog(TerminalTag).write(
         "Starting main loop with thread id {}",
@@ -140,22 +511,48 @@ void Terminal::mainLoop()
             break;
     }
 
+    if (sessionFile_)
+        saveSession(nullopt);
+
     eventListener_.onClosed();
 }
 
 bool Terminal::processInputOnce()
 {
-    auto const timeout =
-        renderBuffer_.state == RenderBufferState::WaitingForRefresh && !screenDirty_
+    CRISPY_PROFILE_ZONE("Terminal::processInputOnce");
+
+    // Hidden terminals do not wake up to refresh their render buffer.
+    auto timeout =
+        ((renderBuffer_.state == RenderBufferState::WaitingForRefresh && !screenDirty_) || !visible_)
+                && !historyReflowPending_
             ? std::chrono::seconds(4)
             : refreshInterval_ // std::chrono::seconds(0)
             ;
 
-    auto const n = pty_.read(readBuffer_.data(), readBuffer_.size(), timeout);
+    // Nothing is rendered while a synchronized output batch is open, so only wakes up
+    // to end it if it did not complete in time.
+    if (batchStart_ != Timestamp{})
+        timeout = clamp(chrono::duration_cast<chrono::milliseconds>(batchStart_ + synchronizedOutputTimeout_ - steady_clock::now()),
+                        chrono::milliseconds(0),
+                        timeout);
 
-    if (n > 0)
+    // Wakes up in time to drop predicted characters that have not been echoed.
+    if (predictiveEcho_)
+        timeout = min(timeout, chrono::duration_cast<chrono::milliseconds>(PredictionTimeout));
+
+    auto const parseTime = parseStats_.time();
+
+    if (inputPipeline_)
+    {
+        if (!processPipelinedInputOnce(timeout))
+            return false;
+    }
+    else if (auto const n = readInput(timeout); n > 0)
     {
-        writeToScreen(readBuffer_.data(), n);
+        if (recorder_)
+            recorder_->recordOutput(string_view(readBuffer_.data(), static_cast<size_t>(n)), lastReadTime_);
+        writeToScreen(readBuffer_.data(), n, lastReadTime_);
+        adaptReadBufferSize(static_cast<size_t>(n));
 
         #if defined(LIBTERMINAL_PASSIVE_RENDER_BUFFER_UPDATE)
         auto const now = std::chrono::steady_clock::now();
@@ -172,9 +569,310 @@ bool Terminal::processInputOnce()
         return false;
     }
 
+    if (batchStart_ != Timestamp{})
+    {
+        auto const now = steady_clock::now();
+        auto const completed = [&]() {
+            auto const _l = lock_guard{*this};
+            return updateSynchronizedOutput(now);
+        }();
+        if (completed)
+            flushScreenUpdate(now);
+    }
+
+    if (auto const parsed = parseStats_.time() - parseTime; parsed.count() > 0)
+        yieldToForeground(parsed);
+
+    updateThroughputMode(steady_clock::now());
+    if (screenUpdatePending_ && visible_ && !throughputMode_)
+        flushScreenUpdate(steady_clock::now());
+
+    if (historyReflowPending_)
+    {
+        auto const _l = lock_guard{*this};
+        reflowHistory(BackgroundReflowLineCount);
+    }
+
+    if (sessionFile_ && steady_clock::now() >= nextSessionSave_)
+        saveSession(SessionSaveLineCount);
+
+    if (auto const now = steady_clock::now(); now >= nextImageCompression_)
+        compressUnusedImages(now);
+
+    if (auto lastWrite = lastWriteTime_.load(); lastWrite && idleMemoryTrimDelay_.count() > 0
+            && steady_clock::now() - steady_clock::time_point(steady_clock::duration(lastWrite)) >= idleMemoryTrimDelay_
+            && lastWriteTime_.compare_exchange_strong(lastWrite, 0))
+        trimMemory();
+
+    if (predictiveEcho_)
+    {
+        auto const _l = lock_guard{*this};
+        if (!predictions_.empty() && steady_clock::now() - predictionTime_ >= PredictionTimeout)
+        {
+            debuglog(TerminalTag).write("Dropping {} predicted characters not echoed in time.", predictions_.size());
+            predictions_.clear();
+            breakLoopAndRefreshRenderBuffer();
+        }
+    }
+
     return true;
 }
 
+int Terminal::readInput(std::chrono::milliseconds _timeout)
+{
+    auto const n = pty_.read(readBuffer_.data(), readBuffer_.size(), _timeout);
+    if (n > 0)
+        lastReadTime_ = steady_clock::now();
+    if (n < 0 && errno == EAGAIN && readBuffer_.size() > static_cast<size_t>(ptyReadBufferSize_))
+    {
+        // Idle, so give the memory of a grown buffer back.
+        readBuffer_ = vector<char>(static_cast<size_t>(ptyReadBufferSize_));
+        fullReadCount_ = 0;
+    }
+    if (n <= 0 || !readBufferSettings_.coalesce)
+        return n;
+
+    // Drains whatever else is pending, so that it is parsed and rendered in one go.
+    // Failures and wakeups are left for the next read to report.
+    auto total = static_cast<size_t>(n);
+    auto const deadline = steady_clock::now() + readBufferSettings_.coalesceTimeBudget;
+    while (total < readBuffer_.size() && steady_clock::now() < deadline)
+    {
+        auto const m = pty_.read(readBuffer_.data() + total, readBuffer_.size() - total, std::chrono::milliseconds(0));
+        if (m <= 0)
+            break;
+        total += static_cast<size_t>(m);
+    }
+    return static_cast<int>(total);
+}
+
+void Terminal::trimMemory()
+{
+    {
+        auto const _l = lock_guard{*this};
+        screen_.trimMemory();
+        for (RenderRow& row: renderRows_)
+        {
+            row.cells.shrink_to_fit();
+            row.codepoints.shrink_to_fit();
+            row.hyperlinkSpans.shrink_to_fit();
+        }
+        renderRows_.shrink_to_fit();
+        #if defined(LIBTERMINAL_PASSIVE_RENDER_BUFFER_UPDATE)
+        // Only the terminal thread fills render buffers in this mode, so the back buffer is ours.
+        renderBuffer_.backBuffer().shrinkToFit();
+        #endif
+    }
+
+    crispy::size_class_pool::current().release();
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+
+    debuglog(TerminalTag).write("Trimmed memory.");
+    eventListener_.memoryTrimmed();
+}
+
+void Terminal::compressUnusedImages(steady_clock::time_point _now)
+{
+    nextImageCompression_ = _now + ImageCompressionInterval;
+
+    // Still busy with the images of the previous round.
+    if (imageCompression_.valid() && imageCompression_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+
+    imageCompression_ = crispy::thread_pool::shared().submit(
+        [this, unusedSince = _now - ImageCompressionDelay]() {
+            if (auto const bytes = screen_.compressUnusedImages(unusedSince); bytes != 0)
+                debuglog(TerminalTag).write("Compressed unused images, releasing {} bytes.", bytes);
+        },
+        crispy::task_options{ crispy::task_priority::background, reinterpret_cast<uintptr_t>(this) }
+    );
+}
+
+void Terminal::adaptReadBufferSize(size_t _bytesRead)
+{
+    // Grows the buffer while the application keeps filling it up, yielding fewer and larger
+    // parse batches. Shrinking happens in readInput() once the PTY went idle.
+    constexpr int FullReadsBeforeGrowing = 4;
+
+    if (_bytesRead < readBuffer_.size())
+    {
+        fullReadCount_ = 0;
+        return;
+    }
+
+    if (++fullReadCount_ < FullReadsBeforeGrowing || readBuffer_.size() >= readBufferSettings_.maxSize)
+        return;
+
+    readBuffer_.resize(min(readBuffer_.size() * 2, readBufferSettings_.maxSize));
+    fullReadCount_ = 0;
+}
+
+// {{{ input pipeline
+void Terminal::inputPipelineLoop()
+{
+    auto& pipeline = *inputPipeline_;
+
+    while (!pipeline.closed)
+    {
+        if (pipeline.buffer.size() >= pipeline.settings.highWatermark)
+        {
+            // Let the parser catch up, which also stops draining the PTY, throttling the application.
+            auto lock = unique_lock{pipeline.mutex};
+            pipeline.spaceAvailable.wait(lock, [&]() {
+                return pipeline.buffer.size() <= pipeline.settings.lowWatermark || pipeline.closed;
+            });
+            continue;
+        }
+
+        auto space = pipeline.buffer.writable();
+        auto const n = pty_.read(space.begin(), min(space.size(), readBuffer_.size()), std::chrono::seconds(4));
+        if (n > 0)
+        {
+            pipeline.buffer.commit(static_cast<size_t>(n));
+            markPipelinedInputRead(pipeline);
+            auto const _l = lock_guard{pipeline.mutex};
+            pipeline.dataAvailable.notify_one();
+        }
+        else if (n < 0 && (errno != EINTR && errno != EAGAIN))
+        {
+            debuglog(TerminalTag).write("PTY read failed. {}", strerror(errno));
+            break;
+        }
+    }
+
+    auto const _l = lock_guard{pipeline.mutex};
+    pipeline.closed = true;
+    pipeline.dataAvailable.notify_one();
+}
+
+void Terminal::markPipelinedInputRead(InputPipeline& _pipeline)
+{
+    // Only the oldest pending data's read time is kept, which the parser takes along with all of it.
+    auto expected = steady_clock::rep{0};
+    _pipeline.readTime.compare_exchange_strong(expected, steady_clock::now().time_since_epoch().count());
+}
+
+bool Terminal::readPipelinedInput()
+{
+    // Invoked by the PtyReactor whenever the PTY is readable.
+    auto& pipeline = *inputPipeline_;
+
+    if (auto space = pipeline.buffer.writable(); !space.empty())
+    {
+        auto const n = pty_.read(space.begin(), min(space.size(), readBuffer_.size()), std::chrono::milliseconds(0));
+        if (n > 0)
+        {
+            pipeline.buffer.commit(static_cast<size_t>(n));
+            markPipelinedInputRead(pipeline);
+            auto const _l = lock_guard{pipeline.mutex};
+            pipeline.dataAvailable.notify_one();
+        }
+        else if (n == 0 || (errno != EINTR && errno != EAGAIN))
+        {
+            debuglog(TerminalTag).write("PTY read failed. {}", n == 0 ? "End of file." : strerror(errno));
+            auto const _l = lock_guard{pipeline.mutex};
+            pipeline.closed = true;
+            pipeline.dataAvailable.notify_one();
+            return false;
+        }
+    }
+
+    if (pipeline.buffer.size() < pipeline.settings.highWatermark)
+        return true;
+
+    // Stop watching the PTY until the parser has caught up. Either this or the parser thread
+    // clears the flag again, if the buffer got drained meanwhile, and only that one resumes.
+    pipeline.paused = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return pipeline.buffer.size() <= pipeline.settings.lowWatermark && pipeline.paused.exchange(false);
+}
+
+bool Terminal::processPipelinedInputOnce(std::chrono::milliseconds _timeout)
+{
+    auto& pipeline = *inputPipeline_;
+
+    if (pipeline.buffer.empty())
+    {
+        auto lock = unique_lock{pipeline.mutex};
+        pipeline.dataAvailable.wait_for(lock, _timeout, [&]() {
+            return !pipeline.buffer.empty() || pipeline.closed || pipeline.wakeupRequested;
+        });
+        pipeline.wakeupRequested = false;
+    }
+
+    auto const readTime = pipeline.readTime.exchange(0);
+    auto const data = pipeline.buffer.readable();
+    if (data.empty())
+        return !pipeline.closed;
+
+    auto const readTimePoint = readTime ? steady_clock::time_point(steady_clock::duration(readTime)) : steady_clock::now();
+    if (recorder_)
+        recorder_->recordOutput(string_view(data.begin(), data.size()), readTimePoint);
+    writeToScreen(data.begin(), data.size(), readTimePoint);
+    pipeline.buffer.consume(data.size());
+
+    if (pipeline.buffer.size() <= pipeline.settings.lowWatermark)
+    {
+        if (pipeline.reactorFd < 0)
+        {
+            auto const _l = lock_guard{pipeline.mutex};
+            pipeline.spaceAvailable.notify_one();
+        }
+#if !defined(_WIN32)
+        else
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (pipeline.paused.exchange(false))
+                PtyReactor::shared().resume(pipeline.reactorFd);
+        }
+#endif
+    }
+
+    #if defined(LIBTERMINAL_PASSIVE_RENDER_BUFFER_UPDATE)
+    auto const now = std::chrono::steady_clock::now();
+    ensureFreshRenderBuffer(now);
+    #endif
+
+    return true;
+}
+// }}}
+
+void Terminal::reflowHistory(optional<int> _maxLines)
+{
+    auto const pendingLineCount = screen_.pendingReflowLineCount();
+    auto const lineCountDelta = screen_.reflowHistory(_maxLines);
+    historyReflowPending_ = screen_.pendingReflowLineCount() != 0;
+
+    // Keep the viewport on the lines it has been showing. The lines just reflowed
+    // now start right below the remaining pending ones, and any lines below them are shifted.
+    if (auto const scrollOffset = viewport_.absoluteScrollOffset(); scrollOffset.has_value())
+    {
+        auto const reflowStart = screen_.pendingReflowLineCount();
+        if (*scrollOffset >= pendingLineCount)
+            viewport_.scrollToAbsolute(*scrollOffset + lineCountDelta);
+        else if (*scrollOffset >= reflowStart)
+        {
+            auto const oldLineCount = pendingLineCount - reflowStart;
+            auto const newLineCount = oldLineCount + lineCountDelta;
+            viewport_.scrollToAbsolute(reflowStart + (*scrollOffset - reflowStart) * newLineCount / oldLineCount);
+        }
+    }
+
+    publishViewState();
+}
+
+void Terminal::publishViewState()
+{
+    auto const _l = lock_guard{viewStateWriteLock_};
+    auto state = ViewState{};
+    state.pageSize = screen_.size();
+    state.historyLineCount = screen_.historyLineCount();
+    state.scrollOffset = viewport_.absoluteScrollOffset().value_or(-1);
+    viewState_.store(state);
+}
+
 // {{{ RenderBuffer synchronization
 void Terminal::breakLoopAndRefreshRenderBuffer()
 {
@@ -184,7 +882,14 @@ void Terminal::breakLoopAndRefreshRenderBuffer()
     if (this_thread::get_id() == mainLoopThreadID_)
         return;
 
-    pty_.wakeupReader();
+    if (inputPipeline_)
+    {
+        auto const _l = lock_guard{inputPipeline_->mutex};
+        inputPipeline_->wakeupRequested = true;
+        inputPipeline_->dataAvailable.notify_one();
+    }
+    else
+        pty_.wakeupReader();
 }
 
 bool Terminal::refreshRenderBuffer(std::chrono::steady_clock::time_point _now)
@@ -196,6 +901,12 @@ bool Terminal::refreshRenderBuffer(std::chrono::steady_clock::time_point _now)
 
 void Terminal::ensureFreshRenderBuffer(std::chrono::steady_clock::time_point _now)
 {
+    #if defined(LIBTERMINAL_PASSIVE_RENDER_BUFFER_UPDATE)
+    // Hidden terminals only parse, catching up once visible again (see setVisible()).
+    if (!visible_)
+        return;
+    #endif
+
     if (!renderBufferUpdateEnabled_)
     {
         renderBuffer_.state = RenderBufferState::WaitingForRefresh;
@@ -205,6 +916,13 @@ void Terminal::ensureFreshRenderBuffer(std::chrono::steady_clock::time_point _no
     auto const elapsed = _now - renderBuffer_.lastUpdate;
     auto const avoidRefresh = elapsed < refreshInterval_;
 
+    // The frame completing a synchronized output batch is shown right away.
+    if (batchCompleted_.exchange(false))
+        renderBuffer_.state = RenderBufferState::RefreshBuffersAndTrySwap;
+    // While flooded, even explicitly requested refreshes wait for the next refresh interval.
+    else if (throughputMode_ && avoidRefresh && renderBuffer_.state == RenderBufferState::RefreshBuffersAndTrySwap)
+        return;
+
     switch (renderBuffer_.state)
     {
         case RenderBufferState::WaitingForRefresh:
@@ -217,24 +935,49 @@ void Terminal::ensureFreshRenderBuffer(std::chrono::steady_clock::time_point _no
             renderBuffer_.state = RenderBufferState::TrySwapBuffers;
             [[fallthrough]];
         case RenderBufferState::TrySwapBuffers:
+        {
+            auto const outputTime = renderBuffer_.backBuffer().outputTime;
             #if !defined(LIBTERMINAL_PASSIVE_RENDER_BUFFER_UPDATE)
                 // We have been actively invoked by the render thread, so don't inform it about updates.
                 renderBuffer_.swapBuffers(_now);
+                latencyTrace_.record(LatencyStage::RenderBuffer, outputTime, steady_clock::now());
             #else
                 // Passively invoked by the terminal thread, so do inform render thread about updates.
                 if (renderBuffer_.swapBuffers(_now))
+                {
+                    latencyTrace_.record(LatencyStage::RenderBuffer, outputTime, steady_clock::now());
                     eventListener_.renderBufferUpdated();
+                }
             #endif
             break;
+        }
     }
 }
 
 void Terminal::refreshRenderBuffer(RenderBuffer& _output)
 {
     auto const _l = lock_guard{*this};
+    auto const _a = allocationTrace_.scope(AllocationPhase::RenderBuffer);
+    CRISPY_PROFILE_ZONE("Terminal::refreshRenderBuffer");
+
+    applyTypedInput();
+
+    // History lines must have been reflowed before they can be shown.
+    if (historyReflowPending_ && viewport_.absoluteScrollOffset().value_or(screen_.historyLineCount()) < screen_.pendingReflowLineCount())
+        reflowHistory(nullopt);
+
+    // Compressed history lines about to be scrolled into view are restored ahead of time.
+    if (viewport_.scrolled() && screen_.isPrimaryScreen())
+        historyPrefetcher_.update(screen_.grid(),
+                                  *viewport_.absoluteScrollOffset(),
+                                  screen_.size().height,
+                                  viewport_.scrollVelocity(steady_clock::now()));
+    else if (historyPrefetcher_.pageCount() != 0)
+        historyPrefetcher_.clear();
+
     auto const reverseVideo = screen_.isModeEnabled(terminal::DECMode::ReverseVideo);
     auto const baseLine = viewport_.absoluteScrollOffset().value_or(screen_.historyLineCount());
-    auto const renderHyperlinks = screen_.contains(currentMousePosition_);
+    auto const renderHyperlinks = hyperlinkHoverEnabled_.load() && screen_.contains(currentMousePosition_);
     auto const currentMousePositionRel = Coordinate{
         currentMousePosition_.row - viewport_.relativeScrollOffset(),
         currentMousePosition_.column
@@ -244,86 +987,164 @@ void Terminal::refreshRenderBuffer(RenderBuffer& _output)
 
     if (renderHyperlinks)
     {
-        auto& cellAtMouse = screen_.at(currentMousePositionRel);
-        if (cellAtMouse.hyperlink())
-            cellAtMouse.hyperlink()->state = HyperlinkState::Hover; // TODO: Left-Ctrl pressed?
+        if (auto* hyperlink = screen_.hyperlinkAt(currentMousePositionRel); hyperlink)
+            hyperlink->state = HyperlinkState::Hover; // TODO: Left-Ctrl pressed?
+    }
+
+    // {{{ RenderColors const& colorsOf(cell)
+    // Resolving colors against the palette is done only once per graphics rendition,
+    // as most cells on a screen share very few distinct renditions.
+    // See "invalidate cached rows" below for the palette and reverse video changes.
+    auto const& grid = screen_.grid();
+    if (renderAttributesVersion_ != grid.attributesTable().version())
+    {
+        renderAttributesVersion_ = grid.attributesTable().version();
+        ++renderColorGeneration_;
     }
+    renderColorCache_.resize(grid.attributesTable().size());
+    auto const colorsOf = [&](Cell const& _cell) -> RenderColors const&
+    {
+        RenderColors& colors = renderColorCache_[_cell.attributes()];
+        if (colors.generation != renderColorGeneration_)
+        {
+            auto const& attributes = grid.attributes(_cell);
+            auto const [fg, bg] = attributes.makeColors(screen_.colorPalette(), reverseVideo);
+            colors.foreground = fg;
+            colors.background = bg;
+            colors.decoration = attributes.getUnderlineColor(screen_.colorPalette());
+
+            // Same as above, but taking reverse video from the palette slots' colors instead.
+            auto const bright = (attributes.styles & CellFlags::Bold) != 0;
+            auto const inverse = (attributes.styles & CellFlags::Inverse) != 0;
+            colors.foregroundSlot = inverse
+                ? paletteSlot(attributes.backgroundColor, ColorTarget::Background, bright)
+                : paletteSlot(attributes.foregroundColor, ColorTarget::Foreground, bright);
+            colors.backgroundSlot = inverse
+                ? paletteSlot(attributes.foregroundColor, ColorTarget::Foreground, false)
+                : paletteSlot(attributes.backgroundColor, ColorTarget::Background, false);
+            colors.decorationSlot = attributes.underlineColor.type == ColorType::Default
+                                 || attributes.underlineColor.type == ColorType::Undefined
+                ? PaletteSlot::DefaultUnderline
+                : paletteSlot(attributes.underlineColor, ColorTarget::Foreground, bright);
+            colors.flags = attributes.styles;
+            colors.generation = renderColorGeneration_;
+        }
+        return colors;
+    }; // }}}
 
-    // {{{ void appendCell(pos, cell, fg, bg)
-    auto const appendCell = [&](Coordinate const& _pos, Cell const& _cell,
-                                RGBColor fg, RGBColor bg)
+    // {{{ void appendCell(row, pos, cell, fg, bg, paletteColors)
+    auto const appendCell = [&](RenderRow& _row, Coordinate const& _pos, Cell const& _cell,
+                                RGBColor fg, RGBColor bg, bool _paletteColors)
     {
+        RenderColors const& colors = colorsOf(_cell);
         RenderCell cell;
         cell.backgroundColor = bg;
         cell.foregroundColor = fg;
-        cell.decorationColor = _cell.attributes().getUnderlineColor(screen_.colorPalette());
+        cell.decorationColor = colors.decoration;
+        cell.decorationSlot = colors.decorationSlot;
+        if (_paletteColors)
+        {
+            cell.foregroundSlot = colors.foregroundSlot;
+            cell.backgroundSlot = colors.backgroundSlot;
+        }
         cell.position = _pos;
-        cell.flags = _cell.attributes().styles;
+        cell.flags = colors.flags;
 
         if (!_cell.codepoints().empty())
         {
 #if defined(LIBTERMINAL_IMAGES)
-            assert(!_cell.imageFragment().has_value());
+            assert(!_cell.hasImage());
 #endif
-            cell.codepoints = _cell.codepoints();
+            auto const codepoints = _cell.codepoints();
+            cell.codepointOffset = static_cast<uint32_t>(_row.codepoints.size());
+            cell.codepointCount = static_cast<uint32_t>(codepoints.size());
+            _row.codepoints.insert(_row.codepoints.end(), codepoints.begin(), codepoints.end());
         }
 #if defined(LIBTERMINAL_IMAGES)
-        else if (optional<ImageFragment> const& fragment = _cell.imageFragment(); fragment.has_value())
+        else if (_cell.hasImage())
         {
             assert(_cell.codepoints().empty());
             cell.flags |= CellFlags::Image; // TODO: this should already be there.
-            cell.image = _cell.imageFragment();
+            cell.image = grid.imageFragment(_cell);
         }
 #endif
 
-        if (_cell.hyperlink())
+        if (auto const* hyperlink = screen_.hyperlinks().find(_cell.hyperlink()); hyperlink)
         {
-            auto const& color = _cell.hyperlink()->state == HyperlinkState::Hover
+            auto const& color = hyperlink->state == HyperlinkState::Hover
                                 ? screen_.colorPalette().hyperlinkDecoration.hover
                                 : screen_.colorPalette().hyperlinkDecoration.normal;
             // TODO(decoration): Move property into Terminal.
-            auto const decoration = _cell.hyperlink()->state == HyperlinkState::Hover
+            auto const decoration = hyperlink->state == HyperlinkState::Hover
                                     ? CellFlags::Underline          // TODO: decorationRenderer_.hyperlinkHover()
                                     : CellFlags::DottedUnderline;   // TODO: decorationRenderer_.hyperlinkNormal();
             cell.flags |= decoration; // toCellStyle(decoration);
             cell.decorationColor = color;
+            cell.decorationSlot = PaletteSlot::None;
+            _row.hyperlinks = true;
         }
 
-        _output.screen.emplace_back(std::move(cell));
+        _row.cells.emplace_back(std::move(cell));
     }; // }}}
 
-    screenDirty_ = false;
-    _output.clear();
-
-    enum class State {
-        Gap,
-        Sequence,
-    };
-    State state = State::Gap;
-
-    int lineNr = 1;
-    screen_.render(
-        [&](Coordinate const& _pos, Cell const& _cell) // mutable
+    // {{{ void renderRow(row, rowNumber, line, selected, highlights)
+    using SearchMatches = crispy::range<vector<SearchMatch>::const_iterator>;
+    auto const renderRow = [&](RenderRow& _row, int _rowNumber, Line const& _line, bool _selected,
+                               SearchMatches _highlights)
+    {
+        enum class State {
+            Gap,
+            Sequence,
+        };
+        State state = State::Gap;
+
+        _row.line = &_line;
+        _row.generation = _line.generation();
+        _row.selected = _selected;
+        _row.highlighted = !_highlights.empty();
+        _row.hyperlinks = false;
+        _row.version = ++renderRowVersion_;
+        _row.number = _rowNumber;
+        _row.cells.clear();
+        _row.codepoints.clear();
+        _row.hyperlinkSpans.clear();
+
+        // Cells are tested against the row's selected columns rather than the selector itself.
+        auto const selectedColumns = _selected ? selectedColumnsAbsolute(baseLine + (_rowNumber - 1))
+                                               : nullopt;
+
+        // Matches of highlighting triggers are shown like search highlights.
+        auto const& triggers = screen_.triggers();
+        auto const& triggerMatches = _line.triggerMatches();
+        auto const triggerHighlighted = [&](int _firstColumn, int _lastColumn) {
+            return std::any_of(triggerMatches.begin(), triggerMatches.end(), [&](TriggerMatch const& _match) {
+                return _match.firstColumn <= _lastColumn && _firstColumn <= _match.lastColumn
+                    && triggers.performs(_match.trigger, TriggerAction::Highlight);
+            });
+        };
+
+        auto const renderCell = [&](Coordinate const& _pos, Cell const& _cell)
         {
-            auto const absolutePos = Coordinate{baseLine + (_pos.row - 1), _pos.column};
-            auto const selected = isSelectedAbsolute(absolutePos);
-            auto const [fg, bg] = makeColors(screen_.colorPalette(), _cell, reverseVideo, selected);
+            auto const selected = selectedColumns.has_value()
+                               && crispy::ascending(selectedColumns->fromColumn, _pos.column, selectedColumns->toColumn);
+            auto const highlighted = !selected && (std::any_of(_highlights.begin(), _highlights.end(), [&](SearchMatch const& _match) {
+                return crispy::ascending(_match.firstColumn, _pos.column, _match.lastColumn);
+            }) || triggerHighlighted(_pos.column, _pos.column));
+            RenderColors const& colors = colorsOf(_cell);
+            auto const [fg, bg] = highlighted
+                ? makeSearchHighlightColors(screen_.colorPalette(), colors.foreground, colors.background)
+                : makeColors(screen_.colorPalette(), colors.foreground, colors.background, selected);
 
             auto const cellEmpty = (_cell.codepoints().empty() || _cell.codepoints()[0] == 0x20)
 #if defined(LIBTERMINAL_IMAGES)
-                                && !_cell.imageFragment().has_value()
+                                && !_cell.hasImage()
 #endif
                                 ;
-            auto const customBackground = bg != screen_.colorPalette().defaultBackground;
-
-            bool isNewLine = false;
-            if (lineNr != _pos.row)
-            {
-                isNewLine = true;
-                lineNr = _pos.row;
-                if (!_output.screen.empty())
-                    _output.screen.back().flags |= CellFlags::CellSequenceEnd;
-            }
+            // Cells with a background from the palette other than the default one are kept
+            // even if currently showing the default color, as the palette may change.
+            auto const paletteColors = !selected && !highlighted;
+            auto const customBackground = bg != screen_.colorPalette().defaultBackground
+                                       || (paletteColors && colors.backgroundSlot != PaletteSlot::DefaultBackground);
 
             switch (state)
             {
@@ -331,37 +1152,305 @@ void Terminal::refreshRenderBuffer(RenderBuffer& _output)
                     if (!cellEmpty || customBackground)
                     {
                         state = State::Sequence;
-                        appendCell(_pos, _cell, fg, bg);
-                        _output.screen.back().flags |= CellFlags::CellSequenceStart;
+                        appendCell(_row, _pos, _cell, fg, bg, paletteColors);
+                        _row.cells.back().flags |= CellFlags::CellSequenceStart;
                     }
                     break;
                 case State::Sequence:
                     if (cellEmpty && !customBackground)
                     {
-                        _output.screen.back().flags |= CellFlags::CellSequenceEnd;
+                        _row.cells.back().flags |= CellFlags::CellSequenceEnd;
                         state = State::Gap;
                     }
                     else
-                    {
-                        appendCell(_pos, _cell, fg, bg);
+                        appendCell(_row, _pos, _cell, fg, bg, paletteColors);
+                    break;
+            }
+        };
+
+        // Trailing blank cells not allocated are rendered without restoring them (see Line::trim()).
+        for (auto const && [columnNumber, cell] : crispy::indexed(_line.untrimmedCells(), 1))
+        {
+            renderCell(Coordinate{_rowNumber, columnNumber}, cell);
 
-                        if (isNewLine)
-                            _output.screen.back().flags |= CellFlags::CellSequenceStart;
+            if (auto const hyperlink = cell.hyperlink(); hyperlink != NoHyperlinkId)
+            {
+                auto& spans = _row.hyperlinkSpans;
+                if (!spans.empty() && spans.back().hyperlink == hyperlink && spans.back().lastColumn + 1 == columnNumber)
+                    spans.back().lastColumn = columnNumber;
+                else
+                    spans.push_back(HyperlinkSpan{Coordinate{_rowNumber, columnNumber}, columnNumber, hyperlink});
+            }
+        }
+
+        // Trailing blank cells are only looked at one by one if any of them may end up visible.
+        auto const renderBlanks = [&](int _firstColumn, int _count, Cell const& _blank)
+        {
+            if (_count <= 0)
+                return;
+
+            auto const lastColumn = _firstColumn + _count - 1;
+            auto const selected = selectedColumns.has_value()
+                               && selectedColumns->fromColumn <= lastColumn
+                               && _firstColumn <= selectedColumns->toColumn;
+            auto const highlighted = std::any_of(_highlights.begin(), _highlights.end(), [&](SearchMatch const& _match) {
+                return _match.firstColumn <= lastColumn && _firstColumn <= _match.lastColumn;
+            }) || triggerHighlighted(_firstColumn, lastColumn);
+            if (!selected && !highlighted)
+            {
+                if (RenderColors const& colors = colorsOf(_blank);
+                        colors.background == screen_.colorPalette().defaultBackground
+                        && colors.backgroundSlot == PaletteSlot::DefaultBackground)
+                {
+                    if (state == State::Sequence)
+                    {
+                        _row.cells.back().flags |= CellFlags::CellSequenceEnd;
+                        state = State::Gap;
                     }
-                    break;
+                    return;
+                }
             }
-        },
-        viewport_.absoluteScrollOffset()
-    );
+
+            for (auto const columnNumber : crispy::times(_firstColumn, _count))
+                renderCell(Coordinate{_rowNumber, columnNumber}, _blank);
+        };
+
+        auto const untrimmedCellCount = _line.size() - _line.trimmedCellCount();
+        renderBlanks(untrimmedCellCount + 1, _line.trimmedCellCount(), Cell{{}, _line.trimmedAttributes()});
+        renderBlanks(_line.size() + 1, screen_.size().width - _line.size(), Cell{});
+
+        if (!_row.cells.empty())
+            _row.cells.back().flags |= CellFlags::CellSequenceEnd;
+
+        // Links detected in the plain text can be hovered just like hyperlinks, but are only decorated
+        // while hovered. Lines not scanned for them yet are left alone while bulk output is written.
+        if (_line.linksDetected() || screen_.eagerLinkDetection())
+        {
+            auto& spans = _row.hyperlinkSpans;
+            auto const hyperlinkSpanCount = spans.size();
+            for (DetectedLink const& link : _line.detectedLinks())
+                spans.push_back(HyperlinkSpan{Coordinate{_rowNumber, link.firstColumn}, link.lastColumn, NoHyperlinkId});
+            std::inplace_merge(spans.begin(), spans.begin() + static_cast<ptrdiff_t>(hyperlinkSpanCount), spans.end(),
+                               [](HyperlinkSpan const& a, HyperlinkSpan const& b) { return a.start < b.start; });
+        }
+
+        if (renderHoveredLink_ && renderHoveredLink_->row == _rowNumber)
+        {
+            for (RenderCell& cell : _row.cells)
+            {
+                if (renderHoveredLink_->link.contains(cell.position.column))
+                {
+                    cell.flags |= CellFlags::Underline;
+                    cell.decorationColor = screen_.colorPalette().hyperlinkDecoration.hover;
+                    cell.decorationSlot = PaletteSlot::None;
+                }
+            }
+        }
+    }; // }}}
+
+    screenDirty_ = false;
+    _output.clear();
+    _output.outputTime = std::exchange(outputTime_, Timestamp{});
+
+    // {{{ invalidate cached rows
+    // Rows are only rendered again if their line has been modified or moved, or if their
+    // selection or hyperlink hover state may have changed. Anything else affecting all
+    // cells at once invalidates all rows.
+    auto const paletteChanged = renderPaletteVersion_ == 0
+                             || renderReverseVideo_ != reverseVideo
+                             || renderColorPalette_ != screen_.colorPalette();
+    if (paletteChanged)
+    {
+        renderReverseVideo_ = reverseVideo;
+        renderColorPalette_ = screen_.colorPalette();
+        renderPalette_ = RenderPalette(renderColorPalette_, reverseVideo);
+        ++renderPaletteVersion_;
+        ++renderColorGeneration_;
+    }
+
+    if (renderRows_.size() != static_cast<size_t>(screen_.size().height)
+        || renderRowWidth_ != screen_.size().width)
+    {
+        renderRows_.clear();
+        renderRows_.resize(static_cast<size_t>(screen_.size().height));
+        renderRowWidth_ = screen_.size().width;
+    }
+    else if (paletteChanged)
+    {
+        // Palette changes and reverse video merely recolor the cells from their palette slots,
+        // rather than rendering them again from the grid.
+        // Only hyperlink decorations are taken from the palette otherwise.
+        auto const hoveredLinkRow = renderHoveredLink_ ? renderHoveredLink_->row : 0;
+        for (size_t i = 0; i < renderRows_.size(); ++i)
+        {
+            RenderRow& row = renderRows_[i];
+            if (row.hyperlinks || static_cast<int>(i + 1) == hoveredLinkRow)
+                row.line = nullptr;
+            else
+            {
+                for (RenderCell& cell : row.cells)
+                    recolor(cell, renderPalette_);
+                row.version = ++renderRowVersion_;
+            }
+        }
+    }
+    _output.palette = renderPalette_;
+    _output.paletteVersion = renderPaletteVersion_;
+
+    // Rows of lines moved by scrolling, be it the viewport or new output, are moved along with
+    // their lines rather than rendered again, keeping their version. The renderer can then move
+    // their pixels instead of rendering them again, too.
+    auto const page = grid.pageAtScrollOffset(viewport_.absoluteScrollOffset());
+    auto const movedRows = [&]() -> int {
+        auto const rowCount = static_cast<int>(renderRows_.size());
+        auto lineIter = page.begin();
+        for (int i = 0; i < rowCount && lineIter != page.end(); ++i, ++lineIter)
+        {
+            if (i > 0 && renderRows_[static_cast<size_t>(i)].line == &*page.begin())
+                return i;
+            if (i > 0 && renderRows_[0].line == &*lineIter)
+                return -i;
+        }
+        return 0;
+    }();
+    if (movedRows > 0)
+    {
+        std::rotate(renderRows_.begin(), renderRows_.begin() + movedRows, renderRows_.end());
+        for (auto i = renderRows_.size() - static_cast<size_t>(movedRows); i < renderRows_.size(); ++i)
+            renderRows_[i].line = nullptr;
+    }
+    else if (movedRows < 0)
+    {
+        std::rotate(renderRows_.begin(), renderRows_.end() + movedRows, renderRows_.end());
+        for (auto i = size_t{0}; i < static_cast<size_t>(-movedRows); ++i)
+            renderRows_[i].line = nullptr;
+    }
+
+    auto const hoveredHyperlink = renderHyperlinks ? screen_.at(currentMousePositionRel).hyperlink() : NoHyperlinkId;
+    auto const hoverChanged = hoveredHyperlink != renderHoveredHyperlink_;
+    renderHoveredHyperlink_ = hoveredHyperlink;
+
+    // Links detected in the plain text are only looked for where there is no hyperlink.
+    auto const hoveredLink = [&]() -> optional<HoveredLink> {
+        if (!renderHyperlinks || hoveredHyperlink != NoHyperlinkId)
+            return nullopt;
+        if (auto const link = screen_.detectedLinkAt(currentMousePositionRel); link)
+            return HoveredLink{currentMousePosition_.row, *link};
+        return nullopt;
+    }();
+    auto const linkHoverChanged = hoveredLink.has_value() != renderHoveredLink_.has_value()
+                               || (hoveredLink && (hoveredLink->row != renderHoveredLink_->row
+                                                   || hoveredLink->link != renderHoveredLink_->link));
+    auto const linkHoverRows = pair{renderHoveredLink_ ? renderHoveredLink_->row : 0,
+                                    hoveredLink ? hoveredLink->row : 0};
+    renderHoveredLink_ = hoveredLink;
+
+    // Selected cells are rendered in the selection colors, unless left to the renderer to draw on top.
+    auto const selectionOverlay = selectionOverlay_.load();
+    auto const selectedRows = [&]() -> optional<pair<int, int>> {
+        if (!isSelectionAvailable())
+            return nullopt;
+        return pair{min(selector_->from().row, selector_->to().row),
+                    max(selector_->from().row, selector_->to().row)};
+    }();
+    // }}}
+
+    Grid const& backgroundGrid = screen_.backgroundGrid();
+    bool rowsRendered = !hyperlinkSpans_;
+    auto rowNumber = 0;
+    for (Line const& line : page) // not crispy::indexed(), which yields copies, as rows refer to their line
+    {
+        ++rowNumber;
+        RenderRow& row = renderRows_[static_cast<size_t>(rowNumber - 1)];
+        auto const absoluteRow = baseLine + rowNumber - 1;
+        auto const rowSelected = selectedRows.has_value() && crispy::ascending(selectedRows->first, absoluteRow, selectedRows->second);
+        auto const selected = rowSelected && !selectionOverlay;
+        if (rowSelected && selectionOverlay)
+            if (auto const columns = selectedColumnsAbsolute(absoluteRow); columns)
+                _output.selection.push_back(RenderSelection{rowNumber, columns->fromColumn, columns->toColumn});
+        auto const [highlightsBegin, highlightsEnd] = std::equal_range(
+            searchHighlights_.begin(),
+            searchHighlights_.end(),
+            SearchMatch{absoluteRow, 0, 0},
+            [](SearchMatch const& a, SearchMatch const& b) { return a.line < b.line; }
+        );
+        auto const highlights = SearchMatches(highlightsBegin, highlightsEnd);
+
+        // Rows showing the same on the primary and alternate screen are kept when switching between
+        // them, as their lines have taken over the generation of their counterpart (see Grid::touchPage()).
+        if (row.line && row.line != &line && !viewport_.scrolled()
+                && rowNumber <= backgroundGrid.screenSize().height
+                && row.line == &backgroundGrid.lineAt(rowNumber)
+                && row.generation == line.generation())
+            row.line = &line;
+
+        // Predicted characters are rendered into a copy of their line, so that the row gets rendered
+        // again from the line itself as soon as they have been confirmed or rolled back.
+        if (!predictions_.empty() && !viewport_.scrolled() && rowNumber == predictions_.front().position.row)
+        {
+            auto predicted = Line(line);
+            for (PredictedCell const& prediction : predictions_)
+                predicted[static_cast<size_t>(prediction.position.column - 1)].setCharacter(prediction.codepoint);
+            renderRow(row, rowNumber, predicted, selected, highlights);
+            row.line = nullptr;
+            for (RenderCell& cell : row.cells)
+                if (crispy::ascending(predictions_.front().position.column,
+                                      cell.position.column,
+                                      predictions_.back().position.column))
+                    cell.flags |= CellFlags::Underline;
+            rowsRendered = true;
+        }
+        // Rows with highlights are rendered again, as highlights refer to absolute lines.
+        else if (row.line != &line || row.generation != line.generation()
+            || selected || row.selected
+            || !highlights.empty() || row.highlighted
+            || (hoverChanged && row.hyperlinks)
+            || (linkHoverChanged && (rowNumber == linkHoverRows.first || rowNumber == linkHoverRows.second)))
+        {
+            renderRow(row, rowNumber, line, selected, highlights);
+            rowsRendered = true;
+        }
+        else if (row.number != rowNumber)
+        {
+            row.number = rowNumber;
+            for (RenderCell& cell : row.cells)
+                cell.position.row = rowNumber;
+            for (HyperlinkSpan& span : row.hyperlinkSpans)
+                span.start.row = rowNumber;
+            rowsRendered = rowsRendered || !row.hyperlinkSpans.empty();
+        }
+
+        _output.rowVersions.push_back(row.version);
+
+        // Cached cells refer to the row's own codepoints, so rebase them onto the output's arena.
+        auto const codepointBase = static_cast<uint32_t>(_output.codepoints.size());
+        _output.codepoints.insert(_output.codepoints.end(), row.codepoints.begin(), row.codepoints.end());
+        for (RenderCell const& cell : row.cells)
+        {
+            _output.screen.emplace_back(cell);
+            _output.screen.back().codepointOffset += codepointBase;
+        }
+    }
+
+    if (rowsRendered)
+    {
+        auto spans = HyperlinkSpans{};
+        for (RenderRow const& row : renderRows_)
+            spans.insert(spans.end(), row.hyperlinkSpans.begin(), row.hyperlinkSpans.end());
+        atomic_store(&hyperlinkSpans_, shared_ptr<HyperlinkSpans const>(make_shared<HyperlinkSpans>(move(spans))));
+    }
 
     if (renderHyperlinks)
     {
-        auto& cellAtMouse = screen_.at(currentMousePositionRel);
-        if (cellAtMouse.hyperlink())
-            cellAtMouse.hyperlink()->state = HyperlinkState::Inactive;
+        if (auto* hyperlink = screen_.hyperlinkAt(currentMousePositionRel); hyperlink)
+            hyperlink->state = HyperlinkState::Inactive;
     }
 
+    _output.buildRuns();
+
     _output.cursor = renderCursor();
+    if (_output.cursor && !predictions_.empty() && !viewport_.scrolled())
+        _output.cursor->position.column = min(predictions_.back().position.column + 1, screen_.size().width);
 }
 
 optional<RenderCursor> Terminal::renderCursor()
@@ -392,6 +1481,7 @@ optional<RenderCursor> Terminal::renderCursor()
 
 bool Terminal::sendKeyPressEvent(KeyInputEvent const& _keyEvent, chrono::steady_clock::time_point _now)
 {
+    auto const _a = allocationTrace_.scope(AllocationPhase::Input);
     cursorBlinkState_ = 1;
     lastCursorBlink_ = _now;
 
@@ -400,17 +1490,30 @@ bool Terminal::sendKeyPressEvent(KeyInputEvent const& _keyEvent, chrono::steady_
         return true;
 
     viewport_.scrollToBottom();
-    bool const success = inputGenerator_.generate(_keyEvent.key, _keyEvent.modifier);
-    if (success)
+
+    // Keys such as backspace or the cursor keys edit the prompt in ways not predicted.
+    if (predictiveEcho_)
+    {
+        typedInput_.push(TypedInput{nullopt, _now});
+        breakLoopAndRefreshRenderBuffer();
+    }
+
+    // Written straight from the precomputed key sequence table, after anything still pending.
+    auto const sequence = inputGenerator_.sequence(_keyEvent.key, _keyEvent.modifier);
+    flushInput(_now);
+    if (!sequence.empty())
+    {
         debuglog(InputTag).write("Sending {}.", _keyEvent);
+        writeToPty(sequence, _now);
+    }
 
-    flushInput();
     viewport_.scrollToBottom();
-    return success;
+    return !sequence.empty();
 }
 
 bool Terminal::sendCharPressEvent(CharInputEvent const& _charEvent, steady_clock::time_point _now)
 {
+    auto const _a = allocationTrace_.scope(AllocationPhase::Input);
     cursorBlinkState_ = 1;
     lastCursorBlink_ = _now;
 
@@ -422,13 +1525,105 @@ bool Terminal::sendCharPressEvent(CharInputEvent const& _charEvent, steady_clock
     if (success)
         debuglog(InputTag).write("Sending {}.", _charEvent);
 
-    flushInput();
+    flushInput(_now);
     viewport_.scrollToBottom();
+
+    if (success && predictiveEcho_)
+    {
+        typedInput_.push(TypedInput{_charEvent, _now});
+        breakLoopAndRefreshRenderBuffer();
+    }
+
     return success;
 }
 
+void Terminal::setPredictiveEcho(bool _enabled)
+{
+    predictiveEcho_ = _enabled;
+    predictions_.clear();
+    breakLoopAndRefreshRenderBuffer();
+}
+
+void Terminal::applyTypedInput()
+{
+    while (auto input = typedInput_.try_pop())
+    {
+        if (input->character)
+            predictEcho(*input->character, input->time);
+        else
+            predictions_.clear();
+    }
+}
+
+void Terminal::predictEcho(CharInputEvent const& _charEvent, Timestamp _now)
+{
+    // Only plain characters typed at the end of the prompt line are predicted.
+    auto const position = predictions_.empty()
+        ? screen_.cursor().position
+        : Coordinate{predictions_.back().position.row, predictions_.back().position.column + 1};
+    auto const predictable = [&]() {
+        if (!(U' ' <= _charEvent.value && _charEvent.value < 0x7F)
+            || _charEvent.modifier.without(Modifier::Shift).some()
+            || !screen_.isPrimaryScreen()
+            || viewport_.scrolled()
+            || screen_.wrapPending()
+            || position.column > screen_.size().width
+            || !screen_.grid().lineAt(position.row).marked())
+            return false;
+        for (int column = position.column; column <= screen_.size().width; ++column)
+            if (!screen_.at(Coordinate{position.row, column}).empty())
+                return false;
+        return true;
+    }();
+
+    if (!predictable)
+    {
+        if (predictions_.empty())
+            return;
+        predictions_.clear();
+    }
+    else
+    {
+        predictions_.emplace_back(PredictedCell{position, _charEvent.value});
+        predictionTime_ = _now;
+    }
+}
+
+void Terminal::confirmPredictions(Timestamp _now)
+{
+    // The echo confirms predictions in the order they have been typed.
+    auto confirmed = predictions_.begin();
+    while (confirmed != predictions_.end())
+    {
+        Cell const& cell = screen_.at(confirmed->position);
+        if (cell.codepointCount() != 1 || cell.codepoint(0) != confirmed->codepoint)
+            break;
+        ++confirmed;
+    }
+    if (confirmed != predictions_.begin())
+    {
+        predictions_.erase(predictions_.begin(), confirmed);
+        predictionTime_ = _now;
+    }
+
+    // Anything but the remaining echo still to come rolls the remaining predictions back.
+    if (predictions_.empty())
+        return;
+
+    auto const cursor = screen_.cursor().position;
+    if (!screen_.isPrimaryScreen()
+        || cursor != predictions_.front().position
+        || !screen_.at(cursor).empty()
+        || !screen_.grid().lineAt(cursor.row).marked())
+    {
+        debuglog(TerminalTag).write("Rolling back {} predicted characters.", predictions_.size());
+        predictions_.clear();
+    }
+}
+
 bool Terminal::sendMousePressEvent(MousePressEvent const& _mousePress, chrono::steady_clock::time_point _now)
 {
+    auto const _a = allocationTrace_.scope(AllocationPhase::Input);
     respectMouseProtocol_ = mouseProtocolBypassModifier_ == Modifier::None
                          || !_mousePress.modifier.contains(mouseProtocolBypassModifier_);
 
@@ -491,8 +1686,24 @@ void Terminal::clearSelection()
     breakLoopAndRefreshRenderBuffer();
 }
 
+SearchSnapshot Terminal::searchSnapshot() const
+{
+    auto const _l = lock_guard{*this};
+    return screen_.grid().searchSnapshot();
+}
+
+void Terminal::setSearchHighlights(vector<SearchMatch> _matches)
+{
+    {
+        auto const _l = lock_guard{*this};
+        searchHighlights_ = move(_matches);
+    }
+    breakLoopAndRefreshRenderBuffer();
+}
+
 bool Terminal::sendMouseMoveEvent(MouseMoveEvent const& _mouseMove, chrono::steady_clock::time_point /*_now*/)
 {
+    auto const _a = allocationTrace_.scope(AllocationPhase::Input);
     auto const newPosition = _mouseMove.coordinates();
     bool const positionChanged = newPosition != currentMousePosition_;
 
@@ -505,13 +1716,13 @@ bool Terminal::sendMouseMoveEvent(MouseMoveEvent const& _mouseMove, chrono::stea
     {
         debuglog(InputTag).write("Sending {}.", _mouseMove);
         flushInput();
-        return true;
+        return changed;
     }
 
     speedClicks_ = 0;
 
     if (!positionChanged)
-        return true;
+        return changed;
 
     if (leftMouseButtonPressed_ && !selectionAvailable())
     {
@@ -539,6 +1750,7 @@ bool Terminal::sendMouseMoveEvent(MouseMoveEvent const& _mouseMove, chrono::stea
 
 bool Terminal::sendMouseReleaseEvent(MouseReleaseEvent const& _mouseRelease, chrono::steady_clock::time_point /*_now*/)
 {
+    auto const _a = allocationTrace_.scope(AllocationPhase::Input);
     MouseReleaseEvent const withPosition{_mouseRelease.button,
                                          _mouseRelease.modifier,
                                          currentMousePosition_.row,
@@ -605,10 +1817,21 @@ bool Terminal::sendFocusOutEvent()
     return false;
 }
 
-void Terminal::sendPaste(string_view _text)
+void Terminal::sendPaste(string _text, bool _sanitize)
 {
     debuglog(InputTag).write("Sending paste of {} bytes.", _text.size());
-    inputGenerator_.generatePaste(_text);
+    if (_sanitize)
+        sanitizePaste(_text);
+
+    // The text itself is handed over to the PTY writer as is, only the brackets go through
+    // the input generator, so that even huge pastes are not copied around.
+    inputGenerator_.generatePasteBegin();
+    flushInput();
+    if (ptyWriter_)
+        ptyWriter_->write(make_shared<string const>(move(_text)));
+    else
+        writeToPty(_text);
+    inputGenerator_.generatePasteEnd();
     flushInput();
 }
 
@@ -618,7 +1841,7 @@ void Terminal::sendRaw(string_view _text)
     flushInput();
 }
 
-void Terminal::flushInput()
+void Terminal::flushInput(Timestamp _origin)
 {
     inputGenerator_.swap(pendingInput_);
     if (pendingInput_.empty())
@@ -626,15 +1849,104 @@ void Terminal::flushInput()
 
     // XXX Should be the only location that does write to the PTY's stdin to avoid race conditions.
     debuglog(InputTag).write("Flushing input: \"{}\"", crispy::escape(begin(pendingInput_), end(pendingInput_)));
-    pty_.write(pendingInput_.data(), pendingInput_.size());
+    writeToPty(string_view(pendingInput_.data(), pendingInput_.size()), _origin);
     pendingInput_.clear();
 }
 
-void Terminal::writeToScreen(char const* data, size_t size)
+void Terminal::writeToPty(string_view _data, Timestamp _origin)
+{
+    if (ptyWriter_)
+        ptyWriter_->write(_data, _origin);
+    else
+    {
+        pty_.write(_data.data(), _data.size());
+        latencyTrace_.record(LatencyStage::InputWritten, _origin, steady_clock::now());
+    }
+}
+
+void Terminal::writeToScreen(char const* data, size_t size, steady_clock::time_point _received)
+{
+    auto const sliceSize = parseSliceSize();
+    auto const eagerLinkDetection = size < EagerLinkDetectionMaxBytes;
+    auto parseTime = steady_clock::duration::zero();
+    for (size_t offset = 0; offset < size; offset += sliceSize)
+    {
+        if (offset)
+        {
+            // Lets the threads waiting for the lock have it, and notifies about the screen update
+            // just as if the slice parsed before had been read on its own.
+            this_thread::yield();
+            auto const now = steady_clock::now();
+            updateThroughputMode(now);
+            if (screenUpdatePending_ && visible_ && !throughputMode_)
+                flushScreenUpdate(now);
+        }
+
+        auto const sliceStart = steady_clock::now();
+        auto const batchCompleted = writeSliceToScreen(data + offset, min(sliceSize, size - offset), _received, eagerLinkDetection);
+        parseTime += steady_clock::now() - sliceStart;
+        if (batchCompleted)
+            flushScreenUpdate(steady_clock::now());
+    }
+    parseStats_.record(size, parseTime);
+    lastWriteTime_ = steady_clock::now().time_since_epoch().count();
+    latencyTrace_.record(LatencyStage::Parsed, _received, steady_clock::now());
+}
+
+bool Terminal::writeSliceToScreen(char const* data, size_t size, Timestamp _received, bool _eagerLinkDetection)
 {
     auto const _l = lock_guard{*this};
+    auto const _a = allocationTrace_.scope(AllocationPhase::Parse, size);
+    CRISPY_PROFILE_ZONE("Terminal::writeToScreen");
+    CRISPY_PROFILE_COUNTER("bytes parsed", size);
+    applyTypedInput();
+    screen_.setEagerLinkDetection(_eagerLinkDetection);
     screen_.write(data, size);
-    renderBufferUpdateEnabled_ = !screen_.isModeEnabled(DECMode::BatchedRendering);
+    if (!predictions_.empty())
+        confirmPredictions(_received);
+    publishViewState();
+    throughputBytes_ += size;
+    auto const batchCompleted = updateSynchronizedOutput(_received);
+    if (outputTime_ == Timestamp{})
+        outputTime_ = _received;
+    return batchCompleted;
+}
+
+size_t Terminal::parseSliceSize() const noexcept
+{
+    auto const& settings = parseSliceSettings_;
+    if (settings.timeBudget.count() <= 0)
+        return numeric_limits<size_t>::max();
+
+    auto const time = parseStats_.time();
+    if (time.count() <= 0)
+        return max(settings.minSize, size_t{1});
+
+    auto const bytesPerMicrosecond = static_cast<double>(parseStats_.bytes()) * 1000.0 / static_cast<double>(time.count());
+    return max({ settings.minSize,
+                 size_t{1},
+                 static_cast<size_t>(bytesPerMicrosecond * static_cast<double>(settings.timeBudget.count())) });
+}
+
+bool Terminal::updateSynchronizedOutput(Timestamp _now)
+{
+    auto batching = screen_.isModeEnabled(DECMode::BatchedRendering);
+    if (batching && batchStart_ == Timestamp{})
+        batchStart_ = _now;
+    else if (batching && _now - batchStart_ >= synchronizedOutputTimeout_)
+    {
+        debuglog(TerminalTag).write("Ending synchronized output not completed within {}ms.", synchronizedOutputTimeout_.count());
+        screen_.setMode(DECMode::BatchedRendering, false);
+        batching = false;
+    }
+
+    renderBufferUpdateEnabled_ = !batching;
+    if (batching || batchStart_ == Timestamp{})
+        return false;
+
+    latencyTrace_.record(LatencyStage::SynchronizedOutput, std::exchange(batchStart_, Timestamp{}), _now);
+    batchCompleted_ = true;
+    return true;
 }
 
 // TODO: this family of functions seems we don't need anymore
@@ -657,17 +1969,26 @@ void Terminal::updateCursorVisibilityState(std::chrono::steady_clock::time_point
 
 bool Terminal::updateCursorHoveringState()
 {
-    if (!screen_.contains(currentMousePosition_))
-        return false;
-
-    auto const relCursorPos = terminal::Coordinate{
-        currentMousePosition_.row - viewport_.relativeScrollOffset(),
-        currentMousePosition_.column
-    };
+    // Looked up in the most recently rendered frame, as mouse moves must not wait for the parser.
+    auto hovered = NoHyperlinkId;
+    auto hoveredLink = Coordinate{};
+    if (auto const spans = atomic_load(&hyperlinkSpans_); spans)
+    {
+        auto const i = upper_bound(spans->begin(), spans->end(), currentMousePosition_,
+                                   [](Coordinate const& _pos, HyperlinkSpan const& _span) { return _pos < _span.start; });
+        if (i != spans->begin()
+            && prev(i)->start.row == currentMousePosition_.row
+            && currentMousePosition_.column <= prev(i)->lastColumn)
+        {
+            hovered = prev(i)->hyperlink;
+            if (hovered == NoHyperlinkId)
+                hoveredLink = prev(i)->start;
+        }
+    }
 
-    auto const newState = screen_.contains(currentMousePosition_) && screen_.at(relCursorPos).hyperlink();
-    auto const oldState = hoveringHyperlink_.exchange(newState);
-    return newState != oldState;
+    hoveringHyperlink_ = hovered != NoHyperlinkId || hoveredLink != Coordinate{};
+    auto const linkChanged = hoveredLinkStart_.exchange(hoveredLink) != hoveredLink;
+    return (hoveredHyperlink_.exchange(hovered) != hovered) || linkChanged;
 }
 
 std::chrono::milliseconds Terminal::nextRender(chrono::steady_clock::time_point _now) const
@@ -680,14 +2001,31 @@ std::chrono::milliseconds Terminal::nextRender(chrono::steady_clock::time_point
 }
 
 void Terminal::resizeScreen(Size _cells, optional<Size> _pixels)
+{
+    resizePage(_cells, _pixels);
+    resizePty(_cells, _pixels);
+}
+
+void Terminal::resizePage(Size _cells, optional<Size> _pixels)
 {
     auto const _l = lock_guard{*this};
 
+    // Only the page is reflowed right away, the history is reflowed by the terminal thread.
     screen_.resize(_cells);
+    historyReflowPending_ = screen_.pendingReflowLineCount() != 0;
     if (_pixels)
         screen_.setCellPixelSize(*_pixels / _cells);
+    publishViewState();
+}
+
+void Terminal::resizePty(Size _cells, optional<Size> _pixels)
+{
+    auto const _l = lock_guard{*this};
 
     pty_.resizeScreen(_cells, _pixels);
+
+    if (recorder_)
+        recorder_->recordResize(_cells, _pixels, steady_clock::now());
 }
 
 void Terminal::setCursorDisplay(CursorDisplay _display)
@@ -702,38 +2040,92 @@ void Terminal::setCursorShape(CursorShape _shape)
 
 void Terminal::setWordDelimiters(string const& _wordDelimiters)
 {
-    wordDelimiters_ = unicode::from_utf8(_wordDelimiters);
+    wordDelimiters_ = WordDelimiters{ unicode::from_utf8(_wordDelimiters) };
 }
 
 string Terminal::extractSelectionText() const
 {
-    using namespace terminal;
-    int lastColumn = 0;
-    string text;
-    string currentLine;
+    // Locked once for the whole selection, rather than contending with the parser on every cell.
+    auto const _lock = scoped_lock{ *this };
+    if (!selector_)
+        return {};
+
+    auto text = string{};
+    auto builder = SelectionTextBuilder{*selector_};
+    for (auto const& range : selector_->selection())
+        builder.append(screen_.grid(), range, 0, text);
+    builder.finish(text);
 
-    renderSelection([&](Coordinate const& _pos, Cell const& _cell) {
-        auto const _lock = scoped_lock{ *this };
-        auto const isNewLine = _pos.column <= lastColumn;
-        auto const isLineWrapped = lineWrapped(_pos.row);
-        bool const touchesRightPage = _pos.row > 0
-            && isSelectedAbsolute({_pos.row - 1, screen_.size().width});
-        if (isNewLine && (!isLineWrapped || !touchesRightPage))
+    return text;
+}
+
+void Terminal::extractSelectionTextAsync(SelectionTextSink _sink)
+{
+    cancelSelectionExtraction();
+
+    auto selector = optional<Selector>{};
+    auto ranges = vector<Selector::Range>{};
+    Grid const* grid = nullptr;
+    uint64_t droppedLineCount = 0;
+    {
+        auto const _l = scoped_lock{*this};
+        if (selector_)
         {
-            // TODO: handle logical line in word-selection (don't include LF in wrapped lines)
-            trimSpaceRight(currentLine);
-            text += currentLine;
-            text += '\n';
-            currentLine.clear();
+            selector.emplace(*selector_);
+            ranges = selector_->selection();
+            grid = &screen_.grid();
+            droppedLineCount = grid->droppedLineCount();
         }
-        currentLine += _cell.toUtf8();
-        lastColumn = _pos.column;
-    });
+    }
 
-    trimSpaceRight(currentLine);
-    text += currentLine;
+    if (!grid)
+    {
+        _sink({}, true);
+        return;
+    }
 
-    return text;
+    selectionExtractionToken_ = crispy::cancellation_token{};
+    auto const token = selectionExtractionToken_;
+    selectionExtraction_ = crispy::thread_pool::shared().submit(
+        [this, token, sink = move(_sink), selector = move(*selector), ranges = move(ranges), grid, droppedLineCount]() {
+            auto builder = SelectionTextBuilder{selector};
+            auto text = string{};
+            size_t i = 0;
+            while (i < ranges.size())
+            {
+                if (token.cancelled())
+                    return;
+
+                {
+                    // The grid keeps being written to in between, only ever dropping lines off
+                    // the top of the history, which shifts the selected lines up accordingly.
+                    auto const _l = scoped_lock{*this};
+                    auto const droppedLines = static_cast<int>(grid->droppedLineCount() - droppedLineCount);
+                    for (auto const end = min(ranges.size(), i + SelectionExtractionLineCount); i < end; ++i)
+                        builder.append(*grid, ranges[i], droppedLines, text);
+                }
+
+                if (text.size() >= SelectionTextChunkSize)
+                {
+                    sink(text, false);
+                    text.clear();
+                }
+            }
+            builder.finish(text);
+            sink(text, true);
+        },
+        crispy::task_options{ crispy::task_priority::normal, reinterpret_cast<uintptr_t>(this), token }
+    );
+}
+
+void Terminal::cancelSelectionExtraction()
+{
+    if (!selectionExtraction_.valid())
+        return;
+
+    selectionExtractionToken_.cancel();
+    selectionExtraction_.wait();
+    selectionExtraction_ = {};
 }
 
 string Terminal::extractLastMarkRange() const
@@ -757,11 +2149,17 @@ string Terminal::extractLastMarkRange() const
     auto const lastLine = *marker1 - screen_.historyLineCount();
 
     string text;
+    std::u32string codepoints;
 
     for (auto lineNum = firstLine; lineNum <= lastLine; ++lineNum)
     {
+        codepoints.clear();
         for (auto colNum = 1; colNum < colCount; ++colNum)
-            text += screen_.at({lineNum, colNum}).toUtf8();
+            if (auto const& cell = screen_.at({lineNum, colNum}); cell.codepointCount())
+                codepoints += cell.codepoints();
+            else
+                codepoints += U' ';
+        crispy::utf8::append(text, codepoints);
         trimSpaceRight(text);
         text += '\n';
     }
@@ -769,6 +2167,13 @@ string Terminal::extractLastMarkRange() const
     return text;
 }
 
+void Terminal::collectMemoryUsage(crispy::memory_usage& _usage) const
+{
+    screen_.collectMemoryUsage(_usage);
+    _usage.add("terminal.render_buffers", renderBuffer_.memoryUsage());
+    _usage.add("process.cell_pool", crispy::size_class_pool::current().stats().pooled_bytes);
+}
+
 // {{{ ScreenEvents overrides
 void Terminal::requestCaptureBuffer(int _absoluteStartLine, int _lineCount)
 {
@@ -798,6 +2203,19 @@ void Terminal::screenUpdated()
 {
     screenDirty_ = true;
     //pty_.wakeupReader();
+
+    auto const now = foreground_ ? Timestamp{} : steady_clock::now();
+    if (throughputMode_ || !visible_ || screen_.isModeEnabled(DECMode::BatchedRendering) || !screenUpdateDue(now))
+    {
+        // Notified once per refresh interval by updateThroughputMode(), once visible again,
+        // once the synchronized output batch has been completed, or at the reduced
+        // refresh rate of background terminals, instead.
+        screenUpdatePending_ = true;
+        return;
+    }
+
+    screenUpdatePending_ = false;
+    lastScreenUpdate_ = now;
     eventListener_.screenUpdated();
 }
 
@@ -828,11 +2246,9 @@ void Terminal::notify(string_view _title, string_view _body)
 
 void Terminal::reply(string_view _reply)
 {
-    // this is invoked from within the terminal thread.
-    // most likely that's not the main thread, which will however write
-    // the actual input events.
-    // TODO: introduce new mutex to guard terminal writes.
-    sendRaw(_reply);
+    // This is invoked from within the terminal thread, while the input generator
+    // belongs to the GUI thread, so replies are queued to the PTY writer directly.
+    writeToPty(_reply);
 }
 
 void Terminal::resizeWindow(int _width, int _height, bool _unitInPixels)
@@ -907,6 +2323,11 @@ void Terminal::discardImage(Image const& _image)
 {
     eventListener_.discardImage(_image);
 }
+
+bool Terminal::permitSharedImage()
+{
+    return eventListener_.permitSharedImage();
+}
 // }}}
 
 }  // namespace terminal
@@ -13,19 +13,34 @@
  */
 #pragma once
 
+#include <terminal/HistoryPrefetcher.h>
 #include <terminal/InputGenerator.h>
+#include <terminal/AllocationTrace.h>
+#include <terminal/LatencyTrace.h>
+#include <terminal/ParseStats.h>
+#include <terminal/SessionScheduler.h>
 #include <terminal/pty/Pty.h>
+#include <terminal/pty/PtyRecording.h>
+#include <terminal/pty/PtyWriter.h>
 #include <terminal/ScreenEvents.h>
 #include <terminal/Screen.h>
 #include <terminal/Selector.h>
+#include <terminal/SessionFile.h>
 #include <terminal/Viewport.h>
 #include <terminal/RenderBuffer.h>
 
+#include <crispy/mpsc_queue.h>
+#include <crispy/seqlock.h>
+#include <crispy/spsc_ring.h>
+#include <crispy/thread_pool.h>
+
 #include <fmt/format.h>
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <string_view>
@@ -62,6 +77,14 @@ class Terminal : public ScreenEvents {
         virtual void setWindowTitle(std::string_view /*_title*/) {}
         virtual void setTerminalProfile(std::string const& /*_configProfileName*/) {}
         virtual void discardImage(Image const&) {}
+        virtual bool permitSharedImage() { return false; }
+        /// Invoked whenever input to the application started (or stopped) piling up,
+        /// because the application is not reading it fast enough. Invoked from any thread,
+        /// yet in order, see PtyWriter::CongestionHandler.
+        virtual void inputCongestionChanged(bool /*_congested*/) {}
+        /// Invoked by the terminal thread after Terminal::trimMemory(),
+        /// for the display to give back the memory of its caches as well.
+        virtual void memoryTrimmed() {}
     };
 
     Terminal(Pty& _pty,
@@ -81,17 +104,160 @@ class Terminal : public ScreenEvents {
 
     void start();
 
+    /// Flow control settings of the PTY input pipeline, see enableInputPipeline().
+    struct InputPipelineSettings {
+        /// Capacity in bytes of the buffer between the reader thread and the parser.
+        size_t bufferSize = 4 * 1024 * 1024;
+        /// Number of pending bytes at which the reader thread stops reading from the PTY.
+        size_t highWatermark = 3 * 1024 * 1024;
+        /// Number of pending bytes at which the reader thread resumes reading from the PTY.
+        size_t lowWatermark = 1024 * 1024;
+        /// Whether the PTY is read by the PtyReactor shared by all terminals, where available,
+        /// instead of a dedicated reader thread.
+        bool sharedReactor = true;
+    };
+
+    /// Reads the PTY on a dedicated thread into a lock-free buffer, which the terminal thread
+    /// then parses in large batches, so that the application's output does not stall while parsing.
+    ///
+    /// Must be invoked before start().
+    void enableInputPipeline(InputPipelineSettings const& _settings);
+
+    /// Sizing of the PTY read buffer and batching of PTY reads, see setReadBufferSettings().
+    struct ReadBufferSettings {
+        /// Size in bytes the read buffer grows up to while the application keeps filling it.
+        /// When idle, it shrinks back to the PTY read buffer size passed at construction.
+        size_t maxSize = 1024 * 1024;
+        /// Whether the PTY is drained by further non-blocking reads before parsing.
+        bool coalesce = false;
+        /// Time spent at most on draining the PTY, before parsing what has been read so far.
+        std::chrono::microseconds coalesceTimeBudget{2000};
+    };
+
+    /// Configures how the PTY is read when not using the input pipeline.
+    ///
+    /// Must be invoked before start().
+    void setReadBufferSettings(ReadBufferSettings const& _settings);
+
+    /// Slicing of large batches of output to parse, see setParseSliceSettings().
+    struct ParseSliceSettings {
+        /// Time a single slice is parsed within, holding the terminal lock, or zero to never slice.
+        std::chrono::microseconds timeBudget{4000};
+        /// Size in bytes of the smallest slice, and of all slices before the parse rate is known.
+        size_t minSize = 64 * 1024;
+    };
+
+    /// Configures how large batches of output (e.g. read during a flood) are parsed.
+    ///
+    /// Each batch is parsed in slices, sized by the parse rate seen so far to take about
+    /// the time budget each. In between, the terminal lock is released for rendering and
+    /// input handling to proceed, and screen updates are notified as if each slice had been
+    /// read on its own.
+    void setParseSliceSettings(ParseSliceSettings const& _settings) noexcept { parseSliceSettings_ = _settings; }
+
+    /// Records the PTY output being parsed, along with the changes of the screen size,
+    /// e.g. for reproducing a session later on (see PtyReplay).
+    ///
+    /// Must be invoked before start().
+    void setRecorder(std::unique_ptr<PtyRecorder> _recorder);
+
+    /// Restores the screen's state and history from the given session file, if saved before,
+    /// and keeps saving them to it while running, until the terminal is closed.
+    ///
+    /// Must be invoked before start().
+    void setSessionFile(std::unique_ptr<SessionFile> _sessionFile);
+
+    /// @returns the current size of the PTY read buffer.
+    size_t readBufferSize() const noexcept { return readBuffer_.size(); }
+
+    /// Sets the time without any output after which trimMemory() is invoked by the terminal thread,
+    /// or zero to never do so.
+    void setIdleMemoryTrimDelay(std::chrono::milliseconds _delay) noexcept { idleMemoryTrimDelay_ = _delay; }
+
+    /// Gives back memory held beyond what is needed for the current screen, such as buffers grown
+    /// by a burst of output, pooled line cells, and the allocator's free memory, and notifies
+    /// the event listener to do the same (see Events::memoryTrimmed()).
+    void trimMemory();
+
     void setRefreshRate(double _refreshRate);
 
+    /// Detection of output floods, see setThroughputModeSettings().
+    struct ThroughputModeSettings {
+        bool enabled = true;
+        /// Number of bytes to be parsed within a single refresh interval to count as flooded.
+        size_t bytesPerFrame = 256 * 1024;
+        /// Number of consecutive flooded refresh intervals, after which throughput mode is entered.
+        int sustainedFrames = 3;
+    };
+
+    /// Configures when to enter throughput mode.
+    ///
+    /// While the application produces output faster than it could possibly be displayed,
+    /// the terminal only parses, building exactly one render buffer and notifying about
+    /// screen updates once per refresh interval (see setRefreshRate()), even if asked more often.
+    /// Throughput mode is left as soon as a refresh interval passes without flooding.
+    void setThroughputModeSettings(ThroughputModeSettings const& _settings);
+
+    /// @returns whether the terminal currently is in throughput mode.
+    bool throughputMode() const noexcept { return throughputMode_.load(); }
+
+    /// Accounts the input parsed since the last invocation to the current refresh interval,
+    /// entering or leaving throughput mode accordingly.
+    /// Invoked by the terminal thread after each read.
+    void updateThroughputMode(std::chrono::steady_clock::time_point _now);
+
+    /// Sets the time a synchronized output batch (DECSET 2026) may stay open, after which
+    /// it is ended by the terminal, as if the application had done so.
+    ///
+    /// While a batch is open, screen updates are held back and no render buffers are built.
+    /// Once it ends, a render buffer is built and screen update notified right away.
+    void setSynchronizedOutputTimeout(std::chrono::milliseconds _timeout) noexcept { synchronizedOutputTimeout_ = _timeout; }
+
+    /// Notifies about the screen update held back by throughput mode, while hidden,
+    /// or by a synchronized output batch, if any.
+    void flushScreenUpdate(std::chrono::steady_clock::time_point _now);
+
+    /// Tells whether the terminal is displayed at all, e.g. not minimized or fully occluded.
+    ///
+    /// While hidden, the terminal only parses: screen updates are held back and no render buffers
+    /// are built, until it is visible again, then notifying about the screen update once.
+    void setVisible(bool _visible);
+
+    /// @returns whether the terminal is displayed, see setVisible().
+    bool visible() const noexcept { return visible_.load(); }
+
+    /// Tells whether the terminal has the keyboard focus, giving it priority over all other
+    /// terminals of the process when sharing the CPU, see SessionScheduler.
+    ///
+    /// In the background, the terminal parses for at most its share of the CPU while the focused
+    /// one is busy, and notifies about screen updates at a reduced refresh rate.
+    /// Terminals start out in the foreground, so that only those opting in are ever throttled.
+    void setForeground(bool _foreground);
+
+    /// @returns whether the terminal has the keyboard focus, see setForeground().
+    bool foreground() const noexcept { return foreground_.load(); }
+
     /// Retrieves the time point this terminal instance has been spawned.
     std::chrono::steady_clock::time_point startTime() const noexcept { return startTime_; }
 
     /// Retrieves reference to the underlying PTY device.
     Pty& device() noexcept { return pty_; }
 
-    crispy::Size screenSize() const noexcept { return pty_.screenSize(); }
+    /// @returns the size of the screen, which the PTY's window size may lag behind, see resizePage().
+    crispy::Size screenSize() const noexcept { return viewState_.load().pageSize; }
+
+    /// Resizes the screen and the PTY's window along with it.
     void resizeScreen(crispy::Size _cells, std::optional<crispy::Size> _pixels);
 
+    /// Resizes the screen only, keeping the PTY's window size until resizePty() is invoked.
+    ///
+    /// Used while the window is being resized interactively, so that the application
+    /// is not flooded with window size changes, each making it redraw.
+    void resizePage(crispy::Size _cells, std::optional<crispy::Size> _pixels);
+
+    /// Resizes the PTY's window, informing the application about the new size.
+    void resizePty(crispy::Size _cells, std::optional<crispy::Size> _pixels);
+
     void setMouseProtocolBypassModifier(Modifier _value) { mouseProtocolBypassModifier_ = _value; }
 
     // {{{ input proxy
@@ -99,26 +265,64 @@ class Terminal : public ScreenEvents {
     bool sendKeyPressEvent(KeyInputEvent const& _event, Timestamp _now);
     bool sendCharPressEvent(CharInputEvent const& _event, Timestamp _now);
     bool sendMousePressEvent(MousePressEvent const& _event, Timestamp _now);
+
+    /// @returns whether the event changed what is to be displayed, i.e. the selection or the hovered hyperlink.
     bool sendMouseMoveEvent(MouseMoveEvent const& _event, Timestamp _now);
+
     bool sendMouseReleaseEvent(MouseReleaseEvent const& _event, Timestamp _now);
     bool sendFocusInEvent();
     bool sendFocusOutEvent();
-    void sendPaste(std::string_view _text); // Sends verbatim text in bracketed mode to application.
+    /// Sends verbatim text in bracketed mode to application, taking over the text to avoid copying it.
+    /// Control characters other than tab and line breaks are removed first if @p _sanitize is set.
+    void sendPaste(std::string _text, bool _sanitize = false);
     void sendRaw(std::string_view _text);   // Sends raw string to the application.
+
+    /// @returns the number of input bytes that have been sent but not yet been written to the PTY.
+    size_t pendingInputBytes() const { return ptyWriter_ ? ptyWriter_->pendingBytes() : 0; }
+
+    /// Enables showing printable characters typed at the shell prompt right away, underlined,
+    /// rather than waiting for the application to echo them, e.g. on slow SSH connections.
+    ///
+    /// The shell prompt is told by the line marked by the shell integration (see Screen::setMark()).
+    /// Predicted characters are dropped as soon as the echo differs from them, any other input is
+    /// sent, or the echo does not arrive within a second.
+    ///
+    /// Must be invoked with the terminal locked, e.g. while applying a profile.
+    void setPredictiveEcho(bool _enabled);
+    // }}}
+
+    // {{{ view state
+    /// Read-mostly geometry of the screen and viewport, as required by GUI queries.
+    struct ViewState {
+        crispy::Size pageSize{};
+        int historyLineCount = 0;
+        int scrollOffset = -1; // absolute scroll offset of the viewport, or -1 if not scrolled
+
+        int absoluteScrollOffset() const noexcept { return scrollOffset >= 0 ? scrollOffset : historyLineCount; }
+        int relativeScrollOffset() const noexcept { return historyLineCount - absoluteScrollOffset(); }
+    };
+
+    /// @returns the most recently published view state.
+    ///
+    /// This never waits for the terminal thread, as the state is republished
+    /// whenever the screen has been written to, resized, or the viewport has moved.
+    ViewState viewState() const noexcept { return viewState_.load(); }
     // }}}
 
     // {{{ screen proxy
     /// @returns absolute coordinate of @p _pos with scroll offset and applied.
     Coordinate absoluteCoordinate(Coordinate const& _pos) const noexcept
     {
-        // TODO: unit test case me BEFORE merge, yo !
-        auto const row = viewport_.absoluteScrollOffset().value_or(screen_.historyLineCount()) + (_pos.row - 1);
+        auto const row = viewState().absoluteScrollOffset() + (_pos.row - 1);
         auto const col = _pos.column;
         return Coordinate{row, col};
     }
 
     /// Writes a given VT-sequence to screen.
-    void writeToScreen(char const* data, size_t size);
+    ///
+    /// @param _received  time the data has been received, e.g. read from the PTY, for latency tracing.
+    void writeToScreen(char const* data, size_t size,
+                       std::chrono::steady_clock::time_point _received = std::chrono::steady_clock::now());
     void writeToScreen(std::string_view _text) { writeToScreen(_text.data(), _text.size()); }
     void writeToScreen(std::string const& _text) { writeToScreen(_text.data(), _text.size()); }
     // }}}
@@ -161,16 +365,12 @@ class Terminal : public ScreenEvents {
 
     /// Refreshes the render buffer.
     /// When this function returns, the back buffer is updated
-    /// and it is attempted to swap the back/front buffers.
-    /// but the swap has NOT been invoked yet.
+    /// and has been published to the reader.
     ///
-    /// @retval true   front buffer now contains the refreshed render buffer.
-    /// @retval false  back buffer contains the refreshed render buffer,
-    ///                and RenderDoubleBuffer::swapBuffers() must again
-    ///                be successfully invoked to swap back/front buffers
-    ///                in order to access the refreshed render buffer.
+    /// @retval true   the refreshed render buffer is available via renderBuffer().
+    /// @retval false  refreshing the render buffer is currently disabled.
     ///
-    /// @see RenderDoubleBuffer::swapBuffers()
+    /// @see RenderTripleBuffer::swapBuffers()
     /// @see renderBuffer()
     ///
     bool refreshRenderBuffer(std::chrono::steady_clock::time_point _now);
@@ -180,18 +380,48 @@ class Terminal : public ScreenEvents {
     /// - viewport has changed, or
     /// - refreshing the render buffer was explicitly requested.
     ///
-    /// @see RenderDoubleBuffer::swapBuffers()
+    /// @see RenderTripleBuffer::swapBuffers()
     /// @see renderBuffer()
     void ensureFreshRenderBuffer(std::chrono::steady_clock::time_point _now);
 
-    /// Aquuires read-access handle to front render buffer.
+    /// Aquuires read-access handle to the most recently refreshed render buffer.
     ///
-    /// This also acquires the reader lock and releases it automatically
-    /// upon RenderBufferRef destruction.
+    /// This never waits for the terminal thread. May only be invoked by the render thread.
     ///
     /// @see ensureFreshRenderBuffer()
     /// @see refreshRenderBuffer()
     RenderBufferRef renderBuffer() const { return renderBuffer_.frontBuffer(); }
+
+    /// @returns the number of render buffers published so far.
+    uint64_t renderBufferFrameCount() const noexcept { return renderBuffer_.frameCount(); }
+
+    /// @returns the number of render buffers published but replaced by a newer one
+    ///          before the render thread picked them up.
+    uint64_t renderBufferOverwrittenFrameCount() const noexcept { return renderBuffer_.overwrittenFrameCount(); }
+    // }}}
+
+    /// Accounts the memory held by the screen and the render buffers to @p _usage.
+    /// The terminal must be locked by the caller.
+    void collectMemoryUsage(crispy::memory_usage& _usage) const;
+
+    // {{{ latency tracing
+    /// Latencies of PTY output from being read until presented on screen, and of key input
+    /// until written to the PTY.
+    ///
+    /// The terminal traces the stages up to publishing render buffers (see RenderBuffer::outputTime)
+    /// and writing input, whereas the render thread is expected to record the remaining ones.
+    LatencyTrace& latencyTrace() noexcept { return latencyTrace_; }
+    LatencyTrace const& latencyTrace() const noexcept { return latencyTrace_; }
+
+    /// Heap allocations made while parsing PTY output, refreshing the render buffer,
+    /// and handling input events, per unit of work.
+    ///
+    /// The render thread is expected to account the frames it renders, too.
+    AllocationTrace& allocationTrace() noexcept { return allocationTrace_; }
+    AllocationTrace const& allocationTrace() const noexcept { return allocationTrace_; }
+
+    /// Bytes of PTY output parsed, in how many batches, and how long that took.
+    ParseStats const& parseStats() const noexcept { return parseStats_; }
     // }}}
 
     void lock() const { outerLock_.lock(); innerLock_.lock(); }
@@ -232,7 +462,7 @@ class Terminal : public ScreenEvents {
     // {{{ selection management
     // TODO: move you, too?
     void setWordDelimiters(std::string const& _wordDelimiters);
-    std::u32string const& wordDelimiters() const noexcept { return wordDelimiters_; }
+    WordDelimiters const& wordDelimiters() const noexcept { return wordDelimiters_; }
 
     Selector const* selector() const noexcept { return selector_.get(); }
     Selector* selector() noexcept { return selector_.get(); }
@@ -257,6 +487,14 @@ class Terminal : public ScreenEvents {
             && selector_->contains(_coord);
     }
 
+    /// @returns the selected columns of the given absolute line, if any.
+    std::optional<Selector::Range> selectedColumnsAbsolute(int _line) const noexcept
+    {
+        if (!isSelectionAvailable())
+            return std::nullopt;
+        return selector_->selectedColumns(_line);
+    }
+
     /// Sets or resets to a new selection.
     void setSelector(std::unique_ptr<Selector> _selector) { selector_ = std::move(_selector); }
 
@@ -264,18 +502,91 @@ class Terminal : public ScreenEvents {
     bool selectionAvailable() const noexcept { return !!selector_; }
     // }}}
 
+    // {{{ search
+    /// @returns a copy of the text of the current screen's lines, to be searched without
+    ///          holding the terminal lock, e.g. from another thread.
+    ///
+    /// The terminal is locked only while taking the snapshot.
+    SearchSnapshot searchSnapshot() const;
+
+    /// Highlights the given search matches (sorted in ascending order) when rendering,
+    /// replacing any previous ones.
+    ///
+    /// The terminal is locked while updating the highlights, so the caller must not hold the lock.
+    void setSearchHighlights(std::vector<SearchMatch> _matches);
+
+    /// Only access this when having the terminal object locked.
+    std::vector<SearchMatch> const& searchHighlights() const noexcept { return searchHighlights_; }
+    // }}}
+
     std::string extractSelectionText() const;
+
+    /// Receives consecutive pieces of an extracted selection's text, see extractSelectionTextAsync().
+    using SelectionTextSink = std::function<void(std::string_view _text, bool _last)>;
+
+    /// Extracts the text of the current selection on a worker thread, locking the terminal
+    /// only for a slice of lines at a time, so that huge selections do not stall the output.
+    ///
+    /// The selection is taken at call time, and @p _sink called from the worker thread with
+    /// consecutive pieces of its text, the last one (possibly empty) being flagged as such.
+    /// Lines that scroll off the history meanwhile are skipped.
+    ///
+    /// A still running extraction is cancelled first, without its sink receiving the last piece.
+    /// Must neither be called with the terminal locked, nor from within a sink.
+    void extractSelectionTextAsync(SelectionTextSink _sink);
     std::string extractLastMarkRange() const;
 
     /// Tests whether or not the mouse is currently hovering a hyperlink.
     bool isMouseHoveringHyperlink() const noexcept { return hoveringHyperlink_.load(); }
 
+    /// Tells whether the hyperlink under the mouse cursor is rendered as hovered,
+    /// which may be given up under rendering pressure.
+    ///
+    /// May be invoked by any thread, taking effect with the next render buffer.
+    void setHyperlinkHoverEnabled(bool _enabled) noexcept { hyperlinkHoverEnabled_ = _enabled; }
+
+    /// Tells whether the selection is left to the renderer to draw on top of the cells,
+    /// as given by RenderBuffer::selection, rather than rendered into the cells' colors.
+    /// Changing the selection then leaves the rows, and the renderer's caches of them, untouched.
+    ///
+    /// May be invoked by any thread, taking effect with the next render buffer.
+    void setSelectionOverlay(bool _enabled) noexcept { selectionOverlay_ = _enabled; }
+
     bool processInputOnce();
 
   private:
-    void flushInput();
+    void flushInput(Timestamp _origin = {});
+    void writeToPty(std::string_view _data, Timestamp _origin = {});
     void mainLoop();
+    void inputPipelineLoop();
+    int readInput(std::chrono::milliseconds _timeout);
+    void adaptReadBufferSize(size_t _bytesRead);
+    bool readPipelinedInput();
+    struct InputPipeline;
+    static void markPipelinedInputRead(InputPipeline& _pipeline);
+    bool processPipelinedInputOnce(std::chrono::milliseconds _timeout);
     void refreshRenderBuffer(RenderBuffer& _output);
+    void applyTypedInput();
+
+    /// Parses a single slice of output under the terminal lock, see setParseSliceSettings().
+    ///
+    /// @returns whether a synchronized output batch has been completed.
+    bool writeSliceToScreen(char const* data, size_t size, Timestamp _received, bool _eagerLinkDetection);
+    size_t parseSliceSize() const noexcept;
+    bool updateSynchronizedOutput(Timestamp _now);
+    void predictEcho(CharInputEvent const& _charEvent, Timestamp _now);
+    void confirmPredictions(Timestamp _now);
+
+    /// Reflows history lines left over from a resize, keeping the viewport in place.
+    void reflowHistory(std::optional<int> _maxLines);
+
+    /// Saves the screen's changes to the session file, with at most @p _maxLines history lines.
+    void saveSession(std::optional<int> _maxLines);
+
+    /// Compresses the images not displayed for a while in the background, see Screen::compressUnusedImages().
+    void compressUnusedImages(std::chrono::steady_clock::time_point _now);
+    void publishViewState();
+    void cancelSelectionExtraction();
     std::optional<RenderCursor> renderCursor();
     void updateCursorVisibilityState(std::chrono::steady_clock::time_point _now) const;
     bool updateCursorHoveringState();
@@ -316,6 +627,7 @@ class Terminal : public ScreenEvents {
     void useApplicationCursorKeys(bool _enabled) override;
     void hardReset() override;
     void discardImage(Image const&) override;
+    bool permitSharedImage() override;
 
     // private data
     //
@@ -329,10 +641,139 @@ class Terminal : public ScreenEvents {
 
     std::chrono::milliseconds refreshInterval_;
     bool screenDirty_ = false;
-    RenderDoubleBuffer renderBuffer_{};
+
+    // {{{ throughput mode, see setThroughputModeSettings()
+    ThroughputModeSettings throughputSettings_;
+    std::atomic<bool> throughputMode_ = false;
+    std::chrono::steady_clock::time_point throughputWindowStart_{};
+    size_t throughputBytes_ = 0;     // bytes parsed since throughputWindowStart_
+    int floodedWindowCount_ = 0;     // consecutive refresh intervals above the threshold
+    std::atomic<bool> screenUpdatePending_ = false; // screenUpdated() held back until the next refresh interval
+    // }}}
+
+    // {{{ synchronized output, see setSynchronizedOutputTimeout()
+    std::chrono::milliseconds synchronizedOutputTimeout_ = std::chrono::seconds(1);
+    Timestamp batchStart_{};                    // of the batch currently open, if any
+    std::atomic<bool> batchCompleted_ = false;  // the next render buffer is built right away
+    // }}}
+
+    std::atomic<bool> visible_ = true; // see setVisible()
+
+    // {{{ CPU sharing, see setForeground()
+    /// Accounts the time just spent on parsing to the SessionScheduler,
+    /// waiting for the next time slice if a background terminal used up its share.
+    void yieldToForeground(std::chrono::nanoseconds _parseTime);
+
+    /// @returns whether a screen update may be notified about at @p _now, which background
+    /// terminals only do at their reduced refresh rate. Must be invoked with the lock held.
+    bool screenUpdateDue(Timestamp _now) const noexcept;
+
+    std::atomic<bool> foreground_ = true;
+    SessionScheduler::Budget schedulingBudget_;  // of the terminal thread
+    Timestamp lastScreenUpdate_{};              // most recently notified screen update
+    // }}}
+
+    /// Render colors of a graphics rendition, resolved against the current color palette.
+    ///
+    /// They are kept across frames until the color palette, reverse video mode, or the
+    /// identifiers of the grid's graphics renditions change.
+    struct RenderColors {
+        RGBColor foreground;
+        RGBColor background;
+        RGBColor decoration;
+        PaletteSlot foregroundSlot;     // palette slots the colors above are resolved from
+        PaletteSlot backgroundSlot;
+        PaletteSlot decorationSlot;
+        CellFlags flags;
+        uint64_t generation = 0;
+    };
+    std::vector<RenderColors> renderColorCache_; // indexed by GraphicsAttributesId
+    uint64_t renderColorGeneration_ = 1;         // entries of any other generation are stale
+    uint64_t renderAttributesVersion_ = 0;       // see GraphicsAttributesTable::version()
+
+    /// Render cells of a single viewport row, along with the state they have been rendered from.
+    /// Run of cells of a rendered frame referring to the same hyperlink, in viewport coordinates.
+    struct HyperlinkSpan {
+        Coordinate start;
+        int lastColumn;
+        HyperlinkId hyperlink;  // NoHyperlinkId for links detected in the plain text
+    };
+    using HyperlinkSpans = std::vector<HyperlinkSpan>; // ordered by start
+
+    struct RenderRow {
+        Line const* line = nullptr;
+        uint64_t generation = 0;
+        bool selected = false;
+        bool highlighted = false;
+        bool hyperlinks = false;
+        uint64_t version = 0;           // see RenderBuffer::rowVersions
+        int number = 0;                 // viewport row the cells' positions refer to
+        std::vector<RenderCell> cells;
+        std::vector<char32_t> codepoints; // referenced by cells, relative to this row
+        HyperlinkSpans hyperlinkSpans;
+    };
+    std::vector<RenderRow> renderRows_; // indexed by viewport row
+    uint64_t renderRowVersion_ = 0;     // most recently assigned RenderRow::version
+    int renderRowWidth_ = 0;
+    bool renderReverseVideo_ = false;
+    ColorPalette renderColorPalette_;
+    RenderPalette renderPalette_;       // of renderColorPalette_ and renderReverseVideo_
+    uint64_t renderPaletteVersion_ = 0; // see RenderBuffer::paletteVersion
+    HyperlinkId renderHoveredHyperlink_ = NoHyperlinkId;
+
+    /// Link detected in the plain text that is rendered as hovered, see Screen::detectedLinkAt().
+    struct HoveredLink {
+        int row;                // in viewport coordinates
+        DetectedLink link;
+    };
+    std::optional<HoveredLink> renderHoveredLink_;
+
+    // Hyperlinks of the most recently rendered frame, published by refreshRenderBuffer() via
+    // std::atomic_store(), so that telling the hovered hyperlink on mouse moves does not lock.
+    std::shared_ptr<HyperlinkSpans const> hyperlinkSpans_;
+    RenderTripleBuffer renderBuffer_{};
+
+    LatencyTrace latencyTrace_;
+    AllocationTrace allocationTrace_;
+    ParseStats parseStats_;
+    ParseSliceSettings parseSliceSettings_;
+    Timestamp outputTime_{}; // read time of the oldest output written to screen but not rendered yet
 
     Pty& pty_;
     std::vector<char> readBuffer_;
+    ReadBufferSettings readBufferSettings_;
+    int fullReadCount_ = 0; // number of consecutive reads that filled up the read buffer
+    Timestamp lastReadTime_{}; // time the most recent readInput() has returned data
+
+    std::chrono::milliseconds idleMemoryTrimDelay_{60000}; // see setIdleMemoryTrimDelay()
+    // Time of the most recent writeToScreen() (as steady_clock::rep), or zero if memory has been trimmed since.
+    std::atomic<std::chrono::steady_clock::rep> lastWriteTime_ = 0;
+
+    /// State shared between the PTY reader (a dedicated thread or the PtyReactor)
+    /// and the terminal thread, see enableInputPipeline().
+    ///
+    /// Data is handed over through the lock-free buffer. The mutex is only used for sleeping,
+    /// while the buffer is either empty (terminal thread) or above its high watermark (reader thread).
+    /// The reactor does not sleep, but stops watching the PTY until it got resumed instead.
+    struct InputPipeline {
+        explicit InputPipeline(InputPipelineSettings const& _settings) :
+            settings{_settings}, buffer{_settings.bufferSize}
+        {}
+
+        InputPipelineSettings settings;
+        crispy::spsc_ring<char> buffer;
+        std::mutex mutex;
+        std::condition_variable dataAvailable;
+        std::condition_variable spaceAvailable;
+        std::atomic<bool> wakeupRequested = false;
+        std::atomic<bool> closed = false;
+        std::unique_ptr<std::thread> readerThread;
+        int reactorFd = -1;
+        std::atomic<bool> paused = false;
+        // Read time (since epoch) of the oldest data not yet taken by the parser, or zero.
+        std::atomic<std::chrono::steady_clock::rep> readTime = 0;
+    };
+    std::unique_ptr<InputPipeline> inputPipeline_;
 
     CursorDisplay cursorDisplay_;
     CursorShape cursorShape_;
@@ -343,7 +784,7 @@ class Terminal : public ScreenEvents {
 
     std::chrono::steady_clock::time_point startTime_;
 
-    std::u32string wordDelimiters_;
+    WordDelimiters wordDelimiters_;
 
     // helpers for detecting double/tripple clicks
     std::chrono::steady_clock::time_point lastClick_{};
@@ -356,14 +797,56 @@ class Terminal : public ScreenEvents {
 
     InputGenerator inputGenerator_;
     InputGenerator::Sequence pendingInput_;
+
+    /// Writes input to the PTY once the terminal has been started, so that neither the GUI thread
+    /// nor the terminal thread ever block on an application not reading its input.
+    std::unique_ptr<PtyWriter> ptyWriter_;
+    std::unique_ptr<PtyRecorder> recorder_;
+    std::unique_ptr<SessionFile> sessionFile_;
+    std::chrono::steady_clock::time_point nextSessionSave_{};
+    std::chrono::steady_clock::time_point nextImageCompression_{};
+    std::future<void> imageCompression_;                // run on crispy::thread_pool::shared()
+
+    // {{{ predictive echo, see setPredictiveEcho()
+    struct PredictedCell {
+        Coordinate position; // on the main page
+        char32_t codepoint;
+    };
+    std::atomic<bool> predictiveEcho_ = false;
+    std::vector<PredictedCell> predictions_; // not yet echoed, in typing order
+    Timestamp predictionTime_{};            // most recently predicted or confirmed
+
+    /// Input typed on the GUI thread, applied to the predictions by applyTypedInput(),
+    /// so that typing never waits for the terminal's lock held by the parser.
+    /// Popped with the terminal's lock held only.
+    struct TypedInput {
+        std::optional<CharInputEvent> character; // unset for keys, rolling predictions back
+        Timestamp time;
+    };
+    crispy::mpsc_queue<TypedInput> typedInput_;
+    // }}}
     Screen screen_;
     std::mutex mutable outerLock_;
     std::mutex mutable innerLock_;
     std::unique_ptr<std::thread> screenUpdateThread_;
     Viewport viewport_;
+    HistoryPrefetcher historyPrefetcher_;               // restores the history lines ahead of viewport_
     std::unique_ptr<Selector> selector_;
+    std::future<void> selectionExtraction_;             // run on crispy::thread_pool::shared()
+    crispy::cancellation_token selectionExtractionToken_;
+    std::vector<SearchMatch> searchHighlights_;
     std::atomic<bool> hoveringHyperlink_ = false;
+    std::atomic<HyperlinkId> hoveredHyperlink_ = NoHyperlinkId;
+    std::atomic<Coordinate> hoveredLinkStart_ = Coordinate{}; // of the detected link hovered, if any
+    std::atomic<bool> hyperlinkHoverEnabled_ = true;
+    std::atomic<bool> selectionOverlay_ = false;
     std::atomic<bool> renderBufferUpdateEnabled_ = true;
+    std::atomic<bool> historyReflowPending_ = false;
+
+    // Published by whichever thread changed it (the terminal thread, or the GUI thread moving the viewport),
+    // so writers are serialized, whereas readers never lock.
+    std::mutex viewStateWriteLock_;
+    crispy::seqlock<ViewState> viewState_;
 };
 
 }  // namespace terminal
@@ -19,8 +19,11 @@
 #include <unicode/convert.h>
 
 #include <algorithm>
+#include <chrono>
+#include <future>
 #include <iterator>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <iostream>
@@ -46,7 +49,7 @@ namespace // {{{ helpers
             if (gap > 0) // Did we jump?
                 currentLine.insert(currentLine.end(), gap - 1, ' ');
 
-            currentLine += unicode::convert_to<char>(u32string_view(cell.codepoints));
+            currentLine += unicode::convert_to<char>(renderBuffer.buffer.codepointsOf(cell));
             lastPos = cell.position;
             lastCount = 1;
         }
@@ -114,9 +117,21 @@ namespace // {{{ helpers
                 UNSCOPED_INFO(fmt::format("[{}] \"{}\"", row, terminal().screen().renderTextLine(row)));
         }
 
+        /// @returns the number of screenUpdated() notifications received so far.
+        int screenUpdateCount() const noexcept { return screenUpdateCount_; }
+
+        void screenUpdated() override { ++screenUpdateCount_; }
+
+        /// @returns the number of memoryTrimmed() notifications received so far.
+        int memoryTrimCount() const noexcept { return memoryTrimCount_; }
+
+        void memoryTrimmed() override { ++memoryTrimCount_; }
+
     private:
         terminal::MockPty pty_;
         terminal::Terminal terminal_;
+        int screenUpdateCount_ = 0;
+        int memoryTrimCount_ = 0;
     };
 
     std::string trimmedTextScreenshot(MockTerm const& _mt)
@@ -157,3 +172,524 @@ TEST_CASE("Terminal.SynchronizedOutput", "[terminal]")
     mc.terminal().ensureFreshRenderBuffer(now);
     CHECK("Hello  World" == trimmedTextScreenshot(mc));
 }
+
+TEST_CASE("Terminal.SynchronizedOutput.notifications", "[terminal]")
+{
+    using terminal::LatencyStage;
+    auto mc = MockTerm{{20, 1}};
+    auto const& trace = mc.terminal().latencyTrace();
+    auto const notified = mc.screenUpdateCount();
+
+    // Screen updates are held back while the batch is open, and notified once when completed.
+    mc.writeToStdout("\033[?2026hHello");
+    mc.writeToStdout(" World");
+    CHECK(mc.screenUpdateCount() == notified);
+    mc.writeToStdout("\033[?2026l");
+    CHECK(mc.screenUpdateCount() == notified + 1);
+    CHECK(trace.histogram(LatencyStage::SynchronizedOutput).count() == 1);
+
+    // Batches not completed in time are ended by the terminal.
+    mc.terminal().setSynchronizedOutputTimeout(chrono::milliseconds(0));
+    mc.writeToStdout("\033[?2026hHello");
+    mc.writeToStdout("!");
+    CHECK_FALSE(mc.terminal().screen().isModeEnabled(terminal::DECMode::BatchedRendering));
+    CHECK(trace.histogram(LatencyStage::SynchronizedOutput).count() == 2);
+}
+
+TEST_CASE("Terminal.refreshRenderBuffer.incremental", "[terminal]")
+{
+    auto const now = chrono::steady_clock::now();
+    auto mc = MockTerm{{5, 2}};
+
+    mc.writeToStdout("ab\r\ncd");
+    mc.terminal().refreshRenderBuffer(now);
+    CHECK("ab\ncd" == trimmedTextScreenshot(mc));
+
+    // Nothing changed, so every row is taken from the previous frame.
+    mc.terminal().refreshRenderBuffer(now);
+    CHECK("ab\ncd" == trimmedTextScreenshot(mc));
+
+    mc.writeToStdout("\033[1;1Hx");
+    mc.terminal().refreshRenderBuffer(now);
+    CHECK("xb\ncd" == trimmedTextScreenshot(mc));
+
+    mc.writeToStdout("\r\n\r\nef");
+    mc.terminal().refreshRenderBuffer(now);
+    CHECK("cd\nef" == trimmedTextScreenshot(mc));
+
+    mc.terminal().viewport().scrollUp(1);
+    mc.terminal().refreshRenderBuffer(now);
+    CHECK("xb\ncd" == trimmedTextScreenshot(mc));
+}
+
+TEST_CASE("Terminal.refreshRenderBuffer.paletteChange", "[terminal]")
+{
+    using terminal::PaletteSlot;
+    using terminal::RGBColor;
+
+    auto const now = chrono::steady_clock::now();
+    auto mc = MockTerm{{5, 1}};
+
+    mc.writeToStdout("\033[31ma\033[1mb");
+    mc.terminal().refreshRenderBuffer(now);
+    auto const [version, paletteVersion] = [&]() {
+        auto const frame = mc.terminal().renderBuffer();
+        REQUIRE(frame.get().screen.size() == 2);
+        CHECK(frame.get().screen[0].foregroundSlot == PaletteSlot{1});
+        CHECK(frame.get().screen[1].foregroundSlot == PaletteSlot{9}); // bold as bright
+        CHECK(frame.get().screen[0].backgroundSlot == PaletteSlot::DefaultBackground);
+        return pair{frame.get().rowVersions.at(0), frame.get().paletteVersion};
+    }();
+
+    // Cells are recolored from their palette slots.
+    mc.terminal().screen().colorPalette().palette[1] = RGBColor{0x12, 0x34, 0x56};
+    mc.terminal().refreshRenderBuffer(now);
+    {
+        auto const frame = mc.terminal().renderBuffer();
+        REQUIRE(frame.get().screen.size() == 2);
+        CHECK(frame.get().screen[0].foregroundColor == RGBColor{0x12, 0x34, 0x56});
+        CHECK(frame.get().screen[1].foregroundColor == mc.terminal().screen().colorPalette().palette[9]);
+        CHECK(frame.get().rowVersions.at(0) != version);
+        CHECK(frame.get().paletteVersion != paletteVersion);
+        CHECK(frame.get().palette.colors[1] == RGBColor{0x12, 0x34, 0x56});
+    }
+
+    // So are default colors in reverse video.
+    mc.writeToStdout("\033[?5h");
+    mc.terminal().refreshRenderBuffer(now);
+    {
+        auto const frame = mc.terminal().renderBuffer();
+        REQUIRE(frame.get().screen.size() == 2);
+        CHECK(frame.get().screen[0].backgroundColor == mc.terminal().screen().colorPalette().defaultForeground);
+        CHECK(frame.get().palette.resolve(PaletteSlot::DefaultBackground, RGBColor{})
+              == mc.terminal().screen().colorPalette().defaultForeground);
+    }
+    CHECK("ab" == trimmedTextScreenshot(mc));
+}
+
+#if defined(LIBTERMINAL_HYPERLINKS)
+TEST_CASE("Terminal.hyperlinkHovering", "[terminal]")
+{
+    auto const now = chrono::steady_clock::now();
+    auto mc = MockTerm{{10, 2}};
+
+    mc.writeToStdout("ab \033]8;;https://example.com\033\\link\033]8;;\033\\ cd");
+    mc.terminal().refreshRenderBuffer(now);
+
+    // Only changes of the hovered hyperlink are reported.
+    CHECK_FALSE(mc.terminal().sendMouseMoveEvent(terminal::MouseMoveEvent{1, 2}, now));
+    CHECK_FALSE(mc.terminal().isMouseHoveringHyperlink());
+    CHECK(mc.terminal().sendMouseMoveEvent(terminal::MouseMoveEvent{1, 4}, now));
+    CHECK(mc.terminal().isMouseHoveringHyperlink());
+    CHECK_FALSE(mc.terminal().sendMouseMoveEvent(terminal::MouseMoveEvent{1, 7}, now));
+    CHECK(mc.terminal().isMouseHoveringHyperlink());
+    CHECK(mc.terminal().sendMouseMoveEvent(terminal::MouseMoveEvent{1, 8}, now));
+    CHECK_FALSE(mc.terminal().isMouseHoveringHyperlink());
+    CHECK_FALSE(mc.terminal().sendMouseMoveEvent(terminal::MouseMoveEvent{2, 5}, now));
+}
+#endif
+
+TEST_CASE("Terminal.refreshRenderBuffer.rowVersions", "[terminal]")
+{
+    auto const now = chrono::steady_clock::now();
+    auto mc = MockTerm{{5, 3}};
+    auto const rowVersions = [&]() { return mc.terminal().renderBuffer().get().rowVersions; };
+
+    mc.writeToStdout("ab\r\ncd\r\nef");
+    mc.terminal().refreshRenderBuffer(now);
+    auto const first = rowVersions();
+    REQUIRE(first.size() == 3);
+
+    // Nothing changed, so neither did any row.
+    mc.terminal().refreshRenderBuffer(now);
+    CHECK(rowVersions() == first);
+
+    // Only the modified row gets a new version.
+    mc.writeToStdout("\033[2;1Hx");
+    mc.terminal().refreshRenderBuffer(now);
+    auto const second = rowVersions();
+    REQUIRE(second.size() == 3);
+    CHECK(second[0] == first[0]);
+    CHECK(second[1] != first[1]);
+    CHECK(second[2] == first[2]);
+
+    // Rows moved by scrolling keep their version, with their cells moved along.
+    mc.writeToStdout("\033[3;1H\r\ngh");
+    mc.terminal().refreshRenderBuffer(now);
+    auto const third = rowVersions();
+    mc.terminal().viewport().scrollUp(1);
+    mc.terminal().refreshRenderBuffer(now);
+    auto const fourth = rowVersions();
+    REQUIRE(fourth.size() == 3);
+    CHECK(fourth[1] == third[0]);
+    CHECK(fourth[2] == third[1]);
+    CHECK("ab\nxd\nef" == trimmedTextScreenshot(mc));
+}
+
+TEST_CASE("Terminal.readBuffer.adaptive", "[terminal]")
+{
+    auto mc = MockTerm{{20, 2}};
+    auto settings = terminal::Terminal::ReadBufferSettings{};
+    settings.maxSize = 4096;
+    mc.terminal().setReadBufferSettings(settings);
+    REQUIRE(mc.terminal().readBufferSize() == 1024);
+
+    // Sustained full reads grow the buffer, but not beyond its maximum.
+    mc.pty().stdoutBuffer() = string(64 * 1024, 'a');
+    for (int i = 0; i < 4; ++i)
+        mc.terminal().processInputOnce();
+    CHECK(mc.terminal().readBufferSize() == 2048);
+    for (int i = 0; i < 12; ++i)
+        mc.terminal().processInputOnce();
+    CHECK(mc.terminal().readBufferSize() == 4096);
+
+    // Partial reads keep the size, whereas being idle shrinks it back.
+    mc.pty().stdoutBuffer() = "bc";
+    mc.terminal().processInputOnce();
+    CHECK(mc.terminal().readBufferSize() == 4096);
+    mc.terminal().processInputOnce();
+    CHECK(mc.terminal().readBufferSize() == 1024);
+    CHECK(mc.terminal().screen().renderTextLine(2) == "aaaaaaaaaaaaaaaabc  ");
+}
+
+TEST_CASE("Terminal.idleMemoryTrim", "[terminal]")
+{
+    auto mc = MockTerm{{20, 2}};
+    mc.terminal().setIdleMemoryTrimDelay(chrono::milliseconds(20));
+
+    mc.writeToStdout("a");
+    CHECK(mc.memoryTrimCount() == 0);
+
+    // Memory is trimmed once per idle period.
+    this_thread::sleep_for(chrono::milliseconds(30));
+    mc.terminal().processInputOnce();
+    CHECK(mc.memoryTrimCount() == 1);
+    this_thread::sleep_for(chrono::milliseconds(30));
+    mc.terminal().processInputOnce();
+    CHECK(mc.memoryTrimCount() == 1);
+
+    mc.writeToStdout("b");
+    this_thread::sleep_for(chrono::milliseconds(30));
+    mc.terminal().processInputOnce();
+    CHECK(mc.memoryTrimCount() == 2);
+    CHECK(mc.terminal().screen().renderTextLine(1) == "ab                  ");
+}
+
+TEST_CASE("Terminal.throughputMode", "[terminal]")
+{
+    auto mc = MockTerm{{20, 2}};
+    mc.terminal().setRefreshRate(1000.0);
+    auto settings = terminal::Terminal::ThroughputModeSettings{};
+    settings.bytesPerFrame = 4;
+    settings.sustainedFrames = 2;
+    mc.terminal().setThroughputModeSettings(settings);
+
+    // The first interval also accounts for all the time before, so it takes one more to enter.
+    auto const flood = string(1000, 'a');
+    for (int i = 0; i < 3; ++i)
+    {
+        CHECK_FALSE(mc.terminal().throughputMode());
+        this_thread::sleep_for(chrono::milliseconds(2));
+        mc.writeToStdout(flood);
+    }
+    REQUIRE(mc.terminal().throughputMode());
+
+    // At most one render buffer is built per refresh interval, even if explicitly requested.
+    auto const now = chrono::steady_clock::now();
+    mc.terminal().refreshRenderBuffer(now);
+    auto const frameCount = mc.terminal().renderBufferFrameCount();
+    mc.terminal().refreshRenderBuffer(now);
+    CHECK(mc.terminal().renderBufferFrameCount() == frameCount);
+    mc.terminal().refreshRenderBuffer(now + chrono::milliseconds(1));
+    CHECK(mc.terminal().renderBufferFrameCount() == frameCount + 1);
+
+    // A refresh interval without flooding leaves throughput mode.
+    this_thread::sleep_for(chrono::milliseconds(2));
+    mc.terminal().processInputOnce();
+    CHECK_FALSE(mc.terminal().throughputMode());
+}
+
+TEST_CASE("Terminal.hidden", "[terminal]")
+{
+    auto mc = MockTerm{{20, 2}};
+    mc.writeToStdout("a");
+    auto const updateCount = mc.screenUpdateCount();
+    REQUIRE(updateCount > 0);
+
+    // Hidden terminals keep parsing, but hold back screen updates.
+    mc.terminal().setVisible(false);
+    mc.writeToStdout("b");
+    mc.writeToStdout("c");
+    CHECK(mc.terminal().screen().renderTextLine(1) == "abc                 ");
+    CHECK(mc.screenUpdateCount() == updateCount);
+
+    // Being visible again catches up with a single screen update.
+    mc.terminal().setVisible(true);
+    mc.terminal().processInputOnce();
+    CHECK(mc.screenUpdateCount() == updateCount + 1);
+    mc.terminal().processInputOnce();
+    CHECK(mc.screenUpdateCount() == updateCount + 1);
+}
+
+TEST_CASE("Terminal.viewState", "[terminal]")
+{
+    auto mc = MockTerm{{5, 2}};
+    CHECK(mc.terminal().viewState().pageSize == crispy::Size{5, 2});
+    CHECK(mc.terminal().viewState().historyLineCount == 0);
+
+    mc.writeToStdout("1\r\n2\r\n3\r\n4");
+    CHECK(mc.terminal().viewState().historyLineCount == 2);
+    CHECK(mc.terminal().viewState().scrollOffset == -1);
+    CHECK(mc.terminal().absoluteCoordinate({1, 1}) == terminal::Coordinate{2, 1});
+
+    // Moving the viewport is published right away, too.
+    mc.terminal().viewport().scrollUp(1);
+    CHECK(mc.terminal().viewState().scrollOffset == 1);
+    CHECK(mc.terminal().viewState().relativeScrollOffset() == 1);
+    CHECK(mc.terminal().absoluteCoordinate({1, 1}) == terminal::Coordinate{1, 1});
+}
+
+TEST_CASE("Terminal.latencyTrace", "[terminal]")
+{
+    using terminal::LatencyStage;
+    auto mc = MockTerm{{5, 2}};
+    auto const& trace = mc.terminal().latencyTrace();
+
+    mc.writeToStdout("ab");
+    CHECK(trace.histogram(LatencyStage::Parsed).count() == 1);
+    CHECK(trace.histogram(LatencyStage::RenderBuffer).count() == 0);
+
+    // Output is traced into the first render buffer showing it, and only that one.
+    mc.terminal().refreshRenderBuffer(chrono::steady_clock::now());
+    CHECK(trace.histogram(LatencyStage::RenderBuffer).count() == 1);
+    CHECK(mc.terminal().renderBuffer().get().outputTime != chrono::steady_clock::time_point{});
+    mc.terminal().refreshRenderBuffer(chrono::steady_clock::now());
+    CHECK(trace.histogram(LatencyStage::RenderBuffer).count() == 1);
+    CHECK(mc.terminal().renderBuffer().get().outputTime == chrono::steady_clock::time_point{});
+
+    // Key presses are traced until written, whereas other input is not.
+    mc.terminal().sendCharPressEvent(terminal::CharInputEvent{'x', terminal::Modifier::None}, chrono::steady_clock::now());
+    mc.terminal().sendRaw("y");
+    CHECK(mc.pty().stdinBuffer() == "xy");
+    CHECK(trace.histogram(LatencyStage::InputWritten).count() == 1);
+}
+
+TEST_CASE("Terminal.allocationTrace", "[terminal]")
+{
+    using terminal::AllocationPhase;
+    auto mc = MockTerm{{5, 2}};
+    auto const& trace = mc.terminal().allocationTrace();
+
+    // Parsing is accounted per byte, and input per event.
+    mc.writeToStdout("hello");
+    CHECK(trace.phase(AllocationPhase::Parse).units() == 5);
+    mc.terminal().sendCharPressEvent(terminal::CharInputEvent{'x', terminal::Modifier::None}, chrono::steady_clock::now());
+    CHECK(trace.phase(AllocationPhase::Input).units() == 1);
+    CHECK(trace.phase(AllocationPhase::RenderBuffer).units() == 0);
+}
+
+TEST_CASE("Terminal.parseStats", "[terminal]")
+{
+    using terminal::ParseStats;
+    static_assert(ParseStats::sizeClass(1) == 0);
+    static_assert(ParseStats::sizeClass(3) == 2);
+    static_assert(ParseStats::sizeClass(4096) == 12);
+    static_assert(ParseStats::sizeClass(size_t{1} << 30) == ParseStats::SizeClassCount - 1);
+
+    auto mc = MockTerm{{5, 2}};
+    auto const& stats = mc.terminal().parseStats();
+    mc.writeToStdout("hello");
+    mc.writeToStdout("ab");
+    CHECK(stats.bytes() == 7);
+    CHECK(stats.batches() == 2);
+    CHECK(stats.batches(ParseStats::sizeClass(5)) == 1);
+    CHECK(stats.batches(ParseStats::sizeClass(2)) == 1);
+}
+
+TEST_CASE("Terminal.parseSlices", "[terminal]")
+{
+    auto mc = MockTerm{{12, 2}};
+    auto settings = terminal::Terminal::ParseSliceSettings{};
+    settings.timeBudget = chrono::microseconds(1);
+    settings.minSize = 3;
+    mc.terminal().setParseSliceSettings(settings);
+
+    // Slices may end within sequences or characters, which are then continued by the next slice.
+    auto const& stats = mc.terminal().parseStats();
+    mc.writeToStdout("\033[1;31mH\xC3\xA4llo\033[m W\xC3\xB6rld");
+    CHECK(mc.terminal().screen().renderTextLine(1) == "H\xC3\xA4llo W\xC3\xB6rld ");
+    CHECK(mc.terminal().screen().attributesAt({1, 2}).styles & terminal::CellFlags::Bold);
+    CHECK_FALSE(mc.terminal().screen().attributesAt({1, 7}).styles & terminal::CellFlags::Bold);
+
+    // Statistics still account whole batches.
+    CHECK(stats.batches() == 1);
+}
+
+TEST_CASE("Terminal.predictiveEcho", "[terminal]")
+{
+    auto const now = chrono::steady_clock::now();
+    auto mc = MockTerm{{10, 2}};
+    {
+        auto const _l = scoped_lock{mc.terminal()};
+        mc.terminal().setPredictiveEcho(true);
+    }
+    auto const type = [&](char32_t _ch) {
+        mc.terminal().sendCharPressEvent(terminal::CharInputEvent{_ch, terminal::Modifier::None}, now);
+        mc.terminal().refreshRenderBuffer(now);
+    };
+    auto const underlined = [&]() {
+        auto text = string{};
+        for (terminal::RenderCell const& cell: mc.terminal().renderBuffer().get().screen)
+            if (cell.flags & terminal::CellFlags::Underline)
+                text += static_cast<char>(cell.position.column + '0');
+        return text;
+    };
+
+    // Nothing is predicted on lines other than the shell prompt.
+    mc.writeToStdout("$ ");
+    type('a');
+    CHECK("$" == trimmedTextScreenshot(mc));
+
+    mc.writeToStdout("\r\n\033[>M$ ");
+    type('b');
+    type('c');
+    CHECK("$\n$ bc" == trimmedTextScreenshot(mc));
+    CHECK(underlined() == "34");
+    auto const cursor = mc.terminal().renderBuffer().get().cursor;
+    REQUIRE(cursor.has_value());
+    CHECK(cursor->position.column == 5);
+
+    // The echo confirms the predictions one by one.
+    mc.writeToStdout("b");
+    mc.terminal().refreshRenderBuffer(now);
+    CHECK("$\n$ bc" == trimmedTextScreenshot(mc));
+    CHECK(underlined() == "4");
+
+    // A differing echo rolls back what is left.
+    mc.writeToStdout("x");
+    mc.terminal().refreshRenderBuffer(now);
+    CHECK("$\n$ bx" == trimmedTextScreenshot(mc));
+    CHECK(underlined().empty());
+
+    // So does any other input.
+    type('d');
+    CHECK(underlined() == "5");
+    type('\r');
+    CHECK("$\n$ bx" == trimmedTextScreenshot(mc));
+    CHECK(mc.pty().stdinBuffer() == "abcd\r");
+}
+
+TEST_CASE("RenderTripleBuffer", "[terminal]")
+{
+    auto const now = chrono::steady_clock::now();
+    auto buffers = terminal::RenderTripleBuffer{};
+    auto const publish = [&](int _row) {
+        auto& back = buffers.backBuffer();
+        back.clear();
+        back.cursor = terminal::RenderCursor{{_row, 1}, terminal::CursorShape::Block, 1};
+        buffers.swapBuffers(now);
+    };
+    auto const frontRow = [&]() {
+        auto const front = buffers.frontBuffer();
+        return front.get().cursor ? front.get().cursor->position.row : 0;
+    };
+
+    CHECK(frontRow() == 0);
+
+    publish(1);
+    CHECK(frontRow() == 1);
+    CHECK(frontRow() == 1); // the reader keeps its frame until a newer one got published
+
+    // The writer never waits for the reader, and the reader always picks up the newest frame.
+    publish(2);
+    publish(3);
+    CHECK(frontRow() == 3);
+    CHECK(buffers.frameCount() == 3);
+    CHECK(buffers.overwrittenFrameCount() == 1);
+}
+
+TEST_CASE("Terminal.searchHighlights", "[terminal]")
+{
+    auto const now = chrono::steady_clock::now();
+    auto mc = MockTerm{{12, 2}};
+
+    mc.writeToStdout("foo bar foo");
+    auto const matches = mc.terminal().searchSnapshot().search(std::regex("fo+"));
+    REQUIRE(matches == vector<terminal::SearchMatch>{{0, 1, 3}, {0, 9, 11}});
+
+    mc.terminal().setSearchHighlights(matches);
+    mc.terminal().refreshRenderBuffer(now);
+
+    auto const highlightedColumns = [&]() {
+        auto const& palette = mc.terminal().screen().colorPalette();
+        auto const renderBuffer = mc.terminal().renderBuffer();
+        auto columns = vector<int>{};
+        for (terminal::RenderCell const& cell: renderBuffer.buffer.screen)
+            if (cell.backgroundColor == palette.defaultForeground)
+                columns.push_back(cell.position.column);
+        return columns;
+    };
+    CHECK(highlightedColumns() == vector<int>{1, 2, 3, 9, 10, 11});
+    CHECK("foo bar foo" == trimmedTextScreenshot(mc));
+
+    mc.terminal().setSearchHighlights({});
+    mc.terminal().refreshRenderBuffer(now);
+    CHECK(highlightedColumns().empty());
+}
+
+TEST_CASE("Terminal.selectionOverlay", "[terminal]")
+{
+    auto const now = chrono::steady_clock::now();
+    auto mc = MockTerm{{5, 3}};
+    mc.writeToStdout("ab\r\ncd\r\nef");
+    mc.terminal().setSelectionOverlay(true);
+    mc.terminal().refreshRenderBuffer(now);
+    auto const rowVersions = mc.terminal().renderBuffer().get().rowVersions;
+
+    auto& screen = mc.terminal().screen();
+    auto selector = make_unique<terminal::Selector>(terminal::Selector::Mode::Linear, U",", screen, screen.toAbsolute({1, 2}));
+    selector->extend(screen.toAbsolute({2, 1}));
+    mc.terminal().setSelector(move(selector));
+    mc.terminal().refreshRenderBuffer(now);
+
+    // The selection is handed to the renderer as spans, leaving the rows as they were.
+    {
+        auto const renderBuffer = mc.terminal().renderBuffer();
+        CHECK(renderBuffer.get().rowVersions == rowVersions);
+        CHECK(renderBuffer.get().selection == vector<terminal::RenderSelection>{{1, 2, 5}, {2, 1, 1}});
+    }
+
+    // Otherwise the selected rows are rendered again, in the selection colors.
+    mc.terminal().setSelectionOverlay(false);
+    mc.terminal().refreshRenderBuffer(now);
+    auto const renderBuffer = mc.terminal().renderBuffer();
+    CHECK(renderBuffer.get().selection.empty());
+    CHECK(renderBuffer.get().rowVersions[0] != rowVersions[0]);
+    CHECK(renderBuffer.get().rowVersions[2] == rowVersions[2]);
+}
+
+TEST_CASE("Terminal.extractSelectionTextAsync", "[terminal]")
+{
+    auto mc = MockTerm{{10, 3}};
+    for (int i = 1; i <= 100; ++i)
+        mc.writeToStdout(fmt::format("line {}\r\n", i));
+
+    auto& screen = mc.terminal().screen();
+    auto selector = make_unique<terminal::Selector>(terminal::Selector::Mode::Linear, U",", screen, terminal::Coordinate{0, 3});
+    selector->extend(screen.toAbsolute({3, 10}));
+    selector->stop();
+    mc.terminal().setSelector(move(selector));
+
+    auto const expected = mc.terminal().extractSelectionText();
+    REQUIRE(expected.substr(0, 10) == "ne 1\nline ");
+    REQUIRE(expected.substr(expected.size() - 10) == "\nline 100\n");
+
+    auto done = promise<string>{};
+    auto text = string{};
+    mc.terminal().extractSelectionTextAsync([&](string_view _piece, bool _last) {
+        text += _piece;
+        if (_last)
+            done.set_value(text);
+    });
+    CHECK(done.get_future().get() == expected);
+}
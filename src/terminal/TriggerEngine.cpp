@@ -0,0 +1,133 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/TriggerEngine.h>
+
+#include <unicode/convert.h>
+
+#include <limits>
+#include <map>
+#include <string_view>
+
+using std::map;
+using std::move;
+using std::numeric_limits;
+using std::string_view;
+using std::u32string;
+using std::vector;
+
+namespace terminal {
+
+TriggerEngine::TriggerEngine(vector<Trigger> _triggers):
+    triggers_{ move(_triggers) }
+{
+    if (triggers_.size() > numeric_limits<uint16_t>::max())
+        triggers_.resize(numeric_limits<uint16_t>::max());
+
+    auto patterns = vector<u32string>{};
+    for (Trigger const& trigger: triggers_)
+    {
+        patterns.emplace_back(unicode::convert_to<char32_t>(string_view(trigger.pattern)));
+        lengths_.push_back(static_cast<int>(patterns.back().size()));
+    }
+
+    // {{{ character classes
+    auto others = map<char32_t, uint16_t>{};
+    for (u32string const& pattern: patterns)
+    {
+        for (char32_t const codepoint: pattern)
+        {
+            if (codepoint < 128)
+            {
+                if (codepoint && !asciiClasses_[codepoint])
+                    asciiClasses_[codepoint] = static_cast<uint16_t>(classCount_++);
+            }
+            else if (others.emplace(codepoint, static_cast<uint16_t>(classCount_)).second)
+                ++classCount_;
+        }
+    }
+    otherClasses_.assign(others.begin(), others.end());
+    // }}}
+
+    // {{{ trie of all patterns
+    auto constexpr None = numeric_limits<State>::max();
+    auto stateCount = size_t{1};
+    auto ownOutputs = vector<vector<uint16_t>>(1);
+    transitions_.assign(classCount_, None);
+    for (size_t i = 0; i < patterns.size(); ++i)
+    {
+        if (patterns[i].empty())
+            continue;
+
+        auto state = size_t{0};
+        for (char32_t const codepoint: patterns[i])
+        {
+            auto const transition = state * classCount_ + classOf(codepoint);
+            if (transitions_[transition] == None)
+            {
+                transitions_[transition] = static_cast<State>(stateCount++);
+                transitions_.resize(stateCount * classCount_, None);
+                ownOutputs.emplace_back();
+            }
+            state = transitions_[transition];
+        }
+        ownOutputs[state].push_back(static_cast<uint16_t>(i));
+    }
+    // }}}
+
+    // {{{ failure transitions, in breadth-first order
+    // A character not continuing any pattern from a state continues the longest pattern prefix
+    // that is a suffix of the text matched so far (its failure state), which is at a lower depth.
+    // Its transitions are thus complete by the time they are copied.
+    auto failure = vector<State>(stateCount, InitialState);
+    auto outputs = vector<vector<uint16_t>>(stateCount);
+    auto queue = vector<State>{};
+    queue.reserve(stateCount);
+    for (size_t c = 0; c < classCount_; ++c)
+    {
+        if (transitions_[c] == None)
+            transitions_[c] = InitialState;
+        else
+            queue.push_back(transitions_[c]);
+    }
+    for (size_t i = 0; i < queue.size(); ++i)
+    {
+        auto const state = queue[i];
+        outputs[state] = ownOutputs[state];
+        outputs[state].insert(outputs[state].end(), outputs[failure[state]].begin(), outputs[failure[state]].end());
+
+        for (size_t c = 0; c < classCount_; ++c)
+        {
+            auto& transition = transitions_[state * classCount_ + c];
+            auto const fallback = transitions_[failure[state] * classCount_ + c];
+            if (transition == None)
+                transition = fallback;
+            else
+            {
+                failure[transition] = fallback;
+                queue.push_back(transition);
+            }
+        }
+    }
+    // }}}
+
+    outputOffsets_.assign(1, 0);
+    outputs_.clear();
+    for (vector<uint16_t> const& stateOutputs: outputs)
+    {
+        outputs_.insert(outputs_.end(), stateOutputs.begin(), stateOutputs.end());
+        outputOffsets_.push_back(static_cast<uint32_t>(outputs_.size()));
+    }
+}
+
+} // end namespace
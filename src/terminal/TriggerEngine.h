@@ -0,0 +1,138 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace terminal {
+
+/// What to do with the lines showing a trigger's pattern.
+enum class TriggerAction : uint8_t
+{
+    Highlight,      // renders the matched text in the search highlight colors
+    Mark,           // marks the line, as if by the prompt marking sequence (see Line::marked())
+    Notify,         // shows the line in a desktop notification
+};
+
+/// Text to look out for in the terminal's output, see TriggerEngine.
+struct Trigger
+{
+    std::string pattern;    // UTF-8 encoded literal text
+    TriggerAction action = TriggerAction::Highlight;
+};
+
+/// Columns of a line showing the pattern of a trigger.
+struct TriggerMatch
+{
+    int firstColumn;        // 1-based
+    int lastColumn;
+    uint16_t trigger;       // index of the trigger within its TriggerEngine
+
+    constexpr bool operator==(TriggerMatch const& _other) const noexcept
+    {
+        return firstColumn == _other.firstColumn && lastColumn == _other.lastColumn && trigger == _other.trigger;
+    }
+    constexpr bool operator!=(TriggerMatch const& _other) const noexcept { return !(*this == _other); }
+};
+
+/// Matches the patterns of any number of triggers against the text of lines, all at once.
+///
+/// The patterns are compiled into a single Aho-Corasick automaton, whose transitions are
+/// tabulated for every state and character, so that each cell fed costs a table lookup,
+/// regardless of the number of patterns. Characters not part of any pattern share a column
+/// of that table, keeping it small.
+///
+/// Like the search, a line's text is fed one codepoint per cell, with empty cells being spaces.
+class TriggerEngine {
+  public:
+    /// State of the automaton in between two cells.
+    using State = uint32_t;
+
+    /// State before the first cell, i.e. without any pattern partially matched.
+    static constexpr State InitialState = 0;
+
+    TriggerEngine() = default;
+
+    /// Compiles the patterns of @p _triggers, ignoring those that are empty.
+    explicit TriggerEngine(std::vector<Trigger> _triggers);
+
+    std::vector<Trigger> const& triggers() const noexcept { return triggers_; }
+    bool empty() const noexcept { return triggers_.empty(); }
+
+    /// @returns whether the trigger at index @p _trigger exists and performs @p _action.
+    bool performs(uint16_t _trigger, TriggerAction _action) const noexcept
+    {
+        return _trigger < triggers_.size() && triggers_[_trigger].action == _action;
+    }
+
+    /// @returns the state after feeding the codepoint of a cell, with 0 standing for an empty cell.
+    State next(State _state, char32_t _codepoint) const noexcept
+    {
+        return transitions_[_state * classCount_ + classOf(_codepoint)];
+    }
+
+    /// Feeds the codepoint of the cell at the 1-based @p _column, with 0 standing for an empty cell,
+    /// appending the matches of the patterns ending with that cell to @p _matches.
+    void feed(State& _state, int _column, char32_t _codepoint, std::vector<TriggerMatch>& _matches) const
+    {
+        _state = next(_state, _codepoint);
+        for (auto i = outputOffsets_[_state]; i != outputOffsets_[_state + 1]; ++i)
+            _matches.push_back(TriggerMatch{ std::max(1, _column - lengths_[outputs_[i]] + 1), _column, outputs_[i] });
+    }
+
+    /// Feeds the cells of a line, given by their codepoints, and appends the matches to @p _matches.
+    ///
+    /// @param _state the state to start in, which is the one a wrapped line's predecessor
+    ///               ended in to find patterns across both (starting at column 1 of this line).
+    /// @returns the state after the last cell.
+    template <typename Codepoints>
+    State scan(Codepoints const& _codepoints, State _state, std::vector<TriggerMatch>& _matches) const
+    {
+        auto column = 0;
+        for (char32_t const codepoint: _codepoints)
+            feed(_state, ++column, codepoint, _matches);
+        return _state;
+    }
+
+  private:
+    size_t classOf(char32_t _codepoint) const noexcept;
+
+    std::vector<Trigger> triggers_;
+    std::vector<int> lengths_;                      // of each trigger's pattern, in codepoints
+
+    std::array<uint16_t, 128> asciiClasses_{};      // character class of each US-ASCII codepoint
+    std::vector<std::pair<char32_t, uint16_t>> otherClasses_; // of the other codepoints in patterns, sorted
+    size_t classCount_ = 1;                         // class 0 being all codepoints not in any pattern
+
+    std::vector<State> transitions_ = std::vector<State>(1, InitialState); // by state and class
+    std::vector<uint32_t> outputOffsets_ = std::vector<uint32_t>(2, 0);  // of each state's outputs_
+    std::vector<uint16_t> outputs_;                 // triggers matched in each state
+};
+
+inline size_t TriggerEngine::classOf(char32_t _codepoint) const noexcept
+{
+    if (_codepoint < 128)
+        return asciiClasses_[_codepoint ? _codepoint : U' '];
+
+    auto const i = std::lower_bound(otherClasses_.begin(), otherClasses_.end(), _codepoint,
+                                    [](auto const& _class, char32_t _value) { return _class.first < _value; });
+    return i != otherClasses_.end() && i->first == _codepoint ? i->second : 0;
+}
+
+} // end namespace
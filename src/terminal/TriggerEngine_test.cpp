@@ -0,0 +1,97 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/TriggerEngine.h>
+
+#include <unicode/convert.h>
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+using terminal::Trigger;
+using terminal::TriggerAction;
+using terminal::TriggerEngine;
+using terminal::TriggerMatch;
+
+namespace
+{
+    TriggerEngine makeEngine(vector<string> const& _patterns)
+    {
+        auto triggers = vector<Trigger>{};
+        for (string const& pattern: _patterns)
+            triggers.push_back(Trigger{pattern, TriggerAction::Highlight});
+        return TriggerEngine(triggers);
+    }
+
+    vector<TriggerMatch> scan(TriggerEngine const& _engine, string_view _text)
+    {
+        auto matches = vector<TriggerMatch>{};
+        _engine.scan(unicode::convert_to<char32_t>(_text), TriggerEngine::InitialState, matches);
+        return matches;
+    }
+}
+
+TEST_CASE("TriggerEngine.literals", "[triggers]")
+{
+    auto const engine = makeEngine({"ERROR", "FAILED", "warn"});
+    CHECK(scan(engine, "all fine").empty());
+    CHECK(scan(engine, "ERROR: oops") == vector<TriggerMatch>{{1, 5, 0}});
+    CHECK(scan(engine, "test FAILED, ERROR") == vector<TriggerMatch>{{6, 11, 1}, {14, 18, 0}});
+    CHECK(scan(engine, "warning: warn") == vector<TriggerMatch>{{1, 4, 2}, {10, 13, 2}});
+    CHECK(scan(engine, "error").empty());
+}
+
+TEST_CASE("TriggerEngine.overlapping", "[triggers]")
+{
+    // Patterns ending in the same cell are all matched, the longest one first.
+    auto const engine = makeEngine({"he", "she", "hers", "his"});
+    CHECK(scan(engine, "ushers") == vector<TriggerMatch>{{2, 4, 1}, {3, 4, 0}, {3, 6, 2}});
+    CHECK(scan(engine, "hhis") == vector<TriggerMatch>{{2, 4, 3}});
+    CHECK(scan(engine, "shshe") == vector<TriggerMatch>{{3, 5, 1}, {4, 5, 0}});
+}
+
+TEST_CASE("TriggerEngine.cells", "[triggers]")
+{
+    // Empty cells are spaces, and columns count cells rather than bytes.
+    auto const engine = makeEngine({"a b", "äö", ""});
+    auto matches = vector<TriggerMatch>{};
+    engine.scan(std::u32string{U'a', 0, U'b'}, TriggerEngine::InitialState, matches);
+    CHECK(matches == vector<TriggerMatch>{{1, 3, 0}});
+    CHECK(scan(engine, "xäöx") == vector<TriggerMatch>{{2, 3, 1}});
+    CHECK(scan(engine, "äxö").empty());
+}
+
+TEST_CASE("TriggerEngine.wrapped", "[triggers]")
+{
+    // A pattern continued on a wrapped line is matched from the first column of that line on.
+    auto const engine = makeEngine({"ERROR"});
+    auto matches = vector<TriggerMatch>{};
+    auto const state = engine.scan(std::u32string_view(U"an ERR"), TriggerEngine::InitialState, matches);
+    CHECK(matches.empty());
+    engine.scan(std::u32string_view(U"OR here"), state, matches);
+    CHECK(matches == vector<TriggerMatch>{{1, 2, 0}});
+}
+
+TEST_CASE("TriggerEngine.empty", "[triggers]")
+{
+    auto const engine = TriggerEngine{};
+    CHECK(engine.empty());
+    CHECK(scan(engine, "anything").empty());
+}
@@ -16,6 +16,8 @@
 #include <terminal/Screen.h>
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <optional>
 
 namespace terminal {
@@ -54,6 +56,15 @@ class Viewport {
             : 0;
     }
 
+    /// @returns the number of lines per second the viewport has recently been scrolled by,
+    ///          positive towards the bottom, or 0 if it has not been scrolled for ScrollIdleTime.
+    double scrollVelocity(std::chrono::steady_clock::time_point _now) const noexcept
+    {
+        if (std::chrono::duration<double>(_now - lastScrollTime_).count() > ScrollIdleTime)
+            return 0;
+        return scrollVelocity_;
+    }
+
     bool isLineVisible(int _row) const noexcept
     {
         return crispy::ascending(1 - relativeScrollOffset(), _row, screenLineCount() - relativeScrollOffset());
@@ -98,6 +109,7 @@ class Viewport {
         if (!scrollOffset_)
             return false;
 
+        trackScroll(*scrollOffset_, historyLineCount());
         scrollOffset_.reset();
         modified_();
         return true;
@@ -110,6 +122,7 @@ class Viewport {
 
         if (0 <= _absoluteScrollOffset && _absoluteScrollOffset < historyLineCount())
         {
+            trackScroll(scrollOffset_.value_or(historyLineCount()), _absoluteScrollOffset);
             scrollOffset_.emplace(_absoluteScrollOffset);
             modified_();
             return true;
@@ -148,6 +161,9 @@ class Viewport {
         return true;
     }
 
+    /// Seconds without scrolling after which the viewport is considered to stand still.
+    static constexpr double ScrollIdleTime = 0.25;
+
   private:
     int historyLineCount() const noexcept { return screen_.historyLineCount(); }
     int screenLineCount() const noexcept { return screen_.size().height; }
@@ -158,10 +174,27 @@ class Viewport {
         return screen_.isAlternateScreen();
     }
 
+    void trackScroll(int _from, int _to)
+    {
+        auto const now = std::chrono::steady_clock::now();
+        auto const elapsed = std::clamp(std::chrono::duration<double>(now - lastScrollTime_).count(),
+                                         0.001, ScrollIdleTime);
+        auto const velocity = (_to - _from) / elapsed;
+
+        // Scrolling anew or turning around starts over, otherwise recent moves are averaged in.
+        if (elapsed >= ScrollIdleTime || std::signbit(velocity) != std::signbit(scrollVelocity_))
+            scrollVelocity_ = velocity;
+        else
+            scrollVelocity_ = (scrollVelocity_ + velocity) / 2;
+        lastScrollTime_ = now;
+    }
+
   private:
     Screen& screen_;
     ModifyEvent modified_;
     std::optional<int> scrollOffset_; //!< scroll offset relative to scroll top (0) or nullopt if not scrolled into history
+    std::chrono::steady_clock::time_point lastScrollTime_{};
+    double scrollVelocity_ = 0; //!< lines per second, positive towards the bottom
 };
 
 }
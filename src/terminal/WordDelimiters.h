@@ -0,0 +1,68 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace terminal {
+
+/// Set of codepoints separating words, e.g. for word-wise text selection.
+///
+/// The delimiters are compiled into a bitset for ASCII codepoints and a sorted set for all others,
+/// so that testing a codepoint is a single bit test in the common case.
+class WordDelimiters {
+  public:
+    WordDelimiters() = default;
+
+    WordDelimiters(std::u32string_view _delimiters) :
+        text_{ _delimiters }
+    {
+        for (char32_t const codepoint: _delimiters)
+        {
+            if (codepoint < 128)
+                ascii_[codepoint / 64] |= uint64_t{1} << (codepoint % 64);
+            else
+                others_.push_back(codepoint);
+        }
+        std::sort(others_.begin(), others_.end());
+        others_.erase(std::unique(others_.begin(), others_.end()), others_.end());
+    }
+
+    WordDelimiters(char32_t const* _delimiters) :
+        WordDelimiters{ std::u32string_view(_delimiters) }
+    {}
+
+    bool contains(char32_t _codepoint) const noexcept
+    {
+        if (_codepoint < 128)
+            return (ascii_[_codepoint / 64] >> (_codepoint % 64)) & 1;
+
+        return !others_.empty() && std::binary_search(others_.begin(), others_.end(), _codepoint);
+    }
+
+    /// @returns the delimiters as originally given.
+    std::u32string const& text() const noexcept { return text_; }
+
+  private:
+    std::u32string text_;
+    std::array<uint64_t, 2> ascii_{};
+    std::vector<char32_t> others_;
+};
+
+} // end namespace
@@ -0,0 +1,43 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/WordDelimiters.h>
+
+#include <catch2/catch.hpp>
+
+#include <string_view>
+
+using std::u32string_view;
+
+using terminal::WordDelimiters;
+
+TEST_CASE("WordDelimiters.empty", "[selector]")
+{
+    auto const delimiters = WordDelimiters{};
+    CHECK_FALSE(delimiters.contains(U' '));
+    CHECK_FALSE(delimiters.contains(U'\0'));
+    CHECK_FALSE(delimiters.contains(U'—'));
+}
+
+TEST_CASE("WordDelimiters.contains", "[selector]")
+{
+    auto const text = u32string_view(U" ,;— \U0001F600—\x7F");
+    auto const delimiters = WordDelimiters{text};
+    CHECK(delimiters.text() == text);
+
+    auto mismatches = 0;
+    for (char32_t codepoint = 0; codepoint < 0x20000; ++codepoint)
+        if (delimiters.contains(codepoint) != (text.find(codepoint) != text.npos))
+            ++mismatches;
+    CHECK(mismatches == 0);
+}
@@ -23,10 +23,14 @@ auto const inline VTParserTag = crispy::debugtag::make("vt.parser", "Logs termin
 
 #if defined(LIBTERMINAL_LOG_RAW)
 auto const inline ScreenRawOutputTag = crispy::debugtag::make("vt.output", "Logs raw writes to the terminal screen.");
+#else
+auto const inline ScreenRawOutputTag = crispy::debugtag::disabled{};
 #endif
 
 #if defined(LIBTERMINAL_LOG_TRACE)
 auto const inline VTParserTraceTag = crispy::debugtag::make("vt.trace", "Logs terminal parser instruction trace.");
+#else
+auto const inline VTParserTraceTag = crispy::debugtag::disabled{};
 #endif
 
 }
@@ -13,11 +13,26 @@
  */
 #include <terminal/pty/ConPty.h>
 
+#include <crispy/debuglog.h>
+
+#include <fmt/format.h>
+
 #include <Windows.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
 using crispy::Size;
 using namespace std;
 
+namespace terminal {
+
+auto const inline PtyTag = crispy::debugtag::make("system.pty", "Logs PTY informations.");
+
 namespace {
     string GetLastErrorAsString()
     {
@@ -42,9 +57,65 @@ namespace {
 
         return message;
     }
-} // anonymous namespace
 
-namespace terminal {
+    /// Size in bytes of the pipes' buffers, as suggested to the system.
+    constexpr DWORD PipeBufferSize = 128 * 1024;
+
+    /// Creates a pipe, anonymous pipes not supporting overlapped I/O.
+    ///
+    /// @param _access  PIPE_ACCESS_INBOUND or PIPE_ACCESS_OUTBOUND, the direction of our end.
+    ///
+    /// @returns our end, opened for overlapped I/O, and the console's end.
+    pair<HANDLE, HANDLE> createPipe(DWORD _access)
+    {
+        static atomic<unsigned> pipeCount = 0;
+        auto const name = fmt::format("\\\\.\\pipe\\contour-conpty-{}-{}", GetCurrentProcessId(), pipeCount++);
+
+        HANDLE server = CreateNamedPipeA(name.c_str(),
+                                         _access | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                                         PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                         1,
+                                         PipeBufferSize,
+                                         PipeBufferSize,
+                                         0,
+                                         nullptr);
+        if (server == INVALID_HANDLE_VALUE)
+            throw runtime_error{ GetLastErrorAsString() };
+
+        HANDLE client = CreateFileA(name.c_str(),
+                                    _access == PIPE_ACCESS_INBOUND ? GENERIC_WRITE : GENERIC_READ,
+                                    0,
+                                    nullptr,
+                                    OPEN_EXISTING,
+                                    0,
+                                    nullptr);
+        if (client == INVALID_HANDLE_VALUE)
+        {
+            auto const error = GetLastErrorAsString();
+            CloseHandle(server);
+            throw runtime_error{ error };
+        }
+
+        // The client is connected already, which this merely confirms.
+        auto overlapped = OVERLAPPED{};
+        if (!ConnectNamedPipe(server, &overlapped) && GetLastError() != ERROR_PIPE_CONNECTED)
+        {
+            auto const error = GetLastErrorAsString();
+            CloseHandle(client);
+            CloseHandle(server);
+            throw runtime_error{ error };
+        }
+
+        return {server, client};
+    }
+
+    void resetOverlapped(OVERLAPPED& _overlapped)
+    {
+        auto const event = _overlapped.hEvent;
+        _overlapped = OVERLAPPED{};
+        _overlapped.hEvent = event;
+    }
+} // anonymous namespace
 
 ConPty::ConPty(Size const& _windowSize) :
     size_{ _windowSize }
@@ -52,18 +123,27 @@ ConPty::ConPty(Size const& _windowSize) :
     master_ = INVALID_HANDLE_VALUE;
     input_ = INVALID_HANDLE_VALUE;
     output_ = INVALID_HANDLE_VALUE;
+    wakeup_ = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+    writeOverlapped_.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    for (OutputRead& read: reads_)
+    {
+        read.overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+        read.buffer.resize(OutputReadSize);
+    }
 
     HANDLE hPipePTYIn{ INVALID_HANDLE_VALUE };
     HANDLE hPipePTYOut{ INVALID_HANDLE_VALUE };
 
     // Create the pipes to which the ConPty will connect to
-    if (!CreatePipe(&hPipePTYIn, &output_, NULL, 0))
-        throw runtime_error{ GetLastErrorAsString() };
-
-    if (!CreatePipe(&input_, &hPipePTYOut, NULL, 0))
+    tie(input_, hPipePTYOut) = createPipe(PIPE_ACCESS_INBOUND);
+    try
     {
-        CloseHandle(hPipePTYIn);
-        throw runtime_error{ GetLastErrorAsString() };
+        tie(output_, hPipePTYIn) = createPipe(PIPE_ACCESS_OUTBOUND);
+    }
+    catch (...)
+    {
+        CloseHandle(hPipePTYOut);
+        throw;
     }
 
     // Create the Pseudo Console of the required size, attached to the PTY-end of the pipes
@@ -83,11 +163,19 @@ ConPty::ConPty(Size const& _windowSize) :
 
     if (hr != S_OK)
         throw runtime_error{ GetLastErrorAsString() };
+
+    for (OutputRead& read: reads_)
+        startRead(read);
 }
 
 ConPty::~ConPty()
 {
     close();
+
+    for (OutputRead& read: reads_)
+        CloseHandle(read.overlapped.hEvent);
+    CloseHandle(writeOverlapped_.hEvent);
+    CloseHandle(wakeup_);
 }
 
 void ConPty::close()
@@ -98,17 +186,27 @@ void ConPty::close()
         master_ = INVALID_HANDLE_VALUE;
     }
 
+    // The buffers of I/O still in flight must not be released before it has been cancelled.
     if (input_ != INVALID_HANDLE_VALUE)
     {
+        CancelIoEx(input_, nullptr);
+        for (OutputRead& read: reads_)
+            if (read.state == OutputRead::State::Pending)
+                completeRead(read, true);
         CloseHandle(input_);
         input_ = INVALID_HANDLE_VALUE;
     }
 
     if (output_ != INVALID_HANDLE_VALUE)
     {
+        auto const _l = scoped_lock{writeLock_};
+        CancelIoEx(output_, nullptr);
+        finishWrite();
         CloseHandle(output_);
         output_ = INVALID_HANDLE_VALUE;
     }
+
+    SetEvent(wakeup_);
 }
 
 void ConPty::prepareParentProcess()
@@ -119,31 +217,135 @@ void ConPty::prepareChildProcess()
 {
 }
 
-int ConPty::read(char* buf, size_t size, std::chrono::milliseconds _timeout)
+void ConPty::startRead(OutputRead& _read)
 {
-    // TODO: wait for _timeout time at most AND got woken up upon wakeupReader() invokcation.
-    (void) _timeout;
+    resetOverlapped(_read.overlapped);
+    _read.size = 0;
+    _read.offset = 0;
 
-    DWORD nread{};
-    if (ReadFile(input_, buf, static_cast<DWORD>(size), &nread, nullptr))
-        return static_cast<int>(nread);
+    // Reads completing right away are collected by completeRead() just the same.
+    if (ReadFile(input_, _read.buffer.data(), OutputReadSize, nullptr, &_read.overlapped)
+            || GetLastError() == ERROR_IO_PENDING)
+        _read.state = OutputRead::State::Pending;
     else
+    {
+        debuglog(PtyTag).write("Reading PTY output failed. {}", GetLastErrorAsString());
+        _read.state = OutputRead::State::Failed;
+    }
+}
+
+bool ConPty::completeRead(OutputRead& _read, bool _wait)
+{
+    if (GetOverlappedResult(input_, &_read.overlapped, &_read.size, _wait ? TRUE : FALSE))
+    {
+        _read.state = OutputRead::State::Completed;
+        return true;
+    }
+
+    if (GetLastError() == ERROR_IO_INCOMPLETE)
+        return false;
+
+    // The console closed its end, or the read got cancelled.
+    _read.state = OutputRead::State::Failed;
+    return false;
+}
+
+int ConPty::read(char* buf, size_t size, std::chrono::milliseconds _timeout)
+{
+    if (input_ == INVALID_HANDLE_VALUE)
+    {
+        errno = ENODEV;
         return -1;
+    }
+
+    auto& head = reads_[nextRead_];
+    if (head.state == OutputRead::State::Pending && !completeRead(head, false)
+            && head.state == OutputRead::State::Pending)
+    {
+        HANDLE const handles[2] = { head.overlapped.hEvent, wakeup_ };
+        auto const timeout = static_cast<DWORD>(std::clamp<long long>(_timeout.count(), 0, INFINITE - 1));
+        switch (WaitForMultipleObjects(2, handles, FALSE, timeout))
+        {
+            case WAIT_OBJECT_0:
+                completeRead(head, true);
+                break;
+            case WAIT_OBJECT_0 + 1:
+                errno = EINTR;
+                return -1;
+            case WAIT_TIMEOUT:
+                errno = EAGAIN;
+                return -1;
+            default:
+                debuglog(PtyTag).write("Waiting for PTY output failed. {}", GetLastErrorAsString());
+                errno = EIO;
+                return -1;
+        }
+    }
+
+    // Hands out the data of all reads completed so far, in order, as far as it fits.
+    size_t count = 0;
+    while (count < size)
+    {
+        auto& read = reads_[nextRead_];
+        if (read.state == OutputRead::State::Pending && !completeRead(read, false))
+            break;
+        if (read.state == OutputRead::State::Failed)
+            break;
+
+        auto const n = std::min(size - count, static_cast<size_t>(read.size - read.offset));
+        std::memcpy(buf + count, read.buffer.data() + read.offset, n);
+        count += n;
+        read.offset += static_cast<DWORD>(n);
+        if (read.offset < read.size)
+            break;
+
+        startRead(read);
+        nextRead_ = (nextRead_ + 1) % OutputReadCount;
+    }
+
+    // Zero bytes tell the end of the output, once no more reads can be started.
+    return static_cast<int>(count);
 }
 
 void ConPty::wakeupReader()
 {
-    // TODO: Windows ConPTY does *NOT* support non-blocking / overlapped I/O.
-    // How can we make ReadFile() return early? We could maybe WriteFile() to it?
+    SetEvent(wakeup_);
 }
 
 int ConPty::write(char const* buf, size_t size)
 {
-    DWORD nwritten{};
-    if (WriteFile(output_, buf, static_cast<DWORD>(size), &nwritten, nullptr))
-        return static_cast<int>(nwritten);
-    else
+    auto const _l = scoped_lock{writeLock_};
+
+    // The write in flight is waited for, its buffer being reused, which is what
+    // keeps an application not reading its input from getting unbounded amounts of it.
+    if (!finishWrite())
+        return -1;
+
+    writeBuffer_.assign(buf, buf + size);
+    resetOverlapped(writeOverlapped_);
+    if (!WriteFile(output_, writeBuffer_.data(), static_cast<DWORD>(size), nullptr, &writeOverlapped_)
+            && GetLastError() != ERROR_IO_PENDING)
+    {
+        debuglog(PtyTag).write("Writing PTY input failed. {}", GetLastErrorAsString());
         return -1;
+    }
+
+    writePending_ = true;
+    return static_cast<int>(size);
+}
+
+bool ConPty::finishWrite()
+{
+    if (!writePending_)
+        return true;
+
+    writePending_ = false;
+    DWORD nwritten{};
+    if (GetOverlappedResult(output_, &writeOverlapped_, &nwritten, TRUE))
+        return true;
+
+    debuglog(PtyTag).write("Writing PTY input failed. {}", GetLastErrorAsString());
+    return false;
 }
 
 Size ConPty::screenSize() const noexcept
@@ -17,9 +17,21 @@
 
 #include <Windows.h>
 
+#include <array>
+#include <mutex>
+#include <vector>
+
 namespace terminal {
 
 /// ConPty implementation for newer Windows 10 versions.
+///
+/// The pseudo console is attached to named pipes, whose ends on our side are opened for
+/// overlapped I/O. That way, read() waits no longer than its timeout and can be woken up,
+/// and write() hands its data over without waiting for the console to consume it.
+///
+/// Several reads are kept outstanding on the console's output at any time, each into a buffer
+/// of its own, so that the console can go on writing while the previous output is being parsed,
+/// and read() hands out as many completed reads at once as fit into the caller's buffer.
 class ConPty : public Pty
 {
   public:
@@ -40,10 +52,41 @@ class ConPty : public Pty
     HPCON master() const noexcept { return master_; }
 
   private:
+    /// A read on the console's output, started ahead of read() asking for its data.
+    struct OutputRead {
+        enum class State { Pending, Completed, Failed };
+
+        OVERLAPPED overlapped{};
+        std::vector<char> buffer;
+        State state = State::Failed;
+        DWORD size = 0;     // number of bytes read, once completed
+        DWORD offset = 0;   // number of those bytes handed out by read() already
+    };
+
+    void startRead(OutputRead& _read);
+    bool completeRead(OutputRead& _read, bool _wait);
+
+    /// Waits for the write in flight to complete, if any.
+    ///
+    /// @returns whether it succeeded.
+    bool finishWrite();
+
+    static constexpr size_t OutputReadCount = 4;
+    static constexpr DWORD OutputReadSize = 64 * 1024;
+
     crispy::Size size_;
     HPCON master_;
-    HANDLE input_;
-    HANDLE output_;
+    HANDLE input_;      // our end of the pipe the console writes its output to
+    HANDLE output_;     // our end of the pipe the console reads its input from
+    HANDLE wakeup_;     // signaled by wakeupReader()
+
+    std::array<OutputRead, OutputReadCount> reads_;
+    size_t nextRead_ = 0; // index of the read to hand out data from next, as they complete in order
+
+    std::mutex writeLock_;
+    OVERLAPPED writeOverlapped_{};
+    std::vector<char> writeBuffer_; // data of the write in flight
+    bool writePending_ = false;
 };
 
 }  // namespace terminal
@@ -1,5 +1,7 @@
 #include <terminal/pty/MockPty.h>
 
+#include <cerrno>
+
 using crispy::Size;
 using namespace std::chrono;
 
@@ -20,6 +22,13 @@ int MockPty::read(char* _buf, size_t _size, std::chrono::milliseconds _timeout)
     // Reading from stdout.
     (void) _timeout;
 
+    if (outputBuffer_.empty())
+    {
+        // Behaves like a timed out read of a PTY with nothing to read.
+        errno = EAGAIN;
+        return -1;
+    }
+
     auto const n = std::min(outputBuffer_.size(), _size);
     std::copy(begin(outputBuffer_), next(begin(outputBuffer_), n), _buf);
     outputBuffer_.erase(0, n);
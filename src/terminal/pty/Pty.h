@@ -40,6 +40,11 @@ class Pty {
     /// That is, the current process must be already the child, i.e. via fork().
     virtual void prepareChildProcess() = 0;
 
+    /// @returns the file descriptor of the slave end of this PTY, so that a child process can be
+    ///          attached to it without fork(), or -1 if the child has to be prepared by
+    ///          prepareChildProcess() instead.
+    virtual int slaveFileDescriptor() const noexcept { return -1; }
+
     /// Reads from the terminal whatever has been written to from the other side of the terminal.
     ///
     /// @param buf    Target buffer to store the received data to.
@@ -48,6 +53,14 @@ class Pty {
     /// @returns number of bytes stored in @p buf or -1 on error.
     virtual int read(char* buf, size_t size, std::chrono::milliseconds _timeout) = 0;
 
+    /// @returns the file descriptor that becomes readable as soon as read() would not block,
+    ///          so that it can be watched by a PtyReactor, or -1 if there is none.
+    virtual int readFileDescriptor() const noexcept { return -1; }
+
+    /// @returns the file descriptor that becomes readable upon wakeupReader() or close(),
+    ///          so that it can be watched by a PtyReactor, or -1 if there is none.
+    virtual int wakeupFileDescriptor() const noexcept { return -1; }
+
     /// Inerrupts the read() operation on this PTY if a read() is currently in progress.
     ///
     /// If no read() is currently being in progress, then this call
@@ -4,45 +4,103 @@
 #if defined(_MSC_VER)
 #include <terminal/pty/ConPty.h>
 #else
+#include <terminal/pty/PtyReactor.h>
 #include <terminal/pty/UnixPty.h>
 #endif
 
+#if defined(LIBTERMINAL_IO_URING)
+#include <terminal/pty/UringPty.h>
+#endif
+
 using namespace std;
 
 namespace terminal {
 
 auto const inline ProcessTag = crispy::debugtag::make("system.process", "Logs OS process informations.");
 
-PtyProcess::PtyProcess(ExecInfo const& _exe, crispy::Size _terminalSize, optional<crispy::Size> _pixels):
-    pty_{
-        #if defined(_MSC_VER)
-            make_unique<terminal::ConPty>(_terminalSize/*TODO: , _pixels*/),
-        #else
-            make_unique<terminal::UnixPty>(_terminalSize, _pixels),
+namespace // {{{ helper
+{
+    unique_ptr<Pty> createPty(crispy::Size _terminalSize, optional<crispy::Size> _pixels)
+    {
+    #if defined(_MSC_VER)
+        (void) _pixels;
+        return make_unique<terminal::ConPty>(_terminalSize/*TODO: , _pixels*/);
+    #else
+        #if defined(LIBTERMINAL_IO_URING)
+        // Falls back to plain reads and writes if io_uring is unavailable or disabled by the kernel.
+        if (auto pty = UringPty::create(_terminalSize, _pixels); pty)
+            return pty;
         #endif
-    },
-    process_{ std::make_unique<Process>(_exe, *pty_) },
-    processExitWatcher_{
-        [this]() {
-            (void) process_->wait();
-            auto const status = process_->checkStatus();
-            if (status.has_value())
-                debuglog(ProcessTag).write("Process terminated. ({})", status.value());
-            else
-                debuglog(ProcessTag).write("Process terminated. (Unknown status)");
-            pty_->close();
-        }
+        return make_unique<terminal::UnixPty>(_terminalSize, _pixels);
+    #endif
     }
+} // }}}
+
+PtyProcess::PtyProcess(ExecInfo const& _exe, crispy::Size _terminalSize, optional<crispy::Size> _pixels):
+    pty_{ createPty(_terminalSize, _pixels) },
+    process_{ std::make_unique<Process>(_exe, *pty_) }
 {
+#if !defined(_MSC_VER)
+    auto const pid = process_->nativeHandle();
+    if (PtyReactor::shared().watchProcess(pid, [this]() { onProcessExited(); }))
+    {
+        reactorWatch_ = pid;
+        return;
+    }
+#endif
+
+    processExitWatcher_ = std::thread([this]() {
+        (void) process_->wait();
+        onProcessExited();
+    });
 }
 
 PtyProcess::~PtyProcess()
 {
+#if !defined(_MSC_VER)
+    // Not holding the exit lock while unwatching, which waits for a running exit handler.
+    auto const exited = [this]() {
+        auto const _l = scoped_lock{exitLock_};
+        return exited_;
+    }();
+    if (reactorWatch_.has_value() && !exited)
+        PtyReactor::shared().unwatchProcess(*reactorWatch_);
+#endif
+}
+
+void PtyProcess::onProcessExited()
+{
+    try
+    {
+        auto const status = process_->checkStatus();
+        if (status.has_value())
+            debuglog(ProcessTag).write("Process terminated. ({})", status.value());
+        else
+            debuglog(ProcessTag).write("Process terminated. (Unknown status)");
+    }
+    catch (exception const& e)
+    {
+        debuglog(ProcessTag).write("Process terminated. {}", e.what());
+    }
+
+    pty_->close();
+
+    {
+        auto const _l = scoped_lock{exitLock_};
+        exited_ = true;
+    }
+    exitCondition_.notify_all();
 }
 
 Process::ExitStatus PtyProcess::waitForProcessExit()
 {
-    processExitWatcher_.join();
+    if (processExitWatcher_.joinable())
+        processExitWatcher_.join();
+    else
+    {
+        auto lock = unique_lock{exitLock_};
+        exitCondition_.wait(lock, [this]() { return exited_; });
+    }
     return process_->checkStatus().value();
 }
 
@@ -73,6 +131,16 @@ void PtyProcess::wakeupReader()
     return pty_->wakeupReader();
 }
 
+int PtyProcess::readFileDescriptor() const noexcept
+{
+    return pty_->readFileDescriptor();
+}
+
+int PtyProcess::wakeupFileDescriptor() const noexcept
+{
+    return pty_->wakeupFileDescriptor();
+}
+
 int PtyProcess::write(char const* _buf, size_t _size)
 {
     return pty_->write(_buf, _size);
@@ -4,7 +4,10 @@
 
 #include <crispy/point.h>
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <thread>
 
 namespace terminal {
@@ -38,14 +41,26 @@ class PtyProcess: public Pty
     void prepareChildProcess() override;
     int read(char* buf, size_t size, std::chrono::milliseconds _timeout) override;
     void wakeupReader() override;
+    int readFileDescriptor() const noexcept override;
+    int wakeupFileDescriptor() const noexcept override;
     int write(char const* buf, size_t size) override;
     crispy::Size screenSize() const noexcept override;
     void resizeScreen(crispy::Size _cells, std::optional<crispy::Size> _pixels) override;
 
   private:
+    /// Closes the PTY once the process exited, waking up its reader.
+    void onProcessExited();
+
     std::unique_ptr<Pty> pty_;
     std::unique_ptr<Process> process_;
+
+    // The process' exit is watched by the PtyReactor where supported, and by a thread of its own otherwise.
+    std::optional<Process::NativeHandle> reactorWatch_;
     std::thread processExitWatcher_;
+
+    std::mutex exitLock_;
+    std::condition_variable exitCondition_;
+    bool exited_ = false;
 };
 
 }
@@ -0,0 +1,317 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/pty/PtyReactor.h>
+#include <terminal/logging.h>
+
+#include <crispy/debuglog.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#else
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+using std::lock_guard;
+using std::runtime_error;
+using namespace std::string_literals;
+
+namespace terminal {
+
+namespace // {{{ helper
+{
+    // Maximum number of events to be fetched per wait.
+    constexpr int EventBatchSize = 64;
+}
+// }}}
+
+PtyReactor& PtyReactor::shared()
+{
+    static PtyReactor reactor;
+    return reactor;
+}
+
+PtyReactor::PtyReactor()
+{
+#if defined(__linux__)
+    poller_ = epoll_create1(EPOLL_CLOEXEC);
+#else
+    poller_ = kqueue();
+#endif
+    if (poller_ < 0)
+        throw runtime_error{"Failed to create PTY reactor. "s + strerror(errno)};
+
+    if (pipe(wakeupPipe_.data()) < 0)
+        throw runtime_error{"Failed to create PTY reactor pipe. "s + strerror(errno)};
+    for (auto const fd: wakeupPipe_)
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+#if defined(__linux__)
+    auto event = epoll_event{};
+    event.events = EPOLLIN;
+    event.data.fd = wakeupPipe_[0];
+    epoll_ctl(poller_, EPOLL_CTL_ADD, wakeupPipe_[0], &event);
+#else
+    struct kevent event{};
+    EV_SET(&event, wakeupPipe_[0], EVFILT_READ, EV_ADD, 0, 0, nullptr);
+    kevent(poller_, &event, 1, nullptr, 0, nullptr);
+#endif
+
+    thread_ = std::thread(&PtyReactor::loop, this);
+}
+
+PtyReactor::~PtyReactor()
+{
+    quit_ = true;
+    char const dummy{};
+    auto const rv = ::write(wakeupPipe_[1], &dummy, sizeof(dummy));
+    (void) rv;
+    thread_.join();
+
+    while (!processWatches_.empty())
+        forgetProcess(processWatches_.begin()->first);
+
+    for (auto const fd: {wakeupPipe_[0], wakeupPipe_[1], poller_})
+        ::close(fd);
+}
+
+void PtyReactor::subscribe(int _fd, Handler _handler, int _wakeupFd, WakeupHandler _wakeupHandler)
+{
+    {
+        auto const _l = lock_guard{mutex_};
+        subscriptions_[_fd] = Subscription{std::move(_handler), _wakeupFd};
+        if (_wakeupFd >= 0)
+            wakeupHandlers_[_wakeupFd] = std::move(_wakeupHandler);
+    }
+    watch(_fd, true);
+    if (_wakeupFd >= 0)
+        watchWakeup(_wakeupFd);
+}
+
+void PtyReactor::unsubscribe(int _fd)
+{
+    auto const _l = lock_guard{mutex_};
+    if (auto subscription = subscriptions_.find(_fd); subscription != subscriptions_.end())
+    {
+        if (auto const wakeupFd = subscription->second.wakeupFd; wakeupFd >= 0)
+        {
+            unwatch(wakeupFd);
+            wakeupHandlers_.erase(wakeupFd);
+        }
+        subscriptions_.erase(subscription);
+    }
+    unwatch(_fd);
+}
+
+void PtyReactor::resume(int _fd)
+{
+    watch(_fd, false);
+}
+
+bool PtyReactor::watchProcess(pid_t _pid, ExitHandler _handler)
+{
+#if defined(__linux__) && !defined(SYS_pidfd_open)
+    // Built against kernel headers without pidfds.
+    (void) _pid;
+    (void) _handler;
+    return false;
+#else
+    auto const _l = lock_guard{mutex_};
+    #if defined(__linux__)
+    // The pidfd becomes readable once the process exited. It is close-on-exec already.
+    auto const ident = static_cast<int>(syscall(SYS_pidfd_open, _pid, 0));
+    if (ident < 0)
+    {
+        debuglog(TerminalTag).write("Could not open pidfd of process {}. {}", _pid, strerror(errno));
+        return false;
+    }
+    auto event = epoll_event{};
+    event.events = EPOLLIN;
+    event.data.fd = ident;
+    if (epoll_ctl(poller_, EPOLL_CTL_ADD, ident, &event) < 0)
+    {
+        debuglog(TerminalTag).write("Could not watch process {}. {}", _pid, strerror(errno));
+        ::close(ident);
+        return false;
+    }
+    #else
+    auto const ident = static_cast<int>(_pid);
+    struct kevent event{};
+    EV_SET(&event, _pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, nullptr);
+    if (kevent(poller_, &event, 1, nullptr, 0, nullptr) < 0)
+    {
+        // Also fails if the process exited already.
+        debuglog(TerminalTag).write("Could not watch process {}. {}", _pid, strerror(errno));
+        return false;
+    }
+    #endif
+    processWatches_[ident] = ProcessWatch{_pid, std::move(_handler)};
+    return true;
+#endif
+}
+
+void PtyReactor::unwatchProcess(pid_t _pid)
+{
+    auto const _l = lock_guard{mutex_};
+    for (auto const& [ident, watch]: processWatches_)
+        if (watch.pid == _pid)
+        {
+            forgetProcess(ident);
+            return;
+        }
+}
+
+void PtyReactor::forgetProcess(int _ident)
+{
+    processWatches_.erase(_ident);
+#if defined(__linux__)
+    epoll_ctl(poller_, EPOLL_CTL_DEL, _ident, nullptr);
+    ::close(_ident);
+#else
+    // One-shot events are dropped once delivered, so failures are expected here.
+    struct kevent event{};
+    EV_SET(&event, _ident, EVFILT_PROC, EV_DELETE, 0, 0, nullptr);
+    kevent(poller_, &event, 1, nullptr, 0, nullptr);
+#endif
+}
+
+void PtyReactor::watch(int _fd, bool _add)
+{
+#if defined(__linux__)
+    auto event = epoll_event{};
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.fd = _fd;
+    if (epoll_ctl(poller_, _add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, _fd, &event) < 0)
+        debuglog(TerminalTag).write("Could not watch file descriptor {}. {}", _fd, strerror(errno));
+#else
+    struct kevent event{};
+    EV_SET(&event, _fd, EVFILT_READ, _add ? EV_ADD | EV_DISPATCH : EV_ENABLE | EV_DISPATCH, 0, 0, nullptr);
+    if (kevent(poller_, &event, 1, nullptr, 0, nullptr) < 0)
+        debuglog(TerminalTag).write("Could not watch file descriptor {}. {}", _fd, strerror(errno));
+#endif
+}
+
+void PtyReactor::watchWakeup(int _fd)
+{
+    // Wakeup descriptors are drained by the reactor itself, so they are watched continuously.
+#if defined(__linux__)
+    auto event = epoll_event{};
+    event.events = EPOLLIN;
+    event.data.fd = _fd;
+    if (epoll_ctl(poller_, EPOLL_CTL_ADD, _fd, &event) < 0)
+        debuglog(TerminalTag).write("Could not watch file descriptor {}. {}", _fd, strerror(errno));
+#else
+    struct kevent event{};
+    EV_SET(&event, _fd, EVFILT_READ, EV_ADD, 0, 0, nullptr);
+    if (kevent(poller_, &event, 1, nullptr, 0, nullptr) < 0)
+        debuglog(TerminalTag).write("Could not watch file descriptor {}. {}", _fd, strerror(errno));
+#endif
+}
+
+void PtyReactor::unwatch(int _fd)
+{
+    // Closed descriptors have been dropped by the kernel already, so failures are expected here.
+#if defined(__linux__)
+    epoll_ctl(poller_, EPOLL_CTL_DEL, _fd, nullptr);
+#else
+    struct kevent event{};
+    EV_SET(&event, _fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+    kevent(poller_, &event, 1, nullptr, 0, nullptr);
+#endif
+}
+
+void PtyReactor::drain(int _fd)
+{
+    char dummy[256];
+    while (::read(_fd, dummy, sizeof(dummy)) > 0)
+        ;
+}
+
+void PtyReactor::loop()
+{
+    while (!quit_)
+    {
+#if defined(__linux__)
+        epoll_event events[EventBatchSize];
+        auto const n = epoll_wait(poller_, events, EventBatchSize, -1);
+#else
+        struct kevent events[EventBatchSize];
+        auto const n = kevent(poller_, nullptr, 0, events, EventBatchSize, nullptr);
+#endif
+        if (n < 0 && errno != EINTR)
+        {
+            debuglog(TerminalTag).write("PTY reactor failed waiting for events. {}", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+#if defined(__linux__)
+            auto const fd = events[i].data.fd;
+#else
+            auto const fd = static_cast<int>(events[i].ident);
+#endif
+            if (fd == wakeupPipe_[0])
+            {
+                drain(fd);
+                continue;
+            }
+
+            auto const _l = lock_guard{mutex_};
+#if !defined(__linux__)
+            // Process IDs may collide with file descriptors.
+            if (events[i].filter == EVFILT_PROC)
+            {
+                if (auto process = processWatches_.find(fd); process != processWatches_.end())
+                {
+                    auto const handler = std::move(process->second.handler);
+                    forgetProcess(fd);
+                    if (handler)
+                        handler();
+                }
+                continue;
+            }
+#endif
+            if (auto subscription = subscriptions_.find(fd); subscription != subscriptions_.end())
+            {
+                if (subscription->second.handler())
+                    watch(fd, false);
+            }
+            else if (auto wakeup = wakeupHandlers_.find(fd); wakeup != wakeupHandlers_.end())
+            {
+                drain(fd);
+                if (wakeup->second)
+                    wakeup->second();
+            }
+            else if (auto process = processWatches_.find(fd); process != processWatches_.end())
+            {
+                auto const handler = std::move(process->second.handler);
+                forgetProcess(fd);
+                if (handler)
+                    handler();
+            }
+        }
+    }
+}
+
+}  // namespace terminal
@@ -0,0 +1,116 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <sys/types.h>
+
+namespace terminal {
+
+/// Watches any number of file descriptors (typically PTY masters) for readability on a single
+/// thread, using epoll on Linux and kqueue elsewhere, and dispatches them to their handlers.
+///
+/// Each descriptor is watched in one-shot manner: after its handler has been invoked, it is
+/// only watched again if the handler asked for it, or once resume() has been invoked.
+/// This allows subscribers to apply back pressure without ever blocking the reactor thread.
+///
+/// Child processes can be watched for their exit, too, using a pidfd on Linux and EVFILT_PROC
+/// elsewhere, so that no thread has to block in waitpid() for each of them.
+class PtyReactor {
+  public:
+    /// Invoked on the reactor thread when the descriptor is readable.
+    ///
+    /// @returns whether the descriptor is to be watched again right away.
+    using Handler = std::function<bool()>;
+
+    /// Invoked on the reactor thread when a wakeup descriptor is readable, after draining it.
+    using WakeupHandler = std::function<void()>;
+
+    /// Invoked on the reactor thread once a watched child process exited.
+    using ExitHandler = std::function<void()>;
+
+    /// @returns the reactor shared by all terminals of this process.
+    static PtyReactor& shared();
+
+    PtyReactor();
+    PtyReactor(PtyReactor const&) = delete;
+    PtyReactor& operator=(PtyReactor const&) = delete;
+    ~PtyReactor();
+
+    /// Starts watching the given descriptor, along with an optional wakeup descriptor, such as
+    /// a pipe the PTY writes to when being closed (which silently drops it from the reactor).
+    void subscribe(int _fd, Handler _handler, int _wakeupFd = -1, WakeupHandler _wakeupHandler = {});
+
+    /// Stops watching the given descriptor.
+    ///
+    /// When this function returns, its handler is not running and will not be invoked anymore.
+    /// It must not be invoked from within a handler.
+    void unsubscribe(int _fd);
+
+    /// Watches the given descriptor again, after its handler asked not to.
+    void resume(int _fd);
+
+    /// Invokes @p _handler once the child process @p _pid exited, leaving it to be reaped by the caller.
+    ///
+    /// @returns false if the process cannot be watched, e.g. as the kernel does not support pidfds,
+    ///          in which case the caller has to wait for it by other means.
+    bool watchProcess(pid_t _pid, ExitHandler _handler);
+
+    /// Stops watching the child process @p _pid, if not exited yet.
+    ///
+    /// When this function returns, its handler is not running and will not be invoked anymore.
+    /// It must not be invoked from within a handler.
+    void unwatchProcess(pid_t _pid);
+
+  private:
+    void watch(int _fd, bool _add);
+    void watchWakeup(int _fd);
+    void unwatch(int _fd);
+    void drain(int _fd);
+    void loop();
+
+    /// Stops watching the process of the given watch, freeing its pidfd if any.
+    /// Must be invoked with the mutex held.
+    void forgetProcess(int _ident);
+
+    struct Subscription {
+        Handler handler;
+        int wakeupFd = -1;
+    };
+
+    struct ProcessWatch {
+        pid_t pid;
+        ExitHandler handler;
+    };
+
+    int poller_ = -1;
+    std::array<int, 2> wakeupPipe_ = {-1, -1};
+    std::atomic<bool> quit_ = false;
+
+    // Held while dispatching, so that unsubscribe() can wait for a running handler.
+    std::mutex mutex_;
+    std::unordered_map<int, Subscription> subscriptions_;
+    std::unordered_map<int, WakeupHandler> wakeupHandlers_;
+    std::unordered_map<int, ProcessWatch> processWatches_; // by pidfd on Linux, by process ID elsewhere
+
+    std::thread thread_;
+};
+
+}  // namespace terminal
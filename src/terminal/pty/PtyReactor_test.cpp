@@ -0,0 +1,137 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/pty/PtyReactor.h>
+
+#include <catch2/catch.hpp>
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+TEST_CASE("PtyReactor.dispatch", "[pty]")
+{
+    auto reactor = terminal::PtyReactor{};
+    auto fds = array<int, 2>{};
+    REQUIRE(pipe(fds.data()) == 0);
+
+    auto mutex = std::mutex{};
+    auto condition = condition_variable{};
+    auto received = string{};
+    auto keepWatching = true;
+
+    auto const waitFor = [&](size_t _size) {
+        auto lock = unique_lock{mutex};
+        return condition.wait_for(lock, chrono::seconds(5), [&]() { return received.size() >= _size; });
+    };
+
+    reactor.subscribe(fds[0], [&]() {
+        char buf[16];
+        auto const n = ::read(fds[0], buf, 1); // one byte at a time, to be dispatched again
+        auto const _l = lock_guard{mutex};
+        received.append(buf, static_cast<size_t>(max(n, ssize_t{0})));
+        condition.notify_one();
+        return keepWatching;
+    });
+
+    REQUIRE(::write(fds[1], "ab", 2) == 2);
+    CHECK(waitFor(2));
+    CHECK(received == "ab");
+
+    // Once the handler asks to not be watched again, nothing is dispatched until resumed.
+    {
+        auto const _l = lock_guard{mutex};
+        keepWatching = false;
+    }
+    REQUIRE(::write(fds[1], "cd", 2) == 2);
+    CHECK(waitFor(3));
+    this_thread::sleep_for(chrono::milliseconds(50));
+    CHECK(received == "abc");
+
+    {
+        auto const _l = lock_guard{mutex};
+        keepWatching = true;
+    }
+    reactor.resume(fds[0]);
+    CHECK(waitFor(4));
+    CHECK(received == "abcd");
+
+    reactor.unsubscribe(fds[0]);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST_CASE("PtyReactor.watchProcess", "[pty]")
+{
+    auto reactor = terminal::PtyReactor{};
+    auto fds = array<int, 2>{};
+    REQUIRE(pipe(fds.data()) == 0);
+
+    // The child exits once told so through the pipe.
+    auto const pid = fork();
+    REQUIRE(pid >= 0);
+    if (pid == 0)
+    {
+        char ch{};
+        (void) ::read(fds[0], &ch, 1);
+        _exit(3);
+    }
+
+    auto mutex = std::mutex{};
+    auto condition = condition_variable{};
+    auto exited = false;
+    if (!reactor.watchProcess(pid, [&]() {
+            auto const _l = lock_guard{mutex};
+            exited = true;
+            condition.notify_one();
+        }))
+    {
+        // Not supported by the kernel, e.g. no pidfds.
+        REQUIRE(::write(fds[1], "x", 1) == 1);
+        REQUIRE(waitpid(pid, nullptr, 0) == pid);
+        ::close(fds[0]);
+        ::close(fds[1]);
+        return;
+    }
+
+    this_thread::sleep_for(chrono::milliseconds(50));
+    {
+        auto const _l = lock_guard{mutex};
+        CHECK_FALSE(exited);
+    }
+
+    REQUIRE(::write(fds[1], "x", 1) == 1);
+    {
+        auto lock = unique_lock{mutex};
+        CHECK(condition.wait_for(lock, chrono::seconds(5), [&]() { return exited; }));
+    }
+
+    // The exited process is left to be reaped by the caller.
+    auto status = 0;
+    REQUIRE(waitpid(pid, &status, WNOHANG) == pid);
+    CHECK(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 3);
+
+    // Unwatching processes exited already is fine.
+    reactor.unwatchProcess(pid);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
@@ -0,0 +1,266 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/pty/PtyRecording.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+using std::get;
+using std::get_if;
+using std::min;
+using std::move;
+using std::nullopt;
+using std::optional;
+using std::runtime_error;
+using std::scoped_lock;
+using std::string;
+using std::string_view;
+
+using crispy::Size;
+
+namespace terminal {
+
+namespace // {{{ helper
+{
+    constexpr auto Magic = string_view{"CTPTYREC"};
+    constexpr char Version = 1;
+
+    constexpr char OutputEvent = 'o';
+    constexpr char ResizeEvent = 'r';
+
+    /// Reads a LEB128-encoded number from the front of @p _input, consuming it.
+    optional<uint64_t> readNumber(string_view& _input)
+    {
+        auto value = uint64_t{0};
+        for (auto shift = 0; shift < 64 && !_input.empty(); shift += 7)
+        {
+            auto const byte = static_cast<uint8_t>(_input.front());
+            _input.remove_prefix(1);
+            value |= uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        return nullopt;
+    }
+} // }}}
+
+// {{{ PtyRecording
+bool PtyRecording::isRecording(string_view _data) noexcept
+{
+    return _data.substr(0, Magic.size()) == Magic;
+}
+
+optional<PtyRecording> PtyRecording::parse(string_view _data)
+{
+    if (!isRecording(_data) || _data.size() <= Magic.size() || _data[Magic.size()] != Version)
+        return nullopt;
+
+    auto input = _data.substr(Magic.size() + 1);
+    auto recording = PtyRecording{};
+
+    // A truncated last event, e.g. of a terminal that crashed while being recorded, is dropped.
+    while (!input.empty())
+    {
+        auto const type = input.front();
+        input.remove_prefix(1);
+
+        auto const delay = readNumber(input);
+        if (!delay)
+            break;
+
+        if (type == OutputEvent)
+        {
+            auto const size = readNumber(input);
+            if (!size || *size > input.size())
+                break;
+            recording.events.emplace_back(Event{microseconds(*delay), Output{string(input.substr(0, *size))}});
+            input.remove_prefix(*size);
+        }
+        else if (type == ResizeEvent)
+        {
+            auto const columns = readNumber(input);
+            auto const lines = readNumber(input);
+            auto const pixelWidth = readNumber(input);
+            auto const pixelHeight = readNumber(input);
+            if (!pixelHeight)
+                break;
+            auto const cells = Size{static_cast<int>(*columns), static_cast<int>(*lines)};
+            auto const pixels = *pixelWidth && *pixelHeight
+                ? optional{Size{static_cast<int>(*pixelWidth), static_cast<int>(*pixelHeight)}}
+                : nullopt;
+            recording.events.emplace_back(Event{microseconds(*delay), Resize{cells, pixels}});
+        }
+        else
+            return nullopt;
+    }
+
+    return recording;
+}
+
+PtyRecording PtyRecording::fromOutput(string _output)
+{
+    auto recording = PtyRecording{};
+    recording.events.emplace_back(Event{microseconds(0), Output{move(_output)}});
+    return recording;
+}
+
+size_t PtyRecording::outputSize() const noexcept
+{
+    auto total = size_t{0};
+    for (auto const& event: events)
+        if (auto const* output = get_if<Output>(&event.value))
+            total += output->data.size();
+    return total;
+}
+// }}}
+
+// {{{ PtyRecorder
+PtyRecorder::PtyRecorder(string const& _path) :
+    file_{ _path, std::ios::binary | std::ios::trunc }
+{
+    if (!file_.good())
+        throw runtime_error{fmt::format("Could not create PTY recording {}. {}", _path, strerror(errno))};
+
+    file_.write(Magic.data(), static_cast<std::streamsize>(Magic.size()));
+    file_.put(Version);
+}
+
+void PtyRecorder::recordOutput(string_view _data, TimePoint _now)
+{
+    auto _l = scoped_lock{lock_};
+    writeEventHeader(OutputEvent, _now);
+    writeNumber(_data.size());
+    file_.write(_data.data(), static_cast<std::streamsize>(_data.size()));
+}
+
+void PtyRecorder::recordResize(Size _cells, optional<Size> _pixels, TimePoint _now)
+{
+    auto _l = scoped_lock{lock_};
+    writeEventHeader(ResizeEvent, _now);
+    writeNumber(static_cast<uint64_t>(_cells.width));
+    writeNumber(static_cast<uint64_t>(_cells.height));
+    writeNumber(_pixels ? static_cast<uint64_t>(_pixels->width) : 0);
+    writeNumber(_pixels ? static_cast<uint64_t>(_pixels->height) : 0);
+}
+
+void PtyRecorder::flush()
+{
+    auto _l = scoped_lock{lock_};
+    file_.flush();
+}
+
+void PtyRecorder::writeEventHeader(char _type, TimePoint _now)
+{
+    // Events may be recorded by different threads, so time stamps might be slightly out of order.
+    auto const delay = lastEventTime_ && _now > *lastEventTime_
+                     ? duration_cast<microseconds>(_now - *lastEventTime_).count()
+                     : 0;
+    if (!lastEventTime_ || _now > *lastEventTime_)
+        lastEventTime_ = _now;
+
+    file_.put(_type);
+    writeNumber(static_cast<uint64_t>(delay));
+}
+
+void PtyRecorder::writeNumber(uint64_t _value)
+{
+    while (_value >= 0x80)
+    {
+        file_.put(static_cast<char>((_value & 0x7F) | 0x80));
+        _value >>= 7;
+    }
+    file_.put(static_cast<char>(_value));
+}
+// }}}
+
+// {{{ PtyReplay
+PtyReplay::PtyReplay(Size _screenSize, PtyRecording _recording, Speed _speed) :
+    MockPty{ _screenSize },
+    recording_{ move(_recording) },
+    speed_{ _speed }
+{
+}
+
+bool PtyReplay::drained() const noexcept
+{
+    return nextEvent_ == recording_.events.size();
+}
+
+int PtyReplay::read(char* _buf, size_t _size, milliseconds _timeout)
+{
+    auto const advance = [this]() {
+        ++nextEvent_;
+        outputOffset_ = 0;
+        if (dueTime_ && nextEvent_ < recording_.events.size())
+            *dueTime_ += recording_.events[nextEvent_].delay;
+    };
+
+    while (nextEvent_ < recording_.events.size())
+    {
+        auto const& event = recording_.events[nextEvent_];
+
+        if (outputOffset_ == 0 && speed_ == Speed::Original)
+        {
+            // The first event is replayed right away, and each other one relative to its predecessor.
+            auto const now = steady_clock::now();
+            if (!dueTime_)
+                dueTime_ = now;
+            if (now < *dueTime_)
+            {
+                std::this_thread::sleep_for(min(duration_cast<microseconds>(*dueTime_ - now),
+                                                duration_cast<microseconds>(_timeout)));
+                if (steady_clock::now() < *dueTime_)
+                {
+                    // Behaves like a timed out read of a PTY with nothing to read.
+                    errno = EAGAIN;
+                    return -1;
+                }
+            }
+        }
+
+        if (auto const* resize = get_if<PtyRecording::Resize>(&event.value))
+        {
+            MockPty::resizeScreen(resize->cells, resize->pixels);
+            if (resizeHandler_)
+                resizeHandler_(resize->cells, resize->pixels);
+            advance();
+            continue;
+        }
+
+        auto const& output = get<PtyRecording::Output>(event.value).data;
+        auto const n = min(output.size() - outputOffset_, _size);
+        std::copy_n(output.data() + outputOffset_, n, _buf);
+        outputOffset_ += n;
+        if (outputOffset_ == output.size())
+            advance();
+        if (n != 0)
+            return static_cast<int>(n);
+    }
+
+    errno = EAGAIN;
+    return -1;
+}
+// }}}
+
+} // end namespace
@@ -0,0 +1,134 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/pty/MockPty.h>
+
+#include <crispy/size.h>
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace terminal {
+
+/// A recording of the output read from a PTY, along with the changes of the terminal size,
+/// each one with the time passed since the previous one.
+///
+/// Recordings are stored in a compact binary format: the magic "CTPTYREC" plus a version byte,
+/// followed by the events, each one being a type byte, the delay in microseconds and the payload,
+/// with all integers LEB128-encoded:
+///  - 'o' (output): number of bytes, followed by the bytes read.
+///  - 'r' (resize): columns, lines, pixel width, pixel height (pixels being 0 if unknown).
+struct PtyRecording
+{
+    struct Output
+    {
+        std::string data;
+    };
+
+    struct Resize
+    {
+        crispy::Size cells;
+        std::optional<crispy::Size> pixels;
+    };
+
+    struct Event
+    {
+        std::chrono::microseconds delay;
+        std::variant<Output, Resize> value;
+    };
+
+    std::vector<Event> events;
+
+    /// @returns whether @p _data starts like a binary PTY recording.
+    static bool isRecording(std::string_view _data) noexcept;
+
+    /// Parses a PTY recording, as written by PtyRecorder.
+    ///
+    /// @returns the recording, or std::nullopt if @p _data is not a (complete) recording.
+    static std::optional<PtyRecording> parse(std::string_view _data);
+
+    /// @returns a recording containing all of @p _output as one chunk of output.
+    static PtyRecording fromOutput(std::string _output);
+
+    /// @returns the total number of output bytes.
+    size_t outputSize() const noexcept;
+};
+
+/// Records raw PTY output and terminal size changes into a binary file (see PtyRecording),
+/// in order to reproduce a session later with PtyReplay.
+///
+/// Recording may be invoked from any thread.
+class PtyRecorder {
+  public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    /// Creates the recording file, throwing std::runtime_error if that fails.
+    explicit PtyRecorder(std::string const& _path);
+
+    void recordOutput(std::string_view _data, TimePoint _now);
+    void recordResize(crispy::Size _cells, std::optional<crispy::Size> _pixels, TimePoint _now);
+
+    void flush();
+
+  private:
+    void writeEventHeader(char _type, TimePoint _now);
+    void writeNumber(uint64_t _value);
+
+    std::mutex lock_;
+    std::ofstream file_;
+    std::optional<TimePoint> lastEventTime_;
+};
+
+/// Mock PTY, replaying a PtyRecording either at the speed it was recorded with
+/// or as fast as it is being read.
+///
+/// Each read returns at most one recorded chunk, so the terminal is being fed the same way
+/// as it was while recording.
+class PtyReplay : public MockPty
+{
+  public:
+    enum class Speed { Original, Unlimited };
+
+    /// Invoked when replaying a change of the terminal size.
+    using ResizeHandler = std::function<void(crispy::Size, std::optional<crispy::Size>)>;
+
+    /// @param _screenSize  screen size until the recording changes it.
+    PtyReplay(crispy::Size _screenSize, PtyRecording _recording, Speed _speed);
+
+    void setResizeHandler(ResizeHandler _handler) { resizeHandler_ = std::move(_handler); }
+
+    int read(char* _buf, size_t _size, std::chrono::milliseconds _timeout) override;
+
+    /// @returns whether the recording has been replayed entirely.
+    bool drained() const noexcept;
+
+  private:
+    PtyRecording recording_;
+    Speed speed_;
+    ResizeHandler resizeHandler_;
+
+    size_t nextEvent_ = 0;
+    size_t outputOffset_ = 0; // into the output event currently being read
+    std::optional<std::chrono::steady_clock::time_point> dueTime_;
+};
+
+} // end namespace
@@ -0,0 +1,141 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/pty/PtyRecording.h>
+
+#include <catch2/catch.hpp>
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono_literals;
+
+using crispy::Size;
+using terminal::PtyRecorder;
+using terminal::PtyRecording;
+using terminal::PtyReplay;
+
+namespace
+{
+    string readFile(string const& _path)
+    {
+        auto file = ifstream{_path, ios::binary};
+        return string{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+    }
+
+    PtyRecording recordSample()
+    {
+        auto const path = string{"PtyRecording_test.rec"};
+        auto const start = chrono::steady_clock::now();
+        {
+            auto recorder = PtyRecorder{path};
+            recorder.recordResize(Size{80, 25}, nullopt, start);
+            recorder.recordOutput("Hello", start + 1ms);
+            recorder.recordResize(Size{100, 30}, Size{1000, 600}, start + 2ms);
+            recorder.recordOutput(string(300, 'x'), start + 20ms);
+        }
+        auto const data = readFile(path);
+        remove(path.c_str());
+
+        REQUIRE(PtyRecording::isRecording(data));
+        auto recording = PtyRecording::parse(data);
+        REQUIRE(recording.has_value());
+        return move(*recording);
+    }
+}
+
+TEST_CASE("PtyRecording.roundtrip", "[pty]")
+{
+    auto const recording = recordSample();
+    REQUIRE(recording.events.size() == 4);
+
+    CHECK(recording.events[0].delay == 0us);
+    auto const* resize = get_if<PtyRecording::Resize>(&recording.events[0].value);
+    REQUIRE(resize);
+    CHECK(resize->cells == Size{80, 25});
+    CHECK(!resize->pixels.has_value());
+
+    CHECK(recording.events[1].delay == 1000us);
+    CHECK(get<PtyRecording::Output>(recording.events[1].value).data == "Hello");
+
+    resize = get_if<PtyRecording::Resize>(&recording.events[2].value);
+    REQUIRE(resize);
+    CHECK(resize->cells == Size{100, 30});
+    CHECK(resize->pixels == Size{1000, 600});
+
+    CHECK(recording.events[3].delay == 18000us);
+    CHECK(recording.outputSize() == 305);
+}
+
+TEST_CASE("PtyRecording.truncated", "[pty]")
+{
+    auto const path = string{"PtyRecording_test.rec"};
+    {
+        auto recorder = PtyRecorder{path};
+        recorder.recordOutput("complete", chrono::steady_clock::now());
+        recorder.recordOutput("incomplete", chrono::steady_clock::now());
+    }
+    auto const data = readFile(path);
+    remove(path.c_str());
+
+    auto const recording = PtyRecording::parse(string_view(data).substr(0, data.size() - 3));
+    REQUIRE(recording.has_value());
+    REQUIRE(recording->events.size() == 1);
+    CHECK(get<PtyRecording::Output>(recording->events[0].value).data == "complete");
+
+    CHECK(!PtyRecording::parse("not a recording").has_value());
+}
+
+TEST_CASE("PtyReplay.unlimited", "[pty]")
+{
+    auto replay = PtyReplay{Size{80, 25}, recordSample(), PtyReplay::Speed::Unlimited};
+    auto resizes = vector<Size>{};
+    replay.setResizeHandler([&](Size _cells, optional<Size>) { resizes.push_back(_cells); });
+
+    // Each read returns at most one recorded chunk.
+    auto buf = array<char, 256>{};
+    CHECK(replay.read(buf.data(), buf.size(), 0ms) == 5);
+    CHECK(string_view(buf.data(), 5) == "Hello");
+    CHECK(replay.read(buf.data(), buf.size(), 0ms) == 256);
+    CHECK(replay.read(buf.data(), buf.size(), 0ms) == 44);
+    CHECK(replay.drained());
+    CHECK(replay.read(buf.data(), buf.size(), 0ms) == -1);
+    CHECK(errno == EAGAIN);
+
+    CHECK(resizes == vector<Size>{Size{80, 25}, Size{100, 30}});
+    CHECK(replay.screenSize() == Size{100, 30});
+}
+
+TEST_CASE("PtyReplay.original", "[pty]")
+{
+    auto replay = PtyReplay{Size{80, 25}, recordSample(), PtyReplay::Speed::Original};
+
+    auto buf = array<char, 512>{};
+    auto const start = chrono::steady_clock::now();
+    CHECK(replay.read(buf.data(), buf.size(), 1s) == 5);
+
+    // The last chunk is not due yet, 18ms after the resize.
+    CHECK(replay.read(buf.data(), buf.size(), 0ms) == -1);
+    CHECK(errno == EAGAIN);
+
+    CHECK(replay.read(buf.data(), buf.size(), 1s) == 300);
+    CHECK(chrono::steady_clock::now() - start >= 19ms);
+    CHECK(replay.drained());
+}
@@ -0,0 +1,172 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/pty/PtyWriter.h>
+#include <terminal/logging.h>
+
+#include <crispy/debuglog.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+using std::lock_guard;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::string_view;
+using std::unique_lock;
+
+namespace terminal {
+
+namespace // {{{ helper
+{
+    // Time to wait before retrying a write the PTY did not accept any data for.
+    constexpr auto RetryInterval = std::chrono::milliseconds(10);
+}
+// }}}
+
+PtyWriter::PtyWriter(Pty& _pty,
+                     size_t _highWatermark,
+                     size_t _lowWatermark,
+                     CongestionHandler _handler,
+                     crispy::latency_histogram* _writeLatency) :
+    pty_{ _pty },
+    highWatermark_{ _highWatermark },
+    lowWatermark_{ std::min(_lowWatermark, _highWatermark) },
+    congestionHandler_{ std::move(_handler) },
+    writeLatency_{ _writeLatency },
+    thread_{ &PtyWriter::loop, this }
+{
+}
+
+PtyWriter::~PtyWriter()
+{
+    {
+        auto const _l = lock_guard{mutex_};
+        quit_ = true;
+    }
+    wakeup_.notify_one();
+    thread_.join();
+}
+
+void PtyWriter::write(string_view _data, Timestamp _origin)
+{
+    if (!_data.empty())
+        write(make_shared<string const>(_data), _origin);
+}
+
+void PtyWriter::write(shared_ptr<string const> _data, Timestamp _origin)
+{
+    if (!_data || _data->empty())
+        return;
+
+    auto lock = unique_lock{mutex_};
+    pendingBytes_ += _data->size();
+    queue_.push_back(Chunk{std::move(_data), _origin});
+    updateCongestion(lock);
+    wakeup_.notify_one();
+}
+
+size_t PtyWriter::pendingBytes() const
+{
+    auto const _l = lock_guard{mutex_};
+    return pendingBytes_;
+}
+
+bool PtyWriter::congested() const
+{
+    auto const _l = lock_guard{mutex_};
+    return congested_;
+}
+
+void PtyWriter::updateCongestion(unique_lock<std::mutex>& _lock)
+{
+    auto const congested = congested_ ? pendingBytes_ > lowWatermark_ : pendingBytes_ > highWatermark_;
+    if (congested == congested_)
+        return;
+
+    congested_ = congested;
+    if (!congestionHandler_)
+        return;
+
+    // The handler may well query this writer, so it must not be invoked while holding the lock.
+    _lock.unlock();
+    notifyCongestion();
+    _lock.lock();
+}
+
+void PtyWriter::notifyCongestion()
+{
+    // The state may have changed again by now, while another thread is still notifying about
+    // the previous change. Reporting the current state, rather than the one that caused this call,
+    // keeps notifications from arriving out of order.
+    auto const _l = lock_guard{congestionHandlerMutex_};
+    auto const current = congested();
+    if (current == notifiedCongested_)
+        return;
+
+    notifiedCongested_ = current;
+    congestionHandler_(current);
+}
+
+void PtyWriter::loop()
+{
+    auto lock = unique_lock{mutex_};
+    while (!quit_)
+    {
+        if (queue_.empty())
+        {
+            wakeup_.wait(lock, [&]() { return quit_ || !queue_.empty(); });
+            continue;
+        }
+
+        auto const chunk = std::move(queue_.front());
+        queue_.pop_front();
+        auto const& data = *chunk.data;
+
+        for (size_t offset = 0; offset < data.size() && !quit_; )
+        {
+            lock.unlock();
+            auto const n = pty_.write(data.data() + offset, data.size() - offset);
+            auto const error = errno;
+            lock.lock();
+
+            if (n > 0)
+            {
+                offset += static_cast<size_t>(n);
+                pendingBytes_ -= static_cast<size_t>(n);
+                if (offset == data.size() && writeLatency_ && chunk.origin != Timestamp{})
+                    writeLatency_->record(std::chrono::steady_clock::now() - chunk.origin);
+                updateCongestion(lock);
+            }
+            else if (n < 0 && (error == EAGAIN || error == EINTR))
+            {
+                // The application is not reading its input right now.
+                wakeup_.wait_for(lock, RetryInterval, [&]() { return quit_; });
+            }
+            else
+            {
+                debuglog(TerminalTag).write("PTY write failed. {} Dropping {} bytes.",
+                                            n < 0 ? strerror(error) : "", pendingBytes_);
+                queue_.clear();
+                pendingBytes_ = 0;
+                updateCongestion(lock);
+                break;
+            }
+        }
+    }
+}
+
+}  // namespace terminal
@@ -0,0 +1,105 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/pty/Pty.h>
+
+#include <crispy/latency_histogram.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace terminal {
+
+/// Writes to a PTY on a dedicated thread, so that queueing input never blocks the caller,
+/// even if the application is not reading it (e.g. while pasting megabytes into a busy editor).
+///
+/// Data is written in the order it has been queued. The amount of data still to be written
+/// is reported, so that the caller can apply back pressure.
+class PtyWriter {
+  public:
+    /// Invoked whenever the queue got congested (true), that is, it grew beyond its high
+    /// watermark, or has been drained below its low watermark again (false).
+    ///
+    /// Invocations never overlap, and each reports the state at the time of its invocation,
+    /// so that the last one always matches congested(). The handler must not queue data.
+    using CongestionHandler = std::function<void(bool)>;
+    using Timestamp = std::chrono::steady_clock::time_point;
+
+    /// @param _writeLatency  if given, records the time from the origin of each write (see write())
+    ///                       until it has been completely written to the PTY.
+    PtyWriter(Pty& _pty,
+              size_t _highWatermark,
+              size_t _lowWatermark,
+              CongestionHandler _handler = {},
+              crispy::latency_histogram* _writeLatency = nullptr);
+    PtyWriter(PtyWriter const&) = delete;
+    PtyWriter& operator=(PtyWriter const&) = delete;
+
+    /// Stops writing, dropping whatever has not been written yet.
+    ~PtyWriter();
+
+    /// Queues the given data to be written to the PTY.
+    ///
+    /// @param _origin  time the data originates from (e.g. a key press) for tracing its latency,
+    ///                 or unset if not to be traced.
+    void write(std::string_view _data, Timestamp _origin = {});
+
+    /// Queues the given data to be written to the PTY without copying it,
+    /// e.g. for pasting large texts.
+    void write(std::shared_ptr<std::string const> _data, Timestamp _origin = {});
+
+    /// @returns the number of bytes queued but not yet written.
+    size_t pendingBytes() const;
+
+    /// @returns whether the queue grew beyond its high watermark, and has not been drained yet.
+    bool congested() const;
+
+  private:
+    struct Chunk {
+        std::shared_ptr<std::string const> data;
+        Timestamp origin;
+    };
+
+    void loop();
+    void updateCongestion(std::unique_lock<std::mutex>& _lock);
+    void notifyCongestion();
+
+    Pty& pty_;
+    size_t const highWatermark_;
+    size_t const lowWatermark_;
+    CongestionHandler congestionHandler_;
+    crispy::latency_histogram* writeLatency_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::deque<Chunk> queue_;
+    size_t pendingBytes_ = 0;
+    bool congested_ = false;
+    bool quit_ = false;
+
+    std::mutex congestionHandlerMutex_;  // serializes the handler, acquired before mutex_
+    bool notifiedCongested_ = false;     // as last passed to the handler
+
+    std::thread thread_;
+};
+
+}  // namespace terminal
@@ -0,0 +1,119 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/pty/PtyWriter.h>
+#include <terminal/pty/MockPty.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace // {{{ helper
+{
+    /// MockPty whose application only reads its input once told to, and then in small portions.
+    class SlowPty : public terminal::MockPty {
+      public:
+        SlowPty() : MockPty{crispy::Size{80, 25}} {}
+
+        int write(char const* _buf, size_t _size) override
+        {
+            if (!reading)
+            {
+                errno = EAGAIN;
+                return -1;
+            }
+            auto const _l = lock_guard{inputMutex};
+            return MockPty::write(_buf, min(_size, size_t{3}));
+        }
+
+        string input()
+        {
+            auto const _l = lock_guard{inputMutex};
+            return stdinBuffer();
+        }
+
+        atomic<bool> reading = false;
+        std::mutex inputMutex;
+    };
+
+    template <typename Predicate>
+    bool waitFor(Predicate _predicate)
+    {
+        for (int i = 0; i < 500 && !_predicate(); ++i)
+            this_thread::sleep_for(chrono::milliseconds(10));
+        return _predicate();
+    }
+} // }}}
+
+TEST_CASE("PtyWriter.congestion", "[pty]")
+{
+    auto pty = SlowPty{};
+    auto congestion = vector<bool>{};
+    auto congestionMutex = std::mutex{};
+    auto writer = terminal::PtyWriter{pty, 8, 2, [&](bool _congested) {
+        auto const _l = lock_guard{congestionMutex};
+        congestion.push_back(_congested);
+    }};
+
+    // Queueing never blocks, even though nothing is written yet.
+    writer.write("hello");
+    writer.write(" world");
+    CHECK(writer.pendingBytes() == 11);
+    CHECK(writer.congested());
+
+    pty.reading = true;
+    CHECK(waitFor([&]() { return writer.pendingBytes() == 0; }));
+    CHECK(pty.input() == "hello world");
+    CHECK_FALSE(writer.congested());
+
+    auto const _l = lock_guard{congestionMutex};
+    CHECK(congestion == vector<bool>{true, false});
+}
+
+TEST_CASE("PtyWriter.dropOnDestruction", "[pty]")
+{
+    // Destructing must not wait for an application that never reads.
+    auto pty = SlowPty{};
+    {
+        auto writer = terminal::PtyWriter{pty, 1024, 512};
+        writer.write("never read");
+    }
+    CHECK(pty.input().empty());
+}
+
+TEST_CASE("PtyWriter.sharedBuffer", "[pty]")
+{
+    auto pty = SlowPty{};
+    auto writer = terminal::PtyWriter{pty, 1024, 512};
+
+    // Shared buffers are written as is, in order with copied data, and released once written.
+    auto const text = make_shared<string const>("pasted text");
+    writer.write("[");
+    writer.write(text);
+    writer.write("]");
+    CHECK(writer.pendingBytes() == 13);
+    CHECK(text.use_count() == 2);
+
+    pty.reading = true;
+    CHECK(waitFor([&]() { return writer.pendingBytes() == 0; }));
+    CHECK(pty.input() == "[pasted text]");
+    CHECK(waitFor([&]() { return text.use_count() == 1; }));
+}
@@ -32,11 +32,11 @@
 
 #include <fcntl.h>
 #include <utmp.h>
+#include <poll.h>
 #include <pwd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
-#include <sys/select.h>
 #include <unistd.h>
 
 using crispy::Size;
@@ -100,6 +100,16 @@ UnixPty::UnixPty(Size const& _windowSize, optional<Size> _pixels) :
     if (openpty(&master_, &slave_, nullptr, /*&term*/ nullptr, wsa) < 0)
         throw runtime_error{ "Failed to open PTY. "s + strerror(errno) };
 
+    // Applied here rather than in the child, as children may also be spawned without fork().
+    auto const tio = constructTerminalSettings(slave_);
+    if (tcsetattr(slave_, TCSANOW, &tio) == 0)
+        tcflush(slave_, TCIOFLUSH);
+
+    // Writes must never block, as input is queued by a PtyWriter that retries until
+    // the application reads again. Reads are only attempted once the master is readable.
+    if (fcntl(master_, F_SETFL, fcntl(master_, F_GETFL) | O_NONBLOCK) < 0)
+        debuglog(PtyTag).write("Could not make PTY master non-blocking. {}", strerror(errno));
+
 #if defined(__linux__)
     if (pipe2(pipe_.data(), O_NONBLOCK /* | O_CLOEXEC | O_NONBLOCK*/) < 0)
         throw runtime_error{ "Failed to create PTY pipe. "s + strerror(errno) };
@@ -167,27 +177,18 @@ int UnixPty::read(char* _buf, size_t _size, std::chrono::milliseconds _timeout)
         return -1;
     }
 
-    timeval tv{};
-    tv.tv_sec = _timeout.count() / 1000;
-    tv.tv_usec = (_timeout.count() % 1000) * 1000;
+    // poll() rather than select() is used, as it is not limited to descriptors below FD_SETSIZE
+    // and requires no per-call setup of descriptor sets.
+    auto const timeout = static_cast<int>(_timeout.count());
 
     for (;;)
     {
-        fd_set rfd, wfd, efd;
-        FD_ZERO(&rfd);
-        FD_ZERO(&wfd);
-        FD_ZERO(&efd);
-        FD_SET(master_, &rfd);
-        FD_SET(pipe_[0], &rfd);
-        auto const nfds = 1 + max(master_, pipe_[0]);
-
-        // debuglog(PtyTag).write(
-        //     "read: select({}, {}) for {}.{:04}s.",
-        //     master_, pipe_[0],
-        //     tv.tv_sec, tv.tv_usec / 1000
-        // );
-
-        int rv = select(nfds, &rfd, &wfd, &efd, &tv);
+        pollfd fds[2] = {
+            pollfd{master_, POLLIN, 0},
+            pollfd{pipe_[0], POLLIN, 0},
+        };
+
+        int rv = poll(fds, 2, timeout);
 
         if (rv == 0)
         {
@@ -199,20 +200,18 @@ int UnixPty::read(char* _buf, size_t _size, std::chrono::milliseconds _timeout)
             return -1;
 
         bool piped = false;
-        if (FD_ISSET(pipe_[0], &rfd))
+        if (fds[1].revents & POLLIN)
         {
             piped = true;
-            int n = 0;
             for (bool done = false; !done; )
             {
                 char dummy[256];
                 rv = ::read(pipe_[0], dummy, sizeof(dummy));
                 done = rv > 0;
-                n += max(rv, 0);
             }
         }
 
-        if (FD_ISSET(master_, &rfd))
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR))
         {
             auto const rv = static_cast<int>(::read(master_, _buf, _size));
             // debuglog(PtyTag).write("read returned {}. {}", rv, rv < 0 ? strerror(errno) : "");
@@ -273,10 +272,6 @@ void UnixPty::prepareChildProcess()
     ::close(master_);
     master_ = -1;
 
-    auto const tio = constructTerminalSettings(slave_);
-    if (tcsetattr(slave_, TCSANOW, &tio) == 0)
-        tcflush(slave_, TCIOFLUSH);
-
     if (login_tty(slave_) < 0)
         _exit(EXIT_FAILURE);
 }
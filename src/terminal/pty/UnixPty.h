@@ -34,12 +34,15 @@ class UnixPty : public Pty
 
     int read(char* buf, size_t size, std::chrono::milliseconds _timeout) override;
     void wakeupReader() override;
+    int readFileDescriptor() const noexcept override { return master_; }
+    int wakeupFileDescriptor() const noexcept override { return pipe_[0]; }
     int write(char const* buf, size_t size) override;
     crispy::Size screenSize() const noexcept override;
     void resizeScreen(crispy::Size _cells, std::optional<crispy::Size> _pixels = std::nullopt) override;
 
     void prepareParentProcess() override;
     void prepareChildProcess() override;
+    int slaveFileDescriptor() const noexcept override { return slave_; }
     void close() override;
 
   private:
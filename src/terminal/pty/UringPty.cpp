@@ -0,0 +1,537 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/pty/UringPty.h>
+#include <crispy/debuglog.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using crispy::Size;
+using std::lock_guard;
+using std::make_unique;
+using std::min;
+using std::optional;
+using std::unique_ptr;
+
+namespace terminal {
+
+auto const inline UringTag = crispy::debugtag::make("system.pty.uring", "Logs io_uring PTY informations.");
+
+namespace // {{{ helper
+{
+    // Number of registered read buffers, that is, the number of reads that may have completed
+    // but not been consumed yet, plus the one in flight.
+    constexpr unsigned BufferCount = 4;
+    constexpr size_t BufferSize = 64 * 1024;
+
+    enum class Tag : uint64_t {
+        Read = 1,
+        ReadPoll,
+        Wakeup,
+        Timeout,
+        Cancel,
+        Write,
+    };
+
+    template <typename T>
+    T* offsetOf(void* _base, unsigned _offset) noexcept
+    {
+        return reinterpret_cast<T*>(static_cast<char*>(_base) + _offset);
+    }
+} // }}}
+
+/// Minimal io_uring submission and completion queue pair, along with the read buffers
+/// registered with it (if any).
+class UringPty::Ring {
+  public:
+    static unique_ptr<Ring> create(unsigned _entries, unsigned _bufferCount);
+
+    ~Ring();
+
+    /// @returns a cleared submission queue entry, or nullptr if the submission queue is full.
+    io_uring_sqe* prepare(uint8_t _opcode, int _fd, Tag _tag) noexcept;
+
+    /// Submits all prepared entries and waits for at least @p _waitCount completions.
+    ///
+    /// @retval true on success.
+    /// @retval false on failure, with errno set accordingly.
+    bool submit(unsigned _waitCount) noexcept;
+
+    /// Invokes @p _handler for each of the currently available completions.
+    template <typename Handler>
+    void reap(Handler&& _handler)
+    {
+        auto head = *cqHead_;
+        auto const tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        while (head != tail)
+        {
+            _handler(cqes_[head & *cqMask_]);
+            ++head;
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    }
+
+    struct Chunk {
+        unsigned buffer;
+        size_t offset;
+        size_t size;
+    };
+
+    // {{{ read state, only touched by the reading thread
+    std::vector<char> buffers;
+    bool fixedBuffers = false;
+    std::deque<Chunk> completed;
+    unsigned nextBuffer = 0;
+    bool readPending = false;
+    bool pollBeforeRead = false;
+    optional<int> readFailure;
+    bool wakeupPending = false;
+    bool woken = false;
+    bool timeoutPending = false;
+    bool timedOut = false;
+    __kernel_timespec timeout{};
+    // }}}
+
+  private:
+    Ring() = default;
+
+    int fd_ = -1;
+    void* sqRing_ = MAP_FAILED;
+    size_t sqRingSize_ = 0;
+    void* cqRing_ = MAP_FAILED;
+    size_t cqRingSize_ = 0;
+    io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize_ = 0;
+
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqMask_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqEntries_ = 0;
+    unsigned unsubmitted_ = 0;
+
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned* cqMask_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+unique_ptr<UringPty::Ring> UringPty::Ring::create(unsigned _entries, unsigned _bufferCount)
+{
+    auto params = io_uring_params{};
+    auto const fd = static_cast<int>(syscall(__NR_io_uring_setup, _entries, &params));
+    if (fd < 0)
+    {
+        debuglog(UringTag).write("io_uring setup failed. {}", strerror(errno));
+        return {};
+    }
+
+    auto ring = unique_ptr<Ring>(new Ring());
+    ring->fd_ = fd;
+
+    // Reading from the current file position requires Linux 5.6, which also provides all
+    // operations used here.
+    if (!(params.features & IORING_FEAT_RW_CUR_POS))
+    {
+        debuglog(UringTag).write("io_uring lacks required features (0x{:x}).", params.features);
+        return {};
+    }
+
+    ring->sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring->sqRingSize_ = ring->cqRingSize_ = std::max(ring->sqRingSize_, ring->cqRingSize_);
+
+    ring->sqRing_ = mmap(nullptr, ring->sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd, IORING_OFF_SQ_RING);
+    if (ring->sqRing_ == MAP_FAILED)
+        return {};
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring->cqRing_ = ring->sqRing_;
+    else
+    {
+        ring->cqRing_ = mmap(nullptr, ring->cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             fd, IORING_OFF_CQ_RING);
+        if (ring->cqRing_ == MAP_FAILED)
+            return {};
+    }
+
+    ring->sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, ring->sqesSize_, PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (ring->sqes_ == MAP_FAILED)
+        return {};
+
+    ring->sqHead_ = offsetOf<unsigned>(ring->sqRing_, params.sq_off.head);
+    ring->sqTail_ = offsetOf<unsigned>(ring->sqRing_, params.sq_off.tail);
+    ring->sqMask_ = offsetOf<unsigned>(ring->sqRing_, params.sq_off.ring_mask);
+    ring->sqArray_ = offsetOf<unsigned>(ring->sqRing_, params.sq_off.array);
+    ring->sqEntries_ = params.sq_entries;
+
+    ring->cqHead_ = offsetOf<unsigned>(ring->cqRing_, params.cq_off.head);
+    ring->cqTail_ = offsetOf<unsigned>(ring->cqRing_, params.cq_off.tail);
+    ring->cqMask_ = offsetOf<unsigned>(ring->cqRing_, params.cq_off.ring_mask);
+    ring->cqes_ = offsetOf<io_uring_cqe>(ring->cqRing_, params.cq_off.cqes);
+
+    if (_bufferCount != 0)
+    {
+        ring->buffers.resize(_bufferCount * BufferSize);
+
+        // Registering buffers saves mapping them on every read, but counts against
+        // RLIMIT_MEMLOCK, so plain reads are used into the very same buffers if that fails.
+        iovec iovecs[BufferCount];
+        for (unsigned i = 0; i < _bufferCount; ++i)
+            iovecs[i] = iovec{ring->buffers.data() + i * BufferSize, BufferSize};
+        ring->fixedBuffers = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+                                     iovecs, _bufferCount) == 0;
+        if (!ring->fixedBuffers)
+            debuglog(UringTag).write("Could not register read buffers. {}", strerror(errno));
+    }
+
+    return ring;
+}
+
+UringPty::Ring::~Ring()
+{
+    if (sqes_ != MAP_FAILED)
+        munmap(sqes_, sqesSize_);
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+        munmap(cqRing_, cqRingSize_);
+    if (sqRing_ != MAP_FAILED)
+        munmap(sqRing_, sqRingSize_);
+
+    // Closing the ring also cancels any operation still in flight.
+    if (fd_ >= 0)
+        ::close(fd_);
+}
+
+io_uring_sqe* UringPty::Ring::prepare(uint8_t _opcode, int _fd, Tag _tag) noexcept
+{
+    auto const tail = *sqTail_;
+    if (tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+        return nullptr;
+
+    auto const index = tail & *sqMask_;
+    auto* sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = _opcode;
+    sqe->fd = _fd;
+    sqe->user_data = static_cast<uint64_t>(_tag);
+    sqArray_[index] = index;
+
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    ++unsubmitted_;
+    return sqe;
+}
+
+bool UringPty::Ring::submit(unsigned _waitCount) noexcept
+{
+    if (unsubmitted_ == 0 && _waitCount == 0)
+        return true;
+
+    auto const flags = _waitCount != 0 ? IORING_ENTER_GETEVENTS : 0u;
+    auto const rv = syscall(__NR_io_uring_enter, fd_, unsubmitted_, _waitCount, flags, nullptr, 0);
+    if (rv < 0)
+        return false;
+
+    unsubmitted_ -= min(unsubmitted_, static_cast<unsigned>(rv));
+    return true;
+}
+
+unique_ptr<UringPty> UringPty::create(Size const& _windowSize, optional<Size> _pixels)
+{
+    auto reader = Ring::create(16, BufferCount);
+    if (!reader)
+        return {};
+
+    auto writer = Ring::create(4, 0);
+    if (!writer)
+        return {};
+
+    return unique_ptr<UringPty>(new UringPty(_windowSize, _pixels, std::move(reader), std::move(writer)));
+}
+
+UringPty::UringPty(Size const& _windowSize, optional<Size> _pixels,
+                   unique_ptr<Ring> _reader, unique_ptr<Ring> _writer) :
+    pty_{ _windowSize, _pixels },
+    reader_{ std::move(_reader) },
+    writer_{ std::move(_writer) }
+{
+    debuglog(UringTag).write("PTY uses io_uring. (registered buffers: {})", reader_->fixedBuffers);
+}
+
+UringPty::~UringPty()
+{
+}
+
+void UringPty::close()
+{
+    pty_.close();
+}
+
+void UringPty::wakeupReader()
+{
+    pty_.wakeupReader();
+}
+
+void UringPty::submitRead()
+{
+    auto& ring = *reader_;
+    if (ring.readPending || ring.readFailure || ring.completed.size() + 1 >= BufferCount)
+        return;
+
+    auto const master = pty_.readFileDescriptor();
+
+    // A non-blocking master would just fail with EAGAIN, so it is polled first,
+    // with the read being linked to the poll's successful completion.
+    if (ring.pollBeforeRead)
+    {
+        auto* poll = ring.prepare(IORING_OP_POLL_ADD, master, Tag::ReadPoll);
+        if (!poll)
+            return;
+        poll->poll_events = POLLIN;
+        poll->flags = IOSQE_IO_LINK;
+    }
+
+    auto const index = ring.nextBuffer;
+    auto* sqe = ring.prepare(ring.fixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ, master, Tag::Read);
+    if (!sqe)
+        return;
+    sqe->addr = reinterpret_cast<uint64_t>(ring.buffers.data() + index * BufferSize);
+    sqe->len = BufferSize;
+    sqe->off = static_cast<uint64_t>(-1); // current position, as the PTY is not seekable
+    sqe->buf_index = static_cast<uint16_t>(index);
+    ring.readPending = true;
+}
+
+void UringPty::submitWakeup()
+{
+    auto& ring = *reader_;
+    if (ring.wakeupPending)
+        return;
+
+    if (auto* sqe = ring.prepare(IORING_OP_POLL_ADD, pty_.wakeupFileDescriptor(), Tag::Wakeup); sqe)
+    {
+        sqe->poll_events = POLLIN;
+        ring.wakeupPending = true;
+    }
+}
+
+void UringPty::submitTimeout(std::chrono::milliseconds _timeout)
+{
+    auto& ring = *reader_;
+    if (ring.timeoutPending || _timeout.count() < 0)
+        return;
+
+    if (auto* sqe = ring.prepare(IORING_OP_TIMEOUT, -1, Tag::Timeout); sqe)
+    {
+        ring.timeout.tv_sec = _timeout.count() / 1000;
+        ring.timeout.tv_nsec = (_timeout.count() % 1000) * 1000000;
+        sqe->addr = reinterpret_cast<uint64_t>(&ring.timeout);
+        sqe->len = 1;
+        sqe->off = 1; // also completes as soon as any other operation completes
+        ring.timeoutPending = true;
+    }
+}
+
+void UringPty::reapCompletions()
+{
+    auto& ring = *reader_;
+    ring.reap([&](io_uring_cqe const& _cqe) {
+        switch (static_cast<Tag>(_cqe.user_data))
+        {
+            case Tag::Read:
+                ring.readPending = false;
+                if (_cqe.res > 0)
+                {
+                    ring.completed.push_back(Ring::Chunk{ring.nextBuffer, 0, static_cast<size_t>(_cqe.res)});
+                    ring.nextBuffer = (ring.nextBuffer + 1) % BufferCount;
+                }
+                else if (_cqe.res == -EAGAIN)
+                    ring.pollBeforeRead = true;
+                else if (_cqe.res != -ECANCELED && _cqe.res != -EINTR)
+                    ring.readFailure = _cqe.res;
+                break;
+            case Tag::Wakeup:
+                ring.wakeupPending = false;
+                if (_cqe.res >= 0)
+                {
+                    char dummy[256];
+                    while (::read(pty_.wakeupFileDescriptor(), dummy, sizeof(dummy)) > 0)
+                        ;
+                    ring.woken = true;
+                }
+                break;
+            case Tag::Timeout:
+                ring.timeoutPending = false;
+                if (_cqe.res == -ETIME)
+                    ring.timedOut = true;
+                break;
+            case Tag::ReadPoll:
+            case Tag::Cancel:
+            case Tag::Write:
+                break;
+        }
+    });
+}
+
+int UringPty::readCompleted(char* _buf, size_t _size)
+{
+    // Copies out as many completed reads as fit, leaving the remains for the next call.
+    auto& ring = *reader_;
+    size_t n = 0;
+    while (!ring.completed.empty() && n < _size)
+    {
+        auto& chunk = ring.completed.front();
+        auto const count = min(chunk.size, _size - n);
+        memcpy(_buf + n, ring.buffers.data() + chunk.buffer * BufferSize + chunk.offset, count);
+        n += count;
+        chunk.offset += count;
+        chunk.size -= count;
+        if (chunk.size == 0)
+            ring.completed.pop_front();
+    }
+    return static_cast<int>(n);
+}
+
+int UringPty::read(char* _buf, size_t _size, std::chrono::milliseconds _timeout)
+{
+    auto& ring = *reader_;
+
+    if (pty_.readFileDescriptor() < 0)
+    {
+        if (ring.readPending)
+        {
+            // The ring still references the closed master; let go of it.
+            if (auto* sqe = ring.prepare(IORING_OP_ASYNC_CANCEL, -1, Tag::Cancel); sqe)
+            {
+                sqe->addr = static_cast<uint64_t>(Tag::Read);
+                ring.submit(0);
+            }
+        }
+        debuglog(UringTag).write("read() called with closed PTY master.");
+        errno = ENODEV;
+        return -1;
+    }
+
+    for (;;)
+    {
+        if (!ring.completed.empty())
+        {
+            auto const n = readCompleted(_buf, _size);
+
+            // Have the kernel fill the next buffer while the caller processes this one.
+            submitRead();
+            ring.submit(0);
+            return n;
+        }
+
+        if (ring.readFailure)
+        {
+            auto const rv = *ring.readFailure;
+            ring.readFailure.reset();
+            if (rv == 0)
+                return 0;
+            errno = -rv;
+            return -1;
+        }
+
+        if (ring.woken)
+        {
+            ring.woken = false;
+            errno = EINTR;
+            return -1;
+        }
+
+        if (ring.timedOut)
+        {
+            ring.timedOut = false;
+            errno = EAGAIN;
+            return -1;
+        }
+
+        submitRead();
+        submitWakeup();
+        submitTimeout(_timeout);
+
+        if (!ring.submit(1) && errno != EINTR)
+            return -1;
+
+        reapCompletions();
+    }
+}
+
+int UringPty::write(char const* _buf, size_t _size)
+{
+    auto const _l = lock_guard{writeLock_};
+    auto& ring = *writer_;
+
+    auto* sqe = ring.prepare(IORING_OP_WRITE, pty_.readFileDescriptor(), Tag::Write);
+    if (!sqe)
+    {
+        errno = EBUSY;
+        return -1;
+    }
+    sqe->addr = reinterpret_cast<uint64_t>(_buf);
+    sqe->len = static_cast<unsigned>(min(_size, size_t{0x7FFFF000}));
+    sqe->off = static_cast<uint64_t>(-1);
+
+    optional<int> result;
+    while (!result)
+    {
+        if (!ring.submit(1) && errno != EINTR)
+            return -1;
+        ring.reap([&](io_uring_cqe const& _cqe) { result = _cqe.res; });
+    }
+
+    if (*result < 0)
+    {
+        errno = -*result;
+        return -1;
+    }
+    return *result;
+}
+
+Size UringPty::screenSize() const noexcept
+{
+    return pty_.screenSize();
+}
+
+void UringPty::resizeScreen(Size _cells, optional<Size> _pixels)
+{
+    pty_.resizeScreen(_cells, _pixels);
+}
+
+void UringPty::prepareParentProcess()
+{
+    pty_.prepareParentProcess();
+}
+
+void UringPty::prepareChildProcess()
+{
+    pty_.prepareChildProcess();
+}
+
+}  // namespace terminal
@@ -0,0 +1,77 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/pty/Pty.h>
+#include <terminal/pty/UnixPty.h>
+
+#include <memory>
+#include <mutex>
+#include <optional>
+
+namespace terminal {
+
+/// Linux PTY performing its I/O through io_uring.
+///
+/// The PTY itself is opened and configured just like UnixPty. Reads are served from a set of
+/// registered buffers, with the next read already in flight while the previous one is being
+/// processed, and with all available completions being reaped at once. Reading, waiting for
+/// wakeups, and the read timeout share a single io_uring_enter() call.
+class UringPty : public Pty
+{
+  public:
+    /// @returns a new PTY, or nullptr if io_uring is not available on this system.
+    static std::unique_ptr<UringPty> create(crispy::Size const& _windowSize,
+                                            std::optional<crispy::Size> _pixels = std::nullopt);
+
+    ~UringPty() override;
+
+    int read(char* buf, size_t size, std::chrono::milliseconds _timeout) override;
+    void wakeupReader() override;
+
+    // Reads are always in flight on the ring, so the descriptors must not be watched elsewhere.
+    int readFileDescriptor() const noexcept override { return -1; }
+    int wakeupFileDescriptor() const noexcept override { return -1; }
+
+    int write(char const* buf, size_t size) override;
+    crispy::Size screenSize() const noexcept override;
+    void resizeScreen(crispy::Size _cells, std::optional<crispy::Size> _pixels = std::nullopt) override;
+
+    void prepareParentProcess() override;
+    void prepareChildProcess() override;
+    int slaveFileDescriptor() const noexcept override { return pty_.slaveFileDescriptor(); }
+    void close() override;
+
+  private:
+    class Ring;
+
+    UringPty(crispy::Size const& _windowSize, std::optional<crispy::Size> _pixels,
+             std::unique_ptr<Ring> _reader, std::unique_ptr<Ring> _writer);
+
+    int readCompleted(char* _buf, size_t _size);
+    void submitRead();
+    void submitWakeup();
+    void submitTimeout(std::chrono::milliseconds _timeout);
+    void reapCompletions();
+
+    UnixPty pty_;
+
+    // Reads are performed by a single thread, whereas writes may come from any other one,
+    // so each of them get their own ring, rather than having to share their completions.
+    std::unique_ptr<Ring> reader_;
+    std::unique_ptr<Ring> writer_;
+    std::mutex writeLock_;
+};
+
+}  // namespace terminal
@@ -0,0 +1,69 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/pty/UringPty.h>
+
+#include <catch2/catch.hpp>
+
+#include <cerrno>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+TEST_CASE("UringPty.readWrite", "[pty]")
+{
+    auto pty = terminal::UringPty::create(crispy::Size{80, 25});
+    if (!pty)
+    {
+        WARN("io_uring not available, skipping.");
+        return;
+    }
+
+    char buf[64];
+
+    SECTION("timeout") {
+        CHECK(pty->read(buf, sizeof(buf), chrono::milliseconds(10)) == -1);
+        CHECK(errno == EAGAIN);
+    }
+
+    SECTION("echo") {
+        // The line discipline echoes whatever is written to the master back to it.
+        REQUIRE(pty->write("hello", 5) == 5);
+        auto received = string{};
+        while (received.size() < 5)
+        {
+            auto const n = pty->read(buf, 2, chrono::seconds(5)); // less than a read completed
+            REQUIRE(n > 0);
+            received.append(buf, static_cast<size_t>(n));
+        }
+        CHECK(received == "hello");
+    }
+
+    SECTION("wakeup") {
+        auto waker = thread([&]() {
+            this_thread::sleep_for(chrono::milliseconds(20));
+            pty->wakeupReader();
+        });
+        CHECK(pty->read(buf, sizeof(buf), chrono::seconds(5)) == -1);
+        CHECK(errno == EINTR);
+        waker.join();
+    }
+
+    SECTION("close") {
+        pty->close();
+        CHECK(pty->read(buf, sizeof(buf), chrono::seconds(5)) == -1);
+        CHECK(errno == ENODEV);
+    }
+}
@@ -58,89 +58,143 @@ TextureAtlasAllocator::~TextureAtlasAllocator()
 
 void TextureAtlasAllocator::clear()
 {
-    maxTextureHeightInCurrentRow_ = 0;
     discarded_.clear();
+    shelves_.clear();
 
     unusedAtlasIDs_.insert(
         unusedAtlasIDs_.end(),
         atlasIDs_.begin(),
         prev(atlasIDs_.end()));
     atlasIDs_.clear();
-    atlasIDs_.push_back(cursor_.atlas);
+    atlasIDs_.push_back(currentAtlas_);
 
-    cursor_.position.x = 0;
-    cursor_.position.y = 0;
+    nextShelfY_ = 0;
 }
 
-optional<TextureAtlasAllocator::Cursor> TextureAtlasAllocator::getOffsetAndAdvance(crispy::Size _size)
+void TextureAtlasAllocator::releaseUnusedAtlases()
 {
-    if (!(cursor_.position.x + HorizontalGap + _size.width < size_.width))
+    for (auto const atlasID: unusedAtlasIDs_)
+        atlasBackend_.destroyAtlas(atlasID);
+    unusedAtlasIDs_.clear();
+    unusedAtlasIDs_.shrink_to_fit();
+}
+
+optional<pair<TextureAtlasAllocator::Cursor, Size>> TextureAtlasAllocator::allocateOnShelf(Size _size)
+{
+    auto const shelfHeight = shelfHeightFor(_size.height);
+    auto const fits = [&](Shelf const& _shelf) {
+        return _shelf.height >= _size.height && _shelf.x + _size.width <= size_.width;
+    };
+
+    // Prefer a shelf of the texture's own size class.
+    Shelf* shelf = nullptr;
+    for (Shelf& candidate: shelves_)
     {
-        cursor_.position.x = 0;
-        cursor_.position.y += maxTextureHeightInCurrentRow_ + VerticalGap;
-        if (!(cursor_.position.y + _size.height < size_.height))
+        if (candidate.height == shelfHeight && fits(candidate))
         {
-            cursor_.position.y = 0;
-            maxTextureHeightInCurrentRow_ = 0;
-
-            if (!(atlasIDs_.size() + 1 < maxInstances_))
-            {
-                cursor_.position.x = size_.width;
-                cursor_.position.y = size_.height;
-                return nullopt;
-            }
-            getOrCreateNewAtlas();
+            shelf = &candidate;
+            break;
         }
     }
 
-    auto const result = cursor_;
-    cursor_.position.x += _size.width + HorizontalGap;
-    maxTextureHeightInCurrentRow_ = max(maxTextureHeightInCurrentRow_, _size.height);
-    return result;
+    // Otherwise open a new one, on a new texture atlas if the current one is exhausted.
+    if (!shelf)
+        shelf = openShelf(shelfHeight);
+
+    // As a last resort, waste some space on the lowest shelf of a larger size class.
+    if (!shelf)
+        for (Shelf& candidate: shelves_)
+            if (fits(candidate) && (!shelf || candidate.height < shelf->height))
+                shelf = &candidate;
+
+    if (!shelf)
+        return nullopt;
+
+    auto const result = Cursor{shelf->atlas, Point{shelf->x, shelf->y}};
+    shelf->x += _size.width + HorizontalGap;
+    return pair{result, Size{_size.width, shelf->height}};
+}
+
+TextureAtlasAllocator::Shelf* TextureAtlasAllocator::openShelf(int _height)
+{
+    if (nextShelfY_ + _height > size_.height)
+    {
+        if (!(atlasIDs_.size() + 1 < maxPages()))
+            return nullptr;
+        getOrCreateNewAtlas();
+    }
+
+    shelves_.emplace_back(Shelf{currentAtlas_, nextShelfY_, _height, 0});
+    nextShelfY_ += _height + VerticalGap;
+    return &shelves_.back();
+}
+
+optional<pair<TextureAtlasAllocator::Cursor, Size>> TextureAtlasAllocator::takeDiscarded(Size _bitmapSize)
+{
+    // Slots are ordered by width first, so the first one that is also high enough
+    // is the narrowest one to fit, which is an exact match if available.
+    for (auto i = discarded_.lower_bound(_bitmapSize); i != end(discarded_); ++i)
+    {
+        auto const slotSize = i->first;
+        if (slotSize.height < _bitmapSize.height)
+            continue;
+
+        std::vector<Cursor>& discardsForGivenSize = i->second;
+        assert(!discardsForGivenSize.empty());
+        auto const cursor = discardsForGivenSize.back();
+
+        discardsForGivenSize.pop_back();
+        if (discardsForGivenSize.empty())
+            discarded_.erase(i);
+
+        return pair{cursor, slotSize};
+    }
+    return nullopt;
 }
 
 TextureInfo const* TextureAtlasAllocator::insert(crispy::Size _bitmapSize,
                                                  crispy::Size _targetSize,
                                                  Format _format,
-                                                 Buffer _data,
+                                                 Buffer&& _data,
                                                  int _user)
 {
+    // Textures of block compressed formats occupy whole blocks.
+    auto const blockSize = block_size(format_);
+    auto const slotRequest = Size{(_bitmapSize.width + blockSize - 1) / blockSize * blockSize,
+                                  (_bitmapSize.height + blockSize - 1) / blockSize * blockSize};
+
     // check free-map first
-    if (auto i = discarded_.find(_bitmapSize); i != end(discarded_))
+    if (auto const discarded = takeDiscarded(slotRequest); discarded.has_value())
     {
-        std::vector<Cursor>& discardsForGivenSize = i->second;
-        if (!discardsForGivenSize.empty())
-        {
-            TextureInfo const& info = appendTextureInfo(_bitmapSize,
-                                                        _targetSize,
-                                                        discardsForGivenSize.back(),
-                                                        _user);
-
-            discardsForGivenSize.pop_back();
-            if (discardsForGivenSize.empty())
-                discarded_.erase(i);
-
-            atlasBackend_.uploadTexture(UploadTexture{
-                std::ref(info),
-                std::move(_data),
-                _format
-            });
-
-            return &info;
-        }
+        auto const [cursor, slotSize] = *discarded;
+        TextureInfo const& info = appendTextureInfo(_bitmapSize,
+                                                    _targetSize,
+                                                    slotSize,
+                                                    cursor,
+                                                    _user);
+
+        atlasBackend_.uploadTexture(UploadTexture{
+            std::ref(info),
+            std::move(_data),
+            _format
+        });
+
+        return &info;
     }
 
     // fail early if to-be-inserted texture is too large to fit a single page in the whole atlas
-    if (_bitmapSize.height > size_.height || _bitmapSize.width > size_.width)
+    if (slotRequest.height > size_.height || slotRequest.width > size_.width)
         return nullptr;
 
-    auto const targetOffset = getOffsetAndAdvance(_bitmapSize);
-    if (!targetOffset.has_value())
+    auto const allocation = allocateOnShelf(slotRequest);
+    if (!allocation.has_value())
         return nullptr;
 
+    auto const [targetOffset, slotSize] = *allocation;
     TextureInfo const& info = appendTextureInfo(_bitmapSize,
                                                 _targetSize,
-                                                *targetOffset,
+                                                slotSize,
+                                                targetOffset,
                                                 _user);
 
     atlasBackend_.uploadTexture(UploadTexture{
@@ -163,7 +217,7 @@ void TextureAtlasAllocator::release(TextureInfo const& _info)
 
     if (i != end(textureInfos_))
     {
-        std::vector<Cursor>& discardsForGivenSize = discarded_[_info.bitmapSize];
+        std::vector<Cursor>& discardsForGivenSize = discarded_[_info.slotSize];
         discardsForGivenSize.emplace_back(Cursor{_info.atlas, _info.offset});
         textureInfos_.erase(i);
     }
@@ -171,6 +225,7 @@ void TextureAtlasAllocator::release(TextureInfo const& _info)
 
 TextureInfo const& TextureAtlasAllocator::appendTextureInfo(crispy::Size _bitmapSize,
                                                             crispy::Size _targetSize,
+                                                            crispy::Size _slotSize,
                                                             Cursor _offset,
                                                             int _user)
 {
@@ -187,7 +242,10 @@ TextureInfo const& TextureAtlasAllocator::appendTextureInfo(crispy::Size _bitmap
         _user
     });
 
-    return textureInfos_.back();
+    TextureInfo& info = textureInfos_.back();
+    info.slotSize = _slotSize;
+    info.lastUsed = frame_;
+    return info;
 }
 
 } // end namespace
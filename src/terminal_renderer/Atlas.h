@@ -13,6 +13,8 @@
  */
 #pragma once
 
+#include <crispy/cache_stats.h>
+#include <crispy/memory_usage.h>
 #include <crispy/size.h>
 #include <crispy/debuglog.h>
 
@@ -21,7 +23,9 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstdint>
 #include <functional>
+#include <limits>
 #include <list>
 #include <map>
 #include <optional>
@@ -34,8 +38,14 @@ namespace terminal::renderer::atlas {
 auto const inline AtlasTag = crispy::debugtag::make("renderer.atlas", "Logs details about texture atlas.");
 
 using Buffer = std::vector<uint8_t>;
-enum class Format { Red, RGB, RGBA };
 
+/// Pixel formats of textures, as uploaded and as stored in atlases.
+///
+/// CompressedRGBA is only used for storing RGBA textures, which the backend compresses
+/// into blocks of 4x4 pixels (see crispy::bc3) when uploading them.
+enum class Format { Red, RGB, RGBA, CompressedRGBA };
+
+/// @returns the number of bytes per pixel.
 constexpr int element_count(Format _format) noexcept
 {
     switch (_format)
@@ -43,10 +53,19 @@ constexpr int element_count(Format _format) noexcept
         case Format::Red: return 1;
         case Format::RGB: return 3;
         case Format::RGBA: return 4;
+        case Format::CompressedRGBA: return 1;
     }
     return 0;
 }
 
+/// @returns the number of pixels per row and column of the blocks the format stores pixels in.
+///
+/// Textures of such a format are placed at, and occupy, multiples of the block size.
+constexpr int block_size(Format _format) noexcept
+{
+    return _format == Format::CompressedRGBA ? 4 : 1;
+}
+
 struct AtlasID
 {
     int value;
@@ -96,7 +115,8 @@ struct TextureInfo {
         relativeY{ _relativeY },
         relativeWidth{ _relativeWidth },
         relativeHeight{ _relativeHeight },
-        user{ _user }
+        user{ _user },
+        slotSize{ _bitmapSize }
     {}
 
     AtlasID atlas;                  // for example 0 for GL_TEXTURE0
@@ -109,6 +129,8 @@ struct TextureInfo {
     float relativeWidth;            // width relative to Atlas::width_
     float relativeHeight;           // height relative to Atlas::height_
     int user;                       // some user defined value, in my case, whether or not this texture is colored or monochrome
+    crispy::Size slotSize;          // size of the atlas area occupied, at least bitmapSize
+    mutable uint64_t lastUsed = 0;  // frame number this texture was last used in
 };
 
 struct UploadTexture {
@@ -123,6 +145,11 @@ struct RenderTexture {
     int y;                          // window y coordinate to render the texture to
     int z;                          // window z coordinate to render the texture to
     std::array<float, 4> color;     // optional; a color being associated with this texture
+    crispy::Point sourceOffset{};   // optional; bottom left corner of the area of the bitmap to render
+    crispy::Size sourceSize{};      // optional; size of the area of the bitmap to render, all of it if empty
+    float scale = 1.0f;             // optional; factor to scale the texture's target size by
+    crispy::Size targetSize{};      // optional; size to render the (source area of the) bitmap to,
+                                    // overriding the scaled target size if not empty
 };
 
 /// Generic listener API to events from an Atlas.
@@ -153,6 +180,9 @@ class AtlasBackend {
  * This Texture atlas stores textures with given dimension in a 3 dimensional array of atlases.
  * Thus, you may say a 4D atlas ;-)
  *
+ * Textures are packed onto horizontal shelves, each one dedicated to a class of texture heights,
+ * so that narrow ASCII glyphs, double-width CJK glyphs and emoji do not waste each others' space.
+ *
  * @param Key a comparable key (such as @c char or @c uint32_t) to use to store and access textures.
  * @param Metadata some optionally accessible metadata that is attached with each texture.
  */
@@ -194,25 +224,81 @@ class TextureAtlasAllocator {
 
     std::vector<AtlasID> const& activeAtlasTextures() const noexcept { return atlasIDs_; }
 
-    /// @return number of internally used 3D texture atlases.
-    constexpr AtlasID currentInstance() const noexcept { return cursor_.atlas; }
+    /// @return the 3D texture atlas new shelves are opened on.
+    constexpr AtlasID currentInstance() const noexcept { return currentAtlas_; }
+
+    /// @return Y offset of the next shelf to be opened on the current 3D texture atlas.
+    constexpr int nextShelfY() const noexcept { return nextShelfY_; }
+
+    /// @return number of shelves opened across all 3D texture atlases.
+    size_t shelfCount() const noexcept { return shelves_.size(); }
+
+    /// @return number of bytes a single atlas texture occupies on the GPU.
+    size_t pageSizeInBytes() const noexcept
+    {
+        return static_cast<size_t>(size_.width) * static_cast<size_t>(size_.height) * element_count(format_);
+    }
+
+    /// @return number of bytes all atlas textures allocated so far occupy on the GPU.
+    size_t memoryUsage() const noexcept { return (atlasIDs_.size() + unusedAtlasIDs_.size()) * pageSizeInBytes(); }
+
+    /// @return number of bytes of host memory used for keeping track of the textures and free areas.
+    size_t metadataMemoryUsage() const noexcept
+    {
+        auto constexpr ListNodeOverhead = 2 * sizeof(void*);
+        auto constexpr MapNodeOverhead = 4 * sizeof(void*);
+        auto bytes = textureInfos_.size() * (sizeof(TextureInfo) + ListNodeOverhead)
+                   + crispy::allocated_bytes(shelves_)
+                   + crispy::allocated_bytes(atlasIDs_)
+                   + crispy::allocated_bytes(unusedAtlasIDs_);
+        for (auto const& entry: discarded_)
+            bytes += sizeof(entry) + MapNodeOverhead + crispy::allocated_bytes(entry.second);
+        return bytes;
+    }
+
+    constexpr size_t memoryBudget() const noexcept { return memoryBudget_; }
 
-    /// @return current X offset into the current 3D texture atlas.
-    constexpr int currentX() const noexcept { return cursor_.position.x; }
+    /// Limits the GPU memory this atlas may allocate for textures.
+    ///
+    /// Once exhausted, no more atlas textures are created and space has to be
+    /// reclaimed by releasing textures, such as MetadataTextureAtlas does by evicting
+    /// the least recently used ones. At least one atlas texture is always allowed.
+    void setMemoryBudget(size_t _bytes) noexcept { memoryBudget_ = _bytes; }
+
+    /// @return maximum number of atlas textures, with respect to both, instance limit and memory budget.
+    size_t maxPages() const noexcept
+    {
+        return std::min(maxInstances_, std::max(size_t{1}, memoryBudget_ / pageSizeInBytes()));
+    }
+
+    /// @return number of the current frame, used to stamp textures when being used.
+    constexpr uint64_t currentFrame() const noexcept { return frame_; }
 
-    /// @return current Y offset into the current 3D texture atlas.
-    constexpr int currentY() const noexcept { return cursor_.position.y; }
+    /// Advances the frame counter. Must be invoked at the beginning of each frame.
+    void nextFrame() noexcept { ++frame_; }
 
-    constexpr int maxTextureHeightInCurrentRow() const noexcept { return maxTextureHeightInCurrentRow_; }
+    /// Marks given texture as being used in the current frame.
+    void touch(TextureInfo const& _info) const noexcept { _info.lastUsed = frame_; }
+
+    /// @return whether or not given texture was used in the current frame and therefore must not be evicted.
+    bool usedInCurrentFrame(TextureInfo const& _info) const noexcept { return _info.lastUsed == frame_; }
 
     void clear();
 
+    /// Destroys the atlas textures left unused by clear(), rather than keeping them for reuse.
+    void releaseUnusedAtlases();
+
     TextureInfo const& get(size_t _index) const { return *std::next(std::begin(textureInfos_), _index); }
 
     // Configure some enforced horizontal/vertical gap between the subtextures.
     auto inline static constexpr HorizontalGap = 0;
     auto inline static constexpr VerticalGap = 0;
 
+    // Shelf heights are rounded up to a multiple of this, defining the size classes.
+    // Being a multiple of the block size of compressed formats, shelves start at block boundaries.
+    auto inline static constexpr ShelfHeightGranularity = 4;
+    static_assert(ShelfHeightGranularity % block_size(Format::CompressedRGBA) == 0);
+
     /// Inserts a new texture into the atlas.
     ///
     /// @param _id       a unique identifier used for accessing this texture
@@ -223,38 +309,57 @@ class TextureAtlasAllocator {
     /// @param _user     user defined data that is supplied along with TexCoord's 4th component
     ///
     /// @return index to the created TextureInfo or std::nullopt if failed.
+    ///         The texture data is only consumed on success.
     TextureInfo const* insert(crispy::Size _bitmapSize,
                               crispy::Size _targetSize,
                               Format _format,
-                              Buffer _data,
+                              Buffer&& _data,
                               int _user = 0);
 
     /// Releases a given texture area the atlas for future reallocations.
+    ///
+    /// The area can be reused by any texture that fits into it.
     void release(TextureInfo const& _info);
 
-    constexpr Cursor cursor() const noexcept { return cursor_; }
-
   private:
-    std::optional<Cursor> getOffsetAndAdvance(crispy::Size _bitmapSize);
+    /// A horizontal strip of an atlas texture, filled from left to right
+    /// with textures of up to the shelf's height.
+    struct Shelf {
+        AtlasID atlas;
+        int y;                      // top offset into the atlas texture
+        int height;                 // height of the size class this shelf is dedicated to
+        int x;                      // offset of the next free area on this shelf
+    };
+
+    constexpr int shelfHeightFor(int _height) const noexcept
+    {
+        auto const rounded = (std::max(_height, 1) + ShelfHeightGranularity - 1)
+                           / ShelfHeightGranularity * ShelfHeightGranularity;
+        return std::min(rounded, size_.height);
+    }
+
+    std::optional<std::pair<Cursor, crispy::Size>> allocateOnShelf(crispy::Size _bitmapSize);
+    Shelf* openShelf(int _height);
+    std::optional<std::pair<Cursor, crispy::Size>> takeDiscarded(crispy::Size _bitmapSize);
 
     void getOrCreateNewAtlas()
     {
         if (unusedAtlasIDs_.empty())
         {
-            cursor_.atlas = atlasBackend_.createAtlas(size_, format_, user_);
+            currentAtlas_ = atlasBackend_.createAtlas(size_, format_, user_);
         }
         else
         {
-            cursor_.atlas = unusedAtlasIDs_.back();
+            currentAtlas_ = unusedAtlasIDs_.back();
             unusedAtlasIDs_.pop_back();
         }
-        atlasIDs_.push_back(cursor_.atlas);
-        cursor_.position.x = 0;
-        cursor_.position.y = 0;
+        atlasIDs_.push_back(currentAtlas_);
+        nextShelfY_ = 0;
     }
 
     TextureInfo const& appendTextureInfo(crispy::Size _bitmapSize,
                                          crispy::Size _targetSize,
+                                         crispy::Size _slotSize,
                                          Cursor _offset,
                                          int _user);
 
@@ -265,21 +370,31 @@ class TextureAtlasAllocator {
     size_t const maxInstances_;    // maximum number of atlas instances (e.g. maximum number of OpenGL 3D textures)
     crispy::Size size_;            // total atlas texture size in pixels
     Format const format_;          // internal storage format, such as GL_R8 or GL_RGBA8
+    size_t memoryBudget_ = std::numeric_limits<size_t>::max(); // maximum number of bytes to allocate on the GPU
+    uint64_t frame_ = 1;           // current frame number, used to stamp textures with when being used
 
     int const user_;               // user-defined arbitrary data that relates to this atlas.
     std::string const name_;       // atlas human readable name (only for debugging)
 
-    Cursor cursor_;                // current texture ID and cursor for the next sub texture
-    int maxTextureHeightInCurrentRow_ = 0; // current maximum height in the current row (used to increment currentY_ to get to the next row)
+    AtlasID currentAtlas_{};       // texture atlas to open new shelves on
+    int nextShelfY_ = 0;           // top offset of the next shelf to open on the current texture atlas
+    std::vector<Shelf> shelves_;   // shelves opened so far, on all texture atlases
 
     // TODO: make this an unordered_map
-    std::map<crispy::Size, std::vector<Cursor>> discarded_; // map of texture size to list of atlas texture offsets of regions that have been discarded and are available for reuse.
+    std::map<crispy::Size, std::vector<Cursor>> discarded_; // map of slot size to list of atlas texture offsets of regions that have been discarded and are available for reuse.
     std::vector<AtlasID> atlasIDs_;
     std::vector<AtlasID> unusedAtlasIDs_;
 
     std::list<TextureInfo> textureInfos_;
 };
 
+/**
+ * Texture atlas that maps user defined keys to textures and their metadata.
+ *
+ * Textures are kept in least recently used order. When the underlying allocator runs out of
+ * space, the least recently used texture that was not used in the current frame and whose
+ * area is large enough is evicted to make room for the new one.
+ */
 template <typename Key, typename Metadata = int>
 class MetadataTextureAtlas {
   public:
@@ -303,6 +418,31 @@ class MetadataTextureAtlas {
     /// @return boolean indicating whether or not this atlas is empty (has no textures present).
     constexpr bool empty() const noexcept { return allocations_.size() == 0; }
 
+    /// @return number of bytes of host memory used for keeping track of the textures.
+    size_t memoryUsage() const noexcept
+    {
+        auto constexpr ListNodeOverhead = 2 * sizeof(void*);
+        return crispy::hash_table_bytes(allocations_)
+             + crispy::hash_table_bytes(metadata_)
+             + lru_.size() * (sizeof(Key) + ListNodeOverhead);
+    }
+
+    /// @return the lookups, insertions and evictions of textures since this atlas has been created,
+    ///         along with the bytes the textures present occupy on the GPU.
+    crispy::cache_stats stats() const noexcept
+    {
+        auto stats = crispy::cache_stats{};
+        stats.hits = hits_;
+        stats.misses = misses_;
+        stats.insertions = insertions_;
+        stats.evictions = evictions_;
+        for (auto const& allocation: allocations_)
+            stats.bytes += static_cast<size_t>(allocation.second.textureInfo->bitmapSize.width)
+                         * static_cast<size_t>(allocation.second.textureInfo->bitmapSize.height)
+                         * static_cast<size_t>(element_count(atlas_.format()));
+        return stats;
+    }
+
     TextureAtlasAllocator& allocator() noexcept { return atlas_; }
     TextureAtlasAllocator const& allocator() const noexcept { return atlas_; }
 
@@ -310,8 +450,10 @@ class MetadataTextureAtlas {
     /// explicitly.
     void clear()
     {
+        evictions_ += allocations_.size();
         allocations_.clear();
         metadata_.clear();
+        lru_.clear();
     }
 
     /// Tests whether given sub-texture is being present in this texture atlas.
@@ -325,7 +467,7 @@ class MetadataTextureAtlas {
         std::reference_wrapper<Metadata const>
     >;
 
-    /// Inserts a new texture into the atlas.
+    /// Inserts a new texture into the atlas, evicting a cold texture if running out of space.
     ///
     /// @param _id       a unique identifier used for accessing this texture
     /// @param _width    texture width in pixels
@@ -349,24 +491,41 @@ class MetadataTextureAtlas {
                                                        atlas_.format(),
                                                        std::move(_data),
                                                        _user);
+        if (!textureInfo && evict(_bitmapSize))
+            textureInfo = atlas_.insert(_bitmapSize,
+                                        _targetSize,
+                                        atlas_.format(),
+                                        std::move(_data),
+                                        _user);
         if (!textureInfo)
             return std::nullopt;
 
-        allocations_.emplace(_id, textureInfo);
+        ++insertions_;
+        lru_.push_front(_id);
+        allocations_.emplace(_id, Allocation{textureInfo, lru_.begin()});
 
-        if constexpr (!std::is_same_v<Metadata, void>)
-            metadata_.emplace(std::pair{_id, std::move(_metadata)});
-
-        return get(_id);
+        auto const metadata = metadata_.emplace(std::pair{_id, std::move(_metadata)}).first;
+        return DataRef{*textureInfo, metadata->second};
     }
 
     /// Retrieves TextureInfo and Metadata tuple if available, std::nullopt otherwise.
-    [[nodiscard]] std::optional<DataRef> get(Key const& _id) const
+    ///
+    /// The texture is marked as being used in the current frame.
+    [[nodiscard]] std::optional<DataRef> get(Key const& _id)
     {
         if (auto const i = allocations_.find(_id); i != allocations_.end())
-            return DataRef{*i->second, metadata_.at(_id)};
+        {
+            ++hits_;
+            auto& [textureInfo, lruPosition] = i->second;
+            atlas_.touch(*textureInfo);
+            lru_.splice(lru_.begin(), lru_, lruPosition);
+            return DataRef{*textureInfo, metadata_.at(_id)};
+        }
         else
+        {
+            ++misses_;
             return std::nullopt;
+        }
     }
 
     void release(Key const& _id)
@@ -376,23 +535,76 @@ class MetadataTextureAtlas {
 
         if (auto const i = allocations_.find(_id); i != allocations_.end())
         {
-            TextureInfo const& ti = *i->second;
+            TextureInfo const& ti = *i->second.textureInfo;
             atlas_.release(ti);
+            ++evictions_;
 
+            lru_.erase(i->second.lruPosition);
             allocations_.erase(i);
         }
     }
 
+    /// Releases all textures whose key satisfies the given predicate.
+    ///
+    /// @return number of released textures.
+    template <typename Predicate>
+    size_t releaseIf(Predicate _predicate)
+    {
+        auto keys = std::vector<Key>{};
+        for (auto const& allocation: allocations_)
+            if (_predicate(allocation.first))
+                keys.push_back(allocation.first);
+
+        for (Key const& key: keys)
+            release(key);
+
+        return keys.size();
+    }
+
   private:
+    /// Releases the least recently used texture that was not used in the current frame
+    /// and occupies an area large enough to hold a texture of the given size.
+    ///
+    /// @return whether or not a texture was evicted.
+    bool evict(crispy::Size _bitmapSize)
+    {
+        for (auto i = lru_.rbegin(); i != lru_.rend(); ++i)
+        {
+            TextureInfo const& ti = *allocations_.at(*i).textureInfo;
+            if (atlas_.usedInCurrentFrame(ti))
+                break; // everything beyond is part of the current frame's working set, too
+
+            if (ti.slotSize.width >= _bitmapSize.width && ti.slotSize.height >= _bitmapSize.height)
+            {
+                debuglog(AtlasTag).write("Evicting texture from {} that was last used in frame {} (current frame {}).",
+                                         atlas_.name(), ti.lastUsed, atlas_.currentFrame());
+                release(Key{*i});
+                return true;
+            }
+        }
+        return false;
+    }
+
+    struct Allocation {
+        TextureInfo const* textureInfo;
+        typename std::list<Key>::iterator lruPosition;
+    };
+
     TextureAtlasAllocator& atlas_;
 
-    std::unordered_map<Key, TextureInfo const*> allocations_ = {};
+    std::unordered_map<Key, Allocation> allocations_ = {};
+    std::list<Key> lru_ = {};                       // keys of all allocations, most recently used first
 
     // conditionally transform void to int as I can't conditionally enable/disable this member var.
     std::unordered_map<
         Key,
         std::conditional_t<std::is_same_v<Metadata, void>, int, Metadata>
     > metadata_ = {};
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t insertions_ = 0;
+    uint64_t evictions_ = 0;
 };
 
 } // end namespace
@@ -422,6 +634,7 @@ namespace fmt { // {{{
                 case terminal::renderer::atlas::Format::RGBA: return format_to(ctx.out(), "RGBA");
                 case terminal::renderer::atlas::Format::RGB: return format_to(ctx.out(), "RGB");
                 case terminal::renderer::atlas::Format::Red: return format_to(ctx.out(), "Alpha");
+                case terminal::renderer::atlas::Format::CompressedRGBA: return format_to(ctx.out(), "CompressedRGBA");
             }
             return format_to(ctx.out(), "unknown");
         }
@@ -510,12 +723,12 @@ namespace fmt { // {{{
         template <typename FormatContext>
         auto format(terminal::renderer::atlas::TextureAtlasAllocator const& _atlas, FormatContext& ctx)
         {
-            return format_to(ctx.out(), "TextureAtlasAllocator<cursor: {}/{} ({}x{}), rowHeight:{}>",
-                _atlas.cursor().atlas,
-                _atlas.cursor().position,
+            return format_to(ctx.out(), "TextureAtlasAllocator<atlas: {}, nextShelfY: {} ({}x{}), shelves:{}>",
+                _atlas.currentInstance(),
+                _atlas.nextShelfY(),
                 _atlas.size(),
                 _atlas.maxInstances(),
-                _atlas.maxTextureHeightInCurrentRow()
+                _atlas.shelfCount()
             );
         }
     };
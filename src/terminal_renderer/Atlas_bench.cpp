@@ -0,0 +1,120 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_renderer/Atlas.h>
+
+#include <crispy/benchmark.h>
+
+#include <fmt/format.h>
+
+#include <deque>
+#include <random>
+#include <vector>
+
+using namespace terminal::renderer::atlas;
+using crispy::Size;
+using crispy::benchmark::do_not_optimize;
+using std::vector;
+
+namespace // {{{ helper
+{
+    /// Atlas backend merely handing out atlas IDs, so that only the allocator itself is measured.
+    class NullBackend : public AtlasBackend {
+      public:
+        AtlasID createAtlas(Size, Format, int) override { return AtlasID{ nextAtlasID_++ }; }
+        void uploadTexture(UploadTexture) override {}
+        void renderTexture(RenderTexture) override {}
+        void destroyAtlas(AtlasID) override {}
+
+      private:
+        int nextAtlasID_ = 0;
+    };
+
+    auto constexpr AtlasSize = Size{1024, 1024};
+    auto constexpr MaxInstances = 4;
+
+    /// @returns @p _count texture sizes as glyphs come in: mostly narrow, some double-width, few emoji.
+    vector<Size> glyphSizes(std::mt19937& _rng, size_t _count, bool _mixed)
+    {
+        auto percent = std::uniform_int_distribution<int>(0, 99);
+        auto sizes = vector<Size>(_count);
+        for (Size& size: sizes)
+        {
+            auto const p = _mixed ? percent(_rng) : 0;
+            size = p < 80 ? Size{10, 20} : p < 95 ? Size{20, 20} : Size{40, 40};
+        }
+        return sizes;
+    }
+
+    TextureInfo const* insert(TextureAtlasAllocator& _atlas, Size _size)
+    {
+        auto const bytes = static_cast<size_t>(_size.width * _size.height);
+        return _atlas.insert(_size, _size, Format::Red, Buffer(bytes));
+    }
+} // }}}
+
+CRISPY_BENCHMARK("TextureAtlasAllocator.insert")
+{
+    for (bool const mixed: {false, true})
+    {
+        // Fills up the atlas, starting over once full.
+        auto backend = NullBackend{};
+        auto atlas = TextureAtlasAllocator(backend, AtlasSize, MaxInstances, Format::Red, 0, "bench");
+        auto const sizes = glyphSizes(_bench.rng(), 4096, mixed);
+        size_t i = 0;
+        _bench.measure(mixed ? "sizes=mixed" : "sizes=uniform", [&]() {
+            auto const size = sizes[i++ % sizes.size()];
+            if (!insert(atlas, size))
+            {
+                atlas.clear();
+                do_not_optimize(insert(atlas, size));
+            }
+        });
+    }
+}
+
+// Keeps a fixed number of textures alive, replacing the oldest one with a new one of random size,
+// which reuses the areas released before, like the glyph cache evicting its least recently used glyphs.
+CRISPY_BENCHMARK("TextureAtlasAllocator.release+insert")
+{
+    for (size_t const liveCount: {size_t{1024}, size_t{8192}})
+    {
+        auto backend = NullBackend{};
+        auto atlas = TextureAtlasAllocator(backend, AtlasSize, MaxInstances, Format::Red, 0, "bench");
+        auto const sizes = glyphSizes(_bench.rng(), 4096, true);
+        auto live = std::deque<TextureInfo const*>();
+        size_t i = 0;
+
+        auto const insertNext = [&]() {
+            auto const size = sizes[i++ % sizes.size()];
+            auto const* info = insert(atlas, size);
+            if (!info)
+            {
+                // Too fragmented to fit in; starts over.
+                atlas.clear();
+                live.clear();
+                info = insert(atlas, size);
+            }
+            live.push_back(info);
+        };
+
+        while (live.size() < liveCount)
+            insertNext();
+
+        _bench.measure(fmt::format("live={}", liveCount), [&]() {
+            atlas.release(*live.front());
+            live.pop_front();
+            insertNext();
+        });
+    }
+}
@@ -39,16 +39,89 @@ void BackgroundRenderer::renderCell(RenderCell const& _cell)
     if (_cell.backgroundColor == defaultColor_)
         return;
 
-    auto const pos = gridMetrics_.map(_cell.position);
+    auto const row = _cell.position.row;
+    auto const column = _cell.position.column;
+
+    if (!row_.empty() && row_.back().top != row)
+        flushRow();
+
+    if (!row_.empty() && row_.back().right + 1 == column && row_.back().color == _cell.backgroundColor)
+        row_.back().right = column;
+    else
+        row_.emplace_back(Block{row, row, column, column, _cell.backgroundColor});
+}
+
+void BackgroundRenderer::renderRun(RenderRun const& _run)
+{
+    if (_run.backgroundColor == defaultColor_ || !_run.cellCount)
+        return;
+
+    auto const row = _run.position.row;
+    auto const left = _run.position.column;
+    auto const right = left + static_cast<int>(_run.cellCount) - 1;
+
+    if (!row_.empty() && row_.back().top != row)
+        flushRow();
+
+    if (!row_.empty() && row_.back().right + 1 == left && row_.back().color == _run.backgroundColor)
+        row_.back().right = right;
+    else
+        row_.emplace_back(Block{row, row, left, right, _run.backgroundColor});
+}
+
+void BackgroundRenderer::finish()
+{
+    flushRow();
+
+    for (Block const& block: blocks_)
+        renderBlock(block);
+    blocks_.clear();
+}
+
+void BackgroundRenderer::flushRow()
+{
+    // Both lists are ordered by column, so a run can only extend
+    // the block spanning exactly the same columns in the row above.
+    auto above = blocks_.begin();
+    for (Block const& run: row_)
+    {
+        while (above != blocks_.end() && above->left < run.left)
+            renderBlock(*above++);
+
+        if (above != blocks_.end()
+            && above->bottom + 1 == run.top
+            && above->left == run.left
+            && above->right == run.right
+            && above->color == run.color)
+        {
+            nextBlocks_.emplace_back(*above++);
+            nextBlocks_.back().bottom = run.bottom;
+        }
+        else
+            nextBlocks_.emplace_back(run);
+    }
+
+    while (above != blocks_.end())
+        renderBlock(*above++);
+
+    std::swap(blocks_, nextBlocks_);
+    nextBlocks_.clear();
+    row_.clear();
+}
+
+void BackgroundRenderer::renderBlock(Block const& _block)
+{
+    // The rectangle's origin is the bottom left corner.
+    auto const pos = gridMetrics_.map(Coordinate{_block.bottom, _block.left});
 
     renderTarget().renderRectangle(
         pos.x,
         pos.y,
-        gridMetrics_.cellSize.width,
-        gridMetrics_.cellSize.height,
-        static_cast<float>(_cell.backgroundColor.red) / 255.0f,
-        static_cast<float>(_cell.backgroundColor.green) / 255.0f,
-        static_cast<float>(_cell.backgroundColor.blue) / 255.0f,
+        gridMetrics_.cellSize.width * (_block.right - _block.left + 1),
+        gridMetrics_.cellSize.height * (_block.bottom - _block.top + 1),
+        static_cast<float>(_block.color.red) / 255.0f,
+        static_cast<float>(_block.color.green) / 255.0f,
+        static_cast<float>(_block.color.blue) / 255.0f,
         opacity_
     );
 }
@@ -19,6 +19,7 @@
 #include <terminal/Screen.h>
 
 #include <memory>
+#include <vector>
 
 namespace terminal::renderer {
 
@@ -42,13 +43,38 @@ class BackgroundRenderer : public Renderable {
     // because there is no need to detect bg/fg color more than once per grid cell!
 
     /// Queues up a render with given background
+    ///
+    /// Cells must be passed in row-major order. Adjacent cells of the same background color
+    /// are merged into as few rectangles as possible, which are rendered by finish().
     void renderCell(RenderCell const& _cell);
 
+    /// Queues up the background of all cells of @p _run at once, see renderCell().
+    void renderRun(RenderRun const& _run);
+
+    /// Renders all queued up backgrounds.
+    void finish();
+
   private:
+    /// Rectangular area of cells sharing the same background color (in grid coordinates).
+    struct Block {
+        int top;
+        int bottom;
+        int left;
+        int right;
+        RGBColor color;
+    };
+
+    void flushRow();
+    void renderBlock(Block const& _block);
+
     // private data
     GridMetrics const& gridMetrics_;
     RGBColor const& defaultColor_;
     float opacity_ = 1.0f; // normalized opacity value between 0.0 .. 1.0
+
+    std::vector<Block> row_;        // horizontally merged runs of the current row
+    std::vector<Block> blocks_;     // blocks ending at the previous row, which may still grow downwards
+    std::vector<Block> nextBlocks_; // scratch buffer for flushRow()
 };
 
 } // end namespace
@@ -0,0 +1,441 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_renderer/BuiltinGlyphs.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+using std::abs;
+using std::array;
+using std::max;
+using std::min;
+using std::sqrt;
+using std::string_view;
+using std::vector;
+
+namespace terminal::renderer {
+
+namespace // {{{ helpers
+{
+    /// Alpha mask of a cell, with its top row first.
+    class Canvas {
+      public:
+        explicit Canvas(crispy::Size _size):
+            width_{ _size.width },
+            height_{ _size.height },
+            pixels_(static_cast<size_t>(_size.width * _size.height), 0)
+        {}
+
+        int width() const noexcept { return width_; }
+        int height() const noexcept { return height_; }
+
+        /// Fills the pixels [_x0, _x1) x [_y0, _y1), clipped to the cell.
+        void fill(int _x0, int _y0, int _x1, int _y1, uint8_t _alpha = 0xFF)
+        {
+            for (int y = max(_y0, 0); y < min(_y1, height_); ++y)
+                for (int x = max(_x0, 0); x < min(_x1, width_); ++x)
+                    blend(x, y, _alpha);
+        }
+
+        /// Fills the area @p _inside a shape, anti-aliased by 4x4 supersampling.
+        template <typename Inside>
+        void fill(Inside _inside)
+        {
+            constexpr int Samples = 4;
+            for (int y = 0; y < height_; ++y)
+                for (int x = 0; x < width_; ++x)
+                {
+                    int covered = 0;
+                    for (int sy = 0; sy < Samples; ++sy)
+                        for (int sx = 0; sx < Samples; ++sx)
+                            if (_inside(x + (sx + 0.5) / Samples, y + (sy + 0.5) / Samples))
+                                ++covered;
+                    if (covered)
+                        blend(x, y, static_cast<uint8_t>(covered * 0xFF / (Samples * Samples)));
+                }
+        }
+
+        /// @returns the bitmap with its bottom row first, as expected of rasterized glyphs.
+        vector<uint8_t> bitmap() const
+        {
+            auto result = vector<uint8_t>(pixels_.size());
+            for (int y = 0; y < height_; ++y)
+                std::copy_n(pixels_.begin() + (height_ - 1 - y) * width_,
+                            width_,
+                            result.begin() + y * width_);
+            return result;
+        }
+
+      private:
+        void blend(int _x, int _y, uint8_t _alpha)
+        {
+            uint8_t& pixel = pixels_[static_cast<size_t>(_y * width_ + _x)];
+            pixel = max(pixel, _alpha);
+        }
+
+        int width_;
+        int height_;
+        vector<uint8_t> pixels_;
+    };
+
+    /// Pixel range [begin, end) along one of the cell's axes.
+    struct Span
+    {
+        int begin;
+        int end;
+    };
+
+    /// A line of thickness @p _thickness, centered on an axis of @p _length pixels.
+    constexpr Span centered(int _length, int _thickness) noexcept
+    {
+        auto const begin = (_length - _thickness) / 2;
+        return Span{begin, begin + _thickness};
+    }
+
+    /// Both lines of a double line, centered on an axis of @p _length pixels.
+    /// The gap in between is as wide as each of them.
+    constexpr array<Span, 2> doubled(int _length, int _thickness) noexcept
+    {
+        auto const begin = (_length - 3 * _thickness) / 2;
+        return {Span{begin, begin + _thickness}, Span{begin + 2 * _thickness, begin + 3 * _thickness}};
+    }
+
+    enum class Line : uint8_t { None, Light, Heavy, Double };
+
+    enum Direction { Up, Right, Down, Left };
+
+    /// Lines of the box drawing characters U+2500..U+257F from the cell's center towards
+    /// its top, right, bottom and left edge, where '.' is none, 'l' light, 'h' heavy and 'd' double.
+    /// Dashed lines, arcs and diagonals are left empty, as they are drawn differently.
+    constexpr auto BoxLines = array<string_view, 0x80>{
+        ".l.l", ".h.h", "l.l.", "h.h.", "",     "",     "",     "",     // U+2500
+        "",     "",     "",     "",     ".ll.", ".hl.", ".lh.", ".hh.", // U+2508
+        "..ll", "..lh", "..hl", "..hh", "ll..", "lh..", "hl..", "hh..", // U+2510
+        "l..l", "l..h", "h..l", "h..h", "lll.", "lhl.", "hll.", "llh.", // U+2518
+        "hlh.", "hhl.", "lhh.", "hhh.", "l.ll", "l.lh", "h.ll", "l.hl", // U+2520
+        "h.hl", "h.lh", "l.hh", "h.hh", ".lll", ".llh", ".hll", ".hlh", // U+2528
+        ".lhl", ".lhh", ".hhl", ".hhh", "ll.l", "ll.h", "lh.l", "lh.h", // U+2530
+        "hl.l", "hl.h", "hh.l", "hh.h", "llll", "lllh", "lhll", "lhlh", // U+2538
+        "hlll", "llhl", "hlhl", "hllh", "hhll", "llhh", "lhhl", "hhlh", // U+2540
+        "lhhh", "hlhh", "hhhl", "hhhh", "",     "",     "",     "",     // U+2548
+        ".d.d", "d.d.", ".dl.", ".ld.", ".dd.", "..ld", "..dl", "..dd", // U+2550
+        "ld..", "dl..", "dd..", "l..d", "d..l", "d..d", "ldl.", "dld.", // U+2558
+        "ddd.", "l.ld", "d.dl", "d.dd", ".dld", ".ldl", ".ddd", "ld.d", // U+2560
+        "dl.l", "dd.d", "ldld", "dldl", "dddd", "",     "",     "",     // U+2568
+        "",     "",     "",     "",     "...l", "l...", ".l..", "..l.", // U+2570
+        "...h", "h...", ".h..", "..h.", ".h.l", "l.h.", ".l.h", "h.l.", // U+2578
+    };
+
+    constexpr Line line(char _spec) noexcept
+    {
+        switch (_spec)
+        {
+            case 'l': return Line::Light;
+            case 'h': return Line::Heavy;
+            case 'd': return Line::Double;
+            default: return Line::None;
+        }
+    }
+
+    /// Draws the lines of a box drawing character, joining them the way its glyph shows:
+    /// crossing lines pass through single ones, but end at double ones they do not continue,
+    /// and the two lines of a double line form corners with those of a perpendicular one.
+    void drawLines(Canvas& _canvas, string_view _spec, int _light, int _heavy)
+    {
+        auto const lines = array<Line, 4>{line(_spec[0]), line(_spec[1]), line(_spec[2]), line(_spec[3])};
+
+        for (int dir = Up; dir <= Left; ++dir)
+        {
+            if (lines[dir] == Line::None)
+                continue;
+
+            auto const horizontal = dir == Left || dir == Right;
+            auto const fromStart = dir == Left || dir == Up; // extending from the axis' start, or towards its end
+            auto const length = horizontal ? _canvas.width() : _canvas.height();
+            auto const breadth = horizontal ? _canvas.height() : _canvas.width();
+            auto const opposite = lines[(dir + 2) % 4];
+            auto const sideA = lines[horizontal ? Up : Left];     // perpendicular line towards the axis' start
+            auto const sideB = lines[horizontal ? Down : Right];  // perpendicular line towards the axis' end
+
+            auto const thickness = [&](Line _line) { return _line == Line::Heavy ? _heavy : _light; };
+            auto const fill = [&](Span _along, Span _across) {
+                if (horizontal)
+                    _canvas.fill(_along.begin, _across.begin, _along.end, _across.end);
+                else
+                    _canvas.fill(_across.begin, _along.begin, _across.end, _along.end);
+            };
+            // Fills from the edge up to and including the pixels of @p _span along the axis.
+            auto const fillThrough = [&](Span _span, Span _across) {
+                if (fromStart)
+                    fill(Span{0, _span.end}, _across);
+                else
+                    fill(Span{_span.begin, length}, _across);
+            };
+            auto const fillToCenter = [&](Span _across) {
+                if (fromStart)
+                    fill(Span{0, length / 2}, _across);
+                else
+                    fill(Span{length / 2, length}, _across);
+            };
+
+            auto const strokes = doubled(length, _light);
+            auto const nearStroke = fromStart ? strokes[0] : strokes[1];
+            auto const farStroke = fromStart ? strokes[1] : strokes[0];
+            auto const perpendicular = [&](Line _line) {
+                return _line == Line::Double ? Span{strokes[0].begin, strokes[1].end}
+                                             : centered(length, thickness(_line));
+            };
+
+            if (lines[dir] != Line::Double)
+            {
+                auto const across = centered(breadth, thickness(lines[dir]));
+                if (sideA == Line::None && sideB == Line::None)
+                    fillToCenter(across);
+                else if (opposite == Line::None && sideA == Line::Double && sideB == Line::Double)
+                    fillThrough(nearStroke, across);
+                else
+                {
+                    auto const a = sideA != Line::None ? perpendicular(sideA) : perpendicular(sideB);
+                    auto const b = sideB != Line::None ? perpendicular(sideB) : perpendicular(sideA);
+                    fillThrough(Span{min(a.begin, b.begin), max(a.end, b.end)}, across);
+                }
+                continue;
+            }
+
+            auto const across = doubled(breadth, _light);
+            for (int i = 0; i < 2; ++i)
+            {
+                // Each of the two lines turns into the perpendicular line on its own side,
+                // or else, becoming the outer line of a corner, into the one on the other side.
+                auto const own = i == 0 ? sideA : sideB;
+                auto const other = i == 0 ? sideB : sideA;
+                if (own == Line::Double)
+                    fillThrough(nearStroke, across[i]);
+                else if (own != Line::None)
+                    fillThrough(perpendicular(own), across[i]);
+                else if (other == Line::Double)
+                    fillThrough(farStroke, across[i]);
+                else if (other != Line::None)
+                    fillThrough(perpendicular(other), across[i]);
+                else
+                    fillToCenter(across[i]);
+            }
+        }
+    }
+
+    /// Draws @p _count dashes along the cell, each followed by a gap of a quarter its length.
+    void drawDashes(Canvas& _canvas, bool _horizontal, int _count, int _thickness)
+    {
+        auto const length = _horizontal ? _canvas.width() : _canvas.height();
+        auto const across = centered(_horizontal ? _canvas.height() : _canvas.width(), _thickness);
+        auto const segment = static_cast<double>(length) / _count;
+        auto const gap = max(1.0, std::round(segment / 4));
+
+        for (int i = 0; i < _count; ++i)
+        {
+            auto const begin = static_cast<int>(std::round(i * segment + gap / 2));
+            auto const end = static_cast<int>(std::round((i + 1) * segment - gap / 2));
+            if (_horizontal)
+                _canvas.fill(begin, across.begin, end, across.end);
+            else
+                _canvas.fill(across.begin, begin, across.end, end);
+        }
+    }
+
+    /// Draws a quarter of an ellipse around the cell corner (@p _cornerX, @p _cornerY),
+    /// meeting the cell's edges right where straight light lines do.
+    void drawArc(Canvas& _canvas, int _cornerX, int _cornerY, int _thickness)
+    {
+        auto const centerX = centered(_canvas.width(), _thickness).begin + _thickness / 2.0;
+        auto const centerY = centered(_canvas.height(), _thickness).begin + _thickness / 2.0;
+        auto const rx = abs(_cornerX - centerX);
+        auto const ry = abs(_cornerY - centerY);
+
+        _canvas.fill([&](double x, double y) {
+            // Distance to the ellipse, approximated by its implicit function over its gradient.
+            auto const dx = x - _cornerX;
+            auto const dy = y - _cornerY;
+            auto const f = dx * dx / (rx * rx) + dy * dy / (ry * ry) - 1.0;
+            auto const gx = 2 * dx / (rx * rx);
+            auto const gy = 2 * dy / (ry * ry);
+            return abs(f) / sqrt(gx * gx + gy * gy) <= _thickness / 2.0;
+        });
+    }
+
+    /// Draws a line from the top left to the bottom right corner, or mirrored if @p _rising.
+    void drawDiagonal(Canvas& _canvas, bool _rising, int _thickness)
+    {
+        double const w = _canvas.width();
+        double const h = _canvas.height();
+        auto const norm = sqrt(w * w + h * h);
+
+        _canvas.fill([&](double x, double y) {
+            auto const distance = _rising ? abs(h * x + w * y - w * h) / norm
+                                          : abs(h * x - w * y) / norm;
+            return distance <= _thickness / 2.0;
+        });
+    }
+
+    /// Fills the quadrants of @p _mask, with the bits 1, 2, 4 and 8 for the upper left,
+    /// upper right, lower left and lower right one.
+    void drawQuadrants(Canvas& _canvas, unsigned _mask)
+    {
+        // Split like the half blocks, so that quadrants line up with them.
+        auto const cx = static_cast<int>(std::lround(_canvas.width() / 2.0));
+        auto const cy = _canvas.height() / 2;
+        if (_mask & 1) _canvas.fill(0, 0, cx, cy);
+        if (_mask & 2) _canvas.fill(cx, 0, _canvas.width(), cy);
+        if (_mask & 4) _canvas.fill(0, cy, cx, _canvas.height());
+        if (_mask & 8) _canvas.fill(cx, cy, _canvas.width(), _canvas.height());
+    }
+
+    /// Draws the block elements U+2580..U+259F.
+    void drawBlock(Canvas& _canvas, char32_t _codepoint)
+    {
+        auto const w = _canvas.width();
+        auto const h = _canvas.height();
+        auto const eighthsOf = [](int _length, int _eighths) {
+            return static_cast<int>(std::lround(_length * _eighths / 8.0));
+        };
+
+        if (_codepoint == 0x2580)                                   // upper half
+            _canvas.fill(0, 0, w, h / 2);
+        else if (_codepoint <= 0x2588)                              // lower 1/8 .. 8/8
+            _canvas.fill(0, h - eighthsOf(h, static_cast<int>(_codepoint - 0x2580)), w, h);
+        else if (_codepoint <= 0x258F)                              // left 7/8 .. 1/8
+            _canvas.fill(0, 0, eighthsOf(w, static_cast<int>(0x2590 - _codepoint)), h);
+        else if (_codepoint == 0x2590)                              // right half
+            _canvas.fill(eighthsOf(w, 4), 0, w, h);
+        else if (_codepoint <= 0x2593)                              // light, medium, dark shade
+            _canvas.fill(0, 0, w, h, static_cast<uint8_t>((_codepoint - 0x2590) * 0x40));
+        else if (_codepoint == 0x2594)                              // upper 1/8
+            _canvas.fill(0, 0, w, eighthsOf(h, 1));
+        else if (_codepoint == 0x2595)                              // right 1/8
+            _canvas.fill(w - eighthsOf(w, 1), 0, w, h);
+        else
+        {
+            constexpr auto Quadrants = array<unsigned, 10>{4, 8, 1, 13, 9, 7, 11, 2, 6, 14};
+            drawQuadrants(_canvas, Quadrants[_codepoint - 0x2596]);
+        }
+    }
+
+    /// Draws the braille pattern U+2800..U+28FF, whose low 8 bits select the dots.
+    void drawBraille(Canvas& _canvas, char32_t _codepoint)
+    {
+        // Dots 1..8 (bit 0..7) as column and row in the pattern's 2x4 grid.
+        constexpr auto Dots = array<array<int, 2>, 8>{{
+            {0, 0}, {0, 1}, {0, 2}, {1, 0}, {1, 1}, {1, 2}, {0, 3}, {1, 3}
+        }};
+
+        double const w = _canvas.width();
+        double const h = _canvas.height();
+        auto const radius = max(0.75, 0.6 * min(w / 4, h / 8));
+
+        for (unsigned dot = 0; dot < Dots.size(); ++dot)
+        {
+            if (!(_codepoint & (1u << dot)))
+                continue;
+            auto const cx = w * (1 + 2 * Dots[dot][0]) / 4;
+            auto const cy = h * (1 + 2 * Dots[dot][1]) / 8;
+            _canvas.fill([&](double x, double y) {
+                return (x - cx) * (x - cx) + (y - cy) * (y - cy) <= radius * radius;
+            });
+        }
+    }
+
+    /// Draws the Powerline arrows U+E0B0..U+E0B3, pointing right or left, solid or as outline.
+    void drawPowerline(Canvas& _canvas, char32_t _codepoint, int _thickness)
+    {
+        double const w = _canvas.width();
+        double const h = _canvas.height();
+        bool const pointingLeft = _codepoint >= 0xE0B2;
+        bool const solid = _codepoint % 2 == 0;
+
+        _canvas.fill([&](double x, double y) {
+            auto const dx = pointingLeft ? w - x : x;      // distance from the arrow's base
+            auto const tip = w * (1.0 - abs(y - h / 2) / (h / 2));
+            if (solid)
+                return dx <= tip;
+
+            // Distance to the nearer one of the arrow's two edges.
+            auto const dy = abs(y - h / 2);
+            return abs((h / 2) * dx + w * dy - w * h / 2) / sqrt(w * w + h * h / 4) <= _thickness / 2.0;
+        });
+    }
+} // }}}
+
+text::rasterized_glyph rasterizeBuiltinGlyph(char32_t _codepoint, GridMetrics const& _gridMetrics)
+{
+    auto const cellSize = _gridMetrics.cellSize;
+    auto const light = max(1, _gridMetrics.underline.thickness);
+    auto const heavy = 2 * light;
+
+    auto result = text::rasterized_glyph{};
+    result.index = text::glyph_index{static_cast<unsigned>(_codepoint)};
+    result.format = text::bitmap_format::alpha_mask;
+
+    if (!isBuiltinGlyph(_codepoint) || cellSize.width <= 0 || cellSize.height <= 0)
+        return result;
+
+    // The bitmap covers the cell, so its top is the cell's height above the cell's bottom.
+    result.size = cellSize;
+    result.position = crispy::Point{0, cellSize.height - _gridMetrics.baseline};
+
+    auto canvas = Canvas{cellSize};
+    if (0x2500 <= _codepoint && _codepoint <= 0x257F)
+    {
+        if (auto const spec = BoxLines[_codepoint - 0x2500]; !spec.empty())
+            drawLines(canvas, spec, light, heavy);
+        else if (0x2504 <= _codepoint && _codepoint <= 0x250B)
+        {
+            auto const i = _codepoint - 0x2504;
+            drawDashes(canvas, !(i & 2), i < 4 ? 3 : 4, i & 1 ? heavy : light);
+        }
+        else if (0x254C <= _codepoint && _codepoint <= 0x254F)
+        {
+            auto const i = _codepoint - 0x254C;
+            drawDashes(canvas, !(i & 2), 2, i & 1 ? heavy : light);
+        }
+        else if (_codepoint == 0x256D)
+            drawArc(canvas, cellSize.width, cellSize.height, light);
+        else if (_codepoint == 0x256E)
+            drawArc(canvas, 0, cellSize.height, light);
+        else if (_codepoint == 0x256F)
+            drawArc(canvas, 0, 0, light);
+        else if (_codepoint == 0x2570)
+            drawArc(canvas, cellSize.width, 0, light);
+        else
+        {
+            if (_codepoint != 0x2572)
+                drawDiagonal(canvas, true, light);
+            if (_codepoint != 0x2571)
+                drawDiagonal(canvas, false, light);
+        }
+    }
+    else if (_codepoint <= 0x259F)
+        drawBlock(canvas, _codepoint);
+    else if (_codepoint <= 0x28FF)
+        drawBraille(canvas, _codepoint);
+    else
+        drawPowerline(canvas, _codepoint, light);
+
+    result.bitmap = canvas.bitmap();
+    return result;
+}
+
+} // end namespace
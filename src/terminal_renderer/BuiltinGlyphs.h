@@ -0,0 +1,57 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal_renderer/GridMetrics.h>
+
+#include <text_shaper/font.h>
+#include <text_shaper/shaper.h>
+
+#include <limits>
+
+namespace terminal::renderer {
+
+/// Font key of the glyphs drawn by rasterizeBuiltinGlyph(), whose glyph index is the codepoint.
+///
+/// It is never handed out by a text shaper, so that these glyphs share the texture atlases
+/// (and the row cache) with all other glyphs without ever being mistaken for one of them.
+constexpr text::font_key BuiltinGlyphFont{ std::numeric_limits<unsigned>::max() };
+
+constexpr bool isBuiltinGlyphFont(text::font_key _font) noexcept
+{
+    return _font.value == BuiltinGlyphFont.value;
+}
+
+/// Tests whether @p _codepoint is drawn by rasterizeBuiltinGlyph(), that is, one of
+/// the box drawing characters (U+2500..U+257F), block elements (U+2580..U+259F),
+/// braille patterns (U+2800..U+28FF) or the Powerline arrows (U+E0B0..U+E0B3).
+constexpr bool isBuiltinGlyph(char32_t _codepoint) noexcept
+{
+    return (0x2500 <= _codepoint && _codepoint <= 0x259F)
+        || (0x2800 <= _codepoint && _codepoint <= 0x28FF)
+        || (0xE0B0 <= _codepoint && _codepoint <= 0xE0B3);
+}
+
+/// Draws the glyph of @p _codepoint procedurally, covering exactly one grid cell.
+///
+/// Unlike glyphs rasterized from a font, lines and blocks reach the cell's edges
+/// at the very same pixels in every cell, so that they join seamlessly with their neighbors,
+/// no matter the font's metrics or whether it covers these characters at all.
+/// Lines are as thick as the underline.
+///
+/// @returns an alpha mask of the cell's size, positioned relative to the baseline like any
+///          other rasterized glyph, or an empty bitmap if @p _codepoint is not a builtin glyph.
+text::rasterized_glyph rasterizeBuiltinGlyph(char32_t _codepoint, GridMetrics const& _gridMetrics);
+
+} // end namespace
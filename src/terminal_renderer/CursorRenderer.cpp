@@ -55,6 +55,12 @@ void CursorRenderer::clearCache()
     textureAtlas_ = std::make_unique<TextureAtlas>(renderTarget().monochromeAtlasAllocator());
 }
 
+void CursorRenderer::gridMetricsChanged()
+{
+    // Rebuilt on next use.
+    textureAtlas_->releaseIf([](CursorShape) { return true; });
+}
+
 void CursorRenderer::rebuild()
 {
     clearCache();
@@ -34,6 +34,7 @@ class CursorRenderer : public Renderable {
 
     void setRenderTarget(RenderTarget& _renderTarget) override;
     void clearCache() override;
+    void gridMetricsChanged() override;
 
     CursorShape shape() const noexcept { return shape_; }
     void setShape(CursorShape _shape);
@@ -13,23 +13,13 @@
  */
 #include <terminal_renderer/DecorationRenderer.h>
 #include <terminal_renderer/GridMetrics.h>
-#include <terminal_renderer/Atlas.h>
-
-#include <crispy/debuglog.h>
-#include <crispy/times.h>
 
 #include <array>
-#include <cmath>
 #include <iostream>
 #include <optional>
 #include <utility>
 
-using crispy::Size;
-
 using std::array;
-using std::get;
-using std::max;
-using std::min;
 using std::nullopt;
 using std::optional;
 using std::pair;
@@ -37,6 +27,31 @@ using std::string;
 
 namespace terminal::renderer {
 
+namespace
+{
+    // Decorators drawn for each cell flag.
+    auto constexpr CellDecorators = array{
+        pair{CellFlags::Underline, Decorator::Underline},
+        pair{CellFlags::DoublyUnderlined, Decorator::DoubleUnderline},
+        pair{CellFlags::CurlyUnderlined, Decorator::CurlyUnderline},
+        pair{CellFlags::DottedUnderline, Decorator::DottedUnderline},
+        pair{CellFlags::DashedUnderline, Decorator::DashedUnderline},
+        pair{CellFlags::Overline, Decorator::Overline},
+        pair{CellFlags::CrossedOut, Decorator::CrossedOut},
+        pair{CellFlags::Framed, Decorator::Framed},
+        pair{CellFlags::Encircled, Decorator::Encircle},
+    };
+}
+
+uint16_t decoratorMask(CellFlags _flags) noexcept
+{
+    uint16_t mask = 0;
+    for (auto const& [flag, decorator]: CellDecorators)
+        if (_flags & flag)
+            mask |= static_cast<uint16_t>(1u << static_cast<unsigned>(decorator));
+    return mask;
+}
+
 optional<Decorator> to_decorator(std::string const& _value)
 {
     auto constexpr mappings = array{
@@ -66,252 +81,65 @@ DecorationRenderer::DecorationRenderer(GridMetrics const& _gridMetrics,
 {
 }
 
-void DecorationRenderer::setRenderTarget(RenderTarget& _renderTarget)
-{
-    Renderable::setRenderTarget(_renderTarget);
-    clearCache();
-}
-
-void DecorationRenderer::clearCache()
-{
-    atlas_ = std::make_unique<Atlas>(monochromeAtlasAllocator());
-}
-
-namespace
+void DecorationRenderer::renderCell(RenderCell const& _cell)
 {
-    constexpr bool pointVisibleInCircle(int x, int y, int r)
+    for (auto const& [flag, decorator]: CellDecorators)
     {
-        return x*x + y*y <= r*r;
-        // return -1.0f <= x && x <= +1.0f
-        //     && -1.0f <= y && y <= +1.0f;
-    }
+        if (!(_cell.flags & flag))
+            continue;
+
+        optional<Run>& run = runs_[static_cast<size_t>(decorator)];
+        if (run.has_value()
+            && run->start.row == _cell.position.row
+            && run->start.column + run->columnCount == _cell.position.column
+            && run->color == _cell.decorationColor)
+        {
+            ++run->columnCount;
+            continue;
+        }
 
-    constexpr double normalize(int _actual, int _max)
-    {
-        return double(_actual) / double(_max);
+        flush(decorator);
+        run = Run{_cell.position, 1, _cell.decorationColor};
     }
 }
 
-void DecorationRenderer::rebuild()
+void DecorationRenderer::renderRun(RenderRun const& _run)
 {
-    auto const width = gridMetrics_.cellSize.width;
-
-    { // {{{ underline
-        auto const thickness_half = int(ceil(gridMetrics_.underline.thickness / 2.0));
-        auto const thickness = min(1, thickness_half * 2);
-        auto const y0 = max(0, gridMetrics_.underline.position - thickness_half);
-        auto const height = y0 + thickness;
-        auto image = atlas::Buffer(width * height, 0);
-
-        for (int y = 1; y <= thickness; ++y)
-            for (int x = 0; x < width; ++x)
-                image[(height - y0 - y) * width + x] = 0xFF;
-
-        atlas_->insert(
-            Decorator::Underline,
-            Size{width, height},
-            Size{width, height},
-            move(image)
-        );
-    } // }}}
-    { // {{{ double underline
-        auto const thickness_half = int(ceil(gridMetrics_.underline.thickness / 2.0));
-        auto const thickness = min(1, thickness_half * 2);
-        auto const y1 = max(0, gridMetrics_.underline.position - thickness_half);
-        auto const y0 = max(0, y1 - 2 * thickness);
-        auto const height = y1 + thickness;
-        auto image = atlas::Buffer(width * height, 0);
-
-        for (int y = 1; y <= thickness; ++y)
-        {
-            for (int x = 0; x < width; ++x)
-            {
-                image[(height - y1 - y) * width + x] = 0xFF; // top line
-                image[(height - y0 - y) * width + x] = 0xFF; // bottom line
-            }
-        }
-
-        atlas_->insert(
-            Decorator::DoubleUnderline,
-            Size{width, height},
-            Size{width, height},
-            move(image)
-        );
-    } // }}}
-    { // {{{ curly underline
-        auto const height = int(ceil(double(gridMetrics_.baseline) * 2.0) / 3.0);
-        auto image = atlas::Buffer(width * height, 0);
-
-        for (int x = 0; x < width; ++x)
-        {
-            auto const normalizedX = static_cast<double>(x) / static_cast<double>(width);
-            auto const sin_x = normalizedX * 2.0 * M_PI;
-            auto const normalizedY = (cosf(sin_x) + 1.0f) / 2.0f;
-            assert(0.0f <= normalizedY && normalizedY <= 1.0f);
-            auto const y = static_cast<int>(normalizedY * static_cast<float>(height - gridMetrics_.underline.thickness));
-            assert(y < height);
-            for (int yi = 0; yi < gridMetrics_.underline.thickness; ++yi)
-                image[(y + yi) * width + x] = 0xFF;
-        }
-
-        atlas_->insert(
-            Decorator::CurlyUnderline,
-            Size{width, height},
-            Size{width, height},
-            move(image)
-        );
-    } // }}}
-    { // {{{ dotted underline
-        auto const radius = int(ceil(gridMetrics_.underline.thickness / 2.0));
-        auto const diameter = radius * 2;
-        auto const y0 = max(radius, gridMetrics_.underline.position - radius); // offset to the bottom line of the grid-cell.
-        auto const height = 1 + y0 + radius;
-        auto image = atlas::Buffer(width * height, 0);
-
-        auto const numberOfCircles = int(ceil(double(width) / double(diameter) / 3.0));
-
-        auto const xOffsetStart = radius;
-        for (int circle = 0; circle < numberOfCircles; ++circle)
+    auto const columnCount = static_cast<int>(_run.cellCount);
+    for (auto const& [flag, decorator]: CellDecorators)
+    {
+        if (!(_run.flags & flag))
+            continue;
+
+        optional<Run>& run = runs_[static_cast<size_t>(decorator)];
+        if (run.has_value()
+            && run->start.row == _run.position.row
+            && run->start.column + run->columnCount == _run.position.column
+            && run->color == _run.decorationColor)
         {
-            auto const bitmapStartX = xOffsetStart + circle * diameter * 3;
-
-            for (int y = -radius; y <= radius; ++y)
-            {
-                for (int x = -radius; x <= radius; ++x)
-                {
-                    if (pointVisibleInCircle(x, y, radius))
-                    {
-                        auto const bitmapX = bitmapStartX + x;
-                        auto const bitmapY = (height - 1 - y0 - (y));
-                        image.at(bitmapY * width + bitmapX) = 0xFF;
-                    }
-                }
-            }
+            run->columnCount += columnCount;
+            continue;
         }
 
-        atlas_->insert(
-            Decorator::DottedUnderline,
-            Size{width, height},
-            Size{width, height},
-            move(image)
-        );
-    } // }}}
-    { // {{{ dashed underline
-        // Devides a grid cell's underline in three sub-ranges and only renders first and third one,
-        // whereas the middle one is being skipped.
-        auto const thickness_half = int(ceil(gridMetrics_.underline.thickness / 2.0));
-        auto const thickness = min(1, thickness_half * 2);
-        auto const y0 = max(0, gridMetrics_.underline.position - thickness_half);
-        auto const height = y0 + thickness;
-        auto image = atlas::Buffer(width * height, 0);
-
-        for (int y = 1; y <= thickness; ++y)
-            for (int x = 0; x < width; ++x)
-                if (fabsf(float(x) / float(width) - 0.5f) >= 0.25f)
-                    image[(height - y0 - y) * width + x] = 0xFF;
-
-        atlas_->insert(
-            Decorator::DashedUnderline,
-            Size{width, height},
-            Size{width, height},
-            move(image)
-        );
-    } // }}}
-    { // {{{ framed
-        auto const cellHeight = gridMetrics_.cellSize.height;
-        auto const thickness = max(1, gridMetrics_.underline.thickness / 2);
-        auto image = atlas::Buffer(width * cellHeight, 0u);
-        auto const gap = 0; // thickness;
-
-        // Draws the top and bottom horizontal lines
-        for (int y = gap; y < thickness + gap; ++y)
-            for (int x = gap; x < width - gap; ++x)
-            {
-                image[y * width + x] = 0xFF;
-                image[(cellHeight - 1 - y) * width + x] = 0xFF;
-            }
-
-        // Draws the left and right vertical lines
-        for (int y = gap; y < cellHeight - gap; y++)
-            for (int x = gap; x < thickness + gap; ++x)
-            {
-                image[y * width + x] = 0xFF;
-                image[y * width + (width - 1 - x)] = 0xFF;
-            }
-
-        atlas_->insert(
-            Decorator::Framed,
-            Size{width, cellHeight},
-            Size{width, cellHeight},
-            move(image)
-        );
-    } // }}}
-    { // {{{ overline
-        auto const cellHeight = gridMetrics_.cellSize.height;
-        auto const thickness = gridMetrics_.underline.thickness;
-        auto image = atlas::Buffer(width * cellHeight, 0);
-
-        for (int y = 0; y < thickness; ++y)
-            for (int x = 0; x < width; ++x)
-                image[(cellHeight - y - 1) * width + x] = 0xFF;
-
-        atlas_->insert(
-            Decorator::Overline,
-            Size{width, cellHeight},
-            Size{width, cellHeight},
-            move(image)
-        );
-    } // }}}
-    { // {{{ crossed-out
-        auto const height = gridMetrics_.cellSize.height / 2;
-        auto const thickness = gridMetrics_.underline.thickness;
-        auto image = atlas::Buffer(width * height, 0u);
-
-        for (int y = 1; y <= thickness; ++y)
-            for (int x = 0; x < width; ++x)
-                image[(height - y) * width + x] = 0xFF;
-
-        atlas_->insert(
-            Decorator::CrossedOut,
-            Size{width, height},
-            Size{width, height},
-            move(image)
-        );
-    } // }}}
-    // TODO: Encircle
+        flush(decorator);
+        run = Run{_run.position, columnCount, _run.decorationColor};
+    }
 }
 
-void DecorationRenderer::renderCell(RenderCell const& _cell)
+void DecorationRenderer::finish()
 {
-    auto constexpr mappings = array{
-        pair{CellFlags::Underline, Decorator::Underline},
-        pair{CellFlags::DoublyUnderlined, Decorator::DoubleUnderline},
-        pair{CellFlags::CurlyUnderlined, Decorator::CurlyUnderline},
-        pair{CellFlags::DottedUnderline, Decorator::DottedUnderline},
-        pair{CellFlags::DashedUnderline, Decorator::DashedUnderline},
-        pair{CellFlags::Overline, Decorator::Overline},
-        pair{CellFlags::CrossedOut, Decorator::CrossedOut},
-        pair{CellFlags::Framed, Decorator::Framed},
-        pair{CellFlags::Encircled, Decorator::Encircle},
-    };
-
-    for (auto const& mapping: mappings)
-        if (_cell.flags & mapping.first)
-            renderDecoration(mapping.second, gridMetrics_.map(_cell.position), 1, _cell.decorationColor);
+    for (size_t i = 0; i < runs_.size(); ++i)
+        flush(static_cast<Decorator>(i));
 }
 
-optional<DecorationRenderer::DataRef> DecorationRenderer::getDataRef(Decorator _decoration)
+void DecorationRenderer::flush(Decorator _decorator)
 {
-    if (optional<DataRef> const dataRef = atlas_->get(_decoration); dataRef.has_value())
-        return dataRef;
-
-    if (atlas_->empty())
-        rebuild();
-
-    if (optional<DataRef> const dataRef = atlas_->get(_decoration); dataRef.has_value())
-        return dataRef;
+    optional<Run>& run = runs_[static_cast<size_t>(_decorator)];
+    if (!run.has_value())
+        return;
 
-    return nullopt;
+    renderDecoration(_decorator, gridMetrics_.map(run->start), run->columnCount, run->color);
+    run.reset();
 }
 
 void DecorationRenderer::renderDecoration(Decorator _decoration,
@@ -319,38 +147,20 @@ void DecorationRenderer::renderDecoration(Decorator _decoration,
                                           int _columnCount,
                                           RGBColor const& _color)
 {
-    optional<DataRef> const dataRef = getDataRef(_decoration);
-
-    if (!dataRef.has_value())
-    {
-#if 0 // !defined(NDEBUG)
-        cout << fmt::format(
-            "DecorationRenderer.renderDecoration: {} from {} with {} cells (MISSING IMPLEMENTATION)\n",
-            _decoration, _pos, _columnCount, _color
-        );
-#endif
-        return;
-    }
-
 #if 0 // !defined(NDEBUG)
     cout << fmt::format(
         "DecorationRenderer.renderDecoration: {} from {} with {} cells, color {}\n",
         _decoration, _pos, _columnCount, _color
     );
 #endif
-    auto const x = _pos.x;
-    auto const y = _pos.y;
-    auto const z = 0;
-    auto const color = array{
-        float(_color.red) / 255.0f,
-        float(_color.green) / 255.0f,
-        float(_color.blue) / 255.0f,
-        1.0f
-    };
-    atlas::TextureInfo const& textureInfo = get<0>(dataRef.value()).get();
-    auto const advanceX = static_cast<int>(gridMetrics_.cellSize.width);
-    for (int const i : crispy::times(_columnCount))
-        textureScheduler().renderTexture({textureInfo, i * advanceX + x, y, z, color});
+    // The pattern itself is drawn by the render target, so that it scales to any cell size
+    // without rasterizing (and re-rasterizing on font size changes) a bitmap per decorator.
+    renderTarget().renderDecoration(_decoration,
+                                    _pos.x,
+                                    _pos.y,
+                                    _columnCount * gridMetrics_.cellSize.width,
+                                    gridMetrics_,
+                                    _color);
 }
 
 } // end namespace
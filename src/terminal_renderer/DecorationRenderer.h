@@ -13,68 +13,53 @@
  */
 #pragma once
 
-#include <terminal_renderer/Atlas.h>
+#include <terminal_renderer/Decorator.h>
 #include <terminal_renderer/RenderTarget.h>
 
 #include <terminal/RenderBuffer.h>
 #include <terminal/Screen.h>
 
+#include <array>
+#include <cstdint>
+#include <optional>
+
 namespace terminal::renderer {
 
 struct GridMetrics;
 
-/// Dectorator, to decorate a grid cell, eventually containing a character
-///
-/// It should be possible to render multiple decoration onto the same coordinates.
-enum class Decorator {
-    /// Draws an underline
-    Underline,
-    /// Draws a doubly underline
-    DoubleUnderline,
-    /// Draws a curly underline
-    CurlyUnderline,
-    /// Draws a dotted underline
-    DottedUnderline,
-    /// Draws a dashed underline
-    DashedUnderline,
-    /// Draws an overline
-    Overline,
-    /// Draws a strike-through line
-    CrossedOut,
-    /// Draws a box around the glyph, this is literally the bounding box of a grid cell.
-    /// This could be used for debugging.
-    /// TODO: That should span the box around the whole (potentially wide) character
-    Framed,
-    /// Puts a circle-shape around into the cell (and ideally around the glyph)
-    /// TODO: How'd that look like with double-width characters?
-    Encircle,
-};
-
-std::optional<Decorator> to_decorator(std::string const& _value);
+/// @returns the decorators the cell flags @p _flags ask for, one bit per Decorator value.
+uint16_t decoratorMask(CellFlags _flags) noexcept;
 
 /// Renders any kind of grid cell decorations, ranging from basic underline to surrounding boxes.
 class DecorationRenderer : public Renderable {
   public:
     /// Constructs the decoration renderer.
     ///
-    /// @param _commandListener
-    /// @param _monochromeTextureAtlas
     /// @param _gridMetrics
+    /// @param _hyperlinkNormal
+    /// @param _hyperlinkHover
     DecorationRenderer(GridMetrics const& _gridMetrics,
                        Decorator _hyperlinkNormal,
                        Decorator _hyperlinkHover);
 
-    void setRenderTarget(RenderTarget& _renderTarget) override;
-    void clearCache() override;
-
     void setHyperlinkDecoration(Decorator _normal, Decorator _hover)
     {
         hyperlinkNormal_  = _normal;
         hyperlinkHover_ = _hover;
     }
 
+    /// Queues up the decorations of the given cell.
+    ///
+    /// Cells must be passed in row-major order. Adjacent cells of the same decoration and color
+    /// are merged into runs, which are rendered by finish() at the latest.
     void renderCell(RenderCell const& _cell);
 
+    /// Queues up the decorations of all cells of @p _run at once, see renderCell().
+    void renderRun(RenderRun const& _run);
+
+    /// Renders all queued up decorations.
+    void finish();
+
     void renderDecoration(Decorator _decoration,
                           crispy::Point _pos,
                           int _columnCount,
@@ -84,12 +69,14 @@ class DecorationRenderer : public Renderable {
     constexpr Decorator hyperlinkHover() const noexcept { return hyperlinkHover_; }
 
   private:
-    using Atlas = atlas::MetadataTextureAtlas<Decorator, int>; // contains various glyph decorators
-    using DataRef = Atlas::DataRef;
-
-    void rebuild();
+    /// Horizontal run of equally decorated cells on a single line.
+    struct Run {
+        Coordinate start;
+        int columnCount;
+        RGBColor color;
+    };
 
-    std::optional<DataRef> getDataRef(Decorator _decorator);
+    void flush(Decorator _decorator);
 
     // private data members
     //
@@ -98,7 +85,7 @@ class DecorationRenderer : public Renderable {
     Decorator hyperlinkNormal_ = Decorator::DottedUnderline;
     Decorator hyperlinkHover_ = Decorator::Underline;
 
-    std::unique_ptr<Atlas> atlas_;
+    std::array<std::optional<Run>, static_cast<size_t>(Decorator::Encircle) + 1> runs_{}; // open run per decorator
 };
 
 } // end namespace
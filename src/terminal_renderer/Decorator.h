@@ -0,0 +1,52 @@
+/**
+ * This file is part of the "contour" project.
+ *   Copyright (c) 2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <optional>
+#include <string>
+
+namespace terminal::renderer {
+
+/// Dectorator, to decorate a grid cell, eventually containing a character
+///
+/// It should be possible to render multiple decoration onto the same coordinates.
+///
+/// The numeric values are also known to the decoration shader of the OpenGL render target.
+enum class Decorator {
+    /// Draws an underline
+    Underline,
+    /// Draws a doubly underline
+    DoubleUnderline,
+    /// Draws a curly underline
+    CurlyUnderline,
+    /// Draws a dotted underline
+    DottedUnderline,
+    /// Draws a dashed underline
+    DashedUnderline,
+    /// Draws an overline
+    Overline,
+    /// Draws a strike-through line
+    CrossedOut,
+    /// Draws a box around the glyph, this is literally the bounding box of a grid cell.
+    /// This could be used for debugging.
+    /// TODO: That should span the box around the whole (potentially wide) character
+    Framed,
+    /// Puts a circle-shape around into the cell (and ideally around the glyph)
+    /// TODO: How'd that look like with double-width characters?
+    Encircle,
+};
+
+std::optional<Decorator> to_decorator(std::string const& _value);
+
+} // end namespace
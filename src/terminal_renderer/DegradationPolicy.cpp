@@ -0,0 +1,91 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_renderer/DegradationPolicy.h>
+
+#include <crispy/debuglog.h>
+
+#include <algorithm>
+
+using std::min;
+using std::chrono::duration_cast;
+
+namespace terminal::renderer {
+
+namespace // {{{ helpers
+{
+    auto const DegradationTag = crispy::debugtag::make("renderer.degradation",
+                                                       "Logs rendering features given up under rendering pressure.");
+
+    constexpr auto Highest = DegradationLevel::ReducedRefreshRate;
+
+    DegradationLevel stepped(DegradationLevel _level, int _delta) noexcept
+    {
+        return static_cast<DegradationLevel>(static_cast<int>(_level) + _delta);
+    }
+} // }}}
+
+void DegradationPolicy::setRefreshRate(double _refreshRate) noexcept
+{
+    auto const refreshRate = _refreshRate > 1.0 ? _refreshRate : 60.0;
+    budget_ = duration_cast<duration>(std::chrono::duration<double>(0.5 / refreshRate));
+}
+
+void DegradationPolicy::record(duration _buildTime, bool _flooded) noexcept
+{
+    if (_flooded || _buildTime > budget_)
+    {
+        relaxedFrames_ = 0;
+        if (++pressuredFrames_ < StepDownFrames)
+            return;
+
+        pressuredFrames_ = 0;
+        if (level_ == Highest)
+            return;
+
+        level_ = stepped(level_, +1);
+        debuglog(DegradationTag).write("Stepping down to {} ({}us build time{}).",
+                                       level_,
+                                       duration_cast<std::chrono::microseconds>(_buildTime).count(),
+                                       _flooded ? ", flooded" : "");
+    }
+    else if (_buildTime < budget_ / 2)
+    {
+        pressuredFrames_ = 0;
+        if (++relaxedFrames_ < StepUpFrames)
+            return;
+
+        relaxedFrames_ = 0;
+        if (level_ == DegradationLevel::None)
+            return;
+
+        level_ = stepped(level_, -1);
+        debuglog(DegradationTag).write("Stepping up to {}.", level_);
+    }
+    else
+    {
+        // Neither under pressure nor clearly relaxed, holding the current level.
+        pressuredFrames_ = 0;
+        relaxedFrames_ = 0;
+    }
+}
+
+DegradationLevel DegradationPolicy::level(time_point _now, time_point _lastInput) const noexcept
+{
+    if (_now - _lastInput < InteractiveWindow)
+        return min(level_, stepped(Highest, -1));
+
+    return level_;
+}
+
+} // end namespace
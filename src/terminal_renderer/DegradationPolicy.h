@@ -0,0 +1,100 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <string_view>
+
+namespace terminal::renderer {
+
+/// Rendering features given up under rendering pressure, each level including the ones before.
+enum class DegradationLevel
+{
+    None,               //!< everything is rendered as configured
+    UncachedShaping,    //!< text not found in the shaping cache is shaped without being added to it
+    SimpleShaping,      //!< text is shaped by the SimpleTextShaper
+    NoDecorations,      //!< neither decorations nor the hovered hyperlink are rendered
+    ReducedRefreshRate, //!< frames are rendered at half the refresh rate
+};
+
+constexpr std::string_view to_string(DegradationLevel _level) noexcept
+{
+    switch (_level)
+    {
+        case DegradationLevel::None: return "none";
+        case DegradationLevel::UncachedShaping: return "uncached shaping";
+        case DegradationLevel::SimpleShaping: return "simple shaping";
+        case DegradationLevel::NoDecorations: return "no decorations";
+        case DegradationLevel::ReducedRefreshRate: return "reduced refresh rate";
+    }
+    return "unknown";
+}
+
+/// Decides which rendering features to give up, so that frames keep up with the display.
+///
+/// Frames are under pressure if building them takes longer than half the refresh interval,
+/// leaving the rest to the GPU and compositor, or if the output floods the terminal.
+/// A few such frames in a row step the level down, until the pressure goes away.
+/// Once frames have been built in less than a quarter of the refresh interval for a while,
+/// the level steps back up again, one level at a time.
+///
+/// Shortly after user input, the refresh rate is never reduced, so that typing
+/// stays responsive even while another program floods the terminal in the background.
+class DegradationPolicy {
+  public:
+    using clock = std::chrono::steady_clock;
+    using duration = clock::duration;
+    using time_point = clock::time_point;
+
+    static constexpr int StepDownFrames = 3;    // consecutive frames under pressure to step down
+    static constexpr int StepUpFrames = 60;     // consecutive relaxed frames to step back up
+    static constexpr auto InteractiveWindow = std::chrono::milliseconds(500);
+
+    explicit DegradationPolicy(double _refreshRate = 60.0) { setRefreshRate(_refreshRate); }
+
+    /// Sets the refresh rate frames are meant to be rendered at.
+    void setRefreshRate(double _refreshRate) noexcept;
+
+    /// Accounts a frame that took @p _buildTime to build, with the output flooding the
+    /// terminal or not, stepping the level down or up accordingly.
+    void record(duration _buildTime, bool _flooded) noexcept;
+
+    /// @returns the level to render the frame at @p _now with, given the most recent
+    ///          user input at @p _lastInput.
+    DegradationLevel level(time_point _now, time_point _lastInput) const noexcept;
+
+    /// @returns the level stepped to by record(), regardless of user input.
+    DegradationLevel level() const noexcept { return level_; }
+
+  private:
+    duration budget_{};                 // build time a frame is under pressure beyond
+    DegradationLevel level_ = DegradationLevel::None;
+    int pressuredFrames_ = 0;           // consecutive frames under pressure
+    int relaxedFrames_ = 0;             // consecutive frames well within the budget
+};
+
+} // end namespace
+
+namespace fmt {
+    template <>
+    struct formatter<terminal::renderer::DegradationLevel> : formatter<std::string_view> {
+        template <typename FormatContext>
+        auto format(terminal::renderer::DegradationLevel _level, FormatContext& _ctx)
+        {
+            return formatter<std::string_view>::format(to_string(_level), _ctx);
+        }
+    };
+}
@@ -0,0 +1,143 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_renderer/FrameScheduler.h>
+
+#include <crispy/debuglog.h>
+
+#include <algorithm>
+#include <cmath>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+namespace terminal::renderer {
+
+namespace // {{{ helpers
+{
+    auto const FrameSchedulerTag = crispy::debugtag::make("renderer.frames", "Logs details about frame pacing.");
+
+    constexpr int CandidatesToAdopt = 8;        // consecutive contradicting frame intervals to adopt them
+    constexpr int MaxFramesBetween = 4;         // presentations further apart tell nothing about the interval
+    constexpr auto MinInterval = milliseconds(2);
+
+    FrameScheduler::duration intervalOf(double _refreshRate) noexcept
+    {
+        auto const refreshRate = _refreshRate > 1.0 ? _refreshRate : 60.0;
+        return duration_cast<FrameScheduler::duration>(std::chrono::duration<double>(1.0 / refreshRate));
+    }
+
+    /// @returns whether or not @p _a and @p _b differ by no more than the given fraction of @p _b.
+    bool near(FrameScheduler::duration _a, FrameScheduler::duration _b, int _fraction) noexcept
+    {
+        auto const difference = _a > _b ? _a - _b : _b - _a;
+        return difference <= _b / _fraction;
+    }
+} // }}}
+
+FrameScheduler::FrameScheduler(double _refreshRate):
+    nominalInterval_{ intervalOf(_refreshRate) },
+    interval_{ nominalInterval_ },
+    reportedInterval_{ nominalInterval_ }
+{
+}
+
+bool FrameScheduler::setNominalRefreshRate(double _refreshRate)
+{
+    auto const interval = intervalOf(_refreshRate);
+    if (interval == nominalInterval_)
+        return false;
+
+    debuglog(FrameSchedulerTag).write("Display refresh rate changed to {} Hz.", _refreshRate);
+    nominalInterval_ = interval;
+    interval_ = interval;
+    reportedInterval_ = interval;
+    lastVblank_.reset();
+    candidateCount_ = 0;
+    candidateSum_ = {};
+    return true;
+}
+
+bool FrameScheduler::presented(time_point _now)
+{
+    auto const lastVblank = lastVblank_;
+    lastVblank_ = _now;
+    if (!lastVblank)
+        return false;
+
+    auto const delta = _now - *lastVblank;
+    if (delta < MinInterval || delta > MaxFramesBetween * interval_)
+        return false;
+
+    auto const frames = std::round(static_cast<double>(delta.count()) / static_cast<double>(interval_.count()));
+    if (frames >= 1.0 && near(delta / static_cast<int>(frames), interval_, 10))
+    {
+        // Refine the estimate, smoothing out the jitter of individual presentations.
+        interval_ += (delta / static_cast<int>(frames) - interval_) / 8;
+        candidateCount_ = 0;
+        candidateSum_ = {};
+    }
+    else
+    {
+        // The refresh rate may have changed, which is only believed once it is consistently observed.
+        if (candidateCount_ != 0 && !near(delta, candidateSum_ / candidateCount_, 10))
+        {
+            candidateCount_ = 0;
+            candidateSum_ = {};
+        }
+        ++candidateCount_;
+        candidateSum_ += delta;
+        if (candidateCount_ < CandidatesToAdopt)
+            return false;
+
+        interval_ = candidateSum_ / candidateCount_;
+        candidateCount_ = 0;
+        candidateSum_ = {};
+    }
+
+    if (near(interval_, reportedInterval_, 20))
+        return false;
+
+    debuglog(FrameSchedulerTag).write("Estimated refresh interval changed from {} to {} us.",
+                                      duration_cast<microseconds>(reportedInterval_).count(),
+                                      duration_cast<microseconds>(interval_).count());
+    reportedInterval_ = interval_;
+    return true;
+}
+
+double FrameScheduler::refreshRate() const noexcept
+{
+    return 1.0 / std::chrono::duration<double>(interval_).count();
+}
+
+FrameScheduler::time_point FrameScheduler::nextVblank(time_point _now) const noexcept
+{
+    if (!lastVblank_)
+        return _now + interval_;
+
+    if (_now < *lastVblank_)
+        return *lastVblank_ + interval_;
+
+    auto const elapsedFrames = (_now - *lastVblank_) / interval_;
+    return *lastVblank_ + (elapsedFrames + 1) * interval_;
+}
+
+FrameScheduler::duration FrameScheduler::renderDelay(time_point _now) const noexcept
+{
+    // Too late for rendering ahead of the next vertical blank is best dealt with by rendering right away.
+    auto const deadline = nextVblank(_now) - renderAhead_;
+    return std::max(deadline - _now, duration::zero());
+}
+
+} // end namespace
@@ -0,0 +1,73 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <chrono>
+#include <optional>
+
+namespace terminal::renderer {
+
+/// Predicts the display's vertical blanks from the times frames got presented,
+/// so that rendering can be started just in time before the next one.
+///
+/// The refresh interval starts out with the display's nominal refresh rate and is refined
+/// from the intervals between presented frames. Should these consistently disagree with it,
+/// e.g. after the window moved to another monitor, the new interval is adopted.
+class FrameScheduler {
+  public:
+    using clock = std::chrono::steady_clock;
+    using duration = clock::duration;
+    using time_point = clock::time_point;
+
+    explicit FrameScheduler(double _refreshRate = 60.0);
+
+    /// Sets the refresh rate as reported by the display, discarding what has been measured so far.
+    ///
+    /// @returns true if it differs from the previously set one.
+    bool setNominalRefreshRate(double _refreshRate);
+
+    /// Sets how long before the vertical blank rendering should start.
+    void setRenderAhead(duration _renderAhead) noexcept { renderAhead_ = _renderAhead; }
+
+    /// Records that a frame has been presented at the given time.
+    ///
+    /// @returns true if the estimated refresh rate changed significantly.
+    bool presented(time_point _now);
+
+    /// @returns the estimated refresh rate in Hz.
+    double refreshRate() const noexcept;
+
+    /// @returns the estimated refresh interval.
+    duration refreshInterval() const noexcept { return interval_; }
+
+    /// @returns the predicted time of the next vertical blank after @p _now.
+    time_point nextVblank(time_point _now) const noexcept;
+
+    /// @returns how long to wait from @p _now before rendering the next frame,
+    ///          or zero if it is time to render already.
+    duration renderDelay(time_point _now) const noexcept;
+
+  private:
+    duration nominalInterval_;
+    duration interval_;                 // estimated refresh interval
+    duration reportedInterval_;         // interval last reported as changed by presented()
+    duration renderAhead_ = std::chrono::milliseconds(3);
+    std::optional<time_point> lastVblank_;
+
+    // Frame intervals contradicting the estimate, as candidates for a new refresh rate.
+    int candidateCount_ = 0;
+    duration candidateSum_{};
+};
+
+} // end namespace
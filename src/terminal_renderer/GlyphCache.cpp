@@ -0,0 +1,292 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_renderer/GlyphCache.h>
+
+#include <crispy/FNV.h>
+#include <crispy/debuglog.h>
+#include <crispy/stdfs.h>
+
+#include <fmt/format.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using std::make_unique;
+using std::move;
+using std::nullopt;
+using std::optional;
+using std::pair;
+using std::string;
+using std::string_view;
+
+namespace terminal::renderer {
+
+namespace // {{{ helpers
+{
+    auto const GlyphCacheTag = crispy::debugtag::make("renderer.glyphcache", "Logs details about the on-disk glyph cache.");
+
+    // Identifies the file format. Must be changed whenever the record layout changes.
+    constexpr string_view Magic = "CTRGLY01";
+
+    struct RecordHeader
+    {
+        uint32_t index;
+        int32_t width;
+        int32_t height;
+        int32_t left;
+        int32_t top;
+        uint32_t format;
+        uint32_t byteCount;
+    };
+
+    bool isValid(RecordHeader const& _header) noexcept
+    {
+        if (_header.format > static_cast<uint32_t>(text::bitmap_format::rgba))
+            return false;
+
+        if (_header.width < 0 || _header.height < 0)
+            return false;
+
+        auto const pixelSize = text::pixel_size(static_cast<text::bitmap_format>(_header.format));
+        return uint64_t(_header.byteCount) == uint64_t(_header.width) * uint64_t(_header.height) * uint64_t(pixelSize);
+    }
+
+#if !defined(_WIN32)
+    /// Opens the given cache file for appending, creating it if needed.
+    ///
+    /// New files are prepared under a temporary name and linked into place,
+    /// so that other processes never see a file without its magic header.
+    int openCacheFile(FileSystem::path const& _path)
+    {
+        if (int const fd = open(_path.string().c_str(), O_RDWR | O_APPEND | O_CLOEXEC); fd >= 0 || errno != ENOENT)
+            return fd;
+
+        FileSystemError ec;
+        FileSystem::create_directories(_path.parent_path(), ec);
+
+        auto tempPath = _path.string() + ".XXXXXX";
+        int const tempFd = mkstemp(tempPath.data());
+        if (tempFd < 0)
+            return -1;
+
+        bool const ok = write(tempFd, Magic.data(), Magic.size()) == static_cast<ssize_t>(Magic.size());
+        close(tempFd);
+        if (ok)
+            (void) link(tempPath.c_str(), _path.string().c_str()); // fails if another process won the race
+        unlink(tempPath.c_str());
+
+        return open(_path.string().c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+    }
+#endif
+} // }}}
+
+struct GlyphCache::File
+{
+    int fd = -1;
+    char const* data = nullptr; // file contents as of opening it
+    size_t size = 0;
+    std::unordered_map<uint32_t, size_t> offsets; // glyph index to its record within data
+    std::unordered_set<uint32_t> written;         // glyphs appended after mapping the file
+
+    File() = default;
+    File(File const&) = delete;
+    File& operator=(File const&) = delete;
+    ~File();
+};
+
+GlyphCache::File::~File()
+{
+#if !defined(_WIN32)
+    if (data)
+        munmap(const_cast<char*>(data), size);
+    if (fd >= 0)
+        close(fd);
+#endif
+}
+
+GlyphCache::GlyphCache(string _directory,
+                       text::shaper& _shaper,
+                       crispy::Point _dpi,
+                       text::render_mode _renderMode):
+    directory_{ move(_directory) },
+    shaper_{ _shaper },
+    dpi_{ _dpi },
+    renderMode_{ _renderMode }
+{
+}
+
+GlyphCache::~GlyphCache()
+{
+}
+
+#if !defined(_WIN32)
+GlyphCache::File* GlyphCache::fileFor(text::font_key _font, text::font_size _size)
+{
+    auto const key = pair{_font.value, _size.pt};
+    if (auto i = files_.find(key); i != files_.end())
+        return i->second.get(); // nullptr if the cache is unavailable for that font
+
+    auto& file = files_[key];
+
+    auto const fontFile = shaper_.font_file(_font);
+    if (!fontFile.has_value())
+        return nullptr;
+
+    struct stat st{};
+    if (stat(fontFile->c_str(), &st) != 0)
+        return nullptr;
+
+    auto const identity = fmt::format("{}:{}:{}:{}:{}:{}:{}",
+                                      *fontFile,
+                                      st.st_size,
+                                      st.st_mtime,
+                                      _size.pt,
+                                      dpi_.x,
+                                      dpi_.y,
+                                      static_cast<int>(renderMode_));
+    auto const fnv = crispy::FNV<char, uint64_t>{1099511628211llu, 14695981039346656037llu};
+    auto const path = FileSystem::path(directory_) / fmt::format("{:016x}.glyphs", fnv(identity.data(), identity.size()));
+
+    int const fd = openCacheFile(path);
+    if (fd < 0)
+    {
+        debuglog(GlyphCacheTag).write("Could not open glyph cache file {}. {}", path.string(), strerror(errno));
+        return nullptr;
+    }
+
+    auto newFile = make_unique<File>();
+    newFile->fd = fd;
+
+    if (fstat(fd, &st) != 0)
+        return nullptr;
+
+    auto const size = static_cast<size_t>(st.st_size);
+    if (size < Magic.size())
+        return nullptr;
+
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        debuglog(GlyphCacheTag).write("Could not map glyph cache file {}. {}", path.string(), strerror(errno));
+        return nullptr;
+    }
+    newFile->data = static_cast<char const*>(data);
+    newFile->size = size;
+
+    if (string_view(newFile->data, Magic.size()) != Magic)
+    {
+        debuglog(GlyphCacheTag).write("Ignoring glyph cache file {} of unknown format.", path.string());
+        return nullptr;
+    }
+
+    // Another process may be appending a record right now, so a truncated tail is expected.
+    auto offset = Magic.size();
+    while (offset + sizeof(RecordHeader) <= size)
+    {
+        RecordHeader header{};
+        std::memcpy(&header, newFile->data + offset, sizeof(header));
+        if (!isValid(header) || offset + sizeof(header) + header.byteCount > size)
+            break;
+        newFile->offsets.emplace(header.index, offset);
+        offset += sizeof(header) + header.byteCount;
+    }
+
+    if (offset != size)
+    {
+        // Records appended after a damaged one could never be found again,
+        // so have the next process start afresh. The mapping stays valid for this one.
+        debuglog(GlyphCacheTag).write("Discarding damaged glyph cache file {}.", path.string());
+        unlink(path.string().c_str());
+    }
+
+    debuglog(GlyphCacheTag).write("Using glyph cache file {} with {} glyphs for font {}.",
+                                  path.string(), newFile->offsets.size(), *fontFile);
+    file = move(newFile);
+    return file.get();
+}
+#else
+GlyphCache::File* GlyphCache::fileFor(text::font_key, text::font_size)
+{
+    // Not available, see GlyphCache::Available.
+    return nullptr;
+}
+#endif
+
+optional<text::rasterized_glyph> GlyphCache::get(text::glyph_key const& _glyph)
+{
+    File const* file = fileFor(_glyph.font, _glyph.size);
+    if (!file)
+        return nullopt;
+
+    auto const i = file->offsets.find(_glyph.index.value);
+    if (i == file->offsets.end())
+        return nullopt;
+
+    RecordHeader header{};
+    std::memcpy(&header, file->data + i->second, sizeof(header));
+    auto const bitmap = reinterpret_cast<uint8_t const*>(file->data + i->second + sizeof(header));
+
+    auto glyph = text::rasterized_glyph{};
+    glyph.index = _glyph.index;
+    glyph.size = crispy::Size{header.width, header.height};
+    glyph.position = crispy::Point{header.left, header.top};
+    glyph.format = static_cast<text::bitmap_format>(header.format);
+    glyph.bitmap.assign(bitmap, bitmap + header.byteCount);
+    return glyph;
+}
+
+void GlyphCache::put(text::glyph_key const& _glyph, text::rasterized_glyph const& _bitmap)
+{
+#if !defined(_WIN32)
+    File* file = fileFor(_glyph.font, _glyph.size);
+    if (!file)
+        return;
+
+    if (file->offsets.count(_glyph.index.value) || !file->written.insert(_glyph.index.value).second)
+        return;
+
+    auto const header = RecordHeader{
+        _glyph.index.value,
+        _bitmap.size.width,
+        _bitmap.size.height,
+        _bitmap.position.x,
+        _bitmap.position.y,
+        static_cast<uint32_t>(_bitmap.format),
+        static_cast<uint32_t>(_bitmap.bitmap.size())
+    };
+    if (!isValid(header))
+        return;
+
+    // Written at once, so that concurrently appending processes do not interleave records.
+    auto record = string(sizeof(header) + _bitmap.bitmap.size(), '\0');
+    std::memcpy(record.data(), &header, sizeof(header));
+    if (!_bitmap.bitmap.empty())
+        std::memcpy(record.data() + sizeof(header), _bitmap.bitmap.data(), _bitmap.bitmap.size());
+
+    if (write(file->fd, record.data(), record.size()) != static_cast<ssize_t>(record.size()))
+        debuglog(GlyphCacheTag).write("Could not append glyph {} to the glyph cache. {}", _glyph.index, strerror(errno));
+#endif
+}
+
+} // end namespace
@@ -0,0 +1,83 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <text_shaper/font.h>
+#include <text_shaper/shaper.h>
+
+#include <crispy/point.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace terminal::renderer {
+
+/// Persistent on-disk cache of rasterized glyphs, shared by all terminal windows.
+///
+/// There is one append-only file per font file, font size, DPI and render mode,
+/// named after a hash of these (including the font file's size and modification time,
+/// so that updated fonts do not hit stale bitmaps).
+/// A file is memory-mapped the first time a glyph of its font is looked up,
+/// so that glyphs rasterized by earlier processes can go straight into the texture atlas.
+///
+/// Only available on POSIX systems, see Available.
+class GlyphCache {
+  public:
+    /// Whether glyphs are cached at all on this platform. Elsewhere, no cache is created,
+    /// and glyphs are rasterized by every process anew.
+#if defined(_WIN32)
+    static constexpr bool Available = false;
+#else
+    static constexpr bool Available = true;
+#endif
+
+    GlyphCache(std::string _directory,
+               text::shaper& _shaper,
+               crispy::Point _dpi,
+               text::render_mode _renderMode);
+    ~GlyphCache();
+
+    GlyphCache(GlyphCache const&) = delete;
+    GlyphCache& operator=(GlyphCache const&) = delete;
+
+    /// @returns the cached bitmap of the given glyph or std::nullopt on cache miss.
+    std::optional<text::rasterized_glyph> get(text::glyph_key const& _glyph);
+
+    /// Appends the given freshly rasterized glyph to the cache.
+    void put(text::glyph_key const& _glyph, text::rasterized_glyph const& _bitmap);
+
+    /// Sets the DPI that fonts looked up from now on have been loaded at.
+    ///
+    /// Files opened before keep being used for their fonts, as font keys are distinct per DPI.
+    void setDpi(crispy::Point _dpi) noexcept { dpi_ = _dpi; }
+
+  private:
+    struct File;
+    File* fileFor(text::font_key _font, text::font_size _size);
+
+    std::string directory_;
+    text::shaper& shaper_;
+    crispy::Point dpi_;
+    text::render_mode renderMode_;
+
+    // Font keys are only meaningful to the current shaper instance,
+    // so cache files are opened lazily and per font key and size.
+    std::map<std::pair<unsigned, double>, std::unique_ptr<File>> files_;
+};
+
+} // end namespace
@@ -0,0 +1,156 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_renderer/GlyphRasterizer.h>
+
+#include <crispy/debuglog.h>
+
+#include <algorithm>
+#include <exception>
+
+using std::exception;
+using std::find_if;
+using std::move;
+using std::nullopt;
+using std::optional;
+using std::scoped_lock;
+using std::unique_lock;
+using std::vector;
+
+namespace terminal::renderer {
+
+namespace
+{
+    auto const GlyphRasterizerTag = crispy::debugtag::make("renderer.rasterizer", "Logs details about asynchronous glyph rasterization.");
+}
+
+GlyphRasterizer::GlyphRasterizer(text::shaper& _shaper, std::function<void()> _ready):
+    shaper_{ _shaper },
+    ready_{ move(_ready) },
+    thread_{ [this]() { run(); } }
+{
+}
+
+GlyphRasterizer::~GlyphRasterizer()
+{
+    {
+        auto _l = scoped_lock{lock_};
+        quit_ = true;
+    }
+    condition_.notify_one();
+    thread_.join();
+}
+
+void GlyphRasterizer::request(text::glyph_key const& _glyph, text::render_mode _mode)
+{
+    {
+        auto _l = scoped_lock{lock_};
+        auto const [i, inserted] = pending_.try_emplace(_glyph, true);
+        if (!inserted)
+        {
+            if (i->second)
+                return;
+
+            // Prefetched already, but needed right away now.
+            i->second = true;
+            auto const prefetched = find_if(prefetchQueue_.begin(), prefetchQueue_.end(), [&](auto const& _entry) {
+                return _entry.first == _glyph;
+            });
+            if (prefetched == prefetchQueue_.end())
+                return; // Being rasterized already, and signaled once done.
+            prefetchQueue_.erase(prefetched);
+        }
+        queue_.emplace_back(_glyph, _mode);
+    }
+    condition_.notify_one();
+}
+
+void GlyphRasterizer::prefetch(text::glyph_key const& _glyph, text::render_mode _mode)
+{
+    {
+        auto _l = scoped_lock{lock_};
+        if (!pending_.try_emplace(_glyph, false).second)
+            return;
+        prefetchQueue_.emplace_back(_glyph, _mode);
+    }
+    condition_.notify_one();
+}
+
+vector<GlyphRasterizer::Result> GlyphRasterizer::fetch()
+{
+    auto _l = scoped_lock{lock_};
+    auto results = vector<Result>{};
+    results.swap(results_);
+    for (Result const& result: results)
+        pending_.erase(result.glyph);
+    signaled_ = false;
+    return results;
+}
+
+void GlyphRasterizer::clear()
+{
+    auto _l = scoped_lock{lock_};
+    queue_.clear();
+    prefetchQueue_.clear();
+    pending_.clear();
+    results_.clear();
+    signaled_ = false;
+    ++generation_;
+}
+
+void GlyphRasterizer::run()
+{
+    auto lock = unique_lock{lock_};
+    for (;;)
+    {
+        condition_.wait(lock, [this]() { return quit_ || !queue_.empty() || !prefetchQueue_.empty(); });
+        if (quit_)
+            return;
+
+        auto& queue = !queue_.empty() ? queue_ : prefetchQueue_;
+        auto const [glyph, mode] = queue.front();
+        queue.pop_front();
+        auto const generation = generation_;
+
+        lock.unlock();
+        optional<text::rasterized_glyph> bitmap = nullopt;
+        try
+        {
+            bitmap = shaper_.rasterize(glyph, mode);
+        }
+        catch (exception const& e)
+        {
+            // Most likely the font got unloaded, in which case the result is discarded anyways.
+            debuglog(GlyphRasterizerTag).write("Rasterizing glyph {} failed. {}", glyph, e.what());
+        }
+        lock.lock();
+
+        if (generation != generation_)
+            continue;
+
+        // Only signal the first requested result, the remaining ones are fetched along with it.
+        // Prefetched ones are fetched along with the next frame, whenever that is.
+        bool const notify = !signaled_ && pending_[glyph];
+        signaled_ = signaled_ || notify;
+        results_.emplace_back(Result{glyph, move(bitmap)});
+
+        if (notify && ready_)
+        {
+            lock.unlock();
+            ready_();
+            lock.lock();
+        }
+    }
+}
+
+} // end namespace
@@ -0,0 +1,84 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <text_shaper/font.h>
+#include <text_shaper/shaper.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace terminal::renderer {
+
+/// Rasterizes glyphs on a worker thread, so that glyph cache misses do not stall rendering.
+///
+/// Glyphs are requested from the render thread, and the rasterized bitmaps are
+/// fetched back from there, too, once the ready callback signaled their availability.
+class GlyphRasterizer {
+  public:
+    struct Result {
+        text::glyph_key glyph;
+        std::optional<text::rasterized_glyph> bitmap; // std::nullopt if rasterization failed
+    };
+
+    /// @param _ready invoked from the worker thread whenever results become available for fetching.
+    GlyphRasterizer(text::shaper& _shaper, std::function<void()> _ready);
+    ~GlyphRasterizer();
+
+    GlyphRasterizer(GlyphRasterizer const&) = delete;
+    GlyphRasterizer& operator=(GlyphRasterizer const&) = delete;
+
+    /// Schedules the given glyph for rasterization, unless it is already pending.
+    void request(text::glyph_key const& _glyph, text::render_mode _mode);
+
+    /// Schedules the given glyph for rasterization ahead of its first use, unless it is already pending.
+    ///
+    /// Prefetched glyphs are rasterized only while no requested ones are waiting,
+    /// and their results do not invoke the ready callback, unless requested in the meantime.
+    void prefetch(text::glyph_key const& _glyph, text::render_mode _mode);
+
+    /// @return all glyphs rasterized since the last call.
+    std::vector<Result> fetch();
+
+    /// Discards all pending requests and results, e.g. because the fonts have changed.
+    void clear();
+
+  private:
+    void run();
+
+    text::shaper& shaper_;
+    std::function<void()> ready_;
+
+    std::mutex lock_;
+    std::condition_variable condition_;
+    std::deque<std::pair<text::glyph_key, text::render_mode>> queue_;
+    std::deque<std::pair<text::glyph_key, text::render_mode>> prefetchQueue_;
+    std::unordered_map<text::glyph_key, bool> pending_; // glyphs requested (true) or prefetched but not fetched yet
+    std::vector<Result> results_;
+    bool signaled_ = false;                         // whether the ready callback was invoked since the last fetch()
+    uint64_t generation_ = 0;                       // incremented on clear() to drop results in flight
+    bool quit_ = false;
+
+    std::thread thread_;
+};
+
+} // end namespace
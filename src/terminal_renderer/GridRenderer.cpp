@@ -0,0 +1,120 @@
+/**
+ * This file is part of the "contour" project.
+ *   Copyright (c) 2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_renderer/GridRenderer.h>
+#include <terminal_renderer/DecorationRenderer.h>
+#include <terminal_renderer/GridMetrics.h>
+
+namespace terminal::renderer {
+
+GridRenderer::GridRenderer(GridMetrics const& _gridMetrics, RGBColor const& _defaultColor) :
+    gridMetrics_{ _gridMetrics },
+    defaultColor_{ _defaultColor }
+{
+}
+
+void GridRenderer::start(int _firstRow, int _lastRow)
+{
+    active_ = enabled_
+           && renderTargetAvailable()
+           && renderTarget().supportsCellGrid()
+           && _firstRow <= _lastRow;
+    firstRow_ = _firstRow;
+    lastRow_ = _lastRow;
+
+    cells_.clear();
+    if (active_)
+        cells_.resize(static_cast<size_t>((_lastRow - _firstRow + 1) * gridMetrics_.pageSize.width));
+}
+
+void GridRenderer::renderCell(RenderCell const& _cell, bool _decorated)
+{
+    GridCell* cell = cellAt(gridMetrics_.map(_cell.position));
+    if (!cell)
+        return;
+
+    // The glyph rendered into this cell later on is only known by its color,
+    // referring to the cell's foreground palette slot if it is the cell's foreground color.
+    cell->foreground = RGBAColor{_cell.foregroundColor};
+    cell->foregroundSlot = _cell.foregroundSlot;
+    cell->faint = (_cell.flags & CellFlags::Faint) != 0;
+
+    if (_cell.backgroundColor != defaultColor_)
+    {
+        cell->background = RGBAColor{_cell.backgroundColor};
+        cell->backgroundSlot = _cell.backgroundSlot;
+    }
+
+    if (auto const decorators = _decorated ? decoratorMask(_cell.flags) : uint16_t{0}; decorators)
+    {
+        cell->decorators = decorators;
+        cell->decorationColor = _cell.decorationColor;
+        cell->decorationSlot = _cell.decorationSlot;
+    }
+}
+
+bool GridRenderer::renderGlyph(crispy::Point _cellPos,
+                               crispy::Point _glyphPos,
+                               atlas::TextureInfo const& _textureInfo,
+                               RGBAColor const& _color)
+{
+    GridCell* cell = cellAt(_cellPos);
+    if (!cell || cell->glyph)
+        return false;
+
+    // A pixel is only looked up in its own cell and both horizontal neighbors.
+    auto const cellSize = gridMetrics_.cellSize;
+    auto const offset = crispy::Point{_glyphPos.x - _cellPos.x, _glyphPos.y - _cellPos.y};
+    auto const targetSize = _textureInfo.targetSize;
+    if (offset.x < -cellSize.width || offset.x + targetSize.width > 2 * cellSize.width)
+        return false;
+    if (offset.y < 0 || offset.y + targetSize.height > cellSize.height)
+        return false;
+
+    if (cell->foreground.rgb() != _color.rgb())
+        cell->foregroundSlot = PaletteSlot::None;
+    cell->foreground = _color;
+    cell->glyph = &_textureInfo;
+    cell->glyphOffset = offset;
+    return true;
+}
+
+void GridRenderer::finish()
+{
+    if (!active_)
+        return;
+
+    renderTarget().renderGrid(gridMetrics_, firstRow_, lastRow_, cells_);
+    active_ = false;
+}
+
+GridCell* GridRenderer::cellAt(crispy::Point _cellPos) noexcept
+{
+    if (!active_)
+        return nullptr;
+
+    // Inverse of GridMetrics::map().
+    auto const cellSize = gridMetrics_.cellSize;
+    auto const column = (_cellPos.x - gridMetrics_.pageMargin.left) / cellSize.width + 1;
+    auto const row = gridMetrics_.pageSize.height - (_cellPos.y - gridMetrics_.pageMargin.bottom) / cellSize.height;
+
+    if (column < 1 || column > gridMetrics_.pageSize.width)
+        return nullptr;
+    if (row < firstRow_ || row > lastRow_)
+        return nullptr;
+
+    auto const index = (row - firstRow_) * gridMetrics_.pageSize.width + (column - 1);
+    return &cells_[static_cast<size_t>(index)];
+}
+
+} // end namespace
@@ -0,0 +1,76 @@
+/**
+ * This file is part of the "contour" project.
+ *   Copyright (c) 2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal_renderer/RenderTarget.h>
+
+#include <terminal/RenderBuffer.h>
+
+#include <crispy/point.h>
+
+#include <vector>
+
+namespace terminal::renderer {
+
+struct GridMetrics;
+
+/// Collects cell backgrounds, glyphs and decorations of the rendered grid lines into a compact
+/// cell grid, which the render target resolves in a single pass instead of one rectangle,
+/// texture or decoration instance each.
+///
+/// Only used if enabled and supported by the render target. Glyphs that do not fit
+/// the cell grid (see renderGlyph()) are left to be rendered as textures by the caller.
+class GridRenderer : public Renderable {
+  public:
+    GridRenderer(GridMetrics const& _gridMetrics, RGBColor const& _defaultColor);
+
+    void setEnabled(bool _enabled) noexcept { enabled_ = _enabled; }
+
+    /// @returns whether or not the current frame is rendered through the cell grid.
+    bool active() const noexcept { return active_; }
+
+    /// Starts collecting the grid lines @p _firstRow to @p _lastRow of the current frame.
+    void start(int _firstRow, int _lastRow);
+
+    /// Sets the cell's background color, unless it is the default one,
+    /// and its decorations if @p _decorated, along with the palette slots of its colors.
+    void renderCell(RenderCell const& _cell, bool _decorated);
+
+    /// Places a glyph into the cell at @p _cellPos, with its bitmap's bottom left corner at @p _glyphPos.
+    ///
+    /// @returns false if the glyph has to be rendered as a texture instead, such as when the
+    ///          cell already holds a glyph, or when the glyph exceeds the cell's line or
+    ///          the cell's immediate neighbors.
+    bool renderGlyph(crispy::Point _cellPos,
+                     crispy::Point _glyphPos,
+                     atlas::TextureInfo const& _textureInfo,
+                     RGBAColor const& _color);
+
+    /// Hands the collected cells over to the render target.
+    void finish();
+
+  private:
+    GridCell* cellAt(crispy::Point _cellPos) noexcept;
+
+    GridMetrics const& gridMetrics_;
+    RGBColor const& defaultColor_;
+
+    bool enabled_ = false;
+    bool active_ = false;
+    int firstRow_ = 0;
+    int lastRow_ = 0;
+    std::vector<GridCell> cells_; // cells of the current frame's grid lines, in row-major order
+};
+
+} // end namespace
@@ -0,0 +1,119 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_renderer/ImageRasterizer.h>
+
+using std::copy;
+using std::move;
+using std::scoped_lock;
+using std::shared_ptr;
+using std::unique_lock;
+using std::vector;
+
+namespace terminal::renderer {
+
+ImageRasterizer::ImageRasterizer(std::function<void()> _ready):
+    ready_{ move(_ready) },
+    thread_{ [this]() { run(); } }
+{
+}
+
+ImageRasterizer::~ImageRasterizer()
+{
+    {
+        auto _l = scoped_lock{lock_};
+        quit_ = true;
+    }
+    condition_.notify_one();
+    thread_.join();
+}
+
+void ImageRasterizer::request(ImageTileKey const& _key, shared_ptr<RasterizedImage const> _image)
+{
+    {
+        auto _l = scoped_lock{lock_};
+        if (!pending_.insert(_key).second)
+            return;
+        queue_.emplace_back(Request{_key, move(_image)});
+    }
+    condition_.notify_one();
+}
+
+vector<ImageRasterizer::Result> ImageRasterizer::fetch()
+{
+    auto _l = scoped_lock{lock_};
+    auto results = vector<Result>{};
+    results.swap(results_);
+    for (Result const& result: results)
+        pending_.erase(result.key);
+    return results;
+}
+
+void ImageRasterizer::clear()
+{
+    auto _l = scoped_lock{lock_};
+    queue_.clear();
+    pending_.clear();
+    results_.clear();
+    ++generation_;
+}
+
+Image::Data ImageRasterizer::cut(Image const& _image, ImageTileKey const& _key)
+{
+    auto const rowSize = static_cast<size_t>(_key.size.width) * 4;
+    auto bitmap = Image::Data(rowSize * static_cast<size_t>(_key.size.height));
+    auto const pixels = _image.pixels();
+    auto target = bitmap.begin();
+    for (int y = _key.offset.row + _key.size.height - 1; y >= _key.offset.row; --y)
+    {
+        auto const source = &pixels.data[(static_cast<size_t>(y) * static_cast<size_t>(_image.width())
+                                          + static_cast<size_t>(_key.offset.column)) * 4];
+        target = copy(source, source + rowSize, target);
+    }
+    return bitmap;
+}
+
+void ImageRasterizer::run()
+{
+    auto lock = unique_lock{lock_};
+    for (;;)
+    {
+        condition_.wait(lock, [this]() { return quit_ || !queue_.empty(); });
+        if (quit_)
+            return;
+
+        auto request = move(queue_.front());
+        queue_.pop_front();
+        auto const generation = generation_;
+
+        lock.unlock();
+        auto bitmap = cut(request.image->image(), request.key);
+        lock.lock();
+
+        if (generation != generation_)
+            continue;
+
+        // Only signal the first result, the remaining ones are fetched along with it.
+        bool const notify = results_.empty();
+        results_.emplace_back(Result{request.key, move(bitmap), move(request.image)});
+
+        if (notify && ready_)
+        {
+            lock.unlock();
+            ready_();
+            lock.lock();
+        }
+    }
+}
+
+} // end namespace
@@ -0,0 +1,140 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/Image.h>
+
+#include <crispy/FNV.h>
+#include <crispy/size.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace terminal::renderer
+{
+    /// Identifies a tile of an image in the texture atlas.
+    ///
+    /// Tiles are cut out of the image's own pixels, independent of the grid's cell size.
+    struct ImageTileKey
+    {
+        Image::Id const imageId;
+        Coordinate const offset;        // of the tile's top left pixel into the image
+        crispy::Size const size;        // of the tile in pixels
+
+        bool operator==(ImageTileKey const& b) const noexcept
+        {
+            return imageId == b.imageId
+                && offset == b.offset
+                && size == b.size;
+        }
+
+        bool operator!=(ImageTileKey const& b) const noexcept
+        {
+            return !(*this == b);
+        }
+
+        bool operator<(ImageTileKey const& b) const noexcept
+        {
+            return (imageId < b.imageId)
+                || (imageId == b.imageId && offset < b.offset);
+        }
+    };
+}
+
+namespace std
+{
+    template<>
+    struct hash<terminal::renderer::ImageTileKey>
+    {
+        constexpr size_t operator()(terminal::renderer::ImageTileKey const& _key) const noexcept
+        {
+            using FNV = crispy::FNV<uint64_t>;
+            return FNV{}(FNV{}.basis(),
+                         _key.imageId,
+                         _key.offset.row,
+                         _key.offset.column,
+                         _key.size.width,
+                         _key.size.height);
+        }
+    };
+}
+
+namespace terminal::renderer {
+
+/// Cuts tiles out of images on a worker thread, so that large images
+/// do not stall rendering.
+///
+/// Tiles are requested from the render thread, and their bitmaps are fetched back
+/// from there, too, once the ready callback signaled their availability.
+class ImageRasterizer {
+  public:
+    struct Result {
+        ImageTileKey key;
+        Image::Data bitmap;     // the tile's RGBA bitmap, see cut()
+
+        // Keeps the image alive until its tile has been used, as images are discarded
+        // from the texture atlas only once they are gone.
+        std::shared_ptr<RasterizedImage const> image;
+    };
+
+    /// @param _ready invoked from the worker thread whenever results become available for fetching.
+    explicit ImageRasterizer(std::function<void()> _ready);
+    ~ImageRasterizer();
+
+    ImageRasterizer(ImageRasterizer const&) = delete;
+    ImageRasterizer& operator=(ImageRasterizer const&) = delete;
+
+    /// Schedules the tile identified by @p _key to be cut out of @p _image, unless it is already pending.
+    ///
+    /// The image is kept alive until the tile has been fetched.
+    void request(ImageTileKey const& _key, std::shared_ptr<RasterizedImage const> _image);
+
+    /// @return all tiles cut since the last call.
+    std::vector<Result> fetch();
+
+    /// Discards all pending requests and results, e.g. because the texture atlas got cleared.
+    void clear();
+
+    /// @returns the RGBA bitmap of the tile identified by @p _key, with its bottom line of pixels first.
+    static Image::Data cut(Image const& _image, ImageTileKey const& _key);
+
+  private:
+    struct Request {
+        ImageTileKey key;
+        std::shared_ptr<RasterizedImage const> image;
+    };
+
+    void run();
+
+    std::function<void()> ready_;
+
+    std::mutex lock_;
+    std::condition_variable condition_;
+    std::deque<Request> queue_;
+    std::unordered_set<ImageTileKey> pending_;  // tiles requested but not fetched yet
+    std::vector<Result> results_;
+    uint64_t generation_ = 0;                   // incremented on clear() to drop results in flight
+    bool quit_ = false;
+
+    std::thread thread_;
+};
+
+} // end namespace
@@ -16,18 +16,97 @@
 #include <crispy/times.h>
 #include <crispy/algorithm.h>
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <tuple>
 
 using crispy::Size;
 using crispy::times;
 
 using std::array;
-using std::array;
+using std::ceil;
+using std::floor;
+using std::lround;
+using std::make_unique;
+using std::max;
+using std::min;
+using std::move;
 using std::nullopt;
 using std::optional;
+using std::tie;
 
 namespace terminal::renderer {
 
+namespace
+{
+    // Upper bound of a tile's width and height in pixels.
+    constexpr int MaxTileSize = 512;
+
+    /// Where and how large an image is rendered, relative to the top left corner
+    /// of the grid cells it is placed onto.
+    struct Placement {
+        double x;           // left edge, negative if cropped
+        double y;           // top edge, negative if cropped
+        double scaleX;      // rendered pixels per image pixel
+        double scaleY;
+    };
+
+    /// @returns position of the image within the free space along one dimension,
+    ///          0 for start (or top), 0.5 for center (or middle), 1 for end (or bottom).
+    std::pair<double, double> alignmentFactors(ImageAlignment _alignment) noexcept
+    {
+        switch (_alignment)
+        {
+            case ImageAlignment::TopStart: return {0.0, 0.0};
+            case ImageAlignment::TopCenter: return {0.5, 0.0};
+            case ImageAlignment::TopEnd: return {1.0, 0.0};
+            case ImageAlignment::MiddleStart: return {0.0, 0.5};
+            case ImageAlignment::MiddleCenter: return {0.5, 0.5};
+            case ImageAlignment::MiddleEnd: return {1.0, 0.5};
+            case ImageAlignment::BottomStart: return {0.0, 1.0};
+            case ImageAlignment::BottomCenter: return {0.5, 1.0};
+            case ImageAlignment::BottomEnd: return {1.0, 1.0};
+        }
+        return {0.5, 0.5};
+    }
+
+    Placement placement(RasterizedImage const& _image, Size _cellSize) noexcept
+    {
+        auto const imageWidth = static_cast<double>(max(1, _image.image().width()));
+        auto const imageHeight = static_cast<double>(max(1, _image.image().height()));
+        auto const areaWidth = static_cast<double>(_image.cellSpan().width * _cellSize.width);
+        auto const areaHeight = static_cast<double>(_image.cellSpan().height * _cellSize.height);
+
+        auto scaleX = areaWidth / imageWidth;
+        auto scaleY = areaHeight / imageHeight;
+        switch (_image.resizePolicy())
+        {
+            case ImageResize::NoResize:
+                // Keeps the image's size relative to the cells it has been placed onto.
+                scaleX = static_cast<double>(_cellSize.width) / static_cast<double>(max(1, _image.cellSize().width));
+                scaleY = static_cast<double>(_cellSize.height) / static_cast<double>(max(1, _image.cellSize().height));
+                break;
+            case ImageResize::ResizeToFit:
+                scaleX = scaleY = min(scaleX, scaleY);
+                break;
+            case ImageResize::ResizeToFill:
+                scaleX = scaleY = max(scaleX, scaleY);
+                break;
+            case ImageResize::StretchToFill:
+                break;
+        }
+
+        auto const [alignX, alignY] = alignmentFactors(_image.alignmentPolicy());
+        return Placement{
+            (areaWidth - imageWidth * scaleX) * alignX,
+            (areaHeight - imageHeight * scaleY) * alignY,
+            scaleX,
+            scaleY
+        };
+    }
+}
+
 ImageRenderer::ImageRenderer(Size const& _cellSize) :
     imagePool_{},
     cellSize_{ _cellSize }
@@ -43,73 +122,224 @@ void ImageRenderer::setRenderTarget(RenderTarget& _renderTarget)
 void ImageRenderer::setCellSize(Size const& _cellSize)
 {
     cellSize_ = _cellSize;
-    // TODO: recompute slices here?
+}
+
+void ImageRenderer::enableAsyncRasterization(std::function<void()> _ready)
+{
+    rasterizer_ = make_unique<ImageRasterizer>(move(_ready));
 }
 
 void ImageRenderer::renderImage(crispy::Point _pos, ImageFragment const& _fragment)
 {
-    if (optional<DataRef> const dataRef = getTextureInfo(_fragment); dataRef.has_value())
+    auto const& image = _fragment.rasterizedImage();
+    auto const offset = _fragment.offset();
+    auto const origin = crispy::Point{
+        _pos.x - offset.column * cellSize_.width,
+        _pos.y + offset.row * cellSize_.height
+    };
+
+    // Extend the current run if this fragment is its right neighbor.
+    if (!blocks_.empty())
     {
-        //std::cout << fmt::format("ImageRenderer.renderImage: {}\n", _fragment);
+        Block& run = blocks_.back();
+        if (run.image.get() == &image
+            && run.origin.x == origin.x
+            && run.origin.y == origin.y
+            && run.top == offset.row
+            && run.right + 1 == offset.column)
+        {
+            run.right = offset.column;
+            return;
+        }
+    }
+
+    blocks_.emplace_back(Block{_fragment.rasterizedImageRef(), origin, offset.row, offset.row, offset.column, offset.column});
+}
 
-        auto const color = array{1.0f, 0.0f, 0.0f, 1.0f}; // not used
-        atlas::TextureInfo const& textureInfo = std::get<0>(*dataRef).get();
+void ImageRenderer::finish()
+{
+    tilesPending_ = false;
+    if (rasterizer_)
+        for (ImageRasterizer::Result& result: rasterizer_->fetch())
+            insertTile(result.key, move(result.bitmap));
+
+    // Runs of consecutive lines spanning the same columns make up a single rectangle.
+    auto const placement = [](Block const& _block) {
+        return tie(_block.image, _block.origin.x, _block.origin.y, _block.left, _block.right);
+    };
+    std::sort(blocks_.begin(), blocks_.end(), [&](Block const& a, Block const& b) {
+        return std::tuple_cat(placement(a), tie(a.top)) < std::tuple_cat(placement(b), tie(b.top));
+    });
 
-        // TODO: actually make x/y/z all signed (for future work, i.e. smooth scrolling!)
-        auto const x = _pos.x;
-        auto const y = _pos.y;
-        auto const z = 0;
-        textureScheduler().renderTexture({textureInfo, x, y, z, color});
+    auto block = blocks_.begin();
+    for (auto run = blocks_.begin(); run != blocks_.end(); ++run)
+    {
+        if (run == block)
+            continue;
+
+        if (placement(*run) == placement(*block) && block->bottom + 1 == run->top)
+        {
+            block->bottom = run->bottom;
+        }
+        else
+        {
+            renderBlock(*block);
+            block = run;
+        }
     }
+    if (block != blocks_.end())
+        renderBlock(*block);
+
+    blocks_.clear();
 }
 
-optional<ImageRenderer::DataRef> ImageRenderer::getTextureInfo(ImageFragment const& _fragment)
+void ImageRenderer::renderBlock(Block const& _block)
 {
-    auto const key = ImageFragmentKey{
-        _fragment.rasterizedImage().image().id(),
-        _fragment.offset(),
-        _fragment.rasterizedImage().cellSize()
-    };
+    auto const& image = _block.image->image();
+    auto const place = renderer::placement(*_block.image, cellSize_);
 
-    if (optional<DataRef> const info = atlas_->get(key); info.has_value())
+    // The block's pixels relative to the image's top left cell, clipped to the rendered image.
+    auto const left = max(double(_block.left * cellSize_.width), place.x);
+    auto const right = min(double((_block.right + 1) * cellSize_.width), place.x + image.width() * place.scaleX);
+    auto const top = max(double(_block.top * cellSize_.height), place.y);
+    auto const bottom = min(double((_block.bottom + 1) * cellSize_.height), place.y + image.height() * place.scaleY);
+    if (left >= right || top >= bottom)
+        return;
+
+    // The image pixels covering them, widened to whole pixels.
+    auto const imageLeft = max(0, static_cast<int>(floor((left - place.x) / place.scaleX)));
+    auto const imageRight = min(image.width(), static_cast<int>(ceil((right - place.x) / place.scaleX)));
+    auto const imageTop = max(0, static_cast<int>(floor((top - place.y) / place.scaleY)));
+    auto const imageBottom = min(image.height(), static_cast<int>(ceil((bottom - place.y) / place.scaleY)));
+
+    auto const color = array{1.0f, 0.0f, 0.0f, 1.0f}; // not used
+
+    for (int tileTop = imageTop / MaxTileSize * MaxTileSize; tileTop < imageBottom; tileTop += MaxTileSize)
+    {
+        for (int tileLeft = imageLeft / MaxTileSize * MaxTileSize; tileLeft < imageRight; tileLeft += MaxTileSize)
+        {
+            // Tiles at the right and bottom edges of the image may be smaller.
+            auto const key = ImageTileKey{
+                image.id(),
+                Coordinate{tileTop, tileLeft},
+                Size{min(MaxTileSize, image.width() - tileLeft), min(MaxTileSize, image.height() - tileTop)}
+            };
+
+            optional<DataRef> const dataRef = getTextureInfo(_block.image, key);
+            if (!dataRef.has_value())
+                continue;
+
+            atlas::TextureInfo const& textureInfo = std::get<0>(*dataRef).get();
+
+            auto const sourceLeft = max(imageLeft, tileLeft);
+            auto const sourceRight = min(imageRight, tileLeft + key.size.width);
+            auto const sourceTop = max(imageTop, tileTop);
+            auto const sourceBottom = min(imageBottom, tileTop + key.size.height);
+
+            auto const targetLeft = static_cast<int>(lround(place.x + sourceLeft * place.scaleX));
+            auto const targetRight = static_cast<int>(lround(place.x + sourceRight * place.scaleX));
+            auto const targetTop = static_cast<int>(lround(place.y + sourceTop * place.scaleY));
+            auto const targetBottom = static_cast<int>(lround(place.y + sourceBottom * place.scaleY));
+            if (targetLeft >= targetRight || targetTop >= targetBottom)
+                continue;
+
+            // The tile's bitmap starts with its bottom line of pixels.
+            auto const sourceOffset = crispy::Point{
+                sourceLeft - tileLeft,
+                tileTop + key.size.height - sourceBottom
+            };
+            auto const sourceSize = Size{sourceRight - sourceLeft, sourceBottom - sourceTop};
+            auto const targetSize = Size{targetRight - targetLeft, targetBottom - targetTop};
+
+            // TODO: actually make x/y/z all signed (for future work, i.e. smooth scrolling!)
+            auto const x = _block.origin.x + targetLeft;
+            auto const y = _block.origin.y + cellSize_.height - targetBottom;
+            auto const z = 0;
+            textureScheduler().renderTexture({textureInfo, x, y, z, color, sourceOffset, sourceSize, 1.0f, targetSize});
+        }
+    }
+}
+
+optional<ImageRenderer::DataRef> ImageRenderer::getTextureInfo(std::shared_ptr<RasterizedImage const> const& _image,
+                                                                ImageTileKey const& _key)
+{
+    if (optional<DataRef> const info = atlas_->get(_key); info.has_value())
         return info;
 
+    if (rasterizer_)
+    {
+        // The tile is left out until cut, which will cause another render.
+        rasterizer_->request(_key, _image);
+        tilesPending_ = true;
+        return nullopt;
+    }
+
+    return insertTile(_key, ImageRasterizer::cut(_image->image(), _key));
+}
+
+optional<ImageRenderer::DataRef> ImageRenderer::insertTile(ImageTileKey const& _key, Image::Data&& _bitmap)
+{
     auto metadata = Metadata{}; // TODO: do we want/need to fill this?
 
     auto constexpr colored = true;
 
     // FIXME: remember if insertion failed already, don't repeat then? or how to deal with GPU atlas/GPU exhaustion?
 
-    auto handle = atlas_->insert(key,
-                                 _fragment.rasterizedImage().cellSize(),
-                                 cellSize_,
-                                 _fragment.data(),
+    auto handle = atlas_->insert(_key,
+                                 _key.size,
+                                 _key.size,
+                                 move(_bitmap),
                                  colored,
                                  metadata);
 
-    // remember image fragment key so we can later on release the GPU memory when not needed anymore.
+    // remember image tile key so we can later on release the GPU memory when not needed anymore.
     if (handle)
-        imageFragmentsInUse_[_fragment.rasterizedImage().image().id()].emplace_back(key);
+        imageTilesInUse_[_key.imageId].emplace_back(_key);
 
     return handle;
 }
 
 void ImageRenderer::discardImage(Image::Id _imageId)
 {
-    auto const fragmentsIterator = imageFragmentsInUse_.find(_imageId);
-    if (fragmentsIterator != end(imageFragmentsInUse_))
+    auto const tilesIterator = imageTilesInUse_.find(_imageId);
+    if (tilesIterator != end(imageTilesInUse_))
     {
-        auto const& fragments = fragmentsIterator->second;
-        for (ImageFragmentKey const& key : fragments)
+        auto const& tiles = tilesIterator->second;
+        for (ImageTileKey const& key : tiles)
             atlas_->release(key);
 
-        imageFragmentsInUse_.erase(fragmentsIterator);
+        imageTilesInUse_.erase(tilesIterator);
     }
 }
 
+void ImageRenderer::collectMemoryUsage(crispy::memory_usage& _usage) const
+{
+    auto tiles = crispy::hash_table_bytes(imageTilesInUse_) + crispy::allocated_bytes(blocks_);
+    for (auto const& entry: imageTilesInUse_)
+        tiles += crispy::allocated_bytes(entry.second);
+    if (atlas_)
+        tiles += atlas_->memoryUsage();
+    _usage.add("images.tile_metadata", tiles);
+}
+
+void ImageRenderer::collectCacheStats(crispy::cache_statistics& _stats) const
+{
+    if (atlas_)
+        _stats.add("atlas.images", atlas_->stats());
+}
+
+void ImageRenderer::gridMetricsChanged()
+{
+    // Image tiles are cut independent of the cell size, and only rendered scaled differently.
+    blocks_.clear();
+}
+
 void ImageRenderer::clearCache()
 {
-    imageFragmentsInUse_.clear();
+    if (rasterizer_)
+        rasterizer_->clear();
+    imageTilesInUse_.clear();
+    blocks_.clear();
     atlas_ = std::make_unique<TextureAtlas>(renderTarget().coloredAtlasAllocator());
 }
 
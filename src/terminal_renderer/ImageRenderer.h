@@ -14,68 +14,33 @@
 #pragma once
 
 #include <terminal_renderer/Atlas.h>
+#include <terminal_renderer/ImageRasterizer.h>
 #include <terminal_renderer/RenderTarget.h>
 
 #include <terminal/Image.h>
-#include <crispy/FNV.h>
 #include <crispy/point.h>
 #include <crispy/size.h>
 
+#include <functional>
 #include <memory>
 #include <vector>
 #include <unordered_map>
 
-namespace terminal::renderer
-{
-    struct ImageFragmentKey
-    {
-        Image::Id const imageId;
-        Coordinate const offset;
-        crispy::Size const size;
-
-        bool operator==(ImageFragmentKey const& b) const noexcept
-        {
-            return imageId == b.imageId
-                && offset == b.offset
-                && size == b.size;
-        }
-
-        bool operator!=(ImageFragmentKey const& b) const noexcept
-        {
-            return !(*this == b);
-        }
-
-        bool operator<(ImageFragmentKey const& b) const noexcept
-        {
-            return (imageId < b.imageId)
-                || (imageId == b.imageId && offset < b.offset);
-        }
-    };
-}
-
-namespace std
-{
-    template<>
-    struct hash<terminal::renderer::ImageFragmentKey>
-    {
-        constexpr size_t operator()(terminal::renderer::ImageFragmentKey const& _key) const noexcept
-        {
-            using FNV = crispy::FNV<uint64_t>;
-            return FNV{}(FNV{}.basis(),
-                         _key.imageId,
-                         _key.offset.row,
-                         _key.offset.column,
-                         _key.size.width,
-                         _key.size.height);
-        }
-    };
-}
-
 namespace terminal::renderer {
 
 /// Image Rendering API.
 ///
 /// Can render any arbitrary RGBA image (for example Sixel Graphics images).
+///
+/// Images are uploaded in tiles of their original pixels, each only once, and their visible
+/// fragments are rendered as few rectangles as possible, cut out of these tiles.
+///
+/// Scaling and aligning an image to the grid cells it is placed onto, according to its
+/// resize and alignment policies, is left to the render target when rendering these rectangles,
+/// so that changing the cell size (such as on font size or DPI changes) does not require
+/// cutting or uploading any tile again.
+///
+/// Tiles may be cut out of their images on a worker thread, see enableAsyncRasterization().
 class ImageRenderer : public Renderable
 {
   public:
@@ -83,28 +48,66 @@ class ImageRenderer : public Renderable
 
     void setRenderTarget(RenderTarget& _renderTarget) override;
     void clearCache() override;
+    void gridMetricsChanged() override;
 
-    /// Reconfigures the slicing properties of existing images.
+    /// Sets the cell size images are scaled and aligned to when rendered.
     void setCellSize(crispy::Size const& _cellSize);
 
+    /// Cuts tiles missing in the texture atlas on a worker thread.
+    ///
+    /// Until available, frames are rendered without them,
+    /// and @p _ready is invoked from the worker thread to have the frame rendered again.
+    void enableAsyncRasterization(std::function<void()> _ready);
+
+    /// @returns whether the last frame left out tiles that are still being cut.
+    bool tilesPending() const noexcept { return tilesPending_; }
+
+    /// Queues up rendering the given image fragment with its bottom left corner at @p _pos.
+    ///
+    /// Fragments are expected in row-major order and must stay alive until finish().
     void renderImage(crispy::Point _pos, ImageFragment const& _fragment);
 
+    /// Renders all queued up image fragments.
+    void finish();
+
     /// notify underlying cache that this fragment is not going to be rendered anymore, maybe freeing up some GPU caches.
     void discardImage(Image::Id _imageId);
 
+    /// Accounts the memory held by the tile bookkeeping to @p _usage.
+    void collectMemoryUsage(crispy::memory_usage& _usage) const;
+
+    /// Reports the effectiveness of the tile atlas to @p _stats.
+    void collectCacheStats(crispy::cache_statistics& _stats) const;
+
     struct Metadata {}; // TODO: do we want/need anything here?
-    using TextureAtlas = atlas::MetadataTextureAtlas<ImageFragmentKey, Metadata>;
+    using TextureAtlas = atlas::MetadataTextureAtlas<ImageTileKey, Metadata>;
     using DataRef = TextureAtlas::DataRef;
 
   private:
-    std::optional<DataRef> getTextureInfo(ImageFragment const& _fragment);
+    /// Rectangular area of a placed image's cells (in grid offsets into the rasterized image).
+    struct Block {
+        std::shared_ptr<RasterizedImage const> image;
+        crispy::Point origin;           // where the bottom left corner of the image's top left cell is rendered to
+        int top;
+        int bottom;
+        int left;
+        int right;
+    };
+
+    std::optional<DataRef> getTextureInfo(std::shared_ptr<RasterizedImage const> const& _image,
+                                          ImageTileKey const& _key);
+    std::optional<DataRef> insertTile(ImageTileKey const& _key, Image::Data&& _bitmap);
+    void renderBlock(Block const& _block);
 
     // private data
     //
     ImagePool imagePool_;
-    std::unordered_map<Image::Id, std::vector<ImageFragmentKey>> imageFragmentsInUse_; // remember each fragment key per image for proper GPU texture GC.
+    std::unordered_map<Image::Id, std::vector<ImageTileKey>> imageTilesInUse_; // remember each tile key per image for proper GPU texture GC.
     crispy::Size cellSize_;
     std::unique_ptr<TextureAtlas> atlas_;
+    std::vector<Block> blocks_;         // horizontal runs of the current frame, merged vertically by finish()
+    std::unique_ptr<ImageRasterizer> rasterizer_;
+    bool tilesPending_ = false;
 };
 
 }
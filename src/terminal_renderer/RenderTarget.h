@@ -14,18 +14,26 @@
 #pragma once
 
 #include <terminal_renderer/Atlas.h>
+#include <terminal_renderer/Decorator.h>
 #include <terminal_renderer/GridMetrics.h>
 
 #include <terminal/Color.h>
 #include <terminal/Grid.h> // cell attribs
+#include <terminal/RenderBuffer.h>
 
+#include <crispy/memory_usage.h>
 #include <crispy/size.h>
 #include <crispy/stdfs.h>
 
 #include <unicode/utf8.h>
 
 #include <array>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace terminal::renderer {
 
@@ -37,6 +45,34 @@ struct AtlasTextureInfo {
     atlas::Buffer buffer;
 };
 
+/// Area of the render target, in pixels counted from its bottom left corner.
+///
+/// Spans the full width unless given otherwise, e.g. when only the cursor changed.
+struct DamagedArea {
+    int y;
+    int height;
+    int x = 0;
+    int width = std::numeric_limits<int>::max();
+};
+
+/// A single grid cell as resolved by the render target's cell grid pass.
+///
+/// @see RenderTarget::renderGrid()
+struct GridCell {
+    RGBAColor background{};                         // with an alpha of zero for the default background
+    RGBAColor foreground{};                         // glyph color, ignored for colored glyphs
+    atlas::TextureInfo const* glyph = nullptr;      // glyph to draw into this cell, if any
+    crispy::Point glyphOffset{};                    // glyph's bottom left corner relative to the cell's
+    RGBColor decorationColor{};
+    uint16_t decorators = 0;                        // decorators drawn on top, one bit per Decorator value
+
+    // Palette slots the colors above have been resolved from, see RenderTarget::setPalette().
+    PaletteSlot backgroundSlot = PaletteSlot::None;
+    PaletteSlot foregroundSlot = PaletteSlot::None;
+    PaletteSlot decorationSlot = PaletteSlot::None;
+    bool faint = false;                             // foreground and decoration shown at half brightness
+};
+
 /**
  * Terminal render target interface.
  *
@@ -68,13 +104,88 @@ class RenderTarget
     virtual void renderRectangle(int _x, int _y, int _width, int _height,
                                  float _r, float _g, float _b, float _a) = 0;
 
+    /// Renders the given decoration across @p _width pixels of a single grid line,
+    /// with @p _x and @p _y being the bottom left corner of its first cell.
+    ///
+    /// The decoration's pattern repeats every grid cell and is derived from @p _gridMetrics.
+    virtual void renderDecoration(Decorator _decorator, int _x, int _y, int _width,
+                                  GridMetrics const& _gridMetrics, RGBColor const& _color) = 0;
+
+    /// Restricts the next execute() to the given area, which is cleared before drawing into it.
+    ///
+    /// All pixels outside of it keep what earlier frames have rendered there.
+    /// With std::nullopt (the default), the whole render target is cleared and redrawn.
+    virtual void setDamagedArea(std::optional<DamagedArea> _area) = 0;
+
+    /// Moves the pixels rendered by earlier frames within the full-width band of @p _area
+    /// by @p _offset pixels upwards (downwards if negative), e.g. when scrolling.
+    ///
+    /// Pixels moved in from outside the band are undefined, and must be rendered again.
+    /// Applies immediately, so it must be invoked before scheduling anything for the next execute().
+    ///
+    /// @retval false moving pixels is not supported, and the whole band must be rendered again.
+    virtual bool scrollArea(DamagedArea const& _area, int _offset) = 0;
+
+    /// Has monochrome glyphs rendered from signed distance fields (see text::render_mode::sdf)
+    /// rather than coverage masks, so that they can be scaled (see atlas::RenderTexture::scale).
+    ///
+    /// @retval false distance fields are not supported, and monochrome glyphs must be coverage masks.
+    virtual bool setDistanceFieldGlyphs(bool _enabled) = 0;
+
+    /// @returns whether or not renderGrid() is supported by this render target.
+    virtual bool supportsCellGrid() const noexcept = 0;
+
+    /// Renders the grid lines @p _firstRow to @p _lastRow from the given cells in a single pass,
+    /// on top of rectangles but beneath textures.
+    ///
+    /// Each cell's background, glyph and decorations are drawn in that order,
+    /// with decorations following the same patterns as renderDecoration().
+    ///
+    /// @p _cells holds the cells of all these lines in row-major order.
+    /// A cell's glyph may overflow into its left and right neighbor but must not
+    /// exceed the cell vertically.
+    virtual void renderGrid(GridMetrics const& _gridMetrics,
+                            int _firstRow,
+                            int _lastRow,
+                            std::vector<GridCell> const& _cells) = 0;
+
+    /// Sets the palette the cell grid's palette slots refer to, see GridCell.
+    ///
+    /// Render targets resolving the palette slots of the cell grid on their own (e.g. on the GPU)
+    /// only need to have the palette updated when it changes, while the cells' colors themselves
+    /// stay the same. All others use the cells' colors as they are.
+    virtual void setPalette(RenderPalette const& _palette) = 0;
+
     using ScreenshotCallback = std::function<void(std::vector<uint8_t> const& /*_rgbaBuffer*/, crispy::Size /*_pixelSize*/)>;
+
+    /// Captures the framebuffer as rendered by the next execute().
+    ///
+    /// The callback may be invoked later on and from another thread, so it must not touch
+    /// anything owned by the render thread.
     virtual void scheduleScreenshot(ScreenshotCallback _callback) = 0;
 
+    /// @returns whether or not screenshots are still being captured, to be picked up by a later frame.
+    virtual bool screenshotsPending() const noexcept = 0;
+
     virtual void execute() = 0;
 
+    /// @returns whether or not textures scheduled for upload were held back by the last execute(),
+    ///          leaving out everything rendered with them. Another frame must follow to render them.
+    virtual bool uploadsPending() const noexcept = 0;
+
+    /// @returns a human readable summary of the time spent in the render passes of execute().
+    virtual std::string renderStats() const = 0;
+
+    /// Accounts the memory held by the render target, such as atlas textures and vertex buffers,
+    /// to @p _usage.
+    virtual void collectMemoryUsage(crispy::memory_usage& _usage) const = 0;
+
     virtual void clearCache() = 0;
 
+    /// Gives back memory held beyond what the current frame needs, such as per-frame buffers
+    /// grown by a larger frame and atlas textures left unused by clearCache().
+    virtual void trimMemory() = 0;
+
     virtual std::optional<AtlasTextureInfo> readAtlas(atlas::TextureAtlasAllocator const& _allocator, atlas::AtlasID _instanceId) = 0;
 };
 
@@ -83,6 +194,14 @@ class Renderable {
     virtual ~Renderable() = default;
 
     virtual void clearCache() {}
+
+    /// Gives back memory of scratch buffers held beyond their typical size, see Renderer::trimMemory().
+    virtual void trimMemory() {}
+
+    /// Invoked after the grid metrics changed while the texture atlases were kept,
+    /// e.g. when changing the font size, to release whatever depends on the cell size.
+    virtual void gridMetricsChanged() { clearCache(); }
+
     virtual void setRenderTarget(RenderTarget& _renderTarget) { renderTarget_ = &_renderTarget; }
     RenderTarget& renderTarget() { return *renderTarget_; }
     constexpr bool renderTargetAvailable() const noexcept { return renderTarget_; }
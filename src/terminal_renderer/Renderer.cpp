@@ -12,16 +12,20 @@
  * limitations under the License.
  */
 #include <terminal_renderer/Renderer.h>
+#include <terminal_renderer/SharedTextShaper.h>
 #include <terminal_renderer/TextRenderer.h>
 
-#include <text_shaper/open_shaper.h>
-#include <text_shaper/directwrite_shaper.h>
-
 #include <crispy/debuglog.h>
+#include <crispy/profiler.h>
+#include <crispy/thread_pool.h>
 
+#include <algorithm>
 #include <array>
 #include <functional>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <thread>
 
 using crispy::Size;
 using std::array;
@@ -30,9 +34,12 @@ using std::chrono::steady_clock;
 using std::make_unique;
 using std::move;
 using std::nullopt;
+using std::numeric_limits;
 using std::optional;
+using std::pair;
 using std::reference_wrapper;
-using std::tuple;
+using std::string;
+using std::string_view;
 using std::unique_ptr;
 using std::vector;
 
@@ -62,39 +69,22 @@ GridMetrics loadGridMetrics(text::font_key _font, Size _pageSize, text::shaper&
     return gm;
 }
 
-FontKeys loadFontKeys(FontDescriptions const& _fd, text::shaper& _shaper)
-{
-    FontKeys output{};
-
-    output.regular = _shaper.load_font(_fd.regular, _fd.size).value_or(text::font_key{});
-    output.bold = _shaper.load_font(_fd.bold, _fd.size).value_or(text::font_key{});
-    output.italic = _shaper.load_font(_fd.italic, _fd.size).value_or(text::font_key{});
-    output.boldItalic = _shaper.load_font(_fd.boldItalic, _fd.size).value_or(text::font_key{});
-    output.emoji = _shaper.load_font(_fd.emoji, _fd.size).value_or(text::font_key{});
-
-    return output;
-}
-
 Renderer::Renderer(Size _screenSize,
                    FontDescriptions const& _fontDescriptions,
                    terminal::ColorPalette const& _colorPalette,
                    terminal::Opacity _backgroundOpacity,
                    Decorator _hyperlinkNormal,
                    Decorator _hyperlinkHover):
-    textShaper_{
-        #if defined(_WIN32)
-        make_unique<text::directwrite_shaper>(_fontDescriptions.dpi)
-        #else
-        make_unique<text::open_shaper>(_fontDescriptions.dpi)
-        #endif
-    },
+    textShaper_{ make_unique<SharedTextShaper>(_fontDescriptions.dpi) },
     fontDescriptions_{ _fontDescriptions },
-    fonts_{ loadFontKeys(fontDescriptions_, *textShaper_) },
-    gridMetrics_{ loadGridMetrics(fonts_.regular, _screenSize, *textShaper_) },
+    fonts_{ fontDescriptions_, *textShaper_ },
+    gridMetrics_{ loadGridMetrics(fonts_.regular(), _screenSize, *textShaper_) },
     backgroundOpacity_{ _backgroundOpacity },
+    colorPalette_{ _colorPalette },
     backgroundRenderer_{ gridMetrics_, _colorPalette.defaultBackground },
+    gridRenderer_{ gridMetrics_, _colorPalette.defaultBackground },
     imageRenderer_{ cellSize() },
-    textRenderer_{ gridMetrics_, *textShaper_, fontDescriptions_, fonts_ },
+    textRenderer_{ gridMetrics_, *textShaper_, fontDescriptions_, fonts_, gridRenderer_ },
     decorationRenderer_{ gridMetrics_, _hyperlinkNormal, _hyperlinkHover },
     cursorRenderer_{ gridMetrics_, CursorShape::Block, _colorPalette.cursor }
 {
@@ -104,6 +94,8 @@ void Renderer::setRenderTarget(RenderTarget& _renderTarget)
 {
     renderTarget_ = &_renderTarget;
     Renderable::setRenderTarget(_renderTarget);
+    fullRedraw_ = true;
+    renderedPaletteVersion_ = 0;
 
     for (reference_wrapper<Renderable>& renderable: renderables())
         renderable.get().setRenderTarget(_renderTarget);
@@ -127,12 +119,26 @@ void Renderer::executeImageDiscards()
     discardImageQueue_.clear();
 }
 
+void Renderer::trimMemory()
+{
+    if (!renderTargetAvailable())
+        return;
+
+    for (auto& renderable: renderables())
+        renderable.get().trimMemory();
+    renderTarget().trimMemory();
+
+    auto _l = scoped_lock{imageDiscardLock_};
+    discardImageQueue_.shrink_to_fit();
+}
+
 void Renderer::clearCache()
 {
     if (!renderTargetAvailable())
         return;
 
     renderTarget().clearCache();
+    fullRedraw_ = true;
 
     // TODO(?): below functions are actually doing the same again and again and again. delete them (and their functions for that)
     // either that, or only the render target is allowed to clear the actual atlas caches.
@@ -145,7 +151,7 @@ void Renderer::setFonts(FontDescriptions _fontDescriptions)
     textShaper_->clear_cache();
     textShaper_->set_dpi(_fontDescriptions.dpi);
     fontDescriptions_ = move(_fontDescriptions);
-    fonts_ = loadFontKeys(fontDescriptions_, *textShaper_);
+    fonts_.reload();
     updateFontMetrics();
 }
 
@@ -158,15 +164,42 @@ bool Renderer::setFontSize(text::font_size _fontSize)
         return false;
 
     fontDescriptions_.size = _fontSize;
-    fonts_ = loadFontKeys(fontDescriptions_, *textShaper_);
-    updateFontMetrics();
+    fonts_.reload();
+    gridMetricsChanged();
+    return true;
+}
 
+bool Renderer::setDpi(crispy::Point _dpi)
+{
+    if (_dpi == crispy::Point{} || _dpi == fontDescriptions_.dpi)
+        return false;
+
+    // The fonts of the previous DPI remain loaded, see SharedTextShaper.
+    textShaper_->set_dpi(_dpi);
+    fontDescriptions_.dpi = _dpi;
+    fonts_.reload();
+    gridMetricsChanged();
     return true;
 }
 
+void Renderer::gridMetricsChanged()
+{
+    // Unlike updateFontMetrics(), the texture atlases are kept,
+    // so that zooming back to a recently used font size (or DPI) needs no rasterization.
+    gridMetrics_ = loadGridMetrics(fonts_.regular(), gridMetrics_.pageSize, *textShaper_);
+    imageRenderer_.setCellSize(cellSize());
+
+    if (renderTargetAvailable())
+    {
+        fullRedraw_ = true;
+        for (auto& renderable: renderables())
+            renderable.get().gridMetricsChanged();
+    }
+}
+
 void Renderer::updateFontMetrics()
 {
-    gridMetrics_ = loadGridMetrics(fonts_.regular, gridMetrics_.pageSize, *textShaper_);
+    gridMetrics_ = loadGridMetrics(fonts_.regular(), gridMetrics_.pageSize, *textShaper_);
 
     textRenderer_.updateFontMetrics();
     imageRenderer_.setCellSize(cellSize());
@@ -180,61 +213,233 @@ void Renderer::setRenderSize(Size _size)
         return;
 
     renderTarget().setRenderSize(_size);
+    fullRedraw_ = true;
 }
 
 void Renderer::setBackgroundOpacity(terminal::Opacity _opacity)
 {
     backgroundOpacity_ = _opacity;
+    fullRedraw_ = true;
+}
+
+void Renderer::setDegradationLevel(Terminal& _terminal, DegradationLevel _level)
+{
+    auto const previous = degradationLevel_.exchange(_level);
+    if (_level == previous)
+        return;
+
+    textRenderer_.setDegradationLevel(_level);
+    _terminal.setHyperlinkHoverEnabled(_level < DegradationLevel::NoDecorations);
+
+    // What is already on screen has been rendered with other features.
+    auto const changed = [&](DegradationLevel _threshold) { return (previous >= _threshold) != (_level >= _threshold); };
+    if (changed(DegradationLevel::SimpleShaping) || changed(DegradationLevel::NoDecorations))
+        fullRedraw_ = true;
 }
 
 uint64_t Renderer::render(Terminal& _terminal,
                           steady_clock::time_point _now,
-                          bool _pressure)
+                          steady_clock::time_point _lastInput)
 {
+    CRISPY_PROFILE_ZONE("Renderer::render");
+    auto const buildStart = steady_clock::now();
     gridMetrics_.pageSize = _terminal.screenSize();
 
+    degradation_.setRefreshRate(refreshRate_.load());
+    setDegradationLevel(_terminal, degradation_.level(_now, _lastInput));
+
     auto const changes = _terminal.tick(_now);
 
+    #if !defined(LIBTERMINAL_PASSIVE_RENDER_BUFFER_UPDATE) // {{{
+    // Windows 10 (ConPTY) workaround. ConPTY can't handle non-blocking I/O,
+    // so we have to explicitly refresh the render buffer
+    // from within the render (reader) thread instead ofthe terminal (writer) thread.
+    _terminal.refreshRenderBuffer(_now);
+    #endif // }}}
+
+    // Refreshing the render buffer is accounted on its own, so only what follows counts as rendering.
+    auto const _a = _terminal.allocationTrace().scope(AllocationPhase::Render);
+
+    // Each stage is timed from the end of the previous one, costing a single clock read per stage.
+    auto stageStart = steady_clock::now();
+    auto const stageDone = [&](RenderStage _stage) {
+        auto const now = steady_clock::now();
+        stageTime_[static_cast<size_t>(_stage)].record(now - stageStart);
+        stageStart = now;
+    };
+
     {
-        #if !defined(LIBTERMINAL_PASSIVE_RENDER_BUFFER_UPDATE) // {{{
-        // Windows 10 (ConPTY) workaround. ConPTY can't handle non-blocking I/O,
-        // so we have to explicitly refresh the render buffer
-        // from within the render (reader) thread instead ofthe terminal (writer) thread.
-        _terminal.refreshRenderBuffer(_now);
-        #endif // }}}
-
-        auto const pressure = _pressure && _terminal.screen().isPrimaryScreen();
         RenderBufferRef const renderBuffer = _terminal.renderBuffer();
         auto const& cursorOpt = renderBuffer.get().cursor;
 
+        // The same frame may be rendered more than once, but its output is only new the first time.
+        auto const outputTime = renderBuffer.get().outputTime;
+        renderedOutputTime_ = outputTime != lastOutputTime_ ? outputTime : steady_clock::time_point{};
+        lastOutputTime_ = outputTime;
+
+        for (atlas::TextureAtlasAllocator* allocator: renderTarget().allAtlasAllocators())
+            allocator->nextFrame();
+
+        // The cells' colors have been recolored along with the palette,
+        // so that only render targets resolving their palette slots need to know.
+        if (auto const paletteVersion = renderBuffer.get().paletteVersion; paletteVersion != renderedPaletteVersion_)
+        {
+            renderTarget().setPalette(renderBuffer.get().palette);
+            renderedPaletteVersion_ = paletteVersion;
+        }
+
         executeImageDiscards();
+        if (memoryTrimRequested_.exchange(false))
+            trimMemory();
+        stageDone(RenderStage::ImageDiscards);
+
         textRenderer_.start();
-        textRenderer_.setPressure(pressure);
-        renderCells(renderBuffer.get().screen);
+
+        // Only the rows that changed are rendered again,
+        // all other pixels are kept by the render target as they were.
+        auto fullRedraw = std::exchange(fullRedraw_, false)
+            || renderBuffer.get().rowVersions.size() != renderedRowVersions_.size();
+        auto damage = damagedArea(renderBuffer.get(), fullRedraw);
+
+        // Rows moved by scrolling are moved within the render target rather than rendered again.
+        if (damage.movedRows != 0)
+        {
+            auto const rowCount = static_cast<int>(renderBuffer.get().rowVersions.size());
+            auto const gridArea = DamagedArea{
+                gridMetrics_.map(Coordinate{rowCount, 1}).y,
+                rowCount * gridMetrics_.cellSize.height
+            };
+            if (!renderTarget().scrollArea(gridArea, damage.movedRows * gridMetrics_.cellSize.height))
+            {
+                fullRedraw = true;
+                damage = Damage{1, rowCount, nullopt};
+            }
+        }
+
+        auto const firstRow = damage.firstRow;
+        auto const lastRow = damage.lastRow;
+        if (fullRedraw)
+            renderTarget().setDamagedArea(nullopt);
+        else if (firstRow <= lastRow)
+        {
+            auto area = DamagedArea{
+                gridMetrics_.map(Coordinate{lastRow, 1}).y,
+                (lastRow - firstRow + 1) * gridMetrics_.cellSize.height
+            };
+            // A blinking or moving cursor alone only redraws its cells.
+            if (damage.columns)
+            {
+                area.x = gridMetrics_.map(Coordinate{firstRow, damage.columns->first}).x;
+                area.width = (damage.columns->second - damage.columns->first + 1) * gridMetrics_.cellSize.width;
+            }
+            renderTarget().setDamagedArea(area);
+        }
+        else
+            renderTarget().setDamagedArea(DamagedArea{0, 0});
+
+        gridRenderer_.start(firstRow, lastRow);
+        stageDone(RenderStage::Damage);
+
+        renderCells(renderBuffer.get(), damage);
+        stageDone(RenderStage::Cells);
+
+        backgroundRenderer_.finish();
+        stageDone(RenderStage::Backgrounds);
+        decorationRenderer_.finish();
+        stageDone(RenderStage::Decorations);
+        imageRenderer_.finish();
+        stageDone(RenderStage::Images);
         textRenderer_.finish();
+        stageDone(RenderStage::Text);
+        gridRenderer_.finish();
+        stageDone(RenderStage::Grid);
+
+        renderSelection(renderBuffer.get(), firstRow, lastRow);
+        stageDone(RenderStage::Selection);
+
+        // Rows with glyphs or image tiles still being rasterized must be rendered again once they are available.
+        if (textRenderer_.glyphsPending() || imageRenderer_.tilesPending())
+            fullRedraw_ = true;
 
-        if (cursorOpt)
+        if (cursorOpt && firstRow <= cursorOpt->position.row && cursorOpt->position.row <= lastRow)
         {
             auto const& cursor = *cursorOpt;
             cursorRenderer_.setShape(cursor.shape);
             cursorRenderer_.render(gridMetrics_.map(cursor.position), cursor.width);
         }
+        stageDone(RenderStage::Cursor);
     }
 
+    // Full-screen applications on the alternate screen redraw rather than scroll,
+    // so their output is not considered a flood.
+    auto const buildTime = steady_clock::now() - buildStart;
+    buildTime_.record(buildTime);
+    degradation_.record(buildTime, _terminal.throughputMode() && _terminal.screen().isPrimaryScreen());
+
+    stageStart = steady_clock::now();
     renderTarget().execute();
+    stageDone(RenderStage::Execute);
+
+    // What was left out for the lack of its textures needs to be rendered again.
+    if (renderTarget().uploadsPending())
+        fullRedraw_ = true;
+
+    _terminal.latencyTrace().record(LatencyStage::Painted, renderedOutputTime_, steady_clock::now());
 
     return changes;
 }
 
-tuple<RGBColor, RGBColor> makeColors(ColorPalette const& _colorPalette, Cell const& _cell, bool _reverseVideo, bool _selected)
+string Renderer::renderStats() const
 {
-    auto const [fg, bg] = _cell.attributes().makeColors(_colorPalette, _reverseVideo);
-    if (!_selected)
-        return tuple{fg, bg};
+    auto const formatDuration = [](crispy::latency_histogram::duration _value) {
+        return fmt::format("{:.3f}ms", static_cast<double>(_value.count()) / 1000.0);
+    };
+    auto const formatRow = [&](string_view _name, crispy::latency_histogram const& _histogram) {
+        return fmt::format("{:<16} {:>10} {:>10} {:>10} {:>10}\n",
+                           _name,
+                           _histogram.count(),
+                           formatDuration(_histogram.percentile(50)),
+                           formatDuration(_histogram.percentile(99)),
+                           formatDuration(_histogram.max()));
+    };
+    auto out = fmt::format("{:<16} {:>10} {:>10} {:>10} {:>10}\n", "stage", "samples", "cpu p50", "cpu p99", "cpu max");
+    out += formatRow("build", buildTime_);
+    for (size_t i = 0; i < RenderStageCount; ++i)
+        out += formatRow(fmt::format("  {}", to_string(static_cast<RenderStage>(i))), stageTime_[i]);
+    out += '\n';
+    out += fmt::format("degradation: {}\n\n", degradationLevel_.load());
+    if (renderTarget_)
+        out += renderTarget_->renderStats();
+    return out;
+}
+
+string Renderer::statsJson() const
+{
+    auto caches = crispy::cache_statistics{};
+    collectCacheStats(caches);
+    auto stages = string();
+    for (size_t i = 0; i < RenderStageCount; ++i)
+        stages += fmt::format("{}\"{}\": {}", i ? ", " : "", to_string(static_cast<RenderStage>(i)), stageTime_[i].json());
+    return fmt::format("{{\"frame_build\": {}, \"stages\": {{{}}}, \"degradation\": \"{}\", "
+                       "\"caches\": {}}}",
+                       buildTime_.json(),
+                       stages,
+                       degradationLevel_.load(),
+                       caches.json());
+}
 
-    auto const a = _colorPalette.selectionForeground.value_or(bg);
-    auto const b = _colorPalette.selectionBackground.value_or(fg);
-    return tuple{a, b};
+void Renderer::collectMemoryUsage(crispy::memory_usage& _usage) const
+{
+    textRenderer_.collectMemoryUsage(_usage);
+    imageRenderer_.collectMemoryUsage(_usage);
+    if (renderTarget_)
+        renderTarget_->collectMemoryUsage(_usage);
+}
+
+void Renderer::collectCacheStats(crispy::cache_statistics& _stats) const
+{
+    textRenderer_.collectCacheStats(_stats);
+    imageRenderer_.collectCacheStats(_stats);
 }
 
 constexpr CellFlags toCellStyle(Decorator _decorator)
@@ -254,16 +459,250 @@ constexpr CellFlags toCellStyle(Decorator _decorator)
     return CellFlags{};
 }
 
-void Renderer::renderCells(vector<RenderCell> const& _renderableCells)
+Renderer::Damage Renderer::damagedArea(RenderBuffer const& _renderBuffer, bool _fullRedraw)
+{
+    auto const& rowVersions = _renderBuffer.rowVersions;
+    auto const rowCount = static_cast<int>(rowVersions.size());
+
+    auto firstRow = rowCount + 1;
+    auto lastRow = 0;
+    auto const damage = [&](int _row) {
+        if (1 <= _row && _row <= rowCount)
+        {
+            firstRow = std::min(firstRow, _row);
+            lastRow = std::max(lastRow, _row);
+        }
+    };
+
+    // Rows keep their version when moved by scrolling, telling by how many rows the first one moved.
+    auto const movedRows = [&]() -> int {
+        if (_fullRedraw || rowCount == 0 || rowVersions[0] == renderedRowVersions_[0])
+            return 0;
+        for (int i = 1; i < rowCount; ++i)
+        {
+            if (renderedRowVersions_[static_cast<size_t>(i)] == rowVersions[0])
+                return i;
+            if (rowVersions[static_cast<size_t>(i)] == renderedRowVersions_[0])
+                return -i;
+        }
+        return 0;
+    }();
+
+    if (!_fullRedraw)
+        for (int row = 1; row <= rowCount; ++row)
+            if (auto const renderedRow = row + movedRows;
+                    renderedRow < 1 || renderedRow > rowCount
+                    || rowVersions[row - 1] != renderedRowVersions_[renderedRow - 1])
+                damage(row);
+    auto const contentChanged = firstRow <= lastRow;
+
+    // The cursor is painted on top of the cells, so both, its old and new row, need to be redrawn.
+    auto const& cursor = _renderBuffer.cursor;
+    auto const cursorChanged = movedRows != 0
+        || cursor.has_value() != renderedCursor_.has_value()
+        || (cursor.has_value() && (cursor->position != renderedCursor_->position
+                                   || cursor->shape != renderedCursor_->shape
+                                   || cursor->width != renderedCursor_->width));
+    auto firstColumn = numeric_limits<int>::max();
+    auto lastColumn = 0;
+    auto const damageCursor = [&](optional<terminal::RenderCursor> const& _cursor) {
+        if (!_cursor.has_value())
+            return;
+        damage(_cursor->position.row);
+        firstColumn = std::min(firstColumn, _cursor->position.column);
+        lastColumn = std::max(lastColumn, _cursor->position.column + std::max(_cursor->width, 1) - 1);
+    };
+    if (cursorChanged)
+    {
+        // The previously rendered cursor has been moved along with its row.
+        auto movedCursor = renderedCursor_;
+        if (movedCursor)
+            movedCursor->position.row -= movedRows;
+        damageCursor(cursor);
+        damageCursor(movedCursor);
+    }
+
+    // The selection is painted on top of the cells as well, so rows whose selected columns
+    // changed are redrawn, from their cached glyphs, without the row having been rendered again.
+    auto const& selection = _renderBuffer.selection;
+    auto selectionChanged = false;
+    auto const damageSelection = [&](vector<terminal::RenderSelection> const& _spans,
+                                     vector<terminal::RenderSelection> const& _otherSpans,
+                                     int _rowOffset) {
+        for (terminal::RenderSelection span: _spans)
+        {
+            auto const row = span.row;
+            span.row += _rowOffset;
+            if (std::find(_otherSpans.begin(), _otherSpans.end(), span) == _otherSpans.end())
+            {
+                damage(row);
+                selectionChanged = true;
+            }
+        }
+    };
+    damageSelection(selection, renderedSelection_, movedRows);
+    damageSelection(renderedSelection_, selection, -movedRows);
+
+    renderedRowVersions_ = rowVersions;
+    renderedCursor_ = cursor;
+    renderedSelection_ = selection;
+
+    if (_fullRedraw)
+        return {1, rowCount, nullopt};
+
+    // Only the cursor's cells need to be redrawn if nothing else changed, e.g. when it blinks.
+    if (cursorChanged && !contentChanged && !selectionChanged && movedRows == 0 && firstRow == lastRow)
+        return {firstRow, lastRow, pair{firstColumn, lastColumn}};
+
+    return {firstRow, lastRow, nullopt, movedRows};
+}
+
+void Renderer::renderSelection(RenderBuffer const& _renderBuffer, int _firstRow, int _lastRow)
+{
+    // The selection is blended in rather than replacing the cells' colors, so their text stays readable.
+    auto constexpr SelectionOpacity = 0.5f;
+
+    auto const color = colorPalette_.selectionBackground.value_or(colorPalette_.defaultForeground);
+    auto const columnCount = gridMetrics_.pageSize.width;
+    for (terminal::RenderSelection const& span: _renderBuffer.selection)
+    {
+        if (span.row < _firstRow || span.row > _lastRow)
+            continue;
+
+        auto const firstColumn = std::max(span.firstColumn, 1);
+        auto const lastColumn = std::min(span.lastColumn, columnCount);
+        if (firstColumn > lastColumn)
+            continue;
+
+        // The rectangle's origin is the bottom left corner.
+        auto const pos = gridMetrics_.map(Coordinate{span.row, firstColumn});
+        renderTarget().renderRectangle(
+            pos.x,
+            pos.y,
+            gridMetrics_.cellSize.width * (lastColumn - firstColumn + 1),
+            gridMetrics_.cellSize.height,
+            static_cast<float>(color.red) / 255.0f,
+            static_cast<float>(color.green) / 255.0f,
+            static_cast<float>(color.blue) / 255.0f,
+            SelectionOpacity
+        );
+    }
+}
+
+void Renderer::renderCells(RenderBuffer const& _renderBuffer, Damage const& _damage)
 {
-    for (RenderCell const& cell: _renderableCells)
+    CRISPY_PROFILE_ZONE("Renderer::renderCells");
+    CRISPY_PROFILE_COUNTER("cells rendered",
+                           std::count_if(_renderBuffer.screen.begin(), _renderBuffer.screen.end(), [&](RenderCell const& _cell) {
+                               return _damage.firstRow <= _cell.position.row && _cell.position.row <= _damage.lastRow;
+                           }));
+
+    // The text of rows that did not change since they were rendered the last time
+    // is rendered from the glyph positions cached back then, without shaping it again.
+    auto row = 0;
+    auto textCached = false;
+
+    // When only the cursor's cells are redrawn, the render target clips everything to them.
+    // Cells next to them are still rendered, as their glyphs may overflow into the cursor's cells,
+    // and so are all of the row's text and grid cells, being cached and passed on per row.
+    auto constexpr OverflowColumns = 2;
+    auto const firstColumn = _damage.columns ? _damage.columns->first - OverflowColumns : 1;
+    auto const lastColumn = _damage.columns ? _damage.columns->second + OverflowColumns : numeric_limits<int>::max();
+
+    auto const decorations = degradationLevel_.load() < DegradationLevel::NoDecorations;
+
+    if (gridRenderer_.active())
+        renderGridCells(_renderBuffer, _damage, decorations);
+    else
     {
-        backgroundRenderer_.renderCell(cell);
-        decorationRenderer_.renderCell(cell);
-        textRenderer_.renderCell(cell);
-        if (cell.image.has_value())
+        CRISPY_PROFILE_ZONE("Renderer::renderRuns");
+        // Backgrounds and decorations only depend on the cells' attributes,
+        // and thus are rendered per run of cells sharing them.
+        for (RenderRun const& run: _renderBuffer.runs)
+        {
+            // Runs are ordered by row.
+            if (run.position.row < _damage.firstRow)
+                continue;
+            if (run.position.row > _damage.lastRow)
+                break;
+
+            auto const left = std::max(run.position.column, firstColumn);
+            auto const right = std::min(run.position.column + static_cast<int>(run.cellCount) - 1, lastColumn);
+            if (left > right)
+                continue;
+
+            auto clipped = run;
+            clipped.position.column = left;
+            clipped.cellCount = static_cast<uint32_t>(right - left + 1);
+            backgroundRenderer_.renderRun(clipped);
+            if (decorations)
+                decorationRenderer_.renderRun(clipped);
+        }
+    }
+
+    // Text not shaped yet, e.g. as the fonts changed, is shaped ahead for all rows at once.
+    textRenderer_.prefetchShaping(_renderBuffer, _damage.firstRow, _damage.lastRow);
+
+    for (RenderCell const& cell: _renderBuffer.screen)
+    {
+        // Cells are ordered by row.
+        if (cell.position.row < _damage.firstRow)
+            continue;
+        if (cell.position.row > _damage.lastRow)
+            break;
+
+        if (cell.position.row != row)
+        {
+            if (row)
+                textRenderer_.finishRow();
+            row = cell.position.row;
+            textCached = textRenderer_.startRow(row, _renderBuffer.rowVersions.at(static_cast<size_t>(row - 1)));
+        }
+
+        auto const clipped = cell.position.column < firstColumn || cell.position.column > lastColumn;
+        if (!textCached)
+            textRenderer_.renderCell(cell, _renderBuffer.codepointsOf(cell));
+        if (cell.image.has_value() && !clipped)
             imageRenderer_.renderImage(gridMetrics_.map(cell.position), *cell.image);
     }
+
+    if (row)
+        textRenderer_.finishRow();
+}
+
+void Renderer::renderGridCells(RenderBuffer const& _renderBuffer, Damage const& _damage, bool _decorations)
+{
+    CRISPY_PROFILE_ZONE("Renderer::renderGridCells");
+
+    // Cells worth handing to another thread, and the least of them for doing so at all.
+    auto constexpr MinBandCells = size_t{4096};
+    auto constexpr MinParallelCells = 4 * MinBandCells;
+
+    // Cells are ordered by row.
+    auto const& screen = _renderBuffer.screen;
+    auto const first = std::lower_bound(screen.begin(), screen.end(), _damage.firstRow,
+                                        [](RenderCell const& _cell, int _row) { return _cell.position.row < _row; });
+    auto const last = std::lower_bound(first, screen.end(), _damage.lastRow + 1,
+                                       [](RenderCell const& _cell, int _row) { return _cell.position.row < _row; });
+    auto const cellCount = static_cast<size_t>(std::distance(first, last));
+
+    if (cellCount < MinParallelCells || std::thread::hardware_concurrency() < 2)
+    {
+        for (auto cell = first; cell != last; ++cell)
+            gridRenderer_.renderCell(*cell, _decorations);
+        return;
+    }
+
+    // Each band writes to the grid cells of its own rows only, so that they need no locking.
+    auto& pool = crispy::thread_pool::shared();
+    auto const bandCount = std::min(pool.thread_count() + 1, cellCount / MinBandCells);
+    auto const bandSize = (cellCount + bandCount - 1) / bandCount;
+    pool.parallel_for(bandCount, [&](size_t _band) {
+        auto const begin = first + static_cast<ptrdiff_t>(_band * bandSize);
+        auto const end = first + static_cast<ptrdiff_t>(std::min(cellCount, (_band + 1) * bandSize));
+        for (auto cell = begin; cell != end; ++cell)
+            gridRenderer_.renderCell(*cell, _decorations);
+    });
 }
 
 optional<RenderCursor> Renderer::renderCursor(Terminal const& _terminal)
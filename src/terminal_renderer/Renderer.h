@@ -19,23 +19,68 @@
 #include <terminal_renderer/BackgroundRenderer.h>
 #include <terminal_renderer/CursorRenderer.h>
 #include <terminal_renderer/DecorationRenderer.h>
+#include <terminal_renderer/DegradationPolicy.h>
+#include <terminal_renderer/GridRenderer.h>
 #include <terminal_renderer/ImageRenderer.h>
 #include <terminal_renderer/TextRenderer.h>
 
 #include <terminal/Image.h>
 #include <terminal/Terminal.h>
 
+#include <crispy/cache_stats.h>
+#include <crispy/latency_histogram.h>
 #include <crispy/size.h>
 
 #include <fmt/format.h>
 
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
 #include <utility>
 
 namespace terminal::renderer {
 
+/// Consecutive stages of Renderer::render(), each one timed on the CPU.
+enum class RenderStage
+{
+    ImageDiscards,      // discarding images and trimming memory
+    Damage,             // telling the rows to render, and scrolling the unchanged ones
+    Cells,              // rendering the cells into each renderer's batch
+    Backgrounds,        // flushing the renderers' batches ...
+    Decorations,
+    Images,
+    Text,
+    Grid,
+    Selection,          // drawing the selection on top of the cells, see RenderBuffer::selection
+    Cursor,
+    Execute,            // submitting the frame to the render target
+};
+
+constexpr size_t RenderStageCount = static_cast<size_t>(RenderStage::Execute) + 1;
+
+constexpr std::string_view to_string(RenderStage _stage) noexcept
+{
+    switch (_stage)
+    {
+        case RenderStage::ImageDiscards: return "image_discards";
+        case RenderStage::Damage: return "damage";
+        case RenderStage::Cells: return "cells";
+        case RenderStage::Backgrounds: return "backgrounds";
+        case RenderStage::Decorations: return "decorations";
+        case RenderStage::Images: return "images";
+        case RenderStage::Text: return "text";
+        case RenderStage::Grid: return "grid";
+        case RenderStage::Selection: return "selection";
+        case RenderStage::Cursor: return "cursor";
+        case RenderStage::Execute: return "execute";
+    }
+    return "unknown";
+}
+
 struct RenderCursor
 {
     crispy::Point position;
@@ -65,9 +110,26 @@ class Renderer : public Renderable {
 
     void setRenderTarget(RenderTarget& _renderTarget);
 
+    /// Moves glyph rasterization and cutting image tiles off the render thread.
+    ///
+    /// @p _scheduleRedraw is invoked from a worker thread whenever newly rasterized
+    /// glyphs or image tiles are ready, to have them rendered.
+    void enableAsyncRasterization(std::function<void()> _scheduleRedraw)
+    {
+        imageRenderer_.enableAsyncRasterization(_scheduleRedraw);
+        textRenderer_.enableAsyncRasterization(std::move(_scheduleRedraw));
+    }
+
     void setBackgroundOpacity(terminal::Opacity _opacity);
     void setRenderSize(crispy::Size _size);
     bool setFontSize(text::font_size _fontSize);
+
+    /// Changes the DPI the fonts are rendered at, keeping the glyphs of the previous one,
+    /// so that moving the window back and forth between screens of different DPI is instant.
+    ///
+    /// @returns whether the DPI has changed.
+    bool setDpi(crispy::Point _dpi);
+
     void updateFontMetrics();
 
     FontDescriptions const& fontDescriptions() const noexcept { return fontDescriptions_; }
@@ -83,6 +145,7 @@ class Renderer : public Renderable {
     void setScreenSize(crispy::Size const& _screenSize) noexcept
     {
         gridMetrics_.pageSize = _screenSize;
+        fullRedraw_ = true;
     }
 
     void setMargin(PageMargin _margin) noexcept
@@ -90,16 +153,68 @@ class Renderer : public Renderable {
         if (renderTarget_)
             renderTarget_->setMargin(_margin);
         gridMetrics_.pageMargin = _margin;
+        fullRedraw_ = true;
     }
 
+    /// Renders cell backgrounds and glyphs through the render target's cell grid pass, if supported.
+    void setCellGridEnabled(bool _enabled) noexcept
+    {
+        gridRenderer_.setEnabled(_enabled);
+        fullRedraw_ = true;
+    }
+
+    /// Has the next frame redraw the whole render target, instead of only what changed.
+    void invalidate() noexcept { fullRedraw_ = true; }
+
     /**
      * Renders the given @p _terminal to the current OpenGL context.
      *
      * @p _now The time hint to use when rendering the eventually blinking cursor.
+     * @p _lastInput The time of the most recent user input, which keeps the refresh rate
+     *               from being reduced under rendering pressure (see DegradationPolicy).
      */
     uint64_t render(Terminal& _terminal,
                     std::chrono::steady_clock::time_point _now,
-                    bool _pressure);
+                    std::chrono::steady_clock::time_point _lastInput);
+
+    /// Sets the refresh rate frames are meant to be rendered at, telling how long building
+    /// a frame may take before rendering features are given up (see DegradationPolicy).
+    ///
+    /// May be invoked by any thread.
+    void setRefreshRate(double _refreshRate) noexcept { refreshRate_ = _refreshRate; }
+
+    /// @returns the rendering features given up by the most recent frame.
+    ///
+    /// May be invoked by any thread.
+    DegradationLevel degradationLevel() const noexcept { return degradationLevel_.load(); }
+
+    /// @returns the read time of the PTY output painted for the first time by the most recent
+    ///          render() call, or an unset time point if it did not paint any new output.
+    ///
+    /// @see RenderBuffer::outputTime
+    std::chrono::steady_clock::time_point renderedOutputTime() const noexcept { return renderedOutputTime_; }
+
+    /// @returns the CPU time spent in @p _stage of render().
+    ///
+    /// May be invoked by any thread.
+    crispy::latency_histogram const& stageTime(RenderStage _stage) const noexcept
+    {
+        return stageTime_[static_cast<size_t>(_stage)];
+    }
+
+    /// @returns a human readable summary of the CPU time spent on building frames and on
+    ///          each stage of it, followed by the time spent in each of the render target's passes.
+    std::string renderStats() const;
+
+    /// @returns a JSON object of the CPU time spent on building frames and on each stage of it,
+    ///          the degradation level, and the effectiveness of the renderer's caches.
+    std::string statsJson() const;
+
+    /// Accounts the memory held by the renderer's caches and its render target to @p _usage.
+    void collectMemoryUsage(crispy::memory_usage& _usage) const;
+
+    /// Reports the effectiveness of the renderer's caches, including those of the text shaper, to @p _stats.
+    void collectCacheStats(crispy::cache_statistics& _stats) const;
 
     // Converts given RGBColor with its given opacity to a 4D-vector of values between 0.0 and 1.0
     static constexpr std::array<float, 4> canonicalColor(RGBColor const& _rgb, Opacity _opacity = Opacity::Opaque)
@@ -116,12 +231,19 @@ class Renderer : public Renderable {
 
     void clearCache();
 
+    /// Has the next frame give back memory held beyond what rendering the current screen needs,
+    /// e.g. once the terminal went idle (see terminal::Terminal::trimMemory()).
+    ///
+    /// May be invoked by any thread.
+    void requestMemoryTrim() noexcept { memoryTrimRequested_ = true; }
+
     void dumpState(std::ostream& _textOutput) const;
 
-    std::array<std::reference_wrapper<Renderable>, 5> renderables()
+    std::array<std::reference_wrapper<Renderable>, 6> renderables()
     {
-        return std::array<std::reference_wrapper<Renderable>, 5>{
+        return std::array<std::reference_wrapper<Renderable>, 6>{
             backgroundRenderer_,
+            gridRenderer_,
             imageRenderer_,
             textRenderer_,
             decorationRenderer_,
@@ -130,12 +252,39 @@ class Renderer : public Renderable {
     }
 
   private:
-    void renderCells(std::vector<RenderCell> const& _renderableCells);
+    /// Grid rows to be rendered again, and if only the cursor changed within them, its columns.
+    struct Damage {
+        int firstRow;
+        int lastRow;
+        std::optional<std::pair<int, int>> columns;
+        int movedRows = 0;  // rows moved upwards (downwards if negative) by scrolling, kept as rendered
+    };
+
+    void renderCells(RenderBuffer const& _renderBuffer, Damage const& _damage);
+
+    /// Renders the damaged cells into the cell grid, split into bands of rows
+    /// across worker threads if there are enough of them.
+    void renderGridCells(RenderBuffer const& _renderBuffer, Damage const& _damage, bool _decorations);
+
+    /// @returns the area that differs from the previously rendered frame,
+    ///          or an empty range of rows (first greater than last) if none does.
+    Damage damagedArea(RenderBuffer const& _renderBuffer, bool _fullRedraw);
 
     std::optional<RenderCursor> renderCursor(Terminal const& _terminal);
 
+    /// Draws the selected cells of the rows @p _firstRow to @p _lastRow as translucent rectangles,
+    /// blending the selection color into the cells rather than rendering them again.
+    void renderSelection(RenderBuffer const& _renderBuffer, int _firstRow, int _lastRow);
+
     void executeImageDiscards();
 
+    /// Reloads the grid metrics after the font size or DPI changed, keeping the texture atlases.
+    void gridMetricsChanged();
+
+    void trimMemory();
+
+    void setDegradationLevel(Terminal& _terminal, DegradationLevel _level);
+
     std::unique_ptr<text::shaper> textShaper_;
 
     FontDescriptions fontDescriptions_;
@@ -144,15 +293,39 @@ class Renderer : public Renderable {
     GridMetrics gridMetrics_;
 
     Opacity backgroundOpacity_;
+    terminal::ColorPalette const& colorPalette_;
 
     std::mutex imageDiscardLock_;               //!< Lock guard for accessing discardImageQueue_.
     std::vector<Image::Id> discardImageQueue_;  //!< List of images to be discarded.
+    std::atomic<bool> memoryTrimRequested_ = false; //!< see requestMemoryTrim()
 
     BackgroundRenderer backgroundRenderer_;
+    GridRenderer gridRenderer_;
     ImageRenderer imageRenderer_;
     TextRenderer textRenderer_;
     DecorationRenderer decorationRenderer_;
     CursorRenderer cursorRenderer_;
+
+
+    // damage tracking
+    //
+    bool fullRedraw_ = true;                        // whether the next frame has to redraw everything
+    std::vector<uint64_t> renderedRowVersions_;     // RenderBuffer::rowVersions of the rendered frame
+    std::optional<terminal::RenderCursor> renderedCursor_;
+    std::vector<terminal::RenderSelection> renderedSelection_; // RenderBuffer::selection of the rendered frame
+    uint64_t renderedPaletteVersion_ = 0;           // RenderBuffer::paletteVersion handed to the render target
+
+    std::chrono::steady_clock::time_point renderedOutputTime_{};
+    std::chrono::steady_clock::time_point lastOutputTime_{}; // of the most recently rendered frame
+
+    crispy::latency_histogram buildTime_;           // CPU time spent in render() before executing the frame
+    std::array<crispy::latency_histogram, RenderStageCount> stageTime_; // see stageTime()
+
+    // graceful degradation under rendering pressure
+    //
+    DegradationPolicy degradation_;
+    std::atomic<double> refreshRate_ = 60.0;        //!< see setRefreshRate()
+    std::atomic<DegradationLevel> degradationLevel_ = DegradationLevel::None; //!< see degradationLevel()
 };
 
 } // end namespace
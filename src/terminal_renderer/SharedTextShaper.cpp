@@ -0,0 +1,176 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_renderer/SharedTextShaper.h>
+
+#include <text_shaper/open_shaper.h>
+#include <text_shaper/directwrite_shaper.h>
+
+#include <map>
+#include <mutex>
+#include <utility>
+
+using std::make_shared;
+using std::map;
+using std::mutex;
+using std::nullopt;
+using std::optional;
+using std::pair;
+using std::scoped_lock;
+using std::shared_ptr;
+using std::string;
+using std::u32string_view;
+using std::weak_ptr;
+
+namespace terminal::renderer {
+
+namespace // {{{ helper
+{
+    mutex sharedShapersLock;
+    map<pair<int, int>, weak_ptr<text::shaper>> sharedShapers; // by DPI
+
+    /// @returns the shaper shared at the given DPI, creating it if not in use yet.
+    shared_ptr<text::shaper> acquireShaper(crispy::Point _dpi)
+    {
+        auto _l = scoped_lock{sharedShapersLock};
+        auto& shared = sharedShapers[pair{_dpi.x, _dpi.y}];
+        if (auto shaper = shared.lock(); shaper)
+            return shaper;
+
+        #if defined(_WIN32)
+        shared_ptr<text::shaper> shaper = make_shared<text::directwrite_shaper>(_dpi);
+        #else
+        shared_ptr<text::shaper> shaper = make_shared<text::open_shaper>(_dpi);
+        #endif
+        shared = shaper;
+        return shaper;
+    }
+} // }}}
+
+SharedTextShaper::SharedTextShaper(crispy::Point _dpi)
+{
+    dpis_[0] = _dpi;
+    shapers_[0] = acquireShaper(_dpi);
+    slotCount_ = 1;
+}
+
+void SharedTextShaper::set_dpi(crispy::Point _dpi)
+{
+    if (_dpi == crispy::Point{} || _dpi == dpis_[current_.load()])
+        return;
+
+    for (size_t slot = 0; slot < slotCount_; ++slot)
+    {
+        if (dpis_[slot] == _dpi)
+        {
+            current_.store(slot, std::memory_order_release);
+            return;
+        }
+    }
+
+    // Not expected to happen, but rather than forgetting any shaper, the current one is kept.
+    if (slotCount_ == MaxSlots)
+        return;
+
+    auto const slot = slotCount_++;
+    dpis_[slot] = _dpi;
+    shapers_[slot] = acquireShaper(_dpi);
+    current_.store(slot, std::memory_order_release);
+}
+
+void SharedTextShaper::clear_cache()
+{
+    auto _l = scoped_lock{sharedShapersLock};
+    auto& shaper = shapers_[current_.load()];
+    if (shaper.use_count() == 1)
+        shaper->clear_cache();
+}
+
+optional<text::font_key> SharedTextShaper::load_font(text::font_description const& _description, text::font_size _size)
+{
+    auto const slot = current_.load(std::memory_order_acquire);
+    if (auto const font = shapers_[slot]->load_font(_description, _size); font.has_value())
+        return tagged(*font, slot);
+    return nullopt;
+}
+
+text::font_metrics SharedTextShaper::metrics(text::font_key _key) const
+{
+    return shaperOf(_key).metrics(untagged(_key));
+}
+
+void SharedTextShaper::shape(text::font_key _font,
+                             u32string_view _text,
+                             crispy::span<int> _clusters,
+                             unicode::Script _script,
+                             text::shape_result& _result)
+{
+    shaperOf(_font).shape(untagged(_font), _text, _clusters, _script, _result);
+    tag(crispy::span(_result.data(), _result.size()), slotOf(_font));
+}
+
+optional<text::glyph_position> SharedTextShaper::shape(text::font_key _font, char32_t _codepoint)
+{
+    auto result = shaperOf(_font).shape(untagged(_font), _codepoint);
+    if (result.has_value())
+        tag(crispy::span(&*result, 1), slotOf(_font));
+    return result;
+}
+
+optional<text::ascii_glyph_table> SharedTextShaper::ascii_glyphs(text::font_key _font)
+{
+    auto result = shaperOf(_font).ascii_glyphs(untagged(_font));
+    if (result.has_value())
+        tag(crispy::span(result->glyphs.data(), result->glyphs.size()), slotOf(_font));
+    return result;
+}
+
+optional<text::rasterized_glyph> SharedTextShaper::rasterize(text::glyph_key _glyph, text::render_mode _mode)
+{
+    auto& shaper = shaperOf(_glyph.font);
+    _glyph.font = untagged(_glyph.font);
+    return shaper.rasterize(_glyph, _mode);
+}
+
+bool SharedTextShaper::has_color(text::font_key _font) const
+{
+    return shaperOf(_font).has_color(untagged(_font));
+}
+
+optional<string> SharedTextShaper::font_file(text::font_key _font) const
+{
+    return shaperOf(_font).font_file(untagged(_font));
+}
+
+void SharedTextShaper::collect_memory_usage(crispy::memory_usage& _usage) const
+{
+    // The fonts of previous DPIs are kept, too.
+    for (size_t slot = 0; slot < slotCount_; ++slot)
+        shapers_[slot]->collect_memory_usage(_usage);
+}
+
+void SharedTextShaper::collect_cache_stats(crispy::cache_statistics& _stats) const
+{
+    // Counted across all instances sharing the shapers, as are their caches.
+    for (size_t slot = 0; slot < slotCount_; ++slot)
+        shapers_[slot]->collect_cache_stats(_stats);
+}
+
+void SharedTextShaper::tag(crispy::span<text::glyph_position> _glyphs, size_t _slot) noexcept
+{
+    // Fallback fonts are loaded by the same shaper as the font they are falling back from.
+    for (text::glyph_position& glyph: _glyphs)
+        glyph.glyph.font = tagged(glyph.glyph.font, _slot);
+}
+
+} // end namespace
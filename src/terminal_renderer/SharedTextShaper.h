@@ -0,0 +1,93 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <text_shaper/shaper.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+namespace terminal::renderer {
+
+/// Text shaper sharing its loaded fonts with all other SharedTextShaper instances
+/// of the same DPI within this process.
+///
+/// This way, terminal windows using the same fonts (see Renderer) do not each load
+/// and keep their own copy of every font face.
+///
+/// Changing the DPI switches over to the shaper shared at the new DPI, keeping the previous
+/// ones, so that switching back (e.g. moving the window between screens) needs no font loading.
+/// Font keys are tagged with the shaper they have been loaded by, so that the keys of all DPIs
+/// are distinct, and remain valid (and with them, the glyphs rendered by them) across DPI changes.
+///
+/// Clearing the cache is ignored as long as other instances are still using the same shaper,
+/// as it would invalidate their font keys.
+class SharedTextShaper final : public text::shaper {
+  public:
+    explicit SharedTextShaper(crispy::Point _dpi);
+
+    void set_dpi(crispy::Point _dpi) override;
+    void clear_cache() override;
+
+    std::optional<text::font_key> load_font(text::font_description const& _description, text::font_size _size) override;
+    text::font_metrics metrics(text::font_key _key) const override;
+
+    void shape(text::font_key _font,
+               std::u32string_view _text,
+               crispy::span<int> _clusters,
+               unicode::Script _script,
+               text::shape_result& _result) override;
+
+    std::optional<text::glyph_position> shape(text::font_key _font, char32_t _codepoint) override;
+    bool concurrent_shaping() const noexcept override { return shapers_[current_.load()]->concurrent_shaping(); }
+    std::optional<text::ascii_glyph_table> ascii_glyphs(text::font_key _font) override;
+    std::optional<text::rasterized_glyph> rasterize(text::glyph_key _glyph, text::render_mode _mode) override;
+    bool has_color(text::font_key _font) const override;
+    std::optional<std::string> font_file(text::font_key _font) const override;
+
+    void collect_memory_usage(crispy::memory_usage& _usage) const override;
+    void collect_cache_stats(crispy::cache_statistics& _stats) const override;
+
+  private:
+    // Font keys carry the index of the shaper they have been loaded by in their top bits.
+    static constexpr unsigned SlotShift = 24;
+    static constexpr size_t MaxSlots = 64;
+
+    static text::font_key untagged(text::font_key _font) noexcept
+    {
+        return text::font_key{_font.value & ((1u << SlotShift) - 1)};
+    }
+
+    static text::font_key tagged(text::font_key _font, size_t _slot) noexcept
+    {
+        return text::font_key{untagged(_font).value | static_cast<unsigned>(_slot << SlotShift)};
+    }
+
+    static size_t slotOf(text::font_key _font) noexcept { return _font.value >> SlotShift; }
+
+    text::shaper& shaperOf(text::font_key _font) const noexcept { return *shapers_[slotOf(_font)]; }
+
+    /// Tags the font keys of the glyphs shaped by the shaper in slot @p _slot.
+    static void tag(crispy::span<text::glyph_position> _glyphs, size_t _slot) noexcept;
+
+    // Shapers by the DPI they have been used at, each one's index being its slot.
+    // They are never replaced, as their glyphs might still be rasterized by worker threads.
+    std::array<crispy::Point, MaxSlots> dpis_{};
+    std::array<std::shared_ptr<text::shaper>, MaxSlots> shapers_{};
+    size_t slotCount_ = 0;
+    std::atomic<size_t> current_ = 0;
+};
+
+} // end namespace
@@ -0,0 +1,690 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_renderer/SoftwareRenderer.h>
+
+#include <crispy/debuglog.h>
+#include <crispy/thread_pool.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+    #include <emmintrin.h>
+    #define LIBTERMINAL_SOFTWARE_RENDERER_SSE2 1
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && (defined(__aarch64__) || defined(_M_ARM64))
+    #include <arm_neon.h>
+    #define LIBTERMINAL_SOFTWARE_RENDERER_NEON 1
+#endif
+
+using crispy::Size;
+using std::array;
+using std::max;
+using std::min;
+using std::nullopt;
+using std::optional;
+using std::string;
+using std::vector;
+using std::chrono::steady_clock;
+
+namespace terminal::renderer {
+
+namespace // {{{ helpers
+{
+    auto const SoftwareRendererTag = crispy::debugtag::make("renderer.software", "Logs details about software rendering.");
+
+    constexpr int MaxInstanceCount = 24;
+    constexpr int MonochromeTextureSize = 1024;
+    constexpr int ColorTextureSize = 2048;
+    constexpr size_t AtlasMemoryBudget = 64 * 1024 * 1024; // memory per atlas allocator, in bytes
+    constexpr int MinBandHeight = 16; // rows worth handing to another thread
+
+    array<uint8_t, 4> normalized(float _r, float _g, float _b, float _a) noexcept
+    {
+        auto const byte = [](float _value) {
+            return static_cast<uint8_t>(std::clamp(_value, 0.0f, 1.0f) * 255.0f + 0.5f);
+        };
+        return {byte(_r), byte(_g), byte(_b), byte(_a)};
+    }
+
+    /// @returns @p _value * @p _factor / 255, rounded to nearest.
+    constexpr uint8_t scaled(unsigned _value, unsigned _factor) noexcept
+    {
+        auto const v = _value * _factor + 0x80;
+        return static_cast<uint8_t>((v + (v >> 8)) >> 8);
+    }
+
+    /// Blends @p _count straight alpha RGBA pixels of @p _source onto @p _target, the same way
+    /// the OpenGL render target does with glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE).
+    void blend(uint8_t* _target, uint8_t const* _source, size_t _count) noexcept
+    {
+        size_t i = 0;
+
+#if defined(LIBTERMINAL_SOFTWARE_RENDERER_SSE2)
+        // Four pixels at a time, widened to 16 bit per channel, two pixels per register.
+        auto const zero = _mm_setzero_si128();
+        auto const full = _mm_set1_epi16(0xFF);
+        auto const rounding = _mm_set1_epi16(0x80);
+        auto const alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+        auto const blendHalf = [&](__m128i _src, __m128i _dst) {
+            auto alpha = _mm_shufflelo_epi16(_src, _MM_SHUFFLE(3, 3, 3, 3));
+            alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+            auto const value = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_src, alpha),
+                                                           _mm_mullo_epi16(_dst, _mm_sub_epi16(full, alpha))),
+                                             rounding);
+            return _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+        };
+        for (; i + 4 <= _count; i += 4)
+        {
+            auto const source = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_source + 4 * i));
+            auto const target = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_target + 4 * i));
+            auto const color = _mm_packus_epi16(blendHalf(_mm_unpacklo_epi8(source, zero), _mm_unpacklo_epi8(target, zero)),
+                                                blendHalf(_mm_unpackhi_epi8(source, zero), _mm_unpackhi_epi8(target, zero)));
+            auto const alpha = _mm_adds_epu8(source, target);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(_target + 4 * i),
+                             _mm_or_si128(_mm_andnot_si128(alphaMask, color), _mm_and_si128(alphaMask, alpha)));
+        }
+#elif defined(LIBTERMINAL_SOFTWARE_RENDERER_NEON)
+        // Eight pixels at a time, deinterleaved into one register per channel.
+        auto const rounding = vdupq_n_u16(0x80);
+        for (; i + 8 <= _count; i += 8)
+        {
+            uint8x8x4_t const source = vld4_u8(_source + 4 * i);
+            uint8x8x4_t target = vld4_u8(_target + 4 * i);
+            uint8x8_t const alpha = source.val[3];
+            uint8x8_t const inverse = vmvn_u8(alpha);
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                auto const value = vaddq_u16(vmlal_u8(vmull_u8(source.val[channel], alpha), target.val[channel], inverse),
+                                             rounding);
+                target.val[channel] = vshrn_n_u16(vaddq_u16(value, vshrq_n_u16(value, 8)), 8);
+            }
+            target.val[3] = vqadd_u8(alpha, target.val[3]);
+            vst4_u8(_target + 4 * i, target);
+        }
+#endif
+
+        for (; i < _count; ++i)
+        {
+            uint8_t const* source = _source + 4 * i;
+            uint8_t* target = _target + 4 * i;
+            auto const alpha = unsigned(source[3]);
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                auto const value = source[channel] * alpha + target[channel] * (255u - alpha) + 0x80;
+                target[channel] = static_cast<uint8_t>((value + (value >> 8)) >> 8);
+            }
+            target[3] = static_cast<uint8_t>(min(255u, unsigned(source[3]) + unsigned(target[3])));
+        }
+    }
+
+    /// Fills @p _count pixels at @p _target with the given RGBA color.
+    void fill(uint8_t* _target, array<uint8_t, 4> const& _color, size_t _count) noexcept
+    {
+        for (size_t i = 0; i < _count; ++i)
+            std::memcpy(_target + 4 * i, _color.data(), 4);
+    }
+
+    /// @returns the number of pixels whose centers lie within @p _extent, starting at a pixel boundary.
+    int coverage(float _extent) noexcept
+    {
+        return max(0, static_cast<int>(std::ceil(_extent - 0.5f)));
+    }
+
+    /// @returns the source pixel sampled by the pixel @p _index of a target of @p _extent pixels,
+    ///          stretched from @p _sourceExtent pixels, the same way GL_NEAREST does.
+    int sample(int _index, float _extent, int _sourceExtent) noexcept
+    {
+        auto const position = (static_cast<float>(_index) + 0.5f) * static_cast<float>(_sourceExtent) / _extent;
+        return min(_sourceExtent - 1, static_cast<int>(position));
+    }
+
+    bool horizontalLine(int _y, int _bottom, int _thickness) noexcept
+    {
+        return _bottom <= _y && _y < _bottom + _thickness;
+    }
+
+    /// Tests whether the given pixel, relative to the bottom left of its grid cell, is to be painted.
+    ///
+    /// This must match the decoration shader of the OpenGL render target.
+    bool covers(Decorator _decorator, int _x, int _y,
+                int _baseline, int _cellWidth, int _cellHeight,
+                int _underlinePosition, int _underlineThickness) noexcept
+    {
+        constexpr double Pi = 3.14159265358979;
+        auto const cellWidth = max(1, _cellWidth);
+        auto const thickness = max(1, _underlineThickness);
+        auto const thicknessHalf = (thickness + 1) / 2;
+        auto const underlineBottom = max(0, _underlinePosition - thicknessHalf);
+
+        switch (_decorator)
+        {
+            case Decorator::Underline:
+                return horizontalLine(_y, underlineBottom, thickness);
+            case Decorator::DoubleUnderline:
+            {
+                auto const lowerBottom = max(0, underlineBottom - thickness);
+                return horizontalLine(_y, lowerBottom, thickness)
+                    || horizontalLine(_y, lowerBottom + 2 * thickness, thickness);
+            }
+            case Decorator::CurlyUnderline:
+            {
+                auto const amplitude = static_cast<float>(max(0, (2 * _baseline) / 3 - thickness));
+                auto const wave = static_cast<float>((std::cos((_x + 0.5) / cellWidth * 2.0 * Pi) + 1.0) / 2.0);
+                return horizontalLine(_y, static_cast<int>(wave * amplitude), thickness);
+            }
+            case Decorator::DottedUnderline:
+            {
+                auto const radius = thicknessHalf;
+                auto const period = 6 * radius;
+                auto const centerY = max(radius, _underlinePosition - radius);
+                auto const dx = _x - radius - ((_x + period / 2 - radius) / period) * period;
+                auto const dy = _y - centerY;
+                return dx * dx + dy * dy <= radius * radius;
+            }
+            case Decorator::DashedUnderline:
+                return horizontalLine(_y, underlineBottom, thickness)
+                    && std::abs((_x + 0.5) / cellWidth - 0.5) >= 0.25;
+            case Decorator::Overline:
+                return horizontalLine(_y, _cellHeight - thickness, thickness);
+            case Decorator::CrossedOut:
+                return horizontalLine(_y, _cellHeight / 2 - thicknessHalf, thickness);
+            case Decorator::Framed:
+            {
+                auto const border = max(1, thickness / 2);
+                return _x < border || _x >= cellWidth - border
+                    || _y < border || _y >= _cellHeight - border;
+            }
+            case Decorator::Encircle:
+            {
+                auto const rx = cellWidth / 2.0;
+                auto const ry = _cellHeight / 2.0;
+                auto const ox = (_x + 0.5 - rx) / rx;
+                auto const oy = (_y + 0.5 - ry) / ry;
+                auto const border = max(1, thickness / 2) / min(rx, ry);
+                auto const extent = std::sqrt(ox * ox + oy * oy);
+                return 1.0 - border <= extent && extent <= 1.0;
+            }
+        }
+        return false;
+    }
+} // }}}
+
+/// Keeps the atlases in system memory, and the textures to render with the current frame.
+struct SoftwareRenderer::TextureScheduler : public atlas::AtlasBackend
+{
+    struct Atlas
+    {
+        Size size;
+        atlas::Format format;
+        atlas::Buffer pixels;           // bottom row first
+    };
+
+    /// A texture to render, resolved to the area of its atlas to sample from.
+    struct Texture
+    {
+        atlas::AtlasID atlas;
+        int x, y;                       // bottom left corner
+        float width, height;            // size on the render target
+        int sourceX, sourceY;           // bottom left corner on the atlas
+        int sourceWidth, sourceHeight;
+        array<uint8_t, 4> color;        // RGBA
+    };
+
+    std::unordered_map<atlas::AtlasID, Atlas> atlases;
+    std::vector<Texture> textures;      // of the current frame, in drawing order
+    int nextAtlasID = 0;
+
+    atlas::AtlasID createAtlas(Size _size, atlas::Format _format, int /*_user*/) override
+    {
+        auto const id = atlas::AtlasID{nextAtlasID++};
+        auto const byteCount = static_cast<size_t>(_size.width) * static_cast<size_t>(_size.height)
+                             * static_cast<size_t>(atlas::element_count(_format));
+        atlases.emplace(id, Atlas{_size, _format, atlas::Buffer(byteCount, 0)});
+        return id;
+    }
+
+    void uploadTexture(atlas::UploadTexture _upload) override
+    {
+        auto const& texture = _upload.texture.get();
+        auto const i = atlases.find(texture.atlas);
+        if (i == atlases.end())
+            return;
+
+        auto& atlas = i->second;
+        assert(_upload.format == atlas.format);
+        auto const elementCount = atlas::element_count(atlas.format);
+        auto const rowSize = static_cast<size_t>(texture.bitmapSize.width * elementCount);
+        auto const rowCount = min(texture.bitmapSize.height, static_cast<int>(_upload.data.size() / max(rowSize, size_t{1})));
+        for (int row = 0; row < rowCount; ++row)
+        {
+            auto const offset = static_cast<size_t>(((texture.offset.y + row) * atlas.size.width + texture.offset.x) * elementCount);
+            std::memcpy(atlas.pixels.data() + offset, _upload.data.data() + static_cast<size_t>(row) * rowSize, rowSize);
+        }
+    }
+
+    void renderTexture(atlas::RenderTexture _render) override
+    {
+        auto const& texture = _render.texture.get();
+
+        auto width = static_cast<float>(texture.targetSize.width);
+        auto height = static_cast<float>(texture.targetSize.height);
+        auto sourceX = texture.offset.x;
+        auto sourceY = texture.offset.y;
+        auto sourceWidth = texture.bitmapSize.width;
+        auto sourceHeight = texture.bitmapSize.height;
+
+        // Only a part of the bitmap is rendered when given a source area,
+        // which is scaled the same way as the whole bitmap is onto its target size.
+        if (auto const& source = _render.sourceSize; source.width && source.height)
+        {
+            width *= static_cast<float>(source.width) / static_cast<float>(sourceWidth);
+            height *= static_cast<float>(source.height) / static_cast<float>(sourceHeight);
+            sourceX += _render.sourceOffset.x;
+            sourceY += _render.sourceOffset.y;
+            sourceWidth = source.width;
+            sourceHeight = source.height;
+        }
+
+        if (auto const& target = _render.targetSize; target.width && target.height)
+        {
+            width = static_cast<float>(target.width);
+            height = static_cast<float>(target.height);
+        }
+
+        if (sourceWidth <= 0 || sourceHeight <= 0)
+            return;
+
+        textures.emplace_back(Texture{
+            texture.atlas,
+            _render.x,
+            _render.y,
+            width,
+            height,
+            sourceX,
+            sourceY,
+            sourceWidth,
+            sourceHeight,
+            normalized(_render.color[0], _render.color[1], _render.color[2], _render.color[3])
+        });
+    }
+
+    void destroyAtlas(atlas::AtlasID _atlas) override
+    {
+        atlases.erase(_atlas);
+    }
+};
+
+SoftwareRenderer::SoftwareRenderer(Size _size, unsigned _threadCount):
+    textureScheduler_{ std::make_unique<TextureScheduler>() },
+    monochromeAtlasAllocator_{
+        *textureScheduler_,
+        Size{MonochromeTextureSize, MonochromeTextureSize},
+        MaxInstanceCount,
+        atlas::Format::Red,
+        0,
+        "monochromeAtlas"
+    },
+    coloredAtlasAllocator_{
+        *textureScheduler_,
+        Size{ColorTextureSize, ColorTextureSize},
+        MaxInstanceCount,
+        atlas::Format::RGBA,
+        1,
+        "colorAtlas"
+    },
+    lcdAtlasAllocator_{
+        *textureScheduler_,
+        Size{ColorTextureSize, ColorTextureSize},
+        MaxInstanceCount,
+        atlas::Format::RGB,
+        2,
+        "lcdAtlas"
+    },
+    threadCount_{ static_cast<unsigned>(min(size_t{max(1u, _threadCount)},
+                                            crispy::thread_pool::shared().thread_count() + 1)) }
+{
+    for (atlas::TextureAtlasAllocator* allocator: allAtlasAllocators())
+        allocator->setMemoryBudget(AtlasMemoryBudget);
+
+    setRenderSize(_size);
+
+    debuglog(SoftwareRendererTag).write("Rendering with up to {} threads.", threadCount_);
+}
+
+SoftwareRenderer::~SoftwareRenderer() = default;
+
+void SoftwareRenderer::setRenderSize(Size _size)
+{
+    size_ = Size{max(0, _size.width), max(0, _size.height)};
+    framebuffer_.assign(static_cast<size_t>(size_.width) * static_cast<size_t>(size_.height) * 4, 0);
+}
+
+atlas::AtlasBackend& SoftwareRenderer::textureScheduler()
+{
+    return *textureScheduler_;
+}
+
+void SoftwareRenderer::renderRectangle(int _x, int _y, int _width, int _height,
+                                       float _r, float _g, float _b, float _a)
+{
+    rectangles_.emplace_back(Rectangle{_x, _y, _width, _height, normalized(_r, _g, _b, _a)});
+}
+
+void SoftwareRenderer::renderDecoration(Decorator _decorator, int _x, int _y, int _width,
+                                        GridMetrics const& _gridMetrics, RGBColor const& _color)
+{
+    decorations_.emplace_back(Decoration{
+        _decorator,
+        _x,
+        _y,
+        _width,
+        _gridMetrics.cellSize.height,
+        {_color.red, _color.green, _color.blue, 0xFF},
+        _gridMetrics.baseline,
+        _gridMetrics.cellSize.width,
+        _gridMetrics.underline.position,
+        _gridMetrics.underline.thickness
+    });
+}
+
+bool SoftwareRenderer::scrollArea(DamagedArea const& _area, int _offset)
+{
+    auto const firstRow = std::clamp(_area.y, 0, size_.height);
+    auto const lastRow = std::clamp(_area.y + _area.height, firstRow, size_.height);
+    auto const rowCount = lastRow - firstRow - std::abs(_offset);
+    if (rowCount <= 0)
+        return true;
+
+    // Rows are stored bottom up, just like the area is given.
+    auto const stride = static_cast<size_t>(size_.width) * 4;
+    auto const source = static_cast<size_t>(_offset > 0 ? firstRow : firstRow - _offset);
+    auto const target = static_cast<size_t>(_offset > 0 ? firstRow + _offset : firstRow);
+    std::memmove(framebuffer_.data() + target * stride,
+                 framebuffer_.data() + source * stride,
+                 static_cast<size_t>(rowCount) * stride);
+    return true;
+}
+
+void SoftwareRenderer::scheduleScreenshot(ScreenshotCallback _callback)
+{
+    pendingScreenshotCallback_ = std::move(_callback);
+}
+
+void SoftwareRenderer::execute()
+{
+    auto const startTime = steady_clock::now();
+
+    auto const area = std::exchange(damagedArea_, nullopt).value_or(DamagedArea{0, size_.height});
+    auto const firstRow = std::clamp(area.y, 0, size_.height);
+    auto const lastRow = std::clamp(area.y + area.height, firstRow, size_.height);
+    auto const left = std::clamp(area.x, 0, size_.width);
+    auto const right = left + std::clamp(area.width, 0, size_.width - left);
+
+    if (firstRow < lastRow && left < right)
+    {
+        // The bands are independent of each other, as each one is clipped to its own rows.
+        auto const rowCount = lastRow - firstRow;
+        auto const bandCount = static_cast<int>(min(static_cast<size_t>(threadCount_),
+                                                    static_cast<size_t>(max(1, rowCount / MinBandHeight))));
+        crispy::thread_pool::shared().parallel_for(static_cast<size_t>(bandCount), [&](size_t _band) {
+            auto const band = static_cast<int>(_band);
+            renderBand(firstRow + rowCount * band / bandCount,
+                       firstRow + rowCount * (band + 1) / bandCount,
+                       left,
+                       right);
+        });
+    }
+
+    rectangles_.clear();
+    decorations_.clear();
+    textureScheduler_->textures.clear();
+
+    executeTime_.record(steady_clock::now() - startTime);
+
+    if (pendingScreenshotCallback_)
+    {
+        auto const callback = std::move(*pendingScreenshotCallback_);
+        pendingScreenshotCallback_.reset();
+        debuglog(SoftwareRendererTag).write("Capture screenshot ({}).", size_);
+        callback(framebuffer_, size_);
+    }
+}
+
+void SoftwareRenderer::renderBand(int _firstRow, int _lastRow, int _left, int _right)
+{
+    auto const stride = static_cast<size_t>(size_.width) * 4;
+    auto const pixelAt = [&](int _x, int _y) {
+        return framebuffer_.data() + static_cast<size_t>(_y) * stride + static_cast<size_t>(_x) * 4;
+    };
+
+    vector<uint8_t> scratch(stride);
+
+    // clear
+    auto const clearColor = array<uint8_t, 4>{clearColor_.red(), clearColor_.green(), clearColor_.blue(), clearColor_.alpha()};
+    fill(scratch.data(), clearColor, static_cast<size_t>(_right - _left));
+    for (int y = _firstRow; y < _lastRow; ++y)
+        std::memcpy(pixelAt(_left, y), scratch.data(), static_cast<size_t>(_right - _left) * 4);
+
+    // render filled rects
+    for (Rectangle const& rect: rectangles_)
+    {
+        auto const x0 = max(rect.x, _left);
+        auto const x1 = min(rect.x + rect.width, _right);
+        auto const y0 = max(rect.y, _firstRow);
+        auto const y1 = min(rect.y + rect.height, _lastRow);
+        if (x0 >= x1 || y0 >= y1 || rect.color[3] == 0)
+            continue;
+
+        auto const count = static_cast<size_t>(x1 - x0);
+        fill(scratch.data(), rect.color, count);
+        for (int y = y0; y < y1; ++y)
+        {
+            if (rect.color[3] == 0xFF)
+                std::memcpy(pixelAt(x0, y), scratch.data(), count * 4);
+            else
+                blend(pixelAt(x0, y), scratch.data(), count);
+        }
+    }
+
+    // render decorations
+    auto const transparent = array<uint8_t, 4>{};
+    for (Decoration const& decoration: decorations_)
+    {
+        auto const x0 = max(decoration.x, _left);
+        auto const x1 = min(decoration.x + decoration.width, _right);
+        auto const y0 = max(decoration.y, _firstRow);
+        auto const y1 = min(decoration.y + decoration.height, _lastRow);
+        if (x0 >= x1 || y0 >= y1)
+            continue;
+
+        auto const cellWidth = max(1, decoration.cellWidth);
+        for (int y = y0; y < y1; ++y)
+        {
+            auto out = scratch.data();
+            for (int x = x0; x < x1; ++x, out += 4)
+            {
+                bool const covered = covers(decoration.decorator,
+                                            (x - decoration.x) % cellWidth,
+                                            y - decoration.y,
+                                            decoration.baseline,
+                                            cellWidth,
+                                            decoration.height,
+                                            decoration.underlinePosition,
+                                            decoration.underlineThickness);
+                std::memcpy(out, covered ? decoration.color.data() : transparent.data(), 4);
+            }
+            blend(pixelAt(x0, y), scratch.data(), static_cast<size_t>(x1 - x0));
+        }
+    }
+
+    renderTextures(_firstRow, _lastRow, _left, _right, scratch);
+}
+
+void SoftwareRenderer::renderTextures(int _firstRow, int _lastRow, int _left, int _right, vector<uint8_t>& _scratch)
+{
+    auto const stride = static_cast<size_t>(size_.width) * 4;
+
+    for (TextureScheduler::Texture const& texture: textureScheduler_->textures)
+    {
+        auto const atlasIter = textureScheduler_->atlases.find(texture.atlas);
+        if (atlasIter == textureScheduler_->atlases.end())
+            continue;
+
+        auto const& atlas = atlasIter->second;
+        auto const x0 = max(texture.x, _left);
+        auto const x1 = min(texture.x + coverage(texture.width), _right);
+        auto const y0 = max(texture.y, _firstRow);
+        auto const y1 = min(texture.y + coverage(texture.height), _lastRow);
+        if (x0 >= x1 || y0 >= y1)
+            continue;
+
+        auto const elementCount = atlas::element_count(atlas.format);
+        auto const color = texture.color;
+        for (int y = y0; y < y1; ++y)
+        {
+            auto const sourceRow = min(atlas.size.height - 1,
+                                       texture.sourceY + sample(y - texture.y, texture.height, texture.sourceHeight));
+            auto const* atlasRow = atlas.pixels.data() + static_cast<size_t>(sourceRow * atlas.size.width * elementCount);
+            auto const texel = [&](int _x) {
+                auto const sourceColumn = min(atlas.size.width - 1,
+                                              texture.sourceX + sample(_x - texture.x, texture.width, texture.sourceWidth));
+                return atlasRow + sourceColumn * elementCount;
+            };
+
+            auto out = _scratch.data();
+            switch (atlas.format)
+            {
+                case atlas::Format::Red:
+                    // monochrome glyph, being the coverage of the text color
+                    for (int x = x0; x < x1; ++x, out += 4)
+                    {
+                        auto const value = texel(x)[0];
+                        out[0] = color[0];
+                        out[1] = color[1];
+                        out[2] = color[2];
+                        out[3] = scaled(value, color[3]);
+                    }
+                    break;
+                case atlas::Format::RGBA:
+                    // colored image, such as emoji or Sixel graphics
+                    for (int x = x0; x < x1; ++x, out += 4)
+                        std::memcpy(out, texel(x), 4);
+                    break;
+                case atlas::Format::RGB:
+                    // LCD subpixel glyph, being the coverage of the text color per subpixel
+                    for (int x = x0; x < x1; ++x, out += 4)
+                    {
+                        auto const* value = texel(x);
+                        out[0] = scaled(value[0], color[0]);
+                        out[1] = scaled(value[1], color[1]);
+                        out[2] = scaled(value[2], color[2]);
+                        out[3] = static_cast<uint8_t>((unsigned(value[0]) + unsigned(value[1]) + unsigned(value[2])) / 3);
+                    }
+                    break;
+                case atlas::Format::CompressedRGBA:
+                    // never used by this renderer's own atlases
+                    break;
+            }
+
+            blend(framebuffer_.data() + static_cast<size_t>(y) * stride + static_cast<size_t>(x0) * 4,
+                  _scratch.data(),
+                  static_cast<size_t>(x1 - x0));
+        }
+    }
+}
+
+string SoftwareRenderer::renderStats() const
+{
+    auto const formatDuration = [](crispy::latency_histogram::duration _value) {
+        return fmt::format("{:.3f}ms", static_cast<double>(_value.count()) / 1000.0);
+    };
+    auto out = fmt::format("{:<14} {:>10} {:>10} {:>10} {:>10}\n", "pass", "samples", "cpu p50", "cpu p99", "cpu max");
+    out += fmt::format("{:<14} {:>10} {:>10} {:>10} {:>10}\n",
+                       "software",
+                       executeTime_.count(),
+                       formatDuration(executeTime_.percentile(50)),
+                       formatDuration(executeTime_.percentile(99)),
+                       formatDuration(executeTime_.max()));
+    return out;
+}
+
+void SoftwareRenderer::collectMemoryUsage(crispy::memory_usage& _usage) const
+{
+    auto atlases = crispy::hash_table_bytes(textureScheduler_->atlases);
+    for (auto const& atlas: textureScheduler_->atlases)
+        atlases += crispy::allocated_bytes(atlas.second.pixels);
+
+    _usage.add("software.atlases", atlases);
+    _usage.add("software.atlas_metadata", monochromeAtlasAllocator_.metadataMemoryUsage()
+                                        + coloredAtlasAllocator_.metadataMemoryUsage()
+                                        + lcdAtlasAllocator_.metadataMemoryUsage());
+    _usage.add("software.framebuffer", crispy::allocated_bytes(framebuffer_));
+    _usage.add("software.frame", crispy::allocated_bytes(rectangles_)
+                               + crispy::allocated_bytes(decorations_)
+                               + crispy::allocated_bytes(textureScheduler_->textures));
+}
+
+void SoftwareRenderer::clearCache()
+{
+    monochromeAtlasAllocator_.clear();
+    coloredAtlasAllocator_.clear();
+    lcdAtlasAllocator_.clear();
+}
+
+void SoftwareRenderer::trimMemory()
+{
+    monochromeAtlasAllocator_.releaseUnusedAtlases();
+    coloredAtlasAllocator_.releaseUnusedAtlases();
+    lcdAtlasAllocator_.releaseUnusedAtlases();
+
+    rectangles_.shrink_to_fit();
+    decorations_.shrink_to_fit();
+    textureScheduler_->textures.shrink_to_fit();
+}
+
+optional<AtlasTextureInfo> SoftwareRenderer::readAtlas(atlas::TextureAtlasAllocator const& _allocator, atlas::AtlasID _instanceId)
+{
+    auto const i = textureScheduler_->atlases.find(_instanceId);
+    if (i == textureScheduler_->atlases.end())
+        return nullopt;
+
+    // Converted to RGBA, the same way as OpenGL reads textures back.
+    auto const& atlas = i->second;
+    auto const elementCount = atlas::element_count(atlas.format);
+    auto const pixelCount = static_cast<size_t>(atlas.size.width) * static_cast<size_t>(atlas.size.height);
+
+    AtlasTextureInfo output{};
+    output.atlasName = _allocator.name();
+    output.atlasInstanceId = _instanceId.value;
+    output.size = atlas.size;
+    output.format = atlas::Format::RGBA;
+    output.buffer.resize(pixelCount * 4);
+    for (size_t pixel = 0; pixel < pixelCount; ++pixel)
+    {
+        auto const* in = atlas.pixels.data() + pixel * static_cast<size_t>(elementCount);
+        auto* out = output.buffer.data() + pixel * 4;
+        out[0] = in[0];
+        out[1] = elementCount >= 3 ? in[1] : 0;
+        out[2] = elementCount >= 3 ? in[2] : 0;
+        out[3] = elementCount == 4 ? in[3] : 0xFF;
+    }
+    return output;
+}
+
+} // end namespace
@@ -0,0 +1,149 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal_renderer/Atlas.h>
+#include <terminal_renderer/RenderTarget.h>
+
+#include <terminal/Color.h>
+
+#include <crispy/latency_histogram.h>
+#include <crispy/size.h>
+#include <crispy/thread_pool.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace terminal::renderer {
+
+/// Render target rasterizing into an RGBA framebuffer in system memory, without any GPU.
+///
+/// This allows rendering terminals without a display, e.g. for screenshots and previews
+/// of headless terminal sessions. Frames look the same as rendered by OpenGLRenderer,
+/// and the framebuffer is laid out like OpenGL reads it back, i.e. bottom row first.
+///
+/// Each frame is rasterized in horizontal bands of the damaged area, rendered in parallel
+/// on the shared crispy::thread_pool. Pixels are blended with SSE2 or NEON where available.
+class SoftwareRenderer final : public RenderTarget {
+  public:
+    /// @param _threadCount maximum number of threads rendering a frame, including the one invoking execute().
+    explicit SoftwareRenderer(crispy::Size _size,
+                              unsigned _threadCount = std::thread::hardware_concurrency());
+    ~SoftwareRenderer() override;
+
+    SoftwareRenderer(SoftwareRenderer const&) = delete;
+    SoftwareRenderer& operator=(SoftwareRenderer const&) = delete;
+
+    /// Sets the color the damaged area is cleared with before rendering into it.
+    void setClearColor(RGBAColor _color) noexcept { clearColor_ = _color; }
+
+    crispy::Size size() const noexcept { return size_; }
+
+    /// @returns the RGBA pixels rendered so far, bottom row first.
+    std::vector<uint8_t> const& framebuffer() const noexcept { return framebuffer_; }
+
+    void setRenderSize(crispy::Size _size) override;
+    void setMargin(PageMargin _margin) override { margin_ = _margin; }
+
+    atlas::TextureAtlasAllocator& monochromeAtlasAllocator() noexcept override { return monochromeAtlasAllocator_; }
+    atlas::TextureAtlasAllocator& coloredAtlasAllocator() noexcept override { return coloredAtlasAllocator_; }
+    atlas::TextureAtlasAllocator& lcdAtlasAllocator() noexcept override { return lcdAtlasAllocator_; }
+
+    atlas::AtlasBackend& textureScheduler() override;
+
+    void renderRectangle(int _x, int _y, int _width, int _height,
+                         float _r, float _g, float _b, float _a) override;
+
+    void renderDecoration(Decorator _decorator, int _x, int _y, int _width,
+                          GridMetrics const& _gridMetrics, RGBColor const& _color) override;
+
+    void setDamagedArea(std::optional<DamagedArea> _area) override { damagedArea_ = _area; }
+    bool scrollArea(DamagedArea const& _area, int _offset) override;
+
+    bool setDistanceFieldGlyphs(bool /*_enabled*/) override { return false; }
+    bool supportsCellGrid() const noexcept override { return false; }
+    void setPalette(RenderPalette const& /*_palette*/) override {}
+    void renderGrid(GridMetrics const& /*_gridMetrics*/,
+                    int /*_firstRow*/,
+                    int /*_lastRow*/,
+                    std::vector<GridCell> const& /*_cells*/) override {}
+
+    /// Screenshots are taken synchronously at the end of the next execute().
+    void scheduleScreenshot(ScreenshotCallback _callback) override;
+    bool screenshotsPending() const noexcept override { return pendingScreenshotCallback_.has_value(); }
+
+    void execute() override;
+
+    bool uploadsPending() const noexcept override { return false; }
+
+    std::string renderStats() const override;
+
+    void collectMemoryUsage(crispy::memory_usage& _usage) const override;
+
+    void clearCache() override;
+    void trimMemory() override;
+
+    std::optional<AtlasTextureInfo> readAtlas(atlas::TextureAtlasAllocator const& _allocator, atlas::AtlasID _instanceId) override;
+
+  private:
+    struct TextureScheduler;
+
+    struct Rectangle {
+        int x, y;                           // bottom left corner
+        int width, height;
+        std::array<uint8_t, 4> color;       // RGBA
+    };
+
+    struct Decoration {
+        Decorator decorator;
+        int x, y;                           // bottom left corner
+        int width, height;
+        std::array<uint8_t, 4> color;       // RGBA
+        int baseline;
+        int cellWidth;
+        int underlinePosition;
+        int underlineThickness;
+    };
+
+    /// Renders the rows @p _firstRow up to but excluding @p _lastRow of the current frame,
+    /// clipped to the columns @p _left up to but excluding @p _right.
+    void renderBand(int _firstRow, int _lastRow, int _left, int _right);
+    void renderTextures(int _firstRow, int _lastRow, int _left, int _right, std::vector<uint8_t>& _scratch);
+
+    crispy::Size size_;
+    PageMargin margin_{};
+    RGBAColor clearColor_{};
+    std::vector<uint8_t> framebuffer_;          // RGBA, bottom row first
+    std::optional<DamagedArea> damagedArea_;    // area to be redrawn by the next execute(), or everything
+
+    std::unique_ptr<TextureScheduler> textureScheduler_;
+    atlas::TextureAtlasAllocator monochromeAtlasAllocator_;
+    atlas::TextureAtlasAllocator coloredAtlasAllocator_;
+    atlas::TextureAtlasAllocator lcdAtlasAllocator_;
+
+    // the current frame, in drawing order
+    std::vector<Rectangle> rectangles_;
+    std::vector<Decoration> decorations_;
+
+    unsigned threadCount_;
+    std::optional<ScreenshotCallback> pendingScreenshotCallback_;
+    crispy::latency_histogram executeTime_;
+};
+
+} // end namespace
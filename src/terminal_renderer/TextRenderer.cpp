@@ -17,20 +17,29 @@
 
 #include <crispy/algorithm.h>
 #include <crispy/debuglog.h>
+#include <crispy/profiler.h>
 #include <crispy/times.h>
 #include <crispy/range.h>
+#include <crispy/thread_pool.h>
 
 #include <unicode/convert.h>
 
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 
-using crispy::copy;
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
 using crispy::times;
 
 using unicode::out;
 
 using std::array;
+using std::count_if;
+using std::chrono::steady_clock;
 using std::get;
 using std::make_unique;
 using std::max;
@@ -38,6 +47,7 @@ using std::move;
 using std::nullopt;
 using std::optional;
 using std::pair;
+using std::remove_if;
 using std::u32string;
 using std::u32string_view;
 using std::vector;
@@ -57,25 +67,85 @@ namespace // {{{ helpers
             case TextStyle::Invalid:
                 break;
             case TextStyle::Regular:
-                return _fonts.regular;
+                return _fonts.regular();
             case TextStyle::Bold:
-                return _fonts.bold;
+                return _fonts.bold();
             case TextStyle::Italic:
-                return _fonts.italic;
+                return _fonts.italic();
             case TextStyle::BoldItalic:
-                return _fonts.boldItalic;
+                return _fonts.boldItalic();
         }
-        return _fonts.regular;
+        return _fonts.regular();
+    }
+
+    TextStyle textStyleOf(CellFlags _flags) noexcept
+    {
+        if (contains_all(_flags, CellFlags::Bold | CellFlags::Italic))
+            return TextStyle::BoldItalic;
+        if (_flags & CellFlags::Bold)
+            return TextStyle::Bold;
+        if (_flags & CellFlags::Italic)
+            return TextStyle::Italic;
+        return TextStyle::Regular;
+    }
+
+    /// Number of font sizes (at a DPI) whose glyphs are kept in the texture atlases
+    /// when changing the font size or DPI.
+    constexpr size_t RetainedFontVariants = 3;
+
+    /// Maximum number of shaped text sequences cached by the ComplexTextShaper.
+    constexpr size_t ShapingCacheCapacity = 4096;
+
+    uint64_t shapingCacheKey(u32string_view _codepoints, TextStyle _style, text::font_key _font) noexcept
+    {
+        auto const fnv = crispy::FNV<char32_t, uint64_t>{1099511628211llu, 14695981039346656037llu};
+        auto hash = fnv(fnv.basis(), _codepoints, static_cast<char32_t>(_style), static_cast<char32_t>(_font.value));
+
+        // FNV alone does not spread short inputs well enough across the low bits used for indexing.
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdllu;
+        hash ^= hash >> 33;
+        return hash;
     }
 } // }}}
 
+// {{{ FontKeys
+FontKeys::FontKeys(FontDescriptions const& _descriptions, text::shaper& _shaper):
+    descriptions_{ _descriptions },
+    shaper_{ _shaper }
+{
+    reload();
+}
+
+void FontKeys::reload()
+{
+    regular_ = shaper_.load_font(descriptions_.regular, descriptions_.size).value_or(text::font_key{});
+    bold_.reset();
+    italic_.reset();
+    boldItalic_.reset();
+    emoji_.reset();
+}
+
+text::font_key FontKeys::get(optional<text::font_key>& _key, text::font_description const& _description) const
+{
+    if (!_key.has_value())
+    {
+        _key = shaper_.load_font(_description, descriptions_.size).value_or(regular_);
+        debuglog(TextRendererTag).write("Loaded font on first use: {} (key {})", _description, *_key);
+    }
+    return *_key;
+}
+// }}}
+
 TextRenderer::TextRenderer(GridMetrics const& _gridMetrics,
                            text::shaper& _textShaper,
                            FontDescriptions& _fontDescriptions,
-                           FontKeys const& _fonts) :
+                           FontKeys const& _fonts,
+                           GridRenderer& _gridRenderer) :
     gridMetrics_{ _gridMetrics },
     fontDescriptions_{ _fontDescriptions },
     fonts_{ _fonts },
+    gridRenderer_{ _gridRenderer },
     textShaper_{ _textShaper }
 {
     setTextShapingMethod(fontDescriptions_.textShapingMethod);
@@ -92,7 +162,7 @@ void TextRenderer::setTextShapingMethod(TextShapingMethod _method)
                 fonts_,
                 std::bind(&TextRenderer::renderRun, this, _1, _2, _3)
             );
-            return;
+            break;
         case TextShapingMethod::Simple:
             textRenderingEngine_ = make_unique<SimpleTextShaper>(
                 gridMetrics_,
@@ -100,8 +170,36 @@ void TextRenderer::setTextShapingMethod(TextShapingMethod _method)
                 fonts_,
                 std::bind(&TextRenderer::renderRun, this, _1, _2, _3)
             );
-            return;
+            break;
     }
+
+    // Fonts may have changed, too, so the fallback is recreated when needed.
+    simpleTextRenderingEngine_.reset();
+    simpleShaping_ = false;
+    setDegradationLevel(degradationLevel_);
+}
+
+void TextRenderer::setDegradationLevel(DegradationLevel _level)
+{
+    degradationLevel_ = _level;
+    textRenderingEngine_->setCacheBypass(_level >= DegradationLevel::UncachedShaping);
+
+    auto const simpleShaping = _level >= DegradationLevel::SimpleShaping
+                            && fontDescriptions_.textShapingMethod == TextShapingMethod::Complex;
+    if (simpleShaping == simpleShaping_)
+        return;
+
+    simpleShaping_ = simpleShaping;
+    if (simpleShaping_ && !simpleTextRenderingEngine_)
+        simpleTextRenderingEngine_ = make_unique<SimpleTextShaper>(
+            gridMetrics_,
+            textShaper_,
+            fonts_,
+            std::bind(&TextRenderer::renderRun, this, _1, _2, _3)
+        );
+
+    // Rows must be shaped again by the text shaper now in use.
+    clearRowCache();
 }
 
 void TextRenderer::setRenderTarget(RenderTarget& _renderTarget)
@@ -115,8 +213,103 @@ void TextRenderer::clearCache()
     monochromeAtlas_ = make_unique<TextureAtlas>(renderTarget().monochromeAtlasAllocator());
     colorAtlas_ = make_unique<TextureAtlas>(renderTarget().coloredAtlasAllocator());
     lcdAtlas_ = make_unique<TextureAtlas>(renderTarget().lcdAtlasAllocator());
+    recentFontVariants_.assign(1, FontVariant{fontDescriptions_.size, fontDescriptions_.dpi});
+    fontDpis_.clear();
+    clearRowCache();
+
+    auto const distanceFields = fontDescriptions_.renderMode == text::render_mode::sdf;
+    distanceFieldGlyphs_ = renderTarget().setDistanceFieldGlyphs(distanceFields) && distanceFields;
+    distanceFieldFonts_.clear();
+    distanceFieldFontFiles_.clear();
+    updateDistanceFieldScale();
 
     textRenderingEngine_->clearCache();
+    if (simpleTextRenderingEngine_)
+        simpleTextRenderingEngine_->clearCache();
+
+    if (rasterizer_)
+        rasterizer_->clear();
+    failedGlyphs_.clear();
+    prefetchPending_ = true;
+    shapingPrefetchPending_ = true;
+
+    // Recreated, as font keys, sizes or DPI may have changed.
+    if (GlyphCache::Available && !fontDescriptions_.glyphCacheDirectory.empty())
+        glyphCache_ = make_unique<GlyphCache>(fontDescriptions_.glyphCacheDirectory,
+                                              textShaper_,
+                                              fontDescriptions_.dpi,
+                                              rasterizationMode());
+    else
+        glyphCache_.reset();
+}
+
+void TextRenderer::trimMemory()
+{
+    textRenderingEngine_->trimMemory();
+    if (simpleTextRenderingEngine_)
+        simpleTextRenderingEngine_->trimMemory();
+    for (auto& row: rowCache_)
+    {
+        row.runs.shrink_to_fit();
+        row.glyphPositions.shrink_to_fit();
+    }
+    rowCache_.shrink_to_fit();
+}
+
+void TextRenderer::gridMetricsChanged()
+{
+    // Glyphs and shaped text are keyed by font (and font size), and fonts are loaded per DPI,
+    // so those of other sizes and DPIs remain valid and merely age in the atlases' LRU order.
+    // Beyond the few most recent ones, they are released right away rather than taking up
+    // atlas space until evicted.
+    auto const variant = FontVariant{fontDescriptions_.size, fontDescriptions_.dpi};
+    auto const sameVariant = [&](FontVariant const& _other) {
+        return _other.size.pt == variant.size.pt && _other.dpi == variant.dpi;
+    };
+
+    if (!recentFontVariants_.empty() && recentFontVariants_.front().dpi != variant.dpi)
+    {
+        // Builtin glyphs are drawn at the cell size, which depends on the DPI, too.
+        monochromeAtlas_->releaseIf([](text::glyph_key const& _key) { return isBuiltinGlyphFont(_key.font); });
+        if (glyphCache_)
+            glyphCache_->setDpi(variant.dpi);
+    }
+
+    recentFontVariants_.erase(remove_if(recentFontVariants_.begin(), recentFontVariants_.end(), sameVariant),
+                              recentFontVariants_.end());
+    recentFontVariants_.insert(recentFontVariants_.begin(), variant);
+
+    while (recentFontVariants_.size() > RetainedFontVariants)
+    {
+        auto const evicted = recentFontVariants_.back();
+        recentFontVariants_.pop_back();
+
+        auto const ofEvictedVariant = [&](text::glyph_key const& _key) {
+            auto const dpi = fontDpis_.find(_key.font);
+            return _key.size.pt == evicted.size.pt && (dpi == fontDpis_.end() || dpi->second == evicted.dpi);
+        };
+        auto const count = monochromeAtlas_->releaseIf(ofEvictedVariant)
+                         + colorAtlas_->releaseIf(ofEvictedVariant)
+                         + lcdAtlas_->releaseIf(ofEvictedVariant);
+        debuglog(TextRendererTag).write("Released {} glyphs of font size {} at DPI {}.", count, evicted.size, evicted.dpi);
+    }
+
+    // Glyph positions depend on the font size.
+    clearRowCache();
+    updateDistanceFieldScale();
+    prefetchPending_ = true;
+    shapingPrefetchPending_ = true;
+}
+
+void TextRenderer::updateDistanceFieldScale()
+{
+    auto const pixelsPerEm = fontDescriptions_.size.pt * static_cast<double>(fontDescriptions_.dpi.y) / 72.0;
+    distanceFieldScale_ = static_cast<float>(pixelsPerEm / text::sdf_em_size);
+}
+
+void TextRenderer::enableAsyncRasterization(std::function<void()> _ready)
+{
+    rasterizer_ = make_unique<GlyphRasterizer>(textShaper_, move(_ready));
 }
 
 void TextRenderer::updateFontMetrics()
@@ -129,43 +322,167 @@ void TextRenderer::updateFontMetrics()
     clearCache();
 }
 
-void TextRenderer::renderCell(RenderCell const& _cell)
+void TextRenderer::clearRowCache()
 {
-    auto const style = [](auto mask) constexpr -> TextStyle {
-        if (contains_all(mask, CellFlags::Bold | CellFlags::Italic))
-            return TextStyle::BoldItalic;
-        if (mask & CellFlags::Bold)
-            return TextStyle::Bold;
-        if (mask & CellFlags::Italic)
-            return TextStyle::Italic;
-        return TextStyle::Regular;
-    }(_cell.flags);
+    rowCacheCounters_.evict(static_cast<uint64_t>(count_if(rowCache_.begin(), rowCache_.end(),
+                                                           [](CachedRow const& _row) { return _row.version != 0; })));
+    rowCache_.clear();
+}
 
-    auto const codepoints = crispy::span(_cell.codepoints.data(), _cell.codepoints.size());
+bool TextRenderer::startRow(int _row, uint64_t _version)
+{
+    auto const index = static_cast<size_t>(_row - 1);
+    if (index >= rowCache_.size())
+        rowCache_.resize(index + 1);
+
+    CachedRow& row = rowCache_[index];
+    if (row.version == _version)
+    {
+        rowCacheCounters_.hit();
+        text::glyph_position const* glyphPositions = row.glyphPositions.data();
+        for (CachedRun const& run: row.runs)
+            renderRun(run.position, crispy::span(glyphPositions + run.first, run.count), run.color);
+        return true;
+    }
+
+    rowCacheCounters_.miss();
+    if (row.version != 0)
+        rowCacheCounters_.evict();
+    rowCacheCounters_.insert();
+    row.version = _version;
+    row.runs.clear();
+    row.glyphPositions.clear();
+    recordingRow_ = index;
+    return false;
+}
+
+void TextRenderer::finishRow()
+{
+    if (!recordingRow_.has_value())
+        return;
+
+    // Text sequences end with their row anyway, this only flushes what a text shaper may still hold.
+    textRenderingEngine().endSequence();
+    recordingRow_.reset();
+}
+
+void TextRenderer::renderCell(RenderCell const& _cell, u32string_view _codepoints)
+{
+    auto const style = textStyleOf(_cell.flags);
+
+    if (fontDescriptions_.builtinBoxDrawing && _codepoints.size() == 1 && isBuiltinGlyph(_codepoints[0]))
+    {
+        renderBuiltinGlyph(_cell, _codepoints[0]);
+        return;
+    }
+
+    auto const codepoints = crispy::span(_codepoints.data(), _codepoints.size());
 
     if (_cell.flags & CellFlags::CellSequenceStart)
-        textRenderingEngine_->setTextPosition(gridMetrics_.map(_cell.position));
+        textRenderingEngine().setTextPosition(gridMetrics_.map(_cell.position));
 
-    textRenderingEngine_->appendCell(codepoints, style, _cell.foregroundColor);
+    textRenderingEngine().appendCell(codepoints, style, _cell.foregroundColor);
 
     if (_cell.flags & CellFlags::CellSequenceEnd)
-        textRenderingEngine_->endSequence();
+        textRenderingEngine().endSequence();
+}
+
+void TextRenderer::renderBuiltinGlyph(RenderCell const& _cell, char32_t _codepoint)
+{
+    // The text sequence is interrupted by this cell, continuing right after it.
+    auto const pos = gridMetrics_.map(_cell.position);
+    textRenderingEngine().endSequence();
+
+    auto const glyph = text::glyph_position{
+        GlyphId{BuiltinGlyphFont, fontDescriptions_.size, text::glyph_index{static_cast<unsigned>(_codepoint)}},
+        crispy::Point{0, 0},
+        crispy::Point{gridMetrics_.cellSize.width, 0}
+    };
+    renderRun(pos, crispy::span(&glyph, 1), _cell.foregroundColor);
+
+    if (!(_cell.flags & CellFlags::CellSequenceEnd))
+        textRenderingEngine().setTextPosition(crispy::Point{pos.x + gridMetrics_.cellSize.width, pos.y});
 }
 
 void TextRenderer::start()
 {
-    textRenderingEngine_->beginFrame();
+    // Glyphs rasterized in the meantime are uploaded along with this frame.
+    if (rasterizer_)
+        for (GlyphRasterizer::Result& result: rasterizer_->fetch())
+        {
+            if (result.bitmap.has_value() && glyphCache_)
+                glyphCache_->put(result.glyph, *result.bitmap);
+
+            if (!result.bitmap.has_value() || !insertGlyph(result.glyph, move(*result.bitmap)).has_value())
+                failedGlyphs_.insert(result.glyph);
+        }
+
+    if (prefetchPending_)
+        prefetchCommonGlyphs();
+
+    glyphsPending_ = false;
+    textRenderingEngine().beginFrame();
 }
 
 void TextRenderer::finish()
 {
-    textRenderingEngine_->endSequence();
+    textRenderingEngine().endSequence();
+}
+
+void TextRenderer::prefetchShaping(RenderBuffer const& _renderBuffer, int _firstRow, int _lastRow)
+{
+    if (!std::exchange(shapingPrefetchPending_, false))
+        return;
+
+    TextShaper& shaper = textRenderingEngine();
+    if (!shaper.beginPrefetch())
+        return;
+
+    CRISPY_PROFILE_ZONE("TextRenderer::prefetchShaping");
+
+    // Text is passed in as by renderCell(), so that it is split into the same sequences.
+    auto row = 0;
+    for (RenderCell const& cell: _renderBuffer.screen)
+    {
+        // Cells are ordered by row.
+        if (cell.position.row < _firstRow)
+            continue;
+        if (cell.position.row > _lastRow)
+            break;
+
+        if (cell.position.row != row)
+        {
+            shaper.endSequence();
+            row = cell.position.row;
+        }
+
+        auto const codepoints = _renderBuffer.codepointsOf(cell);
+        if (fontDescriptions_.builtinBoxDrawing && codepoints.size() == 1 && isBuiltinGlyph(codepoints[0]))
+        {
+            shaper.endSequence();
+            continue;
+        }
+
+        shaper.appendCell(crispy::span(codepoints.data(), codepoints.size()), textStyleOf(cell.flags), cell.foregroundColor);
+        if (cell.flags & CellFlags::CellSequenceEnd)
+            shaper.endSequence();
+    }
+    shaper.endSequence();
+
+    shaper.finishPrefetch();
 }
 
 void TextRenderer::renderRun(crispy::Point _pos,
                              crispy::span<text::glyph_position const> _glyphPositions,
                              RGBColor _color)
 {
+    if (recordingRow_.has_value())
+    {
+        CachedRow& row = rowCache_[*recordingRow_];
+        row.runs.emplace_back(CachedRun{_pos, row.glyphPositions.size(), _glyphPositions.size(), _color});
+        row.glyphPositions.insert(row.glyphPositions.end(), _glyphPositions.begin(), _glyphPositions.end());
+    }
+
     crispy::Point pen = _pos;
     auto const advanceX = gridMetrics_.cellSize.width;
 
@@ -192,6 +509,9 @@ void TextRenderer::renderRun(crispy::Point _pos,
 
 TextRenderer::TextureAtlas& TextRenderer::atlasForFont(text::font_key _font)
 {
+    if (isBuiltinGlyphFont(_font))
+        return *monochromeAtlas_;
+
     if (textShaper_.has_color(_font))
         return *colorAtlas_;
 
@@ -205,26 +525,147 @@ TextRenderer::TextureAtlas& TextRenderer::atlasForFont(text::font_key _font)
         case text::render_mode::light:
         case text::render_mode::gray:
         case text::render_mode::bitmap:
+        case text::render_mode::sdf:
             return *monochromeAtlas_;
     }
 
     return *monochromeAtlas_;
 }
 
+bool TextRenderer::distanceField(text::font_key _font)
+{
+    if (!distanceFieldGlyphs_ || isBuiltinGlyphFont(_font))
+        return false;
+
+    auto i = distanceFieldFonts_.find(_font);
+    if (i == distanceFieldFonts_.end())
+    {
+        // Each font size is loaded from the same file, and the first one loaded keys the glyphs of all.
+        // Fonts are loaded from a file's first face only, so the file identifies the font.
+        optional<text::font_key> key;
+        if (!textShaper_.has_color(_font))
+        {
+            key = _font;
+            if (auto const file = textShaper_.font_file(_font); file.has_value())
+                key = distanceFieldFontFiles_.try_emplace(*file, _font).first->second;
+        }
+        i = distanceFieldFonts_.emplace(_font, key).first;
+    }
+    return i->second.has_value();
+}
+
+GlyphId TextRenderer::atlasKey(GlyphId const& _id)
+{
+    if (!distanceField(_id.font))
+        return _id;
+
+    return GlyphId{*distanceFieldFonts_.at(_id.font), text::font_size{0}, _id.index};
+}
+
 optional<TextRenderer::DataRef> TextRenderer::getTextureInfo(text::glyph_key const& _id)
 {
-    if (auto i = glyphToTextureMapping_.find(_id); i != glyphToTextureMapping_.end())
+    auto const key = atlasKey(_id);
+    if (auto i = glyphToTextureMapping_.find(key); i != glyphToTextureMapping_.end())
         if (TextureAtlas* ta = atlasForBitmapFormat(i->second); ta != nullptr)
-            if (optional<DataRef> const dataRef = ta->get(_id); dataRef.has_value())
+            if (optional<DataRef> const dataRef = ta->get(key); dataRef.has_value())
+            {
+                glyphCacheCounters_.hit();
                 return dataRef;
+            }
+
+    auto const missStart = steady_clock::now();
+    auto const filledIn = [&](optional<DataRef> _dataRef) {
+        glyphCacheCounters_.miss(steady_clock::now() - missStart);
+        return _dataRef;
+    };
 
-    bool const colored = textShaper_.has_color(_id.font);
+    // Glyphs are only ever shaped with fonts of the current DPI.
+    fontDpis_.try_emplace(_id.font, fontDescriptions_.dpi);
 
-    auto theGlyphOpt = textShaper_.rasterize(_id, fontDescriptions_.renderMode);
-    if (!theGlyphOpt.has_value())
+    // Builtin glyphs are drawn faster than they are looked up anywhere else.
+    if (isBuiltinGlyphFont(_id.font))
+        return filledIn(insertGlyph(_id, rasterizeBuiltinGlyph(static_cast<char32_t>(_id.index.value), gridMetrics_)));
+
+    if (glyphCache_)
+        if (auto cachedGlyph = glyphCache_->get(_id); cachedGlyph.has_value())
+            return filledIn(insertGlyph(_id, move(cachedGlyph.value())));
+
+    if (rasterizer_)
+    {
+        // The glyph is left out until rasterized, which will cause another render.
+        if (!failedGlyphs_.count(_id))
+        {
+            rasterizer_->request(_id, rasterizationMode());
+            glyphsPending_ = true;
+        }
+        glyphCacheCounters_.miss();
         return nullopt;
+    }
+
+    auto theGlyphOpt = textShaper_.rasterize(_id, rasterizationMode());
+    if (!theGlyphOpt.has_value())
+        return filledIn(nullopt);
+
+    if (glyphCache_)
+        glyphCache_->put(_id, theGlyphOpt.value());
+
+    return filledIn(insertGlyph(_id, move(theGlyphOpt.value())));
+}
+
+void TextRenderer::prefetchCommonGlyphs()
+{
+    prefetchPending_ = false;
+    if (!rasterizer_)
+        return;
+
+    static constexpr auto CommonCodepoints = array<pair<char32_t, char32_t>, 3>{{
+        { 0x0020, 0x007E }, // printable US-ASCII
+        { 0x00A0, 0x00FF }, // Latin-1 supplement
+        { 0x2500, 0x257F }, // box drawing
+    }};
+
+    auto const inAtlas = [&](GlyphId const& _id) {
+        auto const key = atlasKey(_id);
+        auto const i = glyphToTextureMapping_.find(key);
+        if (i == glyphToTextureMapping_.end())
+            return false;
+        TextureAtlas const* atlas = atlasForBitmapFormat(i->second);
+        return atlas && atlas->contains(key);
+    };
+
+    auto const mode = rasterizationMode();
+    auto count = 0;
+    for (text::font_key const font: { fonts_.regular(), fonts_.bold(), fonts_.italic() })
+        for (auto const& [first, last]: CommonCodepoints)
+            for (char32_t codepoint = first; codepoint <= last; ++codepoint)
+            {
+                // Builtin glyphs are drawn on demand, faster than they are fetched from the worker.
+                if (fontDescriptions_.builtinBoxDrawing && isBuiltinGlyph(codepoint))
+                    continue;
+
+                auto const gpos = textShaper_.shape(font, codepoint);
+                if (!gpos.has_value() || failedGlyphs_.count(gpos->glyph) || inAtlas(gpos->glyph))
+                    continue;
+
+                fontDpis_.try_emplace(gpos->glyph.font, fontDescriptions_.dpi);
+                rasterizer_->prefetch(gpos->glyph, mode);
+                ++count;
+            }
+
+    debuglog(TextRendererTag).write("Prefetching {} common glyphs.", count);
+}
+
+optional<TextRenderer::DataRef> TextRenderer::insertGlyph(GlyphId const& _id, text::rasterized_glyph&& _glyph)
+{
+    bool const colored = !isBuiltinGlyphFont(_id.font) && textShaper_.has_color(_id.font);
+
+    // Distance fields are rasterized at text::sdf_em_size, so the cell's metrics do not apply to them.
+    bool const scalable = distanceField(_id.font);
+    auto const key = atlasKey(_id);
+    if (scalable && monochromeAtlas_->contains(key)) // rasterized for another font size in the meantime
+        return monochromeAtlas_->get(key);
 
-    text::rasterized_glyph& glyph = theGlyphOpt.value();
+    text::rasterized_glyph& glyph = _glyph;
     auto const numCells = colored ? 2 : 1; // is this the only case - with colored := Emoji presentation?
     // FIXME: this `2` is a hack of my bad knowledge. FIXME.
     // As I only know of emojis being colored fonts, and those take up 2 cell with units.
@@ -315,16 +756,16 @@ optional<TextRenderer::DataRef> TextRenderer::getTextureInfo(text::glyph_key con
         return {0, *monochromeAtlas_};
     }(colored, glyph.format); // }}}
 
-    glyphToTextureMapping_[_id] = glyph.format;
+    glyphToTextureMapping_[key] = glyph.format;
 
-    if (yOverflow < 0)
+    if (yOverflow < 0 && !scalable)
     {
         debuglog(TextRendererTag).write("Cropping {} overflowing bitmap rows.", -yOverflow);
         glyph.size.height += yOverflow;
         glyph.position.y += yOverflow;
     }
 
-    if (yMin < 0)
+    if (yMin < 0 && !scalable)
     {
         auto const rowCount = -yMin;
         auto const pixelCount = rowCount * glyph.size.width * text::pixel_size(glyph.format);
@@ -349,7 +790,7 @@ optional<TextRenderer::DataRef> TextRenderer::getTextureInfo(text::glyph_key con
                                         yMin < 0 ? yMin : 0,
                                         glyph);
 
-    return targetAtlas.insert(_id,
+    return targetAtlas.insert(key,
                               glyph.size,
                               glyph.size * ratio,
                               move(glyph.bitmap),
@@ -363,35 +804,31 @@ void TextRenderer::renderTexture(crispy::Point const& _pos,
                                  GlyphMetrics const& _glyphMetrics,
                                  text::glyph_position const& _glyphPos)
 {
-    auto const colored = textShaper_.has_color(_glyphPos.glyph.font);
-
-    if (colored)
-    {
-        auto const x = _pos.x
-                     + _glyphMetrics.bearing.x
-                     + _glyphPos.offset.x
-                     ;
-
-        auto const y = _pos.y;
-
-        renderTexture(crispy::Point{x, y}, _color, _textureInfo);
-    }
-    else
-    {
-        auto const x = _pos.x
-                     + _glyphMetrics.bearing.x
-                     + _glyphPos.offset.x
-                     ;
-
-        auto const y = _pos.y                           // bottom left
-                     + _glyphPos.offset.y               // -> harfbuzz adjustment
-                     + gridMetrics_.baseline            // -> baseline
-                     + _glyphMetrics.bearing.y          // -> bitmap top
-                     - _glyphMetrics.bitmapSize.height  // -> bitmap height
-                     ;
-
-        renderTexture(crispy::Point{x, y}, _color, _textureInfo);
-    }
+    auto const colored = !isBuiltinGlyphFont(_glyphPos.glyph.font) && textShaper_.has_color(_glyphPos.glyph.font);
+
+    // Distance fields are scaled from text::sdf_em_size to the current font size.
+    auto const scalable = distanceField(_glyphPos.glyph.font);
+    auto const scale = scalable ? distanceFieldScale_ : 1.0f;
+    auto const scaled = [scale](int _value) { return static_cast<int>(std::lround(static_cast<float>(_value) * scale)); };
+
+    auto const x = _pos.x
+                 + scaled(_glyphMetrics.bearing.x)
+                 + _glyphPos.offset.x
+                 ;
+
+    auto const y = colored
+                 ? _pos.y
+                 : _pos.y                                       // bottom left
+                   + _glyphPos.offset.y                         // -> harfbuzz adjustment
+                   + gridMetrics_.baseline                      // -> baseline
+                   + scaled(_glyphMetrics.bearing.y)            // -> bitmap top
+                   - scaled(_glyphMetrics.bitmapSize.height)    // -> bitmap height
+                 ;
+
+    // The pen is always at the bottom left of the glyph's cell.
+    // Scaled glyphs are left to textures, as the cell grid renders glyphs at their target size.
+    if (scalable || !gridRenderer_.renderGlyph(_pos, crispy::Point{x, y}, _textureInfo, _color))
+        renderTexture(crispy::Point{x, y}, _color, _textureInfo, scale);
 
 #if 0
     if (crispy::logging_sink::for_debug().enabled())
@@ -407,7 +844,8 @@ void TextRenderer::renderTexture(crispy::Point const& _pos,
 
 void TextRenderer::renderTexture(crispy::Point const& _pos,
                                  RGBAColor const& _color,
-                                 atlas::TextureInfo const& _textureInfo)
+                                 atlas::TextureInfo const& _textureInfo,
+                                 float _scale)
 {
     // TODO: actually make x/y/z all signed (for future work, i.e. smooth scrolling!)
     auto const x = _pos.x;
@@ -419,19 +857,54 @@ void TextRenderer::renderTexture(crispy::Point const& _pos,
         float(_color.blue()) / 255.0f,
         float(_color.alpha()) / 255.0f,
     };
-    textureScheduler().renderTexture({_textureInfo, x, y, z, color});
+    textureScheduler().renderTexture({_textureInfo, x, y, z, color, {}, {}, _scale});
 }
 
 void TextRenderer::debugCache(std::ostream& _textOutput) const
 {
-    std::map<u32string, CacheKey> orderedKeys;
+    textRenderingEngine_->debugCache(_textOutput);
+}
 
-    _textOutput << fmt::format("TextRenderer: {} cache entries:\n", orderedKeys.size());
-    for (auto && [word, key] : orderedKeys)
-    {
-        auto const vword = u32string_view(word);
-        _textOutput << fmt::format("  {}\n", unicode::convert_to<char>(vword));
-    }
+void TextRenderer::collectMemoryUsage(crispy::memory_usage& _usage) const
+{
+    textRenderingEngine_->collectMemoryUsage(_usage);
+    if (simpleTextRenderingEngine_)
+        simpleTextRenderingEngine_->collectMemoryUsage(_usage);
+    textShaper_.collect_memory_usage(_usage);
+
+    auto rowCache = crispy::allocated_bytes(rowCache_);
+    for (auto const& row: rowCache_)
+        rowCache += crispy::allocated_bytes(row.runs) + crispy::allocated_bytes(row.glyphPositions);
+    _usage.add("text.row_cache", rowCache);
+
+    _usage.add("text.glyphs", crispy::hash_table_bytes(glyphToTextureMapping_)
+                            + crispy::hash_table_bytes(failedGlyphs_)
+                            + crispy::hash_table_bytes(fontDpis_));
+
+    auto atlasMetadata = size_t{0};
+    for (auto const* atlas: {monochromeAtlas_.get(), colorAtlas_.get(), lcdAtlas_.get()})
+        if (atlas)
+            atlasMetadata += atlas->memoryUsage();
+    _usage.add("text.atlas_metadata", atlasMetadata);
+}
+
+void TextRenderer::collectCacheStats(crispy::cache_statistics& _stats) const
+{
+    auto rows = size_t{0};
+    for (auto const& row: rowCache_)
+        rows += crispy::allocated_bytes(row.runs) + crispy::allocated_bytes(row.glyphPositions);
+    _stats.add("text.rows", rowCacheCounters_.stats(rows));
+    _stats.add("text.shaping", textRenderingEngine_->cacheStats());
+    _stats.add("text.glyphs", glyphCacheCounters_.stats(crispy::hash_table_bytes(glyphToTextureMapping_)));
+
+    if (monochromeAtlas_)
+        _stats.add("atlas.monochrome", monochromeAtlas_->stats());
+    if (colorAtlas_)
+        _stats.add("atlas.color", colorAtlas_->stats());
+    if (lcdAtlas_)
+        _stats.add("atlas.lcd", lcdAtlas_->stats());
+
+    textShaper_.collect_cache_stats(_stats);
 }
 
 // {{{ ComplexTextShaper
@@ -442,14 +915,66 @@ ComplexTextShaper::ComplexTextShaper(GridMetrics const& _gridMetrics,
     gridMetrics_{ _gridMetrics },
     fonts_{ _fonts },
     textShaper_{ _textShaper },
-    renderGlyphs_{ std::move(_renderGlyphs) }
+    renderGlyphs_{ std::move(_renderGlyphs) },
+    cache_{ ShapingCacheCapacity }
 {
 }
 
 void ComplexTextShaper::clearCache()
 {
-    cacheKeyStorage_.clear();
     cache_.clear();
+    asciiGlyphs_.clear();
+}
+
+void ComplexTextShaper::trimMemory()
+{
+    codepoints_.shrink_to_fit();
+    clusters_.shrink_to_fit();
+}
+
+void ComplexTextShaper::debugCache(std::ostream& _textOutput) const
+{
+    auto const lookups = cache_.hits() + cache_.misses();
+    _textOutput << fmt::format("TextRenderer: {}/{} cache entries, {} hits, {} misses ({:.1f}% hit rate):\n",
+                               cache_.size(),
+                               cache_.capacity(),
+                               cache_.hits(),
+                               cache_.misses(),
+                               lookups ? 100.0 * double(cache_.hits()) / double(lookups) : 0.0);
+    cache_.for_each([&](uint64_t, ShapingCacheEntry const& _entry) {
+        _textOutput << fmt::format("  {}\n", unicode::convert_to<char>(u32string_view(_entry.text)));
+    });
+}
+
+crispy::cache_stats ComplexTextShaper::cacheStats() const
+{
+    auto stats = cache_.stats();
+    cache_.for_each([&](uint64_t, ShapingCacheEntry const& _entry) {
+        stats.bytes += crispy::allocated_bytes(_entry.text) + crispy::allocated_bytes(_entry.glyphPositions);
+    });
+    return stats.with_miss_latency(shapingTime_);
+}
+
+void ComplexTextShaper::collectMemoryUsage(crispy::memory_usage& _usage) const
+{
+    auto cache = cache_.storage_bytes();
+    cache_.for_each_value([&](ShapingCacheEntry const& _entry) {
+        cache += crispy::allocated_bytes(_entry.text) + crispy::allocated_bytes(_entry.glyphPositions);
+    });
+    _usage.add("shaping.cache", cache);
+
+    auto ascii = crispy::hash_table_bytes(asciiGlyphs_) + crispy::allocated_bytes(asciiGlyphPositions_);
+    _usage.add("shaping.ascii", ascii);
+
+    auto buffers = crispy::allocated_bytes(codepoints_)
+                 + crispy::allocated_bytes(clusters_)
+                 + crispy::allocated_bytes(runGlyphPositions_)
+                 + crispy::allocated_bytes(uncachedGlyphPositions_)
+                 + crispy::allocated_bytes(segmentedGlyphPositions_)
+                 + crispy::allocated_bytes(shapedLines_);
+    for (auto const& line: shapedLines_)
+        buffers += crispy::allocated_bytes(line);
+    _usage.add("shaping.buffers", buffers);
 }
 
 void ComplexTextShaper::appendCell(crispy::span<char32_t const> _codepoints,
@@ -487,6 +1012,9 @@ void ComplexTextShaper::beginFrame()
     auto constexpr DefaultColor = RGBColor{};
     style_ = TextStyle::Invalid;
     color_ = DefaultColor;
+
+    CRISPY_PROFILE_COUNTER("shaping cache hit rate (%)",
+                           cache_.hits() ? 100.0 * double(cache_.hits()) / double(cache_.hits() + cache_.misses()) : 0.0);
 }
 
 void ComplexTextShaper::setTextPosition(crispy::Point _position)
@@ -504,7 +1032,8 @@ void ComplexTextShaper::endSequence()
     if (!codepoints_.empty())
     {
         text::shape_result const& glyphPositions = cachedGlyphPositions();
-        renderGlyphs_(textPosition_, crispy::span(glyphPositions.data(), glyphPositions.size()), color_);
+        if (!prefetching_)
+            renderGlyphs_(textPosition_, crispy::span(glyphPositions.data(), glyphPositions.size()), color_);
     }
 
     codepoints_.clear();
@@ -517,47 +1046,248 @@ void ComplexTextShaper::endSequence()
 text::shape_result const& ComplexTextShaper::cachedGlyphPositions()
 {
     auto const codepoints = u32string_view(codepoints_.data(), codepoints_.size());
-    if (auto const cached = cache_.find(TextCacheKey{codepoints, style_}); cached != cache_.end())
-        return cached->second;
+    auto const font = getFontForStyle(fonts_, style_);
 
-    cacheKeyStorage_.emplace_back(u32string{codepoints});
-    auto const cacheKeyFromStorage = TextCacheKey{ cacheKeyStorage_.back(), style_ };
+    // Most text is plain ASCII, which is shaped faster by table lookup than by hash lookup.
+    if (shapeAscii(codepoints, font, asciiGlyphPositions_))
+        return asciiGlyphPositions_;
+
+    if (shapeSegmented(font, segmentedGlyphPositions_))
+        return segmentedGlyphPositions_;
+
+    return cachedGlyphPositions(0, codepoints_.size());
+}
+
+text::shape_result const& ComplexTextShaper::cachedGlyphPositions(size_t _start, size_t _end)
+{
+    auto const codepoints = u32string_view(codepoints_.data() + _start, _end - _start);
+    auto const font = getFontForStyle(fonts_, style_);
+    auto const key = shapingCacheKey(codepoints, style_, font);
+
+    if (prefetching_)
+    {
+        prefetch(key, _start, _end);
+        uncachedGlyphPositions_.clear();
+        return uncachedGlyphPositions_;
+    }
+
+    if (ShapingCacheEntry const* cached = cache_.try_get(key);
+            cached && cached->text == codepoints && cached->style == style_)
+        return cached->glyphPositions;
+
+    auto const missStart = steady_clock::now();
+    if (cacheBypass_)
+    {
+        requestGlyphPositions(_start, _end, uncachedGlyphPositions_);
+        shapingTime_.record(steady_clock::now() - missStart);
+        return uncachedGlyphPositions_;
+    }
+
+    // Evicted entries are reused as they are, so that their buffers are, too.
+    ShapingCacheEntry& entry = cache_.insert(key);
+    entry.text.assign(codepoints);
+    entry.style = style_;
+    requestGlyphPositions(_start, _end, entry.glyphPositions);
+    shapingTime_.record(steady_clock::now() - missStart);
+    return entry.glyphPositions;
+}
+
+bool ComplexTextShaper::beginPrefetch()
+{
+    // Text shaped under rendering pressure is not cached, and thus not worth shaping ahead.
+    if (cacheBypass_)
+        return false;
 
-    return cache_[cacheKeyFromStorage] = requestGlyphPositions();
+    assert(codepoints_.empty());
+    style_ = TextStyle::Invalid;
+    color_ = RGBColor{};
+    prefetching_ = true;
+    return true;
 }
 
-text::shape_result ComplexTextShaper::requestGlyphPositions()
+void ComplexTextShaper::prefetch(uint64_t _key, size_t _start, size_t _end)
 {
-    text::shape_result glyphPositions;
+    auto const codepoints = u32string_view(codepoints_.data() + _start, _end - _start);
+    if (ShapingCacheEntry const* cached = cache_.peek(_key);
+            cached && cached->text == codepoints && cached->style == style_)
+        return;
+
+    // Text beyond the cache's capacity would only evict the text shaped ahead of it.
+    if (prefetched_.size() == cache_.capacity() || !prefetchedKeys_.insert(_key).second)
+        return;
+
+    PrefetchedText& text = prefetched_.emplace_back();
+    text.key = _key;
+    text.style = style_;
+    text.codepoints.assign(codepoints);
+    text.clusters.assign(clusters_.begin() + static_cast<ptrdiff_t>(_start),
+                         clusters_.begin() + static_cast<ptrdiff_t>(_end));
+
     unicode::run_segmenter::range run;
-    auto rs = unicode::run_segmenter(codepoints_.data(), codepoints_.size());
+    auto rs = unicode::run_segmenter(codepoints_.data() + _start, _end - _start);
     while (rs.consume(out(run)))
-        crispy::copy(shapeRun(run), std::back_inserter(glyphPositions));
+        text.runs.push_back(PrefetchedRun{static_cast<size_t>(run.start),
+                                          static_cast<size_t>(run.end),
+                                          fontOf(run),
+                                          get<unicode::Script>(run.properties)});
+}
 
-    return glyphPositions;
+void ComplexTextShaper::finishPrefetch()
+{
+    assert(codepoints_.empty());
+    prefetching_ = false;
+    style_ = TextStyle::Invalid;
+    color_ = RGBColor{};
+
+    auto const shape = [&](size_t _index) {
+        PrefetchedText& text = prefetched_[_index];
+        auto runGlyphPositions = text::shape_result{};
+        for (PrefetchedRun const& run: text.runs)
+        {
+            auto const count = run.end - run.start;
+            textShaper_.shape(run.font,
+                              u32string_view(text.codepoints).substr(run.start, count),
+                              crispy::span(text.clusters.data() + run.start, count),
+                              run.script,
+                              runGlyphPositions);
+            text.glyphPositions.insert(text.glyphPositions.end(), runGlyphPositions.begin(), runGlyphPositions.end());
+        }
+    };
+
+    // Each text is shaped into buffers of its own, so that threads share nothing but the text shaper.
+    if (textShaper_.concurrent_shaping())
+        crispy::thread_pool::shared().parallel_for(prefetched_.size(), shape);
+    else
+        for (size_t i = 0; i < prefetched_.size(); ++i)
+            shape(i);
+
+    debuglog(TextRendererTag).write("Shaped {} text sequences ahead.", prefetched_.size());
+
+    for (PrefetchedText& text: prefetched_)
+    {
+        ShapingCacheEntry& entry = cache_.insert(text.key);
+        entry.text = move(text.codepoints);
+        entry.style = text.style;
+        entry.glyphPositions = move(text.glyphPositions);
+    }
+
+    prefetched_.clear();
+    prefetched_.shrink_to_fit();
+    prefetchedKeys_.clear();
 }
 
-text::shape_result ComplexTextShaper::shapeRun(unicode::run_segmenter::range const& _run)
+bool ComplexTextShaper::shapeSegmented(text::font_key _font, text::shape_result& _result)
+{
+    text::ascii_glyph_table const* table = asciiGlyphTable(_font);
+    if (!table)
+        return false;
+
+    // Context free characters neither take part in ligatures nor affect their neighbors' positions,
+    // so that the text is shaped alike when split around them, unless sharing a cell with combining marks.
+    auto const count = codepoints_.size();
+    auto const breakAt = [&](size_t i) -> text::glyph_position const* {
+        if ((i > 0 && clusters_[i - 1] == clusters_[i]) || (i + 1 < count && clusters_[i + 1] == clusters_[i]))
+            return nullptr;
+        return table->find(codepoints_[i]);
+    };
+
+    auto segmented = false;
+    for (size_t i = 0; i < count && !segmented; ++i)
+        segmented = breakAt(i) != nullptr;
+    if (!segmented)
+        return false;
+
+    _result.clear();
+    size_t start = 0; // of the segment to be shaped next
+    for (size_t i = 0; i <= count; ++i)
+    {
+        text::glyph_position const* gpos = i < count ? breakAt(i) : nullptr;
+        if (i < count && !gpos)
+            continue;
+
+        if (start < i)
+        {
+            text::shape_result const& segment = cachedGlyphPositions(start, i);
+            _result.insert(_result.end(), segment.begin(), segment.end());
+        }
+        if (gpos)
+            _result.emplace_back(*gpos);
+        start = i + 1;
+    }
+
+    return true;
+}
+
+text::ascii_glyph_table const* ComplexTextShaper::asciiGlyphTable(text::font_key _font)
+{
+    auto i = asciiGlyphs_.find(_font);
+    if (i == asciiGlyphs_.end())
+        i = asciiGlyphs_.emplace(_font, textShaper_.ascii_glyphs(_font)).first;
+
+    return i->second.has_value() ? &i->second.value() : nullptr;
+}
+
+bool ComplexTextShaper::shapeAscii(u32string_view _codepoints,
+                                   text::font_key _font,
+                                   text::shape_result& _result)
+{
+    text::ascii_glyph_table const* table = asciiGlyphTable(_font);
+    if (!table)
+        return false;
+
+    _result.clear();
+    for (char32_t const codepoint: _codepoints)
+    {
+        text::glyph_position const* gpos = table->find(codepoint);
+        if (!gpos)
+            return false; // non-ASCII, or possibly forming a ligature with its neighbors
+        _result.emplace_back(*gpos);
+    }
+
+    return true;
+}
+
+void ComplexTextShaper::requestGlyphPositions(size_t _start, size_t _end, text::shape_result& _result)
+{
+    _result.clear();
+
+    unicode::run_segmenter::range run;
+    auto rs = unicode::run_segmenter(codepoints_.data() + _start, _end - _start);
+    while (rs.consume(out(run)))
+    {
+        run.start += _start;
+        run.end += _start;
+        shapeRun(run, runGlyphPositions_);
+        _result.insert(_result.end(), runGlyphPositions_.begin(), runGlyphPositions_.end());
+    }
+}
+
+text::font_key ComplexTextShaper::fontOf(unicode::run_segmenter::range const& _run) const
+{
+    bool const isEmojiPresentation = std::get<unicode::PresentationStyle>(_run.properties) == unicode::PresentationStyle::Emoji;
+    return isEmojiPresentation ? fonts_.emoji() : getFontForStyle(fonts_, style_);
+}
+
+void ComplexTextShaper::shapeRun(unicode::run_segmenter::range const& _run, text::shape_result& _result)
 {
     bool const isEmojiPresentation = std::get<unicode::PresentationStyle>(_run.properties) == unicode::PresentationStyle::Emoji;
 
-    auto const font = isEmojiPresentation ? fonts_.emoji : getFontForStyle(fonts_, style_);
+    auto const font = fontOf(_run);
 
     // TODO(where to apply cell-advances) auto const advanceX = gridMetrics_.cellSize.width;
     auto const count = static_cast<int>(_run.end - _run.start);
     auto const codepoints = u32string_view(codepoints_.data() + _run.start, count);
     auto const clusters = crispy::span(clusters_.data() + _run.start, count);
 
-    text::shape_result gpos;
     textShaper_.shape(
         font,
         codepoints,
         clusters,
         std::get<unicode::Script>(_run.properties),
-        gpos
+        _result
     );
 
-    if (crispy::logging_sink::for_debug().enabled() && !gpos.empty())
+    if (crispy::logging_sink::for_debug().enabled() && !_result.empty())
     {
         auto msg = debuglog(TextRendererTag);
         msg.write("Shaped codepoints: {}", unicode::convert_to<char>(codepoints));
@@ -580,11 +1310,9 @@ text::shape_result ComplexTextShaper::shapeRun(unicode::run_segmenter::range con
         // msg.write("using font: \"{}\" \"{}\" \"{}\"\n", font.familyName(), font.styleName(), font.filePath());
 
         msg.write("with metrics:");
-        for (text::glyph_position const& gp : gpos)
+        for (text::glyph_position const& gp : _result)
             msg.write(" {}", gp);
     }
-
-    return gpos;
 }
 // }}}
 
@@ -642,6 +1370,23 @@ void SimpleTextShaper::endSequence()
     flush();
 }
 
+void SimpleTextShaper::debugCache(std::ostream& _textOutput) const
+{
+    _textOutput << fmt::format("TextRenderer: {} cache entries\n", cache_.size());
+}
+
+void SimpleTextShaper::collectMemoryUsage(crispy::memory_usage& _usage) const
+{
+    auto constexpr ListNodeOverhead = 2 * sizeof(void*);
+    auto cache = crispy::hash_table_bytes(cache_);
+    for (auto const& entry: cache_)
+        cache += crispy::allocated_bytes(entry.second);
+    for (auto const& key: cacheKeyStorage_)
+        cache += sizeof(key) + ListNodeOverhead + crispy::allocated_bytes(key);
+    _usage.add("shaping.cache", cache);
+    _usage.add("shaping.buffers", crispy::allocated_bytes(glyphPositions_));
+}
+
 void SimpleTextShaper::flush()
 {
     if (glyphPositions_.empty())
@@ -14,6 +14,11 @@
 #pragma once
 
 #include <terminal_renderer/Atlas.h>
+#include <terminal_renderer/BuiltinGlyphs.h>
+#include <terminal_renderer/DegradationPolicy.h>
+#include <terminal_renderer/GlyphCache.h>
+#include <terminal_renderer/GlyphRasterizer.h>
+#include <terminal_renderer/GridRenderer.h>
 #include <terminal_renderer/RenderTarget.h>
 
 #include <terminal/Color.h>
@@ -24,6 +29,8 @@
 #include <text_shaper/shaper.h>
 
 #include <crispy/FNV.h>
+#include <crispy/cache_stats.h>
+#include <crispy/lru_cache.h>
 #include <crispy/point.h>
 #include <crispy/size.h>
 #include <crispy/span.h>
@@ -31,9 +38,13 @@
 #include <unicode/run_segmenter.h>
 
 #include <functional>
+#include <iosfwd>
 #include <list>
 #include <memory>
+#include <optional>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace terminal::renderer
@@ -155,6 +166,8 @@ struct FontDescriptions
     text::font_description emoji;
     text::render_mode renderMode;
     TextShapingMethod textShapingMethod;
+    std::string glyphCacheDirectory; // persistent glyph cache location, disabled if empty
+    bool builtinBoxDrawing = true;   // draws box drawing characters and alike instead of using the fonts' glyphs
 };
 
 inline bool operator==(FontDescriptions const& a, FontDescriptions const& b) noexcept
@@ -165,7 +178,8 @@ inline bool operator==(FontDescriptions const& a, FontDescriptions const& b) noe
         && a.italic == b.italic
         && a.boldItalic == b.boldItalic
         && a.emoji == b.emoji
-        && a.renderMode == b.renderMode;
+        && a.renderMode == b.renderMode
+        && a.builtinBoxDrawing == b.builtinBoxDrawing;
 }
 
 inline bool operator!=(FontDescriptions const& a, FontDescriptions const& b) noexcept
@@ -173,12 +187,37 @@ inline bool operator!=(FontDescriptions const& a, FontDescriptions const& b) noe
     return !(a == b);
 }
 
-struct FontKeys {
-    text::font_key regular;
-    text::font_key bold;
-    text::font_key italic;
-    text::font_key boldItalic;
-    text::font_key emoji;
+/// Font keys of the configured fonts.
+///
+/// Only the regular font is loaded upfront, as it defines the grid metrics.
+/// The others are loaded on first use, as most sessions never show e.g. italic text.
+class FontKeys {
+  public:
+    FontKeys(FontDescriptions const& _descriptions, text::shaper& _shaper);
+
+    FontKeys(FontKeys const&) = delete;
+    FontKeys& operator=(FontKeys const&) = delete;
+
+    /// (Re-)loads the regular font and forgets about the others, e.g. after the font descriptions changed.
+    void reload();
+
+    text::font_key regular() const noexcept { return regular_; }
+    text::font_key bold() const { return get(bold_, descriptions_.bold); }
+    text::font_key italic() const { return get(italic_, descriptions_.italic); }
+    text::font_key boldItalic() const { return get(boldItalic_, descriptions_.boldItalic); }
+    text::font_key emoji() const { return get(emoji_, descriptions_.emoji); }
+
+  private:
+    /// @returns the key of the given font, loading it if not done yet, or the regular font if it failed to load.
+    text::font_key get(std::optional<text::font_key>& _key, text::font_description const& _description) const;
+
+    FontDescriptions const& descriptions_;
+    text::shaper& shaper_;
+    text::font_key regular_{};
+    mutable std::optional<text::font_key> bold_;
+    mutable std::optional<text::font_key> italic_;
+    mutable std::optional<text::font_key> boldItalic_;
+    mutable std::optional<text::font_key> emoji_;
 };
 
 // {{{ TextShaper
@@ -194,6 +233,9 @@ public:
 
     virtual void clearCache() = 0;
 
+    /// Gives back the memory of scratch buffers grown by long runs of text.
+    virtual void trimMemory() = 0;
+
     virtual void beginFrame() = 0;
 
     virtual void setTextPosition(crispy::Point _position) = 0;
@@ -207,6 +249,28 @@ public:
 
     /// Marks the end of a consecutive sequence of text.
     virtual void endSequence() = 0;
+
+    /// Starts collecting the text sequences passed in until finishPrefetch(), instead of rendering them.
+    ///
+    /// @returns false if the text shaper does not shape ahead, in which case nothing is to be passed in.
+    virtual bool beginPrefetch() = 0;
+
+    /// Shapes the text collected since beginPrefetch() that is not in the shaping cache yet,
+    /// in parallel if supported by the underlying text::shaper, and adds it to the cache.
+    virtual void finishPrefetch() = 0;
+
+    /// Has text not found in the shaping cache be shaped without adding it to the cache,
+    /// as under rendering pressure most text is only seen for a single frame.
+    virtual void setCacheBypass(bool _bypass) = 0;
+
+    /// Writes human readable cache statistics to @p _textOutput.
+    virtual void debugCache(std::ostream& _textOutput) const = 0;
+
+    /// @returns the effectiveness of the shaping cache, if it keeps track of it.
+    virtual crispy::cache_stats cacheStats() const = 0;
+
+    /// Accounts the memory held by the shaping caches to @p _usage.
+    virtual void collectMemoryUsage(crispy::memory_usage& _usage) const = 0;
 };
 
 // Fully featured Text shaping pipeline.
@@ -219,6 +283,7 @@ public:
                       RenderGlyphs _renderGlyphs);
 
     void clearCache() override;
+    void trimMemory() override;
 
     void beginFrame() override;
     void setTextPosition(crispy::Point _position) override;
@@ -226,13 +291,41 @@ public:
                     TextStyle _style,
                     RGBColor _color) override;
     void endSequence() override;
+    bool beginPrefetch() override;
+    void finishPrefetch() override;
+    void setCacheBypass(bool _bypass) override { cacheBypass_ = _bypass; }
+    void debugCache(std::ostream& _textOutput) const override;
+    crispy::cache_stats cacheStats() const override;
+    void collectMemoryUsage(crispy::memory_usage& _usage) const override;
 
 private:
     // helper functions
     //
     text::shape_result const& cachedGlyphPositions();
-    text::shape_result requestGlyphPositions();
-    text::shape_result shapeRun(unicode::run_segmenter::range const& _run);
+
+    /// @returns the glyph positions of the codepoints [_start, _end) of the current sequence,
+    ///          from the shaping cache if possible.
+    text::shape_result const& cachedGlyphPositions(size_t _start, size_t _end);
+
+    /// Shapes the current sequence in segments, separated by cells of a single context free
+    /// US-ASCII character, which are looked up rather than shaped. Each segment in between is
+    /// shaped and cached on its own, so that changing a few cells of a long sequence, such as
+    /// a clock in a status line or a progress bar, only reshapes the segment around them.
+    ///
+    /// @returns false if the sequence has no such cells to be segmented at.
+    bool shapeSegmented(text::font_key _font, text::shape_result& _result);
+
+    text::ascii_glyph_table const* asciiGlyphTable(text::font_key _font);
+    bool shapeAscii(std::u32string_view _codepoints, text::font_key _font, text::shape_result& _result);
+    void requestGlyphPositions(size_t _start, size_t _end, text::shape_result& _result);
+    void shapeRun(unicode::run_segmenter::range const& _run, text::shape_result& _result);
+
+    /// @returns the font the run @p _run of the current sequence is shaped with.
+    text::font_key fontOf(unicode::run_segmenter::range const& _run) const;
+
+    /// Collects the codepoints [_start, _end) of the current sequence to be shaped by finishPrefetch(),
+    /// unless cached or collected already.
+    void prefetch(uint64_t _key, size_t _start, size_t _end);
 
     // fonts, text shaper, and grid metrics
     //
@@ -252,10 +345,44 @@ private:
     int cellCount_ = 0;
     bool textStartFound_ = false;
 
-    // text shaping cache
+    // text shaping cache, keyed by a hash of (codepoints, style, font)
     //
-    std::list<std::u32string> cacheKeyStorage_;
-    std::unordered_map<TextCacheKey, text::shape_result> cache_;
+    struct ShapingCacheEntry {
+        std::u32string text;                // verifies hash hits, buffer reused after eviction
+        TextStyle style = TextStyle::Invalid;
+        text::shape_result glyphPositions;  // buffer reused after eviction
+    };
+    crispy::lru_cache<ShapingCacheEntry> cache_;
+    crispy::latency_histogram shapingTime_;  // of text missing in the cache, see cacheStats()
+    text::shape_result runGlyphPositions_;  // scratch buffer for shaping a single run
+    text::shape_result uncachedGlyphPositions_; // shaped text not added to the cache, see setCacheBypass()
+    bool cacheBypass_ = false;
+
+    // text shaping bypass for printable US-ASCII text
+    //
+    std::unordered_map<text::font_key, std::optional<text::ascii_glyph_table>> asciiGlyphs_;
+    text::shape_result asciiGlyphPositions_;
+    text::shape_result segmentedGlyphPositions_; // see shapeSegmented()
+
+    // text collected to be shaped ahead, see beginPrefetch()
+    //
+    struct PrefetchedRun {
+        size_t start;                       // into PrefetchedText::codepoints
+        size_t end;
+        text::font_key font;
+        unicode::Script script;
+    };
+    struct PrefetchedText {
+        uint64_t key;                       // into the shaping cache
+        TextStyle style;
+        std::u32string codepoints;
+        std::vector<int> clusters;
+        std::vector<PrefetchedRun> runs;    // resolved upfront, as fonts are loaded on first use
+        text::shape_result glyphPositions;
+    };
+    std::vector<PrefetchedText> prefetched_;
+    std::unordered_set<uint64_t> prefetchedKeys_;
+    bool prefetching_ = false;
 
     // output fields
     //
@@ -270,10 +397,17 @@ public:
                      FontKeys const& _fonts,
                      RenderGlyphs _renderGlyphs);
     void clearCache() override {};
+    void trimMemory() override {}
     void beginFrame() override {};
     void setTextPosition(crispy::Point _position) override;
     void appendCell(crispy::span<char32_t const> _codepoints, TextStyle _style, RGBColor _color) override;
     void endSequence() override;
+    bool beginPrefetch() override { return false; }
+    void finishPrefetch() override {}
+    void setCacheBypass(bool) override {}
+    void debugCache(std::ostream& _textOutput) const override;
+    crispy::cache_stats cacheStats() const override { return {}; }
+    void collectMemoryUsage(crispy::memory_usage& _usage) const override;
 
     text::shape_result cachedGlyphPositions(crispy::span<char32_t const> _codepoints, TextStyle _style);
     void flush();
@@ -304,32 +438,94 @@ class TextRenderer : public Renderable {
     TextRenderer(GridMetrics const& _gridMetrics,
                  text::shaper& _textShaper,
                  FontDescriptions& _fontDescriptions,
-                 FontKeys const& _fontKeys);
+                 FontKeys const& _fontKeys,
+                 GridRenderer& _gridRenderer);
 
     void setRenderTarget(RenderTarget& _renderTarget) override;
     void clearCache() override;
+    void trimMemory() override;
+
+    /// Keeps the glyphs of the most recently used font sizes and DPIs, so that zooming back to them,
+    /// or moving the window back to the screen it was on, is instant.
+    void gridMetricsChanged() override;
 
     void updateFontMetrics();
 
-    void setPressure(bool _pressure) noexcept { pressure_ = _pressure; }
+    /// Gives up text rendering features according to @p _level, see DegradationLevel.
+    ///
+    /// Must be called between frames only.
+    void setDegradationLevel(DegradationLevel _level);
+
+    /// Rasterizes glyphs that are missing in the texture atlas on a worker thread.
+    ///
+    /// Until available, frames are rendered without them,
+    /// and @p _ready is invoked from the worker thread to have the frame rendered again.
+    ///
+    /// Glyphs of commonly used characters are also rasterized ahead of their first use,
+    /// whenever the fonts or the font size changed, see prefetchCommonGlyphs().
+    void enableAsyncRasterization(std::function<void()> _ready);
 
     void start();
-    void renderCell(RenderCell const& _cell);
+
+    /// Starts rendering the text of the given viewport row, whose contents is identified
+    /// by @p _version (see RenderBuffer::rowVersions).
+    ///
+    /// @returns true if the row's text has been rendered from the glyph positions it was rendered
+    ///          with the last time, as its contents did not change since. Its cells must not be
+    ///          passed to renderCell() then.
+    bool startRow(int _row, uint64_t _version);
+
+    /// Finishes rendering the text of the row passed to startRow(), remembering its glyph positions.
+    void finishRow();
+
+    void renderCell(RenderCell const& _cell, std::u32string_view _codepoints);
     void finish();
 
+    /// Shapes the text of the rows @p _firstRow to @p _lastRow of @p _renderBuffer ahead of rendering
+    /// them, if the shaping cache has been emptied, e.g. as the fonts or the font size changed.
+    ///
+    /// The text sequences, which are independent of each other, are then shaped all at once
+    /// on multiple threads, rather than one after the other as their cells are rendered.
+    void prefetchShaping(RenderBuffer const& _renderBuffer, int _firstRow, int _lastRow);
+
+    /// @returns whether glyphs were left out of the current frame, as they are still being rasterized.
+    bool glyphsPending() const noexcept { return glyphsPending_; }
+
     void debugCache(std::ostream& _textOutput) const;
 
+    /// Reports the effectiveness of the row cache (see startRow()), the shaping cache,
+    /// the glyph lookups and the texture atlases, and those of the text shaper, to @p _stats.
+    void collectCacheStats(crispy::cache_statistics& _stats) const;
+
+    /// Accounts the memory held by the shaping and glyph caches, including those
+    /// of the text shaper, to @p _usage.
+    void collectMemoryUsage(crispy::memory_usage& _usage) const;
+
   private:
     void setTextShapingMethod(TextShapingMethod _method);
 
+    /// Forgets the rows rendered, counting them as evicted.
+    void clearRowCache();
+
+    /// @returns the text shaper in use, which may be the simple one under rendering pressure.
+    TextShaper& textRenderingEngine() noexcept
+    {
+        return simpleShaping_ && simpleTextRenderingEngine_ ? *simpleTextRenderingEngine_ : *textRenderingEngine_;
+    }
+
     void renderRun(crispy::Point _startPos,
                    crispy::span<text::glyph_position const> _glyphPositions,
                    RGBColor _color);
 
-    /// Renders an arbitrary texture.
+    /// Renders the cell @p _cell, holding the builtin glyph of @p _codepoint (see isBuiltinGlyph()),
+    /// bypassing the text shaper.
+    void renderBuiltinGlyph(RenderCell const& _cell, char32_t _codepoint);
+
+    /// Renders an arbitrary texture, scaled by @p _scale.
     void renderTexture(crispy::Point const& _pos,
                        RGBAColor const& _color,
-                       atlas::TextureInfo const& _textureInfo);
+                       atlas::TextureInfo const& _textureInfo,
+                       float _scale = 1.0f);
 
     // rendering
     //
@@ -343,6 +539,30 @@ class TextRenderer : public Renderable {
     using DataRef = TextureAtlas::DataRef;
 
     std::optional<DataRef> getTextureInfo(GlyphId const& _id);
+    std::optional<DataRef> insertGlyph(GlyphId const& _id, text::rasterized_glyph&& _glyph);
+
+    /// Has the glyphs of printable US-ASCII, Latin-1 and box drawing characters of the regular, bold
+    /// and italic fonts rasterized on the worker thread, unless in the texture atlases already.
+    ///
+    /// Their codepoints are mapped to glyphs right here, which is cheap compared to rasterizing them.
+    void prefetchCommonGlyphs();
+
+    /// @returns the render mode glyphs are rasterized with.
+    text::render_mode rasterizationMode() const noexcept
+    {
+        return fontDescriptions_.renderMode == text::render_mode::sdf && !distanceFieldGlyphs_
+             ? text::render_mode::gray
+             : fontDescriptions_.renderMode;
+    }
+
+    /// @returns whether the glyphs of @p _font are rendered from distance fields.
+    bool distanceField(text::font_key _font);
+
+    /// @returns the key the glyph @p _id is held in the atlas under,
+    ///          which is the same for all font sizes if rendered from a distance field.
+    GlyphId atlasKey(GlyphId const& _id);
+
+    void updateDistanceFieldScale();
 
     void renderTexture(crispy::Point const& _pos,
                        RGBAColor const& _color,
@@ -357,10 +577,12 @@ class TextRenderer : public Renderable {
     GridMetrics const& gridMetrics_;
     FontDescriptions& fontDescriptions_;
     FontKeys const& fonts_;
+    GridRenderer& gridRenderer_; // takes over glyphs fitting into the cell grid, if active
 
     // performance optimizations
     //
-    bool pressure_ = false;
+    DegradationLevel degradationLevel_ = DegradationLevel::None;
+    bool simpleShaping_ = false;
 
     std::unordered_map<text::glyph_key, text::bitmap_format> glyphToTextureMapping_;
 
@@ -381,8 +603,50 @@ class TextRenderer : public Renderable {
     std::unique_ptr<TextureAtlas> monochromeAtlas_;
     std::unique_ptr<TextureAtlas> colorAtlas_;
     std::unique_ptr<TextureAtlas> lcdAtlas_;
+    struct FontVariant {
+        text::font_size size;
+        crispy::Point dpi;
+    };
+    std::vector<FontVariant> recentFontVariants_;   // font sizes and DPIs with glyphs in the atlases, most recently used first
+    std::unordered_map<text::font_key, crispy::Point> fontDpis_; // DPI each font with glyphs in the atlases has been loaded at
 
     std::unique_ptr<TextShaper> textRenderingEngine_;
+    std::unique_ptr<TextShaper> simpleTextRenderingEngine_; // fallback under rendering pressure, if complex shaping is configured
+
+    // glyph positions of each viewport row as rendered the last time, emitted again while unchanged
+    //
+    struct CachedRun {
+        crispy::Point position;
+        size_t first;                           // index into CachedRow::glyphPositions
+        size_t count;
+        RGBColor color;
+    };
+    struct CachedRow {
+        uint64_t version = 0;                   // RenderBuffer::rowVersions value, 0 if none
+        std::vector<CachedRun> runs;
+        text::shape_result glyphPositions;
+    };
+    std::vector<CachedRow> rowCache_;           // indexed by viewport row
+    crispy::cache_counters rowCacheCounters_;
+    crispy::cache_counters glyphCacheCounters_; // lookups of glyphs in the texture atlases
+    std::optional<size_t> recordingRow_;        // index of the row whose runs are being recorded
+
+    // asynchronous rasterization
+    //
+    std::unique_ptr<GlyphRasterizer> rasterizer_;
+    std::unordered_set<text::glyph_key> failedGlyphs_; // glyphs that could not be rasterized or inserted
+    bool glyphsPending_ = false;
+    bool prefetchPending_ = false;                  // common glyphs to be prefetched with the next frame
+    bool shapingPrefetchPending_ = false;           // text to be shaped ahead with the next frame, see prefetchShaping()
+
+    std::unique_ptr<GlyphCache> glyphCache_;
+
+    // glyphs rendered from signed distance fields, which are shared by all font sizes
+    //
+    bool distanceFieldGlyphs_ = false;      // configured and supported by the render target
+    float distanceFieldScale_ = 1.0f;       // from text::sdf_em_size to the current font size
+    std::unordered_map<text::font_key, std::optional<text::font_key>> distanceFieldFonts_; // font keying the glyphs of each, if not a color font
+    std::unordered_map<std::string, text::font_key> distanceFieldFontFiles_; // first font loaded from each file
 };
 
 } // end namespace
@@ -0,0 +1,186 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2021 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_renderer/GridMetrics.h>
+#include <terminal_renderer/TextRenderer.h>
+
+#include <text_shaper/shaper.h>
+
+#include <crispy/benchmark.h>
+
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace terminal::renderer;
+using namespace std::string_view_literals;
+using terminal::RGBColor;
+using crispy::benchmark::do_not_optimize;
+using std::optional;
+using std::u32string;
+using std::vector;
+
+namespace // {{{ helper
+{
+    auto constexpr CellWidth = 10;
+    auto constexpr LineWidth = size_t{80};
+
+    /// Text shaper positioning one glyph per codepoint, so that only the shaping pipeline
+    /// in front of it, such as its cache, is measured.
+    class StubShaper : public text::shaper {
+      public:
+        explicit StubShaper(bool _asciiTable): asciiTable_{ _asciiTable } {}
+
+        void set_dpi(crispy::Point) override {}
+        void clear_cache() override {}
+
+        optional<text::font_key> load_font(text::font_description const&, text::font_size) override
+        {
+            return text::font_key{ nextFontKey_++ };
+        }
+
+        text::font_metrics metrics(text::font_key) const override { return { 20, CellWidth, 16, 4, 2, 1 }; }
+
+        void shape(text::font_key _font,
+                   std::u32string_view _text,
+                   crispy::span<int>,
+                   unicode::Script,
+                   text::shape_result& _result) override
+        {
+            _result.clear();
+            for (char32_t const codepoint: _text)
+                _result.emplace_back(position(_font, codepoint));
+        }
+
+        optional<text::glyph_position> shape(text::font_key _font, char32_t _codepoint) override
+        {
+            return position(_font, _codepoint);
+        }
+
+        optional<text::ascii_glyph_table> ascii_glyphs(text::font_key _font) override
+        {
+            if (!asciiTable_)
+                return std::nullopt;
+            auto table = text::ascii_glyph_table{};
+            for (char32_t ch = table.first; ch <= table.last; ++ch)
+                table.glyphs[ch - table.first] = position(_font, ch);
+            table.context_free.set();
+            return table;
+        }
+
+        optional<text::rasterized_glyph> rasterize(text::glyph_key, text::render_mode) override { return std::nullopt; }
+        bool has_color(text::font_key) const override { return false; }
+        optional<std::string> font_file(text::font_key) const override { return std::nullopt; }
+        void collect_memory_usage(crispy::memory_usage&) const override {}
+
+      private:
+        static text::glyph_position position(text::font_key _font, char32_t _codepoint)
+        {
+            return text::glyph_position{
+                text::glyph_key{ _font, text::font_size{ 12 }, text::glyph_index{ static_cast<unsigned>(_codepoint) } },
+                crispy::Point{},
+                crispy::Point{ CellWidth, 0 }
+            };
+        }
+
+        bool asciiTable_;
+        unsigned nextFontKey_ = 1;
+    };
+
+    /// ComplexTextShaper along with everything it refers to.
+    struct Fixture {
+        explicit Fixture(bool _asciiTable):
+            shaper{ _asciiTable },
+            fonts{ descriptions, shaper },
+            metrics{ gridMetrics() },
+            textShaper{ metrics, shaper, fonts, [](crispy::Point, crispy::span<text::glyph_position const> _glyphs, RGBColor) {
+                do_not_optimize(_glyphs.size());
+            } }
+        {}
+
+        /// Shapes @p _line the way the renderer does with a grid line, one cell at a time.
+        void shapeLine(u32string const& _line)
+        {
+            textShaper.beginFrame();
+            textShaper.setTextPosition(crispy::Point{});
+            for (char32_t const& codepoint: _line)
+                textShaper.appendCell(crispy::span(&codepoint, 1), TextStyle::Regular, RGBColor{});
+            textShaper.endSequence();
+        }
+
+        static GridMetrics gridMetrics()
+        {
+            auto metrics = GridMetrics{};
+            metrics.pageSize = crispy::Size{ static_cast<int>(LineWidth), 25 };
+            metrics.cellSize = crispy::Size{ CellWidth, 20 };
+            return metrics;
+        }
+
+        StubShaper shaper;
+        FontDescriptions descriptions{};
+        FontKeys fonts;
+        GridMetrics metrics;
+        ComplexTextShaper textShaper;
+    };
+
+    /// @returns @p _count lines of words made up of @p _letters.
+    vector<u32string> randomLines(std::mt19937& _rng, size_t _count, std::u32string_view _letters)
+    {
+        auto letter = std::uniform_int_distribution<size_t>(0, _letters.size() - 1);
+        auto wordLength = std::uniform_int_distribution<int>(1, 10);
+        auto lines = vector<u32string>(_count);
+        for (u32string& line: lines)
+        {
+            while (line.size() < LineWidth)
+            {
+                for (auto n = wordLength(_rng); n > 0 && line.size() < LineWidth; --n)
+                    line.push_back(_letters[letter(_rng)]);
+                if (line.size() < LineWidth)
+                    line.push_back(U' ');
+            }
+        }
+        return lines;
+    }
+} // }}}
+
+// Shapes one line per iteration, with each word being looked up on its own.
+CRISPY_BENCHMARK("ComplexTextShaper")
+{
+    auto constexpr AsciiLetters = U"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789"sv;
+    auto constexpr NonAsciiLetters = U"aeiouäöüßéèêçñøå"sv;
+    size_t i = 0;
+
+    // Printable US-ASCII text, shaped by table lookup.
+    {
+        auto fixture = Fixture(true);
+        auto const lines = randomLines(_bench.rng(), 64, AsciiLetters);
+        _bench.measure("ascii", [&]() { fixture.shapeLine(lines[i++ % lines.size()]); });
+    }
+
+    // Few lines, recurring: all words are found in the shaping cache once warmed up.
+    {
+        auto fixture = Fixture(false);
+        auto const lines = randomLines(_bench.rng(), 64, NonAsciiLetters);
+        _bench.measure("hit", [&]() { fixture.shapeLine(lines[i++ % lines.size()]); });
+    }
+
+    // Many more words than the shaping cache holds: words are evicted before they recur.
+    for (bool const bypass: {false, true})
+    {
+        auto fixture = Fixture(false);
+        fixture.textShaper.setCacheBypass(bypass);
+        auto const lines = randomLines(_bench.rng(), 4096, NonAsciiLetters);
+        _bench.measure(bypass ? "miss/bypass" : "miss", [&]() { fixture.shapeLine(lines[i++ % lines.size()]); });
+    }
+}
@@ -2,8 +2,11 @@
 
 #include <crispy/debuglog.h>
 
+#include <fmt/format.h>
+
 #include <algorithm>
 #include <string>
+#include <unordered_map>
 
 // {{{ TODO: replace with libunicode
 #include <codecvt>
@@ -24,6 +27,7 @@ using std::move;
 using std::nullopt;
 using std::optional;
 using std::pair;
+using std::string;
 using std::wstring;
 
 namespace text {
@@ -77,10 +81,16 @@ struct FontInfo
 struct directwrite_shaper::Private
 {
     ComPtr<IDWriteFactory7> factory;
+    ComPtr<IDWriteFontCollection> fontCollection;   // system fonts, queried once
+    ComPtr<IDWriteTextAnalyzer> textAnalyzer;       // shared by all shape() calls
     crispy::Point dpi_;
     std::wstring userLocale;
     std::unordered_map<font_key, FontInfo> fonts;
 
+    // Loaded fonts by formatted font description and size, or none if not found,
+    // sparing the font collection lookups when the same font is requested again.
+    std::unordered_map<string, optional<font_key>> fontKeys;
+
     font_key nextFontKey;
 
     Private(crispy::Point _dpi) :
@@ -89,11 +99,15 @@ struct directwrite_shaper::Private
         auto hr = DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED,
                                       __uuidof(IDWriteFactory7),
                                       reinterpret_cast<IUnknown**>(factory.GetAddressOf()));
+        factory->GetSystemFontCollection(fontCollection.GetAddressOf());
+        factory->CreateTextAnalyzer(textAnalyzer.GetAddressOf());
         wchar_t locale[LOCALE_NAME_MAX_LENGTH];
         GetUserDefaultLocaleName(locale, sizeof(locale));
         userLocale = locale;
     }
 
+    optional<font_key> load_font(font_description const& _description, font_size _size);
+
     font_key create_font_key()
     {
         auto result = nextFontKey;
@@ -131,37 +145,31 @@ directwrite_shaper::directwrite_shaper(crispy::Point _dpi) :
 
 optional<font_key> directwrite_shaper::load_font(font_description const& _description, font_size _size)
 {
-    debuglog(FontFallbackTag).write("Loading font chain for: {}", _description);
+    auto const cacheKey = fmt::format("{} {}", _description, _size);
+    if (auto i = d->fontKeys.find(cacheKey); i != d->fontKeys.end())
+        return i->second;
+
+    auto key = d->load_font(_description, _size);
+    d->fontKeys.emplace(pair{cacheKey, key});
+    return key;
+}
 
-    IDWriteFontCollection* fontCollection{};
-    d->factory->GetSystemFontCollection(&fontCollection);
+optional<font_key> directwrite_shaper::Private::load_font(font_description const& _description, font_size _size)
+{
+    debuglog(FontFallbackTag).write("Loading font chain for: {}", _description);
 
     // TODO: use libunicode for that (TODO: create wchar_t/char16_t converters in libunicode)
     std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> wStringConverter;
     std::wstring familyName = wStringConverter.from_bytes(_description.familyName);
 
-    for (UINT32 i = 0, e = fontCollection->GetFontFamilyCount(); i < e; ++i)
+    // Matches the family name in any locale, rather than enumerating all installed families.
+    UINT32 familyIndex{};
+    BOOL exists = FALSE;
+    fontCollection->FindFamilyName(familyName.c_str(), &familyIndex, &exists);
+    if (exists)
     {
-        IDWriteFontFamily* family{};
-        fontCollection->GetFontFamily(i, &family);
-
-        IDWriteLocalizedStrings* names;
-        family->GetFamilyNames(&names);
-
-        BOOL exists = FALSE;
-        unsigned index{};
-        names->FindLocaleName(d->userLocale.c_str(), &index, &exists);
-
-        wchar_t name[64];
-        if (exists)
-            names->GetString(index, name, _countof(name));
-        else
-            // TODO: there was a different way of fallback that I have a tab open on
-            // one of my smartphones. Please find me.
-            names->GetString(i, name, sizeof(name));
-
-        if (familyName != name)
-            continue;
+        ComPtr<IDWriteFontFamily> family;
+        fontCollection->GetFontFamily(familyIndex, family.GetAddressOf());
 
         for (UINT32 k = 0, ke = family->GetFontCount(); k < ke; ++k)
         {
@@ -173,7 +181,7 @@ optional<font_key> directwrite_shaper::load_font(font_description const& _descri
                 continue;
 
             font_slant slant = dwFontSlant(font->GetStyle());
-            if (weight != _description.weight)
+            if (slant != _description.slant)
                 continue;
 
             ComPtr<IDWriteFontFace> fontFace;
@@ -193,13 +201,13 @@ optional<font_key> directwrite_shaper::load_font(font_description const& _descri
             fontInfo.metrics.descender = int(ceil(dwMetrics.descent * dipScalar));
             fontInfo.metrics.underline_position = int(ceil(dwMetrics.underlinePosition * dipScalar));
             fontInfo.metrics.underline_thickness = int(ceil(dwMetrics.underlineThickness * dipScalar));
-            fontInfo.metrics.advance = int(ceil(d->computeAverageAdvance(fontFace.Get()) * dipScalar));
+            fontInfo.metrics.advance = int(ceil(computeAverageAdvance(fontFace.Get()) * dipScalar));
 
             font.As(&fontInfo.font);
             fontFace.As(&fontInfo.fontFace);
 
-            auto key = d->create_font_key();
-            d->fonts.emplace(pair{key, move(fontInfo)});
+            auto key = create_font_key();
+            fonts.emplace(pair{key, move(fontInfo)});
 
             return key;
         }
@@ -209,12 +217,12 @@ optional<font_key> directwrite_shaper::load_font(font_description const& _descri
 
 #if 0
     IDWriteFontFallbackBuilder* ffb{};
-    d->factory->CreateFontFallbackBuilder(&ffb);
+    factory->CreateFontFallbackBuilder(&ffb);
     IDWriteFontFallback* ff;
     ffb->CreateFontFallback(&ff);
 
     IDWriteTextAnalyzer* textAnalyzer{};
-    d->factory->CreateTextAnalyzer(&textAnalyzer);//?
+    factory->CreateTextAnalyzer(&textAnalyzer);//?
     textAnalyzer->Release();
 
     IDWriteTextAnalysisSource *analysisSource;
@@ -239,7 +247,7 @@ optional<font_key> directwrite_shaper::load_font(font_description const& _descri
     // UINT32 faceIndex = 0;
     // DWRITE_FONT_SIMULATIONS fontFaceSimulationFlags;
     // IDWriteFontFace *fontFace{};
-    // d->factory->CreateFontFace();
+    // factory->CreateFontFace();
 
     // DWRITE_FONT_FACE_TYPE fontFaceType;
     // UINT32 numberOfFiles;
@@ -247,7 +255,7 @@ optional<font_key> directwrite_shaper::load_font(font_description const& _descri
     // UINT32 faceIndex;
     // DWRITE_FONT_SIMULATIONS fontFaceSimulationFlags;
     // IDWriteFontFace **fontFace = nullptr;
-    // d->factory->CreateFontFace(fontFaceType, numberOfFiles, fontFiles, faceIndex, fontFaceSimulationFlags, fontFace);
+    // factory->CreateFontFace(fontFaceType, numberOfFiles, fontFiles, faceIndex, fontFaceSimulationFlags, fontFace);
     printf("done\n");
     return nullopt;
 #endif
@@ -265,8 +273,7 @@ void directwrite_shaper::shape(font_key _font,
                                unicode::Script _script,
                                shape_result& _result)
 {
-    ComPtr<IDWriteTextAnalyzer> analyzer;
-    d->factory->CreateTextAnalyzer(analyzer.GetAddressOf());
+    IDWriteTextAnalyzer* analyzer = d->textAnalyzer.Get();
 
     // WCHAR const *textString = L""; // TODO
     // UINT32 textLength; // TODO
@@ -312,6 +319,12 @@ void directwrite_shaper::shape(font_key _font,
 
 }
 
+std::optional<ascii_glyph_table> directwrite_shaper::ascii_glyphs(font_key /*_font*/)
+{
+    // Unsupported for as long as shape() is, as the table must match what it would produce.
+    return nullopt;
+}
+
 std::optional<rasterized_glyph> directwrite_shaper::rasterize(glyph_key _glyph, render_mode _mode)
 {
     // TODO: specialize IDWriteTextRenderer to render to bitmap
@@ -325,6 +338,45 @@ bool directwrite_shaper::has_color(font_key _font) const
     return false;
 }
 
+std::optional<std::string> directwrite_shaper::font_file(font_key _font) const
+{
+    auto const i = d->fonts.find(_font);
+    if (i == d->fonts.end())
+        return nullopt;
+
+    // Only faces backed by a single local file have a path (as opposed to e.g. in-memory fonts).
+    UINT32 fileCount = 0;
+    if (FAILED(i->second.fontFace->GetFiles(&fileCount, nullptr)) || fileCount != 1)
+        return nullopt;
+
+    ComPtr<IDWriteFontFile> file;
+    ComPtr<IDWriteFontFileLoader> loader;
+    ComPtr<IDWriteLocalFontFileLoader> localLoader;
+    void const* referenceKey{};
+    UINT32 referenceKeySize{};
+    if (FAILED(i->second.fontFace->GetFiles(&fileCount, file.GetAddressOf()))
+        || FAILED(file->GetReferenceKey(&referenceKey, &referenceKeySize))
+        || FAILED(file->GetLoader(loader.GetAddressOf()))
+        || FAILED(loader.As(&localLoader)))
+        return nullopt;
+
+    UINT32 pathLength{};
+    if (FAILED(localLoader->GetFilePathLengthFromKey(referenceKey, referenceKeySize, &pathLength)))
+        return nullopt;
+
+    auto path = wstring(pathLength + 1, L'\0');
+    if (FAILED(localLoader->GetFilePathFromKey(referenceKey, referenceKeySize, path.data(), pathLength + 1)))
+        return nullopt;
+    path.resize(pathLength);
+
+    return std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>{}.to_bytes(path);
+}
+
+void directwrite_shaper::collect_memory_usage(crispy::memory_usage& _usage) const
+{
+    _usage.add("shaper.fonts", crispy::hash_table_bytes(d->fonts) + crispy::hash_table_bytes(d->fontKeys));
+}
+
 void directwrite_shaper::set_dpi(crispy::Point _dpi)
 {
     d->dpi_ = _dpi;
@@ -333,7 +385,8 @@ void directwrite_shaper::set_dpi(crispy::Point _dpi)
 
 void directwrite_shaper::clear_cache()
 {
-    // TODO: clear the cache
+    d->fonts.clear();
+    d->fontKeys.clear();
 }
 
 optional<glyph_position> directwrite_shaper::shape(font_key _font,
@@ -216,9 +216,13 @@ enum class render_mode
     gray,   //!< gray-scale anti-aliasing
     light,  //!< gray-scale anti-aliasing for optimized for LCD screens
     lcd,    //!< LCD-optimized anti-aliasing
-    color   //!< embedded color bitmaps are preferred
+    color,  //!< embedded color bitmaps are preferred
+    sdf,    //!< signed distance fields at sdf_em_size, scaled to any font size (color glyphs excluded)
 };
 
+/// Pixels per em that glyphs rendered as signed distance fields are rasterized at, regardless of the font size.
+constexpr int sdf_em_size = 64;
+
 } // end namespace
 
 namespace std { // {{{
@@ -431,6 +435,7 @@ namespace fmt { // {{{
                 case text::render_mode::light: return format_to(ctx.out(), "Light");
                 case text::render_mode::lcd: return format_to(ctx.out(), "LCD");
                 case text::render_mode::color: return format_to(ctx.out(), "Color");
+                case text::render_mode::sdf: return format_to(ctx.out(), "SDF");
             }
             return format_to(ctx.out(), "({})", unsigned(_value));
         }
@@ -17,7 +17,10 @@
 #include <crispy/algorithm.h>
 #include <crispy/debuglog.h>
 #include <crispy/times.h>
+#include <crispy/utils.h>
 #include <crispy/indexed.h>
+#include <crispy/profiler.h>
+#include <crispy/trace.h>
 
 #include <ft2build.h>
 #include FT_BITMAP_H
@@ -28,23 +31,43 @@
 #include <fontconfig/fontconfig.h>
 #include <harfbuzz/hb.h>
 #include <harfbuzz/hb-ft.h>
+#include <harfbuzz/hb-ot.h>
 
 #include <algorithm>
+#include <array>
+#include <chrono>
 #include <cmath>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
 #include <stdexcept>
 #include <tuple>
 #include <unordered_map>
 #include <utility>
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+    #include <emmintrin.h>
+    #define LIBTERMINAL_TEXT_SHAPER_SSE2 1
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && (defined(__aarch64__) || defined(_M_ARM64))
+    #include <arm_neon.h>
+    #define LIBTERMINAL_TEXT_SHAPER_NEON 1
+#endif
+
 using std::max;
+using std::chrono::steady_clock;
 using std::move;
 using std::nullopt;
 using std::optional;
 using std::pair;
 using std::runtime_error;
+using std::scoped_lock;
+using std::shared_lock;
+using std::shared_mutex;
+using std::shared_ptr;
 using std::string;
 using std::string_view;
 using std::tuple;
+using std::u32string;
 using std::u32string_view;
 using std::unique_ptr;
 using std::vector;
@@ -181,6 +204,8 @@ namespace // {{{ helper
                 return FT_LOAD_COLOR;
             case render_mode::gray:
                 return FT_LOAD_DEFAULT;
+            case render_mode::sdf:
+                return FT_LOAD_NO_HINTING; // hinting is specific to the size the glyph is rasterized at
         }
         return FT_LOAD_DEFAULT;
     }
@@ -194,7 +219,12 @@ namespace // {{{ helper
             case render_mode::light:  return FT_RENDER_MODE_LIGHT;
             case render_mode::lcd:    return FT_RENDER_MODE_LCD;
             case render_mode::color:  return FT_RENDER_MODE_NORMAL;
-                break;
+#if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+            case render_mode::sdf:    return FT_RENDER_MODE_SDF;
+#else
+            // Coverage at sdf_em_size, which still scales acceptably when alpha-tested.
+            case render_mode::sdf:    return FT_RENDER_MODE_NORMAL;
+#endif
         }
         return FT_RENDER_MODE_NORMAL;
     };
@@ -316,7 +346,41 @@ namespace // {{{ helper
     }
 #endif
 
-    static optional<tuple<string, vector<string>>> getFontFallbackPaths(font_description const& _fd)
+    /// A font to fall back to, along with the codepoints it covers according to fontconfig.
+    ///
+    /// This allows skipping fonts that cannot help with a given text, without loading them.
+    struct FallbackFont
+    {
+        string path;
+        shared_ptr<FcCharSet> charset;  // unknown if null, in which case the font must be probed
+    };
+
+    /// The primary font file and its fallback fonts, as resolved by fontconfig for a font description.
+    using FontChain = tuple<string, vector<FallbackFont>>;
+
+    /// Variation selectors and zero width (non-)joiners, which fonts need not map,
+    /// as harfbuzz hides them anyway.
+    constexpr bool isDefaultIgnorable(char32_t _codepoint) noexcept
+    {
+        return (0x200C <= _codepoint && _codepoint <= 0x200D)
+            || (0xFE00 <= _codepoint && _codepoint <= 0xFE0F)
+            || (0xE0100 <= _codepoint && _codepoint <= 0xE01EF);
+    }
+
+    /// @returns whether or not the given fallback font may be able to render all of @p _codepoints.
+    bool mayCover(FallbackFont const& _font, u32string_view _codepoints)
+    {
+        if (!_font.charset)
+            return true;
+
+        for (char32_t const codepoint: _codepoints)
+            if (!isDefaultIgnorable(codepoint) && !FcCharSetHasChar(_font.charset.get(), codepoint))
+                return false;
+
+        return true;
+    }
+
+    static optional<FontChain> getFontFallbackPaths(font_description const& _fd)
     {
         debuglog(FontLoaderTag).write("Loading font chain for: {}", _fd);
         auto pat = unique_ptr<FcPattern, void(*)(FcPattern*)>(
@@ -360,7 +424,7 @@ namespace // {{{ helper
         if (!fs || result != FcResultMatch)
             return {};
 
-        vector<string> fallbackFonts;
+        vector<FallbackFont> fallbackFonts;
         for (int i = 0; i < fs->nfont; ++i)
         {
             FcPattern* font = fs->fonts[i];
@@ -392,31 +456,37 @@ namespace // {{{ helper
                 }
             }
 
-            fallbackFonts.emplace_back((char const*)(file));
+            // The charset belongs to the font set destroyed below, so keep a reference of our own.
+            FcCharSet* charset = nullptr;
+            auto fallbackFont = FallbackFont{(char const*)(file), nullptr};
+            if (FcPatternGetCharSet(font, FC_CHARSET, 0, &charset) == FcResultMatch && charset)
+                fallbackFont.charset = shared_ptr<FcCharSet>(FcCharSetCopy(charset), [](FcCharSet* p) { FcCharSetDestroy(p); });
+
+            fallbackFonts.emplace_back(move(fallbackFont));
             // debuglog(FontFallbackTag).write("Found font: {}", fallbackFonts.back());
         }
 
         #if defined(_WIN32)
         #define FONTDIR "C:\\Windows\\Fonts\\"
         if (_fd.familyName == "emoji") {
-            fallbackFonts.emplace_back(FONTDIR "seguiemj.ttf");
-            fallbackFonts.emplace_back(FONTDIR "seguisym.ttf");
+            fallbackFonts.emplace_back(FallbackFont{FONTDIR "seguiemj.ttf", nullptr});
+            fallbackFonts.emplace_back(FallbackFont{FONTDIR "seguisym.ttf", nullptr});
         }
         else if (_fd.weight != font_weight::normal && _fd.slant != font_slant::normal) {
-            fallbackFonts.emplace_back(FONTDIR "consolaz.ttf");
-            fallbackFonts.emplace_back(FONTDIR "seguisbi.ttf");
+            fallbackFonts.emplace_back(FallbackFont{FONTDIR "consolaz.ttf", nullptr});
+            fallbackFonts.emplace_back(FallbackFont{FONTDIR "seguisbi.ttf", nullptr});
         }
         else if (_fd.weight != font_weight::normal) {
-            fallbackFonts.emplace_back(FONTDIR "consolab.ttf");
-            fallbackFonts.emplace_back(FONTDIR "seguisb.ttf");
+            fallbackFonts.emplace_back(FallbackFont{FONTDIR "consolab.ttf", nullptr});
+            fallbackFonts.emplace_back(FallbackFont{FONTDIR "seguisb.ttf", nullptr});
         }
         else if (_fd.slant != font_slant::normal) {
-            fallbackFonts.emplace_back(FONTDIR "consolai.ttf");
-            fallbackFonts.emplace_back(FONTDIR "seguisli.ttf");
+            fallbackFonts.emplace_back(FallbackFont{FONTDIR "consolai.ttf", nullptr});
+            fallbackFonts.emplace_back(FallbackFont{FONTDIR "seguisli.ttf", nullptr});
         }
         else {
-            fallbackFonts.emplace_back(FONTDIR "consola.ttf");
-            fallbackFonts.emplace_back(FONTDIR "seguisym.ttf");
+            fallbackFonts.emplace_back(FallbackFont{FONTDIR "consola.ttf", nullptr});
+            fallbackFonts.emplace_back(FallbackFont{FONTDIR "seguisym.ttf", nullptr});
         }
 
         #undef FONTDIR
@@ -425,10 +495,10 @@ namespace // {{{ helper
         if (fallbackFonts.empty())
             return nullopt;
 
-        string primary = fallbackFonts.front();
+        string primary = fallbackFonts.front().path;
         fallbackFonts.erase(fallbackFonts.begin());
 
-        return tuple{primary, fallbackFonts};
+        return FontChain{primary, fallbackFonts};
     }
 
     // XXX currently not needed
@@ -518,6 +588,82 @@ namespace // {{{ helper
             if (glyphMissing(gpos))
                 gpos.glyph.index = glyph_index{ missingGlyph };
     }
+
+    // {{{ bitmap conversion
+    // FreeType bitmaps are stored top row first, whereas rasterized glyphs are stored bottom row first.
+
+    /// @returns a pointer to the given row of a FreeType bitmap, counting rows from the bottom.
+    uint8_t const* bitmapRowFromBottom(FT_Bitmap const& _bitmap, int _row) noexcept
+    {
+        return _bitmap.buffer + (static_cast<int>(_bitmap.rows) - 1 - _row) * _bitmap.pitch;
+    }
+
+    /// Expands a row of a 1 bit per pixel bitmap (most significant bit first) into an alpha mask.
+    void expandMonoRow(uint8_t* _dest, uint8_t const* _source, int _width)
+    {
+        // Each source byte expands into eight mask bytes, copied from a table at once.
+        static auto const masks = []() {
+            auto table = std::array<std::array<uint8_t, 8>, 256>{};
+            for (unsigned byte = 0; byte < 256; ++byte)
+                for (unsigned bit = 0; bit < 8; ++bit)
+                    table[byte][bit] = (byte & (0x80u >> bit)) ? 0xFF : 0x00;
+            return table;
+        }();
+
+        auto j = 0;
+        for (; j + 8 <= _width; j += 8)
+            std::memcpy(_dest + j, masks[_source[j / 8]].data(), 8);
+        for (; j < _width; ++j)
+            _dest[j] = masks[_source[j / 8]][j % 8];
+    }
+
+    /// Converts a row of BGRA pixels into RGBA.
+    void swizzleBGRARow(uint8_t* _dest, uint8_t const* _source, int _width)
+    {
+        auto i = 0;
+
+#if defined(LIBTERMINAL_TEXT_SHAPER_SSE2)
+        // Four pixels at a time, swapping the lowest and the third byte of each little endian 32 bit pixel.
+        auto const greenAlpha = _mm_set1_epi32(static_cast<int>(0xFF00FF00u));
+        auto const lowByte = _mm_set1_epi32(0xFF);
+        for (; i + 4 <= _width; i += 4)
+        {
+            auto const pixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_source + i * 4));
+            auto const red = _mm_and_si128(_mm_srli_epi32(pixels, 16), lowByte);
+            auto const blue = _mm_slli_epi32(_mm_and_si128(pixels, lowByte), 16);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(_dest + i * 4),
+                             _mm_or_si128(_mm_and_si128(pixels, greenAlpha), _mm_or_si128(red, blue)));
+        }
+#elif defined(LIBTERMINAL_TEXT_SHAPER_NEON)
+        // Sixteen pixels at a time, deinterleaved into one register per channel.
+        for (; i + 16 <= _width; i += 16)
+        {
+            auto pixels = vld4q_u8(_source + i * 4);
+            auto const blue = pixels.val[0];
+            pixels.val[0] = pixels.val[2];
+            pixels.val[2] = blue;
+            vst4q_u8(_dest + i * 4, pixels);
+        }
+#endif
+
+        for (; i < _width; ++i)
+        {
+            auto const s = _source + i * 4;
+            auto const d = _dest + i * 4;
+            d[0] = s[2];
+            d[1] = s[1];
+            d[2] = s[0];
+            d[3] = s[3];
+        }
+    }
+    // }}}
+
+    /// @returns the HarfBuzz buffer of the calling thread, as threads may shape text concurrently.
+    hb_buffer_t* threadBuffer()
+    {
+        thread_local auto buffer = HbBufferPtr(hb_buffer_create(), [](auto p) { hb_buffer_destroy(p); });
+        return buffer.get();
+    }
 } // }}}
 
 struct FontInfo
@@ -527,23 +673,62 @@ struct FontInfo
     FtFacePtr ftFace;
     HbFontPtr hbFont;
     font_description description{};
-    vector<string> fallbackFonts{};
+    vector<FallbackFont> fallbackFonts{};
+
+    // Texts this font cannot render, to the fallback font rendering them, or none if none does.
+    std::unordered_map<u32string, optional<font_key>> fallbackCache{};
 };
 
 struct open_shaper::Private // {{{
 {
+    // FreeType faces must not be used concurrently, but glyphs may be rasterized on another
+    // thread than the ones shaping text. Shaping with the fonts loaded takes the lock shared,
+    // as HarfBuzz serializes its own access to the faces, anything else takes it exclusively.
+    shared_mutex lock_;
+
     FT_Library ft_;
     crispy::Point dpi_;
     std::unordered_map<font_key, FontInfo> fonts_;  // from font_key to FontInfo struct
     std::unordered_map<FontPathAndSize, font_key> fontPathSizeToKeys;
 
+    // Font chains by formatted font description. They depend on neither font size nor DPI,
+    // so they are kept across clear_cache(), sparing fontconfig's sorting when changing those.
+    std::unordered_map<string, optional<FontChain>> fontChains_;
+
+    // Upper bound of fallback lookups remembered per font, as arbitrary texts may be shaped.
+    static constexpr size_t MaxFallbackCacheSize = 4096;
+
     // The key (for caching) should be composed out of:
     // (file_path, file_mtime, font_weight, font_slant, pixel_size)
 
     std::unordered_map<glyph_key, rasterized_glyph> glyphs_;
-    HbBufferPtr hb_buf_;
     font_key nextFontKey_;
 
+    crispy::cache_counters fontCounters_;        // fonts by path and size, see get_font_key_for()
+    crispy::cache_counters fontChainCounters_;   // fontChains_
+    crispy::cache_counters fallbackCounters_;    // fallbackCache of all fonts, see find_fallback()
+
+    size_t fallbackCacheBytes() const
+    {
+        auto bytes = size_t{0};
+        for (auto const& font: fonts_)
+        {
+            bytes += crispy::hash_table_bytes(font.second.fallbackCache);
+            for (auto const& fallback: font.second.fallbackCache)
+                bytes += crispy::allocated_bytes(fallback.first);
+        }
+        return bytes;
+    }
+
+    size_t fontChainBytes() const
+    {
+        auto bytes = crispy::hash_table_bytes(fontChains_);
+        for (auto const& chain: fontChains_)
+            if (chain.second)
+                bytes += crispy::allocated_bytes(std::get<1>(*chain.second));
+        return bytes;
+    }
+
     font_key create_font_key()
     {
         auto result = nextFontKey_;
@@ -554,9 +739,14 @@ struct open_shaper::Private // {{{
     optional<font_key> get_font_key_for(string _path, font_size _fontSize)
     {
         if (auto i = fontPathSizeToKeys.find(FontPathAndSize{_path, _fontSize}); i != fontPathSizeToKeys.end())
+        {
+            fontCounters_.hit();
             return i->second;
+        }
 
+        auto const missStart = steady_clock::now();
         auto ftFacePtrOpt = loadFace(_path, _fontSize, dpi_, ft_);
+        fontCounters_.miss(steady_clock::now() - missStart);
         if (!ftFacePtrOpt.has_value())
             return nullopt;
 
@@ -570,6 +760,7 @@ struct open_shaper::Private // {{{
         fonts_.emplace(pair{key, move(fontInfo)});
         debuglog(FontLoaderTag).write("Loading font: key={}, path=\"{}\" size={} dpi={} {}", key, _path, _fontSize, dpi_, metrics(key));
         fontPathSizeToKeys.emplace(pair{FontPathAndSize{move(_path), _fontSize}, key});
+        fontCounters_.insert();
         return key;
     }
 
@@ -589,10 +780,59 @@ struct open_shaper::Private // {{{
         return output;
     }
 
+    /// Finds the first fallback font of @p _font that @p _tryFont succeeds with for @p _codepoints,
+    /// remembering the outcome for subsequent lookups of the same codepoints.
+    ///
+    /// Fallback fonts that fontconfig knows not to cover all codepoints are skipped without being loaded.
+    template <typename TryFont>
+    optional<font_key> find_fallback(FontInfo& _font, u32string _codepoints, TryFont _tryFont)
+    {
+        if (auto const cached = _font.fallbackCache.find(_codepoints); cached != _font.fallbackCache.end())
+        {
+            if (!cached->second.has_value())
+                return nullopt;
+            auto const key = cached->second.value();
+            if (_tryFont(key, fonts_.at(key)))
+            {
+                fallbackCounters_.hit();
+                return key;
+            }
+            // Not reached unless the font's glyphs depend on more than just the codepoints (e.g. the script).
+        }
+
+        auto const missStart = steady_clock::now();
+        optional<font_key> result;
+        for (auto const& fallbackFont : _font.fallbackFonts)
+        {
+            if (!mayCover(fallbackFont, _codepoints))
+                continue;
+
+            optional<font_key> fallbackKeyOpt = get_font_key_for(fallbackFont.path, _font.size);
+            if (!fallbackKeyOpt.has_value())
+                continue;
+
+            if (_tryFont(fallbackKeyOpt.value(), fonts_.at(fallbackKeyOpt.value())))
+            {
+                result = fallbackKeyOpt;
+                break;
+            }
+        }
+
+        if (_font.fallbackCache.size() >= MaxFallbackCacheSize)
+        {
+            fallbackCounters_.evict(_font.fallbackCache.size());
+            _font.fallbackCache.clear();
+        }
+        _font.fallbackCache.insert_or_assign(move(_codepoints), result);
+        fallbackCounters_.miss(steady_clock::now() - missStart);
+        fallbackCounters_.insert();
+
+        return result;
+    }
+
     explicit Private(crispy::Point _dpi) :
         ft_{},
         dpi_{ _dpi },
-        hb_buf_(hb_buffer_create(), [](auto p) { hb_buffer_destroy(p); }),
         nextFontKey_{}
     {
         FcInit();
@@ -610,6 +850,10 @@ struct open_shaper::Private // {{{
 
     ~Private()
     {
+        // Charsets must be released before fontconfig is shut down.
+        fonts_.clear();
+        fontChains_.clear();
+
         FT_Done_FreeType(ft_);
 
         FcFini();
@@ -622,6 +866,8 @@ open_shaper::open_shaper(crispy::Point _dpi) : d(new Private(_dpi), [](Private*
 
 void open_shaper::set_dpi(crispy::Point _dpi)
 {
+    auto _l = scoped_lock{d->lock_};
+
     if (_dpi == crispy::Point{})
         return;
 
@@ -630,19 +876,40 @@ void open_shaper::set_dpi(crispy::Point _dpi)
 
 void open_shaper::clear_cache()
 {
+    auto _l = scoped_lock{d->lock_};
+
+    d->fontCounters_.evict(d->fontPathSizeToKeys.size());
+    for (auto const& font: d->fonts_)
+        d->fallbackCounters_.evict(font.second.fallbackCache.size());
+
     d->fonts_.clear();
     d->fontPathSizeToKeys.clear();
 }
 
 optional<font_key> open_shaper::load_font(font_description const& _description, font_size _size)
 {
-    auto fontPathsOpt = getFontFallbackPaths(_description);
-    if (!fontPathsOpt.has_value())
+    auto _l = scoped_lock{d->lock_};
+
+    auto const chainKey = fmt::format("{}", _description);
+    auto chain = d->fontChains_.find(chainKey);
+    if (chain != d->fontChains_.end())
+        d->fontChainCounters_.hit();
+    else
+    {
+        auto const _trace = crispy::trace_scope("font discovery");
+        auto const missStart = steady_clock::now();
+        chain = d->fontChains_.emplace(chainKey, getFontFallbackPaths(_description)).first;
+        d->fontChainCounters_.miss(steady_clock::now() - missStart);
+        d->fontChainCounters_.insert();
+    }
+
+    if (!chain->second.has_value())
         return nullopt;
 
-    auto& [primaryFont, fallbackFonts] = fontPathsOpt.value();
+    auto const& [primaryFont, fallbackFonts] = chain->second.value();
 
-    optional<font_key> fontKeyOpt = d->get_font_key_for(move(primaryFont), _size);
+    auto const _trace = crispy::trace_scope("font loading");
+    optional<font_key> fontKeyOpt = d->get_font_key_for(primaryFont, _size);
     if (!fontKeyOpt.has_value())
         return nullopt;
 
@@ -655,14 +922,54 @@ optional<font_key> open_shaper::load_font(font_description const& _description,
 
 font_metrics open_shaper::metrics(font_key _key) const
 {
+    auto _l = scoped_lock{d->lock_};
+
     return d->metrics(_key);
 }
 
 bool open_shaper::has_color(font_key _font) const
 {
+    auto _l = scoped_lock{d->lock_};
+
     return FT_HAS_COLOR(d->fonts_.at(_font).ftFace.get());
 }
 
+optional<string> open_shaper::font_file(font_key _font) const
+{
+    auto _l = scoped_lock{d->lock_};
+
+    if (auto i = d->fonts_.find(_font); i != d->fonts_.end())
+        return i->second.path;
+
+    return nullopt;
+}
+
+void open_shaper::collect_memory_usage(crispy::memory_usage& _usage) const
+{
+    auto _l = scoped_lock{d->lock_};
+
+    auto glyphs = crispy::hash_table_bytes(d->glyphs_);
+    for (auto const& glyph: d->glyphs_)
+        glyphs += crispy::allocated_bytes(glyph.second.bitmap);
+
+    auto fallbacks = d->fallbackCacheBytes();
+    for (auto const& font: d->fonts_)
+        fallbacks += crispy::allocated_bytes(font.second.fallbackFonts);
+
+    _usage.add("shaper.glyphs", glyphs);
+    _usage.add("shaper.fallbacks", fallbacks);
+    _usage.add("shaper.font_chains", d->fontChainBytes());
+}
+
+void open_shaper::collect_cache_stats(crispy::cache_statistics& _stats) const
+{
+    auto _l = scoped_lock{d->lock_};
+
+    _stats.add("shaper.fonts", d->fontCounters_.stats(crispy::hash_table_bytes(d->fontPathSizeToKeys)));
+    _stats.add("shaper.font_chains", d->fontChainCounters_.stats(d->fontChainBytes()));
+    _stats.add("shaper.fallbacks", d->fallbackCounters_.stats(d->fallbackCacheBytes()));
+}
+
 void prepareBuffer(hb_buffer_t* _hbBuf, u32string_view _codepoints, crispy::span<int> _clusters, unicode::Script _script)
 {
     hb_buffer_clear_contents(_hbBuf);
@@ -716,77 +1023,142 @@ bool tryShape(font_key _font,
 optional<glyph_position> open_shaper::shape(font_key _font,
                                             char32_t _codepoint)
 {
+    CRISPY_PROFILE_ZONE("open_shaper::shape(codepoint)");
+    auto _l = scoped_lock{d->lock_};
+
     FontInfo& fontInfo = d->fonts_.at(_font);
 
+    font_key glyphFont = _font;
     glyph_index glyphIndex{ FT_Get_Char_Index(fontInfo.ftFace.get(), _codepoint) };
     if (!glyphIndex.value)
     {
-        for (auto const& fallbackFont : fontInfo.fallbackFonts)
-        {
-            optional<font_key> fallbackKeyOpt = d->get_font_key_for(fallbackFont, fontInfo.size);
-            if (!fallbackKeyOpt.has_value())
-                continue;
-            FontInfo const& fallbackFontInfo = d->fonts_.at(fallbackKeyOpt.value());
-            glyphIndex = glyph_index{ FT_Get_Char_Index(fallbackFontInfo.ftFace.get(), _codepoint) };
-            if (glyphIndex.value)
-                break;
-        }
+        auto const fallbackKeyOpt = d->find_fallback(fontInfo, u32string(1, _codepoint), [&](font_key /*_key*/, FontInfo const& _fallback) {
+            glyphIndex = glyph_index{ FT_Get_Char_Index(_fallback.ftFace.get(), _codepoint) };
+            return glyphIndex.value != 0;
+        });
+        if (!fallbackKeyOpt.has_value())
+            return nullopt;
+        glyphFont = fallbackKeyOpt.value();
     }
-    if (!glyphIndex.value)
-        return nullopt;
 
     glyph_position gpos{};
-    gpos.glyph = glyph_key{_font, fontInfo.size, glyphIndex};
-    gpos.advance.x = this->metrics(_font).advance;
+    gpos.glyph = glyph_key{glyphFont, fontInfo.size, glyphIndex};
+    gpos.advance.x = d->metrics(_font).advance;
     gpos.offset = crispy::Point{}; // TODO (load from glyph metrics. needed?)
 
     return gpos;
 }
 
+optional<ascii_glyph_table> open_shaper::ascii_glyphs(font_key _font)
+{
+    auto _l = scoped_lock{d->lock_};
+
+    FontInfo const& fontInfo = d->fonts_.at(_font);
+    hb_font_t* hbFont = fontInfo.hbFont.get();
+    hb_face_t* hbFace = hb_font_get_face(hbFont);
+
+    // Legacy kerning tables are applied by harfbuzz without telling which glyphs are affected.
+    if (FT_HAS_KERNING(fontInfo.ftFace.get()) && !hb_ot_layout_has_positioning(hbFace))
+        return nullopt;
+
+    // Collect all glyphs that the features harfbuzz enables by default may substitute or move.
+    static hb_tag_t const substitutionFeatures[] = {
+        HB_TAG('c','c','m','p'), HB_TAG('l','o','c','l'), HB_TAG('r','l','i','g'), HB_TAG('r','c','l','t'), HB_TAG('r','v','r','n'),
+        HB_TAG('l','i','g','a'), HB_TAG('c','l','i','g'), HB_TAG('c','a','l','t'), HB_TAG_NONE
+    };
+    static hb_tag_t const positioningFeatures[] = {
+        HB_TAG('k','e','r','n'), HB_TAG('m','a','r','k'), HB_TAG('m','k','m','k'),
+        HB_TAG('d','i','s','t'), HB_TAG('c','u','r','s'), HB_TAG_NONE
+    };
+
+    auto lookups = unique_ptr<hb_set_t, void(*)(hb_set_t*)>(hb_set_create(), hb_set_destroy);
+    auto contextualGlyphs = unique_ptr<hb_set_t, void(*)(hb_set_t*)>(hb_set_create(), hb_set_destroy);
+    for (auto const& [table, features]: {pair{HB_OT_TAG_GSUB, substitutionFeatures},
+                                         pair{HB_OT_TAG_GPOS, positioningFeatures}})
+    {
+        hb_set_clear(lookups.get());
+        hb_ot_layout_collect_lookups(hbFace, table, nullptr, nullptr, features, lookups.get());
+
+        hb_codepoint_t lookup = HB_SET_VALUE_INVALID;
+        while (hb_set_next(lookups.get(), &lookup))
+            hb_ot_layout_lookup_collect_glyphs(hbFace, table, lookup,
+                                               contextualGlyphs.get(), // before
+                                               contextualGlyphs.get(), // input
+                                               contextualGlyphs.get(), // after
+                                               nullptr);               // output
+    }
+
+    auto result = ascii_glyph_table{};
+    for (char32_t codepoint = ascii_glyph_table::first; codepoint <= ascii_glyph_table::last; ++codepoint)
+    {
+        auto const i = codepoint - ascii_glyph_table::first;
+        hb_codepoint_t glyph = 0;
+        if (!hb_font_get_nominal_glyph(hbFont, codepoint, &glyph) || hb_set_has(contextualGlyphs.get(), glyph))
+            continue;
+
+        // Same as tryShape() would compute for a lone glyph.
+        glyph_position& gpos = result.glyphs[i];
+        gpos.glyph = glyph_key{_font, fontInfo.size, glyph_index{glyph}};
+        gpos.advance.x = int(hb_font_get_glyph_h_advance(hbFont, glyph) / 64.0f);
+        result.context_free.set(i);
+    }
+
+    debuglog(TextShapingTag).write("ASCII glyph table for font key {}: {} of {} characters context free.",
+                                   _font, result.context_free.count(), result.context_free.size());
+    return result;
+}
+
 void open_shaper::shape(font_key _font,
                         u32string_view _codepoints,
                         crispy::span<int> _clusters,
                         unicode::Script _script,
                         shape_result& _result)
 {
-    FontInfo& fontInfo = d->fonts_.at(_font);
-    hb_font_t* hbFont = fontInfo.hbFont.get();
-    hb_buffer_t* hbBuf = d->hb_buf_.get();
+    CRISPY_PROFILE_ZONE("open_shaper::shape");
+    hb_buffer_t* hbBuf = threadBuffer();
 
-    if (crispy::logging_sink::for_debug().enabled())
+    // Text shaped by the font itself, which is most text, may be shaped by multiple threads at once.
     {
-        auto logMessage = debuglog(TextShapingTag);
-        logMessage.write("Shaping codepoints:");
-        for (auto [i, codepoint] : crispy::indexed(_codepoints))
-            logMessage.write(" {}:U+{:x}", _clusters[i], static_cast<unsigned>(codepoint));
-        logMessage.write("\n");
-        logMessage.write("Using font: key={}, path=\"{}\"\n", _font, fontInfo.path);
+        auto _l = shared_lock{d->lock_};
+
+        FontInfo& fontInfo = d->fonts_.at(_font);
+
+        if (crispy::logging_sink::for_debug().enabled())
+        {
+            auto logMessage = debuglog(TextShapingTag);
+            logMessage.write("Shaping codepoints:");
+            for (auto [i, codepoint] : crispy::indexed(_codepoints))
+                logMessage.write(" {}:U+{:x}", _clusters[i], static_cast<unsigned>(codepoint));
+            logMessage.write("\n");
+            logMessage.write("Using font: key={}, path=\"{}\"\n", _font, fontInfo.path);
+        }
+
+        if (tryShape(_font, fontInfo, hbBuf, fontInfo.hbFont.get(), _script, _codepoints, _clusters, _result))
+            return;
     }
 
-    if (tryShape(_font, fontInfo, hbBuf, hbFont, _script, _codepoints, _clusters, _result))
-        return;
+    // Falling back to other fonts may load them.
+    auto _l = scoped_lock{d->lock_};
 
-    for (auto const& fallbackFont : fontInfo.fallbackFonts)
-    {
-        optional<font_key> fallbackKeyOpt = d->get_font_key_for(fallbackFont, fontInfo.size);
-        if (!fallbackKeyOpt.has_value())
-            continue;
+    FontInfo& fontInfo = d->fonts_.at(_font);
+    hb_font_t* hbFont = fontInfo.hbFont.get();
 
+    auto const fallbackKeyOpt = d->find_fallback(fontInfo, u32string(_codepoints), [&](font_key _key, FontInfo& _fallback) {
         // Skip if main font is monospace but fallback font is not.
         if (fontInfo.description.force_spacing &&
             fontInfo.description.spacing != font_spacing::proportional)
         {
-            FontInfo const& fallbackFontInfo = d->fonts_.at(fallbackKeyOpt.value());
-            bool const fontIsMonospace = fallbackFontInfo.ftFace->face_flags & FT_FACE_FLAG_FIXED_WIDTH;
+            bool const fontIsMonospace = _fallback.ftFace->face_flags & FT_FACE_FLAG_FIXED_WIDTH;
             if (!fontIsMonospace)
-                continue;
+                return false;
         }
 
-        FontInfo& fallbackFontInfo = d->fonts_.at(fallbackKeyOpt.value());
-        debuglog(FontFallbackTag).write("Try fallback font: key={}, path=\"{}\"\n", fallbackKeyOpt.value(), fallbackFontInfo.path);
-        if (tryShape(fallbackKeyOpt.value(), fallbackFontInfo, hbBuf, fallbackFontInfo.hbFont.get(), _script, _codepoints, _clusters, _result))
-            return;
-    }
+        debuglog(FontFallbackTag).write("Try fallback font: key={}, path=\"{}\"\n", _key, _fallback.path);
+        return tryShape(_key, _fallback, hbBuf, _fallback.hbFont.get(), _script, _codepoints, _clusters, _result);
+    });
+    if (fallbackKeyOpt.has_value())
+        return;
+
     debuglog(FontFallbackTag).write("Shaping failed.");
 
     // reshape with primary font
@@ -796,10 +1168,24 @@ void open_shaper::shape(font_key _font,
 
 optional<rasterized_glyph> open_shaper::rasterize(glyph_key _glyph, render_mode _mode)
 {
+    CRISPY_PROFILE_ZONE("open_shaper::rasterize");
+    auto _l = scoped_lock{d->lock_};
+
     auto const font = _glyph.font;
     auto ftFace = d->fonts_.at(font).ftFace.get();
     auto const glyphIndex = _glyph.index;
-    FT_Int32 const flags = ftRenderFlag(_mode) | (has_color(font) ? FT_LOAD_COLOR : 0);
+    FT_Int32 const flags = ftRenderFlag(_mode) | (FT_HAS_COLOR(ftFace) ? FT_LOAD_COLOR : 0);
+
+    // Distance fields are rasterized at the same size for every font size, and scaled when rendered.
+    // The face is shared with shaping, which the lock keeps out until its size is restored.
+    auto const _restoreSize = crispy::finally{[&]() {
+        if (_mode != render_mode::sdf || FT_HAS_COLOR(ftFace))
+            return;
+        auto const size = static_cast<FT_F26Dot6>(ceil(d->fonts_.at(font).size.pt * 64.0));
+        FT_Set_Char_Size(ftFace, size, size, d->dpi_.x, d->dpi_.y);
+    }};
+    if (_mode == render_mode::sdf && !FT_HAS_COLOR(ftFace))
+        FT_Set_Pixel_Sizes(ftFace, 0, sdf_em_size);
 
     FT_Error ec = FT_Load_Glyph(ftFace, glyphIndex.value, flags);
     if (ec != FT_Err_Ok)
@@ -842,81 +1228,46 @@ optional<rasterized_glyph> open_shaper::rasterize(glyph_key _glyph, render_mode
     {
         case FT_PIXEL_MODE_MONO:
         {
-            auto const width = output.size.width;
-            auto const height = output.size.height;
-
-            // convert mono to gray
-            FT_Bitmap ftBitmap;
-            FT_Bitmap_Init(&ftBitmap);
-
-            auto const ec = FT_Bitmap_Convert(d->ft_, &ftFace->glyph->bitmap, &ftBitmap, 1);
-            if (ec != FT_Err_Ok)
-                return nullopt;
-
-            ftBitmap.num_grays = 256;
-
+            auto const& bitmap = ftFace->glyph->bitmap;
             output.format = bitmap_format::alpha_mask;
-            output.bitmap.resize(height * width); // 8-bit channel (with values 0 or 255)
-
-            auto const pitch = abs(ftBitmap.pitch);
-            for (auto i = 0; i < int(ftBitmap.rows); ++i)
-                for (auto j = 0; j < int(ftBitmap.width); ++j)
-                    output.bitmap[i * width + j] = ftBitmap.buffer[(height - 1 - i) * pitch + j] * 255;
-
-            FT_Bitmap_Done(d->ft_, &ftBitmap);
+            output.bitmap.resize(output.size.height * output.size.width); // 8-bit channel (with values 0 or 255)
+            for (auto const i : crispy::times(output.size.height))
+                expandMonoRow(output.bitmap.data() + i * output.size.width,
+                              bitmapRowFromBottom(bitmap, i),
+                              output.size.width);
             break;
         }
         case FT_PIXEL_MODE_GRAY:
-        {
-            output.format = bitmap_format::alpha_mask;
-            output.bitmap.resize(output.size.height * output.size.width);
-
-            auto const pitch = ftFace->glyph->bitmap.pitch;
-            auto const s = ftFace->glyph->bitmap.buffer;
-            for (auto i = 0; i < output.size.height; ++i)
-                for (auto j = 0; j < output.size.width; ++j)
-                    output.bitmap[i * output.size.width + j] = s[(output.size.height - 1 - i) * pitch + j];
-            break;
-        }
         case FT_PIXEL_MODE_LCD:
         {
-            auto const width = ftFace->glyph->bitmap.width;
-            auto const height = ftFace->glyph->bitmap.rows;
-
-            output.format = bitmap_format::rgb; // LCD
-            output.bitmap.resize(width * height);
-            output.size.width /= 3;
-
-            auto const pitch = ftFace->glyph->bitmap.pitch;
-            auto s = ftFace->glyph->bitmap.buffer;
-            for (auto const i : crispy::times(ftFace->glyph->bitmap.rows))
-                for (auto const j : crispy::times(ftFace->glyph->bitmap.width))
-                    output.bitmap[i * width + j] = s[(height - 1 - i) * pitch + j];
+            // Both have one byte per pixel (LCD: per subpixel), copied row by row.
+            auto const& bitmap = ftFace->glyph->bitmap;
+            auto const rowSize = static_cast<size_t>(bitmap.width);
+
+            output.bitmap.resize(rowSize * bitmap.rows);
+            for (auto const i : crispy::times(output.size.height))
+                std::memcpy(output.bitmap.data() + i * rowSize, bitmapRowFromBottom(bitmap, i), rowSize);
+
+            if (bitmap.pixel_mode == FT_PIXEL_MODE_LCD)
+            {
+                output.format = bitmap_format::rgb; // LCD
+                output.size.width /= 3;
+            }
+            else
+                output.format = bitmap_format::alpha_mask;
             break;
         }
         case FT_PIXEL_MODE_BGRA:
         {
-            auto const width = output.size.width;
-            auto const height = output.size.height;
+            auto const& bitmap = ftFace->glyph->bitmap;
+            auto const rowSize = static_cast<size_t>(output.size.width) * 4;
 
             output.format = bitmap_format::rgba;
-            output.bitmap.resize(height * width * 4);
-            auto t = output.bitmap.begin();
-
-            auto const pitch = ftFace->glyph->bitmap.pitch;
-            for (auto const i : crispy::times(height))
-            {
-                for (auto const j : crispy::times(width))
-                {
-                    auto const s = &ftFace->glyph->bitmap.buffer[(height - i - 1) * pitch + j * 4];
-
-                    // BGRA -> RGBA
-                    *t++ = s[2];
-                    *t++ = s[1];
-                    *t++ = s[0];
-                    *t++ = s[3];
-                }
-            }
+            output.bitmap.resize(rowSize * output.size.height);
+            for (auto const i : crispy::times(output.size.height))
+                swizzleBGRARow(output.bitmap.data() + i * rowSize,
+                               bitmapRowFromBottom(bitmap, i),
+                               output.size.width);
             break;
         }
         default:
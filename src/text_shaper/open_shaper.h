@@ -45,10 +45,19 @@ class open_shaper : public shaper {
     std::optional<glyph_position> shape(font_key _font,
                                         char32_t _codepoint) override;
 
+    bool concurrent_shaping() const noexcept override { return true; }
+
+    std::optional<ascii_glyph_table> ascii_glyphs(font_key _font) override;
+
     std::optional<rasterized_glyph> rasterize(glyph_key _glyph, render_mode _mode) override;
 
     bool has_color(font_key _font) const override;
 
+    std::optional<std::string> font_file(font_key _font) const override;
+
+    void collect_memory_usage(crispy::memory_usage& _usage) const override;
+    void collect_cache_stats(crispy::cache_statistics& _stats) const override;
+
   private:
     struct Private;
     std::unique_ptr<Private, void(*)(Private*)> d;
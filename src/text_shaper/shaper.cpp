@@ -15,9 +15,19 @@
 
 #include <crispy/debuglog.h>
 
+#include <array>
 #include <utility>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+    #include <emmintrin.h>
+    #define LIBTERMINAL_TEXT_SHAPER_SSE2 1
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && (defined(__aarch64__) || defined(_M_ARM64))
+    #include <arm_neon.h>
+    #define LIBTERMINAL_TEXT_SHAPER_NEON 1
+#endif
+
+using std::array;
 using std::tuple;
 using std::min;
 using std::max;
@@ -27,6 +37,43 @@ namespace text {
 
 namespace {
     auto FontScaleTag = crispy::debugtag::make("font.scaling", "Logs about font's glyph scaling metrics, if required.");
+
+    /// Adds up each channel of @p _count consecutive 4 byte pixels to @p _sum.
+    void accumulatePixels(uint8_t const* _pixels, int _count, array<unsigned, 4>& _sum)
+    {
+        auto i = 0;
+
+#if defined(LIBTERMINAL_TEXT_SHAPER_SSE2)
+        // Two pixels at a time, widened to 16 bit and then 32 bit per channel.
+        auto const zero = _mm_setzero_si128();
+        auto sum = _mm_setzero_si128();
+        for (; i + 2 <= _count; i += 2)
+        {
+            auto const pixels = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(_pixels + i * 4)), zero);
+            sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_unpacklo_epi16(pixels, zero), _mm_unpackhi_epi16(pixels, zero)));
+        }
+        alignas(16) unsigned partial[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(partial), sum);
+        for (auto const k: {0, 1, 2, 3})
+            _sum[k] += partial[k];
+#elif defined(LIBTERMINAL_TEXT_SHAPER_NEON)
+        // Two pixels at a time, widened to 16 bit and then 32 bit per channel.
+        auto sum = vdupq_n_u32(0);
+        for (; i + 2 <= _count; i += 2)
+        {
+            auto const pixels = vmovl_u8(vld1_u8(_pixels + i * 4));
+            sum = vaddq_u32(sum, vaddl_u16(vget_low_u16(pixels), vget_high_u16(pixels)));
+        }
+        unsigned partial[4];
+        vst1q_u32(partial, sum);
+        for (auto const k: {0, 1, 2, 3})
+            _sum[k] += partial[k];
+#endif
+
+        for (; i < _count; ++i)
+            for (auto const k: {0, 1, 2, 3})
+                _sum[k] += _pixels[i * 4 + k];
+    }
 }
 
 tuple<rasterized_glyph, float> scale(rasterized_glyph const& _bitmap, crispy::Size _newSize)
@@ -49,29 +96,21 @@ tuple<rasterized_glyph, float> scale(rasterized_glyph const& _bitmap, crispy::Si
     uint8_t* d = dest.data();
     for (int i = 0, sr = 0; i < _newSize.height; i++, sr += factor)
     {
+        auto const rowCount = min(sr + factor, _bitmap.size.height) - sr;
         for (int j = 0, sc = 0; j < _newSize.width; j++, sc += factor, d += 4)
         {
             // calculate area average
-            unsigned int r = 0, g = 0, b = 0, a = 0, count = 0;
-            for (int y = sr; y < min(sr + factor, _bitmap.size.height); y++)
-            {
-                uint8_t const* p = _bitmap.bitmap.data() + (y * _bitmap.size.width * 4) + sc * 4;
-                for (int x = sc; x < min(sc + factor, _bitmap.size.width); x++, count++)
-                {
-                    b += *(p++);
-                    g += *(p++);
-                    r += *(p++);
-                    a += *(p++);
-                }
-            }
-
-            if (count)
-            {
-                d[0] = b / count;
-                d[1] = g / count;
-                d[2] = r / count;
-                d[3] = a / count;
-            }
+            auto const columnCount = min(sc + factor, _bitmap.size.width) - sc;
+            if (rowCount <= 0 || columnCount <= 0)
+                continue;
+
+            auto sum = array<unsigned, 4>{};
+            for (int y = sr; y < sr + rowCount; y++)
+                accumulatePixels(_bitmap.bitmap.data() + (y * _bitmap.size.width + sc) * 4, columnCount, sum);
+
+            auto const count = static_cast<unsigned>(rowCount * columnCount);
+            for (auto const k: {0, 1, 2, 3})
+                d[k] = static_cast<uint8_t>(sum[k] / count);
         }
     }
 
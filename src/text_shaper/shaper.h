@@ -15,11 +15,15 @@
 
 #include <unicode/ucd.h>
 #include <text_shaper/font.h>
+#include <crispy/cache_stats.h>
+#include <crispy/memory_usage.h>
 #include <crispy/point.h>
 #include <crispy/size.h>
 #include <crispy/span.h>
 #include <crispy/debuglog.h>
 
+#include <array>
+#include <bitset>
 #include <cstdint>
 #include <functional>
 #include <optional>
@@ -74,6 +78,30 @@ struct glyph_position
 
 using shape_result = std::vector<glyph_position>;
 
+/// Glyph positions of the printable US-ASCII characters (U+0020 .. U+007E) of a font,
+/// allowing such text to be shaped by a plain table lookup.
+struct ascii_glyph_table
+{
+    static constexpr char32_t first = 0x20;
+    static constexpr char32_t last = 0x7E;
+
+    std::array<glyph_position, last - first + 1> glyphs;
+
+    /// Whether or not the respective glyph is positioned the same regardless of its neighbors.
+    ///
+    /// This is false for characters taking part in ligatures, contextual alternates or kerning,
+    /// and for characters missing in the font.
+    std::bitset<last - first + 1> context_free;
+
+    /// @returns the glyph position for @p _codepoint if it can be shaped by table lookup.
+    glyph_position const* find(char32_t _codepoint) const noexcept
+    {
+        if (_codepoint < first || _codepoint > last || !context_free[_codepoint - first])
+            return nullptr;
+        return &glyphs[_codepoint - first];
+    }
+};
+
 /**
  * Platform-independent font loading, text shaping, and glyph rendering API.
  */
@@ -127,15 +155,50 @@ class shaper {
     virtual std::optional<glyph_position> shape(font_key _font,
                                                 char32_t _codepoint) = 0;
 
+    /**
+     * Whether or not shape() may be invoked from multiple threads at once,
+     * such as for shaping independent lines of text in parallel.
+     */
+    virtual bool concurrent_shaping() const noexcept { return false; }
+
+    /**
+     * Computes the glyph positions of the printable US-ASCII characters of font @p _font,
+     * as shape() would produce them for context-free characters.
+     *
+     * @returns std::nullopt if not supported for the given font.
+     */
+    virtual std::optional<ascii_glyph_table> ascii_glyphs(font_key _font) = 0;
+
     /**
      * Rasterizes (renders) the glyph using the given render mode.
      *
+     * This may be invoked from a worker thread while the other member functions
+     * are being used, so implementations must synchronize access to shared state.
+     * Glyphs of fonts unloaded in the meantime must not crash, though may throw.
+     *
      * @param _glyph glyph identifier.
      * @param _mode  render technique to use.
      */
     virtual std::optional<rasterized_glyph> rasterize(glyph_key _glyph, render_mode _mode) = 0;
 
     virtual bool has_color(font_key _font) const = 0;
+
+    /**
+     * Returns the path of the file the font @p _font has been loaded from,
+     * or std::nullopt if unknown (e.g. not backed by a file).
+     */
+    virtual std::optional<std::string> font_file(font_key _font) const = 0;
+
+    /**
+     * Accounts the memory held by internal caches to @p _usage,
+     * not including the fonts themselves.
+     */
+    virtual void collect_memory_usage(crispy::memory_usage& _usage) const = 0;
+
+    /**
+     * Reports the effectiveness of internal caches to @p _stats, if any.
+     */
+    virtual void collect_cache_stats(crispy::cache_statistics& /*_stats*/) const {}
 };
 
 } // end namespace text